@@ -338,9 +338,17 @@ bool AuditImpl::put_event(uint32_t event_id, cb::const_char_buffer payload) {
     try {
         auto new_event = std::make_unique<Event>(event_id, payload);
         std::lock_guard<std::mutex> guard(producer_consumer_lock);
-        if (filleventqueue.size() < max_audit_queue) {
+        const auto size = filleventqueue.size();
+        if (size < max_audit_queue) {
             filleventqueue.push(std::move(new_event));
-            events_arrived.notify_all();
+            if (size + 1 > queue_high_watermark) {
+                queue_high_watermark = size + 1;
+            }
+            // The consumer only waits for an empty queue, so it only needs
+            // waking by the first event of a batch
+            if (size == 0) {
+                events_arrived.notify_all();
+            }
             return true;
         }
     } catch (const std::bad_alloc&) {
@@ -394,12 +402,28 @@ void AuditImpl::stats(ADD_STAT add_stats, gsl::not_null<const void*> cookie) {
               enabled,
               (uint32_t)strlen(enabled),
               cookie.get());
-    const auto num_of_dropped_events = std::to_string(dropped_events);
-    add_stats("dropped_events",
-              (uint16_t)strlen("dropped_events"),
-              num_of_dropped_events.data(),
-              (uint32_t)num_of_dropped_events.length(),
-              cookie.get());
+    size_t queue_size;
+    {
+        std::lock_guard<std::mutex> guard(producer_consumer_lock);
+        queue_size = filleventqueue.size();
+    }
+
+    const std::pair<const char*, uint64_t> counters[] = {
+            {"dropped_events", dropped_events},
+            {"queue_size", queue_size},
+            {"queue_high_watermark", queue_high_watermark},
+            {"max_queue_size", max_audit_queue},
+            {"processed_events", processed_events},
+            {"processed_batches", processed_batches},
+            {"fsyncs", auditfile.get_fsync_count()}};
+    for (const auto& counter : counters) {
+        const auto value = std::to_string(counter.second);
+        add_stats(counter.first,
+                  (uint16_t)strlen(counter.first),
+                  value.data(),
+                  (uint32_t)value.length(),
+                  cookie.get());
+    }
 }
 
 void AuditImpl::consume_events() {
@@ -409,15 +433,22 @@ void AuditImpl::consume_events() {
 
     while (!stop_audit_consumer) {
         if (filleventqueue.empty()) {
-            events_arrived.wait_for(
-                    lock,
-                    std::chrono::seconds(auditfile.get_seconds_to_rotation()));
+            // Wake up for the next rotation, or the next fsync of any
+            // events written since the last one
+            auto timeout = auditfile.get_seconds_to_rotation();
+            const auto fsync_interval = config.get_fsync_interval();
+            if (fsync_interval != 0) {
+                timeout = std::min(timeout, fsync_interval);
+            }
+            events_arrived.wait_for(lock, std::chrono::seconds(timeout));
             if (filleventqueue.empty()) {
                 // We timed out, so just rotate the files
                 if (auditfile.maybe_rotate_files()) {
                     // If the file was rotated then we need to open a new
                     // audit.log file.
                     auditfile.ensure_open();
+                } else {
+                    auditfile.flush();
                 }
             }
         }
@@ -428,14 +459,21 @@ void AuditImpl::consume_events() {
         lock.unlock();
         // Now outside of the producer_consumer_lock
 
+        // The batch is written with a single flush (and fsync, when it's
+        // due) of the audit log
+        const bool batch = !processeventqueue.empty();
         while (!processeventqueue.empty()) {
             auto& event = processeventqueue.front();
             if (!event->process(*this)) {
                 dropped_events++;
             }
             processeventqueue.pop();
+            processed_events++;
+        }
+        if (batch) {
+            auditfile.flush();
+            processed_batches++;
         }
-        auditfile.flush();
         lock.lock();
     }
 
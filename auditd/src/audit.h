@@ -138,6 +138,13 @@ protected:
     /// The number of events currently dropped.
     std::atomic<uint32_t> dropped_events = {0};
 
+    /// The most events the fill queue has held
+    std::atomic<size_t> queue_high_watermark = {0};
+
+    /// The number of events (and batches of events) the consumer processed
+    std::atomic<uint64_t> processed_events = {0};
+    std::atomic<uint64_t> processed_batches = {0};
+
     ServerCookieIface* cookie_api;
 
     /// The hostname we want to inject to the audit events
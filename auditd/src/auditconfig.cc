@@ -35,6 +35,7 @@ AuditConfig::AuditConfig(const nlohmann::json& json) : AuditConfig() {
     set_rotate_interval(json.at("rotate_interval"));
     set_auditd_enabled(json.at("auditd_enabled"));
     set_buffered(json.value("buffered", true));
+    set_fsync_interval(json.value("fsync_interval", 0u));
     set_log_directory(json.at("log_path"));
     set_descriptors_path(json.at("descriptors_path"));
     set_sync(json.at("sync"));
@@ -69,6 +70,7 @@ AuditConfig::AuditConfig(const nlohmann::json& json) : AuditConfig() {
     tags["rotate_interval"] = 1;
     tags["auditd_enabled"] = 1;
     tags["buffered"] = 1;
+    tags["fsync_interval"] = 1;
     tags["log_path"] = 1;
     tags["descriptors_path"] = 1;
     tags["sync"] = 1;
@@ -140,6 +142,14 @@ bool AuditConfig::is_buffered(void) const {
     return buffered;
 }
 
+void AuditConfig::set_fsync_interval(uint32_t interval) {
+    fsync_interval = interval;
+}
+
+uint32_t AuditConfig::get_fsync_interval() const {
+    return fsync_interval;
+}
+
 void AuditConfig::set_log_directory(const std::string &directory) {
     std::lock_guard<std::mutex> guard(log_path_mutex);
     /* Sanitize path */
@@ -371,6 +381,7 @@ nlohmann::json AuditConfig::to_json() const {
     ret["rotate_size"] = get_rotate_size();
     ret["rotate_interval"] = get_rotate_interval();
     ret["buffered"] = is_buffered();
+    ret["fsync_interval"] = get_fsync_interval();
     ret["log_path"] = get_log_directory();
     ret["descriptors_path"] = get_descriptors_path();
     ret["filtering_enabled"] = is_filtering_enabled();
@@ -422,6 +433,7 @@ void AuditConfig::initialize_config(const nlohmann::json& json) {
     rotate_interval = other.rotate_interval;
     rotate_size = other.rotate_size;
     buffered = other.buffered;
+    fsync_interval = other.fsync_interval;
     filtering_enabled = other.filtering_enabled;
     {
         std::lock_guard<std::mutex> guard(log_path_mutex);
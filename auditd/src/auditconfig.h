@@ -38,6 +38,7 @@ public:
         rotate_interval(900),
         rotate_size(20 * 1024 * 1024),
         buffered(true),
+        fsync_interval(0),
         filtering_enabled(false),
         version(0),
         uuid(""),
@@ -71,6 +72,8 @@ public:
     uint32_t get_rotate_interval(void) const;
     void set_buffered(bool enable);
     bool is_buffered(void) const;
+    void set_fsync_interval(uint32_t interval);
+    uint32_t get_fsync_interval() const;
     void set_log_directory(const std::string &directory);
     std::string get_log_directory(void) const;
     void set_descriptors_path(const std::string &directory);
@@ -136,6 +139,8 @@ protected:
     Couchbase::RelaxedAtomic<uint32_t> rotate_interval;
     Couchbase::RelaxedAtomic<size_t> rotate_size;
     Couchbase::RelaxedAtomic<bool> buffered;
+    /// Seconds between fsyncs of the audit log (0 == never)
+    Couchbase::RelaxedAtomic<uint32_t> fsync_interval;
     Couchbase::RelaxedAtomic<bool> filtering_enabled;
     Couchbase::RelaxedAtomic<uint32_t> version;
 
@@ -25,7 +25,13 @@
 #include <utilities/json_utilities.h>
 
 #include <sys/stat.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -116,7 +122,11 @@ bool AuditFile::open() {
 
 void AuditFile::close_and_rotate_log() {
     cb_assert(file);
+    if (fsync_interval != 0 && unsynced && fflush(file.get()) == 0) {
+        sync();
+    }
     file.reset();
+    unsynced = false;
     if (current_size == 0) {
         remove(open_file_name.c_str());
         return;
@@ -225,6 +235,7 @@ bool AuditFile::write_event_to_disk(nlohmann::json& output) {
     try {
         const auto content = output.dump();
         current_size += fprintf(file.get(), "%s\n", content.c_str());
+        unsynced = true;
         if (ferror(file.get())) {
             LOG_WARNING("Audit: writing to disk error: {}", cb_strerror());
             ret = false;
@@ -271,6 +282,7 @@ void AuditFile::reconfigure(const AuditConfig &config) {
     set_log_directory(config.get_log_directory());
     max_log_size = config.get_rotate_size();
     buffered = config.is_buffered();
+    fsync_interval = config.get_fsync_interval();
 }
 
 bool AuditFile::flush() {
@@ -280,11 +292,37 @@ bool AuditFile::flush() {
             close_and_rotate_log();
             return false;
         }
+
+        if (fsync_interval != 0 && unsynced &&
+            difftime(auditd_time(), last_fsync) >= fsync_interval &&
+            !sync()) {
+            close_and_rotate_log();
+            return false;
+        }
     }
 
     return true;
 }
 
+bool AuditFile::sync() {
+#ifdef WIN32
+    const int ret = _commit(_fileno(file.get()));
+#else
+    int ret;
+    while ((ret = fsync(fileno(file.get()))) == -1 && errno == EINTR) {
+        /* Retry */
+    }
+#endif
+    if (ret != 0) {
+        LOG_WARNING("Audit: fsync of audit log failed: {}", cb_strerror());
+        return false;
+    }
+    last_fsync = auditd_time();
+    unsynced = false;
+    ++fsync_count;
+    return true;
+}
+
 bool AuditFile::is_timestamp_format_correct(std::string& str) {
     const char *data = str.c_str();
     if (str.length() < 19) {
@@ -19,6 +19,7 @@
 #include "auditconfig.h"
 
 #include <nlohmann/json_fwd.hpp>
+#include <atomic>
 #include <cinttypes>
 #include <cstdio>
 #include <ctime>
@@ -82,10 +83,18 @@ public:
     void reconfigure(const AuditConfig &config);
 
     /**
-     * Flush the buffers to the disk
+     * Flush the buffers to the disk, and fsync the file if it's more than
+     * the configured fsync interval since it was last synced
      */
     bool flush();
 
+    /**
+     * get the number of times the audit log has been fsynced
+     */
+    uint64_t get_fsync_count() const {
+        return fsync_count;
+    }
+
     /**
      * get the number of seconds for the next log rotation
      */
@@ -93,6 +102,8 @@ public:
 
 private:
     bool open();
+    /// fsync the (flushed) audit log
+    bool sync();
     bool time_to_rotate_log() const;
     void close_and_rotate_log();
     void set_log_directory(const std::string &new_directory);
@@ -119,5 +130,10 @@ private:
     size_t max_log_size = 20 * 1024 * 1024;
     uint32_t rotate_interval = 900;
     bool buffered = true;
+    uint32_t fsync_interval = 0;
+    time_t last_fsync = 0;
+    /// Has anything been written since the last fsync?
+    bool unsynced = false;
+    std::atomic<uint64_t> fsync_count{0};
 };
 
@@ -265,6 +265,27 @@ TEST_F(AuditConfigTest, TestLegalBuffered) {
     EXPECT_NO_THROW(config.initialize_config(json));
 }
 
+// fsync_interval
+
+TEST_F(AuditConfigTest, TestNoFsyncInterval) {
+    // fsync_interval is optional, and the log isn't fsynced unless it's set
+    json.erase("fsync_interval");
+    EXPECT_NO_THROW(config.initialize_config(json));
+    EXPECT_EQ(0, config.get_fsync_interval());
+}
+
+TEST_F(AuditConfigTest, TestLegalFsyncInterval) {
+    json["fsync_interval"] = 5;
+    EXPECT_NO_THROW(config.initialize_config(json));
+    EXPECT_EQ(5, config.get_fsync_interval());
+    EXPECT_EQ(5, config.to_json()["fsync_interval"].get<uint32_t>());
+}
+
+TEST_F(AuditConfigTest, TestIllegalDatatypeFsyncInterval) {
+    json["fsync_interval"] = "foobar";
+    EXPECT_THROW(config.initialize_config(json), nlohmann::json::exception);
+}
+
 // log_path
 
 TEST_F(AuditConfigTest, TestNoLogPath) {
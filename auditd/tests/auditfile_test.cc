@@ -129,6 +129,37 @@ TEST_F(AuditFileTest, TestTimeRotate) {
     EXPECT_EQ(10, files.size());
 }
 
+/**
+ * Test that flush() only fsyncs the file when something was written, and
+ * at most once per fsync interval
+ */
+TEST_F(AuditFileTest, TestFsyncInterval) {
+    config.set_fsync_interval(10);
+
+    AuditFile auditfile("testing");
+    auditfile.reconfigure(config);
+    auditfile.ensure_open();
+
+    EXPECT_TRUE(auditfile.flush());
+    EXPECT_EQ(0, auditfile.get_fsync_count());
+
+    auditfile.write_event_to_disk(event);
+    EXPECT_TRUE(auditfile.flush());
+    EXPECT_EQ(1, auditfile.get_fsync_count());
+
+    auditfile.write_event_to_disk(event);
+    EXPECT_TRUE(auditfile.flush());
+    EXPECT_EQ(1, auditfile.get_fsync_count());
+
+    cb_timeofday_timetravel(11);
+    EXPECT_TRUE(auditfile.flush());
+    EXPECT_EQ(2, auditfile.get_fsync_count());
+
+    // Nothing left to sync when it's closed
+    auditfile.close();
+    EXPECT_EQ(2, auditfile.get_fsync_count());
+}
+
 /**
  * Test that the we'll rotate to the next file as the content
  * of the file gets bigger.
@@ -22,6 +22,7 @@
 #include <chrono>
 #include <mutex>
 #include <sstream>
+#include <unordered_map>
 
 class PasswordDatabaseManager {
 public:
@@ -29,8 +30,11 @@ public:
     }
 
     void swap(std::unique_ptr<cb::sasl::pwdb::PasswordDatabase>& ndb) {
-        std::lock_guard<std::mutex> lock(dbmutex);
-        db.swap(ndb);
+        {
+            std::lock_guard<std::mutex> lock(dbmutex);
+            db.swap(ndb);
+        }
+        flushDummies();
     }
 
     cb::sasl::pwdb::User find(const std::string& username) {
@@ -38,9 +42,51 @@ public:
         return db->find(username);
     }
 
+    cb::sasl::pwdb::User findDummy(const std::string& username,
+                                   cb::sasl::Mechanism mech) {
+        auto key = std::to_string(int(mech)) + ":" + username;
+        {
+            std::lock_guard<std::mutex> lock(dummymutex);
+            auto iter = dummies.find(key);
+            if (iter != dummies.end()) {
+                return iter->second;
+            }
+        }
+
+        // Generating the secrets runs PBKDF2, so don't hold the lock
+        // while doing so
+        auto user = cb::sasl::pwdb::UserFactory::createDummy(username, mech);
+
+        std::lock_guard<std::mutex> lock(dummymutex);
+        if (dummies.size() >= MaxDummyUsers) {
+            dummies.erase(dummies.begin());
+        }
+        dummies.emplace(key, user);
+        return user;
+    }
+
+    void flushDummies() {
+        std::lock_guard<std::mutex> lock(dummymutex);
+        dummies.clear();
+    }
+
 private:
+    /**
+     * The maximum number of dummy users to keep. When full an arbitrary
+     * entry is evicted to make room for the new one.
+     */
+    static const size_t MaxDummyUsers = 1024;
+
     std::mutex dbmutex;
     std::unique_ptr<cb::sasl::pwdb::PasswordDatabase> db;
+
+    /**
+     * Dummy users handed out for unknown users (keyed by mechanism and
+     * username), so that a client retrying with an unknown user doesn't
+     * cost a PBKDF2 run for every attempt.
+     */
+    std::mutex dummymutex;
+    std::unordered_map<std::string, cb::sasl::pwdb::User> dummies;
 };
 
 static PasswordDatabaseManager pwmgr;
@@ -50,6 +96,15 @@ bool find_user(const std::string& username, cb::sasl::pwdb::User& user) {
     return !user.isDummy();
 }
 
+cb::sasl::pwdb::User find_dummy_user(const std::string& username,
+                                     cb::sasl::Mechanism mech) {
+    return pwmgr.findDummy(username, mech);
+}
+
+void flush_dummy_users() {
+    pwmgr.flushDummies();
+}
+
 cb::sasl::Error parse_user_db(const std::string content, bool file) {
     try {
         auto start = std::chrono::steady_clock::now();
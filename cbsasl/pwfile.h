@@ -27,4 +27,22 @@
  */
 bool find_user(const std::string& username, cb::sasl::pwdb::User& user);
 
+/**
+ * Get the dummy user to use for an unknown user. Creating a dummy user
+ * generates its secrets with PBKDF2, so a bounded number of them are kept
+ * until the password database is reloaded (or the iteration count or
+ * fallback salt used to generate them is changed).
+ *
+ * @param username the username to generate the dummy user for
+ * @param mech the mechanism to generate the secrets for
+ * @return the dummy user
+ */
+cb::sasl::pwdb::User find_dummy_user(const std::string& username,
+                                     cb::sasl::Mechanism mech);
+
+/**
+ * Drop all of the cached dummy users
+ */
+void flush_dummy_users();
+
 cb::sasl::Error load_user_db();
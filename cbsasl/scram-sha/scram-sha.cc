@@ -401,7 +401,7 @@ std::pair<Error, const_char_buffer> ServerBackend::start(
         logging::log(&context,
                      logging::Level::Debug,
                      "User [" + username + "] doesn't exist.. using dummy");
-        user = pwdb::UserFactory::createDummy(username, mechanism);
+        user = find_dummy_user(username, mechanism);
     }
 
     const auto& passwordMeta = user.getPassword(mechanism);
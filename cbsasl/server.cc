@@ -118,11 +118,13 @@ void shutdown() {
 CBSASL_PUBLIC_API
 void set_hmac_iteration_count(int count) {
     pwdb::UserFactory::setDefaultHmacIterationCount(count);
+    flush_dummy_users();
 }
 
 CBSASL_PUBLIC_API
 void set_scramsha_fallback_salt(const std::string& salt) {
     pwdb::UserFactory::setScramshaFallbackSalt(salt);
+    flush_dummy_users();
 }
 
 } // namespace server
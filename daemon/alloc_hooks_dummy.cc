@@ -80,3 +80,25 @@ int DummyAllocHooks::set_allocator_property(const char* name,
                                             size_t newlen) {
     return 1;
 }
+
+bool DummyAllocHooks::create_arena(unsigned* arena) {
+    return false;
+}
+
+void DummyAllocHooks::release_arena(unsigned arena) {
+    // empty
+}
+
+bool DummyAllocHooks::set_thread_arena(unsigned arena) {
+    return false;
+}
+
+size_t DummyAllocHooks::get_arena_allocated(unsigned arena) {
+    return 0;
+}
+
+bool DummyAllocHooks::get_allocation_utilization(const void* ptr,
+                                                 size_t* nfree,
+                                                 size_t* nregs) {
+    return false;
+}
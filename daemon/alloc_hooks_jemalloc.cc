@@ -38,6 +38,10 @@
 #include <jemalloc/jemalloc.h>
 #include <logger/logger.h>
 
+#include <mutex>
+#include <string>
+#include <vector>
+
 #if defined(HAVE_MEMALIGN)
 #include <malloc.h>
 #endif
@@ -218,3 +222,95 @@ int JemallocHooks::set_allocator_property(const char* name,
                                           size_t newlen) {
     return je_mallctl(name, nullptr, 0, newp, newlen);
 }
+
+/* Arenas released by buckets, reused before creating any more. */
+static std::mutex releasedArenasMutex;
+static std::vector<unsigned> releasedArenas;
+
+bool JemallocHooks::create_arena(unsigned* arena) {
+    {
+        std::lock_guard<std::mutex> lh(releasedArenasMutex);
+        if (!releasedArenas.empty()) {
+            *arena = releasedArenas.back();
+            releasedArenas.pop_back();
+            return true;
+        }
+    }
+    size_t size = sizeof(*arena);
+    int err = je_mallctl("arenas.create", arena, &size, nullptr, 0);
+    if (err != 0) {
+        LOG_WARNING("jemalloc_create_arena() error {}", err);
+        return false;
+    }
+    return true;
+}
+
+void JemallocHooks::release_arena(unsigned arena) {
+    const auto purge = "arena." + std::to_string(arena) + ".purge";
+    int err = je_mallctl(purge.c_str(), nullptr, nullptr, nullptr, 0);
+    if (err != 0) {
+        LOG_WARNING("jemalloc_release_arena({}) error {}", arena, err);
+    }
+    std::lock_guard<std::mutex> lh(releasedArenasMutex);
+    releasedArenas.push_back(arena);
+}
+
+bool JemallocHooks::set_thread_arena(unsigned arena) {
+    /* Called whenever a thread switches bucket, so skip the name lookup. */
+    static size_t mib[2];
+    static size_t miblen = [] {
+        size_t len = sizeof(mib) / sizeof(mib[0]);
+        return je_mallctlnametomib("thread.arena", mib, &len) == 0 ? len : 0;
+    }();
+    if (miblen == 0) {
+        return false;
+    }
+    return je_mallctlbymib(mib, miblen, nullptr, nullptr, &arena,
+                           sizeof(arena)) == 0;
+}
+
+size_t JemallocHooks::get_arena_allocated(unsigned arena) {
+    size_t epoch = 1;
+    size_t sz = sizeof(epoch);
+    /* jemalloc can cache its statistics - force a refresh */
+    je_mallctl("epoch", &epoch, &sz, &epoch, sz);
+
+    const auto prefix = "stats.arenas." + std::to_string(arena);
+    size_t small = 0;
+    size_t large = 0;
+    jemalloc_get_stats_prop((prefix + ".small.allocated").c_str(), &small);
+    jemalloc_get_stats_prop((prefix + ".large.allocated").c_str(), &large);
+    return small + large;
+}
+
+bool JemallocHooks::get_allocation_utilization(const void* ptr,
+                                               size_t* nfree,
+                                               size_t* nregs) {
+    /* Called for every value the defragmenter visits, so skip the name
+     * lookup. experimental.utilization.query needs jemalloc 5.2 or later. */
+    static size_t mib[3];
+    static size_t miblen = [] {
+        size_t len = sizeof(mib) / sizeof(mib[0]);
+        return je_mallctlnametomib("experimental.utilization.query", mib,
+                                   &len) == 0
+                       ? len
+                       : 0;
+    }();
+    if (miblen == 0) {
+        return false;
+    }
+
+    /* Layout of jemalloc's extent_util_stats_t */
+    struct {
+        size_t nfree;
+        size_t nregs;
+        size_t size;
+    } util;
+    size_t size = sizeof(util);
+    if (je_mallctlbymib(mib, miblen, &util, &size, &ptr, sizeof(ptr)) != 0) {
+        return false;
+    }
+    *nfree = util.nfree;
+    *nregs = util.nregs;
+    return true;
+}
@@ -43,6 +43,7 @@ Bucket::Bucket(const Bucket& other)
     timings = other.timings;
     subjson_operation_times = other.subjson_operation_times;
     topkeys = other.topkeys;
+    vbucketLoad = other.vbucketLoad;
     responseCounters = other.responseCounters;
 }
 
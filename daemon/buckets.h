@@ -19,7 +19,9 @@
 #include "config.h"
 #include "cluster_config.h"
 #include "mcbp_validators.h"
+#include "timing_histogram.h"
 #include "timings.h"
+#include "vbucket_load.h"
 
 #include <memcached/server_callback_iface.h>
 #include <memcached/types.h>
@@ -151,6 +153,11 @@ public:
      */
     TopKeys *topkeys;
 
+    /**
+     * Per-vBucket read / write counts and rates
+     */
+    VBucketLoad vbucketLoad;
+
     /**
      * The validator chains to use for this bucket when receiving MCBP commands.
      */
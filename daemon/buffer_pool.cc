@@ -0,0 +1,159 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include "buffer_pool.h"
+
+#include <platform/cb_malloc.h>
+#include <relaxed_atomic.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+/// Number of size classes (MinBlockSize, 2 * MinBlockSize, ... MaxBlockSize)
+const size_t NumClasses = 7;
+static_assert(BufferPool::MinBlockSize << (NumClasses - 1) ==
+                      BufferPool::MaxBlockSize,
+              "NumClasses doesn't match the block sizes");
+
+/// The size class recorded for the buffers not from the pool
+const uint32_t Unpooled = NumClasses;
+
+/**
+ * Each buffer is preceded by a header with its size class. The header
+ * is padded to keep the buffer suitably aligned.
+ */
+union Header {
+    uint32_t sizeClass;
+    std::max_align_t align;
+};
+
+/// @returns the size class for the size (NumClasses if it is too large)
+size_t getSizeClass(size_t size) {
+    size_t sizeClass = 0;
+    while (sizeClass < NumClasses &&
+           (BufferPool::MinBlockSize << sizeClass) < size) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+class ThreadPool;
+
+/// All of the thread's pools, to collect their stats
+std::mutex poolsMutex;
+std::vector<ThreadPool*> pools;
+/// The stats of the pools of threads which have gone
+BufferPool::Stats retiredStats;
+
+class ThreadPool {
+public:
+    ThreadPool() {
+        std::lock_guard<std::mutex> guard(poolsMutex);
+        pools.push_back(this);
+    }
+
+    ~ThreadPool() {
+        for (auto& list : free) {
+            for (auto* header : list) {
+                cb_free(header);
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(poolsMutex);
+        retiredStats.hits += hits;
+        retiredStats.misses += misses;
+        pools.erase(std::find(pools.begin(), pools.end(), this));
+    }
+
+    char* allocate(size_t size) {
+        const auto sizeClass = getSizeClass(size);
+        Header* header;
+        if (sizeClass < NumClasses && !free[sizeClass].empty()) {
+            header = free[sizeClass].back();
+            free[sizeClass].pop_back();
+            hits++;
+        } else {
+            const auto blockSize = sizeClass < NumClasses
+                                           ? BufferPool::MinBlockSize
+                                                     << sizeClass
+                                           : size;
+            header = static_cast<Header*>(
+                    cb_malloc(sizeof(Header) + blockSize));
+            if (header == nullptr) {
+                return nullptr;
+            }
+            header->sizeClass = uint32_t(
+                    sizeClass < NumClasses ? sizeClass : Unpooled);
+            misses++;
+        }
+        return reinterpret_cast<char*>(header + 1);
+    }
+
+    void release(char* buffer) {
+        auto* header = reinterpret_cast<Header*>(buffer) - 1;
+        const auto sizeClass = header->sizeClass;
+        if (sizeClass == Unpooled ||
+            free[sizeClass].size() >= BufferPool::MaxFreeBlocks) {
+            cb_free(header);
+            return;
+        }
+        free[sizeClass].push_back(header);
+    }
+
+    Couchbase::RelaxedAtomic<uint64_t> hits;
+    Couchbase::RelaxedAtomic<uint64_t> misses;
+
+private:
+    std::array<std::vector<Header*>, NumClasses> free;
+};
+
+ThreadPool& getThreadPool() {
+    thread_local ThreadPool pool;
+    return pool;
+}
+
+} // namespace
+
+char* BufferPool::allocate(size_t size) {
+    return getThreadPool().allocate(size);
+}
+
+void BufferPool::release(char* buffer) {
+    if (buffer != nullptr) {
+        getThreadPool().release(buffer);
+    }
+}
+
+size_t BufferPool::getBlockSize(size_t size) {
+    const auto sizeClass = getSizeClass(size);
+    return sizeClass < NumClasses ? MinBlockSize << sizeClass : size;
+}
+
+BufferPool::Stats BufferPool::getStats() {
+    std::lock_guard<std::mutex> guard(poolsMutex);
+    auto stats = retiredStats;
+    for (const auto* pool : pools) {
+        stats.hits += pool->hits;
+        stats.misses += pool->misses;
+    }
+    return stats;
+}
@@ -0,0 +1,65 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The BufferPool keeps the (response) buffers used by the front end around
+ * for reuse, so that the steady state request path doesn't have to go to
+ * the memory allocator for them.
+ *
+ * Buffers come in size classes of powers of two from MinBlockSize up to
+ * MaxBlockSize; larger buffers are allocated (and freed) directly. Each
+ * thread has its own pool, so allocating and releasing a buffer doesn't
+ * need any locking. A buffer may be released by a different thread than
+ * the one which allocated it; it then goes into the pool of the releasing
+ * thread. Each pool keeps at most MaxFreeBlocks free buffers per size class.
+ */
+class BufferPool {
+public:
+    /**
+     * Allocate a buffer of at least size bytes (the size of the buffer
+     * is rounded up to the size class)
+     *
+     * @return the buffer, or nullptr if memory allocation failed
+     */
+    static char* allocate(size_t size);
+
+    /**
+     * Release a buffer allocated with allocate (nullptr is ignored)
+     */
+    static void release(char* buffer);
+
+    /// Round the size up to the size of the buffer allocate would return
+    static size_t getBlockSize(size_t size);
+
+    struct Stats {
+        /// Allocations served from the pool
+        uint64_t hits = 0;
+        /// Allocations which had to go to the memory allocator
+        uint64_t misses = 0;
+    };
+
+    /// Get the stats of all of the pools (of all threads)
+    static Stats getStats();
+
+    static const size_t MinBlockSize = 1024;
+    static const size_t MaxBlockSize = 64 * 1024;
+    static const size_t MaxFreeBlocks = 16;
+};
@@ -21,6 +21,7 @@
 #include "memcached.h"
 #include "server_event.h"
 
+#include <gsl/gsl>
 #include <mcbp/protocol/framebuilder.h>
 #include <memory>
 
@@ -58,12 +59,13 @@ public:
 
     bool execute(Connection& connection) override {
         auto& bucket = connection.getBucket();
-        auto payload = bucket.clusterConfiguration.getConfiguration();
-        if (payload.first < connection.getClustermapRevno()) {
-            // Ignore.. we've already sent a newer cluster config
+        if (bucket.clusterConfiguration.getRevision() <=
+            connection.getClustermapRevno()) {
+            // Ignore.. we've already sent this (or a newer) cluster config
             return true;
         }
 
+        auto payload = bucket.clusterConfiguration.getConfiguration();
         connection.setClustermapRevno(payload.first);
         LOG_INFO("{}: Sending Cluster map revision {}",
                  connection.getId(),
@@ -74,8 +76,7 @@ public:
         using namespace cb::mcbp;
         size_t needed = sizeof(Request) + // packet header
                         4 + // rev number in extdata
-                        name.size() + // the name of the bucket
-                        payload.second->size(); // The actual payload
+                        name.size(); // the name of the bucket
 
         connection.write->ensureCapacity(needed);
         FrameBuilder<Request> builder(connection.write->wdata());
@@ -89,14 +90,19 @@ public:
                 {reinterpret_cast<const uint8_t*>(&rev), sizeof(rev)});
         builder.setKey(
                 {reinterpret_cast<const uint8_t*>(name.data()), name.size()});
-        builder.setValue(
-                {reinterpret_cast<const uint8_t*>(payload.second->data()),
-                 payload.second->size()});
+
+        // The actual payload is sent straight from the shared copy of the
+        // configuration rather than being copied into the write buffer
+        auto* request = builder.getFrame();
+        request->setBodylen(gsl::narrow<uint32_t>(request->getBodylen() +
+                                                  payload.second->size()));
 
         // Inject our packet into the stream!
         connection.addMsgHdr(true);
         connection.addIov(connection.write->wdata().data(), needed);
         connection.write->produced(needed);
+        connection.addIov(payload.second->data(), payload.second->size());
+        connection.pushSharedBuffer(std::move(payload.second));
 
         connection.setState(StateMachine::State::send_data);
         connection.setWriteAndGo(StateMachine::State::new_cmd);
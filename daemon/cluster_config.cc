@@ -29,9 +29,10 @@ void ClusterConfiguration::setConfiguration(cb::const_char_buffer buffer) {
                 "revision");
     }
 
+    Config next = std::make_shared<std::string>(buffer.begin(), buffer.end());
     std::lock_guard<std::mutex> guard(mutex);
+    config = std::move(next);
     revision = rev;
-    config = std::make_shared<std::string>(buffer.begin(), buffer.end());
 }
 
 int ClusterConfiguration::getRevisionNumber(cb::const_char_buffer buffer) {
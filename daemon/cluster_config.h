@@ -18,6 +18,7 @@
 
 #include <platform/sized_buffer.h>
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <mutex>
@@ -32,6 +33,13 @@
  */
 class ClusterConfiguration {
 public:
+    /**
+     * The configuration is never modified once set, so all of the responses
+     * carrying it may refer to the same copy (and keep it alive until they
+     * are sent) instead of copying it into each connection's buffers.
+     */
+    using Config = std::shared_ptr<const std::string>;
+
     ClusterConfiguration()
         : config(std::make_shared<std::string>()), revision(-1) {
     }
@@ -42,13 +50,22 @@ public:
      * Get the current configuration.
      *
      * @return a pair where the first element is the revision number, and
-     *         the second element is (a copy) of the configuration.
+     *         the second element is the (shared) configuration.
      */
-    std::pair<int, std::shared_ptr<std::string>> getConfiguration() const {
+    std::pair<int, Config> getConfiguration() const {
         std::lock_guard<std::mutex> guard(mutex);
-        return std::make_pair(revision, config);
+        return std::make_pair(revision.load(), config);
     };
 
+    /**
+     * Get the revision number of the current configuration without
+     * fetching the configuration (so that a connection which already
+     * has it doesn't need to take the lock).
+     */
+    int getRevision() const {
+        return revision;
+    }
+
     /**
      * Pick out the revision number from the provided cluster configuration.
      *
@@ -70,10 +87,10 @@ private:
     /**
      * The actual config
      */
-    std::shared_ptr<std::string> config;
+    Config config;
 
     /**
      * Cached revision so we don't have to parse it every time
      */
-    int revision;
+    std::atomic<int> revision;
 };
@@ -21,6 +21,7 @@
 #include "connections.h"
 #include "cookie.h"
 #include "external_auth_manager_thread.h"
+#include "front_end_thread.h"
 #include "mc_time.h"
 #include "mcaudit.h"
 #include "memcached.h"
@@ -44,6 +45,7 @@
 #include <gsl/gsl>
 
 #include <cctype>
+#include <cstring>
 #include <exception>
 #ifndef WIN32
 #include <netinet/tcp.h> // For TCP_NODELAY etc
@@ -72,6 +74,12 @@ bool Connection::setTcpNoDelay(bool enable) {
         return false;
     }
 
+    if (unixDomain) {
+        // There is no Nagle's algorithm to disable on a Unix domain socket
+        nodelay = enable;
+        return true;
+    }
+
     const int flags = enable ? 1 : 0;
     int error = cb::net::setsockopt(socketDescriptor,
                                     IPPROTO_TCP,
@@ -642,6 +650,11 @@ void Connection::shrinkBuffers() {
     // We share the buffers with the thread, so we don't need to worry
     // about the read and write buffer.
 
+    if (heldResponses > 0) {
+        // The IO vector is still in use
+        return;
+    }
+
     if (msglist.size() > MSG_LIST_HIGHWAT) {
         try {
             msglist.resize(MSG_LIST_INITIAL);
@@ -767,7 +780,8 @@ int Connection::sslPreConnection() {
                 ERR_error_string_n(
                         ERR_get_error(), ssl_err.data(), ssl_err.size());
 
-                LOG_WARNING("{}: {}: {}", getId(), errmsg, ssl_err.data());
+                LOG_WARNING_RATELIMITED(
+                        "{}: {}: {}", getId(), errmsg, ssl_err.data());
             } catch (const std::bad_alloc&) {
                 // unable to print error message; continue.
             }
@@ -811,21 +825,75 @@ int Connection::recv(char* dest, size_t nbytes) {
             totalRecv += res;
         }
     }
+    get_thread_stats(this)->read_syscalls++;
 
     return res;
 }
 
+size_t Connection::getReadSize() const {
+    size_t ret = std::min(
+            std::max(avgPacketSize * size_t(max_reqs_per_event), MinReadSize),
+            MaxReadSize);
+
+    const auto input = read->rdata();
+    size_t needed = sizeof(cb::mcbp::Request);
+    if (input.size() >= sizeof(cb::mcbp::Request)) {
+        needed += reinterpret_cast<const cb::mcbp::Request*>(input.data())
+                          ->getBodylen();
+    }
+    ret = std::max(ret, needed);
+    return ret > input.size() ? ret - input.size() : 1;
+}
+
 ssize_t Connection::sendmsg(struct msghdr* m) {
     ssize_t res = 0;
     if (ssl.isEnabled()) {
-        for (int ii = 0; ii < int(m->msg_iovlen); ++ii) {
-            int n = sslWrite(reinterpret_cast<char*>(m->msg_iov[ii].iov_base),
-                             m->msg_iov[ii].iov_len);
-            if (n > 0) {
-                res += n;
+        // Every SSL_write makes (at least) one TLS record, each with its
+        // own header, MAC and cipher setup - and a response is typically
+        // made up of a number of tiny chunks (header, extras, key, ...).
+        // Gather the chunks which fit in a chunk of the BIO into a single
+        // write. (If a write must be retried, the retry gathers the same
+        // data into the same buffer as OpenSSL expects.)
+        const size_t gatherSize = settings.getBioDrainBufferSize();
+        int ii = 0;
+        while (ii < int(m->msg_iovlen)) {
+            size_t gathered = 0;
+            int next = ii;
+            while (next < int(m->msg_iovlen) &&
+                   gathered + m->msg_iov[next].iov_len <= gatherSize) {
+                gathered += m->msg_iov[next].iov_len;
+                ++next;
+            }
+
+            const char* data;
+            size_t size;
+            if (next - ii > 1) {
+                sslGatherBuffer.resize(gatherSize);
+                auto* ptr = sslGatherBuffer.data();
+                for (int jj = ii; jj < next; ++jj) {
+                    std::memcpy(ptr,
+                                m->msg_iov[jj].iov_base,
+                                m->msg_iov[jj].iov_len);
+                    ptr += m->msg_iov[jj].iov_len;
+                }
+                data = sslGatherBuffer.data();
+                size = gathered;
             } else {
+                data = reinterpret_cast<const char*>(m->msg_iov[ii].iov_base);
+                size = m->msg_iov[ii].iov_len;
+                next = ii + 1;
+            }
+
+            int n = sslWrite(data, size);
+            if (n <= 0) {
                 return res > 0 ? res : -1;
             }
+            res += n;
+            if (size_t(n) < size) {
+                // Let the caller adjust the IO vector and try again
+                break;
+            }
+            ii = next;
         }
 
         /* @todo figure out how to drain the rest of the data if we
@@ -908,6 +976,7 @@ Connection::TransmitResult Connection::transmit() {
 
         res = sendmsg(m);
         auto error = cb::net::get_socket_error();
+        get_thread_stats(this)->write_syscalls++;
         if (res > 0) {
             get_thread_stats(this)->bytes_written += res;
 
@@ -927,6 +996,7 @@ Connection::TransmitResult Connection::transmit() {
                         }
                         return TransmitResult::SoftError;
                     }
+                    heldResponses = 0;
                     return TransmitResult::Complete;
                 }
             }
@@ -949,8 +1019,9 @@ Connection::TransmitResult Connection::transmit() {
                 LOG_INFO("{}: Failed to send data; peer closed the connection",
                          getId());
             } else {
-                LOG_WARNING("Failed to write, and not due to blocking: {}",
-                            cb_strerror(error));
+                LOG_WARNING_RATELIMITED(
+                        "Failed to write, and not due to blocking: {}",
+                        cb_strerror(error));
             }
         } else {
             // sendmsg should return the number of bytes written, but we
@@ -968,6 +1039,7 @@ Connection::TransmitResult Connection::transmit() {
         setState(StateMachine::State::closing);
         return TransmitResult::HardError;
     } else {
+        heldResponses = 0;
         return TransmitResult::Complete;
     }
 }
@@ -989,17 +1061,21 @@ Connection::TryReadResult Connection::tryReadNetwork() {
                 "contain a partial header");
     }
 
-    // Make sure we can fit the header into the input buffer
+    // Make sure we can fit the header (and hopefully the next few
+    // packets) into the input buffer
+    const auto readSize = getReadSize();
     try {
-        read->ensureCapacity(sizeof(cb::mcbp::Request) - read->rsize());
+        read->ensureCapacity(readSize);
     } catch (const std::bad_alloc&) {
         return TryReadResult::MemoryError;
     }
 
     Connection* c = this;
-    const auto res = read->produce([c](cb::byte_buffer buffer) -> ssize_t {
-        return c->recv(reinterpret_cast<char*>(buffer.data()), buffer.size());
-    });
+    const auto res =
+            read->produce([c, readSize](cb::byte_buffer buffer) -> ssize_t {
+                return c->recv(reinterpret_cast<char*>(buffer.data()),
+                               std::min(buffer.size(), readSize));
+            });
 
     if (res > 0) {
         get_thread_stats(this)->bytes_read += res;
@@ -1078,9 +1154,10 @@ int Connection::sslRead(char* dest, size_t nbytes) {
                  * @todo I don't know how to gracefully recover from this
                  * let's just shut down the connection
                  */
-                LOG_WARNING("{}: ERROR: SSL_read returned -1 with error {}",
-                            getId(),
-                            error);
+                LOG_WARNING_RATELIMITED(
+                        "{}: ERROR: SSL_read returned -1 with error {}",
+                        getId(),
+                        error);
                 cb::net::set_econnreset();
                 return -1;
             }
@@ -1131,7 +1208,7 @@ int Connection::sslWrite(const char* src, size_t nbytes) {
                      * @todo I don't know how to gracefully recover from this
                      * let's just shut down the connection
                      */
-                    LOG_WARNING(
+                    LOG_WARNING_RATELIMITED(
                             "{}: ERROR: SSL_write returned -1 with error {}",
                             getId(),
                             error);
@@ -1146,6 +1223,14 @@ int Connection::sslWrite(const char* src, size_t nbytes) {
 }
 
 void Connection::addMsgHdr(bool reset) {
+    holdableResponse = false;
+    if (reset && heldResponses > 0) {
+        // The response is appended to the ones held back, so that they're
+        // all sent with a single sendmsg (addIov starts a new msghdr if
+        // the current one is full)
+        return;
+    }
+
     if (reset) {
         msgcurr = 0;
         msglist.clear();
@@ -1192,6 +1277,46 @@ void Connection::addIov(const void* buf, size_t len) {
     m->msg_iovlen++;
 }
 
+void Connection::addIovCopy(const void* buf, size_t len) {
+    ensureWriteCapacity(len);
+    auto wdata = write->wdata();
+    std::memcpy(wdata.data(), buf, len);
+    write->produced(len);
+    addIov(wdata.data(), len);
+}
+
+Connection::PrefetchedGet::PrefetchedGet(const cb::mcbp::Request& request,
+                                         cb::EngineErrorItemPair result)
+    : opaque(request.getOpaque()),
+      vbucket(request.getVBucket()),
+      key(reinterpret_cast<const char*>(request.getKey().data()),
+          request.getKey().size()),
+      result(std::move(result)) {
+}
+
+bool Connection::PrefetchedGet::isFor(const cb::mcbp::Request& request) const {
+    const auto requestKey = request.getKey();
+    return request.getOpaque() == opaque && request.getVBucket() == vbucket &&
+           requestKey.size() == key.size() &&
+           std::memcmp(requestKey.data(), key.data(), key.size()) == 0;
+}
+
+void Connection::addPrefetchedGet(const cb::mcbp::Request& request,
+                                  cb::EngineErrorItemPair result) {
+    prefetchedGets.emplace_back(request, std::move(result));
+}
+
+cb::EngineErrorItemPair Connection::takePrefetchedGet(
+        const cb::mcbp::Request& request) {
+    if (!prefetchedGets.empty() && prefetchedGets.front().isFor(request)) {
+        auto ret = std::move(prefetchedGets.front().result);
+        prefetchedGets.pop_front();
+        return ret;
+    }
+    prefetchedGets.clear();
+    return cb::makeEngineErrorItemPair(cb::engine_errc::would_block);
+}
+
 void Connection::releaseReservedItems() {
     auto* bucketEngine = getBucket().getEngine();
     for (auto* it : reservedItems) {
@@ -1206,18 +1331,60 @@ void Connection::ensureIovSpace() {
         return;
     }
 
+    // Remember where each msghdr starts in the array (a msghdr which is
+    // partly sent no longer points at the first of its entries)
+    std::vector<size_t> offsets;
+    offsets.reserve(msglist.size());
+    for (const auto& msg : msglist) {
+        offsets.push_back(size_t(msg.msg_iov - iov.data()));
+    }
+
     // Try to double the size of the array
     iov.resize(iov.size() * 2);
 
     /* Point all the msghdr structures at the new list. */
-    size_t ii;
-    int iovnum;
-    for (ii = 0, iovnum = 0; ii < msglist.size(); ii++) {
-        msglist[ii].msg_iov = &iov[iovnum];
-        iovnum += msglist[ii].msg_iovlen;
+    for (size_t ii = 0; ii < msglist.size(); ii++) {
+        msglist[ii].msg_iov = &iov[offsets[ii]];
     }
 }
 
+void Connection::ensureWriteCapacity(size_t size) {
+    const auto before = write->rdata();
+    write->ensureCapacity(size);
+    const auto after = write->rdata();
+    if (before.data() == after.data() || before.empty()) {
+        return;
+    }
+
+    // The pending data was moved; update the entries pointing into it
+    const auto begin = reinterpret_cast<uintptr_t>(before.data());
+    const auto end = begin + before.size();
+    for (size_t ii = 0; ii < iovused; ++ii) {
+        const auto base = reinterpret_cast<uintptr_t>(iov[ii].iov_base);
+        if (base >= begin && base < end) {
+            iov[ii].iov_base = const_cast<uint8_t*>(after.data()) +
+                               (base - begin);
+        }
+    }
+}
+
+bool Connection::holdResponse() {
+    // A response may only be held back while the next command is already
+    // in the input buffer; it is executed right away, and its response is
+    // added to the same msghdr. Once no complete command is left (or the
+    // next command blocks) everything held back is sent.
+    if (!holdableResponse || !settings.isCoalesceResponses() || isDCP() ||
+        write_and_go != StateMachine::State::new_cmd || msgcurr != 0 ||
+        msglist.size() != 1 || msgbytes >= MaxHeldResponseBytes ||
+        !isPacketAvailable()) {
+        return false;
+    }
+
+    ++heldResponses;
+    get_thread_stats(this)->responses_held++;
+    return true;
+}
+
 bool Connection::enableSSL(const std::string& cert, const std::string& pkey) {
     if (ssl.enable(cert, pkey)) {
         if (settings.getVerbose() > 1) {
@@ -1247,8 +1414,13 @@ Connection::Connection(SOCKET sfd, event_base* b, const ListeningPort& ifc)
     : socketDescriptor(sfd),
       base(b),
       parent_port(ifc.port),
-      peername(cb::net::getpeername(socketDescriptor)),
-      sockname(cb::net::getsockname(socketDescriptor)),
+      unixDomain(!ifc.path.empty()),
+      // Clients of a Unix domain socket are unnamed; both ends are
+      // identified by the socket's path.
+      peername(ifc.path.empty() ? cb::net::getpeername(socketDescriptor)
+                                : "unix:" + ifc.path),
+      sockname(ifc.path.empty() ? cb::net::getsockname(socketDescriptor)
+                                : "unix:" + ifc.path),
       stateMachine(*this),
       max_reqs_per_event(settings.getRequestsPerEventNotification(
               EventPriority::Default)) {
@@ -1276,10 +1448,9 @@ Connection::~Connection() {
         externalAuthManager->logoff(username);
     }
 
+    clearPrefetchedGets();
     releaseReservedItems();
-    for (auto* ptr : temp_alloc) {
-        cb_free(ptr);
-    }
+    releaseTempAlloc();
     if (socketDescriptor != INVALID_SOCKET) {
         LOG_DEBUG("{} - Closing socket descriptor", getId());
         safe_close(socketDescriptor);
@@ -1332,6 +1503,53 @@ size_t Connection::getNumberOfCookies() const {
     return ret;
 }
 
+bool Connection::parkCookie() {
+    if (cookies.size() > MaxParkedCookies) {
+        return false;
+    }
+    cookies.emplace(cookies.begin(), std::unique_ptr<Cookie>{new Cookie(*this)});
+    return true;
+}
+
+bool Connection::resumeParkedCookie() {
+    for (auto iter = cookies.begin() + 1; iter != cookies.end(); ++iter) {
+        if (!(*iter)->isEwouldblock()) {
+            // The current cookie is idle, so it may simply be dropped
+            std::swap(cookies.front(), *iter);
+            cookies.erase(iter);
+            setState(StateMachine::State::execute);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Connection::mustWaitForParkedCookies() const {
+    if (cookies.size() == 1) {
+        return false;
+    }
+
+    // We only need the framing extras (holding the reorder flag) of the
+    // next command, but wait for the parked ones until they're available
+    const auto input = read->rdata();
+    const auto* header = reinterpret_cast<const cb::mcbp::Header*>(input.data());
+    if (input.size() < sizeof(cb::mcbp::Request) ||
+        input.size() < sizeof(cb::mcbp::Request) +
+                               header->getFramingExtraslen()) {
+        return true;
+    }
+    if (!header->isRequest()) {
+        return true;
+    }
+
+    try {
+        return !header->getRequest().mayReorder();
+    } catch (const std::exception&) {
+        // Invalid framing extras; leave it to the validators to reject
+        return false;
+    }
+}
+
 bool Connection::isPacketAvailable() const {
     auto buffer = read->rdata();
 
@@ -1464,6 +1682,7 @@ bool Connection::close() {
         shutdown(socketDescriptor, SHUT_RD);
 
         // Release all reserved items!
+        clearPrefetchedGets();
         releaseReservedItems();
     }
 
@@ -1529,6 +1748,74 @@ void Connection::signalIfIdle(bool logbusy, size_t workerthread) {
     }
 }
 
+bool Connection::isMigratable() {
+    return !isDCP() && refcount == 1 && isIdleBetweenCommands();
+}
+
+bool Connection::isIdleBetweenCommands() {
+    const auto state = stateMachine.getCurrentState();
+    if (!registered_in_libevent || socketDescriptor == INVALID_SOCKET ||
+        (state != StateMachine::State::read_packet_header &&
+         state != StateMachine::State::ship_log) ||
+        !server_events.empty() || cookies.size() > 1) {
+        return false;
+    }
+
+    if ((read && !read->empty()) || (write && !write->empty()) ||
+        ssl.havePendingInputData()) {
+        return false;
+    }
+
+    for (const auto& c : cookies) {
+        if (c->isEwouldblock()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Connection::moveToThread(FrontEndThread& to) {
+    if (!unregisterEvent()) {
+        return false;
+    }
+
+    if (event_assign(event.get(),
+                     to.base,
+                     socketDescriptor,
+                     ev_flags,
+                     event_handler,
+                     reinterpret_cast<void*>(this)) == -1) {
+        LOG_WARNING("{}: Failed to move connection to worker thread {}",
+                    getId(),
+                    to.index);
+        // Restore the event on our own base
+        event_assign(event.get(),
+                     base,
+                     socketDescriptor,
+                     ev_flags,
+                     event_handler,
+                     reinterpret_cast<void*>(this));
+        registerEvent();
+        return false;
+    }
+
+    base = to.base;
+    setThread(&to);
+    return true;
+}
+
+void Connection::setDCP(bool dcp) {
+    auto* thr = getThread();
+    if (thr && dcp != Connection::dcp) {
+        if (dcp) {
+            thr->load.dcp_connections++;
+        } else {
+            thr->load.dcp_connections--;
+        }
+    }
+    Connection::dcp = dcp;
+}
+
 void Connection::setPriority(Connection::Priority priority) {
     Connection::priority = priority;
     switch (priority) {
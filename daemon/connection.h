@@ -18,6 +18,7 @@
 
 #include "config.h"
 
+#include "buffer_pool.h"
 #include "datatype.h"
 #include "dynamic_buffer.h"
 #include "ssl_context.h"
@@ -30,8 +31,10 @@
 #include <cbsasl/server.h>
 #include <daemon/protocol/mcbp/command_context.h>
 #include <event.h>
+#include <mcbp/protocol/request.h>
 #include <mcbp/protocol/unsigned_leb128.h>
 #include <memcached/dcp.h>
+#include <memcached/engine.h>
 #include <memcached/openssl.h>
 #include <memcached/rbac.h>
 #include <nlohmann/json_fwd.hpp>
@@ -40,6 +43,7 @@
 
 #include <array>
 #include <chrono>
+#include <deque>
 #include <memory>
 #include <queue>
 #include <string>
@@ -152,6 +156,50 @@ public:
      */
     void signalIfIdle(bool logbusy, size_t workerthread);
 
+    /**
+     * Is the connection idle in a way which allows moving it to another
+     * worker thread: waiting for the next command with nothing buffered,
+     * no command in progress, and not reserved by an engine (which rules out
+     * DCP connections).
+     */
+    bool isMigratable();
+
+    /**
+     * Is the connection between commands with nothing buffered or in
+     * progress: waiting for the next command (or, for DCP, for the next
+     * message to ship), so it may be moved to another thread.
+     */
+    bool isIdleBetweenCommands();
+
+    /// Is the connection waiting to be moved to a DCP thread
+    bool isDcpThreadMovePending() const {
+        return dcpThreadMovePending;
+    }
+
+    void setDcpThreadMovePending(bool pending) {
+        dcpThreadMovePending = pending;
+    }
+
+    /// Is the connection waiting to be moved to a thread of its bucket's
+    /// thread group
+    bool isBucketThreadMovePending() const {
+        return bucketThreadMovePending;
+    }
+
+    void setBucketThreadMovePending(bool pending) {
+        bucketThreadMovePending = pending;
+    }
+
+    /**
+     * Move the connection to another worker thread. Must be called from the
+     * thread the connection is bound to, and only if isMigratable(). The
+     * connection is unregistered from this thread's event base; the new
+     * thread must call registerEvent() to resume serving it.
+     *
+     * @return true on success, otherwise the connection is left as it was
+     */
+    bool moveToThread(FrontEndThread& to);
+
     /**
      * Terminate the eventloop for the current event base. This method doesn't
      * really fit as a member for the class, but I don't want clients to access
@@ -353,6 +401,34 @@ public:
         Connection::allow_unordered_execution = allow_unordered_execution;
     }
 
+    /**
+     * Park the current cookie, which has blocked executing a reorderable
+     * command (with its packet preserved), and give the connection a new
+     * cookie to carry on with the next command.
+     *
+     * @return false if the maximum number of commands is already parked
+     */
+    bool parkCookie();
+
+    /**
+     * If one of the parked cookies has been notified, make it the current
+     * cookie again (replacing the idle current cookie) and move over to
+     * the execute state to complete its command.
+     *
+     * @return true if a cookie was resumed
+     */
+    bool resumeParkedCookie();
+
+    /**
+     * Does the next command in the input buffer have to wait for the
+     * parked commands to complete before it may be executed (as it may
+     * not be reordered with them)?
+     */
+    bool mustWaitForParkedCookies() const;
+
+    /// The maximum number of blocked commands parked on a connection
+    static const size_t MaxParkedCookies = 64;
+
     /**
      * Remap the current error code
      *
@@ -425,9 +501,8 @@ public:
         return dcp;
     }
 
-    void setDCP(bool dcp) {
-        Connection::dcp = dcp;
-    }
+    /// Also counts the connection in its thread's load.
+    void setDCP(bool dcp);
 
     bool isDcpXattrAware() const {
         return dcpXattrAware;
@@ -539,6 +614,26 @@ public:
      */
     int recv(char* dest, size_t nbytes);
 
+    /**
+     * Get the number of bytes to try to read from the socket next. The
+     * read size adapts to the size of the recent packets, so a single read
+     * brings in about a timeslice (max_reqs_per_event) worth of pipelined
+     * commands - and always at least the rest of the current packet.
+     */
+    size_t getReadSize() const;
+
+    /**
+     * Record the size of a packet read from the client (used to size the
+     * reads from the socket)
+     */
+    void recordPacketSize(size_t size) {
+        avgPacketSize = (avgPacketSize * 7 + size) / 8;
+    }
+
+    /// The bounds of the (adaptive) read size
+    static const size_t MinReadSize = 2048;
+    static const size_t MaxReadSize = 64 * 1024;
+
     /**
      * Send data over the socket
      *
@@ -623,6 +718,51 @@ public:
      */
     void addIov(const void* buf, size_t len);
 
+    /**
+     * Copy a (small) chunk of memory into the write buffer and add it to the
+     * IO vector to send, for data which doesn't outlive the command.
+     *
+     * @param buf pointer to the data to send
+     * @param len number of bytes to send
+     * @throws std::bad_alloc
+     */
+    void addIovCopy(const void* buf, size_t len);
+
+    /**
+     * Make sure there is room for (at least) size bytes in the write buffer.
+     * The data already in the buffer may be moved in the process, so the
+     * IO vector entries referring to it are updated accordingly.
+     *
+     * @throws std::bad_alloc
+     */
+    void ensureWriteCapacity(size_t size);
+
+    /**
+     * Mark the response just added to the IO vector as one which may be
+     * held back: it only refers to the write buffer, reserved items and
+     * temporary allocations, which all stay valid until it is sent.
+     */
+    void setResponseHoldable() {
+        holdableResponse = true;
+    }
+
+    /**
+     * Decide if the response just added to the IO vector should be held back
+     * and sent in the same sendmsg as the responses of the commands which
+     * follow it in the input buffer (see the coalesce_responses setting).
+     *
+     * @return true if the response is held back
+     */
+    bool holdResponse();
+
+    /// Are there responses held back which haven't been sent yet?
+    bool hasHeldResponses() const {
+        return heldResponses > 0;
+    }
+
+    /// The max number of bytes of responses to hold back
+    static const size_t MaxHeldResponseBytes = 64 * 1024;
+
     /**
      * Release all of the items we've saved a reference to
      */
@@ -643,17 +783,51 @@ public:
         }
     }
 
+    /**
+     * Record the result of a GET-family request which follows the request
+     * currently being executed in the input buffer, looked up ahead of time
+     * as part of a pipeline (see GetCommandContext).
+     */
+    void addPrefetchedGet(const cb::mcbp::Request& request,
+                          cb::EngineErrorItemPair result);
+
+    /**
+     * Take the prefetched result for the given request, if the oldest
+     * prefetched result is for it. Otherwise all prefetched results are
+     * discarded; they are only valid for an uninterrupted pipeline of GETs.
+     *
+     * @return the prefetched result, or engine_errc::would_block if there is
+     *         none for this request
+     */
+    cb::EngineErrorItemPair takePrefetchedGet(const cb::mcbp::Request& request);
+
+    /**
+     * Discard (and release the items of) all prefetched GET results.
+     */
+    void clearPrefetchedGets() {
+        prefetchedGets.clear();
+    }
+
     void releaseTempAlloc() {
         for (auto* ptr : temp_alloc) {
-            cb_free(ptr);
+            BufferPool::release(ptr);
         }
         temp_alloc.resize(0);
+        sharedBuffers.clear();
     }
 
     void pushTempAlloc(char* ptr) {
         temp_alloc.push_back(ptr);
     }
 
+    /**
+     * Keep a reference to a shared, immutable buffer the IO vector points
+     * into until the connection is done sending all of the data.
+     */
+    void pushSharedBuffer(std::shared_ptr<const std::string> buffer) {
+        sharedBuffers.push_back(std::move(buffer));
+    }
+
     /**
      * Enable the datatype which corresponds to the feature
      *
@@ -1099,6 +1273,9 @@ protected:
     /** Listening port that creates this connection instance */
     const in_port_t parent_port{0};
 
+    /** Is the connection on a Unix domain socket (no TCP options)? */
+    const bool unixDomain{false};
+
     /**
      * The index of the connected bucket
      */
@@ -1184,6 +1361,12 @@ protected:
     /** Is this DCP channel XAttrAware */
     bool dcpXattrAware = false;
 
+    /** Should the connection be moved to a DCP thread once idle? */
+    bool dcpThreadMovePending = false;
+
+    /** Should the connection be moved to its bucket's threads once idle? */
+    bool bucketThreadMovePending = false;
+
     /** Shuld values be stripped off? */
     bool dcpNoValue = false;
 
@@ -1196,6 +1379,9 @@ protected:
     /** The maximum requests we can process in a worker thread timeslice */
     int max_reqs_per_event;
 
+    /// Moving average of the size of the packets read from the client
+    size_t avgPacketSize = sizeof(cb::mcbp::Request);
+
     /**
      * number of events this connection can process in a single worker
      * thread timeslice
@@ -1235,20 +1421,53 @@ protected:
     /** number of bytes in current msg */
     size_t msgbytes = 0;
 
+    /** number of responses held back to be sent with the following ones */
+    size_t heldResponses = 0;
+    /** may the response being added to the IO vector be held back */
+    bool holdableResponse = false;
+
     /**
      * List of items we've reserved during the command (should call
      * item_release when transmit is complete)
      */
     std::vector<void*> reservedItems;
 
+    /**
+     * A GET-family request looked up ahead of time, and its result.
+     */
+    struct PrefetchedGet {
+        PrefetchedGet(const cb::mcbp::Request& request,
+                      cb::EngineErrorItemPair result);
+
+        /// @returns true if this is the result for the given request.
+        bool isFor(const cb::mcbp::Request& request) const;
+
+        const uint32_t opaque;
+        const Vbid vbucket;
+        const std::string key;
+        cb::EngineErrorItemPair result;
+    };
+
+    /**
+     * Results of the GET-family requests which follow the one currently
+     * being executed, in the order they appear in the input buffer.
+     */
+    std::deque<PrefetchedGet> prefetchedGets;
+
     /**
      * A vector of temporary allocations that should be freed when the
      * the connection is done sending all of the data. Use pushTempAlloc to
-     * push a pointer to this list (must be allocated with malloc/calloc/strdup
-     * etc.. will be freed by calling "free")
+     * push a pointer to this list (must be allocated from the BufferPool,
+     * will be released to it)
      */
     std::vector<char*> temp_alloc;
 
+    /**
+     * Shared buffers (such as the cluster configuration) sent directly from
+     * the IO vector, released along with the temporary allocations.
+     */
+    std::vector<std::shared_ptr<const std::string>> sharedBuffers;
+
     /**
      * If the client enabled the mutation seqno feature each mutation
      * command will return the vbucket UUID and sequence number for the
@@ -1261,18 +1480,23 @@ protected:
      */
     SslContext ssl;
 
+    /**
+     * Buffer used to gather small chunks of an IO vector into a single
+     * SSL_write (and hence a single TLS record)
+     */
+    std::vector<char> sslGatherBuffer;
+
     // Total number of bytes received on the network
     size_t totalRecv = 0;
     // Total number of bytes sent to the network
     size_t totalSend = 0;
 
     /**
-     * The list of commands currently being processed. Currently we
-     * only use a single entry in this vector (and always reuse that
-     * object for all commands), but when the client tries to
-     * enable unordered execution we may operate with multiple
-     * commands at the same time and they're all stored in this
-     * vector)
+     * The list of commands currently being processed. The first entry is
+     * the current command (reused for all commands). When the client
+     * enabled unordered execution the rest are the blocked reorderable
+     * commands parked while the connection carries on with the
+     * following ones.
      */
     std::vector<std::unique_ptr<Cookie>> cookies;
 
@@ -156,6 +156,7 @@ void run_event_loop(Connection* c, short which) {
     auto* thread = c->getThread();
     if (thread != nullptr) {
         scheduler_info[thread->index].add(ns);
+        thread->load.cpu_time += ns.count();
     }
 
     if (c->shouldDelete()) {
@@ -199,6 +200,8 @@ Connection* conn_new(const SOCKET sfd,
     }
 
     c->setThread(thread);
+    // Connected to the default bucket, which may belong to other threads
+    request_bucket_thread(*c);
 
     if (settings.getVerbose() > 1) {
         LOG_DEBUG("<{} new client connection", sfd);
@@ -318,6 +321,14 @@ static void release_connection(Connection* c) {
         connections.conns.erase(iter);
     }
 
+    auto* thread = c->getThread();
+    if (thread != nullptr) {
+        thread->load.connections--;
+        if (c->isDCP()) {
+            thread->load.dcp_connections--;
+        }
+    }
+
     // Finally free it
     conn_destructor(c);
 }
@@ -222,14 +222,16 @@ void Cookie::sendDynamicBuffer() {
         connection.setState(StateMachine::State::send_data);
         connection.setWriteAndGo(StateMachine::State::new_cmd);
         connection.pushTempAlloc(dynamicBuffer.getRoot());
+        connection.setResponseHoldable();
         dynamicBuffer.takeOwnership();
     }
 }
 
 void Cookie::sendNotMyVBucket() {
-    auto pair = connection.getBucket().clusterConfiguration.getConfiguration();
-    if (pair.first == -1 || (pair.first == connection.getClustermapRevno() &&
-                             settings.isDedupeNmvbMaps())) {
+    const auto& config = connection.getBucket().clusterConfiguration;
+    auto revision = config.getRevision();
+    if (revision == -1 || (revision == connection.getClustermapRevno() &&
+                           settings.isDedupeNmvbMaps())) {
         // We don't have a vbucket map, or we've already sent it to the
         // client
         mcbp_add_header(*this,
@@ -240,30 +242,37 @@ void Cookie::sendNotMyVBucket() {
                         PROTOCOL_BINARY_RAW_BYTES);
         connection.setState(StateMachine::State::send_data);
         connection.setWriteAndGo(StateMachine::State::new_cmd);
+        connection.setResponseHoldable();
         return;
     }
 
-    const size_t needed = sizeof(cb::mcbp::Response) + pair.second->size();
-    if (!growDynamicBuffer(needed)) {
-        throw std::bad_alloc();
-    }
-    auto& buffer = getDynamicBuffer();
-    auto* buf = reinterpret_cast<uint8_t*>(buffer.getCurrent());
-    const auto& header = getHeader();
-    cb::mcbp::ResponseBuilder builder({buf, needed});
-    builder.setMagic(cb::mcbp::Magic::ClientResponse);
-    builder.setOpcode(header.getRequest().getClientOpcode());
-    builder.setStatus(cb::mcbp::Status::NotMyVbucket);
-    builder.setOpaque(header.getOpaque());
-    builder.setValue({reinterpret_cast<const uint8_t*>(pair.second->data()),
-                      pair.second->size()});
-    builder.validate();
-
-    buffer.moveOffset(needed);
-    sendDynamicBuffer();
+    auto pair = config.getConfiguration();
+    sendClusterConfig(cb::mcbp::Status::NotMyVbucket,
+                      std::move(pair.second),
+                      cb::mcbp::Datatype::Raw);
     connection.setClustermapRevno(pair.first);
 }
 
+void Cookie::sendClusterConfig(cb::mcbp::Status status,
+                               std::shared_ptr<const std::string> config,
+                               cb::mcbp::Datatype datatype) {
+    // Only the header is written to the connection's buffer; the config
+    // is sent straight from the shared copy
+    mcbp_add_header(*this,
+                    status,
+                    0,
+                    0,
+                    uint32_t(config->size()),
+                    connection.getEnabledDatatypes(
+                            protocol_binary_datatype_t(datatype)));
+    connection.addIov(config->data(), config->size());
+    connection.pushSharedBuffer(std::move(config));
+
+    connection.setState(StateMachine::State::send_data);
+    connection.setWriteAndGo(StateMachine::State::new_cmd);
+    connection.setResponseHoldable();
+}
+
 void Cookie::sendResponse(cb::mcbp::Status status) {
     if (status == cb::mcbp::Status::Success) {
         const auto& request = getHeader().getRequest();
@@ -281,6 +290,7 @@ void Cookie::sendResponse(cb::mcbp::Status status) {
         mcbp_add_header(*this, status, 0, 0, 0, PROTOCOL_BINARY_RAW_BYTES);
         connection.setState(StateMachine::State::send_data);
         connection.setWriteAndGo(StateMachine::State::new_cmd);
+        connection.setResponseHoldable();
         return;
     }
 
@@ -303,7 +313,7 @@ void Cookie::sendResponse(cb::mcbp::Status status,
                           cb::const_char_buffer value,
                           cb::mcbp::Datatype datatype,
                           uint64_t cas) {
-    if (!connection.write->empty()) {
+    if (!connection.write->empty() && !connection.hasHeldResponses()) {
         // We can't continue as we might already have references
         // in the IOvector stack pointing into the existing buffer!
         throw std::logic_error(
@@ -336,10 +346,10 @@ void Cookie::sendResponse(cb::mcbp::Status status,
 
     size_t needed = sizeof(cb::mcbp::Header) + value.size() + key.size() +
                     extras.size();
-    if (isTracingEnabled()) {
+    if (isServerDurationEnabled()) {
         needed += MCBP_TRACING_RESPONSE_SIZE;
     }
-    connection.write->ensureCapacity(needed);
+    connection.ensureWriteCapacity(needed);
 
     mcbp_add_header(*this,
                     status,
@@ -372,10 +382,18 @@ void Cookie::sendResponse(cb::mcbp::Status status,
 
     connection.setState(StateMachine::State::send_data);
     connection.setWriteAndGo(StateMachine::State::new_cmd);
+    connection.setResponseHoldable();
 }
 
 const DocKey Cookie::getRequestKey() const {
-    return connection.makeDocKey(getRequest().getKey());
+    const auto key = getRequest().getKey();
+    if (requestKeyPrefixLen != 0) {
+        return DocKey{key.data(),
+                      key.size(),
+                      requestKeyCollectionID,
+                      requestKeyPrefixLen};
+    }
+    return connection.makeDocKey(key);
 }
 
 std::string Cookie::getPrintableRequestKey() const {
@@ -493,7 +511,9 @@ Cookie::Cookie(Connection& conn) : connection(conn) {
 
 void Cookie::initialize(cb::const_byte_buffer header, bool tracing_enabled) {
     reset();
-    enableTracing = tracing_enabled;
+    serverDuration = tracing_enabled;
+    // The spans are also recorded for the trace sampler
+    enableTracing = tracing_enabled || settings.getTraceSampleRate() != 0;
     setPacket(Cookie::PacketContent::Header, header);
     setCas(0);
     start = std::chrono::steady_clock::now();
@@ -506,9 +526,17 @@ void Cookie::reset() {
     error_context.clear();
     json_message.clear();
     packet = {};
+    received_packet.reset();
     cas = 0;
     commandContext.reset();
+    streamedItem.reset();
+    streamedValue = {};
+    streamedValueReceived = 0;
+    valueStreamingFailed = false;
     dynamicBuffer.clear();
     tracer.clear();
     ewouldblock = false;
+    topkeysUpdate = false;
+    topkeysBytes = 0;
+    requestKeyPrefixLen = 0;
 }
@@ -22,6 +22,7 @@
 #include <mcbp/protocol/datatype.h>
 #include <mcbp/protocol/status.h>
 #include <memcached/dockey.h>
+#include <memcached/engine.h>
 #include <memcached/engine_error.h>
 #include <nlohmann/json_fwd.hpp>
 #include <platform/sized_buffer.h>
@@ -232,6 +233,76 @@ public:
         setPacket(PacketContent::Full, getPacket(), true);
     }
 
+    /**
+     * Is the current packet a copy owned by the cookie (see
+     * preserveRequest()), rather than a reference into the input buffer?
+     */
+    bool isPacketPreserved() const {
+        return received_packet && packet.data() == received_packet.get();
+    }
+
+    /**
+     * Receive the value of the request straight into an item allocated in
+     * the engine, rather than buffering it with the rest of the packet.
+     * The cookie's packet is then the request without its value.
+     *
+     * @param item the item the value is read into
+     * @param value the item's value
+     * @param received the number of bytes of the value already copied in
+     */
+    void setStreamedValue(cb::unique_item_ptr item,
+                          cb::byte_buffer value,
+                          size_t received) {
+        streamedItem = std::move(item);
+        streamedValue = value;
+        streamedValueReceived = received;
+    }
+
+    /// Does the request have its value in an item (see setStreamedValue)?
+    bool hasStreamedValue() const {
+        return bool(streamedItem);
+    }
+
+    /// Get the part of the streamed value which is yet to be received
+    cb::byte_buffer getStreamedValueRemaining() const {
+        return {streamedValue.data() + streamedValueReceived,
+                streamedValue.size() - streamedValueReceived};
+    }
+
+    /**
+     * Record that another part of the streamed value was received
+     *
+     * @return true if the value is now complete
+     */
+    bool addStreamedValueReceived(size_t nbytes) {
+        streamedValueReceived += nbytes;
+        return streamedValueReceived == streamedValue.size();
+    }
+
+    /// Get the streamed value (the item keeps ownership of the memory)
+    cb::const_byte_buffer getStreamedValue() const {
+        return {streamedValue.data(), streamedValue.size()};
+    }
+
+    /// Take ownership of the item holding the streamed value
+    cb::unique_item_ptr takeStreamedItem() {
+        streamedValue = {};
+        streamedValueReceived = 0;
+        return std::move(streamedItem);
+    }
+
+    /**
+     * Record that the value of the current request couldn't be streamed, so
+     * the whole packet is to be buffered.
+     */
+    void setValueStreamingFailed() {
+        valueStreamingFailed = true;
+    }
+
+    bool isValueStreamingFailed() const {
+        return valueStreamingFailed;
+    }
+
     /**
      * Get the packet header for the current packet. The packet header
      * allows for getting the various common fields in a packet (request and
@@ -263,6 +334,19 @@ public:
      */
     const DocKey getRequestKey() const;
 
+    /**
+     * Remember the collection-ID encoded in the request's key, decoded when
+     * the key was validated, so the DocKeys getRequestKey() creates for the
+     * request (and the engine) don't decode it again.
+     *
+     * @param cid The collection-ID
+     * @param prefixLen The length of its leb128 encoding
+     */
+    void setRequestKeyCollectionID(CollectionIDType cid, uint8_t prefixLen) {
+        requestKeyCollectionID = cid;
+        requestKeyPrefixLen = prefixLen;
+    }
+
     /**
      * Get a printable key from the header. Replace all non-printable
      * charachters with '.'
@@ -353,6 +437,19 @@ public:
      */
     void sendNotMyVBucket();
 
+    /**
+     * Send a response carrying the cluster configuration as its value.
+     * The configuration isn't copied: the connection keeps a reference to
+     * it until the response is sent.
+     *
+     * @param status The status code for the response
+     * @param config The configuration to send
+     * @param datatype The datatype to add to the message
+     */
+    void sendClusterConfig(cb::mcbp::Status status,
+                           std::shared_ptr<const std::string> config,
+                           cb::mcbp::Datatype datatype);
+
     /**
      * Send a response without a message payload back to the client.
      *
@@ -445,10 +542,38 @@ public:
         enableTracing = enable;
     }
 
+    /**
+     * Should the server duration be returned in the response (the client
+     * enabled tracing). The spans may be recorded (isTracingEnabled())
+     * without it, for the trace sampler.
+     */
+    bool isServerDurationEnabled() const {
+        return serverDuration;
+    }
+
     cb::tracing::Tracer& getTracer() {
         return tracer;
     }
 
+    /**
+     * Record an access of the request key in the bucket's topkeys when the
+     * command completes (so its latency is known); see update_topkeys().
+     *
+     * @param bytes the number of bytes of the document read or written
+     */
+    void setTopkeysUpdate(size_t bytes) {
+        topkeysUpdate = true;
+        topkeysBytes = bytes;
+    }
+
+    bool isTopkeysUpdate() const {
+        return topkeysUpdate;
+    }
+
+    size_t getTopkeysBytes() const {
+        return topkeysBytes;
+    }
+
     uint8_t getRefcount() {
         return refcount;
     }
@@ -471,6 +596,9 @@ protected:
     bool enableTracing = false;
     cb::tracing::Tracer tracer;
 
+    /// Return the server duration in the response
+    bool serverDuration = false;
+
     /**
      * The connection object this cookie is bound to
      */
@@ -495,6 +623,15 @@ protected:
      */
     std::unique_ptr<uint8_t[]> received_packet;
 
+    /// The item the value of the request is received into (see
+    /// setStreamedValue), its value and how much of it has arrived
+    cb::unique_item_ptr streamedItem;
+    cb::byte_buffer streamedValue;
+    size_t streamedValueReceived = 0;
+
+    /// Set if the value couldn't be streamed, and the packet is buffered
+    bool valueStreamingFailed = false;
+
     /**
      * The dynamic buffer is used to format output packets to be sent on
      * the wire.
@@ -504,6 +641,15 @@ protected:
     /** The cas to return back to the client */
     uint64_t cas = 0;
 
+    /// Update the topkeys when the command completes (see setTopkeysUpdate)
+    bool topkeysUpdate = false;
+    size_t topkeysBytes = 0;
+
+    /// The collection-ID prefix of the request's key if already decoded
+    /// (see setRequestKeyCollectionID); requestKeyPrefixLen is 0 if not.
+    CollectionIDType requestKeyCollectionID = 0;
+    uint8_t requestKeyPrefixLen = 0;
+
     /**
      * The high resolution timer value for when we started executing the
      * current command.
@@ -17,7 +17,10 @@
 #include "config.h"
 #include "dynamic_buffer.h"
 
-#include <platform/cb_malloc.h>
+#include "buffer_pool.h"
+
+#include <platform/platform.h>
+#include <algorithm>
 
 bool DynamicBuffer::grow(size_t needed) {
     size_t nsize = size;
@@ -37,8 +40,12 @@ bool DynamicBuffer::grow(size_t needed) {
     }
 
     if (nsize != size) {
-        char* ptr = reinterpret_cast<char*>(cb_realloc(buffer, nsize));
+        char* ptr = BufferPool::allocate(nsize);
         if (ptr) {
+            if (buffer) {
+                std::copy(buffer, buffer + offset, ptr);
+                BufferPool::release(buffer);
+            }
             buffer = ptr;
             size = nsize;
         } else {
@@ -50,7 +57,7 @@ bool DynamicBuffer::grow(size_t needed) {
 }
 
 void DynamicBuffer::clear() {
-    cb_free(buffer);
+    BufferPool::release(buffer);
     buffer = nullptr;
     size = 0;
     offset = 0;
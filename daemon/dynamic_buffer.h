@@ -85,7 +85,7 @@ public:
 
     /**
      * Transfer the ownership of the underlying buffer. The caller is
-     * responsible for freeing the underlying data
+     * responsible for releasing the underlying data (BufferPool::release)
      */
     void takeOwnership() {
         buffer = nullptr;
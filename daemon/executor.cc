@@ -40,7 +40,7 @@ void Executor::run() {
 
     while (true) {
         std::unique_lock<std::mutex> lock(mutex);
-        while (!shutdown && runq.empty()) {
+        while (!shutdown && runqEmpty()) {
             idlecond.wait(lock);
         }
 
@@ -48,8 +48,7 @@ void Executor::run() {
             break;
         }
 
-        auto task = runq.front();
-        runq.pop();
+        auto task = popRunnable();
 
         // Release the lock so that others may schedule new events
         lock.unlock();
@@ -103,7 +102,7 @@ void Executor::schedule(const std::shared_ptr<Task>& task, bool runnable) {
     task->setExecutor(this);
 
     if (runnable) {
-        runq.push(task);
+        pushRunnable(task);
         idlecond.notify_all();
     } else {
         waitq[task.get()] = task;
@@ -122,7 +121,7 @@ void Executor::makeRunnable(Task* task) {
     if (iter == waitq.end()) {
         throw std::runtime_error("Internal error object is not in the waitq");
     }
-    runq.push(iter->second);
+    pushRunnable(iter->second);
     waitq.erase(iter);
     idlecond.notify_all();
 }
@@ -166,6 +165,50 @@ void Executor::clockTick() {
     }
 }
 
+int Executor::getLaneWeight(Task::Priority priority) {
+    switch (priority) {
+    case Task::Priority::High:
+        return 4;
+    case Task::Priority::Normal:
+        return 2;
+    case Task::Priority::Low:
+        return 1;
+    }
+    throw std::invalid_argument("Executor::getLaneWeight: invalid priority");
+}
+
+void Executor::pushRunnable(std::shared_ptr<Task> task) {
+    const auto lane = static_cast<size_t>(task->getPriority());
+    runq.at(lane).push(std::move(task));
+}
+
+std::shared_ptr<Task> Executor::popRunnable() {
+    while (true) {
+        for (size_t lane = 0; lane < runq.size(); ++lane) {
+            if (!runq[lane].empty() && credits[lane] > 0) {
+                --credits[lane];
+                auto task = std::move(runq[lane].front());
+                runq[lane].pop();
+                return task;
+            }
+        }
+
+        // Every lane with runnable tasks has used its share; next round.
+        for (size_t lane = 0; lane < credits.size(); ++lane) {
+            credits[lane] = getLaneWeight(static_cast<Task::Priority>(lane));
+        }
+    }
+}
+
+bool Executor::runqEmpty() const {
+    for (const auto& lane : runq) {
+        if (!lane.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 size_t Executor::waitqSize() const {
     std::lock_guard<std::mutex> guard(mutex);
     return waitq.size();
@@ -173,7 +216,11 @@ size_t Executor::waitqSize() const {
 
 size_t Executor::runqSize() const {
     std::lock_guard<std::mutex> guard(mutex);
-    return runq.size();
+    size_t count = 0;
+    for (const auto& lane : runq) {
+        count += lane.size();
+    }
+    return count;
 }
 
 size_t Executor::futureqSize() const {
@@ -16,21 +16,19 @@
  */
 #pragma once
 
+#include "task.h"
+
 #include <platform/platform.h>
 #include <platform/processclock.h>
 #include <platform/thread.h>
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <queue>
 #include <unordered_map>
 
-/**
- * Forward decl of the Task to avoid circular dependencies
- */
-class Task;
-
 /**
  * The Executor class represents a single executor thread. It keeps
  * working on items in the runq and whenever a request can't be completed
@@ -38,6 +36,12 @@ class Task;
  * makeRunnable (NOTE: you should hold the command's lock when calling that),
  * and it is NOT allowed to call it from any of the executors threads (that
  * may create deadlock)
+ *
+ * The runq has a lane per Task::Priority, served by weighted round robin:
+ * each lane may run up to getLaneWeight() tasks per round, and the round
+ * ends (and starts over) once no lane with runnable tasks has any left.
+ * With all lanes busy the high lane gets 4/7 of the executions and the low
+ * lane 1/7, so e.g. a storm of authentication tasks can't hold up stats.
  */
 class Executor : public Couchbase::Thread {
 public:
@@ -84,9 +88,30 @@ public:
 
     size_t futureqSize() const;
 
+    /**
+     * @return the number of tasks of a lane the executor runs per round
+     */
+    static int getLaneWeight(Task::Priority priority);
+
 protected:
     void run() override;
 
+    /**
+     * Put the task at the back of the lane of its priority. Must hold mutex.
+     */
+    void pushRunnable(std::shared_ptr<Task> task);
+
+    /**
+     * Take the next task to run. Must hold mutex, and the runq must not be
+     * empty.
+     */
+    std::shared_ptr<Task> popRunnable();
+
+    /**
+     * Are there no runnable tasks? Must hold mutex.
+     */
+    bool runqEmpty() const;
+
     /**
      * Is shutdown requested?
      */
@@ -105,9 +130,14 @@ protected:
     mutable std::mutex mutex;
 
     /**
-     * The FIFO queue of commands ready to run
+     * The FIFO queues (one per priority) of commands ready to run
+     */
+    std::array<std::queue<std::shared_ptr<Task> >, Task::NumPriorities> runq;
+
+    /**
+     * The number of tasks each lane may still run in the current round
      */
-    std::queue<std::shared_ptr<Task> > runq;
+    std::array<int, Task::NumPriorities> credits{};
 
     /**
      * When a task is being served by a backend thread it is put in
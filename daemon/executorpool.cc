@@ -43,6 +43,24 @@ void ExecutorPool::schedule(std::shared_ptr<Task>& task, bool runnable) {
             "The mutex should be held when trying to schedule a event");
     }
 
+    if (runnable && task->getPriority() == Task::Priority::High) {
+        // Don't queue behind another executor's backlog when one is free
+        auto* executor = executors.front().get();
+        auto shortest = executor->runqSize();
+        for (const auto& candidate : executors) {
+            if (shortest == 0) {
+                break;
+            }
+            const auto size = candidate->runqSize();
+            if (size < shortest) {
+                executor = candidate.get();
+                shortest = size;
+            }
+        }
+        executor->schedule(task, runnable);
+        return;
+    }
+
     executors[++roundRobin % executors.size()]->schedule(task, runnable);
 }
 
@@ -30,7 +30,8 @@ class Task;
 /**
  * As the name implies the ExecutorPool is pool of executors to execute
  * tasks. A task is pinned to a thread when it is being scheduled
- * (by using round robin) and never switch the thread.
+ * (by using round robin, except that runnable high priority tasks go to the
+ * executor with the fewest runnable tasks) and never switch the thread.
  */
 class ExecutorPool {
 public:
@@ -17,14 +17,20 @@
 
 #pragma once
 
+#include "subdoc_path_cache.h"
+#include "trace_sampler.h"
+
 #include <JSON_checker.h>
 #include <event.h>
 #include <memcached/engine_error.h>
 #include <platform/socket.h>
 #include <subdoc/operations.h>
+#include <utilities/json_validator.h>
+#include <atomic>
 #include <mutex>
 #include <queue>
 #include <unordered_map>
+#include <vector>
 
 // Forward decl
 namespace cb {
@@ -117,6 +123,12 @@ struct FrontEndThread {
      */
     Subdoc::Operation subdoc_op;
 
+    /**
+     * Locations of recently looked up paths in hot documents, shared by all
+     * connections serviced by this thread
+     */
+    SubdocPathCache subdoc_path_cache;
+
     /**
      * When we're deleting buckets we need to disconnect idle
      * clients. This variable is incremented for every delete bucket
@@ -132,12 +144,80 @@ struct FrontEndThread {
      * Shared validator used by all connections serviced by this thread
      * when they need to validate a JSON document
      */
-    JSON_checker::Validator validator;
+    cb::json::Validator validator;
+
+    /// The traces of the slow (and a sample of the other) requests served
+    /// by this thread
+    TraceSampler trace_sampler;
 
     /// Is the thread running or not
     std::atomic_bool running{false};
+
+    /// Is this one of the threads dedicated to DCP connections
+    bool dcp = false;
+
+    /// Set when connections of this thread are waiting to be moved to a
+    /// DCP thread (only used by the thread itself)
+    bool dcp_move_pending = false;
+
+    /// Set when connections of this thread are waiting to be moved to the
+    /// thread group of their bucket (see request_bucket_thread())
+    std::atomic_bool bucket_move_pending{false};
+
+    /**
+     * The load of the thread, used by dispatch_conn_new() to pick the thread
+     * for a new connection.
+     */
+    struct {
+        /// Connections bound to (or queued for) the thread
+        std::atomic<size_t> connections{0};
+        /// Of those, the DCP connections
+        std::atomic<size_t> dcp_connections{0};
+        /// Total time (in ns) spent running the connections' event loops
+        std::atomic<uint64_t> cpu_time{0};
+    } load;
+
+    /// The number of idle connections to hand over to other threads
+    /// (set by rebalance_connections()).
+    std::atomic<size_t> migrate_out{0};
+
+    /// Connections handed over by other threads, to be registered with
+    /// this thread's event base.
+    struct {
+        std::mutex mutex;
+        std::vector<Connection*> conns;
+    } migrated;
 };
 
 void notify_thread(FrontEndThread& thread);
 void notify_dispatcher();
 void notify_thread_bucket_deletion(FrontEndThread& me);
+
+/// @returns the front-end thread with the given index (0..nthreads-1 are
+/// the worker threads, followed by the DCP threads)
+FrontEndThread& get_worker_thread(size_t index);
+
+/**
+ * Serve a new connection on the given thread. Unlike dispatch_conn_new()
+ * this must be called on the thread itself (from one of its own listening
+ * sockets), so the connection is registered with its event base directly.
+ */
+void dispatch_conn_local(FrontEndThread& thread,
+                         SOCKET sfd,
+                         in_port_t parent_port);
+
+/**
+ * Move a connection which just opened a DCP stream to one of the threads
+ * dedicated to DCP (if there are any). Must be called on the thread the
+ * connection is bound to; the move happens once the connection is idle
+ * between commands.
+ */
+void request_dcp_thread(Connection& c);
+
+/**
+ * Move a connection which just selected a bucket to a thread of the
+ * bucket's worker thread group (if the worker threads are grouped, and it's
+ * not on one already). The move happens once the connection is idle between
+ * commands.
+ */
+void request_bucket_thread(Connection& c);
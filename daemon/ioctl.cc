@@ -23,10 +23,16 @@
 #include "connection.h"
 #include "connections.h"
 #include "cookie.h"
+#include "front_end_thread.h"
+#include "memcached.h"
+#include "settings.h"
 #include "tracing.h"
 #include "utilities/string_utilities.h"
 #include <logger/logger.h>
 #include <mcbp/mcbp.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
 
 /*
  * Implement ioctl-style memcached commands (ioctl_get / ioctl_set).
@@ -58,6 +64,15 @@ static ENGINE_ERROR_CODE setReleaseFreeMemory(Cookie& cookie,
     return ENGINE_SUCCESS;
 }
 
+static ENGINE_ERROR_CODE setRebalanceConnections(Cookie& cookie,
+                                                 const StrToStrMap&,
+                                                 const std::string& value) {
+    rebalance_connections();
+    auto& c = cookie.getConnection();
+    LOG_INFO("{}: IOCTL_SET: connections.rebalance called", c.getId());
+    return ENGINE_SUCCESS;
+}
+
 static ENGINE_ERROR_CODE setJemallocProfActive(Cookie& cookie,
                                                const StrToStrMap&,
                                                const std::string& value) {
@@ -138,11 +153,42 @@ ENGINE_ERROR_CODE ioctlRbacDbDump(Cookie& cookie,
     return ENGINE_SUCCESS;
 }
 
+/**
+ * Get the traces kept by the trace samplers of all the front end threads,
+ * as a JSON array ordered by the start of the requests.
+ */
+ENGINE_ERROR_CODE ioctlGetTraceSamples(Cookie& cookie,
+                                       const StrToStrMap& arguments,
+                                       std::string& value) {
+    if (!arguments.empty() || !value.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    std::vector<TraceSampler::Sample> samples;
+    for (size_t ii = 0; ii < settings.getNumFrontEndThreads(); ++ii) {
+        const auto thread = get_worker_thread(ii).trace_sampler.getSamples();
+        samples.insert(samples.end(), thread.begin(), thread.end());
+    }
+    std::sort(samples.begin(),
+              samples.end(),
+              [](const TraceSampler::Sample& a, const TraceSampler::Sample& b) {
+                  return a.start < b.start;
+              });
+
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& sample : samples) {
+        json.push_back(TraceSampler::to_json(sample));
+    }
+    value = json.dump();
+    return ENGINE_SUCCESS;
+}
+
 static const std::unordered_map<std::string, GetCallbackFunc> ioctl_get_map{
         {"trace.config", ioctlGetTracingConfig},
         {"trace.status", ioctlGetTracingStatus},
         {"trace.dump.begin", ioctlGetTracingBeginDump},
         {"trace.dump.chunk", ioctlGetTracingDumpChunk},
+        {"trace.samples", ioctlGetTraceSamples},
         {"sla", ioctlGetMcbpSla},
         {"rbac.db.dump", ioctlRbacDbDump}};
 
@@ -188,6 +234,7 @@ static const std::unordered_map<std::string, SetCallbackFunc> ioctl_set_map{
         {"jemalloc.prof.active", setJemallocProfActive},
         {"jemalloc.prof.dump", setJemallocProfDump},
         {"release_free_memory", setReleaseFreeMemory},
+        {"connections.rebalance", setRebalanceConnections},
         {"trace.config", ioctlSetTracingConfig},
         {"trace.start", ioctlSetTracingStart},
         {"trace.stop", ioctlSetTracingStop},
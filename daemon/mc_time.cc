@@ -259,6 +259,7 @@ void mc_time_clock_tick(void) {
 static void mc_gather_timing_samples(void) {
     bucketsForEach([](Bucket& bucket, void *) -> bool {
         bucket.timings.sample(std::chrono::seconds(1));
+        bucket.vbucketLoad.sample();
         return true;
     }, nullptr);
 }
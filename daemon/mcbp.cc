@@ -50,7 +50,7 @@ static cb::const_byte_buffer mcbp_add_header(Cookie& cookie,
     header->response.setOpaque(opaque);
     header->response.setCas(cas);
 
-    if (cookie.isTracingEnabled()) {
+    if (cookie.isServerDurationEnabled()) {
         // When tracing is enabled we'll be using the alternative
         // response header where we inject the framing header.
         // For now we'll just hard-code the adding of the bytes
@@ -99,6 +99,8 @@ void mcbp_add_header(Cookie& cookie,
                      uint8_t datatype) {
     auto& connection = cookie.getConnection();
     connection.addMsgHdr(true);
+    connection.ensureWriteCapacity(sizeof(cb::mcbp::Response) +
+                                   MCBP_TRACING_RESPONSE_SIZE);
     const auto& header = cookie.getHeader();
 
     const auto wbuf = mcbp_add_header(cookie,
@@ -258,7 +260,8 @@ void mcbp_collect_timings(Cookie& cookie) {
     cookie.getTracer().end(cb::tracing::TraceCode::REQUEST, endTime);
 
     // aggregated timing for all buckets
-    all_buckets[0].timings.collect(opcode, elapsed);
+    const auto thread = c->getThread()->index;
+    all_buckets[0].timings.collect(thread, opcode, elapsed);
 
     // timing for current bucket
     const auto bucketid = c->getBucketIndex();
@@ -267,9 +270,29 @@ void mcbp_collect_timings(Cookie& cookie) {
      * to delete the bucket you're associated with and your're idle.
      */
     if (bucketid != 0) {
-        all_buckets[bucketid].timings.collect(opcode, elapsed);
+        all_buckets[bucketid].timings.collect(thread, opcode, elapsed);
+        all_buckets[bucketid].vbucketLoad.record(
+                thread,
+                opcode,
+                header.getRequest().getVBucket(),
+                cookie.isTopkeysUpdate() ? cookie.getTopkeysBytes() : 0);
+    }
+
+    // Record the access of the key (see update_topkeys)
+    auto* topkeys = all_buckets[bucketid].topkeys;
+    if (cookie.isTopkeysUpdate() && topkeys != nullptr) {
+        const auto key = cookie.getRequestKey();
+        topkeys->updateKey(thread,
+                           key.data(),
+                           key.size(),
+                           cookie.getTopkeysBytes(),
+                           elapsed,
+                           mc_time_get_current_time());
     }
 
     // Log operations taking longer than the "slow" threshold for the opcode.
     cookie.maybeLogSlowCommand(elapsed);
+
+    // Keep the trace of the slow operations (and a sample of the others)
+    c->getThread()->trace_sampler.record(cookie, elapsed);
 }
@@ -57,6 +57,7 @@
 #include <mcbp/protocol/header.h>
 #include <nlohmann/json.hpp>
 #include <platform/string_hex.h>
+#include <gsl/gsl>
 
 std::array<bool, 0x100>&  topkey_commands = get_mcbp_topkeys();
 
@@ -64,15 +65,11 @@ std::array<bool, 0x100>&  topkey_commands = get_mcbp_topkeys();
  * Triggers topkeys_update (i.e., increments topkeys stats) if called by a
  * valid operation.
  */
-void update_topkeys(const Cookie& cookie) {
+void update_topkeys(Cookie& cookie, size_t bytes) {
     const auto opcode = cookie.getHeader().getOpcode();
     if (topkey_commands[opcode]) {
-        const auto index = cookie.getConnection().getBucketIndex();
-        const auto key = cookie.getRequestKey();
-        if (all_buckets[index].topkeys != nullptr) {
-            all_buckets[index].topkeys->updateKey(
-                    key.data(), key.size(), mc_time_get_current_time());
-        }
+        // Recorded by mcbp_collect_timings(), with the command's latency
+        cookie.setTopkeysUpdate(bytes);
     }
 }
 
@@ -104,7 +101,7 @@ static void gat_executor(Cookie& cookie) {
  *
  * When called the entire packet is available.
  */
-using HandlerFunction = std::function<void(Cookie&)>;
+using HandlerFunction = void (*)(Cookie&);
 
 /**
  * A map between the request packets op-code and the function to handle
@@ -596,13 +593,13 @@ static void process_bin_dcp_response(Cookie& cookie) {
 static void setup_response_handler(cb::mcbp::ClientOpcode opcode,
                                    HandlerFunction function) {
     response_handlers[std::underlying_type<cb::mcbp::ClientOpcode>::type(
-            opcode)] = std::move(function);
+            opcode)] = function;
 }
 
 static void setup_handler(cb::mcbp::ClientOpcode opcode,
                           HandlerFunction function) {
     handlers[std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)] =
-            std::move(function);
+            function;
 }
 
 void initialize_mbcp_lookup_map() {
@@ -800,6 +797,44 @@ void initialize_mbcp_lookup_map() {
                   adjust_timeofday_executor);
 }
 
+/**
+ * Call the handler for the request. The most frequent commands are
+ * dispatched directly so their executors may be inlined here, the rest go
+ * through the handlers table.
+ */
+static inline void dispatch_client_request(cb::mcbp::ClientOpcode opcode,
+                                           Cookie& cookie) {
+    switch (opcode) {
+    case cb::mcbp::ClientOpcode::Get:
+    case cb::mcbp::ClientOpcode::Getq:
+    case cb::mcbp::ClientOpcode::Getk:
+    case cb::mcbp::ClientOpcode::Getkq:
+        get_executor(cookie);
+        return;
+    case cb::mcbp::ClientOpcode::Set:
+    case cb::mcbp::ClientOpcode::Setq:
+        set_executor(cookie);
+        return;
+    case cb::mcbp::ClientOpcode::Add:
+    case cb::mcbp::ClientOpcode::Addq:
+        add_executor(cookie);
+        return;
+    case cb::mcbp::ClientOpcode::Replace:
+    case cb::mcbp::ClientOpcode::Replaceq:
+        replace_executor(cookie);
+        return;
+    case cb::mcbp::ClientOpcode::Delete:
+    case cb::mcbp::ClientOpcode::Deleteq:
+        delete_executor(cookie);
+        return;
+    default:
+        break;
+    }
+
+    handlers[std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)](
+            cookie);
+}
+
 void execute_client_request_packet(Cookie& cookie,
                                    const cb::mcbp::Request& request) {
     auto* c = &cookie.getConnection();
@@ -823,8 +858,7 @@ void execute_client_request_packet(Cookie& cookie,
         }
         return;
     case cb::rbac::PrivilegeAccess::Ok:
-        handlers[std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)](
-                cookie);
+        dispatch_client_request(opcode, cookie);
         return;
     case cb::rbac::PrivilegeAccess::Stale:
         if (c->remapErrorCode(ENGINE_AUTH_STALE) == ENGINE_DISCONNECT) {
@@ -1020,6 +1054,141 @@ void try_read_mcbp_command(Cookie& cookie) {
         }
     }
 
+    prepare_mcbp_packet_body(cookie);
+}
+
+/**
+ * Get the size of the request up to its value if the value is to be read
+ * straight into an item allocated in the engine (see start_value_stream),
+ * or 0 if the whole packet is to be buffered.
+ *
+ * Only the values of Add, Set and Replace of at least the configured
+ * streamed_value_threshold are streamed, as these go into an item of the
+ * same size as the value unless the document has XATTRs to preserve.
+ */
+static size_t get_streamed_value_offset(Cookie& cookie) {
+    const auto threshold = settings.getStreamedValueThreshold();
+    const auto& header = cookie.getHeader();
+    if (threshold == 0 || !header.isRequest() ||
+        cookie.isValueStreamingFailed()) {
+        return 0;
+    }
+
+    const auto& request = header.getRequest();
+    if (!cb::mcbp::is_client_magic(request.getMagic())) {
+        return 0;
+    }
+
+    switch (request.getClientOpcode()) {
+    case cb::mcbp::ClientOpcode::Add:
+    case cb::mcbp::ClientOpcode::Addq:
+    case cb::mcbp::ClientOpcode::Set:
+    case cb::mcbp::ClientOpcode::Setq:
+    case cb::mcbp::ClientOpcode::Replace:
+    case cb::mcbp::ClientOpcode::Replaceq:
+        break;
+    default:
+        return 0;
+    }
+
+    const size_t offset = sizeof(cb::mcbp::Request) +
+                          request.getFramingExtraslen() +
+                          request.getExtlen() + request.getKeylen();
+    const size_t size = sizeof(cb::mcbp::Request) + request.getBodylen();
+    if (size < offset || size - offset < threshold) {
+        return 0;
+    }
+
+    // Don't let a connection which may not store anything allocate items
+    auto& c = cookie.getConnection();
+    if (!c.isAuthenticated() || c.getBucket().type == BucketType::NoBucket) {
+        return 0;
+    }
+
+    return offset;
+}
+
+/**
+ * Try to start reading the value of the request straight into an item
+ * allocated in the engine (from the key and extras of the request), to
+ * avoid buffering a large value in the input buffer and copying it into
+ * the item afterwards. From here on the cookie's packet is a copy of the
+ * request without its value (as that is what the validator gets to see),
+ * and the input buffer is empty until the value has been received.
+ *
+ * @param cookie the cookie for the request
+ * @param offset the offset of the value (the request up to it is in
+ *               the input buffer)
+ * @return true if the value is streamed, false if the packet is to be
+ *         buffered as a whole
+ */
+static bool start_value_stream(Cookie& cookie, size_t offset) {
+    auto& c = cookie.getConnection();
+    auto input = c.read->rdata();
+    const auto& request = cookie.getRequest();
+    const auto opcode = request.getClientOpcode();
+    const size_t valuelen =
+            sizeof(cb::mcbp::Request) + request.getBodylen() - offset;
+
+    std::vector<uint8_t> stripped(input.data(), input.data() + offset);
+    reinterpret_cast<cb::mcbp::Request*>(stripped.data())
+            ->setBodylen(gsl::narrow<uint32_t>(offset -
+                                               sizeof(cb::mcbp::Request)));
+    cookie.setPacket(Cookie::PacketContent::Full,
+                     cb::const_byte_buffer{stripped.data(), stripped.size()},
+                     true);
+
+    // The key and extras are used to allocate the item, so they must be
+    // valid before we go any further. Anything the validator rejects here
+    // is rejected again with the complete packet.
+    if (c.getBucket().validator.validate(opcode, cookie) ==
+        cb::mcbp::Status::Success) {
+        const auto& req = cookie.getRequest();
+        const auto& extras =
+                *reinterpret_cast<const cb::mcbp::request::MutationPayload*>(
+                        req.getExtdata().data());
+        try {
+            auto ret = bucket_allocate_ex(cookie,
+                                          cookie.getRequestKey(),
+                                          valuelen,
+                                          0,
+                                          extras.getFlagsInNetworkByteOrder(),
+                                          extras.getExpiration(),
+                                          uint8_t(req.getDatatype()),
+                                          req.getVBucket());
+            if (ret.first) {
+                // Move over the part of the value we've already got, and
+                // drain the input buffer (we've got our own copy of the
+                // rest of the request)
+                auto* root =
+                        static_cast<uint8_t*>(ret.second.value[0].iov_base);
+                std::copy(input.begin() + offset, input.end(), root);
+                cookie.setStreamedValue(std::move(ret.first),
+                                        {root, valuelen},
+                                        input.size() - offset);
+                c.read->consume([](cb::const_byte_buffer buffer) -> ssize_t {
+                    return buffer.size();
+                });
+                c.setState(StateMachine::State::read_packet_value);
+                return true;
+            }
+        } catch (const std::exception&) {
+            // Leave it to the mutation to fail with the complete packet
+        }
+    }
+
+    cookie.setPacket(
+            Cookie::PacketContent::Header,
+            cb::const_byte_buffer{input.data(), sizeof(cb::mcbp::Request)});
+    cookie.setValueStreamingFailed();
+    return false;
+}
+
+void prepare_mcbp_packet_body(Cookie& cookie) {
+    auto& c = cookie.getConnection();
+    auto input = c.read->rdata();
+    const auto& header = cookie.getHeader();
+
     if (c.isPacketAvailable()) {
         // we've got the entire packet spooled up, just go execute
         cookie.setPacket(Cookie::PacketContent::Full,
@@ -1027,22 +1196,35 @@ void try_read_mcbp_command(Cookie& cookie) {
                                                sizeof(cb::mcbp::Request) +
                                                        header.getBodylen()});
         c.setState(StateMachine::State::validate);
-    } else {
-        // we need to allocate more memory!!
-        try {
-            size_t needed = sizeof(cb::mcbp::Request) + header.getBodylen();
-            c.read->ensureCapacity(needed - c.read->rsize());
-            // ensureCapacity may have reallocated the buffer.. make sure
-            // that the packet in the cookie points to the correct address
-            cookie.setPacket(Cookie::PacketContent::Header,
-                             cb::const_byte_buffer{c.read->rdata().data(),
-                                                   sizeof(cb::mcbp::Request)});
-        } catch (const std::bad_alloc&) {
-            LOG_WARNING("{}: Failed to grow buffer.. closing connection",
-                        c.getId());
-            c.setState(StateMachine::State::closing);
-            return;
+        return;
+    }
+
+    size_t needed = sizeof(cb::mcbp::Request) + header.getBodylen();
+    const auto offset = get_streamed_value_offset(cookie);
+    if (offset != 0) {
+        if (input.size() >= offset) {
+            if (start_value_stream(cookie, offset)) {
+                return;
+            }
+        } else {
+            // Only buffer the request up to the value for now
+            needed = offset;
         }
-        c.setState(StateMachine::State::read_packet_body);
     }
+
+    // we need to allocate more memory!!
+    try {
+        c.read->ensureCapacity(needed - c.read->rsize());
+        // ensureCapacity may have reallocated the buffer.. make sure
+        // that the packet in the cookie points to the correct address
+        cookie.setPacket(Cookie::PacketContent::Header,
+                         cb::const_byte_buffer{c.read->rdata().data(),
+                                               sizeof(cb::mcbp::Request)});
+    } catch (const std::bad_alloc&) {
+        LOG_WARNING("{}: Failed to grow buffer.. closing connection",
+                    c.getId());
+        c.setState(StateMachine::State::closing);
+        return;
+    }
+    c.setState(StateMachine::State::read_packet_body);
 }
@@ -28,6 +28,14 @@ class Response;
 
 void try_read_mcbp_command(Cookie& cookie);
 
+/**
+ * Move on with the packet whose header was parsed by try_read_mcbp_command
+ * as more of it becomes available: execute it once complete, or make room
+ * for the rest of it in the input buffer (or start reading its value
+ * straight into an item allocated in the engine for large mutations).
+ */
+void prepare_mcbp_packet_body(Cookie& cookie);
+
 void initialize_mbcp_lookup_map();
 
 void execute_request_packet(Cookie& cookie, const cb::mcbp::Request& request);
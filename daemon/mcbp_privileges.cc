@@ -234,6 +234,8 @@ McbpPrivilegeChains::McbpPrivilegeChains() {
     setup(cb::mcbp::ClientOpcode::AddqWithMeta, require<Privilege::MetaWrite>);
     setup(cb::mcbp::ClientOpcode::DelWithMeta, require<Privilege::MetaWrite>);
     setup(cb::mcbp::ClientOpcode::DelqWithMeta, require<Privilege::MetaWrite>);
+    setup(cb::mcbp::ClientOpcode::WithMetaBatch,
+          require<Privilege::MetaWrite>);
 
     /**
      * Command to create a new checkpoint on a given vbucket by force
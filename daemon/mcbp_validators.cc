@@ -43,9 +43,13 @@ static inline bool may_accept_xattr(const Cookie& cookie) {
     return true;
 }
 
-bool is_document_key_valid(Cookie& cookie) {
-    const auto& req = cookie.getRequest(Cookie::PacketContent::Header);
-    const auto& key = req.getKey();
+/**
+ * Validate the key, and if it is the request's key remember its decoded
+ * collection-ID in the cookie (see Cookie::setRequestKeyCollectionID).
+ */
+static bool is_document_key_valid(Cookie& cookie,
+                                  cb::const_byte_buffer key,
+                                  bool requestKey) {
     if (!cookie.getConnection().isCollectionsSupported()) {
         return true;
     }
@@ -79,10 +83,23 @@ bool is_document_key_valid(Cookie& cookie) {
     bool rv = leb.second.size() <= maxLen;
     if (!rv) {
         cookie.setErrorContext("Logical key exceeds " + std::to_string(maxLen));
+    } else if (requestKey) {
+        cookie.setRequestKeyCollectionID(
+                leb.first,
+                gsl::narrow_cast<uint8_t>(leb.second.data() - key.data()));
     }
     return rv;
 }
 
+bool is_document_key_valid(Cookie& cookie) {
+    const auto& req = cookie.getRequest(Cookie::PacketContent::Header);
+    return is_document_key_valid(cookie, req.getKey(), true);
+}
+
+bool is_document_key_valid(Cookie& cookie, cb::const_byte_buffer key) {
+    return is_document_key_valid(cookie, key, false);
+}
+
 static inline bool may_accept_dcp_deleteV2(const Cookie& cookie) {
     return cookie.getConnection().isDcpDeleteV2();
 }
@@ -220,6 +237,7 @@ static bool supportsDurability(cb::mcbp::ClientOpcode opcode) {
     case ClientOpcode::VbucketBatchCount:
     case ClientOpcode::DelWithMeta:
     case ClientOpcode::DelqWithMeta:
+    case ClientOpcode::WithMetaBatch:
     case ClientOpcode::CreateCheckpoint:
     case ClientOpcode::NotifyVbucketUpdate:
     case ClientOpcode::EnableTraffic:
@@ -267,15 +285,16 @@ using ExpectedValueLen = McbpValidator::ExpectedValueLen;
 using ExpectedCas = McbpValidator::ExpectedCas;
 
 /**
- * Verify the header meets basic sanity checks and fields length
- * match the provided expected lengths.
+ * The body of McbpValidator::verify_header. It is inline so that the
+ * validators calling it with constant expectations (see document_validator)
+ * get a copy where the checks of the expectations are folded away.
  */
-Status McbpValidator::verify_header(Cookie& cookie,
-                                    uint8_t expected_extlen,
-                                    ExpectedKeyLen expected_keylen,
-                                    ExpectedValueLen expected_valuelen,
-                                    ExpectedCas expected_cas,
-                                    uint8_t expected_datatype_mask) {
+static inline Status verify_header_inline(Cookie& cookie,
+                                          uint8_t expected_extlen,
+                                          ExpectedKeyLen expected_keylen,
+                                          ExpectedValueLen expected_valuelen,
+                                          ExpectedCas expected_cas,
+                                          uint8_t expected_datatype_mask) {
     const auto& header = cookie.getHeader();
 
     if (!header.isValid()) {
@@ -374,9 +393,9 @@ Status McbpValidator::verify_header(Cookie& cookie,
                                      cb::const_byte_buffer data) -> bool {
         switch (id) {
         case cb::mcbp::request::FrameInfoId::Reorder:
-            status = Status::NotSupported;
-            cookie.setErrorContext("OoO is currently not supported");
-            return false;
+            // Only a hint; it is ignored unless the connection is in
+            // unordered execution mode and the command may be reordered
+            return true;
         case cb::mcbp::request::FrameInfoId::DurabilityRequirement:
             try {
                 cb::durability::Requirements req(data);
@@ -420,6 +439,47 @@ Status McbpValidator::verify_header(Cookie& cookie,
     return status;
 }
 
+/**
+ * Verify the header meets basic sanity checks and fields length
+ * match the provided expected lengths.
+ */
+Status McbpValidator::verify_header(Cookie& cookie,
+                                    uint8_t expected_extlen,
+                                    ExpectedKeyLen expected_keylen,
+                                    ExpectedValueLen expected_valuelen,
+                                    ExpectedCas expected_cas,
+                                    uint8_t expected_datatype_mask) {
+    return verify_header_inline(cookie,
+                                expected_extlen,
+                                expected_keylen,
+                                expected_valuelen,
+                                expected_cas,
+                                expected_datatype_mask);
+}
+
+/**
+ * Validator for the document commands which only need the header checked
+ * against fixed expectations, and a valid key. The expectations are template
+ * parameters so each command gets its own specialised copy of the header
+ * checks.
+ */
+template <uint8_t ExtLen,
+          ExpectedKeyLen KeyLen,
+          ExpectedValueLen ValueLen,
+          ExpectedCas Cas,
+          uint8_t DatatypeMask>
+static Status document_validator(Cookie& cookie) {
+    auto status = verify_header_inline(
+            cookie, ExtLen, KeyLen, ValueLen, Cas, DatatypeMask);
+    if (status != Status::Success) {
+        return status;
+    }
+    if (!is_document_key_valid(cookie)) {
+        return Status::Einval;
+    }
+    return Status::Success;
+}
+
 /******************************************************************************
  *                         Package validators                                 *
  *****************************************************************************/
@@ -1093,46 +1153,26 @@ static Status flush_validator(Cookie& cookie) {
     return Status::Success;
 }
 
+/* Must have extras and key, may have value */
 static Status add_validator(Cookie& cookie) {
-    constexpr uint8_t expected_datatype_mask = PROTOCOL_BINARY_RAW_BYTES |
-                                               PROTOCOL_BINARY_DATATYPE_JSON |
-                                               PROTOCOL_BINARY_DATATYPE_SNAPPY;
-    /* Must have extras and key, may have value */
-    auto status = McbpValidator::verify_header(
-            cookie,
-            sizeof(cb::mcbp::request::MutationPayload),
-            ExpectedKeyLen::NonZero,
-            ExpectedValueLen::Any,
-            ExpectedCas::NotSet,
-            expected_datatype_mask);
-    if (status != Status::Success) {
-        return status;
-    }
-    if (!is_document_key_valid(cookie)) {
-        return Status::Einval;
-    }
-    return Status::Success;
+    return document_validator<sizeof(cb::mcbp::request::MutationPayload),
+                              ExpectedKeyLen::NonZero,
+                              ExpectedValueLen::Any,
+                              ExpectedCas::NotSet,
+                              PROTOCOL_BINARY_RAW_BYTES |
+                                      PROTOCOL_BINARY_DATATYPE_JSON |
+                                      PROTOCOL_BINARY_DATATYPE_SNAPPY>(cookie);
 }
 
+/* Must have extras and key, may have value */
 static Status set_replace_validator(Cookie& cookie) {
-    constexpr uint8_t expected_datatype_mask = PROTOCOL_BINARY_RAW_BYTES |
-                                               PROTOCOL_BINARY_DATATYPE_JSON |
-                                               PROTOCOL_BINARY_DATATYPE_SNAPPY;
-    /* Must have extras and key, may have value */
-    auto status = McbpValidator::verify_header(
-            cookie,
-            sizeof(cb::mcbp::request::MutationPayload),
-            ExpectedKeyLen::NonZero,
-            ExpectedValueLen::Any,
-            ExpectedCas::Any,
-            expected_datatype_mask);
-    if (status != Status::Success) {
-        return status;
-    }
-    if (!is_document_key_valid(cookie)) {
-        return Status::Einval;
-    }
-    return Status::Success;
+    return document_validator<sizeof(cb::mcbp::request::MutationPayload),
+                              ExpectedKeyLen::NonZero,
+                              ExpectedValueLen::Any,
+                              ExpectedCas::Any,
+                              PROTOCOL_BINARY_RAW_BYTES |
+                                      PROTOCOL_BINARY_DATATYPE_JSON |
+                                      PROTOCOL_BINARY_DATATYPE_SNAPPY>(cookie);
 }
 
 static Status append_prepend_validator(Cookie& cookie) {
@@ -1156,20 +1196,11 @@ static Status append_prepend_validator(Cookie& cookie) {
 }
 
 static Status get_validator(Cookie& cookie) {
-    auto status = McbpValidator::verify_header(cookie,
-                                               0,
-                                               ExpectedKeyLen::NonZero,
-                                               ExpectedValueLen::Zero,
-                                               ExpectedCas::NotSet,
-                                               PROTOCOL_BINARY_RAW_BYTES);
-    if (status != Status::Success) {
-        return status;
-    }
-    if (!is_document_key_valid(cookie)) {
-        return Status::Einval;
-    }
-
-    return Status::Success;
+    return document_validator<0,
+                              ExpectedKeyLen::NonZero,
+                              ExpectedValueLen::Zero,
+                              ExpectedCas::NotSet,
+                              PROTOCOL_BINARY_RAW_BYTES>(cookie);
 }
 
 static Status gat_validator(Cookie& cookie) {
@@ -1193,20 +1224,11 @@ static Status gat_validator(Cookie& cookie) {
 }
 
 static Status delete_validator(Cookie& cookie) {
-    auto status = McbpValidator::verify_header(cookie,
-                                               0,
-                                               ExpectedKeyLen::NonZero,
-                                               ExpectedValueLen::Zero,
-                                               ExpectedCas::Any,
-                                               PROTOCOL_BINARY_RAW_BYTES);
-    if (status != Status::Success) {
-        return status;
-    }
-    if (!is_document_key_valid(cookie)) {
-        return Status::Einval;
-    }
-
-    return Status::Success;
+    return document_validator<0,
+                              ExpectedKeyLen::NonZero,
+                              ExpectedValueLen::Zero,
+                              ExpectedCas::Any,
+                              PROTOCOL_BINARY_RAW_BYTES>(cookie);
 }
 
 static Status stat_validator(Cookie& cookie) {
@@ -1591,6 +1613,96 @@ static Status mutate_with_meta_validator(Cookie& cookie) {
     return Status::Success;
 }
 
+static Status with_meta_batch_validator(Cookie& cookie) {
+    auto status = McbpValidator::verify_header(cookie,
+                                               0,
+                                               ExpectedKeyLen::Zero,
+                                               ExpectedValueLen::NonZero,
+                                               ExpectedCas::NotSet,
+                                               PROTOCOL_BINARY_RAW_BYTES);
+    if (status != Status::Success) {
+        return status;
+    }
+
+    // The value is a sequence of complete SET/ADD/DEL_WITH_META requests,
+    // each validated as mutate_with_meta_validator would
+    const auto& request = cookie.getHeader().getRequest();
+    auto value = request.getValue();
+    while (!value.empty()) {
+        if (value.size() < sizeof(cb::mcbp::Request)) {
+            cookie.setErrorContext("Truncated mutation header");
+            return Status::Einval;
+        }
+        const auto& mutation =
+                *reinterpret_cast<const cb::mcbp::Request*>(value.data());
+        const size_t size = sizeof(cb::mcbp::Request) + mutation.getBodylen();
+        if (mutation.getMagic() != cb::mcbp::Magic::ClientRequest ||
+            !mutation.isValid() || size > value.size()) {
+            cookie.setErrorContext("Invalid mutation header");
+            return Status::Einval;
+        }
+
+        switch (mutation.getClientOpcode()) {
+        case cb::mcbp::ClientOpcode::SetWithMeta:
+        case cb::mcbp::ClientOpcode::AddWithMeta:
+        case cb::mcbp::ClientOpcode::DelWithMeta:
+            break;
+        default:
+            cookie.setErrorContext(
+                    "Only SET_WITH_META, ADD_WITH_META and DEL_WITH_META "
+                    "may be batched");
+            return Status::Einval;
+        }
+
+        if (mutation.getVBucket() != request.getVBucket()) {
+            cookie.setErrorContext("Mutation is not for the batch's vbucket");
+            return Status::Einval;
+        }
+
+        switch (mutation.getExtlen()) {
+        case 24:
+        case 26:
+        case 28:
+        case 30:
+            break;
+        default:
+            cookie.setErrorContext("Mutation extras invalid");
+            return Status::Einval;
+        }
+
+        const auto datatype = uint8_t(mutation.getDatatype());
+        if (!mcbp::datatype::is_valid(datatype)) {
+            cookie.setErrorContext("Mutation datatype invalid");
+            return Status::Einval;
+        }
+        if (mcbp::datatype::is_xattr(datatype)) {
+            if (!cookie.getConnection().isXattrEnabled()) {
+                cookie.setErrorContext("Connection not Xattr enabled");
+                return Status::Einval;
+            }
+            if (!is_valid_xattr_blob(mutation)) {
+                cookie.setErrorContext("Xattr blob invalid");
+                return Status::XattrEinval;
+            }
+        }
+
+        const auto maxKeyLen = cookie.getConnection().isCollectionsSupported()
+                                       ? MaxCollectionsKeyLen
+                                       : KEY_MAX_LENGTH;
+        if (mutation.getKeylen() == 0 || mutation.getKeylen() > maxKeyLen) {
+            cookie.setErrorContext("Mutation key length invalid");
+            return Status::Einval;
+        }
+        if (!is_document_key_valid(cookie, mutation.getKey())) {
+            return Status::Einval;
+        }
+
+        value = {value.data() + size, value.size() - size};
+    }
+
+    return Status::Success;
+}
+
 static Status get_errmap_validator(Cookie& cookie) {
     auto status = McbpValidator::verify_header(cookie,
                                                0,
@@ -1812,8 +1924,16 @@ static Status scrub_validator(Cookie& cookie) {
 }
 
 static Status get_random_key_validator(Cookie& cookie) {
+    const auto extlen = cookie.getHeader().getExtlen();
+    if (extlen != 0 && extlen != sizeof(uint32_t)) {
+        cookie.setErrorContext(
+                "Expected 4 bytes of extras containing the number of "
+                "documents to get");
+        return Status::Einval;
+    }
+
     return McbpValidator::verify_header(cookie,
-                                        0,
+                                        extlen,
                                         ExpectedKeyLen::Zero,
                                         ExpectedValueLen::Zero,
                                         ExpectedCas::NotSet,
@@ -2110,6 +2230,30 @@ static Status not_supported_validator(Cookie& cookie) {
 }
 
 Status McbpValidator::validate(ClientOpcode command, Cookie& cookie) {
+    // The most frequent commands are dispatched directly so their
+    // (specialised) validators are inlined here instead of being called
+    // through the table. They're still installed in the table too.
+    switch (command) {
+    case ClientOpcode::Get:
+    case ClientOpcode::Getq:
+    case ClientOpcode::Getk:
+    case ClientOpcode::Getkq:
+        return get_validator(cookie);
+    case ClientOpcode::Set:
+    case ClientOpcode::Setq:
+    case ClientOpcode::Replace:
+    case ClientOpcode::Replaceq:
+        return set_replace_validator(cookie);
+    case ClientOpcode::Add:
+    case ClientOpcode::Addq:
+        return add_validator(cookie);
+    case ClientOpcode::Delete:
+    case ClientOpcode::Deleteq:
+        return delete_validator(cookie);
+    default:
+        break;
+    }
+
     const auto idx = std::underlying_type<ClientOpcode>::type(command);
     if (validators[idx]) {
         return validators[idx](cookie);
@@ -2240,6 +2384,7 @@ McbpValidator::McbpValidator() {
     setup(cb::mcbp::ClientOpcode::AddqWithMeta, mutate_with_meta_validator);
     setup(cb::mcbp::ClientOpcode::DelWithMeta, mutate_with_meta_validator);
     setup(cb::mcbp::ClientOpcode::DelqWithMeta, mutate_with_meta_validator);
+    setup(cb::mcbp::ClientOpcode::WithMetaBatch, with_meta_batch_validator);
     setup(cb::mcbp::ClientOpcode::GetErrorMap, get_errmap_validator);
     setup(cb::mcbp::ClientOpcode::GetLocked, get_locked_validator);
     setup(cb::mcbp::ClientOpcode::UnlockKey, unlock_validator);
@@ -65,7 +65,11 @@ protected:
      */
     void setup(ClientOpcode command, Status (*f)(Cookie&));
 
-    std::array<std::function<Status(Cookie&)>, 0x100> validators;
+    /// Every validator is a plain function, so the table doesn't need the
+    /// type erasure (and extra indirection) of std::function.
+    using Validator = Status (*)(Cookie&);
+
+    std::array<Validator, 0x100> validators{};
 };
 
 /**
@@ -74,3 +78,6 @@ protected:
  * @return true if the keylen represents a valid key for the connection
  */
 bool is_document_key_valid(Cookie& cookie);
+
+/// As above, for a key other than the request's (e.g. of a batched request)
+bool is_document_key_valid(Cookie& cookie, cb::const_byte_buffer key);
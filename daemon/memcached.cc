@@ -47,6 +47,7 @@
 #include "server_socket.h"
 #include "session_cas.h"
 #include "settings.h"
+#include "ssl_context.h"
 #include "stats.h"
 #include "subdocument.h"
 #include "timings.h"
@@ -77,6 +78,7 @@
 #include <platform/socket.h>
 #include <platform/strerror.h>
 #include <platform/sysinfo.h>
+#include <platform/timeutils.h>
 #include <snappy-c.h>
 #include <utilities/breakpad.h>
 #include <gsl/gsl>
@@ -94,6 +96,7 @@
 #include <math.h>
 #ifndef WIN32
 #include <netinet/tcp.h> // For TCP_NODELAY etc
+#include <sys/un.h>
 #include <sysexits.h>
 #endif
 #include <signal.h>
@@ -160,6 +163,9 @@ struct stats stats;
 
 /** file scope variables **/
 std::vector<std::unique_ptr<ServerSocket>> listen_conn;
+/// The additional SO_REUSEPORT sockets (bound to the same addresses as
+/// listen_conn) used by the worker threads when reuseport_listeners is set.
+static std::vector<std::unique_ptr<ServerSocket>> worker_listen_conn;
 static struct event_base *main_base;
 
 static engine_event_handler_array_t engine_event_handlers;
@@ -222,6 +228,10 @@ bool associate_bucket(Connection& connection, const char* name) {
         }
     }
 
+    if (found) {
+        request_bucket_thread(connection);
+    }
+
     if (!found) {
         /* Bucket not found, connect to the "no-bucket" */
         Bucket &b = all_buckets.at(0);
@@ -391,7 +401,7 @@ static void stats_init(void) {
 }
 
 struct thread_stats* get_thread_stats(Connection* c) {
-    cb_assert(c->getThread()->index < (settings.getNumWorkerThreads() + 1));
+    cb_assert(c->getThread()->index < (settings.getNumFrontEndThreads() + 1));
     auto& independent_stats = all_buckets[c->getBucketIndex()].stats;
     return &independent_stats.at(c->getThread()->index);
 }
@@ -567,7 +577,7 @@ static void settings_init(void) {
     settings.setDedupeNmvbMaps(false);
 
     char *tmp = getenv("MEMCACHED_TOP_KEYS");
-    settings.setTopkeysSize(20);
+    settings.setTopkeysSize(160);
     if (tmp != NULL) {
         int count;
         if (safe_strtol(tmp, count)) {
@@ -664,6 +674,9 @@ void disable_listen() {
     for (auto& connection : listen_conn) {
         connection->disable();
     }
+    for (auto& connection : worker_listen_conn) {
+        connection->disable();
+    }
 }
 
 void safe_close(SOCKET sfd) {
@@ -808,7 +821,7 @@ void event_handler(evutil_socket_t fd, short which, void *arg) {
 /**
  * The listen_event_handler is the callback from libevent when someone is
  * connecting to one of the server sockets. It runs in the context of the
- * listen thread
+ * listen thread (or of the worker thread owning a SO_REUSEPORT socket)
  */
 void listen_event_handler(evutil_socket_t, short which, void *arg) {
     auto& c = *reinterpret_cast<ServerSocket*>(arg);
@@ -848,6 +861,9 @@ static void dispatch_event_handler(evutil_socket_t fd, short, void *) {
             for (auto& connection : listen_conn) {
                 connection->enable();
             }
+            for (auto& connection : worker_listen_conn) {
+                connection->enable();
+            }
         }
     }
 }
@@ -934,6 +950,18 @@ static SOCKET new_server_socket(struct addrinfo *ai, bool tcp_nodelay) {
                     cb_strerror(cb::net::get_socket_error()));
     }
 
+#ifdef SO_REUSEPORT
+    if (settings.isReuseportListenersEnabled() &&
+        cb::net::setsockopt(sfd,
+                            SOL_SOCKET,
+                            SO_REUSEPORT,
+                            reinterpret_cast<const void*>(&flags),
+                            sizeof(flags)) != 0) {
+        LOG_WARNING("setsockopt(SO_REUSEPORT): {}",
+                    cb_strerror(cb::net::get_socket_error()));
+    }
+#endif
+
     if (cb::net::setsockopt(sfd,
                             SOL_SOCKET,
                             SO_KEEPALIVE,
@@ -966,6 +994,89 @@ static SOCKET new_server_socket(struct addrinfo *ai, bool tcp_nodelay) {
     return sfd;
 }
 
+/**
+ * Create the SO_REUSEPORT sockets for the worker threads (all but the first
+ * one, which gets the primary socket) bound to the same address as the
+ * given primary socket. They're moved over to the worker threads by
+ * start_worker_listeners() once the threads exist.
+ *
+ * @param ai the address info the primary socket was created from
+ * @param primary the primary socket (already bound)
+ * @param port the port number the primary socket is bound to
+ * @param interf the interface description used to create the port
+ */
+static void create_worker_listen_sockets(struct addrinfo* ai,
+                                         SOCKET primary,
+                                         in_port_t port,
+                                         const NetworkInterface& interf) {
+#ifdef SO_REUSEPORT
+    sockaddr_storage addr{};
+    socklen_t addrlen = sizeof(addr);
+    if (getsockname(primary, reinterpret_cast<sockaddr*>(&addr), &addrlen) !=
+        0) {
+        LOG_WARNING("getsockname(): {}",
+                    cb_strerror(cb::net::get_socket_error()));
+        return;
+    }
+
+    for (size_t ii = 1; ii < settings.getNumWorkerThreads(); ++ii) {
+        auto sfd = new_server_socket(ai, interf.tcp_nodelay);
+        if (sfd == INVALID_SOCKET) {
+            return;
+        }
+        if (bind(sfd, reinterpret_cast<sockaddr*>(&addr), addrlen) ==
+            SOCKET_ERROR) {
+            LOG_WARNING("Failed to bind SO_REUSEPORT socket to {} - {}",
+                        cb::net::to_string(&addr, addrlen),
+                        cb_strerror(cb::net::get_socket_error()));
+            safe_close(sfd);
+            return;
+        }
+        worker_listen_conn.emplace_back(std::make_unique<ServerSocket>(
+                sfd, main_base, port, ai->ai_addr->sa_family, interf));
+        stats.daemon_conns++;
+        stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+}
+
+/**
+ * Hand the listening sockets over to the worker threads when
+ * reuseport_listeners is set, so the kernel spreads the new connections
+ * over the workers and each one accepts and serves its own (no dispatch
+ * through the listen thread). The primary sockets go to the first worker,
+ * the sockets created by create_worker_listen_sockets() to the others.
+ */
+static void start_worker_listeners() {
+#ifdef SO_REUSEPORT
+    if (!settings.isReuseportListenersEnabled()) {
+        return;
+    }
+
+    const auto nthreads = settings.getNumWorkerThreads();
+    for (auto& connection : listen_conn) {
+        // There's only the primary Unix domain socket, so those clients are
+        // still dispatched over all the workers.
+        if (!connection->isUnixDomain()) {
+            connection->moveToThread(get_worker_thread(0));
+        }
+    }
+    if (nthreads > 1) {
+        for (size_t ii = 0; ii < worker_listen_conn.size(); ++ii) {
+            worker_listen_conn[ii]->moveToThread(
+                    get_worker_thread((ii % (nthreads - 1)) + 1));
+        }
+    }
+    LOG_INFO("Worker threads accept clients on SO_REUSEPORT sockets");
+#else
+    if (settings.isReuseportListenersEnabled()) {
+        LOG_WARNING(
+                "reuseport_listeners is not supported on this platform, "
+                "clients are dispatched by the listen thread");
+    }
+#endif
+}
+
 /**
  * Add a port to the list of interfaces we're listening to.
  *
@@ -991,6 +1102,7 @@ static void add_listening_port(const NetworkInterface *interf, in_port_t port, s
 
         newport.curr_conns = 1;
         newport.maxconns = interf->maxconn;
+        newport.path = interf->path;
 
         if (interf->ssl.key.empty() || interf->ssl.cert.empty()) {
             newport.ssl.enabled = false;
@@ -1019,6 +1131,54 @@ static void add_listening_port(const NetworkInterface *interf, in_port_t port, s
     }
 }
 
+/**
+ * Create a Unix domain socket listening at the interface's path, replacing
+ * any (stale) socket file left there.
+ * @param interf the interface to bind to
+ * @return true if we were able to listen at the path
+ */
+static bool unix_server_socket(const NetworkInterface& interf) {
+#ifdef WIN32
+    LOG_CRITICAL(R"(Unix domain socket "{}" is not supported on Windows)",
+                 interf.path);
+    return false;
+#else
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::copy(interf.path.begin(), interf.path.end(), addr.sun_path);
+
+    auto sfd = cb::net::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sfd == INVALID_SOCKET) {
+        LOG_CRITICAL(R"(Failed to create Unix domain socket for "{}": {})",
+                     interf.path,
+                     cb_strerror(cb::net::get_socket_error()));
+        return false;
+    }
+    if (evutil_make_socket_nonblocking(sfd) == -1) {
+        safe_close(sfd);
+        return false;
+    }
+    maximize_sndbuf(sfd);
+
+    unlink(interf.path.c_str());
+    if (bind(sfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ==
+        SOCKET_ERROR) {
+        LOG_CRITICAL(R"(Failed to bind to Unix domain socket "{}": {})",
+                     interf.path,
+                     cb_strerror(cb::net::get_socket_error()));
+        safe_close(sfd);
+        return false;
+    }
+
+    listen_conn.emplace_back(std::make_unique<ServerSocket>(
+            sfd, main_base, interf.port, AF_UNIX, interf));
+    stats.daemon_conns++;
+    stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
+    add_listening_port(&interf, interf.port, AF_UNIX);
+    return true;
+#endif
+}
+
 /**
  * Create a socket and bind it to a specific port number
  * @param interface the interface to bind to
@@ -1026,6 +1186,10 @@ static void add_listening_port(const NetworkInterface *interf, in_port_t port, s
  *        false if we failed to set any addresses on the interface
  */
 static bool server_socket(const NetworkInterface& interf) {
+    if (!interf.path.empty()) {
+        return unix_server_socket(interf);
+    }
+
     SOCKET sfd;
     addrinfo hints = {};
 
@@ -1125,6 +1289,10 @@ static bool server_socket(const NetworkInterface& interf) {
         stats.daemon_conns++;
         stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
         add_listening_port(&interf, listenport, next->ai_addr->sa_family);
+
+        if (settings.isReuseportListenersEnabled()) {
+            create_worker_listen_sockets(next, sfd, listenport, interf);
+        }
     }
 
     freeaddrinfo(ai);
@@ -1509,12 +1677,21 @@ struct ServerCookieApi : public ServerCookieIface {
         if (thr == nullptr) {
             throw std::runtime_error(
                     R"(ServerCookieApi::release: connection is not bound to a thread)");
-        } else {
+        }
+
+        for (;;) {
             TRACE_LOCKGUARD_TIMED(thr->mutex,
                                   "mutex",
                                   "release_cookie::threadLock",
                                   SlowMutexThreshold);
 
+            // A DCP connection may have been moved to a DCP thread (which
+            // is done holding the old thread's lock) while we waited
+            if (connection.getThread() != thr) {
+                thr = connection.getThread();
+                continue;
+            }
+
             // Releasing the reference to the object may cause it to change
             // state. (NOTE: the release call shall never be called from the
             // worker threads), so put the connection in the pool of pending
@@ -1522,6 +1699,7 @@ struct ServerCookieApi : public ServerCookieIface {
             cookie.decrementRefcount();
             notify = add_conn_to_pending_io_list(
                     &connection, nullptr, ENGINE_SUCCESS);
+            break;
         }
 
         // kick the thread in the butt
@@ -1647,6 +1825,12 @@ public:
         hooks_api.release_free_memory = AllocHooks::release_free_memory;
         hooks_api.enable_thread_cache = AllocHooks::enable_thread_cache;
         hooks_api.get_allocator_property = AllocHooks::get_allocator_property;
+        hooks_api.create_arena = AllocHooks::create_arena;
+        hooks_api.release_arena = AllocHooks::release_arena;
+        hooks_api.set_thread_arena = AllocHooks::set_thread_arena;
+        hooks_api.get_arena_allocated = AllocHooks::get_arena_allocated;
+        hooks_api.get_allocation_utilization =
+                AllocHooks::get_allocation_utilization;
 
         core = &core_api;
         callback = &callback_api;
@@ -1734,7 +1918,9 @@ void CreateBucketThread::create() {
         all_buckets[ii].type = type;
         strcpy(all_buckets[ii].name, name.c_str());
         try {
-            all_buckets[ii].topkeys = new TopKeys(settings.getTopkeysSize());
+            all_buckets[ii].topkeys =
+                    new TopKeys(settings.getTopkeysSize(),
+                                settings.getNumFrontEndThreads() + 1);
         } catch (const std::bad_alloc &) {
             result = ENGINE_ENOMEM;
             LOG_WARNING("{} Create bucket [{}] failed - out of memory",
@@ -1913,6 +2099,8 @@ void DestroyBucketThread::destroy() {
         disassociate_bucket(*connection);
     }
 
+    const auto start = std::chrono::steady_clock::now();
+
     /* Let all of the worker threads start invalidating connections */
     threads_initiate_bucket_deletion();
 
@@ -1957,14 +2145,21 @@ void DestroyBucketThread::destroy() {
      * BucketState != Ready.  See associate_bucket() for more details.
      */
 
+    const auto disconnected = std::chrono::steady_clock::now();
     LOG_INFO(
-            "{} Delete bucket [{}]. Shut down the bucket", connection_id, name);
+            "{} Delete bucket [{}]. Shut down the bucket (clients "
+            "disconnected in {})",
+            connection_id,
+            name,
+            cb::time2text(disconnected - start));
 
     bucket.getEngine()->destroy(force);
 
-    LOG_INFO("{} Delete bucket [{}]. Clean up allocated resources ",
+    LOG_INFO("{} Delete bucket [{}]. Clean up allocated resources (bucket "
+             "shut down in {})",
              connection_id,
-             name);
+             name,
+             cb::time2text(std::chrono::steady_clock::now() - disconnected));
 
     /* Clean up the stats... */
     threadlocal_stats_reset(bucket.stats);
@@ -1983,10 +2178,14 @@ void DestroyBucketThread::destroy() {
         bucket.responseCounters.fill(0);
         bucket.topkeys = nullptr;
     }
-    // don't need lock because all timing data uses atomics
+    // don't need lock because the timings have locks of their own
     bucket.timings.reset();
+    bucket.vbucketLoad.reset();
 
-    LOG_INFO("{} Delete bucket [{}] complete", connection_id, name);
+    LOG_INFO("{} Delete bucket [{}] complete in {}",
+             connection_id,
+             name,
+             cb::time2text(std::chrono::steady_clock::now() - start));
     result = ENGINE_SUCCESS;
 }
 
@@ -1998,9 +2197,11 @@ void DestroyBucketThread::run() {
 }
 
 static void initialize_buckets(void) {
-    size_t numthread = settings.getNumWorkerThreads() + 1;
+    size_t numthread = settings.getNumFrontEndThreads() + 1;
     for (auto &b : all_buckets) {
         b.stats.resize(numthread);
+        b.timings.resize(numthread);
+        b.vbucketLoad.resize(numthread);
     }
 
     // To make the life easier for us in the code, index 0
@@ -2116,7 +2317,7 @@ void delete_all_buckets() {
 
 static void set_max_filehandles(void) {
     const uint64_t maxfiles = settings.getMaxconns() +
-                            (3 * (settings.getNumWorkerThreads() + 2)) +
+                            (3 * (settings.getNumFrontEndThreads() + 2)) +
                             1024;
 
     auto limit = cb::io::maximizeFileDescriptors(maxfiles);
@@ -2136,7 +2337,7 @@ static void set_max_filehandles(void) {
                 int(maxfiles),
                 int(limit),
                 settings.getMaxconns(),
-                (3 * (settings.getNumWorkerThreads() + 2)));
+                (3 * (settings.getNumFrontEndThreads() + 2)));
     }
 }
 
@@ -2356,7 +2557,11 @@ extern "C" int memcached_main(int argc, char **argv) {
     create_listen_sockets(true);
 
     /* start up worker threads if MT mode */
-    thread_init(settings.getNumWorkerThreads(), main_base, dispatch_event_handler);
+    thread_init(settings.getNumWorkerThreads(),
+                settings.getNumDcpThreads(),
+                main_base,
+                dispatch_event_handler);
+    start_worker_listeners();
 
     executorPool =
             std::make_unique<ExecutorPool>(settings.getNumWorkerThreads());
@@ -2405,6 +2610,7 @@ extern "C" int memcached_main(int argc, char **argv) {
 
     LOG_INFO("Releasing server sockets");
     listen_conn.clear();
+    worker_listen_conn.clear();
 
     LOG_INFO("Releasing client resources");
     close_all_connections();
@@ -2448,6 +2654,7 @@ extern "C" int memcached_main(int argc, char **argv) {
     free_callbacks();
 
     LOG_INFO("Shutting down OpenSSL");
+    SslContext::releaseServerContexts();
     shutdown_openssl();
 
     LOG_INFO("Shutting down libevent");
@@ -71,6 +71,7 @@ void associate_initial_bucket(Connection& connection);
  */
 
 void thread_init(size_t nthreads,
+                 size_t ndcpthreads,
                  struct event_base* main_base,
                  void (*dispatcher_callback)(evutil_socket_t, short, void*));
 void threads_shutdown();
@@ -78,6 +79,13 @@ void threads_cleanup();
 
 void dispatch_conn_new(SOCKET sfd, in_port_t parent_port);
 
+/**
+ * Ask the worker threads with more than their share of (non-DCP)
+ * connections to move idle ones to the least loaded threads. The moves
+ * happen asynchronously, on the thread each connection is bound to.
+ */
+void rebalance_connections();
+
 /* Lock wrappers for cache functions that are called from main loop. */
 int is_listen_thread(void);
 
@@ -86,6 +94,16 @@ void threadlocal_stats_reset(std::vector<thread_stats>& thread_stats);
 void notify_io_complete(gsl::not_null<const void*> cookie,
                         ENGINE_ERROR_CODE status);
 void safe_close(SOCKET sfd);
+
+/**
+ * Add a notification for the connection to its thread's pending io list.
+ *
+ * @return non-zero if the caller must notify the thread. That is only the
+ *         case for the first notification added since the thread last took
+ *         the list; it will pick up any added after that one anyway, so a
+ *         batch of notifications (e.g. the cookies of one background fetch)
+ *         costs a single wakeup.
+ */
 int add_conn_to_pending_io_list(Connection* c,
                                 Cookie* cookie,
                                 ENGINE_ERROR_CODE status);
@@ -106,9 +124,11 @@ const char* get_server_version(void);
 
 /**
  * Increments topkeys count for the key specified within the command context
- * provided by the cookie.
+ * provided by the cookie (once the command completes).
+ *
+ * @param bytes the number of bytes of the document read or written
  */
-void update_topkeys(const Cookie& cookie);
+void update_topkeys(Cookie& cookie, size_t bytes = 0);
 
 void threads_notify_bucket_deletion();
 void threads_complete_bucket_deletion();
@@ -23,6 +23,9 @@
 
 #include <nlohmann/json.hpp>
 #include <utilities/json_utilities.h>
+#ifndef WIN32
+#include <sys/un.h>
+#endif
 
 static void handle_interface_maxconn(NetworkInterface& ifc,
                                      nlohmann::json::const_iterator it) {
@@ -39,6 +42,20 @@ static void handle_interface_host(NetworkInterface& ifc,
     ifc.host = cb::jsonGet<std::string>(it);
 }
 
+static void handle_interface_path(NetworkInterface& ifc,
+                                  nlohmann::json::const_iterator it) {
+#ifdef WIN32
+    throw std::invalid_argument(R"("path" is not supported on Windows)");
+#else
+    ifc.path = cb::jsonGet<std::string>(it);
+    if (ifc.path.empty() || ifc.path.size() >= sizeof(sockaddr_un::sun_path)) {
+        throw std::invalid_argument(
+                R"("path" must be a non-empty path shorter than )" +
+                std::to_string(sizeof(sockaddr_un::sun_path)) + " bytes");
+    }
+#endif
+}
+
 static void handle_interface_backlog(NetworkInterface& ifc,
                                      nlohmann::json::const_iterator it) {
     ifc.backlog = gsl::narrow<int>(cb::jsonGet<size_t>(it));
@@ -153,6 +170,7 @@ NetworkInterface::NetworkInterface(const nlohmann::json& json) {
             {"maxconn", handle_interface_maxconn},
             {"port", handle_interface_port},
             {"host", handle_interface_host},
+            {"path", handle_interface_path},
             {"backlog", handle_interface_backlog},
             {"ipv4", handle_interface_ipv4},
             {"ipv6", handle_interface_ipv6},
@@ -35,6 +35,12 @@ public:
     explicit NetworkInterface(const nlohmann::json& json);
 
     std::string host;
+    /**
+     * If set, listen on a Unix domain socket at this path rather than on a
+     * TCP port (for clients on the same host); the port number then only
+     * identifies the interface.
+     */
+    std::string path;
     struct {
         std::string key;
         std::string cert;
@@ -0,0 +1,169 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "prometheus.h"
+
+#include <utilities/hdrhistogram.h>
+
+#include <cmath>
+#include <cstdio>
+
+namespace cb {
+namespace prometheus {
+
+const std::vector<uint64_t> Writer::DurationBuckets = {
+        50,      100,     250,     500,     1000,     2500,
+        5000,    10000,   25000,   50000,   100000,   250000,
+        500000,  1000000, 2500000, 5000000, 10000000, 30000000};
+
+static std::string formatDouble(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+static std::string formatSeconds(uint64_t usec) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%g", double(usec) / 1e6);
+    return buffer;
+}
+
+/// Escape a label value (backslash, double-quote and line feed)
+static void appendEscaped(std::string& out, const std::string& value) {
+    for (const auto c : value) {
+        switch (c) {
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        default:
+            out.push_back(c);
+        }
+    }
+}
+
+std::string Writer::sanitise(const std::string& name) {
+    std::string ret = name;
+    for (size_t ii = 0; ii < ret.size(); ++ii) {
+        const auto c = ret[ii];
+        const bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                           c == '_' ||
+                           (ii > 0 && c >= '0' && c <= '9');
+        if (!valid) {
+            ret[ii] = '_';
+        }
+    }
+    return ret;
+}
+
+void Writer::addType(const std::string& name, const char* type) {
+    if (types.insert(name).second) {
+        document.append("# TYPE ").append(name).append(1, ' ');
+        document.append(type).append(1, '\n');
+    }
+}
+
+void Writer::addSample(const std::string& name,
+                       const Labels& labels,
+                       const std::string& value,
+                       const std::pair<std::string, std::string>* extra) {
+    document.append(name);
+    if (!labels.empty() || extra) {
+        document.push_back('{');
+        bool first = true;
+        auto addLabel = [this, &first](const std::pair<std::string,
+                                                       std::string>& label) {
+            if (!first) {
+                document.push_back(',');
+            }
+            first = false;
+            document.append(label.first).append("=\"");
+            appendEscaped(document, label.second);
+            document.push_back('"');
+        };
+        for (const auto& label : labels) {
+            addLabel(label);
+        }
+        if (extra) {
+            addLabel(*extra);
+        }
+        document.push_back('}');
+    }
+    document.append(1, ' ').append(value).append(1, '\n');
+}
+
+void Writer::counter(const std::string& name,
+                     const Labels& labels,
+                     uint64_t value) {
+    addType(name, "counter");
+    addSample(name, labels, std::to_string(value));
+}
+
+void Writer::gauge(const std::string& name,
+                   const Labels& labels,
+                   double value) {
+    addType(name, "gauge");
+    addSample(name, labels, formatDouble(value));
+}
+
+void Writer::histogram(const std::string& name,
+                       const Labels& labels,
+                       const HdrHistogram& histogram) {
+    addType(name, "histogram");
+
+    std::vector<uint64_t> counts(DurationBuckets.size());
+    double sum = 0;
+    auto iter = histogram.makeRecordedIterator();
+    while (auto next = histogram.getNextValueAndCount(iter)) {
+        // the iterator's values include the +1 bias of HdrHistogram
+        const uint64_t value = iter.highest_equivalent_value - 1;
+        sum += double(value) * next->second;
+        for (size_t ii = 0; ii < DurationBuckets.size(); ++ii) {
+            if (value <= DurationBuckets[ii]) {
+                counts[ii] += next->second;
+                break;
+            }
+        }
+    }
+
+    const auto bucket = name + "_bucket";
+    uint64_t cumulative = 0;
+    for (size_t ii = 0; ii < DurationBuckets.size(); ++ii) {
+        cumulative += counts[ii];
+        const std::pair<std::string, std::string> le{
+                "le", formatSeconds(DurationBuckets[ii])};
+        addSample(bucket, labels, std::to_string(cumulative), &le);
+    }
+    const auto total = histogram.getValueCount();
+    const std::pair<std::string, std::string> inf{"le", "+Inf"};
+    addSample(bucket, labels, std::to_string(total), &inf);
+    addSample(name + "_sum", labels, formatDouble(sum / 1e6));
+    addSample(name + "_count", labels, std::to_string(total));
+}
+
+} // namespace prometheus
+} // namespace cb
@@ -0,0 +1,88 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class HdrHistogram;
+
+namespace cb {
+namespace prometheus {
+
+/// The labels of a sample, as (name, value) pairs
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * Builds a document in the Prometheus text exposition format (version
+ * 0.0.4), as returned by "stats metrics".
+ *
+ * The samples of a metric must be added one after the other; the TYPE line
+ * of a metric is written before its first sample.
+ */
+class Writer {
+public:
+    /// Add a sample of a counter (a value which only ever goes up)
+    void counter(const std::string& name, const Labels& labels, uint64_t value);
+
+    /// Add a sample of a gauge
+    void gauge(const std::string& name, const Labels& labels, double value);
+
+    /**
+     * Add a histogram, with the fixed (cumulative) buckets of
+     * DurationBuckets.
+     *
+     * @param name the name of the histogram (reported in seconds)
+     * @param labels the labels of the histogram
+     * @param histogram the histogram, of values in microseconds
+     */
+    void histogram(const std::string& name,
+                   const Labels& labels,
+                   const HdrHistogram& histogram);
+
+    /// @return the document
+    const std::string& str() const {
+        return document;
+    }
+
+    /**
+     * @return the name, with the characters not allowed in a metric name
+     *         replaced by '_'
+     */
+    static std::string sanitise(const std::string& name);
+
+    /// The upper bounds (in microseconds) of the buckets of histograms
+    static const std::vector<uint64_t> DurationBuckets;
+
+private:
+    void addType(const std::string& name, const char* type);
+    void addSample(const std::string& name,
+                   const Labels& labels,
+                   const std::string& value,
+                   const std::pair<std::string, std::string>* extra = nullptr);
+
+    std::string document;
+
+    /// The metrics a TYPE line has been written for
+    std::unordered_set<std::string> types;
+};
+
+} // namespace prometheus
+} // namespace cb
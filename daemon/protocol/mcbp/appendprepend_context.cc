@@ -35,6 +35,9 @@ AppendPrependCommandContext::AppendPrependCommandContext(
       vbucket(req.getVBucket()),
       cas(req.getCas()),
       state(State::ValidateInput),
+      // The engine can't apply durable writes in place.
+      inPlace(!cookie.getRequest(Cookie::PacketContent::Full)
+                       .getDurabilityRequirements()),
       datatype(uint8_t(req.getDatatype())) {
 }
 
@@ -48,6 +51,9 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::step() {
         case State::InflateInputData:
             ret = inflateInputData();
             break;
+        case State::MutateInPlace:
+            ret = mutateInPlace();
+            break;
         case State::GetItem:
             ret = getItem();
             break;
@@ -87,7 +93,7 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::validateInput() {
     if (mcbp::datatype::is_snappy(datatype)) {
         state = State::InflateInputData;
     } else {
-        state = State::GetItem;
+        state = getFetchState();
     }
     return ENGINE_SUCCESS;
 }
@@ -100,7 +106,7 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::inflateInputData() {
             return ENGINE_EINVAL;
         }
         value = inputbuffer;
-        state = State::GetItem;
+        state = getFetchState();
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -108,39 +114,57 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::inflateInputData() {
     return ENGINE_SUCCESS;
 }
 
+ENGINE_ERROR_CODE AppendPrependCommandContext::mutateInPlace() {
+    // Runs the same steps as the get / allocate path, but from within the
+    // engine and with the document locked; the engine then stores the new
+    // item under the same lock. The old value is shared with the engine's
+    // copy, so it's only copied once, into the new item.
+    auto mutator = [this](cb::unique_item_ptr current)
+            -> std::pair<cb::engine_errc, item*> {
+        if (!current) {
+            return {cb::engine_errc::no_such_key, nullptr};
+        }
+        olditem = std::move(current);
+        newitem.reset();
+        buffer.reset();
+
+        auto ret = prepareOldItem();
+        if (ret == ENGINE_SUCCESS) {
+            ret = allocateNewItem();
+        }
+        if (ret != ENGINE_SUCCESS) {
+            return {cb::engine_errc(ret), nullptr};
+        }
+        return {cb::engine_errc::success, newitem.get()};
+    };
+
+    auto ret = bucket_mutate_in_place(cookie, key, vbucket, mutator);
+    if (ret.status == cb::engine_errc::not_supported ||
+        (ret.status == cb::engine_errc::locked && cas != 0)) {
+        // A locked document may be updated with the CAS from locking it,
+        // which the get / CAS-store path handles.
+        inPlace = false;
+        state = State::GetItem;
+        return ENGINE_SUCCESS;
+    }
+
+    if (ret.status != cb::engine_errc::success) {
+        // If the engine is fetching the document (would block) the mutator
+        // wasn't called, and we start again from here once notified.
+        state = State::MutateInPlace;
+        return ENGINE_ERROR_CODE(ret.status);
+    }
+    return sendResponse(ret.cas);
+}
+
 ENGINE_ERROR_CODE AppendPrependCommandContext::getItem() {
     auto ret = bucket_get(cookie, key, vbucket);
     if (ret.first == cb::engine_errc::success) {
         olditem = std::move(ret.second);
-        if (!bucket_get_item_info(connection, olditem.get(), &oldItemInfo)) {
-            return ENGINE_FAILED;
-        }
 
-        if (cas != 0) {
-            if (oldItemInfo.cas == uint64_t(-1)) {
-                // The object in the cache is locked... lets try to use
-                // the cas provided by the user to override this
-                oldItemInfo.cas = cas;
-            } else if (cas != oldItemInfo.cas) {
-                return ENGINE_KEY_EEXISTS;
-            }
-        } else if (oldItemInfo.cas == uint64_t(-1)) {
-            return ENGINE_LOCKED;
-        }
-
-        if (mcbp::datatype::is_snappy(oldItemInfo.datatype)) {
-            try {
-                cb::const_char_buffer payload(static_cast<const char*>(
-                                              oldItemInfo.value[0].iov_base),
-                                              oldItemInfo.value[0].iov_len);
-                if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
-                                              payload,
-                                              buffer)) {
-                    return ENGINE_FAILED;
-                }
-            } catch (const std::bad_alloc&) {
-                return ENGINE_ENOMEM;
-            }
+        const auto status = prepareOldItem();
+        if (status != ENGINE_SUCCESS) {
+            return status;
         }
 
         // Move on to the next state
@@ -150,6 +174,41 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::getItem() {
     return ENGINE_ERROR_CODE(ret.first);
 }
 
+ENGINE_ERROR_CODE AppendPrependCommandContext::prepareOldItem() {
+    if (!bucket_get_item_info(connection, olditem.get(), &oldItemInfo)) {
+        return ENGINE_FAILED;
+    }
+
+    if (cas != 0) {
+        if (oldItemInfo.cas == uint64_t(-1)) {
+            // The object in the cache is locked... lets try to use
+            // the cas provided by the user to override this
+            oldItemInfo.cas = cas;
+        } else if (cas != oldItemInfo.cas) {
+            return ENGINE_KEY_EEXISTS;
+        }
+    } else if (oldItemInfo.cas == uint64_t(-1)) {
+        return ENGINE_LOCKED;
+    }
+
+    if (mcbp::datatype::is_snappy(oldItemInfo.datatype)) {
+        try {
+            cb::const_char_buffer payload(
+                    static_cast<const char*>(oldItemInfo.value[0].iov_base),
+                    oldItemInfo.value[0].iov_len);
+            if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                          payload,
+                                          buffer)) {
+                return ENGINE_FAILED;
+            }
+        } catch (const std::bad_alloc&) {
+            return ENGINE_ENOMEM;
+        }
+    }
+
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE AppendPrependCommandContext::allocateNewItem() {
     cb::char_buffer old{static_cast<char*>(oldItemInfo.value[0].iov_base),
                         oldItemInfo.nbytes};
@@ -229,27 +288,7 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::storeItem() {
                                     .getDurabilityRequirements());
 
     if (ret == ENGINE_SUCCESS) {
-        update_topkeys(cookie);
-        cookie.setCas(ncas);
-        if (connection.isSupportsMutationExtras()) {
-            item_info newItemInfo;
-            if (!bucket_get_item_info(
-                        connection, newitem.get(), &newItemInfo)) {
-                return ENGINE_FAILED;
-            }
-            extras.vbucket_uuid = htonll(newItemInfo.vbucket_uuid);
-            extras.seqno = htonll(newItemInfo.seqno);
-            cookie.sendResponse(
-                    cb::mcbp::Status::Success,
-                    {reinterpret_cast<const char*>(&extras), sizeof(extras)},
-                    {},
-                    {},
-                    cb::mcbp::Datatype::Raw,
-                    ncas);
-        } else {
-            cookie.sendResponse(cb::mcbp::Status::Success);
-        }
-        state = State::Done;
+        ret = sendResponse(ncas);
     } else if (ret == ENGINE_KEY_EEXISTS && cas == 0) {
         state = State::Reset;
         // We need to return ENGINE_SUCCESS in order to continue processing
@@ -259,6 +298,30 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::storeItem() {
     return ret;
 }
 
+ENGINE_ERROR_CODE AppendPrependCommandContext::sendResponse(uint64_t ncas) {
+    update_topkeys(cookie, value.len);
+    cookie.setCas(ncas);
+    if (connection.isSupportsMutationExtras()) {
+        item_info newItemInfo;
+        if (!bucket_get_item_info(connection, newitem.get(), &newItemInfo)) {
+            return ENGINE_FAILED;
+        }
+        extras.vbucket_uuid = htonll(newItemInfo.vbucket_uuid);
+        extras.seqno = htonll(newItemInfo.seqno);
+        cookie.sendResponse(
+                cb::mcbp::Status::Success,
+                {reinterpret_cast<const char*>(&extras), sizeof(extras)},
+                {},
+                {},
+                cb::mcbp::Datatype::Raw,
+                ncas);
+    } else {
+        cookie.sendResponse(cb::mcbp::Status::Success);
+    }
+    state = State::Done;
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE AppendPrependCommandContext::reset() {
     olditem.reset();
     newitem.reset();
@@ -43,6 +43,10 @@ public:
         // If the client sends compressed data we need to inflate the
         // input data before we can do anything
             InflateInputData,
+        // Have the engine apply the append / prepend to the document in
+        // place (see EngineIface::mutate_in_place), with the document
+        // locked against other updates
+            MutateInPlace,
         // Look up the item to operate on
             GetItem,
         // Allocate the destination object
@@ -69,14 +73,30 @@ protected:
 
     ENGINE_ERROR_CODE inflateInputData();
 
+    ENGINE_ERROR_CODE mutateInPlace();
+
     ENGINE_ERROR_CODE getItem();
 
+    /**
+     * Check the CAS of the current document (olditem) and inflate its value
+     * if it's compressed.
+     */
+    ENGINE_ERROR_CODE prepareOldItem();
+
     ENGINE_ERROR_CODE allocateNewItem();
 
     ENGINE_ERROR_CODE storeItem();
 
     ENGINE_ERROR_CODE reset();
 
+    /// Send the response for the stored document
+    ENGINE_ERROR_CODE sendResponse(uint64_t ncas);
+
+    /// The state which fetches the document to operate on
+    State getFetchState() const {
+        return inPlace ? State::MutateInPlace : State::GetItem;
+    }
+
 private:
     const Mode mode;
     const DocKey key;
@@ -93,6 +113,10 @@ private:
     cb::compression::Buffer inputbuffer;
     State state;
 
+    // Try to have the engine mutate the document in place; cleared if the
+    // engine doesn't support it (or can't for this request).
+    bool inPlace;
+
     // The extras section is used as a buffer to hold extra meta information
     // about the mutation while it is being sent back to the client iff the
     // client requested them (as the context object have the same lifetime
@@ -37,6 +37,64 @@ ArithmeticCommandContext::ArithmeticCommandContext(Cookie& cookie,
       vbucket(req.getVBucket()),
       increment(req.getClientOpcode() == cb::mcbp::ClientOpcode::Increment ||
                 req.getClientOpcode() == cb::mcbp::ClientOpcode::Incrementq) {
+    // The engine can't apply durable writes in place.
+    if (cookie.getRequest(Cookie::PacketContent::Full)
+                .getDurabilityRequirements()) {
+        state = State::GetItem;
+    }
+}
+
+ENGINE_ERROR_CODE ArithmeticCommandContext::mutateInPlace() {
+    // Runs the same steps as the get / allocate path, but from within the
+    // engine and with the document locked; the engine then stores the new
+    // item under the same lock.
+    auto mutator = [this](cb::unique_item_ptr current)
+            -> std::pair<cb::engine_errc, item*> {
+        olditem = std::move(current);
+        newitem.reset();
+        buffer.reset();
+
+        ENGINE_ERROR_CODE ret;
+        if (olditem) {
+            ret = prepareOldItem();
+            if (ret == ENGINE_SUCCESS) {
+                ret = allocateNewItem();
+            }
+        } else if (extras.getExpiration() == 0xffffffff) {
+            if (increment) {
+                STATS_INCR(&connection, incr_misses);
+            } else {
+                STATS_INCR(&connection, decr_misses);
+            }
+            ret = ENGINE_KEY_ENOENT;
+        } else if (cas != 0) {
+            // As an add with a CAS
+            ret = ENGINE_NOT_STORED;
+        } else {
+            ret = createNewItem();
+        }
+
+        if (ret != ENGINE_SUCCESS) {
+            return {cb::engine_errc(ret), nullptr};
+        }
+        return {cb::engine_errc::success, newitem.get()};
+    };
+
+    auto ret = bucket_mutate_in_place(cookie, key, vbucket, mutator);
+    if (ret.status == cb::engine_errc::not_supported) {
+        state = State::GetItem;
+        return ENGINE_SUCCESS;
+    }
+
+    if (ret.status == cb::engine_errc::success) {
+        cookie.setCas(ret.cas);
+        state = State::SendResult;
+    } else {
+        // If the engine is fetching the document (would block) the mutator
+        // wasn't called, and we start again from here once notified.
+        state = State::MutateInPlace;
+    }
+    return ENGINE_ERROR_CODE(ret.status);
 }
 
 ENGINE_ERROR_CODE ArithmeticCommandContext::getItem() {
@@ -44,29 +102,9 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::getItem() {
     if (ret.first == cb::engine_errc::success) {
         olditem = std::move(ret.second);
 
-        if (!bucket_get_item_info(connection, olditem.get(), &oldItemInfo)) {
-            return ENGINE_FAILED;
-        }
-
-        uint64_t oldcas = oldItemInfo.cas;
-        if (cas != 0 && cas != oldcas) {
-            return ENGINE_KEY_EEXISTS;
-        }
-
-        if (mcbp::datatype::is_snappy(oldItemInfo.datatype)) {
-            try {
-                cb::const_char_buffer payload(static_cast<const char*>(
-                                              oldItemInfo.value[0].iov_base),
-                                              oldItemInfo.value[0].iov_len);
-                if (!cb::compression::inflate(
-                    cb::compression::Algorithm::Snappy,
-                    payload,
-                    buffer)) {
-                    return ENGINE_FAILED;
-                }
-            } catch (const std::bad_alloc&) {
-                return ENGINE_ENOMEM;
-            }
+        const auto status = prepareOldItem();
+        if (status != ENGINE_SUCCESS) {
+            return status;
         }
 
         // Move on to the next state
@@ -87,6 +125,34 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::getItem() {
     return ENGINE_ERROR_CODE(ret.first);
 }
 
+ENGINE_ERROR_CODE ArithmeticCommandContext::prepareOldItem() {
+    if (!bucket_get_item_info(connection, olditem.get(), &oldItemInfo)) {
+        return ENGINE_FAILED;
+    }
+
+    uint64_t oldcas = oldItemInfo.cas;
+    if (cas != 0 && cas != oldcas) {
+        return ENGINE_KEY_EEXISTS;
+    }
+
+    if (mcbp::datatype::is_snappy(oldItemInfo.datatype)) {
+        try {
+            cb::const_char_buffer payload(
+                    static_cast<const char*>(oldItemInfo.value[0].iov_base),
+                    oldItemInfo.value[0].iov_len);
+            if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                          payload,
+                                          buffer)) {
+                return ENGINE_FAILED;
+            }
+        } catch (const std::bad_alloc&) {
+            return ENGINE_ENOMEM;
+        }
+    }
+
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE ArithmeticCommandContext::createNewItem() {
     const std::string value{std::to_string(extras.getInitial())};
     result = extras.getInitial();
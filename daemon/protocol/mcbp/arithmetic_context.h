@@ -36,8 +36,15 @@ class ArithmeticCommandContext : public SteppableCommandContext {
 public:
     /**
      * The internal state diagram for performing an arithmetic operation.
-     * We've got two different paths through the state diagram depending
-     * if the counter exists or not:
+     *
+     * If the engine supports it the operation is applied to the document
+     * in place (see EngineIface::mutate_in_place), with the document
+     * locked, so it can't race with other updates:
+     *
+     *    MutateInPlace -> SendResult -> Done
+     *
+     * Otherwise (and for durable writes) we've got two different paths
+     * through the state diagram depending if the counter exists or not:
      *
      * If the document exists:
      *
@@ -57,6 +64,7 @@ public:
      * forever we give up after a 10 times.
      */
     enum class State {
+        MutateInPlace,
         GetItem,
         CreateNewItem,
         StoreNewItem,
@@ -78,6 +86,9 @@ protected:
         auto ret = ENGINE_SUCCESS;
         do {
             switch (state) {
+            case State::MutateInPlace:
+                ret = mutateInPlace();
+                break;
             case State::GetItem:
                 ret = getItem();
                 break;
@@ -107,8 +118,16 @@ protected:
         return ret;
     }
 
+    ENGINE_ERROR_CODE mutateInPlace();
+
     ENGINE_ERROR_CODE getItem();
 
+    /**
+     * Check the CAS of the current document (olditem) and inflate its value
+     * if it's compressed.
+     */
+    ENGINE_ERROR_CODE prepareOldItem();
+
     ENGINE_ERROR_CODE createNewItem();
 
     ENGINE_ERROR_CODE storeNewItem();
@@ -133,5 +152,5 @@ private:
     cb::unique_item_ptr newitem;
     cb::compression::Buffer buffer;
     uint64_t result = 0;
-    State state = State::GetItem;
+    State state = State::MutateInPlace;
 };
@@ -48,12 +48,10 @@ void get_cluster_config_executor(Cookie& cookie) {
     if (pair.first == -1) {
         cookie.sendResponse(cb::mcbp::Status::KeyEnoent);
     } else {
-        cookie.sendResponse(cb::mcbp::Status::Success,
-                            {},
-                            {},
-                            {pair.second->data(), pair.second->size()},
-                            cb::mcbp::Datatype::JSON,
-                            0);
+        cookie.setCas(0);
+        cookie.sendClusterConfig(cb::mcbp::Status::Success,
+                                 std::move(pair.second),
+                                 cb::mcbp::Datatype::JSON);
         connection.setClustermapRevno(pair.first);
     }
 }
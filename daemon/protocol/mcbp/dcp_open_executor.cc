@@ -18,6 +18,7 @@
 #include "engine_wrapper.h"
 #include "executors.h"
 #include "utilities.h"
+#include <daemon/front_end_thread.h>
 #include <daemon/mcaudit.h>
 #include <daemon/mcbp.h>
 #include <logger/logger.h>
@@ -106,6 +107,7 @@ void dcp_open_executor(Cookie& cookie) {
 
         audit_dcp_open(&connection);
         cookie.sendResponse(cb::mcbp::Status::Success);
+        request_dcp_thread(connection);
         break;
     }
 
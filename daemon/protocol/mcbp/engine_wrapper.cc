@@ -136,6 +136,25 @@ cb::EngineErrorCasPair bucket_store_if(
     return ret;
 }
 
+cb::EngineErrorCasPair bucket_mutate_in_place(Cookie& cookie,
+                                              const DocKey& key,
+                                              Vbid vbucket,
+                                              cb::DocumentMutator mutator) {
+    auto& c = cookie.getConnection();
+    auto ret = c.getBucketEngine()->mutate_in_place(
+            &cookie, key, vbucket, std::move(mutator));
+    if (ret.status == cb::engine_errc::success) {
+        using namespace cb::audit::document;
+        add(cookie, Operation::Modify);
+    } else if (ret.status == cb::engine_errc::disconnect) {
+        LOG_WARNING("{}: {} mutate_in_place return ENGINE_DISCONNECT",
+                    c.getId(),
+                    c.getDescription());
+    }
+
+    return ret;
+}
+
 ENGINE_ERROR_CODE bucket_remove(
         Cookie& cookie,
         const DocKey& key,
@@ -172,6 +191,14 @@ cb::EngineErrorItemPair bucket_get(Cookie& cookie,
     return ret;
 }
 
+std::vector<cb::EngineErrorItemPair> bucket_get_multi(
+        Cookie& cookie,
+        const std::vector<std::pair<DocKey, Vbid>>& keys,
+        DocStateFilter documentStateFilter) {
+    auto& c = cookie.getConnection();
+    return c.getBucketEngine()->get_multi(&cookie, keys, documentStateFilter);
+}
+
 BucketCompressionMode bucket_get_compression_mode(Cookie& cookie) {
     auto& c = cookie.getConnection();
     return c.getBucketEngine()->getCompressionMode();
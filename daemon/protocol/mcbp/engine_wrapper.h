@@ -70,6 +70,11 @@ cb::EngineErrorCasPair bucket_store_if(
         boost::optional<cb::durability::Requirements> durability,
         DocumentState document_state = DocumentState::Alive);
 
+cb::EngineErrorCasPair bucket_mutate_in_place(Cookie& cookie,
+                                              const DocKey& key,
+                                              Vbid vbucket,
+                                              cb::DocumentMutator mutator);
+
 ENGINE_ERROR_CODE bucket_remove(
         Cookie& cookie,
         const DocKey& key,
@@ -84,6 +89,15 @@ cb::EngineErrorItemPair bucket_get(
         Vbid vbucket,
         DocStateFilter documentStateFilter = DocStateFilter::Alive);
 
+/**
+ * Look up multiple keys in one call to the engine; see
+ * EngineIface::get_multi().
+ */
+std::vector<cb::EngineErrorItemPair> bucket_get_multi(
+        Cookie& cookie,
+        const std::vector<std::pair<DocKey, Vbid>>& keys,
+        DocStateFilter documentStateFilter = DocStateFilter::Alive);
+
 cb::EngineErrorItemPair bucket_get_if(
         Cookie& cookie,
         const DocKey& key,
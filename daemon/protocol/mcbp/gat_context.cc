@@ -94,6 +94,7 @@ ENGINE_ERROR_CODE GatCommandContext::inflateItem() {
             return ENGINE_FAILED;
         }
         payload = buffer;
+        STATS_INCR(&connection, get_value_copies);
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -104,7 +105,7 @@ ENGINE_ERROR_CODE GatCommandContext::inflateItem() {
 
 ENGINE_ERROR_CODE GatCommandContext::sendResponse() {
     STATS_HIT(&connection, get);
-    update_topkeys(cookie);
+    update_topkeys(cookie, payload.len);
 
     // Audit the modification to the document (change of EXP)
     cb::audit::document::add(cookie, cb::audit::document::Operation::Modify);
@@ -134,11 +135,18 @@ ENGINE_ERROR_CODE GatCommandContext::sendResponse() {
                     bodylen,
                     datatype);
 
-    // Add the flags
-    connection.addIov(&info.flags, sizeof(info.flags));
+    // Add the flags (copied, as they live in the context)
+    connection.addIovCopy(&info.flags, sizeof(info.flags));
     // Add the value
     connection.addIov(payload.buf, payload.len);
     connection.setState(StateMachine::State::send_data);
+
+    // Let the connection keep the item until the response is sent, so
+    // that the response may be held back (see Connection::holdResponse)
+    if (connection.reserveItem(it.get())) {
+        it.release();
+        connection.setResponseHoldable();
+    }
     cb::audit::document::add(cookie, cb::audit::document::Operation::Read);
     state = State::Done;
     return ENGINE_SUCCESS;
@@ -34,7 +34,7 @@
  *         and the second being the histogram (only valid if the first
  *         parameter is ENGINE_SUCCESS)
  */
-static std::pair<ENGINE_ERROR_CODE, TimingHistogram> get_timings(
+static std::pair<ENGINE_ERROR_CODE, HdrHistogram> get_timings(
         Cookie& cookie, const Bucket& bucket, uint8_t opcode) {
     // Don't creata a new privilege context if the one we've got is for the
     // connected bucket:
@@ -43,7 +43,7 @@ static std::pair<ENGINE_ERROR_CODE, TimingHistogram> get_timings(
         auto ret = mcbp::checkPrivilege(cookie,
                                         cb::rbac::Privilege::SimpleStats);
         if (ret != ENGINE_SUCCESS) {
-            return std::make_pair(ENGINE_EACCESS, TimingHistogram{});
+            return std::make_pair(ENGINE_EACCESS, Timings::makeHistogram());
         }
     } else {
         // Check to see if we've got access to the bucket
@@ -61,7 +61,7 @@ static std::pair<ENGINE_ERROR_CODE, TimingHistogram> get_timings(
         }
 
         if (!access) {
-            return std::make_pair(ENGINE_EACCESS, TimingHistogram{});
+            return std::make_pair(ENGINE_EACCESS, Timings::makeHistogram());
         }
     }
 
@@ -80,10 +80,11 @@ static std::pair<ENGINE_ERROR_CODE, TimingHistogram> get_timings(
  * @param opcode The opcode we're interested in
  * @param bucketname The name of the bucket we want
  */
-static std::pair<ENGINE_ERROR_CODE, TimingHistogram> maybe_get_timings(
+static std::pair<ENGINE_ERROR_CODE, HdrHistogram> maybe_get_timings(
     Cookie& cookie, const Bucket& bucket, uint8_t opcode, const std::string& bucketname) {
 
-    std::pair<ENGINE_ERROR_CODE, TimingHistogram> ret = std::make_pair(ENGINE_KEY_ENOENT, TimingHistogram{});
+    std::pair<ENGINE_ERROR_CODE, HdrHistogram> ret =
+            std::make_pair(ENGINE_KEY_ENOENT, Timings::makeHistogram());
     std::lock_guard<std::mutex> guard(bucket.mutex);
     if (bucket.type != BucketType::NoBucket &&
         bucket.state == BucketState::Ready && bucketname == bucket.name) {
@@ -99,7 +100,7 @@ static std::pair<ENGINE_ERROR_CODE, TimingHistogram> maybe_get_timings(
  */
 static std::pair<ENGINE_ERROR_CODE, std::string> get_aggregated_timings(
         Cookie& cookie, uint8_t opcode) {
-    TimingHistogram timings;
+    auto timings = Timings::makeHistogram();
     bool found = false;
 
     for (auto& bucket : all_buckets) {
@@ -111,7 +112,7 @@ static std::pair<ENGINE_ERROR_CODE, std::string> get_aggregated_timings(
     }
 
     if (found) {
-        return std::make_pair(ENGINE_SUCCESS, timings.to_string());
+        return std::make_pair(ENGINE_SUCCESS, Timings::to_string(timings));
     }
 
     // We didn't have access to any buckets!
@@ -140,14 +141,15 @@ std::pair<ENGINE_ERROR_CODE, std::string> get_cmd_timer(Cookie& cookie) {
         auto& connection = cookie.getConnection();
         auto bt = get_timings(cookie, connection.getBucket(), opcode);
         if (bt.first == ENGINE_SUCCESS) {
-            return std::make_pair(ENGINE_SUCCESS, bt.second.to_string());
+            return std::make_pair(ENGINE_SUCCESS,
+                                  Timings::to_string(bt.second));
         }
 
         return std::make_pair(bt.first, std::string{});
     }
 
     // The user specified a bucket... let's locate the bucket
-    std::pair<ENGINE_ERROR_CODE, TimingHistogram> ret;
+    auto ret = std::make_pair(ENGINE_KEY_ENOENT, Timings::makeHistogram());
 
     for (auto& b : all_buckets) {
         ret = maybe_get_timings(cookie, b, opcode, bucket);
@@ -157,7 +159,7 @@ std::pair<ENGINE_ERROR_CODE, std::string> get_cmd_timer(Cookie& cookie) {
     }
 
     if (ret.first == ENGINE_SUCCESS) {
-        return std::make_pair(ENGINE_SUCCESS, ret.second.to_string());
+        return std::make_pair(ENGINE_SUCCESS, Timings::to_string(ret.second));
     }
 
     if (ret.first == ENGINE_KEY_ENOENT) {
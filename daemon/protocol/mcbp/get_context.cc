@@ -27,9 +27,85 @@
 #include <xattr/utils.h>
 #include <gsl/gsl>
 
+bool GetCommandContext::isPipelinable(const cb::mcbp::Request& request) {
+    // Only plain GETs (no framing extras, extras or value) are looked up
+    // ahead of their execution.
+    if (request.getMagic() != cb::mcbp::Magic::ClientRequest) {
+        return false;
+    }
+    switch (request.getClientOpcode()) {
+    case cb::mcbp::ClientOpcode::Get:
+    case cb::mcbp::ClientOpcode::Getq:
+    case cb::mcbp::ClientOpcode::Getk:
+    case cb::mcbp::ClientOpcode::Getkq:
+        break;
+    default:
+        return false;
+    }
+    return request.getExtlen() == 0 && request.getKeylen() != 0 &&
+           request.getBodylen() == request.getKeylen();
+}
+
+cb::EngineErrorItemPair GetCommandContext::lookup(const DocKey& key) {
+    if (!lookedUp) {
+        lookedUp = true;
+        auto ret = connection.takePrefetchedGet(cookie.getRequest());
+        if (ret.first == cb::engine_errc::would_block) {
+            ret = lookupPipeline(key);
+        }
+        // Any other status goes through the normal path, so the
+        // engine can block / set the error context etc. for this cookie.
+        if (ret.first == cb::engine_errc::success ||
+            ret.first == cb::engine_errc::no_such_key) {
+            return ret;
+        }
+    }
+    return bucket_get(cookie, key, vbucket);
+}
+
+cb::EngineErrorItemPair GetCommandContext::lookupPipeline(const DocKey& key) {
+    const auto& request = cookie.getRequest();
+    if (!isPipelinable(request)) {
+        return cb::makeEngineErrorItemPair(cb::engine_errc::would_block);
+    }
+
+    // The input buffer starts with the request being executed; look for
+    // complete pipelinable requests following it.
+    std::vector<std::pair<DocKey, Vbid>> keys{{key, vbucket}};
+    std::vector<const cb::mcbp::Request*> following;
+    const auto input = connection.read->rdata();
+    size_t offset = cookie.getPacket().size();
+    while (keys.size() < MaxPipelineSize &&
+           input.size() - offset >= sizeof(cb::mcbp::Request)) {
+        const auto* next = reinterpret_cast<const cb::mcbp::Request*>(
+                input.data() + offset);
+        const size_t size = sizeof(cb::mcbp::Request) + next->getBodylen();
+        if (input.size() - offset < size || !isPipelinable(*next)) {
+            break;
+        }
+        keys.emplace_back(connection.makeDocKey(next->getKey()),
+                          next->getVBucket());
+        following.push_back(next);
+        offset += size;
+    }
+
+    if (following.empty()) {
+        return cb::makeEngineErrorItemPair(cb::engine_errc::would_block);
+    }
+
+    auto results = bucket_get_multi(cookie, keys);
+    if (results.size() != keys.size()) {
+        return cb::makeEngineErrorItemPair(cb::engine_errc::would_block);
+    }
+    for (size_t ii = 0; ii < following.size(); ++ii) {
+        connection.addPrefetchedGet(*following[ii], std::move(results[ii + 1]));
+    }
+    return std::move(results.front());
+}
+
 ENGINE_ERROR_CODE GetCommandContext::getItem() {
     const auto key = cookie.getRequestKey();
-    auto ret = bucket_get(cookie, key, vbucket);
+    auto ret = lookup(key);
     if (ret.first == cb::engine_errc::success) {
         it = std::move(ret.second);
         if (!bucket_get_item_info(connection, it.get(), &info)) {
@@ -67,6 +143,7 @@ ENGINE_ERROR_CODE GetCommandContext::inflateItem() {
             return ENGINE_FAILED;
         }
         payload = buffer;
+        STATS_INCR(&connection, get_value_copies);
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -107,8 +184,8 @@ ENGINE_ERROR_CODE GetCommandContext::sendResponse() {
                     bodylen,
                     datatype);
 
-    // Add the flags
-    connection.addIov(&info.flags, sizeof(info.flags));
+    // Add the flags (copied, as they live in the context)
+    connection.addIovCopy(&info.flags, sizeof(info.flags));
 
     // Add the value
     if (shouldSendKey()) {
@@ -117,10 +194,17 @@ ENGINE_ERROR_CODE GetCommandContext::sendResponse() {
 
     connection.addIov(payload.buf, payload.len);
     connection.setState(StateMachine::State::send_data);
+
+    // Let the connection keep the item until the response is sent, so
+    // that the response may be held back (see Connection::holdResponse)
+    if (connection.reserveItem(it.get())) {
+        it.release();
+        connection.setResponseHoldable();
+    }
     cb::audit::document::add(cookie, cb::audit::document::Operation::Read);
 
     STATS_HIT(&connection, get);
-    update_topkeys(cookie);
+    update_topkeys(cookie, payload.len);
 
     state = State::Done;
     return ENGINE_SUCCESS;
@@ -47,6 +47,18 @@ public:
           state(State::GetItem) {
     }
 
+    /**
+     * The maximum number of GET requests (including the one being executed)
+     * looked up in a single call to the engine.
+     */
+    static constexpr size_t MaxPipelineSize = 32;
+
+    /**
+     * @return true if the request is a GET-family request which may be
+     *         looked up as part of a pipeline (see lookupPipeline()).
+     */
+    static bool isPipelinable(const cb::mcbp::Request& request);
+
 protected:
     /**
      * Keep running the state machine.
@@ -89,6 +101,26 @@ protected:
      */
     ENGINE_ERROR_CODE getItem();
 
+    /**
+     * Look up the requested key. On the first attempt uses the result
+     * prefetched by an earlier GET in the pipeline if there is one, or else
+     * looks up this key along with any pipelinable GETs which directly follow
+     * it in the input buffer (see lookupPipeline()).
+     */
+    cb::EngineErrorItemPair lookup(const DocKey& key);
+
+    /**
+     * Look up the requested key along with the keys of the pipelinable GET
+     * requests which directly follow it in the input buffer, with a single
+     * call to the engine's get_multi(). The results for the following
+     * requests are recorded in the connection, to be used when they are
+     * executed.
+     *
+     * @return the result for this request; engine_errc::would_block if no
+     *         lookup was made (or the engine couldn't serve it immediately)
+     */
+    cb::EngineErrorItemPair lookupPipeline(const DocKey& key);
+
     /**
      * Handle the case where the item isn't found. If the client don't want
      * to be notified about misses we'd just update the stats. Otherwise
@@ -130,4 +162,7 @@ private:
     cb::const_char_buffer payload;
     cb::compression::Buffer buffer;
     State state;
+
+    /// Set once getItem() has been called (it is called again if blocked).
+    bool lookedUp = false;
 };
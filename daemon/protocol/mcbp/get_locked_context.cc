@@ -72,6 +72,7 @@ ENGINE_ERROR_CODE GetLockedCommandContext::inflateItem() {
             return ENGINE_FAILED;
         }
         payload = buffer;
+        STATS_INCR(&connection, get_value_copies);
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -108,7 +109,7 @@ ENGINE_ERROR_CODE GetLockedCommandContext::sendResponse() {
     connection.setState(StateMachine::State::send_data);
 
     STATS_INCR(&connection, cmd_lock);
-    update_topkeys(cookie);
+    update_topkeys(cookie, payload.len);
 
     state = State::Done;
     return ENGINE_SUCCESS;
@@ -33,7 +33,9 @@ MutationCommandContext::MutationCommandContext(Cookie& cookie,
     : SteppableCommandContext(cookie),
       operation(req.getCas() == 0 ? op_ : OPERATION_CAS),
       key(cookie.getRequestKey()),
-      value(req.getValue()),
+      value(cookie.hasStreamedValue() ? cookie.getStreamedValue()
+                                      : req.getValue()),
+      streamedItem(cookie.takeStreamedItem()),
       vbucket(req.getVBucket()),
       input_cas(req.getCas()),
       extras(*reinterpret_cast<const cb::mcbp::request::MutationPayload*>(
@@ -225,6 +227,19 @@ ENGINE_ERROR_CODE MutationCommandContext::allocateNewItem() {
         dtype &= ~PROTOCOL_BINARY_DATATYPE_SNAPPY;
     }
 
+    if (streamedItem && existingXattrs.size() == 0 &&
+        value.data() != reinterpret_cast<const uint8_t*>(
+                                decompressed_value.data())) {
+        // The value was read off the network straight into an item of the
+        // right size; all that may have changed is the datatype
+        bucket_item_set_datatype(connection, streamedItem.get(), dtype);
+        newitem = std::move(streamedItem);
+        usingStreamedItem = true;
+        setNewItemCas();
+        state = State::StoreItem;
+        return ENGINE_SUCCESS;
+    }
+
     size_t total_size = value.size() + existingXattrs.size();
     if (existingXattrs.size() > 0 && mcbp::datatype::is_snappy(datatype)) {
         total_size = decompressed_value.size() + existingXattrs.size();
@@ -250,15 +265,7 @@ ENGINE_ERROR_CODE MutationCommandContext::allocateNewItem() {
         return ENGINE_ERROR_CODE(e.code().value());
     }
 
-    if (operation == OPERATION_ADD || input_cas != 0) {
-        bucket_item_set_cas(connection, newitem.get(), input_cas);
-    } else {
-        if (existing) {
-            bucket_item_set_cas(connection, newitem.get(), existing_info.cas);
-        } else {
-            bucket_item_set_cas(connection, newitem.get(), input_cas);
-        }
-    }
+    setNewItemCas();
 
     auto* root = reinterpret_cast<uint8_t*>(newitem_info.value[0].iov_base);
     if (existingXattrs.size() > 0) {
@@ -285,6 +292,18 @@ ENGINE_ERROR_CODE MutationCommandContext::allocateNewItem() {
     return ENGINE_SUCCESS;
 }
 
+void MutationCommandContext::setNewItemCas() {
+    if (operation == OPERATION_ADD || input_cas != 0) {
+        bucket_item_set_cas(connection, newitem.get(), input_cas);
+    } else {
+        if (existing) {
+            bucket_item_set_cas(connection, newitem.get(), existing_info.cas);
+        } else {
+            bucket_item_set_cas(connection, newitem.get(), input_cas);
+        }
+    }
+}
+
 ENGINE_ERROR_CODE MutationCommandContext::storeItem() {
     const auto& request = cookie.getRequest(Cookie::PacketContent::Full);
     auto ret = bucket_store_if(cookie,
@@ -324,7 +343,7 @@ ENGINE_ERROR_CODE MutationCommandContext::storeItem() {
 }
 
 ENGINE_ERROR_CODE MutationCommandContext::sendResponse() {
-    update_topkeys(cookie);
+    update_topkeys(cookie, value.size());
     state = State::Done;
 
     if (cookie.getRequest().isQuiet()) {
@@ -362,6 +381,11 @@ ENGINE_ERROR_CODE MutationCommandContext::sendResponse() {
 }
 
 ENGINE_ERROR_CODE MutationCommandContext::reset() {
+    if (usingStreamedItem) {
+        // Hang on to the value for the retry
+        streamedItem = std::move(newitem);
+        usingStreamedItem = false;
+    }
     newitem.reset();
     existing.reset();
     existingXattrs.assign({nullptr, 0}, false);
@@ -85,6 +85,9 @@ protected:
      */
     ENGINE_ERROR_CODE allocateNewItem();
 
+    /// Set the CAS of the new document to the one to store it with
+    void setNewItemCas();
+
     /**
      * Store the newly created document in the engine
      *
@@ -113,6 +116,15 @@ private:
     const DocKey key;
     cb::const_byte_buffer value;
 
+    /// The item the value was received into, if it was large enough to be
+    /// read off the network straight into an item (see
+    /// Cookie::setStreamedValue). It becomes the new document unless
+    /// XATTRs need to be preserved or the value was decompressed.
+    cb::unique_item_ptr streamedItem;
+
+    /// Set while newitem is the streamedItem
+    bool usingStreamedItem = false;
+
     /// If the incoming value was compressed; then this will hold the
     /// decompressed form of it once the validateInput() state has been
     // executed.
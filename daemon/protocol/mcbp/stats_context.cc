@@ -23,12 +23,14 @@
 #include "utilities.h"
 
 #include <daemon/buckets.h>
+#include <daemon/buffer_pool.h>
 #include <daemon/connection.h>
 #include <daemon/cookie.h>
 #include <daemon/executorpool.h>
 #include <daemon/mc_time.h>
 #include <daemon/mcaudit.h>
 #include <daemon/memcached.h>
+#include <daemon/prometheus.h>
 #include <daemon/runtime.h>
 #include <daemon/settings.h>
 #include <daemon/stats.h>
@@ -43,6 +45,7 @@
 #include <platform/checked_snprintf.h>
 
 #include <gsl/gsl>
+#include <cstdlib>
 
 /*************************** ADD STAT CALLBACKS ***************************/
 
@@ -204,6 +207,10 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
                  thread_stats.bytes_subdoc_mutation_total);
         add_stat(cookie, add_stat_callback, "bytes_subdoc_mutation_inserted",
                  thread_stats.bytes_subdoc_mutation_inserted);
+        add_stat(cookie, add_stat_callback, "subdoc_path_cache_hits",
+                 thread_stats.subdoc_path_cache_hits);
+        add_stat(cookie, add_stat_callback, "subdoc_path_cache_misses",
+                 thread_stats.subdoc_path_cache_misses);
 
         // index 0 contains the aggregated timings for all buckets
         auto& timings = all_buckets[0].timings;
@@ -228,6 +235,23 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
         add_stat(cookie, add_stat_callback, "cas_hits", thread_stats.cas_hits);
         add_stat(cookie, add_stat_callback, "cas_badval", thread_stats.cas_badval);
         add_stat(cookie, add_stat_callback, "bytes_read", thread_stats.bytes_read);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "read_syscalls",
+                 thread_stats.read_syscalls);
+        add_stat(cookie, add_stat_callback, "cmds_read", thread_stats.cmds_read);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "write_syscalls",
+                 thread_stats.write_syscalls);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "responses_held",
+                 thread_stats.responses_held);
+
+        const auto pool = BufferPool::getStats();
+        add_stat(cookie, add_stat_callback, "buffer_pool_hits", pool.hits);
+        add_stat(cookie, add_stat_callback, "buffer_pool_misses", pool.misses);
         add_stat(cookie, add_stat_callback, "bytes_written",
                  thread_stats.bytes_written);
         add_stat(cookie, add_stat_callback, "accepting_conns",
@@ -259,6 +283,10 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
         add_stat(cookie, add_stat_callback, "cmd_lock", thread_stats.cmd_lock);
         add_stat(cookie, add_stat_callback, "lock_errors",
                  thread_stats.lock_errors);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "get_value_copies",
+                 thread_stats.get_value_copies);
 
         auto lookup_latency = timings.get_interval_lookup_latency();
         add_stat(cookie, add_stat_callback, "cmd_lookup_10s_count",
@@ -281,6 +309,10 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
                  add_stat_callback,
                  "total_resp_errors",
                  total_resp_errors);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "log_messages_suppressed",
+                 cb::logger::RateLimiter::getTotalSuppressed());
 
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
@@ -330,6 +362,12 @@ static void process_stat_settings(ADD_STAT add_stat_callback, Cookie& cookie) {
             checked_snprintf(interface + offset, sizeof(interface) - offset,
                              "-management");
             add_stat(cookie, add_stat_callback, interface, ifce.management);
+            if (!ifce.path.empty()) {
+                checked_snprintf(interface + offset,
+                                 sizeof(interface) - offset,
+                                 "-path");
+                add_stat(cookie, add_stat_callback, interface, ifce.path);
+            }
 
             if (ifce.ssl.enabled) {
                 checked_snprintf(interface + offset, sizeof(interface) - offset,
@@ -351,6 +389,14 @@ static void process_stat_settings(ADD_STAT add_stat_callback, Cookie& cookie) {
 
     add_stat(cookie, add_stat_callback, "verbosity", settings.getVerbose());
     add_stat(cookie, add_stat_callback, "num_threads", settings.getNumWorkerThreads());
+    add_stat(cookie,
+             add_stat_callback,
+             "num_dcp_threads",
+             settings.getNumDcpThreads());
+    add_stat(cookie,
+             add_stat_callback,
+             "num_worker_thread_groups",
+             settings.getNumWorkerThreadGroups());
     add_stat(cookie, add_stat_callback, "reqs_per_event_high_priority",
              settings.getRequestsPerEventNotification(EventPriority::High));
     add_stat(cookie, add_stat_callback, "reqs_per_event_med_priority",
@@ -379,6 +425,12 @@ static void process_stat_settings(ADD_STAT add_stat_callback, Cookie& cookie) {
              settings.isDedupeNmvbMaps() ? "true" : "false");
     add_stat(cookie, add_stat_callback, "max_packet_size",
              std::to_string(settings.getMaxPacketSize()).c_str());
+    add_stat(cookie, add_stat_callback, "streamed_value_threshold",
+             std::to_string(settings.getStreamedValueThreshold()).c_str());
+    add_stat(cookie, add_stat_callback, "subdoc_path_cache_size",
+             std::to_string(settings.getSubdocPathCacheSize()).c_str());
+    add_stat(cookie, add_stat_callback, "trace_sample_rate",
+             std::to_string(settings.getTraceSampleRate()).c_str());
     add_stat(cookie, add_stat_callback, "xattr_enabled",
             settings.isXattrEnabled());
     add_stat(cookie, add_stat_callback, "privilege_debug",
@@ -505,7 +557,7 @@ static ENGINE_ERROR_CODE stat_reset_executor(const std::string& arg,
 static ENGINE_ERROR_CODE stat_sched_executor(const std::string& arg,
                                              Cookie& cookie) {
     if (arg.empty()) {
-        for (size_t ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+        for (size_t ii = 0; ii < settings.getNumFrontEndThreads(); ++ii) {
             auto hist = scheduler_info[ii].to_string();
             std::string key = std::to_string(ii);
             append_stats(key.data(),
@@ -687,6 +739,184 @@ static ENGINE_ERROR_CODE stat_topkeys_json_executor(const std::string& arg,
     }
 }
 
+/**
+ * Handler for the <code>stats vbucket_load [limit]</code> command used to
+ * retrieve the read / write counts and rates of the vBuckets of the attached
+ * bucket, the hottest first.
+ *
+ * @param arg - the maximum number of vBuckets to return (optional)
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_vbucket_load_executor(const std::string& arg,
+                                                    Cookie& cookie) {
+    size_t limit = VBucketLoad::MaxVBuckets;
+    if (!arg.empty()) {
+        try {
+            const auto value = std::stoll(arg);
+            if (value < 0) {
+                return ENGINE_EINVAL;
+            }
+            limit = size_t(value);
+        } catch (...) {
+            return ENGINE_EINVAL;
+        }
+    }
+
+    const auto index = cookie.getConnection().getBucketIndex();
+    if (index == 0) {
+        return ENGINE_NO_BUCKET;
+    }
+
+    for (const auto& load : all_buckets[index].vbucketLoad.getLoad(limit)) {
+        const auto prefix = "vb_" + std::to_string(load.vbucket.get()) + ":";
+        auto add = [&cookie, &prefix](const char* name, uint64_t value) {
+            add_stat(cookie, append_stats, (prefix + name).c_str(), value);
+        };
+        add("reads", load.reads);
+        add("writes", load.writes);
+        add("bytes", load.bytes);
+        add("reads_per_sec", load.readsPerSec);
+        add("writes_per_sec", load.writesPerSec);
+        add("bytes_per_sec", load.bytesPerSec);
+    }
+    return ENGINE_SUCCESS;
+}
+
+/// The metrics being built by stat_metrics_executor on this thread (the
+/// ADD_STAT callback is only passed the cookie)
+struct EngineMetrics {
+    cb::prometheus::Writer& writer;
+    const cb::prometheus::Labels& labels;
+    std::string prefix;
+};
+static thread_local EngineMetrics* engineMetrics = nullptr;
+
+/// ADD_STAT callback adding the numeric engine stats as gauges
+static void add_engine_metric(const char* key,
+                              const uint16_t klen,
+                              const char* val,
+                              const uint32_t vlen,
+                              gsl::not_null<const void*>) {
+    const std::string value(val, vlen);
+    double number;
+    if (value == "true" || value == "false") {
+        number = value == "true" ? 1 : 0;
+    } else {
+        char* end = nullptr;
+        number = std::strtod(value.c_str(), &end);
+        if (value.empty() || end != value.c_str() + value.size()) {
+            // Not a number
+            return;
+        }
+    }
+    engineMetrics->writer.gauge(
+            engineMetrics->prefix +
+                    cb::prometheus::Writer::sanitise(std::string(key, klen)),
+            engineMetrics->labels,
+            number);
+}
+
+/**
+ * Handler for the <code>stats metrics</code> command used to retrieve the
+ * statistics of the attached bucket as one document in the Prometheus text
+ * exposition format: the front-end counters, a histogram of the command
+ * durations of each opcode, and the numeric engine stats (the default, DCP
+ * aggregate and KVStore groups) as gauges.
+ *
+ * @param arg - should be empty
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_metrics_executor(const std::string& arg,
+                                               Cookie& cookie) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+    const auto index = cookie.getConnection().getBucketIndex();
+    if (index == 0) {
+        return ENGINE_NO_BUCKET;
+    }
+    auto& bucket = all_buckets[index];
+
+    cb::prometheus::Writer writer;
+    const cb::prometheus::Labels labels{{"bucket", bucket.name}};
+
+    struct thread_stats thread_stats;
+    thread_stats.aggregate(bucket.stats);
+    const std::pair<const char*, uint64_t> counters[] = {
+            {"kv_cmd_get_total", thread_stats.cmd_get},
+            {"kv_cmd_set_total", thread_stats.cmd_set},
+            {"kv_cmd_flush_total", thread_stats.cmd_flush},
+            {"kv_cmd_lock_total", thread_stats.cmd_lock},
+            {"kv_cmd_subdoc_lookup_total", thread_stats.cmd_subdoc_lookup},
+            {"kv_cmd_subdoc_mutation_total", thread_stats.cmd_subdoc_mutation},
+            {"kv_get_hits_total", thread_stats.get_hits},
+            {"kv_get_misses_total", thread_stats.get_misses},
+            {"kv_delete_hits_total", thread_stats.delete_hits},
+            {"kv_delete_misses_total", thread_stats.delete_misses},
+            {"kv_incr_hits_total", thread_stats.incr_hits},
+            {"kv_incr_misses_total", thread_stats.incr_misses},
+            {"kv_decr_hits_total", thread_stats.decr_hits},
+            {"kv_decr_misses_total", thread_stats.decr_misses},
+            {"kv_cas_hits_total", thread_stats.cas_hits},
+            {"kv_cas_misses_total", thread_stats.cas_misses},
+            {"kv_cas_badval_total", thread_stats.cas_badval},
+            {"kv_auth_cmds_total", thread_stats.auth_cmds},
+            {"kv_auth_errors_total", thread_stats.auth_errors},
+            {"kv_lock_errors_total", thread_stats.lock_errors},
+            {"kv_read_bytes_total", thread_stats.bytes_read},
+            {"kv_written_bytes_total", thread_stats.bytes_written},
+            {"kv_cmds_read_total", thread_stats.cmds_read},
+            {"kv_read_syscalls_total", thread_stats.read_syscalls},
+            {"kv_write_syscalls_total", thread_stats.write_syscalls},
+            {"kv_conn_yields_total", thread_stats.conn_yields}};
+    for (const auto& counter : counters) {
+        writer.counter(counter.first, labels, counter.second);
+    }
+
+    for (int op = 0; op < MAX_NUM_OPCODES; ++op) {
+        const auto histogram = bucket.timings.get_timing_histogram(uint8_t(op));
+        if (histogram.getValueCount() == 0) {
+            continue;
+        }
+        const auto opcode = cb::mcbp::ClientOpcode(op);
+        auto opcodeLabels = labels;
+        opcodeLabels.emplace_back("opcode",
+                                  cb::mcbp::is_valid_opcode(opcode)
+                                          ? to_string(opcode)
+                                          : std::to_string(op));
+        writer.histogram("kv_cmd_duration_seconds", opcodeLabels, histogram);
+    }
+
+    // The engine stats. Only the default group is required, not all engines
+    // have the others.
+    EngineMetrics metrics{writer, labels, "kv_ep_"};
+    engineMetrics = &metrics;
+    auto ret = bucket_get_stats(cookie, {}, add_engine_metric);
+    if (ret == ENGINE_SUCCESS) {
+        const std::pair<const char*, const char*> groups[] = {
+                {"dcpagg :", "kv_dcp_"}, {"kvstore", "kv_kvstore_"}};
+        for (const auto& group : groups) {
+            metrics.prefix = group.second;
+            bucket_get_stats(cookie,
+                             {group.first, strlen(group.first)},
+                             add_engine_metric);
+        }
+    }
+    engineMetrics = nullptr;
+    if (ret != ENGINE_SUCCESS) {
+        return ret;
+    }
+
+    char key[] = "metrics";
+    const auto& document = writer.str();
+    append_stats(key,
+                 uint16_t(strlen(key)),
+                 document.data(),
+                 uint32_t(document.size()),
+                 &cookie);
+    return ENGINE_SUCCESS;
+}
+
 /**
  * Handler for the <code>stats subdoc_execute</code> command used to retrieve
  * information from the subdoc subsystem.
@@ -826,8 +1056,31 @@ static ENGINE_ERROR_CODE stat_all_stats(const std::string& arg,
     return ret;
 }
 
+/**
+ * @return true if the engine stat group is expensive to collect (it visits
+ *         all of the vBuckets or DCP streams), so is collected by a
+ *         StatsTaskBucketStats instead of on the front-end thread.
+ *         ("checkpoint" isn't, ep-engine already collects it in a task of
+ *         its own.)
+ */
+static bool is_expensive_bucket_stat(const std::string& key) {
+    return key == "dcp" || key == "hash" || key == "vbucket-details" ||
+           key == "vbucket-seqno" || key == "failovers" ||
+           key.compare(0, 7, "dcpagg ") == 0 ||
+           key.compare(0, 8, "diskinfo") == 0;
+}
+
 static ENGINE_ERROR_CODE stat_bucket_stats(const std::string& arg,
                                            Cookie& cookie) {
+    if (is_expensive_bucket_stat(arg)) {
+        std::shared_ptr<Task> task = std::make_shared<StatsTaskBucketStats>(
+                cookie.getConnection(), cookie, &append_stats, arg);
+        cookie.obtainContext<StatsCommandContext>(cookie).setTask(task);
+        std::lock_guard<std::mutex> guard(task->getMutex());
+        executorPool->schedule(task, true);
+        return ENGINE_EWOULDBLOCK;
+    }
+
     return bucket_get_stats(cookie, arg, append_stats);
 }
 
@@ -863,6 +1116,8 @@ static std::unordered_map<std::string, struct command_stat_handler>
                 {"topkeys_json", {false, stat_topkeys_json_executor}},
                 {"subdoc_execute", {false, stat_subdoc_execute_executor}},
                 {"responses", {false, stat_responses_json_executor}},
+                {"vbucket_load", {false, stat_vbucket_load_executor}},
+                {"metrics", {false, stat_metrics_executor}},
                 {"tracing", {true, stat_tracing_executor}}};
 
 /**
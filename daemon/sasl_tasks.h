@@ -49,6 +49,12 @@ public:
 
     void notifyExecutionComplete() override;
 
+    /// Authentication is costly (and comes in storms when clients
+    /// reconnect); don't let it hold up the other tasks.
+    Priority getPriority() const override {
+        return Priority::Low;
+    }
+
     cb::sasl::Error getError() const {
         return response.first;
     }
@@ -18,6 +18,7 @@
 #include "server_socket.h"
 
 #include "connections.h"
+#include "front_end_thread.h"
 #include "memcached.h"
 #include "network_interface.h"
 #include "settings.h"
@@ -31,6 +32,7 @@
 #include <string>
 #ifndef WIN32
 #include <sys/resource.h>
+#include <unistd.h>
 #endif
 
 ServerSocket::ServerSocket(SOCKET fd,
@@ -41,7 +43,8 @@ ServerSocket::ServerSocket(SOCKET fd,
     : sfd(fd),
       listen_port(port),
       family(fam),
-      sockname(cb::net::getsockname(fd)),
+      path(interf.path),
+      sockname(path.empty() ? cb::net::getsockname(fd) : "unix:" + path),
       backlog(interf.backlog),
       ssl(!interf.ssl.cert.empty()),
       management(interf.management),
@@ -59,6 +62,11 @@ ServerSocket::ServerSocket(SOCKET fd,
 
 ServerSocket::~ServerSocket() {
     disable();
+#ifndef WIN32
+    if (!path.empty()) {
+        unlink(path.c_str());
+    }
+#endif
 }
 
 void ServerSocket::enable() {
@@ -170,7 +178,25 @@ void ServerSocket::acceptNewClient() {
         return;
     }
 
-    dispatch_conn_new(client, listen_port);
+    if (thread) {
+        dispatch_conn_local(*thread, client, listen_port);
+    } else {
+        dispatch_conn_new(client, listen_port);
+    }
+}
+
+void ServerSocket::moveToThread(FrontEndThread& to) {
+    disable();
+    ev.reset(event_new(to.base,
+                       sfd,
+                       EV_READ | EV_PERSIST,
+                       listen_event_handler,
+                       reinterpret_cast<void*>(this)));
+    if (!ev) {
+        throw std::bad_alloc();
+    }
+    thread = &to;
+    enable();
 }
 
 unique_cJSON_ptr ServerSocket::getDetails() {
@@ -186,8 +212,11 @@ unique_cJSON_ptr ServerSocket::getDetails() {
     cJSON_AddStringToObject(obj, "protocol", "memcached");
     if (family == AF_INET) {
         cJSON_AddStringToObject(obj, "family", "AF_INET");
-    } else {
+    } else if (family == AF_INET6) {
         cJSON_AddStringToObject(obj, "family", "AF_INET6");
+    } else {
+        cJSON_AddStringToObject(obj, "family", "AF_UNIX");
+        cJSON_AddStringToObject(obj, "path", path.c_str());
     }
 
     cJSON_AddNumberToObject(obj, "port", listen_port);
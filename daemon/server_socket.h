@@ -22,6 +22,7 @@
 #include <memory>
 
 class NetworkInterface;
+struct FrontEndThread;
 
 /**
  * The ServerSocket represents the socket used to accept new clients.
@@ -37,7 +38,8 @@ public:
      * @param sfd The socket to operate on
      * @param b The event base to use (the caller owns the event base)
      * @param port The port we're listening to
-     * @param fam The address family for the port (IPv4/6)
+     * @param fam The address family for the port (IPv4/6, or AF_UNIX for a
+     *            Unix domain socket at interf.path)
      * @param interf The interface object containing properties to use (backlog,
      *               ssl, management etc)
      */
@@ -63,12 +65,24 @@ public:
         return sfd;
     }
 
+    /// Is this a Unix domain socket (rather than a TCP socket)?
+    bool isUnixDomain() const {
+        return !path.empty();
+    }
+
     void enable();
 
     void disable();
 
     void acceptNewClient();
 
+    /**
+     * Move the socket over to the given worker thread's event base. From
+     * then on the worker thread accepts the clients itself and serves them,
+     * rather than dispatching them (used for SO_REUSEPORT listeners).
+     */
+    void moveToThread(FrontEndThread& to);
+
     /**
      * Get the details for this connection to put in the portnumber
      * file so that the test framework may pick up the port numbers
@@ -82,9 +96,12 @@ protected:
     /// The port number we're listening on
     in_port_t listen_port;
 
-    /// The address family of this server socket (IPv4 / IPv6)
+    /// The address family of this server socket (IPv4 / IPv6 / Unix)
     const sa_family_t family;
 
+    /// The path of a Unix domain socket (empty for IPv4 / IPv6)
+    const std::string path;
+
     /// The sockets name (used for debug)
     const std::string sockname;
 
@@ -105,6 +122,9 @@ protected:
         }
     };
 
+    /// The worker thread owning the socket (nullptr for the listen thread)
+    FrontEndThread* thread = nullptr;
+
     /// Are we currently registered in libevent or not
     bool registered_in_libevent = {false};
 
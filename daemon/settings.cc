@@ -34,6 +34,7 @@
 #include "ssl_utils.h"
 
 #include <mcbp/mcbp.h>
+#include <utilities/cpu_affinity.h>
 #include <utilities/json_utilities.h>
 #include <utilities/logtags.h>
 
@@ -61,6 +62,7 @@ Settings::Settings()
     verbose.store(0);
     connection_idle_time.reset();
     dedupe_nmvb_maps.store(false);
+    coalesce_responses.store(true);
     xattr_enabled.store(false);
     privilege_debug.store(false);
     collections_enabled.store(true);
@@ -179,6 +181,39 @@ static void handle_threads(Settings& s, const nlohmann::json& obj) {
     s.setNumWorkerThreads(gsl::narrow_cast<size_t>(obj.get<unsigned int>()));
 }
 
+/**
+ * Handle the "dcp_threads" tag in the settings
+ *
+ *  The value must be an integer value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_dcp_threads(Settings& s, const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError("\"dcp_threads\" must be an unsigned int");
+    }
+    s.setNumDcpThreads(gsl::narrow_cast<size_t>(obj.get<unsigned int>()));
+}
+
+/**
+ * Handle the "worker_thread_groups" tag in the settings
+ *
+ *  The value must be an integer value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_worker_thread_groups(Settings& s,
+                                        const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                "\"worker_thread_groups\" must be an unsigned int");
+    }
+    s.setNumWorkerThreadGroups(
+            gsl::narrow_cast<size_t>(obj.get<unsigned int>()));
+}
+
 /**
  * Handle the "topkeys_enabled" tag in the settings
  *
@@ -234,6 +269,55 @@ static void handle_tracing_enabled(Settings& s, const nlohmann::json& obj) {
     s.setTracingEnabled(obj.get<bool>());
 }
 
+/**
+ * Handle the "streamed_value_threshold" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_streamed_value_threshold(Settings& s,
+                                            const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                "\"streamed_value_threshold\" must be an unsigned int");
+    }
+    s.setStreamedValueThreshold(obj.get<size_t>());
+}
+
+/**
+ * Handle the "subdoc_path_cache_size" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_subdoc_path_cache_size(Settings& s,
+                                          const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                "\"subdoc_path_cache_size\" must be an unsigned int");
+    }
+    s.setSubdocPathCacheSize(obj.get<size_t>());
+}
+
+/**
+ * Handle the "trace_sample_rate" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_trace_sample_rate(Settings& s, const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError("\"trace_sample_rate\" must be an unsigned int");
+    }
+    s.setTraceSampleRate(obj.get<size_t>());
+}
+
 /**
  * Handle the "stdin_listener" tag in the settings
  *
@@ -246,6 +330,56 @@ static void handle_stdin_listener(Settings& s, const nlohmann::json& obj) {
     s.setStdinListenerEnabled(obj.get<bool>());
 }
 
+/**
+ * Handle the "reuseport_listeners" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_reuseport_listeners(Settings& s,
+                                       const nlohmann::json& obj) {
+    s.setReuseportListenersEnabled(obj.get<bool>());
+}
+
+/**
+ * Handle the "worker_cpu_affinity" tag in the settings
+ *
+ *  The value must be a string with a list of CPUs (like "0-3,8")
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_worker_cpu_affinity(Settings& s,
+                                       const nlohmann::json& obj) {
+    s.setWorkerCpuAffinity(parse_cpu_list(obj.get<std::string>()));
+}
+
+/**
+ * Handle the "event_backend" tag in the settings
+ *
+ *  The value must be a string (the name of a libevent backend)
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_event_backend(Settings& s, const nlohmann::json& obj) {
+    s.setEventBackend(obj.get<std::string>());
+}
+
+/**
+ * Handle the "event_changelist" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_event_changelist(Settings& s, const nlohmann::json& obj) {
+    s.setEventChangelistEnabled(obj.get<bool>());
+}
+
 /**
  * Handle "default_reqs_per_event", "reqs_per_event_high_priority",
  * "reqs_per_event_med_priority" and "reqs_per_event_low_priority" tag in
@@ -471,6 +605,18 @@ static void handle_dedupe_nmvb_maps(Settings& s, const nlohmann::json& obj) {
     s.setDedupeNmvbMaps(obj.get<bool>());
 }
 
+/**
+ * Handle the "coalesce_responses" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_coalesce_responses(Settings& s, const nlohmann::json& obj) {
+    s.setCoalesceResponses(obj.get<bool>());
+}
+
 /**
  * Handle the "xattr_enabled" tag in the settings
  *
@@ -588,6 +734,8 @@ void Settings::reconfigure(const nlohmann::json& json) {
             {"audit_file", handle_audit_file},
             {"error_maps_dir", handle_error_maps_dir},
             {"threads", handle_threads},
+            {"dcp_threads", handle_dcp_threads},
+            {"worker_thread_groups", handle_worker_thread_groups},
             {"interfaces", handle_interfaces},
             {"extensions", handle_extensions},
             {"logger", handle_logger},
@@ -609,13 +757,21 @@ void Settings::reconfigure(const nlohmann::json& json) {
             {"sasl_mechanisms", handle_sasl_mechanisms},
             {"ssl_sasl_mechanisms", handle_ssl_sasl_mechanisms},
             {"stdin_listener", handle_stdin_listener},
+            {"reuseport_listeners", handle_reuseport_listeners},
+            {"worker_cpu_affinity", handle_worker_cpu_affinity},
+            {"event_backend", handle_event_backend},
+            {"event_changelist", handle_event_changelist},
             {"dedupe_nmvb_maps", handle_dedupe_nmvb_maps},
+            {"coalesce_responses", handle_coalesce_responses},
             {"xattr_enabled", handle_xattr_enabled},
             {"client_cert_auth", handle_client_cert_auth},
             {"collections_enabled", handle_collections_enabled},
             {"opcode_attributes_override", handle_opcode_attributes_override},
             {"topkeys_enabled", handle_topkeys_enabled},
             {"tracing_enabled", handle_tracing_enabled},
+            {"subdoc_path_cache_size", handle_subdoc_path_cache_size},
+            {"streamed_value_threshold", handle_streamed_value_threshold},
+            {"trace_sample_rate", handle_trace_sample_rate},
             {"scramsha_fallback_salt", handle_scramsha_fallback_salt},
             {"external_auth_service", handle_external_auth_service},
             {"active_external_users_push_interval",
@@ -665,6 +821,18 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             throw std::invalid_argument("threads can't be changed dynamically");
         }
     }
+    if (other.has.dcp_threads) {
+        if (other.num_dcp_threads != num_dcp_threads) {
+            throw std::invalid_argument(
+                    "dcp_threads can't be changed dynamically");
+        }
+    }
+    if (other.has.worker_thread_groups) {
+        if (other.num_worker_thread_groups != num_worker_thread_groups) {
+            throw std::invalid_argument(
+                    "worker_thread_groups can't be changed dynamically");
+        }
+    }
 
     if (other.has.audit) {
         if (other.audit_file != audit_file) {
@@ -715,8 +883,8 @@ void Settings::updateSettings(const Settings& other, bool apply) {
 
             // the following fields can't change
             if ((i1.host != i2.host) || (i1.port != i2.port) ||
-                (i1.ipv4 != i2.ipv4) || (i1.ipv6 != i2.ipv6) ||
-                (i1.management != i2.management)) {
+                (i1.path != i2.path) || (i1.ipv4 != i2.ipv4) ||
+                (i1.ipv6 != i2.ipv6) || (i1.management != i2.management)) {
                 throw std::invalid_argument(
                     "interfaces can't be changed dynamically");
             }
@@ -730,6 +898,34 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
     }
 
+    if (other.has.reuseport_listeners) {
+        if (other.reuseport_listeners.load() != reuseport_listeners.load()) {
+            throw std::invalid_argument(
+                    "reuseport_listeners can't be changed dynamically");
+        }
+    }
+
+    if (other.has.worker_cpu_affinity) {
+        if (other.worker_cpu_affinity != worker_cpu_affinity) {
+            throw std::invalid_argument(
+                    "worker_cpu_affinity can't be changed dynamically");
+        }
+    }
+
+    if (other.has.event_backend) {
+        if (other.event_backend != event_backend) {
+            throw std::invalid_argument(
+                    "event_backend can't be changed dynamically");
+        }
+    }
+
+    if (other.has.event_changelist) {
+        if (other.event_changelist.load() != event_changelist.load()) {
+            throw std::invalid_argument(
+                    "event_changelist can't be changed dynamically");
+        }
+    }
+
     if (other.has.logger) {
         if (other.logger_settings != logger_settings)
             throw std::invalid_argument(
@@ -876,6 +1072,13 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             setDedupeNmvbMaps(other.dedupe_nmvb_maps.load());
         }
     }
+    if (other.has.coalesce_responses) {
+        if (other.coalesce_responses != coalesce_responses) {
+            LOG_INFO("{} coalescing of responses",
+                     other.coalesce_responses.load() ? "Enable" : "Disable");
+            setCoalesceResponses(other.coalesce_responses.load());
+        }
+    }
 
     if (other.has.xattr_enabled) {
         if (other.xattr_enabled != xattr_enabled) {
@@ -1032,6 +1235,33 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         setTracingEnabled(other.isTracingEnabled());
     }
 
+    if (other.has.subdoc_path_cache_size) {
+        if (other.getSubdocPathCacheSize() != getSubdocPathCacheSize()) {
+            LOG_INFO("Change subdoc path cache size from {} to {}",
+                     getSubdocPathCacheSize(),
+                     other.getSubdocPathCacheSize());
+            setSubdocPathCacheSize(other.getSubdocPathCacheSize());
+        }
+    }
+
+    if (other.has.streamed_value_threshold) {
+        if (other.getStreamedValueThreshold() != getStreamedValueThreshold()) {
+            LOG_INFO("Change streamed value threshold from {} to {}",
+                     getStreamedValueThreshold(),
+                     other.getStreamedValueThreshold());
+            setStreamedValueThreshold(other.getStreamedValueThreshold());
+        }
+    }
+
+    if (other.has.trace_sample_rate) {
+        if (other.getTraceSampleRate() != getTraceSampleRate()) {
+            LOG_INFO("Change trace sample rate from {} to {}",
+                     getTraceSampleRate(),
+                     other.getTraceSampleRate());
+            setTraceSampleRate(other.getTraceSampleRate());
+        }
+    }
+
     if (other.has.scramsha_fallback_salt) {
         const auto o = other.getScramshaFallbackSalt();
         const auto m = getScramshaFallbackSalt();
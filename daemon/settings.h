@@ -132,6 +132,57 @@ public:
         notify_changed("threads");
     }
 
+    /**
+     * Get the number of frontend threads dedicated to DCP connections
+     *
+     * @return the configured amount of DCP threads (0 if DCP connections
+     *         are served by the worker threads)
+     */
+    size_t getNumDcpThreads() const {
+        return num_dcp_threads;
+    }
+
+    /**
+     * Set the number of frontend threads dedicated to DCP connections
+     *
+     * @param num_dcp_threads the new number of threads
+     */
+    void setNumDcpThreads(size_t num_dcp_threads) {
+        has.dcp_threads = true;
+        Settings::num_dcp_threads = num_dcp_threads;
+        notify_changed("dcp_threads");
+    }
+
+    /**
+     * Get the number of groups the worker threads are split into, each
+     * serving the connections of its share of the buckets
+     *
+     * @return the configured amount of groups (0 if any worker thread
+     *         serves any bucket)
+     */
+    size_t getNumWorkerThreadGroups() const {
+        return num_worker_thread_groups;
+    }
+
+    /**
+     * Set the number of groups the worker threads are split into
+     *
+     * @param num_worker_thread_groups the new number of groups
+     */
+    void setNumWorkerThreadGroups(size_t num_worker_thread_groups) {
+        has.worker_thread_groups = true;
+        Settings::num_worker_thread_groups = num_worker_thread_groups;
+        notify_changed("worker_thread_groups");
+    }
+
+    /**
+     * Get the total number of frontend threads serving connections (the
+     * worker threads and the DCP threads)
+     */
+    size_t getNumFrontEndThreads() const {
+        return num_threads + num_dcp_threads;
+    }
+
     /**
      * Add a new interface definition to the list of interfaces provided
      * by the server.
@@ -174,6 +225,90 @@ public:
         notify_changed("stdin_listener");
     }
 
+    /**
+     * Should each worker thread accept its own connections from a
+     * SO_REUSEPORT listening socket, rather than having the listen thread
+     * accept them and dispatch them to the workers?
+     *
+     * @return true if enabled, false otherwise
+     */
+    bool isReuseportListenersEnabled() const {
+        return reuseport_listeners.load();
+    }
+
+    /**
+     * Set if the worker threads should have their own listening sockets
+     *
+     * @param enabled the new value
+     */
+    void setReuseportListenersEnabled(bool enabled) {
+        reuseport_listeners.store(enabled);
+        has.reuseport_listeners = true;
+        notify_changed("reuseport_listeners");
+    }
+
+    /**
+     * Get the CPUs to pin the front end (worker) threads to; worker thread
+     * n is pinned to CPU n modulo the number of CPUs in the list. An empty
+     * list means the threads aren't pinned.
+     */
+    const std::vector<int>& getWorkerCpuAffinity() const {
+        return worker_cpu_affinity;
+    }
+
+    /**
+     * Set the CPUs to pin the front end threads to
+     *
+     * @param cpus the CPUs to use
+     */
+    void setWorkerCpuAffinity(const std::vector<int>& cpus) {
+        worker_cpu_affinity = cpus;
+        has.worker_cpu_affinity = true;
+        notify_changed("worker_cpu_affinity");
+    }
+
+    /**
+     * Get the name of the libevent backend (method) the front end threads
+     * should use for their event loops. An empty name means the default
+     * (the best one available on the platform).
+     */
+    const std::string& getEventBackend() const {
+        return event_backend;
+    }
+
+    /**
+     * Set the libevent backend for the front end threads
+     *
+     * @param backend the name of the backend ("epoll", "poll", "kqueue" etc)
+     */
+    void setEventBackend(const std::string& backend) {
+        event_backend = backend;
+        has.event_backend = true;
+        notify_changed("event_backend");
+    }
+
+    /**
+     * Should the front end threads batch the changes to the events they're
+     * interested in, and apply them all in one go before polling (saving
+     * an epoll_ctl() call for most of the changes)?
+     *
+     * @return true if enabled, false otherwise
+     */
+    bool isEventChangelistEnabled() const {
+        return event_changelist.load();
+    }
+
+    /**
+     * Set if the front end threads should use an event changelist
+     *
+     * @param enabled the new value
+     */
+    void setEventChangelistEnabled(bool enabled) {
+        event_changelist.store(enabled);
+        has.event_changelist = true;
+        notify_changed("event_changelist");
+    }
+
     cb::logger::Config getLoggerConfig() const {
         auto config = logger_settings;
         // log_level is synthesised from settings.verbose.
@@ -599,6 +734,28 @@ public:
         notify_changed("dedupe_nmvb_maps");
     }
 
+    /**
+     * Should the responses of pipelined commands be held back and sent
+     * together with the responses of the following commands (already in
+     * the input buffer) in a single sendmsg.
+     *
+     * @return true if responses should be coalesced
+     */
+    bool isCoalesceResponses() const {
+        return coalesce_responses.load();
+    }
+
+    /**
+     * Set if the responses of pipelined commands should be coalesced
+     *
+     * @param coalesce_responses true if responses should be coalesced
+     */
+    void setCoalesceResponses(bool coalesce_responses) {
+        Settings::coalesce_responses.store(coalesce_responses);
+        has.coalesce_responses = true;
+        notify_changed("coalesce_responses");
+    }
+
     /**
      * Get the breakpad settings
      *
@@ -714,6 +871,51 @@ public:
         notify_changed("tracing_enabled");
     }
 
+    /**
+     * Get the number of documents each front end thread remembers the
+     * location of looked up subdoc paths for (0 if disabled).
+     */
+    size_t getSubdocPathCacheSize() const {
+        return subdoc_path_cache_size.load(std::memory_order_acquire);
+    }
+
+    void setSubdocPathCacheSize(size_t size) {
+        Settings::subdoc_path_cache_size.store(size,
+                                               std::memory_order_release);
+        has.subdoc_path_cache_size = true;
+        notify_changed("subdoc_path_cache_size");
+    }
+
+    /**
+     * Get the size from which the value of an Add, Set or Replace is read
+     * straight into the engine's item instead of the input buffer (0 if
+     * values are never streamed).
+     */
+    size_t getStreamedValueThreshold() const {
+        return streamed_value_threshold.load(std::memory_order_acquire);
+    }
+
+    void setStreamedValueThreshold(size_t size) {
+        Settings::streamed_value_threshold.store(size,
+                                                 std::memory_order_release);
+        has.streamed_value_threshold = true;
+        notify_changed("streamed_value_threshold");
+    }
+
+    /**
+     * Get the rate requests are sampled at for the "trace.samples" ioctl
+     * (1 in N requests keep their trace, 0 if the sampler is disabled).
+     */
+    size_t getTraceSampleRate() const {
+        return trace_sample_rate.load(std::memory_order_acquire);
+    }
+
+    void setTraceSampleRate(size_t rate) {
+        Settings::trace_sample_rate.store(rate, std::memory_order_release);
+        has.trace_sample_rate = true;
+        notify_changed("trace_sample_rate");
+    }
+
     void setScramshaFallbackSalt(std::string value) {
         {
             std::lock_guard<std::mutex> guard(scramsha_fallback_salt.mutex);
@@ -768,6 +970,18 @@ protected:
      * */
     size_t num_threads;
 
+    /**
+     * Number of libevent threads DCP connections are moved to once opened,
+     * or 0 to keep them on the worker threads
+     * */
+    size_t num_dcp_threads = 0;
+
+    /**
+     * Number of groups the worker threads are split into, a connection
+     * being moved to a thread of its bucket's group, or 0 for no groups
+     * */
+    size_t num_worker_thread_groups = 0;
+
     /**
      * Array of interface settings we are listening on
      */
@@ -880,6 +1094,11 @@ protected:
      */
     std::atomic_bool dedupe_nmvb_maps;
 
+    /**
+     * Should we coalesce the responses of pipelined commands
+     */
+    std::atomic_bool coalesce_responses;
+
     /**
      * Map of version -> string for error maps
      */
@@ -913,11 +1132,50 @@ protected:
      */
     std::atomic_bool tracing_enabled{true};
 
+    /**
+     * The number of documents each front end thread caches subdoc path
+     * locations of, or 0 to disable the cache
+     */
+    std::atomic<size_t> subdoc_path_cache_size{0};
+
+    /**
+     * Values of mutations at least this big are received directly into
+     * the engine allocated item, or 0 to always buffer the whole packet
+     */
+    std::atomic<size_t> streamed_value_threshold{1024 * 1024};
+
+    /**
+     * Keep the trace of 1 in N requests (and of all slow requests) in the
+     * per thread sample buffers, or 0 to disable the sampler
+     */
+    std::atomic<size_t> trace_sample_rate{1000};
+
     /**
      * Use standard input listener
      */
     std::atomic_bool stdin_listener{true};
 
+    /**
+     * Give each worker thread its own SO_REUSEPORT listening socket
+     */
+    std::atomic_bool reuseport_listeners{false};
+
+    /**
+     * The CPUs the front end threads are pinned to (if any)
+     */
+    std::vector<int> worker_cpu_affinity;
+
+    /**
+     * The libevent backend used by the front end threads (empty for the
+     * default one)
+     */
+    std::string event_backend;
+
+    /**
+     * Use a changelist for the event loops of the front end threads
+     */
+    std::atomic_bool event_changelist{false};
+
     /**
      * Should we allow for using the external authentication service or not
      */
@@ -937,6 +1195,8 @@ public:
         bool rbac_file;
         bool privilege_debug;
         bool threads;
+        bool dcp_threads;
+        bool worker_thread_groups;
         bool interfaces;
         bool logger;
         bool audit;
@@ -960,13 +1220,21 @@ public:
         bool sasl_mechanisms;
         bool ssl_sasl_mechanisms;
         bool dedupe_nmvb_maps;
+        bool coalesce_responses;
         bool error_maps;
         bool xattr_enabled;
         bool collections_enabled;
         bool opcode_attributes_override;
         bool topkeys_enabled;
         bool tracing_enabled;
+        bool subdoc_path_cache_size;
+        bool streamed_value_threshold;
+        bool trace_sample_rate;
         bool stdin_listener;
+        bool reuseport_listeners;
+        bool worker_cpu_affinity;
+        bool event_backend;
+        bool event_changelist;
         bool scramsha_fallback_salt;
         bool external_auth_service;
         bool active_external_users_push_interval = false;
@@ -147,6 +147,14 @@ public:
     bool havePendingInputData();
 
     std::pair<cb::x509::Status, std::string> getCertUserName();
+
+    /**
+     * Release the server contexts shared by the connections (they're
+     * otherwise kept for the lifetime of the process for session
+     * resumption). Connections still using a context keep it alive.
+     */
+    static void releaseServerContexts();
+
     /**
      * Get a JSON description of this object
      */
@@ -155,6 +163,15 @@ public:
 protected:
     bool drainInputSocketBuf();
 
+    /**
+     * Create a server context using the certificate and private key
+     * (configured from the current settings)
+     *
+     * @return the new context, or nullptr if it couldn't be created
+     */
+    static SSL_CTX* createServerContext(const std::string& cert,
+                                        const std::string& pkey);
+
     bool enabled = false;
     bool connected = false;
     bool error = false;
@@ -26,6 +26,104 @@
 #include <platform/strerror.h>
 #include <utilities/logtags.h>
 
+#include <sys/stat.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+namespace {
+
+/**
+ * The server contexts shared by the connections, one per certificate
+ * and private key pair. Apart from not having to read and parse the
+ * files for every connection, sharing the context is what allows clients
+ * to resume their session (from the context's session cache, or with a
+ * session ticket encrypted with the context's ticket keys) instead of
+ * doing a full handshake every time they reconnect.
+ *
+ * A context is configured from the settings at the time it is created;
+ * the fingerprint of that configuration (and of the files) is kept with
+ * it, and a new context is created when it no longer matches.
+ */
+class ServerContextCache {
+public:
+    ~ServerContextCache() {
+        clear();
+    }
+
+    /// Drop the cache's references to the contexts
+    void clear() {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (auto& entry : contexts) {
+            SSL_CTX_free(entry.second.ctx);
+        }
+        contexts.clear();
+    }
+
+    /**
+     * Get a reference to the cached context (the caller must release it
+     * with SSL_CTX_free), or nullptr if there is no cached context for
+     * the current configuration.
+     */
+    SSL_CTX* get(const std::string& files, const std::string& fingerprint) {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto iter = contexts.find(files);
+        if (iter == contexts.end() ||
+            iter->second.fingerprint != fingerprint) {
+            return nullptr;
+        }
+        SSL_CTX_up_ref(iter->second.ctx);
+        return iter->second.ctx;
+    }
+
+    /// Cache the (newly created) context, replacing any stale one
+    void put(const std::string& files,
+             const std::string& fingerprint,
+             SSL_CTX* ctx) {
+        SSL_CTX_up_ref(ctx);
+        std::lock_guard<std::mutex> guard(mutex);
+        auto& entry = contexts[files];
+        if (entry.ctx != nullptr) {
+            SSL_CTX_free(entry.ctx);
+        }
+        entry.fingerprint = fingerprint;
+        entry.ctx = ctx;
+    }
+
+private:
+    struct Entry {
+        std::string fingerprint;
+        SSL_CTX* ctx = nullptr;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> contexts;
+};
+
+ServerContextCache serverContexts;
+
+std::string getModificationTime(const std::string& file) {
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) {
+        return {};
+    }
+    return std::to_string(st.st_mtime);
+}
+
+/// The configuration a server context is created from
+std::string getContextFingerprint(const std::string& cert,
+                                  const std::string& pkey) {
+    return getModificationTime(cert) + ":" + getModificationTime(pkey) +
+           ":" + std::to_string(int(settings.getClientCertMode())) + ":" +
+           settings.getSslCipherList() + ":" +
+           settings.getSslMinimumProtocol() + ":" +
+           std::to_string(settings.isSslCipherOrder());
+}
+
+} // namespace
+#endif
+
 SslContext::~SslContext() {
     if (enabled) {
         disable();
@@ -58,7 +156,58 @@ bool SslContext::havePendingInputData() {
 }
 
 bool SslContext::enable(const std::string& cert, const std::string& pkey) {
-    ctx = SSL_CTX_new(SSLv23_server_method());
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    const auto files = cert + '\0' + pkey;
+    const auto fingerprint = getContextFingerprint(cert, pkey);
+    ctx = serverContexts.get(files, fingerprint);
+    if (ctx == nullptr) {
+        ctx = createServerContext(cert, pkey);
+        if (ctx == nullptr) {
+            return false;
+        }
+        serverContexts.put(files, fingerprint, ctx);
+    }
+#else
+    ctx = createServerContext(cert, pkey);
+    if (ctx == nullptr) {
+        return false;
+    }
+#endif
+
+    enabled = true;
+    error = false;
+    client = NULL;
+
+    try {
+        inputPipe.ensureCapacity(settings.getBioDrainBufferSize());
+        outputPipe.ensureCapacity(settings.getBioDrainBufferSize());
+    } catch (std::bad_alloc) {
+        return false;
+    }
+
+    BIO_new_bio_pair(&application,
+                     settings.getBioDrainBufferSize(),
+                     &network,
+                     settings.getBioDrainBufferSize());
+
+    client = SSL_new(ctx);
+    SSL_set_bio(client, application, application);
+    // A write we have to retry may be gathered into a different buffer
+    // (see Connection::sendmsg)
+    SSL_set_mode(client, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    return true;
+}
+
+void SslContext::releaseServerContexts() {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    serverContexts.clear();
+#endif
+}
+
+SSL_CTX* SslContext::createServerContext(const std::string& cert,
+                                         const std::string& pkey) {
+    auto* ctx = SSL_CTX_new(SSLv23_server_method());
     set_ssl_ctx_protocol_mask(ctx);
 
     /* @todo don't read files, but use in-memory-copies */
@@ -67,7 +216,8 @@ bool SslContext::enable(const std::string& cert, const std::string& pkey) {
         LOG_WARNING("Failed to use SSL cert {} and pkey {}",
                     cb::UserDataView(cert),
                     cb::UserDataView(pkey));
-        return false;
+        SSL_CTX_free(ctx);
+        return nullptr;
     }
 
     set_ssl_ctx_cipher_list(ctx);
@@ -81,7 +231,8 @@ bool SslContext::enable(const std::string& cert, const std::string& pkey) {
         STACK_OF(X509_NAME)* certNames = SSL_load_client_CA_file(cert.c_str());
         if (certNames == NULL) {
             LOG_WARNING("Failed to read SSL cert {}", cb::UserDataView(cert));
-            return false;
+            SSL_CTX_free(ctx);
+            return nullptr;
         }
         SSL_CTX_set_client_CA_list(ctx, certNames);
         SSL_CTX_load_verify_locations(ctx, cert.c_str(), nullptr);
@@ -92,26 +243,15 @@ bool SslContext::enable(const std::string& cert, const std::string& pkey) {
         break;
     }
 
-    enabled = true;
-    error = false;
-    client = NULL;
-
-    try {
-        inputPipe.ensureCapacity(settings.getBioDrainBufferSize());
-        outputPipe.ensureCapacity(settings.getBioDrainBufferSize());
-    } catch (std::bad_alloc) {
-        return false;
-    }
-
-    BIO_new_bio_pair(&application,
-                     settings.getBioDrainBufferSize(),
-                     &network,
-                     settings.getBioDrainBufferSize());
+    // Sessions are resumable (from the session cache, or with a ticket)
+    // for as long as the context is shared. The session id context must be
+    // set for sessions to be resumed when client certificates are in use.
+    static const unsigned char sessionIdContext[] = "memcached";
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_session_id_context(
+            ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
 
-    client = SSL_new(ctx);
-    SSL_set_bio(client, application, application);
-
-    return true;
+    return ctx;
 }
 
 std::pair<cb::x509::Status, std::string> SslContext::getCertUserName() {
@@ -272,6 +412,9 @@ nlohmann::json SslContext::toJSON() const {
         obj["error"] = error;
         obj["total_recv"] = totalRecv;
         obj["total_send"] = totalSend;
+        if (client != nullptr) {
+            obj["session_reused"] = SSL_session_reused(client) == 1;
+        }
     }
 
     return obj;
@@ -26,6 +26,7 @@
 #include "mcaudit.h"
 #include "mcbp.h"
 #include "mcbp_executors.h"
+#include "protocol/mcbp/get_context.h"
 #include "sasl_tasks.h"
 
 #include <logger/logger.h>
@@ -69,6 +70,8 @@ const char* StateMachine::getStateName(State state) const {
         return "parse_cmd";
     case StateMachine::State::read_packet_body:
         return "read_packet_body";
+    case StateMachine::State::read_packet_value:
+        return "read_packet_value";
     case StateMachine::State::closing:
         return "closing";
     case StateMachine::State::pending_close:
@@ -94,6 +97,7 @@ bool StateMachine::isIdleState() const {
     switch (currentState) {
     case State::read_packet_header:
     case State::read_packet_body:
+    case State::read_packet_value:
     case State::waiting:
     case State::new_cmd:
     case State::ship_log:
@@ -123,6 +127,8 @@ bool StateMachine::execute() {
         return conn_parse_cmd();
     case StateMachine::State::read_packet_body:
         return conn_read_packet_body();
+    case StateMachine::State::read_packet_value:
+        return conn_read_packet_value();
     case StateMachine::State::closing:
         return conn_closing();
     case StateMachine::State::pending_close:
@@ -143,6 +149,19 @@ bool StateMachine::execute() {
     throw std::invalid_argument("execute(): invalid state");
 }
 
+/**
+ * The connection is about to wait for the network (or the engine); if it's
+ * waiting to be moved to a DCP thread (or a thread of its bucket's group)
+ * have its thread retry the move now that it's idle (see
+ * request_dcp_thread() and request_bucket_thread()).
+ */
+static void notifyIfThreadMovePending(Connection& connection) {
+    if (connection.isDcpThreadMovePending() ||
+        connection.isBucketThreadMovePending()) {
+        notify_thread(*connection.getThread());
+    }
+}
+
 /**
  * Ship DCP log to the other end. This state differs with all other states
  * in the way that it support full duplex dialog. We're listening to both read
@@ -223,6 +242,8 @@ bool StateMachine::conn_ship_log() {
                 connection.getId(),
                 connection.getDescription());
         connection.setState(StateMachine::State::closing);
+    } else if (!cont) {
+        notifyIfThreadMovePending(connection);
     }
 
     return cont;
@@ -243,12 +264,14 @@ bool StateMachine::conn_waiting() {
         connection.setState(StateMachine::State::closing);
         return true;
     }
+    notifyIfThreadMovePending(connection);
     connection.setState(StateMachine::State::read_packet_header);
     return false;
 }
 
 bool StateMachine::conn_read_packet_header() {
-    if (is_bucket_dying(connection) || connection.processServerEvents()) {
+    if (is_bucket_dying(connection) || connection.processServerEvents() ||
+        connection.resumeParkedCookie()) {
         return true;
     }
 
@@ -287,6 +310,21 @@ bool StateMachine::conn_read_packet_header() {
 }
 
 bool StateMachine::conn_parse_cmd() {
+    if (connection.resumeParkedCookie()) {
+        return true;
+    }
+
+    if (connection.mustWaitForParkedCookies()) {
+        // The next command can't be reordered with the parked (blocked)
+        // commands. Stop reading until they've all completed; we'll be
+        // notified as each of them unblocks.
+        if (!sendHeldResponses()) {
+            return true;
+        }
+        connection.unregisterEvent();
+        return false;
+    }
+
     // Parse the data in the input pipe and prepare the cookie for execution.
     // If all data is available we'll move over to the execution phase,
     // otherwise we'll wait for the data to arrive
@@ -299,7 +337,14 @@ bool StateMachine::conn_new_cmd() {
         return true;
     }
 
-    if (!connection.write->empty()) {
+    if (connection.hasHeldResponses() && !connection.isPacketAvailable()) {
+        // No more commands to add responses to; send what we've got
+        connection.setState(StateMachine::State::send_data);
+        connection.setWriteAndGo(StateMachine::State::new_cmd);
+        return true;
+    }
+
+    if (!connection.write->empty() && !connection.hasHeldResponses()) {
         LOG_WARNING("{}: Expected write buffer to be empty.. It's not! ({})",
                     connection.getId(),
                     connection.write->rsize());
@@ -308,12 +353,18 @@ bool StateMachine::conn_new_cmd() {
     /*
      * In order to ensure that all clients will be served each
      * connection will only process a certain number of operations
-     * before they will back off.
+     * before they will back off. The complete packets already read
+     * are processed before backing off though, as that doesn't cost
+     * another read (and the reads are sized to about a timeslice).
      */
-    if (connection.decrementNumEvents() >= 0) {
+    if (connection.decrementNumEvents() >= 0 ||
+        connection.isPacketAvailable()) {
         connection.getCookieObject().reset();
 
         connection.shrinkBuffers();
+        if (connection.resumeParkedCookie()) {
+            return true;
+        }
         if (connection.read->rsize() >= sizeof(cb::mcbp::Header)) {
             connection.setState(StateMachine::State::parse_cmd);
         } else if (connection.isSslEnabled()) {
@@ -361,6 +412,8 @@ bool StateMachine::conn_validate() {
 
     auto& cookie = connection.getCookieObject();
     const auto& header = cookie.getHeader();
+    connection.recordPacketSize(cookie.getPacket().size());
+    get_thread_stats(&connection)->cmds_read++;
     // We validated the basics of the header in try_read_mcbp_command
     // (we needed that in order to know if we could use the length field...
 
@@ -413,9 +466,40 @@ bool StateMachine::conn_execute() {
     }
 
     auto& cookie = connection.getCookieObject();
+    if (cookie.isEwouldblock() && connection.getNumberOfCookies() > 1) {
+        // We got notified for one of the parked cookies, but the current
+        // command is still blocked. The parked one is resumed once the
+        // current command completes.
+        connection.unregisterEvent();
+        return false;
+    }
     cookie.setEwouldblock(false);
 
+    // GET results prefetched as part of a pipeline are only valid until a
+    // different command is executed.
+    const auto& header = cookie.getHeader();
+    if (!header.isRequest() ||
+        !GetCommandContext::isPipelinable(header.getRequest())) {
+        connection.clearPrefetchedGets();
+    }
+
+    // With unordered execution a reorderable command gets its own copy of
+    // the packet up front, so that it may be parked if it blocks.
+    if (connection.allowUnorderedExecution() && !cookie.isPacketPreserved() &&
+        header.isRequest() && header.getRequest().mayReorder()) {
+        cookie.preserveRequest();
+        consumePacket(cookie);
+    }
+
     if (!cookie.execute()) {
+        if (cookie.isPacketPreserved() && connection.parkCookie()) {
+            // Carry on with the next command while this one is blocked
+            connection.setState(StateMachine::State::new_cmd);
+            return true;
+        }
+        if (!sendHeldResponses()) {
+            return true;
+        }
         connection.unregisterEvent();
         return false;
     }
@@ -430,7 +514,20 @@ bool StateMachine::conn_execute() {
 
     mcbp_collect_timings(cookie);
 
-    // Consume the packet we just executed from the input buffer
+    // Consume the packet we just executed from the input buffer (unless
+    // we already did so when taking a copy of it)
+    if (!cookie.isPacketPreserved()) {
+        consumePacket(cookie);
+    }
+    // We've cleared the memory for this packet so we need to mark it
+    // as cleared in the cookie to avoid having it dumped in toJSON and
+    // using freed memory. We cannot call reset on the cookie as we
+    // want to preserve the error context and id.
+    cookie.clearPacket();
+    return true;
+}
+
+void StateMachine::consumePacket(Cookie& cookie) {
     connection.read->consume([&cookie](
                                      cb::const_byte_buffer buffer) -> ssize_t {
         size_t size = cookie.getPacket(Cookie::PacketContent::Full).size();
@@ -440,12 +537,6 @@ bool StateMachine::conn_execute() {
         }
         return gsl::narrow<ssize_t>(size);
     });
-    // We've cleared the memory for this packet so we need to mark it
-    // as cleared in the cookie to avoid having it dumped in toJSON and
-    // using freed memory. We cannot call reset on the cookie as we
-    // want to preserve the error context and id.
-    cookie.clearPacket();
-    return true;
 }
 
 bool StateMachine::conn_read_packet_body() {
@@ -459,31 +550,51 @@ bool StateMachine::conn_read_packet_body() {
                 "packet available");
     }
 
-    // We need to get more data!!!
-    auto res =
-            connection.read->produce([this](cb::byte_buffer buffer) -> ssize_t {
+    // We need to get more data!!! Read the rest of the packet, and
+    // whatever follows it (up to the connection's read size)
+    const auto readSize = connection.getReadSize();
+    auto res = connection.read->produce(
+            [this, readSize](cb::byte_buffer buffer) -> ssize_t {
                 return connection.recv(reinterpret_cast<char*>(buffer.data()),
-                                       buffer.size());
+                                       std::min(buffer.size(), readSize));
             });
 
     if (res > 0) {
         get_thread_stats(&connection)->bytes_read += res;
+        prepare_mcbp_packet_body(connection.getCookieObject());
+        return true;
+    }
 
-        if (connection.isPacketAvailable()) {
-            auto& cookie = connection.getCookieObject();
-            auto input = connection.read->rdata();
-            const auto* req =
-                    reinterpret_cast<const cb::mcbp::Request*>(input.data());
-            cookie.setPacket(Cookie::PacketContent::Full,
-                             cb::const_byte_buffer{input.data(),
-                                                   sizeof(cb::mcbp::Request) +
-                                                           req->getBodylen()});
+    return handleReadFailure(res, "conn_read_packet_body");
+}
+
+bool StateMachine::conn_read_packet_value() {
+    if (is_bucket_dying(connection)) {
+        return true;
+    }
+
+    auto& cookie = connection.getCookieObject();
+    auto buffer = cookie.getStreamedValueRemaining();
+    if (buffer.empty()) {
+        throw std::logic_error(
+                "conn_read_packet_value: should not be called with the "
+                "complete value available");
+    }
+
+    auto res = connection.recv(reinterpret_cast<char*>(buffer.data()),
+                               buffer.size());
+    if (res > 0) {
+        get_thread_stats(&connection)->bytes_read += res;
+        if (cookie.addStreamedValueReceived(size_t(res))) {
             connection.setState(StateMachine::State::validate);
         }
-
         return true;
     }
 
+    return handleReadFailure(res, "conn_read_packet_value");
+}
+
+bool StateMachine::handleReadFailure(ssize_t res, const char* state) {
     if (res == 0) { /* end of stream */
         // Note: we do not log a clean connection shutdown
         connection.setState(StateMachine::State::closing);
@@ -494,10 +605,10 @@ bool StateMachine::conn_read_packet_body() {
     if (cb::net::is_blocking(error)) {
         if (!connection.updateEvent(EV_READ | EV_PERSIST)) {
             LOG_WARNING(
-                    "{}: conn_read_packet_body - Unable to update libevent "
-                    "settings with (EV_READ | EV_PERSIST), closing "
-                    "connection {}",
+                    "{}: {} - Unable to update libevent settings with "
+                    "(EV_READ | EV_PERSIST), closing connection {}",
                     connection.getId(),
+                    state,
                     connection.getDescription());
             connection.setState(StateMachine::State::closing);
             return true;
@@ -520,6 +631,12 @@ bool StateMachine::conn_read_packet_body() {
 }
 
 bool StateMachine::conn_send_data() {
+    if (connection.holdResponse()) {
+        // Sent along with the response of the next command
+        connection.setState(connection.getWriteAndGo());
+        return true;
+    }
+
     bool ret = true;
 
     switch (connection.transmit()) {
@@ -553,6 +670,32 @@ bool StateMachine::conn_send_data() {
     return ret;
 }
 
+bool StateMachine::sendHeldResponses() {
+    if (!connection.hasHeldResponses()) {
+        return true;
+    }
+
+    auto ret = Connection::TransmitResult::Incomplete;
+    while (ret == Connection::TransmitResult::Incomplete) {
+        ret = connection.transmit();
+    }
+
+    switch (ret) {
+    case Connection::TransmitResult::Complete:
+        connection.releaseTempAlloc();
+        connection.releaseReservedItems();
+        return true;
+    case Connection::TransmitResult::SoftError:
+        // The socket is full. There is more to send once the command
+        // completes anyway, so the rest is sent along with its response.
+        return true;
+    case Connection::TransmitResult::Incomplete:
+    case Connection::TransmitResult::HardError:
+        break;
+    }
+    return false;
+}
+
 bool StateMachine::conn_immediate_close() {
     {
         std::lock_guard<std::mutex> guard(stats_mutex);
@@ -17,6 +17,7 @@
 #pragma once
 
 class Connection;
+class Cookie;
 
 /**
  * The state machinery for connections in the daemon
@@ -68,6 +69,8 @@ public:
          *   * closing - if the bucket is currently being deleted (or protocol
          *               error)
          *   * read_packet_body - to fetch the rest of the data in the packet
+         *   * read_packet_value - to read the value of a large mutation
+         *                         straight into the item
          *   * send_data - if an error occurs and we want to tell the user
          *                 about the error before disconnecting.
          */
@@ -79,10 +82,23 @@ public:
          * possible next state:
          *   * closing - if the bucket is currently being deleted (or protocol
          *               error)
+         *   * read_packet_value - the request up to the value of a large
+         *                         mutation is available
          *   * execute - the entire packet is available in memory
          */
         read_packet_body,
 
+        /**
+         * Read the value of a large mutation from the network straight into
+         * the item allocated for it (see Cookie::setStreamedValue)
+         *
+         * possible next state:
+         *   * closing - if the bucket is currently being deleted (or network
+         *               errors)
+         *   * validate - the entire value is available
+         */
+        read_packet_value,
+
         /**
          * Validate the packet
          *
@@ -217,6 +233,7 @@ protected:
     bool conn_read_packet_header();
     bool conn_parse_cmd();
     bool conn_read_packet_body();
+    bool conn_read_packet_value();
     bool conn_closing();
     bool conn_pending_close();
     bool conn_immediate_close();
@@ -226,6 +243,29 @@ protected:
     bool conn_send_data();
     bool conn_ship_log();
 
+    /**
+     * Handle a failed (or empty) read from the network in one of the
+     * states reading the rest of a packet
+     *
+     * @param res the return value of the read
+     * @param state the name of the state (for logging)
+     * @return the return value for the state
+     */
+    bool handleReadFailure(ssize_t res, const char* state);
+
+    /// Consume the cookie's packet from the connection's input buffer
+    void consumePacket(Cookie& cookie);
+
+    /**
+     * Send the responses held back by the connection (see
+     * Connection::holdResponse) before the state machine stops to wait for
+     * a blocked command - as far as the socket takes them without blocking;
+     * whatever is left goes out with the next response.
+     *
+     * @return false if the connection failed (and is closing)
+     */
+    bool sendHeldResponses();
+
     State currentState;
     Connection& connection;
 };
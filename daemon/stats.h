@@ -49,6 +49,10 @@ struct thread_stats {
         cas_misses = 0;
         bytes_written = 0;
         bytes_read = 0;
+        read_syscalls = 0;
+        cmds_read = 0;
+        write_syscalls = 0;
+        responses_held = 0;
         cmd_flush = 0;
         conn_yields = 0;
         auth_cmds = 0;
@@ -57,11 +61,14 @@ struct thread_stats {
         cmd_subdoc_mutation = 0;
         cmd_lock = 0;
         lock_errors = 0;
+        get_value_copies = 0;
 
         bytes_subdoc_lookup_total = 0;
         bytes_subdoc_lookup_extracted = 0;
         bytes_subdoc_mutation_total = 0;
         bytes_subdoc_mutation_inserted = 0;
+        subdoc_path_cache_hits = 0;
+        subdoc_path_cache_misses = 0;
 
         rbufs_allocated = 0;
         rbufs_loaned = 0;
@@ -89,6 +96,10 @@ struct thread_stats {
         incr_hits += other.incr_hits;
         cas_misses += other.cas_misses;
         bytes_read += other.bytes_read;
+        read_syscalls += other.read_syscalls;
+        cmds_read += other.cmds_read;
+        write_syscalls += other.write_syscalls;
+        responses_held += other.responses_held;
         bytes_written += other.bytes_written;
         cmd_flush += other.cmd_flush;
         conn_yields += other.conn_yields;
@@ -99,11 +110,14 @@ struct thread_stats {
 
         cmd_lock += other.cmd_lock;
         lock_errors += other.lock_errors;
+        get_value_copies += other.get_value_copies;
 
         bytes_subdoc_lookup_total += other.bytes_subdoc_lookup_total;
         bytes_subdoc_lookup_extracted += other.bytes_subdoc_lookup_extracted;
         bytes_subdoc_mutation_total += other.bytes_subdoc_mutation_total;
         bytes_subdoc_mutation_inserted += other.bytes_subdoc_mutation_inserted;
+        subdoc_path_cache_hits += other.subdoc_path_cache_hits;
+        subdoc_path_cache_misses += other.subdoc_path_cache_misses;
 
         rbufs_allocated += other.rbufs_allocated;
         rbufs_loaned += other.rbufs_loaned;
@@ -138,6 +152,16 @@ struct thread_stats {
     Couchbase::RelaxedAtomic<uint64_t> decr_hits;
     Couchbase::RelaxedAtomic<uint64_t> cas_misses;
     Couchbase::RelaxedAtomic<uint64_t> bytes_read;
+    /* # of recv() calls made reading from clients */
+    Couchbase::RelaxedAtomic<uint64_t> read_syscalls;
+    /* # of packets read from clients (read_syscalls / cmds_read is the
+       number of reads per command) */
+    Couchbase::RelaxedAtomic<uint64_t> cmds_read;
+    /* # of sendmsg() calls made writing to clients */
+    Couchbase::RelaxedAtomic<uint64_t> write_syscalls;
+    /* # of responses held back to be sent along with the responses of the
+       following (pipelined) commands */
+    Couchbase::RelaxedAtomic<uint64_t> responses_held;
     Couchbase::RelaxedAtomic<uint64_t> bytes_written;
     Couchbase::RelaxedAtomic<uint64_t> cmd_flush;
     Couchbase::RelaxedAtomic<uint64_t> conn_yields; /* # of yields for connections (-R option)*/
@@ -154,6 +178,10 @@ struct thread_stats {
     /** # of times an operation failed due to accessing a locked item */
     Couchbase::RelaxedAtomic<uint64_t> lock_errors;
 
+    /** # of GET (GET, GAT, GETL) responses which couldn't send the item's
+        value directly and had to copy it (i.e. inflate it) first */
+    Couchbase::RelaxedAtomic<uint64_t> get_value_copies;
+
     /* # of bytes in the complete document which subdoc lookups searched
        within. Compare with 'bytes_subdoc_lookup_extracted' */
     Couchbase::RelaxedAtomic<uint64_t> bytes_subdoc_lookup_total;
@@ -168,6 +196,13 @@ struct thread_stats {
        received from the client). */
     Couchbase::RelaxedAtomic<uint64_t> bytes_subdoc_mutation_inserted;
 
+    /* # of subdoc lookup paths found in the subdoc path cache (and hence
+       which didn't need to parse the document). */
+    Couchbase::RelaxedAtomic<uint64_t> subdoc_path_cache_hits;
+    /* # of subdoc lookup paths searched for as they weren't in the subdoc
+       path cache (when enabled). */
+    Couchbase::RelaxedAtomic<uint64_t> subdoc_path_cache_misses;
+
     /* # of read buffers allocated. */
     Couchbase::RelaxedAtomic<uint64_t> rbufs_allocated;
     /* # of read buffers which could be loaned (and hence didn't need to be allocated). */
@@ -230,6 +265,9 @@ public:
     /** The hostname this port is bound to ("*" means all interfaces) */
     const std::string host;
 
+    /** The Unix domain socket path listened on (empty for TCP ports) */
+    std::string path;
+
     /** SSL related properties for the port */
     struct ifc_ssl_info {
         ifc_ssl_info()
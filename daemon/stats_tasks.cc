@@ -20,6 +20,7 @@
 #include "connection.h"
 #include "cookie.h"
 #include "memcached.h"
+#include "protocol/mcbp/engine_wrapper.h"
 #include <logger/logger.h>
 #include <nlohmann/json.hpp>
 
@@ -66,6 +67,30 @@ Task::Status StatsTaskConnectionStats::execute() {
     return Task::Status::Finished;
 }
 
+StatsTaskBucketStats::StatsTaskBucketStats(Connection& connection_,
+                                           Cookie& cookie_,
+                                           ADD_STAT add_stats_,
+                                           std::string key_)
+    : StatsTask(connection_, cookie_, add_stats_), key(std::move(key_)) {
+}
+
+Task::Status StatsTaskBucketStats::execute() {
+    try {
+        command_error = bucket_get_stats(cookie, key, add_stats);
+    } catch (const std::exception& exception) {
+        LOG_WARNING(
+                "{}: StatsTaskBucketStats::execute(): An exception "
+                "occurred while getting stats \"{}\": {}",
+                connection.getId(),
+                key,
+                exception.what());
+        cookie.setErrorContext("An exception occurred");
+        command_error = ENGINE_FAILED;
+    }
+
+    return Task::Status::Finished;
+}
+
 StatsTask::StatsTask(Connection& connection_,
                      Cookie& cookie_,
                      ADD_STAT add_stats_)
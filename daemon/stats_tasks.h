@@ -20,6 +20,8 @@
 #include <memcached/engine_common.h>
 #include <memcached/engine_error.h>
 
+#include <string>
+
 class Connection;
 
 class Cookie;
@@ -38,6 +40,12 @@ public:
 
     void notifyExecutionComplete() override;
 
+    /// Stats are served ahead of the other tasks (such as authentication),
+    /// so monitoring keeps working while the executors are busy.
+    Priority getPriority() const override {
+        return Priority::High;
+    }
+
     ENGINE_ERROR_CODE getCommandError() const {
         return command_error;
     }
@@ -65,3 +73,26 @@ public:
 protected:
     int64_t fd;
 };
+
+/**
+ * Collects a group of the bucket's engine stats, for the groups which are
+ * too expensive to collect on the front-end thread (they visit all of the
+ * vBuckets or DCP streams). The engine must collect the group synchronously
+ * (not return ENGINE_EWOULDBLOCK).
+ */
+class StatsTaskBucketStats : public StatsTask {
+public:
+    StatsTaskBucketStats() = delete;
+
+    StatsTaskBucketStats(const StatsTaskBucketStats&) = delete;
+
+    StatsTaskBucketStats(Connection& connection_,
+                         Cookie& cookie_,
+                         ADD_STAT add_stats_,
+                         std::string key_);
+
+    Status execute() override;
+
+protected:
+    const std::string key;
+};
@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "subdoc_path_cache.h"
+
+void SubdocPathCache::setMaxDocuments(size_t max) {
+    maxDocuments = max;
+    while (documents.size() > maxDocuments) {
+        index.erase(documents.back().id);
+        documents.pop_back();
+    }
+}
+
+bool SubdocPathCache::lookup(const std::string& id,
+                             uint64_t cas,
+                             size_t docLength,
+                             cb::const_char_buffer path,
+                             Location& location) {
+    auto iter = index.find(id);
+    if (iter == index.end()) {
+        return false;
+    }
+
+    auto& doc = *iter->second;
+    if (doc.cas != cas || doc.length != docLength) {
+        return false;
+    }
+
+    auto pathIter = doc.paths.find(std::string{path.data(), path.size()});
+    if (pathIter == doc.paths.end()) {
+        return false;
+    }
+
+    location = pathIter->second;
+    documents.splice(documents.begin(), documents, iter->second);
+    return true;
+}
+
+void SubdocPathCache::insert(const std::string& id,
+                             uint64_t cas,
+                             size_t docLength,
+                             cb::const_char_buffer path,
+                             const Location& location) {
+    if (maxDocuments == 0) {
+        return;
+    }
+
+    auto iter = index.find(id);
+    if (iter == index.end()) {
+        if (documents.size() == maxDocuments) {
+            index.erase(documents.back().id);
+            documents.pop_back();
+        }
+        documents.push_front({id, cas, docLength, {}});
+        iter = index.emplace(id, documents.begin()).first;
+    } else {
+        documents.splice(documents.begin(), documents, iter->second);
+    }
+
+    auto& doc = *iter->second;
+    if (doc.cas != cas || doc.length != docLength) {
+        doc.cas = cas;
+        doc.length = docLength;
+        doc.paths.clear();
+    }
+
+    if (doc.paths.size() < MaxPathsPerDocument) {
+        doc.paths[std::string{path.data(), path.size()}] = location;
+    }
+}
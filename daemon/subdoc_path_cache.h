@@ -0,0 +1,114 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <mcbp/protocol/status.h>
+#include <platform/sized_buffer.h>
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/**
+ * A cache of where lookup paths were found in recently searched documents.
+ *
+ * Searching a large document with subjson means parsing it from the start
+ * up to the path, for every lookup. When the same paths of the same (hot)
+ * document are read over and over again the cache lets a lookup skip the
+ * parse, and simply return the location recorded by an earlier lookup of
+ * the path.
+ *
+ * A document is identified by a caller provided string (bucket, vBucket
+ * and key) along with its CAS and length; any mutation of the document
+ * changes its CAS so the old locations are never used for the new value.
+ * The cache holds a bounded number of documents (least recently used are
+ * dropped first) and a bounded number of paths per document.
+ *
+ * The cache is not thread safe; there is one per front end thread.
+ */
+class SubdocPathCache {
+public:
+    /// Where a path was found in the document (if it was found).
+    struct Location {
+        cb::mcbp::Status status;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    /// The maximum number of paths remembered per document.
+    static const size_t MaxPathsPerDocument = 32;
+
+    /**
+     * Set the maximum number of documents to keep paths of; 0 disables the
+     * cache (and drops everything in it).
+     */
+    void setMaxDocuments(size_t max);
+
+    size_t getMaxDocuments() const {
+        return maxDocuments;
+    }
+
+    /// @return the number of documents currently in the cache
+    size_t size() const {
+        return index.size();
+    }
+
+    /**
+     * Look up where a path was found in the given version of a document.
+     *
+     * @param id the identity of the document
+     * @param cas the CAS of the document searched
+     * @param docLength the length of the document searched
+     * @param path the path to look up
+     * @param location set to the recorded location on success
+     * @return true if the path was found in the cache
+     */
+    bool lookup(const std::string& id,
+                uint64_t cas,
+                size_t docLength,
+                cb::const_char_buffer path,
+                Location& location);
+
+    /**
+     * Record where a path was found in the given version of a document.
+     * Any locations recorded for a different version of the document are
+     * dropped.
+     */
+    void insert(const std::string& id,
+                uint64_t cas,
+                size_t docLength,
+                cb::const_char_buffer path,
+                const Location& location);
+
+private:
+    struct Document {
+        std::string id;
+        uint64_t cas;
+        size_t length;
+        std::unordered_map<std::string, Location> paths;
+    };
+    using DocumentList = std::list<Document>;
+
+    size_t maxDocuments = 0;
+
+    /// The documents in the cache, most recently used first.
+    DocumentList documents;
+
+    /// Map of document identity to its entry in documents.
+    std::unordered_map<std::string, DocumentList::iterator> index;
+};
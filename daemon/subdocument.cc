@@ -26,9 +26,11 @@
 #include "protocol/mcbp/engine_wrapper.h"
 #include "settings.h"
 #include "subdoc/util.h"
+#include "subdoc_path_cache.h"
 #include "subdocument_context.h"
 #include "subdocument_traits.h"
 #include "subdocument_validators.h"
+#include "timing_histogram.h"
 #include "timings.h"
 #include "topkeys.h"
 #include "utilities/logtags.h"
@@ -61,6 +63,14 @@ static bool subdoc_fetch(Cookie& cookie,
                          Vbid vbucket,
                          uint64_t cas);
 
+static bool subdoc_check_fetched(Cookie& cookie,
+                                 SubdocCmdContext& ctx,
+                                 ENGINE_ERROR_CODE ret);
+
+static bool subdoc_prepare_document(Cookie& cookie,
+                                    SubdocCmdContext& ctx,
+                                    uint64_t cas);
+
 static bool subdoc_operate(SubdocCmdContext& context);
 
 static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
@@ -68,6 +78,32 @@ static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
                                        cb::const_byte_buffer key,
                                        Vbid vbucket,
                                        uint32_t expiration);
+
+static ENGINE_ERROR_CODE subdoc_allocate_new_doc(SubdocCmdContext& context,
+                                                 ENGINE_ERROR_CODE ret,
+                                                 cb::const_byte_buffer key,
+                                                 Vbid vbucket,
+                                                 uint32_t expiration);
+
+/// Outcome of asking the engine to apply a mutation in place.
+enum class InPlaceStatus {
+    /// The engine applied the mutation (or left the document unchanged as
+    /// some paths of a multi-mutation failed); continue with the response.
+    Success,
+    /// The engine doesn't support it; fetch and update the document instead.
+    NotSupported,
+    /// A response has been sent, or the command will be executed again.
+    Finished
+};
+
+static bool subdoc_can_mutate_in_place(Cookie& cookie,
+                                       const SubdocCmdContext& context);
+
+static InPlaceStatus subdoc_mutate_in_place(SubdocCmdContext& context,
+                                            cb::const_byte_buffer key,
+                                            Vbid vbucket,
+                                            uint64_t cas,
+                                            uint32_t expiration);
 static void subdoc_response(Cookie& cookie, SubdocCmdContext& context);
 
 // Debug - print details of the specified subdocument command.
@@ -381,36 +417,54 @@ static void subdoc_executor(Cookie& cookie, const SubdocCmdTraits traits) {
             cookie.setCommandContext(context);
         }
 
-        // 1. Attempt to fetch from the engine the document to operate on. Only
-        // continue if it returned true, otherwise return from this function
-        // (which may result in it being called again later in the EWOULDBLOCK
-        // case).
-        if (!subdoc_fetch(cookie, *context, ret, key, vbucket, cas)) {
-            return;
+        // If the engine supports it, have it apply a mutation to the
+        // document in place - with the document locked, so there can't be a
+        // concurrent update to retry after, nor a separate fetch and store.
+        bool updated = false;
+        if (ret == ENGINE_SUCCESS &&
+            subdoc_can_mutate_in_place(cookie, *context)) {
+            const auto status = subdoc_mutate_in_place(
+                    *context, key, vbucket, cas, expiration);
+            if (status == InPlaceStatus::Finished) {
+                return;
+            }
+            updated = (status == InPlaceStatus::Success);
         }
 
-        // 2. Perform the operation specified by CMD. Again, return if it fails.
-        if (!subdoc_operate(*context)) {
-            return;
-        }
+        if (!updated) {
+            // 1. Attempt to fetch from the engine the document to operate on.
+            // Only continue if it returned true, otherwise return from this
+            // function (which may result in it being called again later in
+            // the EWOULDBLOCK case).
+            if (!subdoc_fetch(cookie, *context, ret, key, vbucket, cas)) {
+                return;
+            }
 
-        // 3. Update the document in the engine (mutations only).
-        ret = subdoc_update(*context, ret, key, vbucket, expiration);
-        if (ret == ENGINE_KEY_EEXISTS) {
-            if (auto_retry) {
-                // Retry the operation. Reset the command context and related
-                // state, so start from the beginning again.
-                ret = ENGINE_SUCCESS;
+            // 2. Perform the operation specified by CMD. Again, return if it
+            // fails.
+            if (!subdoc_operate(*context)) {
+                return;
+            }
 
-                cookie.setCommandContext();
-                continue;
-            } else {
-                // No auto-retry - return status back to client and return.
-                cookie.sendResponse(cb::engine_errc(ret));
+            // 3. Update the document in the engine (mutations only).
+            ret = subdoc_update(*context, ret, key, vbucket, expiration);
+            if (ret == ENGINE_KEY_EEXISTS) {
+                if (auto_retry) {
+                    // Retry the operation. Reset the command context and
+                    // related state, so start from the beginning again.
+                    ret = ENGINE_SUCCESS;
+
+                    cookie.setCommandContext();
+                    continue;
+                } else {
+                    // No auto-retry - return status back to client and
+                    // return.
+                    cookie.sendResponse(cb::engine_errc(ret));
+                    return;
+                }
+            } else if (ret != ENGINE_SUCCESS) {
                 return;
             }
-        } else if (ret != ENGINE_SUCCESS) {
-            return;
         }
 
         // 4. Form a response and send it back to the client.
@@ -434,7 +488,9 @@ static void subdoc_executor(Cookie& cookie, const SubdocCmdTraits traits) {
 
             STATS_HIT(&cookie.getConnection(), get);
         }
-        update_topkeys(cookie);
+        update_topkeys(cookie,
+                       context->traits.is_mutator ? context->out_doc_len
+                                                  : context->in_doc.len);
         return;
     } while (auto_retry && attempts < MAXIMUM_ATTEMPTS);
 
@@ -479,56 +535,76 @@ static bool subdoc_fetch(Cookie& cookie,
             }
         }
 
-        switch (ret) {
-        case ENGINE_SUCCESS:
-            if (ctx.traits.is_mutator &&
-                ctx.mutationSemantics == MutationSemantics::Add) {
-                cookie.sendResponse(cb::mcbp::Status::KeyEexists);
-                return false;
-            }
-            ctx.needs_new_doc = false;
-            break;
-
-        case ENGINE_KEY_ENOENT:
-            if (ctx.traits.is_mutator &&
-                ctx.mutationSemantics == MutationSemantics::Replace) {
-                cookie.sendResponse(cb::engine_errc(ret));
-                return false;
-            }
-
-            // The item does not exist. Check the current command context to
-            // determine if we should at all write a new document (i.e. pretend
-            // it exists) and defer insert until later.. OR if we should simply
-            // bail.
-
-            if (ctx.jroot_type == JSONSL_T_LIST) {
-                ctx.in_doc = {"[]", 2};
-            } else if (ctx.jroot_type == JSONSL_T_OBJECT) {
-                ctx.in_doc = {"{}", 2};
-            } else {
-                cookie.sendResponse(cb::engine_errc(ret));
-                return false;
-            }
+        if (!subdoc_check_fetched(cookie, ctx, ret)) {
+            return false;
+        }
+    }
 
-            // Indicate that a new document is required:
-            ctx.needs_new_doc = true;
-            ctx.in_datatype = PROTOCOL_BINARY_DATATYPE_JSON;
-            return true;
+    return subdoc_prepare_document(cookie, ctx, cas);
+}
 
-        case ENGINE_EWOULDBLOCK:
-            cookie.setEwouldblock(true);
+// Check the result of fetching the document against the command, setting up
+// an empty document to operate on if it doesn't exist and the command allows
+// that.
+// Returns true if execution should continue, else false.
+static bool subdoc_check_fetched(Cookie& cookie,
+                                 SubdocCmdContext& ctx,
+                                 ENGINE_ERROR_CODE ret) {
+    switch (ret) {
+    case ENGINE_SUCCESS:
+        if (ctx.traits.is_mutator &&
+            ctx.mutationSemantics == MutationSemantics::Add) {
+            cookie.sendResponse(cb::mcbp::Status::KeyEexists);
             return false;
+        }
+        ctx.needs_new_doc = false;
+        return true;
 
-        case ENGINE_DISCONNECT:
-            cookie.getConnection().setState(StateMachine::State::closing);
+    case ENGINE_KEY_ENOENT:
+        if (ctx.traits.is_mutator &&
+            ctx.mutationSemantics == MutationSemantics::Replace) {
+            cookie.sendResponse(cb::engine_errc(ret));
             return false;
+        }
 
-        default:
+        // The item does not exist. Check the current command context to
+        // determine if we should at all write a new document (i.e. pretend
+        // it exists) and defer insert until later.. OR if we should simply
+        // bail.
+
+        if (ctx.jroot_type == JSONSL_T_LIST) {
+            ctx.in_doc = {"[]", 2};
+        } else if (ctx.jroot_type == JSONSL_T_OBJECT) {
+            ctx.in_doc = {"{}", 2};
+        } else {
             cookie.sendResponse(cb::engine_errc(ret));
             return false;
         }
+
+        // Indicate that a new document is required:
+        ctx.needs_new_doc = true;
+        ctx.in_datatype = PROTOCOL_BINARY_DATATYPE_JSON;
+        return true;
+
+    case ENGINE_EWOULDBLOCK:
+        cookie.setEwouldblock(true);
+        return false;
+
+    case ENGINE_DISCONNECT:
+        cookie.getConnection().setState(StateMachine::State::closing);
+        return false;
+
+    default:
+        cookie.sendResponse(cb::engine_errc(ret));
+        return false;
     }
+}
 
+// Make the fetched document available to subjson.
+// Returns true if execution should continue, else false.
+static bool subdoc_prepare_document(Cookie& cookie,
+                                    SubdocCmdContext& ctx,
+                                    uint64_t cas) {
     if (ctx.in_doc.buf == nullptr) {
         // Retrieve the item_info the engine, and if necessary
         // uncompress it so subjson can parse it.
@@ -545,6 +621,54 @@ static bool subdoc_fetch(Cookie& cookie,
     return true;
 }
 
+/**
+ * Get the front end thread's subdoc path cache if it may be used for the
+ * given operation; that is it's enabled and the operation is a GET or EXISTS
+ * of a path in the body of a (real) document.
+ *
+ * @return the cache to use, or nullptr if the operation can't use the cache
+ */
+static SubdocPathCache* subdoc_get_path_cache(
+        SubdocCmdContext& context,
+        const SubdocCmdContext::OperationSpec& spec) {
+    auto& cache = context.connection.getThread()->subdoc_path_cache;
+    const auto max = settings.getSubdocPathCacheSize();
+    if (cache.getMaxDocuments() != max) {
+        cache.setMaxDocuments(max);
+    }
+
+    if (max == 0 || context.traits.is_mutator ||
+        context.getCurrentPhase() != SubdocCmdContext::Phase::Body) {
+        return nullptr;
+    }
+
+    // Locked documents don't expose their real CAS, so the version of the
+    // document isn't known.
+    const auto cas = context.getInputItemInfo().cas;
+    if (cas == 0 || cas == LOCKED_CAS) {
+        return nullptr;
+    }
+
+    if (spec.traits.subdocCommand != Subdoc::Command::GET &&
+        spec.traits.subdocCommand != Subdoc::Command::EXISTS) {
+        return nullptr;
+    }
+
+    if (context.path_cache_id.empty()) {
+        auto& connection = context.connection;
+        const auto& request = context.cookie.getRequest();
+        const auto key = request.getKey();
+        context.path_cache_id =
+                std::to_string(connection.getBucketIndex()) + ":" +
+                std::to_string(request.getVBucket().get()) +
+                (connection.isCollectionsSupported() ? ":c:" : ":d:");
+        context.path_cache_id.append(reinterpret_cast<const char*>(key.data()),
+                                     key.size());
+    }
+
+    return &cache;
+}
+
 /**
  * Perform the subjson operation specified by {spec} to one path in the
  * document.
@@ -553,6 +677,25 @@ static cb::mcbp::Status subdoc_operate_one_path(
         SubdocCmdContext& context,
         SubdocCmdContext::OperationSpec& spec,
         const cb::const_char_buffer& in_doc) {
+    auto* pathCache = subdoc_get_path_cache(context, spec);
+    const auto cas = context.getInputItemInfo().cas;
+    if (pathCache) {
+        SubdocPathCache::Location loc;
+        auto* thread_stats = get_thread_stats(&context.connection);
+        if (pathCache->lookup(context.path_cache_id,
+                              cas,
+                              in_doc.size(),
+                              spec.path,
+                              loc)) {
+            thread_stats->subdoc_path_cache_hits++;
+            if (loc.status == cb::mcbp::Status::Success) {
+                spec.result.set_matchloc({in_doc.buf + loc.offset, loc.length});
+            }
+            return loc.status;
+        }
+        thread_stats->subdoc_path_cache_misses++;
+    }
+
     // Prepare the specified sub-document command.
     auto& op = context.connection.getThread()->subdoc_op;
     op.clear();
@@ -584,6 +727,43 @@ static cb::mcbp::Status subdoc_operate_one_path(
     // ... and execute it.
     const auto subdoc_res = op.op_exec(spec.path.buf, spec.path.len);
 
+    // Record where a GET found the path (or that the path doesn't resolve),
+    // which answers later GETs and EXISTSs of the path too.
+    if (pathCache && spec.traits.subdocCommand == Subdoc::Command::GET) {
+        const auto mloc = spec.result.matchloc();
+        switch (subdoc_res) {
+        case Subdoc::Error::SUCCESS:
+            if (mloc.at >= in_doc.buf &&
+                mloc.at + mloc.length <= in_doc.buf + in_doc.len) {
+                pathCache->insert(
+                        context.path_cache_id,
+                        cas,
+                        in_doc.size(),
+                        spec.path,
+                        {cb::mcbp::Status::Success,
+                         gsl::narrow<uint32_t>(mloc.at - in_doc.buf),
+                         gsl::narrow<uint32_t>(mloc.length)});
+            }
+            break;
+        case Subdoc::Error::PATH_ENOENT:
+            pathCache->insert(context.path_cache_id,
+                              cas,
+                              in_doc.size(),
+                              spec.path,
+                              {cb::mcbp::Status::SubdocPathEnoent, 0, 0});
+            break;
+        case Subdoc::Error::PATH_MISMATCH:
+            pathCache->insert(context.path_cache_id,
+                              cas,
+                              in_doc.size(),
+                              spec.path,
+                              {cb::mcbp::Status::SubdocPathMismatch, 0, 0});
+            break;
+        default:
+            break;
+        }
+    }
+
     switch (subdoc_res) {
     case Subdoc::Error::SUCCESS:
         return cb::mcbp::Status::Success;
@@ -1183,70 +1363,10 @@ static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
     // Allocate a new item of this size.
     if (context.out_doc == NULL &&
         !(context.no_sys_xattrs && context.do_delete_doc)) {
-
-        if (ret == ENGINE_SUCCESS) {
-            context.out_doc_len = context.in_doc.len;
-            auto allocate_key = cookie.getConnection().makeDocKey(key);
-            const size_t priv_bytes =
-                cb::xattr::get_system_xattr_size(context.in_datatype,
-                                                 context.in_doc);
-
-            // Calculate the updated document length - use the last operation result.
-            try {
-                auto r = bucket_allocate_ex(cookie,
-                                            allocate_key,
-                                            context.out_doc_len,
-                                            priv_bytes,
-                                            context.in_flags,
-                                            expiration,
-                                            context.in_datatype,
-                                            vbucket);
-                if (r.first) {
-                    // Save the allocated document in the cmd context.
-                    context.out_doc = std::move(r.first);
-                    ret = ENGINE_SUCCESS;
-                } else {
-                    ret = ENGINE_ENOMEM;
-                }
-            } catch (const cb::engine_error& e) {
-                ret = ENGINE_ERROR_CODE(e.code().value());
-                ret = context.connection.remapErrorCode(ret);
-            }
-        }
-
-        switch (ret) {
-        case ENGINE_SUCCESS:
-            // Save the allocated document in the cmd context.
-            break;
-
-        case ENGINE_EWOULDBLOCK:
-            cookie.setEwouldblock(true);
-            return ret;
-
-        case ENGINE_DISCONNECT:
-            connection.setState(StateMachine::State::closing);
-            return ret;
-
-        default:
-            cookie.sendResponse(cb::engine_errc(ret));
+        ret = subdoc_allocate_new_doc(context, ret, key, vbucket, expiration);
+        if (ret != ENGINE_SUCCESS) {
             return ret;
         }
-
-        // To ensure we only replace the version of the document we
-        // just appended to; set the CAS to the one retrieved from.
-        bucket_item_set_cas(connection, context.out_doc.get(), context.in_cas);
-
-        // Obtain the item info (and it's iovectors)
-        item_info new_doc_info;
-        if (!bucket_get_item_info(
-                    connection, context.out_doc.get(), &new_doc_info)) {
-            cookie.sendResponse(cb::mcbp::Status::Einternal);
-            return ENGINE_FAILED;
-        }
-
-        // Copy the new document into the item.
-        char* write_ptr = static_cast<char*>(new_doc_info.value[0].iov_base);
-        std::memcpy(write_ptr, context.in_doc.buf, context.in_doc.len);
     }
 
     // And finally, store the new document.
@@ -1338,6 +1458,191 @@ static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
     return ret;
 }
 
+// Allocate the item for the updated document and copy the document into it.
+// Returns ENGINE_SUCCESS if the item was allocated, otherwise the error (for
+// which a response has been sent if required).
+static ENGINE_ERROR_CODE subdoc_allocate_new_doc(SubdocCmdContext& context,
+                                                 ENGINE_ERROR_CODE ret,
+                                                 cb::const_byte_buffer key,
+                                                 Vbid vbucket,
+                                                 uint32_t expiration) {
+    auto& connection = context.connection;
+    auto& cookie = context.cookie;
+
+    if (ret == ENGINE_SUCCESS) {
+        context.out_doc_len = context.in_doc.len;
+        auto allocate_key = cookie.getConnection().makeDocKey(key);
+        const size_t priv_bytes = cb::xattr::get_system_xattr_size(
+                context.in_datatype, context.in_doc);
+
+        // Calculate the updated document length - use the last operation
+        // result.
+        try {
+            auto r = bucket_allocate_ex(cookie,
+                                        allocate_key,
+                                        context.out_doc_len,
+                                        priv_bytes,
+                                        context.in_flags,
+                                        expiration,
+                                        context.in_datatype,
+                                        vbucket);
+            if (r.first) {
+                // Save the allocated document in the cmd context.
+                context.out_doc = std::move(r.first);
+                ret = ENGINE_SUCCESS;
+            } else {
+                ret = ENGINE_ENOMEM;
+            }
+        } catch (const cb::engine_error& e) {
+            ret = ENGINE_ERROR_CODE(e.code().value());
+            ret = context.connection.remapErrorCode(ret);
+        }
+    }
+
+    switch (ret) {
+    case ENGINE_SUCCESS:
+        // Save the allocated document in the cmd context.
+        break;
+
+    case ENGINE_EWOULDBLOCK:
+        cookie.setEwouldblock(true);
+        return ret;
+
+    case ENGINE_DISCONNECT:
+        connection.setState(StateMachine::State::closing);
+        return ret;
+
+    default:
+        cookie.sendResponse(cb::engine_errc(ret));
+        return ret;
+    }
+
+    // To ensure we only replace the version of the document we
+    // just appended to; set the CAS to the one retrieved from.
+    bucket_item_set_cas(connection, context.out_doc.get(), context.in_cas);
+
+    // Obtain the item info (and it's iovectors)
+    item_info new_doc_info;
+    if (!bucket_get_item_info(
+                connection, context.out_doc.get(), &new_doc_info)) {
+        cookie.sendResponse(cb::mcbp::Status::Einternal);
+        return ENGINE_FAILED;
+    }
+
+    // Copy the new document into the item.
+    char* write_ptr = static_cast<char*>(new_doc_info.value[0].iov_base);
+    std::memcpy(write_ptr, context.in_doc.buf, context.in_doc.len);
+    return ENGINE_SUCCESS;
+}
+
+// Returns true if the command can be executed by the engine applying it to
+// the document in place.
+static bool subdoc_can_mutate_in_place(Cookie& cookie,
+                                       const SubdocCmdContext& context) {
+    // Only a fresh command context; any other has already fetched (or
+    // operated on) the document. Deleted documents and sync writes need the
+    // remove / store paths of subdoc_update.
+    return context.traits.is_mutator && !context.fetchedItem &&
+           !context.needs_new_doc && !context.executed &&
+           !context.do_allow_deleted_docs && !context.do_delete_doc &&
+           !cookie.getRequest(Cookie::PacketContent::Full)
+                    .getDurabilityRequirements();
+}
+
+// Have the engine apply the mutation to the document in place: the
+// fetch / operate / update steps run as a DocumentMutator called by the
+// engine with the document locked.
+static InPlaceStatus subdoc_mutate_in_place(SubdocCmdContext& context,
+                                            cb::const_byte_buffer key,
+                                            Vbid vbucket,
+                                            uint64_t cas,
+                                            uint32_t expiration) {
+    auto& connection = context.connection;
+    auto& cookie = context.cookie;
+
+    // Set if the mutator has already sent a response (or arranged for the
+    // command to be executed again).
+    bool finished = false;
+    bool stored = false;
+    auto mutator = [&context, &cookie, &finished, &stored, key, vbucket, cas,
+                    expiration](cb::unique_item_ptr current)
+            -> std::pair<cb::engine_errc, item*> {
+        context.fetchedItem = std::move(current);
+        const auto fetched =
+                context.fetchedItem ? ENGINE_SUCCESS : ENGINE_KEY_ENOENT;
+        if (!subdoc_check_fetched(cookie, context, fetched) ||
+            !subdoc_prepare_document(cookie, context, cas) ||
+            !subdoc_operate(context)) {
+            finished = true;
+            return {cb::engine_errc::success, nullptr};
+        }
+
+        // As subdoc_update: a multi-mutation only changes the document if
+        // all of its paths succeeded.
+        if (context.overall_status != cb::mcbp::Status::Success) {
+            return {cb::engine_errc::success, nullptr};
+        }
+
+        if (subdoc_allocate_new_doc(
+                    context, ENGINE_SUCCESS, key, vbucket, expiration) !=
+            ENGINE_SUCCESS) {
+            finished = true;
+            return {cb::engine_errc::success, nullptr};
+        }
+        stored = true;
+        return {cb::engine_errc::success, context.out_doc.get()};
+    };
+
+    auto docKey = connection.makeDocKey(key);
+    auto r = bucket_mutate_in_place(cookie, docKey, vbucket, mutator);
+    if (r.status == cb::engine_errc::not_supported) {
+        return InPlaceStatus::NotSupported;
+    }
+    if (finished) {
+        return InPlaceStatus::Finished;
+    }
+
+    auto ret = connection.remapErrorCode(ENGINE_ERROR_CODE(r.status));
+    switch (ret) {
+    case ENGINE_SUCCESS:
+        break;
+
+    case ENGINE_EWOULDBLOCK:
+        // The document is being fetched from disk - the mutator wasn't
+        // called, so the command starts afresh when executed again.
+        cookie.setEwouldblock(true);
+        return InPlaceStatus::Finished;
+
+    case ENGINE_DISCONNECT:
+        connection.setState(StateMachine::State::closing);
+        return InPlaceStatus::Finished;
+
+    default:
+        cookie.sendResponse(cb::engine_errc(ret));
+        return InPlaceStatus::Finished;
+    }
+
+    if (stored) {
+        // Record the UUID / Seqno if MUTATION_SEQNO feature is enabled so
+        // we can include it in the response.
+        if (connection.isSupportsMutationExtras()) {
+            item_info info;
+            if (!bucket_get_item_info(
+                        connection, context.out_doc.get(), &info)) {
+                LOG_WARNING("{}: Subdoc: Failed to get item info",
+                            connection.getId());
+                cookie.sendResponse(cb::mcbp::Status::Einternal);
+                return InPlaceStatus::Finished;
+            }
+
+            context.vbucket_uuid = info.vbucket_uuid;
+            context.sequence_no = info.seqno;
+        }
+        cookie.setCas(r.cas);
+    }
+    return InPlaceStatus::Success;
+}
+
 /* Encodes the context's mutation sequence number and vBucket UUID into the
  * given buffer.
  * @param descr Buffer to write to. Must be 16 bytes in size.
@@ -31,6 +31,7 @@
 #include <utilities/string_utilities.h>
 #include <xattr/blob.h>
 #include <gsl/gsl>
+#include <cstring>
 #include <iomanip>
 #include <random>
 #include <sstream>
@@ -346,12 +347,19 @@ cb::mcbp::Status SubdocCmdContext::get_document_for_searching(
     in_document_state = info.document_state;
 
     if (mcbp::datatype::is_snappy(info.datatype)) {
-        // Need to expand before attempting to extract from it.
+        // Need to expand before attempting to extract from it; if only the
+        // XATTRs are going to be looked at that's all which is expanded.
         try {
             using namespace cb::compression;
-            if (!inflate(Algorithm::Snappy,
-                         in_doc,
-                         inflated_doc_buffer)) {
+            bool inflated;
+            if (needsOnlyXattrs()) {
+                inflated = cb::xattr::inflate_xattrs(in_doc,
+                                                     inflated_doc_buffer);
+            } else {
+                inflated = inflate(
+                        Algorithm::Snappy, in_doc, inflated_doc_buffer);
+            }
+            if (!inflated) {
                 char clean_key[KEY_MAX_LENGTH + 32];
                 if (buf_to_printable_buffer(
                             clean_key,
@@ -380,6 +388,20 @@ cb::mcbp::Status SubdocCmdContext::get_document_for_searching(
     return cb::mcbp::Status::Success;
 }
 
+bool SubdocCmdContext::needsOnlyXattrs() {
+    if (traits.is_mutator ||
+        !mcbp::datatype::is_xattr(getInputItemInfo().datatype) ||
+        !getOperations(Phase::Body).empty()) {
+        return false;
+    }
+
+    // The $document virtual XATTR describes the body (its size and CRC).
+    const auto& document = cb::xattr::vattrs::DOCUMENT;
+    return xattr_key.size() != document.size() ||
+           std::memcmp(xattr_key.data(), document.data(), document.size()) !=
+                   0;
+}
+
 uint32_t SubdocCmdContext::computeValueCRC32C() {
     cb::const_char_buffer value;
     if (mcbp::datatype::is_xattr(in_datatype)) {
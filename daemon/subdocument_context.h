@@ -151,7 +151,9 @@ public:
     // c). {intermediate_result} member of this object.
     // Either way, it should /not/ be cb_free()d.
     // Note this is *always* in a decompressed form (and hence can safely be
-    // read / manipulated directly) - see get_document_for_searching().
+    // read / manipulated directly) - see get_document_for_searching(). When
+    // the command only needs the XATTRs of a compressed document, only they
+    // are inflated (and the body is empty) - see needsOnlyXattrs().
     // TODO: Remove (b), and just use intermediate result.
     cb::const_char_buffer in_doc{};
 
@@ -219,6 +221,10 @@ public:
     // Size in bytes of the response value to send back to the client.
     size_t response_val_len = 0;
 
+    // [Lookups only] Identity of the document in the front end thread's
+    // subdoc path cache; built the first time the cache is used.
+    std::string path_cache_id;
+
     // Set to true if one (or more) of the xattr operation wants to do
     // macro expansion.
     bool do_macro_expansion = false;
@@ -330,6 +336,12 @@ public:
      */
     cb::mcbp::Status get_document_for_searching(uint64_t client_cas);
 
+    /**
+     * Does this command only look at the XATTRs of the input document (so
+     * a compressed document's body doesn't need to be inflated)?
+     */
+    bool needsOnlyXattrs();
+
     /**
      * The result of subdoc_fetch.
      */
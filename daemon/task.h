@@ -34,6 +34,16 @@ class Task {
 public:
     enum class Status { Finished, Continue };
 
+    /**
+     * The lane of the executor's run queue the task is served from. The
+     * lanes are served by weight (see Executor), so a burst of tasks in one
+     * lane delays but can't starve the others.
+     */
+    enum class Priority { High, Normal, Low };
+
+    /// The number of priority lanes
+    static const size_t NumPriorities = 3;
+
     Task() : executor(nullptr) {
         // empty
     }
@@ -60,6 +70,14 @@ public:
     virtual void notifyExecutionComplete() {
     }
 
+    /**
+     * Get the priority of the task. It's read whenever the task is put in
+     * the run queue, and should not change while the task is scheduled.
+     */
+    virtual Priority getPriority() const {
+        return Priority::Normal;
+    }
+
     /**
      * Get the mutex used to protect the task and to ensure that we don't
      * have any race conditions. It should be held when:
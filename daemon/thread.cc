@@ -21,6 +21,7 @@
 #include <platform/platform.h>
 #include <platform/socket.h>
 #include <platform/strerror.h>
+#include <utilities/cpu_affinity.h>
 
 #include <fcntl.h>
 #include <atomic>
@@ -33,8 +34,11 @@
 #ifndef WIN32
 #include <netinet/tcp.h> // For TCP_NODELAY etc
 #endif
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <queue>
+#include <utility>
 
 extern std::atomic<bool> memcached_shutdown;
 
@@ -166,11 +170,60 @@ static void setup_dispatcher(struct event_base *main_base,
     }
 }
 
+/*
+ * Create the event base for a front end thread, using the backend and
+ * flags from the settings.
+ */
+static struct event_base* create_event_base() {
+    const auto& backend = settings.getEventBackend();
+    if (backend.empty() && !settings.isEventChangelistEnabled()) {
+        return event_base_new();
+    }
+
+    std::unique_ptr<event_config, void (*)(event_config*)> config(
+            event_config_new(), event_config_free);
+    if (!config) {
+        return nullptr;
+    }
+
+    if (!backend.empty()) {
+        // libevent picks the best backend it isn't told to avoid
+        for (auto** method = event_get_supported_methods(); *method;
+             ++method) {
+            if (backend != *method) {
+                event_config_avoid_method(config.get(), *method);
+            }
+        }
+    }
+
+    if (settings.isEventChangelistEnabled()) {
+        event_config_set_flag(config.get(),
+                              EVENT_BASE_FLAG_EPOLL_USE_CHANGELIST);
+    }
+
+    auto* base = event_base_new_with_config(config.get());
+    if (base == nullptr) {
+        LOG_WARNING(
+                "Failed to create an event base with the event backend "
+                "\"{}\", using the default",
+                backend);
+        return event_base_new();
+    }
+
+    if (!backend.empty() && backend != event_base_get_method(base)) {
+        LOG_WARNING(
+                "The event backend \"{}\" isn't available, using \"{}\"",
+                backend,
+                event_base_get_method(base));
+    }
+    return base;
+}
+
 /*
  * Set up a thread's information.
  */
 static void setup_thread(FrontEndThread& me) {
-    me.base = event_base_new();
+    me.base = create_event_base();
 
     if (!me.base) {
         FATAL_ERROR(EXIT_FAILURE, "Can't allocate event base");
@@ -197,6 +250,17 @@ static void worker_libevent(void *arg) {
     /* Any per-thread setup can happen here; thread_init() will block until
      * all threads have finished initializing.
      */
+    const auto& cpus = settings.getWorkerCpuAffinity();
+    if (!cpus.empty()) {
+        const auto cpu = cpus[me->index % cpus.size()];
+        if (bind_current_thread_to_cpus({cpu})) {
+            LOG_DEBUG("Worker thread {} pinned to CPU {}", me->index, cpu);
+        } else {
+            LOG_WARNING("Failed to pin worker thread {} to CPU {}",
+                        me->index,
+                        cpu);
+        }
+    }
 
     cb_mutex_enter(&init_lock);
     me->running = true;
@@ -243,8 +307,272 @@ static void dispatch_new_connections(FrontEndThread& me) {
             LOG_WARNING("Failed to dispatch event for socket {}",
                         long(item->sfd));
             safe_close(item->sfd);
+            me.load.connections--;
+        }
+    }
+}
+
+/*
+ * Start serving the connections other threads handed over to us.
+ */
+static void register_migrated_connections(FrontEndThread& me) {
+    std::vector<Connection*> conns;
+    {
+        std::lock_guard<std::mutex> lock(me.migrated.mutex);
+        me.migrated.conns.swap(conns);
+    }
+
+    for (auto* c : conns) {
+        if (!c->isRegisteredInLibevent() && !c->registerEvent()) {
+            LOG_WARNING("{}: Failed to register migrated connection on "
+                        "worker thread {}. Closing connection",
+                        c->getId(),
+                        me.index);
+            c->setState(StateMachine::State::closing);
+            run_event_loop(c, EV_READ | EV_WRITE);
+        }
+    }
+}
+
+/*
+ * The worker threads are split into worker_thread_groups contiguous groups
+ * (of nearly equal size), and the buckets are given a group in turn.
+ */
+static size_t num_thread_groups() {
+    return std::min(settings.getNumWorkerThreadGroups(),
+                    settings.getNumWorkerThreads());
+}
+
+/*
+ * The range [first, last) of the worker threads which should serve the
+ * connection: those of its bucket's group, or all of them.
+ */
+static std::pair<size_t, size_t> worker_threads_for(const Connection& c) {
+    const size_t nthr = settings.getNumWorkerThreads();
+    const size_t groups = num_thread_groups();
+    const auto bucket = size_t(c.getBucketIndex());
+    if (groups < 2 || bucket == 0) {
+        return {0, nthr};
+    }
+    const size_t group = (bucket - 1) % groups;
+    return {group * nthr / groups, (group + 1) * nthr / groups};
+}
+
+static bool serves_bucket_of(const FrontEndThread& thread,
+                             const Connection& c) {
+    const auto range = worker_threads_for(c);
+    return thread.index >= range.first && thread.index < range.second;
+}
+
+static FrontEndThread& least_loaded_thread(std::pair<size_t, size_t> range) {
+    return *std::min_element(threads.begin() + range.first,
+                             threads.begin() + range.second,
+                             [](const FrontEndThread& a,
+                                const FrontEndThread& b) {
+                                 return a.load.connections <
+                                        b.load.connections;
+                             });
+}
+
+static FrontEndThread& least_loaded_dcp_thread() {
+    const auto workers = threads.begin() + settings.getNumWorkerThreads();
+    return *std::min_element(workers,
+                             threads.end(),
+                             [](const FrontEndThread& a,
+                                const FrontEndThread& b) {
+                                 return a.load.connections <
+                                        b.load.connections;
+                             });
+}
+
+/*
+ * Hand idle connections over to the least loaded threads, as requested by
+ * rebalance_connections().
+ */
+static void migrate_connections(FrontEndThread& me) {
+    const size_t wanted = me.migrate_out.exchange(0);
+    if (wanted == 0) {
+        return;
+    }
+
+    std::vector<Connection*> candidates;
+    iterate_thread_connections(&me, [&candidates, wanted](Connection& c) {
+        if (candidates.size() < wanted && c.isMigratable()) {
+            candidates.push_back(&c);
+        }
+    });
+    {
+        // Connections with a notification pending must stay where they are
+        std::lock_guard<std::mutex> lock(me.pending_io.mutex);
+        auto pending = [&me](Connection* c) {
+            return me.pending_io.map.count(c) != 0;
+        };
+        candidates.erase(
+                std::remove_if(candidates.begin(), candidates.end(), pending),
+                candidates.end());
+    }
+
+    size_t moved = 0;
+    for (auto* c : candidates) {
+        // Connections only move within their bucket's thread group
+        auto& target = least_loaded_thread(worker_threads_for(*c));
+        if (&target == &me ||
+            target.load.connections + 1 >= me.load.connections) {
+            continue;
+        }
+        if (!c->moveToThread(target)) {
+            continue;
+        }
+        me.load.connections--;
+        target.load.connections++;
+        {
+            std::lock_guard<std::mutex> lock(target.migrated.mutex);
+            target.migrated.conns.push_back(c);
         }
+        notify_thread(target);
+        ++moved;
     }
+
+    LOG_INFO("Worker thread {}: moved {} idle connections to other threads",
+             me.index,
+             moved);
+}
+
+/*
+ * Hand the DCP connections opened on this worker thread over to the
+ * threads dedicated to DCP, as requested by request_dcp_thread(). A
+ * connection is only moved between commands; until then it stays pending
+ * (and notifies us again when it next becomes idle).
+ */
+static void move_dcp_connections(FrontEndThread& me) {
+    if (!me.dcp_move_pending) {
+        return;
+    }
+    me.dcp_move_pending = false;
+
+    std::vector<Connection*> candidates;
+    iterate_thread_connections(&me, [&me, &candidates](Connection& c) {
+        if (c.isDcpThreadMovePending()) {
+            if (c.isIdleBetweenCommands()) {
+                candidates.push_back(&c);
+            } else {
+                me.dcp_move_pending = true;
+            }
+        }
+    });
+
+    for (auto* c : candidates) {
+        auto& target = least_loaded_dcp_thread();
+        {
+            // A connection with a notification pending must stay until it
+            // has been served. Holding the lock while moving makes anyone
+            // about to notify the connection find it on its new thread
+            // (see add_conn_to_pending_io_list)
+            std::lock_guard<std::mutex> lock(me.pending_io.mutex);
+            if (me.pending_io.map.count(c) != 0) {
+                me.dcp_move_pending = true;
+                continue;
+            }
+            c->setDcpThreadMovePending(false);
+            if (!c->moveToThread(target)) {
+                continue;
+            }
+        }
+        me.load.connections--;
+        target.load.connections++;
+        if (c->isDCP()) {
+            me.load.dcp_connections--;
+            target.load.dcp_connections++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(target.migrated.mutex);
+            target.migrated.conns.push_back(c);
+        }
+        notify_thread(target);
+        LOG_INFO("{}: Moved DCP connection from worker thread {} to DCP "
+                 "thread {}",
+                 c->getId(),
+                 me.index,
+                 target.index);
+    }
+}
+
+/*
+ * Hand the connections of this thread waiting for a thread of their bucket's
+ * group over to the least loaded thread of the group, as requested by
+ * request_bucket_thread(). Like the move to a DCP thread, a connection is
+ * only moved between commands.
+ */
+static void move_bucket_connections(FrontEndThread& me) {
+    if (!me.bucket_move_pending.exchange(false)) {
+        return;
+    }
+
+    std::vector<Connection*> candidates;
+    iterate_thread_connections(&me, [&me, &candidates](Connection& c) {
+        if (!c.isBucketThreadMovePending()) {
+            return;
+        }
+        if (c.isDCP() || serves_bucket_of(me, c)) {
+            // DCP connections have their own threads, and the connection
+            // may have selected another bucket since
+            c.setBucketThreadMovePending(false);
+        } else if (c.isMigratable()) {
+            candidates.push_back(&c);
+        } else {
+            me.bucket_move_pending = true;
+        }
+    });
+
+    for (auto* c : candidates) {
+        auto& target = least_loaded_thread(worker_threads_for(*c));
+        {
+            // See move_dcp_connections()
+            std::lock_guard<std::mutex> lock(me.pending_io.mutex);
+            if (me.pending_io.map.count(c) != 0) {
+                me.bucket_move_pending = true;
+                continue;
+            }
+            c->setBucketThreadMovePending(false);
+            if (!c->moveToThread(target)) {
+                continue;
+            }
+        }
+        me.load.connections--;
+        target.load.connections++;
+        {
+            std::lock_guard<std::mutex> lock(target.migrated.mutex);
+            target.migrated.conns.push_back(c);
+        }
+        notify_thread(target);
+        LOG_DEBUG("{}: Moved connection from worker thread {} to worker "
+                  "thread {} of its bucket's group",
+                  c->getId(),
+                  me.index,
+                  target.index);
+    }
+}
+
+void request_bucket_thread(Connection& c) {
+    auto* thread = c.getThread();
+    if (num_thread_groups() < 2 || thread == nullptr || thread->dcp ||
+        serves_bucket_of(*thread, c)) {
+        return;
+    }
+    c.setBucketThreadMovePending(true);
+    thread->bucket_move_pending = true;
+    notify_thread(*thread);
+}
+
+void request_dcp_thread(Connection& c) {
+    auto* thread = c.getThread();
+    if (settings.getNumDcpThreads() == 0 || thread == nullptr ||
+        thread->dcp) {
+        return;
+    }
+    c.setDcpThreadMovePending(true);
+    thread->dcp_move_pending = true;
+    notify_thread(*thread);
 }
 
 /*
@@ -303,6 +631,12 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
             if (pair.first) {
                 pair.first->setAiostat(pair.second);
                 pair.first->setEwouldblock(false);
+                // Close the span the engine may have opened when it
+                // notified us (e.g. when a background fetch completed)
+                if (pair.first->isTracingEnabled()) {
+                    pair.first->getTracer().end(
+                            cb::tracing::TraceCode::NOTIFY_IO);
+                }
             }
         }
 
@@ -315,6 +649,11 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
         run_event_loop(c, EV_READ | EV_WRITE);
     }
 
+    register_migrated_connections(me);
+    migrate_connections(me);
+    move_dcp_connections(me);
+    move_bucket_connections(me);
+
     /*
      * I could look at all of the connection objects bound to dying buckets
      */
@@ -359,21 +698,91 @@ void notify_io_complete(gsl::not_null<const void*> void_cookie,
               cookie.getConnection().getId(),
               status);
 
-    /* kick the thread in the butt */
+    /* kick the thread in the butt (which may not be the thread we looked
+     * up if the connection moved in the meantime) */
     if (add_conn_to_pending_io_list(&cookie.getConnection(), &cookie, status)) {
-        notify_thread(*thr);
+        notify_thread(*cookie.getConnection().getThread());
     }
 }
 
 /* Which thread we assigned a connection to most recently. */
 static int last_thread = -1;
 
+/* A DCP connection counts as this many connections when dispatching. */
+static const size_t DcpConnectionWeight = 4;
+
+/* How often the dispatcher samples the worker threads' CPU usage. */
+static const std::chrono::seconds DispatchSampleInterval{1};
+
+/*
+ * The dispatcher's view of the worker threads' recent CPU usage. Only
+ * accessed from dispatch_conn_new().
+ */
+static struct {
+    std::chrono::steady_clock::time_point sampled;
+    /// Each thread's load.cpu_time when last sampled
+    std::vector<uint64_t> cpu_time;
+    /// The (smoothed) fraction of the sample interval each thread was busy
+    std::vector<double> busy;
+} dispatch_load;
+
+static void sample_dispatch_load(size_t nthr) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto elapsed = now - dispatch_load.sampled;
+    if (dispatch_load.busy.size() == nthr && elapsed < DispatchSampleInterval) {
+        return;
+    }
+
+    dispatch_load.cpu_time.resize(nthr, 0);
+    dispatch_load.busy.resize(nthr, 0.0);
+    const double interval =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count();
+    for (size_t ii = 0; ii < nthr; ++ii) {
+        const uint64_t cpu = threads[ii].load.cpu_time;
+        const double busy = std::min(
+                1.0, double(cpu - dispatch_load.cpu_time[ii]) / interval);
+        dispatch_load.busy[ii] = (dispatch_load.busy[ii] + busy) / 2;
+        dispatch_load.cpu_time[ii] = cpu;
+    }
+    dispatch_load.sampled = now;
+}
+
+/*
+ * Pick the worker thread for a new connection: the least busy thread (in
+ * steps of 10% of recent CPU usage), and of those the one with the fewest
+ * connections, DCP connections weighing more. Ties go round-robin, so
+ * connections are spread as before while the threads are evenly loaded.
+ */
+static size_t select_dispatch_thread() {
+    const size_t nthr = settings.getNumWorkerThreads();
+    sample_dispatch_load(nthr);
+
+    size_t best = 0;
+    int bestBusy = 0;
+    size_t bestWeight = 0;
+    for (size_t step = 1; step <= nthr; ++step) {
+        const size_t tid = (last_thread + step) % nthr;
+        const auto& load = threads[tid].load;
+        const int busy = int(dispatch_load.busy[tid] * 10);
+        const size_t weight = load.connections +
+                              (DcpConnectionWeight - 1) * load.dcp_connections;
+        if (step == 1 || busy < bestBusy ||
+            (busy == bestBusy && weight < bestWeight)) {
+            best = tid;
+            bestBusy = busy;
+            bestWeight = weight;
+        }
+    }
+    return best;
+}
+
 /*
  * Dispatches a new connection to another thread. This is only ever called
  * from the main thread, or because of an incoming connection.
  */
 void dispatch_conn_new(SOCKET sfd, in_port_t parent_port) {
-    size_t tid = (last_thread + 1) % settings.getNumWorkerThreads();
+    size_t tid = select_dispatch_thread();
     auto& thread = threads[tid];
     last_thread = gsl::narrow<int>(tid);
 
@@ -388,9 +797,51 @@ void dispatch_conn_new(SOCKET sfd, in_port_t parent_port) {
         return ;
     }
 
+    thread.load.connections++;
     notify_thread(thread);
 }
 
+void dispatch_conn_local(FrontEndThread& thread,
+                         SOCKET sfd,
+                         in_port_t parent_port) {
+    thread.load.connections++;
+    if (conn_new(sfd, parent_port, thread.base, &thread) == nullptr) {
+        LOG_WARNING("dispatch_conn_local: Failed to create connection for "
+                    "socket {}",
+                    long(sfd));
+        safe_close(sfd);
+        thread.load.connections--;
+    }
+}
+
+FrontEndThread& get_worker_thread(size_t index) {
+    return threads.at(index);
+}
+
+void rebalance_connections() {
+    // The DCP threads only serve DCP connections, which don't migrate, and
+    // the connections of the buckets of a thread group stay in the group
+    const size_t nthr = settings.getNumWorkerThreads();
+    const size_t groups = std::max(size_t(1), num_thread_groups());
+    for (size_t group = 0; group < groups; ++group) {
+        const size_t first = group * nthr / groups;
+        const size_t last = (group + 1) * nthr / groups;
+        size_t total = 0;
+        for (size_t ii = first; ii < last; ++ii) {
+            total += threads[ii].load.connections;
+        }
+        const size_t share = (total + last - first - 1) / (last - first);
+        for (size_t ii = first; ii < last; ++ii) {
+            auto& thread = threads[ii];
+            const size_t connections = thread.load.connections;
+            if (connections > share) {
+                thread.migrate_out = connections - share;
+                notify_thread(thread);
+            }
+        }
+    }
+}
+
 /*
  * Returns true if this is the thread that listens for new TCP connections.
  */
@@ -414,43 +865,50 @@ void threadlocal_stats_reset(std::vector<thread_stats>& thread_stats) {
  * Initializes the thread subsystem, creating various worker threads.
  *
  * nthreads  Number of worker event handler threads to spawn
+ * ndcpthreads Number of event handler threads to spawn for DCP connections
+ *             (they follow the worker threads in the threads array)
  * main_base Event base for main thread
  */
 void thread_init(size_t nthr,
+                 size_t ndcpthr,
                  struct event_base* main_base,
                  void (*dispatcher_callback)(evutil_socket_t, short, void*)) {
     cb_mutex_initialize(&init_lock);
     cb_cond_initialize(&init_cond);
 
-    scheduler_info.resize(nthr);
+    const size_t total = nthr + ndcpthr;
+    scheduler_info.resize(total);
 
     try {
-        threads = std::vector<FrontEndThread>(nthr);
+        threads = std::vector<FrontEndThread>(total);
     } catch (const std::bad_alloc&) {
         FATAL_ERROR(EXIT_FAILURE, "Can't allocate thread descriptors");
     }
 
     setup_dispatcher(main_base, dispatcher_callback);
 
-    for (size_t ii = 0; ii < nthr; ii++) {
+    for (size_t ii = 0; ii < total; ii++) {
         if (!create_notification_pipe(threads[ii])) {
             FATAL_ERROR(EXIT_FAILURE, "Cannot create notification pipe");
         }
         threads[ii].index = ii;
+        threads[ii].dcp = ii >= nthr;
 
         setup_thread(threads[ii]);
     }
 
     /* Create threads after we've done all the libevent setup. */
     for (auto& thread : threads) {
-        const std::string name = "mc:worker_" + std::to_string(thread.index);
+        const std::string name =
+                thread.dcp ? "mc:dcp_" + std::to_string(thread.index - nthr)
+                           : "mc:worker_" + std::to_string(thread.index);
         create_worker(
                 worker_libevent, &thread, &thread.thread_id, name.c_str());
     }
 
     /* Wait for all the threads to set themselves up before returning. */
     cb_mutex_enter(&init_lock);
-    while (init_count < nthr) {
+    while (init_count < total) {
         cb_cond_wait(&init_cond, &init_lock);
     }
     cb_mutex_exit(&init_lock);
@@ -528,15 +986,25 @@ int add_conn_to_pending_io_list(Connection* c,
                                 Cookie* cookie,
                                 ENGINE_ERROR_CODE status) {
     auto* thread = c->getThread();
-
-    std::lock_guard<std::mutex> lock(thread->pending_io.mutex);
+    std::unique_lock<std::mutex> lock(thread->pending_io.mutex);
+    while (c->getThread() != thread) {
+        // The connection moved to another thread (which is done holding
+        // this lock) before we got the lock; its new thread serves it
+        lock.unlock();
+        thread = c->getThread();
+        lock = std::unique_lock<std::mutex>(thread->pending_io.mutex);
+    }
+
+    // The thread has already been notified (and not yet taken the list)
+    // unless the list is empty.
+    const bool notify = thread->pending_io.map.empty();
     auto iter = thread->pending_io.map.find(c);
     if (iter == thread->pending_io.map.end()) {
         thread->pending_io.map.emplace(
                 c,
                 std::vector<std::pair<Cookie*, ENGINE_ERROR_CODE>>{
                         {cookie, status}});
-        return 1;
+        return notify;
     } else {
         for (const auto& pair : iter->second) {
             if (pair.first == cookie) {
@@ -546,6 +1014,6 @@ int add_conn_to_pending_io_list(Connection* c,
             }
         }
         iter->second.push_back({cookie, status});
-        return 1;
+        return notify;
     }
 }
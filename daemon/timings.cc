@@ -16,23 +16,73 @@
  */
 #include "timings.h"
 #include <memcached/protocol_binary.h>
+#include <nlohmann/json.hpp>
 #include <platform/platform.h>
-#include "timing_histogram.h"
+
+#include <algorithm>
+
+// Track from 1us to an hour, to 1 significant figure (each power of two is
+// split into 16 buckets, so a value is reported to within ~6%).
+static const uint64_t MaxTrackedMicros = 3600ULL * 1000 * 1000;
+
+struct Timings::ThreadTimings {
+    /**
+     * Only contended by the readers (and reset()), as the histograms are
+     * only recorded into by the thread they belong to.
+     */
+    mutable std::mutex mutex;
+
+    /// Allocated the first time the thread runs each opcode
+    std::array<std::unique_ptr<HdrHistogram>, MAX_NUM_OPCODES> histograms;
+
+    std::array<cb::sampling::Interval, MAX_NUM_OPCODES> interval_counters;
+};
 
 Timings::Timings() {
     reset();
 }
 
+Timings::~Timings() = default;
+
 Timings& Timings::operator=(const Timings& other) {
-    timings = other.timings;
+    resize(other.threads.size());
+    for (size_t ii = 0; ii < threads.size(); ++ii) {
+        auto& dst = *threads[ii];
+        const auto& src = *other.threads[ii];
+        std::lock(dst.mutex, src.mutex);
+        std::lock_guard<std::mutex> dstGuard(dst.mutex, std::adopt_lock);
+        std::lock_guard<std::mutex> srcGuard(src.mutex, std::adopt_lock);
+        for (size_t op = 0; op < MAX_NUM_OPCODES; ++op) {
+            dst.histograms[op].reset();
+            if (src.histograms[op]) {
+                dst.histograms[op] = std::make_unique<HdrHistogram>(
+                        makeHistogram());
+                *dst.histograms[op] += *src.histograms[op];
+            }
+        }
+    }
     interval_latency_lookups = other.interval_latency_lookups;
     interval_latency_mutations = other.interval_latency_mutations;
     return *this;
 }
 
+void Timings::resize(size_t nthreads) {
+    threads.resize(nthreads);
+    for (auto& t : threads) {
+        if (!t) {
+            t = std::make_unique<ThreadTimings>();
+        }
+    }
+}
+
 void Timings::reset() {
-    for (auto& t : timings) {
-        t.reset();
+    for (auto& t : threads) {
+        std::lock_guard<std::mutex> guard(t->mutex);
+        for (auto& histogram : t->histograms) {
+            if (histogram) {
+                histogram->reset();
+            }
+        }
     }
 
     {
@@ -42,19 +92,69 @@ void Timings::reset() {
     }
 }
 
-void Timings::collect(cb::mcbp::ClientOpcode opcode,
+void Timings::collect(size_t thread,
+                      cb::mcbp::ClientOpcode opcode,
                       std::chrono::nanoseconds nsec) {
-    timings[std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)].add(
-            nsec);
-    auto& interval = interval_counters
-            [std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)];
+    using namespace std::chrono;
+    const auto op = std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode);
+    const auto usec = std::min(
+            uint64_t(std::max(duration_cast<microseconds>(nsec).count(),
+                              microseconds::rep(0))),
+            MaxTrackedMicros);
+
+    auto& t = *threads.at(thread);
+    std::lock_guard<std::mutex> guard(t.mutex);
+    auto& histogram = t.histograms[op];
+    if (!histogram) {
+        histogram = std::make_unique<HdrHistogram>(makeHistogram());
+    }
+    histogram->addValue(usec);
+
+    auto& interval = t.interval_counters[op];
     interval.count++;
     interval.duration_ns += nsec.count();
 }
 
+HdrHistogram Timings::makeHistogram() {
+    return HdrHistogram(1, MaxTrackedMicros, 1);
+}
+
+HdrHistogram Timings::get_timing_histogram(uint8_t opcode) const {
+    auto ret = makeHistogram();
+    for (const auto& t : threads) {
+        std::lock_guard<std::mutex> guard(t->mutex);
+        if (t->histograms[opcode]) {
+            ret += *t->histograms[opcode];
+        }
+    }
+    return ret;
+}
+
+std::string Timings::to_string(const HdrHistogram& histogram) {
+    nlohmann::json json;
+    json["total"] = histogram.getValueCount();
+
+    auto percentiles = nlohmann::json::array();
+    for (const auto percentile : {50.0, 90.0, 99.0, 99.9, 99.99, 100.0}) {
+        percentiles.push_back(
+                {percentile, histogram.getValueAtPercentile(percentile)});
+    }
+    json["percentiles"] = percentiles;
+
+    auto data = nlohmann::json::array();
+    auto iter = histogram.makeRecordedIterator();
+    while (auto next = histogram.getNextValueAndCount(iter)) {
+        // the iterator's values include the +1 bias of HdrHistogram
+        data.push_back({iter.highest_equivalent_value - 1, next->second});
+    }
+    json["data"] = data;
+
+    return json.dump();
+}
+
 std::string Timings::generate(cb::mcbp::ClientOpcode opcode) {
-    return timings[std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)]
-            .to_string();
+    return to_string(get_timing_histogram(
+            std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)));
 }
 
 static const cb::mcbp::ClientOpcode timings_mutations[] = {
@@ -103,12 +203,41 @@ static const cb::mcbp::ClientOpcode timings_retrievals[] = {
         cb::mcbp::ClientOpcode::SubdocGet,
         cb::mcbp::ClientOpcode::SubdocExists};
 
+using OpcodeSet = std::array<bool, MAX_NUM_OPCODES>;
+
+template <size_t N>
+static OpcodeSet makeOpcodeSet(const cb::mcbp::ClientOpcode (&opcodes)[N]) {
+    OpcodeSet ret{};
+    for (auto op : opcodes) {
+        ret[std::underlying_type<cb::mcbp::ClientOpcode>::type(op)] = true;
+    }
+    return ret;
+}
+
+bool Timings::isMutation(cb::mcbp::ClientOpcode opcode) {
+    static const OpcodeSet mutations = makeOpcodeSet(timings_mutations);
+    return mutations[std::underlying_type<cb::mcbp::ClientOpcode>::type(
+            opcode)];
+}
+
+bool Timings::isRetrieval(cb::mcbp::ClientOpcode opcode) {
+    static const OpcodeSet retrievals = makeOpcodeSet(timings_retrievals);
+    return retrievals[std::underlying_type<cb::mcbp::ClientOpcode>::type(
+            opcode)];
+}
+
 uint64_t Timings::get_aggregated_mutation_stats() {
 
     uint64_t ret = 0;
-    for (auto cmd : timings_mutations) {
-        ret += timings[std::underlying_type<cb::mcbp::ClientOpcode>::type(cmd)]
-                       .get_total();
+    for (const auto& t : threads) {
+        std::lock_guard<std::mutex> guard(t->mutex);
+        for (auto cmd : timings_mutations) {
+            const auto& histogram = t->histograms
+                    [std::underlying_type<cb::mcbp::ClientOpcode>::type(cmd)];
+            if (histogram) {
+                ret += histogram->getValueCount();
+            }
+        }
     }
     return ret;
 }
@@ -116,9 +245,15 @@ uint64_t Timings::get_aggregated_mutation_stats() {
 uint64_t Timings::get_aggregated_retrival_stats() {
 
     uint64_t ret = 0;
-    for (auto cmd : timings_retrievals) {
-        ret += timings[std::underlying_type<cb::mcbp::ClientOpcode>::type(cmd)]
-                       .get_total();
+    for (const auto& t : threads) {
+        std::lock_guard<std::mutex> guard(t->mutex);
+        for (auto cmd : timings_retrievals) {
+            const auto& histogram = t->histograms
+                    [std::underlying_type<cb::mcbp::ClientOpcode>::type(cmd)];
+            if (histogram) {
+                ret += histogram->getValueCount();
+            }
+        }
     }
     return ret;
 }
@@ -136,20 +271,24 @@ cb::sampling::Interval Timings::get_interval_lookup_latency() {
 void Timings::sample(std::chrono::seconds sample_interval) {
     cb::sampling::Interval interval_lookup, interval_mutation;
 
-    for (auto op : timings_mutations) {
-        interval_mutation += interval_counters
-                [std::underlying_type<cb::mcbp::ClientOpcode>::type(op)];
-        interval_counters[std::underlying_type<cb::mcbp::ClientOpcode>::type(
-                                  op)]
-                .reset();
-    }
+    for (auto& t : threads) {
+        std::lock_guard<std::mutex> guard(t->mutex);
+        auto& interval_counters = t->interval_counters;
+        for (auto op : timings_mutations) {
+            interval_mutation += interval_counters
+                    [std::underlying_type<cb::mcbp::ClientOpcode>::type(op)];
+            interval_counters
+                    [std::underlying_type<cb::mcbp::ClientOpcode>::type(op)]
+                            .reset();
+        }
 
-    for (auto op : timings_retrievals) {
-        interval_lookup += interval_counters
-                [std::underlying_type<cb::mcbp::ClientOpcode>::type(op)];
-        interval_counters[std::underlying_type<cb::mcbp::ClientOpcode>::type(
-                                  op)]
-                .reset();
+        for (auto op : timings_retrievals) {
+            interval_lookup += interval_counters
+                    [std::underlying_type<cb::mcbp::ClientOpcode>::type(op)];
+            interval_counters
+                    [std::underlying_type<cb::mcbp::ClientOpcode>::type(op)]
+                            .reset();
+        }
     }
 
     {
@@ -16,29 +16,53 @@
  */
 #pragma once
 
-#include "timing_histogram.h"
 #include "timing_interval.h"
 
 #include <mcbp/protocol/opcode.h>
+#include <utilities/hdrhistogram.h>
 
 #include <array>
+#include <memory>
 #include <string>
 #include <mutex>
+#include <vector>
 
 
 #define MAX_NUM_OPCODES 0x100
 
-/** Records timings for each memcached opcode. Each opcode has a histogram of
- * times.
+/**
+ * Records timings for each memcached opcode. Each opcode has a HdrHistogram
+ * of times (in microseconds).
+ *
+ * Each worker thread records into histograms of its own, so recording a
+ * command's time doesn't write to memory shared with the other threads. The
+ * histograms of the threads are merged when they're read.
  */
 class Timings {
 public:
     Timings();
+    ~Timings();
     Timings& operator=(const Timings& other);
     Timings(const Timings&) = delete;
 
+    /**
+     * Set the number of worker threads recording timings. Must be called
+     * before any timings are recorded.
+     */
+    void resize(size_t nthreads);
+
     void reset();
-    void collect(cb::mcbp::ClientOpcode opcode, std::chrono::nanoseconds nsec);
+
+    /**
+     * Record the time of a command
+     *
+     * @param thread the index of the worker thread which ran the command
+     * @param opcode the command's opcode
+     * @param nsec how long the command took
+     */
+    void collect(size_t thread,
+                 cb::mcbp::ClientOpcode opcode,
+                 std::chrono::nanoseconds nsec);
     void sample(std::chrono::seconds sample_interval);
     std::string generate(cb::mcbp::ClientOpcode opcode);
     uint64_t get_aggregated_mutation_stats();
@@ -48,13 +72,37 @@ public:
     cb::sampling::Interval get_interval_lookup_latency();
 
     /**
-     * Get the underlying timings histogram for the specified opcode
+     * Get the timings histogram for the specified opcode, merged across all
+     * of the worker threads
      */
-    TimingHistogram get_timing_histogram(uint8_t opcode) const {
-        return timings[opcode];
-    }
+    HdrHistogram get_timing_histogram(uint8_t opcode) const;
+
+    /// @return true if the opcode is counted as a mutation
+    static bool isMutation(cb::mcbp::ClientOpcode opcode);
+
+    /// @return true if the opcode is counted as a retrieval
+    static bool isRetrieval(cb::mcbp::ClientOpcode opcode);
+
+    /// @return a histogram of the range (and precision) used for the timings
+    static HdrHistogram makeHistogram();
+
+    /**
+     * Format a histogram of timings as JSON (the format returned by
+     * GetCmdTimer and read by mctimings):
+     *
+     *     {"total": <count>,
+     *      "percentiles": [[<percentile>, <us>], ...],
+     *      "data": [[<upper bound us>, <count>], ...]}
+     *
+     * where "data" lists the histogram buckets with values recorded, in
+     * order of value. The percentiles include 50, 90, 99, 99.9, 99.99 and
+     * 100 (the maximum).
+     */
+    static std::string to_string(const HdrHistogram& histogram);
 
 private:
+    struct ThreadTimings;
+
     // This lock is only held by sample() and some blocks within generate().
     // It guards the various IntervalSeries variables which internally
     // contain cb::RingBuffer objects which are not thread safe.
@@ -62,6 +110,7 @@ private:
 
     cb::sampling::IntervalSeries interval_latency_lookups;
     cb::sampling::IntervalSeries interval_latency_mutations;
-    std::array<TimingHistogram, MAX_NUM_OPCODES> timings;
-    std::array<cb::sampling::Interval, MAX_NUM_OPCODES> interval_counters;
+
+    /// The timings recorded by each worker thread
+    std::vector<std::unique_ptr<ThreadTimings>> threads;
 };
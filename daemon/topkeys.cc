@@ -24,86 +24,324 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <gsl/gsl>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
+#include <unordered_map>
 
 /*
  * Implementation Details
  *
  * === TopKeys ===
  *
- * The TopKeys class is split into NUM_SHARDS shards, each which owns
- * 1/NUM_SHARDS of the keyspace. This is to allow some level of
- * concurrent access - each shard has a mutex guarding all access.
- * Other than that the TopKeys class is pretty uninteresting - it
- * simply passes on requests to the correct Shard, and when statistics
- * are requested it aggregates information from each shard.
+ * Each worker thread records the keys it accesses into a Shard of its own,
+ * so recording an access doesn't write to memory shared with the other
+ * threads. When statistics are requested the keys tracked by each shard are
+ * merged, and the most frequently accessed reported.
  *
  * === TopKeys::Shard ===
  *
- * This is where the action happens. Each Shard maintains an ordered
- * list of key names and related statistics, orded by when they were
- * last accessed. There is a fixed number of keys each Shard tracks.
-
- * Given we generally track only a small number of keys per shard (10
- * by default), it's highly likely that any one key access will 'miss'
- * - i.e. not find an existing topkey. Therefore this class is
- * optimized for that case, attempting to minimise memory allocation
- * in steady-state.
+ * A Shard estimates the access count of every key with a Count-Min sketch:
+ * Depth rows of Width counters, where a key increments one counter of each
+ * row (selected by its hash) and its estimated count is the minimum of
+ * them. The estimate never undercounts, and (with conservative update,
+ * where only the counters at the minimum are incremented) overcounts by
+ * little for the frequently accessed keys.
  *
- * Internally Shard consists of a vector of topkey_t, storing the
- * current max_keys top_keys, and a list of topkey_t pointers, used to
- * main the current most -> least recently used ordering:
-
- * max_keys elements. Each element is a tuple of
- * {hash(key), key, topkey_stats}:
- *
- *
- *       vector<topkey_t>
- *   +----------+-------------+---------------+
- *   | size_t   | std::string | topkey_item_t |
- *   +----------+-------------+---------------+
- *   | <hash 1> | <key 1>     | stats 1       | <--- Node1
- *   | <hash 2> | <key 2>     | stats 2       | <--- Node2
- *   | <hash 3> | <key 3>     | stats 3       | <--- Node3
- *   . ....                                   .
- *   | <hash N> | <key N>     | stats N       | <--- NodeN
- *   +----------------------------------------+
- *
- *   Node3 <---> Node1 <---> ... <---> Node2
- *   ^^^                               ^^^
- *   MRU                               LRU
+ * The (up to) maxKeys keys with the highest estimates are kept in a min-heap
+ * of Entry, along with the bytes and latency of their accesses:
  *
+ *   - An access of a key tracked in the heap updates its Entry.
+ *   - An access of an untracked key whose estimate exceeds the count of the
+ *     heap's minimum replaces the minimum.
+ *   - Any other access - the common case for the "cold" keys - only updates
+ *     the sketch.
  *
- * Upon a key 'hit', TopKeys::updateKey() is called. That hashes the
- * key, and finds the Shard responsible for that
- * key. TopKeys::Shard::updateKey() is then called.
+ * Only the owning thread updates the sketch and the heap, so neither needs
+ * any synchronisation. The Entry fields read by the stats are atomics, and
+ * the mutex is only taken when the key of an Entry changes (or the stats
+ * read the keys).
  *
- * Shard::updateKey() iterates over the vector, searching for a hash
- * match with an existing element, using the actual key string to
- * validate (in case of a hash collision). If it is found, then the
- * stats are simply updated.  If it is not found, then the
- * least-recently-used element is selected as a 'victim' and it's
- * contents is replaced by the incoming key.  Finally the linked-list
- * is updated to move the updated element to the head of the list.
+ * So that the hot keys reported follow changes in the workload, every
+ * DecayPeriod accesses all the counts are halved.
  */
 
+/// Store v + delta to an atomic only written by the calling thread.
+template <typename T>
+static void add(std::atomic<T>& v, T delta) {
+    v.store(v.load(std::memory_order_relaxed) + delta,
+            std::memory_order_relaxed);
+}
+
+template <typename T>
+static void halve(std::atomic<T>& v) {
+    v.store(v.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+}
+
+class TopKeys::Shard {
+public:
+    explicit Shard(size_t capacity)
+        : capacity(capacity), entries(new Entry[capacity]) {
+        for (auto& row : sketch) {
+            row.fill(0);
+        }
+        heap.reserve(capacity);
+        position.resize(capacity);
+        index.reserve(capacity);
+    }
+
+    void updateKey(cb::const_char_buffer key,
+                   uint64_t hash,
+                   size_t bytes,
+                   std::chrono::nanoseconds latency,
+                   rel_time_t now);
+
+    /// Append the keys of the shard to keys
+    void getKeys(std::vector<KeyStats>& keys) const;
+
+private:
+    static const size_t Depth = 4;
+    static const size_t Width = 1024;
+    static const uint64_t DecayPeriod = 1 << 18;
+
+    struct Entry {
+        std::string key;
+        uint64_t hash = 0;
+        /// The estimate of the key's access count
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> ops{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> latency{0};
+        std::atomic<rel_time_t> ctime{0};
+        std::atomic<rel_time_t> atime{0};
+    };
+
+    /// Count an access of the key in the sketch, returning its new estimate
+    uint64_t increment(uint64_t hash);
+
+    void record(Entry& entry,
+                uint64_t count,
+                size_t bytes,
+                std::chrono::nanoseconds latency,
+                rel_time_t now);
+
+    /// Start tracking a key in the given entry
+    void assign(Entry& entry,
+                cb::const_char_buffer key,
+                uint64_t hash,
+                rel_time_t now);
+
+    uint64_t countAt(size_t pos) const {
+        return entries[heap[pos]].count.load(std::memory_order_relaxed);
+    }
+
+    void swap(size_t a, size_t b) {
+        std::swap(heap[a], heap[b]);
+        position[heap[a]] = a;
+        position[heap[b]] = b;
+    }
+
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+    void decay();
+
+    const size_t capacity;
+
+    std::array<std::array<uint32_t, Width>, Depth> sketch;
+    uint64_t accesses = 0;
+
+    /// The tracked keys; entries [0, used) are in use
+    std::unique_ptr<Entry[]> entries;
+    std::atomic<size_t> used{0};
+
+    /// Indexes of the used entries, as a min-heap by count
+    std::vector<uint32_t> heap;
+    /// The position in the heap of each entry
+    std::vector<size_t> position;
+    /// The entry tracking a key hash
+    std::unordered_map<uint64_t, uint32_t> index;
+
+    /// Held while changing the key of an entry, and reading the keys
+    mutable std::mutex mutex;
+};
+
+const size_t TopKeys::Shard::Depth;
+const size_t TopKeys::Shard::Width;
+const uint64_t TopKeys::Shard::DecayPeriod;
+
+uint64_t TopKeys::Shard::increment(uint64_t hash) {
+    // Derive the counter of each row from two halves of the hash
+    const auto h1 = uint32_t(hash);
+    const auto h2 = uint32_t(hash >> 32) | 1;
+    std::array<uint32_t*, Depth> counters;
+    uint32_t min = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < Depth; ++row) {
+        counters[row] = &sketch[row][(h1 + row * h2) & (Width - 1)];
+        min = std::min(min, *counters[row]);
+    }
+    // Conservative update: only raise the counters to the new estimate.
+    const uint32_t estimate = min + 1;
+    for (auto* counter : counters) {
+        *counter = std::max(*counter, estimate);
+    }
+    return estimate;
+}
+
+void TopKeys::Shard::record(Entry& entry,
+                            uint64_t count,
+                            size_t bytes,
+                            std::chrono::nanoseconds latency,
+                            rel_time_t now) {
+    entry.count.store(count, std::memory_order_relaxed);
+    add(entry.ops, uint64_t(1));
+    add(entry.bytes, uint64_t(bytes));
+    add(entry.latency,
+        uint64_t(std::max(latency.count(), std::chrono::nanoseconds::rep(0))));
+    entry.atime.store(now, std::memory_order_relaxed);
+}
+
+void TopKeys::Shard::assign(Entry& entry,
+                            cb::const_char_buffer key,
+                            uint64_t hash,
+                            rel_time_t now) {
+    std::lock_guard<std::mutex> guard(mutex);
+    entry.key.assign(key.buf, key.len);
+    entry.hash = hash;
+    entry.ops.store(0, std::memory_order_relaxed);
+    entry.bytes.store(0, std::memory_order_relaxed);
+    entry.latency.store(0, std::memory_order_relaxed);
+    entry.ctime.store(now, std::memory_order_relaxed);
+}
+
+void TopKeys::Shard::siftUp(size_t pos) {
+    while (pos > 0) {
+        const auto parent = (pos - 1) / 2;
+        if (countAt(parent) <= countAt(pos)) {
+            return;
+        }
+        swap(parent, pos);
+        pos = parent;
+    }
+}
+
+void TopKeys::Shard::siftDown(size_t pos) {
+    for (;;) {
+        auto smallest = pos;
+        for (auto child = 2 * pos + 1; child <= 2 * pos + 2; ++child) {
+            if (child < heap.size() && countAt(child) < countAt(smallest)) {
+                smallest = child;
+            }
+        }
+        if (smallest == pos) {
+            return;
+        }
+        swap(smallest, pos);
+        pos = smallest;
+    }
+}
+
+void TopKeys::Shard::decay() {
+    for (auto& row : sketch) {
+        for (auto& counter : row) {
+            counter /= 2;
+        }
+    }
+    // Halving every count keeps the order of the heap.
+    for (size_t ii = 0; ii < used.load(std::memory_order_relaxed); ++ii) {
+        auto& entry = entries[ii];
+        halve(entry.count);
+        halve(entry.ops);
+        halve(entry.bytes);
+        halve(entry.latency);
+    }
+}
+
+void TopKeys::Shard::updateKey(cb::const_char_buffer key,
+                               uint64_t hash,
+                               size_t bytes,
+                               std::chrono::nanoseconds latency,
+                               rel_time_t now) {
+    if (++accesses % DecayPeriod == 0) {
+        decay();
+    }
+    const auto count = increment(hash);
+
+    // A tracked key?
+    const auto found = index.find(hash);
+    if (found != index.end()) {
+        auto& entry = entries[found->second];
+        if (entry.key.size() == key.len &&
+            std::memcmp(entry.key.data(), key.buf, key.len) == 0) {
+            record(entry, count, bytes, latency, now);
+            siftDown(position[found->second]);
+        }
+        // else a different key with the same hash; leave it untracked.
+        return;
+    }
+
+    const auto size = used.load(std::memory_order_relaxed);
+    if (size < capacity) {
+        const auto entry = uint32_t(size);
+        assign(entries[entry], key, hash, now);
+        used.store(size + 1, std::memory_order_release);
+        index[hash] = entry;
+        record(entries[entry], count, bytes, latency, now);
+        heap.push_back(entry);
+        position[entry] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+    } else if (count > countAt(0)) {
+        // Replace the least frequently accessed key
+        const auto entry = heap[0];
+        index.erase(entries[entry].hash);
+        assign(entries[entry], key, hash, now);
+        index[hash] = entry;
+        record(entries[entry], count, bytes, latency, now);
+        siftDown(0);
+    }
+    // else not frequently accessed enough to be tracked
+}
+
+void TopKeys::Shard::getKeys(std::vector<KeyStats>& keys) const {
+    std::lock_guard<std::mutex> guard(mutex);
+    const auto size = used.load(std::memory_order_acquire);
+    for (size_t ii = 0; ii < size; ++ii) {
+        const auto& entry = entries[ii];
+        KeyStats stats;
+        stats.key = entry.key;
+        stats.access_count = entry.count.load(std::memory_order_relaxed);
+        stats.ops = entry.ops.load(std::memory_order_relaxed);
+        stats.bytes = entry.bytes.load(std::memory_order_relaxed);
+        stats.latency = entry.latency.load(std::memory_order_relaxed);
+        stats.ctime = entry.ctime.load(std::memory_order_relaxed);
+        stats.atime = entry.atime.load(std::memory_order_relaxed);
+        keys.push_back(std::move(stats));
+    }
+}
 
-TopKeys::TopKeys(int mkeys) {
+TopKeys::TopKeys(int mkeys, size_t nthreads)
+    : maxKeys(std::max(mkeys, 1)), shards(nthreads) {
     for (auto& shard : shards) {
-        shard.setMaxKeys(mkeys);
+        shard.store(nullptr);
     }
 }
 
 TopKeys::~TopKeys() {
+    for (auto& shard : shards) {
+        delete shard.load();
+    }
 }
 
-void TopKeys::updateKey(const void* key,
+void TopKeys::updateKey(size_t thread,
+                        const void* key,
                         size_t nkey,
+                        size_t bytes,
+                        std::chrono::nanoseconds latency,
                         rel_time_t operation_time) {
     if (settings.isTopkeysEnabled()) {
-        doUpdateKey(key, nkey, operation_time);
+        doUpdateKey(thread, key, nkey, bytes, latency, operation_time);
     }
 }
 
@@ -126,82 +364,11 @@ ENGINE_ERROR_CODE TopKeys::json_stats(nlohmann::json& object,
     return ENGINE_SUCCESS;
 }
 
-TopKeys::Shard& TopKeys::getShard(size_t key_hash) {
-    /* This is special-cased for 8 */
-    static_assert(NUM_SHARDS == 8,
-                  "Topkeys::getShard() special-cased for SHARDS==8");
-    return shards[key_hash & 0x7];
-}
-
-TopKeys::Shard::topkey_t*
-TopKeys::Shard::searchForKey(size_t key_hash,
-                             const cb::const_char_buffer& key) {
-
-    for (auto& topkey : storage) {
-        if (topkey.first.hash == key_hash) {
-            // Double-check with full compare
-            if (topkey.first.key.compare(0, topkey.first.key.size(),
-                                         key.buf, key.len) == 0) {
-                // Match found.
-                return &topkey;
-            }
-        }
-    }
-    return nullptr;
-}
-
-bool TopKeys::Shard::updateKey(const cb::const_char_buffer& key,
-                               size_t key_hash,
-                               const rel_time_t ct) {
-    try {
-        std::lock_guard<std::mutex> lock(mutex);
-
-        topkey_t* found_key = searchForKey(key_hash, key);
-
-        if (found_key == NULL) {
-            // Key not found.
-            if (storage.size() == max_keys) {
-                // Re-use the lowest keys' storage.
-                found_key = list.back();
-                found_key->first.hash = key_hash;
-                found_key->first.key.assign(key.buf, key.len);
-                found_key->second = topkey_item_t(ct);
-
-                // Move back element to the front, shuffling down the
-                // rest.
-                list.splice(list.begin(), list, --list.end());
-
-            } else {
-                // add a new element to the storage array.
-
-                storage.emplace_back(
-                    std::make_pair(KeyId{key_hash,
-                                         std::string(key.buf, key.len)},
-                                   topkey_item_t(ct)));
-                found_key = &storage.back();
-
-                // Insert the new item to the front of the list
-                list.push_front(found_key);
-            }
-        } else {
-            // Found - shuffle to the front.
-            auto it = std::find(list.begin(), list.end(),
-                                found_key);
-            list.splice(list.begin(), list, it);
-        }
-
-        // Increment access count.
-        found_key->second.ti_access_count++;
-        return true;
-
-    } catch (const std::bad_alloc&) {
-        // Failed to update.
-        return false;
-    }
-}
-
-void TopKeys::doUpdateKey(const void* key,
+void TopKeys::doUpdateKey(size_t thread,
+                          const void* key,
                           size_t nkey,
+                          size_t bytes,
+                          std::chrono::nanoseconds latency,
                           rel_time_t operation_time) {
     if (key == nullptr || nkey == 0) {
         throw std::invalid_argument(
@@ -209,86 +376,94 @@ void TopKeys::doUpdateKey(const void* key,
     }
 
     try {
-        cb::const_char_buffer key_buf(static_cast<const char*>(key), nkey);
-        std::hash<cb::const_char_buffer > hash_fn;
-        const size_t key_hash = hash_fn(key_buf);
+        auto& slot = shards.at(thread);
+        auto* shard = slot.load(std::memory_order_acquire);
+        if (shard == nullptr) {
+            shard = new Shard(maxKeys);
+            slot.store(shard, std::memory_order_release);
+        }
 
-        getShard(key_hash).updateKey(key_buf, key_hash, operation_time);
+        cb::const_char_buffer key_buf(static_cast<const char*>(key), nkey);
+        std::hash<cb::const_char_buffer> hash_fn;
+        shard->updateKey(
+                key_buf, hash_fn(key_buf), bytes, latency, operation_time);
     } catch (const std::bad_alloc&) {
         // Failed to increment topkeys, continue...
     }
 }
 
-struct tk_context {
-    tk_context(const void* c, ADD_STAT a, rel_time_t t, nlohmann::json* arr)
-        : cookie(c), add_stat(a), current_time(t), array(arr) {
-        // empty
+std::vector<TopKeys::KeyStats> TopKeys::getKeys() const {
+    std::vector<KeyStats> keys;
+    for (const auto& slot : shards) {
+        const auto* shard = slot.load(std::memory_order_acquire);
+        if (shard) {
+            shard->getKeys(keys);
+        }
     }
 
-    const void *cookie;
-    ADD_STAT add_stat;
-    rel_time_t current_time;
-    nlohmann::json* array;
-};
-
-static void tk_iterfunc(const std::string& key, const topkey_item_t& it,
-                        void *arg) {
-    struct tk_context *c = (struct tk_context*)arg;
-    char val_str[500];
-    /* Note we use accessed time for both 'atime' and 'ctime' below. They have
-     * had the same value since the topkeys code was added; but given that
-     * clients may expect separate values we print both.
-     */
-    rel_time_t created_time = c->current_time - it.ti_ctime;
-    int vlen = snprintf(val_str, sizeof(val_str) - 1, "get_hits=%d,"
-                        "get_misses=0,cmd_set=0,incr_hits=0,incr_misses=0,"
-                        "decr_hits=0,decr_misses=0,delete_hits=0,"
-                        "delete_misses=0,evictions=0,cas_hits=0,cas_badval=0,"
-                        "cas_misses=0,get_replica=0,evict=0,getl=0,unlock=0,"
-                        "get_meta=0,set_meta=0,del_meta=0,ctime=%" PRIu32
-                        ",atime=%" PRIu32, it.ti_access_count,
-                        created_time, created_time);
-    if (vlen > 0 && vlen < int(sizeof(val_str) - 1)) {
-        c->add_stat(key.c_str(),
-                    gsl::narrow<uint16_t>(key.size()),
-                    val_str,
-                    vlen,
-                    c->cookie);
+    // Merge the keys tracked by more than one thread
+    std::unordered_map<std::string, size_t> merged;
+    std::vector<KeyStats> ret;
+    for (auto& key : keys) {
+        const auto found = merged.find(key.key);
+        if (found == merged.end()) {
+            merged[key.key] = ret.size();
+            ret.push_back(std::move(key));
+            continue;
+        }
+        auto& into = ret[found->second];
+        into.access_count += key.access_count;
+        into.ops += key.ops;
+        into.bytes += key.bytes;
+        into.latency += key.latency;
+        into.ctime = std::min(into.ctime, key.ctime);
+        into.atime = std::max(into.atime, key.atime);
     }
-}
 
-/**
- * Passing in a list of keys, context, and cJSON array will populate that
- * array with an object for each key in the following format:
- * {
- *    "key": "somekey",
- *    "access_count": nnn,
- *    "ctime": ccc,
- *    "atime": aaa
- * }
- */
-static void tk_jsonfunc(const std::string& key, const topkey_item_t& it,
-                        void* arg) {
-    struct tk_context *c = (struct tk_context*)arg;
-    if (c->array == nullptr) {
-        throw std::invalid_argument("tk_jsonfunc: c->array can't be nullptr");
+    std::sort(ret.begin(), ret.end(), [](const KeyStats& a, const KeyStats& b) {
+        return a.access_count > b.access_count;
+    });
+    if (ret.size() > maxKeys) {
+        ret.resize(maxKeys);
     }
+    return ret;
+}
 
-    nlohmann::json obj;
-    obj["key"] = key;
-    obj["access_count"] = it.ti_access_count;
-    obj["ctime"] = c->current_time - it.ti_ctime;
-
-    c->array->push_back(obj);
+static uint64_t average(uint64_t total, uint64_t ops) {
+    return ops == 0 ? 0 : total / ops;
 }
 
 ENGINE_ERROR_CODE TopKeys::doStats(const void* cookie,
                                    rel_time_t current_time,
                                    ADD_STAT add_stat) {
-    struct tk_context context(cookie, add_stat, current_time, nullptr);
-
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_iterfunc, &context);
+    for (const auto& key : getKeys()) {
+        char val_str[500];
+        const rel_time_t created_time = current_time - key.ctime;
+        const rel_time_t accessed_time = current_time - key.atime;
+        int vlen = snprintf(
+                val_str,
+                sizeof(val_str) - 1,
+                "get_hits=%" PRIu64
+                ","
+                "get_misses=0,cmd_set=0,incr_hits=0,incr_misses=0,"
+                "decr_hits=0,decr_misses=0,delete_hits=0,"
+                "delete_misses=0,evictions=0,cas_hits=0,cas_badval=0,"
+                "cas_misses=0,get_replica=0,evict=0,getl=0,unlock=0,"
+                "get_meta=0,set_meta=0,del_meta=0,ctime=%" PRIu32
+                ",atime=%" PRIu32 ",avg_bytes=%" PRIu64
+                ",avg_latency_us=%" PRIu64,
+                key.access_count,
+                created_time,
+                accessed_time,
+                average(key.bytes, key.ops),
+                average(key.latency, key.ops) / 1000);
+        if (vlen > 0 && vlen < int(sizeof(val_str) - 1)) {
+            add_stat(key.key.c_str(),
+                     gsl::narrow<uint16_t>(key.key.size()),
+                     val_str,
+                     vlen,
+                     cookie);
+        }
     }
 
     return ENGINE_SUCCESS;
@@ -296,32 +471,31 @@ ENGINE_ERROR_CODE TopKeys::doStats(const void* cookie,
 
 /**
  * Passing a set of topkeys, and relevant context data will
- * return a cJSON object containing an array of topkeys (with each key
- * appearing as in the example above for tk_jsonfunc):
+ * return a JSON object containing an array of topkeys, each in the following
+ * format:
  * {
- *   "topkeys": [
- *      { ... }, ..., { ... }
- *    ]
+ *    "key": "somekey",
+ *    "access_count": nnn,
+ *    "ctime": ccc,
+ *    "atime": aaa,
+ *    "avg_bytes": bbb,
+ *    "avg_latency_us": lll
  * }
  */
 ENGINE_ERROR_CODE TopKeys::do_json_stats(nlohmann::json& object,
                                          rel_time_t current_time) {
     nlohmann::json topkeys = nlohmann::json::array();
-    struct tk_context context(nullptr, nullptr, current_time, &topkeys);
-
-    /* Collate the topkeys JSON object */
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_jsonfunc, &context);
+    for (const auto& key : getKeys()) {
+        nlohmann::json obj;
+        obj["key"] = key.key;
+        obj["access_count"] = key.access_count;
+        obj["ctime"] = current_time - key.ctime;
+        obj["atime"] = current_time - key.atime;
+        obj["avg_bytes"] = average(key.bytes, key.ops);
+        obj["avg_latency_us"] = average(key.latency, key.ops) / 1000;
+        topkeys.push_back(obj);
     }
 
     object["topkeys"] = topkeys;
     return ENGINE_SUCCESS;
 }
-
-void TopKeys::Shard::accept_visitor(iterfunc_t visitor_func,
-                                    void* visitor_ctx) {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (const auto key : list) {
-        visitor_func(key->first.key, key->second, visitor_ctx);
-    }
-}
@@ -16,46 +16,50 @@
  */
 #pragma once
 
-#include <cJSON.h>
 #include <memcached/engine.h>
 #include <nlohmann/json_fwd.hpp>
 #include <platform/sized_buffer.h>
-#include <array>
 
-#include <mutex>
-#include <list>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 
 /*
  * TopKeys
  *
- * Tracks the top N most recently accessed keys. The details are
- * accessible by a stats call, which is used by ns_server to print the
- * top keys list in the GUI.
- */
-
-struct topkey_item_t {
-    topkey_item_t(rel_time_t create_time)
-        : ti_ctime(create_time),
-          ti_access_count(0) { }
-
-    rel_time_t ti_ctime; /* Time this item was created */
-    int ti_access_count; /* Int count for number of times key has been accessed */
-};
-
-/* Class to track the "top" keys in a bucket.
+ * Tracks the N most frequently accessed keys of a bucket, with the bytes
+ * and latency of their accesses. The details are accessible by a stats
+ * call, which is used by ns_server to print the top keys list in the GUI.
  */
 class TopKeys {
 public:
-    /* Constructor.
-     * @param mkeys Number of keys stored in each shard (i.e. up to
-     * mkeys * SHARDS will be tracked).
+    /**
+     * @param mkeys the number of keys reported (the most frequently accessed;
+     *        each worker thread tracks this many)
+     * @param nthreads the number of worker threads updating keys
      */
-    explicit TopKeys(int mkeys);
+    TopKeys(int mkeys, size_t nthreads);
     ~TopKeys();
 
-    void updateKey(const void* key, size_t nkey, rel_time_t operation_time);
+    /**
+     * Record an access of a key.
+     *
+     * @param thread the index of the worker thread which accessed the key
+     *        (each thread updates a shard of its own)
+     * @param key the key accessed
+     * @param nkey the length of the key
+     * @param bytes the number of bytes of the document read or written
+     * @param latency how long the command took
+     * @param operation_time when the key was accessed
+     */
+    void updateKey(size_t thread,
+                   const void* key,
+                   size_t nkey,
+                   size_t bytes,
+                   std::chrono::nanoseconds latency,
+                   rel_time_t operation_time);
 
     ENGINE_ERROR_CODE stats(const void* cookie,
                             rel_time_t current_time,
@@ -63,14 +67,16 @@ public:
 
     /**
      * Passing a set of topkeys, and relevant context data will
-     * return a cJSON object containing an array of topkeys:
+     * return a JSON object containing an array of topkeys:
      * {
      *   "topkeys": [
      *      {
      *          "key": "somekey",
      *          "access_count": nnn,
      *          "ctime": ccc,
-     *          "atime": aaa
+     *          "atime": aaa,
+     *          "avg_bytes": bbb,
+     *          "avg_latency_us": lll
      *      }, ..., { ... }
      *    ]
      * }
@@ -78,8 +84,31 @@ public:
     ENGINE_ERROR_CODE json_stats(nlohmann::json& object,
                                  rel_time_t current_time);
 
+    /// The statistics of a tracked key (merged across the threads)
+    struct KeyStats {
+        std::string key;
+        /// Estimated (decayed) number of accesses of the key
+        uint64_t access_count = 0;
+        /// Accesses, bytes and time (in ns) recorded since it was tracked
+        /// (decayed alongside the access count)
+        uint64_t ops = 0;
+        uint64_t bytes = 0;
+        uint64_t latency = 0;
+        /// When the key started being tracked, and was last accessed
+        rel_time_t ctime = 0;
+        rel_time_t atime = 0;
+    };
+
+    /// @return the tracked keys, most frequently accessed first
+    std::vector<KeyStats> getKeys() const;
+
 protected:
-    void doUpdateKey(const void* key, size_t nkey, rel_time_t operation_time);
+    void doUpdateKey(size_t thread,
+                     const void* key,
+                     size_t nkey,
+                     size_t bytes,
+                     std::chrono::nanoseconds latency,
+                     rel_time_t operation_time);
 
     ENGINE_ERROR_CODE doStats(const void* cookie,
                               rel_time_t current_time,
@@ -89,79 +118,12 @@ protected:
                                     rel_time_t current_time);
 
 private:
-    // Number of shards the keyspace is broken into. Permits some level of
-    // concurrent update (there is one mutex per shard).
-    static const int NUM_SHARDS = 8;
-
     class Shard;
 
-    Shard& getShard(size_t key_hash);
-
-    // One of N Shards which the keyspace has been broken
-    // into.
-    // Responsible for tracking the top {mkeys} within it's keyspace.
-    class Shard {
-    public:
-
-        void setMaxKeys(int mkeys) {
-            max_keys = mkeys;
-            storage.reserve(max_keys);
-            // reallocating storage invalidates the LRU list.
-            list.clear();
-        }
-
-        // Updates the topkey 'ranking' for the specified key.
-        // If the item does not exist it will be created (with it's creation
-        // time set to operation_time), otherwise the existing item will be
-        // updated.
-        // On success returns true, If insufficient memory to create a
-        // new item, returns false.
-        bool updateKey(const cb::const_char_buffer& key,
-                       size_t key_hash,
-                       rel_time_t operation_time);
-
-        typedef void (*iterfunc_t)(const std::string& key,
-                                   const topkey_item_t& it,
-                                   void *arg);
-
-        /* For each key in this shard, invoke the given callback function.
-         */
-        void accept_visitor(iterfunc_t visitor_func, void* visitor_ctx);
-
-    private:
-
-        struct KeyId {
-            size_t hash;
-            std::string key;
-        };
-
-        // Pair of the key's string and the statistics related to it.
-        typedef std::pair<KeyId, topkey_item_t> topkey_t;
-
-        // An ordered list of topkey_t*, used for LRU.
-        typedef std::list<topkey_t*> key_history_t;
-
-        // Vector topket_t, used for actual topke storage.
-        typedef std::vector<topkey_t> key_storage_t;
-
-        // Searches for the given key. If found returns a pointer to the
-        // topkey_t, else returns NULL.
-        topkey_t* searchForKey(size_t hash, const cb::const_char_buffer& key);
-
-        // Maxumum numbers of keys to be tracked per shard.
-        unsigned int max_keys;
-
-        // mutex to serial access to this shard.
-        std::mutex mutex;
-
-        // list of keys, ordered from most-recently used (front) to least recently
-        // used (back).
-        key_history_t list;
-
-        // Underlying topkey storage.
-        key_storage_t storage;
-    };
+    /// The number of keys tracked by each shard, and reported
+    const size_t maxKeys;
 
-    // array of topkey shards.
-    std::array<Shard, NUM_SHARDS> shards;
+    /// The shard of each worker thread, allocated the first time the thread
+    /// accesses a key of the bucket
+    std::vector<std::atomic<Shard*>> shards;
 };
@@ -0,0 +1,171 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "trace_sampler.h"
+
+#include "connection.h"
+#include "cookie.h"
+#include "settings.h"
+
+#include <mcbp/mcbp.h>
+#include <nlohmann/json.hpp>
+#include <platform/string_hex.h>
+#include <tracing/tracer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<TraceSampler::Sample>::value,
+              "TraceSampler::Sample must be trivially copyable");
+
+const size_t TraceSampler::MaxSpans;
+const size_t TraceSampler::Capacity;
+
+void TraceSampler::record(Cookie& cookie,
+                          std::chrono::steady_clock::duration elapsed) {
+    const auto rate = settings.getTraceSampleRate();
+    if (rate == 0) {
+        return;
+    }
+
+    const auto& header = cookie.getHeader();
+    const auto opcode = header.getRequest().getClientOpcode();
+    const bool slow = elapsed > cb::mcbp::sla::getSlowOpThreshold(opcode);
+    if (++since_sample >= rate) {
+        since_sample = 0;
+    } else if (!slow) {
+        return;
+    }
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::nanoseconds;
+
+    Sample sample = {};
+    sample.start = duration_cast<nanoseconds>(
+                           cookie.getStart().time_since_epoch())
+                           .count();
+    sample.duration = uint32_t(duration_cast<microseconds>(elapsed).count());
+    auto& connection = cookie.getConnection();
+    sample.connection = connection.getId();
+    sample.opaque = ntohl(header.getOpaque());
+    sample.bucket = uint16_t(connection.getBucketIndex());
+    sample.opcode = uint8_t(opcode);
+    sample.slow = slow;
+
+    for (const auto& span : cookie.getTracer().getDurations()) {
+        if (sample.nspans == MaxSpans) {
+            break;
+        }
+        auto& s = sample.spans[sample.nspans++];
+        s.start = uint32_t(
+                duration_cast<microseconds>(span.start - cookie.getStart())
+                        .count());
+        s.duration = span.duration == cb::tracing::Span::Duration::max()
+                             ? -1
+                             : span.duration.count();
+        s.code = uint8_t(span.code);
+    }
+
+    add(sample);
+}
+
+void TraceSampler::add(const Sample& sample) {
+    std::array<uint64_t, Words> words = {};
+    std::memcpy(words.data(), &sample, sizeof(sample));
+
+    auto& slot = slots[next];
+    next = (next + 1) % Capacity;
+
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t ii = 0; ii < Words; ++ii) {
+        slot.data[ii].store(words[ii], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+std::vector<TraceSampler::Sample> TraceSampler::getSamples() const {
+    std::vector<Sample> ret;
+    std::array<uint64_t, Words> words;
+
+    for (const auto& slot : slots) {
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || (sequence & 1) != 0) {
+            // Never written, or being written
+            continue;
+        }
+        for (size_t ii = 0; ii < Words; ++ii) {
+            words[ii] = slot.data[ii].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            // Overwritten while we read it
+            continue;
+        }
+        ret.emplace_back();
+        std::memcpy(&ret.back(), words.data(), sizeof(Sample));
+    }
+
+    std::sort(ret.begin(), ret.end(), [](const Sample& a, const Sample& b) {
+        return a.start < b.start;
+    });
+    return ret;
+}
+
+nlohmann::json TraceSampler::to_json(const Sample& sample) {
+    // The start is recorded with the steady clock; report it as the wall
+    // clock time (in microseconds since the epoch).
+    using namespace std::chrono;
+    const auto age = steady_clock::now().time_since_epoch() -
+                     nanoseconds(sample.start);
+    const auto timestamp = duration_cast<microseconds>(
+            (system_clock::now() - age).time_since_epoch());
+
+    std::string opcode;
+    try {
+        opcode = to_string(cb::mcbp::ClientOpcode(sample.opcode));
+    } catch (const std::exception&) {
+        opcode = cb::to_hex(sample.opcode);
+    }
+
+    nlohmann::json spans = nlohmann::json::array();
+    for (size_t ii = 0; ii < sample.nspans; ++ii) {
+        const auto& span = sample.spans[ii];
+        nlohmann::json entry;
+        entry["name"] = to_string(cb::tracing::TraceCode(span.code));
+        entry["start"] = span.start;
+        if (span.duration < 0) {
+            entry["duration"] = nullptr;
+        } else {
+            entry["duration"] = span.duration;
+        }
+        spans.push_back(entry);
+    }
+
+    nlohmann::json ret;
+    ret["timestamp"] = timestamp.count();
+    ret["duration"] = sample.duration;
+    ret["slow"] = sample.slow;
+    ret["opcode"] = opcode;
+    ret["bucket"] = sample.bucket;
+    ret["connection"] = sample.connection;
+    ret["opaque"] = cb::to_hex(sample.opaque);
+    ret["spans"] = spans;
+    return ret;
+}
@@ -0,0 +1,109 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+class Cookie;
+
+/**
+ * The TraceSampler keeps the trace (the spans recorded by the tracer) of
+ * 1 in N of the requests served by a front end thread, along with the trace
+ * of every request slower than the slow operation threshold of its opcode,
+ * so that the breakdown of the tail requests can be looked at (with the
+ * "trace.samples" ioctl) when the latency spikes.
+ *
+ * The samples are kept in a fixed size ring buffer, which is written to by
+ * the front end thread owning it and read by any thread. Each slot is
+ * guarded by a sequence number (a seqlock): the writer makes it odd while
+ * it updates the slot and the readers skip slots which are being written
+ * (or were overwritten while they read them), so neither side ever blocks.
+ */
+class TraceSampler {
+public:
+    /// The maximum number of spans kept per request
+    static const size_t MaxSpans = 16;
+
+    /// The number of requests kept
+    static const size_t Capacity = 256;
+
+    struct Span {
+        /// Start of the span, in microseconds since the start of the request
+        uint32_t start;
+        /// Duration of the span in microseconds (-1 if it wasn't ended)
+        int32_t duration;
+        /// The cb::tracing::TraceCode of the span
+        uint8_t code;
+    };
+
+    struct Sample {
+        /// Start of the request (steady_clock nanoseconds since epoch)
+        uint64_t start;
+        /// Duration of the request in microseconds
+        uint32_t duration;
+        uint32_t connection;
+        uint32_t opaque;
+        uint16_t bucket;
+        uint8_t opcode;
+        /// Was the request slower than the slow operation threshold
+        bool slow;
+        uint8_t nspans;
+        std::array<Span, MaxSpans> spans;
+    };
+
+    /**
+     * Keep the trace of the request if it is slow, or was picked by the
+     * sampling rate of the settings. Must be called on the front end thread
+     * owning the sampler.
+     *
+     * @param cookie the request which completed
+     * @param elapsed the time the request took
+     */
+    void record(Cookie& cookie, std::chrono::steady_clock::duration elapsed);
+
+    /// Add the sample to the ring buffer (on the owning thread)
+    void add(const Sample& sample);
+
+    /// Get a copy of the samples in the ring buffer (from any thread)
+    std::vector<Sample> getSamples() const;
+
+    /// Get the JSON representation of a sample
+    static nlohmann::json to_json(const Sample& sample);
+
+private:
+    static const size_t Words = (sizeof(Sample) + 7) / 8;
+
+    struct Slot {
+        /// Odd while the slot is written, 0 if it was never written
+        std::atomic<uint64_t> sequence{0};
+        std::array<std::atomic<uint64_t>, Words> data;
+    };
+
+    std::array<Slot, Capacity> slots;
+
+    /// The next slot to write (only used by the owning thread)
+    size_t next = 0;
+
+    /// The number of requests since the last one sampled
+    size_t since_sample = 0;
+};
@@ -0,0 +1,205 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "vbucket_load.h"
+#include "timings.h"
+
+#include <algorithm>
+
+const size_t VBucketLoad::MaxVBuckets;
+const size_t VBucketLoad::WindowSize;
+
+/// Add to an atomic only written by the calling thread.
+static void add(std::atomic<uint64_t>& v, uint64_t delta) {
+    v.store(v.load(std::memory_order_relaxed) + delta,
+            std::memory_order_relaxed);
+}
+
+VBucketLoad::VBucketLoad() = default;
+
+VBucketLoad::~VBucketLoad() {
+    for (auto& t : threads) {
+        delete t.load();
+    }
+}
+
+VBucketLoad& VBucketLoad::operator=(const VBucketLoad& other) {
+    resize(other.threads.size());
+    for (size_t ii = 0; ii < threads.size(); ++ii) {
+        const auto* src = other.threads[ii].load();
+        if (src == nullptr) {
+            continue;
+        }
+        auto* dst = threads[ii].load();
+        if (dst == nullptr) {
+            dst = new VBucketCounters();
+            threads[ii].store(dst);
+        }
+        for (size_t vb = 0; vb < MaxVBuckets; ++vb) {
+            (*dst)[vb].reads.store((*src)[vb].reads.load());
+            (*dst)[vb].writes.store((*src)[vb].writes.load());
+            (*dst)[vb].bytes.store((*src)[vb].bytes.load());
+        }
+    }
+    std::lock(mutex, other.mutex);
+    std::lock_guard<std::mutex> guard(mutex, std::adopt_lock);
+    std::lock_guard<std::mutex> otherGuard(other.mutex, std::adopt_lock);
+    window.reset();
+    if (other.window) {
+        window = std::make_unique<Window>(*other.window);
+    }
+    return *this;
+}
+
+void VBucketLoad::resize(size_t nthreads) {
+    std::vector<std::atomic<VBucketCounters*>> resized(nthreads);
+    for (size_t ii = 0; ii < nthreads; ++ii) {
+        resized[ii].store(ii < threads.size() ? threads[ii].exchange(nullptr)
+                                              : nullptr);
+    }
+    for (auto& t : threads) {
+        delete t.load();
+    }
+    threads.swap(resized);
+}
+
+void VBucketLoad::reset() {
+    // The threads may be counting; at worst a count made while resetting
+    // survives it.
+    for (auto& t : threads) {
+        auto* counters = t.load(std::memory_order_acquire);
+        if (counters) {
+            for (auto& c : *counters) {
+                c.reads.store(0, std::memory_order_relaxed);
+                c.writes.store(0, std::memory_order_relaxed);
+                c.bytes.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    window.reset();
+}
+
+void VBucketLoad::record(size_t thread,
+                         cb::mcbp::ClientOpcode opcode,
+                         Vbid vbucket,
+                         size_t bytes) {
+    const bool read = Timings::isRetrieval(opcode);
+    const bool write = Timings::isMutation(opcode);
+    if ((!read && !write) || vbucket.get() >= MaxVBuckets) {
+        return;
+    }
+
+    auto& slot = threads.at(thread);
+    auto* counters = slot.load(std::memory_order_acquire);
+    if (counters == nullptr) {
+        counters = new VBucketCounters();
+        slot.store(counters, std::memory_order_release);
+    }
+    auto& c = (*counters)[vbucket.get()];
+    if (read) {
+        add(c.reads, 1);
+    }
+    if (write) {
+        add(c.writes, 1);
+    }
+    add(c.bytes, bytes);
+}
+
+void VBucketLoad::sample() {
+    std::array<Totals, MaxVBuckets> totals;
+    bool counted = false;
+    for (const auto& t : threads) {
+        const auto* counters = t.load(std::memory_order_acquire);
+        if (counters == nullptr) {
+            continue;
+        }
+        counted = true;
+        for (size_t vb = 0; vb < MaxVBuckets; ++vb) {
+            const auto& c = (*counters)[vb];
+            totals[vb].reads += c.reads.load(std::memory_order_relaxed);
+            totals[vb].writes += c.writes.load(std::memory_order_relaxed);
+            totals[vb].bytes += c.bytes.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!counted) {
+        return;
+    }
+    if (!window) {
+        window = std::make_unique<Window>();
+    }
+
+    // The counters only go backwards when reset
+    auto delta = [](uint64_t now, uint64_t before) {
+        return now >= before ? now - before : now;
+    };
+    auto& sample = window->samples[window->next];
+    for (size_t vb = 0; vb < MaxVBuckets; ++vb) {
+        auto& previous = window->totals[vb];
+        sample[vb].reads = delta(totals[vb].reads, previous.reads);
+        sample[vb].writes = delta(totals[vb].writes, previous.writes);
+        sample[vb].bytes = delta(totals[vb].bytes, previous.bytes);
+    }
+    window->totals = totals;
+    window->next = (window->next + 1) % WindowSize;
+    window->count = std::min(window->count + 1, WindowSize);
+}
+
+std::vector<VBucketLoad::Load> VBucketLoad::getLoad(size_t limit) const {
+    std::vector<Load> ret;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!window) {
+            return ret;
+        }
+        for (size_t vb = 0; vb < MaxVBuckets; ++vb) {
+            const auto& totals = window->totals[vb];
+            if (totals.reads == 0 && totals.writes == 0) {
+                continue;
+            }
+            Load load;
+            load.vbucket = Vbid(uint16_t(vb));
+            load.reads = totals.reads;
+            load.writes = totals.writes;
+            load.bytes = totals.bytes;
+            for (size_t ii = 0; ii < window->count; ++ii) {
+                const auto& sample = window->samples[ii][vb];
+                load.readsPerSec += sample.reads;
+                load.writesPerSec += sample.writes;
+                load.bytesPerSec += sample.bytes;
+            }
+            load.readsPerSec /= window->count;
+            load.writesPerSec /= window->count;
+            load.bytesPerSec /= window->count;
+            ret.push_back(load);
+        }
+    }
+
+    std::sort(ret.begin(), ret.end(), [](const Load& a, const Load& b) {
+        const auto aRate = a.readsPerSec + a.writesPerSec;
+        const auto bRate = b.readsPerSec + b.writesPerSec;
+        if (aRate != bRate) {
+            return aRate > bRate;
+        }
+        return a.reads + a.writes > b.reads + b.writes;
+    });
+    if (ret.size() > limit) {
+        ret.resize(limit);
+    }
+    return ret;
+}
@@ -0,0 +1,132 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "timing_interval.h"
+
+#include <mcbp/protocol/opcode.h>
+#include <memcached/vbucket.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Counts the reads, writes and document bytes of each vBucket of a bucket,
+ * both in total and over a rolling window of the last WindowSize seconds.
+ * Reported by "stats vbucket_load", which is cheap enough to be polled
+ * frequently by the cluster manager to find the hot vBuckets.
+ *
+ * Each worker thread counts into counters of its own (only written by that
+ * thread, and allocated the first time it accesses the bucket). Once a
+ * second sample() merges the counters of the threads, and records the
+ * change since the previous sample into the window.
+ */
+class VBucketLoad {
+public:
+    /// vBuckets with a higher id aren't counted
+    static const size_t MaxVBuckets = 1024;
+
+    /// The number of one-second samples in the window
+    static const size_t WindowSize = cb::sampling::INTERVAL_SERIES_SIZE;
+
+    VBucketLoad();
+    ~VBucketLoad();
+    VBucketLoad(const VBucketLoad&) = delete;
+
+    /// Copies the counters of the other instance
+    VBucketLoad& operator=(const VBucketLoad& other);
+
+    /**
+     * Set the number of worker threads counting. Must be called before any
+     * command is counted.
+     */
+    void resize(size_t nthreads);
+
+    void reset();
+
+    /**
+     * Count a command. Only the commands which read or write documents
+     * (see Timings::isRetrieval() and Timings::isMutation()) are counted.
+     *
+     * @param thread the index of the worker thread which ran the command
+     * @param opcode the command's opcode
+     * @param vbucket the vBucket the command accessed
+     * @param bytes the number of bytes of the document read or written
+     */
+    void record(size_t thread,
+                cb::mcbp::ClientOpcode opcode,
+                Vbid vbucket,
+                size_t bytes);
+
+    /// Record the counts of the last second into the window
+    void sample();
+
+    /// The load of a vBucket
+    struct Load {
+        Vbid vbucket;
+        /// Totals (as of the last sample)
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t bytes = 0;
+        /// Average rates over the window
+        uint64_t readsPerSec = 0;
+        uint64_t writesPerSec = 0;
+        uint64_t bytesPerSec = 0;
+    };
+
+    /**
+     * @param limit the maximum number of vBuckets to return
+     * @return the load of the vBuckets accessed, the most operations per
+     *         second (then the highest total) first
+     */
+    std::vector<Load> getLoad(size_t limit = MaxVBuckets) const;
+
+private:
+    struct Counters {
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> writes{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    using VBucketCounters = std::array<Counters, MaxVBuckets>;
+
+    struct Totals {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t bytes = 0;
+    };
+
+    /// The totals of the last sample, and the change over each second of
+    /// the window (a ring, oldest at next)
+    struct Window {
+        std::array<Totals, MaxVBuckets> totals;
+        std::array<std::array<Totals, MaxVBuckets>, WindowSize> samples;
+        size_t next = 0;
+        size_t count = 0;
+    };
+
+    /// The counters of each worker thread
+    std::vector<std::atomic<VBucketCounters*>> threads;
+
+    /// Guards the window (sample() and getLoad())
+    mutable std::mutex mutex;
+    /// Allocated by the first sample of counts
+    std::unique_ptr<Window> window;
+};
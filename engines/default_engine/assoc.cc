@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <array>
+#include <atomic>
 #include <mutex>
 #include <vector>
 
@@ -21,6 +23,20 @@
 #define hashsize(n) ((size_t)1<<(n))
 #define hashmask(n) (hashsize(n)-1)
 
+/*
+ * The hashtable is shared by all buckets, so instead of one mutex it is
+ * guarded by hashsize(lockpower) lock stripes, selected by the low bits of
+ * the hash. Expansion only moves an item between the old and new buckets
+ * which share the low (hashpower - 1) bits of its hash, so as long as there
+ * are no more stripes than old buckets the stripe of a hash guards every
+ * bucket the item may be found in (or moved to). Starting and finishing an
+ * expansion (which change the tables themselves) take every stripe.
+ */
+static const unsigned int lockpower = 10;
+static const unsigned int initial_hashpower = 16;
+static_assert(lockpower < initial_hashpower,
+              "assoc: more lock stripes than hash buckets");
+
 struct Assoc {
     Assoc(unsigned int hp) : hashpower(hp) {
         primary_hashtable.resize(hashsize(hashpower));
@@ -40,26 +56,51 @@ struct Assoc {
     std::vector<hash_item*> old_hashtable;
 
     /* Number of items in the hash table. */
-    unsigned int hash_items{0};
+    std::atomic<unsigned int> hash_items{0};
 
     /* Flag: Are we in the middle of expanding now? */
-    bool expanding{false};
+    std::atomic<bool> expanding{false};
+
+    /* Flag: Is a thread allocating the table to expand into? */
+    std::atomic<bool> growing{false};
 
     /*
      * During expansion we migrate values with bucket granularity; this is how
      * far we've gotten so far. Ranges from 0 .. hashsize(hashpower - 1) - 1.
+     * Only advanced past a bucket while holding that bucket's stripe, so it
+     * may be read holding any stripe.
      */
-    unsigned int expand_bucket{0};
+    std::atomic<unsigned int> expand_bucket{0};
 
     /*
-     * serialise access to the hashtable
+     * serialise access to the hashtable; see lockpower
      */
-    std::mutex mutex;
+    std::array<std::mutex, hashsize(lockpower)> locks;
 };
 
 /* One hashtable for all */
 static struct Assoc* global_assoc = nullptr;
 
+/* The lock stripe guarding all the buckets the given hash may be in */
+static std::mutex& assoc_lock(uint32_t hash) {
+    return global_assoc->locks[hash & hashmask(lockpower)];
+}
+
+/* Take every lock stripe (in order), to change the tables */
+static void assoc_lock_all() {
+    for (auto& lock : global_assoc->locks) {
+        lock.lock();
+    }
+}
+
+static void assoc_unlock_all() {
+    for (auto it = global_assoc->locks.rbegin();
+         it != global_assoc->locks.rend();
+         ++it) {
+        it->unlock();
+    }
+}
+
 /* assoc factory. returns one new assoc or NULL if out-of-memory */
 static struct Assoc* assoc_consruct(int hashpower) {
     try {
@@ -74,7 +115,7 @@ ENGINE_ERROR_CODE assoc_init(struct default_engine *engine) {
         construct and save away one assoc for use by all buckets.
     */
     if (global_assoc == nullptr) {
-        global_assoc = assoc_consruct(16);
+        global_assoc = assoc_consruct(initial_hashpower);
     }
     return (global_assoc != NULL) ? ENGINE_SUCCESS : ENGINE_ENOMEM;
 }
@@ -94,7 +135,7 @@ hash_item *assoc_find(uint32_t hash, const hash_key *key) {
     unsigned int oldbucket;
     hash_item *ret = NULL;
     int depth = 0;
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
+    std::lock_guard<std::mutex> guard(assoc_lock(hash));
     if (global_assoc->expanding &&
         (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
     {
@@ -121,7 +162,7 @@ hash_item *assoc_find(uint32_t hash, const hash_key *key) {
 /*
     returns the address of the item pointer before the key.  if *item == 0,
     the item wasn't found
-    assoc->lock is assumed to be held by the caller.
+    the lock stripe for the hash is assumed to be held by the caller.
 */
 static hash_item** _hashitem_before(uint32_t hash, const hash_key* key) {
     hash_item **pos;
@@ -153,20 +194,39 @@ static hash_item** _hashitem_before(uint32_t hash, const hash_key* key) {
 static void assoc_maintenance_thread(void *arg);
 
 /*
-    grows the hashtable to the next power of 2.
-    assoc->lock is assumed to be held by the caller.
+    grows the hashtable to the next power of 2, unless it's already expanding
+    (or another thread grew it first).
+    no lock stripe may be held by the caller.
 */
-static void assoc_expand() {
-    global_assoc->old_hashtable.swap(global_assoc->primary_hashtable);
+static void assoc_grow() {
+    unsigned int hashpower;
+    {
+        std::lock_guard<std::mutex> guard(global_assoc->locks[0]);
+        hashpower = global_assoc->hashpower;
+    }
 
+    /*
+     * Allocate (and zero) the new table before taking every stripe; it can
+     * be large, and no lookup can proceed while they are all held.
+     */
+    std::vector<hash_item*> table;
     try {
-        global_assoc->primary_hashtable.resize(hashsize(global_assoc->hashpower + 1));
+        table.resize(hashsize(hashpower + 1));
     } catch (const std::bad_alloc&) {
-        global_assoc->primary_hashtable.swap(global_assoc->old_hashtable);
         /* Bad news, but we can keep running. */
         return;
     }
 
+    assoc_lock_all();
+    if (global_assoc->expanding || global_assoc->hashpower != hashpower ||
+        global_assoc->hash_items <= (hashsize(hashpower) * 3) / 2) {
+        assoc_unlock_all();
+        return;
+    }
+
+    global_assoc->old_hashtable.swap(global_assoc->primary_hashtable);
+    global_assoc->primary_hashtable.swap(table);
+
     int ret = 0;
     cb_thread_t tid;
 
@@ -183,8 +243,18 @@ static void assoc_expand() {
         global_assoc->hashpower--;
         global_assoc->expanding = false;
         global_assoc->primary_hashtable.swap(global_assoc->old_hashtable);
-        global_assoc->old_hashtable.resize(0);
-        global_assoc->old_hashtable.shrink_to_fit();
+        /* the new table is freed once the stripes are released */
+        global_assoc->old_hashtable.swap(table);
+    }
+    assoc_unlock_all();
+}
+
+/* only one thread at a time allocates a table to grow into */
+static void assoc_expand() {
+    bool expected = false;
+    if (global_assoc->growing.compare_exchange_strong(expected, true)) {
+        assoc_grow();
+        global_assoc->growing = false;
     }
 }
 
@@ -194,26 +264,32 @@ int assoc_insert(uint32_t hash, hash_item *it) {
 
     cb_assert(assoc_find(hash, item_get_key(it)) == 0);  /* shouldn't have duplicately named things defined */
 
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    if (global_assoc->expanding &&
-        (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
+    bool expand;
     {
-        it->h_next = global_assoc->old_hashtable[oldbucket];
-        global_assoc->old_hashtable[oldbucket] = it;
-    } else {
-        it->h_next = global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
-        global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)] = it;
+        std::lock_guard<std::mutex> guard(assoc_lock(hash));
+        if (global_assoc->expanding &&
+            (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
+        {
+            it->h_next = global_assoc->old_hashtable[oldbucket];
+            global_assoc->old_hashtable[oldbucket] = it;
+        } else {
+            it->h_next = global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
+            global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)] = it;
+        }
+
+        const auto items = ++global_assoc->hash_items;
+        expand = !global_assoc->expanding &&
+                 items > (hashsize(global_assoc->hashpower) * 3) / 2;
     }
 
-    global_assoc->hash_items++;
-    if (! global_assoc->expanding && global_assoc->hash_items > (hashsize(global_assoc->hashpower) * 3) / 2) {
+    if (expand) {
         assoc_expand();
     }
     return 1;
 }
 
 void assoc_delete(uint32_t hash, const hash_key *key) {
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
+    std::lock_guard<std::mutex> guard(assoc_lock(hash));
     hash_item **before = _hashitem_before(hash, key);
 
     if (*before) {
@@ -229,48 +305,40 @@ void assoc_delete(uint32_t hash, const hash_key *key) {
     cb_assert(*before != 0);
 }
 
-
-
-#define DEFAULT_HASH_BULK_MOVE 1
-int hash_bulk_move = DEFAULT_HASH_BULK_MOVE;
-
 static void assoc_maintenance_thread(void *arg) {
-    bool done = false;
-    do {
-        int ii;
-        std::lock_guard<std::mutex> guard(global_assoc->mutex);
-
-        for (ii = 0; ii < hash_bulk_move && global_assoc->expanding; ++ii) {
-            hash_item *it, *next;
-            int bucket;
-
-            for (it = global_assoc->old_hashtable[global_assoc->expand_bucket];
-                 NULL != it; it = next) {
-                next = it->h_next;
-                const hash_key* key = item_get_key(it);
-                bucket = crc32c(hash_key_get_key(key),
-                                hash_key_get_key_len(key),
-                                0) & hashmask(global_assoc->hashpower);
-                it->h_next = global_assoc->primary_hashtable[bucket];
-                global_assoc->primary_hashtable[bucket] = it;
-            }
-
-            global_assoc->old_hashtable[global_assoc->expand_bucket] = NULL;
-            global_assoc->expand_bucket++;
-            if (global_assoc->expand_bucket == hashsize(global_assoc->hashpower - 1)) {
-                global_assoc->expanding = false;
-                global_assoc->old_hashtable.resize(0);
-                global_assoc->old_hashtable.shrink_to_fit();
-                LOG_INFO("Hash table expansion done");
-            }
-        }
-        if (!global_assoc->expanding) {
-            done = true;
+    const unsigned int oldsize = hashsize(global_assoc->hashpower - 1);
+
+    /* Move one old bucket at a time, under the lock stripe all the items
+       being moved (and their new buckets) were in */
+    while (global_assoc->expand_bucket < oldsize) {
+        const unsigned int oldbucket = global_assoc->expand_bucket;
+        std::lock_guard<std::mutex> guard(assoc_lock(oldbucket));
+
+        hash_item *it, *next;
+        for (it = global_assoc->old_hashtable[oldbucket]; NULL != it;
+             it = next) {
+            next = it->h_next;
+            const hash_key* key = item_get_key(it);
+            const auto bucket = crc32c(hash_key_get_key(key),
+                                       hash_key_get_key_len(key),
+                                       0) & hashmask(global_assoc->hashpower);
+            it->h_next = global_assoc->primary_hashtable[bucket];
+            global_assoc->primary_hashtable[bucket] = it;
         }
-    } while (!done);
+
+        global_assoc->old_hashtable[oldbucket] = NULL;
+        global_assoc->expand_bucket++;
+    }
+
+    /* Every stripe is held only to retire the old table; it's freed after */
+    std::vector<hash_item*> old;
+    assoc_lock_all();
+    global_assoc->expanding = false;
+    old.swap(global_assoc->old_hashtable);
+    assoc_unlock_all();
+    LOG_INFO("Hash table expansion done");
 }
 
 bool assoc_expanding() {
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
     return global_assoc->expanding;
 }
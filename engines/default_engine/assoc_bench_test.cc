@@ -22,6 +22,7 @@
 #include <platform/cb_malloc.h>
 #include <platform/crc32c.h>
 #include <random>
+#include <vector>
 
 const uint32_t max_items = 100000;
 
@@ -107,8 +108,43 @@ void AccessRandomItems(benchmark::State& state) {
     }
 }
 
+/*
+ * Look up random items while the first thread inserts new ones (and so grows
+ * the hash table), to show how much lookups are held up by the expansion.
+ */
+void AccessRandomItemsWhileInserting(benchmark::State& state) {
+    if (state.thread_index != 0) {
+        AccessRandomItems(state);
+        return;
+    }
+
+    std::vector<uint32_t> inserted;
+    uint32_t id = max_items;
+    while (state.KeepRunning()) {
+        auto* it = item_alloc(id);
+        hash_key hkey;
+        hash_key_create(&hkey, id);
+        assoc_insert(crc32c(hash_key_get_key(&hkey),
+                            hash_key_get_key_len(&hkey),
+                            0),
+                     it);
+        inserted.push_back(id++);
+    }
+
+    for (auto ii : inserted) {
+        hash_key hkey;
+        hash_key_create(&hkey, ii);
+        auto hash = crc32c(hash_key_get_key(&hkey),
+                           hash_key_get_key_len(&hkey), 0);
+        auto* it = assoc_find(hash, &hkey);
+        assoc_delete(hash, &hkey);
+        free(static_cast<void*>(it));
+    }
+}
+
 BENCHMARK(AccessSingleItem)->ThreadRange(1, 16);
 BENCHMARK(AccessRandomItems)->ThreadRange(1, 16);
+BENCHMARK(AccessRandomItemsWhileInserting)->ThreadRange(2, 16);
 
 int main(int argc, char** argv) {
     ::benchmark::Initialize(&argc, argv);
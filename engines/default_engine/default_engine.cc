@@ -71,7 +71,6 @@ void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
 {
     cb_mutex_initialize(&engine->slabs.lock);
     cb_mutex_initialize(&engine->items.lock);
-    cb_mutex_initialize(&engine->stats.lock);
     cb_mutex_initialize(&engine->scrubber.lock);
 
     engine->bucket_id = id;
@@ -80,6 +79,7 @@ void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
     engine->config.evict_to_free = true;
     engine->config.maxbytes = 64 * 1024 * 1024;
     engine->config.preallocate = false;
+    engine->config.slab_automove = true;
     engine->config.factor = 1.25;
     engine->config.chunk_size = 48;
     engine->config.item_size_max= 1024 * 1024;
@@ -153,7 +153,6 @@ void destroy_engine_instance(struct default_engine* engine) {
 
         /* Clean up the mutexes */
         cb_mutex_destroy(&engine->items.lock);
-        cb_mutex_destroy(&engine->stats.lock);
         cb_mutex_destroy(&engine->slabs.lock);
         cb_mutex_destroy(&engine->scrubber.lock);
 
@@ -473,7 +472,6 @@ ENGINE_ERROR_CODE default_engine::get_stats(gsl::not_null<const void*> cookie,
         char val[128];
         int len;
 
-        cb_mutex_enter(&stats.lock);
         len = sprintf(val, "%" PRIu64, (uint64_t)stats.evictions);
         add_stat("evictions", 9, val, len, cookie);
         len = sprintf(val, "%" PRIu64, (uint64_t)stats.curr_items);
@@ -482,11 +480,10 @@ ENGINE_ERROR_CODE default_engine::get_stats(gsl::not_null<const void*> cookie,
         add_stat("total_items", 11, val, len, cookie);
         len = sprintf(val, "%" PRIu64, (uint64_t)stats.curr_bytes);
         add_stat("bytes", 5, val, len, cookie);
-        len = sprintf(val, "%" PRIu64, stats.reclaimed);
+        len = sprintf(val, "%" PRIu64, stats.reclaimed.load());
         add_stat("reclaimed", 9, val, len, cookie);
         len = sprintf(val, "%" PRIu64, (uint64_t)config.maxbytes);
         add_stat("engine_maxbytes", 15, val, len, cookie);
-        cb_mutex_exit(&stats.lock);
     } else if (key == "slabs"_ccb) {
         slabs_stats(this, add_stat, cookie);
     } else if (key == "items"_ccb) {
@@ -616,11 +613,9 @@ ENGINE_ERROR_CODE default_engine::flush(gsl::not_null<const void*> cookie) {
 void default_engine::reset_stats(gsl::not_null<const void*> cookie) {
     item_stats_reset(this);
 
-    cb_mutex_enter(&stats.lock);
     stats.evictions = 0;
     stats.reclaimed = 0;
     stats.total_items = 0;
-    cb_mutex_exit(&stats.lock);
 }
 
 static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
@@ -630,7 +625,7 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
    se->config.vb0 = true;
 
    if (cfg_str != NULL) {
-       struct config_item items[13];
+       struct config_item items[14];
        int ii = 0;
 
        memset(&items, 0, sizeof(items));
@@ -654,6 +649,11 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
        items[ii].value.dt_bool = &se->config.preallocate;
        ++ii;
 
+       items[ii].key = "slab_automove";
+       items[ii].datatype = DT_BOOL;
+       items[ii].value.dt_bool = &se->config.slab_automove;
+       ++ii;
+
        items[ii].key = "factor";
        items[ii].datatype = DT_FLOAT;
        items[ii].value.dt_float = &se->config.factor;
@@ -695,7 +695,7 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
 
        items[ii].key = NULL;
        ++ii;
-       cb_assert(ii == 13);
+       cb_assert(ii == 14);
        ret = ENGINE_ERROR_CODE(se->server.core->parse_config(cfg_str,
                                                              items,
                                                              stderr));
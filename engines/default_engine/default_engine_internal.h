@@ -38,12 +38,16 @@ struct default_engine;
 /** The item is deleted (may only be accessed if explicitly asked for) */
 #define ITEM_ZOMBIE (4)
 
+/** The item was accessed since it was linked / last reached the LRU tail */
+#define ITEM_ACTIVE (8)
+
 struct config {
    size_t verbose;
    rel_time_t oldest_live;
    bool evict_to_free;
    size_t maxbytes;
    bool preallocate;
+   bool slab_automove;
    float factor;
    size_t chunk_size;
    size_t item_size_max;
@@ -57,15 +61,15 @@ struct config {
 };
 
 /**
- * Statistic information collected by the default engine
+ * Statistic information collected by the default engine. Updated without a
+ * lock of their own (the item paths updating them already hold items.lock).
  */
 struct engine_stats {
-   cb_mutex_t lock;
-   uint64_t evictions;
-   uint64_t reclaimed;
-   uint64_t curr_bytes;
-   uint64_t curr_items;
-   uint64_t total_items;
+   std::atomic<uint64_t> evictions;
+   std::atomic<uint64_t> reclaimed;
+   std::atomic<uint64_t> curr_bytes;
+   std::atomic<uint64_t> curr_items;
+   std::atomic<uint64_t> total_items;
 };
 
 struct engine_scrubber {
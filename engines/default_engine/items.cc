@@ -57,7 +57,6 @@ static void hash_key_copy_to_item(hash_item* dst, const hash_key* src);
  * in this many seconds. That saves us from churning on frequently-accessed
  * items.
  */
-#define ITEM_UPDATE_INTERVAL 60
 /*
  * To avoid scanning through the complete cache in some circumstances we'll
  * just give up and return an error after inspecting a fixed number of objects.
@@ -96,6 +95,204 @@ static uint64_t get_cas_id(void) {
 #endif
 
 
+/*
+ * Evict (or reclaim, if it has expired) the least recently used unreferenced
+ * item of the slab class, searching up to search_items items from its tail.
+ * With secondChance, an item accessed since it was linked or last reached
+ * the tail (ITEM_ACTIVE) isn't evicted; it's moved back to the head with
+ * the flag cleared. That keeps repositioning items off the read path (which
+ * only sets the flag) and keeps items which are read more than once in the
+ * cache ahead of those read once, e.g. by a scan.
+ *
+ * @return true if an item was unlinked
+ */
+static bool do_item_evict(struct default_engine *engine,
+                          unsigned int id,
+                          rel_time_t current_time,
+                          bool secondChance) {
+    const rel_time_t oldest_live = engine->config.oldest_live;
+    int tries = search_items;
+    hash_item *search, *prev;
+
+    for (search = engine->items.tails[id]; tries > 0 && search != NULL;
+         tries--, search = prev) {
+        prev = search->prev;
+        if (search->refcount != 0 || search->locktime > current_time) {
+            continue;
+        }
+        if (search->exptime == 0 || search->exptime > current_time) {
+            const bool flushed = oldest_live != 0 &&
+                                 oldest_live <= current_time &&
+                                 search->time <= oldest_live;
+            if (secondChance && !flushed &&
+                (search->iflag & ITEM_ACTIVE) != 0) {
+                /* The LRU is kept sorted by time (see item_flush_expired) */
+                search->iflag &= ~ITEM_ACTIVE;
+                item_unlink_q(engine, search);
+                search->time = current_time;
+                item_link_q(engine, search);
+                continue;
+            }
+            engine->items.itemstats[id].evicted++;
+            engine->items.itemstats[id].evicted_time = current_time - search->time;
+            if (search->exptime != 0) {
+                engine->items.itemstats[id].evicted_nonzero++;
+            }
+            engine->stats.evictions++;
+        } else {
+            engine->items.itemstats[id].reclaimed++;
+            engine->stats.reclaimed++;
+        }
+        do_item_unlink(engine, search);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Slab automove looks at the evictions (and out of memory errors) of each
+ * slab class over the last one to two windows of this many seconds.
+ */
+static const rel_time_t slab_automove_window = 10;
+
+/* How many slabs of the class to take one from are tried */
+static const unsigned int slab_automove_tries = 4;
+
+static unsigned int item_slab_pressure_total(const itemstats_t *stats) {
+    return stats->evicted + stats->outofmemory;
+}
+
+/*
+ * Start a new automove window if the current one is over. Evictions (and
+ * out of memory errors) only follow a call to do_item_slab_automove, so if
+ * none started a window for a whole window there were none in it.
+ */
+static void do_item_slab_automove_window(struct default_engine *engine,
+                                         rel_time_t current_time) {
+    struct items *items = &engine->items;
+    unsigned int ii;
+
+    if (current_time < items->automove_window + slab_automove_window) {
+        return;
+    }
+    for (ii = 0; ii < POWER_LARGEST; ++ii) {
+        const unsigned int now = item_slab_pressure_total(&items->itemstats[ii]);
+        if (current_time < items->automove_window + 2 * slab_automove_window) {
+            items->automove_pressure[0][ii] = items->automove_pressure[1][ii];
+        } else {
+            items->automove_pressure[0][ii] = now;
+        }
+        items->automove_pressure[1][ii] = now;
+    }
+    items->automove_window = current_time;
+}
+
+/* Evictions and out of memory errors of a slab class since the last window */
+static unsigned int do_item_slab_pressure(struct default_engine *engine,
+                                          unsigned int id) {
+    const unsigned int now =
+            item_slab_pressure_total(&engine->items.itemstats[id]);
+    const unsigned int then = engine->items.automove_pressure[0][id];
+    /* the stats may have been reset since */
+    return now >= then ? now - then : now;
+}
+
+/*
+ * Evict all of the items in slab number idx of slab class id, unless any of
+ * them are in use or locked (or evict_to_free is disabled).
+ *
+ * @return true if all of the chunks of the slab are now free
+ */
+static bool do_item_slab_evict(struct default_engine *engine,
+                               unsigned int id,
+                               unsigned int idx,
+                               rel_time_t current_time) {
+    const slabclass_t *p = &engine->slabs.slabclass[id];
+    char *slab = static_cast<char*>(slabs_get_slab(engine, id, idx));
+    unsigned int ii;
+
+    if (slab == NULL) {
+        return false;
+    }
+
+    /* Free chunks (and those never handed out) don't have a slab class */
+    for (ii = 0; ii < p->perslab; ++ii) {
+        const hash_item *it = (const hash_item*)(slab + (size_t)ii * p->size);
+        if (it->slabs_clsid != 0 &&
+            (it->refcount != 0 || (it->iflag & ITEM_LINKED) == 0 ||
+             it->locktime > current_time || !engine->config.evict_to_free)) {
+            engine->slabs.automove_busy++;
+            return false;
+        }
+    }
+
+    for (ii = 0; ii < p->perslab; ++ii) {
+        hash_item *it = (hash_item*)(slab + (size_t)ii * p->size);
+        if (it->slabs_clsid != 0) {
+            do_item_unlink(engine, it);
+            engine->slabs.automove_evicted++;
+        }
+    }
+    return true;
+}
+
+/*
+ * Slab automove: give slab class id, which is out of memory, a slab from
+ * another class if id has been evicting items (or failing to allocate them)
+ * since the last window started. The slab is taken from the class with the
+ * most free memory of those which haven't (and have more than one slab), and
+ * the items still in it are evicted. That lets the memory follow changes in
+ * the sizes of the items stored instead of staying with the classes it was
+ * first given to, without moving slabs back and forth between classes which
+ * are both short of memory.
+ *
+ * @return true if class id was given a slab
+ */
+static bool do_item_slab_automove(struct default_engine *engine,
+                                  unsigned int id,
+                                  rel_time_t current_time) {
+    unsigned int src = 0;
+    size_t src_free = 0;
+    unsigned int ii;
+
+    if (!engine->config.slab_automove) {
+        return false;
+    }
+
+    do_item_slab_automove_window(engine, current_time);
+    if (do_item_slab_pressure(engine, id) == 0) {
+        return false;
+    }
+
+    for (ii = POWER_SMALLEST;
+         ii < POWER_LARGEST && ii <= engine->slabs.power_largest;
+         ++ii) {
+        const slabclass_t *p = &engine->slabs.slabclass[ii];
+        size_t free;
+
+        /* do_slabs_newslab always lets a class have one slab */
+        if (ii == id || p->slabs < 2 || do_item_slab_pressure(engine, ii) != 0) {
+            continue;
+        }
+        free = (size_t)(p->sl_curr + p->end_page_free) * p->size;
+        if (src == 0 || free > src_free) {
+            src = ii;
+            src_free = free;
+        }
+    }
+
+    if (src == 0) {
+        return false;
+    }
+
+    for (ii = 0; ii < slab_automove_tries; ++ii) {
+        if (do_item_slab_evict(engine, src, ii, current_time)) {
+            return slabs_reassign(engine, src, ii, id);
+        }
+    }
+    return false;
+}
+
 /*@null@*/
 hash_item *do_item_alloc(struct default_engine *engine,
                          const hash_key *key,
@@ -132,9 +329,7 @@ hash_item *do_item_alloc(struct default_engine *engine,
             /* I don't want to actually free the object, just steal
              * the item to avoid to grab the slab mutex twice ;-)
              */
-            cb_mutex_enter(&engine->stats.lock);
             engine->stats.reclaimed++;
-            cb_mutex_exit(&engine->stats.lock);
             engine->items.itemstats[id].reclaimed++;
             it->refcount = 1;
             slabs_adjust_mem_requested(engine, it->slabs_clsid, ITEM_ntotal(engine, it), ntotal);
@@ -147,12 +342,13 @@ hash_item *do_item_alloc(struct default_engine *engine,
     }
 
     if (it == NULL &&
-        (it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id))) == NULL) {
+        (it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id))) == NULL &&
+        (!do_item_slab_automove(engine, id, current_time) ||
+         (it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id))) == NULL)) {
         /*
-        ** Could not find an expired item at the tail, and memory allocation
-        ** failed. Try to evict some items!
+        ** Could not find an expired item at the tail, memory allocation
+        ** failed and no slab could be moved here. Try to evict some items!
         */
-        tries = search_items;
 
         /* If requested to not push old items out of cache when memory runs out,
          * we're out of luck at this point...
@@ -175,26 +371,9 @@ hash_item *do_item_alloc(struct default_engine *engine,
             return NULL;
         }
 
-        for (search = engine->items.tails[id]; tries > 0 && search != NULL; tries--, search=search->prev) {
-            if (search->refcount == 0 && search->locktime <= current_time) {
-                if (search->exptime == 0 || search->exptime > current_time) {
-                    engine->items.itemstats[id].evicted++;
-                    engine->items.itemstats[id].evicted_time = current_time - search->time;
-                    if (search->exptime != 0) {
-                        engine->items.itemstats[id].evicted_nonzero++;
-                    }
-                    cb_mutex_enter(&engine->stats.lock);
-                    engine->stats.evictions++;
-                    cb_mutex_exit(&engine->stats.lock);
-                } else {
-                    engine->items.itemstats[id].reclaimed++;
-                    cb_mutex_enter(&engine->stats.lock);
-                    engine->stats.reclaimed++;
-                    cb_mutex_exit(&engine->stats.lock);
-                }
-                do_item_unlink(engine, search);
-                break;
-            }
+        if (!do_item_evict(engine, id, current_time, true)) {
+            /* Everything searched was recently used; evict the LRU anyway */
+            do_item_evict(engine, id, current_time, false);
         }
         it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
         if (it == 0) {
@@ -309,11 +488,9 @@ int do_item_link(struct default_engine *engine,
     assoc_insert(crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0),
                  it);
 
-    cb_mutex_enter(&engine->stats.lock);
     engine->stats.curr_bytes += ITEM_ntotal(engine, it);
     engine->stats.curr_items += 1;
     engine->stats.total_items += 1;
-    cb_mutex_exit(&engine->stats.lock);
 
     auto cas = get_cas_id();
 
@@ -345,10 +522,8 @@ void do_item_unlink(struct default_engine *engine, hash_item *it) {
     const hash_key* key = item_get_key(it);
     if ((it->iflag & ITEM_LINKED) != 0) {
         it->iflag &= ~ITEM_LINKED;
-        cb_mutex_enter(&engine->stats.lock);
         engine->stats.curr_bytes -= ITEM_ntotal(engine, it);
         engine->stats.curr_items -= 1;
-        cb_mutex_exit(&engine->stats.lock);
         assoc_delete(crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0),
                      key);
         item_unlink_q(engine, it);
@@ -373,10 +548,8 @@ ENGINE_ERROR_CODE do_safe_item_unlink(struct default_engine* engine,
     if (it->cas == stored->cas) {
         if ((stored->iflag & ITEM_LINKED) != 0) {
             stored->iflag &= ~ITEM_LINKED;
-            cb_mutex_enter(&engine->stats.lock);
             engine->stats.curr_bytes -= ITEM_ntotal(engine, stored);
             engine->stats.curr_items -= 1;
-            cb_mutex_exit(&engine->stats.lock);
             assoc_delete(crc32c(hash_key_get_key(key),
                                 hash_key_get_key_len(key), 0),
                          key);
@@ -404,15 +577,10 @@ void do_item_release(struct default_engine *engine, hash_item *it) {
 }
 
 void do_item_update(struct default_engine *engine, hash_item *it) {
-    rel_time_t current_time = engine->server.core->get_current_time();
-    if (it->time < current_time - ITEM_UPDATE_INTERVAL) {
-        cb_assert((it->iflag & ITEM_SLABBED) == 0);
-
-        if ((it->iflag & ITEM_LINKED) != 0) {
-            item_unlink_q(engine, it);
-            it->time = current_time;
-            item_link_q(engine, it);
-        }
+    /* Only mark the item used; do_item_evict moves it back to the head of
+       the LRU if it reaches the tail while marked */
+    if ((it->iflag & ITEM_ACTIVE) == 0) {
+        it->iflag |= ITEM_ACTIVE;
     }
 }
 
@@ -152,6 +152,13 @@ struct items {
    hash_item *tails[POWER_LARGEST];
    itemstats_t itemstats[POWER_LARGEST];
    unsigned int sizes[POWER_LARGEST];
+   /*
+    * Slab automove: the evictions and out of memory errors of each slab
+    * class at the start of the previous and the current window, and when
+    * the current window started (see do_item_slab_automove)
+    */
+   unsigned int automove_pressure[2][POWER_LARGEST];
+   rel_time_t automove_window;
    /*
     * serialise access to the items data
    */
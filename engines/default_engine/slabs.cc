@@ -177,9 +177,20 @@ static int grow_slab_list (struct default_engine *engine, const unsigned int id)
     return 1;
 }
 
+/*
+ * With slab_automove every slab is item_size_max bytes, so that a slab can
+ * be moved to any other class.
+ */
+static size_t slab_size(struct default_engine *engine, const slabclass_t *p) {
+    if (engine->config.slab_automove) {
+        return engine->config.item_size_max;
+    }
+    return (size_t)p->size * p->perslab;
+}
+
 static int do_slabs_newslab(struct default_engine *engine, const unsigned int id) {
     slabclass_t *p = &engine->slabs.slabclass[id];
-    int len = p->size * p->perslab;
+    int len = (int)slab_size(engine, p);
     char *ptr;
 
     if ((engine->slabs.mem_limit && engine->slabs.mem_malloced + len > engine->slabs.mem_limit && p->slabs > 0) ||
@@ -276,6 +287,51 @@ static void do_slabs_free(struct default_engine *engine, void *ptr, const size_t
     return;
 }
 
+static bool do_slabs_reassign(struct default_engine *engine,
+                              unsigned int src,
+                              unsigned int idx,
+                              unsigned int dst) {
+    slabclass_t *s = &engine->slabs.slabclass[src];
+    slabclass_t *d = &engine->slabs.slabclass[dst];
+    char *slab;
+    char *end;
+    unsigned int ii, jj;
+
+    if (idx >= s->slabs || d->end_page_ptr != NULL ||
+        grow_slab_list(engine, dst) == 0) {
+        return false;
+    }
+
+    slab = static_cast<char*>(s->slab_list[idx]);
+    end = slab + (size_t)s->size * s->perslab;
+
+    /* Drop the chunks of the slab from the free list of the class */
+    for (ii = jj = 0; ii < s->sl_curr; ++ii) {
+        char *chunk = static_cast<char*>(s->slots[ii]);
+        if (chunk < slab || chunk >= end) {
+            s->slots[jj++] = chunk;
+        }
+    }
+    s->sl_curr = jj;
+
+    if (s->end_page_ptr != NULL && static_cast<char*>(s->end_page_ptr) >= slab &&
+        static_cast<char*>(s->end_page_ptr) < end) {
+        s->end_page_ptr = 0;
+        s->end_page_free = 0;
+    }
+
+    s->slab_list[idx] = s->slab_list[--s->slabs];
+    s->pages_moved_out++;
+
+    memset(slab, 0, slab_size(engine, d));
+    d->end_page_ptr = slab;
+    d->end_page_free = d->perslab;
+    d->slab_list[d->slabs++] = slab;
+    d->pages_moved_in++;
+
+    return true;
+}
+
 void add_statistics(const void *cookie, ADD_STAT add_stats,
                     const char* prefix, int num, const char *key,
                     const char *fmt, ...) {
@@ -327,6 +383,7 @@ void add_statistics(const void *cookie, ADD_STAT add_stats,
 static void do_slabs_stats(struct default_engine *engine, ADD_STAT add_stats, const void *cookie) {
     unsigned int i;
     unsigned int total = 0;
+    uint64_t moved = 0;
 
     for(i = POWER_SMALLEST; i <= engine->slabs.power_largest; i++) {
         slabclass_t *p = &engine->slabs.slabclass[i];
@@ -352,8 +409,13 @@ static void do_slabs_stats(struct default_engine *engine, ADD_STAT add_stats, co
             add_statistics(cookie, add_stats, NULL, i, "mem_requested",
                            "%" PRIu64,
                            (uint64_t)p->requested);
+            add_statistics(cookie, add_stats, NULL, i, "pages_moved_in", "%u",
+                           p->pages_moved_in);
+            add_statistics(cookie, add_stats, NULL, i, "pages_moved_out",
+                           "%u", p->pages_moved_out);
             total++;
         }
+        moved += p->pages_moved_in;
     }
 
     /* add overall slab stats and append terminator */
@@ -361,6 +423,12 @@ static void do_slabs_stats(struct default_engine *engine, ADD_STAT add_stats, co
     add_statistics(cookie, add_stats, NULL, -1, "active_slabs", "%d", total);
     add_statistics(cookie, add_stats, NULL, -1, "total_malloced", "%" PRIu64,
                    (uint64_t)engine->slabs.mem_malloced);
+    add_statistics(cookie, add_stats, NULL, -1, "slabs_moved", "%" PRIu64,
+                   moved);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_busy",
+                   "%" PRIu64, engine->slabs.automove_busy.load());
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_evicted",
+                   "%" PRIu64, engine->slabs.automove_evicted.load());
 }
 
 static void *memory_allocate(struct default_engine *engine, size_t size) {
@@ -407,6 +475,34 @@ void slabs_free(struct default_engine *engine, void *ptr, size_t size, unsigned
     cb_mutex_exit(&engine->slabs.lock);
 }
 
+void *slabs_get_slab(struct default_engine *engine, unsigned int id, unsigned int idx) {
+    void *ret = NULL;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    if (id >= POWER_SMALLEST && id <= engine->slabs.power_largest &&
+        idx < engine->slabs.slabclass[id].slabs) {
+        ret = engine->slabs.slabclass[id].slab_list[idx];
+    }
+    cb_mutex_exit(&engine->slabs.lock);
+    return ret;
+}
+
+bool slabs_reassign(struct default_engine *engine,
+                    unsigned int src,
+                    unsigned int idx,
+                    unsigned int dst) {
+    bool ret = false;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    if (engine->config.slab_automove && src != dst &&
+        src >= POWER_SMALLEST && src <= engine->slabs.power_largest &&
+        dst >= POWER_SMALLEST && dst <= engine->slabs.power_largest) {
+        ret = do_slabs_reassign(engine, src, idx, dst);
+    }
+    cb_mutex_exit(&engine->slabs.lock);
+    return ret;
+}
+
 void slabs_stats(struct default_engine *engine, ADD_STAT add_stats, const void *c) {
     cb_mutex_enter(&engine->slabs.lock);
     do_slabs_stats(engine, add_stats, c);
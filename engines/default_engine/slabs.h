@@ -4,6 +4,8 @@
 #include <memcached/engine_common.h>
 #include <memcached/engine_error.h>
 
+#include <atomic>
+
 /* Slab sizing definitions. */
 #define POWER_SMALLEST 1
 #define POWER_LARGEST 200
@@ -31,6 +33,9 @@ typedef struct {
 
     unsigned int killing;  /* index+1 of dying slab, or zero if none */
     size_t requested; /* The number of requested bytes */
+
+    unsigned int pages_moved_in;  /* slabs given to this class by automove */
+    unsigned int pages_moved_out; /* slabs taken from this class by automove */
 } slabclass_t;
 
 struct slabs {
@@ -49,6 +54,14 @@ struct slabs {
       size_t size;
    } allocs;
 
+   /**
+    * Slab automove statistics: the number of times a slab couldn't be moved
+    * as an item in it was in use, and the number of items evicted to move
+    * slabs
+    */
+   std::atomic<uint64_t> automove_busy;
+   std::atomic<uint64_t> automove_evicted;
+
    /**
     * Access to the slab allocator is protected by this lock
     */
@@ -87,6 +100,26 @@ void slabs_free(struct default_engine *engine, void *ptr, size_t size, unsigned
 /** Adjust the stats for memory requested */
 void slabs_adjust_mem_requested(struct default_engine *engine, unsigned int id, size_t old, size_t ntotal);
 
+/**
+ * Get a slab of a slab class, for the caller to check the items in it
+ * before moving it to another class with slabs_reassign.
+ *
+ * @return slab number idx of class id, or NULL if it doesn't have that many
+ */
+void *slabs_get_slab(struct default_engine *engine, unsigned int id, unsigned int idx);
+
+/**
+ * Move slab number idx of class src to class dst (slab_automove). All of the
+ * chunks in the slab must be free (the caller unlinks the items in it first).
+ *
+ * @return false if the slab couldn't be moved: dst still has chunks left at
+ *         the end of its last slab, or there's no memory to track the slab
+ */
+bool slabs_reassign(struct default_engine *engine,
+                    unsigned int src,
+                    unsigned int idx,
+                    unsigned int dst);
+
 /** Fill buffer with stats */ /*@null@*/
 void slabs_stats(struct default_engine *engine, ADD_STAT add_stats, const void *c);
 
@@ -0,0 +1,125 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks relating to the DurabilityMonitor class.
+ */
+
+#include "durability_monitor.h"
+#include "engine_fixture.h"
+#include "kv_bucket.h"
+#include "vbucket.h"
+
+#include "../tests/module_tests/test_helpers.h"
+#include "../tests/module_tests/thread_gate.h"
+
+#include <mock/mock_synchronous_ep_engine.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class DurabilityMonitorBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        EngineFixture::SetUp(state);
+        engine->getKVBucket()->setVBucketState(
+                vbid, vbucket_state_active, false);
+        monitor = std::make_unique<DurabilityMonitor>(
+                *engine->getKVBucket()->getVBucket(vbid));
+        ASSERT_EQ(ENGINE_SUCCESS, monitor->registerReplicationChain({replica}));
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        monitor.reset();
+        EngineFixture::TearDown(state);
+    }
+
+    queued_item makeSyncWrite(int64_t seqno) {
+        queued_item qi{new Item(makeStoredDocKey("key"),
+                                0 /*flags*/,
+                                0 /*exp*/,
+                                "value",
+                                5 /*valueSize*/,
+                                PROTOCOL_BINARY_RAW_BYTES,
+                                0 /*cas*/,
+                                seqno)};
+        using namespace cb::durability;
+        qi->setPendingSyncWrite(Requirements(Level::Majority, 0 /*timeout*/));
+        return qi;
+    }
+
+    const std::string replica = "replica1";
+    std::unique_ptr<DurabilityMonitor> monitor;
+};
+
+/*
+ * Measures the throughput of the frontend thread adding SyncWrites while a
+ * replica acks them in a background thread (the DCP consumer side), i.e.
+ * the contention between addSyncWrite and seqnoAckReceived.
+ */
+BENCHMARK_DEFINE_F(DurabilityMonitorBench, AddSyncWriteWhileAcking)
+(benchmark::State& state) {
+    std::atomic<int64_t> lastAdded{0};
+    std::atomic<bool> done{false};
+    ThreadGate tg(2);
+
+    size_t numAcks = 0;
+    std::thread acker([this, &tg, &lastAdded, &done, &numAcks]() {
+        tg.threadUp();
+        int64_t lastAcked = 0;
+        while (!done) {
+            const auto seqno = lastAdded.load();
+            if (seqno > lastAcked) {
+                monitor->seqnoAckReceived(replica, seqno);
+                lastAcked = seqno;
+                numAcks++;
+            }
+        }
+    });
+
+    // Create the SyncWrites outside of the measured loop
+    const size_t batch = state.range(0);
+    std::vector<queued_item> writes;
+    int64_t seqno = 1;
+
+    tg.threadUp();
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        writes.clear();
+        for (size_t ii = 0; ii < batch; ++ii) {
+            writes.push_back(makeSyncWrite(seqno++));
+        }
+        state.ResumeTiming();
+
+        for (auto& qi : writes) {
+            monitor->addSyncWrite(qi);
+            lastAdded = qi->getBySeqno();
+        }
+    }
+    done = true;
+    acker.join();
+
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.counters["NumAcks"] = numAcks;
+}
+
+BENCHMARK_REGISTER_F(DurabilityMonitorBench, AddSyncWriteWhileAcking)
+        ->Args({100})
+        ->Args({10000});
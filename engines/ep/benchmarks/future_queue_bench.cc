@@ -0,0 +1,167 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks relating to the FutureQueue class, compared against the binary
+ * heap it replaced (which re-heapified the queue on every snooze / wake).
+ */
+
+#include "futurequeue.h"
+#include "taskable.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <vector>
+
+class BenchTaskable : public Taskable {
+public:
+    BenchTaskable() : policy(HIGH_BUCKET_PRIORITY, 1) {
+    }
+    const std::string& getName() const override {
+        return name;
+    }
+    task_gid_t getGID() const override {
+        return 0;
+    }
+    bucket_priority_t getWorkloadPriority() const override {
+        return HIGH_BUCKET_PRIORITY;
+    }
+    void setWorkloadPriority(bucket_priority_t prio) override {
+    }
+    WorkLoadPolicy& getWorkLoadPolicy() override {
+        return policy;
+    }
+    void logQTime(TaskId id,
+                  const std::chrono::steady_clock::duration enqTime) override {
+    }
+    void logRunTime(TaskId id,
+                    const std::chrono::steady_clock::duration runTime) override {
+    }
+
+private:
+    const std::string name = "bench";
+    WorkLoadPolicy policy;
+};
+
+class BenchTask : public GlobalTask {
+public:
+    explicit BenchTask(Taskable& t)
+        : GlobalTask(t, TaskId::ActiveStreamCheckpointProcessorTask, 0, false) {
+    }
+    bool run() override {
+        return false;
+    }
+    std::string getDescription() override {
+        return "BenchTask";
+    }
+    std::chrono::microseconds maxExpectedDuration() override {
+        return std::chrono::seconds(1);
+    }
+};
+
+/**
+ * The previous FutureQueue: a std::priority_queue which locates a task with a
+ * linear search and rebuilds the heap after changing its wakeTime.
+ */
+class HeapFutureQueue {
+public:
+    void push(ExTask task) {
+        queue.push(task);
+    }
+
+    bool snooze(const ExTask& task, const double secs) {
+        task->snooze(secs);
+        return queue.heapify(task);
+    }
+
+    bool updateWaketime(const ExTask& task,
+                        std::chrono::steady_clock::time_point newTime) {
+        task->updateWaketime(newTime);
+        return queue.heapify(task);
+    }
+
+private:
+    class Queue : public std::priority_queue<ExTask,
+                                             std::deque<ExTask>,
+                                             CompareByDueDate> {
+    public:
+        bool heapify(const ExTask& task) {
+            auto it = std::find_if(
+                    c.begin(), c.end(), [&task](const ExTask& qTask) {
+                        return task->getId() == qTask->getId();
+                    });
+            if (it == c.end()) {
+                return false;
+            }
+            if (c.back()->getId() == task->getId()) {
+                std::push_heap(c.begin(), c.end(), comp);
+            } else {
+                std::make_heap(c.begin(), c.end(), comp);
+            }
+            return true;
+        }
+    } queue;
+};
+
+template <class Q>
+class FutureQueueFixture {
+public:
+    explicit FutureQueueFixture(size_t numTasks) {
+        std::mt19937 gen(numTasks);
+        std::uniform_int_distribution<int> secs(1, 60);
+        for (size_t ii = 0; ii < numTasks; ++ii) {
+            tasks.push_back(std::make_shared<BenchTask>(taskable));
+            tasks.back()->snooze(secs(gen));
+            queue.push(tasks.back());
+        }
+    }
+
+    BenchTaskable taskable;
+    std::vector<ExTask> tasks;
+    Q queue;
+};
+
+// Snooze queued tasks in turn, as done by tasks which run and snooze again.
+template <class Q>
+static void BM_FutureQueueSnooze(benchmark::State& state) {
+    FutureQueueFixture<Q> fixture(state.range(0));
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        const auto& task = fixture.tasks[next++ % fixture.tasks.size()];
+        benchmark::DoNotOptimize(fixture.queue.snooze(task, 5.0));
+    }
+}
+
+// Wake queued tasks in turn, as done by ExecutorPool::wake.
+template <class Q>
+static void BM_FutureQueueWake(benchmark::State& state) {
+    FutureQueueFixture<Q> fixture(state.range(0));
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        const auto& task = fixture.tasks[next++ % fixture.tasks.size()];
+        benchmark::DoNotOptimize(fixture.queue.updateWaketime(
+                task, std::chrono::steady_clock::now()));
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_FutureQueueSnooze, FutureQueue)->Range(16, 16384);
+BENCHMARK_TEMPLATE(BM_FutureQueueSnooze, HeapFutureQueue)->Range(16, 16384);
+BENCHMARK_TEMPLATE(BM_FutureQueueWake, FutureQueue)->Range(16, 16384);
+BENCHMARK_TEMPLATE(BM_FutureQueueWake, HeapFutureQueue)->Range(16, 16384);
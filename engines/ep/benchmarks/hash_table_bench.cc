@@ -25,6 +25,15 @@
 #include <benchmark/benchmark.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+
 // Benchmarks inserting items into a HashTable
 class HashTableBench : public benchmark::Fixture {
 public:
@@ -153,3 +162,245 @@ BENCHMARK_REGISTER_F(HashTableBench, Find)->ThreadPerCpu();
 BENCHMARK_REGISTER_F(HashTableBench, Insert)->ThreadPerCpu();
 BENCHMARK_REGISTER_F(HashTableBench, Replace)->ThreadPerCpu();
 BENCHMARK_REGISTER_F(HashTableBench, Delete)->ThreadPerCpu();
+
+/// Background work run against the HashTable while the front-end threads
+/// access it.
+enum class Background { None, Resize, Pager, Defragmenter };
+
+/*
+ * Benchmarks front-end threads contending on a HashTable; with a mix of
+ * reads and writes, keys chosen uniformly or from a zipfian distribution,
+ * and optionally a background thread resizing or visiting the HashTable.
+ *
+ * Arguments: {ht_locks, read %, zipf skew x 100 (0 for uniform), Background}
+ */
+class HashTableContentionBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        if (state.thread_index == 0) {
+            ht = std::make_unique<HashTable>(
+                    stats,
+                    std::make_unique<StoredValueFactory>(stats),
+                    numItems,
+                    state.range(0));
+            latencies.clear();
+            threadsDone = 0;
+        }
+    }
+
+    void TearDown(benchmark::State& state) override {
+        if (state.thread_index == 0) {
+            ht.reset();
+        }
+    }
+
+    /// Items of the same keys for every thread (so writes contend), but
+    /// distinct objects as HashTable::set() takes a non-const Item.
+    std::vector<Item> createItems() {
+        std::vector<Item> items;
+        items.reserve(numItems);
+        const auto data = std::string(256, 'x');
+        for (size_t i = 0; i < numItems; i++) {
+            auto key = makeStoredDocKey("key::" + std::to_string(i));
+            items.emplace_back(key, 0, 0, data.data(), data.size());
+        }
+        return items;
+    }
+
+    /// The sequence of item indexes a thread accesses, so choosing keys
+    /// isn't timed.
+    std::vector<size_t> createKeySequence(int seed, double skew) {
+        std::vector<double> weights(numItems, 1.0);
+        if (skew > 0) {
+            for (size_t i = 0; i < numItems; i++) {
+                weights[i] = 1.0 / std::pow(i + 1, skew);
+            }
+        }
+        std::mt19937_64 gen(seed);
+        std::discrete_distribution<size_t> dist(weights.begin(),
+                                                weights.end());
+        std::vector<size_t> sequence(sequenceLength);
+        for (auto& index : sequence) {
+            index = dist(gen);
+        }
+        // Hot keys shouldn't map to adjacent hash buckets.
+        std::vector<size_t> shuffle(numItems);
+        std::iota(shuffle.begin(), shuffle.end(), 0);
+        std::shuffle(shuffle.begin(), shuffle.end(), std::mt19937_64(0));
+        for (auto& index : sequence) {
+            index = shuffle[index];
+        }
+        return sequence;
+    }
+
+    /// Start the background work; until the benchmark is done.
+    void startBackground(Background background) {
+        stopBackground = false;
+        bgThread = std::thread([this, background]() {
+            switch (background) {
+            case Background::None:
+                return;
+            case Background::Resize:
+                // Alternate between sizes either side of numItems.
+                for (size_t ii = 0; !stopBackground; ++ii) {
+                    ht->resize((ii % 2) ? numItems * 4 : numItems / 4);
+                }
+                return;
+            case Background::Pager: {
+                // As the ItemPager, visit every item under its lock.
+                PagerVisitor visitor;
+                while (!stopBackground) {
+                    ht->visit(visitor);
+                }
+                return;
+            }
+            case Background::Defragmenter: {
+                // As the DefragmenterTask, visit in chunks and resume.
+                DefragmenterVisitor visitor;
+                HashTable::Position position;
+                while (!stopBackground) {
+                    visitor.visited = 0;
+                    position = ht->pauseResumeVisit(visitor, position);
+                    if (position == ht->endPosition()) {
+                        position = HashTable::Position();
+                    }
+                }
+                return;
+            }
+            }
+        });
+    }
+
+    void stopBackgroundThread() {
+        stopBackground = true;
+        bgThread.join();
+    }
+
+    /// Add a thread's latencies; the last thread reports the percentiles.
+    void reportLatencies(benchmark::State& state,
+                         const std::vector<uint64_t>& threadLatencies) {
+        std::lock_guard<std::mutex> lh(latencyMutex);
+        latencies.insert(
+                latencies.end(), threadLatencies.begin(), threadLatencies.end());
+        if (++threadsDone < state.threads || latencies.empty()) {
+            return;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [this](double pct) {
+            return double(latencies[size_t(latencies.size() * pct / 100)]);
+        };
+        // Counters are summed across threads, so only one thread sets them.
+        state.counters["p50_ns"] = percentile(50);
+        state.counters["p99_ns"] = percentile(99);
+        state.counters["p99.9_ns"] = percentile(99.9);
+    }
+
+    EPStats stats;
+    std::unique_ptr<HashTable> ht;
+    const size_t numItems = 10000;
+    const size_t sequenceLength = 1 << 16;
+
+    std::thread bgThread;
+    std::atomic<bool> stopBackground{false};
+
+    std::mutex latencyMutex;
+    std::vector<uint64_t> latencies;
+    int threadsDone = 0;
+
+private:
+    struct PagerVisitor : public HashTableVisitor {
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            // Age the item's frequency counter, as the ItemFreqDecayer.
+            v.setFreqCounterValue(v.getFreqCounterValue() / 2);
+            return true;
+        }
+    };
+
+    struct DefragmenterVisitor : public HashTableVisitor {
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            benchmark::DoNotOptimize(v.getValue());
+            return ++visited < chunkSize;
+        }
+        size_t visited = 0;
+        const size_t chunkSize = 1000;
+    };
+};
+
+BENCHMARK_DEFINE_F(HashTableContentionBench, Mixed)(benchmark::State& state) {
+    const int readPercent = state.range(1);
+    const double skew = state.range(2) / 100.0;
+    const auto background = Background(state.range(3));
+
+    auto items = createItems();
+    const auto sequence = createKeySequence(state.thread_index, skew);
+    std::mt19937 gen(state.thread_index);
+    std::vector<bool> isRead(sequenceLength);
+    for (size_t ii = 0; ii < sequenceLength; ++ii) {
+        isRead[ii] = int(gen() % 100) < readPercent;
+    }
+
+    if (state.thread_index == 0) {
+        for (auto& item : items) {
+            ASSERT_EQ(MutationStatus::WasClean, ht->set(item));
+        }
+        startBackground(background);
+    }
+
+    // Time every 16th operation, to keep the clock out of the throughput.
+    const size_t sampleMask = 0xf;
+    std::vector<uint64_t> threadLatencies;
+    threadLatencies.reserve(1 << 20);
+    size_t iteration = 0;
+    while (state.KeepRunning()) {
+        const auto index = iteration % sequenceLength;
+        const bool sample = (iteration++ & sampleMask) == 0;
+        std::chrono::steady_clock::time_point start;
+        if (sample) {
+            start = std::chrono::steady_clock::now();
+        }
+
+        auto& item = items[sequence[index]];
+        if (isRead[index]) {
+            benchmark::DoNotOptimize(ht->findForRead(item.getKey()));
+        } else {
+            benchmark::DoNotOptimize(ht->set(item));
+        }
+
+        if (sample) {
+            threadLatencies.push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+        }
+    }
+
+    if (state.thread_index == 0) {
+        stopBackgroundThread();
+    }
+    reportLatencies(state, threadLatencies);
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void ContentionArguments(benchmark::internal::Benchmark* b) {
+    const int uniform = 0;
+    const int zipf = 99;
+    // Lock counts: the default ht_locks (47), and fewer / more.
+    for (int locks : {5, 47, 1021}) {
+        for (int readPercent : {100, 90, 50}) {
+            for (int skew : {uniform, zipf}) {
+                b->Args({locks, readPercent, skew, int(Background::None)});
+            }
+        }
+    }
+    for (auto background :
+         {Background::Resize, Background::Pager, Background::Defragmenter}) {
+        b->Args({47, 90, zipf, int(background)});
+    }
+}
+
+BENCHMARK_REGISTER_F(HashTableContentionBench, Mixed)
+        ->Apply(ContentionArguments)
+        ->ThreadPerCpu()
+        ->UseRealTime();
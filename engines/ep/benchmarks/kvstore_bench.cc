@@ -17,23 +17,34 @@
 
 #include "callbacks.h"
 #include "collections/vbucket_manifest.h"
+#include "ep_types.h"
 #include "kvstore.h"
 #include "kvstore_config.h"
+#include "vbucket_bgfetch_item.h"
 #ifdef EP_USE_ROCKSDB
 #include "rocksdb-kvstore/rocksdb-kvstore_config.h"
 #endif
+#ifdef EP_USE_MAGMA
+#include "magma-kvstore/magma-kvstore_config.h"
+#endif
 #include "tests/module_tests/test_helpers.h"
 
 #include <benchmark/benchmark.h>
 #include <gtest/gtest.h>
 #include <platform/dirutils.h>
 
+#include <random>
+
 enum Storage {
     COUCHSTORE = 0
 #ifdef EP_USE_ROCKSDB
     ,
     ROCKSDB
 #endif
+#ifdef EP_USE_MAGMA
+    ,
+    MAGMA
+#endif
 };
 
 class MockWriteCallback : public Callback<TransactionContext, mutation_result> {
@@ -75,8 +86,20 @@ protected:
     size_t itemCount;
 };
 
+class MockRollbackCallback : public RollbackCB {
+public:
+    void callback(GetValue& val) override {
+    }
+
+    void rollbackKey(GetValue& postRbSeqno, GetValue& preRbSeqno) override {
+    }
+};
+
 /*
  * Benchmark fixture for KVStore.
+ *
+ * Arguments: the number of items to load, the Storage to use and (for some
+ * benchmarks) a third, benchmark specific, argument.
  */
 class KVStoreBench : public benchmark::Fixture {
 protected:
@@ -102,6 +125,14 @@ protected:
             kvstoreConfig =
                     std::make_unique<RocksDBKVStoreConfig>(config, shardId);
             break;
+#endif
+#ifdef EP_USE_MAGMA
+        case MAGMA:
+            state.SetLabel("Magma");
+            config.setBackend("magma");
+            kvstoreConfig =
+                    std::make_unique<MagmaKVStoreConfig>(config, shardId);
+            break;
 #endif
         }
 
@@ -109,26 +140,8 @@ protected:
         kvstore = setup_kv_store(*kvstoreConfig);
 
         // Load some data
-        const std::string key = "key";
-        std::string value = "value";
-        MockWriteCallback wc;
-        Vbid vbid = Vbid(0);
-        kvstore->begin(std::make_unique<TransactionContext>());
-        for (int i = 1; i <= numItems; i++) {
-            Item item(makeStoredDocKey(key + std::to_string(i)),
-                      0 /*flags*/,
-                      0 /*exptime*/,
-                      value.c_str(),
-                      value.size(),
-                      PROTOCOL_BINARY_RAW_BYTES,
-                      0 /*cas*/,
-                      i /*bySeqno*/,
-                      vbid);
-            kvstore->set(item, wc);
-        }
-        Collections::VB::Manifest m({});
-        Collections::VB::Flush f(m);
-        kvstore->commit(f);
+        nextSeqno = 1;
+        writeItems(numItems);
         // Just check that the VBucket High Seqno has been updated correctly
         EXPECT_EQ(kvstore->getVBucketState(vbid)->highSeqno, numItems);
     }
@@ -159,10 +172,46 @@ private:
     }
 
 protected:
+    /// @returns the key of the given (1-based) item.
+    StoredDocKey makeKey(int i) const {
+        return makeStoredDocKey("key" + std::to_string(i));
+    }
+
+    /**
+     * Write count items in a single commit, at the next seqnos. The items
+     * cycle through the keys of the loaded items, so once loaded every
+     * write is an update.
+     */
+    void writeItems(int count) {
+        const std::string value(valueSize, 'x');
+        MockWriteCallback wc;
+        kvstore->begin(std::make_unique<TransactionContext>());
+        for (int i = 0; i < count; i++, nextSeqno++) {
+            Item item(makeKey(int((nextSeqno - 1) % numItems) + 1),
+                      0 /*flags*/,
+                      0 /*exptime*/,
+                      value.c_str(),
+                      value.size(),
+                      PROTOCOL_BINARY_RAW_BYTES,
+                      0 /*cas*/,
+                      nextSeqno /*bySeqno*/,
+                      vbid);
+            kvstore->set(item, wc);
+        }
+        Collections::VB::Manifest m({});
+        Collections::VB::Flush f(m);
+        ASSERT_TRUE(kvstore->commit(f));
+    }
+
+    /// Size of the value of every item written.
+    static const size_t valueSize = 256;
+
     std::unique_ptr<KVStoreConfig> kvstoreConfig;
     std::unique_ptr<KVStore> kvstore;
     Vbid vbid = Vbid(0);
     int numItems;
+    /// Seqno of the next item written.
+    int64_t nextSeqno;
 };
 
 /*
@@ -195,13 +244,137 @@ BENCHMARK_DEFINE_F(KVStoreBench, Scan)(benchmark::State& state) {
     }
 
     state.SetItemsProcessed(itemCountTotal);
+    state.SetBytesProcessed(itemCountTotal * valueSize);
+}
+
+/*
+ * Benchmark for KVStore::commit() of batches of updates; the third argument
+ * is the number of items per commit.
+ */
+BENCHMARK_DEFINE_F(KVStoreBench, Commit)(benchmark::State& state) {
+    const int batchSize = state.range(2);
+    while (state.KeepRunning()) {
+        writeItems(batchSize);
+    }
+
+    state.SetItemsProcessed(state.iterations() * batchSize);
+    state.SetBytesProcessed(state.iterations() * batchSize * valueSize);
+}
+
+/*
+ * Benchmark for KVStore::getMulti() of batches of random keys (as the
+ * BGFetcher does - every fetch misses the HashTable by definition); the
+ * third argument is the number of keys per getMulti.
+ */
+BENCHMARK_DEFINE_F(KVStoreBench, GetMulti)(benchmark::State& state) {
+    const int batchSize = state.range(2);
+    std::mt19937 gen(numItems);
+    std::uniform_int_distribution<int> dist(1, numItems);
+
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        vb_bgfetch_queue_t itms;
+        while (itms.size() < size_t(batchSize)) {
+            vb_bgfetch_item_ctx_t ctx;
+            ctx.isMetaOnly = GetMetaOnly::No;
+            itms[makeKey(dist(gen))] = std::move(ctx);
+        }
+        state.ResumeTiming();
+
+        kvstore->getMulti(vbid, itms);
+
+        state.PauseTiming();
+        for (auto& fetched : itms) {
+            ASSERT_EQ(ENGINE_SUCCESS, fetched.second.value.getStatus());
+        }
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * batchSize);
+    state.SetBytesProcessed(state.iterations() * batchSize * valueSize);
+}
+
+/*
+ * Benchmark for KVStore::compactDB() of the loaded vBucket. Bytes processed
+ * are of the file before compaction.
+ */
+BENCHMARK_DEFINE_F(KVStoreBench, Compaction)(benchmark::State& state) {
+    size_t bytes = 0;
+    while (state.KeepRunning()) {
+        CompactionConfig config;
+        config.db_file_id = vbid;
+        compaction_ctx cctx(config, 0);
+        ASSERT_TRUE(kvstore->compactDB(&cctx));
+        bytes += cctx.stats.pre.size;
+    }
+
+    state.SetItemsProcessed(state.iterations() * numItems);
+    state.SetBytesProcessed(bytes);
+}
+
+/*
+ * Benchmark for KVStore::rollback() of a commit of updates to a tenth of the
+ * loaded items.
+ */
+BENCHMARK_DEFINE_F(KVStoreBench, Rollback)(benchmark::State& state) {
+    const int rollbackItems = numItems / 10;
+    const int64_t rollbackSeqno = nextSeqno - 1;
+    auto cb = std::make_shared<MockRollbackCallback>();
+
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        nextSeqno = rollbackSeqno + 1;
+        writeItems(rollbackItems);
+        state.ResumeTiming();
+
+        auto result = kvstore->rollback(vbid, rollbackSeqno, cb);
+        ASSERT_TRUE(result.success);
+    }
+
+    state.SetItemsProcessed(state.iterations() * rollbackItems);
+    state.SetBytesProcessed(state.iterations() * rollbackItems * valueSize);
 }
 
 const int NUM_ITEMS = 100000;
 
-BENCHMARK_REGISTER_F(KVStoreBench, Scan)
-        ->Args({NUM_ITEMS, COUCHSTORE})
+/// Register the benchmark for every backend, with the given extra arguments.
+static void AllBackends(benchmark::internal::Benchmark* b,
+                        const std::vector<int64_t>& args) {
+    std::vector<int64_t> storages{COUCHSTORE};
 #ifdef EP_USE_ROCKSDB
-        ->Args({NUM_ITEMS, ROCKSDB})
+    storages.push_back(ROCKSDB);
 #endif
-        ;
+#ifdef EP_USE_MAGMA
+    storages.push_back(MAGMA);
+#endif
+    for (auto storage : storages) {
+        std::vector<int64_t> backendArgs{NUM_ITEMS, storage};
+        backendArgs.insert(backendArgs.end(), args.begin(), args.end());
+        b->Args(backendArgs);
+    }
+}
+
+static void ScanArgs(benchmark::internal::Benchmark* b) {
+    AllBackends(b, {});
+}
+
+static void CommitArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t batch : {1, 100, 10000}) {
+        AllBackends(b, {batch});
+    }
+}
+
+static void GetMultiArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t batch : {1, 16, 256}) {
+        AllBackends(b, {batch});
+    }
+}
+
+BENCHMARK_REGISTER_F(KVStoreBench, Scan)->Apply(ScanArgs);
+BENCHMARK_REGISTER_F(KVStoreBench, Commit)->Apply(CommitArgs);
+BENCHMARK_REGISTER_F(KVStoreBench, GetMulti)->Apply(GetMultiArgs);
+
+// RocksDB and Magma compact in the background, and don't support rollback.
+BENCHMARK_REGISTER_F(KVStoreBench, Compaction)->Args({NUM_ITEMS, COUCHSTORE});
+
+BENCHMARK_REGISTER_F(KVStoreBench, Rollback)->Args({NUM_ITEMS, COUCHSTORE});
@@ -0,0 +1,372 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the memory used per item by each of the structures an item
+ * is held in. These report counters (bytes per item) rather than time; the
+ * values are deterministic for a given build and allocator, so changes to
+ * them between releases are changes in metadata overhead.
+ */
+
+#include "benchmark_memory_tracker.h"
+#include "checkpoint_manager.h"
+#include "dcp/response.h"
+#include "engine_fixture.h"
+#include "hash_table.h"
+#include "item.h"
+#include "module_tests/test_helpers.h"
+#include "stats.h"
+#include "stored_value_factories.h"
+#include "vbucket.h"
+
+#include <mock/mock_synchronous_ep_engine.h>
+#include <programs/engine_testapp/mock_server.h>
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <sstream>
+
+enum class Factory { Persistent, Ephemeral };
+
+static std::string to_string(Factory factory) {
+    switch (factory) {
+    case Factory::Persistent:
+        return "StoredValue";
+    case Factory::Ephemeral:
+        return "OrderedStoredValue";
+    }
+    throw std::invalid_argument("to_string(Factory): invalid enumeration " +
+                                std::to_string(int(factory)));
+}
+
+/// The number of items each benchmark measures the memory of.
+static const size_t numItems = 10000;
+
+static std::string makeKey(size_t keySize, size_t index) {
+    auto key = std::to_string(index);
+    if (key.size() < keySize) {
+        key.insert(0, keySize - key.size(), 'k');
+    }
+    return key;
+}
+
+class MemoryFootprintBench : public benchmark::Fixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        memoryTracker = BenchmarkMemoryTracker::getInstance(
+                *get_mock_server_api()->alloc_hooks);
+        memoryTracker->reset();
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        memoryTracker->destroyInstance();
+    }
+
+    BenchmarkMemoryTracker* memoryTracker;
+};
+
+/*
+ * The memory used by a HashTable for each item; split into the hash bucket
+ * array (sized as the ItemPager / resizer would size it for the items), the
+ * StoredValue (including its key) and the value Blob.
+ *
+ * Arguments:
+ *  - range(0) : StoredValueFactory type (Factory)
+ *  - range(1) : Key size
+ *  - range(2) : Value size
+ */
+BENCHMARK_DEFINE_F(MemoryFootprintBench, HashTable)(benchmark::State& state) {
+    const auto factory = Factory(state.range(0));
+    const size_t keySize = state.range(1);
+    const std::string value(state.range(2), 'x');
+
+    size_t bucketBytes = 0;
+    size_t storedValueBytes = 0;
+    size_t totalBytes = 0;
+    while (state.KeepRunning()) {
+        EPStats stats;
+        std::unique_ptr<AbstractStoredValueFactory> svFactory;
+        if (factory == Factory::Persistent) {
+            svFactory = std::make_unique<StoredValueFactory>(stats);
+        } else {
+            svFactory = std::make_unique<OrderedStoredValueFactory>(stats);
+        }
+        const auto base = memoryTracker->getCurrentAlloc();
+        HashTable ht(stats, std::move(svFactory), 3, 47);
+        ht.resize(numItems);
+        bucketBytes = memoryTracker->getCurrentAlloc() - base;
+
+        for (size_t ii = 0; ii < numItems; ++ii) {
+            // The Item is destroyed after each set, leaving only what the
+            // HashTable holds (its Blob is shared with the StoredValue).
+            Item item(makeStoredDocKey(makeKey(keySize, ii)),
+                      0,
+                      0,
+                      value.data(),
+                      value.size());
+            ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+        }
+        storedValueBytes = ht.getMetadataMemory();
+        totalBytes = memoryTracker->getCurrentAlloc() - base;
+    }
+
+    state.SetLabel(to_string(factory).c_str());
+    state.counters["HashBucketBytesPerItem"] = double(bucketBytes) / numItems;
+    state.counters["StoredValueBytesPerItem"] =
+            double(storedValueBytes) / numItems;
+    state.counters["BlobBytesPerItem"] =
+            double(totalBytes - bucketBytes - storedValueBytes) / numItems;
+    state.counters["TotalBytesPerItem"] = double(totalBytes) / numItems;
+}
+
+static void HashTableArguments(benchmark::internal::Benchmark* b) {
+    for (auto factory : {Factory::Persistent, Factory::Ephemeral}) {
+        for (int keySize : {10, 32, 100, 250}) {
+            for (int valueSize : {0, 32, 256, 4096}) {
+                b->Args({int(factory), keySize, valueSize});
+            }
+        }
+    }
+}
+
+BENCHMARK_REGISTER_F(MemoryFootprintBench, HashTable)
+        ->Apply(HashTableArguments)
+        ->Iterations(1);
+
+/*
+ * The memory used by the CheckpointManager for each queued item, excluding
+ * the Item itself (which is measured separately as ItemBytesPerItem; in the
+ * front-end path its value Blob is shared with the HashTable).
+ *
+ * Arguments:
+ *  - range(0) : Key size
+ *  - range(1) : Value size
+ */
+class CheckpointFootprintBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        memoryTracker = BenchmarkMemoryTracker::getInstance(
+                *get_mock_server_api()->alloc_hooks);
+        memoryTracker->reset();
+        // Keep all of the items in a single open checkpoint.
+        varConfig = "chk_max_items=" + std::to_string(numItems * 2);
+        EngineFixture::SetUp(state);
+        engine->getKVBucket()->setVBucketState(
+                vbid, vbucket_state_active, false);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        EngineFixture::TearDown(state);
+        memoryTracker->destroyInstance();
+    }
+
+    std::vector<queued_item> createItems(size_t keySize,
+                                         const std::string& value) {
+        std::vector<queued_item> items;
+        items.reserve(numItems);
+        for (size_t ii = 0; ii < numItems; ++ii) {
+            items.emplace_back(new Item(makeStoredDocKey(makeKey(keySize, ii)),
+                                        0,
+                                        0,
+                                        value.data(),
+                                        value.size()));
+            items.back()->setVBucketId(vbid);
+        }
+        return items;
+    }
+
+    BenchmarkMemoryTracker* memoryTracker;
+};
+
+BENCHMARK_DEFINE_F(CheckpointFootprintBench, QueueDirty)
+(benchmark::State& state) {
+    const size_t keySize = state.range(0);
+    const std::string value(state.range(1), 'x');
+    auto vb = engine->getKVBucket()->getVBucket(vbid);
+    auto& ckptMgr = *vb->checkpointManager;
+
+    size_t itemBytes = 0;
+    size_t checkpointBytes = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        ckptMgr.clear(*vb, 0);
+        auto base = memoryTracker->getCurrentAlloc();
+        auto items = createItems(keySize, value);
+        itemBytes = memoryTracker->getCurrentAlloc() - base;
+        state.ResumeTiming();
+
+        base = memoryTracker->getCurrentAlloc();
+        for (auto& qi : items) {
+            ckptMgr.queueDirty(*vb,
+                               qi,
+                               GenerateBySeqno::Yes,
+                               GenerateCas::Yes,
+                               /*preLinkDocCtx*/ nullptr);
+        }
+        checkpointBytes = memoryTracker->getCurrentAlloc() - base;
+    }
+
+    state.counters["ItemBytesPerItem"] = double(itemBytes) / numItems;
+    state.counters["CheckpointBytesPerItem"] =
+            double(checkpointBytes) / numItems;
+}
+
+static void KeyValueArguments(benchmark::internal::Benchmark* b) {
+    for (int keySize : {10, 32, 100, 250}) {
+        for (int valueSize : {0, 32, 256, 4096}) {
+            b->Args({keySize, valueSize});
+        }
+    }
+}
+
+BENCHMARK_REGISTER_F(CheckpointFootprintBench, QueueDirty)
+        ->Apply(KeyValueArguments)
+        ->Iterations(1);
+
+/*
+ * The memory used by a DCP stream for each item buffered in its readyQ,
+ * excluding the (shared) Item.
+ *
+ * Arguments:
+ *  - range(0) : Key size
+ *  - range(1) : Value size
+ */
+BENCHMARK_DEFINE_F(MemoryFootprintBench, DcpReadyQueue)
+(benchmark::State& state) {
+    const size_t keySize = state.range(0);
+    const std::string value(state.range(1), 'x');
+
+    std::vector<queued_item> items;
+    items.reserve(numItems);
+    for (size_t ii = 0; ii < numItems; ++ii) {
+        items.emplace_back(new Item(makeStoredDocKey(makeKey(keySize, ii)),
+                                    0,
+                                    0,
+                                    value.data(),
+                                    value.size()));
+    }
+
+    size_t bufferBytes = 0;
+    while (state.KeepRunning()) {
+        const auto base = memoryTracker->getCurrentAlloc();
+        std::deque<std::unique_ptr<DcpResponse>> readyQ;
+        for (auto& qi : items) {
+            readyQ.push_back(std::make_unique<MutationResponse>(
+                    qi,
+                    /*opaque*/ 0,
+                    IncludeValue::Yes,
+                    IncludeXattrs::Yes,
+                    IncludeDeleteTime::No,
+                    DocKeyEncodesCollectionId::No,
+                    EnableExpiryOutput::No,
+                    cb::mcbp::DcpStreamId{}));
+        }
+        bufferBytes = memoryTracker->getCurrentAlloc() - base;
+    }
+
+    state.counters["DcpBufferBytesPerItem"] = double(bufferBytes) / numItems;
+}
+
+BENCHMARK_REGISTER_F(MemoryFootprintBench, DcpReadyQueue)
+        ->Apply(KeyValueArguments)
+        ->Iterations(1);
+
+/*
+ * The memory used for each collection in each vBucket - the
+ * Collections::VB::ManifestEntry with its counters, and the system event
+ * queued for the collection's creation.
+ *
+ * Arguments:
+ *  - range(0) : The number of collections (in addition to the default)
+ *  - range(1) : The number of vBuckets
+ */
+class CollectionsFootprintBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        memoryTracker = BenchmarkMemoryTracker::getInstance(
+                *get_mock_server_api()->alloc_hooks);
+        memoryTracker->reset();
+        EngineFixture::SetUp(state);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        EngineFixture::TearDown(state);
+        memoryTracker->destroyInstance();
+    }
+
+    /// @return a manifest (with the given uid) of the default collection and
+    ///         the given number of collections.
+    static std::string makeManifest(size_t uid, size_t collections) {
+        std::stringstream ss;
+        ss << std::hex << R"({"uid":")" << uid
+           << R"(","scopes":[{"name":"_default","uid":"0","collections":[)"
+           << R"({"name":"_default","uid":"0"})";
+        for (size_t ii = 0; ii < collections; ++ii) {
+            // The first uid available to user collections is 8.
+            const auto cid = 8 + ii;
+            ss << R"(,{"name":"c)" << cid << R"(","uid":")" << cid << R"("})";
+        }
+        ss << "]}]}";
+        return ss.str();
+    }
+
+    BenchmarkMemoryTracker* memoryTracker;
+};
+
+BENCHMARK_DEFINE_F(CollectionsFootprintBench, SetCollections)
+(benchmark::State& state) {
+    const size_t collections = state.range(0);
+    const size_t numVBuckets = state.range(1);
+    auto* store = engine->getKVBucket();
+    for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+        store->setVBucketState(Vbid(vb), vbucket_state_active, false);
+    }
+
+    size_t manifestUid = 0;
+    size_t collectionBytes = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        // Return to the default collection only.
+        ASSERT_EQ(cb::engine_errc::success,
+                  store->setCollections(makeManifest(++manifestUid, 0)).code());
+        for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+            store->getVBucket(Vbid(vb))->checkpointManager->clear(
+                    *store->getVBucket(Vbid(vb)), 0);
+        }
+        const auto manifest = makeManifest(++manifestUid, collections);
+        const auto base = memoryTracker->getCurrentAlloc();
+        state.ResumeTiming();
+
+        ASSERT_EQ(cb::engine_errc::success,
+                  store->setCollections(manifest).code());
+
+        state.PauseTiming();
+        collectionBytes = memoryTracker->getCurrentAlloc() - base;
+        state.ResumeTiming();
+    }
+
+    state.counters["BytesPerCollectionPerVBucket"] =
+            double(collectionBytes) / (collections * numVBuckets);
+}
+
+BENCHMARK_REGISTER_F(CollectionsFootprintBench, SetCollections)
+        ->Args({10, 1})
+        ->Args({10, 64})
+        ->Args({100, 64})
+        ->Args({1000, 64})
+        ->Iterations(1);
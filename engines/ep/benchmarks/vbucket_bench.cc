@@ -33,6 +33,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <limits>
 #include <thread>
 
 enum class Store { Couchstore = 0, RocksDB = 1 };
@@ -140,6 +141,84 @@ protected:
     }
 };
 
+/*
+ * Fixture for benchmarks of the CheckpointManager's cursor operations.
+ * Checkpoints hold up to 1000 items, and are only removed when a benchmark
+ * asks for it.
+ */
+class CheckpointCursorBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        varConfig =
+                "max_size=1000000000;max_checkpoints=100000000;"
+                "chk_max_items=1000";
+
+        EngineFixture::SetUp(state);
+        if (state.thread_index == 0) {
+            engine->getKVBucket()->setVBucketState(
+                    Vbid(0), vbucket_state_active, false);
+            vb = engine->getKVBucket()->getVBucket(vbid).get();
+            ckptMgr = vb->checkpointManager.get();
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        if (state.thread_index == 0) {
+            engine->getKVBucket()->deleteVBucket(vbid, nullptr);
+        }
+        EngineFixture::TearDown(state);
+    }
+
+    /// Queue the given number of mutations, of distinct keys.
+    void queueItems(size_t count, const std::string& prefix = "key") {
+        for (size_t i = 0; i < count; ++i) {
+            queued_item qi{new Item(
+                    StoredDocKey(prefix + std::to_string(i),
+                                 CollectionID::Default),
+                    vbid,
+                    queue_op::mutation,
+                    /*revSeq*/ 0,
+                    /*bySeq*/ 0)};
+            ckptMgr->queueDirty(*vb,
+                                qi,
+                                GenerateBySeqno::Yes,
+                                GenerateCas::Yes,
+                                /*preLinkDocCtx*/ nullptr);
+        }
+    }
+
+    /// Register the given number of DCP cursors, from the start.
+    std::vector<Cursor> registerCursors(size_t count) {
+        std::vector<Cursor> cursors;
+        for (size_t i = 0; i < count; ++i) {
+            cursors.push_back(
+                    ckptMgr->registerCursorBySeqno(
+                                   "cursor" + std::to_string(i), 0)
+                            .cursor);
+        }
+        return cursors;
+    }
+
+    /// Simulate the Flusher, moving the persistence cursor past every item.
+    void persistAllItems() {
+        std::vector<queued_item> items;
+        ckptMgr->getAllItemsForPersistence(items);
+        ckptMgr->itemsPersisted();
+    }
+
+    /// Remove the given cursors and every item queued.
+    void reset(std::vector<Cursor>& cursors) {
+        for (auto& cursor : cursors) {
+            ckptMgr->removeCursor(cursor.lock().get());
+        }
+        cursors.clear();
+        ckptMgr->clear(*vb, 0);
+    }
+
+    VBucket* vb;
+    CheckpointManager* ckptMgr;
+};
+
 /**
  * Benchmark queueing items into a vBucket.
  * Items have a 10% chance of being a duplicate key of a previous item (to
@@ -386,6 +465,208 @@ BENCHMARK_DEFINE_F(CheckpointBench, QueueDirtyWithManyClosedUnrefCheckpoints)
     bgThread.join();
 }
 
+/*
+ * Benchmark reading every item queued with CM::getItemsForCursor, for a
+ * number of cursors (as one per DCP stream).
+ */
+BENCHMARK_DEFINE_F(CheckpointCursorBench, GetItemsForCursor)
+(benchmark::State& state) {
+    const size_t numCursors = state.range(0);
+    const size_t itemCount = state.range(1);
+
+    size_t itemsRead = 0;
+    std::vector<queued_item> items;
+    items.reserve(itemCount * 2);
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        queueItems(itemCount);
+        auto cursors = registerCursors(numCursors);
+        state.ResumeTiming();
+
+        for (auto& cursor : cursors) {
+            items.clear();
+            ckptMgr->getItemsForCursor(cursor.lock().get(),
+                                       items,
+                                       std::numeric_limits<size_t>::max());
+            itemsRead += items.size();
+        }
+
+        state.PauseTiming();
+        reset(cursors);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(itemsRead);
+}
+
+/*
+ * Benchmark registering (and removing) a cursor at a seqno in the middle of
+ * the given number of items.
+ */
+BENCHMARK_DEFINE_F(CheckpointCursorBench, RegisterCursorBySeqno)
+(benchmark::State& state) {
+    const size_t itemCount = state.range(0);
+    queueItems(itemCount);
+
+    while (state.KeepRunning()) {
+        auto result = ckptMgr->registerCursorBySeqno("cursor", itemCount / 2);
+        ckptMgr->removeCursor(result.cursor.lock().get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Benchmark dropping the given number of cursors which are all in closed
+ * checkpoints, as the CursorDropper does under memory pressure.
+ */
+BENCHMARK_DEFINE_F(CheckpointCursorBench, DropCursors)
+(benchmark::State& state) {
+    const size_t numCursors = state.range(0);
+
+    size_t cursorsDropped = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        // Two checkpoints, with the cursors in the closed one and the
+        // persistence cursor in the open one.
+        queueItems(1000);
+        auto cursors = registerCursors(numCursors);
+        ckptMgr->createNewCheckpoint();
+        persistAllItems();
+        state.ResumeTiming();
+
+        for (const auto& cursor : ckptMgr->getListOfCursorsToDrop()) {
+            if (ckptMgr->removeCursor(cursor.lock().get())) {
+                ++cursorsDropped;
+            }
+        }
+
+        state.PauseTiming();
+        reset(cursors);
+        state.ResumeTiming();
+    }
+    ASSERT_EQ(numCursors * state.iterations(), cursorsDropped);
+    state.SetItemsProcessed(cursorsDropped);
+}
+
+/*
+ * Benchmark expelling the given number of items from the open checkpoint,
+ * once a DCP cursor and the persistence cursor have both read them. Only
+ * items of the oldest checkpoint are expelled, so the counts are limited to
+ * chk_max_items.
+ */
+BENCHMARK_DEFINE_F(CheckpointCursorBench, ExpelItems)
+(benchmark::State& state) {
+    const size_t itemCount = state.range(0);
+
+    size_t itemsExpelled = 0;
+    std::vector<queued_item> items;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        queueItems(itemCount);
+        auto cursors = registerCursors(1);
+        items.clear();
+        ckptMgr->getAllItemsForCursor(cursors.front().lock().get(), items);
+        persistAllItems();
+        state.ResumeTiming();
+
+        itemsExpelled += ckptMgr->expelUnreferencedCheckpointItems();
+
+        state.PauseTiming();
+        reset(cursors);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(itemsExpelled);
+}
+
+/*
+ * Benchmark removing the given number of closed, unreferenced checkpoints
+ * (each of 1000 items).
+ */
+BENCHMARK_DEFINE_F(CheckpointCursorBench, RemoveClosedUnrefCheckpoints)
+(benchmark::State& state) {
+    const size_t numCheckpoints = state.range(0);
+
+    size_t itemsRemoved = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        queueItems(numCheckpoints * 1000);
+        ckptMgr->createNewCheckpoint();
+        persistAllItems();
+        state.ResumeTiming();
+
+        bool newOpenCheckpointCreated;
+        itemsRemoved += ckptMgr->removeClosedUnrefCheckpoints(
+                *vb, newOpenCheckpointCreated);
+
+        state.PauseTiming();
+        ckptMgr->clear(*vb, 0);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(itemsRemoved);
+}
+
+/*
+ * Benchmark a DCP cursor reading with CM::getItemsForCursor while front-end
+ * threads queue mutations, other DCP cursors read, and a background thread
+ * persists items and removes closed checkpoints (as the Flusher and the
+ * ClosedUnrefCheckpointRemoverTask would).
+ */
+BENCHMARK_DEFINE_F(CheckpointCursorBench, GetItemsForCursorConcurrent)
+(benchmark::State& state) {
+    const size_t numWriters = state.range(0);
+    const size_t numCursors = state.range(1);
+
+    auto cursors = registerCursors(numCursors);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < numWriters; ++i) {
+        threads.emplace_back([this, i, &done]() {
+            // Writers cycle through their own set of 1000 keys.
+            const auto prefix = "writer" + std::to_string(i) + "_key";
+            while (!done) {
+                queueItems(1000, prefix);
+            }
+        });
+    }
+    // The first cursor is read by the benchmark thread, the others by
+    // background DCP readers.
+    for (size_t i = 1; i < numCursors; ++i) {
+        threads.emplace_back([this, &cursors, i, &done]() {
+            std::vector<queued_item> items;
+            while (!done) {
+                items.clear();
+                ckptMgr->getItemsForCursor(
+                        cursors[i].lock().get(), items, 1000);
+            }
+        });
+    }
+    threads.emplace_back([this, &done]() {
+        std::vector<queued_item> items;
+        bool newOpenCheckpointCreated;
+        while (!done) {
+            items.clear();
+            ckptMgr->getItemsForPersistence(items, 1000);
+            ckptMgr->itemsPersisted();
+            ckptMgr->removeClosedUnrefCheckpoints(*vb,
+                                                  newOpenCheckpointCreated);
+        }
+    });
+
+    size_t itemsRead = 0;
+    std::vector<queued_item> items;
+    while (state.KeepRunning()) {
+        items.clear();
+        ckptMgr->getItemsForCursor(cursors.front().lock().get(), items, 1000);
+        itemsRead += items.size();
+    }
+
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    state.SetItemsProcessed(itemsRead);
+    reset(cursors);
+}
+
 // Run with item counts from 1..10,000,000.
 BENCHMARK_REGISTER_F(MemTrackingVBucketBench, QueueDirty)
         ->Args({1})
@@ -407,3 +688,30 @@ BENCHMARK_REGISTER_F(MemTrackingVBucketBench, FlushVBucket)
 BENCHMARK_REGISTER_F(CheckpointBench, QueueDirtyWithManyClosedUnrefCheckpoints)
         ->Args({1000000, 1000})
         ->Iterations(1);
+
+// Cursors: 1..100, items: 1000..100,000
+BENCHMARK_REGISTER_F(CheckpointCursorBench, GetItemsForCursor)
+        ->Args({1, 1000})
+        ->Args({1, 100000})
+        ->Args({10, 1000})
+        ->Args({10, 100000})
+        ->Args({100, 1000});
+
+BENCHMARK_REGISTER_F(CheckpointCursorBench, RegisterCursorBySeqno)
+        ->Arg(1000)
+        ->Arg(100000);
+
+BENCHMARK_REGISTER_F(CheckpointCursorBench, DropCursors)->Arg(1)->Arg(100);
+
+BENCHMARK_REGISTER_F(CheckpointCursorBench, ExpelItems)->Arg(10)->Arg(1000);
+
+BENCHMARK_REGISTER_F(CheckpointCursorBench, RemoveClosedUnrefCheckpoints)
+        ->Arg(1)
+        ->Arg(100);
+
+// Front-end writers: 0..4, DCP cursors: 1..8
+BENCHMARK_REGISTER_F(CheckpointCursorBench, GetItemsForCursorConcurrent)
+        ->Args({0, 1})
+        ->Args({1, 1})
+        ->Args({4, 1})
+        ->Args({4, 8});
@@ -0,0 +1,260 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of Warmup - the time taken for a bucket to load its data from
+ * disk and become ready.
+ */
+
+#include "access_scanner.h"
+#include "benchmark_memory_tracker.h"
+#include "engine_fixture.h"
+#include "ep_bucket.h"
+#include "fakes/fake_executorpool.h"
+#include "warmup.h"
+
+#include <mock/mock_synchronous_ep_engine.h>
+#include <programs/engine_testapp/mock_server.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+enum class Backend {
+    Couchstore = 0,
+#ifdef EP_USE_ROCKSDB
+    RocksDB = 1,
+#endif
+#ifdef EP_USE_MAGMA
+    Magma = 2,
+#endif
+};
+
+static std::string to_string(Backend backend) {
+    switch (backend) {
+    case Backend::Couchstore:
+        return "couchdb";
+#ifdef EP_USE_ROCKSDB
+    case Backend::RocksDB:
+        return "rocksdb";
+#endif
+#ifdef EP_USE_MAGMA
+    case Backend::Magma:
+        return "magma";
+#endif
+    }
+    throw std::invalid_argument("to_string(Backend): invalid enumeration " +
+                                std::to_string(int(backend)));
+}
+
+/*
+ * Fixture which generates a dataset on disk, which each iteration then
+ * warms up from.
+ *
+ * Arguments:
+ *  - range(0) : Backend
+ *  - range(1) : The number of items, across all vBuckets
+ *  - range(2) : The size of each value
+ *  - range(3) : The number of (active) vBuckets
+ *  - range(4) : Whether to generate an access log (0: no, 1: yes)
+ */
+class WarmupBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        memoryTracker = BenchmarkMemoryTracker::getInstance(
+                *get_mock_server_api()->alloc_hooks);
+        memoryTracker->reset();
+
+        backend = Backend(state.range(0));
+        numVBuckets = state.range(3);
+        varConfig = "backend=" + to_string(backend) +
+                    ";max_size=2000000000;max_vbuckets=" +
+                    std::to_string(numVBuckets) +
+                    // Always generate the access log when asked to.
+                    ";alog_resident_ratio_threshold=100" +
+                    ";alog_path=benchmarks-test/access.log";
+        EngineFixture::SetUp(state);
+
+        createDataset(state.range(1), state.range(2), state.range(4) != 0);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        EngineFixture::TearDown(state);
+        memoryTracker->destroyInstance();
+    }
+
+    void createDataset(size_t items, size_t valueSize, bool accessLog) {
+        auto* store = engine->getKVBucket();
+        for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+            store->setVBucketState(Vbid(vb), vbucket_state_active, false);
+        }
+
+        const std::string value(valueSize, 'x');
+        for (size_t ii = 0; ii < items; ++ii) {
+            const Vbid vb(ii % numVBuckets);
+            auto item = make_item(vb, "key_" + std::to_string(ii), value);
+            ASSERT_EQ(ENGINE_SUCCESS, store->set(item, cookie));
+        }
+
+        auto& ep = dynamic_cast<EPBucket&>(*store);
+        for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+            bool moreAvailable;
+            do {
+                std::tie(moreAvailable, std::ignore) =
+                        ep.flushVBucket(Vbid(vb));
+            } while (moreAvailable);
+        }
+
+        if (accessLog) {
+            generateAccessLog();
+        }
+    }
+
+    /// Run the AccessScanner (and the visitor it creates for each shard)
+    /// to completion.
+    void generateAccessLog() {
+        ExTask task = std::make_shared<AccessScanner>(*engine->getKVBucket(),
+                                                      engine->getConfiguration(),
+                                                      engine->getEpStats(),
+                                                      1000);
+        ExecutorPool::get()->schedule(task);
+        executorPool->runNextTask(AUXIO_TASK_IDX, "Generating access log");
+
+        // Each run of a shard's visitor visits one of its vBuckets; then the
+        // only task left is the (snoozed) AccessScanner.
+        auto& queue = *executorPool->getLpTaskQ()[AUXIO_TASK_IDX];
+        for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+            CheckedExecutor executor(executorPool, queue);
+            executor.runCurrentTask();
+            executor.completeCurrentTask();
+        }
+        executorPool->cancel(task->getId());
+    }
+
+    /// Destroy the engine and create a new one (over the same data), which
+    /// will warm up.
+    void restartEngine() {
+        executorPool->cancelAndClearAll();
+        engine->getDcpConnMap().manageConnections();
+        engine.reset();
+
+        std::string config = "dbname=benchmarks-test;ht_locks=47;" +
+                             varConfig + ";warmup=true";
+        engine.reset(new SynchronousEPEngine(config));
+        ObjectRegistry::onSwitchThread(engine.get());
+        engine->setKVBucket(
+                engine->public_makeBucket(engine->getConfiguration()));
+        engine->public_initializeEngineCallbacks();
+    }
+
+    /**
+     * Warm up, running each reader task and adding the time taken to the
+     * warmup phase it started in.
+     */
+    void warmup(std::map<std::string, std::chrono::nanoseconds>& phases) {
+        auto* store = engine->getKVBucket();
+        store->initializeWarmupTask();
+        store->startWarmupTask();
+
+        auto& readerQueue = *executorPool->getLpTaskQ()[READER_TASK_IDX];
+        while (store->isWarmingUp()) {
+            const std::string phase =
+                    store->getWarmup()->getWarmupState().toString();
+            const auto start = std::chrono::steady_clock::now();
+            CheckedExecutor executor(executorPool, readerQueue);
+            executor.runCurrentTask();
+            executor.completeCurrentTask();
+            phases[phase] += std::chrono::steady_clock::now() - start;
+        }
+    }
+
+    size_t getNumItems() {
+        size_t items = 0;
+        for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+            items += engine->getKVBucket()->getVBucket(Vbid(vb))->getNumItems();
+        }
+        return items;
+    }
+
+    BenchmarkMemoryTracker* memoryTracker;
+    Backend backend;
+    uint16_t numVBuckets;
+};
+
+/*
+ * Benchmark the time to warm up. Reports the time spent in each phase (ms)
+ * and the peak memory allocated while warming up, as counters; and the
+ * items / bytes loaded per second.
+ */
+BENCHMARK_DEFINE_F(WarmupBench, Warmup)(benchmark::State& state) {
+    const size_t valueSize = state.range(2);
+    std::map<std::string, std::chrono::nanoseconds> phases;
+    size_t itemsLoaded = 0;
+    size_t peakBytes = 0;
+
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        restartEngine();
+        memoryTracker->reset();
+        const auto baseBytes = memoryTracker->getCurrentAlloc();
+        state.ResumeTiming();
+
+        warmup(phases);
+
+        state.PauseTiming();
+        peakBytes = std::max(peakBytes,
+                             memoryTracker->getMaxAlloc() - baseBytes);
+        itemsLoaded += getNumItems();
+        state.ResumeTiming();
+    }
+
+    for (const auto& phase : phases) {
+        state.counters[phase.first + " (ms)"] =
+                std::chrono::duration<double, std::milli>(phase.second)
+                        .count() /
+                state.iterations();
+    }
+    state.counters["PeakWarmupBytes"] = peakBytes;
+    state.SetItemsProcessed(itemsLoaded);
+    state.SetBytesProcessed(itemsLoaded * valueSize);
+    state.SetLabel(("backend:" + to_string(backend)).c_str());
+}
+
+static void WarmupArguments(benchmark::internal::Benchmark* b) {
+    std::vector<Backend> backends = {Backend::Couchstore};
+#ifdef EP_USE_ROCKSDB
+    backends.push_back(Backend::RocksDB);
+#endif
+#ifdef EP_USE_MAGMA
+    backends.push_back(Backend::Magma);
+#endif
+    for (auto backend : backends) {
+        // Items, value size, vBuckets, access log
+        b->Args({int(backend), 100000, 256, 4, 0});
+        b->Args({int(backend), 100000, 256, 64, 0});
+        b->Args({int(backend), 100000, 4096, 4, 0});
+        b->Args({int(backend), 1000000, 256, 16, 0});
+    }
+    // The access log is only used for value eviction with couchstore.
+    b->Args({int(Backend::Couchstore), 100000, 256, 4, 1});
+    b->Args({int(Backend::Couchstore), 1000000, 256, 16, 1});
+}
+
+BENCHMARK_REGISTER_F(WarmupBench, Warmup)
+        ->Apply(WarmupArguments)
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(3);
@@ -30,8 +30,10 @@
 #include "stats.h"
 #include "vb_count_visitor.h"
 
+#include <algorithm>
 #include <memory>
 #include <numeric>
+#include <unordered_map>
 
 class ItemAccessVisitor : public VBucketVisitor, public HashTableVisitor {
 public:
@@ -52,7 +54,8 @@ public:
           stateFinalizer(sfin),
           as(aS),
           items_scanned(0),
-          items_to_scan(items_to_scan) {
+          items_to_scan(items_to_scan),
+          incremental(conf.isAlogIncremental()) {
         name = conf.getAlogPath();
         std::stringstream s;
         s << shardID;
@@ -71,6 +74,18 @@ public:
                     "'{}'",
                     next);
         }
+
+        // The states only describe the current log until this run replaces
+        // it, so take them; they're put back once the new log is in place.
+        for (auto vbid : getVBucketFilter().getVBSet()) {
+            auto& state = as.residentStates.at(vbid.get());
+            previousStates.emplace(vbid, state);
+            state = AccessScanner::ResidentState();
+        }
+
+        if (log && incremental) {
+            openPreviousLog();
+        }
     }
 
     bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
@@ -88,6 +103,8 @@ public:
 
     void update() {
         if (log != nullptr) {
+            // Write the keys in the order warmup will fetch them.
+            std::sort(accessed.begin(), accessed.end());
             for (auto it = accessed.begin(); it != accessed.end(); ++it) {
                 log->newItem(currentBucket->getId(), *it);
             }
@@ -102,19 +119,33 @@ public:
         if (log == nullptr) {
             return;
         }
-        HashTable::Position ht_start;
         if (vBucketFilter(vb->getId())) {
-            while (ht_start != vb->ht.endPosition()) {
-                ht_start = vb->ht.pauseResumeVisit(*this, ht_start);
-                update();
-                log->commit1();
-                log->commit2();
-                items_scanned = 0;
+            AccessScanner::ResidentState state;
+            state.highSeqno = vb->getHighSeqno();
+            state.numEjects = vb->ht.getNumEjects();
+            state.numNonResident = vb->ht.getNumInMemoryNonResItems();
+            state.numItems = vb->ht.getNumItems();
+
+            auto previous = previousStates.find(vb->getId());
+            if (previousLog == nullptr || previous == previousStates.end() ||
+                previous->second != state || !copyFromPreviousLog(*vb)) {
+                HashTable::Position ht_start;
+                while (ht_start != vb->ht.endPosition()) {
+                    ht_start = vb->ht.pauseResumeVisit(*this, ht_start);
+                    update();
+                    log->commit1();
+                    log->commit2();
+                    items_scanned = 0;
+                }
             }
+            newStates.emplace_back(vb->getId(), state);
         }
     }
 
     void complete() override {
+        previousEnd.reset();
+        previousIt.reset();
+        previousLog.reset();
 
         if (log == nullptr) {
             updateStateFinalizer(false);
@@ -183,11 +214,91 @@ public:
                     "{} keys",
                     name,
                     static_cast<uint64_t>(num_items));
+            for (const auto& entry : newStates) {
+                as.residentStates.at(entry.first.get()) = entry.second;
+            }
             updateStateFinalizer(true);
         }
     }
 
 private:
+    /**
+     * Open the current access log for copying the keys of unchanged
+     * vBuckets from. The log is written in vbid order, as is the new log,
+     * so a single pass over it serves all the vBuckets.
+     */
+    void openPreviousLog() {
+        bool any = std::any_of(previousStates.begin(),
+                               previousStates.end(),
+                               [](const std::pair<const Vbid,
+                                                  AccessScanner::ResidentState>&
+                                          entry) {
+                                   return entry.second.highSeqno >= 0;
+                               });
+        if (!any) {
+            return;
+        }
+        try {
+            previousLog = std::make_unique<MutationLog>(name);
+            previousLog->open(true);
+            if (!previousLog->isOpen()) {
+                previousLog.reset();
+                return;
+            }
+            previousIt = std::make_unique<MutationLog::iterator>(
+                    previousLog->begin());
+            previousEnd = std::make_unique<MutationLog::iterator>(
+                    previousLog->end());
+        } catch (const MutationLog::ReadException& e) {
+            EP_LOG_WARN(
+                    "Failed to open access log '{}' for an incremental "
+                    "run, scanning all vBuckets: {}",
+                    name,
+                    e.what());
+            previousEnd.reset();
+            previousIt.reset();
+            previousLog.reset();
+        }
+    }
+
+    /**
+     * Copy the keys of the given (unchanged) vBucket from the previous log
+     * to the new one.
+     * @return false if the previous log couldn't be read, and the vBucket
+     *         must be scanned instead. Any keys already copied are
+     *         duplicates warmup discards.
+     */
+    bool copyFromPreviousLog(VBucket& vb) {
+        const auto vbid = vb.getId();
+        try {
+            for (; *previousIt != *previousEnd; ++(*previousIt)) {
+                auto entry = **previousIt;
+                if (entry->type() != MutationLogType::New ||
+                    entry->vbucket() < vbid) {
+                    continue;
+                }
+                if (entry->vbucket() > vbid) {
+                    break;
+                }
+                log->newItem(vbid, StoredDocKey(entry->key()));
+            }
+        } catch (const MutationLog::ReadException& e) {
+            EP_LOG_WARN(
+                    "Failed to read access log '{}' copying {}, scanning "
+                    "the remaining vBuckets: {}",
+                    name,
+                    vbid,
+                    e.what());
+            previousEnd.reset();
+            previousIt.reset();
+            previousLog.reset();
+            return false;
+        }
+        log->commit1();
+        log->commit2();
+        return true;
+    }
+
     /**
      * Finalizer method called at the end of completing a visit.
      * @param created_log: Did we successfully create a MutationLog object on
@@ -230,6 +341,17 @@ private:
     const uint64_t items_to_scan;
 
     VBucketPtr currentBucket;
+
+    // Copy the keys of unchanged vBuckets from the previous log
+    const bool incremental;
+    std::unique_ptr<MutationLog> previousLog;
+    std::unique_ptr<MutationLog::iterator> previousIt;
+    std::unique_ptr<MutationLog::iterator> previousEnd;
+
+    // The states of the shard's vBuckets as of the previous log
+    std::unordered_map<Vbid, AccessScanner::ResidentState> previousStates;
+    // The states of the vBuckets written to the new log
+    std::vector<std::pair<Vbid, AccessScanner::ResidentState>> newStates;
 };
 
 AccessScanner::AccessScanner(KVBucket& _store,
@@ -248,6 +370,7 @@ AccessScanner::AccessScanner(KVBucket& _store,
       stats(st),
       sleepTime(sleeptime),
       available(true) {
+    residentStates.resize(_store.getVBuckets().getSize());
     residentRatioThreshold = conf.getAlogResidentRatioThreshold();
     alogPath = conf.getAlogPath();
     maxStoredItems = conf.getAlogMaxStoredItems();
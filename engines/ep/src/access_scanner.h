@@ -21,6 +21,7 @@
 #include "globaltask.h"
 
 #include <string>
+#include <vector>
 
 // Forward declaration.
 class Configuration;
@@ -44,6 +45,38 @@ public:
 
     std::atomic<size_t> completedCount;
 
+    /**
+     * What a vBucket looked like when its keys were written to the current
+     * access log. While a vBucket is unchanged (no mutations, ejections or
+     * background fetches) its resident set is the same, so an incremental
+     * run copies its keys from the previous log instead of scanning it.
+     */
+    struct ResidentState {
+        bool operator==(const ResidentState& other) const {
+            return highSeqno == other.highSeqno &&
+                   numEjects == other.numEjects &&
+                   numNonResident == other.numNonResident &&
+                   numItems == other.numItems;
+        }
+
+        bool operator!=(const ResidentState& other) const {
+            return !(*this == other);
+        }
+
+        /// -1 if the vBucket isn't in the current access log.
+        int64_t highSeqno = -1;
+        size_t numEjects = 0;
+        size_t numNonResident = 0;
+        size_t numItems = 0;
+    };
+
+    /**
+     * The vBuckets' state (indexed by vbid) as of the access log their
+     * shard's last successful run created. Each element is only accessed by
+     * the visitor of the vBucket's shard.
+     */
+    std::vector<ResidentState> residentStates;
+
 protected:
     void createAndScheduleTask(size_t shard);
 
@@ -168,6 +168,9 @@ bool BgFetcher::run(GlobalTask *task) {
 
 bool BgFetcher::pendingJob() const {
     for (const auto vbid : shard->getVBuckets()) {
+        if (shard->getBgFetcherForVBucket(vbid) != this) {
+            continue;
+        }
         VBucketPtr vb = shard->getBucket(vbid);
         if (vb && vb->hasPendingBGFetchItems()) {
             return true;
@@ -18,9 +18,13 @@
 #include "blob.h"
 
 #include "objectregistry.h"
+#include "value_tier.h"
 
 #include <cstring>
 
+constexpr uint32_t Blob::uncompressibleBit;
+constexpr uint32_t Blob::tieredBit;
+
 Blob* Blob::New(const char* start, const size_t len) {
     size_t total_len = getAllocationSize(len);
     Blob* t = new (::operator new(total_len)) Blob(start, len);
@@ -39,6 +43,19 @@ Blob* Blob::Copy(const Blob& other) {
     return t;
 }
 
+Blob* Blob::CopyToTier(const Blob& other, ValueTier& tier) {
+    void* ptr = tier.allocate(Blob::getAllocationSize(other.valueSize()));
+    if (!ptr) {
+        return nullptr;
+    }
+    return new (ptr) Blob(other, Tiered());
+}
+
+void Blob::destroyTiered(Blob* blob) {
+    blob->~Blob();
+    ValueTier::deallocate(blob);
+}
+
 Blob::Blob(const char* start, const size_t len)
     : size(static_cast<uint32_t>(len)), age(0) {
     if (start != NULL) {
@@ -55,17 +72,24 @@ Blob::Blob(const size_t len) : Blob(nullptr, len) {
 }
 
 Blob::Blob(const Blob& other)
-    : size(other.size.load()),
+    : size(other.size.load() & ~tieredBit),
       // While this is a copy, it is a new allocation therefore reset age.
       age(0) {
     std::memcpy(data, other.data, other.valueSize());
     ObjectRegistry::onCreateBlob(this);
 }
 
+Blob::Blob(const Blob& other, Tiered)
+    : size(other.size.load() | tieredBit), age(0) {
+    std::memcpy(data, other.data, other.valueSize());
+}
+
 const std::string Blob::to_s() const {
     return std::string(data, valueSize());
 }
 
 Blob::~Blob() {
-    ObjectRegistry::onDeleteBlob(this);
+    if (!isTiered()) {
+        ObjectRegistry::onDeleteBlob(this);
+    }
 }
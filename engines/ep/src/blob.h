@@ -22,6 +22,8 @@
 #include "atomic.h"
 #include "tagged_ptr.h"
 
+class ValueTier;
+
 /**
  * A blob is a minimal sized storage for data up to 2^32 bytes long.
  */
@@ -54,6 +56,13 @@ public:
      */
     static Blob* Copy(const Blob& other);
 
+    /**
+     * Create a copy of the specified Blob in the given value tier.
+     *
+     * @return the new Blob instance, or nullptr if the tier has no room
+     */
+    static Blob* CopyToTier(const Blob& other, ValueTier& tier);
+
     // Actual accessorish things.
 
     /**
@@ -67,7 +76,7 @@ public:
      * Get the size of this Blob's value.
      */
     size_t valueSize() const {
-        return size & ~(0x80000000);
+        return size & ~(uncompressibleBit | tieredBit);
     }
 
     /**
@@ -101,7 +110,7 @@ public:
      * Check if the given data is compressible
      */
     bool isCompressible() {
-        return ~(size & 0x80000000);
+        return ~(size & uncompressibleBit);
     }
 
     /**
@@ -109,7 +118,12 @@ public:
      * This should be fine given that the maximum value we support is 20 MiB
      */
     void setUncompressible() {
-        size |= 0x80000000;
+        size |= uncompressibleBit;
+    }
+
+    /// @return true if this Blob is held in a ValueTier (not the heap)
+    bool isTiered() const {
+        return (size & tieredBit) != 0;
     }
 
     /**
@@ -134,7 +148,11 @@ public:
     class Deleter {
     public:
         void operator()(TaggedPtr<Blob> item) {
-            delete item.get();
+            if (item.get()->isTiered()) {
+                destroyTiered(item.get());
+            } else {
+                delete item.get();
+            }
         }
     };
 
@@ -142,6 +160,15 @@ private:
     //Ensure Blob size of 12 bytes by padding by 3.
     static constexpr int paddingSize{3};
 
+    // Bits of size used as flags (values are at most 20 MiB).
+    static constexpr uint32_t uncompressibleBit = 0x80000000;
+    static constexpr uint32_t tieredBit = 0x40000000;
+
+    /// Tag for the constructor of a Blob in a ValueTier.
+    struct Tiered {};
+
+    static void destroyTiered(Blob* blob);
+
 protected:
     /* Constructor.
      * @param start If non-NULL, pointer to array which will be copied into
@@ -155,6 +182,9 @@ protected:
 
     explicit Blob(const Blob& other);
 
+    /// Copy other into a ValueTier; not accounted to the bucket's memory.
+    Blob(const Blob& other, Tiered);
+
     static size_t getAllocationSize(size_t len) {
         return sizeof(Blob) + len - sizeof(Blob(0, 0).data);
     }
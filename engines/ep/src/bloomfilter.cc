@@ -21,7 +21,10 @@
 
 #include "murmurhash3.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <iterator>
 
 #if __x86_64__ || __ppc64__
 #define MURMURHASH_3 MurmurHash3_x64_128
@@ -30,18 +33,48 @@
 #endif
 
 BloomFilter::BloomFilter(size_t key_count, double false_positive_prob,
-                         bfilter_status_t new_status) {
+                         bfilter_status_t new_status, bool blocked)
+    : blocked(blocked) {
 
     status = new_status;
     filterSize = estimateFilterSize(key_count, false_positive_prob);
+    if (blocked) {
+        // Whole blocks only (and at least one).
+        numBlocks = std::max((filterSize + BlockBits - 1) / BlockBits,
+                             size_t(1));
+        filterSize = numBlocks * BlockBits;
+    }
     noOfHashes = estimateNoOfHashes(key_count);
+    if (blocked) {
+        noOfHashes = std::max(noOfHashes, size_t(1));
+    }
     keyCounter = 0;
-    bitArray.assign(filterSize, false);
+    allocate();
+}
+
+void BloomFilter::allocate() {
+    if (blocked) {
+        numBlocks = filterSize / BlockBits;
+        // A block is a cache line; allow for aligning the first one.
+        blockStorage.assign((numBlocks + 1) * BlockWords - 1, 0);
+        auto addr = reinterpret_cast<uintptr_t>(blockStorage.data());
+        addr = (addr + 63) & ~uintptr_t(63);
+        blocks = reinterpret_cast<uint64_t*>(addr);
+    } else {
+        bitArray.assign(filterSize, false);
+    }
 }
 
 BloomFilter::~BloomFilter() {
     status = BFILTER_DISABLED;
+    clear();
+}
+
+void BloomFilter::clear() {
     bitArray.clear();
+    blockStorage.clear();
+    blocks = nullptr;
+    numBlocks = 0;
 }
 
 size_t BloomFilter::estimateFilterSize(size_t key_count,
@@ -62,6 +95,28 @@ uint64_t BloomFilter::hashDocKey(const DocKey& key, uint32_t iteration) {
     return result;
 }
 
+uint64_t* BloomFilter::getBlock(const DocKey& key,
+                                uint64_t (&mask)[BlockWords]) {
+    // One 128-bit hash: the first half picks the block, the second half
+    // generates the k bit positions within it (by double hashing).
+    uint64_t result[2];
+    auto hashable = key.getIdAndKey();
+    MURMURHASH_3(hashable.second.data(),
+                 hashable.second.size(),
+                 uint32_t(hashable.first),
+                 result);
+
+    // An odd stride gives k distinct bits (BlockBits is a power of two).
+    const auto h1 = uint32_t(result[1]);
+    const auto h2 = uint32_t(result[1] >> 32) | 1;
+    std::fill(std::begin(mask), std::end(mask), 0);
+    for (uint32_t i = 0; i < noOfHashes; i++) {
+        const uint32_t bit = (h1 + i * h2) % BlockBits;
+        mask[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    return blocks + (result[0] % numBlocks) * BlockWords;
+}
+
 void BloomFilter::setStatus(bfilter_status_t to) {
     switch (status) {
         case BFILTER_DISABLED:
@@ -72,7 +127,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_PENDING:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clear();
             } else if (to == BFILTER_COMPACTING) {
                 status = to;
             }
@@ -80,7 +135,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_COMPACTING:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clear();
             } else if (to == BFILTER_ENABLED) {
                 status = to;
             }
@@ -88,7 +143,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_ENABLED:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clear();
             } else if (to == BFILTER_COMPACTING) {
                 status = to;
             }
@@ -116,6 +171,23 @@ std::string BloomFilter::getStatusString() {
 
 void BloomFilter::addKey(const DocKey& key) {
     if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        if (blocked) {
+            if (!blocks) {
+                return;
+            }
+            uint64_t mask[BlockWords];
+            auto* block = getBlock(key, mask);
+            uint64_t added = 0;
+            for (size_t w = 0; w < BlockWords; w++) {
+                added |= mask[w] & ~block[w];
+                block[w] |= mask[w];
+            }
+            if (added) {
+                keyCounter++;
+            }
+            return;
+        }
+
         bool overlap = true;
         for (uint32_t i = 0; i < noOfHashes; i++) {
             uint64_t result = hashDocKey(key, i);
@@ -132,6 +204,20 @@ void BloomFilter::addKey(const DocKey& key) {
 
 bool BloomFilter::maybeKeyExists(const DocKey& key) {
     if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        if (blocked) {
+            if (!blocks) {
+                return true;
+            }
+            uint64_t mask[BlockWords];
+            const auto* block = getBlock(key, mask);
+            uint64_t missing = 0;
+            for (size_t w = 0; w < BlockWords; w++) {
+                missing |= mask[w] & ~block[w];
+            }
+            // The key does NOT exist if any of its bits are missing.
+            return missing == 0;
+        }
+
         for (uint32_t i = 0; i < noOfHashes; i++) {
             uint64_t result = hashDocKey(key, i);
             if (bitArray[result % filterSize] == 0) {
@@ -144,6 +230,76 @@ bool BloomFilter::maybeKeyExists(const DocKey& key) {
     return true;
 }
 
+namespace {
+/// Header of a serialised filter, followed by the filter's bits.
+struct SerialisedHeader {
+    uint32_t version;
+    uint32_t blocked;
+    uint64_t filterSize;
+    uint64_t noOfHashes;
+    uint64_t keyCounter;
+};
+const uint32_t SerialisedVersion = 1;
+} // anonymous namespace
+
+std::string BloomFilter::serialise() const {
+    SerialisedHeader header{SerialisedVersion,
+                            blocked ? 1u : 0u,
+                            filterSize,
+                            noOfHashes,
+                            keyCounter};
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (blocked) {
+        data.append(reinterpret_cast<const char*>(blocks),
+                    numBlocks * BlockWords * sizeof(uint64_t));
+    } else {
+        std::string bits((filterSize + 7) / 8, '\0');
+        for (size_t i = 0; i < filterSize; i++) {
+            if (bitArray[i]) {
+                bits[i / 8] |= char(1 << (i % 8));
+            }
+        }
+        data.append(bits);
+    }
+    return data;
+}
+
+std::unique_ptr<BloomFilter> BloomFilter::deserialise(
+        const std::string& data) {
+    SerialisedHeader header;
+    if (data.size() < sizeof(header)) {
+        return {};
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    const bool blocked = header.blocked != 0;
+    const size_t bytes = blocked ? header.filterSize / 8
+                                 : (header.filterSize + 7) / 8;
+    if (header.version != SerialisedVersion || header.filterSize == 0 ||
+        header.noOfHashes == 0 ||
+        (blocked && header.filterSize % BlockBits != 0) ||
+        data.size() != sizeof(header) + bytes) {
+        return {};
+    }
+
+    // Construct the smallest filter, then size it as serialised.
+    std::unique_ptr<BloomFilter> filter(
+            new BloomFilter(1, 0.5, BFILTER_ENABLED, blocked));
+    filter->filterSize = header.filterSize;
+    filter->noOfHashes = header.noOfHashes;
+    filter->keyCounter = header.keyCounter;
+    filter->allocate();
+
+    const char* bits = data.data() + sizeof(header);
+    if (blocked) {
+        std::memcpy(filter->blocks, bits, bytes);
+    } else {
+        for (size_t i = 0; i < filter->filterSize; i++) {
+            filter->bitArray[i] = (bits[i / 8] >> (i % 8)) & 1;
+        }
+    }
+    return filter;
+}
+
 size_t BloomFilter::getNumOfKeysInFilter() {
     if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
         return keyCounter;
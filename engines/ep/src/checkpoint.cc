@@ -98,6 +98,8 @@ Checkpoint::Checkpoint(EPStats& st,
       checkpointState(CHECKPOINT_OPEN),
       numItems(0),
       numMetaItems(0),
+      expelledUpTo(toWrite.begin()),
+      highestExpelledSeqno(0),
       memOverhead(0),
       effectiveMemUsage(0) {
     stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
@@ -108,6 +110,7 @@ Checkpoint::~Checkpoint() {
                  checkpointId,
                  vbucketId);
     stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+    stats.coreLocal.get()->checkpointMemory.fetch_sub(effectiveMemUsage.load());
 }
 
 size_t Checkpoint::getNumMetaItems() const {
@@ -213,7 +216,8 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
             // Reduce the size of the checkpoint by the size of the
             // item being removed.
             decrementMemConsumption((*currPos)->size());
-            // Remove the existing item for the same key from the list.
+            // Remove the existing item for the same key from the queue
+            // (leaving an empty slot; iterators skip it).
             toWrite.erase(currPos);
 
             // Reduce the number of items because addItemToCheckpoint
@@ -227,7 +231,7 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
 
     if (qi->getKey().size() > 0) {
         CheckpointQueue::iterator last = toWrite.end();
-        // --last is okay as the list is not empty now.
+        // --last is okay as the queue is not empty now.
         index_entry entry = {--last, qi->getBySeqno()};
         // Set the index of the key to the new item that is pushed back into
         // the list.
@@ -245,6 +249,8 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
         }
     }
 
+    checkpointManager->publishAppend_UNLOCKED();
+
     // Notify flusher if in case queued item is a checkpoint meta item or
     // vbpersist state.
     if (qi->getOperation() == queue_op::checkpoint_start ||
@@ -271,7 +277,80 @@ void Checkpoint::addItemToCheckpoint(const queued_item& qi) {
     } else {
         // Not a meta item
         ++numItems;
+        indexCollectionItem(*qi);
+    }
+}
+
+void Checkpoint::indexCollectionItem(const Item& item) {
+    auto& positions = collectionPositions[item.getKey().getCollectionID()];
+    const auto capacity = positions.capacity();
+    positions.push_back(CheckpointQueue::index(std::prev(toWrite.end())));
+    if (positions.capacity() != capacity) {
+        const size_t grown =
+                (positions.capacity() - capacity) * sizeof(size_t);
+        memOverhead += grown;
+        stats.coreLocal.get()->memOverhead.fetch_add(grown);
+    }
+}
+
+CheckpointQueue::iterator Checkpoint::nextCollectionItem(
+        CheckpointQueue::iterator pos,
+        const std::vector<CollectionID>& collections) {
+    const auto after = CheckpointQueue::index(pos);
+    auto next = std::numeric_limits<size_t>::max();
+    for (const auto& collection : collections) {
+        const auto it = collectionPositions.find(collection);
+        if (it == collectionPositions.end()) {
+            continue;
+        }
+        const auto& positions = it->second;
+        for (auto p = std::upper_bound(
+                     positions.begin(), positions.end(), after);
+             p != positions.end() && *p < next;
+             ++p) {
+            // Skip the positions of de-duplicated / expelled items.
+            if (*toWrite.at(*p)) {
+                next = *p;
+                break;
+            }
+        }
+    }
+    return next == std::numeric_limits<size_t>::max() ? toWrite.end()
+                                                       : toWrite.at(next);
+}
+
+size_t Checkpoint::expelItems(CheckpointQueue::iterator lowestCursorPos,
+                              std::vector<queued_item>& expelled) {
+    size_t numExpelled = 0;
+    // Resume from where the previous call stopped. A cursor can step back
+    // over expelled slots (see CheckpointCursor::decrPos), in which case
+    // there is nothing more to expel yet.
+    for (auto it = std::next(expelledUpTo); it < lowestCursorPos; ++it) {
+        expelledUpTo = it;
+        queued_item& qi = *it;
+        if (qi->isCheckPointMetaItem()) {
+            continue;
+        }
+
+        if (qi->getKey().size() > 0) {
+            auto entry = keyIndex.find(qi->getKey());
+            if (entry != keyIndex.end() && entry->second.position == it) {
+                keyIndex.erase(entry);
+                size_t entrySize = qi->getKey().size() + sizeof(index_entry) +
+                                   sizeof(queued_item);
+                memOverhead -= entrySize;
+                stats.coreLocal.get()->memOverhead.fetch_sub(entrySize);
+            }
+        }
+
+        decrementMemConsumption(qi->size());
+        highestExpelledSeqno = static_cast<uint64_t>(qi->getBySeqno());
+        --numItems;
+        expelled.push_back(std::move(qi));
+        toWrite.erase(it);
+        ++numExpelled;
     }
+    return numExpelled;
 }
 
 std::ostream& operator <<(std::ostream& os, const Checkpoint& c) {
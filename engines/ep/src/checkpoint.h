@@ -19,16 +19,20 @@
 
 #include "config.h"
 
+#include "checkpoint_queue.h"
 #include "ep_types.h"
 #include "item.h"
 #include "stats.h"
 
 #include <platform/non_negative_counter.h>
 
+#include <algorithm>
+#include <limits>
 #include <list>
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #define GIGANTOR ((size_t)1<<(sizeof(size_t)*8-1))
 
@@ -53,10 +57,6 @@ enum checkpoint_state {
 
 const char* to_string(enum checkpoint_state);
 
-// List is used for queueing mutations as vector incurs shift operations for
-// deduplication.
-typedef std::list<queued_item> CheckpointQueue;
-
 /**
  * A checkpoint index entry.
  */
@@ -94,6 +94,9 @@ class VBucket;
  * When a CheckpointCursor reaches the end of Checkpoint, the CheckpointManager
  * will move it to the next Checkpoint.
  *
+ * A cursor may be limited to the items of some collections, in which case
+ * the CheckpointManager skips (most of) the items of other collections
+ * without returning them.
  */
 class CheckpointCursor {
     friend class CheckpointManager;
@@ -123,7 +126,9 @@ public:
         : name(other.name),
           currentCheckpoint(other.currentCheckpoint),
           currentPos(other.currentPos),
-          numVisits(other.numVisits.load()) {
+          numVisits(other.numVisits.load()),
+          drainedVersion(other.drainedVersion.load()),
+          collections(other.collections) {
     }
 
     CheckpointCursor &operator=(const CheckpointCursor &other) {
@@ -131,6 +136,8 @@ public:
         currentCheckpoint = other.currentCheckpoint;
         currentPos = other.currentPos;
         numVisits = other.numVisits.load();
+        drainedVersion = other.drainedVersion.load();
+        collections = other.collections;
         return *this;
     }
 
@@ -155,6 +162,14 @@ private:
     // Number of times a cursor has been moved or processed.
     std::atomic<size_t>              numVisits;
 
+    // The CheckpointManager's appendVersion when this cursor was last found
+    // to have reached the end of the checkpoints (nothing more to read).
+    std::atomic<uint64_t> drainedVersion{
+            std::numeric_limits<uint64_t>::max()};
+
+    // If set, the only collections whose items the cursor's reader wants.
+    std::shared_ptr<const std::vector<CollectionID>> collections;
+
     friend std::ostream& operator<<(std::ostream& os, const CheckpointCursor& c);
 };
 
@@ -352,10 +367,18 @@ public:
     queue_dirty_t queueDirty(const queued_item &qi,
                              CheckpointManager *checkpointManager);
 
+    /**
+     * Return the lowest seqno present in this checkpoint; after items have
+     * been expelled this is above the seqno of the last expelled item.
+     */
     uint64_t getLowSeqno() const {
         auto pos = toWrite.begin();
         pos++;
-        return (*pos)->getBySeqno();
+        const uint64_t low = (*pos)->getBySeqno();
+        if (highestExpelledSeqno == 0) {
+            return low;
+        }
+        return std::max(low, highestExpelledSeqno + 1);
     }
 
     uint64_t getHighSeqno() const {
@@ -403,8 +426,22 @@ public:
         return toWrite.rend();
     }
 
+    /// @return the position with the given CheckpointQueue::index()
+    CheckpointQueue::iterator at(size_t index) {
+        return toWrite.at(index);
+    }
+
     bool keyExists(const DocKey& key);
 
+    /**
+     * @return the position of the first (non-meta) item after pos which
+     *         belongs to one of the given collections, or end() if there is
+     *         none.
+     */
+    CheckpointQueue::iterator nextCollectionItem(
+            CheckpointQueue::iterator pos,
+            const std::vector<CollectionID>& collections);
+
     /**
      * Return the memory overhead of this checkpoint instance, except for the memory used by
      * all the items belonging to this checkpoint. The memory overhead of those items is
@@ -422,6 +459,7 @@ public:
      */
     void incrementMemConsumption(size_t by) {
         effectiveMemUsage += by;
+        stats.coreLocal.get()->checkpointMemory.fetch_add(by);
     }
 
     /**
@@ -431,6 +469,7 @@ public:
      */
     void decrementMemConsumption(size_t by) {
         effectiveMemUsage -= by;
+        stats.coreLocal.get()->checkpointMemory.fetch_sub(by);
     }
 
     /**
@@ -459,6 +498,24 @@ public:
      */
     void addItemToCheckpoint(const queued_item& qi);
 
+    /// Record the position of the (just appended) last item in the index of
+    /// its collection.
+    void indexCollectionItem(const Item& item);
+
+    /**
+     * Expel the non-meta items which are before the given position (the
+     * position of the lowest cursor in this checkpoint). Their slots are left
+     * empty and their keys removed from the index, so a later mutation of
+     * the same key is queued as a new item.
+     *
+     * @param lowestCursorPos  Items at or after this position are kept.
+     * @param expelled  The expelled items are moved to here, so the caller
+     *        can free them once it has released the queueLock.
+     * @return the number of items expelled.
+     */
+    size_t expelItems(CheckpointQueue::iterator lowestCursorPos,
+                      std::vector<queued_item>& expelled);
+
 private:
     EPStats                       &stats;
     uint64_t                       checkpointId;
@@ -476,9 +533,19 @@ private:
     cb::NonNegativeCounter<size_t> numOfCursorsInCheckpoint = 0;
 
     CheckpointQueue                toWrite;
+    /// Position up to which items have been expelled.
+    CheckpointQueue::iterator expelledUpTo;
+    /// Seqno of the last item expelled, or zero if none have been.
+    uint64_t highestExpelledSeqno;
     checkpoint_index               keyIndex;
     /* Index for meta keys like "dummy_key" */
     checkpoint_index               metaKeyIndex;
+    /**
+     * The positions (see CheckpointQueue::index()) of the non-meta items of
+     * each collection, in order. Positions of items since de-duplicated or
+     * expelled refer to empty slots.
+     */
+    std::unordered_map<CollectionID, std::vector<size_t>> collectionPositions;
     size_t                         memOverhead;
 
     // The following stat is to contain the memory consumption of all
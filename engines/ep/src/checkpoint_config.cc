@@ -37,6 +37,10 @@ public:
             config.setCheckpointMaxItems(value);
         } else if (key.compare("max_checkpoints") == 0) {
             config.setMaxCheckpoints(value);
+        } else if (key.compare("chk_max_vb_memory") == 0) {
+            config.setMaxVBucketMemory(value);
+        } else if (key.compare("chk_max_bucket_memory") == 0) {
+            config.setMaxBucketMemory(value);
         }
     }
 
@@ -58,7 +62,10 @@ CheckpointConfig::CheckpointConfig()
       maxCheckpoints(DEFAULT_MAX_CHECKPOINTS),
       itemNumBasedNewCheckpoint(true),
       keepClosedCheckpoints(false),
-      persistenceEnabled(true) { /* empty */
+      persistenceEnabled(true),
+      lockFreeReaders(false),
+      maxVBucketMemory(0),
+      maxBucketMemory(0) { /* empty */
 }
 
 CheckpointConfig::CheckpointConfig(rel_time_t period,
@@ -66,13 +73,19 @@ CheckpointConfig::CheckpointConfig(rel_time_t period,
                                    size_t max_ckpts,
                                    bool item_based_new_ckpt,
                                    bool keep_closed_ckpts,
-                                   bool persistence_enabled)
+                                   bool persistence_enabled,
+                                   bool lock_free_readers,
+                                   size_t max_vb_memory,
+                                   size_t max_bucket_memory)
     : checkpointPeriod(period),
       checkpointMaxItems(max_items),
       maxCheckpoints(max_ckpts),
       itemNumBasedNewCheckpoint(item_based_new_ckpt),
       keepClosedCheckpoints(keep_closed_ckpts),
-      persistenceEnabled(persistence_enabled) {
+      persistenceEnabled(persistence_enabled),
+      lockFreeReaders(lock_free_readers),
+      maxVBucketMemory(max_vb_memory),
+      maxBucketMemory(max_bucket_memory) {
 }
 
 CheckpointConfig::CheckpointConfig(EventuallyPersistentEngine& e) {
@@ -83,6 +96,9 @@ CheckpointConfig::CheckpointConfig(EventuallyPersistentEngine& e) {
     itemNumBasedNewCheckpoint = config.isItemNumBasedNewChk();
     keepClosedCheckpoints = config.isKeepClosedChks();
     persistenceEnabled = config.getBucketType() == "persistent";
+    lockFreeReaders = config.isChkLockFreeReaders();
+    maxVBucketMemory = config.getChkMaxVbMemory();
+    maxBucketMemory = config.getChkMaxBucketMemory();
 }
 
 void CheckpointConfig::addConfigChangeListener(
@@ -97,6 +113,12 @@ void CheckpointConfig::addConfigChangeListener(
     configuration.addValueChangedListener(
             "max_checkpoints",
             std::make_unique<ChangeListener>(engine.getCheckpointConfig()));
+    configuration.addValueChangedListener(
+            "chk_max_vb_memory",
+            std::make_unique<ChangeListener>(engine.getCheckpointConfig()));
+    configuration.addValueChangedListener(
+            "chk_max_bucket_memory",
+            std::make_unique<ChangeListener>(engine.getCheckpointConfig()));
     configuration.addValueChangedListener(
             "item_num_based_new_chk",
             std::make_unique<ChangeListener>(engine.getCheckpointConfig()));
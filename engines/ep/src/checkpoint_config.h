@@ -36,7 +36,10 @@ public:
                      size_t max_ckpts,
                      bool item_based_new_ckpt,
                      bool keep_closed_ckpts,
-                     bool persistence_enabled);
+                     bool persistence_enabled,
+                     bool lock_free_readers = false,
+                     size_t max_vb_memory = 0,
+                     size_t max_bucket_memory = 0);
 
     CheckpointConfig(EventuallyPersistentEngine& e);
 
@@ -64,6 +67,26 @@ public:
         return persistenceEnabled;
     }
 
+    bool isLockFreeReaders() const {
+        return lockFreeReaders;
+    }
+
+    size_t getMaxVBucketMemory() const {
+        return maxVBucketMemory;
+    }
+
+    size_t getMaxBucketMemory() const {
+        return maxBucketMemory;
+    }
+
+    /**
+     * @return true if checkpoints are closed (and their items expelled)
+     * based on their memory usage.
+     */
+    bool hasMemoryBudget() const {
+        return maxVBucketMemory > 0 || maxBucketMemory > 0;
+    }
+
 protected:
     friend class CheckpointConfigChangeListener;
     friend class EventuallyPersistentEngine;
@@ -76,6 +99,14 @@ protected:
     void setCheckpointMaxItems(size_t value);
     void setMaxCheckpoints(size_t value);
 
+    void setMaxVBucketMemory(size_t value) {
+        maxVBucketMemory = value;
+    }
+
+    void setMaxBucketMemory(size_t value) {
+        maxBucketMemory = value;
+    }
+
     void allowItemNumBasedNewCheckpoint(bool value) {
         itemNumBasedNewCheckpoint = value;
     }
@@ -106,4 +137,16 @@ private:
 
     // Flag indicating if persistence is enabled.
     bool persistenceEnabled;
+
+    // Flag indicating if cursors which have reached the end of the open
+    // checkpoint are checked for new items without taking the queueLock.
+    bool lockFreeReaders;
+
+    // Memory (in bytes) the open checkpoint of a vBucket may use before it is
+    // closed; zero if unlimited.
+    size_t maxVBucketMemory;
+
+    // Memory (in bytes) the checkpoints of all vBuckets may use before open
+    // checkpoints are closed; zero if unlimited.
+    size_t maxBucketMemory;
 };
@@ -35,6 +35,7 @@ CheckpointManager::CheckpointManager(EPStats& st,
                                      FlusherCallback cb)
     : stats(st),
       checkpointConfig(config),
+      queueLock(&st.lockProfiles.checkpointQueue),
       vbucketId(vbucket),
       numItems(0),
       lastBySeqno(lastSeqno),
@@ -219,13 +220,19 @@ void CheckpointManager::addOpenCheckpoint(uint64_t id,
 }
 
 CursorRegResult CheckpointManager::registerCursorBySeqno(
-        const std::string& name, uint64_t startBySeqno) {
+        const std::string& name,
+        uint64_t startBySeqno,
+        std::shared_ptr<const std::vector<CollectionID>> collections) {
     LockHolder lh(queueLock);
-    return registerCursorBySeqno_UNLOCKED(lh, name, startBySeqno);
+    return registerCursorBySeqno_UNLOCKED(
+            lh, name, startBySeqno, std::move(collections));
 }
 
 CursorRegResult CheckpointManager::registerCursorBySeqno_UNLOCKED(
-        const LockHolder& lh, const std::string& name, uint64_t startBySeqno) {
+        const LockHolder& lh,
+        const std::string& name,
+        uint64_t startBySeqno,
+        std::shared_ptr<const std::vector<CollectionID>> collections) {
     const auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
     if (openCkpt.getHighSeqno() < startBySeqno) {
         throw std::invalid_argument(
@@ -261,6 +268,7 @@ CursorRegResult CheckpointManager::registerCursorBySeqno_UNLOCKED(
             auto cursor = std::make_shared<CheckpointCursor>(name,
                                                              itr,
                                                              (*itr)->begin());
+            cursor->collections = collections;
             connCursors[name] = cursor;
             (*itr)->incNumOfCursorsInCheckpoint();
             result.seqno = (*itr)->getLowSeqno();
@@ -285,6 +293,7 @@ CursorRegResult CheckpointManager::registerCursorBySeqno_UNLOCKED(
 
             auto cursor =
                     std::make_shared<CheckpointCursor>(name, itr, iitr);
+            cursor->collections = collections;
             connCursors[name] = cursor;
             (*itr)->incNumOfCursorsInCheckpoint();
             result.cursor.setCursor(cursor);
@@ -364,6 +373,56 @@ bool CheckpointManager::isCheckpointCreationForHighMemUsage_UNLOCKED(
     return forceCreation;
 }
 
+bool CheckpointManager::isOpenCheckpointOverMemoryBudget_UNLOCKED(
+        const LockHolder& lh) const {
+    const auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
+    const auto maxVBucketMemory = checkpointConfig.getMaxVBucketMemory();
+    if (maxVBucketMemory > 0 &&
+        openCkpt.getMemConsumption() >= maxVBucketMemory) {
+        return true;
+    }
+    // Over the bucket budget every vBucket closes its open checkpoint, as
+    // long as that checkpoint isn't tiny (which would just create lots of
+    // checkpoints without freeing anything).
+    const auto maxBucketMemory = checkpointConfig.getMaxBucketMemory();
+    return maxBucketMemory > 0 &&
+           openCkpt.getNumItems() >= MIN_CHECKPOINT_ITEMS &&
+           stats.getCheckpointMemory() >= maxBucketMemory;
+}
+
+size_t CheckpointManager::expelUnreferencedCheckpointItems() {
+    // Items are freed after the lock is released (expelled is destroyed
+    // after lh).
+    std::vector<queued_item> expelled;
+    LockHolder lh(queueLock);
+    return expelUnreferencedCheckpointItems_UNLOCKED(lh, expelled);
+}
+
+size_t CheckpointManager::expelUnreferencedCheckpointItems_UNLOCKED(
+        const LockHolder& lh, std::vector<queued_item>& expelled) {
+    // Only the oldest checkpoint is considered: checkpoints before the
+    // lowest cursor are freed whole by the remover, and expelling from the
+    // oldest one keeps its low seqno meaningful for registerCursorBySeqno
+    // (a cursor asking for an expelled seqno is told to backfill).
+    auto oldest = checkpointList.begin();
+    if ((*oldest)->isNoCursorsInCheckpoint()) {
+        return 0;
+    }
+
+    auto lowestPos = (*oldest)->end();
+    for (const auto& cursor : connCursors) {
+        if (cursor.second->currentCheckpoint == oldest &&
+            cursor.second->currentPos < lowestPos) {
+            lowestPos = cursor.second->currentPos;
+        }
+    }
+
+    const auto numExpelled = (*oldest)->expelItems(lowestPos, expelled);
+    numItems -= numExpelled;
+    stats.itemsExpelledFromCheckpoints.fetch_add(numExpelled);
+    return numExpelled;
+}
+
 size_t CheckpointManager::removeClosedUnrefCheckpoints(
         VBucket& vbucket, bool& newOpenCheckpointCreated, size_t limit) {
     // This function is executed periodically by the non-IO dispatcher.
@@ -627,6 +686,17 @@ CheckpointManager::ItemsForCursor CheckpointManager::getItemsForCursor(
         CheckpointCursor* cursorPtr,
         std::vector<queued_item>& items,
         size_t approxLimit) {
+    // Fast path for (DCP) cursors which have already read everything; the
+    // persistence cursor always takes the lock as the flusher relies on the
+    // returned range.
+    if (cursorPtr && cursorPtr != persistenceCursor &&
+        isCursorDrained(*cursorPtr)) {
+        cursorPtr->numVisits++;
+        return {};
+    }
+
+    // Items expelled below are freed after the lock is released.
+    std::vector<queued_item> expelled;
     LockHolder lh(queueLock);
     if (!cursorPtr) {
         EP_LOG_WARN("getAllItemsForCursor(): Caller had a null cursor {}",
@@ -636,13 +706,37 @@ CheckpointManager::ItemsForCursor CheckpointManager::getItemsForCursor(
 
     auto& cursor = *cursorPtr;
 
+    ItemsForCursor result;
+    if (getSharedItems_UNLOCKED(cursor, items, approxLimit, result)) {
+        if (!result.moreAvailable) {
+            cursor.drainedVersion.store(appendVersion.load(),
+                                        std::memory_order_release);
+        }
+        cursor.numVisits++;
+        return result;
+    }
+
+    // Only DCP cursors (reading every collection) share their reads, and
+    // only when another DCP cursor could be at the same position.
+    const bool shareRead =
+            &cursor != persistenceCursor && !cursor.collections &&
+            connCursors.size() - (persistenceCursor ? 1 : 0) > 1;
+    const auto startCheckpointId = (*cursor.currentCheckpoint)->getId();
+    const auto startPos = CheckpointQueue::index(cursor.currentPos);
+    const auto firstItem = items.size();
+
     // Fetch whole checkpoints; as long as we don't exceed the approx item
     // limit.
-    ItemsForCursor result;
     result.range.start = (*cursor.currentCheckpoint)->getSnapshotStartSeqno();
     result.range.end = (*cursor.currentCheckpoint)->getSnapshotEndSeqno();
     size_t itemCount = 0;
-    while ((result.moreAvailable = incrCursor(cursor))) {
+    while (true) {
+        if (cursor.collections) {
+            skipOtherCollections(cursor);
+        }
+        if (!(result.moreAvailable = incrCursor(cursor))) {
+            break;
+        }
         queued_item& qi = *(cursor.currentPos);
         items.push_back(qi);
         itemCount++;
@@ -667,6 +761,29 @@ CheckpointManager::ItemsForCursor CheckpointManager::getItemsForCursor(
         result.range.end = (*cursor.currentCheckpoint)->getSnapshotEndSeqno();
     }
 
+    if (!result.moreAvailable) {
+        cursor.drainedVersion.store(appendVersion.load(),
+                                    std::memory_order_release);
+    }
+
+    if (shareRead && itemCount > 0) {
+        if (!sharedRead) {
+            sharedRead = std::make_unique<SharedRead>();
+        }
+        sharedRead->version = appendVersion.load();
+        sharedRead->approxLimit = approxLimit;
+        sharedRead->startCheckpointId = startCheckpointId;
+        sharedRead->startPos = startPos;
+        sharedRead->endCheckpointId = (*cursor.currentCheckpoint)->getId();
+        sharedRead->endPos = CheckpointQueue::index(cursor.currentPos);
+        sharedRead->items.assign(items.begin() + firstItem, items.end());
+        sharedRead->result = result;
+    }
+
+    if (checkpointConfig.hasMemoryBudget()) {
+        expelUnreferencedCheckpointItems_UNLOCKED(lh, expelled);
+    }
+
     EP_LOG_DEBUG(
             "CheckpointManager::getAllItemsForCursor() "
             "cursor:{} result:{{#items:{} range:{{{}, {}}} "
@@ -743,6 +860,7 @@ void CheckpointManager::clear(VBucket& vb, uint64_t seqno) {
 }
 
 void CheckpointManager::clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno) {
+    sharedRead.reset();
     checkpointList.clear();
     numItems = 0;
     lastBySeqno.reset(seqno);
@@ -753,6 +871,7 @@ void CheckpointManager::clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno)
 }
 
 void CheckpointManager::resetCursors(bool resetPersistenceCursor) {
+    publishAppend_UNLOCKED();
     for (auto& cit : connCursors) {
         if (cit.second->name == pCursorName) {
             if (!resetPersistenceCursor) {
@@ -790,6 +909,66 @@ bool CheckpointManager::moveCursorToNextCheckpoint(CheckpointCursor &cursor) {
     return true;
 }
 
+bool CheckpointManager::getSharedItems_UNLOCKED(
+        CheckpointCursor& cursor,
+        std::vector<queued_item>& items,
+        size_t approxLimit,
+        ItemsForCursor& result) {
+    if (!sharedRead || &cursor == persistenceCursor || cursor.collections) {
+        return false;
+    }
+    if (sharedRead->version != appendVersion.load()) {
+        // Something has been queued since; release the items.
+        sharedRead.reset();
+        return false;
+    }
+    if (sharedRead->approxLimit != approxLimit ||
+        (*cursor.currentCheckpoint)->getId() != sharedRead->startCheckpointId ||
+        CheckpointQueue::index(cursor.currentPos) != sharedRead->startPos) {
+        return false;
+    }
+
+    auto end = cursor.currentCheckpoint;
+    while ((*end)->getId() != sharedRead->endCheckpointId) {
+        if (++end == checkpointList.end()) {
+            return false;
+        }
+    }
+    if (end != cursor.currentCheckpoint) {
+        (*cursor.currentCheckpoint)->decNumOfCursorsInCheckpoint();
+        cursor.currentCheckpoint = end;
+        (*end)->incNumOfCursorsInCheckpoint();
+    }
+    cursor.currentPos = (*end)->at(sharedRead->endPos);
+
+    items.insert(items.end(),
+                 sharedRead->items.begin(),
+                 sharedRead->items.end());
+    result = sharedRead->result;
+    return true;
+}
+
+void CheckpointManager::skipOtherCollections(CheckpointCursor& cursor) {
+    auto& checkpoint = **cursor.currentCheckpoint;
+    // Read the checkpoint_start (after the dummy item at begin()) normally,
+    // to start a new snapshot.
+    if (cursor.currentPos == checkpoint.begin()) {
+        return;
+    }
+    auto next = checkpoint.nextCollectionItem(cursor.currentPos,
+                                              *cursor.collections);
+    if (next == checkpoint.end() &&
+        checkpoint.getState() == CHECKPOINT_CLOSED) {
+        // Nothing more wanted; leave the checkpoint_end to be read.
+        --next;
+    }
+    // The cursor refers to the last item read, so never move it back.
+    --next;
+    if (cursor.currentPos < next) {
+        cursor.currentPos = next;
+    }
+}
+
 size_t CheckpointManager::getNumOpenChkItems() const {
     LockHolder lh(queueLock);
     return getOpenCheckpoint_UNLOCKED(lh).getNumItems();
@@ -810,10 +989,13 @@ uint64_t CheckpointManager::checkOpenCheckpoint_UNLOCKED(const LockHolder& lh,
     // (2) current checkpoint is reached to the max number of items allowed.
     // (3) time elapsed since the creation of the current checkpoint is greater
     //     than the threshold
+    // (4) current checkpoint exceeds the checkpoint memory budget
     if (forceCreation ||
         (checkpointConfig.isItemNumBasedNewCheckpoint() &&
          openCkpt.getNumItems() >= checkpointConfig.getCheckpointMaxItems()) ||
-        (openCkpt.getNumItems() > 0 && timeBound)) {
+        (openCkpt.getNumItems() > 0 && timeBound) ||
+        (openCkpt.getNumItems() > 0 &&
+         isOpenCheckpointOverMemoryBudget_UNLOCKED(lh))) {
         checkpoint_id = openCkpt.getId();
         addNewCheckpoint_UNLOCKED(checkpoint_id + 1);
     }
@@ -822,6 +1004,9 @@ uint64_t CheckpointManager::checkOpenCheckpoint_UNLOCKED(const LockHolder& lh,
 
 size_t CheckpointManager::getNumItemsForCursor(
         const CheckpointCursor* cursor) const {
+    if (cursor && isCursorDrained(*cursor)) {
+        return 0;
+    }
     LockHolder lh(queueLock);
     return getNumItemsForCursor_UNLOCKED(cursor);
 }
@@ -23,6 +23,7 @@
 #include "cursor.h"
 #include "ep_types.h"
 #include "item.h"
+#include "lock_profiler.h"
 #include "monotonic.h"
 #include "vbucket.h"
 
@@ -49,6 +50,9 @@ class CheckpointManager {
 public:
     typedef std::shared_ptr<Callback<Vbid>> FlusherCallback;
 
+    /// Holder of the (profiled) queueLock, shadowing the global LockHolder
+    using LockHolder = std::lock_guard<ProfiledMutex<>>;
+
     /// Return type of getItemsForCursor()
     struct ItemsForCursor {
         snapshot_range_t range = {0, 0};
@@ -87,17 +91,30 @@ public:
             bool& newOpenCheckpointCreated,
             size_t limit = std::numeric_limits<size_t>::max());
 
+    /**
+     * Expel the items of the oldest checkpoint which every cursor has already
+     * read, without waiting for the whole checkpoint to become unreferenced.
+     * Done automatically after cursors read items if a checkpoint memory
+     * budget is configured (see CheckpointConfig::hasMemoryBudget()).
+     * @return the number of items expelled.
+     */
+    size_t expelUnreferencedCheckpointItems();
+
     /**
      * Register the cursor for getting items whose bySeqno values are between
      * startBySeqno and endBySeqno, and close the open checkpoint if endBySeqno
      * belongs to the open checkpoint.
      * @param startBySeqno start bySeqno.
+     * @param collections if set, the only collections whose items the
+     *        cursor's reader wants (other items may be skipped)
      * @return Cursor registration result which consists of (1) the bySeqno with
      * which the cursor can start and (2) flag indicating if the cursor starts
      * with the first item on a checkpoint.
      */
-    CursorRegResult registerCursorBySeqno(const std::string& name,
-                                          uint64_t startBySeqno);
+    CursorRegResult registerCursorBySeqno(
+            const std::string& name,
+            uint64_t startBySeqno,
+            std::shared_ptr<const std::vector<CollectionID>> collections = {});
 
     /**
      * Remove the cursor for a given connection.
@@ -399,9 +416,11 @@ protected:
 
     bool removeCursor_UNLOCKED(const CheckpointCursor* cursor);
 
-    CursorRegResult registerCursorBySeqno_UNLOCKED(const LockHolder& lh,
-                                                   const std::string& name,
-                                                   uint64_t startBySeqno);
+    CursorRegResult registerCursorBySeqno_UNLOCKED(
+            const LockHolder& lh,
+            const std::string& name,
+            uint64_t startBySeqno,
+            std::shared_ptr<const std::vector<CollectionID>> collections = {});
 
     size_t getNumItemsForCursor_UNLOCKED(const CheckpointCursor* cursor) const;
 
@@ -447,6 +466,26 @@ protected:
 
     bool moveCursorToNextCheckpoint(CheckpointCursor &cursor);
 
+    /**
+     * Move a cursor limited to some collections on to just before the next
+     * item of those collections in its checkpoint. The checkpoint_start and
+     * (for a closed checkpoint) checkpoint_end items aren't skipped.
+     */
+    void skipOtherCollections(CheckpointCursor& cursor);
+
+    /**
+     * If the given cursor is where the last DCP cursor to read items started
+     * from, and nothing has been queued since, give it the same items
+     * (moving it to where that read finished) instead of walking the
+     * checkpoints again. Streams which are caught up with each other hence
+     * share one read.
+     * @return true if the cursor was given the shared items.
+     */
+    bool getSharedItems_UNLOCKED(CheckpointCursor& cursor,
+                                 std::vector<queued_item>& items,
+                                 size_t approxLimit,
+                                 ItemsForCursor& result);
+
     /**
      * Check the current open checkpoint to see if we need to create the new open checkpoint.
      * @param forceCreation is to indicate if a new checkpoint is created due to online update or
@@ -465,15 +504,51 @@ protected:
     bool isCheckpointCreationForHighMemUsage_UNLOCKED(const LockHolder& lh,
                                                       const VBucket& vbucket);
 
+    /**
+     * @return true if the open checkpoint should be closed as it (or the
+     * checkpoints of the whole bucket) exceeds the configured memory budget.
+     */
+    bool isOpenCheckpointOverMemoryBudget_UNLOCKED(const LockHolder& lh) const;
+
+    /**
+     * Expel the items of the oldest checkpoint which all cursors have passed.
+     * @param expelled  The expelled items are moved to here, so they can be
+     *        freed after queueLock is released.
+     * @return the number of items expelled.
+     */
+    size_t expelUnreferencedCheckpointItems_UNLOCKED(
+            const LockHolder& lh, std::vector<queued_item>& expelled);
+
     void resetCursors(bool resetPersistenceCursor = true);
 
+    /**
+     * Record that items have been appended to a checkpoint (or cursors have
+     * been repositioned), invalidating the drainedVersion of all cursors.
+     * Must be called with queueLock held.
+     */
+    void publishAppend_UNLOCKED() {
+        appendVersion.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Checks, without acquiring queueLock, if the given cursor has nothing to
+     * read - i.e. it had already reached the end of the checkpoints and
+     * nothing has been appended since. Only possible (and hence only returns
+     * true) if CheckpointConfig::isLockFreeReaders().
+     */
+    bool isCursorDrained(const CheckpointCursor& cursor) const {
+        return checkpointConfig.isLockFreeReaders() &&
+               cursor.drainedVersion.load(std::memory_order_acquire) ==
+                       appendVersion.load(std::memory_order_acquire);
+    }
+
     queued_item createCheckpointItem(uint64_t id,
                                      Vbid vbid,
                                      queue_op checkpoint_op);
 
     EPStats                 &stats;
     CheckpointConfig        &checkpointConfig;
-    mutable std::mutex       queueLock;
+    mutable ProfiledMutex<>  queueLock;
     const Vbid vbucketId;
 
     // Total number of items (including meta items) in /all/ checkpoints managed
@@ -482,6 +557,10 @@ protected:
     Monotonic<int64_t>       lastBySeqno;
     uint64_t                 pCursorPreCheckpointId;
 
+    // Incremented (with queueLock held) by publishAppend_UNLOCKED(); read
+    // without the lock by isCursorDrained().
+    std::atomic<uint64_t> appendVersion{0};
+
     /**
      * connCursors: stores all known CheckpointCursor objects which are held via
      * shared_ptr. When a client creates a cursor we store the shared_ptr and
@@ -498,6 +577,23 @@ protected:
     Cursor pCursor;
     CheckpointCursor* persistenceCursor = nullptr;
 
+    /**
+     * The items last read by a DCP cursor (see getSharedItems_UNLOCKED()),
+     * with the positions (checkpoint id and CheckpointQueue::index()) the read
+     * started and finished at. Only valid while appendVersion is unchanged.
+     */
+    struct SharedRead {
+        uint64_t version = 0;
+        size_t approxLimit = 0;
+        uint64_t startCheckpointId = 0;
+        size_t startPos = 0;
+        uint64_t endCheckpointId = 0;
+        size_t endPos = 0;
+        std::vector<queued_item> items;
+        ItemsForCursor result;
+    };
+    std::unique_ptr<SharedRead> sharedRead;
+
     friend std::ostream& operator<<(std::ostream& os, const CheckpointManager& m);
 };
 
@@ -0,0 +1,234 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "item.h"
+
+#include <array>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/**
+ * The ordered sequence of items in a Checkpoint.
+ *
+ * Items are appended to fixed-size chunks (arrays of queued_item), so
+ * appending only allocates once per chunkSize items and advancing through
+ * the queue mostly walks contiguous memory.
+ *
+ * The queue is append-only: erase() (used when an item is de-duplicated or
+ * expelled) just releases the item and leaves its slot empty, and iterators skip empty
+ * slots. As such positions never move - an iterator to an item remains
+ * valid (and keeps referring to the same item) across any number of
+ * push_back()s and erase()s of other items. The exception is end(), which
+ * refers to the position the next item will be appended to and so must be
+ * re-obtained after a push_back().
+ *
+ * The first item must never be erased (a Checkpoint starts with a
+ * queue_op::empty item which is always present).
+ */
+class CheckpointQueue {
+    static constexpr size_t chunkShift = 6;
+
+public:
+    /// Number of items per chunk.
+    static constexpr size_t chunkSize = size_t(1) << chunkShift;
+
+    template <class Queue, class Value>
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = queued_item;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        Iterator() = default;
+
+        Iterator(Queue* queue, size_t index) : queue(queue), index(index) {
+        }
+
+        /// Allow conversion from iterator to const_iterator.
+        template <class OtherQueue, class OtherValue>
+        Iterator(const Iterator<OtherQueue, OtherValue>& other)
+            : queue(other.queue), index(other.index) {
+        }
+
+        reference operator*() const {
+            return queue->slot(index);
+        }
+
+        pointer operator->() const {
+            return &queue->slot(index);
+        }
+
+        Iterator& operator++() {
+            do {
+                ++index;
+            } while (index < queue->numSlots && !queue->slot(index));
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        Iterator& operator--() {
+            do {
+                --index;
+            } while (index > 0 && !queue->slot(index));
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            auto tmp = *this;
+            --*this;
+            return tmp;
+        }
+
+        template <class OtherQueue, class OtherValue>
+        bool operator==(const Iterator<OtherQueue, OtherValue>& other) const {
+            return index == other.index;
+        }
+
+        template <class OtherQueue, class OtherValue>
+        bool operator!=(const Iterator<OtherQueue, OtherValue>& other) const {
+            return index != other.index;
+        }
+
+        /// Positions are ordered by when their item was appended.
+        template <class OtherQueue, class OtherValue>
+        bool operator<(const Iterator<OtherQueue, OtherValue>& other) const {
+            return index < other.index;
+        }
+
+    private:
+        friend class CheckpointQueue;
+        template <class OtherQueue, class OtherValue>
+        friend class Iterator;
+
+        Queue* queue = nullptr;
+        size_t index = 0;
+    };
+
+    using iterator = Iterator<CheckpointQueue, queued_item>;
+    using const_iterator = Iterator<const CheckpointQueue, const queued_item>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    CheckpointQueue() = default;
+
+    // Iterators refer to the queue, so it cannot be copied or moved.
+    CheckpointQueue(const CheckpointQueue&) = delete;
+    CheckpointQueue& operator=(const CheckpointQueue&) = delete;
+
+    void push_back(const queued_item& qi) {
+        if ((numSlots & (chunkSize - 1)) == 0) {
+            chunks.push_back(std::make_unique<Chunk>());
+        }
+        slot(numSlots) = qi;
+        ++numSlots;
+        ++numItems;
+    }
+
+    /**
+     * Release the item at the given position, leaving its slot empty.
+     * Iterators to other items are unaffected; iterators to the erased item
+     * must not be used afterwards.
+     */
+    void erase(iterator pos) {
+        slot(pos.index).reset();
+        --numItems;
+    }
+
+    iterator begin() {
+        return {this, 0};
+    }
+
+    const_iterator begin() const {
+        return {this, 0};
+    }
+
+    iterator end() {
+        return {this, numSlots};
+    }
+
+    const_iterator end() const {
+        return {this, numSlots};
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    /**
+     * @return the position of the given iterator, counting every item
+     *         appended before it (including erased ones).
+     */
+    static size_t index(const_iterator pos) {
+        return pos.index;
+    }
+
+    /**
+     * @return an iterator to the given position (see index()), which is
+     *         empty (refers to no item) if that item was erased.
+     */
+    iterator at(size_t index) {
+        return {this, index};
+    }
+
+    /// @return the number of (non-erased) items.
+    size_t size() const {
+        return numItems;
+    }
+
+    bool empty() const {
+        return numItems == 0;
+    }
+
+private:
+    using Chunk = std::array<queued_item, chunkSize>;
+
+    queued_item& slot(size_t index) {
+        return (*chunks[index >> chunkShift])[index & (chunkSize - 1)];
+    }
+
+    const queued_item& slot(size_t index) const {
+        return (*chunks[index >> chunkShift])[index & (chunkSize - 1)];
+    }
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    /// Number of slots used (including those of erased items).
+    size_t numSlots = 0;
+    /// Number of (non-erased) items.
+    size_t numItems = 0;
+};
@@ -46,5 +46,34 @@ std::string PersistedStats::getLebEncodedStats() {
 
     return data;
 }
+
+PersistedStatsMap decodePersistedStats(const char* buf, size_t size) {
+    cb::const_byte_buffer remaining{
+            reinterpret_cast<uint8_t*>(const_cast<char*>(buf)), size};
+    PersistedStatsMap stats;
+    while (remaining.size() != 0) {
+        auto cid = cb::mcbp::decode_unsigned_leb128<uint32_t>(remaining);
+        auto itemCount =
+                cb::mcbp::decode_unsigned_leb128<uint64_t>(cid.second);
+        auto highSeqno =
+                cb::mcbp::decode_unsigned_leb128<uint64_t>(itemCount.second);
+        stats[cid.first] = {itemCount.first, highSeqno.first};
+        remaining = highSeqno.second;
+    }
+    return stats;
+}
+
+std::string encodePersistedStats(const PersistedStatsMap& stats) {
+    std::string data;
+    for (const auto& entry : stats) {
+        auto cid = cb::mcbp::unsigned_leb128<uint32_t>(uint32_t(entry.first));
+        data.append(cid.begin(), cid.end());
+        auto leb = cb::mcbp::unsigned_leb128<uint64_t>(entry.second.itemCount);
+        data.append(leb.begin(), leb.end());
+        leb = cb::mcbp::unsigned_leb128<uint64_t>(entry.second.highSeqno);
+        data.append(leb.begin(), leb.end());
+    }
+    return data;
+}
 } // end namespace VB
 } // end namespace Collections
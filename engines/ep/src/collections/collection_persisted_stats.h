@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include "collections/collections_types.h"
+
+#include <map>
 #include <string>
 
 namespace Collections {
@@ -45,5 +48,20 @@ struct PersistedStats {
     uint64_t itemCount;
     uint64_t highSeqno;
 };
+
+/**
+ * The persisted stats of all of a vbucket's collections, which are stored as
+ * one document.
+ */
+using PersistedStatsMap = std::map<CollectionID, PersistedStats>;
+
+/**
+ * Build from a buffer containing a LEB 128 encoded (collection-ID, itemCount,
+ * highSeqno) triple per collection
+ */
+PersistedStatsMap decodePersistedStats(const char* buf, size_t size);
+
+/// @return a LEB 128 encoded version of the stats ready for persistence
+std::string encodePersistedStats(const PersistedStatsMap& stats);
 } // end namespace VB
 } // end namespace Collections
@@ -48,6 +48,9 @@ const char CouchstoreManifest[] = "_local/collections_manifest";
 // Length of the string excluding the zero terminator (i.e. strlen)
 const size_t CouchstoreManifestLen = sizeof(CouchstoreManifest) - 1;
 
+// Couchstore private file name for the persisted stats of all collections
+const char CouchstoreCollectionStats[] = "_local/collections_stats";
+
 using ManifestUid = WeaklyMonotonic<uint64_t>;
 
 // Map used in summary stats
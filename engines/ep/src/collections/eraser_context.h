@@ -50,6 +50,14 @@ public:
         return manifest.lock(key, allowSystem);
     }
 
+    /**
+     * @return true if the key at the seqno belongs to a collection which is
+     *         being erased. Only such keys need passing to the eraser.
+     */
+    bool isLogicallyDeleted(const ::DocKey& key, int64_t seqno) const {
+        return manifest.lock().isLogicallyDeleted(key, seqno);
+    }
+
     bool needToUpdateCollectionsManifest() const {
         return collectionsErased > 0;
     }
@@ -44,16 +44,16 @@ void Collections::VB::Flush::saveDeletes(
     }
 }
 
-void Collections::VB::Flush::saveCollectionStats(
-        std::function<void(CollectionID, PersistedStats)> cb) const {
-    for (const auto c : mutated) {
-        uint64_t itemCount, highSeqno;
-        {
-            auto lock = manifest.lock();
-            itemCount = lock.getItemCount(c);
-            highSeqno = lock.getPersistedHighSeqno(c);
+void Collections::VB::Flush::updateCollectionStats(
+        PersistedStatsMap& stats) const {
+    {
+        auto lock = manifest.lock();
+        for (const auto c : mutated) {
+            stats[c] = {lock.getItemCount(c), lock.getPersistedHighSeqno(c)};
         }
-        cb(c, {itemCount, highSeqno});
+    }
+    for (const auto c : deletedCollections) {
+        stats.erase(c);
     }
 }
 
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "collections/collection_persisted_stats.h"
 #include "collections/collections_types.h"
 #include "item.h"
 
@@ -27,7 +28,6 @@ namespace Collections {
 namespace VB {
 
 class Manifest;
-struct PersistedStats;
 
 /**
  * The Collections::VB::Flush object maintains data used in a single run of the
@@ -67,11 +67,19 @@ public:
     void saveDeletes(std::function<void(CollectionID)> callback) const;
 
     /**
-     * Run the specified callback against the set of collections which have
-     * changed their item count during the run of the flusher.
+     * @return true if the run of the flusher changed the persisted stats of
+     *         any collection (including by deleting it).
      */
-    void saveCollectionStats(
-            std::function<void(CollectionID, PersistedStats)> cb) const;
+    bool isCollectionStatsChanged() const {
+        return !mutated.empty() || !deletedCollections.empty();
+    }
+
+    /**
+     * Update the persisted stats of all collections with those of the
+     * collections which changed during the run of the flusher, removing the
+     * collections which were deleted; so they can be saved as one document.
+     */
+    void updateCollectionStats(PersistedStatsMap& stats) const;
 
     /**
      * Increment the 'disk' count for the collection associated with the key
@@ -241,6 +241,20 @@ bool Filter::empty() const {
     return (filter.empty() && !defaultAllowed);
 }
 
+boost::optional<std::vector<CollectionID>> Filter::getFixedCollections()
+        const {
+    if (passthrough || scopeID) {
+        return {};
+    }
+
+    std::vector<CollectionID> collections(filter.begin(), filter.end());
+    if (defaultAllowed) {
+        collections.push_back(CollectionID::Default);
+    }
+    collections.push_back(CollectionID::System);
+    return collections;
+}
+
 bool Filter::checkAndUpdateSystemEvent(const Item& item) {
     switch (SystemEvent(item.getFlags())) {
     case SystemEvent::Collection:
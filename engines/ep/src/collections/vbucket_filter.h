@@ -28,6 +28,7 @@
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 class SystemEventMessage;
 
@@ -151,6 +152,14 @@ public:
         return passthrough;
     }
 
+    /**
+     * @return the collections whose items (including system events, of the
+     *         System collection) this filter may allow; or none if that isn't
+     *         a fixed set - a passthrough filter, or a scope filter (which
+     *         gains the collections created in the scope).
+     */
+    boost::optional<std::vector<CollectionID>> getFixedCollections() const;
+
     bool allowDefaultCollection() const {
         return defaultAllowed;
     }
@@ -1084,6 +1084,27 @@ void Manifest::updateSummary(Summary& summary) const {
     }
 }
 
+size_t Manifest::getMemorySize() const {
+    // Each map node holds the value and the next pointer (plus the cached
+    // hash), each list node the value and two pointers.
+    return sizeof(Manifest) + map.bucket_count() * sizeof(void*) +
+           map.size() * (sizeof(container::value_type) + 2 * sizeof(void*)) +
+           scopes.size() * (sizeof(ScopeID) + 2 * sizeof(void*));
+}
+
+void Manifest::updateMemUsed(CollectionID collection, int64_t delta) const {
+    auto itr = map.find(collection);
+    if (itr != map.end()) {
+        itr->second.updateMemUsed(delta);
+    }
+}
+
+void Manifest::updateMemUsedSummary(Summary& summary) const {
+    for (const auto& entry : map) {
+        summary[entry.first] += entry.second.getMemUsed();
+    }
+}
+
 boost::optional<std::vector<CollectionID>> Manifest::getCollectionsForScope(
         ScopeID identifier) const {
     if (std::find(scopes.begin(), scopes.end(), identifier) == scopes.end()) {
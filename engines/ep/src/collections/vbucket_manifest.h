@@ -20,6 +20,7 @@
 #include "collections/collections_types.h"
 #include "collections/manifest.h"
 #include "collections/vbucket_manifest_entry.h"
+#include "sharded_rwlock.h"
 #include "systemevent.h"
 
 #include <platform/non_negative_counter.h>
@@ -87,8 +88,8 @@ public:
          */
         ReadHandle() = default;
 
-        ReadHandle(const Manifest* m, cb::RWLock& lock)
-            : readLock(lock), manifest(m) {
+        ReadHandle(const Manifest* m, ShardedRWLock& lock)
+            : readLock(lock.reader()), manifest(m) {
         }
 
         ReadHandle(ReadHandle&& rhs)
@@ -196,6 +197,18 @@ public:
             manifest->updateSummary(summary);
         }
 
+        void updateMemUsed(CollectionID collection, int64_t delta) const {
+            manifest->updateMemUsed(collection, delta);
+        }
+
+        void updateMemUsedSummary(Summary& summary) const {
+            manifest->updateMemUsedSummary(summary);
+        }
+
+        size_t getMemorySize() const {
+            return manifest->getMemorySize();
+        }
+
         void populateWithSerialisedData(
                 flatbuffers::FlatBufferBuilder& builder) const {
             manifest->populateWithSerialisedData(builder, {});
@@ -255,7 +268,7 @@ public:
          *        should not be allowed, whereas a disk backfill is allowed
          */
         CachingReadHandle(const Manifest* m,
-                          cb::RWLock& lock,
+                          ShardedRWLock& lock,
                           DocKey key,
                           bool allowSystem)
             : ReadHandle(m, lock),
@@ -439,7 +452,7 @@ public:
      */
     class WriteHandle {
     public:
-        WriteHandle(Manifest& m, cb::RWLock& lock)
+        WriteHandle(Manifest& m, ShardedRWLock& lock)
             : writeLock(lock), manifest(m) {
         }
 
@@ -570,7 +583,7 @@ public:
         }
 
     private:
-        std::unique_lock<cb::WriterLock> writeLock;
+        std::unique_lock<ShardedRWLock> writeLock;
         Manifest& manifest;
     };
 
@@ -1032,6 +1045,24 @@ protected:
 
     void updateSummary(Summary& summary) const;
 
+    /**
+     * @return an estimate of the memory used by this VB::Manifest - the
+     * object itself plus the nodes of its collection map and scope list.
+     */
+    size_t getMemorySize() const;
+
+    /**
+     * Adjust the memory used by the given collection's items. Unknown
+     * collections are ignored - their items are being (or have been) purged.
+     */
+    void updateMemUsed(CollectionID collection, int64_t delta) const;
+
+    /**
+     * Add the memory used by each collection's items to the summary (a map
+     * of CollectionID to bytes)
+     */
+    void updateMemUsedSummary(Summary& summary) const;
+
     /**
      * Add a collection entry to the manifest specifing the revision that it was
      * seen in and the sequence number span covering it.
@@ -1258,9 +1289,11 @@ protected:
     ManifestUid manifestUid{0};
 
     /**
-     * shared lock to allow concurrent readers and safe updates
+     * shared lock to allow concurrent readers and safe updates. Every key
+     * based front-end operation takes it for read, so it is sharded to stop
+     * the readers all bouncing the same cache line between cores.
      */
-    mutable cb::RWLock rwlock;
+    mutable ShardedRWLock rwlock;
 
     friend std::ostream& operator<<(std::ostream& os, const Manifest& manifest);
 
@@ -66,6 +66,12 @@ bool Collections::VB::ManifestEntry::addStats(const std::string& cid,
                          vbid.get(),
                          cid.c_str());
         add_casted_stat(buffer, getDiskCount(), add_stat, cookie);
+        checked_snprintf(buffer,
+                         bsize,
+                         "vb_%d:collection:%s:entry:mem_used",
+                         vbid.get(),
+                         cid.c_str());
+        add_casted_stat(buffer, getMemUsed(), add_stat, cookie);
 
         if (getMaxTtl()) {
             checked_snprintf(buffer,
@@ -93,7 +99,8 @@ std::ostream& Collections::VB::operator<<(
        << ", startSeqno:" << manifestEntry.getStartSeqno()
        << ", endSeqno:" << manifestEntry.getEndSeqno()
        << ", persistedHighSeqno:" << manifestEntry.getPersistedHighSeqno()
-       << ", diskCount:" << manifestEntry.getDiskCount();
+       << ", diskCount:" << manifestEntry.getDiskCount()
+       << ", memUsed:" << manifestEntry.getMemUsed();
 
     if (manifestEntry.getMaxTtl()) {
         os << ", maxTtl:" << manifestEntry.getMaxTtl().get().count();
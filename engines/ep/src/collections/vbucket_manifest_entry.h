@@ -48,7 +48,8 @@ public:
           scopeID(scopeID),
           maxTtl(maxTtl),
           diskCount(0),
-          persistedHighSeqno(0) {
+          persistedHighSeqno(0),
+          memUsed(0) {
         // Setters validate the start/end range is valid
         setStartSeqno(startSeqno);
         setEndSeqno(endSeqno);
@@ -162,6 +163,21 @@ public:
         return persistedHighSeqno;
     }
 
+    /// adjust how much memory the collection's items use (in this vbucket)
+    void updateMemUsed(int64_t delta) const {
+        memUsed.fetch_add(delta);
+    }
+
+    /// set how much memory the collection's items use (in this vbucket)
+    void setMemUsed(size_t value) const {
+        memUsed = value;
+    }
+
+    /// @return how much memory the collection's items use (in this vbucket)
+    size_t getMemUsed() const {
+        return memUsed;
+    }
+
     /// @return true if successfully added stats, false otherwise
     bool addStats(const std::string& cid,
                   Vbid vbid,
@@ -230,6 +246,15 @@ private:
      *           The write lock is really for the Manifest map being changed.
      */
     mutable uint64_t persistedHighSeqno;
+
+    /**
+     * The memory used by the collection's items in the HashTable, as
+     * accounted by HashTable::Statistics.
+     *
+     * mutable/atomic - updated with only the read lock held by any thread
+     *                  modifying a StoredValue of the collection.
+     */
+    mutable cb::NonNegativeCounter<size_t> memUsed;
 };
 
 std::ostream& operator<<(std::ostream& os, const ManifestEntry& manifestEntry);
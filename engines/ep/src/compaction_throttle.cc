@@ -0,0 +1,88 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "compaction_throttle.h"
+
+#include <algorithm>
+
+const std::chrono::milliseconds CompactionThrottle::MaxBurst{100};
+const std::chrono::seconds CompactionThrottle::SampleInterval{1};
+const size_t CompactionThrottle::MaxBackoffLevel;
+
+CompactionThrottle::CompactionThrottle(size_t maxBytesPerSec,
+                                       std::chrono::microseconds backoffLatency)
+    : maxRate(maxBytesPerSec), backoffLatency(backoffLatency.count()) {
+}
+
+std::chrono::microseconds CompactionThrottle::acquire(
+        size_t bytes, std::chrono::steady_clock::time_point now) {
+    const size_t rate = getRate();
+    if (rate == 0) {
+        return std::chrono::microseconds(0);
+    }
+
+    std::lock_guard<std::mutex> lh(mutex);
+    // Time not spent on I/O doesn't build up into a larger burst.
+    paidUntil = std::max(paidUntil, now);
+    paidUntil += std::chrono::microseconds(uint64_t(bytes) * 1000000 / rate);
+    const auto ahead = paidUntil - now - MaxBurst;
+    if (ahead.count() <= 0) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(ahead);
+}
+
+void CompactionThrottle::sampleBgFetches(
+        std::chrono::steady_clock::time_point now,
+        uint64_t totalWait,
+        uint64_t totalFetches) {
+    if (maxRate == 0 || backoffLatency == 0) {
+        backoffLevel = 0;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lh(mutex);
+    if (now - lastSample < SampleInterval) {
+        return;
+    }
+    lastSample = now;
+    // The totals go back to zero when the stats are reset.
+    const uint64_t wait = totalWait >= lastWait ? totalWait - lastWait : 0;
+    const uint64_t fetches =
+            totalFetches >= lastFetches ? totalFetches - lastFetches : 0;
+    lastWait = totalWait;
+    lastFetches = totalFetches;
+
+    if (fetches && wait / fetches > backoffLatency) {
+        if (backoffLevel < MaxBackoffLevel) {
+            ++backoffLevel;
+        }
+    } else if (backoffLevel > 0) {
+        --backoffLevel;
+    }
+}
+
+size_t CompactionThrottle::getRate() const {
+    return maxRate >> backoffLevel;
+}
+
+void CompactionThrottle::setMaxRate(size_t bytesPerSec) {
+    maxRate = bytesPerSec;
+}
+
+void CompactionThrottle::setBackoffLatency(std::chrono::microseconds latency) {
+    backoffLatency = latency.count();
+}
@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Limits the rate at which the compactions of a bucket copy data, and backs
+ * that rate off while front end background fetches are slowed down.
+ *
+ * Compactions report the size of each document they copy to acquire(),
+ * which returns how long the compaction should wait first to stay within
+ * the rate - all running compactions of the bucket share the one limit.
+ * Bursts of up to MaxBurst worth of data are let through without waiting.
+ *
+ * With a backoff latency set, the average background fetch wait time is
+ * sampled every SampleInterval: each sample over the latency halves the
+ * rate (down to 1 / 2^MaxBackoffLevel of it), each sample under it doubles
+ * it back towards the configured rate. Backing off only applies with a rate
+ * set; without one compaction isn't throttled at all.
+ */
+class CompactionThrottle {
+public:
+    /**
+     * @param maxBytesPerSec the rate limit; zero disables throttling
+     * @param backoffLatency the average background fetch wait time above
+     *        which to back off; zero disables backing off
+     */
+    CompactionThrottle(size_t maxBytesPerSec,
+                       std::chrono::microseconds backoffLatency);
+
+    /**
+     * Account for the given amount of compaction I/O.
+     *
+     * @param bytes the size of the data about to be copied
+     * @param now the current time
+     * @return how long the caller should wait before copying it
+     */
+    std::chrono::microseconds acquire(size_t bytes,
+                                      std::chrono::steady_clock::time_point now);
+
+    /**
+     * Take a sample of the background fetch wait time, if SampleInterval
+     * has passed since the last one.
+     *
+     * @param now the current time
+     * @param totalWait the total background fetch wait time so far (usec)
+     * @param totalFetches the number of background fetches so far
+     */
+    void sampleBgFetches(std::chrono::steady_clock::time_point now,
+                         uint64_t totalWait,
+                         uint64_t totalFetches);
+
+    /// @returns the current rate limit in bytes/sec, zero if unlimited.
+    size_t getRate() const;
+
+    /// @returns how many times the rate is currently halved.
+    size_t getBackoffLevel() const {
+        return backoffLevel;
+    }
+
+    void setMaxRate(size_t bytesPerSec);
+
+    void setBackoffLatency(std::chrono::microseconds latency);
+
+    static const std::chrono::milliseconds MaxBurst;
+    static const std::chrono::seconds SampleInterval;
+    static const size_t MaxBackoffLevel = 4;
+
+private:
+    std::atomic<size_t> maxRate;
+    std::atomic<uint64_t> backoffLatency; // usec
+    std::atomic<size_t> backoffLevel{0};
+
+    std::mutex mutex;
+    // When the I/O accounted so far is paid off at the current rate.
+    std::chrono::steady_clock::time_point paidUntil;
+    std::chrono::steady_clock::time_point lastSample;
+    uint64_t lastWait = 0;
+    uint64_t lastFetches = 0;
+};
@@ -0,0 +1,64 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "compressibility_tracker.h"
+
+bool CompressibilityTracker::shouldAttempt(CollectionID cid) {
+    std::lock_guard<std::mutex> lh(mutex);
+    const auto iter = collections.find(cid);
+    if (iter == collections.end() || !iter->second.isFutile()) {
+        return true;
+    }
+
+    auto& entry = iter->second;
+    if (++entry.skipped < ProbeInterval) {
+        ++numSkipped;
+        return false;
+    }
+    entry.skipped = 0;
+    return true;
+}
+
+void CompressibilityTracker::recordAttempt(CollectionID cid,
+                                           bool compressed) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto& entry = collections[cid];
+    ++entry.attempts;
+    if (compressed) {
+        ++entry.compressed;
+    }
+    if (entry.attempts >= Window) {
+        entry.attempts /= 2;
+        entry.compressed /= 2;
+    }
+}
+
+bool CompressibilityTracker::isFutile(CollectionID cid) const {
+    std::lock_guard<std::mutex> lh(mutex);
+    const auto iter = collections.find(cid);
+    return iter != collections.end() && iter->second.isFutile();
+}
+
+void CompressibilityTracker::reset() {
+    std::lock_guard<std::mutex> lh(mutex);
+    collections.clear();
+}
+
+size_t CompressibilityTracker::getNumSkipped() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return numSkipped;
+}
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memcached/dockey.h>
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * Learns how well the documents of each collection compress, so the
+ * compressors (ItemCompressorVisitor, and the PagingVisitor when it
+ * compresses instead of evicting) can skip collections whose documents
+ * (nearly) never meet the minimum compression ratio, rather than
+ * compressing each of them only to throw the result away. Collections
+ * holding already compressed binary data are the typical case.
+ *
+ * For every collection the outcome of recent compression attempts is
+ * recorded (halving the counts every Window attempts so old results fade
+ * out). Once at least MinAttempts have been made, a collection where fewer
+ * than one in FutileRatio attempts succeeded is considered futile, and
+ * only one in ProbeInterval of its documents is attempted, which lets it
+ * be reconsidered if its documents change.
+ *
+ * Thread-safe.
+ */
+class CompressibilityTracker {
+public:
+    /**
+     * Should compressing a document of the given collection be attempted?
+     * Counts the documents skipped.
+     */
+    bool shouldAttempt(CollectionID cid);
+
+    /**
+     * Record the outcome of an attempt to compress a document of the given
+     * collection
+     *
+     * @param compressed true if the document met the compression ratio
+     */
+    void recordAttempt(CollectionID cid, bool compressed);
+
+    /// @return true if attempts for the collection are currently skipped
+    bool isFutile(CollectionID cid) const;
+
+    /// Forget everything learnt (e.g. as the compression ratio changed)
+    void reset();
+
+    /// @return how many documents shouldAttempt() said to skip
+    size_t getNumSkipped() const;
+
+    static const size_t Window = 1024;
+    static const size_t MinAttempts = 32;
+    static const size_t FutileRatio = 16;
+    static const size_t ProbeInterval = 64;
+
+private:
+    struct Entry {
+        bool isFutile() const {
+            return attempts >= MinAttempts &&
+                   compressed * FutileRatio < attempts;
+        }
+
+        size_t attempts = 0;
+        size_t compressed = 0;
+        /// Documents skipped since the last probe
+        size_t skipped = 0;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<CollectionID, Entry> collections;
+    size_t numSkipped = 0;
+};
@@ -87,6 +87,20 @@ void ConnNotifier::notifyMutationEvent(void) {
 }
 
 bool ConnNotifier::notifyConnections() {
+    const std::chrono::microseconds window(coalesceWindow.load());
+    if (window.count() != 0) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < lastRun + window) {
+            // Ran recently; leave pendingNotification set (so no further
+            // wakeups) and process everything notified until the window
+            // ends in one go.
+            std::chrono::duration<double> remaining = lastRun + window - now;
+            ExecutorPool::get()->snooze(task, remaining.count());
+            return true;
+        }
+        lastRun = now;
+    }
+
     bool inverse = true;
     pendingNotification.compare_exchange_strong(inverse, false);
     connMap.processPendingNotifications();
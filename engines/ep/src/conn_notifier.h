@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 
 class ConnMap;
@@ -37,10 +38,25 @@ public:
 
     void notifyMutationEvent();
 
+    /**
+     * Notify the pending connections. With a coalesce window set the
+     * notifier runs at most once per window; notifications arriving within
+     * the window of the previous run are processed together at its end.
+     */
     bool notifyConnections();
 
+    /// Set how long notifications are coalesced for (0 disables).
+    void setCoalesceWindow(std::chrono::microseconds window) {
+        coalesceWindow = window.count();
+    }
+
 private:
     ConnMap& connMap;
     std::atomic<size_t> task;
     std::atomic<bool> pendingNotification;
+    // dcp_conn_notifier_coalesce_us
+    std::atomic<uint64_t> coalesceWindow{0};
+    // When notifyConnections last processed the notifications (only
+    // accessed by the notifier task).
+    std::chrono::steady_clock::time_point lastRun;
 };
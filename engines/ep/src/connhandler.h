@@ -45,7 +45,8 @@ struct ConnCounter {
         : conn_queue(0), totalConns(0), totalProducers(0),
           conn_queueFill(0), conn_queueDrain(0), conn_totalBytes(0),
           conn_totalUncompressedDataSize(0), conn_queueRemaining(0),
-          conn_queueBackoff(0), conn_queueItemOnDisk(0)
+          conn_queueBackoff(0), conn_queueItemOnDisk(0),
+          conn_bufferedBytes(0), conn_backfillBytes(0)
     {}
 
     ConnCounter& operator+=(const ConnCounter& other) {
@@ -59,6 +60,8 @@ struct ConnCounter {
         conn_queueRemaining += other.conn_queueRemaining;
         conn_queueBackoff += other.conn_queueBackoff;
         conn_queueItemOnDisk += other.conn_queueItemOnDisk;
+        conn_bufferedBytes += other.conn_bufferedBytes;
+        conn_backfillBytes += other.conn_backfillBytes;
 
         return *this;
     }
@@ -74,6 +77,10 @@ struct ConnCounter {
     size_t      conn_queueRemaining;
     size_t      conn_queueBackoff;
     size_t      conn_queueItemOnDisk;
+    //! Bytes of messages held in stream readyQs and consumer buffers
+    size_t      conn_bufferedBytes;
+    //! Bytes read by backfills but not yet sent
+    size_t      conn_backfillBytes;
 };
 
 class ConnHandler {
@@ -305,6 +312,21 @@ public:
         paused.store(false);
     }
 
+    /**
+     * Mark that a notification of this connection is queued for the
+     * ConnNotifier.
+     *
+     * @return true if one wasn't already queued (and so should be).
+     */
+    bool setNotificationPending() {
+        bool expected = false;
+        return notificationPending.compare_exchange_strong(expected, true);
+    }
+
+    void clearNotificationPending() {
+        notificationPending.store(false);
+    }
+
 protected:
     EventuallyPersistentEngine &engine_;
     EPStats &stats;
@@ -337,6 +359,9 @@ private:
 
     //! Description of why the connection is paused.
     std::atomic<PausedReason> reason;
+
+    //! Is a notification queued in ConnMap::pendingNotifications?
+    std::atomic<bool> notificationPending{false};
 };
 
 std::string to_string(ConnHandler::PausedReason r);
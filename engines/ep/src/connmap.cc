@@ -98,6 +98,8 @@ ConnMap::ConnMap(EventuallyPersistentEngine &theEngine)
 
 void ConnMap::initialize() {
     connNotifier_ = std::make_shared<ConnNotifier>(*this);
+    connNotifier_->setCoalesceWindow(std::chrono::microseconds(
+            engine.getConfiguration().getDcpConnNotifierCoalesceUs()));
     connNotifier_->start();
     ExTask connMgr = std::make_shared<ConnManager>(&engine, this);
     ExecutorPool::get()->schedule(connMgr);
@@ -127,7 +129,11 @@ void ConnMap::addConnectionToPending(const std::shared_ptr<ConnHandler>& conn) {
         return;
     }
 
-    if (conn.get() && conn->isPaused() && conn->isReserved()) {
+    // Only queue the connection once until the ConnNotifier gets to it;
+    // however many mutations arrive in the meantime a single wakeup is
+    // enough.
+    if (conn.get() && conn->isPaused() && conn->isReserved() &&
+        conn->setNotificationPending()) {
         pendingNotifications.push(conn);
         if (connNotifier_) {
             // Wake up the connection notifier so that
@@ -153,8 +159,13 @@ void ConnMap::processPendingNotifications() {
 
     while (!queue.empty()) {
         auto& conn = queue.front();
-        if (conn.get() && conn->isPaused() && conn->isReserved()) {
-            engine.notifyIOComplete(conn->getCookie(), ENGINE_SUCCESS);
+        if (conn.get()) {
+            // Cleared before notifying, so a mutation arriving after this
+            // notification queues another.
+            conn->clearNotificationPending();
+            if (conn->isPaused() && conn->isReserved()) {
+                engine.notifyIOComplete(conn->getCookie(), ENGINE_SUCCESS);
+            }
         }
         queue.pop();
     }
@@ -23,9 +23,16 @@
 
 #include <platform/histogram.h>
 
+#include <algorithm>
+#include <cstring>
+
 std::unique_ptr<FileOpsInterface> getCouchstoreStatsOps(
-    FileStats& stats, FileOpsInterface& base_ops) {
-    return std::unique_ptr<FileOpsInterface>(new StatsOps(stats, base_ops));
+        FileStats& stats,
+        FileOpsInterface& base_ops,
+        size_t writeCombineSize,
+        size_t readAheadSize) {
+    return std::unique_ptr<FileOpsInterface>(
+            new StatsOps(stats, base_ops, writeCombineSize, readAheadSize));
 }
 
 StatsOps::StatFile::StatFile(FileOpsInterface* _orig_ops,
@@ -61,12 +68,14 @@ couchstore_error_t StatsOps::open(couchstore_error_info_t* errinfo,
     StatFile* sf = reinterpret_cast<StatFile*>(*h);
     sf->read_count_since_open = 0;
     sf->write_count_since_open = 0;
+    sf->read_ahead.clear();
     return sf->orig_ops->open(errinfo, &sf->orig_handle, path, flags);
 }
 
 couchstore_error_t StatsOps::close(couchstore_error_info_t* errinfo,
                                    couch_file_handle h) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    const auto flushed = flushPending(errinfo, sf);
     // Add to histograms - we can have zero read (open, goto_eof and close for
     // size; or on error); or zero write (read-only activity) - so only added if
     // counts are non-zero.
@@ -77,7 +86,8 @@ couchstore_error_t StatsOps::close(couchstore_error_info_t* errinfo,
         stats.writeCountHisto.add(sf->write_count_since_open);
     }
 
-    return sf->orig_ops->close(errinfo, sf->orig_handle);
+    const auto closed = sf->orig_ops->close(errinfo, sf->orig_handle);
+    return flushed != COUCHSTORE_SUCCESS ? flushed : closed;
 }
 
 couchstore_error_t StatsOps::set_periodic_sync(couch_file_handle h,
@@ -92,6 +102,52 @@ ssize_t StatsOps::pread(couchstore_error_info_t* errinfo,
                         size_t sz,
                         cs_off_t off) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    const auto flushed = flushPending(errinfo, sf);
+    if (flushed != COUCHSTORE_SUCCESS) {
+        return flushed;
+    }
+    if (sz >= readAheadSize) {
+        return readThrough(errinfo, sf, buf, sz, off);
+    }
+
+    // Serve the read from the read-ahead buffer if it holds all of it,
+    // otherwise refill the buffer from the read's offset.
+    const auto bufferEnd =
+            sf->read_ahead_offs + cs_off_t(sf->read_ahead.size());
+    if (off < sf->read_ahead_offs || off + cs_off_t(sz) > bufferEnd) {
+        sf->read_ahead.resize(readAheadSize);
+        const auto result = readThrough(errinfo,
+                                        sf,
+                                        sf->read_ahead.data(),
+                                        readAheadSize,
+                                        off);
+        if (result < 0) {
+            sf->read_ahead.clear();
+            return result;
+        }
+        sf->read_ahead.resize(result);
+        sf->read_ahead_offs = off;
+    }
+
+    // A short read-ahead (at the end of the file) may not cover all of it.
+    const auto available = size_t(
+            std::max(cs_off_t(0),
+                     sf->read_ahead_offs + cs_off_t(sf->read_ahead.size()) -
+                             off));
+    const auto result = std::min(sz, available);
+    if (result > 0) {
+        std::memcpy(buf,
+                    sf->read_ahead.data() + (off - sf->read_ahead_offs),
+                    result);
+    }
+    return result;
+}
+
+ssize_t StatsOps::readThrough(couchstore_error_info_t* errinfo,
+                              StatFile* sf,
+                              void* buf,
+                              size_t sz,
+                              cs_off_t off) {
     stats.readSizeHisto.add(sz);
     if(sf->last_offs) {
         stats.readSeekHisto.add(std::abs(off - sf->last_offs));
@@ -113,10 +169,44 @@ ssize_t StatsOps::pwrite(couchstore_error_info_t*errinfo,
                          size_t sz,
                          cs_off_t off) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    sf->read_ahead.clear();
+    if (writeCombineSize == 0) {
+        return writeThrough(errinfo, sf, buf, sz, off);
+    }
+
+    // Write out what we have if this write doesn't continue on from it, or
+    // wouldn't fit.
+    if (!sf->pending.empty() &&
+        (off != sf->pending_offs + cs_off_t(sf->pending.size()) ||
+         sf->pending.size() + sz > writeCombineSize)) {
+        const auto flushed = flushPending(errinfo, sf);
+        if (flushed != COUCHSTORE_SUCCESS) {
+            return flushed;
+        }
+    }
+    if (sz >= writeCombineSize) {
+        return writeThrough(errinfo, sf, buf, sz, off);
+    }
+
+    if (sf->pending.empty()) {
+        sf->pending_offs = off;
+    }
+    const auto* data = static_cast<const char*>(buf);
+    sf->pending.insert(sf->pending.end(), data, data + sz);
+    ++sf->pending_writes;
+    return sz;
+}
+
+ssize_t StatsOps::writeThrough(couchstore_error_info_t* errinfo,
+                               StatFile* sf,
+                               const void* buf,
+                               size_t sz,
+                               cs_off_t off) {
     stats.writeSizeHisto.add(sz);
     BlockTimer bt(&stats.writeTimeHisto);
     ssize_t result = sf->orig_ops->pwrite(errinfo, sf->orig_handle, buf,
                                           sz, off);
+    ++stats.totalWriteSyscalls;
     if (result > 0) {
         stats.totalBytesWritten += result;
         ++sf->write_count_since_open;
@@ -124,15 +214,43 @@ ssize_t StatsOps::pwrite(couchstore_error_info_t*errinfo,
     return result;
 }
 
+couchstore_error_t StatsOps::flushPending(couchstore_error_info_t* errinfo,
+                                          StatFile* sf) {
+    if (sf->pending.empty()) {
+        return COUCHSTORE_SUCCESS;
+    }
+    const auto result = writeThrough(errinfo,
+                                     sf,
+                                     sf->pending.data(),
+                                     sf->pending.size(),
+                                     sf->pending_offs);
+    const auto expected = ssize_t(sf->pending.size());
+    stats.totalWritesCombined += sf->pending_writes - 1;
+    sf->pending.clear();
+    sf->pending_writes = 0;
+    if (result < 0) {
+        return couchstore_error_t(result);
+    }
+    return result == expected ? COUCHSTORE_SUCCESS : COUCHSTORE_ERROR_WRITE;
+}
+
 cs_off_t StatsOps::goto_eof(couchstore_error_info_t* errinfo,
                             couch_file_handle h) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    const auto flushed = flushPending(errinfo, sf);
+    if (flushed != COUCHSTORE_SUCCESS) {
+        return flushed;
+    }
     return sf->orig_ops->goto_eof(errinfo, sf->orig_handle);
 }
 
 couchstore_error_t StatsOps::sync(couchstore_error_info_t* errinfo,
                                   couch_file_handle h) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    const auto flushed = flushPending(errinfo, sf);
+    if (flushed != COUCHSTORE_SUCCESS) {
+        return flushed;
+    }
     BlockTimer bt(&stats.syncTimeHisto);
     return sf->orig_ops->sync(errinfo, sf->orig_handle);
 }
@@ -143,6 +261,10 @@ couchstore_error_t StatsOps::advise(couchstore_error_info_t* errinfo,
                                     cs_off_t len,
                                     couchstore_file_advice_t adv) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    const auto flushed = flushPending(errinfo, sf);
+    if (flushed != COUCHSTORE_SUCCESS) {
+        return flushed;
+    }
     return sf->orig_ops->advise(errinfo, sf->orig_handle, offs, len, adv);
 }
 
@@ -154,6 +276,9 @@ FileOpsInterface::FHStats* StatsOps::get_stats(couch_file_handle h) {
 
 void StatsOps::destructor(couch_file_handle h) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    // Normally close() has already written everything.
+    couchstore_error_info_t errinfo;
+    flushPending(&errinfo, sf);
     sf->orig_ops->destructor(sf->orig_handle);
     delete sf;
 }
@@ -21,6 +21,7 @@
 
 #include <atomic>
 #include <memory>
+#include <vector>
 
 #include <libcouchstore/couch_db.h>
 #include <platform/histogram.h>
@@ -32,17 +33,40 @@ struct FileStats;
  * a reference to a base FileOps implementation to wrap
  */
 std::unique_ptr<FileOpsInterface> getCouchstoreStatsOps(
-    FileStats& stats, FileOpsInterface& base_ops);
+        FileStats& stats,
+        FileOpsInterface& base_ops,
+        size_t writeCombineSize = 0,
+        size_t readAheadSize = 0);
 
 /**
  * FileOpsInterface implementation which records various statistics
  * about OS-level file operations performed by Couchstore.
+ *
+ * Optionally it also combines writes: pwrite()s which continue on from the
+ * previous one are appended to a per-file buffer of up to writeCombineSize
+ * bytes, which is written with a single pwrite() of the wrapped ops when a
+ * non-contiguous write arrives, the buffer fills, or before any other
+ * operation on the file (so reads, the EOF and sync() all see the buffered
+ * data). An error writing the buffer is returned by the operation which
+ * triggered it.
+ *
+ * Optionally it also reads ahead: a pread() smaller than readAheadSize which
+ * misses the per-file read-ahead buffer reads readAheadSize bytes from its
+ * offset into the buffer, and later preads within the buffer are served
+ * from it. As couchstore files are append-only, data once read never
+ * changes; the buffer is still dropped on any write to the file.
  */
 class StatsOps : public FileOpsInterface {
 public:
-    StatsOps(FileStats& _stats, FileOpsInterface& ops)
+    StatsOps(FileStats& _stats,
+             FileOpsInterface& ops,
+             size_t writeCombineSize = 0,
+             size_t readAheadSize = 0)
         : stats(_stats),
-          wrapped_ops(ops) {}
+          wrapped_ops(ops),
+          writeCombineSize(writeCombineSize),
+          readAheadSize(readAheadSize) {
+    }
 
     couch_file_handle constructor(couchstore_error_info_t* errinfo) override ;
     couchstore_error_t open(couchstore_error_info_t* errinfo,
@@ -72,6 +96,10 @@ public:
 protected:
     FileStats& stats;
     FileOpsInterface& wrapped_ops;
+    // Max bytes of contiguous writes to combine; 0 disables combining.
+    const size_t writeCombineSize;
+    // Bytes to read at a time; 0 disables read-ahead.
+    const size_t readAheadSize;
 
     struct StatFile : public FileOpsInterface::FHStats {
         StatFile(FileOpsInterface* _orig_ops,
@@ -89,5 +117,33 @@ protected:
         size_t read_count_since_open;
         /// Number of write() calls against this file since it was last opened.
         size_t write_count_since_open;
+
+        /// Data of combined writes not yet written, and where it goes.
+        std::vector<char> pending;
+        cs_off_t pending_offs = 0;
+        /// Number of pwrite() calls combined into pending.
+        size_t pending_writes = 0;
+
+        /// Data read ahead, and where it was read from.
+        std::vector<char> read_ahead;
+        cs_off_t read_ahead_offs = 0;
     };
+
+    /// Write buf through the wrapped ops, recording stats.
+    ssize_t writeThrough(couchstore_error_info_t* errinfo,
+                         StatFile* sf,
+                         const void* buf,
+                         size_t nbytes,
+                         cs_off_t offset);
+
+    /// Read from the file through the wrapped ops, recording stats.
+    ssize_t readThrough(couchstore_error_info_t* errinfo,
+                        StatFile* sf,
+                        void* buf,
+                        size_t nbytes,
+                        cs_off_t offset);
+
+    /// Write any combined writes of the file.
+    couchstore_error_t flushPending(couchstore_error_info_t* errinfo,
+                                    StatFile* sf);
 };
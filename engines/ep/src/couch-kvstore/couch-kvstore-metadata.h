@@ -17,10 +17,12 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <type_traits>
 
 #include <libcouchstore/couch_common.h>
+#include <mcbp/protocol/unsigned_leb128.h>
 #include <memcached/protocol_binary.h>
 #include "item.h"
 
@@ -207,7 +209,7 @@ public:
     enum class Version {
         V0, // Cas/Exptime/Flags
         V1, // Flex code and datatype
-        V2  // Conflict Resolution Mode - not stored, but can be read
+        V2, // Conflict Resolution Mode - not stored, but can be read
         /*
          * !!MetaData Warning!!
          * Sherlock began storing the V2 MetaData.
@@ -216,8 +218,26 @@ public:
          * Any new MetaData (e.g a V3) we wish to store may cause trouble if it
          * has the size of V2, code assumes the version from the size.
          */
+        V3 // The V0/V1 fields in a compact (variable length) encoding
     };
 
+    /*
+     * V3 is CompactMarker followed by the LEB128 encoded cas, exptime and
+     * flags and then the V1 flexCode and datatype bytes; sized from 6 to
+     * MaxCompactSize bytes. Sizes from V0 to V2 always mean the older
+     * versions, so a V3 encoding of such a size is padded (with zeros) to
+     * just beyond V2.
+     */
+    static const uint8_t CompactMarker = 0x03;
+    static const size_t MaxCompactSize = 1 + 10 + 5 + 5 + sizeof(MetaDataV1);
+
+    /// @return true if the data is V3 (compact) metadata
+    static bool isCompact(const sized_buf& in) {
+        return in.size > 0 && uint8_t(in.buf[0]) == CompactMarker &&
+               (in.size < getMetaDataSize(Version::V0) ||
+                in.size > getMetaDataSize(Version::V2));
+    }
+
     MetaData () {}
 
     /*
@@ -226,6 +246,11 @@ public:
      */
     MetaData(const sized_buf& in)
         : initVersion(Version::V0) {
+        if (isCompact(in)) {
+            initialiseCompact(in);
+            initVersion = Version::V3;
+            return;
+        }
 
         // Expect metadata to be V0, V1 or V2.
         // V2 part is ignored, but valid to find in storage.
@@ -275,6 +300,30 @@ public:
         return reinterpret_cast<char*>(&allMeta);
     }
 
+    /*
+     * Encode the metadata as V3 (compact) into this object, and return the
+     * encoding ready for passing to couchstore; valid until the object is
+     * next encoded or destroyed.
+     */
+    sized_buf prepareAndGetCompactForPersistence() {
+        auto* pos = compact.data();
+        *pos++ = char(CompactMarker);
+        pos = appendLeb128(pos, allMeta.v0.getCas());
+        pos = appendLeb128(pos, allMeta.v0.getExptime());
+        pos = appendLeb128(pos, allMeta.v0.getFlags());
+        allMeta.v1.copyToBuf(pos);
+        pos += sizeof(MetaDataV1);
+
+        size_t size = pos - compact.data();
+        if (size >= getMetaDataSize(Version::V0) &&
+            size <= getMetaDataSize(Version::V2)) {
+            const auto padded = getMetaDataSize(Version::V2) + 1;
+            std::fill(pos, compact.data() + padded, 0);
+            size = padded;
+        }
+        return {compact.data(), size};
+    }
+
     void setCas(uint64_t cas) {
         allMeta.v0.setCas(cas);
     }
@@ -346,12 +395,46 @@ public:
                 return sizeof(MetaDataV0) +
                        sizeof(MetaDataV1) +
                        sizeof(MetaDataV2);
+            case Version::V3:
+                return MaxCompactSize;
         }
 
         return sizeof(MetaDataV0) + sizeof(MetaDataV1) + sizeof(MetaDataV2);
     }
 
 protected:
+    void initialiseCompact(const sized_buf& in) {
+        cb::const_byte_buffer remaining{
+                reinterpret_cast<const uint8_t*>(in.buf) + 1, in.size - 1};
+        auto cas = cb::mcbp::decode_unsigned_leb128<uint64_t>(remaining);
+        auto exptime = cb::mcbp::decode_unsigned_leb128<uint32_t>(cas.second);
+        auto flags = cb::mcbp::decode_unsigned_leb128<uint32_t>(exptime.second);
+        remaining = flags.second;
+        if (remaining.size() < sizeof(MetaDataV1)) {
+            throw std::invalid_argument(
+                    "MetaData::initialiseCompact in.size \"" +
+                    std::to_string(in.size) + "\" is too small.");
+        }
+        allMeta.v0.setCas(cas.first);
+        allMeta.v0.setExptime(exptime.first);
+        allMeta.v0.setFlags(flags.first);
+        allMeta.v1.initialise(reinterpret_cast<const char*>(remaining.data()));
+
+        // Anything after V1 must be padding.
+        for (auto ii = sizeof(MetaDataV1); ii < remaining.size(); ++ii) {
+            if (remaining.data()[ii] != 0) {
+                throw std::invalid_argument(
+                        "MetaData::initialiseCompact unexpected data after "
+                        "the datatype");
+            }
+        }
+    }
+
+    static char* appendLeb128(char* pos, uint64_t value) {
+        cb::mcbp::unsigned_leb128<uint64_t> leb(value);
+        return std::copy(leb.begin(), leb.end(), pos);
+    }
+
     class AllMetaData {
     public:
 #pragma pack(1)
@@ -361,6 +444,9 @@ protected:
 #pragma pack()
     } allMeta;
     Version initVersion;
+
+    /// Holds the V3 encoding made by prepareAndGetCompactForPersistence()
+    std::array<char, MaxCompactSize> compact;
 };
 
 /*
@@ -42,6 +42,7 @@
 #include "bucket_logger.h"
 #include "common.h"
 #include "couch-kvstore/couch-kvstore.h"
+#include "document_cache.h"
 #include "ep_types.h"
 #include "kvstore_config.h"
 #include "statwriter.h"
@@ -59,6 +60,12 @@ extern "C" {
     }
 }
 
+extern "C" {
+    static int recordDbDumpByKeyC(Db* db, DocInfo* docinfo, void* ctx) {
+        return CouchKVStore::recordDbDumpByKey(db, docinfo, ctx);
+    }
+}
+
 extern "C" {
     static int getMultiCbC(Db *db, DocInfo *docinfo, void *ctx)
     {
@@ -66,6 +73,18 @@ extern "C" {
     }
 }
 
+extern "C" {
+static int rollbackChangedCbC(Db* db, DocInfo* docinfo, void* ctx) {
+    return CouchKVStore::rollbackChangedCb(db, docinfo, ctx);
+}
+}
+
+extern "C" {
+static int rollbackLookupCbC(Db* db, DocInfo* docinfo, void* ctx) {
+    return CouchKVStore::rollbackLookupCb(db, docinfo, ctx);
+}
+}
+
 struct kvstats_ctx {
     kvstats_ctx(bool persistDocNamespace,
                 Collections::VB::Flush& collectionsFlush)
@@ -179,6 +198,27 @@ static DocKey makeDocKey(const sized_buf buf, bool restoreNamespace) {
                                    : DocKeyEncodesCollectionId::No);
 }
 
+/**
+ * A copy of a DocInfo which owns the key and rev_meta it refers to, so it
+ * can outlive the couchstore callback it was passed to.
+ */
+struct OwnedDocInfo {
+    explicit OwnedDocInfo(const DocInfo& docinfo)
+        : info(docinfo),
+          id(docinfo.id.buf, docinfo.id.size),
+          revMeta(docinfo.rev_meta.buf, docinfo.rev_meta.size) {
+        info.id = {&id[0], id.size()};
+        info.rev_meta = {&revMeta[0], revMeta.size()};
+    }
+
+    OwnedDocInfo(const OwnedDocInfo&) = delete;
+    OwnedDocInfo& operator=(const OwnedDocInfo&) = delete;
+
+    DocInfo info;
+    std::string id;
+    std::string revMeta;
+};
+
 struct GetMultiCbCtx {
     GetMultiCbCtx(CouchKVStore& c, Vbid v, vb_bgfetch_queue_t& f)
         : cks(c), vbId(v), fetches(f) {
@@ -187,16 +227,47 @@ struct GetMultiCbCtx {
     CouchKVStore &cks;
     Vbid vbId;
     vb_bgfetch_queue_t &fetches;
+
+    /// The documents found, and the fetch each is for.
+    std::vector<std::pair<vb_bgfetch_queue_t::iterator,
+                          std::unique_ptr<OwnedDocInfo>>>
+            found;
+};
+
+struct RollbackCtx {
+    RollbackCtx(CouchKVStore& c, Db* db, Vbid v, RollbackCB& cb)
+        : cks(c), rollbackDb(db), vbId(v), cb(cb) {
+    }
+
+    CouchKVStore& cks;
+    /// The vBucket's file at the Rollback Header.
+    Db* rollbackDb;
+    Vbid vbId;
+    RollbackCB& cb;
+
+    /// The keys changed since the Rollback Header which are yet to be
+    /// rolled back, and their current docinfo.
+    std::unordered_map<StoredDocKey, std::unique_ptr<OwnedDocInfo>> changed;
+
+    /// The changed keys of the batch which exist in the Rollback Header;
+    /// their current docinfo and their docinfo in the Rollback Header.
+    std::vector<std::pair<std::unique_ptr<OwnedDocInfo>,
+                          std::unique_ptr<OwnedDocInfo>>>
+            found;
+
+    /// Set if rolling back a batch from within couchstore_changes_since
+    /// failed.
+    couchstore_error_t error = COUCHSTORE_SUCCESS;
 };
 
 struct AllKeysCtx {
-    AllKeysCtx(std::shared_ptr<Callback<const DocKey&>> callback,
+    AllKeysCtx(std::shared_ptr<StatusCallback<const DocKey&>> callback,
                uint32_t cnt,
                bool persistDocNamespace)
         : cb(callback), count(cnt), persistDocNamespace(persistDocNamespace) {
     }
 
-    std::shared_ptr<Callback<const DocKey&>> cb;
+    std::shared_ptr<StatusCallback<const DocKey&>> cb;
     uint32_t count;
     bool persistDocNamespace{false};
 };
@@ -222,7 +293,8 @@ CouchRequest::CouchRequest(const Item& it,
                            uint64_t rev,
                            MutationRequestCallback& cb,
                            bool del,
-                           bool persistDocNamespace)
+                           bool persistDocNamespace,
+                           bool compactMetaData)
     : IORequest(it.getVBucketId(), cb, del, it.getKey()),
       value(it.getValue()),
       fileRevNum(rev) {
@@ -252,11 +324,6 @@ CouchRequest::CouchRequest(const Item& it,
     meta.setDataType(it.getDataType());
 
     dbDocInfo.db_seq = it.getBySeqno();
-
-    // Now allocate space to hold the meta and get it ready for storage
-    dbDocInfo.rev_meta.size = MetaData::getMetaDataSize(MetaData::Version::V1);
-    dbDocInfo.rev_meta.buf = meta.prepareAndGetForPersistence();
-
     dbDocInfo.rev_seq = it.getRevSeqno();
     dbDocInfo.size = dbDoc.data.size;
 
@@ -266,10 +333,63 @@ CouchRequest::CouchRequest(const Item& it,
     } else {
         dbDocInfo.deleted = 0;
     }
+
+    // Now get the meta ready for storage
+    if (compactMetaData) {
+        dbDocInfo.rev_meta = meta.prepareAndGetCompactForPersistence();
+    } else {
+        dbDocInfo.rev_meta.size =
+                MetaData::getMetaDataSize(MetaData::Version::V1);
+        dbDocInfo.rev_meta.buf = meta.prepareAndGetForPersistence();
+    }
     dbDocInfo.id = dbDoc.id;
     dbDocInfo.content_meta = getContentMeta(it);
 }
 
+CouchDbHandleCache::CouchDbHandleCache(size_t maxVBuckets)
+    : entries(maxVBuckets) {
+}
+
+Db* CouchDbHandleCache::checkout(Vbid vbid,
+                                 uint64_t fileRev,
+                                 uint64_t& generation,
+                                 Db*& stale) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto& entry = entries.at(vbid.get());
+    generation = entry.generation;
+    Db* db = entry.db;
+    entry.db = nullptr;
+    if (db && entry.fileRev != fileRev) {
+        stale = db;
+        return nullptr;
+    }
+    stale = nullptr;
+    return db;
+}
+
+Db* CouchDbHandleCache::checkin(Vbid vbid,
+                                Db* db,
+                                uint64_t fileRev,
+                                uint64_t generation) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto& entry = entries.at(vbid.get());
+    if (entry.db || entry.generation != generation) {
+        return db;
+    }
+    entry.db = db;
+    entry.fileRev = fileRev;
+    return nullptr;
+}
+
+Db* CouchDbHandleCache::invalidate(Vbid vbid) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto& entry = entries.at(vbid.get());
+    ++entry.generation;
+    Db* db = entry.db;
+    entry.db = nullptr;
+    return db;
+}
+
 CouchKVStore::CouchKVStore(KVStoreConfig& config)
     : CouchKVStore(config, *couchstore_get_default_file_ops()) {
 }
@@ -277,18 +397,30 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config)
 CouchKVStore::CouchKVStore(KVStoreConfig& config,
                            FileOpsInterface& ops,
                            bool readOnly,
-                           std::shared_ptr<RevisionMap> dbFileRevMap)
+                           std::shared_ptr<RevisionMap> dbFileRevMap,
+                           std::shared_ptr<DocumentCache> docCache,
+                           std::shared_ptr<CouchDbHandleCache> handleCache)
     : KVStore(config, readOnly),
       dbname(config.getDBName()),
       dbFileRevMap(dbFileRevMap),
+      docCache(docCache),
+      handleCache(handleCache),
       intransaction(false),
       scanCounter(0),
       logger(config.getLogger()),
       base_ops(ops) {
     createDataDir(dbname);
-    statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, base_ops);
-    statCollectingFileOpsCompaction = getCouchstoreStatsOps(
-        st.fsStatsCompaction, base_ops);
+    statCollectingFileOps = getCouchstoreStatsOps(
+            st.fsStats, base_ops, configuration.getWriteCombineSize());
+    statCollectingFileOpsCompaction =
+            getCouchstoreStatsOps(st.fsStatsCompaction,
+                                  base_ops,
+                                  configuration.getWriteCombineSize());
+    statCollectingFileOpsScan =
+            getCouchstoreStatsOps(st.fsStats,
+                                  base_ops,
+                                  0 /*writeCombineSize*/,
+                                  configuration.getScanReadAheadSize());
 
     // init db file map with default revision number, 1
     numDbFiles = configuration.getMaxVBuckets();
@@ -308,7 +440,16 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config, FileOpsInterface& ops)
     : CouchKVStore(config,
                    ops,
                    false /*readonly*/,
-                   std::make_shared<RevisionMap>(config.getMaxVBuckets())) {
+                   std::make_shared<RevisionMap>(config.getMaxVBuckets()),
+                   config.getDocumentCacheSize()
+                           ? std::make_shared<DocumentCache>(
+                                     config.getDocumentCacheSize(),
+                                     config.getMaxVBuckets())
+                           : nullptr,
+                   config.isReadHandleCacheEnabled()
+                           ? std::make_shared<CouchDbHandleCache>(
+                                     config.getMaxVBuckets())
+                           : nullptr) {
 }
 
 /**
@@ -317,15 +458,31 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config, FileOpsInterface& ops)
 std::unique_ptr<CouchKVStore> CouchKVStore::makeReadOnlyStore() {
     // Not using make_unique due to the private constructor we're calling
     return std::unique_ptr<CouchKVStore>(
-            new CouchKVStore(configuration, dbFileRevMap));
+            new CouchKVStore(
+                    configuration, dbFileRevMap, docCache, handleCache));
+}
+
+std::unique_ptr<CouchKVStore> CouchKVStore::makeWriterStore(
+        KVStoreConfig& config) {
+    // Not using make_unique due to the private constructor we're calling
+    return std::unique_ptr<CouchKVStore>(new CouchKVStore(config,
+                                                          base_ops,
+                                                          false /*readonly*/,
+                                                          dbFileRevMap,
+                                                          docCache,
+                                                          handleCache));
 }
 
 CouchKVStore::CouchKVStore(KVStoreConfig& config,
-                           std::shared_ptr<RevisionMap> dbFileRevMap)
+                           std::shared_ptr<RevisionMap> dbFileRevMap,
+                           std::shared_ptr<DocumentCache> docCache,
+                           std::shared_ptr<CouchDbHandleCache> handleCache)
     : CouchKVStore(config,
                    *couchstore_get_default_file_ops(),
                    true /*readonly*/,
-                   dbFileRevMap) {
+                   dbFileRevMap,
+                   docCache,
+                   handleCache) {
 }
 
 void CouchKVStore::initialize() {
@@ -376,6 +533,13 @@ void CouchKVStore::initialize() {
 
 CouchKVStore::~CouchKVStore() {
     close();
+    // Cached handles use the file ops of the store which opened them, so
+    // mustn't outlive it.
+    if (handleCache) {
+        for (uint16_t vbid = 0; vbid < numDbFiles; ++vbid) {
+            invalidateReadHandle(Vbid(vbid));
+        }
+    }
 }
 
 void CouchKVStore::reset(Vbid vbucketId) {
@@ -399,6 +563,10 @@ void CouchKVStore::reset(Vbid vbucketId) {
         // KVBucket::vb_mutexes is used in this case.
         unlinkCouchFile(vbucketId, (*dbFileRevMap)[vbucketId.get()]);
         incrementRevision(vbucketId);
+        if (docCache) {
+            docCache->invalidateVBucket(vbucketId);
+        }
+        invalidateReadHandle(vbucketId);
 
         setVBucketState(
                 vbucketId, *state, VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT);
@@ -432,7 +600,8 @@ void CouchKVStore::set(const Item& itm,
                              fileRev,
                              requestcb,
                              deleteItem,
-                             configuration.shouldPersistDocNamespace());
+                             configuration.shouldPersistDocNamespace(),
+                             configuration.isCompactMetaData());
     pendingReqsQ.push_back(req);
 }
 
@@ -523,10 +692,30 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
     if (itms.empty()) {
         return;
     }
-    int numItems = itms.size();
+    st.getMultiBatchSizeHisto.add(itms.size());
+
+    // Complete what we can from the document cache; only the rest need to
+    // be read from the file. The generation must be taken before the file
+    // is opened (see DocumentCache).
+    uint64_t cacheGeneration = 0;
+    std::vector<vb_bgfetch_queue_t::iterator> toRead;
+    toRead.reserve(itms.size());
+    if (docCache) {
+        cacheGeneration = docCache->getGeneration(vb);
+    }
+    for (auto it = itms.begin(); it != itms.end(); ++it) {
+        if (!docCache || !fetchFromDocCache(vb, it->first, it->second)) {
+            toRead.push_back(it);
+        }
+    }
+    if (toRead.empty()) {
+        return;
+    }
+    int numItems = toRead.size();
 
     DbHolder db(*this);
-    couchstore_error_t errCode = openDB(vb, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+    uint64_t handleGeneration = 0;
+    couchstore_error_t errCode = openReadHandle(vb, db, handleGeneration);
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.warn(
                 "CouchKVStore::getMulti: openDB error:{}, "
@@ -535,34 +724,58 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
                 vb,
                 numItems);
         st.numGetFailure += numItems;
-        for (auto& item : itms) {
-            item.second.value.setStatus(ENGINE_NOT_MY_VBUCKET);
+        for (auto& item : toRead) {
+            item->second.value.setStatus(ENGINE_NOT_MY_VBUCKET);
         }
         return;
     }
 
-    size_t idx = 0;
-    std::vector<sized_buf> ids(itms.size());
-    for (auto& item : itms) {
+    std::vector<sized_buf> ids;
+    ids.reserve(toRead.size());
+    for (auto& item : toRead) {
+        const auto& key = item->first;
         if (!configuration.shouldPersistDocNamespace()) {
             auto noprefix = cb::mcbp::skip_unsigned_leb128<CollectionIDType>(
-                    {item.first.data(), item.first.size()});
-            ids[idx] = {const_cast<char*>(
-                                reinterpret_cast<const char*>(noprefix.data())),
-                        noprefix.size()};
+                    {key.data(), key.size()});
+            ids.push_back({const_cast<char*>(reinterpret_cast<const char*>(
+                                   noprefix.data())),
+                           noprefix.size()});
         } else {
-            ids[idx] = {const_cast<char*>(reinterpret_cast<const char*>(
-                                item.first.data())),
-                        item.first.size()};
+            ids.push_back({const_cast<char*>(
+                                   reinterpret_cast<const char*>(key.data())),
+                           key.size()});
         }
-
-        ++idx;
     }
 
+    // A cached handle has counted the reads made since it was opened.
+    auto* stats = couchstore_get_db_filestats(db);
+    const size_t readsBefore = stats ? stats->getReadCount() : 0;
+
     GetMultiCbCtx ctx(*this, vb, itms);
 
     errCode = couchstore_docinfos_by_id(
-            db, ids.data(), itms.size(), 0, getMultiCbC, &ctx);
+            db, ids.data(), ids.size(), 0, getMultiCbC, &ctx);
+
+    // The by-id tree gives the documents in key order, which bears no
+    // relation to where they are in the file; read them in file order so
+    // the reads progress through the file rather than back and forth.
+    std::sort(ctx.found.begin(),
+              ctx.found.end(),
+              [](const std::pair<vb_bgfetch_queue_t::iterator,
+                                 std::unique_ptr<OwnedDocInfo>>& a,
+                 const std::pair<vb_bgfetch_queue_t::iterator,
+                                 std::unique_ptr<OwnedDocInfo>>& b) {
+                  return a.second->info.bp < b.second->info.bp;
+              });
+    for (auto& found : ctx.found) {
+        auto& fetched = found.first->second;
+        fetchMultiDoc(db, found.second->info, fetched, vb);
+        if (docCache && fetched.isMetaOnly == GetMetaOnly::No &&
+            fetched.value.getStatus() == ENGINE_SUCCESS) {
+            docCache->insert(*fetched.value.item, cacheGeneration);
+        }
+    }
+
     if (errCode != COUCHSTORE_SUCCESS) {
         st.numGetFailure += numItems;
         logger.warn(
@@ -571,20 +784,45 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
                 couchstore_strerror(errCode),
                 couchkvstore_strerrno(db, errCode),
                 vb);
-        for (auto& item : itms) {
-            item.second.value.setStatus(couchErr2EngineErr(errCode));
+        for (auto& item : toRead) {
+            item->second.value.setStatus(couchErr2EngineErr(errCode));
         }
     }
 
     // If available, record how many reads() we did for this getMulti;
     // and the average reads per document.
-    auto* stats = couchstore_get_db_filestats(db);
     if (stats != nullptr) {
-        const auto readCount = stats->getReadCount();
+        const auto readCount = stats->getReadCount() - readsBefore;
         st.getMultiFsReadCount += readCount;
         st.getMultiFsReadHisto.add(readCount);
-        st.getMultiFsReadPerDocHisto.add(readCount / itms.size());
+        st.getMultiFsReadPerDocHisto.add(readCount / toRead.size());
+    }
+
+    if (errCode == COUCHSTORE_SUCCESS) {
+        releaseReadHandle(vb, db, handleGeneration);
+    }
+}
+
+bool CouchKVStore::fetchFromDocCache(Vbid vbId,
+                                     const DocKey& key,
+                                     vb_bgfetch_item_ctx_t& bg_itm_ctx) {
+    auto item = docCache->get(vbId, key, bg_itm_ctx.isMetaOnly);
+    if (!item) {
+        ++st.docCacheMisses;
+        return false;
+    }
+    ++st.docCacheHits;
+
+    bg_itm_ctx.value = GetValue(std::move(item));
+    for (auto& fetch : bg_itm_ctx.bgfetched_list) {
+        fetch->value = &bg_itm_ctx.value;
+        st.readTimeHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - fetch->initTime));
+        st.readSizeHisto.add(bg_itm_ctx.value.item->getKey().size() +
+                             bg_itm_ctx.value.item->getNBytes());
     }
+    return true;
 }
 
 void CouchKVStore::del(const Item& itm, Callback<TransactionContext, int>& cb) {
@@ -605,7 +843,8 @@ void CouchKVStore::del(const Item& itm, Callback<TransactionContext, int>& cb) {
                              fileRev,
                              requestcb,
                              true,
-                             configuration.shouldPersistDocNamespace());
+                             configuration.shouldPersistDocNamespace(),
+                             configuration.isCompactMetaData());
     pendingReqsQ.push_back(req);
 }
 
@@ -615,7 +854,11 @@ void CouchKVStore::delVBucket(Vbid vbucket, uint64_t fileRev) {
                         "read-only object.");
     }
 
+    invalidateReadHandle(vbucket);
     unlinkCouchFile(vbucket, fileRev);
+    if (docCache) {
+        docCache->invalidateVBucket(vbucket);
+    }
 }
 
 std::vector<vbucket_state *> CouchKVStore::listPersistedVbuckets() {
@@ -822,37 +1065,51 @@ static int time_purge_hook(Db* d, DocInfo* info, sized_buf item, void* ctx_p) {
         return couchstore_set_purge_seq(d, ctx->max_purged_seq);
     }
 
-    DbInfo infoDb;
-    auto err = couchstore_db_info(d, &infoDb);
-    if (err != COUCHSTORE_SUCCESS) {
-        EP_LOG_WARN("time_purge_hook: couchstore_db_info() failed: {}",
-                    couchstore_strerror(err));
-        return err;
+    if (ctx->ioThrottle) {
+        ctx->ioThrottle(info->size);
     }
 
     uint64_t max_purge_seq = ctx->max_purged_seq;
 
-    if (info->rev_meta.size >= MetaData::getMetaDataSize(MetaData::Version::V0)) {
+    if (info->rev_meta.size >=
+                MetaData::getMetaDataSize(MetaData::Version::V0) ||
+        MetaData::isCompact(info->rev_meta)) {
+        // Is the collections eraser installed? Only the keys of collections
+        // being erased need to go through it (and the vBucket), which is
+        // checked against the compaction's own copy of the manifest first.
+        if (ctx->collectionsEraser) {
+            // Collections: TODO: Permanently restore to stored namespace
+            DocKey key = makeDocKey(info->id,
+                                    ctx->config->shouldPersistDocNamespace());
+            if (ctx->eraserContext->isLogicallyDeleted(
+                        key, int64_t(info->db_seq)) &&
+                ctx->collectionsEraser(key,
+                                       int64_t(info->db_seq),
+                                       info->deleted,
+                                       *ctx->eraserContext)) {
+                if (!info->deleted) {
+                    ctx->stats.collectionsItemsPurged++;
+                } else {
+                    ctx->stats.collectionsDeletedItemsPurged++;
+                }
+                return COUCHSTORE_COMPACT_DROP_ITEM;
+            }
+        }
+
         auto metadata = MetaDataFactory::createMetaData(info->rev_meta);
         uint32_t exptime = metadata->getExptime();
 
-        // Is the collections eraser installed?
-        if (ctx->collectionsEraser &&
-            ctx->collectionsEraser(
-                    makeDocKey(info->id,
-                               ctx->config->shouldPersistDocNamespace()),
-                    int64_t(info->db_seq),
-                    info->deleted,
-                    *ctx->eraserContext)) {
-            if (!info->deleted) {
-                ctx->stats.collectionsItemsPurged++;
-            } else {
-                ctx->stats.collectionsDeletedItemsPurged++;
+        if (info->deleted) {
+            // Only tombstones need the file's last sequence (the tombstone
+            // of the highest seqno is never purged).
+            DbInfo infoDb;
+            auto err = couchstore_db_info(d, &infoDb);
+            if (err != COUCHSTORE_SUCCESS) {
+                EP_LOG_WARN("time_purge_hook: couchstore_db_info() failed: {}",
+                            couchstore_strerror(err));
+                return err;
             }
-            return COUCHSTORE_COMPACT_DROP_ITEM;
-        }
 
-        if (info->deleted) {
             if (info->db_seq != infoDb.last_sequence) {
                 if (ctx->compactConfig.drop_deletes) { // all deleted items must
                                                        // be dropped ...
@@ -1094,6 +1351,12 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     // Update the global VBucket file map so all operations use the new file
     updateDbFileMap(vbid, new_rev);
 
+    // Compaction may have purged or expired documents which are cached.
+    if (docCache) {
+        docCache->invalidateVBucket(vbid);
+    }
+    invalidateReadHandle(vbid);
+
     logger.debug("INFO: created new couch db file, name:{} rev:{}",
                  new_file,
                  new_rev);
@@ -1282,6 +1545,20 @@ bool CouchKVStore::getStat(const char* name, size_t& value)  {
     } else if (strcmp("io_bg_fetch_read_count", name) == 0) {
         value = st.getMultiFsReadCount;
         return true;
+    } else if (strcmp("doc_cache_hits", name) == 0) {
+        value = st.docCacheHits;
+        return true;
+    } else if (strcmp("doc_cache_misses", name) == 0) {
+        value = st.docCacheMisses;
+        return true;
+    } else if (strcmp("doc_cache_memory_used", name) == 0) {
+        // The cache is shared by the shard's stores; only the RO store
+        // reports it so that it is counted once.
+        value = (docCache && isReadOnly()) ? docCache->getMemoryUsed() : 0;
+        return true;
+    } else if (strcmp("doc_cache_items", name) == 0) {
+        value = (docCache && isReadOnly()) ? docCache->getNumItems() : 0;
+        return true;
     }
 
     return false;
@@ -1322,8 +1599,10 @@ ScanContext* CouchKVStore::initScanContext(
         DocumentFilter options,
         ValueFilter valOptions) {
     DbHolder db(*this);
-    couchstore_error_t errorCode =
-            openDB(vbid, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+    couchstore_error_t errorCode = openDB(vbid,
+                                          db,
+                                          COUCHSTORE_OPEN_FLAG_RDONLY,
+                                          statCollectingFileOpsScan.get());
     if (errorCode != COUCHSTORE_SUCCESS) {
         logger.warn(
                 "CouchKVStore::initScanContext: openDB error:{}, "
@@ -1407,7 +1686,9 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
         return scan_failed;
     }
 
-    if (ctx->lastReadSeqno == ctx->maxSeqno) {
+    // A ByKey scan may read the item at maxSeqno at any point.
+    if (ctx->order == ScanOrder::BySeqno &&
+        ctx->lastReadSeqno == ctx->maxSeqno) {
         return scan_success;
     }
 
@@ -1429,17 +1710,27 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
         db = itr->second;
     }
 
-    uint64_t start = ctx->startSeqno;
-    if (ctx->lastReadSeqno != 0) {
-        start = ctx->lastReadSeqno + 1;
-    }
-
     couchstore_error_t errorCode;
-    errorCode = couchstore_changes_since(db,
-                                         start,
-                                         getDocFilter(ctx->docFilter),
-                                         recordDbDumpC,
-                                         static_cast<void*>(ctx));
+    if (ctx->order == ScanOrder::ByKey) {
+        sized_buf start{const_cast<char*>(ctx->resumeKey.data()),
+                        ctx->resumeKey.size()};
+        errorCode = couchstore_all_docs(db,
+                                        &start,
+                                        getDocFilter(ctx->docFilter),
+                                        recordDbDumpByKeyC,
+                                        static_cast<void*>(ctx));
+    } else {
+        uint64_t start = ctx->startSeqno;
+        if (ctx->lastReadSeqno != 0) {
+            start = ctx->lastReadSeqno + 1;
+        }
+
+        errorCode = couchstore_changes_since(db,
+                                             start,
+                                             getDocFilter(ctx->docFilter),
+                                             recordDbDumpC,
+                                             static_cast<void*>(ctx));
+    }
 
     TRACE_EVENT_END1(
             "CouchKVStore", "scan", "lastReadSeqno", ctx->lastReadSeqno);
@@ -1449,8 +1740,10 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
             return scan_again;
         } else {
             logger.warn(
-                    "CouchKVStore::scan couchstore_changes_since "
+                    "CouchKVStore::scan {} "
                     "error:{} [{}]",
+                    ctx->order == ScanOrder::ByKey ? "couchstore_all_docs"
+                                                   : "couchstore_changes_since",
                     couchstore_strerror(errorCode),
                     couchkvstore_strerrno(db, errorCode));
             return scan_failed;
@@ -1574,6 +1867,55 @@ couchstore_error_t CouchKVStore::openDB(Vbid vbucketId,
     return openSpecificDB(vbucketId, fileRev, db, options, ops);
 }
 
+couchstore_error_t CouchKVStore::openReadHandle(Vbid vbucketId,
+                                                DbHolder& db,
+                                                uint64_t& generation) {
+    if (!handleCache) {
+        return openDB(vbucketId, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+    }
+
+    // As openDB, hold openDbMutex so the fileRev remains valid until the
+    // file is open.
+    std::lock_guard<cb::ReaderLock> lg(openDbMutex);
+    const uint64_t fileRev = (*dbFileRevMap)[vbucketId.get()];
+    Db* stale = nullptr;
+    Db* cached = handleCache->checkout(vbucketId, fileRev, generation, stale);
+    if (stale) {
+        closeDatabaseHandle(stale);
+    }
+    if (cached) {
+        *db.getDbAddress() = cached;
+        db.setFileRev(fileRev);
+        return COUCHSTORE_SUCCESS;
+    }
+    return openSpecificDB(
+            vbucketId, fileRev, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+}
+
+void CouchKVStore::releaseReadHandle(Vbid vbucketId,
+                                     DbHolder& db,
+                                     uint64_t generation) {
+    if (!handleCache) {
+        return;
+    }
+    const auto fileRev = db.getFileRev();
+    Db* notCached = handleCache->checkin(
+            vbucketId, db.releaseDb(), fileRev, generation);
+    if (notCached) {
+        closeDatabaseHandle(notCached);
+    }
+}
+
+void CouchKVStore::invalidateReadHandle(Vbid vbucketId) {
+    if (!handleCache) {
+        return;
+    }
+    Db* db = handleCache->invalidate(vbucketId);
+    if (db) {
+        closeDatabaseHandle(db);
+    }
+}
+
 couchstore_error_t CouchKVStore::openSpecificDB(Vbid vbucketId,
                                                 uint64_t fileRev,
                                                 DbHolder& db,
@@ -1924,6 +2266,21 @@ int CouchKVStore::recordDbDump(Db *db, DocInfo *docinfo, void *ctx) {
     return COUCHSTORE_SUCCESS;
 }
 
+int CouchKVStore::recordDbDumpByKey(Db* db, DocInfo* docinfo, void* ctx) {
+    auto* sctx = static_cast<ScanContext*>(ctx);
+    // The by-key index covers the whole vBucket.
+    if (int64_t(docinfo->db_seq) < sctx->startSeqno) {
+        return COUCHSTORE_SUCCESS;
+    }
+
+    const int rv = recordDbDump(db, docinfo, ctx);
+    if (rv == COUCHSTORE_ERROR_CANCEL) {
+        // Paused on this item; the next scan() starts from it.
+        sctx->resumeKey.assign(docinfo->id.buf, docinfo->id.size);
+    }
+    return rv;
+}
+
 bool CouchKVStore::commit2couchstore(Collections::VB::Flush& collectionsFlush) {
     bool success = true;
 
@@ -1993,6 +2350,16 @@ bool CouchKVStore::commit2couchstore(Collections::VB::Flush& collectionsFlush) {
                 vbucket2flush);
     }
 
+    // The written documents must no longer be served from the document
+    // cache (see DocumentCache for why this follows the write).
+    if (docCache) {
+        for (const auto* req : pendingReqsQ) {
+            docCache->invalidate(vbucket2flush, req->getKey());
+        }
+    }
+    // Cached read handles don't see the new header.
+    invalidateReadHandle(vbucket2flush);
+
     commitCallback(pendingReqsQ, kvctx, errCode);
 
     // clean up
@@ -2113,12 +2480,7 @@ couchstore_error_t CouchKVStore::saveDocs(
 
         // Only saving collection stats if collections enabled
         if (configuration.shouldPersistDocNamespace()) {
-            collectionsFlush.saveCollectionStats(
-                    std::bind(&CouchKVStore::saveCollectionStats,
-                              this,
-                              std::ref(*db),
-                              std::placeholders::_1,
-                              std::placeholders::_2));
+            saveCollectionStats(*db, collectionsFlush);
         }
 
         errCode = saveVBState(db, *state);
@@ -2536,18 +2898,21 @@ Collections::VB::PersistedManifest CouchKVStore::readCollectionsManifest(
             lDoc.getLocalDoc()->json.buf + lDoc.getLocalDoc()->json.size};
 }
 
-void CouchKVStore::saveCollectionStats(Db& db,
-                                       CollectionID cid,
-                                       Collections::VB::PersistedStats stats) {
-    // Write out the stats in BE to a local doc named after the collection
-    // Using set-notation cardinality - |cid| which helps keep the keys small
-    std::string docName = "|" + cid.to_string() + "|";
+void CouchKVStore::saveCollectionStats(
+        Db& db, const Collections::VB::Flush& collectionsFlush) {
+    if (!collectionsFlush.isCollectionStatsChanged()) {
+        return;
+    }
 
-    LocalDoc lDoc;
-    lDoc.id.buf = const_cast<char*>(docName.c_str());
-    lDoc.id.size = docName.size();
+    // All the collections' stats are written as one document per commit,
+    // rather than a document per changed collection.
+    auto stats = readCollectionStats(db);
+    collectionsFlush.updateCollectionStats(stats);
+    auto encodedStats = Collections::VB::encodePersistedStats(stats);
 
-    auto encodedStats = stats.getLebEncodedStats();
+    LocalDoc lDoc;
+    lDoc.id.buf = const_cast<char*>(Collections::CouchstoreCollectionStats);
+    lDoc.id.size = sizeof(Collections::CouchstoreCollectionStats) - 1;
     lDoc.json.buf = const_cast<char*>(encodedStats.data());
     lDoc.json.size = encodedStats.size();
     lDoc.deleted = 0;
@@ -2556,15 +2921,36 @@ void CouchKVStore::saveCollectionStats(Db& db,
 
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.warn(
-                "CouchKVStore::saveCollectionStats cid:{} "
+                "CouchKVStore::saveCollectionStats "
                 "couchstore_save_local_document "
                 "error:{} [{}]",
-                cid.to_string(),
                 couchstore_strerror(errCode),
                 couchkvstore_strerrno(&db, errCode));
     }
 }
 
+Collections::VB::PersistedStatsMap CouchKVStore::readCollectionStats(Db& db) {
+    sized_buf id;
+    id.buf = const_cast<char*>(Collections::CouchstoreCollectionStats);
+    id.size = sizeof(Collections::CouchstoreCollectionStats) - 1;
+
+    LocalDocHolder lDoc;
+    auto errCode = couchstore_open_local_document(
+            &db, (void*)id.buf, id.size, lDoc.getLocalDocAddress());
+    if (errCode != COUCHSTORE_SUCCESS) {
+        if (errCode != COUCHSTORE_ERROR_DOC_NOT_FOUND) {
+            logger.warn(
+                    "CouchKVStore::readCollectionStats "
+                    "couchstore_open_local_document error:{}",
+                    couchstore_strerror(errCode));
+        }
+        return {};
+    }
+
+    return Collections::VB::decodePersistedStats(
+            lDoc.getLocalDoc()->json.buf, lDoc.getLocalDoc()->json.size);
+}
+
 void CouchKVStore::deleteCollectionStats(Db& db, CollectionID cid) {
     std::string docName = "|" + cid.to_string() + "|";
     LocalDoc lDoc;
@@ -2587,9 +2973,18 @@ void CouchKVStore::deleteCollectionStats(Db& db, CollectionID cid) {
 
 Collections::VB::PersistedStats CouchKVStore::getCollectionStats(
         const KVFileHandle& kvFileHandle, CollectionID collection) {
+    const auto& db = static_cast<const CouchKVFileHandle&>(kvFileHandle);
+    auto stats = readCollectionStats(*db.getDb());
+    auto itr = stats.find(collection);
+    if (itr != stats.end()) {
+        return itr->second;
+    }
+
+    // Not (yet) in the combined document; the collection's stats may still
+    // be in the per-collection document written by earlier versions, using
+    // set-notation cardinality - |cid|.
     std::string docName = "|" + collection.to_string() + "|";
 
-    const auto& db = static_cast<const CouchKVFileHandle&>(kvFileHandle);
     sized_buf id;
     id.buf = const_cast<char*>(docName.c_str());
     id.size = docName.size();
@@ -2629,7 +3024,6 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
     // Collections: TODO: Permanently restore to stored namespace
     DocKey key = makeDocKey(docinfo->id,
                             cbCtx->cks.getConfig().shouldPersistDocNamespace());
-    KVStoreStats& st = cbCtx->cks.getKVStoreStat();
 
     vb_bgfetch_queue_t::iterator qitr = cbCtx->fetches.find(key);
     if (qitr == cbCtx->fetches.end()) {
@@ -2645,16 +3039,24 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
         return 0;
     }
 
-    vb_bgfetch_item_ctx_t& bg_itm_ctx = (*qitr).second;
+    // The documents are read once they have all been found (see getMulti).
+    cbCtx->found.emplace_back(qitr, std::make_unique<OwnedDocInfo>(*docinfo));
+    return 0;
+}
+
+void CouchKVStore::fetchMultiDoc(Db* db,
+                                 DocInfo& docinfo,
+                                 vb_bgfetch_item_ctx_t& bg_itm_ctx,
+                                 Vbid vbId) {
     GetMetaOnly meta_only = bg_itm_ctx.isMetaOnly;
 
-    couchstore_error_t errCode = cbCtx->cks.fetchDoc(
-            db, docinfo, bg_itm_ctx.value, cbCtx->vbId, meta_only);
+    couchstore_error_t errCode =
+            fetchDoc(db, &docinfo, bg_itm_ctx.value, vbId, meta_only);
     if (errCode != COUCHSTORE_SUCCESS && (meta_only == GetMetaOnly::No)) {
         st.numGetFailure++;
     }
 
-    bg_itm_ctx.value.setStatus(cbCtx->cks.couchErr2EngineErr(errCode));
+    bg_itm_ctx.value.setStatus(couchErr2EngineErr(errCode));
 
     bool return_val_ownership_transferred = false;
     for (auto& fetch : bg_itm_ctx.bgfetched_list) {
@@ -2671,14 +3073,12 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
         }
     }
     if (!return_val_ownership_transferred) {
-        cbCtx->cks.logger.warn(
-                "CouchKVStore::getMultiCb called with zero"
+        logger.warn(
+                "CouchKVStore::fetchMultiDoc called with zero"
                 "items in bgfetched_list, {}, seqno:{}",
-                cbCtx->vbId,
-                docinfo->rev_seq);
+                vbId,
+                docinfo.rev_seq);
     }
-
-    return 0;
 }
 
 
@@ -2790,6 +3190,15 @@ size_t CouchKVStore::getItemCount(Vbid vbid) {
 RollbackResult CouchKVStore::rollback(Vbid vbid,
                                       uint64_t rollbackSeqno,
                                       std::shared_ptr<RollbackCB> cb) {
+    // However the rollback ends, cached documents may be newer than the
+    // documents which remain in the file.
+    auto invalidateCache = gsl::finally([this, vbid]() {
+        if (docCache) {
+            docCache->invalidateVBucket(vbid);
+        }
+        invalidateReadHandle(vbid);
+    });
+
     DbHolder db(*this);
     DbInfo info;
     couchstore_error_t errCode;
@@ -2910,15 +3319,34 @@ RollbackResult CouchKVStore::rollback(Vbid vbid,
     //   deleted in the Rollback header).
     // * If the key is present in the Rollback header then replace the in-memory
     // value with the value from the Rollback header.
+    //
+    // Rather than looking each key up in the Rollback Header individually,
+    // the changed keys are collected from the by-seqno tree in batches and
+    // each batch is looked up with a single walk of the Rollback Header's
+    // by-id tree, with the documents read in file order.
     cb->setDbHeader(newdb);
-    auto cl = std::make_shared<NoLookupCallback>();
-    ScanContext* ctx = initScanContext(cb, cl, vbid, info.last_sequence+1,
-                                       DocumentFilter::ALL_ITEMS,
-                                       ValueFilter::KEYS_ONLY);
-    scan_error_t error = scan(ctx);
-    destroyScanContext(ctx);
-
-    if (error != scan_success) {
+    RollbackCtx ctx(*this, newdb, vbid, *cb);
+    errCode = couchstore_changes_since(
+            db, info.last_sequence + 1, 0, rollbackChangedCbC, &ctx);
+    if (errCode == COUCHSTORE_SUCCESS && !ctx.changed.empty()) {
+        errCode = rollbackBatch(ctx);
+    } else if (errCode == COUCHSTORE_ERROR_CANCEL &&
+               ctx.error != COUCHSTORE_SUCCESS) {
+        errCode = ctx.error;
+    }
+
+    if (errCode != COUCHSTORE_SUCCESS) {
+        // A cancel without an error is the callback running out of memory,
+        // which has already been reported.
+        if (errCode != COUCHSTORE_ERROR_CANCEL) {
+            logger.warn(
+                    "CouchKVStore::rollback: couchstore_changes_since "
+                    "error:{} [{}], {}, since:{}",
+                    couchstore_strerror(errCode),
+                    couchkvstore_strerrno(db, errCode),
+                    vbid,
+                    info.last_sequence + 1);
+        }
         return RollbackResult(false, 0, 0, 0);
     }
 
@@ -2940,10 +3368,151 @@ RollbackResult CouchKVStore::rollback(Vbid vbid,
                           vb_state->lastSnapStart, vb_state->lastSnapEnd);
 }
 
+int CouchKVStore::rollbackChangedCb(Db* db, DocInfo* docinfo, void* ctx) {
+    auto* rbCtx = static_cast<RollbackCtx*>(ctx);
+    // Collections: TODO: Permanently restore to stored namespace
+    rbCtx->changed.emplace(
+            makeDocKey(docinfo->id,
+                       rbCtx->cks.getConfig().shouldPersistDocNamespace()),
+            std::make_unique<OwnedDocInfo>(*docinfo));
+    if (rbCtx->changed.size() >= RollbackBatchSize) {
+        rbCtx->error = rbCtx->cks.rollbackBatch(*rbCtx);
+        if (rbCtx->error != COUCHSTORE_SUCCESS) {
+            return COUCHSTORE_ERROR_CANCEL;
+        }
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+int CouchKVStore::rollbackLookupCb(Db* db, DocInfo* docinfo, void* ctx) {
+    auto* rbCtx = static_cast<RollbackCtx*>(ctx);
+    auto changed = rbCtx->changed.find(makeDocKey(
+            docinfo->id, rbCtx->cks.getConfig().shouldPersistDocNamespace()));
+    if (changed == rbCtx->changed.end()) {
+        rbCtx->cks.logger.warn(
+                "CouchKVStore::rollbackLookupCb: Couchstore returned a "
+                "docinfo for a key which was not looked up in {}, "
+                "seqno:{}",
+                rbCtx->vbId,
+                docinfo->db_seq);
+        return COUCHSTORE_SUCCESS;
+    }
+
+    // The key's current docinfo is kept alive in found, as the ids being
+    // looked up point into it.
+    rbCtx->found.emplace_back(std::move(changed->second),
+                              std::make_unique<OwnedDocInfo>(*docinfo));
+    rbCtx->changed.erase(changed);
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t CouchKVStore::rollbackBatch(RollbackCtx& ctx) {
+    // The current state of a changed key is always passed without its
+    // value, as from a keys only scan.
+    auto makePostRbSeqno = [this, &ctx](const DocInfo& docinfo) {
+        auto metadata = MetaDataFactory::createMetaData(docinfo.rev_meta);
+        // Collections: TODO: Permanently restore to stored namespace
+        auto it = std::make_unique<Item>(
+                makeDocKey(docinfo.id,
+                           configuration.shouldPersistDocNamespace()),
+                metadata->getFlags(),
+                metadata->getExptime(),
+                nullptr,
+                0,
+                metadata->getDataType(),
+                metadata->getCas(),
+                docinfo.db_seq,
+                ctx.vbId,
+                docinfo.rev_seq);
+        if (docinfo.deleted) {
+            it->setDeleted(metadata->getDeleteSource());
+        }
+        return GetValue(std::move(it), ENGINE_SUCCESS, -1, true);
+    };
+
+    std::vector<sized_buf> ids;
+    ids.reserve(ctx.changed.size());
+    for (const auto& changed : ctx.changed) {
+        ids.push_back(changed.second->info.id);
+    }
+
+    ctx.found.clear();
+    auto errCode = couchstore_docinfos_by_id(ctx.rollbackDb,
+                                             ids.data(),
+                                             ids.size(),
+                                             0,
+                                             rollbackLookupCbC,
+                                             &ctx);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.warn(
+                "CouchKVStore::rollbackBatch: couchstore_docinfos_by_id "
+                "error:{} [{}], {}, numDocs:{}",
+                couchstore_strerror(errCode),
+                couchkvstore_strerrno(ctx.rollbackDb, errCode),
+                ctx.vbId,
+                ids.size());
+        return errCode;
+    }
+
+    // Read the documents of the Rollback Header in file order (see
+    // getMulti), reverting each key as its document is read.
+    std::sort(ctx.found.begin(),
+              ctx.found.end(),
+              [](const std::pair<std::unique_ptr<OwnedDocInfo>,
+                                 std::unique_ptr<OwnedDocInfo>>& a,
+                 const std::pair<std::unique_ptr<OwnedDocInfo>,
+                                 std::unique_ptr<OwnedDocInfo>>& b) {
+                  return a.second->info.bp < b.second->info.bp;
+              });
+    for (auto& found : ctx.found) {
+        GetValue preRbSeqno;
+        errCode = fetchDoc(ctx.rollbackDb,
+                           &found.second->info,
+                           preRbSeqno,
+                           ctx.vbId,
+                           GetMetaOnly::No);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            logger.warn(
+                    "CouchKVStore::rollbackBatch: fetchDoc error:{} [{}], "
+                    "{}, deleted:{}",
+                    couchstore_strerror(errCode),
+                    couchkvstore_strerrno(ctx.rollbackDb, errCode),
+                    ctx.vbId,
+                    found.second->info.deleted ? "yes" : "no");
+            ++st.numGetFailure;
+        }
+        preRbSeqno.setStatus(couchErr2EngineErr(errCode));
+
+        auto postRbSeqno = makePostRbSeqno(found.first->info);
+        ctx.cb.rollbackKey(postRbSeqno, preRbSeqno);
+        if (ctx.cb.getStatus() == ENGINE_ENOMEM) {
+            return COUCHSTORE_ERROR_CANCEL;
+        }
+    }
+
+    // The keys left did not exist at the Rollback Header.
+    for (auto& changed : ctx.changed) {
+        GetValue preRbSeqno(nullptr, ENGINE_KEY_ENOENT);
+        auto postRbSeqno = makePostRbSeqno(changed.second->info);
+        ctx.cb.rollbackKey(postRbSeqno, preRbSeqno);
+        if (ctx.cb.getStatus() == ENGINE_ENOMEM) {
+            return COUCHSTORE_ERROR_CANCEL;
+        }
+    }
+
+    ctx.changed.clear();
+    ctx.found.clear();
+    return COUCHSTORE_SUCCESS;
+}
+
 int populateAllKeys(Db *db, DocInfo *docinfo, void *ctx) {
     AllKeysCtx *allKeysCtx = (AllKeysCtx *)ctx;
     DocKey key = makeDocKey(docinfo->id, allKeysCtx->persistDocNamespace);
     (allKeysCtx->cb)->callback(key);
+    if (allKeysCtx->cb->getStatus() != ENGINE_SUCCESS) {
+        // The callback doesn't want any more keys
+        return COUCHSTORE_ERROR_CANCEL;
+    }
     if (--(allKeysCtx->count) <= 0) {
         //Only when count met is less than the actual number of entries
         return COUCHSTORE_ERROR_CANCEL;
@@ -2955,7 +3524,7 @@ ENGINE_ERROR_CODE
 CouchKVStore::getAllKeys(Vbid vbid,
                          const DocKey start_key,
                          uint32_t count,
-                         std::shared_ptr<Callback<const DocKey&>> cb) {
+                         std::shared_ptr<StatusCallback<const DocKey&>> cb) {
     DbHolder db(*this);
     couchstore_error_t errCode = openDB(vbid, db, COUCHSTORE_OPEN_FLAG_RDONLY);
     if(errCode == COUCHSTORE_SUCCESS) {
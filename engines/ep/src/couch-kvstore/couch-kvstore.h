@@ -19,6 +19,7 @@
 #include "config.h"
 
 #include "atomicqueue.h"
+#include "collections/collection_persisted_stats.h"
 #include "configuration.h"
 #include "couch-kvstore/couch-fs-stats.h"
 #include "couch-kvstore/couch-kvstore-metadata.h"
@@ -34,12 +35,14 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 
 #define COUCHSTORE_NO_OPTIONS 0
 
+class DocumentCache;
 class EventuallyPersistentEngine;
 
 /**
@@ -56,12 +59,14 @@ public:
      * @param cb persistence callback
      * @param del flag indicating if it is an item deletion or not
      * @param persistDocNamespace true if we should store the key's namespace
+     * @param compactMetaData true to store the metadata as MetaData V3
      */
     CouchRequest(const Item& it,
                  uint64_t rev,
                  MutationRequestCallback& cb,
                  bool del,
-                 bool persistDocNamespace);
+                 bool persistDocNamespace,
+                 bool compactMetaData);
 
     virtual ~CouchRequest() {}
 
@@ -149,7 +154,66 @@ protected:
     DocInfo dbDocInfo;
 };
 
+/**
+ * Cache of one open, read-only couchstore handle per vBucket, so background
+ * fetches don't have to open the vBucket's file (and read its header) each
+ * time.
+ *
+ * A handle is checked out for the exclusive use of one caller and checked
+ * back in when it is done with. A handle only sees the file as of the header
+ * it was opened at, so the RW store invalidates the vBucket whenever the file
+ * changes: after a commit, and when compaction, rollback, reset or deletion
+ * replaces or removes the file. Invalidating bumps the vBucket's generation,
+ * which stops any handle checked out before then from being cached again.
+ *
+ * Handles returned by the cache are owned by the caller, who must close them.
+ * The cache doesn't close the handles it holds: a CouchKVStore drops them all
+ * when destroyed.
+ */
+class CouchDbHandleCache {
+public:
+    explicit CouchDbHandleCache(size_t maxVBuckets);
+
+    /**
+     * Take the vBucket's cached handle.
+     *
+     * @param fileRev the revision of the vBucket's file the handle must be of
+     * @param[out] generation the vBucket's generation, to pass to checkin()
+     * @param[out] stale a cached handle of another revision, or nullptr
+     * @return the cached handle, or nullptr if there is none for fileRev
+     */
+    Db* checkout(Vbid vbid, uint64_t fileRev, uint64_t& generation, Db*& stale);
+
+    /**
+     * Return a handle to the cache.
+     *
+     * @param generation as returned by the checkout() before the handle was
+     *        used (or opened)
+     * @return nullptr if the handle was cached, otherwise db
+     */
+    Db* checkin(Vbid vbid, Db* db, uint64_t fileRev, uint64_t generation);
+
+    /**
+     * Drop the vBucket's cached handle, and stop any checked out handle from
+     * being cached.
+     *
+     * @return the dropped handle, or nullptr
+     */
+    Db* invalidate(Vbid vbid);
+
+private:
+    struct Entry {
+        Db* db = nullptr;
+        uint64_t fileRev = 0;
+        uint64_t generation = 0;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+};
+
 struct kvstats_ctx;
+struct RollbackCtx;
 
 /**
  * KVStore with couchstore as the underlying storage system
@@ -185,6 +249,16 @@ public:
      */
     std::unique_ptr<CouchKVStore> makeReadOnlyStore();
 
+    /**
+     * Create another RW store over the same files, sharing this object's
+     * revision map (and hence its RO sibling). Used to give a shard several
+     * flushers; each vBucket must only be written through one of the stores.
+     *
+     * @param config configuration for the new store (must outlive it)
+     * @return a unique_ptr holding a RW 'sibling' to this object.
+     */
+    std::unique_ptr<CouchKVStore> makeWriterStore(KVStoreConfig& config);
+
     void initialize();
 
     /**
@@ -401,8 +475,38 @@ public:
     bool getStat(const char* name, size_t& value) override;
 
     static int recordDbDump(Db *db, DocInfo *docinfo, void *ctx);
+    static int recordDbDumpByKey(Db* db, DocInfo* docinfo, void* ctx);
     static int recordDbStat(Db *db, DocInfo *docinfo, void *ctx);
     static int getMultiCb(Db *db, DocInfo *docinfo, void *ctx);
+    static int rollbackChangedCb(Db* db, DocInfo* docinfo, void* ctx);
+    static int rollbackLookupCb(Db* db, DocInfo* docinfo, void* ctx);
+
+    /**
+     * Roll back the batch of keys changed since the rollback header which
+     * rollback() has collected: look up all of their states in the rollback
+     * header with one walk of its by-id tree, then pass each key with its
+     * state to the RollbackCB.
+     */
+    couchstore_error_t rollbackBatch(RollbackCtx& ctx);
+
+    /// Number of changed keys rollback() looks up and rolls back at a time.
+    static const size_t RollbackBatchSize = 1024;
+
+    /// Read the document of a bgfetch found by getMulti, completing it.
+    void fetchMultiDoc(Db* db,
+                       DocInfo& docinfo,
+                       vb_bgfetch_item_ctx_t& bg_itm_ctx,
+                       Vbid vbId);
+
+    /**
+     * Complete a bgfetch from the document cache.
+     *
+     * @return true if the document was cached, false if it must be read
+     *         from the file
+     */
+    bool fetchFromDocCache(Vbid vbId,
+                           const DocKey& key,
+                           vb_bgfetch_item_ctx_t& bg_itm_ctx);
     ENGINE_ERROR_CODE readVBState(Db* db, Vbid vbId);
 
     couchstore_error_t fetchDoc(Db* db,
@@ -421,7 +525,7 @@ public:
             Vbid vbid,
             const DocKey start_key,
             uint32_t count,
-            std::shared_ptr<Callback<const DocKey&>> cb) override;
+            std::shared_ptr<StatusCallback<const DocKey&>> cb) override;
 
     ScanContext* initScanContext(
             std::shared_ptr<StatusCallback<GetValue>> cb,
@@ -433,6 +537,10 @@ public:
 
     scan_error_t scan(ScanContext* sctx) override;
 
+    bool supportsKeyOrderScan() const override {
+        return true;
+    }
+
     void destroyScanContext(ScanContext* ctx) override;
 
     Collections::VB::PersistedManifest getCollectionsManifest(
@@ -551,6 +659,23 @@ protected:
                                       couchstore_open_flags options,
                                       FileOpsInterface* ops = nullptr);
 
+    /**
+     * Open the vBucket's file read-only for a bgfetch, using the handle cache
+     * if enabled.
+     *
+     * @param[out] generation the handle cache generation to pass to
+     *        releaseReadHandle()
+     */
+    couchstore_error_t openReadHandle(Vbid vbucketId,
+                                      DbHolder& db,
+                                      uint64_t& generation);
+
+    /// Return a handle opened by openReadHandle() to the handle cache.
+    void releaseReadHandle(Vbid vbucketId, DbHolder& db, uint64_t generation);
+
+    /// Drop the vBucket's cached read handle, as its file has changed.
+    void invalidateReadHandle(Vbid vbucketId);
+
     /**
      * save the Documents held in docs to the file associated with vbid/rev
      *
@@ -597,17 +722,24 @@ protected:
     Collections::VB::PersistedManifest readCollectionsManifest(Db& db);
 
     /**
-     * Save stats for collection cid into the file referenced by db
+     * Save the stats of all collections (updated with those changed by the
+     * flush) as the one collections stats document of the file referenced
+     * by db
      * @param db The Db to write to
-     * @param cid The collection to update
-     * @param stats The stats that should be persisted
+     * @param collectionsFlush The flush's collection stats changes
      */
     void saveCollectionStats(Db& db,
-                             CollectionID cid,
-                             Collections::VB::PersistedStats stats);
+                             const Collections::VB::Flush& collectionsFlush);
+
+    /**
+     * Read the collections stats document of the file referenced by db
+     * @return the stats, empty if there is no document
+     */
+    Collections::VB::PersistedStatsMap readCollectionStats(Db& db);
 
     /**
-     * Delete the count for collection cid
+     * Delete the count for collection cid, as saved (in a document per
+     * collection) by earlier versions
      * @param db The Db to write to
      * @param cid The collection to delete
      */
@@ -657,10 +789,27 @@ protected:
      * Per-vbucket file revision atomic to ensure writer threads see increments.
      *
      * Owned via a shared_ptr, as there should be a single RevisionMap per
-     * RW/RO pair.
+     * RW/RO pair (shared with any additional RW stores, see
+     * makeWriterStore).
      */
     std::shared_ptr<RevisionMap> dbFileRevMap;
 
+    /**
+     * Cache of documents read by bgfetches, or nullptr if disabled.
+     *
+     * Like the RevisionMap, shared by the RW/RO pair and any additional RW
+     * stores: getMulti (on the RO store) fills it and the RW stores
+     * invalidate the documents they write.
+     */
+    std::shared_ptr<DocumentCache> docCache;
+
+    /**
+     * Cache of read handles used by bgfetches, or nullptr if disabled. Shared
+     * like the docCache: getMulti (on the RO store) uses it and the RW stores
+     * invalidate the vBuckets they change.
+     */
+    std::shared_ptr<CouchDbHandleCache> handleCache;
+
     /**
      * An internal rwlock used to keep openDB and compaction in sync
      * Primarily that compaction and scans can be ran concurrently, we must
@@ -691,6 +840,12 @@ protected:
      */
     std::unique_ptr<FileOpsInterface> statCollectingFileOpsCompaction;
 
+    /**
+     * FileOpsInterface implementation for couchstore used by scans, which
+     * reads ahead if configured to. Backed by this->st.fsStats
+     */
+    std::unique_ptr<FileOpsInterface> statCollectingFileOpsScan;
+
     /* deleted docs in each file, indexed by vBucket. RelaxedAtomic
        to allow stats access witout lock */
     std::vector<Couchbase::RelaxedAtomic<size_t>> cachedDeleteCount;
@@ -721,11 +876,15 @@ private:
      * @param readOnly true if the store can only do read functionality
      * @param dbFileRevMap a revisionMap to use (which should be data owned by
      *        the RW store).
+     * @param docCache the document cache to use (nullptr if disabled)
+     * @param handleCache the read handle cache to use (nullptr if disabled)
      */
     CouchKVStore(KVStoreConfig& config,
                  FileOpsInterface& ops,
                  bool readOnly,
-                 std::shared_ptr<RevisionMap> dbFileRevMap);
+                 std::shared_ptr<RevisionMap> dbFileRevMap,
+                 std::shared_ptr<DocumentCache> docCache,
+                 std::shared_ptr<CouchDbHandleCache> handleCache);
 
     /**
      * Construct a read-only store - private as should be called via
@@ -734,9 +893,13 @@ private:
      * @param config configuration data for the store
      * @param dbFileRevMap The revisionMap to use (which should be intially
      * created owned by the RW store).
+     * @param docCache the document cache of the RW store
+     * @param handleCache the read handle cache of the RW store
      */
     CouchKVStore(KVStoreConfig& config,
-                 std::shared_ptr<RevisionMap> dbFileRevMap);
+                 std::shared_ptr<RevisionMap> dbFileRevMap,
+                 std::shared_ptr<DocumentCache> docCache,
+                 std::shared_ptr<CouchDbHandleCache> handleCache);
 
     /**
      * RAII holder for a couchstore LocalDoc object
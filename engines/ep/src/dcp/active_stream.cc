@@ -18,6 +18,8 @@
 #include "active_stream_impl.h"
 
 #include "checkpoint_manager.h"
+#include "dcp/dcpconnmap.h"
+#include "dcp/item_transform_cache.h"
 #include "dcp/producer.h"
 #include "ep_time.h"
 #include "kv_bucket.h"
@@ -187,7 +189,8 @@ void ActiveStream::registerCursor(CheckpointManager& chkptmgr,
                                   uint64_t lastProcessedSeqno) {
     try {
         CursorRegResult result =
-                chkptmgr.registerCursorBySeqno(name_, lastProcessedSeqno);
+                chkptmgr.registerCursorBySeqno(
+                        name_, lastProcessedSeqno, getCursorCollections());
 
         log(spdlog::level::level_enum::info,
             "{} ActiveStream::registerCursor name \"{}\", backfill:{}, "
@@ -326,7 +329,12 @@ bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
 
         bufferedBackfill.bytes.fetch_add(resp->getApproximateSize());
         bufferedBackfill.items++;
-        lastReadSeqno.store(uint64_t(*resp->getBySeqno()));
+        // A key order backfill reads its snapshot out of seqno order; it has
+        // read up to the highest seqno seen.
+        const auto seqno = uint64_t(*resp->getBySeqno());
+        if (!isKeyOrderBackfill() || seqno > lastReadSeqno.load()) {
+            lastReadSeqno.store(seqno);
+        }
 
         pushToReadyQ(std::move(resp));
 
@@ -765,7 +773,11 @@ std::unique_ptr<DcpResponse> ActiveStream::nextQueuedItem() {
         if (producer->bufferLogInsert(response->getMessageSize())) {
             auto seqno = response->getBySeqno();
             if (seqno) {
-                lastSentSeqno.store(*seqno);
+                // A key order backfill sends its snapshot out of seqno order.
+                if (!isKeyOrderBackfill() ||
+                    uint64_t(*seqno) > lastSentSeqno.load()) {
+                    lastSentSeqno.store(*seqno);
+                }
 
                 if (isBackfilling()) {
                     backfillItems.sent++;
@@ -889,6 +901,12 @@ static bool shouldModifyItem(const queued_item& item,
 
 std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
         const queued_item& item) {
+    cb::compression::Buffer scratch;
+    return makeResponseFromItem(item, scratch);
+}
+
+std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
+        const queued_item& item, cb::compression::Buffer& scratch) {
     // Note: This function is hot - it is called for every item to be
     // sent over the DCP connection.
     if (item->getOperation() != queue_op::system_event) {
@@ -897,13 +915,33 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
                              includeXattributes,
                              isForceValueCompressionEnabled(),
                              isSnappyEnabled())) {
+            // Other streams of the vBucket may well have sent the same
+            // modification of the item already.
+            auto& cache = engine->getDcpConnMap().getItemTransformCache();
+            const auto transform = DcpItemTransformCache::makeTransform(
+                    includeValue,
+                    includeXattributes,
+                    isForceValueCompressionEnabled(),
+                    isSnappyEnabled());
+            queued_item cached = cache.find(*item, transform);
+            if (cached) {
+                return std::make_unique<MutationResponse>(cached,
+                                                          opaque_,
+                                                          includeValue,
+                                                          includeXattributes,
+                                                          includeDeleteTime,
+                                                          includeCollectionID,
+                                                          enableExpiryOutput,
+                                                          sid);
+            }
+
             auto finalItem = std::make_unique<Item>(*item);
             finalItem->pruneValueAndOrXattrs(includeValue, includeXattributes);
 
             if (isSnappyEnabled()) {
                 if (isForceValueCompressionEnabled()) {
                     if (!mcbp::datatype::is_snappy(finalItem->getDataType())) {
-                        if (!finalItem->compressValue()) {
+                        if (!finalItem->compressValue(scratch)) {
                             log(spdlog::level::level_enum::warn,
                                 "{} Failed to snappy compress an uncompressed "
                                 "value",
@@ -913,7 +951,7 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
                 }
             } else {
                 if (mcbp::datatype::is_snappy(finalItem->getDataType())) {
-                    if (!finalItem->decompressValue()) {
+                    if (!finalItem->decompressValue(scratch)) {
                         log(spdlog::level::level_enum::warn,
 
                             "{} Failed to snappy uncompress a compressed "
@@ -926,7 +964,9 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
             /**
              * Create a mutation response to be placed in the ready queue.
              */
-            return std::make_unique<MutationResponse>(std::move(finalItem),
+            queued_item modified(std::move(finalItem));
+            cache.insert(*item, transform, modified);
+            return std::make_unique<MutationResponse>(std::move(modified),
                                                       opaque_,
                                                       includeValue,
                                                       includeXattributes,
@@ -958,6 +998,7 @@ void ActiveStream::processItems(std::vector<queued_item>& items,
         }
 
         std::deque<std::unique_ptr<DcpResponse>> mutations;
+        cb::compression::Buffer scratch;
         for (auto& qi : items) {
             if (shouldProcessItem(*qi)) {
                 curChkSeqno = qi->getBySeqno();
@@ -965,7 +1006,7 @@ void ActiveStream::processItems(std::vector<queued_item>& items,
                 // Check if the item is allowed on the stream, note the filter
                 // updates itself for collection deletion events
                 if (filter.checkAndUpdate(*qi)) {
-                    mutations.push_back(makeResponseFromItem(qi));
+                    mutations.push_back(makeResponseFromItem(qi, scratch));
                 }
 
             } else if (qi->getOperation() == queue_op::checkpoint_start) {
@@ -1004,6 +1045,16 @@ void ActiveStream::processItems(std::vector<queued_item>& items,
     notifyStreamReady(true);
 }
 
+std::shared_ptr<const std::vector<CollectionID>>
+ActiveStream::getCursorCollections() const {
+    auto collections = filter.getFixedCollections();
+    if (!collections) {
+        return {};
+    }
+    return std::make_shared<const std::vector<CollectionID>>(
+            std::move(*collections));
+}
+
 bool ActiveStream::shouldProcessItem(const Item& item) {
     if (!item.shouldReplicate(syncReplication == SyncReplication::Yes)) {
         return false;
@@ -1199,7 +1250,9 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
         try {
             auto registerResult =
                     vbucket->checkpointManager->registerCursorBySeqno(
-                            name_, lastReadSeqno.load());
+                            name_,
+                            lastReadSeqno.load(),
+                            getCursorCollections());
             log(spdlog::level::level_enum::info,
                 "{} ActiveStream::scheduleBackfill_UNLOCKED register cursor "
                 "with "
@@ -1306,7 +1359,9 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
             try {
                 CursorRegResult result =
                         vbucket->checkpointManager->registerCursorBySeqno(
-                                name_, lastReadSeqno.load());
+                                name_,
+                                lastReadSeqno.load(),
+                                getCursorCollections());
                 log(spdlog::level::level_enum::info,
                     "{} ActiveStream::scheduleBackfill_UNLOCKED "
                     "Rescheduling. Register cursor with name \"{}\", "
@@ -125,6 +125,14 @@ public:
                (includeXattributes == IncludeXattrs::No);
     }
 
+    /// @return true if the stream accepts a disk backfill in key order
+    /// (DCP_ADD_STREAM_FLAG_KEY_ORDER_BACKFILL). Never true of a takeover
+    /// stream, whose consumer needs every snapshot in seqno order.
+    bool isKeyOrderBackfill() const {
+        return (flags_ & DCP_ADD_STREAM_FLAG_KEY_ORDER_BACKFILL) &&
+               !(flags_ & DCP_ADD_STREAM_FLAG_TAKEOVER);
+    }
+
     const Cursor& getCursor() const override {
         return cursor;
     }
@@ -158,6 +166,14 @@ protected:
      */
     std::unique_ptr<DcpResponse> makeResponseFromItem(const queued_item& item);
 
+    /**
+     * As makeResponseFromItem(item), using the given buffer to (de)compress
+     * the value of the item (if the stream requires it) so a batch of items
+     * can share one.
+     */
+    std::unique_ptr<DcpResponse> makeResponseFromItem(
+            const queued_item& item, cb::compression::Buffer& scratch);
+
     /* The transitionState function is protected (as opposed to private) for
      * testing purposes.
      */
@@ -175,6 +191,13 @@ protected:
     virtual void registerCursor(CheckpointManager& chkptmgr,
                                 uint64_t lastProcessedSeqno);
 
+    /**
+     * @return the collections to limit the stream's checkpoint cursor to
+     *         (see Filter::getFixedCollections()), null for all.
+     */
+    std::shared_ptr<const std::vector<CollectionID>> getCursorCollections()
+            const;
+
     /**
      * Unlocked variant of nextCheckpointItemTask caller must obtain
      * streamMutex and pass a reference to it
@@ -30,6 +30,8 @@
 
 #include <phosphor/phosphor.h>
 
+#include <algorithm>
+
 static const size_t sleepTime = 1;
 
 class BackfillManagerTask : public GlobalTask {
@@ -98,13 +100,19 @@ std::chrono::microseconds BackfillManagerTask::maxExpectedDuration() {
 }
 
 BackfillManager::BackfillManager(EventuallyPersistentEngine& e)
-    : engine(e), managerTask(NULL) {
+    : lock(&e.getEpStats().lockProfiles.backfillManager),
+      engine(e),
+      managerTask(NULL) {
     Configuration& config = e.getConfiguration();
 
     scanBuffer.bytesRead = 0;
     scanBuffer.itemsRead = 0;
     scanBuffer.maxBytes = config.getDcpScanByteLimit();
     scanBuffer.maxItems = config.getDcpScanItemLimit();
+    scanBuffer.baseBytes = scanBuffer.maxBytes;
+    scanBuffer.baseItems = scanBuffer.maxItems;
+    scanBuffer.limitBytes = config.getDcpScanByteLimitMax();
+    scanBuffer.limited = false;
 
     buffer.bytesRead = 0;
     buffer.maxBytes = config.getDcpBackfillByteLimit();
@@ -125,6 +133,40 @@ void BackfillManager::addStats(DcpProducer& conn,
     conn.addStat(
             "backfill_num_snoozing", snoozingBackfills.size(), add_stat, c);
     conn.addStat("backfill_num_pending", pendingBackfills.size(), add_stat, c);
+    conn.addStat("backfill_scan_max_bytes", scanBuffer.maxBytes, add_stat, c);
+    conn.addStat("backfill_scan_max_items", scanBuffer.maxItems, add_stat, c);
+
+    auto addBackfillStats = [&conn, add_stat, c](const DCPBackfill& backfill) {
+        const auto& stats = backfill.getRunStats();
+        const auto age = backfill.getAge().count();
+        const std::string prefix =
+                "backfill_" + std::to_string(backfill.getVBucketId().get());
+        conn.addStat((prefix + "_runs").c_str(), stats.runs, add_stat, c);
+        conn.addStat((prefix + "_items").c_str(), stats.items, add_stat, c);
+        conn.addStat((prefix + "_bytes").c_str(), stats.bytes, add_stat, c);
+        conn.addStat((prefix + "_bytes_per_sec").c_str(),
+                     stats.runTime.count() > 0
+                             ? uint64_t(stats.bytes * 1000000.0 /
+                                        stats.runTime.count())
+                             : 0,
+                     add_stat,
+                     c);
+        conn.addStat((prefix + "_run_time_us").c_str(),
+                     stats.runTime.count(),
+                     add_stat,
+                     c);
+        conn.addStat((prefix + "_max_run_time_us").c_str(),
+                     stats.maxRunTime.count(),
+                     add_stat,
+                     c);
+        conn.addStat((prefix + "_age_us").c_str(), age, add_stat, c);
+    };
+    for (const auto& backfill : activeBackfills) {
+        addBackfillStats(*backfill);
+    }
+    for (const auto& snoozer : snoozingBackfills) {
+        addBackfillStats(*snoozer.second);
+    }
 }
 
 BackfillManager::~BackfillManager() {
@@ -182,6 +224,7 @@ void BackfillManager::schedule(VBucket& vb,
 bool BackfillManager::bytesCheckAndRead(size_t bytes) {
     LockHolder lh(lock);
     if (scanBuffer.itemsRead >= scanBuffer.maxItems) {
+        scanBuffer.limited = true;
         return false;
     }
 
@@ -192,6 +235,7 @@ bool BackfillManager::bytesCheckAndRead(size_t bytes) {
         scanBuffer.bytesRead += bytes;
     } else {
         /* Subsequent items for this backfill will be read in next run */
+        scanBuffer.limited = true;
         return false;
     }
 
@@ -227,6 +271,11 @@ void BackfillManager::bytesForceRead(size_t bytes) {
     }
 }
 
+size_t BackfillManager::getBytesRead() {
+    LockHolder lh(lock);
+    return buffer.bytesRead;
+}
+
 void BackfillManager::bytesSent(size_t bytes) {
     LockHolder lh(lock);
     if (bytes > buffer.bytesRead) {
@@ -261,7 +310,7 @@ void BackfillManager::bytesSent(size_t bytes) {
 }
 
 backfill_status_t BackfillManager::backfill() {
-    std::unique_lock<std::mutex> lh(lock);
+    std::unique_lock<ProfiledMutex<>> lh(lock);
 
     if (activeBackfills.empty() && snoozingBackfills.empty()
         && pendingBackfills.empty()) {
@@ -312,11 +361,20 @@ backfill_status_t BackfillManager::backfill() {
     activeBackfills.pop_front();
 
     lh.unlock();
+    const auto start = std::chrono::steady_clock::now();
     backfill_status_t status = backfill->run();
+    const auto duration = std::chrono::steady_clock::now() - start;
     lh.lock();
 
+    backfill->recordRun(
+            scanBuffer.itemsRead,
+            scanBuffer.bytesRead,
+            std::chrono::duration_cast<std::chrono::microseconds>(duration));
+    adaptScanBuffer();
+
     scanBuffer.bytesRead = 0;
     scanBuffer.itemsRead = 0;
+    scanBuffer.limited = false;
 
     switch (status) {
         case backfill_success:
@@ -348,6 +406,31 @@ backfill_status_t BackfillManager::backfill() {
     return backfill_success;
 }
 
+void BackfillManager::adaptScanBuffer() {
+    if (scanBuffer.baseBytes == 0 ||
+        scanBuffer.limitBytes <= scanBuffer.baseBytes) {
+        return;
+    }
+
+    size_t newMaxBytes = scanBuffer.maxBytes;
+    // What the client still hadn't drained from earlier runs.
+    const size_t outstanding = buffer.bytesRead > scanBuffer.bytesRead
+                                       ? buffer.bytesRead - scanBuffer.bytesRead
+                                       : 0;
+    if (buffer.full) {
+        newMaxBytes = std::max(scanBuffer.baseBytes, newMaxBytes / 2);
+    } else if (scanBuffer.limited && outstanding <= buffer.maxBytes / 4) {
+        newMaxBytes = std::min(scanBuffer.limitBytes, newMaxBytes * 2);
+    }
+
+    if (newMaxBytes != scanBuffer.maxBytes) {
+        scanBuffer.maxBytes = newMaxBytes;
+        // Keep the item limit in proportion.
+        scanBuffer.maxItems =
+                scanBuffer.baseItems * (newMaxBytes / scanBuffer.baseBytes);
+    }
+}
+
 void BackfillManager::moveToActiveQueue() {
     // Order in below AND is important
     while (!pendingBackfills.empty() &&
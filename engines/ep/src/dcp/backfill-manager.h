@@ -36,8 +36,16 @@
  * sufficiently drained (by sending to the client), backfilling can be
  * resumed.
  *
+ * The amount read by each run of a backfill (the scan buffer) can adapt to
+ * how fast the client drains the buffer: while the buffer is kept mostly
+ * empty and runs are cut short by the scan buffer, the scan buffer doubles
+ * (up to dcp_scan_byte_limit_max); when the buffer fills it halves again
+ * (down to dcp_scan_byte_limit). A fast client is then fed in large reads,
+ * while the overall buffer limit still bounds the memory a slow one pins.
+ *
  * Significant configuration parameters affecting backfill:
  * - dcp_scan_byte_limit
+ * - dcp_scan_byte_limit_max
  * - dcp_scan_item_limit
  * - dcp_backfill_byte_limit
  */
@@ -45,6 +53,7 @@
 
 #include "config.h"
 #include "dcp/backfill.h"
+#include "lock_profiler.h"
 
 #include <list>
 
@@ -84,6 +93,9 @@ public:
 
     void bytesSent(size_t bytes);
 
+    /// @returns the bytes read by backfills and not yet sent.
+    size_t getBytesRead();
+
     // Called by the managerTask to acutally perform backfilling & manage
     // backfills between the different queues.
     backfill_status_t backfill();
@@ -105,13 +117,29 @@ protected:
         size_t itemsRead;
         size_t maxBytes;
         size_t maxItems;
+        //! The configured (and minimum) maxBytes / maxItems
+        size_t baseBytes;
+        size_t baseItems;
+        //! Upper bound of maxBytes when adapting; not adapting if not above
+        //! baseBytes
+        size_t limitBytes;
+        //! The current run was stopped by the scan buffer limits
+        bool limited;
     } scanBuffer;
 
 private:
+    /// Holder of the (profiled) lock, shadowing the global LockHolder
+    using LockHolder = std::lock_guard<ProfiledMutex<>>;
 
     void moveToActiveQueue();
 
-    std::mutex lock;
+    /**
+     * Grow or shrink the scan buffer after a backfill run, depending on how
+     * well the client is draining the buffer. Called with lock held.
+     */
+    void adaptScanBuffer();
+
+    ProfiledMutex<> lock;
     std::list<UniqueDCPBackfillPtr> activeBackfills;
     std::list<std::pair<rel_time_t, UniqueDCPBackfillPtr> > snoozingBackfills;
     //! When the number of (activeBackfills + snoozingBackfills) crosses a
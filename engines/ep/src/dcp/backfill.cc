@@ -20,16 +20,34 @@
 #include "dcp/active_stream.h"
 #include "dcp/backfill.h"
 
+#include <algorithm>
+
 DCPBackfill::DCPBackfill(std::shared_ptr<ActiveStream> s,
                          uint64_t startSeqno,
                          uint64_t endSeqno)
     : streamPtr(s),
       startSeqno(startSeqno),
       endSeqno(endSeqno),
-      vbid(s->getVBucket()) {
+      vbid(s->getVBucket()),
+      created(std::chrono::steady_clock::now()) {
 }
 
 bool DCPBackfill::isStreamDead() const {
     auto stream = streamPtr.lock();
     return !stream || !stream->isActive();
 }
+
+void DCPBackfill::recordRun(size_t items,
+                            size_t bytes,
+                            std::chrono::microseconds duration) {
+    ++runStats.runs;
+    runStats.items += items;
+    runStats.bytes += bytes;
+    runStats.runTime += duration;
+    runStats.maxRunTime = std::max(runStats.maxRunTime, duration);
+}
+
+std::chrono::microseconds DCPBackfill::getAge() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - created);
+}
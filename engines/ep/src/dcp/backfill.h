@@ -21,6 +21,8 @@
 
 #include "vbucket.h"
 
+#include <chrono>
+
 class ActiveStream;
 class ScanContext;
 
@@ -33,6 +35,17 @@ enum backfill_status_t {
     backfill_snooze
 };
 
+/**
+ * Work done by a backfill, as recorded by the BackfillManager running it.
+ */
+struct BackfillRunStats {
+    size_t runs = 0;
+    size_t items = 0;
+    size_t bytes = 0;
+    std::chrono::microseconds runTime{0};
+    std::chrono::microseconds maxRunTime{0};
+};
+
 class DCPBackfill {
 public:
     DCPBackfill(std::shared_ptr<ActiveStream> s,
@@ -70,6 +83,24 @@ public:
      */
     virtual void cancel() = 0;
 
+    /**
+     * Record one run of the backfill.
+     *
+     * @param items items read by the run
+     * @param bytes bytes read by the run
+     * @param duration how long the run took
+     */
+    void recordRun(size_t items,
+                   size_t bytes,
+                   std::chrono::microseconds duration);
+
+    const BackfillRunStats& getRunStats() const {
+        return runStats;
+    }
+
+    /// @returns how long ago the backfill was created.
+    std::chrono::microseconds getAge() const;
+
 protected:
     /**
      * Ptr to the associated Active DCP stream. Backfill can be run for only
@@ -95,6 +126,10 @@ protected:
      * Id of the vbucket on which the backfill is running
      */
     const Vbid vbid;
+
+    const std::chrono::steady_clock::time_point created;
+
+    BackfillRunStats runStats;
 };
 
 using UniqueDCPBackfillPtr = std::unique_ptr<DCPBackfill>;
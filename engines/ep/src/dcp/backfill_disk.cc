@@ -19,10 +19,14 @@
 
 #include "dcp/active_stream_impl.h"
 #include "dcp/backfill_disk.h"
+#include "dcp/dcpconnmap.h"
 #include "ep_engine.h"
 #include "kv_bucket.h"
+#include "kvstore.h"
 #include "vbucket.h"
 
+#include <algorithm>
+
 static std::string backfillStateToString(backfill_state_t state) {
     switch (state) {
     case backfill_state_init:
@@ -151,6 +155,239 @@ void DiskCallback::callback(GetValue& val) {
     }
 }
 
+class SharedDiskScan::FanOutCacheCallback
+    : public StatusCallback<CacheLookup> {
+public:
+    explicit FanOutCacheCallback(SharedDiskScan& scan) : scan(scan) {
+    }
+
+    void callback(CacheLookup& lookup) override {
+        setStatus(scan.cacheLookup(lookup));
+    }
+
+private:
+    SharedDiskScan& scan;
+};
+
+class SharedDiskScan::FanOutDiskCallback : public StatusCallback<GetValue> {
+public:
+    explicit FanOutDiskCallback(SharedDiskScan& scan) : scan(scan) {
+    }
+
+    void callback(GetValue& val) override {
+        setStatus(scan.diskRead(val));
+    }
+
+private:
+    SharedDiskScan& scan;
+};
+
+SharedDiskScan::SharedDiskScan(KVStore& kvstore, ValueFilter valFilter)
+    : kvstore(kvstore),
+      valFilter(valFilter),
+      diskCallback(std::make_shared<FanOutDiskCallback>(*this)),
+      cacheCallback(std::make_shared<FanOutCacheCallback>(*this)) {
+}
+
+SharedDiskScan::~SharedDiskScan() {
+    if (scanCtx) {
+        kvstore.destroyScanContext(scanCtx);
+    }
+}
+
+void SharedDiskScan::setScanContext(ScanContext* ctx) {
+    scanCtx = ctx;
+    position = ctx->startSeqno - 1;
+}
+
+uint64_t SharedDiskScan::getMaxSeqno() const {
+    return scanCtx->maxSeqno;
+}
+
+void SharedDiskScan::add(const void* owner,
+                         EventuallyPersistentEngine& engine,
+                         std::shared_ptr<ActiveStream> stream,
+                         uint64_t startSeqno) {
+    LockHolder lh(membersLock);
+    addMember(owner, engine, stream, startSeqno);
+}
+
+bool SharedDiskScan::join(const void* owner,
+                          EventuallyPersistentEngine& engine,
+                          std::shared_ptr<ActiveStream> stream,
+                          uint64_t startSeqno,
+                          uint64_t endSeqno,
+                          ValueFilter filter) {
+    LockHolder lh(membersLock);
+    // The scan must not have read anything the member needs yet, and must
+    // reach as far as the member needs. A start at or below the purge seqno
+    // is left to a backfill of its own to fail.
+    if (done || filter != valFilter ||
+        int64_t(startSeqno) < scanCtx->startSeqno ||
+        int64_t(startSeqno) <= position ||
+        int64_t(endSeqno) > scanCtx->maxSeqno ||
+        (startSeqno != 1 && startSeqno <= scanCtx->purgeSeqno)) {
+        return false;
+    }
+    // The marker has to be queued before the member can receive any items.
+    stream->incrBackfillRemaining(scanCtx->documentCount);
+    stream->markDiskSnapshot(startSeqno, scanCtx->maxSeqno);
+    addMember(owner, engine, stream, startSeqno);
+    return true;
+}
+
+void SharedDiskScan::addMember(const void* owner,
+                               EventuallyPersistentEngine& engine,
+                               std::shared_ptr<ActiveStream> stream,
+                               uint64_t startSeqno) {
+    members.push_back(std::make_shared<Member>(
+            Member{owner,
+                   startSeqno,
+                   std::make_shared<CacheCallback>(engine, stream),
+                   std::make_shared<DiskCallback>(stream),
+                   int64_t(startSeqno) - 1}));
+}
+
+void SharedDiskScan::leave(const void* owner) {
+    LockHolder lh(membersLock);
+    members.erase(std::remove_if(members.begin(),
+                                 members.end(),
+                                 [owner](const std::shared_ptr<Member>& m) {
+                                     return m->owner == owner;
+                                 }),
+                  members.end());
+}
+
+SharedDiskScan::Status SharedDiskScan::scan(const void* owner) {
+    std::unique_lock<std::mutex> lh(scanLock, std::try_to_lock);
+    if (!lh.owns_lock()) {
+        return Status::Busy;
+    }
+    {
+        LockHolder ml(membersLock);
+        if (done) {
+            return Status::Done;
+        }
+    }
+
+    pausedFor = nullptr;
+    if (kvstore.scan(scanCtx) == scan_again) {
+        return (pausedFor && pausedFor != owner) ? Status::Blocked
+                                                 : Status::Again;
+    }
+
+    LockHolder ml(membersLock);
+    done = true;
+    return Status::Done;
+}
+
+std::vector<std::shared_ptr<SharedDiskScan::Member>>
+SharedDiskScan::getMembersFor(int64_t seqno) {
+    // Members are only called outside of the lock - they call into their
+    // stream and BackfillManager, whose locks may be held by a thread
+    // cancelling a member.
+    std::vector<std::shared_ptr<Member>> result;
+    LockHolder lh(membersLock);
+    position = std::max(position, seqno);
+    for (const auto& member : members) {
+        if (int64_t(member->startSeqno) <= seqno && member->lastSeqno < seqno) {
+            result.push_back(member);
+        }
+    }
+    return result;
+}
+
+ENGINE_ERROR_CODE SharedDiskScan::cacheLookup(CacheLookup& lookup) {
+    const int64_t seqno = lookup.getBySeqno();
+    bool readDisk = false;
+    for (auto& member : getMembersFor(seqno)) {
+        member->cache->callback(lookup);
+        switch (member->cache->getStatus()) {
+        case ENGINE_KEY_EEXISTS:
+            // Sent from memory, or not wanted by the member.
+            member->lastSeqno = seqno;
+            break;
+        case ENGINE_ENOMEM:
+            pausedFor = member->owner;
+            return ENGINE_ENOMEM;
+        default:
+            readDisk = true;
+            break;
+        }
+    }
+    return readDisk ? ENGINE_SUCCESS : ENGINE_KEY_EEXISTS;
+}
+
+ENGINE_ERROR_CODE SharedDiskScan::diskRead(GetValue& val) {
+    if (!val.item) {
+        throw std::invalid_argument("SharedDiskScan::diskRead: val is NULL");
+    }
+    const int64_t seqno = val.item->getBySeqno();
+    auto needing = getMembersFor(seqno);
+    for (size_t ii = 0; ii < needing.size(); ++ii) {
+        auto& member = *needing[ii];
+        // Every member but the last gets a copy of the item.
+        if (ii + 1 < needing.size()) {
+            GetValue copy(std::make_unique<Item>(*val.item),
+                          val.getStatus(),
+                          -1,
+                          val.isPartial());
+            member.disk->callback(copy);
+        } else {
+            member.disk->callback(val);
+        }
+        if (member.disk->getStatus() == ENGINE_ENOMEM) {
+            pausedFor = member.owner;
+            return ENGINE_ENOMEM;
+        }
+        member.lastSeqno = seqno;
+    }
+    return ENGINE_SUCCESS;
+}
+
+std::shared_ptr<SharedDiskScan> SharedDiskScans::join(
+        Vbid vbid,
+        const void* owner,
+        EventuallyPersistentEngine& engine,
+        std::shared_ptr<ActiveStream> stream,
+        uint64_t startSeqno,
+        uint64_t endSeqno,
+        ValueFilter valFilter) {
+    LockHolder lh(lock);
+    auto itr = scans.find(vbid);
+    if (itr == scans.end()) {
+        return {};
+    }
+
+    auto& vbScans = itr->second;
+    std::shared_ptr<SharedDiskScan> joined;
+    for (auto scan = vbScans.begin(); scan != vbScans.end();) {
+        auto candidate = scan->lock();
+        if (!candidate) {
+            scan = vbScans.erase(scan);
+            continue;
+        }
+        if (!joined && candidate->join(owner,
+                                       engine,
+                                       stream,
+                                       startSeqno,
+                                       endSeqno,
+                                       valFilter)) {
+            joined = candidate;
+        }
+        ++scan;
+    }
+    if (vbScans.empty()) {
+        scans.erase(itr);
+    }
+    return joined;
+}
+
+void SharedDiskScans::add(Vbid vbid, std::shared_ptr<SharedDiskScan> scan) {
+    LockHolder lh(lock);
+    scans[vbid].push_back(scan);
+}
+
 DCPBackfillDisk::DCPBackfillDisk(EventuallyPersistentEngine& e,
                                  std::shared_ptr<ActiveStream> s,
                                  uint64_t startSeqno,
@@ -223,8 +460,39 @@ backfill_status_t DCPBackfillDisk::create() {
         }
     }
 
-    auto cb = std::make_shared<DiskCallback>(stream);
-    auto cl = std::make_shared<CacheCallback>(engine, stream);
+    // An initial backfill of a stream which accepts its items in any order
+    // can read them in key order. Shared scans track their progress by seqno,
+    // so such a backfill always has a scan of its own.
+    const bool keyOrder = stream->isKeyOrderBackfill() && startSeqno == 1 &&
+                          kvstore->supportsKeyOrderScan();
+    const bool shareScan =
+            !keyOrder && engine.getConfiguration().isDcpBackfillSharedScans();
+    if (shareScan) {
+        sharedScan = engine.getDcpConnMap().getSharedDiskScans().join(
+                vbid, this, engine, stream, startSeqno, endSeqno, valFilter);
+        if (sharedScan) {
+            stream->log(spdlog::level::level_enum::info,
+                        "({}) Backfill ({} to {}) joined a shared disk scan "
+                        "up to seqno {}",
+                        vbid,
+                        startSeqno,
+                        endSeqno,
+                        sharedScan->getMaxSeqno());
+            transitionState(backfill_state_scanning);
+            return backfill_success;
+        }
+    }
+
+    std::shared_ptr<StatusCallback<GetValue>> cb;
+    std::shared_ptr<StatusCallback<CacheLookup>> cl;
+    if (shareScan) {
+        sharedScan = std::make_shared<SharedDiskScan>(*kvstore, valFilter);
+        cb = sharedScan->getDiskCallback();
+        cl = sharedScan->getCacheCallback();
+    } else {
+        cb = std::make_shared<DiskCallback>(stream);
+        cl = std::make_shared<CacheCallback>(engine, stream);
+    }
     scanCtx = kvstore->initScanContext(
             cb, cl, vbid, startSeqno, DocumentFilter::ALL_ITEMS, valFilter);
 
@@ -258,10 +526,25 @@ backfill_status_t DCPBackfillDisk::create() {
 
         stream->log(spdlog::level::level_enum::warn, "{}", log.str());
         stream->setDead(status);
+        sharedScan.reset();
         transitionState(backfill_state_done);
     } else {
+        if (keyOrder) {
+            scanCtx->order = ScanOrder::ByKey;
+            stream->log(spdlog::level::level_enum::info,
+                        "({}) Backfill ({} to {}) reading in key order",
+                        vbid,
+                        startSeqno,
+                        endSeqno);
+        }
         stream->incrBackfillRemaining(scanCtx->documentCount);
         stream->markDiskSnapshot(startSeqno, scanCtx->maxSeqno);
+        if (sharedScan) {
+            sharedScan->setScanContext(scanCtx);
+            scanCtx = nullptr;
+            sharedScan->add(this, engine, stream, startSeqno);
+            engine.getDcpConnMap().getSharedDiskScans().add(vbid, sharedScan);
+        }
         transitionState(backfill_state_scanning);
     }
 
@@ -280,11 +563,24 @@ backfill_status_t DCPBackfillDisk::scan() {
         return complete(true);
     }
 
-    KVStore* kvstore = engine.getKVBucket()->getROUnderlying(vbid);
-    scan_error_t error = kvstore->scan(scanCtx);
+    if (sharedScan) {
+        switch (sharedScan->scan(this)) {
+        case SharedDiskScan::Status::Again:
+            return backfill_success;
+        case SharedDiskScan::Status::Blocked:
+        case SharedDiskScan::Status::Busy:
+            // Another member's backfill is (or will be) moving the scan on.
+            return backfill_snooze;
+        case SharedDiskScan::Status::Done:
+            break;
+        }
+    } else {
+        KVStore* kvstore = engine.getKVBucket()->getROUnderlying(vbid);
+        scan_error_t error = kvstore->scan(scanCtx);
 
-    if (error == scan_again) {
-        return backfill_success;
+        if (error == scan_again) {
+            return backfill_success;
+        }
     }
 
     transitionState(backfill_state_completing);
@@ -295,8 +591,15 @@ backfill_status_t DCPBackfillDisk::scan() {
 backfill_status_t DCPBackfillDisk::complete(bool cancelled) {
     /* we want to destroy kv store context irrespective of a premature complete
        or not */
-    KVStore* kvstore = engine.getKVBucket()->getROUnderlying(getVBucketId());
-    kvstore->destroyScanContext(scanCtx);
+    if (sharedScan) {
+        // The last member to leave destroys the shared context.
+        sharedScan->leave(this);
+        sharedScan.reset();
+    } else {
+        KVStore* kvstore =
+                engine.getKVBucket()->getROUnderlying(getVBucketId());
+        kvstore->destroyScanContext(scanCtx);
+    }
 
     auto stream = streamPtr.lock();
     if (!stream) {
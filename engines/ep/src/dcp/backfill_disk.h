@@ -22,8 +22,14 @@
 #include "callbacks.h"
 #include "dcp/backfill.h"
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 class EventuallyPersistentEngine;
+class KVStore;
 class ScanContext;
+enum class ValueFilter;
 
 /* The possible states of the DCPBackfillDisk */
 enum backfill_state_t {
@@ -67,6 +73,160 @@ private:
     std::weak_ptr<ActiveStream> streamPtr;
 };
 
+/**
+ * A disk scan of a vBucket shared by the disk backfills of several streams
+ * (say a rebalance, an indexer and an XDCR stream of the same vBucket), so
+ * the data file is read once rather than once per stream.
+ *
+ * A backfill can join a scan which reads values the same way (keys only,
+ * compressed or decompressed), covers the backfill's end seqno and hasn't yet
+ * read anything at or after the backfill's start seqno. Each item read is
+ * passed to every member needing it through that member's own CacheCallback
+ * and DiskCallback, so each stream still applies its own collection filter
+ * and buffer accounting.
+ *
+ * There is no owner: whichever member's backfill runs next drives the scan.
+ * If a member rejects an item (its backfill buffer is full) the scan pauses
+ * for every member and later resumes from that item, each member skipping
+ * the items it already has.
+ */
+class SharedDiskScan {
+public:
+    /// Outcome of a call to scan().
+    enum class Status {
+        /// Scan yielded or paused for the calling member; run again.
+        Again,
+        /// Scan paused as another member rejected an item.
+        Blocked,
+        /// Another member is driving the scan.
+        Busy,
+        /// The scan is complete.
+        Done
+    };
+
+    SharedDiskScan(KVStore& kvstore, ValueFilter valFilter);
+
+    /// Destroys the scan context.
+    ~SharedDiskScan();
+
+    /// @returns the callbacks to create the scan context with.
+    std::shared_ptr<StatusCallback<GetValue>> getDiskCallback() const {
+        return diskCallback;
+    }
+    std::shared_ptr<StatusCallback<CacheLookup>> getCacheCallback() const {
+        return cacheCallback;
+    }
+
+    /// Take ownership of the scan context, created with the above callbacks.
+    void setScanContext(ScanContext* ctx);
+
+    uint64_t getMaxSeqno() const;
+
+    /**
+     * Add the backfill which created the scan as its first member.
+     *
+     * @param owner identifies the member (the backfill)
+     */
+    void add(const void* owner,
+             EventuallyPersistentEngine& engine,
+             std::shared_ptr<ActiveStream> stream,
+             uint64_t startSeqno);
+
+    /**
+     * Add a member if the scan can still provide everything it needs, marking
+     * the disk snapshot on its stream.
+     *
+     * @return true if the member was added
+     */
+    bool join(const void* owner,
+              EventuallyPersistentEngine& engine,
+              std::shared_ptr<ActiveStream> stream,
+              uint64_t startSeqno,
+              uint64_t endSeqno,
+              ValueFilter valFilter);
+
+    /// Remove a member; it receives no more items.
+    void leave(const void* owner);
+
+    /// Run the scan on behalf of the given member.
+    Status scan(const void* owner);
+
+private:
+    struct Member {
+        const void* owner;
+        uint64_t startSeqno;
+        std::shared_ptr<CacheCallback> cache;
+        std::shared_ptr<DiskCallback> disk;
+        // Seqno of the last item given to (or filtered out by) the member.
+        // Only accessed by the member driving the scan.
+        int64_t lastSeqno;
+    };
+
+    class FanOutCacheCallback;
+    class FanOutDiskCallback;
+
+    /// Cache lookup of the item at the given seqno, for every member.
+    ENGINE_ERROR_CODE cacheLookup(CacheLookup& lookup);
+
+    /// Disk read of the item, for every member still needing it.
+    ENGINE_ERROR_CODE diskRead(GetValue& val);
+
+    /// @returns the members which still need the item at the given seqno.
+    std::vector<std::shared_ptr<Member>> getMembersFor(int64_t seqno);
+
+    void addMember(const void* owner,
+                   EventuallyPersistentEngine& engine,
+                   std::shared_ptr<ActiveStream> stream,
+                   uint64_t startSeqno);
+
+    KVStore& kvstore;
+    const ValueFilter valFilter;
+    ScanContext* scanCtx = nullptr;
+    std::shared_ptr<StatusCallback<GetValue>> diskCallback;
+    std::shared_ptr<StatusCallback<CacheLookup>> cacheCallback;
+
+    // Held by the member driving the scan.
+    std::mutex scanLock;
+    // The member which paused the scan by rejecting an item (under scanLock).
+    const void* pausedFor = nullptr;
+
+    // Guards the fields below.
+    std::mutex membersLock;
+    std::vector<std::shared_ptr<Member>> members;
+    // Seqno of the item the scan last reached.
+    int64_t position = 0;
+    bool done = false;
+};
+
+/**
+ * The SharedDiskScans running in a bucket, by vBucket.
+ */
+class SharedDiskScans {
+public:
+    /**
+     * Join a running scan of the vBucket which can provide everything the
+     * backfill needs.
+     *
+     * @return the scan joined, or nullptr if there is none
+     */
+    std::shared_ptr<SharedDiskScan> join(Vbid vbid,
+                                         const void* owner,
+                                         EventuallyPersistentEngine& engine,
+                                         std::shared_ptr<ActiveStream> stream,
+                                         uint64_t startSeqno,
+                                         uint64_t endSeqno,
+                                         ValueFilter valFilter);
+
+    /// Make a new scan available for others to join.
+    void add(Vbid vbid, std::shared_ptr<SharedDiskScan> scan);
+
+private:
+    std::mutex lock;
+    // A scan lives as long as its members' backfills hold it.
+    std::unordered_map<Vbid, std::vector<std::weak_ptr<SharedDiskScan>>>
+            scans;
+};
+
 /**
  * Concrete class that does backfill from the disk and informs the DCP stream
  * of the backfill progress.
@@ -123,6 +283,8 @@ private:
     EventuallyPersistentEngine& engine;
 
     ScanContext* scanCtx;
+    // Set (instead of scanCtx) when the backfill is part of a shared scan.
+    std::shared_ptr<SharedDiskScan> sharedScan;
     backfill_state_t state;
     std::mutex lock;
 };
@@ -46,11 +46,13 @@ const std::string DcpConsumer::sendStreamEndOnClientStreamCloseCtrlMsg =
 const std::string DcpConsumer::hifiMFUCtrlMsg = "supports_hifi_MFU";
 const std::string DcpConsumer::enableOpcodeExpiryCtrlMsg =
         "enable_expiry_opcode";
+const std::string DcpConsumer::stepBatchSizeCtrlMsg = "step_batch_size";
 
 class DcpConsumerTask : public GlobalTask {
 public:
     DcpConsumerTask(EventuallyPersistentEngine* e,
                     std::shared_ptr<DcpConsumer> c,
+                    size_t processor,
                     double sleeptime = 1,
                     bool completeBeforeShutdown = true)
         : GlobalTask(e,
@@ -58,8 +60,12 @@ public:
                      sleeptime,
                      completeBeforeShutdown),
           consumerPtr(c),
+          processor(processor),
           description("DcpConsumerTask, processing buffered items for " +
-                      c->getName()) {
+                      c->getName() +
+                      (c->getNumProcessors() > 1
+                               ? " (" + std::to_string(processor) + ")"
+                               : "")) {
     }
 
     ~DcpConsumerTask() {
@@ -81,7 +87,8 @@ public:
         }
 
         double sleepFor = 0.0;
-        enum process_items_error_t state = consumer->processBufferedItems();
+        enum process_items_error_t state =
+                consumer->processBufferedItems(processor);
         switch (state) {
             case all_processed:
                 sleepFor = INT_MAX;
@@ -109,14 +116,14 @@ public:
         // between the second `if(consumer->notifiedProcessor)` and us calling
         // `wakeUp()`; but that's essentially a benign race as it will just
         // result in wakeUp() being called twice which is benign.
-        if (consumer->notifiedProcessor(false)) {
+        if (consumer->notifiedProcessor(false, processor)) {
             wakeUp();
             state = more_to_process;
         } else {
             snooze(sleepFor);
             // Check if the processor was notified again,
             // in which case the task should wake immediately.
-            if (consumer->notifiedProcessor(false)) {
+            if (consumer->notifiedProcessor(false, processor)) {
                 wakeUp();
                 state = more_to_process;
             }
@@ -138,9 +145,11 @@ public:
     }
 
 private:
-    /* we have one task per consumer. the task only needs a reference to the
-       consumer object and does not own it. Hence std::weak_ptr should be used*/
+    /* we have one task per consumer Processor. the task only needs a reference
+       to the consumer object and does not own it. Hence std::weak_ptr should
+       be used*/
     const std::weak_ptr<DcpConsumer> consumerPtr;
+    const size_t processor;
     const std::string description;
 };
 
@@ -151,9 +160,7 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine& engine,
       lastMessageTime(ep_current_time()),
       engine(engine),
       opaqueCounter(0),
-      processorTaskId(0),
       processorTaskState(all_processed),
-      processorNotification(false),
       backoffs(0),
       dcpNoopTxInterval(engine.getConfiguration().getDcpNoopTxInterval()),
       pendingSendStreamEndOnClientStreamClose(true),
@@ -182,6 +189,12 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine& engine,
             (config.getHtEvictionPolicy() == "hifi_mfu");
     pendingEnableExpiryOpcode = true;
     pendingEnableSyncReplication = true;
+    stepBatchSize = config.getDcpStepBatchSize();
+    pendingSetStepBatchSize = stepBatchSize > 1;
+
+    for (size_t ii = 0; ii < config.getDcpConsumerProcessorTasks(); ++ii) {
+        processors.push_back(std::make_unique<Processor>());
+    }
 }
 
 DcpConsumer::~DcpConsumer() {
@@ -192,7 +205,9 @@ DcpConsumer::~DcpConsumer() {
 void DcpConsumer::cancelTask() {
     bool exp = true;
     if (processorTaskRunning.compare_exchange_strong(exp, false)) {
-        ExecutorPool::get()->cancel(processorTaskId);
+        for (auto& processor : processors) {
+            ExecutorPool::get()->cancel(processor->taskId);
+        }
     }
 }
 
@@ -277,13 +292,15 @@ ENGINE_ERROR_CODE DcpConsumer::addStream(uint32_t opaque,
         }
     }
 
-    /* We need 'Processor' task only when we have a stream. Hence create it
-     only once when the first stream is added */
+    /* We need 'Processor' tasks only when we have a stream. Hence create
+     them only once when the first stream is added */
     bool exp = false;
     if (processorTaskRunning.compare_exchange_strong(exp, true)) {
-        ExTask task = std::make_shared<DcpConsumerTask>(
-                &engine, shared_from_this(), 1);
-        processorTaskId = ExecutorPool::get()->schedule(task);
+        for (size_t ii = 0; ii < processors.size(); ++ii) {
+            ExTask task = std::make_shared<DcpConsumerTask>(
+                    &engine, shared_from_this(), ii, 1);
+            processors[ii]->taskId = ExecutorPool::get()->schedule(task);
+        }
     }
 
     streams.insert({vbucket,
@@ -847,6 +864,10 @@ ENGINE_ERROR_CODE DcpConsumer::step(struct dcp_message_producers* producers) {
         return ret;
     }
 
+    if ((ret = setStepBatchSize(producers)) != ENGINE_FAILED) {
+        return ret;
+    }
+
     auto resp = getNextItem();
     if (resp == nullptr) {
         return ENGINE_EWOULDBLOCK;
@@ -1077,15 +1098,28 @@ void DcpConsumer::addStats(ADD_STAT add_stat, const void *c) {
     addStat("processor_task_state", getProcessorTaskStatusStr(), add_stat, c);
     flowControl.addStats(add_stat, c);
 
-    vbReady.addStats(getName() + ":dcp_buffered_ready_queue_", add_stat, c);
-    addStat("processor_notification",
-            processorNotification.load(),
-            add_stat,
-            c);
+    for (size_t ii = 0; ii < processors.size(); ++ii) {
+        // The first Processor keeps the stat names of a single task.
+        const auto suffix = ii == 0 ? std::string() : "_" + std::to_string(ii);
+        processors[ii]->vbReady.addStats(
+                getName() + ":dcp_buffered_ready_queue" + suffix + "_",
+                add_stat,
+                c);
+        addStat(("processor_notification" + suffix).c_str(),
+                processors[ii]->notification.load(),
+                add_stat,
+                c);
+    }
 }
 
 void DcpConsumer::aggregateQueueStats(ConnCounter& aggregator) {
     aggregator.conn_queueBackoff += backoffs;
+    streams.for_each(
+            [&aggregator](const PassiveStreamMap::value_type& element) {
+                aggregator.conn_bufferedBytes +=
+                        element.second->getReadyQueueMemory() +
+                        element.second->getBufferBytes();
+            });
 }
 
 process_items_error_t DcpConsumer::drainStreamsBufferedItems(
@@ -1097,12 +1131,14 @@ process_items_error_t DcpConsumer::drainStreamsBufferedItems(
         switch (engine_.getReplicationThrottle().getStatus()) {
         case ReplicationThrottle::Status::Pause:
             backoffs++;
-            vbReady.pushUnique(stream->getVBucket());
+            getProcessor(stream->getVBucket())
+                    .vbReady.pushUnique(stream->getVBucket());
             return cannot_process;
 
         case ReplicationThrottle::Status::Disconnect:
             backoffs++;
-            vbReady.pushUnique(stream->getVBucket());
+            getProcessor(stream->getVBucket())
+                    .vbReady.pushUnique(stream->getVBucket());
             logger->warn(
                     "{} Processor task indicating disconnection "
                     "as there is no memory to complete replication",
@@ -1130,7 +1166,8 @@ process_items_error_t DcpConsumer::drainStreamsBufferedItems(
 
     // The stream may not be done yet so must go back in the ready queue
     if (bytesProcessed > 0) {
-        vbReady.pushUnique(stream->getVBucket());
+        getProcessor(stream->getVBucket())
+                .vbReady.pushUnique(stream->getVBucket());
         if (rval == stop_processing) {
             return stop_processing;
         }
@@ -1140,7 +1177,8 @@ process_items_error_t DcpConsumer::drainStreamsBufferedItems(
     return rval;
 }
 
-process_items_error_t DcpConsumer::processBufferedItems() {
+process_items_error_t DcpConsumer::processBufferedItems(size_t processor) {
+    auto& vbReady = processors.at(processor)->vbReady;
     process_items_error_t process_ret = all_processed;
     Vbid vbucket = Vbid(0);
     while (vbReady.popFront(vbucket)) {
@@ -1176,15 +1214,17 @@ process_items_error_t DcpConsumer::processBufferedItems() {
 }
 
 void DcpConsumer::notifyVbucketReady(Vbid vbucket) {
-    if (vbReady.pushUnique(vbucket) &&
-        notifiedProcessor(true)) {
-        ExecutorPool::get()->wake(processorTaskId);
+    auto& processor = getProcessor(vbucket);
+    if (processor.vbReady.pushUnique(vbucket) &&
+        notifiedProcessor(true, vbucket.get() % processors.size())) {
+        ExecutorPool::get()->wake(processor.taskId);
     }
 }
 
-bool DcpConsumer::notifiedProcessor(bool to) {
+bool DcpConsumer::notifiedProcessor(bool to, size_t processor) {
     bool inverse = !to;
-    return processorNotification.compare_exchange_strong(inverse, to);
+    return processors.at(processor)->notification.compare_exchange_strong(
+            inverse, to);
 }
 
 void DcpConsumer::setProcessorTaskState(enum process_items_error_t to) {
@@ -1496,6 +1536,22 @@ ENGINE_ERROR_CODE DcpConsumer::enableSynchronousReplication(
     return ENGINE_FAILED;
 }
 
+ENGINE_ERROR_CODE DcpConsumer::setStepBatchSize(
+        dcp_message_producers* producers) {
+    /* Ask the producer to pass several messages to its front-end per step, so
+       they reach us in fewer (larger) writes. Older producers reject the
+       control message, which just leaves them sending one per step. */
+    if (pendingSetStepBatchSize) {
+        uint32_t opaque = ++opaqueCounter;
+        NonBucketAllocationGuard guard;
+        ENGINE_ERROR_CODE ret = producers->control(
+                opaque, stepBatchSizeCtrlMsg, std::to_string(stepBatchSize));
+        pendingSetStepBatchSize = false;
+        return ret;
+    }
+    return ENGINE_FAILED;
+}
+
 uint64_t DcpConsumer::incrOpaqueCounter()
 {
     return (++opaqueCounter);
@@ -1511,6 +1567,10 @@ void DcpConsumer::setFlowControlBufSize(uint32_t newSize)
     flowControl.setFlowControlBufSize(newSize);
 }
 
+uint64_t DcpConsumer::getFlowControlDrainedBytes() const {
+    return flowControl.getDrainedBytes();
+}
+
 const std::string& DcpConsumer::getControlMsgKey(void)
 {
     return connBufferCtrlMsg;
@@ -33,6 +33,8 @@
 
 #include <list>
 #include <map>
+#include <memory>
+#include <vector>
 
 class DcpResponse;
 class PassiveStream;
@@ -213,7 +215,13 @@ public:
 
     void closeStreamDueToVbStateChange(Vbid vbucket, vbucket_state_t state);
 
-    process_items_error_t processBufferedItems();
+    /**
+     * Process the buffered messages of the vBuckets handled by the given
+     * 'Processor' task.
+     *
+     * @param processor index of the Processor task
+     */
+    process_items_error_t processBufferedItems(size_t processor = 0);
 
     uint64_t incrOpaqueCounter();
 
@@ -221,6 +229,8 @@ public:
 
     void setFlowControlBufSize(uint32_t newSize);
 
+    uint64_t getFlowControlDrainedBytes() const;
+
     static const std::string& getControlMsgKey(void);
 
     bool isStreamPresent(Vbid vbucket);
@@ -229,7 +239,12 @@ public:
 
     void taskCancelled();
 
-    bool notifiedProcessor(bool to);
+    bool notifiedProcessor(bool to, size_t processor = 0);
+
+    /// @returns the number of 'Processor' tasks of this consumer.
+    size_t getNumProcessors() const {
+        return processors.size();
+    }
 
     void setProcessorTaskState(enum process_items_error_t to);
 
@@ -335,6 +350,8 @@ protected:
     ENGINE_ERROR_CODE enableSynchronousReplication(
             dcp_message_producers* producers);
 
+    ENGINE_ERROR_CODE setStepBatchSize(dcp_message_producers* producers);
+
     void notifyVbucketReady(Vbid vbucket);
 
     /**
@@ -453,11 +470,25 @@ protected:
     /* Reference to the ep engine; need to create the 'Processor' task */
     EventuallyPersistentEngine& engine;
     uint64_t opaqueCounter;
-    size_t processorTaskId;
     std::atomic<enum process_items_error_t> processorTaskState;
 
-    DcpReadyQueue vbReady;
-    std::atomic<bool> processorNotification;
+    /*
+     * Buffered messages are processed by one or more 'Processor' tasks
+     * (dcp_consumer_processor_tasks). A vBucket is always handled by the same
+     * task (vbid % number of tasks), so its messages are applied in order
+     * while different vBuckets are processed in parallel.
+     */
+    struct Processor {
+        size_t taskId = 0;
+        DcpReadyQueue vbReady;
+        std::atomic<bool> notification{false};
+    };
+
+    Processor& getProcessor(Vbid vbucket) {
+        return *processors[vbucket.get() % processors.size()];
+    }
+
+    std::vector<std::unique_ptr<Processor>> processors;
 
     std::mutex readyMutex;
     std::list<Vbid> ready;
@@ -486,6 +517,9 @@ protected:
     bool pendingSupportHifiMFU;
     bool pendingEnableExpiryOpcode;
     bool pendingEnableSyncReplication;
+    bool pendingSetStepBatchSize;
+    // The number of messages the consumer asks the producer to send per step
+    size_t stepBatchSize;
 
     /*
      * MB-29441: The following variables are used to set the the proper
@@ -504,7 +538,7 @@ protected:
     } getErrorMapState;
     bool producerIsVersion5orHigher;
 
-    /* Indicates if the 'Processor' task is running */
+    /* Indicates if the 'Processor' tasks are running */
     std::atomic<bool> processorTaskRunning;
 
     FlowControl flowControl;
@@ -533,6 +567,7 @@ protected:
     static const std::string sendStreamEndOnClientStreamCloseCtrlMsg;
     static const std::string hifiMFUCtrlMsg;
     static const std::string enableOpcodeExpiryCtrlMsg;
+    static const std::string stepBatchSizeCtrlMsg;
 };
 
 /*
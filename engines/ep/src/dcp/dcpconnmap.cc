@@ -20,7 +20,10 @@
 #include "bucket_logger.h"
 #include "configuration.h"
 #include "conn_notifier.h"
+#include "dcp/backfill_disk.h"
 #include "dcp/consumer.h"
+#include "dcp/flow-control-manager.h"
+#include "dcp/item_transform_cache.h"
 #include "dcp/producer.h"
 #include "ep_engine.h"
 #include <daemon/tracing.h>
@@ -45,6 +48,9 @@ private:
 
 DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     : ConnMap(e),
+      sharedDiskScans(std::make_unique<SharedDiskScans>()),
+      itemTransformCache(std::make_unique<DcpItemTransformCache>(
+              e.getConfiguration().getDcpItemTransformCacheSize())),
       aggrDcpConsumerBufferSize(0) {
     backfills.numActiveSnoozing = 0;
     updateMaxActiveSnoozingBackfills(engine.getEpStats().getMaxDataSize());
@@ -58,6 +64,9 @@ DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     engine.getConfiguration().addValueChangedListener(
             "dcp_consumer_process_buffered_messages_batch_size",
             std::make_unique<DcpConfigChangeListener>(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_conn_notifier_coalesce_us",
+            std::make_unique<DcpConfigChangeListener>(*this));
 }
 
 DcpConnMap::~DcpConnMap() {
@@ -379,6 +388,8 @@ void DcpConnMap::manageConnections() {
             removeVBConnections(*prod);
         }
     }
+
+    engine.getDcpFlowControlManager().adjustBuffers();
 }
 
 void DcpConnMap::removeVBConnections(DcpProducer& prod) {
@@ -461,6 +472,14 @@ void DcpConnMap::addStats(ADD_STAT add_stat, const void *c) {
     LockHolder lh(connsLock);
     add_casted_stat("ep_dcp_dead_conn_count", deadConnections.size(), add_stat,
                     c);
+    add_casted_stat("ep_dcp_item_transform_cache_hits",
+                    itemTransformCache->getHits(),
+                    add_stat,
+                    c);
+    add_casted_stat("ep_dcp_item_transform_cache_misses",
+                    itemTransformCache->getMisses(),
+                    add_stat,
+                    c);
 }
 
 void DcpConnMap::updateMinCompressionRatioForProducers(float value) {
@@ -480,6 +499,11 @@ void DcpConnMap::DcpConfigChangeListener::sizeValueChanged(const std::string &ke
         myConnMap.consumerYieldConfigChanged(value);
     } else if (key == "dcp_consumer_process_buffered_messages_batch_size") {
         myConnMap.consumerBatchSizeConfigChanged(value);
+    } else if (key == "dcp_conn_notifier_coalesce_us") {
+        if (myConnMap.connNotifier_) {
+            myConnMap.connNotifier_->setCoalesceWindow(
+                    std::chrono::microseconds(value));
+        }
     }
 }
 
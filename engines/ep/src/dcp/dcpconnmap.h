@@ -26,11 +26,14 @@
 
 #include <atomic>
 #include <list>
+#include <memory>
 #include <string>
 
 class CheckpointCursor;
 class DcpProducer;
 class DcpConsumer;
+class DcpItemTransformCache;
+class SharedDiskScans;
 
 class DcpConnMap : public ConnMap {
 
@@ -120,6 +123,16 @@ public:
         return backfills.maxActiveSnoozing;
     }
 
+    /// Disk backfill scans which other streams of the vBucket may join.
+    SharedDiskScans& getSharedDiskScans() {
+        return *sharedDiskScans;
+    }
+
+    /// Modified copies of items, shared by the streams sending them.
+    DcpItemTransformCache& getItemTransformCache() {
+        return *itemTransformCache;
+    }
+
     ENGINE_ERROR_CODE addPassiveStream(ConnHandler& conn,
                                        uint32_t opaque,
                                        Vbid vbucket,
@@ -200,6 +213,10 @@ protected:
 
     std::atomic<float> minCompressionRatioForProducer;
 
+    std::unique_ptr<SharedDiskScans> sharedDiskScans;
+
+    std::unique_ptr<DcpItemTransformCache> itemTransformCache;
+
     /* Total memory used by all DCP consumer buffers */
     std::atomic<size_t> aggrDcpConsumerBufferSize;
 
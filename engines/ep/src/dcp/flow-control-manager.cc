@@ -22,6 +22,8 @@
 #include "dcp/consumer.h"
 #include "ep_engine.h"
 
+#include <algorithm>
+
 DcpFlowControlManager::DcpFlowControlManager(EventuallyPersistentEngine &engine)
     : engine_(engine)
 {
@@ -40,6 +42,9 @@ bool DcpFlowControlManager::isEnabled() const
     return false;
 }
 
+void DcpFlowControlManager::adjustBuffers() {
+}
+
 void DcpFlowControlManager::setBufSizeWithinBounds(DcpConsumer *consumerConn,
                                                    size_t &bufSize)
 {
@@ -224,3 +229,106 @@ void DcpFlowControlManagerAggressive::resizeBuffers_UNLOCKED(size_t bufferSize)
         iter.second->setFlowControlBufSize(bufferSize);
     }
 }
+
+DcpFlowControlManagerAdaptive::DcpFlowControlManagerAdaptive(
+        EventuallyPersistentEngine& engine)
+    : DcpFlowControlManager(engine),
+      lastAdjust(std::chrono::steady_clock::now()) {
+}
+
+DcpFlowControlManagerAdaptive::~DcpFlowControlManagerAdaptive() {
+}
+
+size_t DcpFlowControlManagerAdaptive::newConsumerConn(
+        DcpConsumer* consumerConn) {
+    std::lock_guard<std::mutex> lh(dcpConsumersMapMutex);
+
+    if (consumerConn == nullptr) {
+        throw std::invalid_argument(
+                "DcpFlowControlManagerAdaptive::newConsumerConn: resp is NULL");
+    }
+
+    /* Until its drain rate is known, start with a fair share of the budget */
+    size_t bufferSize = getAggregateBudget() / (dcpConsumersMap.size() + 1);
+    setBufSizeWithinBounds(consumerConn, bufferSize);
+    EP_LOG_DEBUG("{} Conn flow control buffer is {}",
+                 consumerConn->logHeader(),
+                 bufferSize);
+
+    dcpConsumersMap[consumerConn->getCookie()] = {consumerConn, 0, 0};
+    return bufferSize;
+}
+
+void DcpFlowControlManagerAdaptive::handleDisconnect(
+        DcpConsumer* consumerConn) {
+    std::lock_guard<std::mutex> lh(dcpConsumersMapMutex);
+    dcpConsumersMap.erase(consumerConn->getCookie());
+}
+
+bool DcpFlowControlManagerAdaptive::isEnabled() const {
+    return true;
+}
+
+void DcpFlowControlManagerAdaptive::adjustBuffers() {
+    adjustBuffers(std::chrono::steady_clock::now());
+}
+
+void DcpFlowControlManagerAdaptive::adjustBuffers(
+        std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lh(dcpConsumersMapMutex);
+    const double elapsed =
+            std::chrono::duration<double>(now - lastAdjust).count();
+    if (elapsed <= 0) {
+        return;
+    }
+    lastAdjust = now;
+
+    double totalWanted = 0;
+    for (auto& entry : dcpConsumersMap) {
+        auto& state = entry.second;
+        const uint64_t drained = state.consumer->getFlowControlDrainedBytes();
+        /* The count is read from two counters, so may briefly go backwards */
+        const uint64_t delta =
+                drained > state.drainedBytes ? drained - state.drainedBytes : 0;
+        state.drainedBytes = std::max(state.drainedBytes, drained);
+        state.drainRate = (state.drainRate + delta / elapsed) / 2;
+        totalWanted += 2 * state.drainRate;
+    }
+
+    const double budget = getAggregateBudget();
+    const double scale = totalWanted > budget ? budget / totalWanted : 1.0;
+    for (auto& entry : dcpConsumersMap) {
+        auto& state = entry.second;
+        size_t bufferSize = 2 * state.drainRate * scale;
+        setBufSizeWithinBounds(state.consumer, bufferSize);
+
+        /* Each change is sent to the producer as a control message, so
+           ignore small ones */
+        const size_t current = state.consumer->getFlowControlBufSize();
+        if (bufferSize > current + current / 8 ||
+            bufferSize + current / 8 < current) {
+            EP_LOG_DEBUG("{} Conn flow control buffer is {} (drain rate {}/s)",
+                         state.consumer->logHeader(),
+                         bufferSize,
+                         size_t(state.drainRate));
+            state.consumer->setFlowControlBufSize(bufferSize);
+        }
+    }
+}
+
+size_t DcpFlowControlManagerAdaptive::getAggregateBudget() const {
+    auto& stats = engine_.getEpStats();
+    const double aggrFrac =
+            static_cast<double>(engine_.getConfiguration()
+                                        .getDcpConnBufferSizeAggressivePerc()) /
+            100;
+    const size_t budget = aggrFrac * stats.getMaxDataSize();
+
+    /* The buffers are filled by the producers without regard for the
+       replica's memory, so keep them to half of what is left before the
+       high watermark */
+    const size_t memUsed = stats.getEstimatedTotalMemoryUsed();
+    const size_t highWat = stats.mem_high_wat.load();
+    const size_t headroom = memUsed < highWat ? highWat - memUsed : 0;
+    return std::min(budget, headroom / 2);
+}
@@ -17,6 +17,8 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <map>
 #include <mutex>
 
 #include "memcached/types.h"
@@ -48,6 +50,10 @@ public:
     /* Will indicate if flow control is enabled */
     virtual bool isEnabled(void) const;
 
+    /* Called periodically (by the connection manager task) to let the policy
+       resize the flow control buffers of existing connections */
+    virtual void adjustBuffers();
+
 protected:
     void setBufSizeWithinBounds(DcpConsumer *consumerConn, size_t &bufSize);
 
@@ -127,3 +133,51 @@ private:
     /* Fraction of memQuota for all dcp consumer connection buffers */
     std::atomic<double> dcpConnBufferSizeAggrFrac;
 };
+
+/**
+ * In this policy each flow control buffer is sized to how fast its consumer
+ * drains it, and all the buffers together are bounded by the bucket's memory
+ * headroom. Every time adjustBuffers() runs, the drain rate (bytes processed
+ * per second, smoothed) of each connection is measured and its buffer set to
+ * hold twice that - so a consumer held back by its buffer still sees it
+ * grow. If the buffers wanted add up to more than the aggregate budget they
+ * are scaled down in proportion; the budget is the aggressive percentage of
+ * the bucket memory quota, but no more than half of the memory left below
+ * the high watermark. Buffer sizes stay within max (50MB) and min (10 MB).
+ */
+class DcpFlowControlManagerAdaptive : public DcpFlowControlManager {
+public:
+    DcpFlowControlManagerAdaptive(EventuallyPersistentEngine& engine);
+
+    ~DcpFlowControlManagerAdaptive();
+
+    size_t newConsumerConn(DcpConsumer* consumerConn);
+
+    void handleDisconnect(DcpConsumer* consumerConn);
+
+    bool isEnabled(void) const;
+
+    void adjustBuffers();
+
+    /* adjustBuffers() as of the given time */
+    void adjustBuffers(std::chrono::steady_clock::time_point now);
+
+private:
+    /* The memory all the flow control buffers together may use */
+    size_t getAggregateBudget() const;
+
+    struct ConsumerState {
+        DcpConsumer* consumer;
+        /* Bytes the consumer had drained as of the last adjustBuffers() */
+        uint64_t drainedBytes;
+        /* Smoothed drain rate, in bytes per second */
+        double drainRate;
+    };
+
+    /* Mutex to ensure dcpConsumersMap and lastAdjust are thread safe */
+    std::mutex dcpConsumersMapMutex;
+    /* All DCP Consumers with flow control buffer */
+    std::map<const void*, ConsumerState> dcpConsumersMap;
+    /* When adjustBuffers() last ran */
+    std::chrono::steady_clock::time_point lastAdjust;
+};
@@ -106,6 +106,10 @@ uint32_t FlowControl::getFlowControlBufSize(void)
     return bufferSize;
 }
 
+uint64_t FlowControl::getDrainedBytes() const {
+    return ackedBytes.load() + freedBytes.load();
+}
+
 void FlowControl::setFlowControlBufSize(uint32_t newSize)
 {
     std::lock_guard<std::mutex> lh(bufferSizeLock);
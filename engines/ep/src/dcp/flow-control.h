@@ -45,6 +45,9 @@ public:
 
     uint32_t getFlowControlBufSize(void);
 
+    /* Total bytes processed from the flow control buffer (acked or not) */
+    uint64_t getDrainedBytes() const;
+
     void setFlowControlBufSize(uint32_t newSize);
 
     bool isBufferSufficientlyDrained();
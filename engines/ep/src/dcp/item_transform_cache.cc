@@ -0,0 +1,80 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "dcp/item_transform_cache.h"
+
+#include <algorithm>
+
+DcpItemTransformCache::DcpItemTransformCache(size_t size)
+    : shards(size == 0 ? 0 : numShards) {
+    const size_t perShard = std::max(size / numShards, size_t(1));
+    for (auto& shard : shards) {
+        shard.entries.resize(perShard);
+    }
+}
+
+uint8_t DcpItemTransformCache::makeTransform(IncludeValue includeValue,
+                                             IncludeXattrs includeXattrs,
+                                             bool forceValueCompression,
+                                             bool snappyEnabled) {
+    // What happens to the compression of the value: 0 - left as is,
+    // 1 - compressed, 2 - decompressed.
+    const uint8_t compression =
+            snappyEnabled ? (forceValueCompression ? 1 : 0) : 2;
+    return uint8_t(includeValue) |
+           uint8_t(includeXattrs == IncludeXattrs::Yes) << 2 |
+           compression << 3;
+}
+
+queued_item DcpItemTransformCache::find(const Item& item, uint8_t transform) {
+    if (!isEnabled() || item.getBySeqno() <= 0) {
+        return {};
+    }
+    auto& shard = getShard(item.getVBucketId());
+    std::lock_guard<std::mutex> lh(shard.mutex);
+    for (const auto& entry : shard.entries) {
+        if (entry.seqno == item.getBySeqno() && entry.cas == item.getCas() &&
+            entry.vbid == item.getVBucketId() &&
+            entry.transform == transform && entry.item) {
+            ++hits;
+            return entry.item;
+        }
+    }
+    ++misses;
+    return {};
+}
+
+void DcpItemTransformCache::insert(const Item& item,
+                                   uint8_t transform,
+                                   const queued_item& transformed) {
+    if (!isEnabled() || item.getBySeqno() <= 0) {
+        return;
+    }
+    auto& shard = getShard(item.getVBucketId());
+    std::lock_guard<std::mutex> lh(shard.mutex);
+    auto& entry = shard.entries[shard.next];
+    shard.next = (shard.next + 1) % shard.entries.size();
+    entry.vbid = item.getVBucketId();
+    entry.seqno = item.getBySeqno();
+    entry.cas = item.getCas();
+    entry.transform = transform;
+    entry.item = transformed;
+}
+
+DcpItemTransformCache::Shard& DcpItemTransformCache::getShard(Vbid vbid) {
+    return shards[vbid.get() % shards.size()];
+}
@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include "dcp/dcp-types.h"
+#include "item.h"
+
+#include <memcached/vbucket.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Cache of the "as sent" versions of recently streamed items.
+ *
+ * Depending on what the DCP client negotiated (value / xattrs included,
+ * snappy enabled, forced compression) an ActiveStream may need to send a
+ * modified copy of a checkpoint or backfill item - with the xattrs pruned,
+ * or the value decompressed or compressed. When many clients stream the same
+ * vBucket each of them would otherwise repeat that work for every item; with
+ * the cache the first stream to need a given transform of an item makes the
+ * copy and the others send that same (immutable, ref-counted) copy.
+ *
+ * An item is identified by its vBucket, seqno and CAS, so a seqno reused
+ * after a rollback isn't confused with the original; items without a seqno
+ * yet aren't cached. Entries are kept in a
+ * small ring per shard of vBuckets and overwritten as new items are added,
+ * which suffices as streams fanning out from a vBucket generally send its
+ * items at about the same time.
+ *
+ * This class is thread safe.
+ */
+class DcpItemTransformCache {
+public:
+    /**
+     * @param size total number of entries; 0 disables the cache
+     */
+    explicit DcpItemTransformCache(size_t size);
+
+    /**
+     * @returns the key of the transform a stream with the given settings
+     *          applies to items
+     */
+    static uint8_t makeTransform(IncludeValue includeValue,
+                                 IncludeXattrs includeXattrs,
+                                 bool forceValueCompression,
+                                 bool snappyEnabled);
+
+    /**
+     * Look up the transformed copy of an item.
+     *
+     * @return the copy, or an empty queued_item if not cached
+     */
+    queued_item find(const Item& item, uint8_t transform);
+
+    /// Add the transformed copy of an item.
+    void insert(const Item& item,
+                uint8_t transform,
+                const queued_item& transformed);
+
+    bool isEnabled() const {
+        return !shards.empty();
+    }
+
+    size_t getHits() const {
+        return hits;
+    }
+
+    size_t getMisses() const {
+        return misses;
+    }
+
+private:
+    struct Entry {
+        Vbid vbid{0};
+        int64_t seqno = 0;
+        uint64_t cas = 0;
+        uint8_t transform = 0;
+        queued_item item;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> entries;
+        size_t next = 0;
+    };
+
+    Shard& getShard(Vbid vbid);
+
+    static const size_t numShards = 16;
+
+    std::vector<Shard> shards;
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+};
@@ -59,7 +59,9 @@ PassiveStream::PassiveStream(EventuallyPersistentEngine* e,
       cur_snapshot_start(0),
       cur_snapshot_end(0),
       cur_snapshot_type(Snapshot::None),
-      cur_snapshot_ack(false) {
+      cur_snapshot_ack(false),
+      seqnoAckBatchSize(e->getConfiguration().getDcpSeqnoAckBatchSize()),
+      seqnoAckMaxDelay(e->getConfiguration().getDcpSeqnoAckMaxDelayUs()) {
     LockHolder lh(streamMutex);
     streamRequest_UNLOCKED(vb_uuid);
     itemsReady.store(true);
@@ -309,6 +311,7 @@ ENGINE_ERROR_CODE PassiveStream::messageReceived(
             }
 
             if (ret != ENGINE_TMPFAIL && ret != ENGINE_ENOMEM) {
+                engine->getReplicationThrottle().consume(1);
                 return ret;
             }
         }
@@ -437,6 +440,7 @@ process_items_error_t PassiveStream::processBufferedMessages(
     }
 
     processed_bytes = total_bytes_processed;
+    engine->getReplicationThrottle().consume(count);
 
     if (failed) {
         if (noMem && engine->getReplicationThrottle().doDisconnectOnNoMem()) {
@@ -609,18 +613,42 @@ ENGINE_ERROR_CODE PassiveStream::processExpiration(
 ENGINE_ERROR_CODE PassiveStream::processPrepare(
         MutationConsumerMessage* prepare) {
     auto result = processMessage(prepare, MessageType::Prepare);
+    queueSeqnoAck(prepare->getItem()->getBySeqno());
+    return result;
+}
 
-    // @todo-durability: Don't send the ACK directly; should be done once we
-    // get to the end of a snapshot.
+void PassiveStream::queueSeqnoAck(uint64_t seqno) {
+    const auto now = std::chrono::steady_clock::now();
+    bool pushed = false;
     {
         LockHolder lh(streamMutex);
-        // @todo-durability add in the correct on-disk seqno.
-        pushToReadyQ(std::make_unique<SeqnoAcknowledgement>(
-                opaque_, prepare->getItem()->getBySeqno(), 0));
+        if (pendingSeqnoAck.count++ == 0) {
+            pendingSeqnoAck.firstPending = now;
+        }
+        pendingSeqnoAck.seqno = seqno;
+
+        // Note: the snapshot end has already been handled for this seqno, so
+        // check for it here rather than waiting for the next snapshot.
+        if (pendingSeqnoAck.count >= seqnoAckBatchSize ||
+            now - pendingSeqnoAck.firstPending >= seqnoAckMaxDelay ||
+            seqno >= cur_snapshot_end.load()) {
+            pushed = flushSeqnoAck_UNLOCKED();
+        }
     }
-    notifyStreamReady();
+    if (pushed) {
+        notifyStreamReady();
+    }
+}
 
-    return result;
+bool PassiveStream::flushSeqnoAck_UNLOCKED() {
+    if (pendingSeqnoAck.count == 0) {
+        return false;
+    }
+    // @todo-durability add in the correct on-disk seqno.
+    pushToReadyQ(std::make_unique<SeqnoAcknowledgement>(
+            opaque_, pendingSeqnoAck.seqno, 0));
+    pendingSeqnoAck.count = 0;
+    return true;
 }
 
 ENGINE_ERROR_CODE PassiveStream::processSystemEvent(
@@ -811,19 +839,30 @@ void PassiveStream::handleSnapshotEnd(VBucketPtr& vb, uint64_t byseqno) {
             }
         }
 
-        if (cur_snapshot_ack) {
-            {
-                LockHolder lh(streamMutex);
+        bool pushed = false;
+        {
+            LockHolder lh(streamMutex);
+            // Don't hold back the acks of the snapshot's prepares any longer
+            pushed = flushSeqnoAck_UNLOCKED();
+            if (cur_snapshot_ack) {
                 pushToReadyQ(std::make_unique<SnapshotMarkerResponse>(
                         opaque_, cb::mcbp::Status::Success));
+                cur_snapshot_ack = false;
+                pushed = true;
             }
+        }
+        if (pushed) {
             notifyStreamReady();
-            cur_snapshot_ack = false;
         }
         cur_snapshot_type.store(Snapshot::None);
     }
 }
 
+size_t PassiveStream::getBufferBytes() const {
+    std::lock_guard<std::mutex> lg(buffer.bufMutex);
+    return buffer.bytes;
+}
+
 void PassiveStream::addStats(ADD_STAT add_stat, const void* c) {
     Stream::addStats(add_stat, c);
 
@@ -23,6 +23,8 @@
 
 #include <memcached/engine_error.h>
 
+#include <chrono>
+
 class BucketLogger;
 class ChangeSeparatorCollectionEvent;
 class CreateOrDeleteCollectionEvent;
@@ -81,6 +83,9 @@ public:
 
     void addStats(ADD_STAT add_stat, const void* c) override;
 
+    /// @returns the bytes of the messages buffered for later processing.
+    size_t getBufferBytes() const;
+
     static const size_t batchSize;
 
 protected:
@@ -173,6 +178,22 @@ protected:
 
     void handleSnapshotEnd(VBucketPtr& vb, uint64_t byseqno);
 
+    /**
+     * Record that the prepare at the given seqno has been processed, and
+     * send the seqno ack for it if it is due (see pendingSeqnoAck).
+     *
+     * @param seqno the seqno of the processed prepare
+     */
+    void queueSeqnoAck(uint64_t seqno);
+
+    /**
+     * Push the pending seqno ack (if any) into the readyQueue.
+     * This function assumes the caller is holding streamMutex.
+     *
+     * @return true if an ack was pushed
+     */
+    bool flushSeqnoAck_UNLOCKED();
+
     virtual void processMarker(SnapshotMarker* marker);
 
     void processSetVBucketState(SetVBucketState* state);
@@ -211,6 +232,22 @@ protected:
     std::atomic<Snapshot> cur_snapshot_type;
     bool cur_snapshot_ack;
 
+    /**
+     * The acks for processed prepares are coalesced, and only the highest
+     * seqno sent once dcp_seqno_ack_batch_size prepares are pending, the
+     * oldest of them has been pending for dcp_seqno_ack_max_delay_us, or the
+     * end of the snapshot is reached.
+     * Guarded by streamMutex.
+     */
+    struct {
+        uint64_t seqno = 0;
+        size_t count = 0;
+        std::chrono::steady_clock::time_point firstPending;
+    } pendingSeqnoAck;
+
+    const size_t seqnoAckBatchSize;
+    const std::chrono::microseconds seqnoAckMaxDelay;
+
     struct Buffer {
         Buffer() : bytes(0) {
         }
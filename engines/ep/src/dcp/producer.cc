@@ -162,8 +162,10 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
       notifyOnly((flags & cb::mcbp::request::DcpOpenPayload::Notifier) != 0),
       sendStreamEndOnClientStreamClose(false),
       supportsHifiMFU(false),
+      stepBatchSize(1),
       lastSendTime(ep_current_time()),
       log(*this),
+      ready(e.getConfiguration().getDcpProducerReadyQueueQuantum()),
       itemsSent(0),
       totalBytesSent(0),
       totalUncompressedDataSize(0),
@@ -598,6 +600,36 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         }
     }
 
+    ret = sendResponse(producers, std::move(resp));
+
+    // Hand further responses to the front-end in the same step (if the
+    // consumer asked for it). The front-end queues them all in its write
+    // buffer and sends them together, saving the per-message write and
+    // state machine transitions. Once at least one response has been accepted
+    // the step is a success; a response which no longer fits (E2BIG) has been
+    // stashed in rejectResp for the next step.
+    for (size_t sent = 1; ret == ENGINE_SUCCESS && sent < stepBatchSize;
+         ++sent) {
+        resp = getNextItem();
+        if (!resp) {
+            break;
+        }
+        const auto status = sendResponse(producers, std::move(resp));
+        if (status != ENGINE_SUCCESS) {
+            if (status != ENGINE_E2BIG) {
+                ret = status;
+            }
+            break;
+        }
+    }
+
+    lastSendTime = ep_current_time();
+    return ret;
+}
+
+ENGINE_ERROR_CODE DcpProducer::sendResponse(
+        dcp_message_producers* producers, std::unique_ptr<DcpResponse> resp) {
+    ENGINE_ERROR_CODE ret = ENGINE_SUCCESS;
     std::unique_ptr<Item> itmCpy;
     totalUncompressedDataSize.fetch_add(resp->getMessageSize());
 
@@ -785,7 +817,6 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         totalBytesSent.fetch_add(resp->getMessageSize());
     }
 
-    lastSendTime = ep_current_time();
     return ret;
 }
 
@@ -952,6 +983,12 @@ ENGINE_ERROR_CODE DcpProducer::control(uint32_t opaque,
         }
         multipleStreamRequests = MultipleStreamRequests::Yes;
         return ENGINE_SUCCESS;
+    } else if (keyStr == "step_batch_size") {
+        uint32_t size;
+        if (parseUint32(valueStr.c_str(), &size) && size > 0) {
+            stepBatchSize = size;
+            return ENGINE_SUCCESS;
+        }
     } else if (key == "enable_synchronous_replication") {
         if (valueStr == "true") {
             supportsSyncReplication = true;
@@ -1174,6 +1211,7 @@ void DcpProducer::addStats(ADD_STAT add_stat, const void *c) {
             add_stat,
             c);
     addStat("enable_expiry_opcode", enableExpiryOpcode, add_stat, c);
+    addStat("step_batch_size", stepBatchSize, add_stat, c);
     addStat("enable_stream_id",
             multipleStreamRequests == MultipleStreamRequests::Yes,
             add_stat,
@@ -1268,9 +1306,20 @@ void DcpProducer::aggregateQueueStats(ConnCounter& aggregator) {
     aggregator.conn_totalBytes += totalBytesSent;
     aggregator.conn_totalUncompressedDataSize += totalUncompressedDataSize;
     aggregator.conn_queueRemaining += getItemsRemaining();
+    aggregator.conn_bufferedBytes += getReadyQueueMemory();
+    if (backfillMgr) {
+        aggregator.conn_backfillBytes += backfillMgr->getBytesRead();
+    }
 }
 
 void DcpProducer::notifySeqnoAvailable(Vbid vbucket, uint64_t seqno) {
+    // If the vBucket is already in the ready queue its stream(s) will be
+    // stepped and pick up the new seqno from the checkpoint, so there is
+    // nothing to notify. (A NotifierStream must see each seqno.)
+    if (!notifyOnly && ready.exists(vbucket)) {
+        return;
+    }
+
     auto rv = streams.find(vbucket);
 
     if (rv.second) {
@@ -1386,7 +1435,7 @@ std::unique_ptr<DcpResponse> DcpProducer::getNextItem() {
         Vbid vbucket = Vbid(0);
         while (ready.popFront(vbucket)) {
             if (log.pauseIfFull()) {
-                ready.pushUnique(vbucket);
+                ready.requeue(vbucket, 0);
                 return NULL;
             }
 
@@ -1432,7 +1481,7 @@ std::unique_ptr<DcpResponse> DcpProducer::getNextItem() {
                                     response->to_string());
                         }
 
-                        ready.pushUnique(vbucket);
+                        ready.requeue(vbucket, response->getMessageSize());
                         return response;
                     } // else next stream for vb
                 }
@@ -1556,6 +1605,17 @@ size_t DcpProducer::getItemsRemaining() {
     return remainingSize;
 }
 
+size_t DcpProducer::getReadyQueueMemory() {
+    size_t memory = 0;
+    streams.for_each([&memory](const StreamsMap::value_type& vt) {
+        for (auto itr = vt.second->rlock(); !itr.end(); itr.next()) {
+            memory += itr.get()->getReadyQueueMemory();
+        }
+    });
+
+    return memory;
+}
+
 size_t DcpProducer::getTotalBytesSent() {
     return totalBytesSent;
 }
@@ -381,8 +381,18 @@ protected:
 
     std::unique_ptr<DcpResponse> getNextItem();
 
+    /**
+     * Pass a single response to the front-end via the dcp_message_producers
+     * interface, stashing it in rejectResp if there was no space for it.
+     */
+    ENGINE_ERROR_CODE sendResponse(dcp_message_producers* producers,
+                                   std::unique_ptr<DcpResponse> resp);
+
     size_t getItemsRemaining();
 
+    /// @returns the memory used by the readyQs of all of the streams.
+    size_t getReadyQueueMemory();
+
     /**
      * Map the end_stream_status_t to one the client can understand.
      * Maps END_STREAM_FILTER_EMPTY to END_STREAM_OK if the client does not
@@ -459,6 +469,9 @@ protected:
     Couchbase::RelaxedAtomic<bool> sendStreamEndOnClientStreamClose;
     Couchbase::RelaxedAtomic<bool> supportsHifiMFU;
     Couchbase::RelaxedAtomic<bool> enableExpiryOpcode;
+    /// Maximum number of responses passed to the front-end per step()
+    /// (set by the "step_batch_size" control).
+    Couchbase::RelaxedAtomic<size_t> stepBatchSize;
     /// Does this DCP Producer support synchronous replication via DCP_PREPARE/
     /// DCP_COMMIT ?
     Couchbase::RelaxedAtomic<bool> supportsSyncReplication = false;
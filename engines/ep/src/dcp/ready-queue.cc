@@ -20,6 +20,9 @@
 #include "locks.h"
 #include "statwriter.h"
 
+DcpReadyQueue::DcpReadyQueue(size_t quantum) : quantum(quantum) {
+}
+
 bool DcpReadyQueue::exists(Vbid vbucket) {
     LockHolder lh(lock);
     return (queuedValues.count(vbucket) != 0);
@@ -27,11 +30,31 @@ bool DcpReadyQueue::exists(Vbid vbucket) {
 
 bool DcpReadyQueue::popFront(Vbid& frontValue) {
     LockHolder lh(lock);
-    if (!readyQueue.empty()) {
+    const int64_t turnQuantum = quantum;
+    while (!readyQueue.empty()) {
         frontValue = readyQueue.front();
-        readyQueue.pop();
-        queuedValues.erase(frontValue);
-        return true;
+        readyQueue.pop_front();
+        if (turnQuantum == 0 || (turnContinues && frontValue == turnVbucket)) {
+            turnContinues = false;
+            queuedValues.erase(frontValue);
+            return true;
+        }
+
+        // A new turn; pay back any overrun from the last one first.
+        turnContinues = false;
+        turnVbucket = frontValue;
+        turnCredit = turnQuantum;
+        auto itr = overrun.find(frontValue);
+        if (itr != overrun.end()) {
+            turnCredit -= itr->second;
+            overrun.erase(itr);
+        }
+        if (turnCredit > 0) {
+            queuedValues.erase(frontValue);
+            return true;
+        }
+        overrun[frontValue] = size_t(-turnCredit);
+        readyQueue.push_back(frontValue);
     }
     return false;
 }
@@ -40,7 +63,8 @@ void DcpReadyQueue::pop() {
     LockHolder lh(lock);
     if (!readyQueue.empty()) {
         queuedValues.erase(readyQueue.front());
-        readyQueue.pop();
+        overrun.erase(readyQueue.front());
+        readyQueue.pop_front();
     }
 }
 
@@ -51,12 +75,39 @@ bool DcpReadyQueue::pushUnique(Vbid vbucket) {
         wasEmpty = queuedValues.empty();
         const bool inserted = queuedValues.emplace(vbucket).second;
         if (inserted) {
-            readyQueue.push(vbucket);
+            readyQueue.push_back(vbucket);
         }
     }
     return wasEmpty;
 }
 
+void DcpReadyQueue::requeue(Vbid vbucket, size_t bytes) {
+    LockHolder lh(lock);
+    if (!queuedValues.emplace(vbucket).second) {
+        // Already re-queued by a notification; that position stands.
+        return;
+    }
+    if (quantum == 0 || vbucket != turnVbucket) {
+        readyQueue.push_back(vbucket);
+        return;
+    }
+
+    turnCredit -= int64_t(bytes);
+    if (turnCredit > 0) {
+        turnContinues = true;
+        readyQueue.push_front(vbucket);
+    } else {
+        if (turnCredit < 0) {
+            overrun[vbucket] = size_t(-turnCredit);
+        }
+        readyQueue.push_back(vbucket);
+    }
+}
+
+void DcpReadyQueue::setQuantum(size_t bytes) {
+    quantum = bytes;
+}
+
 size_t DcpReadyQueue::size() {
     LockHolder lh(lock);
     return readyQueue.size();
@@ -71,7 +122,7 @@ void DcpReadyQueue::addStats(const std::string& prefix,
                              ADD_STAT add_stat,
                              const void* c) {
     // Take a copy of the queue data under lock; then format it to stats.
-    std::queue<Vbid> qCopy;
+    std::deque<Vbid> qCopy;
     std::unordered_set<Vbid> qMapCopy;
     {
         LockHolder lh(lock);
@@ -80,6 +131,7 @@ void DcpReadyQueue::addStats(const std::string& prefix,
     }
 
     add_casted_stat((prefix + "size").c_str(), qCopy.size(), add_stat, c);
+    add_casted_stat((prefix + "quantum").c_str(), quantum.load(), add_stat, c);
     add_casted_stat(
             (prefix + "map_size").c_str(), qMapCopy.size(), add_stat, c);
 
@@ -87,7 +139,7 @@ void DcpReadyQueue::addStats(const std::string& prefix,
     std::string contents;
     while (!qCopy.empty()) {
         contents += std::to_string(qCopy.front().get()) + ",";
-        qCopy.pop();
+        qCopy.pop_front();
     }
     if (!contents.empty()) {
         contents.pop_back();
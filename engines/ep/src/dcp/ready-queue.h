@@ -20,8 +20,10 @@
 #include <memcached/engine_common.h>
 #include <memcached/vbucket.h>
 
+#include <atomic>
+#include <deque>
 #include <mutex>
-#include <queue>
+#include <unordered_map>
 #include <unordered_set>
 
 /**
@@ -31,13 +33,26 @@
  * this. The interface is generally customised for the needs of:
  * - getNextItem and is thread safe as the frontend operations and
  *   DCPProducer threads are accessing this data.
- * - processBufferedItems by the processer task of the consumer
+ * - processBufferedItems by the processer task(s) of the consumer
  *
- * Internally a std::queue and std::set track the contents and the std::set
+ * Internally a std::deque and std::set track the contents and the std::set
  * enables a fast exists method which is used by front-end threads.
+ *
+ * By default every vbucket gets one response per turn. With a quantum set
+ * the queue does deficit round-robin by bytes instead: a vbucket keeps its
+ * turn (via requeue()) until it has sent a quantum of bytes, and a vbucket
+ * which overran its quantum (e.g. with a large backfilled item) skips turns
+ * until the overrun has been paid back. Each vbucket then gets a fair share
+ * of the connection's bandwidth, rather than a fair share of its messages.
  */
 class DcpReadyQueue {
 public:
+    /**
+     * @param quantum number of bytes a vbucket may send per turn, 0 for one
+     *        response per turn
+     */
+    explicit DcpReadyQueue(size_t quantum = 0);
+
     bool exists(Vbid vbucket);
 
     /**
@@ -59,6 +74,16 @@ public:
      */
     bool pushUnique(Vbid vbucket);
 
+    /**
+     * Return the vbucket last returned by popFront() to the queue, after it
+     * produced a response of the given size. With a quantum set the vbucket
+     * goes back to the front if it has credit left for this turn; otherwise
+     * (and without a quantum) it goes to the back, as pushUnique().
+     */
+    void requeue(Vbid vbucket, size_t bytes);
+
+    void setQuantum(size_t bytes);
+
     /**
      * Size of the queue.
      */
@@ -72,7 +97,7 @@ private:
     std::mutex lock;
 
     /* a queue of vbuckets that are ready for producing */
-    std::queue<Vbid> readyQueue;
+    std::deque<Vbid> readyQueue;
 
     /**
      * maintain a std::unordered_set of values that are in the readyQueue.
@@ -80,4 +105,16 @@ private:
      * efficient so just a set lookup is required.
      */
     std::unordered_set<Vbid> queuedValues;
+
+    std::atomic<size_t> quantum;
+
+    /// The vbucket whose turn it is, and the bytes it may still send.
+    Vbid turnVbucket;
+    int64_t turnCredit = 0;
+    /// Set when requeue() put turnVbucket back at the front to continue
+    /// its turn.
+    bool turnContinues = false;
+
+    /// Bytes each queued vbucket overran its last turn by.
+    std::unordered_map<Vbid, size_t> overrun;
 };
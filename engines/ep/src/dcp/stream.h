@@ -138,6 +138,9 @@ public:
         return id == this->id;
     }
 
+    /// @returns the memory used by the messages in the readyQ.
+    uint64_t getReadyQueueMemory(void);
+
 protected:
     // The StreamState is protected as it needs to be accessed by sub-classes
     enum class StreamState {
@@ -162,8 +165,6 @@ protected:
     /* To be called after getting streamMutex lock */
     std::unique_ptr<DcpResponse> popFromReadyQ(void);
 
-    uint64_t getReadyQueueMemory(void);
-
     std::string name_;
     uint32_t flags_;
     uint32_t opaque_;
@@ -25,6 +25,7 @@
 #include "stored-value.h"
 #include <memcached/server_allocator_iface.h>
 #include <phosphor/phosphor.h>
+#include <algorithm>
 #include <cinttypes>
 
 DefragmenterTask::DefragmenterTask(EventuallyPersistentEngine* e,
@@ -44,7 +45,11 @@ bool DefragmenterTask::run(void) {
         if (!prAdapter) {
             prAdapter = std::make_unique<PauseResumeVBAdapter>(
                     std::make_unique<DefragmentVisitor>(
-                            getAgeThreshold(), getMaxValueSize(alloc_hooks)));
+                            getAgeThreshold(),
+                            getMaxValueSize(alloc_hooks),
+                            alloc_hooks,
+                            getMaxExtentUtilization(),
+                            isStoredValueDefragEnabled()));
             epstore_position = engine->getKVBucket()->startPosition();
         }
 
@@ -69,7 +74,7 @@ bool DefragmenterTask::run(void) {
         // Prepare the underlying visitor.
         auto& visitor = getDefragVisitor();
         const auto start = std::chrono::steady_clock::now();
-        const auto deadline = start + getChunkDuration();
+        const auto deadline = getWorkBudgetDeadline(getChunkDuration());
         visitor.setDeadline(deadline);
         visitor.clearStats();
 
@@ -84,6 +89,9 @@ bool DefragmenterTask::run(void) {
         // Update stats
         stats.defragNumMoved.fetch_add(visitor.getDefragCount());
         stats.defragNumVisited.fetch_add(visitor.getVisitedCount());
+        stats.defragNumSkippedDense.fetch_add(visitor.getSkippedDenseCount());
+        stats.defragStoredValueNumMoved.fetch_add(
+                visitor.getStoredValueDefragCount());
 
         // Release any free memory we now have in the allocator back to the OS.
         // TODO: Benchmark this - is it necessary? How much of a slowdown does it
@@ -107,7 +115,9 @@ bool DefragmenterTask::run(void) {
                                                                       start);
         ss << " Took " << duration.count() << " us."
            << " moved " << visitor.getDefragCount() << "/"
-           << visitor.getVisitedCount() << " visited documents."
+           << visitor.getVisitedCount() << " visited documents ("
+           << visitor.getSkippedDenseCount() << " in dense runs skipped), "
+           << visitor.getStoredValueDefragCount() << " StoredValues moved."
            << " mem_used=" << stats.getEstimatedTotalMemoryUsed()
            << ", mapped_bytes=" << getMappedBytes() << ". Sleeping for "
            << getSleepTime() << " seconds.";
@@ -146,7 +156,50 @@ std::chrono::microseconds DefragmenterTask::maxExpectedDuration() {
 }
 
 double DefragmenterTask::getSleepTime() const {
-    return engine->getConfiguration().getDefragmenterInterval();
+    auto& config = engine->getConfiguration();
+    const double maxSleep = config.getDefragmenterInterval();
+    if (!config.isDefragmenterAutoInterval()) {
+        return maxSleep;
+    }
+
+    // Scale linearly from the max sleep at (or below) the lower threshold to
+    // the min sleep at (or above) the upper threshold.
+    const double minSleep =
+            std::min(double(config.getDefragmenterAutoMinInterval()), maxSleep);
+    const double lower = config.getDefragmenterAutoLowerThreshold();
+    const double upper = config.getDefragmenterAutoUpperThreshold();
+    const double fragmentation = getFragmentationRatio();
+    if (fragmentation >= upper) {
+        return minSleep;
+    }
+    if (fragmentation <= lower) {
+        return maxSleep;
+    }
+    const double scale = (fragmentation - lower) / (upper - lower);
+    return maxSleep - (maxSleep - minSleep) * scale;
+}
+
+double DefragmenterTask::getFragmentationRatio() const {
+    ServerAllocatorIface* alloc_hooks = engine->getServerApi()->alloc_hooks;
+
+    allocator_stats stats = {0};
+    stats.ext_stats.resize(alloc_hooks->get_extra_stats_size());
+    alloc_hooks->get_allocator_stats(&stats);
+
+    if (stats.resident_size == 0 ||
+        stats.resident_size <= stats.allocated_size) {
+        return 0.0;
+    }
+    return double(stats.resident_size - stats.allocated_size) /
+           stats.resident_size;
+}
+
+double DefragmenterTask::getMaxExtentUtilization() const {
+    return engine->getConfiguration().getDefragmenterMaxExtentUtilization();
+}
+
+bool DefragmenterTask::isStoredValueDefragEnabled() const {
+    return engine->getConfiguration().isDefragmenterStoredValueEnabled();
 }
 
 size_t DefragmenterTask::getAgeThreshold() const {
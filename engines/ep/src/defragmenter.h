@@ -86,6 +86,16 @@ class PauseResumeVBAdapter;
  * 2. Document size - Skip documents which are larger than the largest
  *    size class, or are zero-sized.
  *
+ * Where the allocator can report the utilization of the run (jemalloc
+ * extent) holding an object, we don't need to guess: only objects in runs
+ * less than defragmenter_max_extent_utilization full are moved, and document
+ * age isn't used. Moving an object out of a dense run frees no memory.
+ *
+ * Similarly, rather than running at a fixed interval, by default the sleep
+ * between runs adapts to how fragmented memory is (how much of the resident
+ * memory isn't allocated): from defragmenter_interval when there is little
+ * fragmentation, down to defragmenter_auto_min_interval when there is a lot.
+ *
  * An additional policy consideration is how to locate
  * candidate documents. In a large instance, the simple act of
  * visiting each element in the HashTable is a expensive operation -
@@ -117,6 +127,18 @@ private:
     /// Duration (in seconds) defragmenter should sleep for between iterations.
     double getSleepTime() const;
 
+    /**
+     * Returns the fraction of the allocator's resident memory which is not
+     * allocated (0.0 if the allocator doesn't report it).
+     */
+    double getFragmentationRatio() const;
+
+    /// Values in runs at least this fraction full are not moved.
+    double getMaxExtentUtilization() const;
+
+    // Should StoredValues (metadata) be defragmented as well as values?
+    bool isStoredValueDefragEnabled() const;
+
     // Minimum age (measured in defragmenter task passes) that a document
     // must be to be considered for defragmentation.
     size_t getAgeThreshold() const;
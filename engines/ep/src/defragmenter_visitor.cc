@@ -17,14 +17,24 @@
 
 #include "defragmenter_visitor.h"
 
+#include <memcached/server_allocator_iface.h>
+
 // DegragmentVisitor implementation ///////////////////////////////////////////
 
 DefragmentVisitor::DefragmentVisitor(uint8_t age_threshold_,
-                                     size_t max_size_class)
+                                     size_t max_size_class,
+                                     ServerAllocatorIface* alloc_hooks_,
+                                     double max_utilization_,
+                                     bool defrag_stored_values_)
     : max_size_class(max_size_class),
       age_threshold(age_threshold_),
+      alloc_hooks(alloc_hooks_),
+      max_utilization(max_utilization_),
+      defrag_stored_values(defrag_stored_values_),
       defrag_count(0),
       visited_count(0),
+      skipped_dense_count(0),
+      sv_defrag_count(0),
       currentVb(nullptr) {
 }
 
@@ -39,35 +49,91 @@ void DefragmentVisitor::setDeadline(
 bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
                               StoredValue& v) {
     const size_t value_len = v.valuelen();
+    bool valueMoved = false;
 
     // value must be at least non-zero (also covers Items with null Blobs)
     // and no larger than the biggest size class the allocator
     // supports, so it can be successfully reallocated to a run with other
-    // objects of the same size.
-    if (value_len > 0 && value_len <= max_size_class) {
-        // If sufficiently old and if it looks like nothing else holds a
-        // reference to the blob reallocate, otherwise increment it's age.
-        // It may be possible to add a reference to the blob without holding
-        // any locks, therefore the check is somewhat of an estimate which
-        // should be good enough.
-        if (v.getValue()->getAge() >= age_threshold &&
-            v.getValue().refCount() < 2) {
+    // objects of the same size. Inline values have no Blob to reallocate,
+    // and values in the value tier aren't allocated from the heap.
+    if (value_len > 0 && value_len <= max_size_class && !v.hasInlineValue() &&
+        !v.getValue()->isTiered()) {
+        // If the allocator can tell us how full the blob's run is, only
+        // move it out of a sparse run - moving it out of a dense one frees
+        // nothing. Otherwise, if sufficiently old, reallocate; or increment
+        // it's age.
+        // Either way only reallocate if it looks like nothing else holds a
+        // reference to the blob. It may be possible to add a reference to
+        // the blob without holding any locks, therefore the check is
+        // somewhat of an estimate which should be good enough.
+        const double utilization = getUtilization(v.getValue().get());
+        if (utilization >= 0) {
+            if (utilization >= max_utilization) {
+                skipped_dense_count++;
+            } else if (v.getValue().refCount() < 2) {
+                v.reallocate();
+                defrag_count++;
+                valueMoved = true;
+            }
+        } else if (v.getValue()->getAge() >= age_threshold &&
+                   v.getValue().refCount() < 2) {
             v.reallocate();
             defrag_count++;
+            valueMoved = true;
         } else {
             v.getValue()->incrementAge();
         }
     }
     visited_count++;
 
+    if (defrag_stored_values) {
+        maybeDefragStoredValue(lh, v, valueMoved);
+    }
+
     // See if we have done enough work for this chunk. If so
     // stop visiting (for now).
     return progressTracker.shouldContinueVisiting(visited_count);
 }
 
+double DefragmentVisitor::getUtilization(const void* ptr) const {
+    size_t nfree = 0;
+    size_t nregs = 0;
+    if (alloc_hooks &&
+        alloc_hooks->get_allocation_utilization(ptr, &nfree, &nregs) &&
+        nregs != 0) {
+        return double(nregs - nfree) / nregs;
+    }
+    return -1.0;
+}
+
+void DefragmentVisitor::maybeDefragStoredValue(
+        const HashTable::HashBucketLock& lh,
+        StoredValue& v,
+        bool valueMoved) {
+    // Temp items aren't in an ephemeral vBucket's seqList (so can't be
+    // relinked) and are short lived anyway. StoredValues from the arena are
+    // already packed, and a copy drops an inline value region so copying
+    // one with an inline value would just move the value to a Blob.
+    if (!currentVb || v.isTempItem() || v.isArenaAllocated() ||
+        v.hasInlineValue()) {
+        return;
+    }
+
+    // As for Blobs, only move StoredValues out of sparse runs if the
+    // allocator can tell us; otherwise move them along with their value.
+    const double utilization = getUtilization(&v);
+    const bool sparse = utilization >= 0 ? utilization < max_utilization
+                                         : valueMoved;
+    if (sparse && currentVb->reallocateStoredValue(lh, v)) {
+        sv_defrag_count++;
+    }
+}
+
 void DefragmentVisitor::clearStats() {
     defrag_count = 0;
     visited_count = 0;
+    skipped_dense_count = 0;
+    sv_defrag_count = 0;
 }
 
 size_t DefragmentVisitor::getDefragCount() const {
@@ -78,6 +144,14 @@ size_t DefragmentVisitor::getVisitedCount() const {
     return visited_count;
 }
 
+size_t DefragmentVisitor::getSkippedDenseCount() const {
+    return skipped_dense_count;
+}
+
+size_t DefragmentVisitor::getStoredValueDefragCount() const {
+    return sv_defrag_count;
+}
+
 void DefragmentVisitor::setCurrentVBucket(VBucket& vb) {
     currentVb = &vb;
 }
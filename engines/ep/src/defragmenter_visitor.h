@@ -25,13 +25,34 @@
 #include "vb_visitors.h"
 #include "vbucket.h"
 
+struct ServerAllocatorIface;
+
 /**
  * Defragmentation visitor - visit all objects in a VBucket, compress the
- * documents and defragment any which have reached the specified age.
+ * documents and defragment any which live in a sparsely used allocator run
+ * (or, if the allocator can't report that, which have reached the specified
+ * age). Optionally the StoredValues (metadata) are defragmented by the same
+ * policy.
  */
 class DefragmentVisitor : public VBucketAwareHTVisitor {
 public:
-    DefragmentVisitor(uint8_t age_threshold_, size_t max_size_class);
+    /**
+     * @param age_threshold_ age a value must reach to be moved, if
+     *        alloc_hooks_ can't report the utilization of its run
+     * @param max_size_class largest value size to consider
+     * @param alloc_hooks_ allocator to query the utilization of values' runs
+     *        (if null, values are moved by age)
+     * @param max_utilization_ values are only moved if their run is less
+     *        than this fraction full
+     * @param defrag_stored_values_ if true StoredValues are also moved; if
+     *        the allocator can't report their run's utilization, whenever
+     *        their value is moved
+     */
+    DefragmentVisitor(uint8_t age_threshold_,
+                      size_t max_size_class,
+                      ServerAllocatorIface* alloc_hooks_ = nullptr,
+                      double max_utilization_ = 1.0,
+                      bool defrag_stored_values_ = false);
 
     ~DefragmentVisitor();
 
@@ -51,9 +72,29 @@ public:
     // Returns the number of documents that have been visited.
     size_t getVisitedCount() const;
 
+    // Returns the number of documents not moved as their run was dense.
+    size_t getSkippedDenseCount() const;
+
+    // Returns the number of StoredValues that have been defragmented.
+    size_t getStoredValueDefragCount() const;
+
     void setCurrentVBucket(VBucket& vb) override;
 
 private:
+    /**
+     * Returns the utilization (fraction of regions in use) of the allocator
+     * run holding ptr, or a negative value if it can't be determined.
+     */
+    double getUtilization(const void* ptr) const;
+
+    /**
+     * Reallocate the StoredValue if it can be (and is worth) moving. Must be
+     * the last use of v, as v is deleted if it is moved.
+     */
+    void maybeDefragStoredValue(const HashTable::HashBucketLock& lh,
+                                StoredValue& v,
+                                bool valueMoved);
+
     /* Configuration parameters */
 
     // Size of the largest size class from the allocator.
@@ -62,6 +103,15 @@ private:
     // How old a blob must be to consider it for defragmentation.
     const uint8_t age_threshold;
 
+    // Allocator to query for the utilization of a blob's run (may be null).
+    ServerAllocatorIface* const alloc_hooks;
+
+    // Blobs in runs at least this fraction full are not moved.
+    const double max_utilization;
+
+    // Should StoredValues be moved, as well as Blobs?
+    const bool defrag_stored_values;
+
     /* Runtime state */
 
     // Estimates how far we have got, and when we should pause.
@@ -72,6 +122,10 @@ private:
     size_t defrag_count;
     // How many documents have been visited.
     size_t visited_count;
+    // How many documents were not moved because their run was dense.
+    size_t skipped_dense_count;
+    // Count of how many StoredValues have been defrag'd.
+    size_t sv_defrag_count;
 
     // The current vbucket that is being processed
     VBucket* currentVb;
@@ -0,0 +1,194 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "document_cache.h"
+
+#include "item.h"
+#include "kvstore.h"
+#include "objectregistry.h"
+
+#include <memcached/protocol_binary.h>
+#include <platform/compress.h>
+
+#include <stdexcept>
+
+DocumentCache::Entry::Entry(const Item& item)
+    : vbid(item.getVBucketId()),
+      key(item.getKey()),
+      flags(item.getFlags()),
+      exptime(item.getExptime()),
+      cas(item.getCas()),
+      bySeqno(item.getBySeqno()),
+      revSeqno(item.getRevSeqno()),
+      datatype(item.getDataType()),
+      deleted(item.isDeleted()),
+      deleteSource(item.isDeleted()
+                           ? static_cast<uint8_t>(item.deletionSource())
+                           : 0),
+      valueSize(item.getNBytes()) {
+    const cb::const_char_buffer data{item.getData(), item.getNBytes()};
+    if (!mcbp::datatype::is_snappy(datatype) && data.size() > 0) {
+        cb::compression::Buffer deflated;
+        if (cb::compression::deflate(
+                    cb::compression::Algorithm::Snappy, data, deflated) &&
+            deflated.size() < data.size()) {
+            value.assign(deflated.data(), deflated.size());
+            compressed = true;
+            return;
+        }
+    }
+    value.assign(data.data(), data.size());
+}
+
+size_t DocumentCache::Entry::getSize() const {
+    // The entry, its list and index nodes, and the key and value buffers.
+    return sizeof(Entry) + 2 * sizeof(void*) +
+           sizeof(std::pair<StoredDocKey, EntryList::iterator>) +
+           3 * sizeof(void*) + 2 * key.size() + value.capacity();
+}
+
+DocumentCache::DocumentCache(size_t maxSize, size_t maxVBuckets)
+    : maxSize(maxSize), memoryUsed(0) {
+    if (maxSize == 0) {
+        throw std::invalid_argument("DocumentCache: maxSize must be non-zero");
+    }
+    // The cache's memory is not accounted to the bucket, so everything
+    // allocated (or freed) by the cache is done outside of the bucket's
+    // accounting.
+    NonBucketAllocationGuard guard;
+    index.resize(maxVBuckets);
+    generations.assign(maxVBuckets, 0);
+}
+
+DocumentCache::~DocumentCache() {
+    NonBucketAllocationGuard guard;
+    lru.clear();
+    decltype(index)().swap(index);
+    decltype(generations)().swap(generations);
+}
+
+uint64_t DocumentCache::getGeneration(Vbid vbid) const {
+    std::lock_guard<std::mutex> lg(mutex);
+    return generations.at(vbid.get());
+}
+
+std::unique_ptr<Item> DocumentCache::get(Vbid vbid,
+                                         const DocKey& key,
+                                         GetMetaOnly metaOnly) {
+    cb::compression::Buffer inflated;
+    std::unique_lock<std::mutex> lh(mutex);
+    auto& vbIndex = index.at(vbid.get());
+    auto found = vbIndex.find(StoredDocKey(key));
+    if (found == vbIndex.end()) {
+        return nullptr;
+    }
+
+    // Move the entry to the front of the LRU.
+    const auto& entry = *found->second;
+    lru.splice(lru.begin(), lru, found->second);
+
+    const char* data = nullptr;
+    size_t nbytes = entry.valueSize;
+    if (metaOnly == GetMetaOnly::No) {
+        data = entry.value.data();
+        if (entry.compressed) {
+            if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                          entry.value,
+                                          inflated)) {
+                throw std::runtime_error(
+                        "DocumentCache::get: failed to inflate value of " +
+                        vbid.to_string());
+            }
+            data = inflated.data();
+        }
+    }
+
+    auto item = std::make_unique<Item>(entry.key,
+                                       entry.flags,
+                                       entry.exptime,
+                                       data,
+                                       nbytes,
+                                       entry.datatype,
+                                       entry.cas,
+                                       entry.bySeqno,
+                                       entry.vbid,
+                                       entry.revSeqno);
+    if (entry.deleted) {
+        item->setDeleted(static_cast<DeleteSource>(entry.deleteSource));
+    }
+    return item;
+}
+
+void DocumentCache::insert(const Item& item, uint64_t generation) {
+    NonBucketAllocationGuard guard;
+    Entry entry(item);
+    const auto size = entry.getSize();
+    if (size > maxSize) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lg(mutex);
+    if (generations.at(entry.vbid.get()) != generation) {
+        return;
+    }
+
+    auto& vbIndex = index.at(entry.vbid.get());
+    auto found = vbIndex.find(entry.key);
+    if (found != vbIndex.end()) {
+        erase(found->second);
+    }
+
+    while (!lru.empty() && memoryUsed + size > maxSize) {
+        erase(std::prev(lru.end()));
+    }
+
+    lru.push_front(std::move(entry));
+    vbIndex.emplace(lru.front().key, lru.begin());
+    memoryUsed += size;
+}
+
+void DocumentCache::invalidate(Vbid vbid, const DocKey& key) {
+    NonBucketAllocationGuard guard;
+    std::lock_guard<std::mutex> lg(mutex);
+    ++generations.at(vbid.get());
+    auto& vbIndex = index.at(vbid.get());
+    auto found = vbIndex.find(StoredDocKey(key));
+    if (found != vbIndex.end()) {
+        erase(found->second);
+    }
+}
+
+void DocumentCache::invalidateVBucket(Vbid vbid) {
+    NonBucketAllocationGuard guard;
+    std::lock_guard<std::mutex> lg(mutex);
+    ++generations.at(vbid.get());
+    auto& vbIndex = index.at(vbid.get());
+    while (!vbIndex.empty()) {
+        erase(vbIndex.begin()->second);
+    }
+}
+
+size_t DocumentCache::getNumItems() const {
+    std::lock_guard<std::mutex> lg(mutex);
+    return lru.size();
+}
+
+void DocumentCache::erase(EntryList::iterator entry) {
+    memoryUsed -= entry->getSize();
+    index[entry->vbid.get()].erase(entry->key);
+    lru.erase(entry);
+}
@@ -0,0 +1,141 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "storeddockey.h"
+
+#include <memcached/vbucket.h>
+#include <platform/non_negative_counter.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Item;
+enum class GetMetaOnly;
+
+/**
+ * Memory-bounded, read-through cache of documents fetched from disk by
+ * background fetches, kept in front of the data files of one shard (and
+ * shared by all of the shard's KVStores).
+ *
+ * Documents are held compressed (Snappy) and evicted in LRU order once the
+ * cache reaches its size limit. The memory of the cache is not accounted in
+ * the bucket's mem_used - its budget is separate from the bucket quota.
+ *
+ * A cached document must never be served once the document on disk has
+ * changed, so writers invalidate the keys they persist (after the commit)
+ * and whole vBuckets on delete, rollback or compaction. As a reader may have
+ * read a document just before a writer invalidated it, each vBucket has a
+ * generation which every invalidation increments; readers take the
+ * generation before opening the file and insert() drops documents read
+ * under an older generation.
+ */
+class DocumentCache {
+public:
+    /**
+     * @param maxSize maximum number of bytes the cache may use
+     * @param maxVBuckets number of vBuckets of the bucket
+     */
+    DocumentCache(size_t maxSize, size_t maxVBuckets);
+
+    ~DocumentCache();
+
+    /// @returns the current generation of the vBucket.
+    uint64_t getGeneration(Vbid vbid) const;
+
+    /**
+     * Look up a document, making it the most recently used.
+     *
+     * @return a copy of the cached document (without its value if
+     *         metaOnly), or nullptr if the key is not cached.
+     */
+    std::unique_ptr<Item> get(Vbid vbid,
+                              const DocKey& key,
+                              GetMetaOnly metaOnly);
+
+    /**
+     * Cache a document read from disk, replacing any cached copy.
+     *
+     * @param item a document with its value, as read from disk
+     * @param generation the generation of the item's vBucket taken before
+     *        the document was read; the document is not cached if the
+     *        vBucket has been invalidated since.
+     */
+    void insert(const Item& item, uint64_t generation);
+
+    /// Drop the cached copy of a key, as its document has been written.
+    void invalidate(Vbid vbid, const DocKey& key);
+
+    /// Drop all the cached documents of a vBucket.
+    void invalidateVBucket(Vbid vbid);
+
+    size_t getMaxSize() const {
+        return maxSize;
+    }
+
+    /// @returns the (approximate) number of bytes used by the cache.
+    size_t getMemoryUsed() const {
+        return memoryUsed;
+    }
+
+    size_t getNumItems() const;
+
+private:
+    struct Entry {
+        Entry(const Item& item);
+
+        size_t getSize() const;
+
+        const Vbid vbid;
+        const StoredDocKey key;
+        const uint32_t flags;
+        const time_t exptime;
+        const uint64_t cas;
+        const int64_t bySeqno;
+        const uint64_t revSeqno;
+        const uint8_t datatype;
+        const bool deleted;
+        const uint8_t deleteSource;
+        /// Uncompressed size of the value.
+        const uint32_t valueSize;
+        /// True if the value was compressed when it was cached.
+        bool compressed = false;
+        std::string value;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    /// Remove an entry, the caller must hold the mutex.
+    void erase(EntryList::iterator entry);
+
+    const size_t maxSize;
+
+    mutable std::mutex mutex;
+    /// All entries, most recently used first.
+    EntryList lru;
+    /// Per vBucket index of the entries.
+    std::vector<std::unordered_map<StoredDocKey, EntryList::iterator>> index;
+    std::vector<uint64_t> generations;
+
+    cb::NonNegativeCounter<size_t> memoryUsed;
+};
@@ -16,6 +16,7 @@
  */
 
 #include "durability_monitor.h"
+#include "durability_timings.h"
 #include "item.h"
 #include "stored-value.h"
 
@@ -26,7 +27,8 @@
  */
 class DurabilityMonitor::SyncWrite {
 public:
-    SyncWrite(queued_item item) : item(item) {
+    SyncWrite(queued_item item)
+        : item(item), startTime(std::chrono::steady_clock::now()) {
     }
 
     int64_t getBySeqno() const {
@@ -37,6 +39,11 @@ public:
         return item->getDurabilityReqs();
     }
 
+    /// @return when the SyncWrite started being tracked
+    std::chrono::steady_clock::time_point getStartTime() const {
+        return startTime;
+    }
+
 private:
     // An Item stores all the info that the DurabilityMonitor needs:
     // - seqno
@@ -44,6 +51,8 @@ private:
     // Note that queued_item is a ref-counted object, so the copy in the
     // CheckpointManager can be safely removed.
     const queued_item item;
+
+    const std::chrono::steady_clock::time_point startTime;
 };
 
 /*
@@ -80,7 +89,10 @@ struct DurabilityMonitor::ReplicationChain {
     const uint8_t majority;
 };
 
-DurabilityMonitor::DurabilityMonitor(VBucket& vb) : vb(vb) {
+DurabilityMonitor::DurabilityMonitor(VBucket& vb,
+                                     DurabilityTimings* timings,
+                                     LockProfile* lockProfile)
+    : vb(vb), timings(timings), state(lockProfile) {
 }
 
 DurabilityMonitor::~DurabilityMonitor() = default;
@@ -99,7 +111,8 @@ ENGINE_ERROR_CODE DurabilityMonitor::registerReplicationChain(
 
     // Statically create a single RC. This will be expanded for creating
     // multiple RCs dynamically.
-    std::lock_guard<std::mutex> lg(state.m);
+    std::lock_guard<StateMutex> lg(state.m);
+    trackIncoming(lg);
     state.firstChain = std::make_unique<ReplicationChain>(
             nodes, state.trackedWrites.begin());
 
@@ -112,8 +125,12 @@ ENGINE_ERROR_CODE DurabilityMonitor::addSyncWrite(queued_item item) {
         durReq.getTimeout() != 0) {
         return ENGINE_ENOTSUP;
     }
-    std::lock_guard<std::mutex> lg(state.m);
-    state.trackedWrites.push_back(SyncWrite(item));
+    // Allocate the list node before taking the lock, so only an O(1) splice
+    // is done under it.
+    Container write;
+    write.push_back(SyncWrite(item));
+    std::lock_guard<std::mutex> lg(incoming.m);
+    incoming.writes.splice(incoming.writes.end(), write);
     return ENGINE_SUCCESS;
 }
 
@@ -121,7 +138,8 @@ ENGINE_ERROR_CODE DurabilityMonitor::seqnoAckReceived(
         const std::string& replica, int64_t memorySeqno) {
     // @todo: The scope can be probably shorten. Deferring to follow-up patches
     //     as I'm amending this function considerably.
-    std::lock_guard<std::mutex> lg(state.m);
+    std::lock_guard<StateMutex> lg(state.m);
+    trackIncoming(lg);
 
     // Note that in the current implementation of DurabilitMonitot Container
     // can be empty only before the first SyncWrite is added for tracking.
@@ -148,6 +166,7 @@ ENGINE_ERROR_CODE DurabilityMonitor::seqnoAckReceived(
                 ", pending:" + std::to_string(pendingSeqno) + "}");
     }
 
+    const auto now = std::chrono::steady_clock::now();
     while (hasPending(lg, replica)) {
         // Process up to the ack'ed memory seqno
         if (getReplicaPendingMemorySeqno(lg, replica) > memorySeqno) {
@@ -160,6 +179,12 @@ ENGINE_ERROR_CODE DurabilityMonitor::seqnoAckReceived(
         // Note: In this first implementation (1 replica) the Durability
         // Requirement for the pending SyncWrite is implicitly verified
         // at this point.
+        if (timings) {
+            const auto& ackedWrite = *getReplicaMemoryIterator(lg, replica);
+            const auto duration = now - ackedWrite.getStartTime();
+            timings->logReplicate(duration);
+            timings->logCommit(duration);
+        }
 
         // Commit the verified SyncWrite
         commit(lg);
@@ -169,13 +194,14 @@ ENGINE_ERROR_CODE DurabilityMonitor::seqnoAckReceived(
 }
 
 size_t DurabilityMonitor::getNumTracked(
-        const std::lock_guard<std::mutex>& lg) const {
-    return state.trackedWrites.size();
+        const std::lock_guard<StateMutex>& lg) const {
+    std::lock_guard<std::mutex> incomingLock(incoming.m);
+    return state.trackedWrites.size() + incoming.writes.size();
 }
 
 const DurabilityMonitor::Container::iterator&
 DurabilityMonitor::getReplicaMemoryIterator(
-        const std::lock_guard<std::mutex>& lg,
+        const std::lock_guard<StateMutex>& lg,
         const std::string& replica) const {
     if (!state.firstChain) {
         throw std::logic_error(
@@ -192,7 +218,7 @@ DurabilityMonitor::getReplicaMemoryIterator(
 }
 
 DurabilityMonitor::Container::iterator DurabilityMonitor::getReplicaMemoryNext(
-        const std::lock_guard<std::mutex>& lg, const std::string& replica) {
+        const std::lock_guard<StateMutex>& lg, const std::string& replica) {
     const auto& it = getReplicaMemoryIterator(lg, replica);
     // A replica iterator represent the durability state of a replica as seen
     // from the active and it is never singular:
@@ -207,14 +233,14 @@ DurabilityMonitor::Container::iterator DurabilityMonitor::getReplicaMemoryNext(
 }
 
 void DurabilityMonitor::advanceReplicaMemoryIterator(
-        const std::lock_guard<std::mutex>& lg, const std::string& replica) {
+        const std::lock_guard<StateMutex>& lg, const std::string& replica) {
     auto& it = const_cast<DurabilityMonitor::Container::iterator&>(
             getReplicaMemoryIterator(lg, replica));
     it++;
 }
 
 int64_t DurabilityMonitor::getReplicaMemorySeqno(
-        const std::lock_guard<std::mutex>& lg,
+        const std::lock_guard<StateMutex>& lg,
         const std::string& replica) const {
     const auto& it = getReplicaMemoryIterator(lg, replica);
     if (it == state.trackedWrites.end()) {
@@ -223,13 +249,13 @@ int64_t DurabilityMonitor::getReplicaMemorySeqno(
     return it->getBySeqno();
 }
 
-bool DurabilityMonitor::hasPending(const std::lock_guard<std::mutex>& lg,
+bool DurabilityMonitor::hasPending(const std::lock_guard<StateMutex>& lg,
                                    const std::string& replica) {
     return getReplicaMemoryNext(lg, replica) != state.trackedWrites.end();
 }
 
 int64_t DurabilityMonitor::getReplicaPendingMemorySeqno(
-        const std::lock_guard<std::mutex>& lg, const std::string& replica) {
+        const std::lock_guard<StateMutex>& lg, const std::string& replica) {
     const auto& next = getReplicaMemoryNext(lg, replica);
     if (next == state.trackedWrites.end()) {
         return 0;
@@ -237,7 +263,14 @@ int64_t DurabilityMonitor::getReplicaPendingMemorySeqno(
     return next->getBySeqno();
 }
 
-void DurabilityMonitor::commit(const std::lock_guard<std::mutex>& lg) {
+void DurabilityMonitor::trackIncoming(const std::lock_guard<StateMutex>& lg) {
+    // Note: splicing into the list leaves the replica iterators valid,
+    // including the ones at trackedWrites.end() (i.e. before the first ACK)
+    std::lock_guard<std::mutex> incomingLock(incoming.m);
+    state.trackedWrites.splice(state.trackedWrites.end(), incoming.writes);
+}
+
+void DurabilityMonitor::commit(const std::lock_guard<StateMutex>& lg) {
     // @todo: do commit.
     // Here we will:
     // 1) update the SyncWritePrepare to SyncWriteCommit in the HT
@@ -17,13 +17,16 @@
 #pragma once
 
 #include "ep_types.h"
+#include "lock_profiler.h"
 
 #include "memcached/durability_spec.h"
 #include "memcached/engine_error.h"
 
+#include <chrono>
 #include <list>
 #include <mutex>
 
+class DurabilityTimings;
 class StoredValue;
 class VBucket;
 
@@ -39,7 +42,16 @@ class DurabilityMonitor {
 public:
     // Note: constructor and destructor implementation in the .cc file to allow
     // the forward declaration of ReplicationChain in the header
-    DurabilityMonitor(VBucket& vb);
+    /**
+     * @param vb the VBucket owning this DurabilityMonitor
+     * @param timings where the time taken by each phase of the tracked
+     *        SyncWrites is recorded (if not null)
+     * @param lockProfile where a sample of the acquisitions of the state lock
+     *        is recorded (if not null)
+     */
+    DurabilityMonitor(VBucket& vb,
+                      DurabilityTimings* timings = nullptr,
+                      LockProfile* lockProfile = nullptr);
     ~DurabilityMonitor();
 
     /**
@@ -76,6 +88,7 @@ public:
                                        int64_t memorySeqno);
 
 protected:
+    using StateMutex = ProfiledMutex<std::mutex>;
     class SyncWrite;
     using Container = std::list<SyncWrite>;
 
@@ -83,7 +96,7 @@ protected:
      * @param lg the object lock
      * @return the number of pending SyncWrite(s) currently tracked
      */
-    size_t getNumTracked(const std::lock_guard<std::mutex>& lg) const;
+    size_t getNumTracked(const std::lock_guard<StateMutex>& lg) const;
     /**
      * Returns a replica memory iterator.
      *
@@ -93,7 +106,7 @@ protected:
      * @throw std::invalid_argument if replica is not valid
      */
     const Container::iterator& getReplicaMemoryIterator(
-            const std::lock_guard<std::mutex>& lg,
+            const std::lock_guard<StateMutex>& lg,
             const std::string& replica) const;
 
     /**
@@ -104,7 +117,7 @@ protected:
      * @return the iterator to the next position for the given replica
      */
     Container::iterator getReplicaMemoryNext(
-            const std::lock_guard<std::mutex>& lg, const std::string& replica);
+            const std::lock_guard<StateMutex>& lg, const std::string& replica);
 
     /*
      * Advance a replica iterator
@@ -112,7 +125,7 @@ protected:
      * @param lg the object lock
      * @param replica
      */
-    void advanceReplicaMemoryIterator(const std::lock_guard<std::mutex>& lg,
+    void advanceReplicaMemoryIterator(const std::lock_guard<StateMutex>& lg,
                                       const std::string& replica);
 
     /**
@@ -124,7 +137,7 @@ protected:
      *
      * @todo: Expand for supporting and disk-seqno
      */
-    int64_t getReplicaMemorySeqno(const std::lock_guard<std::mutex>& lg,
+    int64_t getReplicaMemorySeqno(const std::lock_guard<StateMutex>& lg,
                                   const std::string& replica) const;
 
     /*
@@ -133,9 +146,17 @@ protected:
      * @return true if the is a pending SyncWrite for the given replica,
      *     false otherwise
      */
-    bool hasPending(const std::lock_guard<std::mutex>& lg,
+    bool hasPending(const std::lock_guard<StateMutex>& lg,
                     const std::string& replica);
 
+    /**
+     * Moves the SyncWrites added since the last call to the end of
+     * trackedWrites.
+     *
+     * @param lg the object lock
+     */
+    void trackIncoming(const std::lock_guard<StateMutex>& lg);
+
     /*
      * Returns the seqno of the next pending SyncWrite for the given replica.
      * The function returns 0 if replica has already acknowledged all the
@@ -145,7 +166,7 @@ protected:
      * @param replica
      * @return the pending seqno for replica, 0 if there is no pending
      */
-    int64_t getReplicaPendingMemorySeqno(const std::lock_guard<std::mutex>& lg,
+    int64_t getReplicaPendingMemorySeqno(const std::lock_guard<StateMutex>& lg,
                                          const std::string& replica);
 
     /**
@@ -154,18 +175,32 @@ protected:
      *
      * @param lg the object lock
      */
-    void commit(const std::lock_guard<std::mutex>& lg);
+    void commit(const std::lock_guard<StateMutex>& lg);
 
     // The VBucket owning this DurabilityMonitor instance
     VBucket& vb;
 
+    DurabilityTimings* const timings;
+
     struct ReplicationChain;
     // Represents the internal state of a DurabilityMonitor instance.
     // Any state change must happen under lock(state.m).
-    struct {
-        mutable std::mutex m;
+    struct State {
+        explicit State(LockProfile* lockProfile) : m(lockProfile) {
+        }
+
+        mutable StateMutex m;
         // @todo: Expand for supporting the SecondChain.
         std::unique_ptr<ReplicationChain> firstChain;
         Container trackedWrites;
     } state;
+
+    // SyncWrites added but not yet moved into state.trackedWrites.
+    // Front-end threads only take this (short lived) lock to add a SyncWrite,
+    // so they don't contend with the processing of replica acks on state.m.
+    // Lock order is state.m then incoming.m.
+    struct {
+        mutable std::mutex m;
+        Container writes;
+    } incoming;
 };
@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "durability_timings.h"
+
+#include "statwriter.h"
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+// Track from 1us to an hour, to 2 significant figures.
+static const uint64_t MaxTrackedMicros = 3600ULL * 1000 * 1000;
+
+static uint64_t toMicros(steady_clock::duration d) {
+    const auto us = duration_cast<microseconds>(d).count();
+    return std::min(uint64_t(std::max(us, decltype(us)(1))), MaxTrackedMicros);
+}
+
+DurabilityTimings::DurabilityTimings()
+    : replicate(1, MaxTrackedMicros, 2), commit(1, MaxTrackedMicros, 2) {
+}
+
+void DurabilityTimings::logReplicate(steady_clock::duration duration) {
+    std::lock_guard<std::mutex> lh(mutex);
+    replicate.addValue(toMicros(duration));
+}
+
+void DurabilityTimings::logCommit(steady_clock::duration duration) {
+    std::lock_guard<std::mutex> lh(mutex);
+    commit.addValue(toMicros(duration));
+}
+
+void DurabilityTimings::reset() {
+    std::lock_guard<std::mutex> lh(mutex);
+    replicate.reset();
+    commit.reset();
+}
+
+void DurabilityTimings::addStats(const void* cookie, ADD_STAT add_stat) const {
+    std::lock_guard<std::mutex> lh(mutex);
+    add_percentile_stats("replicate", replicate, add_stat, cookie);
+    add_percentile_stats("commit", commit, add_stat, cookie);
+}
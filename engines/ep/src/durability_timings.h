@@ -0,0 +1,59 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include "hdrhistogram.h"
+
+#include <memcached/engine_common.h>
+
+#include <chrono>
+#include <mutex>
+
+/**
+ * Histograms of where the time goes for the SyncWrites of a bucket, as seen
+ * by the DurabilityMonitor of the active vBucket:
+ *
+ * - replicate: from the SyncWrite being tracked to a replica acking it. This
+ *   covers the time in the checkpoint, the DCP send to the replica, the
+ *   replica applying it and the ack returning.
+ * - commit: from the SyncWrite being tracked to its Durability Requirements
+ *   being met (i.e. it can be committed).
+ *
+ * Reported by "stats durability-timings".
+ */
+class DurabilityTimings {
+public:
+    DurabilityTimings();
+
+    /// Record the time from a SyncWrite being tracked to a replica acking it
+    void logReplicate(std::chrono::steady_clock::duration duration);
+
+    /// Record the time from a SyncWrite being tracked to it being committed
+    void logCommit(std::chrono::steady_clock::duration duration);
+
+    void reset();
+
+    void addStats(const void* cookie, ADD_STAT add_stat) const;
+
+private:
+    mutable std::mutex mutex;
+    HdrHistogram replicate;
+    HdrHistogram commit;
+};
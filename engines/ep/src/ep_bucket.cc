@@ -25,10 +25,16 @@
 #include "ep_vb.h"
 #include "failover-table.h"
 #include "flusher.h"
+#include "hashtable_image.h"
 #include "persistence_callback.h"
 #include "replicationthrottle.h"
 #include "tasks.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <thread>
+
 /**
  * Callback class used by EpStore, for adding relevant keys
  * to bloomfilter during compaction.
@@ -157,7 +163,9 @@ bool BloomFilterCallback::initTempFilter(Vbid vbucketId) {
         estimated_count = initial_estimation;
     }
 
-    vb->initTempFilter(estimated_count, config.getBfilterFpProb());
+    vb->initTempFilter(estimated_count,
+                       config.getBfilterFpProb(),
+                       config.isBfilterBlocked());
 
     return true;
 }
@@ -186,6 +194,20 @@ public:
                                   size_t value) override {
         if (key == "flusher_batch_split_trigger") {
             bucket.setFlusherBatchSplitTrigger(value);
+        } else if (key == "flusher_batch_min_size") {
+            bucket.flushBatchController.setMinBatchSize(value);
+        } else if (key == "flusher_batch_target_commit_time") {
+            bucket.flushBatchController.setTargetCommitTime(
+                    std::chrono::milliseconds(value));
+        } else if (key == "flusher_group_commit_size") {
+            bucket.setFlusherGroupCommitSize(value);
+        } else if (key == "compaction_max_concurrent_vbuckets") {
+            bucket.setCompactionMaxConcurrency(value);
+        } else if (key == "compaction_io_rate_limit") {
+            bucket.compactionThrottle.setMaxRate(value * 1024 * 1024);
+        } else if (key == "compaction_backoff_bg_wait") {
+            bucket.compactionThrottle.setBackoffLatency(
+                    std::chrono::microseconds(value));
         } else {
             EP_LOG_WARN("Failed to change value for unknown variable, {}", key);
         }
@@ -205,7 +227,19 @@ private:
 };
 
 EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
-    : KVBucket(theEngine) {
+    : KVBucket(theEngine),
+      flushBatchController(
+              engine.getConfiguration().getFlusherBatchSplitTrigger(),
+              engine.getConfiguration().getFlusherBatchMinSize(),
+              std::chrono::milliseconds(engine.getConfiguration()
+                                                .getFlusherBatchTargetCommitTime())),
+      compactionMaxConcurrency(
+              engine.getConfiguration().getCompactionMaxConcurrentVbuckets()),
+      compactionThrottle(
+              engine.getConfiguration().getCompactionIoRateLimit() * 1024 *
+                      1024,
+              std::chrono::microseconds(
+                      engine.getConfiguration().getCompactionBackoffBgWait())) {
     auto& config = engine.getConfiguration();
     const std::string& policy = config.getItemEvictionPolicy();
     if (policy.compare("value_only") == 0) {
@@ -218,10 +252,30 @@ EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
 
     vbMap.enablePersistence(*this);
 
-    flusherBatchSplitTrigger = config.getFlusherBatchSplitTrigger();
     config.addValueChangedListener(
             "flusher_batch_split_trigger",
             std::make_unique<ValueChangedListener>(*this));
+    config.addValueChangedListener(
+            "flusher_batch_min_size",
+            std::make_unique<ValueChangedListener>(*this));
+    config.addValueChangedListener(
+            "flusher_batch_target_commit_time",
+            std::make_unique<ValueChangedListener>(*this));
+
+    flusherGroupCommitSize = config.getFlusherGroupCommitSize();
+    config.addValueChangedListener(
+            "flusher_group_commit_size",
+            std::make_unique<ValueChangedListener>(*this));
+
+    config.addValueChangedListener(
+            "compaction_max_concurrent_vbuckets",
+            std::make_unique<ValueChangedListener>(*this));
+    config.addValueChangedListener(
+            "compaction_io_rate_limit",
+            std::make_unique<ValueChangedListener>(*this));
+    config.addValueChangedListener(
+            "compaction_backoff_bg_wait",
+            std::make_unique<ValueChangedListener>(*this));
 
     retainErroneousTombstones = config.isRetainErroneousTombstones();
     config.addValueChangedListener(
@@ -249,6 +303,14 @@ void EPBucket::deinitialize() {
     stopFlusher();
     stopBgFetcher();
 
+    if (!stats.forceShutdown &&
+        engine.getConfiguration().isWarmupHashtableImage()) {
+        writeHashTableImages();
+    }
+    if (!stats.forceShutdown && engine.getConfiguration().isBfilterPersist()) {
+        persistBloomFilters();
+    }
+
     KVBucket::deinitialize();
 }
 
@@ -262,10 +324,12 @@ void EPBucket::reset() {
     vbMap.getShard(EP_PRIMARY_SHARD)->getFlusher()->notifyFlushEvent();
 }
 
-std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
+std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid,
+                                               std::vector<Vbid>* unsynced) {
     KVShard *shard = vbMap.getShardByVbId(vbid);
     if (diskDeleteAll && !deleteAllTaskCtx.delay) {
-        if (shard->getId() == EP_PRIMARY_SHARD) {
+        if (shard->getId() == EP_PRIMARY_SHARD &&
+            shard->getFlusherIndex(vbid) == 0) {
             flushOneDeleteAll();
         } else {
             // disk flush is pending just return
@@ -285,16 +349,29 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
     if (vb) {
         // Obtain the set of items to flush, up to the maximum allowed for
         // a single flush.
-        auto toFlush = vb->getItemsToPersist(flusherBatchSplitTrigger);
+        auto toFlush = vb->getItemsToPersist(
+                flushBatchController.getBatchLimit());
         auto& items = toFlush.items;
         auto& range = toFlush.range;
         moreAvailable = toFlush.moreAvailable;
 
         KVStore* rwUnderlying = getRWUnderlying(vb->getId());
+        const bool deferSync =
+                unsynced &&
+                rwUnderlying->getStorageProperties().hasGroupCommit();
+        bool syncDeferred = false;
 
         if (!items.empty()) {
-            while (!rwUnderlying->begin(
-                    std::make_unique<EPTransactionContext>(stats, *vb))) {
+            auto makeTxCtx = [this, &vb]() {
+                auto txCtx = std::make_unique<EPTransactionContext>(stats, *vb);
+                if (vb->getState() == vbucket_state_replica) {
+                    txCtx->replicaValuePolicy = getReplicaValuePolicy();
+                    txCtx->minCompressionRatio =
+                            engine.getMinCompressionRatio();
+                }
+                return txCtx;
+            };
+            while (!rwUnderlying->begin(makeTxCtx())) {
                 ++stats.beginFailed;
                 EP_LOG_WARN(
                         "Failed to start a transaction!!! "
@@ -372,7 +449,10 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
                     //     with the same key are ordered from high->low seqno.
                     //     This means we only write the highest (i.e. newest)
                     //     item for a given key, and discard any duplicate,
-                    //     older items.
+                    //     older items. As the batch spans all checkpoints
+                    //     being flushed, this also collapses a key which was
+                    //     updated in several checkpoints.
+                    ++stats.totalDeduplicatedFlusher;
                     --stats.diskQueueSize;
                     vb->doStatsForFlushing(*item, item->size());
                 }
@@ -411,12 +491,23 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
                 // If there are no "real" items to flush, and we encountered
                 // a set_vbucket_state meta-item.
                 auto options = VBStatePersist::VBSTATE_CACHE_UPDATE_ONLY;
-                if ((items_flushed == 0) && mustCheckpointVBState) {
+                const bool persistState =
+                        (items_flushed == 0) && mustCheckpointVBState;
+                if (persistState) {
                     options = VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT;
+                    // A state only commit joins the group commit like any
+                    // other flush, so the state changes of many vBuckets
+                    // (e.g. during a rebalance) share a sync to disk.
+                    rwUnderlying->setDeferCommitSync(deferSync);
                 }
 
-                if (rwUnderlying->snapshotVBucket(vb->getId(), vbstate,
-                                                  options) != true) {
+                const bool snapshotted = rwUnderlying->snapshotVBucket(
+                        vb->getId(), vbstate, options);
+                if (persistState) {
+                    rwUnderlying->setDeferCommitSync(false);
+                    syncDeferred = snapshotted && deferSync;
+                }
+                if (!snapshotted) {
                     return {true, 0};
                 }
 
@@ -431,7 +522,16 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
              * Or if there is a manifest item
              */
             if (items_flushed > 0 || sef.needsCommit()) {
+                rwUnderlying->setDeferCommitSync(deferSync);
+                const auto commit_start = std::chrono::steady_clock::now();
                 commit(*rwUnderlying, sef.getCollectionFlush());
+                flushBatchController.commitCompleted(
+                        items_flushed,
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() -
+                                commit_start));
+                rwUnderlying->setDeferCommitSync(false);
+                syncDeferred = deferSync;
 
                 // Now the commit is complete, vBucket file must exist.
                 if (vb->setBucketCreation(false)) {
@@ -439,7 +539,7 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
                 }
             }
 
-            if (vb->rejectQueue.empty()) {
+            if (vb->rejectQueue.empty() && !syncDeferred) {
                 vb->setPersistedSnapshot(range.start, range.end);
                 uint64_t highSeqno = rwUnderlying->getLastPersistedSeqno(vbid);
                 if (highSeqno > 0 && highSeqno != vb->getPersistenceSeqno()) {
@@ -467,28 +567,80 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
             wakeUpCheckpointRemover();
         }
 
-        if (vb->rejectQueue.empty()) {
-            vb->checkpointManager->itemsPersisted();
-            uint64_t seqno = vb->getPersistenceSeqno();
-            uint64_t chkid =
-                    vb->checkpointManager->getPersistenceCursorPreChkId();
-            vb->notifyHighPriorityRequests(
-                    engine, seqno, HighPriorityVBNotify::Seqno);
-            vb->notifyHighPriorityRequests(
-                    engine, chkid, HighPriorityVBNotify::ChkPersistence);
-            if (chkid > 0 && chkid != vb->getPersistenceCheckpointId()) {
-                vb->setPersistenceCheckpointId(chkid);
-            }
-        } else {
+        if (syncDeferred) {
+            // Persistence is only acknowledged once the group is synced, see
+            // syncFlushedVBuckets().
+            unsynced->push_back(vbid);
+        }
+
+        if (!vb->rejectQueue.empty()) {
             return {true, items_flushed};
+        } else if (!syncDeferred) {
+            notifyItemsPersisted(*vb);
         }
     }
 
     return {moreAvailable, items_flushed};
 }
 
+bool EPBucket::syncFlushedVBuckets(KVStore& rwUnderlying,
+                                   std::vector<Vbid>& unsynced) {
+    if (unsynced.empty()) {
+        return true;
+    }
+    if (!rwUnderlying.syncCommits()) {
+        EP_LOG_WARN(
+                "EPBucket::syncFlushedVBuckets: Failed to sync the commits of "
+                "{} vBucket flushes, will retry",
+                unsynced.size());
+        return false;
+    }
+
+    // A vBucket may have been flushed more than once since the last sync.
+    std::sort(unsynced.begin(), unsynced.end());
+    unsynced.erase(std::unique(unsynced.begin(), unsynced.end()),
+                   unsynced.end());
+
+    for (auto vbid : unsynced) {
+        auto vb = getLockedVBucket(vbid);
+        if (!vb || !vb->rejectQueue.empty()) {
+            continue;
+        }
+        // Everything committed to the vBucket is now durable, so the state
+        // cached by the last commit describes what has been persisted.
+        const auto* vbstate = rwUnderlying.getVBucketState(vbid);
+        if (vbstate) {
+            vb->setPersistedSnapshot(vbstate->lastSnapStart,
+                                     vbstate->lastSnapEnd);
+        }
+        uint64_t highSeqno = rwUnderlying.getLastPersistedSeqno(vbid);
+        if (highSeqno > 0 && highSeqno != vb->getPersistenceSeqno()) {
+            vb->setPersistenceSeqno(highSeqno);
+        }
+        notifyItemsPersisted(*vb);
+    }
+    unsynced.clear();
+    return true;
+}
+
+void EPBucket::notifyItemsPersisted(VBucket& vb) {
+    vb.checkpointManager->itemsPersisted();
+    uint64_t seqno = vb.getPersistenceSeqno();
+    uint64_t chkid = vb.checkpointManager->getPersistenceCursorPreChkId();
+    vb.notifyHighPriorityRequests(engine, seqno, HighPriorityVBNotify::Seqno);
+    vb.notifyHighPriorityRequests(
+            engine, chkid, HighPriorityVBNotify::ChkPersistence);
+    if (chkid > 0 && chkid != vb.getPersistenceCheckpointId()) {
+        vb.setPersistenceCheckpointId(chkid);
+    }
+}
+
 void EPBucket::setFlusherBatchSplitTrigger(size_t limit) {
-    flusherBatchSplitTrigger = limit;
+    flushBatchController.setMaxBatchSize(limit);
+}
+
+void EPBucket::setFlusherGroupCommitSize(size_t size) {
+    flusherGroupCommitSize = size;
 }
 
 void EPBucket::commit(KVStore& kvstore,
@@ -518,20 +670,25 @@ void EPBucket::commit(KVStore& kvstore,
 
 void EPBucket::startFlusher() {
     for (const auto& shard : vbMap.shards) {
-        shard->getFlusher()->start();
+        for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+            shard->getFlusher(ii)->start();
+        }
     }
 }
 
 void EPBucket::stopFlusher() {
     for (const auto& shard : vbMap.shards) {
-        auto* flusher = shard->getFlusher();
-        EP_LOG_INFO(
-                "Attempting to stop the flusher for "
-                "shard:{}",
-                shard->getId());
-        bool rv = flusher->stop(stats.forceShutdown);
-        if (rv && !stats.forceShutdown) {
-            flusher->wait();
+        for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+            auto* flusher = shard->getFlusher(ii);
+            EP_LOG_INFO(
+                    "Attempting to stop the flusher for "
+                    "shard:{} flusher:{}",
+                    shard->getId(),
+                    ii);
+            bool rv = flusher->stop(stats.forceShutdown);
+            if (rv && !stats.forceShutdown) {
+                flusher->wait();
+            }
         }
     }
 }
@@ -539,14 +696,17 @@ void EPBucket::stopFlusher() {
 bool EPBucket::pauseFlusher() {
     bool rv = true;
     for (const auto& shard : vbMap.shards) {
-        auto* flusher = shard->getFlusher();
-        if (!flusher->pause()) {
-            EP_LOG_WARN(
-                    "Attempted to pause flusher in state "
-                    "[{}], shard = {}",
-                    flusher->stateName(),
-                    shard->getId());
-            rv = false;
+        for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+            auto* flusher = shard->getFlusher(ii);
+            if (!flusher->pause()) {
+                EP_LOG_WARN(
+                        "Attempted to pause flusher in state "
+                        "[{}], shard = {} flusher = {}",
+                        flusher->stateName(),
+                        shard->getId(),
+                        ii);
+                rv = false;
+            }
         }
     }
     return rv;
@@ -555,14 +715,17 @@ bool EPBucket::pauseFlusher() {
 bool EPBucket::resumeFlusher() {
     bool rv = true;
     for (const auto& shard : vbMap.shards) {
-        auto* flusher = shard->getFlusher();
-        if (!flusher->resume()) {
-            EP_LOG_WARN(
-                    "Attempted to resume flusher in state [{}], "
-                    "shard = {}",
-                    flusher->stateName(),
-                    shard->getId());
-            rv = false;
+        for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+            auto* flusher = shard->getFlusher(ii);
+            if (!flusher->resume()) {
+                EP_LOG_WARN(
+                        "Attempted to resume flusher in state [{}], "
+                        "shard = {} flusher = {}",
+                        flusher->stateName(),
+                        shard->getId(),
+                        ii);
+                rv = false;
+            }
         }
     }
     return rv;
@@ -571,7 +734,9 @@ bool EPBucket::resumeFlusher() {
 void EPBucket::wakeUpFlusher() {
     if (stats.diskQueueSize.load() == 0) {
         for (const auto& shard : vbMap.shards) {
-            shard->getFlusher()->wake();
+            for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+                shard->getFlusher(ii)->wake();
+            }
         }
     }
 }
@@ -584,22 +749,28 @@ bool EPBucket::startBgFetcher() {
                         shard->getId());
             return false;
         }
-        bgfetcher->start();
+        for (size_t ii = 0; ii < shard->getNumBgFetchers(); ++ii) {
+            shard->getBgFetcher(ii)->start();
+        }
     }
     return true;
 }
 
 void EPBucket::stopBgFetcher() {
     for (const auto& shard : vbMap.shards) {
-        BgFetcher* bgfetcher = shard->getBgFetcher();
-        if (bgfetcher->pendingJob()) {
-            EP_LOG_WARN(
-                    "Shutting down engine while there are still pending data "
-                    "read for shard {} from database storage",
-                    shard->getId());
+        for (size_t ii = 0; ii < shard->getNumBgFetchers(); ++ii) {
+            BgFetcher* bgfetcher = shard->getBgFetcher(ii);
+            if (bgfetcher->pendingJob()) {
+                EP_LOG_WARN(
+                        "Shutting down engine while there are still pending "
+                        "data read for shard {} from database storage",
+                        shard->getId());
+            }
+            EP_LOG_INFO("Stopping bg fetcher {} for shard:{}",
+                        ii,
+                        shard->getId());
+            bgfetcher->stop();
         }
-        EP_LOG_INFO("Stopping bg fetcher for shard:{}", shard->getId());
-        bgfetcher->stop();
     }
 }
 
@@ -617,11 +788,25 @@ ENGINE_ERROR_CODE EPBucket::scheduleCompaction(Vbid vbid,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
+    const size_t maxConcurrent = compactionMaxConcurrency;
+    const double fragmentation =
+            maxConcurrent ? getFragmentation(c.db_file_id) : 0.0;
+
     LockHolder lh(compactionLock);
     ExTask task = std::make_shared<CompactTask>(
             *this, c, vb->getPurgeSeqno(), cookie);
-    compactionTasks.push_back(std::make_pair(c.db_file_id, task));
-    if (compactionTasks.size() > 1) {
+    compactionTasks.push_back({c.db_file_id, task, fragmentation, false});
+    if (maxConcurrent) {
+        const auto running = std::count_if(
+                compactionTasks.begin(),
+                compactionTasks.end(),
+                [](const CompTaskEntry& entry) { return !entry.parked; });
+        if (size_t(running) > maxConcurrent) {
+            // Held back until a running compaction completes.
+            compactionTasks.back().parked = true;
+            task->snooze(INT_MAX);
+        }
+    } else if (compactionTasks.size() > 1) {
         if ((stats.diskQueueSize > compactionWriteQueueCap &&
              compactionTasks.size() > (vbMap.getNumShards() / 2)) ||
             engine.getWorkLoadPolicy().getWorkLoadPattern() == READ_HEAVY) {
@@ -646,6 +831,50 @@ ENGINE_ERROR_CODE EPBucket::scheduleCompaction(Vbid vbid,
     return ENGINE_EWOULDBLOCK;
 }
 
+void EPBucket::writeHashTableImages() {
+    const auto& config = engine.getConfiguration();
+    const auto dbname = config.getDbname();
+    const bool includeValues = config.isWarmupHashtableImageValues();
+    size_t written = 0;
+    for (auto vbid : vbMap.getBuckets()) {
+        auto vb = getVBucket(vbid);
+        if (!vb) {
+            continue;
+        }
+        const auto fileName = HashTableImage::getFileName(dbname, vbid);
+        // An image must match the data file exactly; skip (and remove any
+        // old image of) a vBucket with anything left unpersisted.
+        if (vb->checkpointManager->getNumItemsForPersistence() != 0 ||
+            vb->isDeletionDeferred()) {
+            std::remove(fileName.c_str());
+            continue;
+        }
+        if (HashTableImage::write(fileName, *vb, includeValues)) {
+            ++written;
+        }
+    }
+    EP_LOG_INFO("EPBucket::writeHashTableImages: Wrote {} images", written);
+}
+
+void EPBucket::persistBloomFilters() {
+    size_t persisted = 0;
+    for (auto vbid : vbMap.getBuckets()) {
+        auto vb = getVBucket(vbid);
+        // A filter is only valid for the on-disk state it was persisted at.
+        if (!vb || vb->checkpointManager->getNumItemsForPersistence() != 0) {
+            continue;
+        }
+        const auto filter = vb->serialiseFilter();
+        if (!filter.empty() &&
+            getRWUnderlying(vbid)->snapshotBloomFilter(
+                    vbid, vb->getHighSeqno(), filter)) {
+            ++persisted;
+        }
+    }
+    EP_LOG_INFO("EPBucket::persistBloomFilters: Persisted {} bloom filters",
+                persisted);
+}
+
 void EPBucket::flushOneDeleteAll() {
     for (auto vbid : vbMap.getBuckets()) {
         auto vb = getLockedVBucket(vbid);
@@ -719,8 +948,12 @@ void EPBucket::compactInternal(const CompactionConfig& config,
                                       std::placeholders::_3,
                                       std::placeholders::_4);
 
+    if (compactionThrottle.getRate()) {
+        ctx.ioThrottle = [this](size_t bytes) { throttleCompaction(bytes); };
+    }
+
     KVShard* shard = vbMap.getShardByVbId(config.db_file_id);
-    KVStore* store = shard->getRWUnderlying();
+    KVStore* store = shard->getRWUnderlying(config.db_file_id);
     bool result = store->compactDB(&ctx);
 
     /* Iterate over all the vbucket ids set in max_purged_seq map. If there is
@@ -808,14 +1041,29 @@ bool EPBucket::doCompact(const CompactionConfig& config,
 
 void EPBucket::updateCompactionTasks(Vbid db_file_id) {
     LockHolder lh(compactionLock);
+    const size_t maxConcurrent = compactionMaxConcurrency;
+    if (maxConcurrent) {
+        auto it = std::find_if(compactionTasks.begin(),
+                               compactionTasks.end(),
+                               [db_file_id](const CompTaskEntry& entry) {
+                                   return entry.vbid == db_file_id &&
+                                          !entry.parked;
+                               });
+        if (it != compactionTasks.end()) {
+            compactionTasks.erase(it);
+        }
+        wakeParkedCompactions(maxConcurrent);
+        return;
+    }
+
     bool erased = false, woke = false;
     std::list<CompTaskEntry>::iterator it = compactionTasks.begin();
     while (it != compactionTasks.end()) {
-        if ((*it).first == db_file_id) {
+        if (it->vbid == db_file_id) {
             it = compactionTasks.erase(it);
             erased = true;
         } else {
-            ExTask& task = (*it).second;
+            ExTask& task = it->task;
             if (task->getState() == TASK_SNOOZED) {
                 ExecutorPool::get()->wake(task->getId());
                 woke = true;
@@ -828,6 +1076,60 @@ void EPBucket::updateCompactionTasks(Vbid db_file_id) {
     }
 }
 
+void EPBucket::wakeParkedCompactions(size_t maxConcurrent) {
+    size_t running = std::count_if(
+            compactionTasks.begin(),
+            compactionTasks.end(),
+            [](const CompTaskEntry& entry) { return !entry.parked; });
+    while (!maxConcurrent || running < maxConcurrent) {
+        auto next = compactionTasks.end();
+        for (auto it = compactionTasks.begin(); it != compactionTasks.end();
+             ++it) {
+            if (it->parked && (next == compactionTasks.end() ||
+                               it->fragmentation > next->fragmentation)) {
+                next = it;
+            }
+        }
+        if (next == compactionTasks.end()) {
+            return;
+        }
+        next->parked = false;
+        ExecutorPool::get()->wake(next->task->getId());
+        ++running;
+    }
+}
+
+void EPBucket::setCompactionMaxConcurrency(size_t max) {
+    LockHolder lh(compactionLock);
+    compactionMaxConcurrency = max;
+    wakeParkedCompactions(max);
+}
+
+double EPBucket::getFragmentation(Vbid vbid) {
+    try {
+        const auto info = getRWUnderlying(vbid)->getDbFileInfo(vbid);
+        if (info.fileSize == 0 || info.spaceUsed >= info.fileSize) {
+            return 0.0;
+        }
+        return double(info.fileSize - info.spaceUsed) / info.fileSize;
+    } catch (const std::exception& e) {
+        EP_LOG_WARN("EPBucket::getFragmentation: Failed to get {} info: {}",
+                    vbid,
+                    e.what());
+        return 0.0;
+    }
+}
+
+void EPBucket::throttleCompaction(size_t bytes) {
+    const auto now = std::chrono::steady_clock::now();
+    compactionThrottle.sampleBgFetches(
+            now, stats.bgWait.load(), stats.bgNumOperations.load());
+    const auto delay = compactionThrottle.acquire(bytes, now);
+    if (delay.count() > 0) {
+        std::this_thread::sleep_for(delay);
+    }
+}
+
 std::pair<uint64_t, bool> EPBucket::getLastPersistedCheckpointId(Vbid vb) {
     auto vbucket = vbMap.getBucket(vb);
     if (vbucket) {
@@ -843,10 +1145,15 @@ ENGINE_ERROR_CODE EPBucket::getFileStats(const void* cookie,
     DBFileInfo totalInfo;
 
     for (uint16_t shardId = 0; shardId < numShards; shardId++) {
-        const auto dbInfo =
-                getRWUnderlyingByShard(shardId)->getAggrDbFileInfo();
-        totalInfo.spaceUsed += dbInfo.spaceUsed;
-        totalInfo.fileSize += dbInfo.fileSize;
+        // Each vBucket's file sizes are tracked by the store which writes it,
+        // so sum over all of the shard's writer stores.
+        auto* shard = vbMap.getShard(shardId);
+        for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+            const auto dbInfo =
+                    shard->getRWUnderlyingForFlusher(ii)->getAggrDbFileInfo();
+            totalInfo.spaceUsed += dbInfo.spaceUsed;
+            totalInfo.fileSize += dbInfo.fileSize;
+        }
     }
 
     add_casted_stat("ep_db_data_size", totalInfo.spaceUsed, add_stat, cookie);
@@ -855,6 +1162,20 @@ ENGINE_ERROR_CODE EPBucket::getFileStats(const void* cookie,
     return ENGINE_SUCCESS;
 }
 
+ENGINE_ERROR_CODE EPBucket::getFlusherStats(const void* cookie,
+                                            ADD_STAT add_stat) {
+    add_casted_stat("flusher_batch_limit",
+                    flushBatchController.getBatchLimit(),
+                    add_stat,
+                    cookie);
+    for (const auto& shard : vbMap.shards) {
+        for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+            shard->getFlusher(ii)->addStats(add_stat, cookie);
+        }
+    }
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE EPBucket::getPerVBucketDiskStats(const void* cookie,
                                                    ADD_STAT add_stat) {
     class DiskStatVisitor : public VBucketVisitor {
@@ -866,7 +1187,7 @@ ENGINE_ERROR_CODE EPBucket::getPerVBucketDiskStats(const void* cookie,
             char buf[32];
             Vbid vbid = vb->getId();
             DBFileInfo dbInfo =
-                    vb->getShard()->getRWUnderlying()->getDbFileInfo(vbid);
+                    vb->getShard()->getRWUnderlying(vbid)->getDbFileInfo(vbid);
 
             try {
                 checked_snprintf(
@@ -996,23 +1317,32 @@ public:
             throw std::logic_error(
                     "EPDiskRollbackCB::callback: dbHandle is NULL");
         }
-        // This is the item in its current state, after the rollback seqno
-        // (i.e. the state that we are reverting)
-        UniqueItemPtr postRbSeqnoItem(std::move(val.item));
-        VBucketPtr vb = engine.getVBucket(postRbSeqnoItem->getVBucketId());
 
         // The get value of the item before the rollback seqno
         GetValue preRbSeqnoGetValue =
                 engine.getKVBucket()
-                        ->getROUnderlying(postRbSeqnoItem->getVBucketId())
+                        ->getROUnderlying(val.item->getVBucketId())
                         ->getWithHeader(dbHandle,
-                                        postRbSeqnoItem->getKey(),
-                                        postRbSeqnoItem->getVBucketId(),
+                                        val.item->getKey(),
+                                        val.item->getVBucketId(),
                                         GetMetaOnly::No);
-        if (preRbSeqnoGetValue.getStatus() == ENGINE_SUCCESS) {
+        rollbackKey(val, preRbSeqnoGetValue);
+    }
+
+    void rollbackKey(GetValue& postRbSeqno, GetValue& preRbSeqno) override {
+        if (!postRbSeqno.item) {
+            throw std::invalid_argument(
+                    "EPDiskRollbackCB::rollbackKey: postRbSeqno is NULL");
+        }
+        // This is the item in its current state, after the rollback seqno
+        // (i.e. the state that we are reverting)
+        UniqueItemPtr postRbSeqnoItem(std::move(postRbSeqno.item));
+        VBucketPtr vb = engine.getVBucket(postRbSeqnoItem->getVBucketId());
+
+        if (preRbSeqno.getStatus() == ENGINE_SUCCESS) {
             // This is the item in the state it was before the rollback seqno
             // (i.e. the desired state)
-            UniqueItemPtr preRbSeqnoItem(std::move(preRbSeqnoGetValue.item));
+            UniqueItemPtr preRbSeqnoItem(std::move(preRbSeqno.item));
             if (preRbSeqnoItem->isDeleted()) {
                 // If the item existed before, but had been deleted, we
                 // should delete it now
@@ -1037,13 +1367,13 @@ public:
                             .incrementDiskCount();
                 }
             }
-        } else if (preRbSeqnoGetValue.getStatus() == ENGINE_KEY_ENOENT) {
+        } else if (preRbSeqno.getStatus() == ENGINE_KEY_ENOENT) {
             // If the item did not exist before we should delete it now
             removeDeletedDoc(*vb, *postRbSeqnoItem);
         } else {
             EP_LOG_WARN(
-                    "EPDiskRollbackCB::callback:Unexpected Error Status: {}",
-                    preRbSeqnoGetValue.getStatus());
+                    "EPDiskRollbackCB::rollbackKey:Unexpected Error Status: {}",
+                    preRbSeqno.getStatus());
         }
     }
 
@@ -1071,7 +1401,7 @@ private:
 
 RollbackResult EPBucket::doRollback(Vbid vbid, uint64_t rollbackSeqno) {
     auto cb = std::make_shared<EPDiskRollbackCB>(engine);
-    KVStore* rwUnderlying = vbMap.getShardByVbId(vbid)->getRWUnderlying();
+    KVStore* rwUnderlying = getRWUnderlying(vbid);
     return rwUnderlying->rollback(vbid, rollbackSeqno, cb);
 }
 
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "compaction_throttle.h"
+#include "flush_batch_controller.h"
 #include "kv_bucket.h"
 
 /**
@@ -41,12 +43,29 @@ public:
     /**
      * Flushes all items waiting for persistence in a given vbucket
      * @param vbid The id of the vbucket to flush
+     * @param unsynced If non-null and the vBucket's KVStore supports group
+     *        commit, the commit isn't synced to disk; instead vbid is
+     *        appended to unsynced, and the flush is only acknowledged (the
+     *        persistence seqno updated and waiters notified) by a later
+     *        syncFlushedVBuckets().
      * @return A pair of {moreToFlush, flushCount}:
      *         moreToFlush - true if there are still items remaining for this
      *         vBucket.
      *         flushCount - the number of items flushed.
      */
-    std::pair<bool, size_t> flushVBucket(Vbid vbid);
+    std::pair<bool, size_t> flushVBucket(Vbid vbid,
+                                         std::vector<Vbid>* unsynced = nullptr);
+
+    /**
+     * Sync the unsynced commits of the given vBuckets (see flushVBucket()) to
+     * disk with a single sync, then acknowledge their persistence.
+     *
+     * @param rwUnderlying The KVStore the vBuckets were flushed to
+     * @param unsynced The vBuckets to sync; cleared on success
+     * @return false if the sync failed (unsynced is left as is to retry)
+     */
+    bool syncFlushedVBuckets(KVStore& rwUnderlying,
+                             std::vector<Vbid>& unsynced);
 
     /**
      * Set the number of flusher items which can be included in a
@@ -55,6 +74,21 @@ public:
      */
     void setFlusherBatchSplitTrigger(size_t limit);
 
+    /**
+     * Set the maximum number of vBucket flushes a flusher groups into one
+     * sync to disk. 0 or 1 disables group commit.
+     */
+    void setFlusherGroupCommitSize(size_t size);
+
+    size_t getFlusherGroupCommitSize() const {
+        return flusherGroupCommitSize;
+    }
+
+    /// @returns the current max number of items in a flusher batch.
+    size_t getFlusherBatchLimit() const {
+        return flushBatchController.getBatchLimit();
+    }
+
     void commit(KVStore& kvstore, Collections::VB::Flush& collectionsFlush);
 
     /// Start the Flusher for all shards in this bucket.
@@ -96,6 +130,9 @@ public:
 
     std::pair<uint64_t, bool> getLastPersistedCheckpointId(Vbid vb) override;
 
+    ENGINE_ERROR_CODE getFlusherStats(const void* cookie,
+                                      ADD_STAT add_stat) override;
+
     ENGINE_ERROR_CODE getFileStats(const void* cookie,
                                    ADD_STAT add_stat) override;
 
@@ -147,11 +184,38 @@ public:
         return retainErroneousTombstones.load();
     }
 
+    /**
+     * Limit how many compactions run at once (0 for no limit). Compactions
+     * scheduled beyond the limit are held back, and started most fragmented
+     * file first as the running ones complete.
+     */
+    void setCompactionMaxConcurrency(size_t max);
+
 protected:
     class ValueChangedListener;
 
     void flushOneDeleteAll();
 
+    /**
+     * Write an image of each fully persisted vBucket's HashTable for the next
+     * warmup to load (see HashTableImage). Called on a clean shutdown, once
+     * the flushers have stopped.
+     */
+    void writeHashTableImages();
+
+    /**
+     * Persist the bloom filter of each fully persisted vBucket for the next
+     * warmup to restore. Called on a clean shutdown, once the flushers have
+     * stopped.
+     */
+    void persistBloomFilters();
+
+    /**
+     * Tell the vBucket's checkpoint manager and persistence waiters that its
+     * flushed items are now persisted.
+     */
+    void notifyItemsPersisted(VBucket& vb);
+
     std::unique_ptr<PersistenceCallback> flushOneDelOrSet(const queued_item& qi,
                                                           VBucketPtr& vb);
 
@@ -170,14 +234,37 @@ protected:
     void updateCompactionTasks(Vbid db_file_id);
 
     /**
-     * Max number of backill items in a single flusher batch before we split
-     * into multiple batches.
+     * Wake the most fragmented held back compactions until the concurrency
+     * limit is reached (or all of them if there's no limit).
+     * compactionLock must be held.
      */
-    size_t flusherBatchSplitTrigger;
+    void wakeParkedCompactions(size_t maxConcurrent);
+
+    /// @returns the fraction of the vBucket's data file which is unused.
+    double getFragmentation(Vbid vbid);
+
+    /// Wait as long as the copying of the given amount of data by a
+    /// compaction should be delayed by the compactionThrottle.
+    void throttleCompaction(size_t bytes);
+
+    /**
+     * Decides the max number of backill items in a single flusher batch
+     * before we split into multiple batches - flusher_batch_split_trigger,
+     * or less if adapting to commit latency.
+     */
+    FlushBatchController flushBatchController;
+
+    /// Max number of vBucket flushes grouped into one sync to disk.
+    std::atomic<size_t> flusherGroupCommitSize;
 
     /**
      * Indicates whether erroneous tombstones need to retained or not during
      * compaction
      */
     Couchbase::RelaxedAtomic<bool> retainErroneousTombstones;
+
+    /// Max number of compactions running at once; 0 for no limit.
+    std::atomic<size_t> compactionMaxConcurrency;
+
+    CompactionThrottle compactionThrottle;
 };
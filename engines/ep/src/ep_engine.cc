@@ -41,6 +41,7 @@
 #include "stats-info.h"
 #include "statwriter.h"
 #include "string_utils.h"
+#include "taskqueue.h"
 #include "vb_count_visitor.h"
 #include "warmup.h"
 
@@ -150,8 +151,13 @@ static void checkNumeric(const char* str) {
 
 void EventuallyPersistentEngine::destroy(const bool force) {
     auto eng = acquireEngine(this);
+    const auto arena = stats.getMemoryArena();
+    auto* hooks = serverApi->alloc_hooks;
     eng->destroyInner(force);
     delete eng.get();
+    if (arena) {
+        hooks->release_arena(arena);
+    }
 }
 
 cb::EngineErrorItemPair EventuallyPersistentEngine::allocate(
@@ -259,6 +265,33 @@ cb::EngineErrorItemPair EventuallyPersistentEngine::get(
     return cb::makeEngineErrorItemPair(cb::engine_errc(ret), itm, this);
 }
 
+std::vector<cb::EngineErrorItemPair> EventuallyPersistentEngine::get_multi(
+        gsl::not_null<const void*> cookie,
+        const std::vector<std::pair<DocKey, Vbid>>& keys,
+        DocStateFilter documentStateFilter) {
+    // As get(), but without QUEUE_BG_FETCH - get_multi() must never block,
+    // non-resident items are instead fetched by the frontend via get().
+    get_options_t options = static_cast<get_options_t>(HONOR_STATES |
+                                                       TRACK_REFERENCE |
+                                                       DELETE_TEMP |
+                                                       HIDE_LOCKED_CAS |
+                                                       TRACK_STATISTICS);
+
+    switch (documentStateFilter) {
+    case DocStateFilter::Alive:
+        break;
+    case DocStateFilter::Deleted:
+        // Not supported by get(); use the default implementation so every
+        // key falls back to get() and reports the error from there.
+        return EngineIface::get_multi(cookie, keys, documentStateFilter);
+    case DocStateFilter::AliveOrDeleted:
+        options = static_cast<get_options_t>(options | GET_DELETED_VALUE);
+        break;
+    }
+
+    return acquireEngine(this)->getMultiInner(cookie, keys, options);
+}
+
 cb::EngineErrorItemPair EventuallyPersistentEngine::get_if(
         gsl::not_null<const void*> cookie,
         const DocKey& key,
@@ -344,6 +377,15 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::store_if(
             cookie, item, cas, operation, predicate);
 }
 
+cb::EngineErrorCasPair EventuallyPersistentEngine::mutate_in_place(
+        gsl::not_null<const void*> cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        cb::DocumentMutator mutator) {
+    return acquireEngine(this)->mutateInPlaceInner(
+            cookie, key, vbucket, std::move(mutator));
+}
+
 void EventuallyPersistentEngine::reset_stats(
         gsl::not_null<const void*> cookie) {
     acquireEngine(this)->resetStats();
@@ -361,6 +403,13 @@ cb::mcbp::Status EventuallyPersistentEngine::setReplicationParam(
             getConfiguration().setReplicationThrottleQueueCap(std::stoll(val));
         } else if (key == "replication_throttle_cap_pcnt") {
             getConfiguration().setReplicationThrottleCapPcnt(std::stoull(val));
+        } else if (key == "replication_throttle_rate_shaping") {
+            getConfiguration().setReplicationThrottleRateShaping(cb_stob(val));
+        } else if (key == "replication_throttle_min_rate") {
+            getConfiguration().setReplicationThrottleMinRate(std::stoull(val));
+        } else if (key == "replication_throttle_shaping_band_pcnt") {
+            getConfiguration().setReplicationThrottleShapingBandPcnt(
+                    std::stoull(val));
         } else {
             msg = "Unknown config param";
             rv = cb::mcbp::Status::KeyEnoent;
@@ -402,6 +451,10 @@ cb::mcbp::Status EventuallyPersistentEngine::setCheckpointParam(
             validate(v, size_t(MIN_CHECKPOINT_PERIOD),
                      size_t(MAX_CHECKPOINT_PERIOD));
             getConfiguration().setChkPeriod(v);
+        } else if (key == "chk_max_vb_memory") {
+            getConfiguration().setChkMaxVbMemory(std::stoull(val));
+        } else if (key == "chk_max_bucket_memory") {
+            getConfiguration().setChkMaxBucketMemory(std::stoull(val));
         } else if (key == "max_checkpoints") {
             size_t v = std::stoull(val);
             validate(v, size_t(DEFAULT_MAX_CHECKPOINTS),
@@ -499,6 +552,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
                     delete tmp;
                 }
             }
+        } else if (key == "executor_weight") {
+            getConfiguration().setExecutorWeight(std::stoull(val));
         } else if (key == "exp_pager_enabled") {
             getConfiguration().setExpPagerEnabled(cb_stob(val));
         } else if (key == "exp_pager_stime") {
@@ -514,24 +569,50 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
         } else if (key == "alog_task_time") {
             getConfiguration().requirementsMetOrThrow("alog_task_time");
             getConfiguration().setAlogTaskTime(std::stoull(val));
+        } else if (key == "alog_incremental") {
+            getConfiguration().requirementsMetOrThrow("alog_incremental");
+            getConfiguration().setAlogIncremental(cb_stob(val));
             /* Start of ItemPager parameters */
         } else if (key == "pager_active_vb_pcnt") {
             getConfiguration().setPagerActiveVbPcnt(std::stoull(val));
         } else if (key == "pager_sleep_time_ms") {
             getConfiguration().setPagerSleepTimeMs(std::stoull(val));
+        } else if (key == "pager_visitor_tasks") {
+            getConfiguration().setPagerVisitorTasks(std::stoull(val));
+        } else if (key == "task_profile_slow_runs") {
+            getConfiguration().setTaskProfileSlowRuns(std::stoull(val));
+        } else if (key == "lock_profile_sample_rate") {
+            getConfiguration().setLockProfileSampleRate(std::stoull(val));
         } else if (key == "ht_eviction_policy") {
             getConfiguration().setHtEvictionPolicy(val);
+        } else if (key == "ht_resize_mode") {
+            getConfiguration().setHtResizeMode(val);
+        } else if (key == "ht_resize_step_size") {
+            getConfiguration().setHtResizeStepSize(std::stoull(val));
         } else if (key == "item_eviction_age_percentage") {
             getConfiguration().setItemEvictionAgePercentage(std::stoull(val));
+        } else if (key == "item_eviction_collection_quota_percentage") {
+            getConfiguration().setItemEvictionCollectionQuotaPercentage(
+                    std::stoull(val));
+        } else if (key == "item_eviction_compress_values") {
+            getConfiguration().setItemEvictionCompressValues(cb_stob(val));
         } else if (key == "item_eviction_freq_counter_age_threshold") {
             getConfiguration().setItemEvictionFreqCounterAgeThreshold(
                     std::stoull(val));
+        } else if (key == "item_eviction_sample_size") {
+            getConfiguration().setItemEvictionSampleSize(std::stoull(val));
         } else if (key == "item_freq_decayer_chunk_duration") {
             getConfiguration().setItemFreqDecayerChunkDuration(
                     std::stoull(val));
+        } else if (key == "item_freq_decayer_lazy") {
+            getConfiguration().setItemFreqDecayerLazy(cb_stob(val));
         } else if (key == "item_freq_decayer_percent") {
             getConfiguration().setItemFreqDecayerPercent(std::stoull(val));
             /* End of ItemPager parameters */
+        } else if (key == "warmup_hashtable_image") {
+            getConfiguration().setWarmupHashtableImage(cb_stob(val));
+        } else if (key == "warmup_hashtable_image_values") {
+            getConfiguration().setWarmupHashtableImageValues(cb_stob(val));
         } else if (key == "warmup_min_memory_threshold") {
             getConfiguration().setWarmupMinMemoryThreshold(std::stoull(val));
         } else if (key == "warmup_min_items_threshold") {
@@ -544,6 +625,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             size_t value = std::stoull(val);
             getConfiguration().setNumWriterThreads(value);
             ExecutorPool::get()->setNumWriters(value);
+        } else if (key == "workload_adaptive") {
+            getConfiguration().setWorkloadAdaptive(cb_stob(val));
         } else if (key == "num_auxio_threads") {
             size_t value = std::stoull(val);
             getConfiguration().setNumAuxioThreads(value);
@@ -552,8 +635,12 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             size_t value = std::stoull(val);
             getConfiguration().setNumNonioThreads(value);
             ExecutorPool::get()->setNumNonIO(value);
+        } else if (key == "bfilter_blocked") {
+            getConfiguration().setBfilterBlocked(cb_stob(val));
         } else if (key == "bfilter_enabled") {
             getConfiguration().setBfilterEnabled(cb_stob(val));
+        } else if (key == "bfilter_persist") {
+            getConfiguration().setBfilterPersist(cb_stob(val));
         } else if (key == "bfilter_residency_threshold") {
             getConfiguration().setBfilterResidencyThreshold(std::stof(val));
         } else if (key == "defragmenter_enabled") {
@@ -573,10 +660,32 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setDefragmenterAgeThreshold(std::stoull(val));
         } else if (key == "defragmenter_chunk_duration") {
             getConfiguration().setDefragmenterChunkDuration(std::stoull(val));
+        } else if (key == "defragmenter_max_extent_utilization") {
+            getConfiguration().setDefragmenterMaxExtentUtilization(
+                    std::stof(val));
+        } else if (key == "defragmenter_auto_interval") {
+            getConfiguration().setDefragmenterAutoInterval(cb_stob(val));
+        } else if (key == "defragmenter_auto_min_interval") {
+            getConfiguration().setDefragmenterAutoMinInterval(std::stof(val));
+        } else if (key == "defragmenter_auto_lower_threshold") {
+            getConfiguration().setDefragmenterAutoLowerThreshold(
+                    std::stof(val));
+        } else if (key == "defragmenter_auto_upper_threshold") {
+            getConfiguration().setDefragmenterAutoUpperThreshold(
+                    std::stof(val));
+        } else if (key == "defragmenter_stored_value_enabled") {
+            getConfiguration().setDefragmenterStoredValueEnabled(cb_stob(val));
         } else if (key == "defragmenter_run") {
             runDefragmenterTask();
         } else if (key == "compaction_write_queue_cap") {
             getConfiguration().setCompactionWriteQueueCap(std::stoull(val));
+        } else if (key == "compaction_max_concurrent_vbuckets") {
+            getConfiguration().setCompactionMaxConcurrentVbuckets(
+                    std::stoull(val));
+        } else if (key == "compaction_io_rate_limit") {
+            getConfiguration().setCompactionIoRateLimit(std::stoull(val));
+        } else if (key == "compaction_backoff_bg_wait") {
+            getConfiguration().setCompactionBackoffBgWait(std::stoull(val));
         } else if (key == "dcp_min_compression_ratio") {
             getConfiguration().setDcpMinCompressionRatio(std::stof(val));
         } else if (key == "dcp_noop_mandatory_for_v5_features") {
@@ -585,11 +694,18 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             if (!(runAccessScannerTask())) {
                 rv = cb::mcbp::Status::Etmpfail;
             }
+        } else if (key == "vbucket_deletion_chunk_size") {
+            getConfiguration().setVbucketDeletionChunkSize(std::stoull(val));
         } else if (key == "vb_state_persist_run") {
             runVbStatePersistTask(Vbid(std::stoi(val)));
         } else if (key == "ephemeral_full_policy") {
             getConfiguration().requirementsMetOrThrow("ephemeral_full_policy");
             getConfiguration().setEphemeralFullPolicy(val);
+        } else if (key == "ephemeral_auto_delete_sample_size") {
+            getConfiguration().requirementsMetOrThrow(
+                    "ephemeral_auto_delete_sample_size");
+            getConfiguration().setEphemeralAutoDeleteSampleSize(
+                    std::stoull(val));
         } else if (key == "ephemeral_metadata_purge_age") {
             getConfiguration().requirementsMetOrThrow(
                     "ephemeral_metadata_purge_age");
@@ -598,13 +714,22 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().requirementsMetOrThrow("ephemeral_metadata_purge_interval");
             getConfiguration().setEphemeralMetadataPurgeInterval(
                     std::stoull(val));
+        } else if (key == "ephemeral_metadata_purge_stale_threshold") {
+            getConfiguration().requirementsMetOrThrow(
+                    "ephemeral_metadata_purge_stale_threshold");
+            getConfiguration().setEphemeralMetadataPurgeStaleThreshold(
+                    std::stof(val));
         } else if (key == "fsync_after_every_n_bytes_written") {
             getConfiguration().setFsyncAfterEveryNBytesWritten(
                     std::stoull(val));
+        } else if (key == "get_keys_byte_limit") {
+            getConfiguration().setGetKeysByteLimit(std::stoull(val));
         } else if (key == "xattr_enabled") {
             getConfiguration().setXattrEnabled(cb_stob(val));
         } else if (key == "compression_mode") {
             getConfiguration().setCompressionMode(val);
+        } else if (key == "replica_value_policy") {
+            getConfiguration().setReplicaValuePolicy(val);
         } else if (key == "min_compression_ratio") {
             float min_comp_ratio;
             if (safe_strtof(val.c_str(), min_comp_ratio)) {
@@ -666,6 +791,36 @@ cb::mcbp::Status EventuallyPersistentEngine::setDcpParam(const std::string& key,
             validate(v, size_t(1), std::numeric_limits<size_t>::max());
             getConfiguration().setDcpConsumerProcessBufferedMessagesBatchSize(
                     v);
+        } else if (key == "dcp_consumer_processor_tasks") {
+            size_t v = size_t(std::stoul(val));
+            checkNumeric(val.c_str());
+            validate(v, size_t(1), size_t(16));
+            getConfiguration().setDcpConsumerProcessorTasks(v);
+        } else if (key == "dcp_backfill_shared_scans") {
+            getConfiguration().setDcpBackfillSharedScans(cb_stob(val));
+        } else if (key == "dcp_producer_ready_queue_quantum") {
+            size_t v = size_t(std::stoul(val));
+            checkNumeric(val.c_str());
+            getConfiguration().setDcpProducerReadyQueueQuantum(v);
+        } else if (key == "dcp_step_batch_size") {
+            size_t v = size_t(std::stoul(val));
+            checkNumeric(val.c_str());
+            validate(v, size_t(1), size_t(100000));
+            getConfiguration().setDcpStepBatchSize(v);
+        } else if (key == "dcp_seqno_ack_batch_size") {
+            size_t v = size_t(std::stoul(val));
+            checkNumeric(val.c_str());
+            validate(v, size_t(1), size_t(100000));
+            getConfiguration().setDcpSeqnoAckBatchSize(v);
+        } else if (key == "dcp_seqno_ack_max_delay_us") {
+            size_t v = size_t(std::stoul(val));
+            checkNumeric(val.c_str());
+            getConfiguration().setDcpSeqnoAckMaxDelayUs(v);
+        } else if (key == "dcp_conn_notifier_coalesce_us") {
+            size_t v = size_t(std::stoul(val));
+            checkNumeric(val.c_str());
+            validate(v, size_t(0), size_t(1000000));
+            getConfiguration().setDcpConnNotifierCoalesceUs(v);
         } else if (key == "dcp_idle_timeout") {
             size_t v = size_t(std::stoul(val));
             checkNumeric(val.c_str());
@@ -1115,6 +1270,8 @@ static ENGINE_ERROR_CODE processUnknownCommand(EventuallyPersistentEngine* h,
     case cb::mcbp::ClientOpcode::DelWithMeta:
     case cb::mcbp::ClientOpcode::DelqWithMeta:
         return h->deleteWithMeta(cookie, request, response);
+    case cb::mcbp::ClientOpcode::WithMetaBatch:
+        return h->withMetaBatch(cookie, request, response);
     case cb::mcbp::ClientOpcode::ReturnMeta:
         return h->returnMeta(cookie, request, response);
     case cb::mcbp::ClientOpcode::GetReplica:
@@ -1131,7 +1288,7 @@ static ENGINE_ERROR_CODE processUnknownCommand(EventuallyPersistentEngine* h,
         return rv;
     }
     case cb::mcbp::ClientOpcode::GetRandomKey:
-        return h->getRandomKey(cookie, response);
+        return h->getRandomKey(cookie, request, response);
     case cb::mcbp::ClientOpcode::GetKeys:
         return h->getAllKeys(cookie, request, response);
         // MB-21143: Remove adjusted time/drift API, but return NOT_SUPPORTED
@@ -1649,7 +1806,8 @@ ENGINE_ERROR_CODE create_instance(GET_SERVER_API get_server_api,
     BucketLogger::setLoggerAPI(api->log);
 
     MemoryTracker::getInstance(*api->alloc_hooks);
-    ObjectRegistry::initialize(api->alloc_hooks->get_allocation_size);
+    ObjectRegistry::initialize(api->alloc_hooks->get_allocation_size,
+                               api->alloc_hooks->set_thread_arena);
 
     std::atomic<size_t>* inital_tracking = new std::atomic<size_t>();
 
@@ -1881,6 +2039,8 @@ public:
             engine.setMaxItemSize(value);
         } else if (key.compare("max_item_privileged_bytes") == 0) {
             engine.setMaxItemPrivilegedBytes(value);
+        } else if (key == "executor_weight") {
+            engine.getTaskable().setWorkloadWeight(value);
         }
     }
 
@@ -1894,6 +2054,10 @@ public:
     virtual void floatValueChanged(const std::string& key, float value) {
         if (key == "min_compression_ratio") {
             engine.setMinCompressionRatio(value);
+            // What compresses well enough has changed; relearn it.
+            if (engine.getKVBucket()) {
+                engine.getKVBucket()->getCompressibility().reset();
+            }
         }
     }
 
@@ -1916,6 +2080,22 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
 
     name = configuration.getCouchBucket();
 
+    if (configuration.isArenaMemoryAccounting()) {
+        auto* hooks = serverApi->alloc_hooks;
+        unsigned arena = 0;
+        if (hooks->create_arena(&arena)) {
+            stats.setMemoryArena(arena, hooks->get_arena_allocated);
+            // Re-bind this thread, now the engine has its arena.
+            ObjectRegistry::onSwitchThread(this);
+            EP_LOG_INFO("EPEngine::initialize: allocating from arena {}",
+                        arena);
+        } else {
+            EP_LOG_WARN(
+                    "EPEngine::initialize: arena_memory_accounting is set "
+                    "but the allocator doesn't support arenas");
+        }
+    }
+
     if (config != nullptr) {
         EP_LOG_INFO(R"(EPEngine::initialize: using configuration:"{}")",
                     config);
@@ -1964,6 +2144,11 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
             "getl_max_timeout",
             std::make_unique<EpEngineValueChangeListener>(*this));
 
+    taskable.setWorkloadWeight(configuration.getExecutorWeight());
+    configuration.addValueChangedListener(
+            "executor_weight",
+            std::make_unique<EpEngineValueChangeListener>(*this));
+
     workload = new WorkLoadPolicy(configuration.getMaxNumWorkers(),
                                   configuration.getMaxNumShards());
     if ((unsigned int)workload->getNumShards() >
@@ -1988,6 +2173,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
     } else if (!flowCtlPolicy.compare("aggressive")) {
         dcpFlowControlManager_ =
                 std::make_unique<DcpFlowControlManagerAggressive>(*this);
+    } else if (!flowCtlPolicy.compare("adaptive")) {
+        dcpFlowControlManager_ =
+                std::make_unique<DcpFlowControlManagerAdaptive>(*this);
     } else {
         /* Flow control is not enabled */
         dcpFlowControlManager_ = std::make_unique<DcpFlowControlManager>(*this);
@@ -2153,6 +2341,34 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::get(const void* cookie,
     return ret;
 }
 
+std::vector<cb::EngineErrorItemPair> EventuallyPersistentEngine::getMultiInner(
+        const void* cookie,
+        const std::vector<std::pair<DocKey, Vbid>>& keys,
+        get_options_t options) {
+    std::vector<cb::EngineErrorItemPair> result;
+    result.reserve(keys.size());
+
+    auto values = kvBucket->getMulti(keys, cookie, options);
+    for (auto& gv : values) {
+        const auto ret = gv.getStatus();
+        if (ret == ENGINE_SUCCESS) {
+            if (options & TRACK_STATISTICS) {
+                ++stats.numOpsGet;
+            }
+            result.push_back(cb::makeEngineErrorItemPair(
+                    cb::engine_errc::success, gv.item.release(), this));
+        } else if (ret == ENGINE_KEY_ENOENT && isDegradedMode()) {
+            // Let get() report the tmpfail.
+            result.push_back(
+                    cb::makeEngineErrorItemPair(cb::engine_errc::would_block));
+        } else {
+            result.push_back(
+                    cb::makeEngineErrorItemPair(cb::engine_errc(ret)));
+        }
+    }
+    return result;
+}
+
 cb::EngineErrorItemPair EventuallyPersistentEngine::getAndTouchInner(
         const void* cookie, const DocKey& key, Vbid vbucket, uint32_t exptime) {
     auto* handle = reinterpret_cast<EngineIface*>(this);
@@ -2239,7 +2455,7 @@ cb::EngineErrorItemPair EventuallyPersistentEngine::getIfInner(
             return cb::makeEngineErrorItemPair(cb::engine_errc(status));
         }
 
-        const VBucketPtr vb = getKVBucket()->getVBucket(vbucket);
+        const auto vb = getKVBucket()->getVBucketForRead(vbucket);
         uint64_t vb_uuid = 0;
         int64_t hlcEpoch = HlcCasSeqnoUninitialised;
         if (vb) {
@@ -2375,6 +2591,36 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::storeIfInner(
     return {cb::engine_errc(status), item.getCas()};
 }
 
+cb::EngineErrorCasPair EventuallyPersistentEngine::mutateInPlaceInner(
+        const void* cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        cb::DocumentMutator mutator) {
+    ScopeTimer2<MicrosecondStopwatch, TracerStopwatch> timer(
+            MicrosecondStopwatch(stats.storeCmdHisto),
+            TracerStopwatch(cookie, cb::tracing::TraceCode::STORE));
+
+    if (isDegradedMode()) {
+        return {cb::engine_errc::temporary_failure, 0};
+    }
+
+    uint64_t cas = 0;
+    auto status = kvBucket->mutateInPlace(key, vbucket, cookie, mutator, cas);
+    switch (status) {
+    case ENGINE_SUCCESS:
+        ++stats.numOpsStore;
+        kvBucket->checkAndMaybeFreeMemory();
+        break;
+    case ENGINE_ENOMEM:
+        status = memoryCondition();
+        break;
+    default:
+        break;
+    }
+
+    return {cb::engine_errc(status), cas};
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::storeInner(
         const void* cookie,
         item* itm,
@@ -2459,6 +2705,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                     epstats.totalDeduplicated,
                     add_stat,
                     cookie);
+    add_casted_stat("ep_total_deduplicated_flusher",
+                    epstats.totalDeduplicatedFlusher,
+                    add_stat,
+                    cookie);
     add_casted_stat("ep_expired_access", epstats.expired_access,
                     add_stat, cookie);
     add_casted_stat("ep_expired_compactor", epstats.expired_compactor,
@@ -2473,6 +2723,14 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                     epstats.vbBackfillQueueSize,
                     add_stat,
                     cookie);
+    add_casted_stat("ep_replication_throttle_rate",
+                    getReplicationThrottle().getRate(),
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_replication_throttle_drain_rate",
+                    getReplicationThrottle().getDrainRate(),
+                    add_stat,
+                    cookie);
     auto* flusher = kvBucket->getFlusher(EP_PRIMARY_SHARD);
     if (flusher) {
         add_casted_stat("ep_commit_num", epstats.flusherCommits,
@@ -2574,12 +2832,47 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
     add_casted_stat("ep_items_rm_from_checkpoints",
                     epstats.itemsRemovedFromCheckpoints,
                     add_stat, cookie);
+    add_casted_stat("ep_items_expelled_from_checkpoints",
+                    epstats.itemsExpelledFromCheckpoints,
+                    add_stat,
+                    cookie);
     add_casted_stat("ep_num_value_ejects", epstats.numValueEjects,
                     add_stat, cookie);
+    add_casted_stat("ep_num_pager_compressions",
+                    epstats.numPagerCompressions,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_num_value_tier_moves",
+                    epstats.numValueTierMoves,
+                    add_stat,
+                    cookie);
+    if (const auto* tier = kvBucket->getValueTier()) {
+        add_casted_stat("ep_value_tier_capacity",
+                        tier->getCapacity(),
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_value_tier_used", tier->getUsed(), add_stat, cookie);
+        add_casted_stat("ep_value_tier_values",
+                        tier->getNumAllocations(),
+                        add_stat,
+                        cookie);
+    }
+    add_casted_stat("ep_num_replica_persist_ejects",
+                    epstats.numReplicaPersistEjects,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_num_replica_persist_compressions",
+                    epstats.numReplicaPersistCompressions,
+                    add_stat,
+                    cookie);
     add_casted_stat("ep_num_eject_failures", epstats.numFailedEjects,
                     add_stat, cookie);
     add_casted_stat("ep_num_not_my_vbuckets", epstats.numNotMyVBuckets,
                     add_stat, cookie);
+    add_casted_stat("ep_num_get_value_copies",
+                    epstats.numGetValueCopies,
+                    add_stat,
+                    cookie);
 
     add_casted_stat("ep_pending_ops", epstats.pendingOps, add_stat, cookie);
     add_casted_stat("ep_pending_ops_total", epstats.pendingOpsTotal,
@@ -2595,6 +2888,18 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
     add_casted_stat("ep_rollback_count", epstats.rollbackCount,
                     add_stat, cookie);
 
+    add_casted_stat("ep_vbucket_del_mem_freed",
+                    epstats.vbucketDelMemFreed,
+                    add_stat,
+                    cookie);
+    const size_t vbDelMemTime = epstats.vbucketDelMemTime.load();
+    add_casted_stat("ep_vbucket_del_mem_freed_rate",
+                    vbDelMemTime == 0 ? 0
+                                      : epstats.vbucketDelMemFreed * 1000000 /
+                                                vbDelMemTime,
+                    add_stat,
+                    cookie);
+
     size_t vbDeletions = epstats.vbucketDeletions.load();
     if (vbDeletions > 0) {
         add_casted_stat("ep_vbucket_del_max_walltime",
@@ -2730,6 +3035,14 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                     add_stat, cookie);
     add_casted_stat("ep_defragmenter_num_moved", epstats.defragNumMoved,
                     add_stat, cookie);
+    add_casted_stat("ep_defragmenter_num_skipped_dense",
+                    epstats.defragNumSkippedDense,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_defragmenter_sv_num_moved",
+                    epstats.defragStoredValueNumMoved,
+                    add_stat,
+                    cookie);
 
     add_casted_stat("ep_item_compressor_num_visited",
                     epstats.compressorNumVisited,
@@ -2739,6 +3052,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                     epstats.compressorNumCompressed,
                     add_stat,
                     cookie);
+    add_casted_stat("ep_compressor_num_skipped",
+                    kvBucket->getCompressibility().getNumSkipped(),
+                    add_stat,
+                    cookie);
 
     add_casted_stat("ep_cursor_dropping_lower_threshold",
                     epstats.cursorDroppingLThreshold, add_stat, cookie);
@@ -2803,6 +3120,24 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                         cookie);
     }
 
+    if (kvBucket->getKVStoreStat(
+                "doc_cache_hits", value, KVBucketIface::KVSOption::BOTH)) {
+        add_casted_stat("ep_doc_cache_hits", value, add_stat, cookie);
+    }
+    if (kvBucket->getKVStoreStat(
+                "doc_cache_misses", value, KVBucketIface::KVSOption::BOTH)) {
+        add_casted_stat("ep_doc_cache_misses", value, add_stat, cookie);
+    }
+    if (kvBucket->getKVStoreStat("doc_cache_memory_used",
+                                 value,
+                                 KVBucketIface::KVSOption::BOTH)) {
+        add_casted_stat("ep_doc_cache_memory_used", value, add_stat, cookie);
+    }
+    if (kvBucket->getKVStoreStat(
+                "doc_cache_items", value, KVBucketIface::KVSOption::BOTH)) {
+        add_casted_stat("ep_doc_cache_items", value, add_stat, cookie);
+    }
+
     // Specific to RocksDB. Cumulative ep-engine stats.
     // Note: These are also reported per-shard in 'kvstore' stats.
     // Memory Usage
@@ -2934,6 +3269,13 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doMemoryStats(const void *cookie,
             "ep_value_size", stats.getTotalValueSize(), add_stat, cookie);
     add_casted_stat("ep_overhead", stats.getMemOverhead(), add_stat, cookie);
     add_casted_stat("ep_max_size", stats.getMaxDataSize(), add_stat, cookie);
+    if (configuration.isMemQuotaSharing()) {
+        add_casted_stat("ep_mem_quota_borrowed",
+                        int64_t(stats.getMaxDataSize()) -
+                                int64_t(configuration.getMaxSize()),
+                        add_stat,
+                        cookie);
+    }
     add_casted_stat("ep_mem_low_wat", stats.mem_low_wat, add_stat, cookie);
     add_casted_stat("ep_mem_low_wat_percent", stats.mem_low_wat_percent,
                     add_stat, cookie);
@@ -2974,6 +3316,63 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doMemoryStats(const void *cookie,
     return ENGINE_SUCCESS;
 }
 
+/**
+ * Attribute the bucket's memory to the structures holding it. Each figure
+ * comes from the structure's own accounting (there is no way of tagging an
+ * allocation at the allocator hooks and still attributing its free), so the
+ * sum is an estimate; "other" is what is left of mem_used.
+ */
+ENGINE_ERROR_CODE EventuallyPersistentEngine::doMemoryBreakdownStats(
+        const void* cookie, ADD_STAT add_stat) {
+    class MemoryVBucketVisitor : public VBucketVisitor {
+    public:
+        void visitBucket(VBucketPtr& vb) override {
+            hashTable += vb->ht.memorySize();
+            manifests += vb->lockCollections().getMemorySize();
+        }
+
+        size_t hashTable = 0;
+        size_t manifests = 0;
+    };
+
+    MemoryVBucketVisitor vbVisitor;
+    kvBucket->visit(vbVisitor);
+
+    ConnCounter dcp;
+    dcpConnMap_->each([&dcp](std::shared_ptr<ConnHandler> conn) {
+        conn->aggregateQueueStats(dcp);
+    });
+
+    const size_t memUsed = stats.getPreciseTotalMemoryUsed();
+    const size_t storedValues = stats.getStoredValSize();
+    const size_t blobs = stats.getTotalValueSize();
+    const size_t checkpoints = stats.getCheckpointMemory();
+    const size_t accounted = vbVisitor.hashTable + storedValues + blobs +
+                             checkpoints + dcp.conn_bufferedBytes +
+                             dcp.conn_backfillBytes + vbVisitor.manifests;
+
+    add_casted_stat("mem_used", memUsed, add_stat, cookie);
+    add_casted_stat(
+            "mem_hash_table", vbVisitor.hashTable, add_stat, cookie);
+    add_casted_stat("mem_stored_values", storedValues, add_stat, cookie);
+    add_casted_stat("mem_blobs", blobs, add_stat, cookie);
+    add_casted_stat("mem_checkpoints", checkpoints, add_stat, cookie);
+    add_casted_stat(
+            "mem_dcp_buffers", dcp.conn_bufferedBytes, add_stat, cookie);
+    add_casted_stat(
+            "mem_backfill_buffers", dcp.conn_backfillBytes, add_stat, cookie);
+    add_casted_stat("mem_collection_manifests",
+                    vbVisitor.manifests,
+                    add_stat,
+                    cookie);
+    add_casted_stat("mem_other",
+                    memUsed > accounted ? memUsed - accounted : 0,
+                    add_stat,
+                    cookie);
+
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::doVBucketStats(
                                                        const void *cookie,
                                                        ADD_STAT add_stat,
@@ -3663,6 +4062,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(const void *cookie,
     add_casted_stat("del_vb_cmd", stats.delVbucketCmdHisto, add_stat, cookie);
     add_casted_stat("chk_persistence_cmd", stats.chkPersistenceHisto,
                     add_stat, cookie);
+    add_casted_stat("seqno_persistence_cmd",
+                    stats.seqnoPersistenceHisto,
+                    add_stat,
+                    cookie);
     // Misc
     add_casted_stat("notify_io", stats.notifyIOHisto, add_stat, cookie);
     add_casted_stat("batch_read", stats.getMultiHisto, add_stat, cookie);
@@ -3792,6 +4195,41 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doWorkloadStats(const void
                          "ep_workload:num_sleepers");
         add_casted_stat(statname, numSleepers, add_stat, cookie);
 
+        checked_snprintf(statname,
+                         sizeof(statname),
+                         "ep_workload:adaptive_adjustments");
+        add_casted_stat(
+                statname, workload->getNumAdjustments(), add_stat, cookie);
+
+        checked_snprintf(statname,
+                         sizeof(statname),
+                         "ep_workload:adaptive_readers");
+        add_casted_stat(
+                statname, workload->getAdaptiveReaders(), add_stat, cookie);
+
+        checked_snprintf(statname,
+                         sizeof(statname),
+                         "ep_workload:adaptive_writers");
+        add_casted_stat(
+                statname, workload->getAdaptiveWriters(), add_stat, cookie);
+
+        checked_snprintf(statname, sizeof(statname), "ep_workload:weight");
+        add_casted_stat(
+                statname, taskable.getWorkloadWeight(), add_stat, cookie);
+
+        // This bucket's use of the shared executor threads.
+        for (size_t i = 0; i < NUM_TASK_GROUPS; i++) {
+            const auto type = task_type_t(i);
+            checked_snprintf(statname,
+                             sizeof(statname),
+                             "ep_workload:%s:runtime_us",
+                             TaskQueue::taskType2Str(type).c_str());
+            add_casted_stat(statname,
+                            taskable.getTotalRunTime(type) / 1000,
+                            add_stat,
+                            cookie);
+        }
+
         expool->doTaskQStat(ObjectRegistry::getCurrentEngine(),
                             cookie, add_stat);
 
@@ -3997,8 +4435,23 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
         rv = doSchedulerStats(cookie, add_stat);
     } else if (statKey == "runtimes") {
         rv = doRunTimeStats(cookie, add_stat);
+    } else if (statKey == "tasks-profile") {
+        if (kvBucket) {
+            kvBucket->getTaskProfile().addStats(cookie, add_stat);
+        }
+        rv = ENGINE_SUCCESS;
+    } else if (statKey == "durability-timings") {
+        if (kvBucket) {
+            kvBucket->getDurabilityTimings().addStats(cookie, add_stat);
+        }
+        rv = ENGINE_SUCCESS;
+    } else if (statKey == "locks") {
+        stats.lockProfiles.addStats(cookie, add_stat);
+        rv = ENGINE_SUCCESS;
     } else if (statKey == "memory") {
         rv = doMemoryStats(cookie, add_stat);
+    } else if (statKey == "memory-breakdown") {
+        rv = doMemoryBreakdownStats(cookie, add_stat);
     } else if (statKey == "uuid") {
         add_casted_stat("uuid", configuration.getUuid(), add_stat, cookie);
         rv = ENGINE_SUCCESS;
@@ -4052,6 +4505,12 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
             warmup->addStats(add_stat, cookie);
             rv = ENGINE_SUCCESS;
         }
+    } else if (statKey == "warmup-vbuckets") {
+        const auto* warmup = getKVBucket()->getWarmup();
+        if (warmup != nullptr) {
+            warmup->addVBucketStats(add_stat, cookie);
+            rv = ENGINE_SUCCESS;
+        }
 
     } else if (statKey == "info") {
         add_casted_stat("info", get_stats_info(), add_stat, cookie);
@@ -4078,6 +4537,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
         rv = doDcpVbTakeoverStats(cookie, add_stat, tStream, vbucketId);
     } else if (statKey == "workload") {
         return doWorkloadStats(cookie, add_stat);
+    } else if (statKey == "flusher") {
+        return kvBucket->getFlusherStats(cookie, add_stat);
     } else if (cb_isPrefix(statKey, "failovers")) {
         if (nkey == 9) {
             rv = doAllFailoverLogStats(cookie, add_stat);
@@ -4139,6 +4600,8 @@ void EventuallyPersistentEngine::resetStats() {
     stats.reset();
     if (kvBucket) {
         kvBucket->resetUnderlyingStats();
+        kvBucket->getTaskProfile().reset();
+        kvBucket->getDurabilityTimings().reset();
     }
 }
 
@@ -4637,40 +5100,6 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
         return ENGINE_TMPFAIL;
     }
 
-    const auto extras = request.getExtdata();
-
-    CheckConflicts checkConflicts = CheckConflicts::Yes;
-    PermittedVBStates permittedVBStates{vbucket_state_active};
-    GenerateCas generateCas = GenerateCas::No;
-    if (!decodeWithMetaOptions(
-                extras, generateCas, checkConflicts, permittedVBStates)) {
-        return ENGINE_EINVAL;
-    }
-
-    auto value = request.getValue();
-    cb::const_byte_buffer emd;
-    if (extras.size() == 26 || extras.size() == 30) {
-        // 26 = nmeta
-        // 30 = options and nmeta (options followed by nmeta)
-        // The extras is stored last, so copy out the two last bytes in
-        // the extras field and use them as nmeta
-        uint16_t nmeta;
-        memcpy(&nmeta, extras.end() - sizeof(nmeta), sizeof(nmeta));
-        nmeta = ntohs(nmeta);
-        // Correct the vallen
-        emd = {value.data() + value.size() - nmeta, nmeta};
-        value = {value.data(), value.size() - nmeta};
-    }
-
-    if (value.size() > maxItemSize) {
-        EP_LOG_WARN(
-                "Item value size {} for setWithMeta is bigger "
-                "than the max size {} allowed!!!",
-                value.size(),
-                maxItemSize);
-        return ENGINE_E2BIG;
-    }
-
     std::chrono::steady_clock::time_point startTime;
     {
         void* startTimeC = getEngineSpecific(cookie);
@@ -4688,40 +5117,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
     }
     TRACE_BEGIN(cookie, TraceCode::SETWITHMETA, startTime);
 
-    const auto opcode = request.getClientOpcode();
-    const bool allowExisting = (opcode == cb::mcbp::ClientOpcode::SetWithMeta ||
-                                opcode == cb::mcbp::ClientOpcode::SetqWithMeta);
-
-    const auto* payload =
-            reinterpret_cast<const cb::mcbp::request::SetWithMetaPayload*>(
-                    extras.data());
-
-    uint32_t flags = payload->getFlagsInNetworkByteOrder();
-    uint32_t expiration = payload->getExpiration();
-    uint64_t seqno = payload->getSeqno();
-    uint64_t cas = payload->getCas();
+    uint64_t cas = 0;
     uint64_t bySeqno = 0;
-    ENGINE_ERROR_CODE ret;
-    uint64_t commandCas = request.getCas();
-    try {
-        ret = setWithMeta(request.getVBucket(),
-                          makeDocKey(cookie, request.getKey()),
-                          value,
-                          {cas, seqno, flags, time_t(expiration)},
-                          false /*isDeleted*/,
-                          uint8_t(request.getDatatype()),
-                          commandCas,
-                          &bySeqno,
-                          cookie,
-                          permittedVBStates,
-                          checkConflicts,
-                          allowExisting,
-                          GenerateBySeqno::Yes,
-                          generateCas,
-                          emd);
-    } catch (const std::bad_alloc&) {
-        return ENGINE_ENOMEM;
-    }
+    const auto ret = applySetWithMeta(cookie, request, cas, bySeqno);
 
     if (ret == ENGINE_SUCCESS) {
         ++stats.numOpsSetMeta;
@@ -4730,8 +5128,6 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
         auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
                 endTime - startTime);
         stats.setWithMetaHisto.add(elapsed);
-
-        cas = commandCas;
     } else if (ret == ENGINE_ENOMEM) {
         return memoryCondition();
     } else if (ret == ENGINE_EWOULDBLOCK) {
@@ -4745,6 +5141,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
         return ret;
     }
 
+    const auto opcode = request.getClientOpcode();
     if (opcode == cb::mcbp::ClientOpcode::SetqWithMeta ||
         opcode == cb::mcbp::ClientOpcode::AddqWithMeta) {
         // quiet ops should not produce output
@@ -4762,6 +5159,79 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
     return sendErrorResponse(response, cb::mcbp::Status::Success, cas, cookie);
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::applySetWithMeta(
+        const void* cookie,
+        const cb::mcbp::Request& request,
+        uint64_t& cas,
+        uint64_t& bySeqno) {
+    const auto extras = request.getExtdata();
+
+    CheckConflicts checkConflicts = CheckConflicts::Yes;
+    PermittedVBStates permittedVBStates{vbucket_state_active};
+    GenerateCas generateCas = GenerateCas::No;
+    if (!decodeWithMetaOptions(
+                extras, generateCas, checkConflicts, permittedVBStates)) {
+        return ENGINE_EINVAL;
+    }
+
+    auto value = request.getValue();
+    cb::const_byte_buffer emd;
+    if (extras.size() == 26 || extras.size() == 30) {
+        // 26 = nmeta
+        // 30 = options and nmeta (options followed by nmeta)
+        // The extras is stored last, so copy out the two last bytes in
+        // the extras field and use them as nmeta
+        uint16_t nmeta;
+        memcpy(&nmeta, extras.end() - sizeof(nmeta), sizeof(nmeta));
+        nmeta = ntohs(nmeta);
+        // Correct the vallen
+        emd = {value.data() + value.size() - nmeta, nmeta};
+        value = {value.data(), value.size() - nmeta};
+    }
+
+    if (value.size() > maxItemSize) {
+        EP_LOG_WARN(
+                "Item value size {} for setWithMeta is bigger "
+                "than the max size {} allowed!!!",
+                value.size(),
+                maxItemSize);
+        return ENGINE_E2BIG;
+    }
+
+    const auto opcode = request.getClientOpcode();
+    const bool allowExisting = (opcode == cb::mcbp::ClientOpcode::SetWithMeta ||
+                                opcode == cb::mcbp::ClientOpcode::SetqWithMeta);
+
+    const auto* payload =
+            reinterpret_cast<const cb::mcbp::request::SetWithMetaPayload*>(
+                    extras.data());
+
+    uint32_t flags = payload->getFlagsInNetworkByteOrder();
+    uint32_t expiration = payload->getExpiration();
+    uint64_t seqno = payload->getSeqno();
+    uint64_t metacas = payload->getCas();
+    cas = request.getCas();
+    try {
+        return setWithMeta(request.getVBucket(),
+                           makeDocKey(cookie, request.getKey()),
+                           value,
+                           {metacas, seqno, flags, time_t(expiration)},
+                           false /*isDeleted*/,
+                           uint8_t(request.getDatatype()),
+                           cas,
+                           &bySeqno,
+                           cookie,
+                           permittedVBStates,
+                           checkConflicts,
+                           allowExisting,
+                           GenerateBySeqno::Yes,
+                           generateCas,
+                           emd);
+    } catch (const std::bad_alloc&) {
+        return ENGINE_ENOMEM;
+    }
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
         Vbid vbucket,
         DocKey key,
@@ -4855,6 +5325,39 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::deleteWithMeta(
         return ENGINE_TMPFAIL;
     }
 
+    uint64_t cas = 0;
+    uint64_t bySeqno = 0;
+    const auto ret = applyDeleteWithMeta(cookie, request, cas, bySeqno);
+
+    if (ret == ENGINE_SUCCESS) {
+        ++stats.numOpsDelMeta;
+    } else if (ret == ENGINE_ENOMEM) {
+        return memoryCondition();
+    } else {
+        return ret;
+    }
+
+    if (request.getClientOpcode() == cb::mcbp::ClientOpcode::DelqWithMeta) {
+        return ENGINE_SUCCESS;
+    }
+
+    if (isMutationExtrasSupported(cookie)) {
+        return sendMutationExtras(response,
+                                  request.getVBucket(),
+                                  bySeqno,
+                                  cb::mcbp::Status::Success,
+                                  cas,
+                                  cookie);
+    }
+
+    return sendErrorResponse(response, cb::mcbp::Status::Success, cas, cookie);
+}
+
+ENGINE_ERROR_CODE EventuallyPersistentEngine::applyDeleteWithMeta(
+        const void* cookie,
+        const cb::mcbp::Request& request,
+        uint64_t& cas,
+        uint64_t& bySeqno) {
     const auto extras = request.getExtdata();
 
     CheckConflicts checkConflicts = CheckConflicts::Yes;
@@ -4881,7 +5384,6 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::deleteWithMeta(
     }
 
     auto key = makeDocKey(cookie, request.getKey());
-    uint64_t bySeqno = 0;
 
     const auto* payload =
             reinterpret_cast<const cb::mcbp::request::DelWithMetaPayload*>(
@@ -4890,66 +5392,119 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::deleteWithMeta(
     const uint32_t delete_time = payload->getDeleteTime();
     const uint64_t seqno = payload->getSeqno();
     const uint64_t metacas = payload->getCas();
-    uint64_t cas = request.getCas();
-    ENGINE_ERROR_CODE ret;
+    cas = request.getCas();
     try {
         if (value.empty()) {
-            ret = deleteWithMeta(request.getVBucket(),
-                                 key,
-                                 {metacas, seqno, flags, time_t(delete_time)},
-                                 cas,
-                                 &bySeqno,
-                                 cookie,
-                                 permittedVBStates,
-                                 checkConflicts,
-                                 GenerateBySeqno::Yes,
-                                 generateCas,
-                                 emd,
-                                 DeleteSource::Explicit);
-        } else {
-            // A delete with a value
-            ret = setWithMeta(request.getVBucket(),
-                              key,
-                              value,
-                              {metacas, seqno, flags, time_t(delete_time)},
-                              true /*isDeleted*/,
-                              uint8_t(request.getDatatype()),
-                              cas,
-                              &bySeqno,
-                              cookie,
-                              permittedVBStates,
-                              checkConflicts,
-                              true /*allowExisting*/,
-                              GenerateBySeqno::Yes,
-                              generateCas,
-                              emd);
+            return deleteWithMeta(request.getVBucket(),
+                                  key,
+                                  {metacas, seqno, flags, time_t(delete_time)},
+                                  cas,
+                                  &bySeqno,
+                                  cookie,
+                                  permittedVBStates,
+                                  checkConflicts,
+                                  GenerateBySeqno::Yes,
+                                  generateCas,
+                                  emd,
+                                  DeleteSource::Explicit);
         }
+        // A delete with a value
+        return setWithMeta(request.getVBucket(),
+                           key,
+                           value,
+                           {metacas, seqno, flags, time_t(delete_time)},
+                           true /*isDeleted*/,
+                           uint8_t(request.getDatatype()),
+                           cas,
+                           &bySeqno,
+                           cookie,
+                           permittedVBStates,
+                           checkConflicts,
+                           true /*allowExisting*/,
+                           GenerateBySeqno::Yes,
+                           generateCas,
+                           emd);
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
+}
 
-    if (ret == ENGINE_SUCCESS) {
-        stats.numOpsDelMeta++;
-    } else if (ret == ENGINE_ENOMEM) {
-        return memoryCondition();
-    } else {
-        return ret;
+ENGINE_ERROR_CODE EventuallyPersistentEngine::withMetaBatch(
+        const void* cookie,
+        const cb::mcbp::Request& request,
+        ADD_RESPONSE response) {
+    if (isDegradedMode()) {
+        return ENGINE_TMPFAIL;
     }
 
-    if (request.getClientOpcode() == cb::mcbp::ClientOpcode::DelqWithMeta) {
-        return ENGINE_SUCCESS;
+    // The statuses of the mutations applied so far are kept in the engine
+    // specific while waiting for a mutation's background fetch; when the
+    // command is executed again it resumes from that mutation.
+    auto* statuses =
+            static_cast<std::vector<uint16_t>*>(getEngineSpecific(cookie));
+    if (statuses) {
+        storeEngineSpecific(cookie, nullptr);
+    } else {
+        statuses = new std::vector<uint16_t>();
     }
+    std::unique_ptr<std::vector<uint16_t>> guard(statuses);
 
-    if (isMutationExtrasSupported(cookie)) {
-        return sendMutationExtras(response,
-                                  request.getVBucket(),
-                                  bySeqno,
-                                  cb::mcbp::Status::Success,
-                                  cas,
-                                  cookie);
+    // The validator checked the value is a sequence of complete
+    // SET/ADD/DEL_WITH_META requests for this vbucket
+    auto value = request.getValue();
+    size_t index = 0;
+    while (!value.empty()) {
+        const auto& mutation =
+                *reinterpret_cast<const cb::mcbp::Request*>(value.data());
+        const size_t size = sizeof(cb::mcbp::Request) + mutation.getBodylen();
+        value = {value.data() + size, value.size() - size};
+        if (index++ < statuses->size()) {
+            // Already applied
+            continue;
+        }
+
+        uint64_t cas = 0;
+        uint64_t bySeqno = 0;
+        ENGINE_ERROR_CODE ret;
+        if (mutation.getClientOpcode() == cb::mcbp::ClientOpcode::DelWithMeta) {
+            ret = applyDeleteWithMeta(cookie, mutation, cas, bySeqno);
+            if (ret == ENGINE_SUCCESS) {
+                ++stats.numOpsDelMeta;
+            }
+        } else {
+            ret = applySetWithMeta(cookie, mutation, cas, bySeqno);
+            if (ret == ENGINE_SUCCESS) {
+                ++stats.numOpsSetMeta;
+            } else if (ret == ENGINE_EWOULDBLOCK) {
+                ++stats.numOpsGetMetaOnSetWithMeta;
+            }
+        }
+
+        if (ret == ENGINE_EWOULDBLOCK) {
+            storeEngineSpecific(cookie, guard.release());
+            return ret;
+        } else if (ret == ENGINE_NOT_MY_VBUCKET && statuses->empty()) {
+            // Nothing applied; fail the whole batch so the client gets
+            // the cluster map
+            return ret;
+        } else if (ret == ENGINE_ENOMEM) {
+            ret = memoryCondition();
+        }
+        const auto status = serverApi->cookie->engine_error2mcbp(cookie, ret);
+        statuses->push_back(htons(uint16_t(status)));
     }
 
-    return sendErrorResponse(response, cb::mcbp::Status::Success, cas, cookie);
+    return sendResponse(response,
+                        nullptr,
+                        0,
+                        nullptr,
+                        0,
+                        statuses->data(),
+                        statuses->size() * sizeof(uint16_t),
+                        PROTOCOL_BINARY_RAW_BYTES,
+                        cb::mcbp::Status::Success,
+                        0,
+                        cookie);
 }
 
 ENGINE_ERROR_CODE EventuallyPersistentEngine::deleteWithMeta(
@@ -5224,16 +5779,37 @@ EventuallyPersistentEngine::returnMeta(const void* cookie,
  *
  * This initially allocated buffersize is doubled whenever the length
  * of the buffer holding all the keys, crosses the buffersize.
+ *
+ * Only keys of the given collection are returned, and the keys are
+ * limited to maxBytes; once either is reached the callback sets its status
+ * so the scan stops.
  */
-class AllKeysCallback : public Callback<const DocKey&> {
+class AllKeysCallback : public StatusCallback<const DocKey&> {
 public:
-    AllKeysCallback(bool encodeCollectionID)
-        : encodeCollectionID(encodeCollectionID) {
+    AllKeysCallback(bool encodeCollectionID,
+                    CollectionID collection,
+                    size_t maxBytes)
+        : encodeCollectionID(encodeCollectionID),
+          collection(collection),
+          maxBytes(maxBytes) {
         buffer.reserve((avgKeySize + sizeof(uint16_t)) * expNumKeys);
     }
 
     void callback(const DocKey& key) {
         DocKey outKey = key;
+        if (key.getCollectionID() != collection) {
+            // Keys are in collection order, so there are no more keys of
+            // the collection being scanned.
+            setStatus(ENGINE_KEY_ENOENT);
+            return;
+        }
+        if (!buffer.empty() &&
+            buffer.size() + key.size() + sizeof(uint16_t) > maxBytes) {
+            // Out of budget; the client continues from the last key
+            setStatus(ENGINE_ENOMEM);
+            return;
+        }
+
         if (key.getCollectionID() == CollectionID::System) {
             // Skip system collection keys
             return;
@@ -5244,7 +5820,8 @@ public:
             outKey = key.makeDocKeyWithoutCollectionID();
         }
 
-        if (buffer.size() + outKey.size() + sizeof(uint16_t) > buffer.size()) {
+        if (buffer.size() + outKey.size() + sizeof(uint16_t) >
+            buffer.capacity()) {
             // Reserve the 2x space for the copy-to buffer.
             buffer.reserve(buffer.size()*2);
         }
@@ -5263,6 +5840,8 @@ public:
 private:
     std::vector<char> buffer;
     bool encodeCollectionID{false};
+    const CollectionID collection;
+    const size_t maxBytes;
     static const int avgKeySize = 32;
     static const int expNumKeys = 1000;
 
@@ -5321,7 +5900,10 @@ public:
                                0,
                                cookie);
         } else {
-            auto cb = std::make_shared<AllKeysCallback>(encodeCollectionID);
+            auto cb = std::make_shared<AllKeysCallback>(
+                    encodeCollectionID,
+                    start_key.getCollectionID(),
+                    engine->getConfiguration().getGetKeysByteLimit());
             err = engine->getKVBucket()->getROUnderlying(vbid)->getAllKeys(
                                                     vbid, start_key, count, cb);
             if (err == ENGINE_SUCCESS) {
@@ -5426,8 +6008,17 @@ void EventuallyPersistentEngine::notifyIOComplete(const void* cookie,
     }
 }
 
-ENGINE_ERROR_CODE EventuallyPersistentEngine::getRandomKey(const void *cookie,
-                                                       ADD_RESPONSE response) {
+ENGINE_ERROR_CODE EventuallyPersistentEngine::getRandomKey(
+        const void* cookie,
+        const cb::mcbp::Request& request,
+        ADD_RESPONSE response) {
+    auto extras = request.getExtdata();
+    if (!extras.empty()) {
+        const auto count =
+                ntohl(*reinterpret_cast<const uint32_t*>(extras.data()));
+        return getRandomKeys(cookie, count, response);
+    }
+
     GetValue gv(kvBucket->getRandomKey());
     ENGINE_ERROR_CODE ret = gv.getStatus();
 
@@ -5450,6 +6041,80 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getRandomKey(const void *cookie,
     return ret;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::getRandomKeys(
+        const void* cookie, uint32_t count, ADD_RESPONSE response) {
+    if (count == 0 || count > MaxRandomKeys) {
+        setErrorContext(cookie,
+                        "Number of keys must be between 1 and " +
+                                std::to_string(MaxRandomKeys));
+        return ENGINE_EINVAL;
+    }
+
+    auto values = kvBucket->getRandomKeys(count);
+    if (values.empty()) {
+        return ENGINE_KEY_ENOENT;
+    }
+
+    const bool snappy =
+            isDatatypeSupported(cookie, PROTOCOL_BINARY_DATATYPE_SNAPPY);
+    const size_t maxBytes = getMaxItemSize();
+
+    // Each document is encoded as:
+    //   keylen (2), datatype (1), flags (4), cas (8), valuelen (4),
+    //   key, value
+    // stopping (after at least one document) once the response would be
+    // larger than the max item size.
+    std::vector<char> body;
+    for (auto& gv : values) {
+        Item* it = gv.item.get();
+        if (!snappy && mcbp::datatype::is_snappy(it->getDataType()) &&
+            !it->decompressValue()) {
+            continue;
+        }
+
+        const auto& key = it->getKey();
+        const size_t length = sizeof(uint16_t) + sizeof(uint8_t) +
+                              sizeof(uint32_t) + sizeof(uint64_t) +
+                              sizeof(uint32_t) + key.size() + it->getNBytes();
+        if (!body.empty() && body.size() + length > maxBytes) {
+            break;
+        }
+
+        const uint16_t keylen = htons(key.size());
+        const uint8_t datatype = it->getDataType();
+        const uint32_t flags = it->getFlags();
+        const uint64_t cas = htonll(it->getCas());
+        const uint32_t valuelen = htonl(it->getNBytes());
+        auto append = [&body](const void* data, size_t size) {
+            const auto* ptr = static_cast<const char*>(data);
+            body.insert(body.end(), ptr, ptr + size);
+        };
+        append(&keylen, sizeof(keylen));
+        append(&datatype, sizeof(datatype));
+        append(&flags, sizeof(flags));
+        append(&cas, sizeof(cas));
+        append(&valuelen, sizeof(valuelen));
+        append(key.data(), key.size());
+        append(it->getData(), it->getNBytes());
+    }
+
+    if (body.empty()) {
+        return ENGINE_KEY_ENOENT;
+    }
+
+    return sendResponse(response,
+                        nullptr,
+                        0,
+                        nullptr,
+                        0,
+                        body.data(),
+                        body.size(),
+                        PROTOCOL_BINARY_RAW_BYTES,
+                        cb::mcbp::Status::Success,
+                        0,
+                        cookie);
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::dcpOpen(
         const void* cookie,
         uint32_t opaque,
@@ -5703,7 +6368,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::sendMutationExtras(
         cb::mcbp::Status status,
         uint64_t cas,
         const void* cookie) {
-    VBucketPtr vb = kvBucket->getVBucket(vbucket);
+    const auto vb = kvBucket->getVBucketForRead(vbucket);
     if (!vb) {
         return sendErrorResponse(
                 response, cb::mcbp::Status::NotMyVbucket, cas, cookie);
@@ -5813,8 +6478,17 @@ void EpEngineTaskable::logRunTime(
     myEngine->getKVBucket()->logRunTime(id, runTime);
 }
 
+void EpEngineTaskable::logSlowRun(
+        TaskId id,
+        const std::string& description,
+        const std::string& thread,
+        const std::chrono::steady_clock::duration runTime) {
+    myEngine->getKVBucket()->getTaskProfile().logSlowRun(
+            id, description, thread, runTime);
+}
+
 item_info EventuallyPersistentEngine::getItemInfo(const Item& item) {
-    VBucketPtr vb = getKVBucket()->getVBucket(item.getVBucketId());
+    const auto vb = getKVBucket()->getVBucketForRead(item.getVBucketId());
     uint64_t uuid = 0;
     int64_t hlcEpoch = HlcCasSeqnoUninitialised;
 
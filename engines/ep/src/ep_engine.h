@@ -22,6 +22,7 @@
 #include "configuration.h"
 #include "connhandler.h"
 #include "item.h"
+#include "item_pool.h"
 #include "stats.h"
 #include "storeddockey.h"
 #include "taskable.h"
@@ -88,6 +89,11 @@ public:
     void logRunTime(TaskId id,
                     const std::chrono::steady_clock::duration runTime);
 
+    void logSlowRun(TaskId id,
+                    const std::string& description,
+                    const std::string& thread,
+                    const std::chrono::steady_clock::duration runTime) override;
+
 private:
     EventuallyPersistentEngine* myEngine;
 };
@@ -132,6 +138,10 @@ public:
                                 const DocKey& key,
                                 Vbid vbucket,
                                 DocStateFilter documentStateFilter) override;
+    std::vector<cb::EngineErrorItemPair> get_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<std::pair<DocKey, Vbid>>& keys,
+            DocStateFilter documentStateFilter) override;
     cb::EngineErrorItemPair get_if(
             gsl::not_null<const void*> cookie,
             const DocKey& key,
@@ -175,6 +185,12 @@ public:
             boost::optional<cb::durability::Requirements> durability,
             DocumentState document_state) override;
 
+    cb::EngineErrorCasPair mutate_in_place(
+            gsl::not_null<const void*> cookie,
+            const DocKey& key,
+            Vbid vbucket,
+            cb::DocumentMutator mutator) override;
+
     // Need to explicilty import EngineIface::flush to avoid warning about
     // DCPIface::flush hiding it.
     using EngineIface::flush;
@@ -410,6 +426,16 @@ public:
                           Vbid vbucket,
                           get_options_t options);
 
+    /**
+     * Look up a batch of keys without blocking; see EngineIface::get_multi().
+     * Keys which cannot be returned immediately are reported as would_block,
+     * to be retried by the frontend via get().
+     */
+    std::vector<cb::EngineErrorItemPair> getMultiInner(
+            const void* cookie,
+            const std::vector<std::pair<DocKey, Vbid>>& keys,
+            get_options_t options);
+
     /**
      * Fetch an item only if the specified filter predicate returns true.
      *
@@ -469,6 +495,11 @@ public:
                                         ENGINE_STORE_OPERATION operation,
                                         cb::StoreIfPredicate predicate);
 
+    cb::EngineErrorCasPair mutateInPlaceInner(const void* cookie,
+                                              const DocKey& key,
+                                              Vbid vbucket,
+                                              cb::DocumentMutator mutator);
+
     ENGINE_ERROR_CODE dcpOpen(const void* cookie,
                               uint32_t opaque,
                               uint32_t seqno,
@@ -492,6 +523,15 @@ public:
                                      const cb::mcbp::Request& request,
                                      ADD_RESPONSE response);
 
+    /**
+     * Apply the SET/ADD/DEL_WITH_META requests packed into the value of
+     * request (all for its vbucket) one after another, and respond with
+     * the status of each of them (as a network order uint16_t).
+     */
+    ENGINE_ERROR_CODE withMetaBatch(const void* cookie,
+                                    const cb::mcbp::Request& request,
+                                    ADD_RESPONSE response);
+
     ENGINE_ERROR_CODE returnMeta(const void* cookie,
                                  const cb::mcbp::Request& req,
                                  ADD_RESPONSE response);
@@ -604,6 +644,10 @@ public:
         return stats;
     }
 
+    ItemPool& getItemPool() {
+        return itemPool;
+    }
+
     KVBucket* getKVBucket() {
         return kvBucket.get();
     }
@@ -682,9 +726,26 @@ public:
         workloadPriority = p;
     }
 
-    ENGINE_ERROR_CODE getRandomKey(const void *cookie,
+    /**
+     * Handle GET_RANDOM_KEY. With no extras a single random document is
+     * returned; otherwise the extras hold the number of documents wanted
+     * and they are returned by getRandomKeys().
+     */
+    ENGINE_ERROR_CODE getRandomKey(const void* cookie,
+                                   const cb::mcbp::Request& request,
                                    ADD_RESPONSE response);
 
+    /**
+     * Send up to count distinct random documents (from across the active
+     * vBuckets) packed into the value of a single response.
+     */
+    ENGINE_ERROR_CODE getRandomKeys(const void* cookie,
+                                    uint32_t count,
+                                    ADD_RESPONSE response);
+
+    /// Most documents a single GET_RANDOM_KEY may ask for
+    static const uint32_t MaxRandomKeys = 1000;
+
     void setCompressionMode(const std::string& compressModeStr);
 
     void setMinCompressionRatio(float minCompressRatio) {
@@ -813,6 +874,8 @@ protected:
 
     ENGINE_ERROR_CODE doEngineStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doMemoryStats(const void *cookie, ADD_STAT add_stat);
+    ENGINE_ERROR_CODE doMemoryBreakdownStats(const void* cookie,
+                                             ADD_STAT add_stat);
     ENGINE_ERROR_CODE doVBucketStats(const void *cookie, ADD_STAT add_stat,
                                      const char* stat_key,
                                      int nkey,
@@ -949,6 +1012,24 @@ protected:
             protocol_binary_datatype_t datatype,
             cb::const_char_buffer body);
 
+    /**
+     * Decode and apply a SET/ADD_WITH_META request, without responding to
+     * it.
+     *
+     * @param cas [out] CAS of the mutation
+     * @param bySeqno [out] seqno of the mutation
+     */
+    ENGINE_ERROR_CODE applySetWithMeta(const void* cookie,
+                                       const cb::mcbp::Request& request,
+                                       uint64_t& cas,
+                                       uint64_t& bySeqno);
+
+    /// As applySetWithMeta(), for a DEL_WITH_META request
+    ENGINE_ERROR_CODE applyDeleteWithMeta(const void* cookie,
+                                          const cb::mcbp::Request& request,
+                                          uint64_t& cas,
+                                          uint64_t& bySeqno);
+
     /**
      * Process the set_with_meta with the given buffers/values.
      *
@@ -1025,6 +1106,9 @@ protected:
     // Engine statistics. First concrete member as a number of other members
     // refer to it so needs to be constructed first (and destructed last).
     EPStats stats;
+    // Freed Items for reuse. Destructed after every member which may hold
+    // Items, but before the stats the pooled memory is accounted to.
+    ItemPool itemPool;
     std::unique_ptr<KVBucket> kvBucket;
     WorkLoadPolicy *workload;
     bucket_priority_t workloadPriority;
@@ -148,6 +148,16 @@ enum item_eviction_policy_t {
 
 std::ostream& operator<<(std::ostream&, const item_eviction_policy_t& policy);
 
+/**
+ * What is done with the value of a replica vBucket's item once it has been
+ * persisted (see replica_value_policy). The metadata always stays resident.
+ */
+enum class ReplicaValuePolicy : char {
+    Resident, // Keep the value in memory, as for an active vBucket
+    Compress, // Snappy-compress the value in memory
+    Eject // Eject the value
+};
+
 enum class TaskStatus {
     Reschedule, /* Reschedule for later */
     Complete, /* Complete in this run */
@@ -58,7 +58,10 @@ EPVBucket::EPVBucket(
               lastSnapEnd,
               std::move(table),
               flusherCb,
-              std::make_unique<StoredValueFactory>(st),
+              std::make_unique<StoredValueFactory>(
+                      st,
+                      static_cast<uint8_t>(config.getHtInlineValueSize()),
+                      config.isHtArenaAllocator()),
               std::move(newSeqnoCb),
               config,
               evictionPolicy,
@@ -103,7 +106,8 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
                     ht.unlocked_restoreMeta(hbl.getHTLock(), *fetchedValue, *v);
                 }
             } else if (status == ENGINE_KEY_ENOENT) {
-                if (v && v->isTempInitialItem()) {
+                if (v && v->isTempInitialItem() &&
+                    !cacheNonExistentKey(hbl, *v)) {
                     v->setNonExistent();
                 }
                 /* If ENGINE_KEY_ENOENT is the status from storage and the temp
@@ -154,7 +158,10 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
                                 "restoreValue()");
                     }
                 } else if (status == ENGINE_KEY_ENOENT) {
-                    v->setNonExistent();
+                    if (!(v->isTempInitialItem() &&
+                          cacheNonExistentKey(hbl, *v))) {
+                        v->setNonExistent();
+                    }
                     if (eviction == FULL_EVICTION) {
                         // For the full eviction, we should notify
                         // ENGINE_SUCCESS to the memcached worker thread,
@@ -184,12 +191,15 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
     const auto fetchEnd = std::chrono::steady_clock::now();
     updateBGStats(fetched_item.initTime, startTime, fetchEnd);
 
-    // Close the BG_WAIT span; and add a BG_LOAD span
+    // Close the BG_WAIT span; add a BG_LOAD span, and open the NOTIFY_IO
+    // span (closed by the front end thread when it resumes the request)
     if (fetched_item.cookie) {
         TRACE_END(fetched_item.cookie, cb::tracing::TraceCode::BG_WAIT, startTime);
         TRACE_BEGIN(
                   fetched_item.cookie, cb::tracing::TraceCode::BG_LOAD, startTime);
         TRACE_END(fetched_item.cookie, cb::tracing::TraceCode::BG_LOAD, fetchEnd);
+        TRACE_BEGIN(
+                fetched_item.cookie, cb::tracing::TraceCode::NOTIFY_IO, fetchEnd);
     }
 
     return status;
@@ -402,7 +412,7 @@ void EPVBucket::addStats(bool details, ADD_STAT add_stat, const void* c) {
         if (!isBucketCreation()) {
             try {
                 DBFileInfo fileInfo =
-                        shard->getRWUnderlying()->getDbFileInfo(getId());
+                        shard->getRWUnderlying(getId())->getDbFileInfo(getId());
                 spaceUsed = fileInfo.spaceUsed;
                 fileSize = fileInfo.fileSize;
             } catch (std::runtime_error& e) {
@@ -467,6 +477,11 @@ bool EPVBucket::eligibleToPageOut(const HashTable::HashBucketLock& lh,
     return v.eligibleForEviction(eviction);
 }
 
+StoredValue* EPVBucket::reallocateStoredValue(
+        const HashTable::HashBucketLock& lh, StoredValue& v) {
+    return ht.unlocked_reallocateStoredValue(lh, v).first;
+}
+
 void EPVBucket::queueBackfillItem(queued_item& qi,
                                   const GenerateBySeqno generateBySeqno) {
     LockHolder lh(backfill.mutex);
@@ -563,9 +578,9 @@ void EPVBucket::bgFetch(const DocKey& key,
     size_t bgfetch_size = queueBGFetchItem(
             key,
             std::make_unique<VBucketBGFetchItem>(cookie, isMeta),
-            getShard()->getBgFetcher());
+            getShard()->getBgFetcherForVBucket(getId()));
     if (getShard()) {
-        getShard()->getBgFetcher()->notifyBGEvent();
+        getShard()->getBgFetcherForVBucket(getId())->notifyBGEvent();
     }
     EP_LOG_DEBUG("Queued a background fetch, now at {}",
                  uint64_t(bgfetch_size));
@@ -633,7 +648,7 @@ GetValue EPVBucket::getInternalNonResident(const DocKey& key,
 void EPVBucket::setupDeferredDeletion(const void* cookie) {
     setDeferredDeletionCookie(cookie);
     deferredDeletionFileRevision.store(
-            getShard()->getRWUnderlying()->prepareToDelete(getId()));
+            getShard()->getRWUnderlying(getId())->prepareToDelete(getId()));
     setDeferredDeletion(true);
 }
 
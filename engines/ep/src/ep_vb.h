@@ -101,6 +101,9 @@ public:
     bool eligibleToPageOut(const HashTable::HashBucketLock& lh,
                            const StoredValue& v) const override;
 
+    StoredValue* reallocateStoredValue(const HashTable::HashBucketLock& lh,
+                                       StoredValue& v) override;
+
     bool areDeletedItemsAlwaysResident() const override;
 
     void addStats(bool details, ADD_STAT add_stat, const void* c) override;
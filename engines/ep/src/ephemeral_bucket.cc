@@ -238,6 +238,18 @@ void EphemeralBucket::disableTombstonePurgerTask() {
     ExecutorPool::get()->cancel(tombstonePurgerTask->getId());
 }
 
+size_t EphemeralBucket::getSeqListStaleMemory() const {
+    size_t staleBytes = 0;
+    for (size_t vbid = 0; vbid < vbMap.getSize(); ++vbid) {
+        auto vb = vbMap.getBucket(Vbid(vbid));
+        if (vb) {
+            staleBytes += dynamic_cast<EphemeralVBucket&>(*vb)
+                                  .getSeqListStaleBytes();
+        }
+    }
+    return staleBytes;
+}
+
 void EphemeralBucket::reconfigureForEphemeral(Configuration& config) {
     // Disable access scanner - we never create it anyway, but set to
     // disabled as to not mislead the user via stats.
@@ -48,6 +48,12 @@ public:
         return cb::mcbp::Status::NotSupported;
     }
 
+    /// Flusher stats not supported for Ephemeral buckets.
+    ENGINE_ERROR_CODE getFlusherStats(const void* cookie,
+                                      ADD_STAT add_stat) override {
+        return ENGINE_KEY_ENOENT;
+    }
+
     /// File stats not supported for Ephemeral buckets.
     ENGINE_ERROR_CODE getFileStats(const void* cookie,
                                    ADD_STAT add_stat) override {
@@ -115,6 +121,9 @@ public:
      */
     void disableTombstonePurgerTask();
 
+    /// @return memory used by the stale items of all vBuckets' sequenceLists
+    size_t getSeqListStaleMemory() const;
+
     virtual bool isGetAllKeysSupported() const override {
         return false;
     }
@@ -25,7 +25,6 @@
 #include "ephemeral_vb.h"
 #include "seqlist.h"
 
-#include <climits>
 
 EphemeralVBucket::HTTombstonePurger::HTTombstonePurger(rel_time_t purgeAge)
     : now(ep_current_time()), purgeAge(purgeAge), numPurgedItems(0) {
@@ -107,7 +106,7 @@ bool EphTombstoneHTCleaner::run() {
 
     // Prepare the underlying visitor.
     auto& visitor = getPurgerVisitor();
-    visitor.setDeadline(std::chrono::steady_clock::now() + getChunkDuration());
+    visitor.setDeadline(getWorkBudgetDeadline(getChunkDuration()));
     visitor.clearStats();
 
     // (re)start visiting.
@@ -140,6 +139,7 @@ bool EphTombstoneHTCleaner::run() {
             uint64_t(getSleepTime()));
 
     snooze(getSleepTime());
+    staleItemDeleterTask->requestPass();
     ExecutorPool::get()->wake(staleItemDeleterTaskId);
     return true;
 }
@@ -197,11 +197,13 @@ public:
         }
 
         /// The lambda function passed indicates if the "StaleItemDeleter"
-        /// should be paused. It can be called by the module(s) implementing the
-        /// purge at the desired granularity
+        /// should be paused. It is called for each batch of elements the
+        /// sequence list visits (not each element), so simply check the
+        /// deadline each time; that bounds how long the purge can overrun
+        /// its chunk by to a single batch.
         numItemsDeleted += vbucket->purgeStaleItems([this]() {
             shouldContinueVisiting =
-                    progressTracker.shouldContinueVisiting(numVisitedItems++);
+                    std::chrono::steady_clock::now() < deadline;
             return !(shouldContinueVisiting);
         });
         return shouldContinueVisiting;
@@ -212,12 +214,11 @@ public:
     }
 
     void setDeadline(std::chrono::steady_clock::time_point deadline) {
-        progressTracker.setDeadline(deadline);
+        this->deadline = deadline;
     }
 
     void clearStats() {
         numItemsDeleted = 0;
-        numVisitedItems = 0;
         shouldContinueVisiting = true;
     }
 
@@ -225,11 +226,9 @@ protected:
     /// Count of how many items have been deleted for all visited vBuckets.
     size_t numItemsDeleted = 0;
 
-    /// Estimates how far we have got, and when we should pause.
-    ProgressTracker progressTracker;
-
-    /// Count of how many items have been visited.
-    size_t numVisitedItems = 0;
+    /// Time point at which the visitor should pause visiting.
+    std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::time_point::max();
 
     /// Indicates if the VB visitor should continue visiting other vbuckets in
     /// the current run
@@ -238,7 +237,10 @@ protected:
 
 EphTombstoneStaleItemDeleter::EphTombstoneStaleItemDeleter(
         EventuallyPersistentEngine* e, EphemeralBucket& bucket)
-    : GlobalTask(e, TaskId::EphTombstoneStaleItemDeleter, INT_MAX, false),
+    : GlobalTask(e,
+                 TaskId::EphTombstoneStaleItemDeleter,
+                 StaleMemoryCheckInterval,
+                 false),
       bucket(bucket),
       bucketPosition(bucket.endPosition()) {
 }
@@ -248,6 +250,10 @@ bool EphTombstoneStaleItemDeleter::run() {
     // then resume from where we last were, otherwise create a new visitor
     // starting from the beginning.
     if (bucketPosition == bucket.endPosition()) {
+        if (!shouldStartPass()) {
+            snooze(StaleMemoryCheckInterval);
+            return true;
+        }
         staleItemDeleteVbVisitor =
                 std::make_unique<EphemeralVBucket::StaleItemDeleter>();
         bucketPosition = bucket.startPosition();
@@ -256,8 +262,8 @@ bool EphTombstoneStaleItemDeleter::run() {
     }
 
     // Create a StaleItemDeleter, and run across all VBuckets.
-    staleItemDeleteVbVisitor->setDeadline(std::chrono::steady_clock::now() +
-                                          getChunkDuration());
+    staleItemDeleteVbVisitor->setDeadline(
+            getWorkBudgetDeadline(getChunkDuration()));
     staleItemDeleteVbVisitor->clearStats();
 
     auto start = std::chrono::steady_clock::now();
@@ -283,9 +289,33 @@ bool EphTombstoneStaleItemDeleter::run() {
                  staleItemDeleteVbVisitor->getNumItemsDeleted(),
                  duration_ms.count());
 
-    // Completed a full pass, sleep forever - rely on the HTCleaner task to
-    // wake us.
-    snooze(INT_MAX);
+    // Completed a full pass. Sleep until the stale item memory is next
+    // checked (or the HTCleaner task wakes us).
+    snooze(StaleMemoryCheckInterval);
+    return true;
+}
+
+bool EphTombstoneStaleItemDeleter::shouldStartPass() {
+    if (passRequested.exchange(false)) {
+        return true;
+    }
+
+    const auto threshold = engine->getConfiguration()
+                                   .getEphemeralMetadataPurgeStaleThreshold();
+    if (threshold <= 0) {
+        return false;
+    }
+    const auto staleBytes = bucket.getSeqListStaleMemory();
+    const auto maxBytes =
+            double(threshold) * engine->getEpStats().getMaxDataSize();
+    if (staleBytes < maxBytes) {
+        return false;
+    }
+
+    EP_LOG_DEBUG("{} starting as stale items use {} bytes (threshold: {})",
+                 getDescription(),
+                 staleBytes,
+                 threshold);
     return true;
 }
 
@@ -296,9 +326,9 @@ std::string EphTombstoneStaleItemDeleter::getDescription() {
 std::chrono::microseconds EphTombstoneStaleItemDeleter::maxExpectedDuration() {
     // Stale item deleter purges tombstone items in chunks, with each chunk
     // constrained by a ChunkDuration runtime, so we expect to only take that
-    // long. However, the ProgressTracker used estimates the time remaining, so
-    // apply some headroom to that figure so we don't get inundated with
-    // spurious "slow tasks" which only just exceed the limit.
+    // long. However, the deadline is only checked between batches of the
+    // sequence list, so apply some headroom to that figure so we don't get
+    // inundated with spurious "slow tasks" which only just exceed the limit.
     return getChunkDuration() * 10;
 }
 
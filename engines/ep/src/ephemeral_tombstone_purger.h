@@ -52,7 +52,9 @@
  *
  * 2. EphTombstoneStaleItemDeleter - iterate the SequenceList in order
  *    looking for stale OSVs. For such items unlink from the SequenceList and
- *    delete the OSV.
+ *    delete the OSV. This runs after each pass of EphTombstoneHTCleaner, and
+ *    additionally whenever the memory used by stale items exceeds
+ *    ephemeral_metadata_purge_stale_threshold of the bucket quota.
  *
  * Note that items can also become stale if they have been replaced with a newer
  * revision - this occurs when an item needs to be modified but the existing
@@ -70,6 +72,8 @@
 #include "progress_tracker.h"
 #include "vb_visitors.h"
 
+#include <atomic>
+
 class EphemeralBucket;
 class EphTombstoneStaleItemDeleter;
 
@@ -193,10 +197,28 @@ public:
 
     std::chrono::microseconds maxExpectedDuration() override;
 
+    /**
+     * Request that a pass is made over all vBuckets the next time the task
+     * runs, regardless of how much memory the stale items are using.
+     */
+    void requestPass() {
+        passRequested = true;
+    }
+
+    /// Interval (in seconds) at which the stale item memory is checked.
+    static const size_t StaleMemoryCheckInterval = 1;
+
 private:
     /// How long should each chunk of stale item deleter run for?
     std::chrono::milliseconds getChunkDuration() const;
 
+    /**
+     * @return true if a new pass should be started; either one was requested
+     *         or the stale items are using more than the configured share of
+     *         the bucket quota.
+     */
+    bool shouldStartPass();
+
     /// The bucket we are associated with.
     EphemeralBucket& bucket;
 
@@ -207,4 +229,7 @@ private:
     /// vbuckets one by one
     std::unique_ptr<EphemeralVBucket::StaleItemDeleter>
             staleItemDeleteVbVisitor;
+
+    /// Has a pass been requested (by EphTombstoneHTCleaner)?
+    std::atomic<bool> passRequested{false};
 };
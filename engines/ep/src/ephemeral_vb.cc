@@ -125,6 +125,25 @@ bool EphemeralVBucket::eligibleToPageOut(const HashTable::HashBucketLock& lh,
     return true;
 }
 
+StoredValue* EphemeralVBucket::reallocateStoredValue(
+        const HashTable::HashBucketLock& lh, StoredValue& v) {
+    /* The OrderedStoredValue must be replaced by its copy in the seqList as
+       well as in the hash table; both are done under the list's writeLock so
+       no range read or purge can start looking at it in between */
+    std::lock_guard<std::mutex> listWriteLg(seqList->getListWriteLock());
+    if (!seqList->canRelinkListElem(listWriteLg, *v.toOrderedStoredValue())) {
+        return nullptr;
+    }
+
+    StoredValue* newSv;
+    StoredValue::UniquePtr oldSv;
+    std::tie(newSv, oldSv) = ht.unlocked_reallocateStoredValue(lh, v);
+    seqList->relinkListElem(listWriteLg,
+                            *oldSv->toOrderedStoredValue(),
+                            *newSv->toOrderedStoredValue());
+    return newSv;
+}
+
 bool EphemeralVBucket::areDeletedItemsAlwaysResident() const {
     // Ephemeral buckets do keep all deleted items resident in memory.
     // (We have nowhere else to store them, given there is no disk).
@@ -608,6 +627,20 @@ void EphemeralVBucket::scheduleDeferredDeletion(
     ExecutorPool::get()->schedule(task);
 }
 
+std::pair<bool, size_t> EphemeralVBucket::releaseItems(size_t limit) {
+    size_t staleBytes = 0;
+    if (seqList) {
+        // The items of the hash table are linked into the seqList; destroying
+        // it unlinks them (and frees the stale items, which only it owns).
+        staleBytes = seqList->getStaleValueBytes() +
+                     seqList->getStaleMetadataBytes();
+        seqList.reset();
+    }
+    auto released = VBucket::releaseItems(limit);
+    released.second += staleBytes;
+    return released;
+}
+
 SequenceList::UpdateStatus EphemeralVBucket::modifySeqList(
         std::lock_guard<std::mutex>& seqLock,
         std::lock_guard<std::mutex>& writeLock,
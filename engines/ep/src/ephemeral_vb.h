@@ -104,6 +104,9 @@ public:
     bool eligibleToPageOut(const HashTable::HashBucketLock& lh,
                            const StoredValue& v) const override;
 
+    StoredValue* reallocateStoredValue(const HashTable::HashBucketLock& lh,
+                                       StoredValue& v) override;
+
     bool areDeletedItemsAlwaysResident() const override;
 
     void addStats(bool details, ADD_STAT add_stat, const void* c) override;
@@ -187,15 +190,21 @@ public:
     void queueBackfillItem(queued_item& qi,
                            const GenerateBySeqno generateBySeqno) override;
 
+    /// @return memory used by the stale items in this VBucket's sequenceList
+    size_t getSeqListStaleBytes() const {
+        return seqList->getStaleValueBytes();
+    }
+
     /** Purge any stale items in this VBucket's sequenceList.
      *
      * @param shouldPause Callback function that indicates if tombstone purging
-     *                    should pause. This is called for every element in the
-     *                    sequence list when we iterate over the list during the
-     *                    purge. The caller should decide if the purge should
-     *                    continue or if it should be paused (in case it is
-     *                    running for a long time). By default, we assume that
-     *                    the tombstone purging need not be paused at all
+     *                    should pause. This is called for every batch of
+     *                    elements in the sequence list when we iterate over the
+     *                    list during the purge. The caller should decide if the
+     *                    purge should continue or if it should be paused (in
+     *                    case it is running for a long time). By default, we
+     *                    assume that the tombstone purging need not be paused
+     *                    at all
      *
      * @return Number of items purged.
      */
@@ -211,6 +220,8 @@ public:
      */
     void scheduleDeferredDeletion(EventuallyPersistentEngine& engine) override;
 
+    std::pair<bool, size_t> releaseItems(size_t limit) override;
+
     /**
      * in ephemeral buckets the equivalent meaning is the number of deletes seen
      * by the vbucket.
@@ -0,0 +1,135 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "epoch_domain.h"
+
+#include <algorithm>
+#include <bitset>
+#include <limits>
+
+namespace {
+std::mutex slotAllocationMutex;
+std::bitset<EpochDomain::MaxSlots> allocatedSlots;
+
+/**
+ * The slot of a thread, allocated when the thread first enters any domain
+ * and freed for reuse when the thread exits.
+ */
+class ThreadSlot {
+public:
+    ThreadSlot() {
+        std::lock_guard<std::mutex> lh(slotAllocationMutex);
+        for (size_t ii = 0; ii < allocatedSlots.size(); ++ii) {
+            if (!allocatedSlots.test(ii)) {
+                allocatedSlots.set(ii);
+                index = ii;
+                return;
+            }
+        }
+    }
+
+    ~ThreadSlot() {
+        if (index < EpochDomain::MaxSlots) {
+            std::lock_guard<std::mutex> lh(slotAllocationMutex);
+            allocatedSlots.reset(index);
+        }
+    }
+
+    size_t index = EpochDomain::MaxSlots;
+};
+} // anonymous namespace
+
+size_t EpochDomain::getThreadSlot() {
+    static thread_local ThreadSlot slot;
+    return slot.index;
+}
+
+EpochDomain::Guard EpochDomain::enter() {
+    const auto index = getThreadSlot();
+    if (index >= MaxSlots) {
+        return {};
+    }
+
+    auto& slot = slots[index].epoch;
+    if (slot.load(std::memory_order_relaxed) != 0) {
+        // Nested; the outer guard keeps the domain entered.
+        return {nullptr, &slot, true};
+    }
+    // Sequentially consistent so the store is ordered before the loads of
+    // the protected pointers (see retire()).
+    slot.store(globalEpoch.load());
+    return {this, &slot, true};
+}
+
+void EpochDomain::exit(std::atomic<uint64_t>& slot) {
+    slot.store(0);
+    if (pending.load()) {
+        // This may have been the last reader of a retired object.
+        reclaim();
+    }
+}
+
+void EpochDomain::retire(std::shared_ptr<void> object) {
+    if (!object) {
+        return;
+    }
+
+    // The object has been unpublished; any reader which entered at a later
+    // epoch than this can't have loaded a pointer to it.
+    const auto epoch = globalEpoch.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lh(retiredMutex);
+        retired.emplace_back(epoch, std::move(object));
+        pending.store(true);
+    }
+    reclaim();
+}
+
+void EpochDomain::reclaim() {
+    std::vector<std::shared_ptr<void>> released;
+    {
+        std::lock_guard<std::mutex> lh(retiredMutex);
+        auto oldest = std::numeric_limits<uint64_t>::max();
+        for (const auto& slot : slots) {
+            const auto epoch = slot.epoch.load();
+            if (epoch != 0) {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+
+        // A reader which entered at the same epoch an object was retired at
+        // may have loaded it before it was unpublished.
+        auto it = std::partition(
+                retired.begin(),
+                retired.end(),
+                [oldest](const std::pair<uint64_t, std::shared_ptr<void>>& e) {
+                    return e.first >= oldest;
+                });
+        for (auto release = it; release != retired.end(); ++release) {
+            released.push_back(std::move(release->second));
+        }
+        retired.erase(it, retired.end());
+        pending.store(!retired.empty());
+    }
+    // The references are dropped without holding the lock, as releasing the
+    // last one may do arbitrary work (e.g. schedule a VBucket's deletion).
+}
+
+size_t EpochDomain::getNumRetired() const {
+    std::lock_guard<std::mutex> lh(retiredMutex);
+    return retired.size();
+}
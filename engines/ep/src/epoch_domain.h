@@ -0,0 +1,140 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * Epoch based protection of objects shared between threads, allowing
+ * readers to use a raw pointer to the object without touching its
+ * reference count.
+ *
+ * A reader enters the domain (see Guard) before loading the raw pointer and
+ * may use the object until it exits. A writer which unpublishes an object
+ * (e.g. removes it from a map) hands its reference to retire(); the
+ * reference is only released once every reader which may have loaded the
+ * pointer has exited.
+ *
+ * Each thread uses one of MaxSlots slots (each on its own cache line), so
+ * entering / exiting is a store to memory only written by that thread. If
+ * all the slots are in use a thread can't enter (Guard::active() is false)
+ * and must use a counted reference instead.
+ */
+class EpochDomain {
+public:
+    /// Most threads which can use any EpochDomain concurrently.
+    static constexpr size_t MaxSlots = 128;
+
+    /**
+     * RAII protection of any object published to the domain, for as long as
+     * the Guard exists. Guards may be nested; only the outermost exits the
+     * domain.
+     */
+    class Guard {
+    public:
+        /// An inactive guard, which protects nothing.
+        Guard() = default;
+
+        Guard(Guard&& other) noexcept
+            : domain(other.domain), slot(other.slot), isActive(other.isActive) {
+            other.domain = nullptr;
+            other.isActive = false;
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+        ~Guard() {
+            if (domain) {
+                domain->exit(*slot);
+            }
+        }
+
+        /// @return true if objects of the domain are protected by the Guard
+        bool active() const {
+            return isActive;
+        }
+
+    private:
+        friend class EpochDomain;
+
+        Guard(EpochDomain* domain, std::atomic<uint64_t>* slot, bool active)
+            : domain(domain), slot(slot), isActive(active) {
+        }
+
+        /// The domain to exit when destroyed (null if not outermost)
+        EpochDomain* domain = nullptr;
+        std::atomic<uint64_t>* slot = nullptr;
+        bool isActive = false;
+    };
+
+    EpochDomain() = default;
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    /**
+     * Enter the domain; pointers to objects of the domain loaded (with
+     * sequentially consistent ordering) while the returned guard is active
+     * remain valid until it is destroyed.
+     */
+    Guard enter();
+
+    /**
+     * Retire a reference to an object which is no longer reachable by new
+     * readers. The reference is released once no reader could still be
+     * using the object - possibly by another thread.
+     */
+    void retire(std::shared_ptr<void> object);
+
+    /// @return the number of retired objects not yet released
+    size_t getNumRetired() const;
+
+private:
+    void exit(std::atomic<uint64_t>& slot);
+
+    /// Release the retired objects no reader could still be using.
+    void reclaim();
+
+    /// @return the calling thread's slot index, MaxSlots if it has none.
+    static size_t getThreadSlot();
+
+    struct alignas(64) Slot {
+        /// The epoch the thread entered at, 0 if it's not in the domain.
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    std::array<Slot, MaxSlots> slots;
+
+    /// Current epoch; starts at 1 as a slot of 0 means not entered.
+    std::atomic<uint64_t> globalEpoch{1};
+
+    /// Set while there are retired objects, so exit() knows to reclaim.
+    std::atomic<bool> pending{false};
+
+    mutable std::mutex retiredMutex;
+    /// The retired objects, with the epoch they were retired at.
+    std::vector<std::pair<uint64_t, std::shared_ptr<void>>> retired;
+};
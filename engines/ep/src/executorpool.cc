@@ -28,14 +28,18 @@
 #include <platform/checked_snprintf.h>
 #include <platform/string_hex.h>
 #include <platform/sysinfo.h>
+#include <utilities/cpu_affinity.h>
 #include <algorithm>
 #include <chrono>
+#include <deque>
 #include <queue>
 #include <sstream>
 
 std::mutex ExecutorPool::initGuard;
 std::atomic<ExecutorPool*> ExecutorPool::instance;
 
+const std::chrono::milliseconds ExecutorPool::AutoscaleInterval{900};
+
 static const size_t EP_MIN_NUM_THREADS    = 10;
 static const size_t EP_MIN_READER_THREADS = 4;
 static const size_t EP_MIN_WRITER_THREADS = 4;
@@ -139,6 +143,13 @@ ExecutorPool *ExecutorPool::get(void) {
                                    config.getNumWriterThreads(),
                                    config.getNumAuxioThreads(),
                                    config.getNumNonioThreads());
+            tmp->setLocalQueueSize(config.getExecutorLocalQueueSize());
+            tmp->setNumaInterleave(config.getExecutorNumaBinding() ==
+                                   "interleave");
+            tmp->setAutoscaleLimit(READER_TASK_IDX,
+                                   config.getExecutorAutoscaleMaxReaders());
+            tmp->setAutoscaleLimit(WRITER_TASK_IDX,
+                                   config.getExecutorAutoscaleMaxWriters());
             ObjectRegistry::onSwitchThread(epe);
             instance.store(tmp);
         }
@@ -146,6 +157,87 @@ ExecutorPool *ExecutorPool::get(void) {
     return tmp;
 }
 
+void ExecutorPool::setNumaInterleave(bool enable) {
+    const auto nodes = enable ? get_numa_node_count() : 0;
+    numaNodes = nodes > 1 ? nodes : 0;
+    if (numaNodes) {
+        EP_LOG_INFO("Spreading executor threads over {} NUMA nodes",
+                    numaNodes);
+    }
+}
+
+void ExecutorPool::setAutoscaleLimit(task_type_t type, size_t maxThreads) {
+    std::lock_guard<std::mutex> lh(autoscaleMutex);
+    auto& state = autoscale[type];
+    state = AutoscaleState();
+    state.maxThreads = maxThreads;
+}
+
+void ExecutorPool::autoscaleWorkers() {
+    // Another bucket's task may be doing the check right now.
+    std::unique_lock<std::mutex> lh(autoscaleMutex, std::try_to_lock);
+    if (!lh) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastAutoscale < AutoscaleInterval) {
+        return;
+    }
+    lastAutoscale = now;
+
+    NonBucketAllocationGuard guard;
+    _autoscaleWorkers(READER_TASK_IDX);
+    _autoscaleWorkers(WRITER_TASK_IDX);
+}
+
+size_t ExecutorPool::_autoscaleWorkers(task_type_t type) {
+    auto& state = autoscale[type];
+    const size_t threads = numWorkers[type];
+    if (!state.maxThreads || !threads) {
+        // Not autoscaled, or the threads haven't been started yet.
+        return threads;
+    }
+    if (!state.minThreads) {
+        state.minThreads = threads;
+    }
+
+    // Tasks which are ready while every thread is busy running another task
+    // are waiting for a thread; ready tasks with idle threads around are
+    // just about to be picked up.
+    const size_t ready = numReadyTasks[type];
+    const size_t busy = curWorkers[type];
+    size_t desired = threads;
+    if (ready && busy >= threads) {
+        state.idleChecks = 0;
+        if (++state.busyChecks >= AutoscaleGrowChecks &&
+            threads < state.maxThreads) {
+            desired = threads + 1;
+        }
+    } else if (busy + ready <= threads / 2 && threads > state.minThreads) {
+        state.busyChecks = 0;
+        if (++state.idleChecks >= AutoscaleShrinkChecks) {
+            desired = threads - 1;
+        }
+    } else {
+        state.busyChecks = 0;
+        state.idleChecks = 0;
+    }
+
+    if (desired != threads) {
+        EP_LOG_INFO(
+                "ExecutorPool::autoscaleWorkers: {} {} threads, ready:{} "
+                "busy:{}",
+                desired > threads ? "Adding" : "Removing",
+                to_string(type),
+                ready,
+                busy);
+        state.busyChecks = 0;
+        state.idleChecks = 0;
+        _adjustWorkers(type, desired);
+    }
+    return desired;
+}
+
 void ExecutorPool::shutdown(void) {
     std::lock_guard<std::mutex> lock(initGuard);
     auto* tmp = instance.load();
@@ -161,7 +253,8 @@ ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
                   numTaskSets(nTaskSets), totReadyTasks(0),
                   isHiPrioQset(false), isLowPrioQset(false), numBuckets(0),
                   numSleepers(0), curWorkers(nTaskSets), numWorkers(nTaskSets),
-                  numReadyTasks(nTaskSets) {
+                  numReadyTasks(nTaskSets), numLocalTasks(nTaskSets),
+                  autoscale(nTaskSets) {
     size_t numCPU = Couchbase::get_available_cpu_count();
     size_t numThreads = (size_t)((numCPU * 3)/4);
     numThreads = (numThreads < EP_MIN_NUM_THREADS) ?
@@ -170,6 +263,7 @@ ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
     for (size_t i = 0; i < nTaskSets; i++) {
         curWorkers[i] = 0;
         numReadyTasks[i] = 0;
+        numLocalTasks[i] = 0;
     }
     numWorkers[WRITER_TASK_IDX] = maxWriters;
     numWorkers[READER_TASK_IDX] = maxReaders;
@@ -201,6 +295,12 @@ TaskQueue *ExecutorPool::_nextTask(ExecutorThread &t, uint8_t tick) {
         return NULL;
     }
 
+    if (localQueueSize > 1) {
+        if (auto* q = fetchLocalTask(t)) {
+            return q;
+        }
+    }
+
     task_type_t myq = t.taskType;
     TaskQueue *checkQ; // which TaskQueue set should be polled first
     TaskQueue *checkNextQ; // which set of TaskQueue should be polled next
@@ -220,6 +320,13 @@ TaskQueue *ExecutorPool::_nextTask(ExecutorThread &t, uint8_t tick) {
             return checkQ;
         }
         if (toggle || checkQ == checkNextQ) {
+            // Nothing in the shared queues; before sleeping see if another
+            // thread has more local tasks than it can run.
+            if (numLocalTasks[myq] > 0) {
+                if (auto* q = fetchLocalTask(t)) {
+                    return q;
+                }
+            }
             TaskQueue *sleepQ = getSleepQ(myq);
             if (sleepQ->fetchNextTask(t, true)) {
                 return sleepQ;
@@ -234,6 +341,69 @@ TaskQueue *ExecutorPool::_nextTask(ExecutorThread &t, uint8_t tick) {
     return NULL;
 }
 
+void ExecutorPool::addLocalTask(ExecutorThread& t, ExTask task, TaskQueue* q) {
+    std::lock_guard<std::mutex> lh(t.localQueueMutex);
+    t.localQueue.emplace_back(std::move(task), q);
+    ++numLocalTasks[t.taskType];
+}
+
+TaskQueue* ExecutorPool::fetchLocalTask(ExecutorThread& t) {
+    const auto type = t.taskType;
+    TaskQpair next;
+    {
+        std::lock_guard<std::mutex> lh(t.localQueueMutex);
+        if (!t.localQueue.empty()) {
+            next = std::move(t.localQueue.front());
+            t.localQueue.pop_front();
+        }
+    }
+
+    if (!next.first && numLocalTasks[type] > 0) {
+        // Steal from the back of the queue; the owner takes from the front.
+        LockHolder lh(tMutex);
+        for (auto* thread : threadQ) {
+            if (thread == &t || thread->taskType != type) {
+                continue;
+            }
+            std::lock_guard<std::mutex> guard(thread->localQueueMutex);
+            if (!thread->localQueue.empty()) {
+                next = std::move(thread->localQueue.back());
+                thread->localQueue.pop_back();
+                ++numStolenTasks;
+                break;
+            }
+        }
+    }
+
+    if (!next.first) {
+        return nullptr;
+    }
+    --numLocalTasks[type];
+    lessWork(type);
+    t.setCurrentTask(next.first);
+    return next.second;
+}
+
+void ExecutorPool::returnLocalTasks(ExecutorThread& t) {
+    std::deque<TaskQpair> tasks;
+    {
+        std::lock_guard<std::mutex> lh(t.localQueueMutex);
+        tasks.swap(t.localQueue);
+    }
+    if (tasks.empty()) {
+        return;
+    }
+
+    // The tasks are due, so they become ready again on the next fetch.
+    for (auto& task : tasks) {
+        --numLocalTasks[t.taskType];
+        lessWork(t.taskType);
+        task.second->reschedule(task.first);
+    }
+    size_t numToWake = tasks.size();
+    getSleepQ(t.taskType)->doWake(numToWake);
+}
+
 TaskQueue *ExecutorPool::nextTask(ExecutorThread &t, uint8_t tick) {
     NonBucketAllocationGuard guard;
     TaskQueue *tq = _nextTask(t, tick);
@@ -479,7 +649,22 @@ void ExecutorPool::_registerTaskable(Taskable& taskable) {
             *whichQset = true;
         }
 
+        // Start the taskable level with the least served of the existing
+        // ones, so it doesn't take all the threads while catching up on them.
+        for (size_t i = 0; i < numTaskSets; ++i) {
+            const auto type = task_type_t(i);
+            uint64_t minRunTime = 0;
+            for (auto* owner : taskOwners) {
+                const auto rt =
+                        static_cast<Taskable*>(owner)->getVirtualRunTime(type);
+                if (owner == *taskOwners.begin() || rt < minRunTime) {
+                    minRunTime = rt;
+                }
+            }
+            taskable.setVirtualRunTime(type, minRunTime);
+        }
         taskOwners.insert(&taskable);
+        sharingThreads = taskOwners.size() > 1;
         numBuckets++;
     }
 
@@ -526,7 +711,8 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
                 threadQ.push_back(new ExecutorThread(
                         this,
                         type,
-                        typeName + "_worker_" + std::to_string(tidx)));
+                        typeName + "_worker_" + std::to_string(tidx),
+                        numaNodes ? int(tidx % size_t(numaNodes)) : -1));
                 threadQ.back()->start();
             }
         } else if (numItems > desiredNumItems) {
@@ -581,6 +767,16 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
 
 void ExecutorPool::adjustWorkers(task_type_t type, size_t newCount) {
     NonBucketAllocationGuard guard;
+    {
+        // An explicitly set thread count is the new floor for autoscaling.
+        std::lock_guard<std::mutex> lh(autoscaleMutex);
+        auto& state = autoscale[type];
+        if (state.maxThreads) {
+            state.minThreads = std::min(newCount, state.maxThreads);
+            state.busyChecks = 0;
+            state.idleChecks = 0;
+        }
+    }
     _adjustWorkers(type, newCount);
 }
 
@@ -659,6 +855,7 @@ void ExecutorPool::_unregisterTaskable(Taskable& taskable, bool force) {
 
     LockHolder lh(tMutex);
     taskOwners.erase(&taskable);
+    sharingThreads = taskOwners.size() > 1;
     if (!(--numBuckets)) {
         if (taskLocator.size()) {
             throw std::logic_error("ExecutorPool::_unregisterTaskable: "
@@ -764,6 +961,21 @@ void ExecutorPool::doTaskQStat(EventuallyPersistentEngine *engine,
                 }
             }
         }
+        if (localQueueSize > 1) {
+            for (size_t i = 0; i < numTaskSets; i++) {
+                checked_snprintf(statname,
+                                 sizeof(statname),
+                                 "ep_workload:%s:LocalQsize",
+                                 TaskQueue::taskType2Str(task_type_t(i))
+                                         .c_str());
+                add_casted_stat(
+                        statname, numLocalTasks[i].load(), add_stat, cookie);
+            }
+            add_casted_stat("ep_workload:stolen_tasks",
+                            numStolenTasks.load(),
+                            add_stat,
+                            cookie);
+        }
     } catch (std::exception& error) {
         EP_LOG_WARN("ExecutorPool::doTaskQStat: Failed to build stats: {}",
                     error.what());
@@ -32,6 +32,11 @@
  * a task, it will service the high-priority queue more frequently than the
  * low-priority queue.
  *
+ * Optionally (see setLocalQueueSize) a thread fetches a few ready tasks at a
+ * time, keeping the extra ones in its own local run queue which it services
+ * without touching the shared TaskQueue. Idle threads steal tasks from the
+ * local queues of the other threads of their type before going to sleep.
+ *
  * Within a single queue itself there is also a task priority. The task priority
  * is a value where lower is better. When many tasks are ready for execution
  * they are moved to a ready queue and sorted by their priority. Thus tasks
@@ -72,7 +77,9 @@
 #include "taskable.h"
 
 #include <memcached/engine.h>
+#include <chrono>
 #include <map>
+#include <mutex>
 #include <set>
 
 // Forward decl
@@ -108,6 +115,13 @@ public:
 
     TaskQueue *nextTask(ExecutorThread &t, uint8_t tick);
 
+    /**
+     * Add a task fetched ahead of time from the given queue to the thread's
+     * local queue. The task stays counted as ready until it is taken from
+     * the local queue.
+     */
+    void addLocalTask(ExecutorThread& t, ExTask task, TaskQueue* q);
+
     TaskQueue *getSleepQ(unsigned int curTaskType) {
         return isHiPrioQset ? hpTaskQ[curTaskType] : lpTaskQ[curTaskType];
     }
@@ -194,10 +208,75 @@ public:
 
     size_t getNumReadyTasks(void) { return totReadyTasks; }
 
+    /// @returns the tasks of the given type which are ready to run but
+    /// haven't been picked up by a thread yet.
+    size_t getNumReadyTasks(task_type_t type) const {
+        return numReadyTasks[type];
+    }
+
     size_t getNumSleepers(void) { return numSleepers; }
 
+    /// @returns true if more than one taskable is registered, in which case
+    /// the ready tasks are shared out by the taskables' weights.
+    bool isSharingThreads() const {
+        return sharingThreads;
+    }
+
     size_t schedule(ExTask task);
 
+    /**
+     * Set how many ready tasks a thread may fetch from a TaskQueue at once
+     * (leaving enough ready tasks behind for the threads sleeping on the
+     * queue). The tasks beyond the first go to the thread's local queue; a
+     * value of 0 or 1 makes every fetch use the shared TaskQueues.
+     */
+    void setLocalQueueSize(size_t size) {
+        localQueueSize = size;
+    }
+
+    size_t getLocalQueueSize() const {
+        return localQueueSize;
+    }
+
+    /// @returns how many tasks were taken from another thread's local queue
+    size_t getNumStolenTasks() const {
+        return numStolenTasks;
+    }
+
+    /**
+     * Spread the threads created from now on over the NUMA nodes of the
+     * machine (by thread index within each task type), binding each to the
+     * CPUs of its node. Has no effect on a machine with a single node.
+     */
+    void setNumaInterleave(bool enable);
+
+    /**
+     * Let the number of threads of the given type (readers or writers) grow
+     * up to maxThreads while tasks are waiting behind busy threads, and
+     * shrink back again once the threads are mostly idle. The thread count
+     * set when autoscaling starts (or later by setNumReaders / setNumWriters)
+     * is the floor it never shrinks below. A maxThreads of 0 disables
+     * autoscaling of the type.
+     */
+    void setAutoscaleLimit(task_type_t type, size_t maxThreads);
+
+    /**
+     * Check the backlog of each autoscaled thread type and add or remove a
+     * thread if warranted. Called periodically (by every bucket's
+     * ExecutorAutoscaler task), checks more frequent than AutoscaleInterval
+     * are ignored.
+     */
+    void autoscaleWorkers();
+
+    /// Minimum time between two autoscale checks.
+    static const std::chrono::milliseconds AutoscaleInterval;
+
+    /// Consecutive checks with a backlog before adding a thread.
+    static const size_t AutoscaleGrowChecks = 2;
+
+    /// Consecutive mostly idle checks before removing a thread.
+    static const size_t AutoscaleShrinkChecks = 30;
+
     static ExecutorPool *get(void);
 
     static void shutdown(void);
@@ -230,6 +309,34 @@ protected:
     TaskQueue* _getTaskQueue(const Taskable& t, task_type_t qidx);
     void _stopAndJoinThreads();
 
+    /**
+     * Take the next task of the thread's local queue or, if that is empty,
+     * steal the oldest task from another thread of the same type.
+     *
+     * @return the queue the task was fetched from, or nullptr if there was
+     *         no local task to run
+     */
+    TaskQueue* fetchLocalTask(ExecutorThread& t);
+
+    /// Give the tasks left in the local queue of a stopping thread back to
+    /// the queues they came from.
+    void returnLocalTasks(ExecutorThread& t);
+
+    /**
+     * Autoscale check of a single thread type, without the rate limit.
+     *
+     * @return the new number of threads of the type
+     */
+    size_t _autoscaleWorkers(task_type_t type);
+
+    // Autoscaling bounds and state of a thread type.
+    struct AutoscaleState {
+        size_t minThreads = 0;
+        size_t maxThreads = 0;
+        size_t busyChecks = 0;
+        size_t idleChecks = 0;
+    };
+
     size_t numTaskSets; // safe to read lock-less not altered after creation
     size_t maxGlobalThreads;
 
@@ -251,6 +358,9 @@ protected:
 
     size_t numBuckets;
 
+    // NUMA nodes to spread the threads over; zero if threads aren't bound.
+    int numaNodes = 0;
+
     SyncObject tMutex; // to serialize taskLocator, threadQ, numBuckets access
 
     std::atomic<uint16_t> numSleepers; // total number of sleeping threads
@@ -258,8 +368,18 @@ protected:
     std::vector<std::atomic<uint16_t>> numWorkers; // and limit it to the value set here
     std::vector<std::atomic<size_t>> numReadyTasks; // number of ready tasks per task set
 
+    std::atomic<size_t> localQueueSize{0};
+    // number of tasks in the local queues per task set
+    std::vector<std::atomic<size_t>> numLocalTasks;
+    std::atomic<size_t> numStolenTasks{0};
+
+    std::mutex autoscaleMutex; // serializes the autoscale checks
+    std::vector<AutoscaleState> autoscale;
+    std::chrono::steady_clock::time_point lastAutoscale;
+
     // Set of all known task owners
     std::set<void *> taskOwners;
+    std::atomic<bool> sharingThreads{false};
 
     // Singleton creation
     static std::mutex initGuard;
@@ -28,6 +28,7 @@
 #include "taskqueue.h"
 
 #include <platform/timeutils.h>
+#include <utilities/cpu_affinity.h>
 
 extern "C" {
     static void launch_executor_thread(void *arg) {
@@ -77,6 +78,18 @@ void ExecutorThread::stop(bool wait) {
 void ExecutorThread::run() {
     EP_LOG_DEBUG("Thread {} running..", getName());
 
+    if (numaNode >= 0) {
+        if (bind_current_thread_to_cpus(get_numa_node_cpus(numaNode)) &&
+            prefer_local_numa_memory()) {
+            EP_LOG_DEBUG(
+                    "Thread {} bound to NUMA node {}", getName(), numaNode);
+        } else {
+            EP_LOG_WARN("Thread {} failed to bind to NUMA node {}",
+                        getName(),
+                        numaNode);
+        }
+    }
+
     for (uint8_t tick = 1;; tick++) {
         resetCurrentTask();
 
@@ -158,6 +171,7 @@ void ExecutorThread::run() {
                     std::chrono::steady_clock::now() - getTaskStart());
             currentTask->getTaskable().logRunTime(currentTask->getTaskId(),
                                                   runtime);
+            currentTask->getTaskable().chargeRunTime(taskType, runtime);
             currentTask->updateRuntime(runtime);
 
             // Check if exceeded expected duration; and if so log.
@@ -169,6 +183,11 @@ void ExecutorThread::run() {
                             description,
                             getName(),
                             cb::time2text(runtime));
+                currentTask->getTaskable().logSlowRun(
+                        currentTask->getTaskId(),
+                        description,
+                        getName(),
+                        runtime);
             }
 
             // Check if task is run once or needs to be rescheduled..
@@ -199,7 +218,9 @@ void ExecutorThread::run() {
             manager->doneWork(taskType);
         }
     }
-    // Thread is about to terminate - disassociate it from any engine.
+    // Thread is about to terminate - hand back any tasks it fetched ahead,
+    // and disassociate it from any engine.
+    manager->returnLocalTasks(*this);
     ObjectRegistry::onSwitchThread(nullptr);
 
     state = EXECUTOR_DEAD;
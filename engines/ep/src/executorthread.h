@@ -84,10 +84,18 @@ public:
         std::chrono::steady_clock::time_point timepoint;
     };
 
-    ExecutorThread(ExecutorPool* m, task_type_t type, const std::string nm)
+    /**
+     * @param numaNode NUMA node to bind the thread to when it starts
+     *        running, or -1 to let it run anywhere
+     */
+    ExecutorThread(ExecutorPool* m,
+                   task_type_t type,
+                   const std::string nm,
+                   int numaNode = -1)
         : manager(m),
           taskType(type),
           name(nm),
+          numaNode(numaNode),
           state(EXECUTOR_RUNNING),
           now(std::chrono::steady_clock::now()),
           waketime(std::chrono::steady_clock::time_point::max()),
@@ -158,6 +166,7 @@ protected:
     ExecutorPool *manager;
     task_type_t taskType;
     const std::string name;
+    const int numaNode;
     std::atomic<executor_state_t> state;
 
     // record of current time
@@ -168,4 +177,9 @@ protected:
 
     std::mutex currentTaskMutex; // Protects currentTask
     ExTask currentTask;
+
+    // Ready tasks fetched ahead of time (with the queue each came from), see
+    // ExecutorPool::setLocalQueueSize.
+    std::mutex localQueueMutex;
+    std::deque<std::pair<ExTask, TaskQueue*>> localQueue;
 };
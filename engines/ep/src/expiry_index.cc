@@ -0,0 +1,46 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "expiry_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+void ExpiryIndex::add(const DocKey& key, time_t exptime) {
+    if (exptime == 0) {
+        return;
+    }
+    auto& shard = shards[key.hash() % NumShards];
+    std::lock_guard<std::mutex> lh(shard.mutex);
+    shard.keys[exptime].emplace_back(key);
+    ++numKeys;
+}
+
+std::vector<StoredDocKey> ExpiryIndex::takeExpired(time_t asOf) {
+    std::vector<StoredDocKey> expired;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        const auto end = shard.keys.lower_bound(asOf);
+        for (auto it = shard.keys.begin(); it != end; ++it) {
+            numKeys -= it->second.size();
+            std::move(it->second.begin(),
+                      it->second.end(),
+                      std::back_inserter(expired));
+        }
+        shard.keys.erase(shard.keys.begin(), end);
+    }
+    return expired;
+}
@@ -0,0 +1,87 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "storeddockey.h"
+
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * Index of the keys of a vBucket's items which have an expiry time, by that
+ * time (to the second), allowing the expiry pager to visit just the items
+ * which have expired instead of the whole HashTable.
+ *
+ * The index only holds hints: an item is added whenever it is stored with
+ * an expiry time, but never removed when it is updated, deleted or evicted.
+ * Whoever takes the expired keys must look each up and check whether it
+ * really has expired. A key may be taken more than once (when it was stored
+ * with several expiry times), and the entries of keys which have long since
+ * changed stay until their time comes.
+ *
+ * The index is only complete once every item which was already in the
+ * HashTable when it was created (or was changed by other means, such as a
+ * rollback) has been added: until then the expiry pager sweeps the whole
+ * HashTable, adding the items it doesn't expire, and marks it complete.
+ *
+ * The keys are spread over independently locked shards, so that front end
+ * writes to a vBucket don't all contend on the one lock.
+ */
+class ExpiryIndex {
+public:
+    /**
+     * Add the key of an item with the given expiry time. An exptime of zero
+     * (no expiry) is ignored.
+     */
+    void add(const DocKey& key, time_t exptime);
+
+    /**
+     * Remove and return the keys of the items with an expiry time before the
+     * given time (i.e. those StoredValue::isExpired(asOf) would consider
+     * expired).
+     */
+    std::vector<StoredDocKey> takeExpired(time_t asOf);
+
+    /// @returns the number of keys in the index, duplicates included.
+    size_t size() const {
+        return numKeys;
+    }
+
+    bool isComplete() const {
+        return complete;
+    }
+
+    void setComplete(bool value) {
+        complete = value;
+    }
+
+    static const size_t NumShards = 16;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::map<time_t, std::vector<StoredDocKey>> keys;
+    };
+
+    std::array<Shard, NumShards> shards;
+    std::atomic<size_t> numKeys{0};
+    std::atomic<bool> complete{false};
+};
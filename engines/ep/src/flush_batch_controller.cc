@@ -0,0 +1,81 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "flush_batch_controller.h"
+
+#include <algorithm>
+
+FlushBatchController::FlushBatchController(
+        size_t maxBatchSize,
+        size_t minBatchSize,
+        std::chrono::milliseconds targetCommitTime)
+    : maxBatchSize(maxBatchSize),
+      minBatchSize(minBatchSize),
+      targetCommitTime(
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                      targetCommitTime)
+                      .count()),
+      batchLimit(maxBatchSize) {
+}
+
+size_t FlushBatchController::getBatchLimit() const {
+    if (targetCommitTime == 0) {
+        return maxBatchSize;
+    }
+    return clamp(batchLimit);
+}
+
+void FlushBatchController::commitCompleted(size_t items,
+                                           std::chrono::microseconds duration) {
+    const uint64_t target = targetCommitTime;
+    if (target == 0 || items == 0) {
+        return;
+    }
+
+    const auto limit = getBatchLimit();
+    const uint64_t took = std::max<int64_t>(duration.count(), 1);
+    if (took > target) {
+        // Scale the batch down to what would (roughly) have met the target.
+        const auto wanted = size_t(items * target / took);
+        if (wanted < limit) {
+            batchLimit = clamp(wanted);
+        }
+    } else if (took < target / 2 && items >= limit / 2) {
+        // Well within target with a batch close to the limit; grow it.
+        batchLimit = clamp(limit + limit / 2 + 1);
+    }
+}
+
+void FlushBatchController::setMaxBatchSize(size_t size) {
+    maxBatchSize = size;
+}
+
+void FlushBatchController::setMinBatchSize(size_t size) {
+    minBatchSize = size;
+}
+
+void FlushBatchController::setTargetCommitTime(
+        std::chrono::milliseconds target) {
+    targetCommitTime =
+            std::chrono::duration_cast<std::chrono::microseconds>(target)
+                    .count();
+}
+
+size_t FlushBatchController::clamp(size_t limit) const {
+    const size_t max = maxBatchSize;
+    return std::max(std::min(limit, max), std::min(size_t(minBatchSize), max));
+}
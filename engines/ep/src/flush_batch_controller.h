@@ -0,0 +1,78 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Adapts the number of items the flusher includes in a single commit to the
+ * commit latency observed.
+ *
+ * With a target commit time set, the batch limit is reduced in proportion
+ * whenever a commit takes longer than the target (so a burst of mutations
+ * isn't held up behind one long commit), and grown again while commits of
+ * batches of about the limit complete in under half the target. The limit
+ * never drops below the minimum batch size: on a slow disk most of a commit
+ * is the fixed cost of the sync, and shrinking further would only turn it
+ * into many small commits.
+ *
+ * Commits may be reported concurrently (by several flushers); the limit is
+ * updated without locking, as an occasional lost update is harmless.
+ */
+class FlushBatchController {
+public:
+    /**
+     * @param maxBatchSize the limit when not adapting, and the upper bound
+     *        of the adaptive limit
+     * @param minBatchSize the lower bound of the adaptive limit
+     * @param targetCommitTime the commit time to aim for; zero disables
+     *        adapting
+     */
+    FlushBatchController(size_t maxBatchSize,
+                         size_t minBatchSize,
+                         std::chrono::milliseconds targetCommitTime);
+
+    /// @returns the maximum number of items to flush in one batch.
+    size_t getBatchLimit() const;
+
+    /**
+     * Record the completion of a commit.
+     *
+     * @param items the number of items committed
+     * @param duration how long the commit took
+     */
+    void commitCompleted(size_t items, std::chrono::microseconds duration);
+
+    void setMaxBatchSize(size_t size);
+
+    void setMinBatchSize(size_t size);
+
+    void setTargetCommitTime(std::chrono::milliseconds target);
+
+private:
+    size_t clamp(size_t limit) const;
+
+    std::atomic<size_t> maxBatchSize;
+    std::atomic<size_t> minBatchSize;
+    // Target commit time in microseconds (0 if not adapting).
+    std::atomic<uint64_t> targetCommitTime;
+    std::atomic<size_t> batchLimit;
+};
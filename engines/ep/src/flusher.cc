@@ -20,6 +20,8 @@
 #include "bucket_logger.h"
 #include "common.h"
 #include "ep_bucket.h"
+#include "kvshard.h"
+#include "statwriter.h"
 #include "tasks.h"
 
 #include <platform/timeutils.h>
@@ -27,7 +29,7 @@
 #include <stdlib.h>
 #include <sstream>
 
-Flusher::Flusher(EPBucket* st, KVShard* k)
+Flusher::Flusher(EPBucket* st, KVShard* k, size_t index)
     : store(st),
       _state(State::Initializing),
       taskId(0),
@@ -36,7 +38,11 @@ Flusher::Flusher(EPBucket* st, KVShard* k)
       doHighPriority(false),
       numHighPriority(0),
       pendingMutation(false),
-      shard(k) {
+      shard(k),
+      index(index),
+      numFlushes(0),
+      itemsFlushed(0),
+      groupSyncs(0) {
 }
 
 Flusher::~Flusher() {
@@ -149,6 +155,40 @@ const char* Flusher::stateName() const {
     return stateName(_state);
 }
 
+void Flusher::addStats(ADD_STAT add_stat, const void* cookie) const {
+    char buf[64];
+
+    try {
+        checked_snprintf(buf,
+                         sizeof(buf),
+                         "flusher_%d_%d:state",
+                         int(shard->getId()),
+                         int(index));
+        add_casted_stat(buf, stateName(), add_stat, cookie);
+        checked_snprintf(buf,
+                         sizeof(buf),
+                         "flusher_%d_%d:flushes",
+                         int(shard->getId()),
+                         int(index));
+        add_casted_stat(buf, numFlushes.load(), add_stat, cookie);
+        checked_snprintf(buf,
+                         sizeof(buf),
+                         "flusher_%d_%d:items_flushed",
+                         int(shard->getId()),
+                         int(index));
+        add_casted_stat(buf, itemsFlushed.load(), add_stat, cookie);
+        checked_snprintf(buf,
+                         sizeof(buf),
+                         "flusher_%d_%d:group_syncs",
+                         int(shard->getId()),
+                         int(index));
+        add_casted_stat(buf, groupSyncs.load(), add_stat, cookie);
+    } catch (std::exception& error) {
+        EP_LOG_WARN("Flusher::addStats: Failed to build stats: {}",
+                    error.what());
+    }
+}
+
 void Flusher::initialize() {
     EP_LOG_DEBUG("Flusher::initialize: initializing");
     transitionState(State::Running);
@@ -157,7 +197,7 @@ void Flusher::initialize() {
 void Flusher::schedule_UNLOCKED() {
     ExecutorPool* iom = ExecutorPool::get();
     ExTask task = std::make_shared<FlusherTask>(
-            ObjectRegistry::getCurrentEngine(), this, shard->getId());
+            ObjectRegistry::getCurrentEngine(), this, shard->getId(), index);
     this->setTaskId(task->getId());
     iom->schedule(task);
 }
@@ -197,6 +237,7 @@ bool Flusher::step(GlobalTask *task) {
     case State::Paused:
     case State::Pausing:
         if (currentState == State::Pausing) {
+            syncFlushed();
             transitionState(State::Paused);
         }
         // Indefinitely put task to sleep..
@@ -217,6 +258,7 @@ bool Flusher::step(GlobalTask *task) {
         EP_LOG_DEBUG(
                 "Flusher::step: stopping flusher (write of all dirty items)");
         completeFlush();
+        syncFlushed();
         EP_LOG_DEBUG("Flusher::step: stopped");
         transitionState(State::Stopped);
         return false;
@@ -247,8 +289,10 @@ double Flusher::computeMinSleepTime() {
 }
 
 void Flusher::flushVB(void) {
-    if (store->isDeleteAllScheduled() && shard->getId() != EP_PRIMARY_SHARD) {
-        // another shard is doing disk flush
+    if (store->isDeleteAllScheduled() &&
+        (shard->getId() != EP_PRIMARY_SHARD || index != 0)) {
+        // another flusher (the primary shard's first) is doing disk flush
+        syncFlushed();
         bool inverse = false;
         pendingMutation.compare_exchange_strong(inverse, true);
         return;
@@ -263,13 +307,18 @@ void Flusher::flushVB(void) {
         bool inverse = true;
         if (pendingMutation.compare_exchange_strong(inverse, false)) {
             for (auto vbid : shard->getVBucketsSortedByState()) {
-                lpVbs.push(vbid);
+                if (isOwnVBucket(vbid)) {
+                    lpVbs.push(vbid);
+                }
             }
         }
     }
 
     if (!doHighPriority && shard->highPriorityCount.load() > 0) {
         for (auto vbid : shard->getVBuckets()) {
+            if (!isOwnVBucket(vbid)) {
+                continue;
+            }
             VBucketPtr vb = store->getVBucket(vbid);
             if (vb && vb->getHighPriorityChkSize() > 0) {
                 hpVbs.push(vbid);
@@ -283,23 +332,61 @@ void Flusher::flushVB(void) {
 
     if (hpVbs.empty() && lpVbs.empty()) {
         EP_LOG_DEBUG("Flusher::flushVB: Trying to flush but no vbuckets exist");
+        syncFlushed();
         return;
     } else if (!hpVbs.empty()) {
         Vbid vbid = hpVbs.front();
         hpVbs.pop();
-        if (store->flushVBucket(vbid).first) {
+        if (flushOne(vbid)) {
             // More items still available, add vbid back to pending set.
             hpVbs.push(vbid);
         }
+        // Don't keep high priority requests waiting for the rest of the
+        // group.
+        if (hpVbs.empty()) {
+            syncFlushed();
+        }
     } else {
         if (doHighPriority && --numHighPriority == 0) {
             doHighPriority = false;
         }
         Vbid vbid = lpVbs.front();
         lpVbs.pop();
-        if (store->flushVBucket(vbid).first) {
+        if (flushOne(vbid)) {
             // More items still available, add vbid back to pending set.
             lpVbs.push(vbid);
         }
     }
+
+    // Group commit: sync once the current pass completes or enough flushes
+    // have been grouped.
+    if (lpVbs.empty() ||
+        unsyncedVbs.size() >= store->getFlusherGroupCommitSize()) {
+        syncFlushed();
+    }
+}
+
+bool Flusher::flushOne(Vbid vbid) {
+    const bool groupCommit = store->getFlusherGroupCommitSize() > 1;
+    const auto result =
+            store->flushVBucket(vbid, groupCommit ? &unsyncedVbs : nullptr);
+    if (result.second > 0) {
+        ++numFlushes;
+        itemsFlushed += result.second;
+    }
+    return result.first;
+}
+
+void Flusher::syncFlushed() {
+    if (unsyncedVbs.empty()) {
+        return;
+    }
+    if (store->syncFlushedVBuckets(*shard->getRWUnderlyingForFlusher(index),
+                                   unsyncedVbs)) {
+        ++groupSyncs;
+    }
+}
+
+bool Flusher::isOwnVBucket(Vbid vbid) const {
+    return shard->getFlusherIndex(vbid) == index;
 }
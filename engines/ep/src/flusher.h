@@ -21,12 +21,14 @@
 #include "executorthread.h"
 #include "utility.h"
 
+#include <memcached/engine_common.h>
 #include <memcached/vbucket.h>
 
 #include <list>
 #include <map>
 #include <queue>
 #include <string>
+#include <vector>
 
 #define NO_VBUCKETS_INSTANTIATED 0xFFFF
 #define RETRY_FLUSH_VBUCKET (-1)
@@ -39,10 +41,14 @@ class KVShard;
 
 /**
  * Manage persistence of data for an EPBucket.
+ *
+ * Each Flusher persists the vBuckets of its KVShard which map to its index
+ * (see KVShard::getFlusherIndex()); a shard has one Flusher per read-write
+ * KVStore.
  */
 class Flusher {
 public:
-    Flusher(EPBucket* st, KVShard* k);
+    Flusher(EPBucket* st, KVShard* k, size_t index);
 
     ~Flusher();
 
@@ -56,6 +62,8 @@ public:
 
     const char * stateName() const;
 
+    void addStats(ADD_STAT add_stat, const void* cookie) const;
+
     void notifyFlushEvent(void) {
         // By setting pendingMutation to true we are guaranteeing that the given
         // flusher will iterate the entire vbuckets under its shard from the
@@ -67,6 +75,25 @@ public:
     }
     void setTaskId(size_t newId) { taskId = newId; }
 
+    size_t getIndex() const {
+        return index;
+    }
+
+    /// @returns the number of flushes which persisted at least one item.
+    size_t getNumFlushes() const {
+        return numFlushes;
+    }
+
+    /// @returns the number of items persisted by this flusher.
+    size_t getItemsFlushed() const {
+        return itemsFlushed;
+    }
+
+    /// @returns the number of group commit syncs made by this flusher.
+    size_t getGroupSyncs() const {
+        return groupSyncs;
+    }
+
 private:
     enum class State {
         Initializing,
@@ -80,6 +107,9 @@ private:
     bool transitionState(State to);
     bool validTransition(State to) const;
     void flushVB();
+    bool flushOne(Vbid vbid);
+    void syncFlushed();
+    bool isOwnVBucket(Vbid vbid) const;
     void completeFlush();
     void initialize();
     void schedule_UNLOCKED();
@@ -108,6 +138,15 @@ private:
     std::atomic<bool> pendingMutation;
 
     KVShard *shard;
+    // Index of this flusher within its shard.
+    const size_t index;
+
+    std::atomic<size_t> numFlushes;
+    std::atomic<size_t> itemsFlushed;
+    std::atomic<size_t> groupSyncs;
+
+    // Group commit: vBuckets flushed (once per flush) since the last sync.
+    std::vector<Vbid> unsyncedVbs;
 
     DISALLOW_COPY_AND_ASSIGN(Flusher);
 };
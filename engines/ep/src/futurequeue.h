@@ -22,35 +22,47 @@
  *
  * FutureQueue provides methods that allow a task's wakeTime to be mutated
  * whilst maintaining the priority ordering.
+ *
+ * The tasks are kept in a multimap ordered by wakeTime, plus an index from
+ * task id to the task's entries. Changing the wakeTime of a queued task
+ * (wake / snooze) is therefore O(log n), rather than a linear search and
+ * re-heapify of the whole queue.
+ *
+ * A task is ordered by the wakeTime it had when it was pushed or last
+ * updated through the queue; its wakeTime must not be changed directly while
+ * it is queued.
  */
 
 #pragma once
 
-#include <algorithm>
 #include <chrono>
+#include <map>
 #include <mutex>
-#include <queue>
+#include <string>
+#include <unordered_map>
 
 #include "globaltask.h"
 
-template <class C = std::deque<ExTask>,
-          class Compare = CompareByDueDate>
 class FutureQueue {
 public:
 
     void push(ExTask task) {
         std::lock_guard<std::mutex> lock(queueMutex);
-        queue.push(task);
+        const auto id = task->getId();
+        const auto waketime = task->getWaketime();
+        index.emplace(id, queue.emplace(waketime, std::move(task)));
     }
 
     void pop() {
         std::lock_guard<std::mutex> lock(queueMutex);
-        queue.pop();
+        auto it = queue.begin();
+        eraseFromIndex(it);
+        queue.erase(it);
     }
 
     ExTask top() {
         std::lock_guard<std::mutex> lock(queueMutex);
-        return queue.top();
+        return queue.begin()->second;
     }
 
     size_t size() {
@@ -64,7 +76,7 @@ public:
     }
 
     /*
-     * Update the wakeTime of task and ensure the heap property is
+     * Update the wakeTime of task and ensure the ordering is
      * maintained.
      * @returns true if 'task' is in the FutureQueue.
      */
@@ -72,98 +84,104 @@ public:
                         std::chrono::steady_clock::time_point newTime) {
         std::lock_guard<std::mutex> lock(queueMutex);
         task->updateWaketime(newTime);
-        // After modifiying the task's wakeTime, rebuild the heap
-        return queue.heapify(task);
+        return requeue(task);
     }
 
     /*
      * snooze the task (by altering its wakeTime) and ensure the
-     * heap property is maintained.
+     * ordering is maintained.
      * @returns true if 'task' is in the FutureQueue.
      */
     bool snooze(const ExTask& task, const double secs) {
         std::lock_guard<std::mutex> lock(queueMutex);
         task->snooze(secs);
-        // After modifiying the task's wakeTime, rebuild the heap
-        return queue.heapify(task);
+        return requeue(task);
     }
 
     /**
-     * Checks that the invariants of the future queue are valid.
+     * Checks that the invariants of the future queue are valid (every task
+     * is queued by its current wakeTime and is in the index).
      * If not then throws std::logic_error.
      */
     void assertInvariants() {
-        return queue.verifyHeapProperty();
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (it->first != it->second->getWaketime() || !isIndexed(it)) {
+                throwInvariantBroken(it);
+            }
+        }
+        if (index.size() != queue.size()) {
+            throw std::logic_error(
+                    "FutureQueue::assertInvariants() - index has " +
+                    std::to_string(index.size()) + " entries, queue has " +
+                    std::to_string(queue.size()));
+        }
     }
 
 protected:
+    using Queue = std::multimap<std::chrono::steady_clock::time_point, ExTask>;
+    using Index = std::unordered_multimap<size_t, Queue::iterator>;
 
     /*
-     * HeapifiableQueue exposes a method to maintain the heap ordering
-     * of the underlying queue.
-     *
-     * This class is deliberately hidden inside FutureQueue so that any
-     * extensions made to priority_queue can't be accessed without work.
-     * I.e. correct locking and any need to 'heapify'.
+     * Move each entry of task to its (new) wakeTime.
+     * @returns true if 'task' is in the queue.
      */
-    class HeapifiableQueue : public std::priority_queue<ExTask, C, Compare> {
-    public:
-        /*
-         * Ensure the heap property is maintained
-         * @returns true if 'task' is in the queue and heapify() did something.
-         */
-        bool heapify(const ExTask& task) {
-            // if the task exists, rebuild
-            if (exists(task)) {
-                if (this->c.back()->getId() == task->getId()) {
-                    std::push_heap(this->c.begin(),
-                                   this->c.end(),
-                                   this->comp);
-                } else {
-                    std::make_heap(this->c.begin(),
-                                   this->c.end(),
-                                   this->comp);
-                }
-                return true;
-            } else {
-                return false;
+    bool requeue(const ExTask& task) {
+        auto range = index.equal_range(task->getId());
+        if (range.first == range.second) {
+            return false;
+        }
+        const auto waketime = task->getWaketime();
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second->first != waketime) {
+                auto entry = std::move(it->second->second);
+                queue.erase(it->second);
+                it->second = queue.emplace(waketime, std::move(entry));
             }
         }
+        return true;
+    }
 
-        void verifyHeapProperty() {
-            auto heap_end = std::is_heap_until(
-                    this->c.begin(), this->c.end(), this->comp);
-            if (heap_end != this->c.end()) {
-                std::string msg;
-                msg += "FutureQueue::verifyHeapProperty() - heap invariant "
-                       "broken. First non-heap is task:" +
-                       (*heap_end)->getDescription() + " wake:" +
-                       std::to_string(
-                               to_ns_since_epoch((*heap_end)->getWaketime())
-                                       .count()) +
-                       "\nAll items:\n";
-
-                for (auto& task : this->c) {
-                    msg += "\t task:" + task->getDescription() + " wake:" +
-                           std::to_string(to_ns_since_epoch(task->getWaketime())
-                                                  .count()) +
-                           "\n";
-                }
-                throw std::logic_error(msg);
+    void eraseFromIndex(Queue::iterator entry) {
+        auto range = index.equal_range(entry->second->getId());
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == entry) {
+                index.erase(it);
+                return;
             }
         }
+    }
 
-    protected:
-        bool exists(const ExTask& task) {
-            return std::find_if(this->c.begin(),
-                                this->c.end(),
-                                [&task](const ExTask& qTask) {
-                                    return task->getId() == qTask->getId();
-                                }) != this->c.end();
+    bool isIndexed(Queue::iterator entry) {
+        auto range = index.equal_range(entry->second->getId());
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == entry) {
+                return true;
+            }
         }
+        return false;
+    }
 
-    } queue;
+    void throwInvariantBroken(Queue::iterator entry) {
+        std::string msg;
+        msg += "FutureQueue::assertInvariants() - invariant broken. First "
+               "bad entry is task:" +
+               entry->second->getDescription() + " queued at wake:" +
+               std::to_string(to_ns_since_epoch(entry->first).count()) +
+               "\nAll items:\n";
+
+        for (auto& item : queue) {
+            msg += "\t task:" + item.second->getDescription() + " wake:" +
+                   std::to_string(
+                           to_ns_since_epoch(item.second->getWaketime())
+                                   .count()) +
+                   "\n";
+        }
+        throw std::logic_error(msg);
+    }
 
-    // All access to queue must be done with the queueMutex
+    // All access to queue and index must be done with the queueMutex
+    Queue queue;
+    Index index;
     std::mutex queueMutex;
 };
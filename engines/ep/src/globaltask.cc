@@ -18,8 +18,11 @@
 #include <limits.h>
 
 #include "ep_engine.h"
+#include "executorpool.h"
 #include "globaltask.h"
 
+#include <algorithm>
+
 // These static_asserts previously were in priority_test.cc
 static_assert(TaskPriority::VKeyStatBGFetchTask < TaskPriority::FlusherTask,
               "VKeyStatBGFetchTask not less than FlusherTask");
@@ -29,6 +32,8 @@ static_assert(TaskPriority::ItemPager < TaskPriority::BackfillManagerTask,
 
 std::atomic<size_t> GlobalTask::task_id_counter(1);
 
+const size_t GlobalTask::MaxWorkBudgetDivisor;
+
 GlobalTask::GlobalTask(Taskable& t,
                        TaskId taskId,
                        double sleeptime,
@@ -78,6 +83,15 @@ void GlobalTask::wakeUp() {
     updateWaketime(std::chrono::steady_clock::now());
 }
 
+std::chrono::steady_clock::time_point GlobalTask::getWorkBudgetDeadline(
+        std::chrono::milliseconds chunkDuration) const {
+    const size_t waiting =
+            ExecutorPool::get()->getNumReadyTasks(getTaskType(taskId));
+    const auto divisor = std::min(waiting + 1, MaxWorkBudgetDivisor);
+    return std::chrono::steady_clock::now() +
+           std::chrono::microseconds(chunkDuration) / divisor;
+}
+
 /*
  * Generate a switch statement from tasks.def.h that maps TaskId to a
  * stringified value of the task's name.
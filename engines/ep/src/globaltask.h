@@ -256,6 +256,26 @@ protected:
      */
     void wakeUp();
 
+    /**
+     * Work budget for the next chunk of a task which works through a large
+     * amount of data in chunks (such as a bucket visit with
+     * PauseResumeVBAdapter), yielding the thread in between.
+     *
+     * The budget is the given chunk duration, divided between this task and
+     * the tasks of the same type currently waiting for a thread - so a big
+     * sweep gets its full chunk when the threads are quiet, and steps aside
+     * sooner when it would hold up other tasks. It never drops below
+     * 1 / MaxWorkBudgetDivisor of the chunk duration, so the sweep still
+     * makes progress.
+     *
+     * @param chunkDuration the configured duration of a chunk
+     * @return the deadline for the chunk started now
+     */
+    std::chrono::steady_clock::time_point getWorkBudgetDeadline(
+            std::chrono::milliseconds chunkDuration) const;
+
+    static const size_t MaxWorkBudgetDivisor = 8;
+
     /**
      * We are using a int64_t as opposed to ProcessTime::time_point because we
      * want the access to be atomic without the use of a mutex. The reason for
@@ -25,7 +25,14 @@
 #include <platform/compress.h>
 
 #include <logtags.h>
+#include <algorithm>
 #include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
 
 static const ssize_t prime_size_table[] = {
     3, 7, 13, 23, 47, 97, 193, 383, 769, 1531, 3079, 6143, 12289, 24571, 49157,
@@ -57,6 +64,17 @@ static const ssize_t prime_size_table[] = {
  */
 static const double freqCounterIncFactor = 0.012;
 
+/**
+ * Issue a (non-faulting) prefetch of the cache line containing addr.
+ */
+static inline void prefetchAddress(const void* addr) {
+#if defined(_MSC_VER)
+    _mm_prefetch(static_cast<const char*>(addr), _MM_HINT_T0);
+#else
+    __builtin_prefetch(addr);
+#endif
+}
+
 
 std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
     os << "{lock:" << pos.lock << " bucket:" << pos.hash_bucket << "/" << pos.ht_size << "}";
@@ -66,19 +84,34 @@ std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
 HashTable::HashTable(EPStats& st,
                      std::unique_ptr<AbstractStoredValueFactory> svFactory,
                      size_t initialSize,
-                     size_t locks)
+                     size_t locks,
+                     Layout layout,
+                     ReadLockMode readLockMode,
+                     const LargeArrayPolicy& arrayPolicy)
     : initialSize(initialSize),
       size(initialSize),
+      values(table_type::allocator_type(arrayPolicy)),
+      layout(layout),
+      groups(group_table_type::allocator_type(arrayPolicy)),
+      oldValues(table_type::allocator_type(arrayPolicy)),
       mutexes(locks),
+      readLockMode(readLockMode),
       stats(st),
       valFact(std::move(svFactory)),
       visitors(0),
-      valueStats(stats),
+      valueStats(stats, mutexes),
       numEjects(0),
       numResizes(0),
       maxDeletedRevSeqno(0),
       probabilisticCounter(freqCounterIncFactor) {
     values.resize(size);
+    if (layout == Layout::Grouped) {
+        groups.resize(size);
+    }
+    for (auto& mutex : mutexes) {
+        mutex.shared = (readLockMode == ReadLockMode::Shared);
+        mutex.profile = &stats.lockProfiles.hashTable;
+    }
     activeState = true;
 }
 
@@ -92,6 +125,52 @@ HashTable::~HashTable() {
     }
 }
 
+HashTable::Layout HashTable::layoutFromString(const std::string& str) {
+    if (str == "chained") {
+        return Layout::Chained;
+    }
+    if (str == "grouped") {
+        return Layout::Grouped;
+    }
+    throw std::invalid_argument("HashTable::layoutFromString: unknown layout:" +
+                                str);
+}
+
+HashTable::ReadLockMode HashTable::readLockModeFromString(
+        const std::string& str) {
+    if (str == "exclusive") {
+        return ReadLockMode::Exclusive;
+    }
+    if (str == "shared") {
+        return ReadLockMode::Shared;
+    }
+    throw std::invalid_argument(
+            "HashTable::readLockModeFromString: unknown mode:" + str);
+}
+
+void HashTable::unlocked_refreshGroup(size_t bucketNum) {
+    // Buckets of the old table (during an incremental resize) have no group.
+    if (layout != Layout::Grouped || bucketNum >= size) {
+        return;
+    }
+    auto& group = groups[bucketNum];
+    group.count = 0;
+    group.overflow = false;
+    for (auto* link = &values[bucketNum]; *link; link = &(*link)->getNext()) {
+        if (group.count == BucketGroup::capacity) {
+            group.overflow = true;
+            break;
+        }
+        StoredValue* v = link->get().get();
+        // Reuse the link's tag if it has one, to avoid re-hashing the key.
+        const auto linkTag = link->get().getTag();
+        group.ptrs[group.count] = v;
+        group.tags[group.count] =
+                linkTag ? linkTag : tagForHash(v->getKey().hash());
+        ++group.count;
+    }
+}
+
 void HashTable::cleanupIfTemporaryItem(const HashBucketLock& hbl,
                                        StoredValue& v) {
     if (v.isTempDeletedItem() || v.isTempNonExistentItem()) {
@@ -107,7 +186,7 @@ void HashTable::clear(bool deactivate) {
                     "non-active object");
         }
     }
-    MultiLockHolder mlh(mutexes);
+    MultiLockHolder<BucketMutex> mlh(mutexes);
     clear_UNLOCKED(deactivate);
 }
 
@@ -115,23 +194,157 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
     if (deactivate) {
         setActiveState(false);
     }
+    negativeKeyCache.clear();
+    size_t cursor = 0;
+    releaseChains_UNLOCKED(cursor, std::numeric_limits<size_t>::max());
+    releaseCursor = 0;
+
+    if (isResizing()) {
+        // Nothing left to migrate; complete the resize.
+        stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+        oldValues = table_type(values.get_allocator());
+        oldSize.store(0);
+        resizeCursors.clear();
+        ++numResizes;
+        stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+    }
+
+    if (collectionIndex) {
+        std::lock_guard<std::mutex> lg(collectionIndex->mutex);
+        collectionIndex->collections.clear();
+    }
+
+    valueStats.reset();
+}
+
+std::pair<size_t, size_t> HashTable::releaseChains_UNLOCKED(size_t& cursor,
+                                                            size_t limit) {
+    size_t clearedItems = 0;
     size_t clearedMemSize = 0;
     size_t clearedValSize = 0;
-    for (int i = 0; i < (int)size; i++) {
-        while (values[i]) {
+    const auto& memChanged = valueStats.getMemChangedCallback();
+    std::unordered_map<CollectionID, int64_t> clearedByCollection;
+    // Includes the buckets of the old table if an incremental resize is in
+    // progress.
+    const size_t numBuckets = size + oldSize;
+    while (cursor < numBuckets && clearedItems < limit) {
+        auto& chain = unlocked_chain(cursor);
+        while (chain && clearedItems < limit) {
             // Take ownership of the StoredValue from the vector, update
             // statistics and release it.
-            auto v = std::move(values[i]);
+            auto v = std::move(chain);
+            summariseRemovedCas(*v.get().get());
+            ++clearedItems;
             clearedMemSize += v->size();
             clearedValSize += v->valuelen();
-            values[i] = std::move(v->getNext());
+            if (memChanged) {
+                clearedByCollection[v->getKey().getCollectionID()] -=
+                        static_cast<int64_t>(v->size());
+            }
+            chain = std::move(v->getNext());
         }
+        unlocked_refreshGroup(cursor);
+        if (chain) {
+            break;
+        }
+        ++cursor;
     }
 
     stats.coreLocal.get()->currentSize.fetch_sub(clearedMemSize -
                                                  clearedValSize);
+    for (const auto& cleared : clearedByCollection) {
+        memChanged(cleared.first, cleared.second);
+    }
+    return {clearedItems, clearedMemSize};
+}
 
-    valueStats.reset();
+std::pair<bool, size_t> HashTable::releaseItems(size_t limit) {
+    MultiLockHolder<BucketMutex> mlh(mutexes);
+    setActiveState(false);
+    const auto released = releaseChains_UNLOCKED(releaseCursor, limit);
+    if (releaseCursor < size + oldSize) {
+        return {true, released.second};
+    }
+    // Every item is freed; reset everything else (stats, indexes).
+    clear_UNLOCKED(true);
+    return {false, released.second};
+}
+
+void HashTable::enableCollectionIndex() {
+    if (getNumItems() != 0 || getNumTempItems() != 0) {
+        throw std::logic_error(
+                "HashTable::enableCollectionIndex: HashTable is not empty");
+    }
+    collectionIndex = std::make_unique<CollectionIndex>();
+}
+
+void HashTable::enableRemovedCasSummary(size_t slots, uint64_t maxCas) {
+    if (getNumItems() != 0 || getNumTempItems() != 0) {
+        throw std::logic_error(
+                "HashTable::enableRemovedCasSummary: HashTable is not empty");
+    }
+    removedCas = std::make_unique<std::atomic<uint64_t>[]>(slots);
+    for (size_t ii = 0; ii < slots; ++ii) {
+        removedCas[ii].store(maxCas);
+    }
+    removedCasSlots = slots;
+}
+
+uint64_t HashTable::getRemovedCasBound(const DocKey& key) const {
+    if (removedCasSlots == 0) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return removedCas[key.hash() % removedCasSlots].load();
+}
+
+void HashTable::summariseRemovedCas(const StoredValue& v) {
+    if (removedCasSlots != 0) {
+        atomic_setIfBigger(removedCas[v.getKey().hash() % removedCasSlots],
+                           v.getCas());
+    }
+}
+
+std::vector<StoredDocKey> HashTable::getCollectionKeys(
+        CollectionID collection) const {
+    if (!collectionIndex) {
+        throw std::logic_error(
+                "HashTable::getCollectionKeys: collection index is not "
+                "enabled");
+    }
+
+    std::vector<StoredDocKey> keys;
+    std::lock_guard<std::mutex> lg(collectionIndex->mutex);
+    const auto itr = collectionIndex->collections.find(collection);
+    if (itr != collectionIndex->collections.end()) {
+        keys.reserve(itr->second.size());
+        for (const auto* v : itr->second) {
+            keys.emplace_back(v->getKey());
+        }
+    }
+    return keys;
+}
+
+void HashTable::indexCollectionItem(const StoredValue* v) {
+    if (!collectionIndex) {
+        return;
+    }
+    std::lock_guard<std::mutex> lg(collectionIndex->mutex);
+    collectionIndex->collections[v->getKey().getCollectionID()].insert(v);
+}
+
+void HashTable::unindexCollectionItem(const StoredValue* v) {
+    if (!collectionIndex) {
+        return;
+    }
+    std::lock_guard<std::mutex> lg(collectionIndex->mutex);
+    auto& collections = collectionIndex->collections;
+    const auto itr = collections.find(v->getKey().getCollectionID());
+    if (itr != collections.end()) {
+        itr->second.erase(v);
+        if (itr->second.empty()) {
+            collections.erase(itr);
+        }
+    }
 }
 
 static size_t distance(size_t a, size_t b) {
@@ -147,10 +360,16 @@ static bool isCurrently(size_t size, ssize_t a, ssize_t b) {
     return (current == a || current == b);
 }
 
-void HashTable::resize() {
-    size_t ni = getNumInMemoryItems();
+size_t HashTable::getTargetSize(size_t alignment) const {
+    return getTargetSize(alignment, getNumInMemoryItems());
+}
+
+size_t HashTable::getTargetSize(size_t alignment, size_t ni) const {
+    auto align = [alignment](size_t s) {
+        return ((s + alignment - 1) / alignment) * alignment;
+    };
+
     int i(0);
-    size_t new_size(0);
 
     // Figure out where in the prime table we are.
     ssize_t target(static_cast<ssize_t>(ni));
@@ -160,22 +379,25 @@ void HashTable::resize() {
 
     if (prime_size_table[i] == -1) {
         // We're at the end, take the biggest
-        new_size = prime_size_table[i-1];
+        return align(prime_size_table[i - 1]);
     } else if (prime_size_table[i] < static_cast<ssize_t>(initialSize)) {
         // Was going to be smaller than the initial size.
-        new_size = initialSize;
+        return align(initialSize);
     } else if (0 == i) {
-        new_size = prime_size_table[i];
-    }else if (isCurrently(size, prime_size_table[i-1], prime_size_table[i])) {
+        return align(prime_size_table[i]);
+    } else if (isCurrently(size,
+                           align(prime_size_table[i - 1]),
+                           align(prime_size_table[i]))) {
         // If one of the candidate sizes is the current size, maintain
         // the current size in order to remain stable.
-        new_size = size;
-    } else {
-        // Somewhere in the middle, use the one we're closer to.
-        new_size = nearest(ni, prime_size_table[i-1], prime_size_table[i]);
+        return size;
     }
+    // Somewhere in the middle, use the one we're closer to.
+    return align(nearest(ni, prime_size_table[i - 1], prime_size_table[i]));
+}
 
-    resize(new_size);
+void HashTable::resize() {
+    resize(getTargetSize(1));
 }
 
 void HashTable::resize(size_t newSize) {
@@ -198,43 +420,205 @@ void HashTable::resize(size_t newSize) {
     TRACE_EVENT2(
             "HashTable", "resize", "size", size.load(), "newSize", newSize);
 
-    MultiLockHolder mlh(mutexes);
-    if (visitors.load() > 0) {
+    MultiLockHolder<BucketMutex> mlh(mutexes);
+    if (visitors.load() > 0 || isResizing()) {
         // Do not allow a resize while any visitors are actually
         // processing.  The next attempt will have to pick it up.  New
         // visitors cannot start doing meaningful work (we own all
-        // locks at this point).
+        // locks at this point). Similarly an incremental resize which is
+        // in progress must be allowed to complete.
         return;
     }
 
-    // Get a place for the new items.
-    table_type newValues(newSize);
-
     stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
     ++numResizes;
 
-    // Set the new size so all the hashy stuff works.
-    size_t oldSize = size;
+    // Swap in a place for the new items, and set the new size so all the
+    // hashy stuff works.
+    table_type previous(newSize, values.get_allocator());
+    previous.swap(values);
     size.store(newSize);
+    if (layout == Layout::Grouped) {
+        groups.assign(newSize, BucketGroup());
+    }
 
     // Move existing records into the new space.
-    for (size_t i = 0; i < oldSize; i++) {
-        while (values[i]) {
-            // unlink the front element from the hash chain at values[i].
-            auto v = std::move(values[i]);
-            values[i] = std::move(v->getNext());
+    for (auto& chain : previous) {
+        unlocked_rehashChain(chain);
+    }
 
-            // And re-link it into the correct place in newValues.
-            int newBucket = getBucketForHash(v->getKey().hash());
-            v->setNext(std::move(newValues[newBucket]));
-            newValues[newBucket] = std::move(v);
-        }
+    stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+}
+
+void HashTable::reserve(size_t numItems) {
+    const auto target = getTargetSize(1, numItems);
+    if (target > size) {
+        resize(target);
+    }
+}
+
+bool HashTable::startIncrementalResize() {
+    return startIncrementalResize(getTargetSize(mutexes.size()));
+}
+
+bool HashTable::startIncrementalResize(size_t newSize) {
+    if (!isActive()) {
+        throw std::logic_error(
+                "HashTable::startIncrementalResize: Cannot call on a "
+                "non-active object");
     }
 
-    // Finally assign the new table to values.
-    values = std::move(newValues);
+    const size_t numLocks = mutexes.size();
+    newSize = ((newSize + numLocks - 1) / numLocks) * numLocks;
+
+    // Due to the way hashing works, we can't fit anything larger than
+    // an int.
+    if (newSize > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        return isResizing();
+    }
+
+    if (newSize == size || isResizing()) {
+        return isResizing();
+    }
+
+    if (size % numLocks != 0) {
+        // Keys would not be guarded by the same lock in the current and new
+        // tables, so cannot migrate incrementally. Perform a one-off
+        // blocking resize; after which the size will be suitably aligned.
+        resize(newSize);
+        return false;
+    }
+
+    TRACE_EVENT2("HashTable",
+                 "startIncrementalResize",
+                 "size",
+                 size.load(),
+                 "newSize",
+                 newSize);
+
+    // Allocate the new table before acquiring the locks, so they are only
+    // held for long enough to swap it in.
+    table_type newValues(newSize, values.get_allocator());
+    group_table_type newGroups(layout == Layout::Grouped ? newSize : 0,
+                               groups.get_allocator());
+
+    MultiLockHolder<BucketMutex> mlh(mutexes);
+    if (visitors.load() > 0 || isResizing()) {
+        // As per resize(); the next attempt will have to pick it up.
+        return isResizing();
+    }
+
+    stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+
+    oldValues.swap(values);
+    oldSize.store(size);
+    values.swap(newValues);
+    groups.swap(newGroups);
+    size.store(newSize);
+
+    // Initially no buckets have been migrated; the first old bucket of each
+    // lock L is bucket L.
+    resizeCursors.resize(numLocks);
+    for (size_t lock = 0; lock < numLocks; ++lock) {
+        resizeCursors[lock] = lock;
+    }
+    resizeLock = 0;
 
     stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+    return true;
+}
+
+bool HashTable::incrementalResizeStep(size_t numBuckets) {
+    const size_t numLocks = mutexes.size();
+    {
+        // Holding mutexes[0] prevents any visitor from starting (see
+        // pauseResumeVisit()) while we migrate.
+        std::unique_lock<BucketMutex> firstLock(mutexes[0]);
+        if (!isResizing()) {
+            return true;
+        }
+        if (visitors.load() > 0) {
+            return false;
+        }
+        if (resizeLock < numLocks) {
+            std::unique_lock<BucketMutex> lockBeingMigrated;
+            if (resizeLock != 0) {
+                lockBeingMigrated = std::unique_lock<BucketMutex>(
+                        mutexes[resizeLock]);
+            }
+
+            auto& cursor = resizeCursors[resizeLock];
+            for (size_t migrated = 0;
+                 migrated < std::max(numBuckets, size_t(1)) &&
+                 cursor < oldSize;
+                 ++migrated) {
+                unlocked_rehashChain(oldValues[cursor]);
+                cursor += numLocks;
+            }
+
+            if (cursor < oldSize) {
+                return true;
+            }
+            // All of this lock's old buckets have been migrated; move onto
+            // the next lock.
+            ++resizeLock;
+            if (resizeLock < numLocks) {
+                return true;
+            }
+        }
+    }
+
+    // All buckets migrated - discard the old table. The old table is moved
+    // out under the locks, but freed after they have been released.
+    table_type emptied(values.get_allocator());
+    {
+        MultiLockHolder<BucketMutex> mlh(mutexes);
+        if (!isResizing()) {
+            return true;
+        }
+        stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+        emptied.swap(oldValues);
+        oldSize.store(0);
+        resizeCursors.clear();
+        ++numResizes;
+        stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+    }
+    return true;
+}
+
+size_t HashTable::unlocked_bucketForHash(int h) {
+    const size_t newBucket = getBucketForHash(h);
+    if (!isResizing()) {
+        return newBucket;
+    }
+    const size_t oldBucket = abs(h % static_cast<int>(oldSize));
+    if (oldBucket < resizeCursors[oldBucket % mutexes.size()]) {
+        return newBucket;
+    }
+    return size + oldBucket;
+}
+
+void HashTable::unlocked_rehashChain(StoredValue::UniquePtr& chain) {
+    // Reverse the chain first, so pushing each element onto the head of its
+    // new bucket preserves their original relative order.
+    StoredValue::UniquePtr reversed;
+    while (chain) {
+        auto v = std::move(chain);
+        chain = std::move(v->getNext());
+        v->setNext(std::move(reversed));
+        reversed = std::move(v);
+    }
+
+    while (reversed) {
+        auto v = std::move(reversed);
+        reversed = std::move(v->getNext());
+
+        // And re-link it into the correct place in values.
+        int newBucket = getBucketForHash(v->getKey().hash());
+        v->setNext(std::move(values[newBucket]));
+        values[newBucket] = std::move(v);
+        unlocked_refreshGroup(newBucket);
+    }
 }
 
 HashTable::FindResult HashTable::find(const DocKey& key,
@@ -252,19 +636,32 @@ HashTable::FindResult HashTable::find(const DocKey& key,
 }
 
 std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
+    auto items = getRandomKeys(rnd, 1);
+    if (items.empty()) {
+        return nullptr;
+    }
+    return std::move(items.front());
+}
+
+std::vector<std::unique_ptr<Item>> HashTable::getRandomKeys(long rnd,
+                                                            size_t count) {
+    std::vector<std::unique_ptr<Item>> items;
     /* Try to locate a partition */
-    size_t start = rnd % size;
+    const size_t numBuckets = size + oldSize;
+    size_t start = rnd % numBuckets;
     size_t curr = start;
-    std::unique_ptr<Item> ret;
 
     do {
-        ret = getRandomKeyFromSlot(curr++);
-        if (curr == size) {
+        auto item = getRandomKeyFromSlot(curr++);
+        if (item) {
+            items.push_back(std::move(item));
+        }
+        if (curr == numBuckets) {
             curr = 0;
         }
-    } while (ret == NULL && curr != start);
+    } while (items.size() < count && curr != start);
 
-    return ret;
+    return items;
 }
 
 MutationStatus HashTable::set(Item& val) {
@@ -317,7 +714,7 @@ HashTable::UpdateResult HashTable::unlocked_updateStoredValue(
         v.setValue(itm);
         updateFreqCounter(v);
 
-        valueStats.epilogue(preProps, &v);
+        valueStats.epilogue(hbl.getHTLock(), preProps, &v);
 
         return {status, &v};
     }
@@ -340,15 +737,25 @@ StoredValue* HashTable::unlocked_addNewStoredValue(const HashBucketLock& hbl,
                 "call on a non-active HT object");
     }
 
+    // The key may now have a document.
+    negativeKeyCache.erase(itm.getKey());
+
     const auto emptyProperties = valueStats.prologue(nullptr);
 
     // Create a new StoredValue and link it into the head of the bucket chain.
-    auto v = (*valFact)(itm, std::move(values[hbl.getBucketNum()]));
-
-    valueStats.epilogue(emptyProperties, v.get().get());
-
-    values[hbl.getBucketNum()] = std::move(v);
-    return values[hbl.getBucketNum()].get().get();
+    const auto bucketNum = unlocked_bucketForKey(hbl, itm.getKey());
+    auto& chain = unlocked_chain(bucketNum);
+    auto v = (*valFact)(itm, std::move(chain));
+    tagLink(v, tagForHash(itm.getKey().hash()));
+    // The item's frequency counter is current.
+    v.get().get()->setFreqDecayEpoch(getFreqDecayEpoch());
+
+    valueStats.epilogue(hbl.getHTLock(), emptyProperties, v.get().get());
+    indexCollectionItem(v.get().get());
+
+    chain = std::move(v);
+    unlocked_refreshGroup(bucketNum);
+    return chain.get().get();
 }
 
 HashTable::Statistics::StoredValueProperties::StoredValueProperties(
@@ -367,6 +774,7 @@ HashTable::Statistics::StoredValueProperties::StoredValueProperties(
     isResident = sv->isResident();
     isDeleted = sv->isDeleted();
     isTempItem = sv->isTempItem();
+    collection = sv->getKey().getCollectionID();
 }
 
 HashTable::Statistics::StoredValueProperties HashTable::Statistics::prologue(
@@ -374,26 +782,37 @@ HashTable::Statistics::StoredValueProperties HashTable::Statistics::prologue(
     return StoredValueProperties(v);
 }
 
-void HashTable::Statistics::epilogue(StoredValueProperties pre,
-                                     const StoredValue* v) {
+void HashTable::Statistics::epilogue(
+        const std::unique_lock<BucketMutex>& htLock,
+        StoredValueProperties pre,
+        const StoredValue* v) {
+    if (!htLock) {
+        throw std::invalid_argument(
+                "HashTable::Statistics::epilogue: htLock not held");
+    }
     // After performing updates to sv; compare with the previous properties and
     // update all statistics for all properties which have changed.
+    auto& stripe = htLock.mutex()->statsStripe;
 
     const auto post = StoredValueProperties(v);
 
     // Update size, metadataSize & uncompressed size if pre/post differ.
     if (pre.size != post.size) {
-        cacheSize.fetch_add(post.size - pre.size);
-        memSize.fetch_add(post.size - pre.size);
+        StatisticsStripe::add(stripe.memSize, post.size - pre.size);
+        if (memChangedCallback) {
+            memChangedCallback(post.isValid ? post.collection : pre.collection,
+                               post.size - pre.size);
+        }
     }
     if (pre.metaDataSize != post.metaDataSize) {
-        metaDataMemory.fetch_add(post.metaDataSize - pre.metaDataSize);
+        StatisticsStripe::add(stripe.metaDataMemory,
+                              post.metaDataSize - pre.metaDataSize);
         epStats.coreLocal.get()->currentSize.fetch_add(post.metaDataSize -
                                                        pre.metaDataSize);
     }
     if (pre.uncompressedSize != post.uncompressedSize) {
-        uncompressedMemSize.fetch_add(post.uncompressedSize -
-                                      pre.uncompressedSize);
+        StatisticsStripe::add(stripe.uncompressedMemSize,
+                              post.uncompressedSize - pre.uncompressedSize);
     }
 
     // Determine if valid, non resident; and update numNonResidentItems if
@@ -404,41 +823,75 @@ void HashTable::Statistics::epilogue(StoredValueProperties pre,
             post.isValid &&
             (!post.isResident && !post.isDeleted && !post.isTempItem);
     if (preNonResident != postNonResident) {
-        numNonResidentItems.fetch_add(postNonResident - preNonResident);
+        StatisticsStripe::add(stripe.numNonResidentItems,
+                              postNonResident - preNonResident);
     }
 
     if (pre.isTempItem != post.isTempItem) {
-        numTempItems.fetch_add(post.isTempItem - pre.isTempItem);
+        StatisticsStripe::add(stripe.numTempItems,
+                              post.isTempItem - pre.isTempItem);
     }
 
     // nonItems only considers valid; non-temporary items:
     bool preNonTemp = pre.isValid && !pre.isTempItem;
     bool postNonTemp = post.isValid && !post.isTempItem;
     if (preNonTemp != postNonTemp) {
-        numItems.fetch_add(postNonTemp - preNonTemp);
+        StatisticsStripe::add(stripe.numItems, postNonTemp - preNonTemp);
     }
 
     if (pre.isDeleted != post.isDeleted) {
-        numDeletedItems.fetch_add(post.isDeleted - pre.isDeleted);
+        StatisticsStripe::add(stripe.numDeletedItems,
+                              post.isDeleted - pre.isDeleted);
     }
 
     // Update datatypes. These are only tracked for non-temp, non-deleted items.
-    if (preNonTemp && !pre.isDeleted) {
-        --datatypeCounts[pre.datatype];
+    const bool preCounted = preNonTemp && !pre.isDeleted;
+    const bool postCounted = postNonTemp && !post.isDeleted;
+    if (preCounted && postCounted && pre.datatype == post.datatype) {
+        return;
+    }
+    if (preCounted) {
+        StatisticsStripe::add(stripe.datatypeCounts[pre.datatype], -1);
     }
-    if (postNonTemp && !post.isDeleted) {
-        ++datatypeCounts[post.datatype];
+    if (postCounted) {
+        StatisticsStripe::add(stripe.datatypeCounts[post.datatype], 1);
     }
 }
 
 void HashTable::Statistics::reset() {
-    datatypeCounts.fill(0);
-    numItems.store(0);
-    numTempItems.store(0);
-    numNonResidentItems.store(0);
-    memSize.store(0);
-    cacheSize.store(0);
-    uncompressedMemSize.store(0);
+    for (auto& mutex : mutexes) {
+        auto& stripe = mutex.statsStripe;
+        for (auto& count : stripe.datatypeCounts) {
+            count.store(0);
+        }
+        stripe.numItems.store(0);
+        stripe.numTempItems.store(0);
+        stripe.numNonResidentItems.store(0);
+        stripe.memSize.store(0);
+        stripe.uncompressedMemSize.store(0);
+    }
+}
+
+HashTable::DatatypeCombo HashTable::Statistics::getDatatypeCounts() const {
+    DatatypeCombo result = {};
+    for (size_t datatype = 0; datatype < result.size(); ++datatype) {
+        int64_t total = 0;
+        for (const auto& mutex : mutexes) {
+            total += mutex.statsStripe.datatypeCounts[datatype].load(
+                    std::memory_order_relaxed);
+        }
+        result[datatype] = static_cast<size_t>(std::max(total, int64_t(0)));
+    }
+    return result;
+}
+
+size_t HashTable::Statistics::sum(
+        StatisticsStripe::Count StatisticsStripe::*count) const {
+    int64_t total = 0;
+    for (const auto& mutex : mutexes) {
+        total += (mutex.statsStripe.*count).load(std::memory_order_relaxed);
+    }
+    return std::max(total, int64_t(0));
 }
 
 std::pair<StoredValue*, StoredValue::UniquePtr>
@@ -460,18 +913,65 @@ HashTable::unlocked_replaceByCopy(const HashBucketLock& hbl,
     auto releasedSv = unlocked_release(hbl, vToCopy.getKey());
 
     /* Copy the StoredValue and link it into the head of the bucket chain. */
-    auto newSv = valFact->copyStoredValue(
-            vToCopy, std::move(values[hbl.getBucketNum()]));
+    const auto bucketNum = unlocked_bucketForKey(hbl, releasedSv->getKey());
+    auto& chain = unlocked_chain(bucketNum);
+    auto newSv = valFact->copyStoredValue(vToCopy, std::move(chain));
+    tagLink(newSv, tagForHash(vToCopy.getKey().hash()));
 
     // Adding a new item into the HashTable; update stats.
     const auto emptyProperties = valueStats.prologue(nullptr);
-    valueStats.epilogue(emptyProperties, newSv.get().get());
+    valueStats.epilogue(hbl.getHTLock(), emptyProperties, newSv.get().get());
+    indexCollectionItem(newSv.get().get());
+
+    chain = std::move(newSv);
+    unlocked_refreshGroup(bucketNum);
+    return {chain.get().get(), std::move(releasedSv)};
+}
+
+std::pair<StoredValue*, StoredValue::UniquePtr>
+HashTable::unlocked_reallocateStoredValue(const HashBucketLock& hbl,
+                                          StoredValue& v) {
+    if (!hbl.getHTLock()) {
+        throw std::invalid_argument(
+                "HashTable::unlocked_reallocateStoredValue: htLock "
+                "not held");
+    }
+
+    if (!isActive()) {
+        throw std::invalid_argument(
+                "HashTable::unlocked_reallocateStoredValue: Cannot "
+                "call on a non-active HT object");
+    }
+
+    const auto bucketNum = unlocked_bucketForKey(hbl, v.getKey());
+    for (auto* link = &unlocked_chain(bucketNum); *link;
+         link = &(*link)->getNext()) {
+        if (link->get().get() != &v) {
+            continue;
+        }
 
-    values[hbl.getBucketNum()] = std::move(newSv);
-    return {values[hbl.getBucketNum()].get().get(), std::move(releasedSv)};
+        // Copy the StoredValue (taking over the rest of the chain) and swap
+        // it into the link, keeping the link's tag.
+        const auto preProps = valueStats.prologue(&v);
+        const auto tag = link->get().getTag();
+        auto newSv = valFact->copyStoredValue(v, std::move(v.getNext()));
+        tagLink(newSv, tag);
+        link->swap(newSv);
+        StoredValue* copy = link->get().get();
+        valueStats.epilogue(hbl.getHTLock(), preProps, copy);
+
+        unindexCollectionItem(&v);
+        indexCollectionItem(copy);
+        unlocked_refreshGroup(bucketNum);
+        return {copy, std::move(newSv)};
+    }
+
+    throw std::logic_error(
+            "HashTable::unlocked_reallocateStoredValue: StoredValue to be "
+            "reallocated not found in HashTable");
 }
 
-void HashTable::unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
+void HashTable::unlocked_softDelete(const std::unique_lock<BucketMutex>& htLock,
                                     StoredValue& v,
                                     bool onlyMarkDeleted,
                                     DeleteSource delSource) {
@@ -483,7 +983,7 @@ void HashTable::unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
         v.del(delSource);
     }
 
-    valueStats.epilogue(preProps, &v);
+    valueStats.epilogue(htLock, preProps, &v);
 }
 
 StoredValue* HashTable::unlocked_find(const DocKey& key,
@@ -491,35 +991,101 @@ StoredValue* HashTable::unlocked_find(const DocKey& key,
                                       WantsDeleted wantsDeleted,
                                       TrackReference trackReference,
                                       CommittedState perspective) {
-    for (StoredValue* v = values[bucket_num].get().get(); v;
-            v = v->getNext().get().get()) {
-        if (v->hasKey(key)) {
-            // When using Committed perspective; should only return Committed
-            // items.
-            if ((perspective == CommittedState::Committed) &&
-                (v->getCommitted() == CommittedState::Pending)) {
-                continue;
-            }
-            if (trackReference == TrackReference::Yes && !v->isDeleted()) {
-                updateFreqCounter(*v);
+    // Checks if the given candidate is the StoredValue being searched for.
+    // Returns true if the search is complete (with the result in `found`),
+    // or false if the search should continue with the next candidate.
+    auto checkCandidate = [&](StoredValue* v, StoredValue*& found) {
+        if (!v->hasKey(key)) {
+            return false;
+        }
+        // When using Committed perspective; should only return Committed
+        // items.
+        if ((perspective == CommittedState::Committed) &&
+            (v->getCommitted() == CommittedState::Pending)) {
+            return false;
+        }
+        if (trackReference == TrackReference::Yes && !v->isDeleted()) {
+            updateFreqCounter(*v);
 
-                // @todo remove the referenced call when eviction algorithm is
-                // updated to use the frequency counter value.
-                v->referenced();
-            }
-            if (wantsDeleted == WantsDeleted::Yes || !v->isDeleted()) {
-                return v;
-            } else {
-                return NULL;
+            // @todo remove the referenced call when eviction algorithm is
+            // updated to use the frequency counter value.
+            v->referenced();
+        }
+        if (wantsDeleted == WantsDeleted::Yes || !v->isDeleted()) {
+            found = v;
+        } else {
+            found = nullptr;
+        }
+        return true;
+    };
+
+    if (isResizing()) {
+        // The given bucket_num is that of the lock held; the key may still be
+        // in the old table.
+        bucket_num = unlocked_bucketForHash(key.hash());
+    }
+
+    StoredValue* found = nullptr;
+    const auto tag = tagForHash(key.hash());
+    StoredValue::UniquePtr* link = &unlocked_chain(bucket_num);
+    if (layout == Layout::Grouped && static_cast<size_t>(bucket_num) < size) {
+        // Only dereference the StoredValues whose tag matches; then continue
+        // down the chain if it's longer than the group.
+        const auto& group = groups[bucket_num];
+        for (size_t i = 0; i < group.count; ++i) {
+            if (group.tags[i] == tag && checkCandidate(group.ptrs[i], found)) {
+                return found;
             }
         }
+        if (!group.overflow) {
+            return nullptr;
+        }
+        link = &group.ptrs[BucketGroup::capacity - 1]->getNext();
+    }
+
+    for (; *link; link = &(*link)->getNext()) {
+        // Skip the key comparison if the link's tag shows it is for a
+        // different key.
+        const auto linkTag = link->get().getTag();
+        if (linkTag != 0 && linkTag != tag) {
+            continue;
+        }
+        if (checkCandidate(link->get().get(), found)) {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+void HashTable::prefetchBucket(const DocKey& key) {
+    const auto bucket = getBucketForHash(key.hash());
+    prefetchAddress(&mutexes[mutexForBucket(bucket)]);
+    prefetchAddress(values.data() + bucket);
+    if (layout == Layout::Grouped) {
+        prefetchAddress(groups.data() + bucket);
+    }
+}
+
+void HashTable::prefetchBucketSlot(size_t bucketNum) {
+    prefetchAddress(&unlocked_chain(bucketNum));
+    if (layout == Layout::Grouped && bucketNum < size) {
+        prefetchAddress(groups.data() + bucketNum);
     }
-    return NULL;
 }
 
 HashTable::FindROResult HashTable::findForRead(const DocKey& key,
                                                TrackReference trackReference,
                                                WantsDeleted wantsDeleted) {
+    if (readLockMode == ReadLockMode::Shared &&
+        trackReference == TrackReference::No) {
+        HashBucketLock hbl = getSharedLockedBucketForHash(key.hash());
+        const auto* sv = unlocked_find(key,
+                                       hbl.getBucketNum(),
+                                       wantsDeleted,
+                                       TrackReference::No,
+                                       CommittedState::Committed);
+        return {sv, std::move(hbl)};
+    }
     auto result =
             find(key, trackReference, wantsDeleted, CommittedState::Committed);
     return {result.storedValue, std::move(result.lock)};
@@ -549,8 +1115,9 @@ StoredValue::UniquePtr HashTable::unlocked_release(
     }
 
     // Remove the first (should only be one) StoredValue with the given key.
+    const auto bucketNum = unlocked_bucketForKey(hbl, key);
     auto released = hashChainRemoveFirst(
-            values[hbl.getBucketNum()],
+            unlocked_chain(bucketNum),
             [key](const StoredValue* v) { return v->hasKey(key); });
 
     if (!released) {
@@ -560,10 +1127,13 @@ StoredValue::UniquePtr HashTable::unlocked_release(
                 "HashTable::unlocked_release: StoredValue to be released "
                 "not found in HashTable; possibly HashTable leak");
     }
+    unlocked_refreshGroup(bucketNum);
+    summariseRemovedCas(*released.get().get());
 
     // Update statistics for the item which is now gone.
     const auto preProps = valueStats.prologue(released.get().get());
-    valueStats.epilogue(preProps, nullptr);
+    valueStats.epilogue(hbl.getHTLock(), preProps, nullptr);
+    unindexCollectionItem(released.get().get());
 
     return released;
 }
@@ -586,7 +1156,7 @@ MutationStatus HashTable::insertFromWarmup(
         if (keyMetaDataOnly) {
             const auto preProps = valueStats.prologue(v);
             v->markNotResident();
-            valueStats.epilogue(preProps, v);
+            valueStats.epilogue(hbl.getHTLock(), preProps, v);
         }
         v->setNewCacheItem(false);
     } else {
@@ -629,13 +1199,29 @@ void HashTable::dump() const {
     std::cerr << *this << std::endl;
 }
 
-void HashTable::storeCompressedBuffer(cb::const_char_buffer buf,
+void HashTable::storeCompressedBuffer(const HashBucketLock& hbl,
+                                      cb::const_char_buffer buf,
                                       StoredValue& v) {
     const auto preProps = valueStats.prologue(&v);
 
     v.storeCompressedBuffer(buf);
 
-    valueStats.epilogue(preProps, &v);
+    valueStats.epilogue(hbl.getHTLock(), preProps, &v);
+}
+
+bool HashTable::unlocked_moveToTier(const HashBucketLock& hbl,
+                                    StoredValue& v,
+                                    ValueTier& tier) {
+    Blob* data = Blob::CopyToTier(*v.getValue(), tier);
+    if (!data) {
+        return false;
+    }
+    const auto preProps = valueStats.prologue(&v);
+
+    v.replaceValue(TaggedPtr<Blob>(data));
+
+    valueStats.epilogue(hbl.getHTLock(), preProps, &v);
+    return true;
 }
 
 void HashTable::visit(HashTableVisitor& visitor) {
@@ -645,6 +1231,32 @@ void HashTable::visit(HashTableVisitor& visitor) {
     }
 }
 
+void HashTable::visitRandomBucket(long rnd, HashTableVisitor& visitor) {
+    if (valueStats.getNumItems() == 0 || !isActive()) {
+        return;
+    }
+    // Register as a visitor so the table cannot be resized under us; see
+    // pauseResumeVisit().
+    std::unique_lock<BucketMutex> lh(mutexes[0]);
+    VisitorTracker vt(&visitors);
+    lh.unlock();
+
+    const size_t bucket = static_cast<size_t>(rnd) % (size + oldSize);
+    visitor.setUpHashBucketVisit();
+    {
+        auto hbl = getLockedBucket(static_cast<int>(bucket));
+        StoredValue* v = unlocked_chain(bucket).get().get();
+        while (v) {
+            StoredValue* next = v->getNext().get().get();
+            if (!visitor.visit(hbl, *v)) {
+                break;
+            }
+            v = next;
+        }
+    }
+    visitor.tearDownHashBucketVisit();
+}
+
 void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
     if (valueStats.getNumItems() == 0 || !isActive()) {
         return;
@@ -653,22 +1265,33 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
     // Acquire one (any) of the mutexes before incrementing {visitors}, this
     // prevents any race between this visitor and the HashTable resizer.
     // See comments in pauseResumeVisit() for further details.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    std::unique_lock<BucketMutex> lh(mutexes[0]);
     VisitorTracker vt(&visitors);
     lh.unlock();
 
-    for (int l = 0; l < static_cast<int>(mutexes.size()); l++) {
-        for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
+    // Includes the buckets of the old table if an incremental resize is in
+    // progress (which cannot advance while we are visiting).
+    const int numBuckets = static_cast<int>(size + oldSize);
+    const int numLocks = static_cast<int>(mutexes.size());
+    for (int l = 0; l < numLocks; l++) {
+        for (int i = l; i < numBuckets; i += numLocks) {
+            const int ahead =
+                    i + static_cast<int>(visitPrefetchDistance) * numLocks;
+            if (ahead < numBuckets) {
+                prefetchBucketSlot(ahead);
+            }
+
             // (re)acquire mutex on each HashBucket, to minimise any impact
             // on front-end threads.
-            LockHolder lh(mutexes[l]);
+            std::lock_guard<BucketMutex> lh(mutexes[l]);
 
             size_t depth = 0;
-            StoredValue* p = values[i].get().get();
+            StoredValue* p = unlocked_chain(i).get().get();
             if (p) {
                 // TODO: Perf: This check seems costly - do we think it's still
                 // worth keeping?
-                auto hashbucket = getBucketForHash(p->getKey().hash());
+                auto hashbucket = static_cast<int>(
+                        unlocked_bucketForHash(p->getKey().hash()));
                 if (i != hashbucket) {
                     throw std::logic_error("HashTable::visit: inconsistency "
                             "between StoredValue's calculated hashbucket "
@@ -679,9 +1302,13 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
             }
             size_t mem(0);
             while (p) {
+                StoredValue* next = p->getNext().get().get();
+                if (next) {
+                    prefetchAddress(next);
+                }
                 depth++;
                 mem += p->size();
-                p = p->getNext().get().get();
+                p = next;
             }
             visitor.visit(i, depth, mem);
             ++visited;
@@ -710,10 +1337,14 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
     // inside the inner for() loop. To prevent this race, we explicitly acquire
     // (any) mutex, increment {visitors} and then release the mutex. This
     //avoids the race as if visitors >0 then Resizer will not attempt to resize.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    std::unique_lock<BucketMutex> lh(mutexes[0]);
     VisitorTracker vt(&visitors);
     lh.unlock();
 
+    // Includes the buckets of the old table if an incremental resize is in
+    // progress (which cannot advance while we are visiting).
+    const size_t numBuckets = size + oldSize;
+
     // Start from the requested lock number if in range.
     size_t lock = (start_pos.lock < mutexes.size()) ? start_pos.lock : 0;
     size_t hash_bucket = 0;
@@ -724,15 +1355,27 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
         // recorded bucket (as long as we haven't resized).
         hash_bucket = lock;
         if (start_pos.lock == lock &&
-            start_pos.ht_size == size &&
-            start_pos.hash_bucket < size) {
+            start_pos.ht_size == numBuckets &&
+            start_pos.hash_bucket < numBuckets) {
             hash_bucket = start_pos.hash_bucket;
         }
 
         // Iterate across all values in the hash buckets owned by this lock.
         // Note: we don't record how far into the bucket linked-list we
         // pause at; so any restart will begin from the next bucket.
-        for (; !paused && hash_bucket < size; hash_bucket += mutexes.size()) {
+        for (; !paused && hash_bucket < numBuckets;
+             hash_bucket += mutexes.size()) {
+            // Prefetch pipeline: the slot of a bucket a few ahead is
+            // prefetched without the lock (its address is stable as we are
+            // a registered visitor); the head of the next bucket and the
+            // next element of the chain are prefetched under the lock, as
+            // all buckets visited by this loop share the same mutex.
+            const size_t ahead =
+                    hash_bucket + visitPrefetchDistance * mutexes.size();
+            if (ahead < numBuckets) {
+                prefetchBucketSlot(ahead);
+            }
+
             visitor.setUpHashBucketVisit();
 
             // HashBucketLock scope. If a visitor needs additional locking
@@ -741,9 +1384,20 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
             {
                 HashBucketLock lh(hash_bucket, mutexes[lock]);
 
-                StoredValue* v = values[hash_bucket].get().get();
+                const size_t nextBucket = hash_bucket + mutexes.size();
+                if (nextBucket < numBuckets) {
+                    StoredValue* head = unlocked_chain(nextBucket).get().get();
+                    if (head) {
+                        prefetchAddress(head);
+                    }
+                }
+
+                StoredValue* v = unlocked_chain(hash_bucket).get().get();
                 while (!paused && v) {
                     StoredValue* tmp = v->getNext().get().get();
+                    if (tmp) {
+                        prefetchAddress(tmp);
+                    }
                     paused = !visitor.visit(lh, *v);
                     v = tmp;
                 }
@@ -755,24 +1409,25 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
         // If the visitor paused us before we visited all hash buckets owned
         // by this lock, we don't want to skip the remaining hash buckets, so
         // stop the outer for loop from advancing to the next lock.
-        if (paused && hash_bucket < size) {
+        if (paused && hash_bucket < numBuckets) {
             break;
         }
 
-        // Finished all buckets owned by this lock. Set hash_bucket to 'size'
-        // to give a consistent marker for "end of lock".
-        hash_bucket = size;
+        // Finished all buckets owned by this lock. Set hash_bucket to
+        // 'numBuckets' to give a consistent marker for "end of lock".
+        hash_bucket = numBuckets;
     }
 
     // Return the *next* location that should be visited.
-    return HashTable::Position(size, lock, hash_bucket);
+    return HashTable::Position(numBuckets, lock, hash_bucket);
 }
 
 HashTable::Position HashTable::endPosition() const  {
-    return HashTable::Position(size, mutexes.size(), size);
+    const size_t numBuckets = size + oldSize;
+    return HashTable::Position(numBuckets, mutexes.size(), numBuckets);
 }
 
-bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
+bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock& hbl,
                                    StoredValue*& vptr,
                                    item_eviction_policy_t policy) {
     if (vptr == nullptr) {
@@ -789,7 +1444,7 @@ bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
             ++stats.numValueEjects;
             ++numEjects;
 
-            valueStats.epilogue(preProps, vptr);
+            valueStats.epilogue(hbl.getHTLock(), preProps, vptr);
 
             return true;
         }
@@ -801,16 +1456,20 @@ bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
             const auto preProps = valueStats.prologue(vptr);
 
             // Remove the item from the hash table.
-            int bucket_num = getBucketForHash(vptr->getKey().hash());
+            const auto bucket_num =
+                    unlocked_bucketForHash(vptr->getKey().hash());
             auto removed = hashChainRemoveFirst(
-                    values[bucket_num],
+                    unlocked_chain(bucket_num),
                     [vptr](const StoredValue* v) { return v == vptr; });
+            unlocked_refreshGroup(bucket_num);
+            summariseRemovedCas(*removed.get().get());
 
             if (removed->isResident()) {
                 ++stats.numValueEjects;
             }
             ++numEjects;
-            valueStats.epilogue(preProps, nullptr);
+            valueStats.epilogue(hbl.getHTLock(), preProps, nullptr);
+            unindexCollectionItem(removed.get().get());
 
             updateMaxDeletedRevSeqno(vptr->getRevSeqno());
 
@@ -825,7 +1484,11 @@ bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
 
 std::unique_ptr<Item> HashTable::getRandomKeyFromSlot(int slot) {
     auto lh = getLockedBucket(slot);
-    for (StoredValue* v = values[slot].get().get(); v;
+    if (static_cast<size_t>(slot) >= size + oldSize) {
+        // HashTable was resized since the slot was selected.
+        return nullptr;
+    }
+    for (StoredValue* v = unlocked_chain(slot).get().get(); v;
             v = v->getNext().get().get()) {
         if (!v->isTempItem() && !v->isDeleted() && v->isResident()) {
             return v->toItem(false, Vbid(0));
@@ -836,7 +1499,7 @@ std::unique_ptr<Item> HashTable::getRandomKeyFromSlot(int slot) {
 }
 
 bool HashTable::unlocked_restoreValue(
-        const std::unique_lock<std::mutex>& htLock,
+        const std::unique_lock<BucketMutex>& htLock,
         const Item& itm,
         StoredValue& v) {
     if (!htLock || !isActive() || v.isResident()) {
@@ -853,12 +1516,12 @@ bool HashTable::unlocked_restoreValue(
 
     v.restoreValue(itm);
 
-    valueStats.epilogue(preProps, &v);
+    valueStats.epilogue(htLock, preProps, &v);
 
     return true;
 }
 
-void HashTable::unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
+void HashTable::unlocked_restoreMeta(const std::unique_lock<BucketMutex>& htLock,
                                      const Item& itm,
                                      StoredValue& v) {
     if (!htLock) {
@@ -877,14 +1540,42 @@ void HashTable::unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
 
     v.restoreMeta(itm);
 
-    valueStats.epilogue(preProps, &v);
+    valueStats.epilogue(htLock, preProps, &v);
 }
 
 uint8_t HashTable::generateFreqValue(uint8_t counter) {
     return probabilisticCounter.generateValue(counter);
 }
 
+void HashTable::decayFreqCounters(uint16_t percentage) {
+    // The percentage is stored first so a StoredValue which sees the new
+    // epoch decays at least by the new percentage.
+    freqDecayPercentage.store(percentage);
+    freqDecayEpoch.fetch_add(1);
+}
+
+void HashTable::applyFreqDecay(StoredValue& v) const {
+    const uint8_t epoch = freqDecayEpoch.load();
+    // Unsigned 8 bit arithmetic, so correct across the epoch wrapping.
+    const uint8_t pending = epoch - v.getFreqDecayEpoch();
+    if (pending == 0) {
+        return;
+    }
+
+    const auto retain = freqDecayPercentage.load() * 0.01;
+    auto counter = v.getFreqCounterValue();
+    for (uint8_t ii = 0; ii < pending && counter > 0 && retain < 1.0; ++ii) {
+        counter = counter * retain;
+    }
+    v.setFreqCounterValue(counter);
+    v.setFreqDecayEpoch(epoch);
+}
+
 void HashTable::updateFreqCounter(StoredValue& v) {
+    // Apply any decays made since the value was last accessed first, so
+    // the increment is made to the up to date counter.
+    applyFreqDecay(v);
+
     // Attempt to increment the storedValue frequency counter
     // value.  Because a probabilistic counter is used the new
     // value will either be the same or an increment of the
@@ -907,11 +1598,13 @@ std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
        << " numNonResident:" << ht.getNumInMemoryNonResItems()
        << " numTemp:" << ht.getNumTempItems()
        << " values: " << std::endl;
-    for (const auto& chain : ht.values) {
-        if (chain) {
-            for (StoredValue* sv = chain.get().get(); sv != nullptr;
-                 sv = sv->getNext().get().get()) {
-                os << "    " << *sv << std::endl;
+    for (const auto* table : {&ht.values, &ht.oldValues}) {
+        for (const auto& chain : *table) {
+            if (chain) {
+                for (StoredValue* sv = chain.get().get(); sv != nullptr;
+                     sv = sv->getNext().get().get()) {
+                    os << "    " << *sv << std::endl;
+                }
             }
         }
     }
@@ -18,18 +18,28 @@
 #pragma once
 
 #include "config.h"
+#include "large_array_allocator.h"
+#include "lock_profiler.h"
+#include "negative_key_cache.h"
 #include "probabilistic_counter.h"
 #include "stored-value.h"
 #include "storeddockey.h"
 
 #include <platform/histogram.h>
 #include <platform/non_negative_counter.h>
+#include <platform/rwlock.h>
 
 #include <array>
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 class AbstractStoredValueFactory;
 class HashTableVisitor;
+class ValueTier;
 class HashTableDepthVisitor;
 
 /**
@@ -139,6 +149,15 @@ enum class TempAddStatus : uint8_t {
  * re-hashing all elements into the new table. While resizing is occuring all
  * other access to the HashTable is blocked.
  *
+ * Alternatively the HashTable can be resized incrementally (see
+ * startIncrementalResize()); where a new, empty table is swapped in and the
+ * existing buckets are then migrated into it a few at a time, holding only
+ * the lock of the buckets being migrated. While the resize is in progress
+ * the old and new tables coexist; each key is found in the old table if its
+ * bucket has not yet been migrated, otherwise in the new table. To allow
+ * this, incremental resizing keeps the table size a multiple of the number
+ * of ht_locks, so a key is guarded by the same lock in both tables.
+ *
  * Support for holding both Committed and Pending items requires that we
  * can represent having for each key, either:
  *  1. No item present
@@ -151,9 +170,195 @@ enum class TempAddStatus : uint8_t {
  * field. If both Pending or Committed items are present then the Pending item
  * is the first one in the chain; the StoredValue::committed flag is used to
  * distinguish between them.
+ *
+ * Bucket layout
+ * -------------
+ *
+ * By default (Layout::Chained) a lookup walks the bucket's chain, which costs
+ * a dependent cache miss per StoredValue visited. The HashTable can optionally
+ * be created with Layout::Grouped; where each bucket additionally has a
+ * cache-line sized BucketGroup which records a 16-bit tag (derived from the
+ * key's hash) and a pointer for the first BucketGroup::capacity StoredValues
+ * of the chain. Lookups compare the tags held in the group and only
+ * dereference StoredValues whose tag matches; so most lookups touch the group
+ * plus the single matching StoredValue. The chain remains the owner of the
+ * StoredValues; the group is an index which is refreshed (under the same
+ * ht_lock) whenever the chain is modified.
+ *
+ * Read lock mode
+ * --------------
+ *
+ * By default (ReadLockMode::Exclusive) every access to a hash bucket - read or
+ * write - acquires its ht_lock exclusively, so concurrent lookups of keys
+ * guarded by the same lock serialize. The HashTable can optionally be created
+ * with ReadLockMode::Shared; where the ht_locks are reader/writer locks and
+ * findForRead() acquires them in shared mode, allowing read-only lookups to
+ * proceed in parallel. All other methods still acquire the ht_lock
+ * exclusively.
  */
 class HashTable {
 public:
+    /**
+     * Physical layout of the hash buckets - see "Bucket layout" above.
+     */
+    enum class Layout : uint8_t {
+        /// Each bucket is just the head of a chain of StoredValues.
+        Chained,
+        /// Each bucket is a chain plus a cache-line sized BucketGroup index.
+        Grouped
+    };
+
+    /**
+     * How findForRead() acquires the ht_lock - see "Read lock mode" above.
+     */
+    enum class ReadLockMode : uint8_t {
+        /// Readers acquire the ht_lock exclusively, same as writers.
+        Exclusive,
+        /// Readers acquire the ht_lock shared.
+        Shared
+    };
+
+    class Statistics;
+
+    /**
+     * The changes made to the HashTable statistics (see Statistics) while
+     * holding one ht_lock. Only modified with the lock held exclusively, so
+     * updating a count is a plain load and store to memory next to the lock
+     * (which the holder already owns), instead of an atomic read-modify-write
+     * of a counter shared by all the locks. The statistics are the sums over
+     * all the locks, computed when read.
+     *
+     * A count may be negative - e.g. if an item added under one lock is
+     * removed under another after a resize.
+     */
+    struct StatisticsStripe {
+        using Count = std::atomic<int64_t>;
+
+        /// Apply a change to one of the counts; the ht_lock must be held.
+        static void add(Count& count, int64_t delta) {
+            count.store(count.load(std::memory_order_relaxed) + delta,
+                        std::memory_order_relaxed);
+        }
+
+        Count numItems{0};
+        Count numNonResidentItems{0};
+        Count numDeletedItems{0};
+        Count numTempItems{0};
+        Count memSize{0};
+        Count metaDataMemory{0};
+        Count uncompressedMemSize{0};
+        std::array<Count, mcbp::datatype::highest + 1> datatypeCounts{};
+    };
+
+    /**
+     * Lock guarding a stripe of hash buckets (see mutexForBucket()).
+     *
+     * Meets the Lockable requirements for exclusive locking. For
+     * ReadLockMode::Shared it is backed by a reader/writer lock and
+     * additionally supports lock_shared() / unlock_shared(); for
+     * ReadLockMode::Exclusive it is backed by a plain mutex (which is cheaper
+     * to acquire) and shared locking is not permitted.
+     */
+    class BucketMutex {
+    public:
+        void lock() {
+            if (profile && profile->sample()) {
+                const auto start = std::chrono::steady_clock::now();
+                lockUnprofiled();
+                acquired = std::chrono::steady_clock::now();
+                profile->logWait(acquired - start);
+                return;
+            }
+            lockUnprofiled();
+        }
+
+        bool try_lock() {
+            if (shared ? rwLock.try_lock() : mutex.try_lock()) {
+                ++writeVersion;
+                return true;
+            }
+            return false;
+        }
+
+        void unlock() {
+            std::chrono::steady_clock::duration held{0};
+            const bool sampled =
+                    acquired != std::chrono::steady_clock::time_point();
+            if (sampled) {
+                held = std::chrono::steady_clock::now() - acquired;
+                acquired = {};
+            }
+            if (shared) {
+                rwLock.unlock();
+            } else {
+                mutex.unlock();
+            }
+            if (sampled) {
+                profile->logHold(held);
+            }
+        }
+
+        void lock_shared() {
+            if (profile && profile->sample()) {
+                const auto start = std::chrono::steady_clock::now();
+                rwLock.lock_shared();
+                profile->logWait(std::chrono::steady_clock::now() - start);
+                return;
+            }
+            rwLock.lock_shared();
+        }
+
+        void unlock_shared() {
+            rwLock.unlock_shared();
+        }
+
+        bool isShared() const {
+            return shared;
+        }
+
+    private:
+        friend class HashTable;
+        friend class Statistics;
+
+        void lockUnprofiled() {
+            if (shared) {
+                rwLock.lock();
+            } else {
+                mutex.lock();
+            }
+            ++writeVersion;
+        }
+
+        std::mutex mutex;
+        cb::RWLock rwLock;
+        // Only set when the owning HashTable is constructed.
+        bool shared = false;
+        LockProfile* profile = nullptr;
+        // When a sampled exclusive holder acquired the lock (only accessed by
+        // the holder).
+        std::chrono::steady_clock::time_point acquired;
+        // Incremented on every exclusive acquisition - see LockVersion.
+        std::atomic<uint64_t> writeVersion{0};
+        // The holders' changes to the HashTable statistics.
+        StatisticsStripe statsStripe;
+    };
+
+    /**
+     * Identifies an ht_lock and the number of times it has been acquired
+     * exclusively. As every modification of a StoredValue requires holding
+     * its ht_lock exclusively, a StoredValue cannot have changed while the
+     * LockVersion of its lock is unchanged - which allows snapshots of
+     * StoredValues to be validated without acquiring the lock.
+     */
+    struct LockVersion {
+        size_t lock;
+        uint64_t version;
+
+        bool operator==(const LockVersion& other) const {
+            return lock == other.lock && version == other.version;
+        }
+    };
+
     /**
      * Datatype counts; one element for each combination of datatypes
      * (e.g. JSON, JSON+XATTR, JSON+Snappy, etc...)
@@ -213,10 +418,14 @@ public:
      * Clients can read current statistics values via the various get() methods,
      * however updating statistics values is performed by the prologue() and
      * epilogue() methods.
+     *
+     * The counters are kept per ht_lock (see StatisticsStripe) and summed by
+     * the get() methods.
      */
     class Statistics {
     public:
-        Statistics(EPStats& epStats) : epStats(epStats) {
+        Statistics(EPStats& epStats, std::vector<BucketMutex>& mutexes)
+            : mutexes(mutexes), epStats(epStats) {
         }
 
         /**
@@ -237,6 +446,7 @@ public:
             bool isResident = false;
             bool isDeleted = false;
             bool isTempItem = false;
+            CollectionID collection;
         };
 
         /**
@@ -271,64 +481,54 @@ public:
          * example, if the datatype of a StoredValue may have changed; then
          * datatypeCounts needs to be updated.
          *
+         * @param htLock The (exclusively held) lock of the StoredValue.
          * @param pre StoredValueProperties from before the StoredValue
          *                   was modified.
          * @param post StoredValue which has just been modified.
          */
-        void epilogue(StoredValueProperties pre, const StoredValue* post);
+        void epilogue(const std::unique_lock<BucketMutex>& htLock,
+                      StoredValueProperties pre,
+                      const StoredValue* post);
 
-        /// Reset the values of all statistics to zero.
+        /// Reset the values of all statistics to zero. All the ht_locks must
+        /// be held.
         void reset();
 
-        size_t getNumItems() const {
-            return numItems;
-        }
-
-        size_t getNumNonResidentItems() const {
-            return numNonResidentItems;
-        }
-
-        size_t getNumDeletedItems() const {
-            return numDeletedItems;
-        }
-
-        size_t getNumTempItems() const {
-            return numTempItems;
-        }
-
-        DatatypeCombo getDatatypeCounts() const {
-            return datatypeCounts;
-        }
-
-        size_t getCacheSize() const {
-            return cacheSize;
-        }
-
-        size_t getMetaDataMemory() const {
-            return metaDataMemory;
-        }
-
-        size_t getMemSize() const {
-            return memSize;
+        /**
+         * Set the function to call with the collection and the change in
+         * size whenever the memory used by a StoredValue changes. Called
+         * with the hash bucket lock held.
+         */
+        void setMemChangedCallback(
+                std::function<void(CollectionID, int64_t)> callback) {
+            memChangedCallback = std::move(callback);
         }
 
-        size_t getUncompressedMemSize() const {
-            return uncompressedMemSize;
+        const std::function<void(CollectionID, int64_t)>&
+        getMemChangedCallback() const {
+            return memChangedCallback;
         }
 
-    private:
         /// Count of alive & deleted, in-memory non-resident and resident items.
         /// Excludes temporary items.
-        cb::NonNegativeCounter<size_t> numItems;
+        size_t getNumItems() const {
+            return sum(&StatisticsStripe::numItems);
+        }
 
         /// Count of alive, non-resident items.
-        cb::NonNegativeCounter<size_t> numNonResidentItems;
+        size_t getNumNonResidentItems() const {
+            return sum(&StatisticsStripe::numNonResidentItems);
+        }
 
         /// Count of deleted items.
-        cb::NonNegativeCounter<size_t> numDeletedItems;
+        size_t getNumDeletedItems() const {
+            return sum(&StatisticsStripe::numDeletedItems);
+        }
 
         /// Count of items where StoredValue::isTempItem() is true.
-        cb::NonNegativeCounter<size_t> numTempItems;
+        size_t getNumTempItems() const {
+            return sum(&StatisticsStripe::numTempItems);
+        }
 
         /**
          * Number of documents of a given datatype. Includes alive
@@ -337,19 +537,37 @@ public:
          * datatype is part of the metadata), for full-eviction will only
          * include resident items.
          */
-        DatatypeCombo datatypeCounts = {};
+        DatatypeCombo getDatatypeCounts() const;
 
         //! Cache size (fixed-length fields in StoredValue + keylen + valuelen).
-        std::atomic<size_t> cacheSize = {};
+        size_t getCacheSize() const {
+            return sum(&StatisticsStripe::memSize);
+        }
 
         //! Meta-data size (fixed-length fields in StoredValue + keylen).
-        std::atomic<size_t> metaDataMemory = {};
+        size_t getMetaDataMemory() const {
+            return sum(&StatisticsStripe::metaDataMemory);
+        }
 
         //! Memory consumed by items in this hashtable.
-        std::atomic<size_t> memSize = {};
+        size_t getMemSize() const {
+            return sum(&StatisticsStripe::memSize);
+        }
 
         /// Memory consumed if the items were uncompressed.
-        std::atomic<size_t> uncompressedMemSize = {};
+        size_t getUncompressedMemSize() const {
+            return sum(&StatisticsStripe::uncompressedMemSize);
+        }
+
+    private:
+        /// @return the sum of the given count over all the ht_locks, or 0 if
+        ///         negative (possible while changes are being made).
+        size_t sum(StatisticsStripe::Count StatisticsStripe::*count) const;
+
+        std::vector<BucketMutex>& mutexes;
+
+        /// Per-collection memory accounting; empty if not tracked.
+        std::function<void(CollectionID, int64_t)> memChangedCallback;
 
         EPStats& epStats;
     };
@@ -365,12 +583,23 @@ public:
         HashBucketLock()
             : bucketNum(-1) {}
 
-        HashBucketLock(int bucketNum, std::mutex& mutex)
+        HashBucketLock(int bucketNum, BucketMutex& mutex)
             : bucketNum(bucketNum), htLock(mutex) {
         }
 
+        /**
+         * Construct from an ht_lock held in shared mode. Such a lock only
+         * permits read-only access - getHTLock() returns an unlocked object,
+         * so unlocked_ methods which modify the bucket will reject it.
+         */
+        HashBucketLock(int bucketNum, std::shared_lock<BucketMutex>&& lock)
+            : bucketNum(bucketNum), sharedLock(std::move(lock)) {
+        }
+
         HashBucketLock(HashBucketLock&& other)
-            : bucketNum(other.bucketNum), htLock(std::move(other.htLock)) {
+            : bucketNum(other.bucketNum),
+              htLock(std::move(other.htLock)),
+              sharedLock(std::move(other.sharedLock)) {
         }
 
         HashBucketLock(const HashBucketLock& other) = delete;
@@ -379,17 +608,23 @@ public:
             return bucketNum;
         }
 
-        const std::unique_lock<std::mutex>& getHTLock() const {
+        const std::unique_lock<BucketMutex>& getHTLock() const {
             return htLock;
         }
 
-        std::unique_lock<std::mutex>& getHTLock() {
+        std::unique_lock<BucketMutex>& getHTLock() {
             return htLock;
         }
 
+        /// @return true if the ht_lock is held in shared (read-only) mode.
+        bool isShared() const {
+            return sharedLock.owns_lock();
+        }
+
     private:
         int bucketNum;
-        std::unique_lock<std::mutex> htLock;
+        std::unique_lock<BucketMutex> htLock;
+        std::shared_lock<BucketMutex> sharedLock;
     };
 
     /**
@@ -399,20 +634,54 @@ public:
      * @param svFactory Factory to use for constructing stored values
      * @param initialSize the number of hash table buckets to initially create.
      * @param locks the number of locks in the hash table
+     * @param layout the bucket layout to use
+     * @param readLockMode how findForRead() acquires the ht_lock
+     * @param arrayPolicy how the bucket arrays are backed
      */
     HashTable(EPStats& st,
               std::unique_ptr<AbstractStoredValueFactory> svFactory,
               size_t initialSize,
-              size_t locks);
+              size_t locks,
+              Layout layout = Layout::Chained,
+              ReadLockMode readLockMode = ReadLockMode::Exclusive,
+              const LargeArrayPolicy& arrayPolicy = {});
 
     ~HashTable();
 
     size_t memorySize() {
         return sizeof(HashTable)
-            + (size * sizeof(StoredValue*))
-            + (mutexes.size() * sizeof(std::mutex));
+            + ((size + oldSize) * sizeof(StoredValue*))
+            + (groups.size() * sizeof(BucketGroup))
+            + (mutexes.size() * sizeof(BucketMutex));
+    }
+
+    /**
+     * Get the bucket layout this hash table was created with.
+     */
+    Layout getLayout() const {
+        return layout;
+    }
+
+    /**
+     * Convert a configuration string ("chained" / "grouped") to a Layout.
+     * @throws std::invalid_argument if the string is not a known layout.
+     */
+    static Layout layoutFromString(const std::string& str);
+
+    /**
+     * Get the read lock mode this hash table was created with.
+     */
+    ReadLockMode getReadLockMode() const {
+        return readLockMode;
     }
 
+    /**
+     * Convert a configuration string ("exclusive" / "shared") to a
+     * ReadLockMode.
+     * @throws std::invalid_argument if the string is not a known mode.
+     */
+    static ReadLockMode readLockModeFromString(const std::string& str);
+
     /**
      * Get the number of hash table buckets this hash table has.
      */
@@ -467,6 +736,95 @@ public:
         frequencyCounterSaturated = callbackFunction;
     }
 
+    /**
+     * Decay the frequency counters of all the StoredValues by the given
+     * percentage, lazily: this just advances the decay epoch, the decays are
+     * applied to each StoredValue when it's next accessed (applyFreqDecay).
+     *
+     * The per-StoredValue epoch is 8 bits, so every StoredValue must have the
+     * decays applied (e.g. by the ItemFreqDecayerVisitor) before 256 more
+     * decays are made, or the pending decays of the idle ones are lost.
+     *
+     * @param percentage the percentage of the counter to retain per decay;
+     *        the percentage in use when the decay is applied is used for
+     *        all the pending decays.
+     */
+    void decayFreqCounters(uint16_t percentage);
+
+    /**
+     * Apply any pending (lazy) decays to the StoredValue's frequency counter.
+     * Requires the HashBucketLock of the StoredValue to be held.
+     */
+    void applyFreqDecay(StoredValue& v) const;
+
+    /// @return the current frequency decay epoch
+    uint8_t getFreqDecayEpoch() const {
+        return freqDecayEpoch.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * The keys recently found to have no live document on disk. A key is
+     * erased from it whenever a StoredValue is added for the key.
+     */
+    NegativeKeyCache& getNegativeKeyCache() {
+        return negativeKeyCache;
+    }
+
+    /**
+     * Sets the function to call with the collection and the change in size
+     * whenever the memory used by one of the HashTable's StoredValues
+     * changes (including when it is added or removed). The function is
+     * called with the hash bucket lock held.
+     */
+    void setMemChangedCallback(
+            std::function<void(CollectionID, int64_t)> callbackFunction) {
+        valueStats.setMemChangedCallback(std::move(callbackFunction));
+    }
+
+    /**
+     * Index the StoredValues of each collection as they're added to and
+     * removed from the HashTable, so the items of one collection can be
+     * found without visiting the whole HashTable (see getCollectionKeys()).
+     *
+     * Costs a (per HashTable) mutex and a set insertion / erasure whenever
+     * a StoredValue is added or removed, so is optional. Must be called
+     * before any items are added.
+     */
+    void enableCollectionIndex();
+
+    bool isCollectionIndexed() const {
+        return collectionIndex != nullptr;
+    }
+
+    /**
+     * Keep a summary of the CAS of the StoredValues removed from the
+     * HashTable (evicted, or deleted and persisted). The keys are hashed into
+     * the given number of slots, each holding the largest CAS of the keys
+     * removed from it, so lookups can bound the CAS a key which isn't in the
+     * HashTable has on disk.
+     *
+     * @param slots number of slots to summarise the keys in
+     * @param maxCas bound of the CAS of the items already on disk
+     * @throws std::logic_error if the HashTable isn't empty
+     */
+    void enableRemovedCasSummary(size_t slots, uint64_t maxCas);
+
+    /**
+     * @return a CAS which the given key (if it isn't in the HashTable) is
+     *         known not to exceed on disk; the maximum CAS if the summary
+     *         isn't enabled.
+     */
+    uint64_t getRemovedCasBound(const DocKey& key) const;
+
+    /**
+     * Get the keys of the (temporary, deleted and alive) items of the given
+     * collection in the HashTable. The items may have changed by the time
+     * they're looked up with the keys.
+     *
+     * @throws std::logic_error if the collection index isn't enabled
+     */
+    std::vector<StoredDocKey> getCollectionKeys(CollectionID collection) const;
+
     /**
      * Gets a reference to the frequencyCounterSaturated function.
      * Currently used for testing purposes.
@@ -525,6 +883,16 @@ public:
      */
     void clear(bool deactivate = false);
 
+    /**
+     * Free up to the given number of items, so a table which is being
+     * destroyed can be released in bounded steps rather than all at once by
+     * clear() / the destructor. Deactivates the table.
+     *
+     * @param limit the most items to free
+     * @return {true if there are items left to free, bytes freed}
+     */
+    std::pair<bool, size_t> releaseItems(size_t limit);
+
     /**
      * Get the number of times this hash table has been resized.
      */
@@ -551,6 +919,51 @@ public:
      */
     void resize(size_t to);
 
+    /**
+     * Grow the table (if needed) to fit the given number of items, such as
+     * the items warmup is about to load, so it doesn't go through repeated
+     * resizes as they are added.
+     */
+    void reserve(size_t numItems);
+
+    /**
+     * Begin an incremental resize to fit the current data.
+     *
+     * Unlike resize(), all ht_locks are only held for long enough to swap in
+     * a new (empty) table; the existing StoredValues are then migrated by
+     * subsequent calls to incrementalResizeStep().
+     *
+     * The new size is rounded up to a multiple of the number of locks. If
+     * the current size is not such a multiple then a one-off blocking
+     * resize() is performed instead.
+     *
+     * @return true if an incremental resize is now in progress.
+     */
+    bool startIncrementalResize();
+
+    /**
+     * Begin an incremental resize to (approximately) the specified size.
+     * See startIncrementalResize().
+     */
+    bool startIncrementalResize(size_t to);
+
+    /**
+     * Migrate up to numBuckets buckets of the old table into the new table
+     * as part of an incremental resize. Only the lock of the buckets being
+     * migrated (and the first lock, to exclude new visitors) is held.
+     *
+     * @return true if progress was made (or no resize is in progress); false
+     *         if a visitor is running and the caller should try again later.
+     */
+    bool incrementalResizeStep(size_t numBuckets);
+
+    /**
+     * @return true if an incremental resize is in progress.
+     */
+    bool isResizing() const {
+        return oldSize.load() != 0;
+    }
+
     /**
      * Result of the findForRead() method.
      */
@@ -562,7 +975,8 @@ public:
          * returns a locked object; even if the requested key doesn't exist.
          * This is to facilitate use-cases where the caller subsequently needs
          * to insert a StoredValue for this key, to avoid unlocking and
-         * re-locking the mutex.
+         * re-locking the mutex - except if the lock is held shared (see
+         * findForRead()), in which case it only permits reading.
          */
         HashBucketLock lock;
     };
@@ -578,6 +992,11 @@ public:
      *                       increase the hotness of this key?)
      * @param wantsDeleted whether a deleted value needs to be returned
      *                     or not
+     * If the HashTable uses ReadLockMode::Shared and trackReference is No,
+     * the ht_lock is acquired in shared mode, so concurrent lookups of keys
+     * guarded by the same lock do not serialize. (Tracking references
+     * modifies the StoredValue, so requires the lock exclusively.)
+     *
      * @return A FindROResult consisting of:
      *         - a pointer to a StoredValue -- NULL if not found
      *         - a (locked) HashBucketLock for the key's hash bucket.
@@ -636,6 +1055,19 @@ public:
      */
     std::unique_ptr<Item> getRandomKey(long rnd);
 
+    /**
+     * Find up to count resident items, taking at most one from each slot
+     * (so they are distinct) from consecutive slots starting at a random
+     * one. Keys are spread over the slots by their hash, so consecutive
+     * slots are as good a sample as random ones and cheaper to visit.
+     *
+     * @param rnd a randomization input
+     * @param count the maximum number of items to return
+     * @return the items found (fewer than count if the table has fewer
+     *         non-empty slots)
+     */
+    std::vector<std::unique_ptr<Item>> getRandomKeys(long rnd, size_t count);
+
     /**
      * Set an Item into the this hashtable
      *
@@ -649,11 +1081,25 @@ public:
      * Store the given compressed buffer as a value in the
      * given StoredValue
      *
+     * @param hbl the (held) lock of the StoredValue
      * @param buf buffer holding compressed data
      * @param v   StoredValue in which compressed data has
      *            to be stored
      */
-    void storeCompressedBuffer(cb::const_char_buffer buf, StoredValue& v);
+    void storeCompressedBuffer(const HashBucketLock& hbl,
+                               cb::const_char_buffer buf,
+                               StoredValue& v);
+
+    /**
+     * Move the (resident, heap) value of the given StoredValue into the
+     * value tier, freeing its DRAM.
+     *
+     * @param hbl the (held) lock of the StoredValue
+     * @return true if moved, false if the tier has no room
+     */
+    bool unlocked_moveToTier(const HashBucketLock& hbl,
+                             StoredValue& v,
+                             ValueTier& tier);
 
     /**
      * Result of an Update operation.
@@ -717,6 +1163,27 @@ public:
      */
     std::pair<StoredValue*, StoredValue::UniquePtr> unlocked_replaceByCopy(
             const HashBucketLock& hbl, const StoredValue& vToCopy);
+
+    /**
+     * Replaces a StoredValue in the HT with a newly allocated copy, at the
+     * same position in its hash chain, and releases the ownership of the
+     * original. Used by the defragmenter to move StoredValues out of
+     * sparsely used allocator pages.
+     * Unlike unlocked_replaceByCopy() the copy isn't treated as a new item;
+     * HT stats only change by any difference in the size of the copy.
+     * Assumes that HT bucket lock is grabbed.
+     *
+     * @param hbl Hash table bucket lock that must be held.
+     * @param v StoredValue to be reallocated.
+     *
+     * @return Ptr of the copy of the StoredValue. This is owned by the hash
+     *         table.
+     *         UniquePtr to the original StoredValue. This is NOT owned by the
+     *         hash table anymore.
+     */
+    std::pair<StoredValue*, StoredValue::UniquePtr>
+    unlocked_reallocateStoredValue(const HashBucketLock& hbl, StoredValue& v);
+
     /**
      * Logically (soft) delete the item in ht
      * Assumes that HT bucket lock is grabbed.
@@ -728,7 +1195,7 @@ public:
      *                        just mark deleted
      * @param delSource The source of the deletion (explicit or expiry)
      */
-    void unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
+    void unlocked_softDelete(const std::unique_lock<BucketMutex>& htLock,
                              StoredValue& v,
                              bool onlyMarkDeleted,
                              DeleteSource delSource);
@@ -797,6 +1264,56 @@ public:
         return getLockedBucketForHash(key.hash());
     }
 
+    /**
+     * Hint to the CPU that the hash bucket (and its lock) for the given key
+     * will shortly be accessed, so the cache misses can overlap with other
+     * work - e.g. looking up the previous key of a batch.
+     *
+     * No lock is acquired; if the table is concurrently resized the
+     * prefetched address may be stale, which only costs a wasted prefetch.
+     */
+    void prefetchBucket(const DocKey& key);
+
+    /**
+     * Get the current LockVersion of the ht_lock guarding the given key,
+     * without acquiring it.
+     */
+    LockVersion getLockVersion(const DocKey& key) {
+        const auto lock = mutexForBucket(getBucketForHash(key.hash()));
+        return {lock, mutexes[lock].writeVersion.load()};
+    }
+
+    /**
+     * Get the LockVersion of the given (held) ht_lock.
+     */
+    LockVersion getLockVersion(const HashBucketLock& hbl) {
+        const auto lock = mutexForBucket(hbl.getBucketNum());
+        return {lock, mutexes[lock].writeVersion.load()};
+    }
+
+    /**
+     * Get a lock holder holding a shared (read-only) lock for the bucket for
+     * the given hash. Requires ReadLockMode::Shared.
+     *
+     * @param h the input hash
+     * @return HashBucketLock which contains a shared lock and the hash bucket
+     *         number
+     */
+    inline HashBucketLock getSharedLockedBucketForHash(int h) {
+        while (true) {
+            if (!isActive()) {
+                throw std::logic_error("HashTable::getSharedLockedBucket: "
+                        "Cannot call on a non-active object");
+            }
+            int bucket = getBucketForHash(h);
+            std::shared_lock<BucketMutex> lock(
+                    mutexes[mutexForBucket(bucket)]);
+            if (bucket == getBucketForHash(h)) {
+                return HashBucketLock(bucket, std::move(lock));
+            }
+        }
+    }
+
     /**
      * Delete a key from the cache without trying to lock the cache first
      * (Please note that you <b>MUST</b> acquire the mutex before calling
@@ -812,6 +1329,16 @@ public:
      */
     void visit(HashTableVisitor &visitor);
 
+    /**
+     * Visit the items of a single hash bucket, chosen by the given random
+     * number; for sampling the table without visiting all of it.
+     *
+     * @param rnd a randomization input
+     * @param visitor the visitor; setUp/tearDownHashBucketVisit are called
+     *        around the bucket's visit as for visit().
+     */
+    void visitRandomBucket(long rnd, HashTableVisitor& visitor);
+
     /**
      * Visit all items within this call with a depth visitor.
      */
@@ -894,7 +1421,7 @@ public:
      *
      * @return true if restored; else false
      */
-    bool unlocked_restoreValue(const std::unique_lock<std::mutex>& htLock,
+    bool unlocked_restoreValue(const std::unique_lock<BucketMutex>& htLock,
                                const Item& itm,
                                StoredValue& v);
 
@@ -907,7 +1434,7 @@ public:
      * @param itm the Item whose metadata is being restored
      * @param v corresponding StoredValue
      */
-    void unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
+    void unlocked_restoreMeta(const std::unique_lock<BucketMutex>& htLock,
                               const Item& itm,
                               StoredValue& v);
 
@@ -953,7 +1480,43 @@ public:
 
 private:
     // The container for actually holding the StoredValues.
-    using table_type = std::vector<StoredValue::UniquePtr>;
+    using table_type =
+            std::vector<StoredValue::UniquePtr,
+                        LargeArrayAllocator<StoredValue::UniquePtr>>;
+
+    /**
+     * How many buckets (of the same lock) ahead of the bucket being visited
+     * pauseResumeVisit() / visitDepth() prefetch the bucket slot of. Bulk
+     * visitors are dominated by cache misses on large tables; this overlaps
+     * the misses of later buckets with visiting the current one.
+     */
+    static constexpr size_t visitPrefetchDistance = 4;
+
+    /**
+     * Index of the head of one hash bucket's chain, sized to fit in a single
+     * cache line. Entry i describes the i'th StoredValue of the chain (in
+     * chain order, so a Pending item still precedes its Committed item).
+     * Only used for Layout::Grouped.
+     */
+    struct BucketGroup {
+        static constexpr size_t capacity = 6;
+
+        /// Pointers to the first `count` StoredValues of the chain.
+        std::array<StoredValue*, capacity> ptrs;
+        /// tagForHash() of the key of each StoredValue in ptrs.
+        std::array<uint16_t, capacity> tags;
+        /// Number of valid entries in ptrs / tags.
+        uint8_t count = 0;
+        /// True if the chain has more than `capacity` elements; the
+        /// remainder must be found by walking on from ptrs[capacity - 1].
+        bool overflow = false;
+    };
+    static_assert(sizeof(BucketGroup) <= 64,
+                  "BucketGroup should fit in a cache line");
+
+    // The container for the per-bucket groups.
+    using group_table_type =
+            std::vector<BucketGroup, LargeArrayAllocator<BucketGroup>>;
 
     friend class StoredValue;
     friend std::ostream& operator<<(std::ostream& os, const HashTable& ht);
@@ -993,15 +1556,69 @@ private:
     // in `values`
     std::atomic<size_t> size;
     table_type values;
-    std::vector<std::mutex> mutexes;
+    // Layout of the buckets; fixed for the lifetime of the HashTable.
+    const Layout layout;
+    // Per-bucket groups; same size as `values` if layout is Grouped, else
+    // empty. Element N is guarded by the same mutex as values[N].
+    group_table_type groups;
+
+    // While an incremental resize is in progress, the table being migrated
+    // from; otherwise empty. Its buckets are addressed as
+    // [size, size + oldSize) - see unlocked_chain().
+    table_type oldValues;
+    // Size of oldValues; zero if no incremental resize is in progress.
+    // Only modified while holding all mutexes.
+    std::atomic<size_t> oldSize{0};
+    // Per-lock migration cursor. For lock L, all old buckets B (where
+    // B % mutexes.size() == L) with B < resizeCursors[L] have been migrated
+    // into values. Element L is guarded by mutexes[L].
+    std::vector<size_t> resizeCursors;
+    // Lock whose old buckets are currently being migrated. Guarded by
+    // mutexes[0].
+    size_t resizeLock = 0;
+
+    std::vector<BucketMutex> mutexes;
+    const ReadLockMode readLockMode;
     EPStats&             stats;
     std::unique_ptr<AbstractStoredValueFactory> valFact;
     std::atomic<size_t>       visitors;
 
     Statistics valueStats;
 
+    /**
+     * The StoredValues of each collection, if enabled. The StoredValues
+     * (and so the sets) are only added or removed while holding both their
+     * hash bucket lock and the index's mutex, so the keys of the
+     * StoredValues may be read while holding just the mutex.
+     */
+    struct CollectionIndex {
+        mutable std::mutex mutex;
+        std::unordered_map<CollectionID,
+                           std::unordered_set<const StoredValue*>>
+                collections;
+    };
+    std::unique_ptr<CollectionIndex> collectionIndex;
+
+    /// Add the StoredValue to the collection index (if enabled)
+    void indexCollectionItem(const StoredValue* v);
+
+    /// Remove the StoredValue from the collection index (if enabled)
+    void unindexCollectionItem(const StoredValue* v);
+
+    /**
+     * The largest CAS of the StoredValues removed from each slot, if
+     * enabled. See enableRemovedCasSummary().
+     */
+    std::unique_ptr<std::atomic<uint64_t>[]> removedCas;
+    size_t removedCasSlots = 0;
+
+    /// Record the CAS of a StoredValue about to be removed (if enabled)
+    void summariseRemovedCas(const StoredValue& v);
+
     std::atomic<size_t> numEjects;
     std::atomic<size_t>       numResizes;
+    // The next bucket releaseItems() frees the items of.
+    size_t releaseCursor = 0;
 
     std::atomic<uint64_t> maxDeletedRevSeqno;
     bool                 activeState;
@@ -1021,10 +1638,76 @@ private:
     // responsible for waking the ItemFreqDecayer task.
     std::function<void()> frequencyCounterSaturated{[]() {}};
 
+    // Incremented (wrapping) by each lazy decay of the frequency counters; a
+    // StoredValue's counter is up to date when its epoch matches.
+    std::atomic<uint8_t> freqDecayEpoch{0};
+
+    // The percentage of the counter retained by each lazy decay.
+    std::atomic<uint16_t> freqDecayPercentage{100};
+
+    NegativeKeyCache negativeKeyCache;
+
     int getBucketForHash(int h) {
         return abs(h % static_cast<int>(size));
     }
 
+    /**
+     * Get the (old or new table) bucket which currently holds keys with the
+     * given hash. Only differs from getBucketForHash() while an incremental
+     * resize is in progress. The lock for the bucket must be held.
+     */
+    size_t unlocked_bucketForHash(int h);
+
+    /**
+     * Get the bucket which currently holds the given key, which is guarded
+     * by the given (held) lock.
+     */
+    size_t unlocked_bucketForKey(const HashBucketLock& hbl, const DocKey& key) {
+        if (!isResizing()) {
+            return hbl.getBucketNum();
+        }
+        return unlocked_bucketForHash(key.hash());
+    }
+
+    /**
+     * Prefetch the chain head (slot) of the given bucket, addressed as per
+     * unlocked_chain(). Does not read the slot, so no lock is required; but
+     * the table must not be resized concurrently (e.g. visitors > 0).
+     */
+    void prefetchBucketSlot(size_t bucketNum);
+
+    /**
+     * Get the chain for the given bucket; where buckets [0, size) are in the
+     * current table and [size, size + oldSize) are in the old table being
+     * migrated from by an incremental resize.
+     */
+    StoredValue::UniquePtr& unlocked_chain(size_t bucketNum) {
+        if (bucketNum < size) {
+            return values[bucketNum];
+        }
+        return oldValues[bucketNum - size];
+    }
+
+    /**
+     * Calculate the size the HashTable should be resized to for the current
+     * number of items, as a multiple of the given alignment.
+     */
+    size_t getTargetSize(size_t alignment) const;
+
+    /**
+     * Calculate the size the HashTable should be for the given number of
+     * items, as a multiple of the given alignment.
+     */
+    size_t getTargetSize(size_t alignment, size_t numItems) const;
+
+    /**
+     * Move all StoredValues in the given chain into their buckets in
+     * `values` (which must be of the new size). Preserves the relative
+     * order of StoredValues which end up in the same bucket, so a Pending
+     * item remains ahead of its Committed item.
+     */
+    void unlocked_rehashChain(StoredValue::UniquePtr& chain);
+
     inline size_t mutexForBucket(size_t bucket_num) {
         if (!isActive()) {
             throw std::logic_error("HashTable::mutexForBucket: Cannot call on a "
@@ -1035,6 +1718,36 @@ private:
 
     std::unique_ptr<Item> getRandomKeyFromSlot(int slot);
 
+    /**
+     * Returns the tag recorded for a key of the given hash - in a BucketGroup,
+     * and in the (otherwise unused) top 16 bits of each hash chain link. Never
+     * zero; a link with a zero tag hasn't been tagged.
+     */
+    static uint16_t tagForHash(uint32_t h) {
+        // Bucket selection uses (h % size); fold the high bits into the tag
+        // so keys in the same bucket are still likely to have distinct tags.
+        const auto tag = static_cast<uint16_t>((h >> 16) ^ h);
+        return tag ? tag : 1;
+    }
+
+    /**
+     * Record the given tag in a hash chain link. The tag moves with the
+     * link as the chain is modified, so always describes the StoredValue
+     * pointed to.
+     */
+    static void tagLink(StoredValue::UniquePtr& link, uint16_t tag) {
+        auto ptr = link.release();
+        ptr.setTag(tag);
+        link.reset(ptr);
+    }
+
+    /**
+     * Re-populate the BucketGroup for the given bucket from its chain.
+     * Must be called (with the bucket's lock held) after any modification
+     * of values[bucketNum]. No-op for Layout::Chained.
+     */
+    void unlocked_refreshGroup(size_t bucketNum);
+
     /** Searches for the first element in the specified hashChain which matches
      * predicate p, and unlinks it from the chain.
      *
@@ -1073,6 +1786,15 @@ private:
 
     void clear_UNLOCKED(bool deactivate);
 
+    /**
+     * Free up to limit items from the chains starting at bucket cursor,
+     * which is advanced past the chains emptied; updating the memory stats.
+     *
+     * @return {items freed, bytes freed}
+     */
+    std::pair<size_t, size_t> releaseChains_UNLOCKED(size_t& cursor,
+                                                     size_t limit);
+
     /**
      * Generates a new value that is either the same or higher than the input
      * value.  It is intended to be used to increment the frequency counter of a
@@ -0,0 +1,344 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "hashtable_image.h"
+
+#include "bucket_logger.h"
+#include "callbacks.h"
+#include "crc32.h"
+#include "hash_table.h"
+#include "item.h"
+#include "stored-value.h"
+#include "vbucket.h"
+
+#include <gsl/gsl>
+#include <platform/dirutils.h>
+#include <platform/memorymap.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t vbid;
+    uint16_t flags;
+    uint32_t reserved;
+    int64_t highSeqno;
+    uint64_t itemCount;
+};
+
+/// Header flag: records of resident items include the value.
+const uint16_t IncludesValues = 0x1;
+
+struct BlockHeader {
+    uint32_t length;
+    uint32_t crc;
+};
+
+struct RecordHeader {
+    uint64_t cas;
+    uint64_t revSeqno;
+    int64_t bySeqno;
+    int64_t exptime;
+    uint32_t flags;
+    uint32_t valueLength;
+    uint16_t keyLength;
+    uint16_t freqCounter;
+    uint8_t datatype;
+    uint8_t nru;
+    uint8_t hasValue;
+    uint8_t reserved;
+};
+
+uint32_t checksum(const void* data, size_t length) {
+    // crc32buf doesn't modify the buffer, it just isn't declared const.
+    return crc32buf(static_cast<uint8_t*>(const_cast<void*>(data)), length);
+}
+
+/**
+ * Visits a HashTable appending a record for each live, committed item to the
+ * current block, and writing the block out whenever it fills.
+ */
+class ImageWriter : public HashTableVisitor {
+public:
+    ImageWriter(FILE* fp, bool includeValues)
+        : fp(fp), includeValues(includeValues) {
+        block.reserve(HashTableImage::BlockSize + sizeof(RecordHeader));
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
+        if (v.isTempItem() || v.isDeleted() ||
+            v.getCommitted() == CommittedState::Pending) {
+            return true;
+        }
+
+        const auto& key = v.getKey();
+        const bool withValue = includeValues && v.isResident() && v.hasValue();
+        const auto value = withValue ? v.getValueData()
+                                     : cb::const_char_buffer{};
+
+        RecordHeader record{};
+        record.cas = v.getCas();
+        record.revSeqno = v.getRevSeqno();
+        record.bySeqno = v.getBySeqno();
+        record.exptime = v.getExptime();
+        record.flags = v.getFlags();
+        record.valueLength = gsl::narrow<uint32_t>(value.size());
+        record.keyLength = gsl::narrow<uint16_t>(key.size());
+        record.freqCounter = v.getFreqCounterValue();
+        record.datatype = v.getDatatype();
+        record.nru = v.getNru();
+        record.hasValue = withValue;
+
+        append(&record, sizeof(record));
+        append(key.data(), key.size());
+        append(value.data(), value.size());
+        ++items;
+
+        if (block.size() >= HashTableImage::BlockSize) {
+            return flushBlock();
+        }
+        return true;
+    }
+
+    /// Write out the current block (if non-empty).
+    bool flushBlock() {
+        if (block.empty()) {
+            return true;
+        }
+        BlockHeader header{gsl::narrow<uint32_t>(block.size()),
+                           checksum(block.data(), block.size())};
+        if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+            fwrite(block.data(), block.size(), 1, fp) != 1) {
+            failed = true;
+            return false;
+        }
+        block.clear();
+        return true;
+    }
+
+    size_t items = 0;
+    bool failed = false;
+
+private:
+    void append(const void* data, size_t length) {
+        const auto* bytes = static_cast<const char*>(data);
+        block.insert(block.end(), bytes, bytes + length);
+    }
+
+    FILE* fp;
+    const bool includeValues;
+    std::vector<char> block;
+};
+
+} // anonymous namespace
+
+std::string HashTableImage::getFileName(const std::string& dbname,
+                                        Vbid vbid) {
+    return dbname + "/" + std::to_string(vbid.get()) + ".hashtable";
+}
+
+bool HashTableImage::write(const std::string& fileName,
+                           VBucket& vb,
+                           bool includeValues) {
+    const auto tmpName = fileName + ".tmp";
+    FILE* fp = fopen(tmpName.c_str(), "wb");
+    if (!fp) {
+        EP_LOG_WARN("HashTableImage::write: Failed to create {} error:{}",
+                    tmpName,
+                    strerror(errno));
+        return false;
+    }
+
+    // The header is written last, once the item count is known.
+    Header header{};
+    uint32_t headerCrc = 0;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(&headerCrc, sizeof(headerCrc), 1, fp) == 1;
+
+    ImageWriter writer(fp, includeValues);
+    if (ok) {
+        vb.ht.visit(writer);
+        const BlockHeader end{0, 0};
+        ok = !writer.failed && writer.flushBlock() &&
+             fwrite(&end, sizeof(end), 1, fp) == 1;
+    }
+
+    if (ok) {
+        header.magic = Magic;
+        header.version = Version;
+        header.vbid = vb.getId().get();
+        header.flags = includeValues ? IncludesValues : 0;
+        header.highSeqno = vb.getHighSeqno();
+        header.itemCount = writer.items;
+        headerCrc = checksum(&header, sizeof(header));
+        ok = fseek(fp, 0, SEEK_SET) == 0 &&
+             fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(&headerCrc, sizeof(headerCrc), 1, fp) == 1;
+    }
+
+    ok = (fclose(fp) == 0) && ok;
+    if (ok && std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        EP_LOG_WARN("HashTableImage::write: Failed to write {} error:{}",
+                    fileName,
+                    strerror(errno));
+        std::remove(tmpName.c_str());
+        return false;
+    }
+
+    EP_LOG_DEBUG("HashTableImage::write: Wrote {} items of {} to {}",
+                 writer.items,
+                 vb.getId(),
+                 fileName);
+    return true;
+}
+
+HashTableImage::LoadResult HashTableImage::load(const std::string& fileName,
+                                                Vbid vbid,
+                                                int64_t highSeqno,
+                                                StatusCallback<GetValue>& cb) {
+    LoadResult result;
+    if (!cb::io::isFile(fileName)) {
+        return result;
+    }
+
+    try {
+        cb::io::MemoryMappedFile map(fileName.c_str(),
+                                     cb::io::MemoryMappedFile::Mode::RDONLY);
+        const auto content = map.content();
+        const char* pos = content.data();
+        const char* const end = content.data() + content.size();
+
+        Header header;
+        uint32_t headerCrc;
+        if (content.size() < sizeof(header) + sizeof(headerCrc)) {
+            throw std::runtime_error("truncated header");
+        }
+        std::memcpy(&header, pos, sizeof(header));
+        std::memcpy(&headerCrc, pos + sizeof(header), sizeof(headerCrc));
+        pos += sizeof(header) + sizeof(headerCrc);
+        if (header.magic != Magic || header.version != Version ||
+            headerCrc != checksum(&header, sizeof(header))) {
+            throw std::runtime_error("invalid header");
+        }
+        if (header.vbid != vbid.get() || header.highSeqno != highSeqno) {
+            EP_LOG_INFO(
+                    "HashTableImage::load: Ignoring stale image {} of "
+                    "vb:{} seqno:{}, expected {} seqno:{}",
+                    fileName,
+                    header.vbid,
+                    header.highSeqno,
+                    vbid,
+                    highSeqno);
+            std::remove(fileName.c_str());
+            return result;
+        }
+
+        // Verify every block before loading anything, so a corrupt image
+        // leaves the vBucket untouched for the normal warmup.
+        std::vector<std::pair<const char*, size_t>> blocks;
+        while (true) {
+            BlockHeader block;
+            if (size_t(end - pos) < sizeof(block)) {
+                throw std::runtime_error("truncated image");
+            }
+            std::memcpy(&block, pos, sizeof(block));
+            pos += sizeof(block);
+            if (block.length == 0) {
+                break;
+            }
+            if (size_t(end - pos) < block.length ||
+                block.crc != checksum(pos, block.length)) {
+                throw std::runtime_error("corrupt block");
+            }
+            blocks.emplace_back(pos, block.length);
+            pos += block.length;
+        }
+
+        result.loaded = true;
+        result.includesValues = (header.flags & IncludesValues) != 0;
+        for (const auto& block : blocks) {
+            const char* rec = block.first;
+            const char* const blockEnd = block.first + block.second;
+            while (rec < blockEnd) {
+                RecordHeader record;
+                if (size_t(blockEnd - rec) < sizeof(record)) {
+                    throw std::runtime_error("truncated record");
+                }
+                std::memcpy(&record, rec, sizeof(record));
+                rec += sizeof(record);
+                if (size_t(blockEnd - rec) <
+                    size_t(record.keyLength) + record.valueLength) {
+                    throw std::runtime_error("truncated record");
+                }
+                const DocKey key(reinterpret_cast<const uint8_t*>(rec),
+                                 record.keyLength,
+                                 DocKeyEncodesCollectionId::Yes);
+                rec += record.keyLength;
+
+                auto item = std::make_unique<Item>(key,
+                                                   record.flags,
+                                                   record.exptime,
+                                                   rec,
+                                                   record.valueLength,
+                                                   record.datatype,
+                                                   record.cas,
+                                                   record.bySeqno,
+                                                   vbid,
+                                                   record.revSeqno,
+                                                   record.nru,
+                                                   record.freqCounter);
+                rec += record.valueLength;
+
+                GetValue gv(std::move(item),
+                            ENGINE_SUCCESS,
+                            -1,
+                            /*incomplete*/ !record.hasValue);
+                cb.callback(gv);
+                ++result.items;
+                if (record.hasValue) {
+                    ++result.values;
+                }
+                if (cb.getStatus() == ENGINE_ENOMEM) {
+                    result.stopped = true;
+                    std::remove(fileName.c_str());
+                    return result;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        EP_LOG_WARN("HashTableImage::load: Failed to load {} after {} items: {}",
+                    fileName,
+                    result.items,
+                    e.what());
+        // The blocks are verified up front, so a failure part way through
+        // loading would be a bug - either way the caller falls back to
+        // scanning the vBucket, which copes with any items already loaded.
+        result.loaded = false;
+    }
+
+    std::remove(fileName.c_str());
+    return result;
+}
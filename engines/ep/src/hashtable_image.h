@@ -0,0 +1,120 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * HashTable image
+ *
+ * On a clean shutdown each vBucket's HashTable can be written out to an
+ * image file (next to the vBucket's data file) holding the key and metadata
+ * of every live item, plus the value of resident items if requested. Warmup
+ * then memory-maps the image and streams it straight into the HashTable,
+ * instead of rebuilding every StoredValue by scanning the data file (and,
+ * with values, instead of the later data / access log loading of that
+ * vBucket). Items keep their frequency counter and NRU value, so the
+ * eviction state survives the restart too.
+ *
+ * An image is only valid for the exact on-disk state it was written from: it
+ * records the vBucket's high seqno, which warmup compares against the
+ * persisted vbucket_state. Warmup removes every image it encounters, so an
+ * image is used at most once; a stale, truncated or corrupt image is
+ * ignored and the vBucket is warmed up from its data file as normal.
+ *
+ * File layout (host byte order - an image is only read by the node which
+ * wrote it, the magic catches anything else):
+ *
+ *     Header      magic, version, vbid, flags, high seqno, item count
+ *     uint32_t    crc32 of the header
+ *     Block*      uint32_t length, uint32_t crc32, length bytes of records
+ *     Block       length 0 - end of image
+ *
+ * Each record is a RecordHeader followed by the (collection-encoded) key and
+ * then the value, if the record has one.
+ */
+
+#include "config.h"
+
+#include <memcached/vbucket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class GetValue;
+template <typename... RV>
+class StatusCallback;
+class VBucket;
+
+class HashTableImage {
+public:
+    /// Outcome of loading an image.
+    struct LoadResult {
+        /// Image existed, was valid and matched the vBucket's on-disk state.
+        bool loaded = false;
+        /// The image included values for the resident items.
+        bool includesValues = false;
+        /// Loading stopped early as the callback reported ENGINE_ENOMEM.
+        bool stopped = false;
+        /// Items passed to the callback.
+        size_t items = 0;
+        /// Of those, the items which had their value.
+        size_t values = 0;
+    };
+
+    /// @returns the name of the image file of the given vBucket.
+    static std::string getFileName(const std::string& dbname, Vbid vbid);
+
+    /**
+     * Write an image of the vBucket's HashTable. The image is written to a
+     * temporary file and renamed into place, so a partially written image is
+     * never picked up.
+     *
+     * The caller must ensure everything in the HashTable has been persisted
+     * (and that nothing is modifying the vBucket).
+     *
+     * @param fileName image file to create (replacing any existing one)
+     * @param vb vBucket to write out
+     * @param includeValues write the value of resident items
+     * @return true if the image was written
+     */
+    static bool write(const std::string& fileName,
+                      VBucket& vb,
+                      bool includeValues);
+
+    /**
+     * Load an image, passing each item to the callback (as a partial
+     * GetValue when the item has no value). The image file is removed
+     * whether or not it could be used.
+     *
+     * @param fileName image file to load
+     * @param vbid vBucket the image must be of
+     * @param highSeqno the persisted high seqno the image must be of
+     * @param cb callback to pass the items to
+     */
+    static LoadResult load(const std::string& fileName,
+                           Vbid vbid,
+                           int64_t highSeqno,
+                           StatusCallback<GetValue>& cb);
+
+    /// Magic identifying an image ('HTIM').
+    static const uint32_t Magic = 0x4854494d;
+    static const uint32_t Version = 1;
+
+    /// Records are appended to a block until it reaches this size.
+    static const size_t BlockSize = 256 * 1024;
+};
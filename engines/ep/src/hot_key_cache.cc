@@ -0,0 +1,59 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "hot_key_cache.h"
+
+#include "ep_time.h"
+
+#include <stdexcept>
+
+HotKeyCache::HotKeyCache(size_t numSlots)
+    : slots(numSlots), hits(0), misses(0) {
+    if (numSlots == 0) {
+        throw std::invalid_argument(
+                "HotKeyCache: numSlots must be non-zero");
+    }
+}
+
+std::unique_ptr<Item> HotKeyCache::get(const DocKey& key,
+                                       HashTable::LockVersion version) {
+    // Take a reference to the entry; it cannot change underneath us.
+    const RCPtr<Entry> entry(slotFor(key));
+    if (!entry || !(entry->version == version) ||
+        !(entry->item.getKey() == key)) {
+        ++misses;
+        return nullptr;
+    }
+
+    const auto exptime = entry->item.getExptime();
+    if (exptime != 0 && exptime < ep_real_time()) {
+        // Let the normal path expire it.
+        ++misses;
+        return nullptr;
+    }
+
+    ++hits;
+    return std::make_unique<Item>(entry->item);
+}
+
+void HotKeyCache::insert(const Item& item, HashTable::LockVersion version) {
+    slotFor(item.getKey()).reset(new Entry(item, version));
+}
+
+RCPtr<HotKeyCache::Entry>& HotKeyCache::slotFor(const DocKey& key) {
+    return slots[key.hash() % slots.size()];
+}
@@ -0,0 +1,97 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "atomic.h"
+#include "hash_table.h"
+#include "item.h"
+
+#include <relaxed_atomic.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * Bounded cache of immutable snapshots of the hottest items of one
+ * HashTable, allowing GETs of them to be served without acquiring their
+ * HashBucketLock or converting the StoredValue into an Item.
+ *
+ * The cache is direct-mapped: each key hashes to one slot, and admitting a
+ * key replaces whatever the slot held. Which items are admitted is up to the
+ * caller (VBucket admits items whose frequency counter is high).
+ *
+ * Entries are never explicitly invalidated. Instead each records the
+ * HashTable::LockVersion of the key's HashBucketLock when it was admitted;
+ * any change to a StoredValue requires acquiring its lock exclusively, which
+ * changes the version and so makes the entry stale. As such hits are only
+ * likely while the key's lock isn't otherwise being acquired exclusively.
+ *
+ * Lookups and insertions only take the (per-slot) spinlock of the slot's
+ * RCPtr, never a HashBucketLock.
+ */
+class HotKeyCache {
+public:
+    /**
+     * @param numSlots number of slots (maximum number of cached items).
+     */
+    explicit HotKeyCache(size_t numSlots);
+
+    /**
+     * Look up an item.
+     *
+     * @param key the key to look up
+     * @param version the current LockVersion of the key's HashBucketLock
+     * @return a copy of the cached item, or nullptr if the key is not cached,
+     *         the entry is stale or the item has expired.
+     */
+    std::unique_ptr<Item> get(const DocKey& key,
+                              HashTable::LockVersion version);
+
+    /**
+     * Admit an item, replacing any other item in its slot. Must be called
+     * while holding the item's HashBucketLock.
+     *
+     * @param item the item to cache (copied)
+     * @param version the LockVersion of the (held) HashBucketLock
+     */
+    void insert(const Item& item, HashTable::LockVersion version);
+
+    size_t getHits() const {
+        return hits;
+    }
+
+    size_t getMisses() const {
+        return misses;
+    }
+
+private:
+    struct Entry : public RCValue {
+        Entry(const Item& item, HashTable::LockVersion version)
+            : item(item), version(version) {
+        }
+
+        const Item item;
+        const HashTable::LockVersion version;
+    };
+
+    RCPtr<Entry>& slotFor(const DocKey& key);
+
+    std::vector<RCPtr<Entry>> slots;
+    Couchbase::RelaxedAtomic<size_t> hits;
+    Couchbase::RelaxedAtomic<size_t> misses;
+};
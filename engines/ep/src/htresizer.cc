@@ -30,11 +30,35 @@
  */
 class ResizingVisitor : public VBucketVisitor {
 public:
-    ResizingVisitor() { }
+    /**
+     * @param incremental If true, resize each HashTable incrementally
+     *        (see HashTable::startIncrementalResize()) rather than in one
+     *        blocking pass.
+     * @param stepSize Number of buckets to migrate per incremental step.
+     */
+    ResizingVisitor(bool incremental, size_t stepSize)
+        : incremental(incremental), stepSize(stepSize) {
+    }
 
     void visitBucket(VBucketPtr &vb) override {
-        vb->ht.resize();
+        if (!incremental) {
+            vb->ht.resize();
+            return;
+        }
+
+        if (!vb->ht.isResizing()) {
+            vb->ht.startIncrementalResize();
+        }
+        // Each step only holds the locks for the buckets being migrated, so
+        // front-end operations can interleave between steps. Stops early
+        // if a HashTable visitor is running; the next run will continue.
+        while (vb->ht.isResizing() && vb->ht.incrementalResizeStep(stepSize)) {
+        }
     }
+
+private:
+    const bool incremental;
+    const size_t stepSize;
 };
 
 HashtableResizerTask::HashtableResizerTask(KVBucketIface& s, double sleepTime)
@@ -47,13 +71,17 @@ HashtableResizerTask::HashtableResizerTask(KVBucketIface& s, double sleepTime)
 
 bool HashtableResizerTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "HashtableResizerTask");
-    auto pv = std::make_unique<ResizingVisitor>();
+    const auto& config = engine->getConfiguration();
+    auto pv = std::make_unique<ResizingVisitor>(
+            config.getHtResizeMode() == "incremental",
+            config.getHtResizeStepSize());
 
-    // [per-VBucket Task] While a Hashtable is resizing no user
-    // requests can be performed (the resizing process needs to
+    // [per-VBucket Task] While a Hashtable is resizing in blocking mode no
+    // user requests can be performed (the resizing process needs to
     // acquire all HT locks). As such we are sensitive to the duration
     // of this task - we want to log anything which has a
-    // non-negligible impact on frontend operations.
+    // non-negligible impact on frontend operations. (In incremental mode
+    // user requests are only blocked for the duration of a single step.)
     const auto maxExpectedDuration = std::chrono::milliseconds(100);
 
     store.visit(std::move(pv),
@@ -20,6 +20,7 @@
 #include "ep_time.h"
 #include "item.h"
 #include "item_eviction.h"
+#include "item_pool.h"
 #include "objectregistry.h"
 
 #include <cJSON.h>
@@ -130,6 +131,29 @@ Item::~Item() {
     ObjectRegistry::onDeleteItem(this);
 }
 
+void* Item::operator new(size_t count) {
+    // Objects of any (larger) derived type aren't pooled.
+    if (count == sizeof(Item)) {
+        auto* pool = ObjectRegistry::getItemPool();
+        if (pool) {
+            if (auto* block = pool->allocate()) {
+                return block;
+            }
+        }
+    }
+    return ::operator new(count);
+}
+
+void Item::operator delete(void* ptr, size_t count) {
+    if (count == sizeof(Item)) {
+        auto* pool = ObjectRegistry::getItemPool();
+        if (pool && pool->deallocate(ptr)) {
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
 std::string to_string(queue_op op) {
     switch(op) {
     case queue_op::mutation:
@@ -238,11 +262,15 @@ std::ostream& operator<<(std::ostream& os, const Blob& b) {
 }
 
 bool Item::compressValue() {
+    cb::compression::Buffer deflated;
+    return compressValue(deflated);
+}
+
+bool Item::compressValue(cb::compression::Buffer& deflated) {
     auto datatype = getDataType();
     if (!mcbp::datatype::is_snappy(datatype)) {
         // Attempt compression only if datatype indicates
         // that the value is not compressed already.
-        cb::compression::Buffer deflated;
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
                                      {getData(), getNBytes()}, deflated)) {
             if (deflated.size() > getNBytes()) {
@@ -262,11 +290,15 @@ bool Item::compressValue() {
 }
 
 bool Item::decompressValue() {
+    cb::compression::Buffer inflated;
+    return decompressValue(inflated);
+}
+
+bool Item::decompressValue(cb::compression::Buffer& inflated) {
     uint8_t datatype = getDataType();
     if (mcbp::datatype::is_snappy(datatype)) {
         // Attempt decompression only if datatype indicates
         // that the value is compressed.
-        cb::compression::Buffer inflated;
         if (cb::compression::inflate(cb::compression::Algorithm::Snappy,
                                      {getData(), getNBytes()}, inflated)) {
             setData(inflated.data(), inflated.size());
@@ -26,6 +26,7 @@
 #include <mcbp/protocol/datatype.h>
 #include <memcached/durability_spec.h>
 #include <memcached/types.h>
+#include <platform/compress.h>
 #include <platform/n_byte_integer.h>
 #include <string>
 
@@ -187,6 +188,13 @@ public:
 
     ~Item();
 
+    /**
+     * Items are allocated from the ItemPool of the current engine when it
+     * has a free block, and freed to it when it has room.
+     */
+    static void* operator new(size_t count);
+    static void operator delete(void* ptr, size_t count);
+
     static Item* makeDeletedItem(
             DeleteSource cause,
             const DocKey& k,
@@ -220,9 +228,19 @@ public:
     /* Snappy compress value and update datatype */
     bool compressValue();
 
+    /**
+     * Snappy compress value and update datatype, compressing into the given
+     * buffer first. Compressing many items using the same buffer saves
+     * allocating one for each of them.
+     */
+    bool compressValue(cb::compression::Buffer& scratch);
+
     /* Snappy uncompress value and update datatype */
     bool decompressValue();
 
+    /// As decompressValue(), inflating into the given buffer first
+    bool decompressValue(cb::compression::Buffer& scratch);
+
     const char *getData() const {
         return value ? value->getData() : NULL;
     }
@@ -59,11 +59,13 @@ bool ItemCompressorTask::run(void) {
         // Prepare the underlying visitor.
         auto& visitor = getItemCompressorVisitor();
         const auto start = std::chrono::steady_clock::now();
-        const auto deadline = start + getChunkDuration();
+        const auto deadline = getWorkBudgetDeadline(getChunkDuration());
         visitor.setDeadline(deadline);
         visitor.clearStats();
         visitor.setCompressionMode(engine->getCompressionMode());
         visitor.setMinCompressionRatio(engine->getMinCompressionRatio());
+        visitor.setCompressibility(
+                &engine->getKVBucket()->getCompressibility());
 
         // Do it - set off the visitor.
         epstore_position = engine->getKVBucket()->pauseResumeVisit(
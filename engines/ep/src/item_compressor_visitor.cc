@@ -39,8 +39,9 @@ bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
                                   StoredValue& v) {
 
     // Check if the item can be compressed
-    if (compressMode == BucketCompressionMode::Active && v.isCompressible()) {
-        cb::compression::Buffer deflated;
+    if (compressMode == BucketCompressionMode::Active && v.isCompressible() &&
+        (!compressibility ||
+         compressibility->shouldAttempt(v.getKey().getCollectionID()))) {
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
                                      {v.getValue()->getData(), v.valuelen()},
                                      deflated)) {
@@ -49,8 +50,13 @@ bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
 
             // Compress the document only if the compression ratio is greater
             // than or equal to the current minium compression ratio
-            if (comp_ratio >= currentMinCompressionRatio) {
-                currentVb->ht.storeCompressedBuffer(deflated, v);
+            const bool compress = comp_ratio >= currentMinCompressionRatio;
+            if (compressibility) {
+                compressibility->recordAttempt(v.getKey().getCollectionID(),
+                                               compress);
+            }
+            if (compress) {
+                currentVb->ht.storeCompressedBuffer(lh, deflated, v);
 
                 // If the value was compressed, increment the count of number
                 // of compressed documents
@@ -93,3 +99,8 @@ void ItemCompressorVisitor::setCurrentVBucket(VBucket& vb) {
 void ItemCompressorVisitor::setMinCompressionRatio(float minCompressionRatio) {
     currentMinCompressionRatio = minCompressionRatio;
 }
+
+void ItemCompressorVisitor::setCompressibility(
+        CompressibilityTracker* tracker) {
+    compressibility = tracker;
+}
@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "compressibility_tracker.h"
 #include "hash_table.h"
 #include "item.h"
 #include "progress_tracker.h"
@@ -44,6 +45,10 @@ public:
     // Set the minimum compression ratio
     void setMinCompressionRatio(float minCompressionRatio);
 
+    // Set where to learn (and check) how well each collection compresses.
+    // If not set every compressible document is compressed.
+    void setCompressibility(CompressibilityTracker* tracker);
+
     // Implementation of HashTableVisitor interface:
     virtual bool visit(const HashTable::HashBucketLock& lh,
                        StoredValue& v) override;
@@ -79,4 +84,11 @@ private:
 
     // The current minimum compression ratio supported by the bucket
     float currentMinCompressionRatio;
+
+    // How well the documents of each collection compress
+    CompressibilityTracker* compressibility = nullptr;
+
+    // Values are compressed into this before being copied into their Blob,
+    // reused for every value visited.
+    cb::compression::Buffer deflated;
 };
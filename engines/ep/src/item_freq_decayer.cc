@@ -49,8 +49,21 @@ bool ItemFreqDecayerTask::run(void) {
     // then resume from where we last were, otherwise create a new visitor
     // starting from the beginning.
     if (!prAdapter) {
+        const bool lazy = engine->getConfiguration().isItemFreqDecayerLazy();
+        if (lazy) {
+            decayLazily();
+            // Visit the documents only every lazyVisitInterval decays, to
+            // apply the pending decays of the idle ones before their decay
+            // epochs wrap. No decays are made while visiting (notified is
+            // set until the visit completes).
+            if (++lazyDecays % lazyVisitInterval != 0) {
+                completed = true;
+                notified.store(false);
+                return !engine->getEpStats().isShutdown;
+            }
+        }
         prAdapter = std::make_unique<PauseResumeVBAdapter>(
-                std::make_unique<ItemFreqDecayerVisitor>(percentage));
+                std::make_unique<ItemFreqDecayerVisitor>(percentage, lazy));
         epstore_position = engine->getKVBucket()->startPosition();
         completed = false;
     }
@@ -70,7 +83,7 @@ bool ItemFreqDecayerTask::run(void) {
     // Prepare the underlying visitor.
     auto& visitor = getItemFreqDecayerVisitor();
     const auto start = std::chrono::steady_clock::now();
-    const auto deadline = start + getChunkDuration();
+    const auto deadline = getWorkBudgetDeadline(getChunkDuration());
     visitor.setDeadline(deadline);
     visitor.clearStats();
 
@@ -113,6 +126,19 @@ bool ItemFreqDecayerTask::run(void) {
     return true;
 }
 
+void ItemFreqDecayerTask::decayLazily() {
+    auto* kvBucket = engine->getKVBucket();
+    for (auto vbid : kvBucket->getVBuckets().getBuckets()) {
+        auto vb = kvBucket->getVBucket(vbid);
+        if (vb) {
+            vb->ht.decayFreqCounters(percentage);
+        }
+    }
+    EP_LOG_DEBUG("{} for bucket '{}' decayed lazily",
+                 getDescription(),
+                 engine->getName());
+}
+
 void ItemFreqDecayerTask::stop(void) {
     if (uid) {
         ExecutorPool::get()->cancel(uid);
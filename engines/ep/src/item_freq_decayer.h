@@ -61,6 +61,17 @@ private:
     // Returns the underlying AgeVisitor instance.
     ItemFreqDecayerVisitor& getItemFreqDecayerVisitor();
 
+    // Decay the frequency counters of every vBucket's HashTable lazily.
+    void decayLazily();
+
+    // With lazy decay, how many decays are made between each visit of all
+    // the documents. Must be less than the 256 decays a HashTable's decay
+    // epoch takes to wrap.
+    static const size_t lazyVisitInterval = 128;
+
+    // The number of lazy decays made.
+    size_t lazyDecays = 0;
+
     // Opaque marker indicating how far through the epStore we have visited.
     KVBucketIface::Position epstore_position;
 
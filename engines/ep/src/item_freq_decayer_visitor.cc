@@ -16,11 +16,17 @@
  */
 
 #include "item_freq_decayer_visitor.h"
+#include "vbucket.h"
 
 // AgeVisitor implementation ///////////////////////////////////////////
 
-ItemFreqDecayerVisitor::ItemFreqDecayerVisitor(uint16_t percentage_)
-    : percentage(percentage_), visitedCount(0) {
+ItemFreqDecayerVisitor::ItemFreqDecayerVisitor(uint16_t percentage_,
+                                               bool lazy_)
+    : percentage(percentage_), lazy(lazy_), visitedCount(0) {
+}
+
+void ItemFreqDecayerVisitor::setCurrentVBucket(VBucket& vb) {
+    currentHashTable = &vb.ht;
 }
 
 void ItemFreqDecayerVisitor::setDeadline(
@@ -30,8 +36,13 @@ void ItemFreqDecayerVisitor::setDeadline(
 
 bool ItemFreqDecayerVisitor::visit(const HashTable::HashBucketLock& lh,
                                    StoredValue& v) {
-    // age the value's frequency counter by the given percentage
-    v.setFreqCounterValue(v.getFreqCounterValue() * (percentage * 0.01));
+    if (currentHashTable) {
+        currentHashTable->applyFreqDecay(v);
+    }
+    if (!lazy) {
+        // age the value's frequency counter by the given percentage
+        v.setFreqCounterValue(v.getFreqCounterValue() * (percentage * 0.01));
+    }
     visitedCount++;
 
     // See if we have done enough work for this chunk. If so
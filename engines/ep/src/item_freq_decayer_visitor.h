@@ -26,10 +26,14 @@
 /**
  * Visit all documents in a hash table and reduce the frequency count of each
  * document by a given percentage.
+ *
+ * If lazy, the frequency counts have been decayed lazily (see
+ * HashTable::decayFreqCounters) and the visitor only applies the pending
+ * decays to each document.
  */
 class ItemFreqDecayerVisitor : public VBucketAwareHTVisitor {
 public:
-    ItemFreqDecayerVisitor(uint16_t percentage_);
+    ItemFreqDecayerVisitor(uint16_t percentage_, bool lazy_ = false);
 
     ~ItemFreqDecayerVisitor() = default;
 
@@ -41,6 +45,8 @@ public:
     // constructed.
     bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override;
 
+    void setCurrentVBucket(VBucket& vb) override;
+
     // Resets any held stats to zero.
     void clearStats();
 
@@ -55,8 +61,14 @@ private:
     // 100 would reset the counter to zero.
     const uint16_t percentage;
 
+    // Only apply the pending lazy decays.
+    const bool lazy;
+
     /* Runtime state */
 
+    // The HashTable being visited (to apply its pending lazy decays).
+    HashTable* currentHashTable = nullptr;
+
     // Estimates how far we have got, and when we should pause.
     ProgressTracker progressTracker;
 
@@ -28,8 +28,10 @@
 #include "item_eviction.h"
 #include "kv_bucket.h"
 #include "kv_bucket_iface.h"
+#include "memory_arbiter.h"
 #include "paging_visitor.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
@@ -37,6 +39,7 @@
 #include <list>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <phosphor/phosphor.h>
 #include <memory>
@@ -62,6 +65,31 @@ ItemPager::ItemPager(EventuallyPersistentEngine& e, EPStats& st)
     }
 }
 
+/**
+ * Sums the memory used by each collection's items across all vbuckets.
+ */
+class CollectionMemUsedVBucketVisitor : public VBucketVisitor {
+public:
+    void visitBucket(VBucketPtr& vb) override {
+        vb->lockCollections().updateMemUsedSummary(memUsed);
+    }
+    Collections::Summary memUsed;
+};
+
+std::unordered_map<CollectionID, size_t> ItemPager::getCollectionsOverQuota(
+        KVBucket& bucket, size_t quota) {
+    CollectionMemUsedVBucketVisitor visitor;
+    bucket.visit(visitor);
+
+    std::unordered_map<CollectionID, size_t> overQuota;
+    for (const auto& entry : visitor.memUsed) {
+        if (entry.second > quota) {
+            overQuota[entry.first] = entry.second - quota;
+        }
+    }
+    return overQuota;
+}
+
 bool ItemPager::run(void) {
     TRACE_EVENT0("ep-engine/task", "ItemPager");
 
@@ -77,6 +105,11 @@ bool ItemPager::run(void) {
     // Clear the notification flag before starting the task's actions
     notified.store(false);
 
+    if (engine.getConfiguration().isMemQuotaSharing()) {
+        // Borrow (or reclaim lent) quota before deciding whether to evict
+        MemoryArbiter::get().rebalance(wasNotified);
+    }
+
     KVBucket* kvBucket = engine.getKVBucket();
     double current = static_cast<double>(stats.getEstimatedTotalMemoryUsed());
     double upper = static_cast<double>(stats.mem_high_wat);
@@ -147,34 +180,97 @@ bool ItemPager::run(void) {
         }
 
         bool isEphemeral = (cfg.getBucketType() == "ephemeral");
+        // Ephemeral buckets delete their victims to free memory; sample for
+        // them by default so memory is reclaimed as soon as the pager runs,
+        // rather than after a sweep of each vBucket's HashTable.
+        auto sampleSize = cfg.getItemEvictionSampleSize();
+        if (isEphemeral && sampleSize == 0) {
+            sampleSize = cfg.getEphemeralAutoDeleteSampleSize();
+        }
         PagingVisitor::EvictionPolicy evictionPolicy =
                 (cfg.getHtEvictionPolicy() == "2-bit_lru")
                         ? PagingVisitor::EvictionPolicy::lru2Bit
                         : PagingVisitor::EvictionPolicy::hifi_mfu;
 
-        auto pv = std::make_unique<PagingVisitor>(
-                *kvBucket,
-                stats,
-                toKill,
-                available,
-                ITEM_PAGER,
-                false,
-                bias,
-                filter,
-                &phase,
-                isEphemeral,
-                cfg.getItemEvictionAgePercentage(),
-                cfg.getItemEvictionFreqCounterAgeThreshold(),
-                evictionPolicy);
+        // Split the run over several visitor tasks, each taking every n'th
+        // vBucket, so that large buckets are evicted from in parallel.
+        std::vector<VBucketFilter> partitions;
+        const size_t maxTasks = cfg.getPagerVisitorTasks();
+        if (maxTasks > 1) {
+            const auto vbuckets =
+                    filter.empty() ? kvBucket->getVBuckets().getBuckets()
+                                   : std::vector<Vbid>(filter.getVBSet().begin(),
+                                                       filter.getVBSet().end());
+            partitions.resize(std::max(
+                    size_t(1), std::min(maxTasks, vbuckets.size())));
+            for (size_t ii = 0; ii < vbuckets.size(); ++ii) {
+                partitions[ii % partitions.size()].addVBucket(vbuckets[ii]);
+            }
+        } else {
+            partitions.push_back(filter);
+        }
+
+        std::shared_ptr<PagingVisitor::Group> group;
+        if (partitions.size() > 1) {
+            group = std::make_shared<PagingVisitor::Group>(partitions.size());
+        }
+
+        std::unordered_map<CollectionID, size_t> overQuota;
+        const auto quotaPercentage =
+                cfg.getItemEvictionCollectionQuotaPercentage();
+        if (quotaPercentage > 0) {
+            overQuota = getCollectionsOverQuota(
+                    *kvBucket, stats.getMaxDataSize() * quotaPercentage / 100);
+            // Each visitor frees its share of the excess.
+            const auto shares = partitions.size();
+            for (auto& collection : overQuota) {
+                collection.second = (collection.second + shares - 1) / shares;
+            }
+        }
 
         // p99.99 is ~200ms
         const auto maxExpectedDuration = std::chrono::milliseconds(200);
 
-        kvBucket->visit(std::move(pv),
-                        "Item pager",
-                        TaskId::ItemPagerVisitor,
-                        /*sleepTime*/ 0,
-                        maxExpectedDuration);
+        for (const auto& partition : partitions) {
+            auto pv = std::make_unique<PagingVisitor>(
+                    *kvBucket,
+                    stats,
+                    toKill,
+                    available,
+                    ITEM_PAGER,
+                    false,
+                    bias,
+                    partition,
+                    &phase,
+                    isEphemeral,
+                    cfg.getItemEvictionAgePercentage(),
+                    cfg.getItemEvictionFreqCounterAgeThreshold(),
+                    evictionPolicy);
+            pv->setSampleSize(sampleSize);
+            if (cfg.isItemEvictionCompressValues() &&
+                engine.getCompressionMode() != BucketCompressionMode::Off) {
+                pv->setCompressBeforeEject(engine.getMinCompressionRatio());
+            }
+            if (kvBucket->getValueTier()) {
+                pv->setValueTier(kvBucket->getValueTier());
+            }
+            if (!isEphemeral && kvBucket->getReplicaValuePolicy() ==
+                                        ReplicaValuePolicy::Eject) {
+                pv->setEjectReplicaValues();
+            }
+            if (!overQuota.empty()) {
+                pv->setCollectionsOverQuota(overQuota);
+            }
+            if (group) {
+                pv->setGroup(group);
+            }
+
+            kvBucket->visit(std::move(pv),
+                            "Item pager",
+                            TaskId::ItemPagerVisitor,
+                            /*sleepTime*/ 0,
+                            maxExpectedDuration);
+        }
     }
 
     return true;
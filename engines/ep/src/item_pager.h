@@ -20,11 +20,16 @@
 
 #include "globaltask.h"
 
+#include <memcached/dockey.h>
+
+#include <unordered_map>
+
 typedef std::pair<int64_t, int64_t> row_range_t;
 
 // Forward declaration.
 class EPStats;
 class EventuallyPersistentEngine;
+class KVBucket;
 
 /**
  * The item pager phase
@@ -75,6 +80,15 @@ public:
      */
     void scheduleNow();
 
+    /**
+     * @param quota the memory each collection's items may use (summed over
+     *        all vbuckets)
+     * @return the collections using more than the quota, mapped to how many
+     *         bytes over it they are
+     */
+    static std::unordered_map<CollectionID, size_t> getCollectionsOverQuota(
+            KVBucket& bucket, size_t quota);
+
 private:
     EventuallyPersistentEngine& engine;
     EPStats& stats;
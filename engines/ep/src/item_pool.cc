@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "item_pool.h"
+
+#include <new>
+
+ItemPool::~ItemPool() {
+    for (auto& list : freeLists) {
+        std::lock_guard<std::mutex> lh(list->mutex);
+        for (size_t ii = 0; ii < list->count; ++ii) {
+            ::operator delete(list->blocks[ii]);
+        }
+        list->count = 0;
+    }
+}
+
+void* ItemPool::allocate() {
+    auto& list = freeLists.get();
+    std::lock_guard<std::mutex> lh(list->mutex);
+    if (list->count == 0) {
+        return nullptr;
+    }
+    return list->blocks[--list->count];
+}
+
+bool ItemPool::deallocate(void* block) {
+    auto& list = freeLists.get();
+    std::lock_guard<std::mutex> lh(list->mutex);
+    if (list->count == BlocksPerCore) {
+        return false;
+    }
+    list->blocks[list->count++] = block;
+    return true;
+}
+
+size_t ItemPool::size() const {
+    size_t total = 0;
+    for (const auto& list : freeLists) {
+        std::lock_guard<std::mutex> lh(list->mutex);
+        total += list->count;
+    }
+    return total;
+}
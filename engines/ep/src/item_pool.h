@@ -0,0 +1,77 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <platform/cacheline_padded.h>
+#include <platform/corestore.h>
+
+#include <array>
+#include <mutex>
+
+/**
+ * A per-bucket cache of freed Item allocations, so that the Items created
+ * for every request (e.g. to return a document to a GET) can reuse memory
+ * instead of each being allocated from, and freed back to, the heap - along
+ * with the memory tracking of each allocation.
+ *
+ * The free blocks are kept per CPU core (each list guarded by its own,
+ * normally uncontended, mutex), up to BlocksPerCore per core; blocks freed
+ * beyond that are returned to the heap. The blocks are still accounted as
+ * allocated to the bucket while cached.
+ *
+ * See Item::operator new / delete.
+ */
+class ItemPool {
+public:
+    /// Most free blocks cached per core.
+    static constexpr size_t BlocksPerCore = 64;
+
+    ItemPool() = default;
+
+    ItemPool(const ItemPool&) = delete;
+    ItemPool& operator=(const ItemPool&) = delete;
+
+    /// Returns all the cached blocks to the heap.
+    ~ItemPool();
+
+    /**
+     * @return a free block (of the size of an Item) of the calling thread's
+     *         core, or nullptr if it has none.
+     */
+    void* allocate();
+
+    /**
+     * Cache a block of an Item which has been destroyed.
+     * @return false if the calling thread's core has no room for it (so it
+     *         must be freed by the caller).
+     */
+    bool deallocate(void* block);
+
+    /// @return the number of free blocks cached.
+    size_t size() const;
+
+private:
+    struct FreeList {
+        mutable std::mutex mutex;
+        std::array<void*, BlocksPerCore> blocks;
+        size_t count = 0;
+    };
+
+    CoreStore<cb::CachelinePadded<FreeList>> freeLists;
+};
@@ -20,16 +20,20 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <memcached/server_document_iface.h>
 #include <phosphor/phosphor.h>
+#include <platform/timeutils.h>
 #include <utilities/logtags.h>
 
 #include "access_scanner.h"
@@ -52,6 +56,7 @@
 #include "kvshard.h"
 #include "kvstore.h"
 #include "locks.h"
+#include "memory_arbiter.h"
 #include "mutation_log.h"
 #include "replicationthrottle.h"
 #include "statwriter.h"
@@ -72,16 +77,7 @@ public:
 
     void sizeValueChanged(const std::string& key, size_t value) override {
         if (key.compare("max_size") == 0) {
-            stats.setMaxDataSize(value);
-            store.getEPEngine().getDcpConnMap(). \
-                                     updateMaxActiveSnoozingBackfills(value);
-            size_t low_wat = static_cast<size_t>
-                    (static_cast<double>(value) * stats.mem_low_wat_percent);
-            size_t high_wat = static_cast<size_t>
-                    (static_cast<double>(value) * stats.mem_high_wat_percent);
-            stats.mem_low_wat.store(low_wat);
-            stats.mem_high_wat.store(high_wat);
-            store.setCursorDroppingLowerUpperThresholds(value);
+            store.setMaxDataSize(value);
         } else if (key.compare("mem_low_wat") == 0) {
             stats.mem_low_wat.store(value);
             stats.mem_low_wat_percent.store(
@@ -97,6 +93,8 @@ public:
             stats.warmupMemUsedCap.store(static_cast<double>(value) / 100.0);
         } else if (key.compare("warmup_min_items_threshold") == 0) {
             stats.warmupNumReadCap.store(static_cast<double>(value) / 100.0);
+        } else if (key.compare("lock_profile_sample_rate") == 0) {
+            stats.lockProfiles.setSampleRate(value);
         } else {
             EP_LOG_WARN(
                     "StatsValueChangeListener(size_t) failed to change value "
@@ -152,8 +150,15 @@ public:
             store.setCompactionExpMemThreshold(value);
         } else if (key.compare("replication_throttle_cap_pcnt") == 0) {
             store.getEPEngine().getReplicationThrottle().setCapPercent(value);
+        } else if (key.compare("replication_throttle_min_rate") == 0) {
+            store.getEPEngine().getReplicationThrottle().setMinRate(value);
+        } else if (key.compare("replication_throttle_shaping_band_pcnt") == 0) {
+            store.getEPEngine().getReplicationThrottle().setShapingBandPercent(
+                    value);
         } else if (key.compare("max_ttl") == 0) {
             store.setMaxTtl(value);
+        } else if (key.compare("task_profile_slow_runs") == 0) {
+            store.getTaskProfile().setMaxSlowRuns(value);
         } else {
             EP_LOG_WARN("Failed to change value for unknown variable, {}", key);
         }
@@ -184,6 +189,8 @@ public:
             }
         } else if (key.compare("xattr_enabled") == 0) {
             store.setXattrEnabled(value);
+        } else if (key.compare("replication_throttle_rate_shaping") == 0) {
+            store.getEPEngine().getReplicationThrottle().setRateShaping(value);
         }
     }
 
@@ -195,6 +202,12 @@ public:
         }
     }
 
+    virtual void stringValueChanged(const std::string& key, const char* value) {
+        if (key == "replica_value_policy") {
+            store.setReplicaValuePolicy(value);
+        }
+    }
+
 private:
     KVBucket& store;
 };
@@ -321,6 +334,15 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
     config.addValueChangedListener(
             "replication_throttle_cap_pcnt",
             std::make_unique<EPStoreValueChangeListener>(*this));
+    config.addValueChangedListener(
+            "replication_throttle_rate_shaping",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+    config.addValueChangedListener(
+            "replication_throttle_min_rate",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+    config.addValueChangedListener(
+            "replication_throttle_shaping_band_pcnt",
+            std::make_unique<EPStoreValueChangeListener>(*this));
 
     stats.warmupMemUsedCap.store(static_cast<double>
                                (config.getWarmupMinMemoryThreshold()) / 100.0);
@@ -333,6 +355,11 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
             "warmup_min_items_threshold",
             std::make_unique<StatsValueChangeListener>(stats, *this));
 
+    stats.lockProfiles.setSampleRate(config.getLockProfileSampleRate());
+    config.addValueChangedListener(
+            "lock_profile_sample_rate",
+            std::make_unique<StatsValueChangeListener>(stats, *this));
+
     double mem_threshold = static_cast<double>
                                       (config.getMutationMemThreshold()) / 100;
     VBucket::setMutationMemoryThreshold(mem_threshold);
@@ -377,6 +404,16 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
     config.addValueChangedListener(
             "max_ttl", std::make_unique<EPStoreValueChangeListener>(*this));
 
+    setReplicaValuePolicy(config.getReplicaValuePolicy());
+    config.addValueChangedListener(
+            "replica_value_policy",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+
+    taskProfile.setMaxSlowRuns(config.getTaskProfileSlowRuns());
+    config.addValueChangedListener(
+            "task_profile_slow_runs",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+
     xattrEnabled = config.isXattrEnabled();
 
     // Always create the item pager; but initially disable, leaving scheduling
@@ -394,6 +431,19 @@ bool KVBucket::initialize() {
         reset();
     }
 
+    if (config.getValueTierSize() > 0) {
+        try {
+            valueTier.reset(new ValueTier(config.getValueTierSize(),
+                                          config.getValueTierPath(),
+                                          config.getValueTierNumaNode()));
+            EP_LOG_INFO("Mapped a value tier of {} bytes",
+                        valueTier->getCapacity());
+        } catch (const std::system_error& error) {
+            EP_LOG_WARN("KVBucket::initialize: No value tier: {}",
+                        error.what());
+        }
+    }
+
     startWarmupTask();
 
     initializeExpiryPager(config);
@@ -410,6 +460,12 @@ bool KVBucket::initialize() {
             std::make_shared<WorkLoadMonitor>(&engine, false);
     ExecutorPool::get()->schedule(workloadMonitorTask);
 
+    if (config.getExecutorAutoscaleMaxReaders() ||
+        config.getExecutorAutoscaleMaxWriters()) {
+        ExecutorPool::get()->schedule(
+                std::make_shared<ExecutorAutoscaler>(&engine));
+    }
+
 #if HAVE_JEMALLOC
     /* Only create the defragmenter task if we have an underlying memory
      * allocator which can facilitate defragmenting memory.
@@ -432,6 +488,10 @@ bool KVBucket::initialize() {
             &engine, config.getItemFreqDecayerPercent());
     ExecutorPool::get()->schedule(itemFreqDecayerTask);
 
+    if (config.isMemQuotaSharing()) {
+        MemoryArbiter::get().addBucket(*this);
+    }
+
     return true;
 }
 
@@ -450,6 +510,7 @@ void KVBucket::startWarmupTask() {
 }
 
 void KVBucket::deinitialize() {
+    MemoryArbiter::get().removeBucket(*this);
     stopWarmup();
     ExecutorPool::get()->stopTaskGroup(engine.getTaskable().getGID(),
                                        NONIO_TASK_IDX, stats.forceShutdown);
@@ -463,6 +524,30 @@ void KVBucket::deinitialize() {
 
     ExecutorPool::get()->unregisterTaskable(engine.getTaskable(),
                                             stats.forceShutdown);
+
+    releaseVBuckets();
+}
+
+void KVBucket::releaseVBuckets() {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (auto& shard : vbMap.shards) {
+        auto* kvShard = shard.get();
+        threads.emplace_back([this, kvShard]() {
+            // Account for the memory freed against this bucket
+            ObjectRegistry::onSwitchThread(&engine);
+            for (auto vbid : kvShard->getVBuckets()) {
+                kvShard->takeBucket(vbid);
+            }
+            ObjectRegistry::onSwitchThread(nullptr);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EP_LOG_INFO("Released the vBuckets of {} shards in {}",
+                threads.size(),
+                cb::time2text(std::chrono::steady_clock::now() - start));
 }
 
 KVBucket::~KVBucket() {
@@ -602,18 +687,20 @@ void KVBucket::logQTime(TaskId taskType,
                         const std::chrono::steady_clock::duration enqTime) {
     auto ms = std::chrono::duration_cast<std::chrono::microseconds>(enqTime);
     stats.schedulingHisto[static_cast<int>(taskType)].add(ms);
+    taskProfile.logQTime(taskType, enqTime);
 }
 
 void KVBucket::logRunTime(TaskId taskType,
                           const std::chrono::steady_clock::duration runTime) {
     auto ms = std::chrono::duration_cast<std::chrono::microseconds>(runTime);
     stats.taskRuntimeHisto[static_cast<int>(taskType)].add(ms);
+    taskProfile.logRunTime(taskType, runTime);
 }
 
 ENGINE_ERROR_CODE KVBucket::set(Item& itm,
                                 const void* cookie,
                                 cb::StoreIfPredicate predicate) {
-    VBucketPtr vb = getVBucket(itm.getVBucketId());
+    auto vb = getVBucketForRead(itm.getVBucketId());
     if (!vb) {
         ++stats.numNotMyVBuckets;
         return ENGINE_NOT_MY_VBUCKET;
@@ -659,7 +746,7 @@ ENGINE_ERROR_CODE KVBucket::set(Item& itm,
 
 ENGINE_ERROR_CODE KVBucket::add(Item &itm, const void *cookie)
 {
-    VBucketPtr vb = getVBucket(itm.getVBucketId());
+    auto vb = getVBucketForRead(itm.getVBucketId());
     if (!vb) {
         ++stats.numNotMyVBuckets;
         return ENGINE_NOT_MY_VBUCKET;
@@ -708,7 +795,7 @@ ENGINE_ERROR_CODE KVBucket::add(Item &itm, const void *cookie)
 ENGINE_ERROR_CODE KVBucket::replace(Item& itm,
                                     const void* cookie,
                                     cb::StoreIfPredicate predicate) {
-    VBucketPtr vb = getVBucket(itm.getVBucketId());
+    auto vb = getVBucketForRead(itm.getVBucketId());
     if (!vb) {
         ++stats.numNotMyVBuckets;
         return ENGINE_NOT_MY_VBUCKET;
@@ -743,6 +830,51 @@ ENGINE_ERROR_CODE KVBucket::replace(Item& itm,
     }
 }
 
+ENGINE_ERROR_CODE KVBucket::mutateInPlace(const DocKey& key,
+                                          Vbid vbucket,
+                                          const void* cookie,
+                                          const cb::DocumentMutator& mutator,
+                                          uint64_t& cas) {
+    VBucketPtr vb = getVBucket(vbucket);
+    if (!vb) {
+        ++stats.numNotMyVBuckets;
+        return ENGINE_NOT_MY_VBUCKET;
+    }
+
+    // Obtain read-lock on VB state to ensure VB state changes are interlocked
+    // with this mutation
+    ReaderLockHolder rlh(vb->getStateLock());
+    if (vb->getState() == vbucket_state_dead ||
+        vb->getState() == vbucket_state_replica) {
+        ++stats.numNotMyVBuckets;
+        return ENGINE_NOT_MY_VBUCKET;
+    } else if (vb->getState() == vbucket_state_pending) {
+        if (vb->addPendingOp(cookie)) {
+            return ENGINE_EWOULDBLOCK;
+        }
+    } else if (vb->isTakeoverBackedUp()) {
+        EP_LOG_DEBUG(
+                "({}) Returned TMPFAIL to a mutate in place op, because "
+                "takeover is lagging",
+                vb->getId());
+        return ENGINE_TMPFAIL;
+    }
+
+    { // collections read-lock scope
+        auto cHandle = vb->lockCollections(key);
+        if (!cHandle.valid()) {
+            engine.setErrorContext(
+                    cookie,
+                    Collections::getUnknownCollectionErrorContext(
+                            cHandle.getManifestUid()));
+            return ENGINE_UNKNOWN_COLLECTION;
+        } // now hold collections read access for the duration of the update
+
+        return vb->mutateInPlace(
+                key, cookie, engine, mutator, cHandle, getMaxTtl(), cas);
+    }
+}
+
 ENGINE_ERROR_CODE KVBucket::addBackfillItem(Item& itm,
                                             ExtendedMetaData* emd) {
     VBucketPtr vb = getVBucket(itm.getVBucketId());
@@ -877,7 +1009,8 @@ ENGINE_ERROR_CODE KVBucket::setVBucketState_UNLOCKED(
             // Initialize bloom filters upon vbucket creation during
             // bucket creation and rebalance
             newvb->createFilter(config.getBfilterKeyCount(),
-                                config.getBfilterFpProb());
+                                config.getBfilterFpProb(),
+                                config.isBfilterBlocked());
         }
 
         // The first checkpoint for active vbucket should start with id 2.
@@ -1330,7 +1463,7 @@ GetValue KVBucket::getInternal(const DocKey& key,
                                get_options_t options) {
     vbucket_state_t disallowedState = (allowedState == vbucket_state_active) ?
         vbucket_state_replica : vbucket_state_active;
-    VBucketPtr vb = getVBucket(vbucket);
+    auto vb = getVBucketForRead(vbucket);
 
     if (!vb) {
         ++stats.numNotMyVBuckets;
@@ -1377,6 +1510,66 @@ GetValue KVBucket::getInternal(const DocKey& key,
     }
 }
 
+std::vector<GetValue> KVBucket::getMulti(
+        const std::vector<std::pair<DocKey, Vbid>>& keys,
+        const void* cookie,
+        get_options_t options) {
+    options = static_cast<get_options_t>(options & ~QUEUE_BG_FETCH);
+
+    // Visit the keys grouped by vBucket (preserving the request order
+    // within each vBucket), results are placed back at their original index.
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+        return keys[a].second < keys[b].second;
+    });
+
+    std::vector<GetValue> result(keys.size());
+    auto it = order.begin();
+    while (it != order.end()) {
+        const Vbid vbid = keys[*it].second;
+        const auto groupEnd =
+                std::find_if(it, order.end(), [&keys, vbid](size_t idx) {
+                    return keys[idx].second != vbid;
+                });
+
+        VBucketPtr vb = getVBucket(vbid);
+        if (!vb) {
+            // Left for get() to report (and count) as not my vbucket.
+            for (; it != groupEnd; ++it) {
+                result[*it] = GetValue(nullptr, ENGINE_EWOULDBLOCK);
+            }
+            continue;
+        }
+
+        ReaderLockHolder rlh(vb->getStateLock());
+        const bool active = vb->getState() == vbucket_state_active;
+        for (; it != groupEnd; ++it) {
+            if (!active) {
+                result[*it] = GetValue(nullptr, ENGINE_EWOULDBLOCK);
+                continue;
+            }
+            if (std::next(it) != groupEnd) {
+                vb->ht.prefetchBucket(keys[*std::next(it)].first);
+            }
+
+            auto cHandle = vb->lockCollections(keys[*it].first);
+            if (!cHandle.valid()) {
+                // get() sets the error context on the cookie.
+                result[*it] = GetValue(nullptr, ENGINE_EWOULDBLOCK);
+                continue;
+            }
+            result[*it] = vb->getInternal(cookie,
+                                          engine,
+                                          options,
+                                          diskDeleteAll,
+                                          VBucket::GetKeyOnly::No,
+                                          cHandle);
+        }
+    }
+    return result;
+}
+
 GetValue KVBucket::getRandomKey() {
     size_t max = vbMap.getSize();
 
@@ -1404,6 +1597,41 @@ GetValue KVBucket::getRandomKey() {
     return GetValue(NULL, ENGINE_KEY_ENOENT);
 }
 
+std::vector<GetValue> KVBucket::getRandomKeys(size_t count) {
+    std::vector<GetValue> result;
+    const size_t max = vbMap.getSize();
+    size_t activeRemaining = vbMap.getVBStateCount(vbucket_state_active);
+    if (max == 0 || activeRemaining == 0) {
+        return result;
+    }
+
+    const Vbid::id_type start = labs(getRandom()) % max;
+    Vbid::id_type curr = start;
+
+    do {
+        VBucketPtr vb = getVBucket(Vbid(curr++));
+        if (vb && vb->getState() == vbucket_state_active &&
+            activeRemaining > 0) {
+            // Take an even share of what is still needed from each of the
+            // remaining active vBuckets, so a vBucket with too few items
+            // is made up for by the ones after it.
+            const size_t wanted = count - result.size();
+            const size_t share =
+                    (wanted + activeRemaining - 1) / activeRemaining;
+            --activeRemaining;
+            for (auto& itm : vb->ht.getRandomKeys(getRandom(), share)) {
+                result.emplace_back(std::move(itm), ENGINE_SUCCESS);
+            }
+        }
+
+        if (curr == max) {
+            curr = 0;
+        }
+    } while (result.size() < count && curr != start);
+
+    return result;
+}
+
 ENGINE_ERROR_CODE KVBucket::getMetaData(const DocKey& key,
                                         Vbid vbucket,
                                         const void* cookie,
@@ -1683,7 +1911,7 @@ std::string KVBucket::validateKey(const DocKey& key,
         if (diskItem.getFlags() != v->getFlags()) {
             return "flags_mismatch";
         } else if (v->isResident() && memcmp(diskItem.getData(),
-                                             v->getValue()->getData(),
+                                             v->getValueData().data(),
                                              diskItem.getNBytes())) {
             return "data_mismatch";
         } else {
@@ -1700,7 +1928,7 @@ ENGINE_ERROR_CODE KVBucket::deleteItem(const DocKey& key,
                                        const void* cookie,
                                        ItemMetaData* itemMeta,
                                        mutation_descr_t& mutInfo) {
-    VBucketPtr vb = getVBucket(vbucket);
+    auto vb = getVBucketForRead(vbucket);
     if (!vb || vb->getState() == vbucket_state_dead) {
         ++stats.numNotMyVBuckets;
         return ENGINE_NOT_MY_VBUCKET;
@@ -2042,6 +2270,18 @@ void KVBucket::wakeUpExpiryPager() {
     }
 }
 
+void KVBucket::setMaxDataSize(size_t size) {
+    stats.setMaxDataSize(size);
+    engine.getDcpConnMap().updateMaxActiveSnoozingBackfills(size);
+    size_t low_wat = static_cast<size_t>(static_cast<double>(size) *
+                                         stats.mem_low_wat_percent);
+    size_t high_wat = static_cast<size_t>(static_cast<double>(size) *
+                                          stats.mem_high_wat_percent);
+    stats.mem_low_wat.store(low_wat);
+    stats.mem_high_wat.store(high_wat);
+    setCursorDroppingLowerUpperThresholds(size);
+}
+
 void KVBucket::wakeItemPager() {
     if (itemPagerTask->getState() == TASK_SNOOZED) {
         ExecutorPool::get()->wake(itemPagerTask->getId());
@@ -2217,11 +2457,18 @@ VBCBAdaptor::VBCBAdaptor(KVBucket* s,
       maxDuration(std::chrono::microseconds::max()),
       currentvb(Vbid(0)) {
     const VBucketFilter& vbFilter = visitor->getVBucketFilter();
+    std::vector<Vbid> vbids;
     for (auto vbid : store->getVBuckets().getBuckets()) {
         if (vbFilter(vbid)) {
-            vbList.push(vbid);
+            vbids.push_back(vbid);
         }
     }
+    if (auto comparator = visitor->getVBucketComparator()) {
+        std::stable_sort(vbids.begin(), vbids.end(), comparator);
+    }
+    for (auto vbid : vbids) {
+        vbList.push(vbid);
+    }
 }
 
 std::string VBCBAdaptor::getDescription() {
@@ -2253,7 +2500,9 @@ void KVBucket::resetUnderlyingStats(void)
 {
     for (size_t i = 0; i < vbMap.shards.size(); i++) {
         KVShard *shard = vbMap.shards[i].get();
-        shard->getRWUnderlying()->resetStats();
+        for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+            shard->getRWUnderlyingForFlusher(ii)->resetStats();
+        }
         shard->getROUnderlying()->resetStats();
     }
 
@@ -2272,7 +2521,9 @@ void KVBucket::addKVStoreStats(ADD_STAT add_stat, const void* cookie) {
          * for both read write and read-only.
          */
         std::set<KVStore *> underlyingSet;
-        underlyingSet.insert(vbMap.shards[i]->getRWUnderlying());
+        for (size_t ii = 0; ii < vbMap.shards[i]->getNumFlushers(); ++ii) {
+            underlyingSet.insert(vbMap.shards[i]->getRWUnderlyingForFlusher(ii));
+        }
         underlyingSet.insert(vbMap.shards[i]->getROUnderlying());
 
         for (auto* store : underlyingSet) {
@@ -2284,7 +2535,9 @@ void KVBucket::addKVStoreStats(ADD_STAT add_stat, const void* cookie) {
 void KVBucket::addKVStoreTimingStats(ADD_STAT add_stat, const void* cookie) {
     for (size_t i = 0; i < vbMap.shards.size(); i++) {
         std::set<KVStore*> underlyingSet;
-        underlyingSet.insert(vbMap.shards[i]->getRWUnderlying());
+        for (size_t ii = 0; ii < vbMap.shards[i]->getNumFlushers(); ++ii) {
+            underlyingSet.insert(vbMap.shards[i]->getRWUnderlyingForFlusher(ii));
+        }
         underlyingSet.insert(vbMap.shards[i]->getROUnderlying());
 
         for (auto* store : underlyingSet) {
@@ -2306,8 +2559,11 @@ bool KVBucket::getKVStoreStat(const char* name, size_t& value, KVSOption option)
         }
 
         if (option == KVSOption::RW || option == KVSOption::BOTH) {
-            success &= shard->getRWUnderlying()->getStat(name, per_shard_value);
-            value += per_shard_value;
+            for (size_t ii = 0; ii < shard->getNumFlushers(); ++ii) {
+                success &= shard->getRWUnderlyingForFlusher(ii)->getStat(
+                        name, per_shard_value);
+                value += per_shard_value;
+            }
         }
     }
     return success;
@@ -2449,7 +2705,7 @@ std::ostream& operator<<(std::ostream& os, const KVBucket::Position& pos) {
 void KVBucket::notifyFlusher(const Vbid vbid) {
     KVShard* shard = vbMap.getShardByVbId(vbid);
     if (shard) {
-        shard->getFlusher()->notifyFlushEvent();
+        shard->getFlusherForVBucket(vbid)->notifyFlushEvent();
     } else {
         throw std::logic_error("KVBucket::notifyFlusher() : shard null for " +
                                vbid.to_string());
@@ -2579,6 +2835,28 @@ void KVBucket::setMaxTtl(size_t max) {
     maxTtl = max;
 }
 
+void KVBucket::setReplicaValuePolicy(const std::string& policy) {
+    if (policy == "resident") {
+        replicaValuePolicy = ReplicaValuePolicy::Resident;
+    } else if (policy == "compress") {
+        replicaValuePolicy = ReplicaValuePolicy::Compress;
+    } else if (policy == "eject") {
+        replicaValuePolicy = ReplicaValuePolicy::Eject;
+    } else {
+        throw std::invalid_argument(
+                "KVBucket::setReplicaValuePolicy: invalid policy " + policy);
+    }
+}
+
+ReplicaValuePolicy KVBucket::getReplicaValuePolicy() const {
+    if (replicaValuePolicy == ReplicaValuePolicy::Compress &&
+        engine.getCompressionMode() == BucketCompressionMode::Off) {
+        // Values aren't held compressed in memory in this mode.
+        return ReplicaValuePolicy::Resident;
+    }
+    return replicaValuePolicy;
+}
+
 uint16_t KVBucket::getNumOfVBucketsInState(vbucket_state_t state) const {
     return vbMap.getVBStateCount(state);
 }
@@ -16,6 +16,9 @@
 
 #include "config.h"
 
+#include "compressibility_tracker.h"
+
+#include "durability_timings.h"
 #include "ep_types.h"
 #include "executorpool.h"
 #include "item_freq_decayer.h"
@@ -23,8 +26,10 @@
 #include "mutation_log.h"
 #include "stored-value.h"
 #include "storeddockey.h"
+#include "task_profile.h"
 #include "task_type.h"
 #include "utility.h"
+#include "value_tier.h"
 #include "vbucket.h"
 #include "vbucketmap.h"
 
@@ -76,7 +81,16 @@ private:
 const uint16_t EP_PRIMARY_SHARD = 0;
 class KVShard;
 
-typedef std::pair<Vbid, ExTask> CompTaskEntry;
+/// A scheduled compaction task.
+struct CompTaskEntry {
+    Vbid vbid;
+    ExTask task;
+    /// Fragmentation of the file when the compaction was scheduled; only
+    /// filled in when the number of concurrent compactions is limited.
+    double fragmentation;
+    /// Held back (snoozed) until a running compaction completes.
+    bool parked;
+};
 
 /**
  * KVBucket is the base class for concrete Key/Value bucket implementations
@@ -115,6 +129,12 @@ public:
                               const void* cookie,
                               cb::StoreIfPredicate predicate = {}) override;
 
+    ENGINE_ERROR_CODE mutateInPlace(const DocKey& key,
+                                    Vbid vbucket,
+                                    const void* cookie,
+                                    const cb::DocumentMutator& mutator,
+                                    uint64_t& cas) override;
+
     ENGINE_ERROR_CODE addBackfillItem(Item& item,
                                       ExtendedMetaData* emd) override;
 
@@ -126,8 +146,31 @@ public:
                            options);
     }
 
+    /**
+     * Retrieve a batch of keys from active vBuckets without blocking; see
+     * EngineIface::get_multi().
+     *
+     * Keys are looked up grouped by vBucket (taking each vBucket's state
+     * lock once per group), and the hash bucket of the next key of a group
+     * is prefetched while the current one is looked up. Any key which cannot
+     * be served immediately from memory - non-resident, in a missing or
+     * non-active vBucket, or in an unknown collection - is returned as
+     * ENGINE_EWOULDBLOCK so the caller can retry it via get().
+     *
+     * @param keys the keys (and their vBuckets) to look up
+     * @param cookie the connection cookie
+     * @param options get options; QUEUE_BG_FETCH is ignored
+     * @return one GetValue per key, in the same order as keys
+     */
+    std::vector<GetValue> getMulti(
+            const std::vector<std::pair<DocKey, Vbid>>& keys,
+            const void* cookie,
+            get_options_t options);
+
     GetValue getRandomKey() override;
 
+    std::vector<GetValue> getRandomKeys(size_t count) override;
+
     GetValue getReplica(const DocKey& key,
                         Vbid vbucket,
                         const void* cookie,
@@ -218,6 +261,15 @@ public:
         return vbMap.getBucket(vbid);
     }
 
+    /**
+     * Return a handle on the given VBucket for the duration of a front-end
+     * operation. Unlike getVBucket() the VBucket's reference count isn't
+     * modified, so prefer it where the VBucket isn't kept beyond the call.
+     */
+    VBucketReadHandle getVBucketForRead(Vbid vbid) const {
+        return vbMap.getBucketForRead(vbid);
+    }
+
     /**
      * Return a pointer to the given VBucket, acquiring the appropriate VB
      * mutex lock at the same time.
@@ -367,7 +419,7 @@ public:
                                 const void* cookie) override;
 
     KVStore* getRWUnderlying(Vbid vbId) override {
-        return vbMap.getShardByVbId(vbId)->getRWUnderlying();
+        return vbMap.getShardByVbId(vbId)->getRWUnderlying(vbId);
     }
 
     KVStore* getRWUnderlyingByShard(size_t shardId) override {
@@ -452,8 +504,14 @@ public:
     /// Wake up the expiry pager (if enabled), scheduling it for immediate run.
     void wakeUpExpiryPager();
 
+    /**
+     * Apply a new memory quota (max_size), scaling the watermarks with it.
+     * Used for changes of the configured max_size, and by the MemoryArbiter
+     * to lend / borrow quota.
+     */
+    void setMaxDataSize(size_t size);
+
     /// Wake up the item pager (if enabled), scheduling it for immediate run.
-    /// Currently this is used only during testing.
     void wakeItemPager();
     void enableItemPager();
     void disableItemPager();
@@ -488,6 +546,14 @@ public:
     void logRunTime(TaskId taskType,
                     const std::chrono::steady_clock::duration runTime) override;
 
+    TaskProfile& getTaskProfile() {
+        return taskProfile;
+    }
+
+    DurabilityTimings& getDurabilityTimings() {
+        return durabilityTimings;
+    }
+
     void updateCachedResidentRatio(size_t activePerc, size_t replicaPerc) override {
         cachedResidentRatio.activeRatio.store(activePerc);
         cachedResidentRatio.replicaRatio.store(replicaPerc);
@@ -632,6 +698,19 @@ public:
         return *replicationThrottle;
     }
 
+    /**
+     * Returns how well the documents of each collection compress, which
+     * the compressors use to skip collections where it's futile.
+     */
+    CompressibilityTracker& getCompressibility() {
+        return compressibility;
+    }
+
+    /// @return the value tier, or nullptr if there isn't one
+    ValueTier* getValueTier() const {
+        return valueTier.get();
+    }
+
     /**
      * Perform actions for erasing keys based on a vbucket's collection's
      * manifest. This method examines key@bySeqno against the vbucket's (vbid)
@@ -659,6 +738,16 @@ public:
     /// set the buckets maxTtl
     void setMaxTtl(size_t max);
 
+    /// Set the replica_value_policy from its configured name
+    void setReplicaValuePolicy(const std::string& policy);
+
+    /**
+     * @return what is done with the values of replica vBuckets once they are
+     *         persisted; Compress is only honoured if the compression_mode
+     *         is not off.
+     */
+    ReplicaValuePolicy getReplicaValuePolicy() const;
+
 protected:
     // During the warmup phase we might want to enable external traffic
     // at a given point in time.. The LoadStorageKvPairCallback will be
@@ -670,6 +759,14 @@ protected:
     void warmupCompleted() override;
     void stopWarmup() override;
 
+    /**
+     * Release all of the vBuckets (freeing their hash tables, checkpoints
+     * etc unless something else still holds a reference to them) using one
+     * thread per shard. Used when the bucket is shut down, as this is most
+     * of the time taken to delete a large bucket.
+     */
+    void releaseVBuckets();
+
     GetValue getInternal(const DocKey& key,
                          Vbid vbucket,
                          const void* cookie,
@@ -717,6 +814,11 @@ protected:
     EventuallyPersistentEngine     &engine;
     EPStats                        &stats;
     std::unique_ptr<Warmup> warmupTask;
+    /**
+     * The tier cold values are moved to by the item pager, if configured.
+     * Declared before vbMap so it is released after the values in it.
+     */
+    std::unique_ptr<ValueTier, ValueTier::Release> valueTier;
     VBucketMap                      vbMap;
     ExTask itemPagerTask;
     ExTask                          chkTask;
@@ -730,6 +832,10 @@ protected:
     size_t                          compactionWriteQueueCap;
     float                           compactionExpMemThreshold;
 
+    TaskProfile taskProfile;
+
+    DurabilityTimings durabilityTimings;
+
     /* Vector of mutexes for each vbucket
      * Used by flush operations: flushVB, deleteVB, compactVB, snapshotVB */
     std::vector<std::mutex>       vb_mutexes;
@@ -788,8 +894,13 @@ protected:
     /* Contains info about throttling the replication */
     std::unique_ptr<ReplicationThrottle> replicationThrottle;
 
+    CompressibilityTracker compressibility;
+
     std::atomic<size_t> maxTtl;
 
+    std::atomic<ReplicaValuePolicy> replicaValuePolicy{
+            ReplicaValuePolicy::Resident};
+
     /**
      * Allows us to override the random function.  This is used for testing
      * purposes where we want a constant number as opposed to a random one.
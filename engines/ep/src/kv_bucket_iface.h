@@ -122,6 +122,22 @@ public:
                                       const void* cookie,
                                       cb::StoreIfPredicate predicate = {}) = 0;
 
+    /**
+     * Update a document in place with the result of a function applied to
+     * its current version (see EngineIface::mutate_in_place).
+     * @param key the key of the document
+     * @param vbucket the vbucket of the document
+     * @param cookie the cookie representing the client
+     * @param mutator function producing the new version of the document
+     * @param[out] cas the CAS of the document on success
+     * @return the result of the operation
+     */
+    virtual ENGINE_ERROR_CODE mutateInPlace(const DocKey& key,
+                                            Vbid vbucket,
+                                            const void* cookie,
+                                            const cb::DocumentMutator& mutator,
+                                            uint64_t& cas) = 0;
+
     /**
      * Add a DCP backfill item into its corresponding vbucket
      * @param item the item to be added
@@ -152,6 +168,15 @@ public:
      */
     virtual GetValue getRandomKey() = 0;
 
+    /**
+     * Retrieve up to count distinct values randomly from the store, spread
+     * over the active vBuckets.
+     *
+     * @return one GetValue per value retrieved (empty if the store has no
+     *         resident values)
+     */
+    virtual std::vector<GetValue> getRandomKeys(size_t count) = 0;
+
     /**
      * Retrieve a value from a vbucket in replica state.
      *
@@ -357,6 +382,17 @@ public:
     virtual ENGINE_ERROR_CODE getFileStats(const void* cookie,
                                            ADD_STAT add_stat) = 0;
 
+    /**
+     * Get the statistics of each of the bucket's flushers.
+     *
+     * @param cookie Cookie associated with ADD_STAT
+     * @param add_stat Callback to use to add stats to the caller.
+     * @return ENGINE_SUCCESS if stats were successfully retrieved, or
+     *         ENGINE_KEY_ENOENT if the bucket has no flushers.
+     */
+    virtual ENGINE_ERROR_CODE getFlusherStats(const void* cookie,
+                                              ADD_STAT add_stat) = 0;
+
     /**
      * Get detailed (per-vbucket) disk stats.
      *
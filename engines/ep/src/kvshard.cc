@@ -21,6 +21,8 @@
 #include <memory>
 
 #include "bgfetcher.h"
+#include "bucket_logger.h"
+#include "couch-kvstore/couch-kvstore.h"
 #include "ep_bucket.h"
 #include "ep_engine.h"
 #include "flusher.h"
@@ -34,26 +36,39 @@
 
 /* [EPHE TODO]: Consider not using KVShard for ephemeral bucket */
 KVShard::KVShard(uint16_t id, Configuration& config)
-    : vbuckets(config.getMaxVbuckets()), highPriorityCount(0) {
+    : vbuckets(config.getMaxVbuckets()),
+      numBgFetchers(config.getBgfetchersPerShard()),
+      highPriorityCount(0) {
     const std::string backend = config.getBackend();
     if (backend == "couchdb") {
         kvConfig = std::make_unique<KVStoreConfig>(config, id);
         auto stores = KVStoreFactory::create(*kvConfig);
-        rwStore = std::move(stores.rw);
+        rwStores.push_back(std::move(stores.rw));
         roStore = std::move(stores.ro);
+
+        // vBucket files are independent, so additional flushers can each
+        // write through their own store.
+        auto& primary = dynamic_cast<CouchKVStore&>(*rwStores.front());
+        for (size_t ii = 1; ii < config.getFlushersPerShard(); ++ii) {
+            flusherKVConfigs.push_back(
+                    std::make_unique<KVStoreConfig>(config, id));
+            flusherKVConfigs.back()->setFlusherIndex(ii);
+            rwStores.push_back(
+                    primary.makeWriterStore(*flusherKVConfigs.back()));
+        }
     }
 #ifdef EP_USE_MAGMA
     else if (backend == "magma") {
         kvConfig = std::make_unique<MagmaKVStoreConfig>(config, id);
         auto stores = KVStoreFactory::create(*kvConfig);
-        rwStore = std::move(stores.rw);
+        rwStores.push_back(std::move(stores.rw));
     }
 #endif
 #ifdef EP_USE_ROCKSDB
     else if (backend == "rocksdb") {
         kvConfig = std::make_unique<RocksDBKVStoreConfig>(config, id);
         auto stores = KVStoreFactory::create(*kvConfig);
-        rwStore = std::move(stores.rw);
+        rwStores.push_back(std::move(stores.rw));
     }
 #endif
     else {
@@ -62,23 +77,49 @@ KVShard::KVShard(uint16_t id, Configuration& config)
                 "Invalid backend type '" +
                 backend + "'");
     }
+
+    if (rwStores.size() < config.getFlushersPerShard()) {
+        EP_LOG_WARN(
+                "KVShard::KVShard: flushers_per_shard:{} not supported by "
+                "backend '{}', using a single flusher for shard:{}",
+                config.getFlushersPerShard(),
+                backend,
+                id);
+    }
 }
 
 void KVShard::enablePersistence(EPBucket& ep) {
-    flusher = std::make_unique<Flusher>(&ep, this);
-    bgFetcher = std::make_unique<BgFetcher>(ep, *this);
+    for (size_t ii = 0; ii < rwStores.size(); ++ii) {
+        flushers.push_back(std::make_unique<Flusher>(&ep, this, ii));
+    }
+    for (size_t ii = 0; ii < numBgFetchers; ++ii) {
+        bgFetchers.push_back(std::make_unique<BgFetcher>(ep, *this));
+    }
+}
+
+VBucketPtr VBucketReadHandle::getPtr() const {
+    if (ptr || !vb) {
+        return ptr;
+    }
+    return vb->shared_from_this();
 }
 
 // Non-inline destructor so we can destruct
 // unique_ptrs of forward-declared items
 KVShard::~KVShard() = default;
 
-Flusher *KVShard::getFlusher() {
-    return flusher.get();
+Flusher* KVShard::getFlusher(size_t index) {
+    if (index < flushers.size()) {
+        return flushers[index].get();
+    }
+    return nullptr;
 }
 
-BgFetcher *KVShard::getBgFetcher() {
-    return bgFetcher.get();
+BgFetcher* KVShard::getBgFetcher(size_t index) {
+    if (index < bgFetchers.size()) {
+        return bgFetchers[index].get();
+    }
+    return nullptr;
 }
 
 VBucketPtr KVShard::getBucket(Vbid id) const {
@@ -89,15 +130,49 @@ VBucketPtr KVShard::getBucket(Vbid id) const {
     }
 }
 
+VBucketReadHandle KVShard::getBucketForRead(Vbid id) const {
+    if (id.get() >= vbuckets.size()) {
+        return VBucketReadHandle(VBucketPtr());
+    }
+
+    auto guard = epochs.enter();
+    if (!guard.active()) {
+        return VBucketReadHandle(getBucket(id));
+    }
+    auto* vb = vbuckets[id.get()].getRaw();
+    return {std::move(guard), vb};
+}
+
 void KVShard::setBucket(VBucketPtr vb) {
-    vbuckets[vb->getId().get()].lock().set(vb);
+    VBucketPtr replaced;
+    {
+        auto element = vbuckets[vb->getId().get()].lock();
+        replaced = element.get();
+        element.set(vb);
+    }
+    epochs.retire(std::move(replaced));
 }
 
-void KVShard::dropVBucketAndSetupDeferredDeletion(Vbid id, const void* cookie) {
+VBucketPtr KVShard::takeBucket(Vbid id) {
+    // Don't hold the lock while the vBucket is destroyed
     auto vb = vbuckets[id.get()].lock();
-    auto vbPtr = vb.get();
-    vbPtr->setupDeferredDeletion(cookie);
+    auto ret = vb.get();
     vb.reset();
+    // Readers may still be using it
+    epochs.retire(ret);
+    return ret;
+}
+
+void KVShard::dropVBucketAndSetupDeferredDeletion(Vbid id, const void* cookie) {
+    VBucketPtr vbPtr;
+    {
+        auto vb = vbuckets[id.get()].lock();
+        vbPtr = vb.get();
+        vbPtr->setupDeferredDeletion(cookie);
+        vb.reset();
+    }
+    // The deletion happens once the last reader is done with the vBucket
+    epochs.retire(std::move(vbPtr));
 }
 
 std::vector<Vbid> KVShard::getVBucketsSortedByState() {
@@ -130,6 +205,6 @@ std::vector<Vbid> KVShard::getVBuckets() {
 
 void NotifyFlusherCB::callback(Vbid& vb) {
     if (shard->getBucket(vb)) {
-        shard->getFlusher()->notifyFlushEvent();
+        shard->getFlusherForVBucket(vb)->notifyFlushEvent();
     }
 }
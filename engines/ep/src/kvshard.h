@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "epoch_domain.h"
 #include "kvstore_config.h"
 #include "utility.h"
 #include "vbucket.h"
@@ -45,19 +46,76 @@
  *   |                                 |
  *   | vbuckets: VBucket[] (partitions)|----> [(VBucket),(VBucket)..]
  *   |                                 |
- *   | flusher: Flusher                |
- *   | BGFetcher: bgFetcher            |
+ *   | flushers: Flusher[]             |
+ *   | bgFetchers: BgFetcher[]         |
  *   |                                 |
- *   | rwUnderlying: KVStore (write)   |----> (CouchKVStore)
+ *   | rwUnderlying: KVStore[] (write) |----> [(CouchKVStore),..]
  *   | roUnderlying: KVStore (read)    |----> (CouchKVStore)
  *   -----------------------------------
  *
+ * A shard normally has a single flusher. With flushers_per_shard > 1 the
+ * shard's vBuckets are split between several flushers, each of which writes
+ * through its own read-write KVStore, so they can be persisted concurrently.
+ *
+ * Similarly with bgfetchers_per_shard > 1 the shard's vBuckets are split
+ * between several BgFetchers, whose tasks can each run on a reader thread
+ * (reading through the shared read-only KVStore), so more background fetches
+ * of the shard can be in flight at once.
  */
 class BgFetcher;
 class Configuration;
 class EPBucket;
 class Flusher;
 
+/**
+ * A reference to a VBucket for the duration of a front-end operation.
+ *
+ * Unlike copying a VBucketPtr it doesn't modify the VBucket's reference
+ * count (a cache line every thread operating on the VBucket would otherwise
+ * bounce); instead the VBucket is kept alive by an EpochDomain::Guard of
+ * its KVShard. Should the thread not be able to enter the domain the handle
+ * holds a VBucketPtr instead.
+ *
+ * The handle must not outlive the operation (it delays the deletion of a
+ * dropped VBucket); use getPtr() for a reference which may be kept.
+ */
+class VBucketReadHandle {
+public:
+    VBucketReadHandle(EpochDomain::Guard guard, VBucket* vb)
+        : guard(std::move(guard)), vb(vb) {
+    }
+
+    explicit VBucketReadHandle(VBucketPtr ptr)
+        : vb(ptr.get()), ptr(std::move(ptr)) {
+    }
+
+    VBucketReadHandle(VBucketReadHandle&&) = default;
+
+    VBucket* get() const {
+        return vb;
+    }
+
+    VBucket* operator->() const {
+        return vb;
+    }
+
+    VBucket& operator*() const {
+        return *vb;
+    }
+
+    explicit operator bool() const {
+        return vb != nullptr;
+    }
+
+    /// @return a counted reference to the VBucket
+    VBucketPtr getPtr() const;
+
+private:
+    EpochDomain::Guard guard;
+    VBucket* vb;
+    VBucketPtr ptr;
+};
+
 class KVShard {
 public:
     // Identifier for a KVShard
@@ -68,23 +126,78 @@ public:
     /// Enable persistence for this KVShard; setting up flusher and BGFetcher.
     void enablePersistence(EPBucket& epBucket);
 
+    /// @returns the shard's primary read-write KVStore.
     KVStore* getRWUnderlying() {
-        return rwStore.get();
+        return rwStores.front().get();
+    }
+
+    /// @returns the read-write KVStore which the given vBucket is written to.
+    KVStore* getRWUnderlying(Vbid vbid) {
+        return rwStores[getFlusherIndex(vbid)].get();
+    }
+
+    /// @returns the read-write KVStore used by the given flusher.
+    KVStore* getRWUnderlyingForFlusher(size_t index) {
+        return rwStores.at(index).get();
     }
 
     KVStore* getROUnderlying() {
         if (roStore) {
             return roStore.get();
         }
-        return rwStore.get();
+        return rwStores.front().get();
     }
 
-    Flusher *getFlusher();
-    BgFetcher *getBgFetcher();
+    /// @returns the given flusher (the primary flusher by default).
+    Flusher* getFlusher(size_t index = 0);
+
+    Flusher* getFlusherForVBucket(Vbid vbid) {
+        return getFlusher(getFlusherIndex(vbid));
+    }
+
+    size_t getNumFlushers() const {
+        return rwStores.size();
+    }
+
+    /// @returns the index of the flusher (and KVStore) the vBucket uses.
+    size_t getFlusherIndex(Vbid vbid) const {
+        return (vbid.get() / kvConfig->getMaxShards()) % rwStores.size();
+    }
+
+    /// @returns the given BgFetcher (the primary BgFetcher by default).
+    BgFetcher* getBgFetcher(size_t index = 0);
+
+    BgFetcher* getBgFetcherForVBucket(Vbid vbid) {
+        return getBgFetcher(getBgFetcherIndex(vbid));
+    }
+
+    size_t getNumBgFetchers() const {
+        return bgFetchers.size();
+    }
+
+    /// @returns the index of the BgFetcher the vBucket uses.
+    size_t getBgFetcherIndex(Vbid vbid) const {
+        return (vbid.get() / kvConfig->getMaxShards()) % numBgFetchers;
+    }
 
     VBucketPtr getBucket(Vbid id) const;
+
+    /**
+     * Get the vBucket for a front-end operation, without taking the element's
+     * mutex or modifying the vBucket's reference count.
+     */
+    VBucketReadHandle getBucketForRead(Vbid id) const;
+
     void setBucket(VBucketPtr vb);
 
+    /**
+     * Remove the vBucket from the shard.
+     *
+     * @return the vBucket removed (which is destroyed along with the returned
+     *         pointer unless something else holds a reference to it)
+     */
+    VBucketPtr takeBucket(Vbid id);
+
     /**
      * Drop the vbucket from the map and setup deferred deletion of the VBucket.
      * Once the VBucketPtr has no more references the vbucket is deleted, but
@@ -113,10 +226,18 @@ private:
     // RocksDBKVStoreConfig) instance.
     std::unique_ptr<KVStoreConfig> kvConfig;
 
+    // Configs of the additional read-write KVStores (rwStores[1..n]), which
+    // differ from kvConfig only in their flusher index.
+    std::vector<std::unique_ptr<KVStoreConfig>> flusherKVConfigs;
+
     /**
      * VBMapElement comprises the VBucket smart pointer and a mutex.
      * Access to the smart pointer must be performed through the ::Access object
      * which will perform RAII locking of the mutex.
+     *
+     * A raw copy of the pointer is also kept for getBucketForRead(), which is
+     * read without the mutex under the protection of the shard's epochs. The
+     * smart pointer replaced by set() / reset() must be retired to the epochs.
      */
     class VBMapElement {
     public:
@@ -165,6 +286,7 @@ private:
             typename std::enable_if<!std::is_const<
                     typename std::remove_reference<U>::type>::value>::type
             set(VBucketPtr vb) {
+                element.rawPtr.store(vb.get());
                 element.vbPtr = vb;
             }
 
@@ -175,6 +297,7 @@ private:
             typename std::enable_if<!std::is_const<
                     typename std::remove_reference<U>::type>::value>::type
             reset() {
+                element.rawPtr.store(nullptr);
                 element.vbPtr.reset();
             }
 
@@ -191,18 +314,31 @@ private:
             return {mutex, *this};
         }
 
+        /// @return the VBucket, only valid within an epoch of the shard
+        VBucket* getRaw() const {
+            return rawPtr.load();
+        }
+
     private:
         mutable std::mutex mutex;
         VBucketPtr vbPtr;
+        std::atomic<VBucket*> rawPtr{nullptr};
     };
 
     std::vector<VBMapElement> vbuckets;
 
-    std::unique_ptr<KVStore> rwStore;
+    /// Protects the raw VBucket pointers read by getBucketForRead().
+    mutable EpochDomain epochs;
+
+    // One per flusher; the first is the shard's primary read-write KVStore.
+    std::vector<std::unique_ptr<KVStore>> rwStores;
     std::unique_ptr<KVStore> roStore;
 
-    std::unique_ptr<Flusher> flusher;
-    std::unique_ptr<BgFetcher> bgFetcher;
+    std::vector<std::unique_ptr<Flusher>> flushers;
+    std::vector<std::unique_ptr<BgFetcher>> bgFetchers;
+    // Number of BgFetchers; known before persistence (and so bgFetchers) is
+    // enabled.
+    const size_t numBgFetchers;
 
 public:
     std::atomic<size_t> highPriorityCount;
@@ -17,6 +17,7 @@
 
 #include "config.h"
 
+#include <cstring>
 #include <map>
 #include <string>
 #include <fcntl.h>
@@ -32,6 +33,7 @@
 #include "rocksdb-kvstore/rocksdb-kvstore_config.h"
 #endif
 #include "bucket_logger.h"
+#include "crc32.h"
 #include "kvstore.h"
 #include "kvstore_config.h"
 #include "persistence_callback.h"
@@ -81,6 +83,8 @@ void FileStats::reset() {
     writeCountHisto.reset();
     totalBytesRead = 0;
     totalBytesWritten = 0;
+    totalWriteSyscalls = 0;
+    totalWritesCombined = 0;
 }
 
 KVStoreRWRO KVStoreFactory::create(KVStoreConfig& config) {
@@ -238,6 +242,113 @@ bool KVStore::snapshotStats(const std::map<std::string,
     return rv;
 }
 
+namespace {
+/// Header of a persisted bloom filter, followed by the serialised filter.
+struct BloomFilterFileHeader {
+    uint32_t magic;
+    uint16_t vbid;
+    uint16_t reserved;
+    int64_t highSeqno;
+    uint64_t length;
+    uint32_t crc;
+    uint32_t reserved2;
+};
+/// 'BFLT'
+const uint32_t BloomFilterFileMagic = 0x42464c54;
+
+std::string getBloomFilterFileName(const std::string& dbname, Vbid vbid) {
+    return dbname + "/" + std::to_string(vbid.get()) + ".bloomfilter";
+}
+
+uint32_t bloomFilterChecksum(const std::string& filter) {
+    // crc32buf doesn't modify the buffer, it just isn't declared const.
+    return crc32buf(
+            reinterpret_cast<uint8_t*>(const_cast<char*>(filter.data())),
+            filter.size());
+}
+} // anonymous namespace
+
+bool KVStore::snapshotBloomFilter(Vbid vbid,
+                                  int64_t highSeqno,
+                                  const std::string& filter) {
+    if (isReadOnly()) {
+        throw std::logic_error(
+                "KVStore::snapshotBloomFilter: Cannot perform "
+                "on a read-only instance.");
+    }
+
+    const auto fname = getBloomFilterFileName(configuration.getDBName(), vbid);
+    const auto next_fname = fname + ".new";
+    FILE* file = fopen(next_fname.c_str(), "wb");
+    if (file == nullptr) {
+        EP_LOG_WARN("Failed to open the bloom filter file \"{}\": {}",
+                    next_fname,
+                    strerror(errno));
+        return false;
+    }
+
+    BloomFilterFileHeader header{BloomFilterFileMagic,
+                                 vbid.get(),
+                                 0,
+                                 highSeqno,
+                                 filter.size(),
+                                 bloomFilterChecksum(filter),
+                                 0};
+    bool rv = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(filter.data(), filter.size(), 1, file) == 1;
+    rv = (fclose(file) == 0) && rv;
+    if (rv && rename(next_fname.c_str(), fname.c_str()) != 0) {
+        rv = false;
+    }
+    if (!rv) {
+        EP_LOG_WARN("Failed to write the bloom filter file \"{}\": {}",
+                    fname,
+                    strerror(errno));
+        remove(next_fname.c_str());
+    }
+    return rv;
+}
+
+std::string KVStore::getPersistedBloomFilter(Vbid vbid, int64_t highSeqno) {
+    const auto fname = getBloomFilterFileName(configuration.getDBName(), vbid);
+    if (!cb::io::isFile(fname)) {
+        return {};
+    }
+
+    std::string content;
+    try {
+        content = cb::io::loadFile(fname);
+    } catch (const std::exception& e) {
+        EP_LOG_WARN("Failed to read the bloom filter file \"{}\": {}",
+                    fname,
+                    e.what());
+    }
+    // A filter is only used once; the vBucket changes from here on.
+    remove(fname.c_str());
+
+    BloomFilterFileHeader header;
+    if (content.size() < sizeof(header)) {
+        return {};
+    }
+    std::memcpy(&header, content.data(), sizeof(header));
+    auto filter = content.substr(sizeof(header));
+    if (header.magic != BloomFilterFileMagic || header.vbid != vbid.get() ||
+        header.length != filter.size() ||
+        header.crc != bloomFilterChecksum(filter)) {
+        EP_LOG_WARN("Ignoring invalid bloom filter file \"{}\"", fname);
+        return {};
+    }
+    if (header.highSeqno != highSeqno) {
+        EP_LOG_INFO(
+                "Ignoring stale bloom filter of {} (seqno:{}, expected:{})",
+                vbid,
+                header.highSeqno,
+                highSeqno);
+        return {};
+    }
+    return filter;
+}
+
 template <typename T>
 void KVStore::addStat(const std::string &prefix, const char *stat, T &val,
                            ADD_STAT add_stat, const void *c) {
@@ -262,6 +373,10 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
         prefixStream << "ro_" << shardId;
     } else {
         prefixStream << "rw_" << shardId;
+        // Additional writers of a shard (see flushers_per_shard).
+        if (configuration.getFlusherIndex() > 0) {
+            prefixStream << "_" << configuration.getFlusherIndex();
+        }
     }
 
     const std::string& prefix = prefixStream.str();
@@ -296,6 +411,8 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
             add_stat,
             c);
     addStat(prefix, "io_write_bytes", st.io_write_bytes, add_stat, c);
+    addStat(prefix, "doc_cache_hits", st.docCacheHits, add_stat, c);
+    addStat(prefix, "doc_cache_misses", st.docCacheMisses, add_stat, c);
 
     const size_t read = st.fsStats.totalBytesRead.load() +
                         st.fsStatsCompaction.totalBytesRead.load();
@@ -305,6 +422,16 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
                            st.fsStatsCompaction.totalBytesWritten.load();
     addStat(prefix, "io_total_write_bytes", written, add_stat, c);
 
+    const size_t writeSyscalls =
+            st.fsStats.totalWriteSyscalls.load() +
+            st.fsStatsCompaction.totalWriteSyscalls.load();
+    addStat(prefix, "io_num_write_syscalls", writeSyscalls, add_stat, c);
+
+    const size_t writesCombined =
+            st.fsStats.totalWritesCombined.load() +
+            st.fsStatsCompaction.totalWritesCombined.load();
+    addStat(prefix, "io_num_writes_combined", writesCombined, add_stat, c);
+
     addStat(prefix, "io_compaction_read_bytes",
             st.fsStatsCompaction.totalBytesRead, add_stat, c);
     addStat(prefix, "io_compaction_write_bytes",
@@ -422,6 +549,10 @@ void KVStore::addTimingStats(ADD_STAT add_stat, const void *c) {
         prefixStream << "ro_" << shardId;
     } else {
         prefixStream << "rw_" << shardId;
+        // Additional writers of a shard (see flushers_per_shard).
+        if (configuration.getFlusherIndex() > 0) {
+            prefixStream << "_" << configuration.getFlusherIndex();
+        }
     }
 
     const std::string& prefix = prefixStream.str();
@@ -437,6 +568,7 @@ void KVStore::addTimingStats(ADD_STAT add_stat, const void *c) {
     addStat(prefix, "writeSize",   st.writeSizeHisto,   add_stat, c);
     addStat(prefix, "saveDocCount",   st.batchSize,     add_stat, c);
 
+    addStat(prefix, "getMultiBatchSize", st.getMultiBatchSizeHisto, add_stat, c);
     addStat(prefix, "getMultiFsReadCount", st.getMultiFsReadHisto, add_stat, c);
     addStat(prefix,
             "getMultiFsReadPerDocCount",
@@ -33,6 +33,7 @@
 #include <chrono>
 #include <cstring>
 #include <deque>
+#include <functional>
 #include <list>
 #include <map>
 #include <string>
@@ -134,6 +135,9 @@ struct compaction_ctx {
     std::function<bool(
             const DocKey, int64_t, bool, Collections::VB::EraserContext&)>
             collectionsEraser;
+    /// If set, called with the size of each document before it is copied,
+    /// blocking as long as compaction should be slowed down.
+    std::function<void(size_t)> ioThrottle;
 };
 
 /**
@@ -232,6 +236,13 @@ enum class ValueFilter {
     VALUES_DECOMPRESSED
 };
 
+enum class ScanOrder {
+    // Items are read in seqno order
+    BySeqno,
+    // Items are read in key order (see KVStore::supportsKeyOrderScan)
+    ByKey
+};
+
 enum class VBStatePersist {
     VBSTATE_CACHE_UPDATE_ONLY,       //Update only cached state in-memory
     VBSTATE_PERSIST_WITHOUT_COMMIT,  //Persist without committing to disk
@@ -266,6 +277,11 @@ public:
     const ValueFilter valFilter;
     const uint64_t documentCount;
 
+    /// The order to read the items in; must be set before the first scan().
+    ScanOrder order = ScanOrder::BySeqno;
+    /// A ByKey scan resumes from this (stored) key, the item it paused on.
+    std::string resumeKey;
+
     BucketLogger* logger;
     const KVStoreConfig& config;
     Collections::VB::ScanContext collectionsContext;
@@ -295,6 +311,11 @@ struct FileStats {
     std::atomic<size_t> totalBytesRead{0};
     // Total bytes written to disk.
     std::atomic<size_t> totalBytesWritten{0};
+    // Number of write syscalls issued.
+    std::atomic<size_t> totalWriteSyscalls{0};
+    // Number of writes which were combined into another write, so didn't
+    // need a syscall of their own.
+    std::atomic<size_t> totalWritesCombined{0};
 
     void reset();
 };
@@ -323,8 +344,11 @@ public:
       io_num_write(0),
       io_bgfetch_doc_bytes(0),
       io_write_bytes(0),
+      docCacheHits(0),
+      docCacheMisses(0),
       readSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
       writeSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
+      getMultiBatchSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
       getMultiFsReadCount(0),
       getMultiFsReadHisto(ExponentialGenerator<uint32_t>(6, 1.2), 50),
       getMultiFsReadPerDocHisto(ExponentialGenerator<uint32_t>(6, 1.2),50) {
@@ -343,6 +367,8 @@ public:
         numDelFailure = 0;
         numOpenFailure = 0;
         numVbSetFailure = 0;
+        docCacheHits = 0;
+        docCacheMisses = 0;
 
         readTimeHisto.reset();
         readSizeHisto.reset();
@@ -354,6 +380,7 @@ public:
         commitHisto.reset();
         saveDocsHisto.reset();
         batchSize.reset();
+        getMultiBatchSizeHisto.reset();
         getMultiFsReadCount = 0;
         getMultiFsReadHisto.reset();
         getMultiFsReadPerDocHisto.reset();
@@ -388,6 +415,10 @@ public:
     Couchbase::RelaxedAtomic<size_t> io_bgfetch_doc_bytes;
     //! Number of bytes written (key + value + application rev metadata)
     Couchbase::RelaxedAtomic<size_t> io_write_bytes;
+    //! Background fetches served by the document cache.
+    Couchbase::RelaxedAtomic<size_t> docCacheHits;
+    //! Background fetches which missed the document cache.
+    Couchbase::RelaxedAtomic<size_t> docCacheMisses;
 
     /* for flush and vb delete, no error handling in KVStore, such
      * failure should be tracked in MC-engine  */
@@ -413,6 +444,9 @@ public:
     //Time spent in vbucket snapshot
     MicrosecondHistogram snapshotHisto;
 
+    // Number of documents requested per getMulti() call
+    Histogram<size_t> getMultiBatchSizeHisto;
+
     // Count and histogram filesystem read()s per getMulti() request
     Couchbase::RelaxedAtomic<size_t> getMultiFsReadCount;
     Histogram<uint32_t> getMultiFsReadHisto;
@@ -475,11 +509,17 @@ public:
         No
     };
 
+    enum class GroupCommit {
+        Yes,
+        No
+    };
+
     StorageProperties(EfficientVBDump evb, EfficientVBDeletion evd, PersistedDeletion pd,
-                      EfficientGet eget, ConcurrentWriteCompact cwc)
+                      EfficientGet eget, ConcurrentWriteCompact cwc,
+                      GroupCommit gc = GroupCommit::No)
         : efficientVBDump(evb), efficientVBDeletion(evd),
           persistedDeletions(pd), efficientGet(eget),
-          concWriteCompact(cwc) {}
+          concWriteCompact(cwc), groupCommit(gc) {}
 
     /* True if we can efficiently dump a single vbucket */
     bool hasEfficientVBDump() const {
@@ -507,12 +547,19 @@ public:
         return (concWriteCompact == ConcurrentWriteCompact::Yes);
     }
 
+    /* True if commits of several vbuckets can be synced to disk at once
+     * (see KVStore::setDeferCommitSync()) */
+    bool hasGroupCommit() const {
+        return (groupCommit == GroupCommit::Yes);
+    }
+
 private:
     EfficientVBDump efficientVBDump;
     EfficientVBDeletion efficientVBDeletion;
     PersistedDeletion persistedDeletions;
     EfficientGet efficientGet;
     ConcurrentWriteCompact concWriteCompact;
+    GroupCommit groupCommit;
 };
 
 /**
@@ -607,6 +654,26 @@ public:
      */
     virtual bool commit(Collections::VB::Flush& collectionsFlush) = 0;
 
+    /**
+     * Set whether commit() should wait for the transaction to be synced to
+     * disk. When deferred, a commit is visible (and survives a process crash)
+     * but is only durable once syncCommits() has returned true, allowing a
+     * single sync to cover the commits of several vBuckets.
+     *
+     * Only supported if getStorageProperties().hasGroupCommit().
+     */
+    virtual void setDeferCommitSync(bool defer) {
+    }
+
+    /**
+     * Sync to disk all commits made while commit syncs were deferred.
+     *
+     * @return false if the sync failed
+     */
+    virtual bool syncCommits() {
+        return true;
+    }
+
     /**
      * Rollback the current transaction.
      */
@@ -693,6 +760,32 @@ public:
      */
     bool snapshotStats(const std::map<std::string, std::string> &m);
 
+    /**
+     * Persist a vBucket's (serialised) bloom filter, for the next warmup to
+     * load with getPersistedBloomFilter(). It is only valid for the given
+     * high seqno, so should only be persisted once the vBucket is fully
+     * persisted and no further mutations are accepted (i.e. on shutdown).
+     *
+     * @param vbid vBucket the filter belongs to
+     * @param highSeqno the vBucket's (persisted) high seqno
+     * @param filter the serialised bloom filter
+     * @return true if the filter was persisted
+     */
+    bool snapshotBloomFilter(Vbid vbid,
+                             int64_t highSeqno,
+                             const std::string& filter);
+
+    /**
+     * Read (and remove) a vBucket's persisted bloom filter.
+     *
+     * @param vbid vBucket to read the filter of
+     * @param highSeqno the vBucket's persisted high seqno; a filter persisted
+     *        at any other seqno is stale and is discarded
+     * @return the serialised bloom filter, or an empty string if there is no
+     *         valid filter
+     */
+    std::string getPersistedBloomFilter(Vbid vbid, int64_t highSeqno);
+
     /**
      * Snapshot vbucket state
      * @param vbucketId id of the vbucket that needs to be snapshotted
@@ -802,11 +895,16 @@ public:
         return st;
     }
 
+    /**
+     * Return (via the callback) up to count keys of the vBucket, in key
+     * order, starting at start_key. The scan stops early if the callback
+     * sets its status to anything other than ENGINE_SUCCESS.
+     */
     virtual ENGINE_ERROR_CODE getAllKeys(
             Vbid vbid,
             const DocKey start_key,
             uint32_t count,
-            std::shared_ptr<Callback<const DocKey&>> cb) = 0;
+            std::shared_ptr<StatusCallback<const DocKey&>> cb) = 0;
 
     /**
      * Create a KVStore Scan Context with the given options. On success,
@@ -826,6 +924,16 @@ public:
 
     virtual scan_error_t scan(ScanContext* sctx) = 0;
 
+    /**
+     * @returns true if scan() can read the items of a ScanContext in key
+     * order (ScanOrder::ByKey). A scan in key order reads the same snapshot as
+     * one in seqno order, but walks the by-key index rather than the by-seqno
+     * one, so it is only of use to a scan of the whole vBucket.
+     */
+    virtual bool supportsKeyOrderScan() const {
+        return false;
+    }
+
     virtual void destroyScanContext(ScanContext* ctx) = 0;
 
     /**
@@ -943,6 +1051,21 @@ public:
 
     virtual void callback(GetValue &val) = 0;
 
+    /**
+     * Revert a key changed since the rollback point, given its state at the
+     * rollback point as already found by the KVStore (so, unlike callback(),
+     * there is no need to look the key up via the db handle).
+     *
+     * @param postRbSeqno the key in its current, to be reverted, state
+     *        (without its value)
+     * @param preRbSeqno the key's state at the rollback point; status
+     *        ENGINE_KEY_ENOENT if the key did not exist then
+     */
+    virtual void rollbackKey(GetValue& postRbSeqno, GetValue& preRbSeqno) {
+        (void)preRbSeqno;
+        callback(postRbSeqno);
+    }
+
     void setDbHeader(void *db) {
         dbHandle = db;
     }
@@ -45,6 +45,12 @@ KVStoreConfig::KVStoreConfig(Configuration& config, uint16_t shardid)
                     shardid,
                     config.isCollectionsEnabled()) {
     setPeriodicSyncBytes(config.getFsyncAfterEveryNBytesWritten());
+    setWriteCombineSize(config.getCouchstoreWriteCombineSize());
+    setDocumentCacheSize(config.getCouchstoreDocCacheSize() /
+                         config.getMaxNumShards());
+    setReadHandleCacheEnabled(config.isCouchstoreReadHandleCache());
+    setCompactMetaData(config.isCouchstoreCompactMetadata());
+    setScanReadAheadSize(config.getCouchstoreScanReadaheadSize());
     config.addValueChangedListener(
             "fsync_after_every_n_bytes_written",
             std::make_unique<ConfigChangeListener>(*this));
@@ -61,9 +67,15 @@ KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
       dbname(_dbname),
       backend(_backend),
       shardId(_shardId),
+      flusherIndex(0),
       logger(globalBucketLogger.get()),
       buffered(true),
-      persistDocNamespace(_persistDocNamespace) {
+      persistDocNamespace(_persistDocNamespace),
+      writeCombineSize(0),
+      documentCacheSize(0),
+      readHandleCache(false),
+      compactMetaData(false),
+      scanReadAheadSize(0) {
 }
 
 KVStoreConfig::~KVStoreConfig() = default;
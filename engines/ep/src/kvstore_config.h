@@ -67,6 +67,18 @@ public:
         return shardId;
     }
 
+    /**
+     * Index of the flusher (within the shard) which writes through the
+     * KVStore using this config; zero for the shard's primary KVStore.
+     */
+    uint16_t getFlusherIndex() const {
+        return flusherIndex;
+    }
+
+    void setFlusherIndex(uint16_t index) {
+        flusherIndex = index;
+    }
+
     BucketLogger& getLogger() {
         return *logger;
     }
@@ -109,6 +121,76 @@ public:
         periodicSyncBytes = bytes;
     }
 
+    size_t getWriteCombineSize() const {
+        return writeCombineSize;
+    }
+
+    /**
+     * Set the maximum number of bytes of contiguous file writes to combine
+     * into a single write (0 to disable).
+     *
+     * Only recognised by CouchKVStore
+     */
+    void setWriteCombineSize(size_t bytes) {
+        writeCombineSize = bytes;
+    }
+
+    size_t getDocumentCacheSize() const {
+        return documentCacheSize;
+    }
+
+    /**
+     * Set the maximum number of bytes of the shard's document cache (0 to
+     * disable).
+     *
+     * Only recognised by CouchKVStore
+     */
+    void setDocumentCacheSize(size_t bytes) {
+        documentCacheSize = bytes;
+    }
+
+    bool isReadHandleCacheEnabled() const {
+        return readHandleCache;
+    }
+
+    /**
+     * Set if the read-only handle on each vBucket's file used by
+     * background fetches should be kept open between fetches.
+     *
+     * Only recognised by CouchKVStore
+     */
+    void setReadHandleCacheEnabled(bool enabled) {
+        readHandleCache = enabled;
+    }
+
+    bool isCompactMetaData() const {
+        return compactMetaData;
+    }
+
+    /**
+     * Set if the metadata of documents is written in the compact (V3)
+     * encoding.
+     *
+     * Only recognised by CouchKVStore
+     */
+    void setCompactMetaData(bool enabled) {
+        compactMetaData = enabled;
+    }
+
+    size_t getScanReadAheadSize() const {
+        return scanReadAheadSize;
+    }
+
+    /**
+     * Set the number of bytes seqno scans read ahead of what is requested
+     * (0 to disable).
+     *
+     * Only recognised by CouchKVStore
+     */
+    void setScanReadAheadSize(size_t bytes) {
+        scanReadAheadSize = bytes;
+    }
+
 private:
     class ConfigChangeListener;
 
@@ -117,6 +199,7 @@ private:
     std::string dbname;
     std::string backend;
     uint16_t shardId;
+    uint16_t flusherIndex;
     BucketLogger* logger;
     bool buffered;
     bool persistDocNamespace;
@@ -126,4 +209,34 @@ private:
      * N bytes written.
      */
     uint64_t periodicSyncBytes;
+
+    /**
+     * If non-zero, contiguous writes up to this many bytes in total are
+     * combined into a single write to the file.
+     */
+    size_t writeCombineSize;
+
+    /**
+     * If non-zero, documents read by background fetches are cached (up to
+     * this many bytes) in front of the shard's data files.
+     */
+    size_t documentCacheSize;
+
+    /**
+     * If true, background fetches reuse an open handle on the vBucket's
+     * file until the file is next written to.
+     */
+    bool readHandleCache;
+
+    /**
+     * If true, documents are written with the compact (V3) metadata
+     * encoding.
+     */
+    bool compactMetaData;
+
+    /**
+     * If non-zero, seqno scans read this many bytes at a time, serving
+     * subsequent reads from what was read ahead.
+     */
+    size_t scanReadAheadSize;
 };
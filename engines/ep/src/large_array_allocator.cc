@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "large_array_allocator.h"
+
+#include "objectregistry.h"
+
+#include <utilities/cpu_affinity.h>
+
+#include <new>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+const size_t LargeArrayPolicy::MinMappedSize;
+
+LargeArrayPolicy::HugePages LargeArrayPolicy::hugePagesFromString(
+        const std::string& mode) {
+    if (mode == "off") {
+        return HugePages::Off;
+    } else if (mode == "transparent") {
+        return HugePages::Transparent;
+    } else if (mode == "explicit") {
+        return HugePages::Explicit;
+    }
+    throw std::invalid_argument(
+            "LargeArrayPolicy::hugePagesFromString: Invalid mode:" + mode);
+}
+
+bool LargeArrayPolicy::isMapped(size_t bytes) const {
+    return (hugePages != HugePages::Off || numaNode >= 0) &&
+           bytes >= MinMappedSize;
+}
+
+#ifdef __linux__
+static size_t mappedLength(size_t bytes) {
+    const auto page = LargeArrayPolicy::MinMappedSize;
+    return (bytes + page - 1) / page * page;
+}
+#endif
+
+void* allocateLargeArray(size_t bytes, const LargeArrayPolicy& policy) {
+#ifdef __linux__
+    if (policy.isMapped(bytes)) {
+        const auto length = mappedLength(bytes);
+        void* ptr = MAP_FAILED;
+        if (policy.hugePages == LargeArrayPolicy::HugePages::Explicit) {
+            ptr = mmap(nullptr,
+                       length,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                       -1,
+                       0);
+        }
+        if (ptr == MAP_FAILED) {
+            ptr = mmap(nullptr,
+                       length,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1,
+                       0);
+            if (ptr == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            if (policy.hugePages != LargeArrayPolicy::HugePages::Off) {
+                madvise(ptr, length, MADV_HUGEPAGE);
+            }
+        }
+        // Set the placement before first touching the pages (which is when
+        // they're allocated).
+        if (policy.numaNode >= 0) {
+            bind_memory_to_numa_node(ptr, length, policy.numaNode);
+        }
+        // Not seen by the allocator hooks, so account for it here.
+        ObjectRegistry::memoryAllocated(length);
+        return ptr;
+    }
+#endif
+    return ::operator new(bytes);
+}
+
+void freeLargeArray(void* ptr, size_t bytes, const LargeArrayPolicy& policy) {
+#ifdef __linux__
+    if (policy.isMapped(bytes)) {
+        const auto length = mappedLength(bytes);
+        munmap(ptr, length);
+        ObjectRegistry::memoryDeallocated(length);
+        return;
+    }
+#endif
+    ::operator delete(ptr);
+}
@@ -0,0 +1,121 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+/**
+ * How large, long lived arrays (the HashTable's bucket arrays) are backed.
+ * On Linux, arrays of at least LargeArrayPolicy::MinMappedSize are mapped
+ * directly (instead of coming from the heap) when the policy asks for huge
+ * pages or a NUMA node, so that they can be backed and placed as asked; any
+ * other arrays come from the heap as usual.
+ */
+struct LargeArrayPolicy {
+    enum class HugePages {
+        /// Use the default page size.
+        Off,
+        /// Ask for transparent huge pages (madvise).
+        Transparent,
+        /// Use explicit (hugetlbfs reserved) huge pages, falling back to
+        /// transparent ones if none are available.
+        Explicit
+    };
+
+    static HugePages hugePagesFromString(const std::string& mode);
+
+    /// @return true if an array of the given size should be mapped.
+    bool isMapped(size_t bytes) const;
+
+    bool operator==(const LargeArrayPolicy& other) const {
+        return hugePages == other.hugePages && numaNode == other.numaNode;
+    }
+
+    bool operator!=(const LargeArrayPolicy& other) const {
+        return !(*this == other);
+    }
+
+    /// Size of a (2MB) huge page; mapped arrays are rounded up to it.
+    static const size_t MinMappedSize = 2 * 1024 * 1024;
+
+    HugePages hugePages = HugePages::Off;
+    /// NUMA node to place mapped arrays on, -1 for the default placement.
+    int numaNode = -1;
+};
+
+/// Allocate memory for an array of the given size, as per the policy.
+void* allocateLargeArray(size_t bytes, const LargeArrayPolicy& policy);
+
+/// Free memory from allocateLargeArray() (of the same size and policy).
+void freeLargeArray(void* ptr, size_t bytes, const LargeArrayPolicy& policy);
+
+/**
+ * Allocator for containers holding large arrays, backing them as per its
+ * LargeArrayPolicy. The policy follows the contents when containers are
+ * swapped or move assigned.
+ */
+template <typename T>
+class LargeArrayAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    LargeArrayAllocator() = default;
+
+    explicit LargeArrayAllocator(const LargeArrayPolicy& policy)
+        : policy(policy) {
+    }
+
+    template <typename U>
+    LargeArrayAllocator(const LargeArrayAllocator<U>& other)
+        : policy(other.getPolicy()) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(allocateLargeArray(n * sizeof(T), policy));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        freeLargeArray(ptr, n * sizeof(T), policy);
+    }
+
+    const LargeArrayPolicy& getPolicy() const {
+        return policy;
+    }
+
+private:
+    LargeArrayPolicy policy;
+};
+
+template <typename T, typename U>
+bool operator==(const LargeArrayAllocator<T>& a,
+                const LargeArrayAllocator<U>& b) {
+    return a.getPolicy() == b.getPolicy();
+}
+
+template <typename T, typename U>
+bool operator!=(const LargeArrayAllocator<T>& a,
+                const LargeArrayAllocator<U>& b) {
+    return !(a == b);
+}
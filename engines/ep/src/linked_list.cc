@@ -25,6 +25,7 @@
 BasicLinkedList::BasicLinkedList(Vbid vbucketId, EPStats& st)
     : SequenceList(),
       readRange(0, 0),
+      purgeRange(0, 0),
       staleSize(0),
       staleMetaDataSize(0),
       highSeqno(0),
@@ -69,9 +70,11 @@ SequenceList::UpdateStatus BasicLinkedList::updateListElem(
     /* Lock that needed for consistent read of SeqRange 'readRange' */
     std::lock_guard<SpinLock> lh(rangeLock);
 
-    if (readRange.fallsInRange(v.getBySeqno())) {
-        /* Range read is in middle of a point-in-time snapshot, hence we cannot
-           move the element to the end of the list. Return a temp failure */
+    if (readRange.fallsInRange(v.getBySeqno()) ||
+        purgeRange.fallsInRange(v.getBySeqno())) {
+        /* Range read is in middle of a point-in-time snapshot (or the purger
+           is iterating over the element), hence we cannot move the element to
+           the end of the list. Return a temp failure */
         return UpdateStatus::Append;
     }
 
@@ -231,19 +234,53 @@ void BasicLinkedList::markItemStale(std::lock_guard<std::mutex>& listWriteLg,
     v->toOrderedStoredValue()->markStale(listWriteLg, newSv);
 }
 
+bool BasicLinkedList::canRelinkListElem(
+        std::lock_guard<std::mutex>& listWriteLg,
+        const OrderedStoredValue& v) const {
+    if (!v.seqno_hook.is_linked()) {
+        return false;
+    }
+
+    /* Stale items point to the item which replaced them, which may be v; we
+       have no way of finding them to update them */
+    if (numStaleItems != 0) {
+        return false;
+    }
+
+    std::lock_guard<SpinLock> lh(rangeLock);
+    return !readRange.fallsInRange(v.getBySeqno()) &&
+           !purgeRange.fallsInRange(v.getBySeqno());
+}
+
+void BasicLinkedList::relinkListElem(std::lock_guard<std::mutex>& listWriteLg,
+                                     OrderedStoredValue& oldSv,
+                                     OrderedStoredValue& newSv) {
+    auto it = seqList.iterator_to(oldSv);
+    auto newIt = seqList.insert(it, newSv);
+    /* If the element is at 'pausedPurgePoint', then the purge must resume
+       from its replacement */
+    if (pausedPurgePoint == it) {
+        pausedPurgePoint = newIt;
+    }
+    seqList.erase(it);
+}
+
 size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
                                         std::function<bool()> shouldPause) {
     // Purge items marked as stale from the seqList.
     //
     // Strategy - we try to ensure that this function does not block
-    // frontend-writes (adding new OrderedStoredValues (OSVs) to the seqList).
-    // To achieve this (safely),
-    // we (try to) acquire the rangeReadLock and setup a 'read' range for the
-    // whole of the seqList. This prevents any other readers from iterating
-    // the list (and accessing stale items) while we purge on it; but permits
-    // front-end operations to continue as they:
+    // frontend-writes (adding new OrderedStoredValues (OSVs) to the seqList)
+    // or range reads (backfills).
+    // To achieve this (safely), we setup a 'purge' range for the part of the
+    // seqList we visit. This permits front-end operations to continue as
+    // they:
     //   a) Only read/modify non-stale items (we only change stale items) and
-    //   b) Do not change the list membership of anything within the read-range.
+    //   b) Do not change the list membership of anything within the range.
+    // A range read in progress only visits elements from its current
+    // position (readRange.getBegin()) onwards, so we purge up to that
+    // position and stop there - see "Purging during range reads" in the
+    // class description.
     // However, we do need to be careful about what members of OSVs we access
     // here - the only OSVs we can safely access are ones marked stale as they
     // are no longer in the HashTable (and hence subject to HashTable locks).
@@ -252,14 +289,9 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
     // ideal (that's the same lock needed by front-end operations), we can
     // release the lock between each element so front-end operations can
     // have the opportunity to acquire it.
-    //
-    // Attempt to acquire the readRangeLock, to block anyone else concurrently
-    // reading from the list while we remove elements from it.
-    std::unique_lock<std::mutex> rrGuard(rangeReadLock, std::try_to_lock);
-    if (!rrGuard) {
-        // If we cannot acquire the lock then another thread is
-        // running a range read. Given these are typically long-running,
-        // return without blocking.
+    std::unique_lock<std::mutex> purgeGuard(purgeLock, std::try_to_lock);
+    if (!purgeGuard) {
+        // Another purge is in progress; return without blocking.
         return 0;
     }
 
@@ -285,52 +317,68 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
             return 0;
         }
 
-        // Update readRange
+        // Update purgeRange
         std::lock_guard<SpinLock> rangeGuard(rangeLock);
-        readRange = SeqRange(startIt->getBySeqno(), purgeUpToSeqno);
+        purgeRange = SeqRange(startIt->getBySeqno(), purgeUpToSeqno);
     }
 
     // Iterate across all but the last item in the seqList, looking
     // for stale items.
+    // The writeLock is taken for a batch of (up to purgeBatchSize) elements
+    // at a time rather than for each one, so the purger doesn't bounce the
+    // lock with the front-end writers for every element it visits.
     size_t purgedCount = 0;
-    bool stale;
-    for (auto it = startIt; it != seqList.end();) {
-        if ((it->getBySeqno() > purgeUpToSeqno) ||
-            (it->getBySeqno() <= 0) /* last item with no valid seqno yet */) {
-            break;
-        }
-
-        {
-            // As we move past the items in the list, increment the begin of
-            // 'readRange' to reduce the window of creating stale items during
-            // updates
-            std::lock_guard<SpinLock> rangeGuard(rangeLock);
-            readRange.setBegin(it->getBySeqno());
-        }
-
+    bool done = false;
+    for (auto it = startIt; !done && it != seqList.end();) {
         {
             std::lock_guard<std::mutex> writeGuard(getListWriteLock());
-            stale = it->isStale(writeGuard);
-        }
-        // Only stale items are purged.
-        if (!stale) {
-            ++it;
-        } else {
-            // Checks pass, remove from list and delete.
-            it = purgeListElem(it);
-            ++purgedCount;
+            for (size_t visited = 0;
+                 visited < purgeBatchSize && it != seqList.end();
+                 ++visited) {
+                if ((it->getBySeqno() > purgeUpToSeqno) ||
+                    (it->getBySeqno() <= 0) /* last item with no valid seqno
+                                               yet */) {
+                    done = true;
+                    break;
+                }
+
+                {
+                    std::lock_guard<SpinLock> rangeGuard(rangeLock);
+                    if (readRange.getBegin() > 0 &&
+                        it->getBySeqno() >= readRange.getBegin()) {
+                        // Caught up with a range read; the rest of the list
+                        // is still to be read. Resume from here next time.
+                        pausedPurgePoint = it;
+                        done = true;
+                        break;
+                    }
+                    // As we move past the items in the list, increment the
+                    // begin of 'purgeRange' to reduce the window of creating
+                    // stale items during updates
+                    purgeRange.setBegin(it->getBySeqno());
+                }
+
+                // Only stale items are purged.
+                if (!it->isStale(writeGuard)) {
+                    ++it;
+                } else {
+                    // Checks pass, remove from list and delete.
+                    it = purgeListElem(writeGuard, it);
+                    ++purgedCount;
+                }
+            }
         }
 
-        if (shouldPause()) {
+        if (!done && shouldPause()) {
             pausedPurgePoint = it;
             break;
         }
     }
 
-    // Complete; reset the readRange.
+    // Complete; reset the purgeRange.
     {
         std::lock_guard<SpinLock> lh(rangeLock);
-        readRange.reset();
+        purgeRange.reset();
     }
     return purgedCount;
 }
@@ -418,12 +466,10 @@ std::ostream& operator <<(std::ostream& os, const BasicLinkedList& ll) {
     return os;
 }
 
-OrderedLL::iterator BasicLinkedList::purgeListElem(OrderedLL::iterator it) {
+OrderedLL::iterator BasicLinkedList::purgeListElem(
+        std::lock_guard<std::mutex>& writeGuard, OrderedLL::iterator it) {
     StoredValue::UniquePtr purged(&*it);
-    {
-        std::lock_guard<std::mutex> lckGd(getListWriteLock());
-        it = seqList.erase(it);
-    }
+    it = seqList.erase(it);
 
     /* Update the stats tracking the memory owned by the list */
     staleSize.fetch_sub(purged->size());
@@ -133,12 +133,27 @@ private:
  *
  * Ordering/Hierarchy of Locks:
  * ===========================
- * BasicLinkedList has 3 locks namely:
- * (i) writeLock (ii) rangeLock (iii) rangeReadLock
+ * BasicLinkedList has 4 locks namely:
+ * (i) writeLock (ii) rangeLock (iii) rangeReadLock (iv) purgeLock
  * Description of each lock can be found below in the class declaration, here
  * we describe in what order the locks should be grabbed
  *
- * rangeReadLock ==> writeLock ==> rangeLock is the valid lock hierarchy.
+ * rangeReadLock ==> writeLock ==> rangeLock and
+ * purgeLock ==> writeLock ==> rangeLock are the valid lock hierarchies.
+ *
+ * Purging during range reads:
+ * ==========================
+ * A range read only ever moves forward through the list, and never looks at
+ * an element again once it has moved past it. purgeTombstones() therefore
+ * doesn't exclude range reads; it runs concurrently and purges stale
+ * elements up to (but not including) readRange.getBegin(), the element the
+ * range read is currently on. Checking an element against the readRange and
+ * unlinking it are done together under writeLock, which is also held when a
+ * range read registers its readRange (before it looks at any element), so
+ * the purger can never unlink an element a range read has yet to move past.
+ * Without this a long-running backfill would hold back all stale item
+ * purging - i.e. every update during the backfill would keep its old
+ * version in memory until the backfill completed.
  *
  * Preferred/Expected Lock Duration:
  * ================================
@@ -174,6 +189,13 @@ public:
                        StoredValue::UniquePtr ownedSv,
                        StoredValue* newSv) override;
 
+    bool canRelinkListElem(std::lock_guard<std::mutex>& listWriteLg,
+                           const OrderedStoredValue& v) const override;
+
+    void relinkListElem(std::lock_guard<std::mutex>& listWriteLg,
+                        OrderedStoredValue& oldSv,
+                        OrderedStoredValue& newSv) override;
+
     size_t purgeTombstones(seqno_t purgeUpToSeqno,
                            std::function<bool()> shouldPause = []() {
                                return false;
@@ -208,6 +230,12 @@ public:
 
     void dump() const override;
 
+    /**
+     * The default number of elements purgeTombstones() visits each time it
+     * takes writeLock (and between its checks of shouldPause).
+     */
+    static const size_t DefaultPurgeBatchSize = 64;
+
 protected:
     /* Underlying data structure that holds the items in an Ordered Sequence */
     OrderedLL seqList;
@@ -242,12 +270,28 @@ protected:
      * range.
      * For now we use this lock to allow only one range read at a time.
      *
-     * It is also additionally used in purgeTombstones() to prevent the
-     * creation of any new rangeReads while purge is in-progress - see
-     * detailed comments there.
      */
     std::mutex rangeReadLock;
 
+    /**
+     * The range of the list purgeTombstones() is currently visiting. Like
+     * readRange, writers must not move elements in this range to the end of
+     * the list (as the purger is iterating over it).
+     * Protected by rangeLock.
+     */
+    SeqRange purgeRange;
+
+    /**
+     * Lock that serializes purgeTombstones() calls.
+     */
+    std::mutex purgeLock;
+
+    /**
+     * The number of elements purgeTombstones() visits each time it takes
+     * writeLock. Guarded by purgeLock.
+     */
+    size_t purgeBatchSize = DefaultPurgeBatchSize;
+
     /* Overall memory consumed by (stale) OrderedStoredValues owned by the
        list */
     Couchbase::RelaxedAtomic<size_t> staleSize;
@@ -257,7 +301,13 @@ protected:
     Couchbase::RelaxedAtomic<size_t> staleMetaDataSize;
 
 private:
-    OrderedLL::iterator purgeListElem(OrderedLL::iterator it);
+    /**
+     * Remove (and delete) the stale element 'it' from the list.
+     *
+     * @return iterator to the next element
+     */
+    OrderedLL::iterator purgeListElem(std::lock_guard<std::mutex>& writeGuard,
+                                      OrderedLL::iterator it);
 
     /**
      * We need to keep track of the highest seqno separately because there is a
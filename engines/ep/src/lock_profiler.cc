@@ -0,0 +1,139 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "lock_profiler.h"
+
+#include "statwriter.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace std::chrono;
+
+// Track from 1ns to an hour, to 2 significant figures.
+static const uint64_t MaxTrackedNanos = 3600ULL * 1000 * 1000 * 1000;
+
+static const size_t DefaultSampleRate = 100;
+
+static uint64_t toNanos(steady_clock::duration d) {
+    const int64_t ns = duration_cast<nanoseconds>(d).count();
+    return std::min(uint64_t(std::max(ns, int64_t(1))), MaxTrackedNanos);
+}
+
+LockProfile::LockProfile(const char* name)
+    : name(name),
+      sampleRate(DefaultSampleRate),
+      wait(1, MaxTrackedNanos, 2),
+      hold(1, MaxTrackedNanos, 2) {
+}
+
+bool LockProfile::sample() const {
+    const auto rate = sampleRate.load(std::memory_order_relaxed);
+    if (rate == 0) {
+        return false;
+    }
+    // A cheap per-thread xorshift generator; the acquisitions of the
+    // different lock classes by a thread must not be sampled in lock step.
+    static thread_local uint32_t state = 0;
+    if (state == 0) {
+        state = uint32_t(reinterpret_cast<uintptr_t>(&state)) | 1;
+    }
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state % rate) == 0;
+}
+
+void LockProfile::logWait(steady_clock::duration duration) {
+    std::lock_guard<std::mutex> lh(mutex);
+    wait.addValue(toNanos(duration));
+}
+
+void LockProfile::logHold(steady_clock::duration duration) {
+    std::lock_guard<std::mutex> lh(mutex);
+    hold.addValue(toNanos(duration));
+}
+
+void LockProfile::reset() {
+    std::lock_guard<std::mutex> lh(mutex);
+    wait.reset();
+    hold.reset();
+}
+
+static void addNanosStats(const std::string& prefix,
+                          const HdrHistogram& histogram,
+                          ADD_STAT add_stat,
+                          const void* cookie) {
+    add_casted_stat((prefix + "_count").c_str(),
+                    histogram.getValueCount(),
+                    add_stat,
+                    cookie);
+    if (histogram.getValueCount() == 0) {
+        return;
+    }
+    const std::pair<const char*, double> percentiles[] = {
+            {"_p50_ns", 50.0},
+            {"_p90_ns", 90.0},
+            {"_p99_ns", 99.0},
+            {"_p99.9_ns", 99.9},
+            {"_max_ns", 100.0}};
+    for (const auto& p : percentiles) {
+        add_casted_stat((prefix + p.first).c_str(),
+                        histogram.getValueAtPercentile(p.second),
+                        add_stat,
+                        cookie);
+    }
+}
+
+void LockProfile::addStats(const void* cookie, ADD_STAT add_stat) const {
+    std::lock_guard<std::mutex> lh(mutex);
+    add_casted_stat((std::string(name) + ":sample_rate").c_str(),
+                    sampleRate.load(std::memory_order_relaxed),
+                    add_stat,
+                    cookie);
+    addNanosStats(std::string(name) + ":wait", wait, add_stat, cookie);
+    addNanosStats(std::string(name) + ":hold", hold, add_stat, cookie);
+}
+
+void LockProfiles::setSampleRate(size_t rate) {
+    for (auto* profile : {&hashTable,
+                          &checkpointQueue,
+                          &vbucketState,
+                          &durabilityMonitor,
+                          &backfillManager}) {
+        profile->setSampleRate(rate);
+    }
+}
+
+void LockProfiles::reset() {
+    for (auto* profile : {&hashTable,
+                          &checkpointQueue,
+                          &vbucketState,
+                          &durabilityMonitor,
+                          &backfillManager}) {
+        profile->reset();
+    }
+}
+
+void LockProfiles::addStats(const void* cookie, ADD_STAT add_stat) const {
+    for (const auto* profile : {&hashTable,
+                                &checkpointQueue,
+                                &vbucketState,
+                                &durabilityMonitor,
+                                &backfillManager}) {
+        profile->addStats(cookie, add_stat);
+    }
+}
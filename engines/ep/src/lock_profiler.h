@@ -0,0 +1,203 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include "hdrhistogram.h"
+
+#include <memcached/engine_common.h>
+#include <platform/rwlock.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+/**
+ * Sampled wait and hold time histograms of a class of locks (e.g. all of
+ * the hash bucket locks of a bucket), reported by "stats locks".
+ *
+ * Only 1 in sampleRate (at random) acquisitions of the locks are timed, so
+ * the profile can be gathered in production: the others only pay for the
+ * sampling decision.
+ */
+class LockProfile {
+public:
+    explicit LockProfile(const char* name);
+
+    /// @return true if the calling thread should time this acquisition
+    bool sample() const;
+
+    /// Record the time a (sampled) acquisition waited for the lock
+    void logWait(std::chrono::steady_clock::duration duration);
+
+    /// Record the time a (sampled) acquisition held the lock for
+    void logHold(std::chrono::steady_clock::duration duration);
+
+    /// Time 1 in rate acquisitions, or none if 0
+    void setSampleRate(size_t rate) {
+        sampleRate.store(rate, std::memory_order_relaxed);
+    }
+
+    void reset();
+
+    void addStats(const void* cookie, ADD_STAT add_stat) const;
+
+    /**
+     * Times a (sampled) acquisition by a lock holder: construct it before
+     * acquiring the lock, call acquired() once acquired, and destroy it
+     * once the lock is released.
+     */
+    class Timer {
+    public:
+        /// @param profile the profile to record into; null to not time
+        explicit Timer(LockProfile* profile)
+            : profile(profile && profile->sample() ? profile : nullptr) {
+            if (this->profile) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        Timer(const Timer&) = delete;
+
+        void acquired() {
+            if (profile) {
+                const auto now = std::chrono::steady_clock::now();
+                profile->logWait(now - start);
+                start = now;
+            }
+        }
+
+        ~Timer() {
+            if (profile) {
+                profile->logHold(std::chrono::steady_clock::now() - start);
+            }
+        }
+
+    private:
+        /// The profile to record into, null if this acquisition isn't sampled
+        LockProfile* const profile;
+        /// When the acquisition started, then when the lock was acquired
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    const char* const name;
+    std::atomic<size_t> sampleRate;
+
+    mutable std::mutex mutex;
+    HdrHistogram wait;
+    HdrHistogram hold;
+};
+
+/**
+ * The profiled lock classes of a bucket.
+ */
+struct LockProfiles {
+    void setSampleRate(size_t rate);
+    void reset();
+    void addStats(const void* cookie, ADD_STAT add_stat) const;
+
+    /// The hash bucket locks (stripes) of the HashTables
+    LockProfile hashTable{"hash_table"};
+    /// The CheckpointManager queueLock of the vBuckets
+    LockProfile checkpointQueue{"checkpoint_queue"};
+    /// The state lock of the vBuckets
+    LockProfile vbucketState{"vbucket_state"};
+    /// The state mutex of the DurabilityMonitors
+    LockProfile durabilityMonitor{"durability_monitor"};
+    /// The lock of the DCP BackfillManagers
+    LockProfile backfillManager{"backfill_manager"};
+};
+
+/**
+ * A wrapper around a mutex (meeting the Lockable and, if the mutex does,
+ * the SharedLockable requirements) which records a sample of its
+ * acquisitions into a LockProfile. Shared acquisitions only record the
+ * time waited for the lock.
+ */
+template <typename Mutex = std::mutex>
+class ProfiledMutex {
+public:
+    /// @param profile the profile to record into; null to not profile
+    explicit ProfiledMutex(LockProfile* profile) : profile(profile) {
+    }
+
+    void lock() {
+        if (!profile || !profile->sample()) {
+            mutex.lock();
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        mutex.lock();
+        acquired = std::chrono::steady_clock::now();
+        profile->logWait(acquired - start);
+    }
+
+    bool try_lock() {
+        return mutex.try_lock();
+    }
+
+    void unlock() {
+        if (acquired == std::chrono::steady_clock::time_point()) {
+            mutex.unlock();
+            return;
+        }
+        const auto held = std::chrono::steady_clock::now() - acquired;
+        acquired = {};
+        mutex.unlock();
+        profile->logHold(held);
+    }
+
+    void lock_shared() {
+        if (!profile || !profile->sample()) {
+            mutex.lock_shared();
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        mutex.lock_shared();
+        profile->logWait(std::chrono::steady_clock::now() - start);
+    }
+
+    void unlock_shared() {
+        mutex.unlock_shared();
+    }
+
+private:
+    LockProfile* const profile;
+    Mutex mutex;
+    /// When the (sampled) exclusive holder acquired the lock; only accessed
+    /// by the holder.
+    std::chrono::steady_clock::time_point acquired;
+};
+
+/**
+ * A cb::RWLock whose acquisitions through ReaderLockHolder and
+ * WriterLockHolder are profiled.
+ */
+class ProfiledRWLock : public cb::RWLock {
+public:
+    explicit ProfiledRWLock(LockProfile& profile) : profile(profile) {
+    }
+
+    LockProfile& getProfile() {
+        return profile;
+    }
+
+private:
+    LockProfile& profile;
+};
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "config.h"
+#include "lock_profiler.h"
 #include "utility.h"
 #include <platform/rwlock.h>
 #include <mutex>
@@ -27,6 +28,7 @@ using LockHolder = std::lock_guard<std::mutex>;
 /**
  * RAII lock holder over multiple locks.
  */
+template <class Mutex = std::mutex>
 class MultiLockHolder {
 public:
 
@@ -35,7 +37,7 @@ public:
      *
      * @param m reference to a vector of locks
      */
-    MultiLockHolder(std::vector<std::mutex>& m)
+    MultiLockHolder(std::vector<Mutex>& m)
         : mutexes(m) {
         lock();
     }
@@ -63,7 +65,7 @@ private:
         }
     }
 
-    std::vector<std::mutex>& mutexes;
+    std::vector<Mutex>& mutexes;
 
     DISALLOW_COPY_AND_ASSIGN(MultiLockHolder);
 };
@@ -77,10 +79,17 @@ public:
     typedef cb::RWLock mutex_type;
 
     ReaderLockHolder(cb::RWLock& lock)
-        : lh(lock) {
+        : timer(nullptr), lh(lock) {
+    }
+
+    ReaderLockHolder(ProfiledRWLock& lock)
+        : timer(&lock.getProfile()), lh(lock) {
+        timer.acquired();
     }
 
 private:
+    // Declared before lh, so the hold is recorded once the lock is released
+    LockProfile::Timer timer;
     std::lock_guard<cb::ReaderLock> lh;
 
     DISALLOW_COPY_AND_ASSIGN(ReaderLockHolder);
@@ -95,10 +104,17 @@ public:
     typedef cb::RWLock mutex_type;
 
     WriterLockHolder(cb::RWLock& lock)
-        : lh(lock) {
+        : timer(nullptr), lh(lock) {
+    }
+
+    WriterLockHolder(ProfiledRWLock& lock)
+        : timer(&lock.getProfile()), lh(lock) {
+        timer.acquired();
     }
 
 private:
+    // Declared before lh, so the hold is recorded once the lock is released
+    LockProfile::Timer timer;
     std::lock_guard<cb::WriterLock> lh;
 
     DISALLOW_COPY_AND_ASSIGN(WriterLockHolder);
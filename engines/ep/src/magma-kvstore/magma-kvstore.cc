@@ -23,9 +23,15 @@
 #include "magma-kvstore_config.h"
 #include "vbucket.h"
 
+#include <nlohmann/json.hpp>
 #include <string.h>
 #include <algorithm>
+#include <functional>
+#include <gsl/gsl>
 #include <limits>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 
 namespace magmakv {
 // MetaData is used to serialize and de-serialize metadata respectively when
@@ -147,25 +153,141 @@ private:
     bool updatedExistingItem;
 };
 
+/**
+ * The Magma instance of a single VBucket.
+ *
+ * This is the only place which talks to Magma itself; MagmaKVStore is
+ * written purely against the primitives below (a batched write, point
+ * lookups, a seqno ordered scan and local documents). Until the magma
+ * library is wired in, the VBucket's documents are kept in memory, which
+ * lets the KVStore paths above be exercised and benchmarked.
+ *
+ * Documents are stored as MetaData followed by the value, keyed by the
+ * (collection-encoded) document key; a by-seqno index maps each live seqno
+ * to its key. All methods are thread-safe.
+ */
 class KVMagma {
 public:
+    /// Status codes returned by the primitives; errors are negative.
+    enum Status { Success = 0, NotFound = 1 };
+
+    /// Called for each document of a scan, returns false to stop the scan.
+    using ScanCallback = std::function<bool(
+            int64_t seqno, const std::string& key, const std::string& value)>;
+
     KVMagma(const Vbid vb, const std::string path) : vbid(vb.get()) {
         // open magma
     }
 
-    int SetOrDel(MagmaRequest* req) {
-        if (req->isDelete()) {
-            ; // TODO should we have a merge delta ops for old value?
+    /**
+     * Apply a batch of mutations and the given local documents atomically.
+     * Requests whose key already had a live document are marked as updated.
+     */
+    int Write(const std::vector<std::unique_ptr<MagmaRequest>>& batch,
+              const std::map<std::string, std::string>& localDocs) {
+        std::lock_guard<std::mutex> lg(lock);
+        for (const auto& req : batch) {
+            std::string key(req->getKeyData(), req->getKeyLen());
+            std::string value(reinterpret_cast<const char*>(&req->getDocMeta()),
+                              sizeof(magmakv::MetaData));
+            value.append(static_cast<const char*>(req->getBodyData()),
+                         req->getBodySize());
+
+            auto it = docs.find(key);
+            if (it != docs.end()) {
+                const auto old = getMeta(it->second);
+                bySeqno.erase(old.bySeqno);
+                if (old.deleted) {
+                    --numDeletes;
+                } else {
+                    --numItems;
+                    req->markAsUpdated();
+                }
+                it->second = std::move(value);
+            } else {
+                it = docs.emplace(std::move(key), std::move(value)).first;
+            }
+            bySeqno[req->getBySeqno()] = it->first;
+            if (req->isDelete()) {
+                ++numDeletes;
+            } else {
+                ++numItems;
+            }
         }
-        return 0;
+        for (const auto& doc : localDocs) {
+            local[doc.first] = doc.second;
+        }
+        return Success;
     }
 
-    int Get(const StoredDocKey& key, void** value, int* valueLen) {
-        return 0;
+    int Get(const DocKey& key, std::string& value) const {
+        std::lock_guard<std::mutex> lg(lock);
+        auto it = docs.find(std::string(
+                reinterpret_cast<const char*>(key.data()), key.size()));
+        if (it == docs.end()) {
+            return NotFound;
+        }
+        value = it->second;
+        return Success;
+    }
+
+    int GetLocal(const std::string& key, std::string& value) const {
+        std::lock_guard<std::mutex> lg(lock);
+        auto it = local.find(key);
+        if (it == local.end()) {
+            return NotFound;
+        }
+        value = it->second;
+        return Success;
+    }
+
+    /**
+     * Visit the documents with a seqno in [startSeqno, endSeqno] in seqno
+     * order. Writes to the VBucket wait for the scan to complete, so the
+     * scan sees a consistent snapshot.
+     */
+    int Scan(int64_t startSeqno, int64_t endSeqno, ScanCallback cb) const {
+        std::lock_guard<std::mutex> lg(lock);
+        for (auto it = bySeqno.lower_bound(startSeqno);
+             it != bySeqno.end() && it->first <= endSeqno;
+             ++it) {
+            if (!cb(it->first, it->second, docs.at(it->second))) {
+                break;
+            }
+        }
+        return Success;
+    }
+
+    int64_t GetMaxSeqno() const {
+        std::lock_guard<std::mutex> lg(lock);
+        return bySeqno.empty() ? 0 : bySeqno.rbegin()->first;
+    }
+
+    size_t GetItemCount() const {
+        std::lock_guard<std::mutex> lg(lock);
+        return numItems;
+    }
+
+    size_t GetDeleteCount() const {
+        std::lock_guard<std::mutex> lg(lock);
+        return numDeletes;
     }
 
     Vbid vbid;
-    int magmaHandleId;
+
+private:
+    static magmakv::MetaData getMeta(const std::string& value) {
+        magmakv::MetaData meta;
+        std::memcpy(&meta, value.data(), sizeof(meta));
+        return meta;
+    }
+
+    mutable std::mutex lock;
+    std::unordered_map<std::string, std::string> docs;
+    std::map<int64_t, std::string> bySeqno;
+    std::map<std::string, std::string> local;
+    size_t numItems = 0;
+    size_t numDeletes = 0;
 };
 
 MagmaKVStore::MagmaKVStore(MagmaKVStoreConfig& configuration)
@@ -204,8 +326,7 @@ MagmaKVStore::MagmaKVStore(MagmaKVStoreConfig& configuration)
     // Read persisted VBs state
     auto vbids = discoverVBuckets();
     for (auto vbid : vbids) {
-        KVMagma db(vbid, magmaPath);
-        // TODO: may need to read stashed magma state files for caching.
+        readVBState(*openDB(vbid));
         // Update stats
         ++st.numLoadedVb;
     }
@@ -214,6 +335,16 @@ MagmaKVStore::MagmaKVStore(MagmaKVStoreConfig& configuration)
 MagmaKVStore::~MagmaKVStore() {
 }
 
+std::shared_ptr<KVMagma> MagmaKVStore::openDB(Vbid vbid) {
+    std::lock_guard<std::mutex> lg(openDBMutex);
+    auto& db = vbDB[vbid.get()];
+    if (!db) {
+        db = std::make_shared<KVMagma>(vbid, getVBDBSubdir(vbid));
+        ++st.numOpen;
+    }
+    return db;
+}
+
 std::string MagmaKVStore::getVBDBSubdir(Vbid vbid) {
     return magmaPath + std::to_string(vbid.get());
 }
@@ -265,7 +396,10 @@ bool MagmaKVStore::commit(Collections::VB::Flush& collectionsFlush) {
     auto vbid = commitBatch[0]->getVBucketId();
 
     // Flush all documents to disk
+    auto begin = std::chrono::steady_clock::now();
     auto status = saveDocs(vbid, collectionsFlush, commitBatch);
+    st.commitHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin));
     if (status) {
         logger.warn(
                 "MagmaKVStore::commit: saveDocs error:{}, "
@@ -291,19 +425,34 @@ void MagmaKVStore::commitCallback(
         int status,
         const std::vector<std::unique_ptr<MagmaRequest>>& commitBatch) {
     for (const auto& req : commitBatch) {
-        if (!status) {
-            ++st.numSetFailure;
+        const auto dataSize = sizeof(magmakv::MetaData) + req->getBodySize();
+        /* update ep stats */
+        ++st.io_num_write;
+        st.io_write_bytes += (req->getKeyLen() + dataSize);
+
+        // A failed write is retried by the flusher, a successful one reports
+        // whether the key had a live document (see KVMagma::Write).
+        if (req->isDelete()) {
+            int rv = MUTATION_FAILED;
+            if (status) {
+                ++st.numDelFailure;
+            } else {
+                st.delTimeHisto.add(req->getDelta() / 1000);
+                rv = req->wasCreate() ? DOC_NOT_FOUND : MUTATION_SUCCESS;
+            }
+            req->getDelCallback()->callback(*transactionCtx, rv);
         } else {
-            st.writeTimeHisto.add(req->getDelta() / 1000);
-            st.writeSizeHisto.add(req->getKeyLen() + req->getBodySize());
+            int rv = MUTATION_FAILED;
+            if (status) {
+                ++st.numSetFailure;
+            } else {
+                st.writeTimeHisto.add(req->getDelta() / 1000);
+                st.writeSizeHisto.add(req->getKeyLen() + dataSize);
+                rv = MUTATION_SUCCESS;
+            }
+            mutation_result mr = std::make_pair(rv, req->wasCreate());
+            req->getSetCallback()->callback(*transactionCtx, mr);
         }
-        // TODO: Should set `mr.second` to true or false depending on if
-        // this is an insertion (true) or an update of an existing item
-        // (false). However, to achieve this we would need to perform a lookup
-        // which is costly. For now just assume that the item
-        // did not exist. Later maybe use hyperlog for a better answer?
-        mutation_result mr = std::make_pair(1, req->wasCreate());
-        req->getSetCallback()->callback(*transactionCtx, mr);
     }
 }
 
@@ -352,41 +501,27 @@ GetValue MagmaKVStore::getWithHeader(void* dbHandle,
                                      Vbid vb,
                                      GetMetaOnly getMetaOnly,
                                      bool fetchDelete) {
-    void* value = nullptr;
-    int valueLen = 0;
-    KVMagma db(vb, magmaPath);
-    int status = db.Get(key, &value, &valueLen);
-    if (status < 0) {
-        logger.warn(
-                "MagmaKVStore::getWithHeader: magma::DB::Lookup error:{}, "
-                "vb:{}",
-                status,
-                vb);
+    auto rv = fetchDoc(*openDB(vb), key, vb, getMetaOnly);
+    if (rv.getStatus() == ENGINE_SUCCESS && rv.item->isDeleted() &&
+        !fetchDelete) {
+        return GetValue{nullptr, ENGINE_KEY_ENOENT};
     }
-    std::string valStr(reinterpret_cast<char*>(value), valueLen);
-    return makeGetValue(vb, key, valStr, getMetaOnly);
+    return rv;
 }
 
 void MagmaKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
-    KVMagma db(vb, magmaPath);
+    // All the keys are looked up through the one (cached) handle of the
+    // VBucket.
+    const auto db = openDB(vb);
     for (auto& it : itms) {
         auto& key = it.first;
-        void* value = nullptr;
-        int valueLen = 0;
-        int status = db.Get(key, &value, &valueLen);
-        if (status < 0) {
-            logger.warn(
-                    "MagmaKVStore::getMulti: magma::DB::Lookup error:{}, "
-                    "vb:{}",
-                    status,
-                    vb);
+        it.second.value = fetchDoc(*db, key, vb, it.second.isMetaOnly);
+        if (it.second.value.getStatus() != ENGINE_SUCCESS) {
             for (auto& fetch : it.second.bgfetched_list) {
-                fetch->value->setStatus(ENGINE_KEY_ENOENT);
+                fetch->value->setStatus(it.second.value.getStatus());
             }
             continue;
         }
-        std::string valStr(reinterpret_cast<char*>(value), valueLen);
-        it.second.value = makeGetValue(vb, key, valStr, it.second.isMetaOnly);
         GetValue* rv = &it.second.value;
         for (auto& fetch : it.second.bgfetched_list) {
             fetch->value = rv;
@@ -394,6 +529,35 @@ void MagmaKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
     }
 }
 
+GetValue MagmaKVStore::fetchDoc(const KVMagma& db,
+                                const DocKey& key,
+                                Vbid vb,
+                                GetMetaOnly getMetaOnly) {
+    auto start = std::chrono::steady_clock::now();
+    std::string value;
+    int status = db.Get(key, value);
+    if (status != KVMagma::Success) {
+        if (status < 0) {
+            logger.warn(
+                    "MagmaKVStore::fetchDoc: magma::DB::Lookup error:{}, "
+                    "vb:{}",
+                    status,
+                    vb);
+        }
+        ++st.numGetFailure;
+        return GetValue{nullptr,
+                        status < 0 ? ENGINE_TMPFAIL : ENGINE_KEY_ENOENT};
+    }
+
+    auto rv = makeGetValue(vb, key, value, getMetaOnly);
+    ++st.io_bg_fetch_docs_read;
+    st.io_bgfetch_doc_bytes += key.size() + value.size();
+    st.readTimeHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start));
+    st.readSizeHisto.add(key.size() + rv.item->getNBytes());
+    return rv;
+}
+
 void MagmaKVStore::reset(Vbid vbucketId) {
     // TODO storage-team 2018-10-9 need to implement
 }
@@ -414,8 +578,13 @@ void MagmaKVStore::del(const Item& item,
 
 void MagmaKVStore::delVBucket(Vbid vbid, uint64_t vb_version) {
     std::lock_guard<std::mutex> lg(writeLock);
-    // TODO: check if needs lock on `openDBMutex`.
-    vbDB[vbid.get()].reset();
+    {
+        std::lock_guard<std::mutex> lg2(openDBMutex);
+        if (vbDB[vbid.get()]) {
+            vbDB[vbid.get()].reset();
+            ++st.numClose;
+        }
+    }
     // Just destroy the DB in the sub-folder for vbid
     auto dbname = getVBDBSubdir(vbid);
     // DESTROY DB...
@@ -430,6 +599,18 @@ bool MagmaKVStore::snapshotVBucket(Vbid vbucketId,
     if (updateCachedVBState(vbucketId, vbstate) &&
         (options == VBStatePersist::VBSTATE_PERSIST_WITHOUT_COMMIT ||
          options == VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT)) {
+        auto status = openDB(vbucketId)->Write(
+                {}, {{getVbstateKey(), encodeVBState(vbstate)}});
+        if (status) {
+            logger.warn(
+                    "MagmaKVStore::snapshotVBucket: magma::DB::Write error:{} "
+                    "state:{} {}",
+                    status,
+                    VBucket::toString(vbstate.state),
+                    vbucketId);
+            ++st.numVbSetFailure;
+            return false;
+        }
     }
 
     st.snapshotHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
@@ -447,6 +628,14 @@ void MagmaKVStore::destroyInvalidVBuckets(bool) {
     // TODO storage-team 2018-10-9 need to implement
 }
 
+size_t MagmaKVStore::getNumPersistedDeletes(Vbid vbid) {
+    return openDB(vbid)->GetDeleteCount();
+}
+
+size_t MagmaKVStore::getItemCount(Vbid vbid) {
+    return openDB(vbid)->GetItemCount();
+}
+
 size_t MagmaKVStore::getNumShards() const {
     return configuration.getMaxShards();
 }
@@ -509,6 +698,85 @@ void MagmaKVStore::readVBState(const KVMagma& db) {
     auto key = getVbstateKey();
     std::string vbstate;
     auto vbid = db.vbid;
+    auto status = db.GetLocal(key, vbstate);
+    if (status != KVMagma::Success) {
+        if (status == KVMagma::NotFound) {
+            logger.info(
+                    "MagmaKVStore::readVBState: '_local/vbstate.{}' not found",
+                    vbid.get());
+        } else {
+            logger.warn(
+                    "MagmaKVStore::readVBState: error getting vbstate "
+                    "error:{}, {}",
+                    status,
+                    vbid);
+        }
+    } else {
+        nlohmann::json json;
+        try {
+            json = nlohmann::json::parse(vbstate);
+        } catch (const nlohmann::json::exception& e) {
+            logger.warn(
+                    "MagmaKVStore::readVBState: Failed to parse the vbstat "
+                    "json doc for {}, json:{} with reason:{}",
+                    vbid,
+                    vbstate,
+                    e.what());
+            return;
+        }
+
+        auto vb_state = json.value("state", "");
+        auto checkpoint_id = json.value("checkpoint_id", "");
+        auto max_deleted_seqno = json.value("max_deleted_seqno", "");
+        auto snapStart = json.find("snap_start");
+        auto snapEnd = json.find("snap_end");
+        auto maxCasValue = json.find("max_cas");
+        auto hlcCasEpoch = json.find("hlc_epoch");
+        mightContainXattrs = json.value("might_contain_xattrs", false);
+
+        auto failover_json = json.find("failover_table");
+        if (vb_state.empty() || checkpoint_id.empty() ||
+            max_deleted_seqno.empty()) {
+            logger.warn(
+                    "MagmaKVStore::readVBState: State"
+                    " JSON doc for {} is in the wrong format:{}, "
+                    "vb state:{}, checkpoint id:{} and max deleted seqno:{}",
+                    vbid,
+                    vbstate,
+                    vb_state,
+                    checkpoint_id,
+                    max_deleted_seqno);
+        } else {
+            state = VBucket::fromString(vb_state.c_str());
+            maxDeletedSeqno = std::stoull(max_deleted_seqno);
+            checkpointId = std::stoull(checkpoint_id);
+
+            if (snapStart == json.end()) {
+                lastSnapStart = gsl::narrow<uint64_t>(highSeqno);
+            } else {
+                lastSnapStart = std::stoull(snapStart->get<std::string>());
+            }
+
+            if (snapEnd == json.end()) {
+                lastSnapEnd = gsl::narrow<uint64_t>(highSeqno);
+            } else {
+                lastSnapEnd = std::stoull(snapEnd->get<std::string>());
+            }
+
+            if (maxCasValue != json.end()) {
+                maxCas = std::stoull(maxCasValue->get<std::string>());
+            }
+
+            if (hlcCasEpoch != json.end()) {
+                hlcCasEpochSeqno = std::stoull(hlcCasEpoch->get<std::string>());
+            }
+
+            if (failover_json != json.end()) {
+                failovers = failover_json->dump();
+            }
+        }
+    }
+
     cachedVBStates[vbid.get()] =
             std::make_unique<vbucket_state>(state,
                                             checkpointId,
@@ -524,6 +792,31 @@ void MagmaKVStore::readVBState(const KVMagma& db) {
                                             false);
 }
 
+std::string MagmaKVStore::encodeVBState(const vbucket_state& vbState) {
+    std::stringstream jsonState;
+
+    jsonState << "{\"state\": \"" << VBucket::toString(vbState.state) << "\""
+              << ",\"checkpoint_id\": \"" << vbState.checkpointId << "\""
+              << ",\"max_deleted_seqno\": \"" << vbState.maxDeletedSeqno
+              << "\"";
+    if (!vbState.failovers.empty()) {
+        jsonState << ",\"failover_table\": " << vbState.failovers;
+    }
+    jsonState << ",\"snap_start\": \"" << vbState.lastSnapStart << "\""
+              << ",\"snap_end\": \"" << vbState.lastSnapEnd << "\""
+              << ",\"max_cas\": \"" << vbState.maxCas << "\""
+              << ",\"hlc_epoch\": \"" << vbState.hlcCasEpochSeqno << "\"";
+
+    if (vbState.mightContainXattrs) {
+        jsonState << ",\"might_contain_xattrs\": true";
+    } else {
+        jsonState << ",\"might_contain_xattrs\": false";
+    }
+
+    jsonState << "}";
+    return jsonState.str();
+}
+
 int MagmaKVStore::saveDocs(
         Vbid vbid,
         Collections::VB::Flush& collectionsFlush,
@@ -541,45 +834,39 @@ int MagmaKVStore::saveDocs(
     }
 
     int64_t lastSeqno = 0;
-    int status = 0;
-
-    auto begin = std::chrono::steady_clock::now();
-    {
-        KVMagma db(vbid, magmaPath);
-
-        for (const auto& request : commitBatch) {
-            status = db.SetOrDel(request.get());
-            if (status < 0) {
-                logger.warn(
-                        "MagmaKVStore::saveDocs: magma::DB::Insert error:{}, "
-                        "vb:{}",
-                        status,
-                        vbid);
-            }
-            if (request->getBySeqno() > lastSeqno) {
-                lastSeqno = request->getBySeqno();
-            }
-        }
+    for (const auto& request : commitBatch) {
+        lastSeqno = std::max(lastSeqno, request->getBySeqno());
     }
 
-    st.commitHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+    // The whole batch and the updated vbstate go to Magma in one write.
+    // The cached state is only updated once the write has succeeded.
+    vbucket_state newState = *vbstate;
+    newState.highSeqno = lastSeqno;
+
+    auto begin = std::chrono::steady_clock::now();
+    auto status = openDB(vbid)->Write(
+            commitBatch, {{getVbstateKey(), encodeVBState(newState)}});
+    st.saveDocsHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - begin));
     if (status) {
         logger.warn(
                 "MagmaKVStore::saveDocs: magma::DB::Write error:{}, "
-                "vb:%d",
+                "{}",
                 status,
-                vbid.get());
+                vbid);
         return status;
     }
 
+    st.batchSize.add(reqsSize);
+    st.docsCommitted = reqsSize;
+
     vbstate->highSeqno = lastSeqno;
 
     return status;
 }
 
 int64_t MagmaKVStore::readHighSeqnoFromDisk(const KVMagma& db) {
-    return 0;
+    return db.GetMaxSeqno();
 }
 
 std::string MagmaKVStore::getVbstateKey() {
@@ -628,12 +915,63 @@ scan_error_t MagmaKVStore::scan(ScanContext* ctx) {
     if (ctx->lastReadSeqno != 0) {
         startSeqno = ctx->lastReadSeqno + 1;
     }
-    (void)startSeqno;
 
-    return scan_success;
+    GetMetaOnly isMetaOnly = ctx->valFilter == ValueFilter::KEYS_ONLY
+                                     ? GetMetaOnly::Yes
+                                     : GetMetaOnly::No;
+    const bool includeDeletes = ctx->docFilter != DocumentFilter::NO_DELETES;
+    const bool onlyKeys = ctx->valFilter == ValueFilter::KEYS_ONLY;
+
+    auto result = scan_success;
+    auto visit = [&](int64_t seqno,
+                     const std::string& keyStr,
+                     const std::string& value) {
+        DocKey key(reinterpret_cast<const uint8_t*>(keyStr.data()),
+                   keyStr.size(),
+                   DocKeyEncodesCollectionId::Yes);
+        std::unique_ptr<Item> itm = makeItem(ctx->vbid, key, value, isMetaOnly);
+        if (!includeDeletes && itm->isDeleted()) {
+            return true;
+        }
+
+        auto collectionsRHandle = ctx->collectionsContext.lockCollections(
+                key, true /*allow system*/);
+        CacheLookup lookup(key, seqno, ctx->vbid, collectionsRHandle);
+        ctx->lookup->callback(lookup);
+
+        int status = ctx->lookup->getStatus();
+        if (status == ENGINE_KEY_EEXISTS) {
+            ctx->lastReadSeqno = seqno;
+            return true;
+        } else if (status == ENGINE_ENOMEM) {
+            result = scan_again;
+            return false;
+        }
+
+        GetValue rv(std::move(itm), ENGINE_SUCCESS, -1, onlyKeys);
+        ctx->callback->callback(rv);
+        if (ctx->callback->getStatus() == ENGINE_ENOMEM) {
+            result = scan_again;
+            return false;
+        }
+
+        ctx->lastReadSeqno = seqno;
+        return true;
+    };
+
+    auto status = openDB(ctx->vbid)->Scan(startSeqno, ctx->maxSeqno, visit);
+    if (status) {
+        logger.warn("MagmaKVStore::scan: magma::DB::Scan error:{}, {}",
+                    status,
+                    ctx->vbid);
+        return scan_failed;
+    }
+
+    return result;
 }
 
 void MagmaKVStore::destroyScanContext(ScanContext* ctx) {
     // TODO Might be nice to have the snapshot in the ctx and
     // release it on destruction
+    delete ctx;
 }
@@ -131,10 +131,7 @@ public:
         return cachedVBStates[vbucketId.get()].get();
     }
 
-    size_t getNumPersistedDeletes(Vbid vbid) override {
-        // TODO storage-team 2018-10-9 - need to implement
-        return 0;
-    }
+    size_t getNumPersistedDeletes(Vbid vbid) override;
 
     DBFileInfo getDbFileInfo(Vbid vbid) override {
         // TODO how will magma implement this
@@ -148,10 +145,7 @@ public:
         return vbinfo;
     }
 
-    size_t getItemCount(Vbid vbid) override {
-        // TODO storage-team 2018-10-9 need to implement
-        return 0;
-    }
+    size_t getItemCount(Vbid vbid) override;
 
     RollbackResult rollback(Vbid vbid,
                             uint64_t rollbackSeqno,
@@ -168,7 +162,7 @@ public:
             Vbid vbid,
             const DocKey start_key,
             uint32_t count,
-            std::shared_ptr<Callback<const DocKey&>> cb) override {
+            std::shared_ptr<StatusCallback<const DocKey&>> cb) override {
         // TODO 2018-10-9 need to implement
         return ENGINE_SUCCESS;
     }
@@ -226,8 +220,9 @@ private:
     // Thus, we put an entry in this vector at position `vbid` when we `openDB`
     // for a VBucket for the first time. Then, further calls to `openDB(vbid)`
     // return the pointer stored in this vector. An entry is removed only when
-    // `delVBucket(vbid)`.
-    std::vector<std::unique_ptr<KVMagma>> vbDB;
+    // `delVBucket(vbid)`; callers share ownership, so a concurrent
+    // `delVBucket` does not destroy an instance which is still in use.
+    std::vector<std::shared_ptr<KVMagma>> vbDB;
 
     /*
      * This function returns an instance of `KVMagma` for the given `vbid`.
@@ -235,7 +230,7 @@ private:
      *
      * @param vbid vbucket id for the vbucket DB to open
      */
-    const KVMagma& openDB(Vbid vbid);
+    std::shared_ptr<KVMagma> openDB(Vbid vbid);
 
     /*
      * The DB for each VBucket is created in a separated subfolder of
@@ -263,8 +258,22 @@ private:
                           const std::string& value,
                           GetMetaOnly getMetaOnly = GetMetaOnly::No);
 
+    /**
+     * Look up a document, recording the read stats.
+     *
+     * @return the document, or a GetValue with status ENGINE_KEY_ENOENT if
+     *         the key has no document
+     */
+    GetValue fetchDoc(const KVMagma& db,
+                      const DocKey& key,
+                      Vbid vb,
+                      GetMetaOnly getMetaOnly);
+
     void readVBState(const KVMagma& db);
 
+    /// @returns the JSON local document the vbucket_state is persisted as.
+    std::string encodeVBState(const vbucket_state& vbState);
+
     int saveDocs(Vbid vbid,
                  Collections::VB::Flush& collectionsFlush,
                  const std::vector<std::unique_ptr<MagmaRequest>>& commitBatch);
@@ -0,0 +1,141 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "memory_arbiter.h"
+
+#include "bucket_logger.h"
+#include "ep_engine.h"
+#include "kv_bucket.h"
+#include "objectregistry.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr double MemoryArbiter::LendFraction;
+constexpr std::chrono::milliseconds MemoryArbiter::MinInterval;
+
+MemoryArbiter& MemoryArbiter::get() {
+    static MemoryArbiter arbiter;
+    return arbiter;
+}
+
+std::vector<size_t> MemoryArbiter::computeQuotas(
+        const std::vector<Usage>& usage) {
+    std::vector<double> spare(usage.size());
+    std::vector<double> need(usage.size());
+    double pool = 0;
+    double demand = 0;
+    for (size_t ii = 0; ii < usage.size(); ++ii) {
+        const auto& u = usage[ii];
+        const double low = u.baseQuota * u.lowWatPercent;
+        if (u.used < low) {
+            spare[ii] = (low - u.used) * LendFraction;
+            pool += spare[ii];
+        } else if (u.lowWatPercent > 0) {
+            // The quota which would put the usage at the low watermark
+            need[ii] = std::max(0.0, u.used / u.lowWatPercent - u.baseQuota);
+            demand += need[ii];
+        }
+    }
+
+    // Only lend as much as is needed, and only grant as much as is lent.
+    const double lendShare = pool > demand ? demand / pool : 1.0;
+    const double grantShare = demand > pool ? pool / demand : 1.0;
+
+    std::vector<size_t> quotas;
+    quotas.reserve(usage.size());
+    for (size_t ii = 0; ii < usage.size(); ++ii) {
+        quotas.push_back(static_cast<size_t>(
+                std::round(usage[ii].baseQuota - spare[ii] * lendShare +
+                           need[ii] * grantShare)));
+    }
+    return quotas;
+}
+
+void MemoryArbiter::addBucket(KVBucket& bucket) {
+    std::lock_guard<std::mutex> lh(mutex);
+    buckets.push_back(&bucket);
+    EP_LOG_INFO("MemoryArbiter: sharing the memory quota of {} buckets",
+                buckets.size());
+}
+
+void MemoryArbiter::removeBucket(KVBucket& bucket) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto it = std::find(buckets.begin(), buckets.end(), &bucket);
+    if (it == buckets.end()) {
+        return;
+    }
+    buckets.erase(it);
+    // Redistribute what the bucket lent or borrowed.
+    rebalanceLocked();
+}
+
+void MemoryArbiter::rebalance(bool force) {
+    std::lock_guard<std::mutex> lh(mutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (!force && now - lastRebalance < MinInterval) {
+        return;
+    }
+    lastRebalance = now;
+    rebalanceLocked();
+}
+
+void MemoryArbiter::rebalanceLocked() {
+    if (buckets.empty()) {
+        return;
+    }
+
+    // Any memory allocated while looking at (or updating) a bucket is
+    // accounted to that bucket.
+    auto* callingEngine = ObjectRegistry::onSwitchThread(nullptr, true);
+
+    std::vector<Usage> usage;
+    usage.reserve(buckets.size());
+    for (auto* bucket : buckets) {
+        auto& engine = bucket->getEPEngine();
+        ObjectRegistry::onSwitchThread(&engine);
+        const auto& stats = engine.getEpStats();
+        usage.push_back({engine.getConfiguration().getMaxSize(),
+                         stats.getEstimatedTotalMemoryUsed(),
+                         stats.mem_low_wat_percent.load()});
+    }
+
+    const auto quotas = computeQuotas(usage);
+    for (size_t ii = 0; ii < buckets.size(); ++ii) {
+        auto& engine = buckets[ii]->getEPEngine();
+        ObjectRegistry::onSwitchThread(&engine);
+        const auto& stats = engine.getEpStats();
+        if (quotas[ii] == stats.getMaxDataSize()) {
+            continue;
+        }
+        EP_LOG_DEBUG(
+                "MemoryArbiter: quota of bucket {} changed from {} to {} "
+                "(configured:{} used:{})",
+                engine.getName(),
+                stats.getMaxDataSize(),
+                quotas[ii],
+                usage[ii].baseQuota,
+                usage[ii].used);
+        buckets[ii]->setMaxDataSize(quotas[ii]);
+        if (usage[ii].used > stats.mem_high_wat) {
+            // Quota reclaimed; evict down to it.
+            buckets[ii]->wakeItemPager();
+        }
+    }
+
+    ObjectRegistry::onSwitchThread(callingEngine);
+}
@@ -0,0 +1,93 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class KVBucket;
+
+/**
+ * Shares the memory quota of the buckets of the process (those with
+ * mem_quota_sharing set) between them.
+ *
+ * Each bucket keeps its configured max_size as its base quota. A bucket using
+ * less than the low watermark of its base quota lends part of the difference;
+ * a bucket using more borrows enough (as far as the lenders allow) for its
+ * usage to be back at the low watermark of its new quota, rather than evict.
+ * The loans are recalculated from the current usage each time, so a lender
+ * whose usage grows reclaims its quota, and the borrowers' item pagers are
+ * woken to evict down to their reduced quotas.
+ *
+ * The rebalance is driven by the item pagers of the sharing buckets; which
+ * run periodically and when a bucket goes over its high watermark.
+ */
+class MemoryArbiter {
+public:
+    /// The memory state of a bucket, as considered by computeQuotas()
+    struct Usage {
+        /// The configured quota (max_size)
+        size_t baseQuota;
+        /// The memory used
+        size_t used;
+        /// The low watermark, as a fraction of the quota
+        double lowWatPercent;
+    };
+
+    /// Fraction of its spare quota (below its low watermark) a bucket lends,
+    /// leaving it room to grow before it needs its quota back.
+    static constexpr double LendFraction = 0.5;
+
+    /// The least time between (non forced) rebalances.
+    static constexpr std::chrono::milliseconds MinInterval{1000};
+
+    static MemoryArbiter& get();
+
+    /**
+     * Calculate the quota of each of the given buckets.
+     *
+     * @return the quota of each bucket, in the same order
+     */
+    static std::vector<size_t> computeQuotas(const std::vector<Usage>& usage);
+
+    /// Start sharing the quota of the bucket.
+    void addBucket(KVBucket& bucket);
+
+    /// Stop sharing the quota of the bucket; it returns (and gets back) any
+    /// quota it borrowed (lent).
+    void removeBucket(KVBucket& bucket);
+
+    /**
+     * Recalculate the quotas of the sharing buckets and apply them.
+     *
+     * @param force rebalance even if the last one was less than MinInterval
+     *        ago
+     */
+    void rebalance(bool force = false);
+
+protected:
+    /// Must hold mutex
+    void rebalanceLocked();
+
+    std::mutex mutex;
+    std::vector<KVBucket*> buckets;
+    std::chrono::steady_clock::time_point lastRebalance;
+};
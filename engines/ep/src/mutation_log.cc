@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <fcntl.h>
+#include <iterator>
 #include <platform/strerror.h>
 #include <string>
 #include <sys/stat.h>
@@ -1010,16 +1011,18 @@ bool MutationLogHarvester::load() {
         switch (le->type()) {
         case MutationLogType::New:
             if (vbid_set.find(le->vbucket()) != vbid_set.end()) {
-                loading[le->vbucket()].emplace(le->key());
+                loading[le->vbucket()].emplace_back(le->key());
             }
             break;
         case MutationLogType::Commit2:
             clean = true;
 
             for (auto vb : vbid_set) {
-                for (auto& item : loading[vb]) {
-                    committed[vb].emplace(item);
-                }
+                auto& keys = loading[vb];
+                auto& dest = committed[vb];
+                dest.insert(dest.end(),
+                            std::make_move_iterator(keys.begin()),
+                            std::make_move_iterator(keys.end()));
             }
             loading.clear();
             break;
@@ -1034,6 +1037,7 @@ bool MutationLogHarvester::load() {
                     to_string(le->type()));
         }
     }
+    sortCommitted();
     return clean;
 }
 
@@ -1052,7 +1056,7 @@ MutationLog::iterator MutationLogHarvester::loadBatch(
         switch (le->type()) {
         case MutationLogType::New:
             if (vbid_set.find(le->vbucket()) != vbid_set.end()) {
-                committed[le->vbucket()].emplace(le->key());
+                committed[le->vbucket()].emplace_back(le->key());
                 count++;
             }
             break;
@@ -1067,9 +1071,18 @@ MutationLog::iterator MutationLogHarvester::loadBatch(
         }
         }
     }
+    sortCommitted();
     return it;
 }
 
+void MutationLogHarvester::sortCommitted() {
+    for (auto& entry : committed) {
+        auto& keys = entry.second;
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    }
+}
+
 void MutationLogHarvester::apply(void *arg, mlCallback mlc) {
     for (const auto vb : vbid_set) {
         for (const auto& key : committed[vb]) {
@@ -1092,15 +1105,18 @@ void MutationLogHarvester::apply(void *arg, mlCallbackWithQueue mlc) {
         }
 
         // Remove any items which are no longer valid in the VBucket.
-        for (auto it = committed[vb].begin(); it != committed[vb].end(); ) {
-            if ((vbucket->ht
-                         .findForRead(*it, TrackReference::No, WantsDeleted::No)
-                         .storedValue == nullptr)) {
-                it = committed[vb].erase(it);
-            } else {
-                ++it;
-            }
-        }
+        auto& keys = committed[vb];
+        keys.erase(std::remove_if(keys.begin(),
+                                  keys.end(),
+                                  [&vbucket](const StoredDocKey& key) {
+                                      return vbucket->ht
+                                                     .findForRead(
+                                                             key,
+                                                             TrackReference::No,
+                                                             WantsDeleted::No)
+                                                     .storedValue == nullptr;
+                                  }),
+                   keys.end());
 
         if (committed[vb].empty()) {
             // No valid items for this vBucket; move to next.
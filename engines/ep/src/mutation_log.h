@@ -493,7 +493,7 @@ typedef std::pair<uint64_t, uint8_t> mutation_log_event_t;
  */
 typedef bool (*mlCallback)(void*, Vbid, const DocKey&);
 typedef bool (*mlCallbackWithQueue)(Vbid,
-                                    const std::set<StoredDocKey>&,
+                                    const std::vector<StoredDocKey>&,
                                     void* arg);
 
 /**
@@ -567,11 +567,17 @@ public:
 
 private:
 
+    /// Sort the committed keys of each vBucket, removing duplicates.
+    void sortCommitted();
+
     MutationLog &mlog;
     EventuallyPersistentEngine *engine;
     std::set<Vbid> vbid_set;
 
-    std::unordered_map<Vbid, std::set<StoredDocKey>> committed;
-    std::unordered_map<Vbid, std::set<StoredDocKey>> loading;
+    // Keys are gathered in vectors (sorted and de-duplicated once a batch is
+    // loaded) rather than sets: the access log of a large bucket can hold
+    // millions of keys, and a set costs a node allocation per key.
+    std::unordered_map<Vbid, std::vector<StoredDocKey>> committed;
+    std::unordered_map<Vbid, std::vector<StoredDocKey>> loading;
     size_t itemsSeen[int(MutationLogType::NumberOfTypes)];
 };
@@ -0,0 +1,101 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "negative_key_cache.h"
+
+#include <algorithm>
+
+static bool keysEqual(const DocKey& lhs, const DocKey& rhs) {
+    const auto lhsIdAndKey = lhs.getIdAndKey();
+    const auto rhsIdAndKey = rhs.getIdAndKey();
+    return lhsIdAndKey.first == rhsIdAndKey.first &&
+           lhsIdAndKey.second.size() == rhsIdAndKey.second.size() &&
+           std::equal(lhsIdAndKey.second.begin(),
+                      lhsIdAndKey.second.end(),
+                      rhsIdAndKey.second.begin());
+}
+
+void NegativeKeyCache::insert(const DocKey& key, rel_time_t expiry) {
+    const auto hash = key.hash();
+    std::lock_guard<std::mutex> lh(mutex);
+    auto* entry = find(key, hash);
+    if (!entry) {
+        // Use a free entry if there is one, otherwise replace the oldest.
+        for (size_t ii = 0; ii < Capacity && entries[next].used; ++ii) {
+            next = (next + 1) % Capacity;
+        }
+        entry = &entries[next];
+        next = (next + 1) % Capacity;
+        if (!entry->used) {
+            entry->used = true;
+            numEntries.fetch_add(1, std::memory_order_relaxed);
+        }
+        entry->key = StoredDocKey(key);
+        entry->hash = hash;
+    }
+    entry->expiry = expiry;
+}
+
+bool NegativeKeyCache::contains(const DocKey& key, rel_time_t now) {
+    if (numEntries.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lh(mutex);
+    auto* entry = find(key, key.hash());
+    if (!entry) {
+        return false;
+    }
+    if (entry->expiry <= now) {
+        unlocked_release(*entry);
+        return false;
+    }
+    ++hits;
+    return true;
+}
+
+void NegativeKeyCache::clear() {
+    std::lock_guard<std::mutex> lh(mutex);
+    for (auto& entry : entries) {
+        if (entry.used) {
+            unlocked_release(entry);
+        }
+    }
+}
+
+void NegativeKeyCache::eraseSlow(const DocKey& key) {
+    const auto hash = key.hash();
+    std::lock_guard<std::mutex> lh(mutex);
+    auto* entry = find(key, hash);
+    if (entry) {
+        unlocked_release(*entry);
+    }
+}
+
+NegativeKeyCache::Entry* NegativeKeyCache::find(const DocKey& key,
+                                                uint32_t hash) {
+    for (auto& entry : entries) {
+        if (entry.used && entry.hash == hash && keysEqual(entry.key, key)) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void NegativeKeyCache::unlocked_release(Entry& entry) {
+    entry.used = false;
+    entry.key = StoredDocKey();
+    numEntries.fetch_sub(1, std::memory_order_relaxed);
+}
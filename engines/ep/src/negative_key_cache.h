@@ -0,0 +1,100 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "storeddockey.h"
+
+#include <memcached/types.h>
+#include <relaxed_atomic.h>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+/**
+ * Small cache of the keys of one HashTable which a background fetch found
+ * recently to have no live (non-deleted) document on disk. This lets
+ * repeated reads of such keys be answered without a StoredValue for them
+ * (a temporary non-existent item) having to remain in the HashTable, or
+ * another fetch.
+ *
+ * Entries expire after the TTL given when they were inserted, or are
+ * replaced (oldest first) once the cache is full. A key must be erased
+ * when a StoredValue is created for it, which the HashTable does; so
+ * insert(), erase() and contains() for a key must be called while holding
+ * the key's HashBucketLock. The cache itself is protected by its own mutex,
+ * which isn't touched while the cache is empty.
+ */
+class NegativeKeyCache {
+public:
+    /// Maximum number of keys cached.
+    static constexpr size_t Capacity = 32;
+
+    /**
+     * Record that the given key has no live document on disk.
+     * @param expiry when the entry expires
+     */
+    void insert(const DocKey& key, rel_time_t expiry);
+
+    /// Forget the given key (it may now have a document).
+    void erase(const DocKey& key) {
+        if (numEntries.load(std::memory_order_relaxed) != 0) {
+            eraseSlow(key);
+        }
+    }
+
+    /**
+     * @param now the current time
+     * @return true if the key is known to have no live document on disk.
+     */
+    bool contains(const DocKey& key, rel_time_t now);
+
+    /// Forget all keys.
+    void clear();
+
+    /// @return the number of (possibly expired) entries
+    size_t size() const {
+        return numEntries.load(std::memory_order_relaxed);
+    }
+
+    size_t getHits() const {
+        return hits;
+    }
+
+private:
+    struct Entry {
+        StoredDocKey key;
+        uint32_t hash = 0;
+        rel_time_t expiry = 0;
+        bool used = false;
+    };
+
+    void eraseSlow(const DocKey& key);
+
+    /// @return the used entry for the key, or nullptr. mutex must be held.
+    Entry* find(const DocKey& key, uint32_t hash);
+
+    void unlocked_release(Entry& entry);
+
+    std::mutex mutex;
+    std::array<Entry, Capacity> entries;
+    /// Next entry to replace when the cache is full.
+    size_t next = 0;
+    /// Number of used entries; only modified with mutex held.
+    std::atomic<size_t> numEntries{0};
+    Couchbase::RelaxedAtomic<size_t> hits{0};
+};
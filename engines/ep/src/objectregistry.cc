@@ -35,6 +35,21 @@ extern "C" {
 }
 
 static get_allocation_size getAllocSize = defaultGetAllocSize;
+static set_thread_arena setThreadArena = nullptr;
+
+/// The allocator arena the calling thread is bound to (0 is the default).
+static thread_local unsigned threadArena = 0;
+
+/**
+ * Bind the calling thread to the allocator arena of the engine (or the
+ * default arena if the engine doesn't have one), if it isn't already.
+ */
+static void bindArena(EventuallyPersistentEngine* engine) {
+    const unsigned arena = engine ? engine->getEpStats().getMemoryArena() : 0;
+    if (arena != threadArena && setThreadArena && setThreadArena(arena)) {
+        threadArena = arena;
+    }
+}
 
 
 
@@ -69,12 +84,15 @@ static bool verifyEngine(EventuallyPersistentEngine *engine)
    return true;
 }
 
-void ObjectRegistry::initialize(get_allocation_size func) {
+void ObjectRegistry::initialize(get_allocation_size func,
+                                set_thread_arena arenaFunc) {
     getAllocSize = func;
+    setThreadArena = arenaFunc;
 }
 
 void ObjectRegistry::reset() {
     getAllocSize = defaultGetAllocSize;
+    setThreadArena = nullptr;
 }
 
 void ObjectRegistry::onCreateBlob(const Blob *blob)
@@ -176,6 +194,11 @@ EventuallyPersistentEngine *ObjectRegistry::getCurrentEngine() {
     return th->get();
 }
 
+ItemPool* ObjectRegistry::getItemPool() {
+    EventuallyPersistentEngine* engine = th->get();
+    return engine ? &engine->getItemPool() : nullptr;
+}
+
 EventuallyPersistentEngine *ObjectRegistry::onSwitchThread(
                                             EventuallyPersistentEngine *engine,
                                             bool want_old_thread_local) {
@@ -186,6 +209,7 @@ EventuallyPersistentEngine *ObjectRegistry::onSwitchThread(
     }
 
     th->set(engine);
+    bindArena(engine);
     return old_engine;
 }
 
@@ -202,6 +226,10 @@ bool ObjectRegistry::memoryAllocated(size_t mem) {
         return false;
     }
     EPStats &stats = engine->getEpStats();
+    if (stats.getMemoryArena()) {
+        // Memory used is read from the engine's arena instead.
+        return true;
+    }
     stats.memAllocated(mem);
     return true;
 }
@@ -215,6 +243,10 @@ bool ObjectRegistry::memoryDeallocated(size_t mem) {
         return false;
     }
     EPStats &stats = engine->getEpStats();
+    if (stats.getMemoryArena()) {
+        // Memory used is read from the engine's arena instead.
+        return true;
+    }
     stats.memDeallocated(mem);
     return true;
 }
@@ -222,10 +254,12 @@ bool ObjectRegistry::memoryDeallocated(size_t mem) {
 NonBucketAllocationGuard::NonBucketAllocationGuard() {
     engine = th->get();
     th->set(nullptr);
+    bindArena(nullptr);
 }
 
 NonBucketAllocationGuard::~NonBucketAllocationGuard() {
     th->set(engine);
+    bindArena(engine);
 }
 
 #endif
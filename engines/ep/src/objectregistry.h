@@ -23,17 +23,25 @@
 class EventuallyPersistentEngine;
 class Blob;
 class Item;
+class ItemPool;
 class StoredValue;
 
 extern "C" {
     typedef size_t (*get_allocation_size)(const void *ptr);
+    typedef bool (*set_thread_arena)(unsigned arena);
 }
 
 class StoredValue;
 
 class ObjectRegistry {
 public:
-    static void initialize(get_allocation_size func);
+    /**
+     * @param func used to find the size of allocations
+     * @param arenaFunc used to bind threads to the allocator arena of the
+     *        engine they switch to (for engines which have one)
+     */
+    static void initialize(get_allocation_size func,
+                           set_thread_arena arenaFunc = nullptr);
 
     /**
      * Resets the ObjectRegistry back to initial state (before initialize()
@@ -53,6 +61,9 @@ public:
 
     static EventuallyPersistentEngine *getCurrentEngine();
 
+    /// @return the ItemPool of the current engine, nullptr if none.
+    static ItemPool* getItemPool();
+
     static EventuallyPersistentEngine *onSwitchThread(EventuallyPersistentEngine *engine,
                                                       bool want_old_thread_local = false);
 
@@ -22,6 +22,7 @@
 #include "dcp/dcpconnmap.h"
 #include "ep_engine.h"
 #include "ep_time.h"
+#include "expiry_index.h"
 #include "executorpool.h"
 #include "item_eviction.h"
 #include "kv_bucket.h"
@@ -33,13 +34,70 @@
 #include <limits>
 #include <list>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <phosphor/phosphor.h>
+#include <platform/compress.h>
 #include <memory>
 
 static const size_t MAX_PERSISTENCE_QUEUE_SIZE = 1000000;
 
+/**
+ * Finds the coldest item eligible for eviction in the hash buckets it
+ * visits: the one with the lowest frequency counter, and of those the
+ * oldest (lowest CAS). Items of collections over their memory quota are
+ * preferred to all others.
+ *
+ * As a full pager pass does, eligible items visited have their frequency
+ * counter decayed, so items which are no longer accessed become candidates
+ * over time.
+ */
+class EvictionSampler : public HashTableVisitor {
+public:
+    EvictionSampler(
+            VBucket& vb,
+            const std::unordered_map<CollectionID, size_t>& overQuota)
+        : vb(vb), overQuota(overQuota) {
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
+        if (!vb.eligibleToPageOut(lh, v)) {
+            return true;
+        }
+        vb.ht.applyFreqDecay(v);
+        const auto freq = v.getFreqCounterValue();
+        const bool isOverQuota =
+                !overQuota.empty() &&
+                overQuota.count(v.getKey().getCollectionID()) > 0;
+        if (!found || (isOverQuota && !foundOverQuota) ||
+            (isOverQuota == foundOverQuota &&
+             (freq < freqCounter ||
+              (freq == freqCounter && v.getCas() < cas)))) {
+            found = true;
+            foundOverQuota = isOverQuota;
+            key = StoredDocKey(v.getKey());
+            freqCounter = freq;
+            cas = v.getCas();
+            valueSize = v.valuelen();
+        }
+        if (freq > 0) {
+            v.setFreqCounterValue(freq - 1);
+        }
+        return true;
+    }
+
+    VBucket& vb;
+    const std::unordered_map<CollectionID, size_t>& overQuota;
+    bool found = false;
+    bool foundOverQuota = false;
+    StoredDocKey key;
+    uint8_t freqCounter = 0;
+    uint64_t cas = 0;
+    size_t valueSize = 0;
+};
+
 PagingVisitor::PagingVisitor(KVBucket& s,
                              EPStats& st,
                              double pcnt,
@@ -86,11 +144,40 @@ bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
         return true;
     }
 
+    if (indexing && !v.isDeleted() && !v.isTempItem()) {
+        indexing->add(v.getKey(), v.getExptime());
+    }
+
     // return if not ItemPager, which uses valid eviction percentage
     if (percent <= 0 || !pager_phase) {
         return true;
     }
 
+    if (ejectingReplica) {
+        // Replica values are only read after a failover; eject them all,
+        // however hot, keeping the metadata for a fast promotion.
+        StoredValue* vptr = &v;
+        if (v.eligibleForEviction(VALUE_ONLY) &&
+            currentBucket->ht.unlocked_ejectItem(lh, vptr, VALUE_ONLY)) {
+            ++ejected;
+        }
+        return true;
+    }
+
+    // Items of collections over their memory quota go first, however hot.
+    if (!collectionsOverQuota.empty()) {
+        const auto collection = v.getKey().getCollectionID();
+        if (collectionsOverQuota.count(collection) > 0) {
+            // Only the value is certain to be freed; with full eviction the
+            // whole StoredValue is.
+            const size_t freed = v.valuelen();
+            if (doEviction(lh, &v)) {
+                chargeOverQuota(collection, freed);
+                return true;
+            }
+        }
+    }
+
     switch (evictionPolicy) {
     case EvictionPolicy::lru2Bit: {
         // always evict unreferenced items, or randomly evict referenced
@@ -115,6 +202,7 @@ bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
          * doEviction can modify the value, and when we want to
          * add it to the histogram we want to use the original value.
          */
+        currentBucket->ht.applyFreqDecay(v);
         auto storedValueFreqCounter = v.getFreqCounterValue();
         bool evicted = true;
 
@@ -218,9 +306,22 @@ void PagingVisitor::visitBucket(VBucketPtr& vb) {
     if (percent <= 0 || !pager_phase) {
         if (vBucketFilter(vb->getId())) {
             currentBucket = vb;
+            auto* index =
+                    owner == EXPIRY_PAGER ? vb->getExpiryIndex() : nullptr;
+            if (index && index->isComplete()) {
+                if (vb->getState() == vbucket_state_active) {
+                    visitExpired(*vb, *index);
+                }
+                return;
+            }
             // EvictionPolicy is not required when running expiry item
-            // pager
+            // pager. A full visit fills in the expiry index as it goes.
+            indexing = index;
             vb->ht.visit(*this);
+            indexing = nullptr;
+            if (index) {
+                index->setComplete(true);
+            }
         }
         return;
     }
@@ -234,7 +335,7 @@ void PagingVisitor::visitBucket(VBucketPtr& vb) {
         return;
     }
 
-    if (current > lower) {
+    if (current > lower && !(group && group->belowLowWaterMark)) {
         double p = (current - static_cast<double>(lower)) / current;
         adjustPercent(p, vb->getState());
         if (vBucketFilter(vb->getId())) {
@@ -243,6 +344,23 @@ void PagingVisitor::visitBucket(VBucketPtr& vb) {
             itemEviction.reset();
             freqCounterThreshold = 0;
 
+            evictOverQuota(*vb);
+
+            ejectingReplica = ejectReplicaValues &&
+                              vb->getState() == vbucket_state_replica;
+            if (ejectingReplica) {
+                vb->ht.visit(*this);
+                ejectingReplica = false;
+                removeClosedUnrefCheckpoints(vb);
+                return;
+            }
+
+            if (evictionPolicy == EvictionPolicy::hifi_mfu && sampleSize > 0) {
+                evictSampled(*vb);
+                removeClosedUnrefCheckpoints(vb);
+                return;
+            }
+
             if (evictionPolicy == EvictionPolicy::hifi_mfu) {
                 // Percent of items in the hash table to be visited
                 // between updating the interval.
@@ -289,6 +407,114 @@ void PagingVisitor::visitBucket(VBucketPtr& vb) {
 
     } else { // stop eviction whenever memory usage is below low watermark
         isBelowLowWaterMark = true;
+        if (group) {
+            group->belowLowWaterMark = true;
+        }
+    }
+}
+
+std::function<bool(const Vbid&, const Vbid&)>
+PagingVisitor::getVBucketComparator() const {
+    if (!ejectReplicaValues) {
+        return {};
+    }
+    auto isReplica = std::make_shared<std::vector<bool>>(
+            store.getVBuckets().getSize());
+    for (auto vbid : store.getVBucketsInState(vbucket_state_replica)) {
+        (*isReplica)[vbid.get()] = true;
+    }
+    return [isReplica](const Vbid& a, const Vbid& b) {
+        return (*isReplica)[a.get()] && !(*isReplica)[b.get()];
+    };
+}
+
+void PagingVisitor::evictSampled(VBucket& vb) {
+    const auto target = static_cast<size_t>(
+            std::ceil(vb.ht.getNumInMemoryItems() * percent));
+    // Bound the work if few of the sampled items can be evicted.
+    const size_t maxAttempts = target * 2;
+    // How often to check whether we've got below the low watermark.
+    const size_t memoryCheckInterval = 1000;
+
+    auto& frequencyValuesEvictedHisto =
+            ((vb.getState() == vbucket_state_active) ||
+             (vb.getState() == vbucket_state_pending))
+                    ? stats.activeOrPendingFrequencyValuesEvictedHisto
+                    : stats.replicaFrequencyValuesEvictedHisto;
+
+    size_t evicted = 0;
+    for (size_t attempt = 1; evicted < target && attempt <= maxAttempts;
+         ++attempt) {
+        EvictionSampler sampler(vb, collectionsOverQuota);
+        for (size_t ii = 0; ii < sampleSize; ++ii) {
+            vb.ht.visitRandomBucket(std::rand(), sampler);
+        }
+        if (sampler.found) {
+            // The item may have changed since it was sampled; doEviction
+            // (pageOut) re-checks it is still eligible.
+            setUpHashBucketVisit();
+            {
+                auto res = vb.ht.findForWrite(sampler.key, WantsDeleted::No);
+                if (res.storedValue && doEviction(res.lock, res.storedValue)) {
+                    ++evicted;
+                    frequencyValuesEvictedHisto.addValue(sampler.freqCounter);
+                    if (sampler.foundOverQuota) {
+                        chargeOverQuota(sampler.key.getCollectionID(),
+                                        sampler.valueSize);
+                    }
+                }
+            }
+            tearDownHashBucketVisit();
+        }
+
+        if (attempt % memoryCheckInterval == 0 &&
+            stats.getEstimatedTotalMemoryUsed() <= stats.mem_low_wat) {
+            isBelowLowWaterMark = true;
+            break;
+        }
+    }
+}
+
+void PagingVisitor::evictOverQuota(VBucket& vb) {
+    if (collectionsOverQuota.empty() || !vb.ht.isCollectionIndexed()) {
+        return;
+    }
+
+    // chargeOverQuota() removes collections once their excess is freed.
+    std::vector<CollectionID> collections;
+    for (const auto& entry : collectionsOverQuota) {
+        collections.push_back(entry.first);
+    }
+
+    for (const auto collection : collections) {
+        for (const auto& key : vb.ht.getCollectionKeys(collection)) {
+            if (collectionsOverQuota.count(collection) == 0) {
+                break;
+            }
+            setUpHashBucketVisit();
+            {
+                auto res = vb.ht.findForWrite(key, WantsDeleted::No);
+                if (res.storedValue) {
+                    const size_t freed = res.storedValue->valuelen();
+                    if (doEviction(res.lock, res.storedValue)) {
+                        chargeOverQuota(collection, freed);
+                    }
+                }
+            }
+            tearDownHashBucketVisit();
+        }
+    }
+}
+
+void PagingVisitor::chargeOverQuota(CollectionID collection, size_t freed) {
+    auto itr = collectionsOverQuota.find(collection);
+    if (itr == collectionsOverQuota.end()) {
+        return;
+    }
+    if (freed >= itr->second) {
+        collectionsOverQuota.erase(itr);
+    } else {
+        itr->second -= freed;
     }
 }
 
@@ -324,6 +550,23 @@ void PagingVisitor::complete() {
         stats.expiryPagerHisto.add(elapsed_time);
     }
 
+    // Wake up any sleeping backfill tasks if the memory usage is lowered
+    // below the high watermark as a result of checkpoint removal.
+    if (wasHighMemoryUsage && !store.isMemoryUsageTooHigh()) {
+        store.getEPEngine().getDcpConnMap().notifyBackfillManagerTasks();
+    }
+
+    if (group) {
+        if (isBelowLowWaterMark) {
+            group->belowLowWaterMark = true;
+        }
+        // The rest of the run is finished by its last visitor.
+        if (--group->running > 0) {
+            return;
+        }
+        isBelowLowWaterMark = group->belowLowWaterMark;
+    }
+
     bool inverse = false;
     (*stateFinalizer).compare_exchange_strong(inverse, true);
 
@@ -339,12 +582,6 @@ void PagingVisitor::complete() {
         }
     }
 
-    // Wake up any sleeping backfill tasks if the memory usage is lowered
-    // below the high watermark as a result of checkpoint removal.
-    if (wasHighMemoryUsage && !store.isMemoryUsageTooHigh()) {
-        store.getEPEngine().getDcpConnMap().notifyBackfillManagerTasks();
-    }
-
     if (ITEM_PAGER == owner) {
         // Re-check memory which may wake up the ItemPager and schedule
         // a new PagingVisitor with the next phase/memory target etc...
@@ -384,6 +621,14 @@ void PagingVisitor::adjustPercent(double prob, vbucket_state_t state) {
 
 bool PagingVisitor::doEviction(const HashTable::HashBucketLock& lh,
                                StoredValue* v) {
+    if (compressBeforeEject && compressValue(lh, *v)) {
+        // Freed memory without ejecting; count it as an eviction.
+        return true;
+    }
+    if (valueTier && moveToTier(lh, *v)) {
+        return true;
+    }
+
     item_eviction_policy_t policy = store.getItemEvictionPolicy();
     StoredDocKey key(v->getKey());
 
@@ -404,6 +649,70 @@ bool PagingVisitor::doEviction(const HashTable::HashBucketLock& lh,
     return false;
 }
 
+bool PagingVisitor::compressValue(const HashTable::HashBucketLock& lh,
+                                  StoredValue& v) {
+    if (!v.isResident() || !v.isCompressible() ||
+        !currentBucket->eligibleToPageOut(lh, v)) {
+        return false;
+    }
+
+    auto& compressibility = store.getCompressibility();
+    const auto cid = v.getKey().getCollectionID();
+    if (!compressibility.shouldAttempt(cid)) {
+        // The collection's documents don't compress; just evict it.
+        return false;
+    }
+
+    const bool compress =
+            cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                     {v.getValue()->getData(), v.valuelen()},
+                                     deflated) &&
+            static_cast<float>(v.valuelen()) /
+                            static_cast<float>(deflated.size()) >=
+                    minCompressionRatio;
+    compressibility.recordAttempt(cid, compress);
+    if (compress) {
+        currentBucket->ht.storeCompressedBuffer(lh, deflated, v);
+        ++stats.numPagerCompressions;
+        return true;
+    }
+
+    // Not worth compressing; don't try again on later passes.
+    v.setUncompressible();
+    return false;
+}
+
+bool PagingVisitor::moveToTier(const HashTable::HashBucketLock& lh,
+                               StoredValue& v) {
+    if (!v.isResident() || v.hasInlineValue() || !v.getValue() ||
+        v.getValue()->isTiered() ||
+        v.getValue()->valueSize() > ValueTier::MaxAllocation ||
+        !currentBucket->eligibleToPageOut(lh, v)) {
+        return false;
+    }
+    if (currentBucket->ht.unlocked_moveToTier(lh, v, *valueTier)) {
+        ++stats.numValueTierMoves;
+        return true;
+    }
+    return false;
+}
+
+void PagingVisitor::visitExpired(VBucket& vb, ExpiryIndex& index) {
+    for (const auto& key : index.takeExpired(startTime)) {
+        auto hbl = vb.ht.getLockedBucket(key);
+        auto* v = vb.ht.unlocked_find(key,
+                                      hbl.getBucketNum(),
+                                      WantsDeleted::No,
+                                      TrackReference::No);
+        // The index only holds hints; the item may have been deleted,
+        // evicted or stored again with a later expiry time (in which case
+        // it was added to the index again).
+        if (v && v->isExpired(startTime)) {
+            visit(hbl, *v);
+        }
+    }
+}
+
 void PagingVisitor::setUpHashBucketVisit() {
     // Grab a locked ReadHandle
     readHandle = currentBucket->lockCollections();
@@ -26,9 +26,11 @@
 
 #include <atomic>
 #include <list>
+#include <unordered_map>
 
 class EPStats;
 class EventuallyPersistentEngine;
+class ExpiryIndex;
 class KVBucket;
 class StoredValue;
 
@@ -45,6 +47,20 @@ public:
         hifi_mfu // The new hifi_mfu policy
     };
 
+    /**
+     * State shared by the PagingVisitors of one ItemPager run which has been
+     * split over several tasks, each visiting a share of the vBuckets.
+     */
+    struct Group {
+        explicit Group(size_t visitors) : running(visitors) {
+        }
+        /// Visitors of the run which have yet to complete.
+        std::atomic<size_t> running;
+        /// Set once any visitor finds memory below the low watermark, which
+        /// stops the others at their next vBucket.
+        std::atomic<bool> belowLowWaterMark{false};
+    };
+
     /**
      * Construct a PagingVisitor that will attempt to evict the given
      * percentage of objects.
@@ -105,6 +121,68 @@ public:
         return ejected;
     }
 
+    /**
+     * With the hifi_mfu policy, evict from each vBucket by sampling instead
+     * of visiting its whole HashTable: each eviction picks the coldest of
+     * the items in sampleSize random hash buckets. 0 (the default) visits
+     * the whole table.
+     */
+    void setSampleSize(size_t size) {
+        sampleSize = size;
+    }
+
+    /**
+     * Evict the items of the given collections (mapped to the number of
+     * bytes each is over its memory quota) ahead of any others, regardless
+     * of their frequency counters, until that many bytes have been freed.
+     */
+    void setCollectionsOverQuota(
+            std::unordered_map<CollectionID, size_t> overQuota) {
+        collectionsOverQuota = std::move(overQuota);
+    }
+
+    /**
+     * Compress a resident, uncompressed value in memory instead of ejecting
+     * it, if it compresses by at least minCompressionRatio. A value which is
+     * already compressed (or doesn't compress well enough) is ejected as
+     * usual, so a cold value is compressed on the first pass which picks it
+     * and ejected on a later one.
+     */
+    void setCompressBeforeEject(float minRatio) {
+        compressBeforeEject = true;
+        minCompressionRatio = minRatio;
+    }
+
+    /**
+     * Move a resident value to the given tier instead of ejecting it, while
+     * the tier has room. A value already in the tier is ejected as usual
+     * when it is next picked.
+     */
+    void setValueTier(ValueTier* tier) {
+        valueTier = tier;
+    }
+
+    /**
+     * Visit the replica vBuckets first, ejecting each of their values
+     * (keeping the metadata) regardless of how recently it was used, before
+     * evicting from any other vBucket. See replica_value_policy.
+     */
+    void setEjectReplicaValues() {
+        ejectReplicaValues = true;
+    }
+
+    std::function<bool(const Vbid&, const Vbid&)> getVBucketComparator()
+            const override;
+
+    /**
+     * Make this visitor one of a group sharing a run. Only the last of the
+     * group to complete finishes the run (marking the pager available again
+     * and moving it to its next phase).
+     */
+    void setGroup(std::shared_ptr<Group> g) {
+        group = std::move(g);
+    }
+
 protected:
     // Protected for testing purposes
     // Holds the data structures used during the selection of documents to
@@ -135,6 +213,29 @@ private:
 
     bool doEviction(const HashTable::HashBucketLock& lh, StoredValue* v);
 
+    /// @return true if the value was compressed in place
+    bool compressValue(const HashTable::HashBucketLock& lh, StoredValue& v);
+
+    /// @return true if the value was moved to the value tier
+    bool moveToTier(const HashTable::HashBucketLock& lh, StoredValue& v);
+
+    /// Evict the current vBucket's share of items by sampling.
+    void evictSampled(VBucket& vb);
+
+    /**
+     * Evict the items of the collections over their memory quota, found
+     * through the HashTable's collection index (if it has one), until the
+     * excess has been freed.
+     */
+    void evictOverQuota(VBucket& vb);
+
+    /// Expire the items the vBucket's (complete) expiry index says have
+    /// expired, instead of visiting the whole HashTable.
+    void visitExpired(VBucket& vb, ExpiryIndex& index);
+
+    /// Deduct freed bytes from a collection's excess over its quota.
+    void chargeOverQuota(CollectionID collection, size_t freed);
+
     std::list<Item> expired;
 
     KVBucket& store;
@@ -171,6 +272,34 @@ private:
     // The policy used to evict items from the hash table.
     EvictionPolicy evictionPolicy;
 
+    // Number of hash buckets sampled per eviction (0 to visit them all).
+    size_t sampleSize = 0;
+
+    // Expiry index being filled in by a full visit of its vBucket, if any.
+    ExpiryIndex* indexing = nullptr;
+
+    // Collections over their memory quota, and by how many bytes.
+    std::unordered_map<CollectionID, size_t> collectionsOverQuota;
+
+    // Compress values before ejecting them; see setCompressBeforeEject().
+    bool compressBeforeEject = false;
+    float minCompressionRatio = 0;
+
+    // Values are compressed into this before being copied into their Blob,
+    // reused for every value compressed.
+    cb::compression::Buffer deflated;
+
+    // The tier to move values to before ejecting them, if any.
+    ValueTier* valueTier = nullptr;
+
+    // Eject the values of replicas first; see setEjectReplicaValues().
+    bool ejectReplicaValues = false;
+    // Set while visiting a replica vBucket with ejectReplicaValues.
+    bool ejectingReplica = false;
+
+    // The group this visitor is part of, if its run is split over several.
+    std::shared_ptr<Group> group;
+
     // The VB::Manifest read handle that we use to lock around HashBucket
     // visits. Will contain a nullptr if we aren't currently locking anything.
     Collections::VB::Manifest::ReadHandle readHandle;
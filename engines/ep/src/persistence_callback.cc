@@ -48,6 +48,9 @@ void PersistenceCallback::callback(TransactionContext& txCtx,
                 // mark this item clean only if current and stored cas
                 // value match
                 v->markClean();
+                if (epCtx.replicaValuePolicy != ReplicaValuePolicy::Resident) {
+                    applyReplicaValuePolicy(epCtx, hbl, *v);
+                }
             }
             if (v->isNewCacheItem()) {
                 if (value.second) {
@@ -138,6 +141,43 @@ void PersistenceCallback::callback(TransactionContext& txCtx, int& value) {
     }
 }
 
+void PersistenceCallback::applyReplicaValuePolicy(
+        EPTransactionContext& epCtx,
+        const HashTable::HashBucketLock& hbl,
+        StoredValue& v) {
+    // Only the value goes; the metadata stays for a fast promotion.
+    if (!v.eligibleForEviction(VALUE_ONLY)) {
+        return;
+    }
+
+    switch (epCtx.replicaValuePolicy) {
+    case ReplicaValuePolicy::Resident:
+        return;
+    case ReplicaValuePolicy::Compress:
+        if (v.isCompressible() &&
+            cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                     {v.getValue()->getData(), v.valuelen()},
+                                     epCtx.deflated)) {
+            const auto ratio = static_cast<float>(v.valuelen()) /
+                               static_cast<float>(epCtx.deflated.size());
+            if (ratio >= epCtx.minCompressionRatio) {
+                epCtx.vbucket.ht.storeCompressedBuffer(hbl, epCtx.deflated, v);
+                ++epCtx.stats.numReplicaPersistCompressions;
+            } else {
+                v.setUncompressible();
+            }
+        }
+        return;
+    case ReplicaValuePolicy::Eject: {
+        StoredValue* vptr = &v;
+        if (epCtx.vbucket.ht.unlocked_ejectItem(hbl, vptr, VALUE_ONLY)) {
+            ++epCtx.stats.numReplicaPersistEjects;
+        }
+        return;
+    }
+    }
+}
+
 void PersistenceCallback::redirty(EPStats& stats, VBucket& vbucket) {
     if (vbucket.isDeletionDeferred()) {
         // updating the member stats for the vbucket is not really necessary
@@ -19,9 +19,12 @@
 #include "config.h"
 
 #include "callbacks.h"
+#include "ep_types.h"
 #include "kvstore.h"
 #include "vbucket.h"
 
+#include <platform/compress.h>
+
 class EPStats;
 
 struct EPTransactionContext : public TransactionContext {
@@ -31,6 +34,13 @@ struct EPTransactionContext : public TransactionContext {
 
     EPStats& stats;
     VBucket& vbucket;
+
+    /// What to do with a value once persisted (for a replica vBucket)
+    ReplicaValuePolicy replicaValuePolicy = ReplicaValuePolicy::Resident;
+    /// The ratio a value must compress by for ReplicaValuePolicy::Compress
+    float minCompressionRatio = 0;
+    /// Values are compressed into this, reused for each item of the flush
+    cb::compression::Buffer deflated;
 };
 
 /**
@@ -61,6 +71,11 @@ public:
 private:
     void redirty(EPStats& stats, VBucket& vbucket);
 
+    /// Apply the replica value policy to the (clean) persisted value
+    void applyReplicaValuePolicy(EPTransactionContext& epCtx,
+                                 const HashTable::HashBucketLock& hbl,
+                                 StoredValue& v);
+
     const queued_item queuedItem;
     uint64_t cas;
     DISALLOW_COPY_AND_ASSIGN(PersistenceCallback);
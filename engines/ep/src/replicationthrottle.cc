@@ -20,10 +20,24 @@
 #include "configuration.h"
 #include "replicationthrottle.h"
 
+#include <algorithm>
+
+/// How often the drain and unshaped rates are sampled.
+static const std::chrono::milliseconds rateSampleInterval{100};
+
+/// Weight of a new sample in the smoothed rates.
+static const double rateSampleWeight = 0.25;
+
+/// How many seconds worth of tokens (at the shaped rate) the bucket holds.
+static const double burstDuration = 0.1;
+
 ReplicationThrottle::ReplicationThrottle(const Configuration& config,
                                          EPStats& s)
     : queueCap(config.getReplicationThrottleQueueCap()),
       capPercent(config.getReplicationThrottleCapPcnt()),
+      rateShaping(config.isReplicationThrottleRateShaping()),
+      minRate(config.getReplicationThrottleMinRate()),
+      shapingBandPercent(config.getReplicationThrottleShapingBandPcnt()),
       stats(s) {
 }
 
@@ -43,9 +57,124 @@ bool ReplicationThrottle::hasSomeMemory() const {
     return memoryUsed <= (maxSize * stats.replicationThrottleThreshold);
 }
 
+bool ReplicationThrottle::isWithinLimits() const {
+    return persistenceQueueSmallEnough() && hasSomeMemory();
+}
+
+double ReplicationThrottle::getHeadroom() const {
+    const double band = static_cast<double>(shapingBandPercent) / 100.0;
+    if (band <= 0) {
+        return 1.0;
+    }
+
+    double headroom = 1.0;
+    const double maxSize = static_cast<double>(stats.getMaxDataSize());
+    if (maxSize > 0) {
+        const double memoryLimit = maxSize * stats.replicationThrottleThreshold;
+        const double memoryUsed =
+                static_cast<double>(stats.getEstimatedTotalMemoryUsed());
+        headroom = std::min(headroom,
+                            (memoryLimit - memoryUsed) / (maxSize * band));
+    }
+
+    const ssize_t writeQueueCap = stats.replicationThrottleWriteQueueCap;
+    if (writeQueueCap > 0) {
+        const double cap = static_cast<double>(writeQueueCap);
+        const double queueSize = static_cast<double>(stats.diskQueueSize);
+        headroom = std::min(headroom, (cap - queueSize) / (cap * band));
+    }
+    return std::max(0.0, headroom);
+}
+
+void ReplicationThrottle::refill(std::lock_guard<std::mutex>&) const {
+    const auto time = now();
+
+    // Sample the rates the write queue drains, and messages are applied at
+    // while not limited.
+    const auto sinceSample = time - lastSample;
+    if (lastSample.time_since_epoch().count() == 0) {
+        // First use; just start sampling from here.
+        lastPersisted = stats.totalPersisted.load();
+        lastSample = time;
+    } else if (sinceSample >= rateSampleInterval) {
+        const double seconds =
+                std::chrono::duration<double>(sinceSample).count();
+        const size_t persisted = stats.totalPersisted.load();
+        const double drained =
+                persisted >= lastPersisted ? persisted - lastPersisted : 0;
+        drainRate += rateSampleWeight * (drained / seconds - drainRate);
+        if (rate == 0) {
+            unshapedRate += rateSampleWeight *
+                            (appliedSinceSample / seconds - unshapedRate);
+        }
+        lastPersisted = persisted;
+        appliedSinceSample = 0;
+        lastSample = time;
+        currentDrainRate = static_cast<size_t>(drainRate);
+    }
+
+    const double headroom = getHeadroom();
+    if (headroom >= 1.0) {
+        // Not limited; start with a full bucket once we are.
+        rate = 0;
+        tokens = 0;
+        lastRefill = time;
+        currentRate = 0;
+        return;
+    }
+
+    // Scale the rate between the unshaped rate (at the edge of the band) and
+    // the drain rate (at the limit), so the limit is approached smoothly.
+    const double floor =
+            std::max(static_cast<double>(minRate), std::max(drainRate, 1.0));
+    const double newRate =
+            floor + std::max(0.0, unshapedRate - floor) * headroom;
+    const double capacity = std::max(1.0, newRate * burstDuration);
+    if (rate == 0) {
+        tokens = capacity;
+    } else {
+        const double seconds =
+                std::chrono::duration<double>(time - lastRefill).count();
+        tokens = std::min(capacity, tokens + seconds * newRate);
+    }
+    rate = newRate;
+    lastRefill = time;
+    currentRate = static_cast<size_t>(rate);
+}
+
+ReplicationThrottle::Status ReplicationThrottle::getShapedStatus() const {
+    if (!rateShaping) {
+        currentRate = 0;
+        return Status::Process;
+    }
+
+    std::lock_guard<std::mutex> lh(shaperMutex);
+    refill(lh);
+    return (rate == 0 || tokens > 0) ? Status::Process : Status::Pause;
+}
+
 ReplicationThrottle::Status ReplicationThrottle::getStatus() const {
-    return (persistenceQueueSmallEnough() && hasSomeMemory()) ? Status::Process
-                                                              : Status::Pause;
+    return isWithinLimits() ? getShapedStatus() : Status::Pause;
+}
+
+void ReplicationThrottle::consume(size_t messages) {
+    if (!rateShaping || messages == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lh(shaperMutex);
+    appliedSinceSample += messages;
+    if (rate != 0) {
+        tokens -= messages;
+    }
+}
+
+size_t ReplicationThrottle::getRate() const {
+    return currentRate;
+}
+
+size_t ReplicationThrottle::getDrainRate() const {
+    return currentDrainRate;
 }
 
 void ReplicationThrottle::adjustWriteQueueCap(size_t totalItems) {
@@ -68,13 +197,14 @@ ReplicationThrottleEphe::ReplicationThrottleEphe(const Configuration& config,
 }
 
 ReplicationThrottle::Status ReplicationThrottleEphe::getStatus() const {
-    ReplicationThrottle::Status status = ReplicationThrottle::getStatus();
-    if (status == Status::Pause) {
+    if (!isWithinLimits()) {
         if (config.getEphemeralFullPolicy() == "fail_new_data") {
             return Status::Disconnect;
         }
+        return Status::Pause;
     }
-    return status;
+    // Being rate limited only delays replication, never disconnects.
+    return getShapedStatus();
 }
 
 bool ReplicationThrottleEphe::doDisconnectOnNoMem() const {
@@ -22,11 +22,23 @@
 
 #include "stats.h"
 
+#include <chrono>
+#include <mutex>
+
 class Configuration;
 
 /**
  * Monitors various internal state to report whether we should
  * throttle incoming tap and DCP items.
+ *
+ * Replication is paused outright once memory usage reaches
+ * replication_throttle_threshold or the disk write queue reaches its cap.
+ * Before that - once within replication_throttle_shaping_band_pcnt of either
+ * limit - the rate replicated messages are applied at is shaped by a token
+ * bucket; the closer to the limit, the closer the rate is brought down to
+ * the rate the disk write queue is drained at (or
+ * replication_throttle_min_rate, if larger). This avoids replication
+ * abruptly stopping and starting as the limits are crossed.
  */
 class ReplicationThrottle {
 public:
@@ -53,18 +65,94 @@ public:
         return false;
     }
 
+    /**
+     * Record that the given number of replicated messages have been applied;
+     * they consume the tokens of the rate shaper.
+     */
+    void consume(size_t messages);
+
+    /**
+     * @return the rate (messages per second) replication is currently shaped
+     *         to, or 0 if it isn't currently limited.
+     */
+    size_t getRate() const;
+
+    /// @return the measured rate (items per second) the write queue drains.
+    size_t getDrainRate() const;
+
     void setCapPercent(size_t perc) { capPercent = perc; }
     void setQueueCap(ssize_t cap) { queueCap = cap; }
+    void setRateShaping(bool enabled) {
+        rateShaping = enabled;
+    }
+    void setMinRate(size_t rate) {
+        minRate = rate;
+    }
+    void setShapingBandPercent(size_t perc) {
+        shapingBandPercent = perc;
+    }
 
     void adjustWriteQueueCap(size_t totalItems);
 
+protected:
+    /// @return true if neither memory nor the write queue is at its limit.
+    bool isWithinLimits() const;
+
+    /**
+     * @return Process if the rate shaper has tokens available (or isn't
+     *         limiting the rate), else Pause.
+     */
+    Status getShapedStatus() const;
+
+    /**
+     * Returns how far (0.0 - 1.0) from the nearest of the limits we are,
+     * as a fraction of the shaping band; 1.0 if not within the band.
+     */
+    double getHeadroom() const;
+
+    /// Returns the current time; virtual so tests can control it.
+    virtual std::chrono::steady_clock::time_point now() const {
+        return std::chrono::steady_clock::now();
+    }
+
 private:
     bool persistenceQueueSmallEnough() const;
     bool hasSomeMemory() const;
 
+    /**
+     * Update the measured rates, re-evaluate the shaped rate and add the
+     * tokens accrued since the last refill. shaperMutex must be held.
+     */
+    void refill(std::lock_guard<std::mutex>& lh) const;
+
     Couchbase::RelaxedAtomic<ssize_t> queueCap;
     Couchbase::RelaxedAtomic<size_t> capPercent;
+    Couchbase::RelaxedAtomic<bool> rateShaping;
+    Couchbase::RelaxedAtomic<size_t> minRate;
+    Couchbase::RelaxedAtomic<size_t> shapingBandPercent;
     EPStats &stats;
+
+    /* Rate shaper state; guarded by shaperMutex (and updated by the const
+       getStatus()) */
+    mutable std::mutex shaperMutex;
+    // Tokens available; may go negative as batches are applied.
+    mutable double tokens = 0;
+    // The current shaped rate (messages / s); 0 if not limited.
+    mutable double rate = 0;
+    // Smoothed drain rate of the write queue (items / s).
+    mutable double drainRate = 0;
+    // Smoothed rate messages are applied at while not limited.
+    mutable double unshapedRate = 0;
+    // Messages applied since the last rate sample.
+    mutable size_t appliedSinceSample = 0;
+    // stats.totalPersisted at the last rate sample.
+    mutable size_t lastPersisted = 0;
+    mutable std::chrono::steady_clock::time_point lastSample;
+    mutable std::chrono::steady_clock::time_point lastRefill;
+
+    // Relaxed copies of rate / drainRate for stats.
+    mutable Couchbase::RelaxedAtomic<size_t> currentRate{0};
+    mutable Couchbase::RelaxedAtomic<size_t> currentDrainRate{0};
 };
 
 /**
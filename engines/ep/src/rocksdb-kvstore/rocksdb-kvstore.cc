@@ -29,11 +29,15 @@
 #include <platform/sysinfo.h>
 #include <rocksdb/convenience.h>
 #include <rocksdb/filter_policy.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/version.h>
+#include <rocksdb/write_buffer_manager.h>
 
 #include <nlohmann/json.hpp>
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <deque>
 #include <gsl/gsl>
 #include <limits>
 #include <thread>
@@ -164,21 +168,38 @@ struct ColumnFamilyDeleter {
 private:
     rocksdb::DB& db;
 };
-using ColumnFamilyPtr =
-        std::unique_ptr<rocksdb::ColumnFamilyHandle, ColumnFamilyDeleter>;
+
+static ColumnFamilyPtr makeColumnFamilyPtr(rocksdb::DB& db,
+                                           rocksdb::ColumnFamilyHandle* cfh) {
+    return ColumnFamilyPtr(cfh, ColumnFamilyDeleter(db));
+}
+
+// Names of the Column Families shared by all the VBuckets of a shard
+static const std::string sharedDefaultCFName = "default_shared";
+static const std::string sharedSeqnoCFName = "local+seqno_shared";
+
+// With shared Column Families every key of a VBucket starts with its vbid,
+// big-endian so that the keys of a VBucket are contiguous under the bytewise
+// ordering of the 'default' CF too.
+static std::string makeKeyPrefix(Vbid vbid) {
+    return {static_cast<char>(vbid.get() >> 8),
+            static_cast<char>(vbid.get() & 0xff)};
+}
 
 // The 'VBHandle' class is a wrapper around the ColumnFamilyHandles
 // for a VBucket.
 class VBHandle {
 public:
     VBHandle(rocksdb::DB& rdb,
-             rocksdb::ColumnFamilyHandle* defaultCFH,
-             rocksdb::ColumnFamilyHandle* seqnoCFH,
-             Vbid vbid)
+             ColumnFamilyPtr defaultCFH,
+             ColumnFamilyPtr seqnoCFH,
+             Vbid vbid,
+             std::string keyPrefix = {})
         : rdb(rdb),
-          defaultCFH(ColumnFamilyPtr(defaultCFH, rdb)),
-          seqnoCFH(ColumnFamilyPtr(seqnoCFH, rdb)),
-          vbid(vbid) {
+          defaultCFH(std::move(defaultCFH)),
+          seqnoCFH(std::move(seqnoCFH)),
+          vbid(vbid),
+          keyPrefix(std::move(keyPrefix)) {
     }
 
     void dropColumnFamilies() {
@@ -204,11 +225,62 @@ public:
     const ColumnFamilyPtr defaultCFH;
     const ColumnFamilyPtr seqnoCFH;
     const Vbid vbid;
+    // Prepended to every key of the VBucket; empty unless the Column
+    // Families are shared.
+    const std::string keyPrefix;
+};
+
+// The key of a document in the 'default' CF of a VBucket.
+class DocumentKey {
+public:
+    DocumentKey(const VBHandle& vbh, const rocksdb::Slice& key) {
+        if (vbh.keyPrefix.empty()) {
+            slice = key;
+        } else {
+            buffer.reserve(vbh.keyPrefix.size() + key.size());
+            buffer.append(vbh.keyPrefix).append(key.data(), key.size());
+            slice = buffer;
+        }
+    }
+
+    DocumentKey(const DocumentKey&) = delete;
+
+    const rocksdb::Slice& get() const {
+        return slice;
+    }
+
+private:
+    std::string buffer;
+    rocksdb::Slice slice;
+};
+
+// The key of a seqno in the 'seqno' CF of a VBucket.
+class SeqnoKey {
+public:
+    SeqnoKey(const std::string& keyPrefix, int64_t seqno)
+        : size(keyPrefix.size() + sizeof(seqno)) {
+        Expects(keyPrefix.size() <= sizeof(uint16_t));
+        std::memcpy(buffer, keyPrefix.data(), keyPrefix.size());
+        std::memcpy(buffer + keyPrefix.size(), &seqno, sizeof(seqno));
+    }
+
+    SeqnoKey(const VBHandle& vbh, int64_t seqno)
+        : SeqnoKey(vbh.keyPrefix, seqno) {
+    }
+
+    rocksdb::Slice get() const {
+        return rocksdb::Slice(buffer, size);
+    }
+
+private:
+    char buffer[sizeof(uint16_t) + sizeof(int64_t)];
+    const size_t size;
 };
 
 RocksDBKVStore::RocksDBKVStore(RocksDBKVStoreConfig& configuration)
     : KVStore(configuration),
       vbHandles(configuration.getMaxVBuckets()),
+      sharedCFs(configuration.getSharedColumnFamilies()),
       in_transaction(false),
       scanCounter(0),
       logger(configuration.getLogger()) {
@@ -241,6 +313,7 @@ RocksDBKVStore::RocksDBKVStore(RocksDBKVStoreConfig& configuration)
     rocksdb::Env::Default()->SetBackgroundThreads(highPri, rocksdb::Env::HIGH);
 
     dbOptions.create_if_missing = true;
+    dbOptions.create_missing_column_families = sharedCFs;
 
     // We use EventListener to set the correct ThreadLocal engine in the
     // ObjectRegistry for the RocksDB Flusher and Compactor threads. This
@@ -286,6 +359,22 @@ RocksDBKVStore::RocksDBKVStore(RocksDBKVStoreConfig& configuration)
     applyUserCFOptions(defaultCFOptions, cfOptions, bbtOptions);
     applyUserCFOptions(seqnoCFOptions, cfOptions, bbtOptions);
 
+    if (sharedCFs) {
+        applySharedSeqnoCFOptions();
+
+        // With a single pair of CFs there is no need to re-balance the
+        // Memtables of many CFs as VBuckets come and go (see
+        // 'applyMemtablesQuota'); a single WriteBufferManager caps the
+        // Memtables of the shard, flushing when its quota is exceeded.
+        if (configuration.getMemtablesRatio() > 0.0) {
+            dbOptions.write_buffer_manager =
+                    std::make_shared<rocksdb::WriteBufferManager>(
+                            configuration.getBucketQuota() /
+                            configuration.getMaxShards() *
+                            configuration.getMemtablesRatio());
+        }
+    }
+
     // Open the DB and load the ColumnFamilyHandle for all the
     // existing Column Families (populates the 'vbHandles' vector)
     openDB();
@@ -312,6 +401,8 @@ RocksDBKVStore::~RocksDBKVStore() {
     //     "Before delete DB, you have to close All column families by calling
     //      DestroyColumnFamilyHandle() with all the handles."
     vbHandles.clear();
+    sharedDefaultCFH.reset();
+    sharedSeqnoCFH.reset();
     // MB-28493: We need to destroy RocksDB instance before BlockCache and
     // CFOptions are destroyed as a temporary workaround for some RocksDB
     // open issues.
@@ -342,6 +433,28 @@ void RocksDBKVStore::openDB() {
         }
     }
 
+    // The CF layout is fixed when the DB is created.
+    const bool hasSharedCFs = std::find(cfs.begin(),
+                                        cfs.end(),
+                                        sharedDefaultCFName) != cfs.end();
+    const bool hasPerVBucketCFs =
+            std::find_if(cfs.begin(), cfs.end(), [](const std::string& cf) {
+                return cf != sharedDefaultCFName &&
+                       cf.compare(0, 8, "default_") == 0;
+            }) != cfs.end();
+    if ((sharedCFs && hasPerVBucketCFs) || (!sharedCFs && hasSharedCFs)) {
+        throw std::logic_error(
+                "RocksDBKVStore::openDB: DB '" + dbname + "' was created " +
+                (sharedCFs ? "without" : "with") +
+                " shared column families, rocksdb_shared_column_families "
+                "cannot be changed for an existing DB");
+    }
+
+    if (sharedCFs) {
+        openSharedDB(dbname);
+        return;
+    }
+
     // We need to pass a ColumnFamilyDescriptor for every existing CF.
     // We populate 'cfDescriptors' so that it results in a vector
     // containing packed CFs for every VBuckets, e.g. with
@@ -398,7 +511,10 @@ void RocksDBKVStore::openDB() {
         const auto& cf = cfDescriptors[i].name;
         Vbid vbid(std::stoi(cf.substr(8)));
         vbHandles[vbid.get()] = std::make_shared<VBHandle>(
-                *rdb, handles[i], handles[i + 1], vbid);
+                *rdb,
+                makeColumnFamilyPtr(*rdb, handles[i]),
+                makeColumnFamilyPtr(*rdb, handles[i + 1]),
+                vbid);
     }
 
     // We need to release the ColumnFamilyHandle for the built-in 'default' CF
@@ -406,12 +522,72 @@ void RocksDBKVStore::openDB() {
     rdb->DestroyColumnFamilyHandle(handles.back());
 }
 
+void RocksDBKVStore::openSharedDB(const std::string& dbname) {
+    // The shared CFs are created by 'rocksdb::DB::Open' if missing.
+    std::vector<rocksdb::ColumnFamilyDescriptor> cfDescriptors;
+    cfDescriptors.emplace_back(sharedDefaultCFName, defaultCFOptions);
+    cfDescriptors.emplace_back(sharedSeqnoCFName, seqnoCFOptions);
+    cfDescriptors.emplace_back(rocksdb::kDefaultColumnFamilyName,
+                               rocksdb::ColumnFamilyOptions());
+    std::vector<rocksdb::ColumnFamilyHandle*> handles;
+    rocksdb::DB* db;
+    auto status =
+            rocksdb::DB::Open(dbOptions, dbname, cfDescriptors, &handles, &db);
+    if (!status.ok()) {
+        throw std::runtime_error(
+                "RocksDBKVStore::openSharedDB: Open failed for database '" +
+                dbname + "': " + status.getState());
+    }
+    rdb.reset(db);
+    sharedDefaultCFH = makeColumnFamilyPtr(*rdb, handles[0]);
+    sharedSeqnoCFH = makeColumnFamilyPtr(*rdb, handles[1]);
+    rdb->DestroyColumnFamilyHandle(handles[2]);
+
+    // There is no CF per VBucket to tell us which VBuckets exist. Every
+    // VBucket persists its vbstate (under a fixed key in the 'seqno' CF)
+    // when it is created, so look for that.
+    const auto vbstateKey = getVbstateKey();
+    for (uint16_t vbid = 0; vbid < configuration.getMaxVBuckets(); vbid++) {
+        if ((vbid % configuration.getMaxShards()) !=
+            configuration.getShardId()) {
+            continue;
+        }
+        auto keyPrefix = makeKeyPrefix(Vbid(vbid));
+        std::string vbstate;
+        status = rdb->Get(rocksdb::ReadOptions(),
+                          sharedSeqnoCFH.get(),
+                          SeqnoKey(keyPrefix, vbstateKey).get(),
+                          &vbstate);
+        if (status.ok()) {
+            vbHandles[vbid] = std::make_shared<VBHandle>(*rdb,
+                                                         sharedDefaultCFH,
+                                                         sharedSeqnoCFH,
+                                                         Vbid(vbid),
+                                                         std::move(keyPrefix));
+        } else if (!status.IsNotFound()) {
+            throw std::runtime_error(
+                    "RocksDBKVStore::openSharedDB: Get of vbstate failed for "
+                    "vb:" +
+                    std::to_string(vbid) + ": " + status.getState());
+        }
+    }
+}
+
 std::shared_ptr<VBHandle> RocksDBKVStore::getVBHandle(Vbid vbid) {
     std::lock_guard<std::mutex> lg(vbhMutex);
     if (vbHandles[vbid.get()]) {
         return vbHandles[vbid.get()];
     }
 
+    if (sharedCFs) {
+        vbHandles[vbid.get()] = std::make_shared<VBHandle>(*rdb,
+                                                           sharedDefaultCFH,
+                                                           sharedSeqnoCFH,
+                                                           vbid,
+                                                           makeKeyPrefix(vbid));
+        return vbHandles[vbid.get()];
+    }
+
     // If the VBHandle for vbid does not exist it means that we need to create
     // the VBucket, i.e. we need to create the set of CFs on DB for vbid
     std::vector<rocksdb::ColumnFamilyDescriptor> cfDescriptors;
@@ -438,7 +614,10 @@ std::shared_ptr<VBHandle> RocksDBKVStore::getVBHandle(Vbid vbid) {
     }
 
     vbHandles[vbid.get()] =
-            std::make_shared<VBHandle>(*rdb, handles[0], handles[1], vbid);
+            std::make_shared<VBHandle>(*rdb,
+                                       makeColumnFamilyPtr(*rdb, handles[0]),
+                                       makeColumnFamilyPtr(*rdb, handles[1]),
+                                       vbid);
 
     // The number of VBuckets has increased, we need to re-balance the
     // Memtables Quota among the CFs of existing VBuckets.
@@ -608,12 +787,13 @@ GetValue RocksDBKVStore::getWithHeader(void* dbHandle,
                                        Vbid vb,
                                        GetMetaOnly getMetaOnly,
                                        bool fetchDelete) {
-    std::string value;
+    rocksdb::PinnableSlice value;
     const auto vbh = getVBHandle(vb);
-    // TODO RDB: use a PinnableSlice to avoid some memcpy
-    rocksdb::Slice keySlice = getKeySlice(key);
-    rocksdb::Status s = rdb->Get(
-            rocksdb::ReadOptions(), vbh->defaultCFH.get(), keySlice, &value);
+    DocumentKey docKey(*vbh, getKeySlice(key));
+    rocksdb::Status s = rdb->Get(rocksdb::ReadOptions(),
+                                 vbh->defaultCFH.get(),
+                                 docKey.get(),
+                                 &value);
     if (!s.ok()) {
         return GetValue{NULL, ENGINE_KEY_ENOENT};
     }
@@ -621,16 +801,52 @@ GetValue RocksDBKVStore::getWithHeader(void* dbHandle,
 }
 
 void RocksDBKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
-    // TODO RDB: RocksDB supports a multi get which we should use here.
+    if (itms.empty()) {
+        return;
+    }
+    st.getMultiBatchSizeHisto.add(itms.size());
+
+    // Look all the keys up with a single MultiGet, which reads them from
+    // one implicit snapshot and batches the lookups in each memtable / file.
+    const auto vbh = getVBHandle(vb);
+    std::deque<DocumentKey> docKeys;
+    std::vector<rocksdb::Slice> keys;
+    keys.reserve(itms.size());
+    for (auto& it : itms) {
+        docKeys.emplace_back(*vbh, getKeySlice(it.first));
+        keys.push_back(docKeys.back().get());
+    }
+
+    rocksdb::ReadOptions readOptions;
+#if ROCKSDB_MAJOR > 7 || (ROCKSDB_MAJOR == 7 && ROCKSDB_MINOR >= 4)
+    // Overlap the reads of keys in different files.
+    readOptions.async_io = true;
+#endif
+#if ROCKSDB_MAJOR > 6 || (ROCKSDB_MAJOR == 6 && ROCKSDB_MINOR >= 4)
+    std::vector<rocksdb::PinnableSlice> values(keys.size());
+    std::vector<rocksdb::Status> statuses(keys.size());
+    rdb->MultiGet(readOptions,
+                  vbh->defaultCFH.get(),
+                  keys.size(),
+                  keys.data(),
+                  values.data(),
+                  statuses.data());
+#else
+    std::vector<std::string> values;
+    const auto statuses = rdb->MultiGet(
+            readOptions,
+            std::vector<rocksdb::ColumnFamilyHandle*>(keys.size(),
+                                                      vbh->defaultCFH.get()),
+            keys,
+            &values);
+#endif
+
+    size_t index = 0;
     for (auto& it : itms) {
         auto& key = it.first;
-        rocksdb::Slice keySlice = getKeySlice(key);
-        std::string value;
-        const auto vbh = getVBHandle(vb);
-        rocksdb::Status s = rdb->Get(rocksdb::ReadOptions(),
-                                     vbh->defaultCFH.get(),
-                                     keySlice,
-                                     &value);
+        const auto& s = statuses[index];
+        const auto& value = values[index];
+        ++index;
         if (s.ok()) {
             it.second.value =
                     makeGetValue(vb, key, value, it.second.isMetaOnly);
@@ -693,8 +909,12 @@ void RocksDBKVStore::delVBucket(Vbid vbid, uint64_t vb_version) {
         while (!sharedPtr.unique()) {
             std::this_thread::sleep_for(std::chrono::microseconds(100));
         }
-        // Drop all the CF for vbid.
-        sharedPtr->dropColumnFamilies();
+        if (sharedCFs) {
+            deleteVBucketKeys(*sharedPtr);
+        } else {
+            // Drop all the CF for vbid.
+            sharedPtr->dropColumnFamilies();
+        }
     }
 
     // The number of VBuckets has decreased, we need to re-balance the
@@ -702,6 +922,30 @@ void RocksDBKVStore::delVBucket(Vbid vbid, uint64_t vb_version) {
     applyMemtablesQuota(lg2);
 }
 
+void RocksDBKVStore::deleteVBucketKeys(const VBHandle& vbh) {
+    // The range of the next vbid prefix is the exclusive end of the range.
+    const auto endPrefix = makeKeyPrefix(Vbid(vbh.vbid.get() + 1));
+    auto status = rdb->DeleteRange(
+            writeOptions, vbh.defaultCFH.get(), vbh.keyPrefix, endPrefix);
+    if (!status.ok()) {
+        throw std::runtime_error(
+                "RocksDBKVStore::deleteVBucketKeys: DeleteRange failed for "
+                "[" +
+                vbh.vbid.to_string() + ", CF: default]: " + status.getState());
+    }
+    const auto minSeqno = std::numeric_limits<int64_t>::min();
+    status = rdb->DeleteRange(writeOptions,
+                              vbh.seqnoCFH.get(),
+                              SeqnoKey(vbh.keyPrefix, minSeqno).get(),
+                              SeqnoKey(endPrefix, minSeqno).get());
+    if (!status.ok()) {
+        throw std::runtime_error(
+                "RocksDBKVStore::deleteVBucketKeys: DeleteRange failed for "
+                "[" +
+                vbh.vbid.to_string() + ", CF: seqno]: " + status.getState());
+    }
+}
+
 bool RocksDBKVStore::snapshotVBucket(Vbid vbucketId,
                                      const vbucket_state& vbstate,
                                      VBStatePersist options) {
@@ -723,7 +967,9 @@ bool RocksDBKVStore::snapshotVBucket(Vbid vbucketId,
                     status.getState());
             return false;
         }
-        status = rdb->Write(writeOptions, &batch);
+        auto options = writeOptions;
+        options.sync = writeOptions.sync && !deferCommitSync;
+        status = rdb->Write(options, &batch);
         if (!status.ok()) {
             logger.warn(
                     "RocksDBKVStore::snapshotVBucket: Write() "
@@ -843,7 +1089,9 @@ StorageProperties RocksDBKVStore::getStorageProperties(void) {
                          // does not yet use the underlying multi get
                          // of RocksDB
                          StorageProperties::EfficientGet::Yes,
-                         StorageProperties::ConcurrentWriteCompact::Yes);
+                         StorageProperties::ConcurrentWriteCompact::Yes,
+                         // All vBuckets share a single WAL.
+                         StorageProperties::GroupCommit::Yes);
     return rv;
 }
 
@@ -899,14 +1147,13 @@ rocksdb::Slice RocksDBKVStore::getKeySlice(const DocKey& key) {
                           storageKey.size());
 }
 
-rocksdb::Slice RocksDBKVStore::getSeqnoSlice(const int64_t* seqno) {
-    return rocksdb::Slice(reinterpret_cast<const char*>(seqno), sizeof(*seqno));
-}
-
 int64_t RocksDBKVStore::getNumericSeqno(const rocksdb::Slice& seqnoSlice) {
-    assert(seqnoSlice.size() == sizeof(int64_t));
+    // The seqno is the last part of the key (after any vbid prefix)
+    assert(seqnoSlice.size() >= sizeof(int64_t));
     int64_t seqno;
-    std::memcpy(&seqno, seqnoSlice.data(), seqnoSlice.size());
+    std::memcpy(&seqno,
+                seqnoSlice.data() + seqnoSlice.size() - sizeof(seqno),
+                sizeof(seqno));
     return seqno;
 }
 
@@ -944,11 +1191,10 @@ std::unique_ptr<Item> RocksDBKVStore::makeItem(Vbid vb,
 
 GetValue RocksDBKVStore::makeGetValue(Vbid vb,
                                       const DocKey& key,
-                                      const std::string& value,
+                                      const rocksdb::Slice& value,
                                       GetMetaOnly getMetaOnly) {
-    rocksdb::Slice sval(value);
     return GetValue(
-            makeItem(vb, key, sval, getMetaOnly), ENGINE_SUCCESS, -1, 0);
+            makeItem(vb, key, value, getMetaOnly), ENGINE_SUCCESS, -1, 0);
 }
 
 void RocksDBKVStore::readVBState(const VBHandle& vbh) {
@@ -971,7 +1217,7 @@ void RocksDBKVStore::readVBState(const VBHandle& vbh) {
     auto vbid = vbh.vbid;
     auto status = rdb->Get(rocksdb::ReadOptions(),
                            vbh.seqnoCFH.get(),
-                           getSeqnoSlice(&key),
+                           SeqnoKey(vbh, key).get(),
                            &vbstate);
     if (!status.ok()) {
         if (status.IsNotFound()) {
@@ -1093,9 +1339,8 @@ rocksdb::Status RocksDBKVStore::saveVBStateToBatch(const VBHandle& vbh,
 
     jsonState << "}";
 
-    auto key = getVbstateKey();
-    rocksdb::Slice keySlice = getSeqnoSlice(&key);
-    return batch.Put(vbh.seqnoCFH.get(), keySlice, jsonState.str());
+    SeqnoKey key(vbh, getVbstateKey());
+    return batch.Put(vbh.seqnoCFH.get(), key.get(), jsonState.str());
 }
 
 rocksdb::ColumnFamilyOptions RocksDBKVStore::getBaselineDefaultCFOptions() {
@@ -1110,10 +1355,35 @@ rocksdb::ColumnFamilyOptions RocksDBKVStore::getBaselineDefaultCFOptions() {
 
 rocksdb::ColumnFamilyOptions RocksDBKVStore::getBaselineSeqnoCFOptions() {
     rocksdb::ColumnFamilyOptions cfOptions;
-    cfOptions.comparator = &seqnoComparator;
+    cfOptions.comparator =
+            sharedCFs ? static_cast<const rocksdb::Comparator*>(
+                                &prefixedSeqnoComparator)
+                      : &seqnoComparator;
     return cfOptions;
 }
 
+void RocksDBKVStore::applySharedSeqnoCFOptions() {
+    // Keys are prefixed by the 2-byte vbid. Build Bloom filters on that
+    // prefix, both for the Memtables and the SST files, so that a scan or
+    // seek of one VBucket skips the data of all the others.
+    seqnoCFOptions.prefix_extractor.reset(
+            rocksdb::NewFixedPrefixTransform(sizeof(uint16_t)));
+    seqnoCFOptions.memtable_prefix_bloom_size_ratio = 0.1;
+
+    auto* bbtOptions = static_cast<rocksdb::BlockBasedTableOptions*>(
+            seqnoCFOptions.table_factory->GetOptions());
+    rocksdb::BlockBasedTableOptions tableOptions = *bbtOptions;
+    if (!tableOptions.filter_policy) {
+        tableOptions.filter_policy.reset(
+                rocksdb::NewBloomFilterPolicy(10, false));
+    }
+    // The only point lookup in the 'seqno' CF is for the vbstate, not worth
+    // a whole key filter.
+    tableOptions.whole_key_filtering = false;
+    seqnoCFOptions.table_factory.reset(
+            rocksdb::NewBlockBasedTableFactory(tableOptions));
+}
+
 void RocksDBKVStore::applyUserCFOptions(rocksdb::ColumnFamilyOptions& cfOptions,
                                         const std::string& newCfOptions,
                                         const std::string& newBbtOptions) {
@@ -1182,9 +1452,24 @@ void RocksDBKVStore::applyUserCFOptions(rocksdb::ColumnFamilyOptions& cfOptions,
     }
 }
 
+bool RocksDBKVStore::syncCommits() {
+    auto begin = std::chrono::steady_clock::now();
+    auto status = rdb->SyncWAL();
+    st.commitHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin));
+    if (!status.ok()) {
+        logger.warn("RocksDBKVStore::syncCommits: SyncWAL error:{}",
+                    status.getState());
+        return false;
+    }
+    return true;
+}
+
 rocksdb::Status RocksDBKVStore::writeAndTimeBatch(rocksdb::WriteBatch batch) {
     auto begin = std::chrono::steady_clock::now();
-    auto status = rdb->Write(writeOptions, &batch);
+    auto options = writeOptions;
+    options.sync = writeOptions.sync && !deferCommitSync;
+    auto status = rdb->Write(options, &batch);
     st.commitHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - begin));
     return status;
@@ -1284,13 +1569,17 @@ rocksdb::Status RocksDBKVStore::addRequestToWriteBatch(
     Vbid vbid = request->getVBucketId();
 
     rocksdb::Slice keySlice = getKeySlice(request->getKey());
-    rocksdb::SliceParts keySliceParts(&keySlice, 1);
+    DocumentKey docKey(vbh, keySlice);
+    rocksdb::SliceParts keySliceParts(&docKey.get(), 1);
 
     rocksdb::Slice docSlices[] = {request->getDocMetaSlice(),
                                   request->getDocBodySlice()};
     rocksdb::SliceParts valueSliceParts(docSlices, 2);
 
-    rocksdb::Slice bySeqnoSlice = getSeqnoSlice(&request->getDocMeta().bySeqno);
+    // The seqno CF maps to the document key without the vbid prefix, as
+    // that is what scan() passes on.
+    SeqnoKey bySeqnoKey(vbh, request->getDocMeta().bySeqno);
+    rocksdb::Slice bySeqnoSlice = bySeqnoKey.get();
     // We use the `saveDocsHisto` to track the time spent on
     // `rocksdb::WriteBatch::Put()`.
     auto begin = std::chrono::steady_clock::now();
@@ -1323,14 +1612,14 @@ rocksdb::Status RocksDBKVStore::addRequestToWriteBatch(
 
 int64_t RocksDBKVStore::readHighSeqnoFromDisk(const VBHandle& vbh) {
     std::unique_ptr<rocksdb::Iterator> it(
-            rdb->NewIterator(rocksdb::ReadOptions(), vbh.seqnoCFH.get()));
+            rdb->NewIterator(getSeqnoReadOptions(), vbh.seqnoCFH.get()));
 
     // Seek to the highest seqno=>key mapping stored for the vbid
-    auto maxSeqno = std::numeric_limits<int64_t>::max();
-    rocksdb::Slice maxSeqnoSlice = getSeqnoSlice(&maxSeqno);
-    it->SeekForPrev(maxSeqnoSlice);
+    SeqnoKey maxSeqnoKey(vbh, std::numeric_limits<int64_t>::max());
+    it->SeekForPrev(maxSeqnoKey.get());
 
-    if (!it->Valid()) {
+    // With shared CFs the previous key may belong to a lower vbid
+    if (!it->Valid() || !it->key().starts_with(vbh.keyPrefix)) {
         return 0;
     }
     auto highSeqno = getNumericSeqno(it->key());
@@ -1338,6 +1627,14 @@ int64_t RocksDBKVStore::readHighSeqnoFromDisk(const VBHandle& vbh) {
     return highSeqno >= 0 ? highSeqno : 0;
 }
 
+rocksdb::ReadOptions RocksDBKVStore::getSeqnoReadOptions() const {
+    rocksdb::ReadOptions options;
+    // Only ever iterate the keys of one VBucket, which lets RocksDB use the
+    // prefix Bloom filters of the shared 'seqno' CF.
+    options.prefix_same_as_start = sharedCFs;
+    return options;
+}
+
 int64_t RocksDBKVStore::getVbstateKey() {
     // We put the VBState into the SeqnoCF. As items in the SeqnoCF are ordered
     // by increasing-seqno, we reserve a negative special key to VBState so
@@ -1404,7 +1701,7 @@ scan_error_t RocksDBKVStore::scan(ScanContext* ctx) {
                                      ? GetMetaOnly::Yes
                                      : GetMetaOnly::No;
 
-    rocksdb::ReadOptions snapshotOpts{rocksdb::ReadOptions()};
+    rocksdb::ReadOptions snapshotOpts{getSeqnoReadOptions()};
 
     // Lock for safe access to the scanSnapshots map and to ensure the snapshot
     // doesn't get destroyed whilst we have the pointer.
@@ -1412,8 +1709,8 @@ scan_error_t RocksDBKVStore::scan(ScanContext* ctx) {
     std::lock_guard<std::mutex> lg(scanSnapshotsMutex);
     snapshotOpts.snapshot = scanSnapshots.at(ctx->scanId).get();
 
-    rocksdb::Slice startSeqnoSlice = getSeqnoSlice(&startSeqno);
     const auto vbh = getVBHandle(ctx->vbid);
+    SeqnoKey startSeqnoKey(*vbh, startSeqno);
     std::unique_ptr<rocksdb::Iterator> it(
             rdb->NewIterator(snapshotOpts, vbh->seqnoCFH.get()));
     if (!it) {
@@ -1421,11 +1718,12 @@ scan_error_t RocksDBKVStore::scan(ScanContext* ctx) {
                 "RocksDBKVStore::scan: rocksdb::Iterator to Seqno Column "
                 "Family is nullptr");
     }
-    it->Seek(startSeqnoSlice);
+    it->Seek(startSeqnoKey.get());
 
-    rocksdb::Slice endSeqnoSlice = getSeqnoSlice(&ctx->maxSeqno);
-    auto isPastEnd = [&endSeqnoSlice, this](rocksdb::Slice seqSlice) {
-        return seqnoComparator.Compare(seqSlice, endSeqnoSlice) == 1;
+    SeqnoKey endSeqnoKey(*vbh, ctx->maxSeqno);
+    const auto* comparator = seqnoCFOptions.comparator;
+    auto isPastEnd = [&endSeqnoKey, comparator](rocksdb::Slice seqSlice) {
+        return comparator->Compare(seqSlice, endSeqnoKey.get()) > 0;
     };
 
     for (; it->Valid() && !isPastEnd(it->key()); it->Next()) {
@@ -1433,8 +1731,9 @@ scan_error_t RocksDBKVStore::scan(ScanContext* ctx) {
         auto seqno = getNumericSeqno(it->key());
         rocksdb::Slice keySlice = it->value();
         std::string valueStr;
+        DocumentKey docKey(*vbh, keySlice);
         auto s = rdb->Get(
-                snapshotOpts, vbh->defaultCFH.get(), keySlice, &valueStr);
+                snapshotOpts, vbh->defaultCFH.get(), docKey.get(), &valueStr);
 
         if (!s.ok()) {
             // TODO RDB: Old seqnos are never removed from the db!
@@ -1563,6 +1862,16 @@ bool RocksDBKVStore::getStatFromProperties(ColumnFamily cf,
                                            size_t& value) {
     value = 0;
     std::lock_guard<std::mutex> lg(vbhMutex);
+    if (sharedCFs) {
+        const auto& cfh = (cf == ColumnFamily::Default) ? sharedDefaultCFH
+                                                        : sharedSeqnoCFH;
+        std::string out;
+        if (!rdb->GetProperty(cfh.get(), property, &out)) {
+            return false;
+        }
+        value = std::stoull(out);
+        return true;
+    }
     for (const auto vbh : vbHandles) {
         if (vbh) {
             rocksdb::ColumnFamilyHandle* cfh = nullptr;
@@ -1615,7 +1924,10 @@ void RocksDBKVStore::applyMemtablesQuota(
     // On both cases the following logic does not apply, so the
     // write_buffer_size for both the 'default' and the 'seqno' CFs is left
     // to the baseline value.
-    if (configuration.getMemtablesRatio() > 0.0 && vbuckets > 0) {
+    // With shared CFs the quota goes to the single pair of CFs, whatever the
+    // number of VBuckets.
+    const auto cfsPerType = sharedCFs ? 1 : vbuckets;
+    if (configuration.getMemtablesRatio() > 0.0 && cfsPerType > 0) {
         const auto memtablesQuota = configuration.getBucketQuota() /
                                     configuration.getMaxShards() *
                                     configuration.getMemtablesRatio();
@@ -1629,11 +1941,11 @@ void RocksDBKVStore::applyMemtablesQuota(
 
         // Set the the write_buffer_size for the 'default' CF
         defaultCFOptions.write_buffer_size =
-                defaultCFMemtablesQuota / vbuckets /
+                defaultCFMemtablesQuota / cfsPerType /
                 defaultCFOptions.max_write_buffer_number;
         // Set the write_buffer_size for the 'seqno' CF
         seqnoCFOptions.write_buffer_size =
-                seqnoCFMemtablesQuota / vbuckets /
+                seqnoCFMemtablesQuota / cfsPerType /
                 seqnoCFOptions.max_write_buffer_number;
 
         // Apply the new write_buffer_size
@@ -1645,25 +1957,34 @@ void RocksDBKVStore::applyMemtablesQuota(
                 newSeqnoCFWriteBufferSize{std::make_pair(
                         "write_buffer_size",
                         std::to_string(seqnoCFOptions.write_buffer_size))};
-        for (const auto& vbh : vbHandles) {
-            if (vbh) {
-                auto status = rdb->SetOptions(vbh->defaultCFH.get(),
-                                              newDefaultCFWriteBufferSize);
-                if (!status.ok()) {
-                    throw std::runtime_error(
-                            "RocksDBKVStore::applyMemtablesQuota: SetOptions "
-                            "failed for [" +
-                            (vbh->vbid).to_string() + ", CF: default]: " +
-                            status.getState());
-                }
-                status = rdb->SetOptions(vbh->seqnoCFH.get(),
-                                         newSeqnoCFWriteBufferSize);
-                if (!status.ok()) {
-                    throw std::runtime_error(
-                            "RocksDBKVStore::applyMemtablesQuota: SetOptions "
-                            "failed for [ " +
-                            (vbh->vbid).to_string() + ", CF: seqno]: " +
-                            status.getState());
+        auto setOptions = [this](rocksdb::ColumnFamilyHandle* cfh,
+                                 const std::unordered_map<std::string,
+                                                          std::string>& options,
+                                 const std::string& name) {
+            auto status = rdb->SetOptions(cfh, options);
+            if (!status.ok()) {
+                throw std::runtime_error(
+                        "RocksDBKVStore::applyMemtablesQuota: SetOptions "
+                        "failed for [" +
+                        name + "]: " + status.getState());
+            }
+        };
+        if (sharedCFs) {
+            setOptions(sharedDefaultCFH.get(),
+                       newDefaultCFWriteBufferSize,
+                       "CF: " + sharedDefaultCFName);
+            setOptions(sharedSeqnoCFH.get(),
+                       newSeqnoCFWriteBufferSize,
+                       "CF: " + sharedSeqnoCFName);
+        } else {
+            for (const auto& vbh : vbHandles) {
+                if (vbh) {
+                    setOptions(vbh->defaultCFH.get(),
+                               newDefaultCFWriteBufferSize,
+                               vbh->vbid.to_string() + ", CF: default");
+                    setOptions(vbh->seqnoCFH.get(),
+                               newSeqnoCFWriteBufferSize,
+                               vbh->vbid.to_string() + ", CF: seqno");
                 }
             }
         }
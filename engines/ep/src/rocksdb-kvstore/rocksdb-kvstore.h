@@ -29,6 +29,7 @@
 
 #include <platform/dirutils.h>
 #include <platform/non_negative_counter.h>
+#include <cstring>
 #include <map>
 #include <vector>
 
@@ -103,6 +104,46 @@ public:
     }
 };
 
+// Used to order the seqno Column Family shared by all the vBuckets of a shard,
+// where every key is the 2-byte big-endian vbid followed by the seqno. Orders
+// by vbid and then by seqno, so each vBucket's seqnos are contiguous and
+// every vBucket can be iterated (and range-deleted) on its own.
+class PrefixedSeqnoComparator : public rocksdb::Comparator {
+public:
+    int Compare(const rocksdb::Slice& a,
+                const rocksdb::Slice& b) const override {
+        const auto prefix = std::memcmp(a.data(), b.data(), sizeof(uint16_t));
+        if (prefix != 0) {
+            return prefix;
+        }
+
+        int64_t seqnoA;
+        int64_t seqnoB;
+        std::memcpy(&seqnoA, a.data() + sizeof(uint16_t), sizeof(seqnoA));
+        std::memcpy(&seqnoB, b.data() + sizeof(uint16_t), sizeof(seqnoB));
+        if (seqnoA < seqnoB) {
+            return -1;
+        }
+        if (seqnoA > seqnoB) {
+            return +1;
+        }
+
+        return 0;
+    }
+
+    const char* Name() const override {
+        return "PrefixedSeqnoComparator";
+    }
+
+    void FindShortestSeparator(std::string*,
+                               const rocksdb::Slice&) const override {
+    }
+    void FindShortSuccessor(std::string*) const override {
+    }
+};
+
+using ColumnFamilyPtr = std::shared_ptr<rocksdb::ColumnFamilyHandle>;
+
 class RocksRequest;
 class RocksDBKVStoreConfig;
 class VBHandle;
@@ -141,6 +182,12 @@ public:
      */
     bool commit(Collections::VB::Flush& collectionsFlush) override;
 
+    void setDeferCommitSync(bool defer) override {
+        deferCommitSync = defer;
+    }
+
+    bool syncCommits() override;
+
     /**
      * Rollback a transaction (unless not currently in one).
      */
@@ -273,7 +320,7 @@ public:
             Vbid vbid,
             const DocKey start_key,
             uint32_t count,
-            std::shared_ptr<Callback<const DocKey&>> cb) override {
+            std::shared_ptr<StatusCallback<const DocKey&>> cb) override {
         // TODO vmx 2016-10-29: implement
         return ENGINE_SUCCESS;
     }
@@ -352,6 +399,13 @@ private:
     std::vector<std::shared_ptr<VBHandle>> vbHandles;
 
     SeqnoComparator seqnoComparator;
+    PrefixedSeqnoComparator prefixedSeqnoComparator;
+
+    // If true, all the VBHandles share the 'sharedDefaultCFH' and
+    // 'sharedSeqnoCFH' Column Families and prefix every key with the vbid.
+    const bool sharedCFs;
+    ColumnFamilyPtr sharedDefaultCFH;
+    ColumnFamilyPtr sharedSeqnoCFH;
 
     rocksdb::DBOptions dbOptions;
     rocksdb::ColumnFamilyOptions defaultCFOptions;
@@ -372,11 +426,25 @@ private:
                             const std::string& newCfOptions,
                             const std::string& newBbtOptions);
 
+    // Sets the prefix extractor and prefix Bloom filters of the shared
+    // 'seqno' CF, as every iteration is confined to a single vbid prefix.
+    void applySharedSeqnoCFOptions();
+
     // Opens the DB on disk and instantiates 'rdb'. Also, it
     // populates 'vbHandles' with the ColumnFamilyHandles for all the
     // existing VBuckets.
     void openDB();
 
+    // The part of 'openDB()' for a DB with shared Column Families.
+    void openSharedDB(const std::string& dbname);
+
+    // Returns the ReadOptions for iterating the 'seqno' CF of a VBucket.
+    rocksdb::ReadOptions getSeqnoReadOptions() const;
+
+    // With shared Column Families a VBucket cannot be dropped with its CFs;
+    // this deletes the key ranges of its vbid prefix instead.
+    void deleteVBucketKeys(const VBHandle& vbh);
+
     /*
      * This function returns an instance of VBHandle for the given vbid.
      * The VBHandle for 'vbid' is created if it does not exist.
@@ -413,7 +481,6 @@ private:
     static rocksdb::StatsLevel getStatsLevel(const std::string& stats_level);
 
     rocksdb::Slice getKeySlice(const DocKey& key);
-    rocksdb::Slice getSeqnoSlice(const int64_t* seqno);
     int64_t getNumericSeqno(const rocksdb::Slice& seqnoSlice);
 
     std::unique_ptr<Item> makeItem(Vbid vb,
@@ -423,7 +490,7 @@ private:
 
     GetValue makeGetValue(Vbid vb,
                           const DocKey& key,
-                          const std::string& value,
+                          const rocksdb::Slice& value,
                           GetMetaOnly getMetaOnly = GetMetaOnly::No);
 
     void readVBState(const VBHandle& db);
@@ -483,6 +550,10 @@ private:
 
     rocksdb::WriteOptions writeOptions;
 
+    // If true, commit() writes to the WAL without syncing it; the caller
+    // syncs later via syncCommits(). Only accessed by the flusher.
+    bool deferCommitSync = false;
+
     // RocksDB does *not* need additional synchronisation around
     // db->Write, but we need to prevent delVBucket racing with
     // commit, potentially losing data.
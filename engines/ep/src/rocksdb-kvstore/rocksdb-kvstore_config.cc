@@ -45,6 +45,7 @@ RocksDBKVStoreConfig::RocksDBKVStoreConfig(Configuration& config,
     writeRateLimit = config.getRocksdbWriteRateLimit();
     ucMaxSizeAmplificationPercent =
             config.getRocksdbUcMaxSizeAmplificationPercent();
+    sharedColumnFamilies = config.isRocksdbSharedColumnFamilies();
 }
 
 std::shared_ptr<rocksdb::RateLimiter>
@@ -102,6 +102,11 @@ public:
         return ucMaxSizeAmplificationPercent;
     }
 
+    // Return true if the vBuckets of the shard share their Column Families
+    bool getSharedColumnFamilies() const {
+        return sharedColumnFamilies;
+    }
+
     // Creates a RateLimiter object, which is shared across all the RocksDB
     // instances in the environment to control the IO rate of Flush and
     // Compaction tasks.
@@ -165,4 +170,9 @@ private:
     // Essentially we can use this parameter to relax/narrow the size
     // amplification constraint under Universal Compaction.
     size_t ucMaxSizeAmplificationPercent = 200;
+
+    // If true, all the vBuckets of the shard are stored in one 'default' and
+    // one 'seqno' CF, with every key prefixed by the vbid, rather than in a
+    // pair of CFs per vBucket.
+    bool sharedColumnFamilies = false;
 };
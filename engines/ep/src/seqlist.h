@@ -320,6 +320,34 @@ public:
                                StoredValue::UniquePtr ownedSv,
                                StoredValue* replacement) = 0;
 
+    /**
+     * Check if the OrderedStoredValue can currently be replaced in the list
+     * by a copy of it (see relinkListElem()). This is not possible if it
+     * isn't in the list, if a range read or the purger may be looking at it,
+     * or if there are stale items (which may point to it as their
+     * replacement).
+     *
+     * @param listWriteLg Write lock of the sequenceList from getListWriteLock()
+     * @param v Ref to orderedStoredValue
+     */
+    virtual bool canRelinkListElem(std::lock_guard<std::mutex>& listWriteLg,
+                                   const OrderedStoredValue& v) const = 0;
+
+    /**
+     * Replace an OrderedStoredValue in the list with a copy of it (which
+     * isn't in the list), keeping its position. Used when the StoredValue is
+     * reallocated in the HashTable by the defragmenter.
+     * canRelinkListElem() must have returned true for oldSv, under the same
+     * hold of the write lock.
+     *
+     * @param listWriteLg Write lock of the sequenceList from getListWriteLock()
+     * @param oldSv Ref to orderedStoredValue in the list
+     * @param newSv Ref to the copy of oldSv to put in its place
+     */
+    virtual void relinkListElem(std::lock_guard<std::mutex>& listWriteLg,
+                                OrderedStoredValue& oldSv,
+                                OrderedStoredValue& newSv) = 0;
+
     /**
      * Remove from sequence list and delete all OSVs which are purgable.
      * OSVs which can be purged are items which are outside the ReadRange and
@@ -328,9 +356,10 @@ public:
      * @param purgeUpToSeqno Indicates the max seqno (inclusive) that could be
      *                       purged
      * @param shouldPause Callback function that indicates if tombstone purging
-     *                    should pause. This is called for every element in the
-     *                    sequence list when we iterate over the list during the
-     *                    purge. The caller should decide if the purge should
+     *                    should pause. This is called as we iterate over the
+     *                    sequence list during the purge (after every element,
+     *                    or every batch of elements if the list visits them in
+     *                    batches). The caller should decide if the purge should
      *                    continue or if it should be paused (in case it is
      *                    running for a long time). By default, we assume that
      *                    the tombstone purging need not be paused at all
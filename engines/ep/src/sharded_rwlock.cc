@@ -0,0 +1,28 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "sharded_rwlock.h"
+
+#include <atomic>
+
+size_t ShardedRWLock::getThreadShard() {
+    static std::atomic<size_t> nextShard{0};
+    // Threads are handed out shards in turn, which spreads the (long lived)
+    // front-end and background threads evenly over them.
+    static thread_local const size_t shard = nextShard.fetch_add(1) % NumShards;
+    return shard;
+}
@@ -0,0 +1,69 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <platform/cacheline_padded.h>
+#include <platform/rwlock.h>
+
+#include <array>
+#include <cstddef>
+
+/**
+ * A reader-writer lock for data which is read far more often than it is
+ * written, split into a number of shards (each on its own cache line).
+ *
+ * A reader only takes its own thread's shard, so readers on different
+ * threads don't all contend on the same cache line. A writer takes every
+ * shard (always in the same order), excluding all readers.
+ *
+ * Each thread always uses the same shard, so a thread which already holds a
+ * shared lock can take it again exactly as it could with a single cb::RWLock.
+ *
+ * Readers lock the cb::ReaderLock returned by reader() (as they would for a
+ * cb::RWLock), writers lock the ShardedRWLock itself, e.g.
+ * std::unique_lock<ShardedRWLock>.
+ */
+class ShardedRWLock {
+public:
+    /// The shard of the calling thread, to take for shared access
+    cb::ReaderLock& reader() const {
+        return shards[getThreadShard()]->reader();
+    }
+
+    /// Take exclusive access, locking every shard
+    void lock() {
+        for (auto& shard : shards) {
+            shard->writer().lock();
+        }
+    }
+
+    /// Release exclusive access
+    void unlock() {
+        for (auto it = shards.rbegin(); it != shards.rend(); ++it) {
+            (*it)->writer().unlock();
+        }
+    }
+
+    static const size_t NumShards = 16;
+
+private:
+    /// @return the shard index of the calling thread, assigned on first use
+    static size_t getThreadShard();
+
+    mutable std::array<cb::CachelinePadded<cb::RWLock>, NumShards> shards;
+};
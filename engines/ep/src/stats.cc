@@ -67,9 +67,15 @@ EPStats::EPStats()
       expiryPagerRuns(0),
       freqDecayerRuns(0),
       itemsRemovedFromCheckpoints(0),
+      itemsExpelledFromCheckpoints(0),
       numValueEjects(0),
+      numPagerCompressions(0),
+      numValueTierMoves(0),
+      numReplicaPersistEjects(0),
+      numReplicaPersistCompressions(0),
       numFailedEjects(0),
       numNotMyVBuckets(0),
+      numGetValueCopies(0),
       estimatedTotalMemory(0),
       memoryTrackerEnabled(false),
       forceShutdown(false),
@@ -93,6 +99,8 @@ EPStats::EPStats()
       bgMaxLoad(0),
       vbucketDelMaxWalltime(0),
       vbucketDelTotWalltime(0),
+      vbucketDelMemFreed(0),
+      vbucketDelMemTime(0),
       replicationThrottleThreshold(0),
       numOpsStore(0),
       numOpsDelete(0),
@@ -115,6 +123,8 @@ EPStats::EPStats()
       rollbackCount(0),
       defragNumVisited(0),
       defragNumMoved(0),
+      defragNumSkippedDense(0),
+      defragStoredValueNumMoved(0),
       compressorNumVisited(0),
       compressorNumCompressed(0),
       dirtyAgeHisto(),
@@ -195,7 +205,30 @@ void EPStats::maybeUpdateEstimatedTotalMemUsed(
     }
 }
 
+void EPStats::setMemoryArena(unsigned arena,
+                             size_t (*getAllocated)(unsigned)) {
+    getArenaAllocated = getAllocated;
+    memoryArena = arena;
+}
+
+const std::chrono::microseconds EPStats::ArenaReadInterval{1000};
+
+size_t EPStats::getArenaMemoryUsed(bool refresh) const {
+    const int64_t now = std::chrono::steady_clock::now().time_since_epoch() /
+                        std::chrono::microseconds(1);
+    auto last = arenaReadTime.load();
+    // Only one thread re-reads the arena; the others use the last read.
+    if ((refresh || now - last >= ArenaReadInterval.count()) &&
+        arenaReadTime.compare_exchange_strong(last, now)) {
+        estimatedTotalMemory->store(getArenaAllocated(memoryArena));
+    }
+    return size_t(std::max(int64_t(0), estimatedTotalMemory->load()));
+}
+
 size_t EPStats::getPreciseTotalMemoryUsed() {
+    if (memoryArena.load()) {
+        return getArenaMemoryUsed(true);
+    }
     if (memoryTrackerEnabled.load()) {
         for (auto& core : coreLocal) {
             estimatedTotalMemory->fetch_add(
@@ -269,5 +302,13 @@ size_t EPStats::getNumItem() const {
     for (const auto& core : coreLocal) {
         result += core->numItem;
     }
+
+size_t EPStats::getCheckpointMemory() const {
+    int64_t result = 0;
+    for (const auto& core : coreLocal) {
+        result += core->checkpointMemory;
+    }
+    return std::max(int64_t(0), result);
+}
     return std::max(int64_t(0), result);
 }
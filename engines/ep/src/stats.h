@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "hdrhistogram.h"
+#include "lock_profiler.h"
 #include "objectregistry.h"
 
 #include <memcached/types.h>
@@ -31,9 +32,55 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 
 class CoreLocalStats;
 
+/**
+ * Counter for events counted on every front-end operation. Each core
+ * increments its own (cacheline padded) count, which are summed on read, so
+ * the counter's cacheline isn't bounced between the cores updating it.
+ * Reading is O(cores); only use it for counters which are updated far more
+ * often than read.
+ */
+class CoreLocalCounter {
+public:
+    explicit CoreLocalCounter(size_t initial = 0) {
+        counts.get()->store(initial);
+    }
+
+    CoreLocalCounter& operator++() {
+        counts.get()->fetch_add(1);
+        return *this;
+    }
+
+    CoreLocalCounter& operator+=(size_t n) {
+        counts.get()->fetch_add(n);
+        return *this;
+    }
+
+    size_t load() const {
+        size_t total = 0;
+        for (const auto& count : counts) {
+            total += count->load();
+        }
+        return total;
+    }
+
+    operator size_t() const {
+        return load();
+    }
+
+    void reset() {
+        for (auto& count : counts) {
+            count->store(0);
+        }
+    }
+
+private:
+    CoreStore<cb::CachelinePadded<Couchbase::RelaxedAtomic<size_t>>> counts;
+};
+
 /**
  * Global engine stats container.
  */
@@ -81,6 +128,9 @@ public:
      * returns.
      */
     size_t getEstimatedTotalMemoryUsed() const {
+        if (memoryArena.load()) {
+            return getArenaMemoryUsed(false);
+        }
         int64_t rv = 0;
         if (memoryTrackerEnabled.load()) {
             rv = estimatedTotalMemory->load();
@@ -102,6 +152,20 @@ public:
      */
     size_t getPreciseTotalMemoryUsed();
 
+    /**
+     * Take the bucket's memory used from the allocator arena it allocates
+     * from (see arena_memory_accounting), instead of from the memory
+     * tracker's per allocation counts.
+     * @param arena the bucket's arena
+     * @param getAllocated returns the bytes allocated from an arena
+     */
+    void setMemoryArena(unsigned arena, size_t (*getAllocated)(unsigned));
+
+    /// @returns the allocator arena the bucket allocates from (0 if none).
+    unsigned getMemoryArena() const {
+        return memoryArena.load();
+    }
+
     /// @returns total size of stored objects.
     size_t getCurrentSize() const;
 
@@ -126,6 +190,9 @@ public:
     /// @returns number of Item objects which exist.
     size_t getNumItem() const;
 
+    /// @returns memory used by the items queued in all checkpoints.
+    size_t getCheckpointMemory() const;
+
     // account for allocated mem
     void memAllocated(size_t sz);
 
@@ -171,9 +238,13 @@ public:
     //! Number of times VBucket state persisted.
     Counter totalPersistVBState;
     //! Cumulative number of items added to the queue.
-    Counter totalEnqueued;
+    CoreLocalCounter totalEnqueued;
     //! Cumulative count of items de-duplicated when queued to CheckpointManager
-    Counter totalDeduplicated;
+    CoreLocalCounter totalDeduplicated;
+    //! Cumulative count of items de-duplicated by the flusher, i.e. which
+    //! weren't persisted as a later item for the same key was in the same
+    //! flush batch (possibly from a different checkpoint).
+    Counter totalDeduplicatedFlusher;
     //! Number of times an item flush failed.
     Counter flushFailed;
     //! Number of times an item is not flushed due to the item's expiry
@@ -233,12 +304,27 @@ public:
     Counter freqDecayerRuns;
     //! Number of items removed from closed unreferenced checkpoints.
     Counter itemsRemovedFromCheckpoints;
+    //! Number of items expelled from checkpoints once all cursors passed them.
+    Counter itemsExpelledFromCheckpoints;
     //! Number of times a value is ejected
     Counter numValueEjects;
+    //! Number of times the item pager compressed a value instead of
+    //! ejecting it
+    Counter numPagerCompressions;
+    //! Number of times the item pager moved a value to the value tier
+    //! instead of ejecting it
+    Counter numValueTierMoves;
+    //! Number of replica values ejected once persisted (replica_value_policy)
+    Counter numReplicaPersistEjects;
+    //! Number of replica values compressed in memory once persisted
+    Counter numReplicaPersistCompressions;
     //! Number of times a value could not be ejected
     Counter numFailedEjects;
     //! Number of times "Not my bucket" happened
-    Counter numNotMyVBuckets;
+    CoreLocalCounter numNotMyVBuckets;
+    //! Number of GETs whose value had to be copied into the returned Item,
+    //! instead of sharing the StoredValue's Blob (e.g. inline values).
+    Counter numGetValueCopies;
 
     //! The total amount of memory used by this bucket (From memory tracking)
     // This is a signed variable as depending on how/when the thread-local
@@ -311,6 +397,10 @@ public:
     std::atomic<hrtime_t> vbucketDelMaxWalltime;
     //! Total wall time of deleting vbuckets
     std::atomic<hrtime_t> vbucketDelTotWalltime;
+    //! Bytes of items freed by deleting vbuckets from memory
+    Counter vbucketDelMemFreed;
+    //! Total time (µs) spent freeing the items of deleted vbuckets
+    Counter vbucketDelMemTime;
 
     //! Histogram of setWithMeta latencies.
     MicrosecondHistogram setWithMetaHisto;
@@ -328,28 +418,28 @@ public:
     std::atomic<double> replicationThrottleThreshold;
 
     //! The number of basic store (add, set, arithmetic, touch, etc.) operations
-    Counter numOpsStore;
+    CoreLocalCounter numOpsStore;
     //! The number of basic delete operations
-    Counter numOpsDelete;
+    CoreLocalCounter numOpsDelete;
     //! The number of basic get operations
-    Counter numOpsGet;
+    CoreLocalCounter numOpsGet;
 
     //! The number of get with meta operations
-    Counter  numOpsGetMeta;
+    CoreLocalCounter numOpsGetMeta;
     //! The number of set with meta operations
-    Counter  numOpsSetMeta;
+    CoreLocalCounter numOpsSetMeta;
     //! The number of delete with meta operations
-    Counter  numOpsDelMeta;
+    CoreLocalCounter numOpsDelMeta;
     //! The number of failed set meta ops due to conflict resoltion
     Counter numOpsSetMetaResolutionFailed;
     //! The number of failed del meta ops due to conflict resoltion
     Counter numOpsDelMetaResolutionFailed;
     //! The number of set returning meta operations
-    Counter  numOpsSetRetMeta;
+    CoreLocalCounter numOpsSetRetMeta;
     //! The number of delete returning meta operations
-    Counter  numOpsDelRetMeta;
+    CoreLocalCounter numOpsDelRetMeta;
     //! The number of background get meta ops due to set_with_meta operations
-    Counter  numOpsGetMetaOnSetWithMeta;
+    CoreLocalCounter numOpsGetMetaOnSetWithMeta;
 
     //! The number of times the access scanner runs
     Counter alogRuns;
@@ -379,6 +469,16 @@ public:
      */
     Counter defragNumMoved;
 
+    /** The number of items the defragmenter task didn't move because the
+     * allocator run holding them was dense.
+     */
+    Counter defragNumSkippedDense;
+
+    /** The number of StoredValues that have been moved (defragmented) by the
+     * defragmenter task.
+     */
+    Counter defragStoredValueNumMoved;
+
     Counter compressorNumVisited;
     Counter compressorNumCompressed;
 
@@ -453,6 +553,9 @@ public:
     //! Histogram of wait_for_checkpoint_persistence command
     MicrosecondHistogram chkPersistenceHisto;
 
+    //! Histogram of waits for a seqno to be persisted (seqno_persistence)
+    MicrosecondHistogram seqnoPersistenceHisto;
+
     //
     // DB timers.
     //
@@ -485,6 +588,9 @@ public:
     MicrosecondHistogram persistenceCursorGetItemsHisto;
     MicrosecondHistogram dcpCursorsGetItemsHisto;
 
+    //! Sampled wait and hold times of the bucket's locks ("stats locks")
+    LockProfiles lockProfiles;
+
     //! Reset all stats to reasonable values.
     void reset() {
         tooYoung.store(0);
@@ -499,9 +605,15 @@ public:
         expiryPagerRuns.store(0);
         freqDecayerRuns.store(0);
         itemsRemovedFromCheckpoints.store(0);
+        itemsExpelledFromCheckpoints.store(0);
         numValueEjects.store(0);
+        numPagerCompressions.store(0);
+        numValueTierMoves.store(0);
+        numReplicaPersistEjects.store(0);
+        numReplicaPersistCompressions.store(0);
         numFailedEjects.store(0);
-        numNotMyVBuckets.store(0);
+        numNotMyVBuckets.reset();
+        numGetValueCopies.store(0);
         bg_fetched.store(0);
         bgNumOperations.store(0);
         bgWait.store(0);
@@ -518,11 +630,15 @@ public:
         pendingOpsMaxDuration.store(0);
         vbucketDelMaxWalltime.store(0);
         vbucketDelTotWalltime.store(0);
+        vbucketDelMemFreed.store(0);
+        vbucketDelMemTime.store(0);
 
         alogRuns.store(0);
         accessScannerSkips.store(0),
         defragNumVisited.store(0),
         defragNumMoved.store(0);
+        defragNumSkippedDense.store(0);
+        defragStoredValueNumMoved.store(0);
 
         compressorNumVisited.store(0);
         compressorNumCompressed.store(0);
@@ -544,6 +660,7 @@ public:
         notifyIOHisto.reset();
         getStatsCmdHisto.reset();
         chkPersistenceHisto.reset();
+        seqnoPersistenceHisto.reset();
         diskInsertHisto.reset();
         diskUpdateHisto.reset();
         diskDelHisto.reset();
@@ -560,6 +677,8 @@ public:
         replicaFrequencyValuesEvictedHisto.reset();
         activeOrPendingFrequencyValuesSnapshotHisto.reset();
         replicaFrequencyValuesSnapshotHisto.reset();
+
+        lockProfiles.reset();
     }
 
     // Used by stats logging infrastructure.
@@ -585,6 +704,23 @@ protected:
      */
     void calculateMemUsedMergeThreshold();
 
+    /**
+     * @param refresh read the arena now, rather than only if the last read
+     *        is older than ArenaReadInterval
+     * @return the bytes allocated from the bucket's arena
+     */
+    size_t getArenaMemoryUsed(bool refresh) const;
+
+    /// Reading the arena's stats is too costly for every memory check, so
+    /// the last read is reused for this long.
+    static const std::chrono::microseconds ArenaReadInterval;
+
+    //! Allocator arena the bucket allocates from, 0 if none.
+    std::atomic<unsigned> memoryArena{0};
+    size_t (*getArenaAllocated)(unsigned) = nullptr;
+    //! When the arena was last read (steady_clock, in microseconds).
+    mutable std::atomic<int64_t> arenaReadTime{0};
+
     //! Max allowable memory size.
     std::atomic<size_t> maxDataSize;
 
@@ -645,6 +781,9 @@ public:
 
     //! Total number of Item objects
     Counter numItem;
+
+    //! Memory used by the items queued in checkpoints.
+    Counter checkpointMemory;
 };
 
 /**
@@ -29,6 +29,8 @@
 #include <atomic>
 #include <cstring>
 #include <sstream>
+#include <string>
+#include <type_traits>
 
 class EventuallyPersistentEngine;
 
@@ -40,14 +42,122 @@ inline void add_casted_stat(const char *k, const char *v,
     ObjectRegistry::onSwitchThread(e);
 }
 
+/// @cond DETAILS
+namespace statwriter {
+
+/**
+ * Add an integer stat, formatted into a buffer on the stack. There are
+ * thousands of these in a full set of stats (e.g. "vbucket-details" of 1024
+ * vBuckets) so they avoid the heap allocations of a stringstream.
+ */
+inline void add_integer_stat(const char* k,
+                             bool negative,
+                             unsigned long long magnitude,
+                             ADD_STAT add_stat,
+                             const void* cookie) {
+    char buf[24];
+    char* const end = buf + sizeof(buf);
+    char* begin = end;
+    do {
+        *--begin = char('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (negative) {
+        *--begin = '-';
+    }
+
+    EventuallyPersistentEngine* e = ObjectRegistry::onSwitchThread(NULL, true);
+    add_stat(k,
+             static_cast<uint16_t>(strlen(k)),
+             begin,
+             static_cast<uint32_t>(end - begin),
+             cookie);
+    ObjectRegistry::onSwitchThread(e);
+}
+
 template <typename T>
-void add_casted_stat(const char *k, const T &v,
-                            ADD_STAT add_stat, const void *cookie) {
+void add_integer_stat(const char* k,
+                      const T& v,
+                      ADD_STAT add_stat,
+                      const void* cookie,
+                      std::true_type /* signed */) {
+    const auto value = static_cast<long long>(v);
+    const auto magnitude = static_cast<unsigned long long>(value);
+    add_integer_stat(
+            k, value < 0, value < 0 ? 0 - magnitude : magnitude, add_stat, cookie);
+}
+
+template <typename T>
+void add_integer_stat(const char* k,
+                      const T& v,
+                      ADD_STAT add_stat,
+                      const void* cookie,
+                      std::false_type /* signed */) {
+    add_integer_stat(
+            k, false, static_cast<unsigned long long>(v), add_stat, cookie);
+}
+
+/**
+ * Integers wider than a char (which the streams print as a character) are
+ * formatted directly; everything else is streamed.
+ */
+template <typename T>
+using is_formatted_integer =
+        std::integral_constant<bool,
+                               std::is_integral<T>::value && (sizeof(T) > 1)>;
+
+template <typename T>
+void add_value_stat(const char* k,
+                    const T& v,
+                    ADD_STAT add_stat,
+                    const void* cookie,
+                    std::true_type /* formatted integer */) {
+    add_integer_stat(k, v, add_stat, cookie, std::is_signed<T>());
+}
+
+template <typename T>
+void add_value_stat(const char* k,
+                    const T& v,
+                    ADD_STAT add_stat,
+                    const void* cookie,
+                    std::false_type /* formatted integer */) {
     std::stringstream vals;
     vals << v;
     add_casted_stat(k, vals.str().c_str(), add_stat, cookie);
 }
 
+/// @return "<prefix>:<name>"
+inline std::string make_stat_name(const std::string& prefix, const char* nm) {
+    std::string name;
+    name.reserve(prefix.size() + 1 + strlen(nm));
+    name.append(prefix).append(1, ':').append(nm);
+    return name;
+}
+
+inline std::string make_stat_name(const char* prefix, const char* nm) {
+    std::string name;
+    name.reserve(strlen(prefix) + 1 + strlen(nm));
+    name.append(prefix).append(1, ':').append(nm);
+    return name;
+}
+
+template <typename P>
+std::string make_stat_name(const P& prefix, const char* nm) {
+    std::stringstream name;
+    name << prefix << ":" << nm;
+    return name.str();
+}
+
+} // namespace statwriter
+/// @endcond
+
+template <typename T>
+void add_casted_stat(const char *k, const T &v,
+                            ADD_STAT add_stat, const void *cookie) {
+    statwriter::add_value_stat(
+            k, v, add_stat, cookie, statwriter::is_formatted_integer<T>());
+}
+
 inline void add_casted_stat(const char *k, const bool v,
                             ADD_STAT add_stat, const void *cookie) {
     add_casted_stat(k, v ? "true" : "false", add_stat, cookie);
@@ -127,10 +237,10 @@ void add_casted_stat(const char* k,
 template <typename P, typename T>
 void add_prefixed_stat(P prefix, const char *nm, T val,
                   ADD_STAT add_stat, const void *cookie) {
-    std::stringstream name;
-    name << prefix << ":" << nm;
-
-    add_casted_stat(name.str().c_str(), val, add_stat, cookie);
+    add_casted_stat(statwriter::make_stat_name(prefix, nm).c_str(),
+                    val,
+                    add_stat,
+                    cookie);
 }
 
 template <typename P, typename T, template <class> class Limits>
@@ -139,8 +249,37 @@ void add_prefixed_stat(P prefix,
                        Histogram<T, Limits>& val,
                        ADD_STAT add_stat,
                        const void* cookie) {
-    std::stringstream name;
-    name << prefix << ":" << nm;
+    add_casted_stat(statwriter::make_stat_name(prefix, nm).c_str(),
+                    val,
+                    add_stat,
+                    cookie);
+}
 
-    add_casted_stat(name.str().c_str(), val, add_stat, cookie);
+/**
+ * Add the count and the p50 / p90 / p99 / p99.9 / max values of a histogram
+ * of microsecond durations, as "<prefix>_count", "<prefix>_p50_us" etc.
+ */
+inline void add_percentile_stats(const std::string& prefix,
+                                 const HdrHistogram& histogram,
+                                 ADD_STAT add_stat,
+                                 const void* cookie) {
+    add_casted_stat((prefix + "_count").c_str(),
+                    histogram.getValueCount(),
+                    add_stat,
+                    cookie);
+    if (histogram.getValueCount() == 0) {
+        return;
+    }
+    const std::pair<const char*, double> percentiles[] = {
+            {"_p50_us", 50.0},
+            {"_p90_us", 90.0},
+            {"_p99_us", 99.0},
+            {"_p99.9_us", 99.9},
+            {"_max_us", 100.0}};
+    for (const auto& p : percentiles) {
+        add_casted_stat((prefix + p.first).c_str(),
+                        histogram.getValueAtPercentile(p.second),
+                        add_stat,
+                        cookie);
+    }
 }
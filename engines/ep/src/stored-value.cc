@@ -23,10 +23,13 @@
 #include "item.h"
 #include "objectregistry.h"
 #include "stats.h"
+#include "stored_value_arena.h"
 
 #include <platform/cb_malloc.h>
 #include <platform/compress.h>
 
+#include <cstring>
+
 const int64_t StoredValue::state_pending_seqno = -2;
 const int64_t StoredValue::state_deleted_key = -3;
 const int64_t StoredValue::state_non_existent_key = -4;
@@ -36,7 +39,8 @@ const int64_t StoredValue::state_collection_open = -6;
 StoredValue::StoredValue(const Item& itm,
                          UniquePtr n,
                          EPStats& stats,
-                         bool isOrdered)
+                         bool isOrdered,
+                         uint8_t inlineCapacity)
     : value(itm.getValue()),
       chain_next_or_replacement(std::move(n)),
       cas(itm.getCas()),
@@ -61,6 +65,20 @@ StoredValue::StoredValue(const Item& itm,
     // object.
     new (key()) SerialisedDocKey(itm.getKey());
 
+    if (inlineCapacity) {
+        if (isOrdered) {
+            throw std::invalid_argument(
+                    "StoredValue::StoredValue: inline values are not "
+                    "supported for OrderedStoredValue");
+        }
+        bits2.set(inlineRegionIndex, true);
+        setInlineValue(false);
+        auto* region = inlineRegion();
+        region[inlineCapacityOffset] = static_cast<char>(inlineCapacity);
+        region[inlineLengthOffset] = 0;
+        moveValueInline();
+    }
+
     if (isTempInitialItem()) {
         markClean();
     } else {
@@ -100,6 +118,13 @@ StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
     setResident(other.isResident());
     setStale(false);
     setCommitted(other.getCommitted());
+    // The copy never has an inline region; move any inline value to a Blob.
+    bits2.set(inlineRegionIndex, false);
+    setInlineValue(false);
+    if (other.hasInlineValue()) {
+        const auto data = other.getValueData();
+        replaceValue(TaggedPtr<Blob>(Blob::New(data.data(), data.size())));
+    }
     // Placement-new the key which lives in memory directly after this
     // object.
     StoredDocKey sKey(other.getKey());
@@ -163,6 +188,8 @@ void StoredValue::restoreValue(const Item& itm) {
     datatype = itm.getDataType();
     setDeletedPriv(itm.isDeleted());
     value = itm.getValue(); // Implicitly also copies the frequency counter
+    setInlineValue(false);
+    moveValueInline();
     setResident(true);
 }
 
@@ -187,17 +214,43 @@ void StoredValue::restoreMeta(const Item& itm) {
 }
 
 size_t StoredValue::uncompressedValuelen() const {
-    if (!value) {
+    if (!hasValue()) {
         return 0;
     }
     if (mcbp::datatype::is_snappy(datatype)) {
         return cb::compression::get_uncompressed_length(
-                cb::compression::Algorithm::Snappy,
-                {value->getData(), value->valueSize()});
+                cb::compression::Algorithm::Snappy, getValueData());
     }
     return valuelen();
 }
 
+cb::const_char_buffer StoredValue::getValueData() const {
+    if (hasInlineValue()) {
+        const auto* region = inlineRegion();
+        return {region + inlineDataOffset,
+                uint8_t(region[inlineLengthOffset])};
+    }
+    if (value) {
+        return {value->getData(), value->valueSize()};
+    }
+    return {};
+}
+
+void StoredValue::moveValueInline() {
+    if (!hasInlineRegion() || !value || value->valueSize() == 0) {
+        return;
+    }
+    auto* region = inlineRegion();
+    const size_t length = value->valueSize();
+    if (length > uint8_t(region[inlineCapacityOffset])) {
+        return;
+    }
+    std::memcpy(region + inlineDataOffset, value->getData(), length);
+    region[inlineLengthOffset] = static_cast<char>(length);
+    replaceValue(TaggedPtr<Blob>());
+    setInlineValue(true);
+}
+
 bool StoredValue::del(DeleteSource delSource) {
     if (isOrdered()) {
         return static_cast<OrderedStoredValue*>(this)->deleteImpl(delSource);
@@ -210,6 +263,14 @@ size_t StoredValue::getRequiredStorage(const DocKey& key) {
     return sizeof(StoredValue) + SerialisedDocKey::getObjectSize(key.size());
 }
 
+size_t StoredValue::getRequiredStorage(const DocKey& key,
+                                       uint8_t inlineCapacity) {
+    if (inlineCapacity == 0) {
+        return getRequiredStorage(key);
+    }
+    return getRequiredStorage(key) + inlineDataOffset + inlineCapacity;
+}
+
 std::unique_ptr<Item> StoredValue::toItem(bool lck, Vbid vbucket) const {
     return toItemImpl(lck, vbucket, false);
 }
@@ -219,6 +280,10 @@ std::unique_ptr<Item> StoredValue::toItemKeyOnly(Vbid vbucket) const {
 }
 
 void StoredValue::reallocate() {
+    if (!value) {
+        // Nothing allocated externally (inline or no value).
+        return;
+    }
     // Allocate a new Blob for this stored value; copy the existing Blob to
     // the new one and free the old.
     value_t new_val(Blob::Copy(*value));
@@ -228,6 +293,9 @@ void StoredValue::reallocate() {
 void StoredValue::Deleter::operator()(StoredValue* val) {
     if (val->isOrdered()) {
         delete static_cast<OrderedStoredValue*>(val);
+    } else if (val->bits2.test(arenaAllocatedIndex)) {
+        val->~StoredValue();
+        StoredValueArena::deallocate(val);
     } else {
         delete val;
     }
@@ -261,7 +329,7 @@ bool StoredValue::operator==(const StoredValue& other) const {
 }
 
 bool StoredValue::deleteImpl(DeleteSource delSource) {
-    if (isDeleted() && !getValue()) {
+    if (isDeleted() && !hasValue()) {
         // SV is already marked as deleted and has no value - no further
         // deletion possible.
         return false;
@@ -281,11 +349,22 @@ bool StoredValue::deleteImpl(DeleteSource delSource) {
 std::unique_ptr<Item> StoredValue::toItemImpl(bool lock,
                                               Vbid vbucket,
                                               bool keyOnly) const {
+    // Items can outlive this object, so an inline value is copied out to
+    // a Blob of its own.
+    value_t itemValue;
+    if (!keyOnly) {
+        if (hasInlineValue()) {
+            const auto data = getValueData();
+            itemValue.reset(Blob::New(data.data(), data.size()));
+        } else {
+            itemValue = value;
+        }
+    }
     auto itm =
             std::make_unique<Item>(getKey(),
                                    getFlags(),
                                    getExptime(),
-                                   keyOnly ? value_t{} : value,
+                                   itemValue,
                                    datatype,
                                    lock ? static_cast<uint64_t>(-1) : getCas(),
                                    bySeqno,
@@ -331,10 +410,15 @@ void StoredValue::setValueImpl(const Item& itm) {
     } else {
         setResident(true);
         replaceValue(itm.getValue().get());
+        moveValueInline();
     }
 }
 
 bool StoredValue::compressValue() {
+    if (hasInlineValue()) {
+        // Too small to be worth compressing; leave as is.
+        return true;
+    }
     if (!mcbp::datatype::is_snappy(datatype)) {
         // Attempt compression only if datatype indicates
         // that the value is not compressed already
@@ -383,9 +467,10 @@ boost::optional<item_info> StoredValue::getItemInfo(uint64_t vbuuid) const {
     info.datatype = datatype;
     info.document_state =
             isDeleted() ? DocumentState::Deleted : DocumentState::Alive;
-    if (getValue()) {
-        info.value[0].iov_base = const_cast<char*>(getValue()->getData());
-        info.value[0].iov_len = getValue()->valueSize();
+    if (hasValue()) {
+        const auto data = getValueData();
+        info.value[0].iov_base = const_cast<char*>(data.data());
+        info.value[0].iov_len = data.size();
     }
     info.key = getKey();
     return info;
@@ -434,15 +519,15 @@ std::ostream& operator<<(std::ostream& os, const StoredValue& sv) {
     }
 
     os << " vallen:" << sv.valuelen();
-    if (sv.getValue().get()) {
-        os << " val:\"";
-        const char* data = sv.getValue()->getData();
+    if (sv.hasValue()) {
+        os << (sv.hasInlineValue() ? " inline" : "") << " val:\"";
+        const auto value = sv.getValueData();
         // print up to first 40 bytes of value.
-        const size_t limit = std::min(size_t(40), sv.getValue()->valueSize());
+        const size_t limit = std::min(size_t(40), value.size());
         for (size_t ii = 0; ii < limit; ii++) {
-            os << data[ii];
+            os << value.data()[ii];
         }
-        if (limit < sv.getValue()->valueSize()) {
+        if (limit < value.size()) {
             os << " <cut>";
         }
         os << "\"";
@@ -83,6 +83,27 @@ class OrderedStoredValue;
  *   length  {   | ...               |
  *               +-------------------+
  *
+ * Inline values
+ * =============
+ *
+ * StoredValueFactory can optionally (ht_inline_value_size) reserve a small
+ * inline value region after the key. Values which fit are then stored there
+ * instead of in a separate Blob, saving the Blob allocation (and its header)
+ * for small documents such as counters:
+ *
+ *               + - - - - - - - - - +
+ *  variable {   | key[]             |
+ *   length  {   + - - - - - - - - - +
+ *           {   | inline capacity   | 1 byte
+ *           {   | inline length     | 1 byte
+ *           {   | inline data[]     | capacity bytes
+ *               +-------------------+
+ *
+ * When the value is inline `value` is null; use hasValue() / getValueData()
+ * rather than getValue() to access the value independent of where it lives.
+ * A value which no longer fits (or is ejected) moves out to a Blob; the
+ * region stays allocated for the lifetime of the object.
+ *
  * OrderedStoredValue
  * ==================
  *
@@ -188,14 +209,28 @@ public:
         return chain_next_or_replacement.get().getTag();
     }
 
-    // Set the frequency counter value to the input value
+    // Set the frequency counter value to the input value. The counter is the
+    // low 8 bits of the value pointer's tag, the high 8 bits are the
+    // counter's decay epoch (see HashTable::applyFreqDecay).
     void setFreqCounterValue(uint16_t newValue) {
-        value.unsafeGetPointer().setTag(newValue);
+        auto& ptr = value.unsafeGetPointer();
+        ptr.setTag((ptr.getTag() & 0xff00) | (newValue & 0xff));
     }
 
     // Gets the frequency counter value
     uint16_t getFreqCounterValue() const {
-        return value.get().getTag();
+        return value.get().getTag() & 0xff;
+    }
+
+    // Set the decay epoch of the HashTable the frequency counter is up to
+    // date with.
+    void setFreqDecayEpoch(uint8_t epoch) {
+        auto& ptr = value.unsafeGetPointer();
+        ptr.setTag((uint16_t(epoch) << 8) | (ptr.getTag() & 0xff));
+    }
+
+    uint8_t getFreqDecayEpoch() const {
+        return value.get().getTag() >> 8;
     }
 
     void referenced();
@@ -230,7 +265,9 @@ public:
      *                  value exists but has zero length
      */
     bool isCompressible() {
-        if (mcbp::datatype::is_snappy(datatype) || !valuelen()) {
+        if (mcbp::datatype::is_snappy(datatype) || !valuelen() ||
+            hasInlineValue() || value->isTiered()) {
+            // Replacing a tiered value would move it back to DRAM.
             return false;
         }
         return value->isCompressible();
@@ -238,7 +275,9 @@ public:
 
     bool eligibleForEviction(item_eviction_policy_t policy) const {
         if (policy == VALUE_ONLY) {
-            return isResident() && !isDirty() && !isDeleted();
+            // Ejecting an inline value wouldn't free any memory.
+            return isResident() && !isDirty() && !isDeleted() &&
+                   !hasInlineValue();
         } else {
             return !isDirty() && !isDeleted();
         }
@@ -276,12 +315,42 @@ public:
     }
 
     /**
-     * Get this item's value.
+     * Get this item's value Blob. Null if the value is not resident, or is
+     * stored inline (see hasInlineValue()).
      */
     const value_t &getValue() const {
         return value;
     }
 
+    /**
+     * True if the value is stored inline, in the same allocation as this
+     * object, instead of in a Blob.
+     */
+    bool hasInlineValue() const {
+        return bits2.test(inlineValueIndex);
+    }
+
+    /**
+     * True if this object was allocated from a StoredValueArena (instead of
+     * individually).
+     */
+    bool isArenaAllocated() const {
+        return bits2.test(arenaAllocatedIndex);
+    }
+
+    /**
+     * True if this item has a (resident) value - either a Blob or inline.
+     */
+    bool hasValue() const {
+        return value || hasInlineValue();
+    }
+
+    /**
+     * Get the data of the resident value, wherever it is stored. Empty if
+     * there is no value.
+     */
+    cb::const_char_buffer getValueData() const;
+
     /**
      * Get the expiration time of this item.
      *
@@ -489,6 +558,9 @@ public:
      }
 
     size_t valuelen() const {
+        if (hasInlineValue()) {
+            return uint8_t(inlineRegion()[inlineLengthOffset]);
+        }
         if (!value) {
             return 0;
         }
@@ -507,7 +579,8 @@ public:
      * @return the amount of memory used by this item.
      */
     size_t size() const {
-        return getObjectSize() + valuelen();
+        // An inline value is already accounted for by getObjectSize().
+        return getObjectSize() + (hasInlineValue() ? 0 : valuelen());
     }
 
     /**
@@ -518,7 +591,8 @@ public:
      * For uncompressed items this is the same as size().
      */
     size_t uncompressedSize() const {
-        return getObjectSize() + uncompressedValuelen();
+        return getObjectSize() +
+               (hasInlineValue() ? 0 : uncompressedValuelen());
     }
 
     size_t metaDataSize() const {
@@ -559,14 +633,17 @@ public:
     /// Discard the value from this document.
     void resetValue() {
         value.reset();
+        setInlineValue(false);
     }
 
     /// Replace the existing value with new data.
     void replaceValue(TaggedPtr<Blob> data) {
-        // Maintain the frequency count for the storedValue.
-        auto freqCount = getFreqCounterValue();
+        // Maintain the frequency count (and its decay epoch) for the
+        // storedValue.
+        const auto tag = value.get().getTag();
         value.reset(data);
-        setFreqCounterValue(freqCount);
+        value.unsafeGetPointer().setTag(tag);
+        setInlineValue(false);
     }
 
     /**
@@ -692,7 +769,8 @@ public:
 
     /**
      * Return the size in byte of this object; both the fixed fields and the
-     * variable-length key. Doesn't include value size (allocated externally).
+     * variable-length key, plus the inline value region if present. Doesn't
+     * include the size of a Blob value (allocated externally).
      */
     inline size_t getObjectSize() const;
 
@@ -723,6 +801,13 @@ public:
     /// Return how many bytes are need to store item given key as a StoredValue
     static size_t getRequiredStorage(const DocKey& key);
 
+    /**
+     * Return how many bytes are needed to store an item with the given key
+     * as a StoredValue with an inline value region of the given capacity.
+     */
+    static size_t getRequiredStorage(const DocKey& key,
+                                     uint8_t inlineCapacity);
+
     /**
      * @return the deletion source of the stored value
      */
@@ -753,11 +838,14 @@ protected:
      *           which the new item is being inserted).
      * @param stats EPStats to update for this new StoredValue
      * @param isOrdered Are we constructing an OrderedStoredValue?
+     * @param inlineCapacity Size of the inline value region allocated after
+     *        the key (zero for none). Not supported for OrderedStoredValue.
      */
     StoredValue(const Item& itm,
                 UniquePtr n,
                 EPStats& stats,
-                bool isOrdered);
+                bool isOrdered,
+                uint8_t inlineCapacity = 0);
 
     // Destructor. protected, as needs to be carefully deleted (via
     // StoredValue::Destructor) depending on the value of isOrdered flag.
@@ -786,6 +874,35 @@ protected:
      */
     inline SerialisedDocKey* key();
 
+    /**
+     * Get the address of the inline value region (following the key). Only
+     * valid if hasInlineRegion().
+     */
+    char* inlineRegion() {
+        return reinterpret_cast<char*>(key()) + key()->getObjectSize();
+    }
+    const char* inlineRegion() const {
+        return const_cast<StoredValue&>(*this).inlineRegion();
+    }
+
+    /**
+     * If the current Blob value fits in the inline region, copy it there and
+     * release the Blob.
+     */
+    void moveValueInline();
+
+    bool hasInlineRegion() const {
+        return bits2.test(inlineRegionIndex);
+    }
+
+    void setInlineValue(bool value) {
+        bits2.set(inlineValueIndex, value);
+    }
+
+    void setArenaAllocated(bool value) {
+        bits2.set(arenaAllocatedIndex, value);
+    }
+
     /**
      * Logically mark this SV as deleted.
      * Implementation for StoredValue instances (dispatched to by del() based
@@ -900,13 +1017,26 @@ protected:
     /**
      * Much like bits, bits2 consists of compressed members inside an
      * AtomicBitSet and utilises spare bits left by padding inside StoredValue.
-     * Currently, only 1 of the 8 available bits is used.
+     * Currently, 5 of the 8 available bits are used.
      */
     // If the stored value is deleted, this stores the source of its deletion.
     static constexpr size_t deletionSource = 0;
     /// Clear if the StoredValue is pending; set if the StoredValue is
     /// committed.
     static constexpr size_t committedIndex = 1;
+    /// Set if an inline value region was allocated after the key. Fixed for
+    /// the lifetime of the object.
+    static constexpr size_t inlineRegionIndex = 2;
+    /// Set if the value is currently stored in the inline region.
+    static constexpr size_t inlineValueIndex = 3;
+    /// Set if this object was allocated from a StoredValueArena (and hence
+    /// must be freed back to it).
+    static constexpr size_t arenaAllocatedIndex = 4;
+
+    // Layout of the inline value region.
+    static constexpr size_t inlineCapacityOffset = 0;
+    static constexpr size_t inlineLengthOffset = 1;
+    static constexpr size_t inlineDataOffset = 2;
 
     folly::AtomicBitSet<sizeof(uint8_t)> bits2;
 
@@ -1068,5 +1198,10 @@ size_t StoredValue::getObjectSize() const {
     if (isOrdered()) {
         return sizeof(OrderedStoredValue) + getKey().getObjectSize();
     }
-    return sizeof(*this) + getKey().getObjectSize();
+    size_t result = sizeof(*this) + getKey().getObjectSize();
+    if (hasInlineRegion()) {
+        result += inlineDataOffset +
+                  uint8_t(inlineRegion()[inlineCapacityOffset]);
+    }
+    return result;
 }
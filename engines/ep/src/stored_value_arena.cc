@@ -0,0 +1,164 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "stored_value_arena.h"
+
+#include <new>
+
+/**
+ * Header of a slab, followed by its chunks. Each chunk starts with a pointer
+ * back to the slab, followed by the object.
+ */
+struct StoredValueArena::Slab {
+    Slab(std::shared_ptr<Classes> classes, size_t chunkSize)
+        : classes(std::move(classes)), chunkSize(chunkSize) {
+    }
+
+    static size_t headerSize() {
+        return (sizeof(Slab) + sizeClassGranularity - 1) /
+               sizeClassGranularity * sizeClassGranularity;
+    }
+
+    char* begin() {
+        return reinterpret_cast<char*>(this) + headerSize();
+    }
+
+    bool hasSpace() const {
+        return headerSize() + carved + chunkSize <= slabSize;
+    }
+
+    SizeClass& sizeClass() {
+        return (*classes)[chunkSize / sizeClassGranularity - 1];
+    }
+
+    const std::shared_ptr<Classes> classes;
+    const size_t chunkSize;
+    /// Number of objects allocated from this slab and not yet freed.
+    /// Guarded by the size class' mutex.
+    size_t live = 0;
+    /// Bytes (from begin()) already carved into chunks. Guarded by the size
+    /// class' mutex.
+    size_t carved = 0;
+};
+
+StoredValueArena::StoredValueArena() : classes(std::make_shared<Classes>()) {
+}
+
+StoredValueArena::~StoredValueArena() {
+    for (auto& sizeClass : *classes) {
+        std::vector<Slab*> unused;
+        {
+            std::lock_guard<std::mutex> guard(sizeClass.mutex);
+            sizeClass.alive = false;
+            sizeClass.freeList = nullptr;
+            sizeClass.current = nullptr;
+            for (auto* slab : sizeClass.slabs) {
+                if (slab->live == 0) {
+                    unused.push_back(slab);
+                }
+            }
+            // Slabs with live objects are now orphaned; freed by
+            // deallocate() along with their last object.
+            sizeClass.slabs.clear();
+        }
+        for (auto* slab : unused) {
+            freeSlab(slab);
+        }
+    }
+}
+
+void* StoredValueArena::allocate(size_t size) {
+    const size_t chunkSize =
+            (size + sizeof(Slab*) + sizeClassGranularity - 1) /
+            sizeClassGranularity * sizeClassGranularity;
+    if (chunkSize > maxChunkSize) {
+        return nullptr;
+    }
+
+    auto& sizeClass = (*classes)[chunkSize / sizeClassGranularity - 1];
+    std::lock_guard<std::mutex> guard(sizeClass.mutex);
+
+    char* chunk;
+    if (sizeClass.freeList) {
+        auto* free = sizeClass.freeList;
+        sizeClass.freeList = free->next;
+        chunk = reinterpret_cast<char*>(free) - sizeof(Slab*);
+    } else {
+        if (!sizeClass.current || !sizeClass.current->hasSpace()) {
+            sizeClass.slabs.reserve(sizeClass.slabs.size() + 1);
+            auto* slab = new (::operator new(slabSize)) Slab(classes, chunkSize);
+            sizeClass.slabs.push_back(slab);
+            sizeClass.current = slab;
+        }
+        auto* slab = sizeClass.current;
+        chunk = slab->begin() + slab->carved;
+        slab->carved += chunkSize;
+        *reinterpret_cast<Slab**>(chunk) = slab;
+    }
+
+    ++(*reinterpret_cast<Slab**>(chunk))->live;
+    return chunk + sizeof(Slab*);
+}
+
+void StoredValueArena::deallocate(void* ptr) {
+    auto* slab = *reinterpret_cast<Slab**>(static_cast<char*>(ptr) -
+                                           sizeof(Slab*));
+
+    // Keeps the size classes (and hence the mutex below) alive if this
+    // frees the last slab referencing them.
+    std::shared_ptr<Classes> keepAlive;
+    auto& sizeClass = slab->sizeClass();
+    std::lock_guard<std::mutex> guard(sizeClass.mutex);
+    --slab->live;
+
+    if (sizeClass.alive) {
+        auto* free = new (ptr) FreeChunk;
+        free->next = sizeClass.freeList;
+        sizeClass.freeList = free;
+        return;
+    }
+
+    if (slab->live == 0) {
+        keepAlive = slab->classes;
+        freeSlab(slab);
+    }
+}
+
+size_t StoredValueArena::getNumSlabs() const {
+    size_t result = 0;
+    for (const auto& sizeClass : *classes) {
+        std::lock_guard<std::mutex> guard(sizeClass.mutex);
+        result += sizeClass.slabs.size();
+    }
+    return result;
+}
+
+size_t StoredValueArena::getNumAllocated() const {
+    size_t result = 0;
+    for (const auto& sizeClass : *classes) {
+        std::lock_guard<std::mutex> guard(sizeClass.mutex);
+        for (const auto* slab : sizeClass.slabs) {
+            result += slab->live;
+        }
+    }
+    return result;
+}
+
+void StoredValueArena::freeSlab(Slab* slab) {
+    slab->~Slab();
+    ::operator delete(slab);
+}
@@ -0,0 +1,112 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Size-classed slab allocator for the StoredValues of one vBucket.
+ *
+ * Instead of allocating each StoredValue individually from the general
+ * purpose allocator, objects are carved out of fixed-size slabs, one set of
+ * slabs per size class (rounded up to sizeClassGranularity). Freed objects
+ * are kept on a per-class free list and reused, so the StoredValues of a
+ * vBucket stay packed together rather than being interleaved with (and
+ * fragmenting) the rest of the heap.
+ *
+ * Slabs are obtained from the normal allocator, and so are accounted in the
+ * bucket's memory usage (via MemoryTracker / ObjectRegistry) like any other
+ * allocation - including the free space in partly used slabs.
+ *
+ * Each allocation is prefixed by a pointer to its slab, which allows it to
+ * be freed via the static deallocate() without knowing the arena. The
+ * arena may be destroyed before everything allocated from it has been
+ * freed; slabs which still have live objects are then freed once their last
+ * object is.
+ */
+class StoredValueArena {
+public:
+    /// Size of each slab (including its header).
+    static constexpr size_t slabSize = 64 * 1024;
+    /// Allocation sizes are rounded up to a multiple of this.
+    static constexpr size_t sizeClassGranularity = 16;
+    /// Largest allocation (including the slab pointer) served from slabs.
+    static constexpr size_t maxChunkSize = 512;
+
+    StoredValueArena();
+
+    ~StoredValueArena();
+
+    StoredValueArena(const StoredValueArena&) = delete;
+    StoredValueArena& operator=(const StoredValueArena&) = delete;
+
+    /**
+     * Allocate memory for an object of the given size.
+     *
+     * @return the allocated memory, or nullptr if size is too large to be
+     *         served by the arena (caller should use the normal allocator).
+     */
+    void* allocate(size_t size);
+
+    /**
+     * Free memory previously returned by allocate() of any arena.
+     */
+    static void deallocate(void* ptr);
+
+    /// @return the number of slabs currently owned by this arena.
+    size_t getNumSlabs() const;
+
+    /// @return the number of allocated (and not yet freed) objects.
+    size_t getNumAllocated() const;
+
+private:
+    struct Slab;
+
+    /// Free chunks are linked through the memory of the object.
+    struct FreeChunk {
+        FreeChunk* next;
+    };
+
+    struct SizeClass {
+        mutable std::mutex mutex;
+        /// False once the owning arena has been destroyed.
+        bool alive = true;
+        /// Slab new chunks are carved from once the free list is empty.
+        Slab* current = nullptr;
+        FreeChunk* freeList = nullptr;
+        /// All slabs of this class owned by the arena.
+        std::vector<Slab*> slabs;
+    };
+
+    static constexpr size_t numSizeClasses =
+            maxChunkSize / sizeClassGranularity;
+
+    /**
+     * The size classes, shared with every slab so that objects freed after
+     * the arena is destroyed can still find (and lock) their class.
+     */
+    using Classes = std::array<SizeClass, numSizeClasses>;
+
+    static void freeSlab(Slab* slab);
+
+    std::shared_ptr<Classes> classes;
+};
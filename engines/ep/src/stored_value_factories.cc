@@ -21,14 +21,43 @@
 
 StoredValue::UniquePtr StoredValueFactory::operator()(
         const Item& itm, StoredValue::UniquePtr next) {
+    // Only reserve an inline region for items whose value fits; so items
+    // with large values don't pay for it.
+    uint8_t inlineCapacity = 0;
+    const auto& value = itm.getValue();
+    if (value && value->valueSize() > 0 &&
+        value->valueSize() <= inlineValueSize) {
+        inlineCapacity = inlineValueSize;
+    }
+
     // Allocate a buffer to store the StoredValue and any trailing bytes
-    // that maybe required.
+    // that maybe required; from the arena if in use (and the object isn't
+    // too large for it).
+    const size_t size =
+            StoredValue::getRequiredStorage(itm.getKey(), inlineCapacity);
+    void* buffer = arena ? arena->allocate(size) : nullptr;
+    const bool fromArena = buffer != nullptr;
+    if (!fromArena) {
+        buffer = ::operator new(size);
+    }
+
+    auto* sv = new (buffer) StoredValue(itm,
+                                        std::move(next),
+                                        *stats,
+                                        /*isOrdered*/ false,
+                                        inlineCapacity);
+    sv->setArenaAllocated(fromArena);
+    return StoredValue::UniquePtr(sv);
+}
+
+StoredValue::UniquePtr StoredValueFactory::copyStoredValue(
+        const StoredValue& other, StoredValue::UniquePtr next) {
+    // Allocate a buffer to store the copy of the StoredValue and any
+    // trailing bytes required for the key (the copy has no inline region).
     return StoredValue::UniquePtr(
-            new (::operator new(StoredValue::getRequiredStorage(itm.getKey())))
-                    StoredValue(itm,
-                                std::move(next),
-                                *stats,
-                                /*isOrdered*/ false));
+            new (::operator new(StoredValue::getRequiredStorage(
+                    other.getKey(), /*inlineCapacity*/ 0)))
+                    StoredValue(other, std::move(next), *stats));
 }
 
 StoredValue::UniquePtr OrderedStoredValueFactory::operator()(
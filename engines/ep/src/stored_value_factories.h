@@ -24,6 +24,7 @@
 #include <memory>
 
 #include "stored-value.h"
+#include "stored_value_arena.h"
 
 /**
  * Abstract base class for StoredValue factories.
@@ -63,7 +64,21 @@ class StoredValueFactory : public AbstractStoredValueFactory {
 public:
     using value_type = StoredValue;
 
-    StoredValueFactory(EPStats& s) : stats(&s) {
+    /**
+     * @param s EPStats to update for created StoredValues
+     * @param inlineValueSize If non-zero, each StoredValue created for an
+     *        item whose value is at most this many bytes is allocated with
+     *        an inline value region of that size, avoiding a separate Blob.
+     * @param useArena If true, StoredValues are allocated from a
+     *        StoredValueArena owned by this factory (and so shared by the
+     *        vBucket's HashTable) instead of individually.
+     */
+    StoredValueFactory(EPStats& s,
+                       uint8_t inlineValueSize = 0,
+                       bool useArena = false)
+        : stats(&s),
+          inlineValueSize(inlineValueSize),
+          arena(useArena ? std::make_unique<StoredValueArena>() : nullptr) {
     }
 
     /**
@@ -72,13 +87,18 @@ public:
     StoredValue::UniquePtr operator()(const Item& itm,
                                       StoredValue::UniquePtr next) override;
 
-    StoredValue::UniquePtr copyStoredValue(const StoredValue& other,
-                                           StoredValue::UniquePtr next) override {
-        throw std::logic_error("Copy of StoredValue is not supported");
-    }
+    /**
+     * Create a copy of the given StoredValue. The copy is always allocated
+     * individually and without an inline value region (any inline value is
+     * moved to a Blob).
+     */
+    StoredValue::UniquePtr copyStoredValue(
+            const StoredValue& other, StoredValue::UniquePtr next) override;
 
 private:
     EPStats* stats;
+    const uint8_t inlineValueSize;
+    const std::unique_ptr<StoredValueArena> arena;
 };
 
 /**
@@ -0,0 +1,130 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "task_profile.h"
+
+#include "statwriter.h"
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+// Track from 1us to an hour, to 2 significant figures.
+static const uint64_t MaxTrackedMicros = 3600ULL * 1000 * 1000;
+
+static uint64_t toMicros(steady_clock::duration d) {
+    const auto us = duration_cast<microseconds>(d).count();
+    return std::min(uint64_t(std::max(us, decltype(us)(1))), MaxTrackedMicros);
+}
+
+TaskProfile::Histograms::Histograms()
+    : runtime(1, MaxTrackedMicros, 2), delay(1, MaxTrackedMicros, 2) {
+}
+
+TaskProfile::TaskProfile(size_t maxSlowRuns) : maxSlowRuns(maxSlowRuns) {
+}
+
+TaskProfile::Histograms& TaskProfile::getHistograms(TaskId id) {
+    auto& entry = histograms[static_cast<size_t>(id)];
+    if (!entry) {
+        entry = std::make_unique<Histograms>();
+    }
+    return *entry;
+}
+
+void TaskProfile::logRunTime(TaskId id, steady_clock::duration runtime) {
+    std::lock_guard<std::mutex> lh(mutex);
+    getHistograms(id).runtime.addValue(toMicros(runtime));
+}
+
+void TaskProfile::logQTime(TaskId id, steady_clock::duration delay) {
+    std::lock_guard<std::mutex> lh(mutex);
+    getHistograms(id).delay.addValue(toMicros(delay));
+}
+
+void TaskProfile::logSlowRun(TaskId id,
+                             std::string description,
+                             std::string thread,
+                             steady_clock::duration runtime) {
+    std::lock_guard<std::mutex> lh(mutex);
+    if (maxSlowRuns == 0) {
+        return;
+    }
+    while (slowRuns.size() >= maxSlowRuns) {
+        slowRuns.pop_front();
+    }
+    slowRuns.push_back({id,
+                        std::move(description),
+                        std::move(thread),
+                        duration_cast<microseconds>(runtime),
+                        system_clock::now()});
+}
+
+void TaskProfile::setMaxSlowRuns(size_t max) {
+    std::lock_guard<std::mutex> lh(mutex);
+    maxSlowRuns = max;
+    while (slowRuns.size() > maxSlowRuns) {
+        slowRuns.pop_front();
+    }
+}
+
+void TaskProfile::reset() {
+    std::lock_guard<std::mutex> lh(mutex);
+    for (auto& entry : histograms) {
+        entry.reset();
+    }
+    slowRuns.clear();
+}
+
+void TaskProfile::addStats(const void* cookie, ADD_STAT add_stat) const {
+    std::lock_guard<std::mutex> lh(mutex);
+    for (TaskId id : GlobalTask::allTaskIds) {
+        const auto& entry = histograms[static_cast<size_t>(id)];
+        if (!entry) {
+            continue;
+        }
+        const std::string name = GlobalTask::getTaskName(id);
+        add_percentile_stats(
+                name + ":runtime", entry->runtime, add_stat, cookie);
+        add_percentile_stats(name + ":delay", entry->delay, add_stat, cookie);
+    }
+
+    // Most recent first.
+    size_t index = 0;
+    for (auto it = slowRuns.rbegin(); it != slowRuns.rend(); ++it, ++index) {
+        const std::string prefix = "slow_run:" + std::to_string(index) + ":";
+        add_casted_stat((prefix + "task").c_str(),
+                        GlobalTask::getTaskName(it->id),
+                        add_stat,
+                        cookie);
+        add_casted_stat((prefix + "description").c_str(),
+                        it->description,
+                        add_stat,
+                        cookie);
+        add_casted_stat(
+                (prefix + "thread").c_str(), it->thread, add_stat, cookie);
+        add_casted_stat((prefix + "runtime_us").c_str(),
+                        it->runtime.count(),
+                        add_stat,
+                        cookie);
+        add_casted_stat((prefix + "time").c_str(),
+                        duration_cast<seconds>(it->when.time_since_epoch())
+                                .count(),
+                        add_stat,
+                        cookie);
+    }
+}
@@ -0,0 +1,91 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include "globaltask.h"
+#include "hdrhistogram.h"
+
+#include <memcached/engine_common.h>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * Profile of the tasks a bucket ran on the executor threads.
+ *
+ * For each TaskId which has run, a histogram of its runtimes and of its
+ * scheduling delays (the time from when the task wanted to run until it
+ * started running). In addition the most recent runs of tasks that exceeded
+ * their maxExpectedDuration are sampled, with the task's description (which
+ * for many tasks includes its progress) and the thread it ran on.
+ *
+ * Reported by "stats tasks-profile".
+ */
+class TaskProfile {
+public:
+    /// A run of a task which took longer than its maxExpectedDuration.
+    struct SlowRun {
+        TaskId id;
+        std::string description;
+        std::string thread;
+        std::chrono::microseconds runtime;
+        std::chrono::system_clock::time_point when;
+    };
+
+    static const size_t DefaultMaxSlowRuns = 16;
+
+    explicit TaskProfile(size_t maxSlowRuns = DefaultMaxSlowRuns);
+
+    void logRunTime(TaskId id, std::chrono::steady_clock::duration runtime);
+
+    void logQTime(TaskId id, std::chrono::steady_clock::duration delay);
+
+    void logSlowRun(TaskId id,
+                    std::string description,
+                    std::string thread,
+                    std::chrono::steady_clock::duration runtime);
+
+    /// Set how many slow runs are kept; 0 disables the sampling.
+    void setMaxSlowRuns(size_t max);
+
+    void reset();
+
+    void addStats(const void* cookie, ADD_STAT add_stat) const;
+
+private:
+    struct Histograms {
+        Histograms();
+        HdrHistogram runtime;
+        HdrHistogram delay;
+    };
+
+    Histograms& getHistograms(TaskId id);
+
+    mutable std::mutex mutex;
+    std::array<std::unique_ptr<Histograms>,
+               static_cast<size_t>(TaskId::TASK_COUNT)>
+            histograms;
+    size_t maxSlowRuns;
+    std::deque<SlowRun> slowRuns;
+};
@@ -22,8 +22,12 @@
 #pragma once
 
 #include "globaltask.h"
+#include "task_type.h"
 #include "workload.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 
 /*
@@ -75,6 +79,69 @@ public:
     virtual void logRunTime(
             TaskId id, const std::chrono::steady_clock::duration runTime) = 0;
 
+    /*
+        Called when a task ran for longer than its maxExpectedDuration, with
+        the task's description and the name of the thread it ran on
+    */
+    virtual void logSlowRun(TaskId id,
+                            const std::string& description,
+                            const std::string& thread,
+                            const std::chrono::steady_clock::duration runTime) {
+    }
+
+    /*
+        Set the taskable's weight; when the ready tasks of several taskables
+        compete for the executor threads of a type, each taskable gets a
+        share of the threads' time in proportion to its weight.
+    */
+    void setWorkloadWeight(size_t w) {
+        weight = std::max(w, size_t(1));
+    }
+
+    size_t getWorkloadWeight() const {
+        return weight;
+    }
+
+    /*
+        Account for the time spent running one of the taskable's tasks on
+        an executor thread of the given type
+    */
+    void chargeRunTime(task_type_t type,
+                       const std::chrono::steady_clock::duration runTime) {
+        const uint64_t ns =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(runTime)
+                        .count();
+        totalRunTime[type] += ns;
+        virtualRunTime[type] += ns / weight;
+    }
+
+    /*
+        Return the total time (in ns) the taskable's tasks have been running
+        on executor threads of the given type
+    */
+    uint64_t getTotalRunTime(task_type_t type) const {
+        return totalRunTime[type];
+    }
+
+    /*
+        Return the time the taskable's tasks have been running on executor
+        threads of the given type, scaled down by the taskable's weight. The
+        taskable with the lowest virtual runtime is the furthest behind its
+        share.
+    */
+    uint64_t getVirtualRunTime(task_type_t type) const {
+        return virtualRunTime[type];
+    }
+
+    void setVirtualRunTime(task_type_t type, uint64_t ns) {
+        virtualRunTime[type] = ns;
+    }
+
 protected:
     virtual ~Taskable() {}
+
+private:
+    std::atomic<size_t> weight{1};
+    std::array<std::atomic<uint64_t>, NUM_TASK_GROUPS> totalRunTime{};
+    std::array<std::atomic<uint64_t>, NUM_TASK_GROUPS> virtualRunTime{};
 };
@@ -21,6 +21,7 @@
 #include "executorthread.h"
 #include "taskqueue.h"
 
+#include <array>
 #include <cmath>
 
 TaskQueue::TaskQueue(ExecutorPool *m, task_type_t t, const char *nm) :
@@ -59,6 +60,41 @@ ExTask TaskQueue::_popReadyTask(void) {
     return t;
 }
 
+/*
+ * Of the ready tasks with the same priority as the top one (up to
+ * MaxShareCandidates), pop the one whose taskable is furthest behind its
+ * share of the threads; the others go back into the readyQueue.
+ */
+ExTask TaskQueue::_popReadyTaskByShare(void) {
+    if (!manager->isSharingThreads()) {
+        return _popReadyTask();
+    }
+
+    ExTask best = readyQueue.top();
+    readyQueue.pop();
+    auto bestRunTime = best->getTaskable().getVirtualRunTime(queueType);
+    std::array<ExTask, MaxShareCandidates - 1> others;
+    size_t numOthers = 0;
+    while (numOthers < others.size() && !readyQueue.empty() &&
+           readyQueue.top()->getQueuePriority() == best->getQueuePriority()) {
+        ExTask candidate = readyQueue.top();
+        readyQueue.pop();
+        const auto runTime =
+                candidate->getTaskable().getVirtualRunTime(queueType);
+        if (runTime < bestRunTime) {
+            std::swap(best, candidate);
+            bestRunTime = runTime;
+        }
+        others[numOthers++] = std::move(candidate);
+    }
+    for (size_t ii = 0; ii < numOthers; ++ii) {
+        readyQueue.push(std::move(others[ii]));
+    }
+
+    manager->lessWork(queueType);
+    return best;
+}
+
 void TaskQueue::doWake(size_t &numToWake) {
     LockHolder lh(mutex);
     _doWake_UNLOCKED(numToWake);
@@ -139,9 +175,18 @@ bool TaskQueue::_fetchNextTask(ExecutorThread &t, bool toSleep) {
         // order, the function below will push any pending task back into the
         // readyQueue (sorted by priority)
         _checkPendingQueue();
-        ExTask tid = _popReadyTask(); // and pop out the top task
+        ExTask tid = _popReadyTaskByShare(); // and pop out the top task
         t.setCurrentTask(tid);
         ret = true;
+
+        // Fetch a few more into the thread's local queue, leaving a ready
+        // task for each thread sleeping on this queue.
+        for (size_t n = manager->getLocalQueueSize();
+             n > 1 && readyQueue.size() > sleepers;
+             --n) {
+            manager->addLocalTask(t, readyQueue.top(), this);
+            readyQueue.pop();
+        }
     } else { // Let the task continue waiting in pendingQueue
         numToWake = numToWake ? numToWake - 1 : 0; // 1 fewer task ready
     }
@@ -72,6 +72,10 @@ private:
     void _doWake_UNLOCKED(size_t &numToWake);
     size_t _moveReadyTasks(const std::chrono::steady_clock::time_point tv);
     ExTask _popReadyTask(void);
+    ExTask _popReadyTaskByShare(void);
+
+    /// Ready tasks considered when picking the next one by share.
+    static const size_t MaxShareCandidates = 8;
 
     SyncObject mutex;
     const std::string name;
@@ -84,7 +88,7 @@ private:
                         CompareByPriority> readyQueue;
 
     // sorted by waketime.
-    FutureQueue<> futureQueue;
+    FutureQueue futureQueue;
 
     std::list<ExTask> pendingQueue;
 };
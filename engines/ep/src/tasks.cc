@@ -17,6 +17,7 @@
 #include "config.h"
 
 #include "bgfetcher.h"
+#include "bucket_logger.h"
 #include "ep_bucket.h"
 #include "ep_engine.h"
 #include "flusher.h"
@@ -110,6 +111,7 @@ WorkLoadMonitor::WorkLoadMonitor(EventuallyPersistentEngine *e,
                completeBeforeShutdown) {
     prevNumMutations = getNumMutations();
     prevNumGets = getNumGets();
+    prevTotalPersisted = e->getEpStats().totalPersisted;
 }
 
 size_t WorkLoadMonitor::getNumMutations() {
@@ -148,9 +150,91 @@ bool WorkLoadMonitor::run() {
     prevNumMutations = curr_num_mutations;
     prevNumGets = curr_num_gets;
 
+    adaptThreads();
+
     snooze(WORKLOAD_MONITOR_FREQ);
     if (engine->getEpStats().isShutdown) {
         return false;
     }
     return true;
 }
+
+void WorkLoadMonitor::adaptThreads() {
+    auto& stats = engine->getEpStats();
+    const size_t totalPersisted = stats.totalPersisted;
+    const size_t persisted = totalPersisted - prevTotalPersisted;
+    prevTotalPersisted = totalPersisted;
+
+    auto& config = engine->getConfiguration();
+    // Ephemeral buckets don't use the readers or writers for front-end
+    // work, and if the ExecutorAutoscaler is running it owns the counts.
+    if (!config.isWorkloadAdaptive() ||
+        config.getBucketType() != "persistent" ||
+        config.getExecutorAutoscaleMaxReaders() ||
+        config.getExecutorAutoscaleMaxWriters()) {
+        candidateChecks = 0;
+        return;
+    }
+
+    // The disk queue is backed up if it holds more than one interval's
+    // worth of what the flushers persisted.
+    const bool diskBacklog = stats.diskQueueSize > persisted;
+
+    auto* pool = ExecutorPool::get();
+    const size_t readers = pool->getNumReaders();
+    const size_t writers = pool->getNumWriters();
+    auto& workload = engine->getWorkLoadPolicy();
+    const size_t target = WorkLoadPolicy::getNumReadersFor(
+            workload.getWorkLoadPattern(),
+            engine->getKVBucket()->getActiveResidentRatio(),
+            diskBacklog,
+            readers + writers);
+
+    if (target == readers) {
+        candidateChecks = 0;
+        return;
+    }
+    if (target != candidateReaders) {
+        candidateReaders = target;
+        candidateChecks = 0;
+    }
+    if (++candidateChecks < adaptChecks) {
+        return;
+    }
+    candidateChecks = 0;
+
+    const size_t targetWriters = readers + writers - target;
+    EP_LOG_INFO(
+            "WorkLoadMonitor: {} workload (active resident ratio:{}%, disk "
+            "backlog:{}), changing readers:{}->{} writers:{}->{}",
+            workload.stringOfWorkLoadPattern(),
+            engine->getKVBucket()->getActiveResidentRatio(),
+            diskBacklog,
+            readers,
+            target,
+            writers,
+            targetWriters);
+    // Shrink first so the total never exceeds what was configured.
+    if (target < readers) {
+        pool->setNumReaders(target);
+        pool->setNumWriters(targetWriters);
+    } else {
+        pool->setNumWriters(targetWriters);
+        pool->setNumReaders(target);
+    }
+    workload.recordAdjustment(target, targetWriters);
+}
+
+ExecutorAutoscaler::ExecutorAutoscaler(EventuallyPersistentEngine* e)
+    : GlobalTask(e, TaskId::ExecutorAutoscaler, 1, false) {
+}
+
+bool ExecutorAutoscaler::run() {
+    ExecutorPool::get()->autoscaleWorkers();
+
+    snooze(1);
+    if (engine->getEpStats().isShutdown) {
+        return false;
+    }
+    return true;
+}
@@ -37,11 +37,15 @@ class Flusher;
 class FlusherTask : public GlobalTask {
 public:
     FlusherTask(EventuallyPersistentEngine *e, Flusher* f, uint16_t shardid,
+                size_t flusherIndex = 0,
                 bool completeBeforeShutdown = true)
         : GlobalTask(e, TaskId::FlusherTask, 0, completeBeforeShutdown),
           flusher(f) {
         std::stringstream ss;
         ss<<"Running a flusher loop: shard "<<shardid;
+        if (flusherIndex > 0) {
+            ss << " flusher " << flusherIndex;
+        }
         desc = ss.str();
     }
 
@@ -229,6 +233,43 @@ private:
     size_t getNumMutations();
     size_t getNumGets();
 
+    /**
+     * If workload_adaptive is set, move reader / writer threads between the
+     * two for the current workload pattern, residency and disk queue (see
+     * WorkLoadPolicy::getNumReadersFor).
+     */
+    void adaptThreads();
+
+    /// Number of consecutive runs a new split must be chosen before it is
+    /// applied, so a short burst doesn't restart threads.
+    static const size_t adaptChecks = 3;
+
     size_t prevNumMutations;
     size_t prevNumGets;
+    size_t prevTotalPersisted;
+
+    // The split adaptThreads() would apply and for how many runs in a row.
+    size_t candidateReaders = 0;
+    size_t candidateChecks = 0;
+};
+
+/**
+ * Periodically asks the ExecutorPool to check whether its reader / writer
+ * threads should be grown or shrunk (see ExecutorPool::setAutoscaleLimit).
+ */
+class ExecutorAutoscaler : public GlobalTask {
+public:
+    ExecutorAutoscaler(EventuallyPersistentEngine* e);
+
+    bool run();
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // Normally just reads a few counters; starting or stopping a thread
+        // takes longer.
+        return std::chrono::milliseconds(10);
+    }
+
+    std::string getDescription() {
+        return "Autoscaling the executor threads";
+    }
 };
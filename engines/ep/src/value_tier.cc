@@ -0,0 +1,197 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "value_tier.h"
+
+#include "bucket_logger.h"
+
+#include <utilities/cpu_affinity.h>
+
+#include <cerrno>
+#include <system_error>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+const size_t ValueTier::MaxAllocation;
+const size_t ValueTier::MinClassSize;
+const size_t ValueTier::NumClasses;
+
+#ifdef __linux__
+static size_t mappedLength(size_t bytes) {
+    const size_t page = sysconf(_SC_PAGESIZE);
+    return (bytes + page - 1) / page * page;
+}
+#endif
+
+ValueTier::ValueTier(size_t size, const std::string& path, int numaNode) {
+#ifdef __linux__
+    capacity = mappedLength(size);
+    void* ptr = MAP_FAILED;
+    if (path.empty()) {
+        ptr = mmap(nullptr,
+                   capacity,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                   -1,
+                   0);
+        if (ptr == MAP_FAILED) {
+            throw std::system_error(
+                    errno, std::system_category(), "ValueTier: mmap");
+        }
+        // Set the placement before first touching the pages (which is when
+        // they're allocated).
+        if (numaNode >= 0 &&
+            !bind_memory_to_numa_node(ptr, capacity, numaNode)) {
+            EP_LOG_WARN("ValueTier: failed to bind to NUMA node {}",
+                        numaNode);
+        }
+    } else {
+        const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd == -1) {
+            throw std::system_error(
+                    errno, std::system_category(), "ValueTier: open " + path);
+        }
+        if (ftruncate(fd, capacity) == 0) {
+            ptr = mmap(nullptr,
+                       capacity,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED,
+                       fd,
+                       0);
+        }
+        const int error = errno;
+        close(fd);
+        // The tier doesn't survive a restart; don't leave the file behind.
+        unlink(path.c_str());
+        if (ptr == MAP_FAILED) {
+            throw std::system_error(
+                    error, std::system_category(), "ValueTier: map " + path);
+        }
+    }
+    base = static_cast<char*>(ptr);
+#else
+    (void)size;
+    (void)path;
+    (void)numaNode;
+    throw std::system_error(std::make_error_code(std::errc::not_supported),
+                            "ValueTier: not supported on this platform");
+#endif
+}
+
+ValueTier::~ValueTier() {
+#ifdef __linux__
+    munmap(base, capacity);
+#endif
+}
+
+void ValueTier::Release::operator()(ValueTier* tier) const {
+    {
+        std::lock_guard<std::mutex> lh(tier->mutex);
+        tier->released = true;
+        if (tier->numAllocations > 0) {
+            // The last deallocate() destroys it.
+            return;
+        }
+    }
+    delete tier;
+}
+
+size_t ValueTier::sizeClassFor(size_t bytes) {
+    if (bytes <= MinClassSize) {
+        return 0;
+    }
+    // The power of two below bytes, split into four classes.
+    const size_t n = bytes - 1;
+    size_t log2 = 6;
+    while ((size_t(2) << log2) <= n) {
+        ++log2;
+    }
+    return (log2 - 6) * 4 + ((n >> (log2 - 2)) & 3) + 1;
+}
+
+size_t ValueTier::classSize(size_t sizeClass) {
+    if (sizeClass == 0) {
+        return MinClassSize;
+    }
+    const size_t log2 = (sizeClass - 1) / 4 + 6;
+    const size_t index = (sizeClass - 1) % 4;
+    return (size_t(1) << log2) + (index + 1) * (size_t(1) << (log2 - 2));
+}
+
+void* ValueTier::allocate(size_t bytes) {
+    if (bytes > MaxAllocation) {
+        return nullptr;
+    }
+    const auto sizeClass = sizeClassFor(bytes + sizeof(Header));
+    const auto size = classSize(sizeClass);
+
+    std::lock_guard<std::mutex> lh(mutex);
+    char* chunk;
+    if (freeLists[sizeClass]) {
+        auto* free = freeLists[sizeClass];
+        freeLists[sizeClass] = free->next;
+        chunk = reinterpret_cast<char*>(free);
+    } else if (capacity - next >= size) {
+        chunk = base + next;
+        next += size;
+    } else {
+        return nullptr;
+    }
+
+    auto* header = reinterpret_cast<Header*>(chunk);
+    header->tier = this;
+    header->sizeClass = static_cast<uint32_t>(sizeClass);
+    used += size;
+    ++numAllocations;
+    return header + 1;
+}
+
+void ValueTier::deallocate(void* ptr) {
+    auto* header = static_cast<Header*>(ptr) - 1;
+    header->tier->free(header);
+}
+
+void ValueTier::free(Header* header) {
+    const auto sizeClass = header->sizeClass;
+    bool destroy;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        auto* chunk = reinterpret_cast<FreeChunk*>(header);
+        chunk->next = freeLists[sizeClass];
+        freeLists[sizeClass] = chunk;
+        used -= classSize(sizeClass);
+        --numAllocations;
+        destroy = released && numAllocations == 0;
+    }
+    if (destroy) {
+        delete this;
+    }
+}
+
+size_t ValueTier::getUsed() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return used;
+}
+
+size_t ValueTier::getNumAllocations() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return numAllocations;
+}
@@ -0,0 +1,127 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * A second tier of memory for cold values, between DRAM and disk.
+ *
+ * The tier is a single mapping of byte-addressable memory: either a file
+ * (on a DAX mounted file system this is persistent memory, accessed
+ * directly) or anonymous memory bound to a NUMA node (such as the CPU-less
+ * node of a CXL memory expander). Values are copied into the tier by the
+ * item pager instead of being ejected (see HashTable::unlocked_moveToTier),
+ * and are read from it in place; they don't count towards the bucket's
+ * memory usage.
+ *
+ * The tier does not survive a restart - a file is unlinked once mapped.
+ *
+ * Allocations are made from size classes (four per power of two, so at
+ * most 25% is wasted), each with a free list, carved from the mapping in
+ * order.
+ */
+class ValueTier {
+public:
+    /// The largest allocation the tier makes.
+    static const size_t MaxAllocation = 1024 * 1024;
+
+    /**
+     * Map the tier.
+     *
+     * @param size bytes of memory to map (rounded up to a page)
+     * @param path file to map; if empty anonymous memory is mapped
+     * @param numaNode node to bind anonymous memory to (-1 for none)
+     * @throws std::system_error if the memory can't be mapped
+     */
+    ValueTier(size_t size, const std::string& path, int numaNode);
+
+    ValueTier(const ValueTier&) = delete;
+    ValueTier& operator=(const ValueTier&) = delete;
+
+    /**
+     * Allocate memory from the tier.
+     *
+     * @return the memory (aligned to 16 bytes), or nullptr if the tier is
+     *         full or bytes is over MaxAllocation
+     */
+    void* allocate(size_t bytes);
+
+    /// Free memory returned by allocate(), of any tier.
+    static void deallocate(void* ptr);
+
+    /// @return the bytes mapped
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    /// @return the bytes allocated (including size class rounding)
+    size_t getUsed() const;
+
+    /// @return the number of allocations which have not been freed
+    size_t getNumAllocations() const;
+
+    /**
+     * Deleter for the owner of a tier: the tier is destroyed once its last
+     * allocation has been freed, as values (in Items) may outlive the
+     * owner.
+     */
+    struct Release {
+        void operator()(ValueTier* tier) const;
+    };
+
+private:
+    ~ValueTier();
+
+    /// Precedes each allocation.
+    struct alignas(16) Header {
+        ValueTier* tier;
+        uint32_t sizeClass;
+    };
+
+    /// A free allocation, linked into the free list of its size class.
+    struct FreeChunk {
+        FreeChunk* next;
+    };
+
+    static const size_t MinClassSize = 64;
+    static const size_t NumClasses = 61;
+
+    static size_t sizeClassFor(size_t bytes);
+    static size_t classSize(size_t sizeClass);
+
+    void free(Header* header);
+
+    char* base = nullptr;
+    size_t capacity = 0;
+
+    mutable std::mutex mutex;
+    /// Offset of the memory not yet carved into allocations
+    size_t next = 0;
+    std::array<FreeChunk*, NumClasses> freeLists{};
+    size_t used = 0;
+    size_t numAllocations = 0;
+    /// Set once the owner has released the tier
+    bool released = false;
+};
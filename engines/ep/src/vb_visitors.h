@@ -22,6 +22,8 @@
 #include "hash_table.h"
 #include "vb_filter.h"
 
+#include <functional>
+
 class HashTableVisitor;
 class VBucket;
 
@@ -50,6 +52,16 @@ public:
         return vBucketFilter;
     }
 
+    /**
+     * @return the order to visit the vBuckets in (true if the first should
+     *         be visited before the second), or an empty function to visit
+     *         them in vBucket id order.
+     */
+    virtual std::function<bool(const Vbid&, const Vbid&)>
+    getVBucketComparator() const {
+        return {};
+    }
+
     /**
      * Called after all vbuckets have been visited.
      */
@@ -27,9 +27,12 @@
 #include "ep_engine.h"
 #include "ep_time.h"
 #include "ep_types.h"
+#include "expiry_index.h"
 #include "failover-table.h"
 #include "flusher.h"
 #include "hash_table.h"
+#include "hot_key_cache.h"
+#include "objectregistry.h"
 #include "pre_link_document_context.h"
 #include "statwriter.h"
 #include "stored_value_factories.h"
@@ -39,10 +42,12 @@
 #include <memcached/protocol_binary.h>
 #include <memcached/server_document_iface.h>
 #include <platform/compress.h>
+#include <utilities/cpu_affinity.h>
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
 #include <logtags.h>
+#include <tracing/trace_helpers.h>
 #include <functional>
 #include <list>
 #include <set>
@@ -129,6 +134,26 @@ std::ostream& operator <<(std::ostream &out, const VBucketFilter &filter)
     return out;
 }
 
+/**
+ * How the vBucket's HashTable arrays are backed: with huge pages if asked,
+ * and, with ht_numa_placement, on the NUMA node of the vBucket's shard (the
+ * shards being spread over the nodes).
+ */
+static LargeArrayPolicy getHashTableArrayPolicy(Vbid vbid,
+                                                Configuration& config) {
+    LargeArrayPolicy policy;
+    policy.hugePages =
+            LargeArrayPolicy::hugePagesFromString(config.getHtHugePages());
+    if (config.isHtNumaPlacement()) {
+        static const int nodes = get_numa_node_count();
+        if (nodes > 1) {
+            const auto shard = vbid.get() % config.getMaxNumShards();
+            policy.numaNode = shard % nodes;
+        }
+    }
+    return policy;
+}
+
 const vbucket_state_t VBucket::ACTIVE =
                      static_cast<vbucket_state_t>(htonl(vbucket_state_active));
 const vbucket_state_t VBucket::REPLICA =
@@ -157,7 +182,13 @@ VBucket::VBucket(Vbid i,
                  int64_t hlcEpochSeqno,
                  bool mightContainXattrs,
                  const Collections::VB::PersistedManifest& collectionsManifest)
-    : ht(st, std::move(valFact), config.getHtSize(), config.getHtLocks()),
+    : ht(st,
+         std::move(valFact),
+         config.getHtSize(),
+         config.getHtLocks(),
+         HashTable::layoutFromString(config.getHtLayout()),
+         HashTable::readLockModeFromString(config.getHtReadLockMode()),
+         getHashTableArrayPolicy(i, config)),
       checkpointManager(std::make_unique<CheckpointManager>(st,
                                                             i,
                                                             chkConfig,
@@ -185,6 +216,7 @@ VBucket::VBucket(Vbid i,
       numHpVBReqs(0),
       id(i),
       state(newState),
+      stateLock(st.lockProfiles.vbucketState),
       initialState(initState),
       purge_seqno(purgeSeqno),
       takeover_backed_up(false),
@@ -204,13 +236,39 @@ VBucket::VBucket(Vbid i,
       newSeqnoCb(std::move(newSeqnoCb)),
       manifest(
               std::make_unique<Collections::VB::Manifest>(collectionsManifest)),
-      mayContainXattrs(mightContainXattrs) {
+      mayContainXattrs(mightContainXattrs),
+      hotKeyCacheMinFreq(config.getHotKeyCacheMinFreq()),
+      negativeKeyCacheTtl(config.getNegativeKeyCacheTtl()) {
+    if (config.getHotKeyCacheSize() > 0) {
+        hotKeyCache =
+                std::make_unique<HotKeyCache>(config.getHotKeyCacheSize());
+    }
+
+    if (config.isExpPagerIndexEnabled()) {
+        expiryIndex = std::make_unique<ExpiryIndex>();
+    }
+
+    if (config.isHtCollectionIndex()) {
+        ht.enableCollectionIndex();
+    }
+
     if (config.getConflictResolutionType().compare("lww") == 0) {
         conflictResolver.reset(new LastWriteWinsResolution());
+        if (config.getConflictResolutionCasSummarySize() > 0) {
+            ht.enableRemovedCasSummary(
+                    config.getConflictResolutionCasSummarySize(), maxCas);
+        }
     } else {
         conflictResolver.reset(new RevisionSeqnoResolution());
     }
 
+    // Account each collection's memory usage in the manifest. Callers
+    // usually already hold a read handle on the manifest; its lock allows
+    // recursive readers.
+    ht.setMemChangedCallback([this](CollectionID collection, int64_t delta) {
+        manifest->lock().updateMemUsed(collection, delta);
+    });
+
     backfill.isBackfillPhase = false;
     pendingOpsStart = std::chrono::steady_clock::time_point();
     stats.coreLocal.get()->memOverhead.fetch_add(
@@ -242,6 +300,9 @@ VBucket::~VBucket() {
     // Clear out the bloomfilter(s)
     clearFilter();
 
+    // The manifest is destroyed before the HashTable (and its items).
+    ht.setMemChangedCallback({});
+
     stats.coreLocal.get()->memOverhead.fetch_sub(
             sizeof(VBucket) + ht.memorySize() + sizeof(CheckpointManager));
 
@@ -463,7 +524,6 @@ uint64_t VBucket::getQueueAge() {
 template <typename T>
 void VBucket::addStat(const char *nm, const T &val, ADD_STAT add_stat,
                       const void *c) {
-    std::string stat = statPrefix;
     if (nm != NULL) {
         add_prefixed_stat(statPrefix, nm, val, add_stat, c);
     } else {
@@ -483,14 +543,13 @@ void VBucket::handlePreExpiry(const HashTable::HashBucketLock& hbl,
                 cb::UserDataView(ss.str()).getSanitizedValue());
     }
 
-    value_t value = v.getValue();
-    if (value) {
+    if (v.hasValue()) {
         std::unique_ptr<Item> itm(v.toItem(false, id));
         item_info itm_info;
         EventuallyPersistentEngine* engine = ObjectRegistry::getCurrentEngine();
         itm_info =
                 itm->toItemInfo(failovers->getLatestUUID(), getHLCEpochSeqno());
-        value_t new_val(Blob::Copy(*value));
+        value_t new_val(Blob::Copy(*itm->getValue()));
         itm->replaceValue(new_val.get());
         itm->setDataType(v.getDatatype());
 
@@ -574,27 +633,31 @@ bool VBucket::isResidentRatioUnderThreshold(float threshold) {
     }
 }
 
-void VBucket::createFilter(size_t key_count, double probability) {
+void VBucket::createFilter(size_t key_count,
+                           double probability,
+                           bool blocked) {
     // Create the actual bloom filter upon vbucket creation during
     // scenarios:
     //      - Bucket creation
     //      - Rebalance
     LockHolder lh(bfMutex);
     if (bFilter == nullptr && tempFilter == nullptr) {
-        bFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                        BFILTER_ENABLED);
+        bFilter = std::make_unique<BloomFilter>(
+                key_count, probability, BFILTER_ENABLED, blocked);
     } else {
         EP_LOG_WARN("({}) Bloom filter / Temp filter already exist!", id);
     }
 }
 
-void VBucket::initTempFilter(size_t key_count, double probability) {
+void VBucket::initTempFilter(size_t key_count,
+                             double probability,
+                             bool blocked) {
     // Create a temp bloom filter with status as COMPACTING,
     // if the main filter is found to exist, set its state to
     // COMPACTING as well.
     LockHolder lh(bfMutex);
-    tempFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                     BFILTER_COMPACTING);
+    tempFilter = std::make_unique<BloomFilter>(
+            key_count, probability, BFILTER_COMPACTING, blocked);
     if (bFilter) {
         bFilter->setStatus(BFILTER_COMPACTING);
     }
@@ -617,6 +680,10 @@ void VBucket::addToFilter(const DocKey& key) {
 }
 
 bool VBucket::maybeKeyExistsInFilter(const DocKey& key) {
+    if (ht.getNegativeKeyCache().contains(key, ep_current_time())) {
+        return false;
+    }
+
     LockHolder lh(bfMutex);
     if (bFilter) {
         return bFilter->maybeKeyExists(key);
@@ -626,6 +693,23 @@ bool VBucket::maybeKeyExistsInFilter(const DocKey& key) {
     }
 }
 
+bool VBucket::maybeKeyExistsInFilter(const DocKey& key, const void* cookie) {
+    TRACE_SCOPE(cookie, cb::tracing::TraceCode::BLOOM_FILTER);
+    return maybeKeyExistsInFilter(key);
+}
+
+HashTable::FindResult VBucket::findForWrite(const DocKey& key,
+                                            const void* cookie) {
+    TRACE_SCOPE(cookie, cb::tracing::TraceCode::HASH_LOCK);
+    return ht.findForWrite(key);
+}
+
+HashTable::HashBucketLock VBucket::getLockedBucket(const DocKey& key,
+                                                   const void* cookie) {
+    TRACE_SCOPE(cookie, cb::tracing::TraceCode::HASH_LOCK);
+    return ht.getLockedBucket(key);
+}
+
 bool VBucket::isTempFilterAvailable() {
     LockHolder lh(bfMutex);
     if (tempFilter &&
@@ -677,6 +761,23 @@ void VBucket::clearFilter() {
     tempFilter.reset();
 }
 
+std::string VBucket::serialiseFilter() {
+    LockHolder lh(bfMutex);
+    if (bFilter && !tempFilter && bFilter->getStatus() == BFILTER_ENABLED) {
+        return bFilter->serialise();
+    }
+    return {};
+}
+
+bool VBucket::restoreFilter(std::unique_ptr<BloomFilter> filter) {
+    LockHolder lh(bfMutex);
+    if (!filter || bFilter || tempFilter) {
+        return false;
+    }
+    bFilter = std::move(filter);
+    return true;
+}
+
 void VBucket::setFilterStatus(bfilter_status_t to) {
     LockHolder lh(bfMutex);
     if (bFilter) {
@@ -743,6 +844,10 @@ VBNotifyCtx VBucket::queueDirty(
         setMightContainXattrs();
     }
 
+    if (expiryIndex && !qi->isDeleted()) {
+        expiryIndex->add(v.getKey(), v.getExptime());
+    }
+
     if (isBackfillItem) {
         queueBackfillItem(qi, generateBySeqno);
         notifyCtx.notifyFlusher = true;
@@ -869,7 +974,7 @@ ENGINE_ERROR_CODE VBucket::set(Item& itm,
                                EventuallyPersistentEngine& engine,
                                cb::StoreIfPredicate predicate) {
     bool cas_op = (itm.getCas() != 0);
-    auto htRes = ht.findForWrite(itm.getKey());
+    auto htRes = findForWrite(itm.getKey(), cookie);
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -895,13 +1000,14 @@ ENGINE_ERROR_CODE VBucket::set(Item& itm,
         ((itm.getCas() != 0) ||
          storeIfStatus == cb::StoreIfStatus::GetItemInfo)) {
         // Check Bloomfilter's prediction
-        if (!maybeKeyExistsInFilter(itm.getKey())) {
+        if (!maybeKeyExistsInFilter(itm.getKey(), cookie)) {
             maybeKeyExists = false;
         }
     }
 
     PreLinkDocumentContext preLinkDocumentContext(engine, cookie, &itm);
     VBQueueItemCtx queueItmCtx;
+    queueItmCtx.cookie = cookie;
     if (itm.getCommitted() == CommittedState::Pending) {
         queueItmCtx.durabilityReqs = itm.getDurabilityReqs();
     }
@@ -975,7 +1081,7 @@ ENGINE_ERROR_CODE VBucket::replace(
         EventuallyPersistentEngine& engine,
         cb::StoreIfPredicate predicate,
         const Collections::VB::Manifest::CachingReadHandle& cHandle) {
-    auto htRes = ht.findForWrite(itm.getKey());
+    auto htRes = findForWrite(itm.getKey(), cookie);
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -999,6 +1105,7 @@ ENGINE_ERROR_CODE VBucket::replace(
         } else {
             PreLinkDocumentContext preLinkDocumentContext(engine, cookie, &itm);
             VBQueueItemCtx queueItmCtx;
+            queueItmCtx.cookie = cookie;
             queueItmCtx.preLinkDocumentContext = &preLinkDocumentContext;
             if (itm.getCommitted() == CommittedState::Pending) {
                 queueItmCtx.durabilityReqs = itm.getDurabilityReqs();
@@ -1058,7 +1165,7 @@ ENGINE_ERROR_CODE VBucket::replace(
             return ENGINE_KEY_ENOENT;
         }
 
-        if (maybeKeyExistsInFilter(itm.getKey())) {
+        if (maybeKeyExistsInFilter(itm.getKey(), cookie)) {
             return addTempItemAndBGFetch(
                     hbl, itm.getKey(), cookie, engine, false);
         } else {
@@ -1069,6 +1176,114 @@ ENGINE_ERROR_CODE VBucket::replace(
     }
 }
 
+ENGINE_ERROR_CODE VBucket::mutateInPlace(
+        const DocKey& key,
+        const void* cookie,
+        EventuallyPersistentEngine& engine,
+        const cb::DocumentMutator& mutator,
+        const Collections::VB::Manifest::CachingReadHandle& cHandle,
+        std::chrono::seconds maxTtl,
+        uint64_t& cas) {
+    auto htRes = findForWrite(key, cookie);
+    auto* v = htRes.storedValue;
+    auto& hbl = htRes.lock;
+
+    // The mutator needs the whole of the current version, so if that isn't
+    // in memory fetch it first.
+    if (v) {
+        if (v->getCommitted() == CommittedState::Pending) {
+            return ENGINE_SYNC_WRITE_IN_PROGRESS;
+        }
+        if (v->isLocked(ep_current_time())) {
+            return ENGINE_LOCKED;
+        }
+        if (v->isTempInitialItem() ||
+            (!v->isTempItem() && !v->isDeleted() && !v->isResident())) {
+            hbl.getHTLock().unlock();
+            bgFetch(key, cookie, engine, false);
+            return ENGINE_EWOULDBLOCK;
+        }
+    } else if (eviction == FULL_EVICTION &&
+               maybeKeyExistsInFilter(key, cookie)) {
+        return addTempItemAndBGFetch(hbl, key, cookie, engine, false);
+    }
+
+    const bool exists = v && !isLogicallyNonExistent(*v, cHandle) &&
+                        !v->isExpired(ep_real_time());
+    cb::unique_item_ptr current(
+            exists ? v->toItem(false, getId()).release() : nullptr,
+            cb::ItemDeleter(&engine));
+
+    std::pair<cb::engine_errc, item*> result;
+    {
+        // The mutator runs front end code, whose allocations aren't the
+        // bucket's.
+        NonBucketAllocationGuard guard;
+        result = mutator(std::move(current));
+    }
+    if (result.first != cb::engine_errc::success) {
+        return ENGINE_ERROR_CODE(result.first);
+    }
+    if (result.second == nullptr) {
+        cas = exists ? v->getCas() : 0;
+        return ENGINE_SUCCESS;
+    }
+
+    auto& itm = *static_cast<Item*>(result.second);
+    if (itm.getKey() != StoredDocKey(key)) {
+        throw std::invalid_argument(
+                "VBucket::mutateInPlace: mutator returned an item with a "
+                "different key");
+    }
+    cHandle.processExpiryTime(itm, maxTtl);
+
+    PreLinkDocumentContext preLinkDocumentContext(engine, cookie, &itm);
+    VBQueueItemCtx queueItmCtx;
+    queueItmCtx.cookie = cookie;
+    queueItmCtx.preLinkDocumentContext = &preLinkDocumentContext;
+    MutationStatus status;
+    boost::optional<VBNotifyCtx> notifyCtx;
+    std::tie(status, notifyCtx) = processSet(hbl,
+                                             v,
+                                             itm,
+                                             0,
+                                             /*allowExisting*/ true,
+                                             /*hasMetaData*/ false,
+                                             queueItmCtx,
+                                             cb::StoreIfStatus::Continue);
+
+    ENGINE_ERROR_CODE ret = ENGINE_SUCCESS;
+    switch (status) {
+    case MutationStatus::NoMem:
+        ret = ENGINE_ENOMEM;
+        break;
+    case MutationStatus::InvalidCas:
+        ret = ENGINE_KEY_EEXISTS;
+        break;
+    case MutationStatus::IsLocked:
+        ret = ENGINE_LOCKED;
+        break;
+    case MutationStatus::NotFound:
+    case MutationStatus::WasDirty:
+    case MutationStatus::WasClean:
+        notifyNewSeqno(*notifyCtx);
+
+        itm.setBySeqno(v->getBySeqno());
+        itm.setCas(v->getCas());
+        cas = v->getCas();
+        break;
+    case MutationStatus::NeedBgFetch:
+        throw std::logic_error(
+                "VBucket::mutateInPlace: the document should already be "
+                "resident");
+    case MutationStatus::IsPendingSyncWrite:
+        ret = ENGINE_SYNC_WRITE_IN_PROGRESS;
+        break;
+    }
+
+    return ret;
+}
+
 ENGINE_ERROR_CODE VBucket::addBackfillItem(Item& itm) {
     auto htRes = ht.findForWrite(itm.getKey());
     auto* v = htRes.storedValue;
@@ -1150,7 +1365,7 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
         GenerateBySeqno genBySeqno,
         GenerateCas genCas,
         const Collections::VB::Manifest::CachingReadHandle& cHandle) {
-    auto htRes = ht.findForWrite(itm.getKey());
+    auto htRes = findForWrite(itm.getKey(), cookie);
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
     bool maybeKeyExists = true;
@@ -1182,18 +1397,20 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
                 }
                 return ENGINE_KEY_EEXISTS;
             }
-        } else {
-            if (maybeKeyExistsInFilter(itm.getKey())) {
+        } else if (maybeKeyExistsInFilter(itm.getKey(), cookie)) {
+            // A mutation newer than any the key can have on disk wins
+            // without fetching the key's metadata.
+            if (itm.getCas() <= ht.getRemovedCasBound(itm.getKey())) {
                 return addTempItemAndBGFetch(
                         hbl, itm.getKey(), cookie, engine, true);
-            } else {
-                maybeKeyExists = false;
             }
+        } else {
+            maybeKeyExists = false;
         }
     } else {
         if (eviction == FULL_EVICTION) {
             // Check Bloomfilter's prediction
-            if (!maybeKeyExistsInFilter(itm.getKey())) {
+            if (!maybeKeyExistsInFilter(itm.getKey(), cookie)) {
                 maybeKeyExists = false;
             }
         }
@@ -1211,6 +1428,7 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
                                /*isBackfillItem*/ false,
                                itm.getDurabilityReqs(),
                                nullptr /* No pre link step needed */};
+    queueItmCtx.cookie = cookie;
     MutationStatus status;
     boost::optional<VBNotifyCtx> notifyCtx;
     std::tie(status, notifyCtx) = processSet(hbl,
@@ -1278,7 +1496,7 @@ ENGINE_ERROR_CODE VBucket::deleteItem(
         ItemMetaData* itemMeta,
         mutation_descr_t& mutInfo,
         const Collections::VB::Manifest::CachingReadHandle& cHandle) {
-    auto htRes = ht.findForWrite(cHandle.getKey());
+    auto htRes = findForWrite(cHandle.getKey(), cookie);
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -1288,7 +1506,7 @@ ENGINE_ERROR_CODE VBucket::deleteItem(
             return ENGINE_KEY_ENOENT;
         } else { // Full eviction.
             if (!v) { // Item might be evicted from cache.
-                if (maybeKeyExistsInFilter(cHandle.getKey())) {
+                if (maybeKeyExistsInFilter(cHandle.getKey(), cookie)) {
                     return addTempItemAndBGFetch(
                             hbl, cHandle.getKey(), cookie, engine, true);
                 } else {
@@ -1329,12 +1547,14 @@ ENGINE_ERROR_CODE VBucket::deleteItem(
     } else {
         ItemMetaData metadata;
         metadata.revSeqno = v->getRevSeqno() + 1;
+        VBQueueItemCtx queueItmCtx;
+        queueItmCtx.cookie = cookie;
         std::tie(delrv, v, notifyCtx) =
                 processSoftDelete(hbl,
                                   *v,
                                   cas,
                                   metadata,
-                                  VBQueueItemCtx{},
+                                  queueItmCtx,
                                   /*use_meta*/ false,
                                   /*bySeqno*/ v->getBySeqno(),
                                   DeleteSource::Explicit);
@@ -1407,7 +1627,7 @@ ENGINE_ERROR_CODE VBucket::deleteWithMeta(
         const Collections::VB::Manifest::CachingReadHandle& cHandle,
         DeleteSource deleteSource) {
     const auto& key = cHandle.getKey();
-    auto htRes = ht.findForWrite(key);
+    auto htRes = findForWrite(key, cookie);
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -1433,7 +1653,7 @@ ENGINE_ERROR_CODE VBucket::deleteWithMeta(
         } else {
             // Item is 1) deleted or not existent in the value eviction case OR
             // 2) deleted or evicted in the full eviction.
-            if (maybeKeyExistsInFilter(key)) {
+            if (maybeKeyExistsInFilter(key, cookie)) {
                 return addTempItemAndBGFetch(hbl, key, cookie, engine, true);
             } else {
                 // Even though bloomfilter predicted that item doesn't exist
@@ -1496,6 +1716,7 @@ ENGINE_ERROR_CODE VBucket::deleteWithMeta(
                                    backfill,
                                    cb::durability::NoRequirements,
                                    nullptr /* No pre link step needed */};
+        queueItmCtx.cookie = cookie;
 
         std::unique_ptr<Item> itm;
         if (getState() == vbucket_state_active &&
@@ -1648,7 +1869,7 @@ ENGINE_ERROR_CODE VBucket::add(
         const void* cookie,
         EventuallyPersistentEngine& engine,
         const Collections::VB::Manifest::CachingReadHandle& cHandle) {
-    auto htRes = ht.findForWrite(itm.getKey());
+    auto htRes = findForWrite(itm.getKey(), cookie);
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -1656,13 +1877,14 @@ ENGINE_ERROR_CODE VBucket::add(
     if ((v == nullptr || v->isTempInitialItem()) &&
         (eviction == FULL_EVICTION)) {
         // Check bloomfilter's prediction
-        if (!maybeKeyExistsInFilter(itm.getKey())) {
+        if (!maybeKeyExistsInFilter(itm.getKey(), cookie)) {
             maybeKeyExists = false;
         }
     }
 
     PreLinkDocumentContext preLinkDocumentContext(engine, cookie, &itm);
     VBQueueItemCtx queueItmCtx;
+    queueItmCtx.cookie = cookie;
     queueItmCtx.preLinkDocumentContext = &preLinkDocumentContext;
     if (itm.getCommitted() == CommittedState::Pending) {
         queueItmCtx.durabilityReqs = itm.getDurabilityReqs();
@@ -1801,7 +2023,24 @@ GetValue VBucket::getInternal(
     const bool metadataOnly = (options & ALLOW_META_ONLY);
     const bool getDeletedValue = (options & GET_DELETED_VALUE);
     const bool bgFetchRequired = (options & QUEUE_BG_FETCH);
-    auto hbl = ht.getLockedBucket(cHandle.getKey());
+
+    // Hot keys are served from a snapshot, if it is still current, without
+    // acquiring the ht_lock. Note this doesn't update the frequency counter
+    // or NRU of the StoredValue.
+    if (hotKeyCache && getKeyOnly == GetKeyOnly::No) {
+        auto item = hotKeyCache->get(cHandle.getKey(),
+                                     ht.getLockVersion(cHandle.getKey()));
+        if (item && !cHandle.isLogicallyDeleted(item->getBySeqno())) {
+            if (options & TRACK_STATISTICS) {
+                opsGet++;
+            }
+            const auto seqno = item->getBySeqno();
+            const auto nru = item->getNRUValue();
+            return GetValue(std::move(item), ENGINE_SUCCESS, seqno, false, nru);
+        }
+    }
+
+    auto hbl = getLockedBucket(cHandle.getKey(), cookie);
     StoredValue* v = fetchValidValue(hbl,
                                      cHandle.getKey(),
                                      WantsDeleted::Yes,
@@ -1833,7 +2072,9 @@ GetValue VBucket::getInternal(
         // should cleanup the SV (if requested) before returning ENOENT (so we
         // don't keep temp items in HT).
         if (v->isTempDeletedItem() || v->isTempNonExistentItem()) {
-            if (options & DELETE_TEMP) {
+            if ((options & DELETE_TEMP) &&
+                !(v->isTempNonExistentItem() &&
+                  cacheNonExistentKey(hbl, *v))) {
                 deleteStoredValue(hbl, *v);
             }
             return GetValue();
@@ -1856,6 +2097,16 @@ GetValue VBucket::getInternal(
             item = v->toItemKeyOnly(getId());
         } else {
             item = v->toItem(hideCas, getId());
+            if (v->hasInlineValue()) {
+                // Inline values can't be shared with the Item.
+                ++stats.numGetValueCopies;
+            }
+            if (hotKeyCache && !hideCas &&
+                v->getCommitted() == CommittedState::Committed &&
+                !v->isDeleted() && !v->isLocked(ep_current_time()) &&
+                v->getFreqCounterValue() >= hotKeyCacheMinFreq) {
+                hotKeyCache->insert(*item, ht.getLockVersion(hbl));
+            }
         }
 
         if (options & TRACK_STATISTICS) {
@@ -2134,9 +2385,16 @@ void VBucket::postProcessRollback(const RollbackResult& rollbackResult,
     incrRollbackItemCount(prevHighSeqno - rollbackResult.highSeqno);
     checkpointManager->setOpenCheckpointId(1);
     setReceivingInitialDiskSnapshot(false);
+    if (expiryIndex) {
+        // The rolled back items were restored from disk, bypassing the index.
+        expiryIndex->setComplete(false);
+    }
 }
 
 void VBucket::collectionsRolledBack(KVStore& kvstore) {
+    // The items are still in memory; carry their accounting over.
+    Collections::Summary memUsed;
+    manifest->lock().updateMemUsedSummary(memUsed);
     manifest = std::make_unique<Collections::VB::Manifest>(
             kvstore.getCollectionsManifest(getId()));
     auto kvstoreContext = kvstore.makeFileHandle(getId());
@@ -2148,6 +2406,10 @@ void VBucket::collectionsRolledBack(KVStore& kvstore) {
                 *kvstoreContext, collection.first).itemCount);
         collection.second.resetPersistedHighSeqno(kvstore.getCollectionStats(
                 *kvstoreContext, collection.first).highSeqno);
+        auto used = memUsed.find(collection.first);
+        if (used != memUsed.end()) {
+            collection.second.setMemUsed(used->second);
+        }
     }
 }
 
@@ -2220,6 +2482,22 @@ void VBucket::_addStats(bool details, ADD_STAT add_stat, const void* c) {
         addStat("hp_vb_req_size", getHighPriorityChkSize(), add_stat, c);
         addStat("might_contain_xattrs", mightContainXattrs(), add_stat, c);
         addStat("max_deleted_revid", ht.getMaxDeletedRevSeqno(), add_stat, c);
+        if (negativeKeyCacheTtl != 0) {
+            addStat("negative_key_cache_hits",
+                    ht.getNegativeKeyCache().getHits(),
+                    add_stat,
+                    c);
+        }
+        if (hotKeyCache) {
+            addStat("hot_key_cache_hits", hotKeyCache->getHits(), add_stat, c);
+            addStat("hot_key_cache_misses",
+                    hotKeyCache->getMisses(),
+                    add_stat,
+                    c);
+        }
+        if (expiryIndex) {
+            addStat("expiry_index_size", expiryIndex->size(), add_stat, c);
+        }
         hlc.addStats(statPrefix, add_stat, c);
     }
 }
@@ -2534,8 +2812,8 @@ VBucket::processExpiredItem(
      * but functionally correct and for performance reasons
      * only the system xattrs need to be stored.
      */
-    value_t value = v.getValue();
-    bool onlyMarkDeleted = value && mcbp::datatype::is_xattr(v.getDatatype());
+    bool onlyMarkDeleted =
+            v.hasValue() && mcbp::datatype::is_xattr(v.getDatatype());
     v.setRevSeqno(v.getRevSeqno() + 1);
     VBNotifyCtx notifyCtx;
     StoredValue* newSv;
@@ -2563,6 +2841,16 @@ bool VBucket::deleteStoredValue(const HashTable::HashBucketLock& hbl,
     return true;
 }
 
+bool VBucket::cacheNonExistentKey(const HashTable::HashBucketLock& hbl,
+                                  StoredValue& v) {
+    if (negativeKeyCacheTtl == 0 || !v.isTempItem()) {
+        return false;
+    }
+    ht.getNegativeKeyCache().insert(v.getKey(),
+                                    ep_current_time() + negativeKeyCacheTtl);
+    return deleteStoredValue(hbl, v);
+}
+
 TempAddStatus VBucket::addTempStoredValue(const HashTable::HashBucketLock& hbl,
                                           const DocKey& key) {
     if (!hbl.getHTLock()) {
@@ -2635,6 +2923,7 @@ int64_t VBucket::queueItem(Item* item, OptionalSeqno seqno) {
 
 VBNotifyCtx VBucket::queueDirty(StoredValue& v,
                                 const VBQueueItemCtx& queueItmCtx) {
+    TRACE_SCOPE(queueItmCtx.cookie, cb::tracing::TraceCode::QUEUE_DIRTY);
     if (queueItmCtx.trackCasDrift == TrackCasDrift::Yes) {
         setMaxCasAndTrackDrift(v.getCas());
     }
@@ -2663,7 +2952,8 @@ void VBucket::addHighPriorityVBEntry(uint64_t seqnoOrChkId,
                                      const void* cookie,
                                      HighPriorityVBNotify reqType) {
     std::unique_lock<std::mutex> lh(hpVBReqsMutex);
-    hpVBReqs.push_back(HighPriorityVBEntry(cookie, seqnoOrChkId, reqType));
+    hpVBReqs.emplace(std::make_pair(reqType, seqnoOrChkId),
+                     HighPriorityVBEntry(cookie, seqnoOrChkId, reqType));
     numHpVBReqs.store(hpVBReqs.size());
 
     EP_LOG_INFO(
@@ -2680,52 +2970,70 @@ std::map<const void*, ENGINE_ERROR_CODE> VBucket::getHighPriorityNotifications(
         EventuallyPersistentEngine& engine,
         uint64_t idNum,
         HighPriorityVBNotify notifyType) {
-    std::unique_lock<std::mutex> lh(hpVBReqsMutex);
     std::map<const void*, ENGINE_ERROR_CODE> toNotify;
+    // Called after every commit (and for ephemeral, every mutation); avoid
+    // the lock in the common case of no-one waiting.
+    if (numHpVBReqs.load() == 0) {
+        return toNotify;
+    }
 
-    auto entry = hpVBReqs.begin();
-
-    while (entry != hpVBReqs.end()) {
-        if (notifyType != entry->reqType) {
-            ++entry;
-            continue;
-        }
-
-        std::string logStr(to_string(notifyType));
-
-        auto wall_time = std::chrono::steady_clock::now() - entry->start;
-        auto spent =
-                std::chrono::duration_cast<std::chrono::seconds>(wall_time);
-        if (entry->id <= idNum) {
-            toNotify[entry->cookie] = ENGINE_SUCCESS;
-            stats.chkPersistenceHisto.add(
-                    std::chrono::duration_cast<std::chrono::microseconds>(
-                            wall_time));
-            adjustCheckpointFlushTimeout(spent);
-            EP_LOG_INFO(
-                    "Notified the completion of {} for {} Check for: {}, "
-                    "Persisted upto: {}, cookie {}",
-                    logStr,
-                    getId(),
-                    entry->id,
-                    idNum,
-                    entry->cookie);
-            entry = hpVBReqs.erase(entry);
-        } else if (spent > getCheckpointFlushTimeout()) {
-            adjustCheckpointFlushTimeout(spent);
-            engine.storeEngineSpecific(entry->cookie, NULL);
-            toNotify[entry->cookie] = ENGINE_TMPFAIL;
-            EP_LOG_WARN(
-                    "Notified the timeout on {} for {} Check for: {}, "
-                    "Persisted upto: {}, cookie {}",
-                    logStr,
-                    getId(),
-                    entry->id,
-                    idNum,
-                    entry->cookie);
-            entry = hpVBReqs.erase(entry);
-        } else {
-            ++entry;
+    std::unique_lock<std::mutex> lh(hpVBReqsMutex);
+    const std::string logStr(to_string(notifyType));
+    const auto now = std::chrono::steady_clock::now();
+    auto& histo = notifyType == HighPriorityVBNotify::Seqno
+                          ? stats.seqnoPersistenceHisto
+                          : stats.chkPersistenceHisto;
+
+    // The requests satisfied are those of this type awaiting up to idNum.
+    const auto begin =
+            hpVBReqs.lower_bound(std::make_pair(notifyType, uint64_t(0)));
+    const auto end = hpVBReqs.upper_bound(std::make_pair(notifyType, idNum));
+    for (auto entry = begin; entry != end; ++entry) {
+        const auto& req = entry->second;
+        auto wall_time = now - req.start;
+        toNotify[req.cookie] = ENGINE_SUCCESS;
+        histo.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                wall_time));
+        adjustCheckpointFlushTimeout(
+                std::chrono::duration_cast<std::chrono::seconds>(wall_time));
+        EP_LOG_INFO(
+                "Notified the completion of {} for {} Check for: {}, "
+                "Persisted upto: {}, cookie {}",
+                logStr,
+                getId(),
+                req.id,
+                idNum,
+                req.cookie);
+    }
+    hpVBReqs.erase(begin, end);
+
+    // Timeouts are in whole seconds, so there's no need to look through the
+    // remaining requests (of this type) more than once a second.
+    auto& nextTimeoutCheck =
+            hpVBReqsTimeoutCheck[static_cast<size_t>(notifyType)];
+    if (now >= nextTimeoutCheck) {
+        nextTimeoutCheck = now + std::chrono::seconds(1);
+        auto entry = end;
+        while (entry != hpVBReqs.end() && entry->first.first == notifyType) {
+            const auto& req = entry->second;
+            auto spent = std::chrono::duration_cast<std::chrono::seconds>(
+                    now - req.start);
+            if (spent > getCheckpointFlushTimeout()) {
+                adjustCheckpointFlushTimeout(spent);
+                engine.storeEngineSpecific(req.cookie, NULL);
+                toNotify[req.cookie] = ENGINE_TMPFAIL;
+                EP_LOG_WARN(
+                        "Notified the timeout on {} for {} Check for: {}, "
+                        "Persisted upto: {}, cookie {}",
+                        logStr,
+                        getId(),
+                        req.id,
+                        idNum,
+                        req.cookie);
+                entry = hpVBReqs.erase(entry);
+            } else {
+                ++entry;
+            }
         }
     }
     numHpVBReqs.store(hpVBReqs.size());
@@ -2739,10 +3047,11 @@ std::map<const void*, ENGINE_ERROR_CODE> VBucket::tmpFailAndGetAllHpNotifies(
     LockHolder lh(hpVBReqsMutex);
 
     for (auto& entry : hpVBReqs) {
-        toNotify[entry.cookie] = ENGINE_TMPFAIL;
-        engine.storeEngineSpecific(entry.cookie, NULL);
+        toNotify[entry.second.cookie] = ENGINE_TMPFAIL;
+        engine.storeEngineSpecific(entry.second.cookie, NULL);
     }
     hpVBReqs.clear();
+    numHpVBReqs.store(0);
 
     return toNotify;
 }
@@ -2769,9 +3078,8 @@ std::unique_ptr<Item> VBucket::pruneXattrDocument(
     // Need to take a copy of the value, prune it, and add it back
 
     // Create work-space document
-    std::vector<char> workspace(
-            v.getValue()->getData(),
-            v.getValue()->getData() + v.getValue()->valueSize());
+    const auto value = v.getValueData();
+    std::vector<char> workspace(value.data(), value.data() + value.size());
 
     // Now attach to the XATTRs in the document
     cb::xattr::Blob xattr({workspace.data(), workspace.size()},
@@ -33,7 +33,9 @@
 #include <platform/atomic_duration.h>
 #include <platform/non_negative_counter.h>
 #include <relaxed_atomic.h>
+#include <array>
 #include <atomic>
+#include <map>
 #include <queue>
 
 class EPStats;
@@ -44,6 +46,8 @@ class ItemMetaData;
 class PreLinkDocumentContext;
 class EventuallyPersistentEngine;
 class DCPBackfill;
+class ExpiryIndex;
+class HotKeyCache;
 class RollbackResult;
 class VBucketBGFetchItem;
 
@@ -92,6 +96,8 @@ struct VBQueueItemCtx {
     cb::durability::Requirements durabilityReqs =
             cb::durability::NoRequirements;
     PreLinkDocumentContext* preLinkDocumentContext = nullptr;
+    /// The request being served (if any), to record trace spans in
+    const void* cookie = nullptr;
 };
 
 /**
@@ -349,7 +355,7 @@ public:
      */
     void setState_UNLOCKED(vbucket_state_t to, WriterLockHolder& vbStateLock);
 
-    cb::RWLock& getStateLock() {return stateLock;}
+    ProfiledRWLock& getStateLock() {return stateLock;}
 
     vbucket_state_t getInitialState(void) { return initialState; }
 
@@ -532,6 +538,18 @@ public:
 
     virtual void notifyAllPendingConnsFailed(EventuallyPersistentEngine& e) = 0;
 
+    /**
+     * Free up to the given number of the items of a deleted vBucket, so
+     * VBucketMemoryDeletionTask can release a large vBucket in bounded
+     * steps. Only valid once the vBucket has no owners.
+     *
+     * @param limit the most items to free
+     * @return {true if there are items left to free, bytes freed}
+     */
+    virtual std::pair<bool, size_t> releaseItems(size_t limit) {
+        return ht.releaseItems(limit);
+    }
+
     /**
      * Get high priority notifications for a seqno or checkpoint persisted
      *
@@ -554,10 +572,20 @@ public:
     /**
      * BloomFilter operations for vbucket
      */
-    void createFilter(size_t key_count, double probability);
-    void initTempFilter(size_t key_count, double probability);
+    void createFilter(size_t key_count,
+                      double probability,
+                      bool blocked = false);
+    void initTempFilter(size_t key_count,
+                        double probability,
+                        bool blocked = false);
     void addToFilter(const DocKey& key);
     virtual bool maybeKeyExistsInFilter(const DocKey& key);
+
+    /**
+     * maybeKeyExistsInFilter(), recording the time taken in the trace of the
+     * request being served (if any).
+     */
+    bool maybeKeyExistsInFilter(const DocKey& key, const void* cookie);
     bool isTempFilterAvailable();
     void addToTempFilter(const DocKey& key);
     void swapFilter();
@@ -567,6 +595,21 @@ public:
     size_t getFilterSize();
     size_t getNumOfKeysInFilter();
 
+    /**
+     * @return the serialised bloom filter, or an empty string if the vBucket
+     *         has no complete (ENABLED) filter.
+     */
+    std::string serialiseFilter();
+
+    /**
+     * Install a bloom filter persisted by a previous run, if the vBucket has
+     * no filter of its own yet. The filter must cover every key of the
+     * vBucket.
+     *
+     * @return true if the filter was installed
+     */
+    bool restoreFilter(std::unique_ptr<BloomFilter> filter);
+
     uint64_t nextHLCCas() {
         return hlc.nextHLC();
     }
@@ -886,6 +929,30 @@ public:
             cb::StoreIfPredicate predicate,
             const Collections::VB::Manifest::CachingReadHandle& cHandle);
 
+    /**
+     * Update a document with the result of a function applied to its current
+     * version, holding the hash bucket lock throughout (see
+     * EngineIface::mutate_in_place).
+     *
+     * @param key the key of the document
+     * @param cookie the connection cookie
+     * @param engine Reference to ep engine
+     * @param mutator function producing the new version of the document
+     * @param cHandle Collections readhandle (caching mode) for this key
+     * @param maxTtl the bucket's max TTL, applied to the new version
+     * @param[out] cas the CAS of the document on success
+     *
+     * @return ENGINE_ERROR_CODE status notified to be to the front end
+     */
+    ENGINE_ERROR_CODE mutateInPlace(
+            const DocKey& key,
+            const void* cookie,
+            EventuallyPersistentEngine& engine,
+            const cb::DocumentMutator& mutator,
+            const Collections::VB::Manifest::CachingReadHandle& cHandle,
+            std::chrono::seconds maxTtl,
+            uint64_t& cas);
+
     /**
      * Add an item directly into its vbucket rather than putting it on a
      * checkpoint (backfill the item). The can happen during DCP or when a
@@ -1044,6 +1111,19 @@ public:
     virtual bool eligibleToPageOut(const HashTable::HashBucketLock& lh,
                                    const StoredValue& v) const = 0;
 
+    /**
+     * Move the given StoredValue to a newly allocated copy of it (to
+     * defragment the memory holding StoredValues); the original is deleted.
+     *
+     * @param lh Bucket lock associated with the StoredValue.
+     * @param v Reference to the StoredValue to be reallocated.
+     *
+     * @return the copy now in the HashTable, or nullptr if the StoredValue
+     *         can't currently be moved (in which case v is unchanged).
+     */
+    virtual StoredValue* reallocateStoredValue(
+            const HashTable::HashBucketLock& lh, StoredValue& v) = 0;
+
     /**
      * Add an item in the store
      *
@@ -1187,6 +1267,11 @@ public:
      */
     bool deleteKey(const DocKey& key);
 
+    /// @returns the vBucket's expiry index, or nullptr if disabled.
+    ExpiryIndex* getExpiryIndex() {
+        return expiryIndex.get();
+    }
+
     /**
      * Creates a DCP backfill object
      *
@@ -1357,6 +1442,15 @@ public:
     };
 
 protected:
+    /**
+     * ht.findForWrite() / ht.getLockedBucket(), recording the time taken
+     * (mostly waiting for the hash bucket lock) in the trace of the request
+     * being served (if any).
+     */
+    HashTable::FindResult findForWrite(const DocKey& key, const void* cookie);
+    HashTable::HashBucketLock getLockedBucket(const DocKey& key,
+                                              const void* cookie);
+
     /**
      * This function checks for the various states of the value & depending on
      * which the calling function can issue a bgfetch as needed.
@@ -1474,6 +1568,20 @@ protected:
     bool deleteStoredValue(const HashTable::HashBucketLock& hbl,
                            StoredValue& v);
 
+    /**
+     * Replace the temporary item of a key which a background fetch found to
+     * have no document on disk (not even a deleted one) with an entry in the
+     * HashTable's NegativeKeyCache, if that's enabled
+     * (negative_key_cache_ttl). maybeKeyExistsInFilter() then returns false
+     * for the key, as it would if the bloom filter excluded it.
+     *
+     * @param hbl Hash table bucket lock that must be held
+     * @param v the temporary item
+     * @return true if the temporary item was deleted
+     */
+    bool cacheNonExistentKey(const HashTable::HashBucketLock& hbl,
+                             StoredValue& v);
+
     /**
      * Queue an item for persistence and replication. Maybe track CAS drift
      *
@@ -1598,8 +1706,20 @@ protected:
     /* last seqno that is persisted on the disk */
     std::atomic<uint64_t> persistenceSeqno;
 
-    /* holds all high priority async requests to the vbucket */
-    std::list<HighPriorityVBEntry> hpVBReqs;
+    /*
+     * holds all high priority async requests to the vbucket, ordered by
+     * request type and then the seqno / checkpoint id awaited; so the
+     * requests satisfied by a commit are a prefix of those of its type.
+     */
+    std::multimap<std::pair<HighPriorityVBNotify, uint64_t>,
+                  HighPriorityVBEntry>
+            hpVBReqs;
+
+    /*
+     * When the requests of each type which are still waiting should next
+     * be checked for timing out (checking them is linear in their number).
+     */
+    std::array<std::chrono::steady_clock::time_point, 2> hpVBReqsTimeoutCheck;
 
     /* synchronizes access to hpVBReqs */
     std::mutex hpVBReqsMutex;
@@ -1821,7 +1941,7 @@ private:
 
     Vbid id;
     std::atomic<vbucket_state_t>    state;
-    cb::RWLock                      stateLock;
+    ProfiledRWLock                  stateLock;
     vbucket_state_t                 initialState;
     std::mutex                           pendingOpLock;
     std::vector<const void*>        pendingOps;
@@ -1878,6 +1998,21 @@ private:
      */
     std::atomic<bool> mayContainXattrs;
 
+    /// Cache of the most frequently read items, consulted by getInternal()
+    /// before the HashTable. Null if disabled (hot_key_cache_size == 0).
+    std::unique_ptr<HotKeyCache> hotKeyCache;
+
+    /// Minimum frequency counter of items admitted to hotKeyCache.
+    const uint16_t hotKeyCacheMinFreq;
+
+    /// Seconds to remember keys without a document on disk for; 0 if the
+    /// NegativeKeyCache is disabled.
+    const rel_time_t negativeKeyCacheTtl;
+
+    /// Keys of the items with an expiry time, for the expiry pager. Null if
+    /// disabled (exp_pager_index_enabled == false).
+    std::unique_ptr<ExpiryIndex> expiryIndex;
+
     static cb::AtomicDuration chkFlushTimeout;
 
     static double mutationMemThreshold;
@@ -23,6 +23,7 @@
 
 #include <phosphor/phosphor.h>
 #include <chrono>
+#include <limits>
 
 VBucketMemoryDeletionTask::VBucketMemoryDeletionTask(
         EventuallyPersistentEngine& eng, VBucket* vb, TaskId tid)
@@ -51,9 +52,12 @@ bool VBucketMemoryDeletionTask::run() {
                  "vb",
                  (vbucket->getId()).get());
 
-    notifyAllPendingConnsFailed(true);
+    if (!notified) {
+        notifyAllPendingConnsFailed(true);
+        notified = true;
+    }
 
-    return false;
+    return releaseItems();
 }
 
 void VBucketMemoryDeletionTask::notifyAllPendingConnsFailed(
@@ -66,6 +70,27 @@ void VBucketMemoryDeletionTask::notifyAllPendingConnsFailed(
     }
 }
 
+bool VBucketMemoryDeletionTask::releaseItems() {
+    size_t limit = engine->getConfiguration().getVbucketDeletionChunkSize();
+    if (limit == 0) {
+        limit = std::numeric_limits<size_t>::max();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto released = vbucket->releaseItems(limit);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    auto& stats = engine->getEpStats();
+    stats.vbucketDelMemFreed += released.second;
+    stats.vbucketDelMemTime += elapsed.count();
+
+    if (released.first) {
+        snooze(0);
+    }
+    return released.first;
+}
+
 VBucketMemoryAndDiskDeletionTask::VBucketMemoryAndDiskDeletionTask(
         EventuallyPersistentEngine& eng, KVShard& shard, EPVBucket* vb)
     : VBucketMemoryDeletionTask(eng,
@@ -81,10 +106,15 @@ bool VBucketMemoryAndDiskDeletionTask::run() {
                  "VBucketMemoryAndDiskDeletionTask",
                  "vb",
                  (vbucket->getId()).get());
+    if (notified) {
+        return releaseItems();
+    }
     notifyAllPendingConnsFailed(false);
+    notified = true;
 
     auto start = std::chrono::steady_clock::now();
-    shard.getRWUnderlying()->delVBucket(vbucket->getId(), vbDeleteRevision);
+    shard.getRWUnderlying(vbucket->getId())
+            ->delVBucket(vbucket->getId(), vbDeleteRevision);
     auto elapsed = std::chrono::steady_clock::now() - start;
     auto wallTime =
             std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
@@ -101,5 +131,5 @@ bool VBucketMemoryAndDiskDeletionTask::run() {
                                  ENGINE_SUCCESS);
     }
 
-    return false;
+    return releaseItems();
 }
@@ -25,7 +25,9 @@ class EPVBucket;
 /*
  * This is a NONIO task called as part of VB deletion.  The task is responsible
  * for clearing all the VBucket's pending operations and for deleting the
- * VBucket (via a smart pointer).
+ * VBucket (via a smart pointer). The items of the VBucket are freed in chunks
+ * of vbucket_deletion_chunk_size, over as many runs as needed, so deleting a
+ * large VBucket doesn't hold a thread (and free memory) for long at a time.
  *
  * This task is designed to be invoked only when the VBucket has no owners.
  */
@@ -55,6 +57,14 @@ protected:
      */
     void notifyAllPendingConnsFailed(bool notifyIfCookieSet);
 
+    /**
+     * Free the next chunk of the VBucket's items.
+     *
+     * @return true if there are items left to free (and the task is
+     *         snoozed to free them on its next run)
+     */
+    bool releaseItems();
+
     /**
      * The vbucket we are deleting is stored in a unique_ptr for RAII deletion
      * once this task is finished and itself deleted, the VBucket will be
@@ -62,6 +72,9 @@ protected:
      */
     std::unique_ptr<VBucket> vbucket;
     std::string description;
+
+    /// Set once the pending operations have been notified (by the first run)
+    bool notified = false;
 };
 
 /*
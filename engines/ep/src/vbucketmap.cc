@@ -47,6 +47,13 @@ VBucketPtr VBucketMap::getBucket(Vbid id) const {
     }
 }
 
+VBucketReadHandle VBucketMap::getBucketForRead(Vbid id) const {
+    if (id.get() < size) {
+        return getShardByVbId(id)->getBucketForRead(id);
+    }
+    return VBucketReadHandle(VBucketPtr());
+}
+
 ENGINE_ERROR_CODE VBucketMap::addBucket(VBucketPtr vb) {
     if (vb->getId().get() < size) {
         getShardByVbId(vb->getId())->setBucket(vb);
@@ -76,6 +76,12 @@ public:
     void dropVBucketAndSetupDeferredDeletion(Vbid id, const void* cookie);
     VBucketPtr getBucket(Vbid id) const;
 
+    /**
+     * Get the VBucket for the duration of a front-end operation; cheaper
+     * than getBucket() on the op path (see VBucketReadHandle).
+     */
+    VBucketReadHandle getBucketForRead(Vbid id) const;
+
     // Returns the size of the map, i.e. the total number of VBuckets it can
     // contain.
     size_t getSize() const {
@@ -26,6 +26,7 @@
 #include "ep_engine.h"
 #include "ep_vb.h"
 #include "failover-table.h"
+#include "hashtable_image.h"
 #include "kv_bucket.h"
 #include "mutation_log.h"
 #include "statwriter.h"
@@ -34,6 +35,7 @@
 #include <platform/timeutils.h>
 
 #include <array>
+#include <cstdio>
 #include <limits>
 #include <memory>
 #include <random>
@@ -172,9 +174,10 @@ private:
 
 class WarmupKeyDump : public GlobalTask {
 public:
-    WarmupKeyDump(KVBucket& st, uint16_t sh, Warmup* w)
+    WarmupKeyDump(KVBucket& st, uint16_t sh, size_t scan, Warmup* w)
         : GlobalTask(&st.getEPEngine(), TaskId::WarmupKeyDump, 0, false),
           _shardId(sh),
+          _scanIndex(scan),
           _warmup(w),
           _description("Warmup - key dump: shard " + std::to_string(_shardId)) {
         _warmup->addToTaskSet(uid);
@@ -194,13 +197,14 @@ public:
 
     bool run() {
         TRACE_EVENT1("ep-engine/task", "WarmupKeyDump", "shard", _shardId);
-        _warmup->keyDumpforShard(_shardId);
+        _warmup->keyDumpforShard(_shardId, _scanIndex);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    size_t _scanIndex;
     Warmup* _warmup;
     const std::string _description;
 };
@@ -274,9 +278,10 @@ private:
 
 class WarmupLoadingKVPairs : public GlobalTask {
 public:
-    WarmupLoadingKVPairs(KVBucket& st, uint16_t sh, Warmup* w)
+    WarmupLoadingKVPairs(KVBucket& st, uint16_t sh, size_t scan, Warmup* w)
         : GlobalTask(&st.getEPEngine(), TaskId::WarmupLoadingKVPairs, 0, false),
           _shardId(sh),
+          _scanIndex(scan),
           _warmup(w),
           _description("Warmup - loading KV Pairs: shard " +
                        std::to_string(_shardId)) {
@@ -298,22 +303,24 @@ public:
 
     bool run() {
         TRACE_EVENT0("ep-engine/task", "WarmupLoadingKVPairs");
-        _warmup->loadKVPairsforShard(_shardId);
+        _warmup->loadKVPairsforShard(_shardId, _scanIndex);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    size_t _scanIndex;
     Warmup* _warmup;
     const std::string _description;
 };
 
 class WarmupLoadingData : public GlobalTask {
 public:
-    WarmupLoadingData(KVBucket& st, uint16_t sh, Warmup* w) :
+    WarmupLoadingData(KVBucket& st, uint16_t sh, size_t scan, Warmup* w) :
         GlobalTask(&st.getEPEngine(), TaskId::WarmupLoadingData, 0, false),
         _shardId(sh),
+        _scanIndex(scan),
         _warmup(w),
         _description("Warmup - loading data: shard " +
                      std::to_string(_shardId)) {
@@ -335,13 +342,14 @@ public:
 
     bool run() {
         TRACE_EVENT0("ep-engine/task", "WarmupLoadingData");
-        _warmup->loadDataforShard(_shardId);
+        _warmup->loadDataforShard(_shardId, _scanIndex);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    size_t _scanIndex;
     Warmup* _warmup;
     const std::string _description;
 };
@@ -410,10 +418,16 @@ private:
 };
 
 static bool batchWarmupCallback(Vbid vbId,
-                                const std::set<StoredDocKey>& fetches,
+                                const std::vector<StoredDocKey>& fetches,
                                 void* arg) {
     WarmupCookie *c = static_cast<WarmupCookie *>(arg);
 
+    if (c->epstore->getWarmup()->isLoadedFromImage(vbId)) {
+        // Data already loaded from the vBucket's HashTable image.
+        c->skipped += fetches.size();
+        return true;
+    }
+
     if (!c->epstore->maybeEnableTraffic()) {
         vb_bgfetch_queue_t items2fetch;
         for (auto& key : fetches) {
@@ -751,6 +765,8 @@ Warmup::Warmup(KVBucket& st, Configuration& config_)
       shardVbStates(store.vbMap.getNumShards()),
       threadtask_count(0),
       shardKeyDumpStatus(store.vbMap.getNumShards()),
+      scansPerShard(config.getWarmupScansPerShard()),
+      vbProgress(config.getMaxVbuckets()),
       shardVbIds(store.vbMap.getNumShards()),
       estimatedItemCount(std::numeric_limits<size_t>::max()),
       cleanShutdown(true),
@@ -902,6 +918,19 @@ void Warmup::createVBuckets(uint16_t shardId) {
                         entry.vb_uuid,
                         entry.by_seqno);
             }
+
+            // Restore the bloom filter persisted on shutdown, rather than
+            // running without one until the next compaction.
+            const auto filter =
+                    store.getROUnderlyingByShard(shardId)
+                            ->getPersistedBloomFilter(vbid, vbs.highSeqno);
+            if (!filter.empty() && cleanShutdown &&
+                config.isBfilterEnabled() && config.isBfilterPersist() &&
+                vb->restoreFilter(BloomFilter::deserialise(filter))) {
+                EP_LOG_INFO("Warmup::createVBuckets: {} restored bloom filter",
+                            vbid);
+            }
+
             KVBucket* bucket = &this->store;
             vb->setFreqSaturatedCallback(
                     [bucket]() { bucket->wakeItemFreqDecayerTask(); });
@@ -976,6 +1005,11 @@ void Warmup::estimateDatabaseItemCount(uint16_t shardId)
         VBucketPtr vb = store.getVBucket(vbid);
         if (vb) {
             vb->setNumTotalItems(vbItemCount);
+            if (store.getItemEvictionPolicy() == VALUE_ONLY) {
+                // All of the items are about to be loaded; size the
+                // HashTable for them up front
+                vb->ht.reserve(vbItemCount);
+            }
         }
         item_count += vbItemCount;
     }
@@ -995,38 +1029,29 @@ void Warmup::estimateDatabaseItemCount(uint16_t shardId)
 void Warmup::scheduleKeyDump()
 {
     threadtask_count = 0;
+    resetVBucketProgress();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupKeyDump>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t scan = 0; scan < scansPerShard; ++scan) {
+            ExTask task =
+                    std::make_shared<WarmupKeyDump>(store, i, scan, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 
 }
 
-void Warmup::keyDumpforShard(uint16_t shardId)
+void Warmup::keyDumpforShard(uint16_t shardId, size_t scanIndex)
 {
-    KVStore* kvstore = store.getROUnderlyingByShard(shardId);
     auto cb = std::make_shared<LoadStorageKVPairCallback>(
             store, false, state.getState());
     auto cl =
             std::make_shared<Collections::VB::LogicallyDeletedCallback>(store);
 
-    for (const auto vbid : shardVbIds[shardId]) {
-        ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
-                                                    DocumentFilter::NO_DELETES,
-                                                    ValueFilter::KEYS_ONLY);
-        if (ctx) {
-            auto errorCode = kvstore->scan(ctx);
-            kvstore->destroyScanContext(ctx);
-            if (errorCode == scan_again) { // ENGINE_ENOMEM
-                // skip loading remaining VBuckets as memory limit was reached
-                break;
-            }
-        }
-    }
+    scanVBuckets(shardId, scanIndex, cb, cl, ValueFilter::KEYS_ONLY);
 
     shardKeyDumpStatus[shardId] = true;
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (scanCompleted()) {
         bool success = false;
         for (size_t i = 0; i < store.vbMap.getNumShards(); i++) {
             if (shardKeyDumpStatus[i]) {
@@ -1207,9 +1232,13 @@ void Warmup::scheduleLoadingKVPairs()
     setEstimatedWarmupCount(estimatedItemCount);
 
     threadtask_count = 0;
+    resetVBucketProgress();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadingKVPairs>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t scan = 0; scan < scansPerShard; ++scan) {
+            ExTask task = std::make_shared<WarmupLoadingKVPairs>(
+                    store, i, scan, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 
 }
@@ -1224,16 +1253,14 @@ ValueFilter getValueFilterForCompressionMode(
     return ValueFilter::VALUES_DECOMPRESSED;
 }
 
-void Warmup::loadKVPairsforShard(uint16_t shardId)
+void Warmup::loadKVPairsforShard(uint16_t shardId, size_t scanIndex)
 {
     bool maybe_enable_traffic = false;
-    scan_error_t errorCode = scan_success;
 
     if (store.getItemEvictionPolicy() == FULL_EVICTION) {
         maybe_enable_traffic = true;
     }
 
-    KVStore* kvstore = store.getROUnderlyingByShard(shardId);
     auto cb = std::make_shared<LoadStorageKVPairCallback>(
             store, maybe_enable_traffic, state.getState());
     auto cl =
@@ -1242,20 +1269,9 @@ void Warmup::loadKVPairsforShard(uint16_t shardId)
     ValueFilter valFilter = getValueFilterForCompressionMode(
                                     store.getEPEngine().getCompressionMode());
 
-    for (const auto vbid : shardVbIds[shardId]) {
-        ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
-                                                    DocumentFilter::NO_DELETES,
-                                                    valFilter);
-        if (ctx) {
-            errorCode = kvstore->scan(ctx);
-            kvstore->destroyScanContext(ctx);
-            if (errorCode == scan_again) { // ENGINE_ENOMEM
-                // skip loading remaining VBuckets as memory limit was reached
-                break;
-            }
-        }
-    }
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    scanVBuckets(shardId, scanIndex, cb, cl, valFilter);
+
+    if (scanCompleted()) {
         transition(WarmupState::State::Done);
     }
 }
@@ -1266,9 +1282,13 @@ void Warmup::scheduleLoadingData()
     setEstimatedWarmupCount(estimatedCount);
 
     threadtask_count = 0;
+    resetVBucketProgress();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadingData>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t scan = 0; scan < scansPerShard; ++scan) {
+            ExTask task = std::make_shared<WarmupLoadingData>(
+                    store, i, scan, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 }
 
@@ -1281,11 +1301,8 @@ void Warmup::scheduleLoadingCollectionCounts() {
     }
 }
 
-void Warmup::loadDataforShard(uint16_t shardId)
+void Warmup::loadDataforShard(uint16_t shardId, size_t scanIndex)
 {
-    scan_error_t errorCode = scan_success;
-
-    KVStore* kvstore = store.getROUnderlyingByShard(shardId);
     auto cb = std::make_shared<LoadStorageKVPairCallback>(
             store, true, state.getState());
     auto cl =
@@ -1294,23 +1311,104 @@ void Warmup::loadDataforShard(uint16_t shardId)
     ValueFilter valFilter = getValueFilterForCompressionMode(
                                           store.getEPEngine().getCompressionMode());
 
-    for (const auto vbid : shardVbIds[shardId]) {
-        ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
-                                                    DocumentFilter::NO_DELETES,
-                                                    valFilter);
-        if (ctx) {
-            errorCode = kvstore->scan(ctx);
-            kvstore->destroyScanContext(ctx);
-            if (errorCode == scan_again) { // ENGINE_ENOMEM
-                // skip loading remaining VBuckets as memory limit was reached
-                break;
+    scanVBuckets(shardId, scanIndex, cb, cl, valFilter);
+
+    if (scanCompleted()) {
+        transition(WarmupState::State::Done);
+    }
+}
+
+void Warmup::scanVBuckets(uint16_t shardId,
+                          size_t scanIndex,
+                          std::shared_ptr<StatusCallback<GetValue>> cb,
+                          std::shared_ptr<StatusCallback<CacheLookup>> cl,
+                          ValueFilter valFilter) {
+    KVStore* kvstore = store.getROUnderlyingByShard(shardId);
+    const auto& vbIds = shardVbIds[shardId];
+    for (size_t ii = scanIndex; ii < vbIds.size(); ii += scansPerShard) {
+        const auto vbid = vbIds[ii];
+        auto& progress = vbProgress[vbid.get()];
+        if (progress.loadedFromImage) {
+            progress.state = VBucketProgress::State::Done;
+            continue;
+        }
+        progress.state = VBucketProgress::State::Loading;
+        const auto start = std::chrono::steady_clock::now();
+
+        scan_error_t errorCode = scan_success;
+        bool stopped = false;
+        if (loadHashTableImage(shardId, vbid, *cb, stopped)) {
+            if (stopped) {
+                errorCode = scan_again;
             }
+        } else {
+            ScanContext* ctx = kvstore->initScanContext(
+                    cb, cl, vbid, 0, DocumentFilter::NO_DELETES, valFilter);
+            if (ctx) {
+                errorCode = kvstore->scan(ctx);
+                kvstore->destroyScanContext(ctx);
+            }
+        }
+
+        progress.duration = std::chrono::steady_clock::now() - start;
+        progress.state = VBucketProgress::State::Done;
+        if (errorCode == scan_again) { // ENGINE_ENOMEM
+            // skip loading remaining VBuckets as memory limit was reached
+            break;
         }
     }
+}
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
-        transition(WarmupState::State::Done);
+bool Warmup::loadHashTableImage(uint16_t shardId,
+                                Vbid vbid,
+                                StatusCallback<GetValue>& cb,
+                                bool& stopped) {
+    const auto& config = store.getEPEngine().getConfiguration();
+    const auto fileName =
+            HashTableImage::getFileName(config.getDbname(), vbid);
+    const auto vbState = shardVbStates[shardId].find(vbid);
+    if (!cleanShutdown || !config.isWarmupHashtableImage() ||
+        vbState == shardVbStates[shardId].end()) {
+        // Any image left behind can't be trusted to match the data file.
+        std::remove(fileName.c_str());
+        return false;
     }
+
+    const auto result = HashTableImage::load(
+            fileName, vbid, vbState->second.highSeqno, cb);
+    if (!result.loaded) {
+        return false;
+    }
+
+    // The load callback accounts for items as this phase would have loaded
+    // them; correct for what the image actually provided.
+    auto& stats = store.getEPEngine().getEpStats();
+    if (state.getState() == WarmupState::State::KeyDump) {
+        stats.warmedUpValues += result.values;
+    } else {
+        stats.warmedUpValues -= result.items - result.values;
+    }
+
+    stopped = result.stopped;
+    vbProgress[vbid.get()].loadedFromImage =
+            result.includesValues && !result.stopped;
+    EP_LOG_INFO("Warmup loaded {} items ({} values) of {} from {}",
+                result.items,
+                result.values,
+                vbid,
+                fileName);
+    return true;
+}
+
+void Warmup::resetVBucketProgress() {
+    for (auto& progress : vbProgress) {
+        progress.state = VBucketProgress::State::Pending;
+        progress.duration = std::chrono::steady_clock::duration::zero();
+    }
+}
+
+bool Warmup::scanCompleted() {
+    return ++threadtask_count == store.vbMap.getNumShards() * scansPerShard;
 }
 
 void Warmup::loadCollectionCountsForShard(uint16_t shardId) {
@@ -1479,6 +1577,35 @@ void Warmup::addStats(ADD_STAT add_stat, const void *c) const
     }
 }
 
+void Warmup::addVBucketStats(ADD_STAT add_stat, const void* c) const {
+    using namespace std::chrono;
+
+    for (const auto& vbIds : shardVbIds) {
+        for (const auto vbid : vbIds) {
+            const auto& progress = vbProgress[vbid.get()];
+            const char* stateName = "pending";
+            switch (progress.state.load()) {
+            case VBucketProgress::State::Pending:
+                break;
+            case VBucketProgress::State::Loading:
+                stateName = "loading";
+                break;
+            case VBucketProgress::State::Done:
+                stateName = "done";
+                break;
+            }
+            const std::string prefix = "vb_" + std::to_string(vbid.get());
+            add_casted_stat((prefix + ":state").c_str(), stateName, add_stat, c);
+            add_casted_stat(
+                    (prefix + ":time").c_str(),
+                    duration_cast<microseconds>(progress.duration.load())
+                            .count(),
+                    add_stat,
+                    c);
+        }
+    }
+}
+
 /* In the case of CouchKVStore, all vbucket states of all the shards
  * are stored in a single instance. Others (e.g. RocksDBKVStore) store
  * only the vbucket states specific to that shard. Hence the vbucket
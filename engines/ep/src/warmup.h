@@ -123,6 +123,8 @@ private:
 };
 
 
+enum class ValueFilter;
+
 class Warmup {
 public:
     Warmup(KVBucket& st, Configuration& config);
@@ -142,10 +144,22 @@ public:
 
     void addStats(ADD_STAT add_stat, const void *c) const;
 
+    /// Add the progress of loading each vBucket's data ("warmup-vbuckets")
+    void addVBucketStats(ADD_STAT add_stat, const void* c) const;
+
+    /// @return the number of tasks scanning each shard's vBuckets
+    size_t getScansPerShard() const {
+        return scansPerShard;
+    }
+
     std::chrono::steady_clock::duration getTime() {
         return warmup.load();
     }
 
+    const WarmupState& getWarmupState() const {
+        return state;
+    }
+
     void setWarmupTime() {
         std::lock_guard<std::mutex> lock(warmupStart.mutex);
         warmup.store(std::chrono::steady_clock::now() - warmupStart.time +
@@ -188,14 +202,19 @@ public:
 
     bool hasOOMFailure() { return warmupOOMFailure.load(); }
 
+    /// @return true if the vBucket's data was loaded from a HashTable image.
+    bool isLoadedFromImage(Vbid vbid) const {
+        return vbProgress[vbid.get()].loadedFromImage;
+    }
+
     void initialize();
     void createVBuckets(uint16_t shardId);
     void estimateDatabaseItemCount(uint16_t shardId);
-    void keyDumpforShard(uint16_t shardId);
+    void keyDumpforShard(uint16_t shardId, size_t scanIndex);
     void checkForAccessLog();
     void loadingAccessLog(uint16_t shardId);
-    void loadKVPairsforShard(uint16_t shardId);
-    void loadDataforShard(uint16_t shardId);
+    void loadKVPairsforShard(uint16_t shardId, size_t scanIndex);
+    void loadDataforShard(uint16_t shardId, size_t scanIndex);
     void loadCollectionCountsForShard(uint16_t shardId);
     void done();
 
@@ -221,6 +240,37 @@ private:
 
     void transition(WarmupState::State to, bool force = false);
 
+    /**
+     * Scan the vBuckets of the shard which belong to the given scan (every
+     * scansPerShard'th one, starting at scanIndex), stopping early if the
+     * memory limit is reached. A vBucket with a valid HashTable image is
+     * loaded from that instead, and its data isn't scanned again by later
+     * phases if the image included values.
+     */
+    void scanVBuckets(uint16_t shardId,
+                      size_t scanIndex,
+                      std::shared_ptr<StatusCallback<GetValue>> cb,
+                      std::shared_ptr<StatusCallback<CacheLookup>> cl,
+                      ValueFilter valFilter);
+
+    /**
+     * Load the vBucket from its HashTable image, if it has one which is
+     * usable. Any image found is removed.
+     *
+     * @return true if the vBucket was loaded (possibly only in part, if
+     *         loading stopped on the memory limit - see stopped).
+     */
+    bool loadHashTableImage(uint16_t shardId,
+                            Vbid vbid,
+                            StatusCallback<GetValue>& cb,
+                            bool& stopped);
+
+    /// Mark every vBucket as not yet scanned by the current phase.
+    void resetVBucketProgress();
+
+    /// Called by a scan task when it completes; true for the last one.
+    bool scanCompleted();
+
     WarmupState state;
 
     KVBucket& store;
@@ -246,6 +296,23 @@ private:
     std::atomic<size_t> threadtask_count;
     std::vector<std::atomic<bool>> shardKeyDumpStatus;
 
+    /// Number of tasks scanning each shard's vBuckets in parallel when
+    /// dumping keys or loading data.
+    const size_t scansPerShard;
+
+    /// Progress of the current scan phase through a vBucket.
+    struct VBucketProgress {
+        enum class State : uint8_t { Pending, Loading, Done };
+        std::atomic<State> state{State::Pending};
+        cb::AtomicDuration duration;
+        /// Data (not just keys) was loaded from a HashTable image; kept
+        /// across phases.
+        std::atomic<bool> loadedFromImage{false};
+    };
+
+    /// Indexed by vBucket ID.
+    std::vector<VBucketProgress> vbProgress;
+
     /// vector of vectors of VBucket IDs (one vector per shard). Each vector
     /// contains all vBucket IDs which are present for the given shard.
     std::vector<std::vector<Vbid>> shardVbIds;
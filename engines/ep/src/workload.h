@@ -18,8 +18,8 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <atomic>
-
 #include <string>
 
 enum bucket_priority_t {
@@ -76,9 +76,83 @@ public:
         workloadPattern.store(pattern);
     }
 
+    /**
+     * Split the reader + writer threads between the readers and the
+     * writers for the given workload (see workload_adaptive).
+     *
+     * Read-heavy workloads get most of the threads as readers, unless the
+     * active items are (nearly) all resident so the reads rarely need a
+     * background fetch; write-heavy ones get most as writers (the flushers).
+     * A backlog on the disk write queue moves a quarter of the threads
+     * over to the writers.
+     *
+     * @param pattern The current workload pattern
+     * @param residentRatio Percentage of the active items resident in memory
+     * @param diskBacklog true if the disk write queue isn't keeping up
+     * @param threads The total number of reader + writer threads
+     * @return The number of readers (the writers get the rest); at least
+     *         one of each if there are 2 or more threads.
+     */
+    static size_t getNumReadersFor(workload_pattern_t pattern,
+                                   size_t residentRatio,
+                                   bool diskBacklog,
+                                   size_t threads) {
+        if (threads < 2) {
+            return threads;
+        }
+
+        // Share of the threads given to the readers, in quarters.
+        size_t quarters;
+        switch (pattern) {
+        case READ_HEAVY:
+            quarters = residentRatio >= fullyResidentRatio ? 2 : 3;
+            break;
+        case WRITE_HEAVY:
+            quarters = 1;
+            break;
+        default:
+            quarters = 2;
+            break;
+        }
+        if (diskBacklog && quarters > 1) {
+            --quarters;
+        }
+
+        const size_t readers = (threads * quarters + 2) / 4;
+        return std::max(size_t(1), std::min(threads - 1, readers));
+    }
+
+    /// Record a reader / writer split applied by the adaptive monitor.
+    void recordAdjustment(size_t readers, size_t writers) {
+        adaptiveReaders.store(readers);
+        adaptiveWriters.store(writers);
+        ++numAdjustments;
+    }
+
+    size_t getAdaptiveReaders() const {
+        return adaptiveReaders.load();
+    }
+
+    size_t getAdaptiveWriters() const {
+        return adaptiveWriters.load();
+    }
+
+    size_t getNumAdjustments() const {
+        return numAdjustments.load();
+    }
+
+    /// Resident ratio (%) at which reads are mostly served from memory.
+    static const size_t fullyResidentRatio = 95;
+
 private:
 
     int maxNumWorkers;
     int maxNumShards;
     std::atomic<workload_pattern_t> workloadPattern;
+
+    // Last reader / writer split applied by the adaptive monitor (0 if none)
+    // and how many times one was applied.
+    std::atomic<size_t> adaptiveReaders{0};
+    std::atomic<size_t> adaptiveWriters{0};
+    std::atomic<size_t> numAdjustments{0};
 };
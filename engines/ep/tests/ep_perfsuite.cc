@@ -31,13 +31,16 @@
 
 #include "config.h"
 
+#include <mcbp/protocol/framebuilder.h>
 #include <memcached/engine.h>
 #include <memcached/engine_testapp.h>
 
 #include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iterator>
 #include <mutex>
 #include <numeric>
@@ -80,7 +83,14 @@ enum class BackgroundWork {
    // Performing bitwise operations and so explicitly assigning values
    None = 0x0,
    Sets = 0x1,
-   Dcp = 0x2
+   Dcp = 0x2,
+   // Work perf_latency_background_work runs alongside the latency client.
+   Compaction = 0x4,
+   ItemPager = 0x8,
+   HashTableResize = 0x10,
+   CheckpointRemoval = 0x20,
+   Warmup = 0x40,
+   CollectionDrop = 0x80
  };
 
 inline BackgroundWork operator | (BackgroundWork lhs, BackgroundWork rhs) {
@@ -104,6 +114,7 @@ struct Stats {
     double pct5;
     double pct95;
     double pct99;
+    double pct999;
     std::vector<T>* values;
 };
 
@@ -192,17 +203,17 @@ void renderToText(const std::string& name,
     }
 
     printf("\n\n                                Percentile           \n");
-    printf("  %-22s Median     95th     99th  Std Dev  Histogram of samples\n\n", "");
+    printf("  %-22s Median     95th     99th   99.9th  Std Dev  Histogram of samples\n\n", "");
     // Finally, print out each set.
     for (const auto& stats : value_stats) {
         if (stats.median/1e6 < 1) {
-            printf("%-22s %8.03f %8.03f %8.03f %8.03f  ",
+            printf("%-22s %8.03f %8.03f %8.03f %8.03f %8.03f  ",
                     stats.name.c_str(), stats.median/1e3, stats.pct95/1e3,
-                    stats.pct99/1e3, stats.stddev/1e3);
+                    stats.pct99/1e3, stats.pct999/1e3, stats.stddev/1e3);
         } else {
-            printf("%-15s (x1e3) %8.03f %8.03f %8.03f %8.03f  ",
+            printf("%-15s (x1e3) %8.03f %8.03f %8.03f %8.03f %8.03f  ",
                     stats.name.c_str(), stats.median/1e6, stats.pct95/1e6,
-                    stats.pct99/1e6, stats.stddev/1e6);
+                    stats.pct99/1e6, stats.pct999/1e6, stats.stddev/1e6);
         }
 
         // Calculate and render Sparkline (requires UTF-8 terminal).
@@ -230,7 +241,7 @@ void renderToText(const std::string& name,
         }
         putchar('\n');
     }
-    printf("%58s  %-14d %s %14d\n\n", "",
+    printf("%67s  %-14d %s %14d\n\n", "",
            int(spark_start/1e3), unit.c_str(), int(spark_end/1e3));
 }
 
@@ -269,6 +280,9 @@ void renderToXML(const std::string& name, const std::string& description,
              << classname << "\"/>\n"
              << "    <testcase name=\"" << name << "." << stats.name
              << ".pct99\" time=\"" << stats.pct99 / 1e3 << "\" classname=\""
+             << classname << "\"/>\n"
+             << "    <testcase name=\"" << name << "." << stats.name
+             << ".pct999\" time=\"" << stats.pct999 / 1e3 << "\" classname=\""
              << classname << "\"/>\n";
     }
     file << "  </testsuite>\n";
@@ -300,6 +314,7 @@ void output_result(const std::string& name,
         stats.pct5 = vec[(vec.size() * 5) / 100];
         stats.pct95 = vec[(vec.size() * 95) / 100];
         stats.pct99 = vec[(vec.size() * 99) / 100];
+        stats.pct999 = vec[(vec.size() * 999) / 1000];
 
         const double sum = std::accumulate(vec.begin(), vec.end(), 0.0);
         stats.mean = sum / vec.size();
@@ -1305,6 +1320,717 @@ static enum test_result perf_dcp_consumer_snap_end_mutation_latency(
     return SUCCESS;
 }
 
+/*
+ * DCP replication between two buckets: a DcpProducer on the "active" bucket
+ * streams to a DcpConsumer on the "replica" bucket, as ns_server sets up
+ * replication between two nodes. Each connection is driven by its own thread
+ * (as memcached runs each connection on a single front-end thread), and the
+ * messages between them are passed through an Inbox per connection, which
+ * stands in for the network.
+ */
+class DcpReplication {
+public:
+    DcpReplication(EngineIface* active, EngineIface* replica)
+        : producer(active, *this), consumer(replica, *this) {
+    }
+
+    /**
+     * The messages for a connection. Each message is executed by the
+     * connection's thread (which is woken up as they are added).
+     */
+    class Inbox {
+    public:
+        explicit Inbox(const void* cookie) : cookie(cookie) {
+        }
+
+        void push(std::function<void()> message) {
+            {
+                std::lock_guard<std::mutex> lh(mutex);
+                messages.push_back(std::move(message));
+            }
+            testHarness->notify_io_complete(cookie, ENGINE_SUCCESS);
+        }
+
+        std::deque<std::function<void()>> drain() {
+            std::deque<std::function<void()>> ret;
+            std::lock_guard<std::mutex> lh(mutex);
+            ret.swap(messages);
+            return ret;
+        }
+
+        bool empty() {
+            std::lock_guard<std::mutex> lh(mutex);
+            return messages.empty();
+        }
+
+    private:
+        const void* cookie;
+        std::mutex mutex;
+        std::deque<std::function<void()>> messages;
+    };
+
+    /// One end of the replication, and the messages it sends to the other.
+    class Endpoint : public dcp_message_producers {
+    public:
+        Endpoint(EngineIface* h, DcpReplication& replication)
+            : h(h),
+              dcp(dynamic_cast<DcpIface&>(*h)),
+              cookie(testHarness->create_cookie()),
+              inbox(cookie),
+              replication(replication) {
+        }
+
+        ~Endpoint() override {
+            testHarness->destroy_cookie(cookie);
+        }
+
+        /// Execute the incoming messages and step the connection until told
+        /// to stop.
+        void run() {
+            while (!replication.stopping) {
+                for (auto& message : inbox.drain()) {
+                    message();
+                }
+                const auto ret = dcp.step(cookie, this);
+                if (ret == ENGINE_EWOULDBLOCK) {
+                    testHarness->lock_cookie(cookie);
+                    if (inbox.empty() && !replication.stopping) {
+                        testHarness->waitfor_cookie(cookie);
+                    }
+                    testHarness->unlock_cookie(cookie);
+                } else {
+                    checkeq(ENGINE_SUCCESS, ret, "Failed to step DCP");
+                }
+            }
+        }
+
+        /// Send the other end a response to one of its requests.
+        void respond(cb::mcbp::ClientOpcode opcode,
+                     uint32_t opaque,
+                     cb::mcbp::Status status,
+                     std::vector<uint8_t> value = {}) {
+            std::vector<uint8_t> buffer(sizeof(cb::mcbp::Response) +
+                                        value.size());
+            cb::mcbp::ResponseBuilder builder({buffer.data(), buffer.size()});
+            builder.setMagic(cb::mcbp::Magic::ClientResponse);
+            builder.setOpcode(opcode);
+            builder.setStatus(status);
+            builder.setOpaque(opaque);
+            builder.setValue({value.data(), value.size()});
+            auto& peer = getPeer();
+            peer.inbox.push([&peer, buffer]() {
+                peer.dcp.response_handler(
+                        peer.cookie,
+                        reinterpret_cast<const protocol_binary_response_header*>(
+                                buffer.data()));
+            });
+        }
+
+        ENGINE_ERROR_CODE get_failover_log(uint32_t, Vbid) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE stream_req(uint32_t,
+                                     Vbid,
+                                     uint32_t,
+                                     uint64_t,
+                                     uint64_t,
+                                     uint64_t,
+                                     uint64_t,
+                                     uint64_t) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE add_stream_rsp(uint32_t,
+                                         uint32_t,
+                                         cb::mcbp::Status) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE marker_rsp(uint32_t, cb::mcbp::Status) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE set_vbucket_state_rsp(uint32_t,
+                                                cb::mcbp::Status) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE stream_end(uint32_t,
+                                     Vbid,
+                                     uint32_t,
+                                     cb::mcbp::DcpStreamId) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE marker(uint32_t,
+                                 Vbid,
+                                 uint64_t,
+                                 uint64_t,
+                                 uint32_t,
+                                 cb::mcbp::DcpStreamId) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE mutation(uint32_t,
+                                   item*,
+                                   Vbid,
+                                   uint64_t,
+                                   uint64_t,
+                                   uint32_t,
+                                   const void*,
+                                   uint16_t,
+                                   uint8_t,
+                                   cb::mcbp::DcpStreamId) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE deletion(uint32_t,
+                                   item*,
+                                   Vbid,
+                                   uint64_t,
+                                   uint64_t,
+                                   const void*,
+                                   uint16_t,
+                                   cb::mcbp::DcpStreamId) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE deletion_v2(uint32_t,
+                                      gsl::not_null<item*>,
+                                      Vbid,
+                                      uint64_t,
+                                      uint64_t,
+                                      uint32_t,
+                                      cb::mcbp::DcpStreamId) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE expiration(uint32_t,
+                                     gsl::not_null<item*>,
+                                     Vbid,
+                                     uint64_t,
+                                     uint64_t,
+                                     uint32_t,
+                                     cb::mcbp::DcpStreamId) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE set_vbucket_state(uint32_t,
+                                            Vbid,
+                                            vbucket_state_t) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE noop(uint32_t) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE buffer_acknowledgement(uint32_t,
+                                                 Vbid,
+                                                 uint32_t) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE control(uint32_t,
+                                  cb::const_char_buffer,
+                                  cb::const_char_buffer) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE system_event(uint32_t,
+                                       Vbid,
+                                       mcbp::systemevent::id,
+                                       uint64_t,
+                                       mcbp::systemevent::version,
+                                       cb::const_byte_buffer,
+                                       cb::const_byte_buffer,
+                                       cb::mcbp::DcpStreamId) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE get_error_map(uint32_t, uint16_t) override {
+            return ENGINE_ENOTSUP;
+        }
+        // The load has no SyncWrites, so neither end sends these.
+        ENGINE_ERROR_CODE prepare(uint32_t,
+                                  item*,
+                                  Vbid,
+                                  uint64_t,
+                                  uint64_t,
+                                  uint32_t,
+                                  uint8_t,
+                                  DocumentState,
+                                  cb::durability::Requirements) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE seqno_acknowledged(uint32_t,
+                                             uint64_t,
+                                             uint64_t) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE commit(uint32_t, uint64_t, uint64_t) override {
+            return ENGINE_ENOTSUP;
+        }
+        ENGINE_ERROR_CODE abort(uint32_t, uint64_t, uint64_t) override {
+            return ENGINE_ENOTSUP;
+        }
+
+        EngineIface* const h;
+        DcpIface& dcp;
+        const void* const cookie;
+        Inbox inbox;
+
+    protected:
+        virtual Endpoint& getPeer() = 0;
+
+        DcpReplication& replication;
+    };
+
+    /// The active end, forwarding the DcpProducer's messages to the consumer.
+    class ProducerEndpoint : public Endpoint {
+    public:
+        using Endpoint::Endpoint;
+
+        ENGINE_ERROR_CODE stream_end(uint32_t opaque,
+                                     Vbid vbucket,
+                                     uint32_t flags,
+                                     cb::mcbp::DcpStreamId) override {
+            auto& consumer = replication.consumer;
+            consumer.inbox.push([&consumer, opaque, vbucket, flags]() {
+                checkeq(ENGINE_SUCCESS,
+                        consumer.dcp.stream_end(
+                                consumer.cookie, opaque, vbucket, flags),
+                        "Failed to apply stream end");
+            });
+            bytesSent += sizeof(cb::mcbp::Request) +
+                         sizeof(cb::mcbp::request::DcpStreamEndPayload);
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE marker(uint32_t opaque,
+                                 Vbid vbucket,
+                                 uint64_t start_seqno,
+                                 uint64_t end_seqno,
+                                 uint32_t flags,
+                                 cb::mcbp::DcpStreamId) override {
+            auto& consumer = replication.consumer;
+            consumer.inbox.push([&consumer,
+                                 opaque,
+                                 vbucket,
+                                 start_seqno,
+                                 end_seqno,
+                                 flags]() {
+                checkeq(ENGINE_SUCCESS,
+                        consumer.dcp.snapshot_marker(consumer.cookie,
+                                                     opaque,
+                                                     vbucket,
+                                                     start_seqno,
+                                                     end_seqno,
+                                                     flags),
+                        "Failed to apply snapshot marker");
+            });
+            bytesSent += sizeof(cb::mcbp::Request) +
+                         sizeof(cb::mcbp::request::DcpSnapshotMarkerPayload);
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE mutation(uint32_t opaque,
+                                   item* itm,
+                                   Vbid vbucket,
+                                   uint64_t by_seqno,
+                                   uint64_t rev_seqno,
+                                   uint32_t lock_time,
+                                   const void* meta,
+                                   uint16_t nmeta,
+                                   uint8_t nru,
+                                   cb::mcbp::DcpStreamId) override {
+            item_info info;
+            check(h->get_item_info(itm, &info), "Failed to get item info");
+            std::string key(reinterpret_cast<const char*>(info.key.data()),
+                            info.key.size());
+            const auto encoding = info.key.getEncoding();
+            std::string value(static_cast<const char*>(info.value[0].iov_base),
+                              info.value[0].iov_len);
+            std::string extMeta(static_cast<const char*>(meta), nmeta);
+            h->release(itm);
+            bytesSent += sizeof(cb::mcbp::Request) +
+                         sizeof(cb::mcbp::request::DcpMutationPayload) +
+                         key.size() + value.size() + extMeta.size();
+
+            auto& consumer = replication.consumer;
+            auto& lag = replication.lag;
+            auto& storeTimes = replication.storeTimes[vbucket.get()];
+            const auto datatype = info.datatype;
+            const auto cas = info.cas;
+            const auto flags = info.flags;
+            const auto exptime = uint32_t(info.exptime);
+            consumer.inbox.push([&consumer,
+                                 &lag,
+                                 &storeTimes,
+                                 opaque,
+                                 key,
+                                 encoding,
+                                 value,
+                                 extMeta,
+                                 datatype,
+                                 cas,
+                                 vbucket,
+                                 flags,
+                                 by_seqno,
+                                 rev_seqno,
+                                 exptime,
+                                 lock_time,
+                                 nru]() {
+                checkeq(ENGINE_SUCCESS,
+                        consumer.dcp.mutation(
+                                consumer.cookie,
+                                opaque,
+                                DocKey(cb::const_char_buffer(key), encoding),
+                                {reinterpret_cast<const uint8_t*>(value.data()),
+                                 value.size()},
+                                0,
+                                datatype,
+                                cas,
+                                vbucket,
+                                flags,
+                                by_seqno,
+                                rev_seqno,
+                                exptime,
+                                lock_time,
+                                {reinterpret_cast<const uint8_t*>(
+                                         extMeta.data()),
+                                 extMeta.size()},
+                                nru),
+                        "Failed to apply mutation");
+                // Each vBucket's loader stores its documents in seqno order,
+                // starting from 1.
+                const auto now = std::chrono::steady_clock::now()
+                                         .time_since_epoch()
+                                         .count();
+                lag.push_back(now - storeTimes.at(by_seqno - 1).load());
+            });
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE noop(uint32_t opaque) override {
+            auto& consumer = replication.consumer;
+            consumer.inbox.push([&consumer, opaque]() {
+                checkeq(ENGINE_SUCCESS,
+                        consumer.dcp.noop(consumer.cookie, opaque),
+                        "Failed to apply noop");
+                consumer.respond(cb::mcbp::ClientOpcode::DcpNoop,
+                                 opaque,
+                                 cb::mcbp::Status::Success);
+            });
+            bytesSent += sizeof(cb::mcbp::Request);
+            return ENGINE_SUCCESS;
+        }
+
+        /// The number of bytes the producer sent to the consumer
+        size_t bytesSent = 0;
+
+    protected:
+        Endpoint& getPeer() override {
+            return replication.consumer;
+        }
+    };
+
+    /// The replica end, forwarding the DcpConsumer's messages to the producer.
+    class ConsumerEndpoint : public Endpoint {
+    public:
+        using Endpoint::Endpoint;
+
+        ENGINE_ERROR_CODE get_error_map(uint32_t opaque, uint16_t) override {
+            // Respond as the producer's memcached would.
+            replication.producer.respond(cb::mcbp::ClientOpcode::GetErrorMap,
+                                         opaque,
+                                         cb::mcbp::Status::Success);
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE control(uint32_t opaque,
+                                  cb::const_char_buffer key,
+                                  cb::const_char_buffer value) override {
+            auto& producer = replication.producer;
+            producer.inbox.push([&producer,
+                                 opaque,
+                                 k = std::string(key.data(), key.size()),
+                                 v = std::string(value.data(), value.size())]() {
+                const auto ret = producer.dcp.control(
+                        producer.cookie, opaque, k, v);
+                producer.respond(cb::mcbp::ClientOpcode::DcpControl,
+                                 opaque,
+                                 ret == ENGINE_SUCCESS
+                                         ? cb::mcbp::Status::Success
+                                         : cb::mcbp::Status::Einval);
+            });
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE stream_req(uint32_t opaque,
+                                     Vbid vbucket,
+                                     uint32_t flags,
+                                     uint64_t start_seqno,
+                                     uint64_t end_seqno,
+                                     uint64_t vbucket_uuid,
+                                     uint64_t snap_start_seqno,
+                                     uint64_t snap_end_seqno) override {
+            auto& producer = replication.producer;
+            producer.inbox.push([&producer,
+                                 opaque,
+                                 vbucket,
+                                 flags,
+                                 start_seqno,
+                                 end_seqno,
+                                 vbucket_uuid,
+                                 snap_start_seqno,
+                                 snap_end_seqno]() {
+                uint64_t rollbackSeqno = 0;
+                failoverLog.clear();
+                const auto ret = producer.dcp.stream_req(producer.cookie,
+                                                         flags,
+                                                         opaque,
+                                                         vbucket,
+                                                         start_seqno,
+                                                         end_seqno,
+                                                         vbucket_uuid,
+                                                         snap_start_seqno,
+                                                         snap_end_seqno,
+                                                         &rollbackSeqno,
+                                                         addFailoverLog,
+                                                         {});
+                // The producer is empty when the stream is requested, so
+                // never asks the consumer to roll back.
+                checkeq(ENGINE_SUCCESS, ret, "Failed to request stream");
+                producer.respond(cb::mcbp::ClientOpcode::DcpStreamReq,
+                                 opaque,
+                                 cb::mcbp::Status::Success,
+                                 std::move(failoverLog));
+            });
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE add_stream_rsp(uint32_t,
+                                         uint32_t,
+                                         cb::mcbp::Status status) override {
+            checkeq(cb::mcbp::Status::Success,
+                    status,
+                    "Failed to add the replication stream");
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE marker_rsp(uint32_t opaque,
+                                     cb::mcbp::Status status) override {
+            respond(cb::mcbp::ClientOpcode::DcpSnapshotMarker, opaque, status);
+            return ENGINE_SUCCESS;
+        }
+
+        ENGINE_ERROR_CODE buffer_acknowledgement(
+                uint32_t opaque, Vbid vbucket, uint32_t buffer_bytes) override {
+            auto& producer = replication.producer;
+            producer.inbox.push([&producer, opaque, vbucket, buffer_bytes]() {
+                checkeq(ENGINE_SUCCESS,
+                        producer.dcp.buffer_acknowledgement(
+                                producer.cookie, opaque, vbucket, buffer_bytes),
+                        "Failed to acknowledge buffer");
+            });
+            return ENGINE_SUCCESS;
+        }
+
+    protected:
+        Endpoint& getPeer() override {
+            return replication.producer;
+        }
+
+    private:
+        static ENGINE_ERROR_CODE addFailoverLog(
+                vbucket_failover_t* entries,
+                size_t nentries,
+                gsl::not_null<const void*>) {
+            for (size_t ii = 0; ii < nentries; ++ii) {
+                const uint64_t entry[] = {htonll(entries[ii].uuid),
+                                          htonll(entries[ii].seqno)};
+                const auto* bytes = reinterpret_cast<const uint8_t*>(entry);
+                failoverLog.insert(
+                        failoverLog.end(), bytes, bytes + sizeof(entry));
+            }
+            return ENGINE_SUCCESS;
+        }
+
+        /// The failover log of the last stream request (as sent on the wire)
+        static std::vector<uint8_t> failoverLog;
+    };
+
+    ProducerEndpoint producer;
+    ConsumerEndpoint consumer;
+    std::atomic<bool> stopping{false};
+
+    /// The time each vBucket's documents were stored, indexed by seqno - 1
+    std::vector<std::vector<std::atomic<hrtime_t>>> storeTimes;
+
+    /// The time between storing each document and the consumer receiving it
+    std::vector<hrtime_t> lag;
+};
+
+std::vector<uint8_t> DcpReplication::ConsumerEndpoint::failoverLog;
+
+/*
+ * Measure the throughput of DCP replication between two buckets, while
+ * one front-end thread per vBucket loads documents of the given size into
+ * the active bucket.
+ */
+static enum test_result perf_dcp_replication(engine_test_t* test,
+                                             const std::string& title,
+                                             size_t valueSize,
+                                             bool compressed,
+                                             const std::string& flowControl) {
+    const uint16_t numVbuckets = 4;
+    const size_t itemsPerVbucket = ITERATIONS / 10 / numVbuckets;
+    const size_t itemCount = itemsPerVbucket * numVbuckets;
+
+    const std::string cfg = std::string(test->cfg) +
+                            ";dcp_flow_control_policy=" + flowControl + ";";
+    std::vector<BucketHolder> buckets;
+    if (create_buckets(cfg.c_str(), 2, buckets) != 2) {
+        destroy_buckets(buckets);
+        return FAIL;
+    }
+    auto* active = buckets[0].h;
+    auto* replica = buckets[1].h;
+    for (auto& bucket : buckets) {
+        test_setup(bucket.h);
+    }
+
+    for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+        check(set_vbucket_state(active, Vbid(vb), vbucket_state_active),
+              "Failed to set active vbucket state");
+        check(set_vbucket_state(replica, Vbid(vb), vbucket_state_replica),
+              "Failed to set replica vbucket state");
+    }
+
+    {
+        DcpReplication replication(active, replica);
+        replication.storeTimes.resize(numVbuckets);
+        for (auto& times : replication.storeTimes) {
+            times = std::vector<std::atomic<hrtime_t>>(itemsPerVbucket);
+        }
+        replication.lag.reserve(itemCount);
+
+        auto& producer = replication.producer;
+        auto& consumer = replication.consumer;
+        if (compressed) {
+            testHarness->set_datatype_support(producer.cookie,
+                                              PROTOCOL_BINARY_DATATYPE_SNAPPY);
+            testHarness->set_datatype_support(consumer.cookie,
+                                              PROTOCOL_BINARY_DATATYPE_SNAPPY);
+        }
+        checkeq(ENGINE_SUCCESS,
+                producer.dcp.open(producer.cookie,
+                                  /*opaque*/ 1,
+                                  /*seqno*/ 0,
+                                  cb::mcbp::request::DcpOpenPayload::Producer,
+                                  "replication:active->replica"),
+                "Failed to open producer");
+        if (compressed) {
+            checkeq(ENGINE_SUCCESS,
+                    producer.dcp.control(producer.cookie,
+                                         /*opaque*/ 2,
+                                         "force_value_compression",
+                                         "true"),
+                    "Failed to force value compression");
+        }
+        checkeq(ENGINE_SUCCESS,
+                consumer.dcp.open(consumer.cookie,
+                                  /*opaque*/ 1,
+                                  /*seqno*/ 0,
+                                  /*flags*/ 0,
+                                  "replication:active->replica"),
+                "Failed to open consumer");
+        for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+            checkeq(ENGINE_SUCCESS,
+                    consumer.dcp.add_stream(
+                            consumer.cookie, /*opaque*/ 3 + vb, Vbid(vb), 0),
+                    "Failed to add stream");
+        }
+
+        std::thread producerThread([&producer]() { producer.run(); });
+        std::thread consumerThread([&consumer]() { consumer.run(); });
+
+        const std::string value = R"({"value":")" +
+                                  std::string(valueSize, 'x') + R"("})";
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> loaders;
+        for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+            loaders.emplace_back([&replication, &value, active, vb,
+                                  itemsPerVbucket]() {
+                auto& times = replication.storeTimes[vb];
+                for (size_t ii = 0; ii < itemsPerVbucket; ++ii) {
+                    const auto key = "key_" + std::to_string(vb) + "_" +
+                                     std::to_string(ii);
+                    times[ii] = std::chrono::steady_clock::now()
+                                        .time_since_epoch()
+                                        .count();
+                    checkeq(cb::engine_errc::success,
+                            storeCasVb11(active,
+                                         nullptr,
+                                         OPERATION_SET,
+                                         key.c_str(),
+                                         value.data(),
+                                         value.size(),
+                                         /*flags*/ 0,
+                                         0,
+                                         Vbid(vb),
+                                         /*exp*/ 0,
+                                         PROTOCOL_BINARY_DATATYPE_JSON)
+                                    .first,
+                            "Failed set.");
+                }
+            });
+        }
+        for (auto& loader : loaders) {
+            loader.join();
+        }
+        const auto loaded = std::chrono::steady_clock::now();
+        wait_for_stat_to_be(replica, "vb_replica_curr_items", int(itemCount));
+        const auto end = std::chrono::steady_clock::now();
+
+        replication.stopping = true;
+        testHarness->notify_io_complete(producer.cookie, ENGINE_SUCCESS);
+        testHarness->notify_io_complete(consumer.cookie, ENGINE_SUCCESS);
+        producerThread.join();
+        consumerThread.join();
+
+        const auto seconds = std::chrono::duration<double>(end - start).count();
+        const auto loadSeconds =
+                std::chrono::duration<double>(loaded - start).count();
+        printf("\n\n");
+        int printed = printf("=== %s - %zu items", title.c_str(), itemCount);
+        fillLineWith('=', 88 - printed);
+        printf("\n  Front-end load:  %10.0f items/s\n"
+               "  Replication:     %10.0f items/s %10.2f MB/s\n",
+               itemCount / loadSeconds,
+               itemCount / seconds,
+               producer.bytesSent / seconds / (1024 * 1024));
+
+        std::vector<std::pair<std::string, std::vector<hrtime_t>*>> lag = {
+                {"Lag", &replication.lag}};
+        output_result(title, "Lag", lag, "µs");
+        printf("\n\n");
+    }
+
+    destroy_buckets(buckets);
+    return SUCCESS;
+}
+
+static enum test_result perf_dcp_replication_small(engine_test_t* test) {
+    return perf_dcp_replication(
+            test, "DCP replication (256B)", 256, false, "aggressive");
+}
+
+static enum test_result perf_dcp_replication_large(engine_test_t* test) {
+    return perf_dcp_replication(
+            test, "DCP replication (4KB)", 4096, false, "aggressive");
+}
+
+static enum test_result perf_dcp_replication_compressed(engine_test_t* test) {
+    return perf_dcp_replication(
+            test, "DCP replication (4KB Snappy)", 4096, true, "aggressive");
+}
+
+static enum test_result perf_dcp_replication_no_flow_control(
+        engine_test_t* test) {
+    return perf_dcp_replication(test,
+                                "DCP replication (4KB no flow control)",
+                                4096,
+                                false,
+                                "none");
+}
+
 static enum test_result perf_multi_thread_latency(engine_test_t* test) {
     return perf_latency_baseline_multi_thread_bucket(test,
                                                      1, /* bucket */
@@ -1339,6 +2065,303 @@ static enum test_result perf_latency_dcp_impact(EngineIface* h) {
     return result;
 }
 
+/*
+ * Background work for perf_latency_background_work. Each runs on its own
+ * thread, repeating until done is set.
+ */
+
+// Compact vBucket 0 back-to-back.
+static void perf_background_compaction(EngineIface* h,
+                                       const std::atomic<bool>& done) {
+    while (!done) {
+        compact_db(h, Vbid(0), Vbid(0), 0, 0, 0);
+        wait_for_stat_to_be(h, "ep_pending_compactions", 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// Keep lowering the watermarks below the memory used, so the ItemPager
+// constantly evicts (persisted) values.
+static void perf_background_item_pager(EngineIface* h,
+                                       const std::atomic<bool>& done) {
+    while (!done) {
+        const auto memUsed = size_t(get_int_stat(h, "mem_used"));
+        set_param(h,
+                  cb::mcbp::request::SetParamPayload::Type::Flush,
+                  "mem_low_wat",
+                  std::to_string(memUsed / 2).c_str());
+        set_param(h,
+                  cb::mcbp::request::SetParamPayload::Type::Flush,
+                  "mem_high_wat",
+                  std::to_string((memUsed * 3) / 4).c_str());
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+// Repeatedly shut down and warm up the given (already populated) bucket,
+// which shares the executor pool with the bucket under test.
+static void perf_background_warmup(BucketHolder& bucket,
+                                   const std::string& config,
+                                   const std::atomic<bool>& done) {
+    while (!done) {
+        testHarness->destroy_bucket(bucket.h, false);
+        bucket.h = testHarness->create_bucket(true, config.c_str());
+        cb_assert(bucket.h != nullptr);
+        wait_for_warmup_complete(bucket.h);
+    }
+}
+
+// Repeatedly create a collection, fill it and drop it - leaving the items to
+// be purged by the collection eraser.
+static void perf_background_collection_drop(EngineIface* h,
+                                            const std::atomic<bool>& done) {
+    const void* cookie = testHarness->create_cookie();
+    testHarness->set_collections_support(cookie, true);
+    const CollectionID collection = 8;
+    const std::string data(100, 'x');
+    const auto makeManifest = [](uint64_t uid, bool withCollection) {
+        std::stringstream manifest;
+        manifest << R"({"uid":")" << std::hex << uid
+                 << R"(","scopes":[{"name":"_default","uid":"0",)"
+                 << R"("collections":[{"name":"_default","uid":"0"})"
+                 << (withCollection ? R"(,{"name":"background","uid":"8"})"
+                                    : "")
+                 << "]}]}";
+        return manifest.str();
+    };
+
+    uint64_t uid = 0;
+    while (!done) {
+        auto manifest = makeManifest(++uid, true);
+        checkeq(cb::engine_errc::success,
+                h->collections.set_manifest(h, cookie, manifest),
+                "Failed to create the collection");
+        for (int ii = 0; ii < 1000; ++ii) {
+            auto ret = h->allocate(
+                    cookie,
+                    makeStoredDocKey("key" + std::to_string(ii), collection),
+                    data.size(),
+                    0,
+                    0,
+                    PROTOCOL_BINARY_RAW_BYTES,
+                    Vbid(0));
+            checkeq(cb::engine_errc::success,
+                    ret.first,
+                    "Failed to allocate a collection item");
+            item_info info;
+            check(h->get_item_info(ret.second.get(), &info),
+                  "Failed to get item info");
+            std::copy(data.begin(),
+                      data.end(),
+                      reinterpret_cast<char*>(info.value[0].iov_base));
+            uint64_t cas = 0;
+            checkeq(ENGINE_SUCCESS,
+                    h->store(cookie,
+                             ret.second.get(),
+                             cas,
+                             OPERATION_SET,
+                             {},
+                             DocumentState::Alive),
+                    "Failed to store a collection item");
+        }
+        manifest = makeManifest(++uid, false);
+        checkeq(cb::engine_errc::success,
+                h->collections.set_manifest(h, cookie, manifest),
+                "Failed to drop the collection");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    testHarness->destroy_cookie(cookie);
+}
+
+static std::string to_string(BackgroundWork work) {
+    const std::vector<std::pair<BackgroundWork, const char*>> names = {
+            {BackgroundWork::Sets, "sets"},
+            {BackgroundWork::Dcp, "DCP"},
+            {BackgroundWork::Compaction, "compaction"},
+            {BackgroundWork::ItemPager, "item pager"},
+            {BackgroundWork::HashTableResize, "HashTable resize"},
+            {BackgroundWork::CheckpointRemoval, "checkpoint removal"},
+            {BackgroundWork::Warmup, "warmup"},
+            {BackgroundWork::CollectionDrop, "collection drop"}};
+    std::string result;
+    for (const auto& name : names) {
+        if ((work & name.first) == name.first) {
+            result += (result.empty() ? "" : ", ") + std::string(name.second);
+        }
+    }
+    return result.empty() ? "none" : result;
+}
+
+/*
+ * Measure the front-end latency (as perf_latency) while the given
+ * combination of background work runs. Unlike perf_latency, persistence is
+ * left running as most of the background work depends on it.
+ *
+ * HashTableResize and CheckpointRemoval are driven by the bucket's own tasks
+ * (configured to resize from a tiny HashTable, and to create and remove
+ * small checkpoints frequently); the rest by a thread each.
+ */
+static enum test_result perf_latency_background_work(engine_test_t* test,
+                                                     const char* title,
+                                                     BackgroundWork work) {
+    std::string cfg(test->cfg);
+    if ((work & BackgroundWork::HashTableResize) ==
+        BackgroundWork::HashTableResize) {
+        cfg += ";ht_size=3;ht_resize_interval=1";
+    } else {
+        cfg += ";ht_size=393209";
+    }
+    if ((work & BackgroundWork::CheckpointRemoval) ==
+        BackgroundWork::CheckpointRemoval) {
+        cfg += ";chk_max_items=100;chk_remover_stime=1";
+    }
+
+    // Bucket 0 is measured; bucket 1 is (re)warmed up in the background.
+    const bool warmup =
+            (work & BackgroundWork::Warmup) == BackgroundWork::Warmup;
+    std::vector<BucketHolder> buckets;
+    const int numBuckets = warmup ? 2 : 1;
+    if (create_buckets(cfg.c_str(), numBuckets, buckets) != numBuckets) {
+        destroy_buckets(buckets);
+        return FAIL;
+    }
+    for (auto& bucket : buckets) {
+        test_setup(bucket.h);
+    }
+    auto* h = buckets[0].h;
+
+    if (warmup) {
+        // Give the warmup something to load.
+        const std::string data(100, 'x');
+        for (size_t ii = 0; ii < ITERATIONS; ++ii) {
+            const auto key = "warmup" + std::to_string(ii);
+            checkeq(cb::engine_errc::success,
+                    storeCasVb11(buckets[1].h,
+                                 nullptr,
+                                 OPERATION_SET,
+                                 key.c_str(),
+                                 data.c_str(),
+                                 data.size(),
+                                 0,
+                                 0,
+                                 Vbid(0))
+                            .first,
+                    "Failed to store a value");
+        }
+        wait_for_flusher_to_settle(buckets[1].h);
+    }
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> workers;
+    if ((work & BackgroundWork::Compaction) == BackgroundWork::Compaction) {
+        workers.emplace_back(perf_background_compaction, h, std::cref(done));
+    }
+    if ((work & BackgroundWork::ItemPager) == BackgroundWork::ItemPager) {
+        workers.emplace_back(perf_background_item_pager, h, std::cref(done));
+    }
+    const auto warmupConfig = get_bucket_config(cfg.c_str(), 1);
+    if (warmup) {
+        workers.emplace_back(perf_background_warmup,
+                             std::ref(buckets[1]),
+                             std::cref(warmupConfig),
+                             std::cref(done));
+    }
+    if ((work & BackgroundWork::CollectionDrop) ==
+        BackgroundWork::CollectionDrop) {
+        workers.emplace_back(
+                perf_background_collection_drop, h, std::cref(done));
+    }
+
+    std::vector<hrtime_t> add_timings, get_timings, replace_timings,
+            delete_timings;
+    add_timings.reserve(ITERATIONS);
+    get_timings.reserve(ITERATIONS);
+    replace_timings.reserve(ITERATIONS);
+    delete_timings.reserve(ITERATIONS);
+    perf_latency_core(h,
+                      0,
+                      ITERATIONS,
+                      add_timings,
+                      get_timings,
+                      replace_timings,
+                      delete_timings);
+
+    done = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    destroy_buckets(buckets);
+
+    const std::string description = std::string("Latency [") + title +
+                                    "] with background " + to_string(work) +
+                                    " - " + std::to_string(ITERATIONS) +
+                                    " items (µs)";
+    std::vector<std::pair<std::string, std::vector<hrtime_t>*>> all_timings;
+    all_timings.push_back(std::make_pair("Add", &add_timings));
+    all_timings.push_back(std::make_pair("Get", &get_timings));
+    all_timings.push_back(std::make_pair("Replace", &replace_timings));
+    all_timings.push_back(std::make_pair("Delete", &delete_timings));
+    output_result(title, description, all_timings, "µs");
+    return SUCCESS;
+}
+
+static enum test_result perf_latency_bg_baseline(engine_test_t* test) {
+    return perf_latency_background_work(
+            test, "Background baseline", BackgroundWork::None);
+}
+
+static enum test_result perf_latency_bg_compaction(engine_test_t* test) {
+    return perf_latency_background_work(
+            test, "With constant compaction", BackgroundWork::Compaction);
+}
+
+static enum test_result perf_latency_bg_item_pager(engine_test_t* test) {
+    return perf_latency_background_work(
+            test, "With constant eviction", BackgroundWork::ItemPager);
+}
+
+static enum test_result perf_latency_bg_ht_resize(engine_test_t* test) {
+    return perf_latency_background_work(test,
+                                        "With HashTable resizing",
+                                        BackgroundWork::HashTableResize);
+}
+
+static enum test_result perf_latency_bg_checkpoint_removal(
+        engine_test_t* test) {
+    return perf_latency_background_work(test,
+                                        "With checkpoint removal",
+                                        BackgroundWork::CheckpointRemoval);
+}
+
+static enum test_result perf_latency_bg_warmup(engine_test_t* test) {
+    return perf_latency_background_work(
+            test, "With another bucket warming up", BackgroundWork::Warmup);
+}
+
+static enum test_result perf_latency_bg_collection_drop(engine_test_t* test) {
+    return perf_latency_background_work(test,
+                                        "With collection drops",
+                                        BackgroundWork::CollectionDrop);
+}
+
+static enum test_result perf_latency_bg_persistence_work(engine_test_t* test) {
+    return perf_latency_background_work(
+            test,
+            "With compaction, eviction and checkpoint removal",
+            BackgroundWork::Compaction | BackgroundWork::ItemPager |
+                    BackgroundWork::CheckpointRemoval);
+}
+
+static enum test_result perf_latency_bg_all(engine_test_t* test) {
+    return perf_latency_background_work(
+            test,
+            "With all background work",
+            BackgroundWork::Compaction | BackgroundWork::ItemPager |
+                    BackgroundWork::HashTableResize |
+                    BackgroundWork::CheckpointRemoval |
+                    BackgroundWork::Warmup | BackgroundWork::CollectionDrop);
+}
+
 static void perf_stat_latency_core(EngineIface* h,
                                    int key_prefix,
                                    StatRuntime statRuntime) {
@@ -1624,6 +2647,70 @@ BaseTestCase testsuite_testcases[] = {
                  "backend=couchdb;ht_size=393209",
                  prepare, cleanup),
 
+        TestCaseV2("Background work latency (baseline)",
+                   perf_latency_bg_baseline,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (compaction)",
+                   perf_latency_bg_compaction,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (item pager)",
+                   perf_latency_bg_item_pager,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (HashTable resize)",
+                   perf_latency_bg_ht_resize,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (checkpoint removal)",
+                   perf_latency_bg_checkpoint_removal,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (warmup)",
+                   perf_latency_bg_warmup,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (collection drop)",
+                   perf_latency_bg_collection_drop,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (persistence work)",
+                   perf_latency_bg_persistence_work,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+        TestCaseV2("Background work latency (all)",
+                   perf_latency_bg_all,
+                   NULL,
+                   NULL,
+                   "backend=couchdb",
+                   prepare,
+                   cleanup),
+
         TestCase("DCP Consumer snapshot-end mutation latency",
                 perf_dcp_consumer_snap_end_mutation_latency,
                  test_setup,
@@ -1632,6 +2719,35 @@ BaseTestCase testsuite_testcases[] = {
                  prepare,
                  cleanup),
 
+        TestCaseV2("DCP replication (256B)",
+                   perf_dcp_replication_small,
+                   NULL,
+                   NULL,
+                   "backend=couchdb;ht_size=393209",
+                   prepare,
+                   cleanup),
+        TestCaseV2("DCP replication (4KB)",
+                   perf_dcp_replication_large,
+                   NULL,
+                   NULL,
+                   "backend=couchdb;ht_size=393209",
+                   prepare,
+                   cleanup),
+        TestCaseV2("DCP replication (4KB Snappy)",
+                   perf_dcp_replication_compressed,
+                   NULL,
+                   NULL,
+                   "backend=couchdb;ht_size=393209",
+                   prepare,
+                   cleanup),
+        TestCaseV2("DCP replication (4KB no flow control)",
+                   perf_dcp_replication_no_flow_control,
+                   NULL,
+                   NULL,
+                   "backend=couchdb;ht_size=393209",
+                   prepare,
+                   cleanup),
+
         TestCase("Baseline Stat latency", perf_stat_latency_baseline,
                  test_setup, teardown,
                  "backend=couchdb;ht_size=393209",
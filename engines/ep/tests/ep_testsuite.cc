@@ -3301,6 +3301,17 @@ static enum test_result test_access_scanner(EngineIface* h) {
             (std::string("access log file (") + name +
              ") should exist (got errno:" + std::to_string(errno)).c_str());
 
+    /* Nothing has changed, so an incremental run copies the keys from the
+     * previous access log, which becomes the .old file */
+    check(set_param(h,
+                    cb::mcbp::request::SetParamPayload::Type::Flush,
+                    "access_scanner_run",
+                    "true"),
+          "Failed to trigger access scanner");
+    wait_for_stat_to_be(h, "ep_num_access_scanner_runs", num_shards * 2);
+    checkeq(0, access(name.c_str(), F_OK), "access log file should exist");
+    checkeq(0, access(prev.c_str(), F_OK), ".old access log file should exist");
+
     /* Increase resident ratio by deleting items */
     checkeq(ENGINE_SUCCESS, vbucketDelete(h, Vbid(0)), "Expected success");
     check(set_vbucket_state(h, Vbid(0), vbucket_state_active),
@@ -6374,6 +6385,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
     std::vector<std::string> roKVStoreStats = {
                 "ro_0:backend_type",
                 "ro_0:close",
+                "ro_0:doc_cache_hits",
+                "ro_0:doc_cache_misses",
                 "ro_0:failure_compaction",
                 "ro_0:failure_get",
                 "ro_0:failure_open",
@@ -6381,6 +6394,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_0:io_compaction_write_bytes",
                 "ro_0:io_bg_fetch_docs_read",
                 "ro_0:io_num_write",
+                "ro_0:io_num_write_syscalls",
+                "ro_0:io_num_writes_combined",
                 "ro_0:io_bg_fetch_doc_bytes",
                 "ro_0:io_total_read_bytes",
                 "ro_0:io_total_write_bytes",
@@ -6389,6 +6404,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_0:open",
                 "ro_1:backend_type",
                 "ro_1:close",
+                "ro_1:doc_cache_hits",
+                "ro_1:doc_cache_misses",
                 "ro_1:failure_compaction",
                 "ro_1:failure_get",
                 "ro_1:failure_open",
@@ -6396,6 +6413,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_1:io_compaction_write_bytes",
                 "ro_1:io_bg_fetch_docs_read",
                 "ro_1:io_num_write",
+                "ro_1:io_num_write_syscalls",
+                "ro_1:io_num_writes_combined",
                 "ro_1:io_bg_fetch_doc_bytes",
                 "ro_1:io_total_read_bytes",
                 "ro_1:io_total_write_bytes",
@@ -6404,6 +6423,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_1:open",
                 "ro_2:backend_type",
                 "ro_2:close",
+                "ro_2:doc_cache_hits",
+                "ro_2:doc_cache_misses",
                 "ro_2:failure_compaction",
                 "ro_2:failure_get",
                 "ro_2:failure_open",
@@ -6411,6 +6432,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_2:io_compaction_write_bytes",
                 "ro_2:io_bg_fetch_docs_read",
                 "ro_2:io_num_write",
+                "ro_2:io_num_write_syscalls",
+                "ro_2:io_num_writes_combined",
                 "ro_2:io_bg_fetch_doc_bytes",
                 "ro_2:io_total_read_bytes",
                 "ro_2:io_total_write_bytes",
@@ -6419,6 +6442,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_2:open",
                 "ro_3:backend_type",
                 "ro_3:close",
+                "ro_3:doc_cache_hits",
+                "ro_3:doc_cache_misses",
                 "ro_3:failure_compaction",
                 "ro_3:failure_get",
                 "ro_3:failure_open",
@@ -6426,6 +6451,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_3:io_compaction_write_bytes",
                 "ro_3:io_bg_fetch_docs_read",
                 "ro_3:io_num_write",
+                "ro_3:io_num_write_syscalls",
+                "ro_3:io_num_writes_combined",
                 "ro_3:io_bg_fetch_doc_bytes",
                 "ro_3:io_total_read_bytes",
                 "ro_3:io_total_write_bytes",
@@ -6437,6 +6464,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
     std::vector<std::string> rwKVStoreStats = {
                 "rw_0:backend_type",
                 "rw_0:close",
+                "rw_0:doc_cache_hits",
+                "rw_0:doc_cache_misses",
                 "rw_0:failure_compaction",
                 "rw_0:failure_del",
                 "rw_0:failure_get",
@@ -6447,6 +6476,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_0:io_compaction_write_bytes",
                 "rw_0:io_bg_fetch_docs_read",
                 "rw_0:io_num_write",
+                "rw_0:io_num_write_syscalls",
+                "rw_0:io_num_writes_combined",
                 "rw_0:io_bg_fetch_doc_bytes",
                 "rw_0:io_total_read_bytes",
                 "rw_0:io_total_write_bytes",
@@ -6456,6 +6487,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_0:open",
                 "rw_1:backend_type",
                 "rw_1:close",
+                "rw_1:doc_cache_hits",
+                "rw_1:doc_cache_misses",
                 "rw_1:failure_compaction",
                 "rw_1:failure_del",
                 "rw_1:failure_get",
@@ -6466,6 +6499,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_1:io_compaction_write_bytes",
                 "rw_1:io_bg_fetch_docs_read",
                 "rw_1:io_num_write",
+                "rw_1:io_num_write_syscalls",
+                "rw_1:io_num_writes_combined",
                 "rw_1:io_bg_fetch_doc_bytes",
                 "rw_1:io_total_read_bytes",
                 "rw_1:io_total_write_bytes",
@@ -6475,6 +6510,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_1:open",
                 "rw_2:backend_type",
                 "rw_2:close",
+                "rw_2:doc_cache_hits",
+                "rw_2:doc_cache_misses",
                 "rw_2:failure_compaction",
                 "rw_2:failure_del",
                 "rw_2:failure_get",
@@ -6485,6 +6522,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_2:io_compaction_write_bytes",
                 "rw_2:io_bg_fetch_docs_read",
                 "rw_2:io_num_write",
+                "rw_2:io_num_write_syscalls",
+                "rw_2:io_num_writes_combined",
                 "rw_2:io_bg_fetch_doc_bytes",
                 "rw_2:io_total_read_bytes",
                 "rw_2:io_total_write_bytes",
@@ -6494,6 +6533,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_2:open",
                 "rw_3:backend_type",
                 "rw_3:close",
+                "rw_3:doc_cache_hits",
+                "rw_3:doc_cache_misses",
                 "rw_3:failure_compaction",
                 "rw_3:failure_del",
                 "rw_3:failure_get",
@@ -6504,6 +6545,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_3:io_compaction_write_bytes",
                 "rw_3:io_bg_fetch_docs_read",
                 "rw_3:io_num_write",
+                "rw_3:io_num_write_syscalls",
+                "rw_3:io_num_writes_combined",
                 "rw_3:io_bg_fetch_doc_bytes",
                 "rw_3:io_total_read_bytes",
                 "rw_3:io_total_write_bytes",
@@ -6536,6 +6579,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
             {"dcp",
              {"ep_dcp_count",
               "ep_dcp_dead_conn_count",
+              "ep_dcp_item_transform_cache_hits",
+              "ep_dcp_item_transform_cache_misses",
               "ep_dcp_items_remaining",
               "ep_dcp_items_sent",
               "ep_dcp_max_running_backfills",
@@ -6640,26 +6685,42 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
             {"info", {"info"}},
             {"allocator", {"detailed"}},
             {"config",
-             {"ep_backend",
+             {"ep_arena_memory_accounting",
+              "ep_backend",
               "ep_backfill_mem_threshold",
+              "ep_bfilter_blocked",
               "ep_bfilter_enabled",
               "ep_bfilter_fp_prob",
               "ep_bfilter_key_count",
+              "ep_bfilter_persist",
               "ep_bfilter_residency_threshold",
+              "ep_bgfetchers_per_shard",
               "ep_bucket_type",
               "ep_cache_size",
+              "ep_chk_lock_free_readers",
+              "ep_chk_max_bucket_memory",
               "ep_chk_max_items",
+              "ep_chk_max_vb_memory",
               "ep_chk_period",
               "ep_chk_remover_stime",
               "ep_collections_enabled",
               "ep_collections_max_size",
+              "ep_compaction_backoff_bg_wait",
               "ep_compaction_exp_mem_threshold",
+              "ep_compaction_io_rate_limit",
+              "ep_compaction_max_concurrent_vbuckets",
               "ep_compaction_write_queue_cap",
               "ep_compression_mode",
               "ep_config_file",
+              "ep_conflict_resolution_cas_summary_size",
               "ep_conflict_resolution_type",
               "ep_connection_manager_interval",
               "ep_couch_bucket",
+              "ep_couchstore_compact_metadata",
+              "ep_couchstore_doc_cache_size",
+              "ep_couchstore_read_handle_cache",
+              "ep_couchstore_scan_readahead_size",
+              "ep_couchstore_write_combine_size",
               "ep_cursor_dropping_lower_mark",
               "ep_cursor_dropping_upper_mark",
               "ep_cursor_dropping_checkpoint_mem_upper_mark",
@@ -6667,53 +6728,93 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_data_traffic_enabled",
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
+              "ep_dcp_backfill_shared_scans",
               "ep_dcp_conn_buffer_size",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
               "ep_dcp_conn_buffer_size_max",
               "ep_dcp_conn_buffer_size_perc",
+              "ep_dcp_conn_notifier_coalesce_us",
               "ep_dcp_enable_noop",
               "ep_dcp_ephemeral_backfill_type",
               "ep_dcp_flow_control_policy",
               "ep_dcp_max_unacked_bytes",
               "ep_dcp_min_compression_ratio",
               "ep_dcp_idle_timeout",
+              "ep_dcp_item_transform_cache_size",
               "ep_dcp_noop_mandatory_for_v5_features",
               "ep_dcp_noop_tx_interval",
+              "ep_dcp_producer_ready_queue_quantum",
               "ep_dcp_producer_snapshot_marker_yield_limit",
               "ep_dcp_consumer_process_buffered_messages_yield_limit",
               "ep_dcp_consumer_process_buffered_messages_batch_size",
+              "ep_dcp_consumer_processor_tasks",
               "ep_dcp_scan_byte_limit",
+              "ep_dcp_scan_byte_limit_max",
               "ep_dcp_scan_item_limit",
+              "ep_dcp_seqno_ack_batch_size",
+              "ep_dcp_seqno_ack_max_delay_us",
+              "ep_dcp_step_batch_size",
               "ep_dcp_takeover_max_time",
               "ep_defragmenter_age_threshold",
+              "ep_defragmenter_auto_interval",
+              "ep_defragmenter_auto_lower_threshold",
+              "ep_defragmenter_auto_min_interval",
+              "ep_defragmenter_auto_upper_threshold",
               "ep_defragmenter_chunk_duration",
               "ep_defragmenter_enabled",
               "ep_defragmenter_interval",
+              "ep_defragmenter_max_extent_utilization",
+              "ep_defragmenter_stored_value_enabled",
               "ep_disk_backfill_queue",
+              "ep_executor_autoscale_max_readers",
+              "ep_executor_autoscale_max_writers",
+              "ep_executor_local_queue_size",
+              "ep_executor_numa_binding",
+              "ep_executor_weight",
               "ep_exp_pager_enabled",
               "ep_exp_pager_initial_run_time",
               "ep_exp_pager_stime",
               "ep_failpartialwarmup",
+              "ep_flusher_batch_min_size",
               "ep_flusher_batch_split_trigger",
+              "ep_flusher_batch_target_commit_time",
+              "ep_flusher_group_commit_size",
+              "ep_flushers_per_shard",
               "ep_fsync_after_every_n_bytes_written",
+              "ep_get_keys_byte_limit",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_hot_key_cache_min_freq",
+              "ep_hot_key_cache_size",
+              "ep_ht_arena_allocator",
               "ep_ht_eviction_policy",
+              "ep_ht_huge_pages",
+              "ep_ht_inline_value_size",
+              "ep_ht_layout",
               "ep_ht_locks",
+              "ep_ht_numa_placement",
+              "ep_ht_read_lock_mode",
               "ep_ht_resize_interval",
+              "ep_ht_resize_mode",
+              "ep_ht_resize_step_size",
               "ep_ht_size",
               "ep_initfile",
               "ep_item_compressor_chunk_duration",
               "ep_item_compressor_interval",
               "ep_item_eviction_age_percentage",
+              "ep_item_eviction_collection_quota_percentage",
+              "ep_item_eviction_compress_values",
               "ep_item_eviction_freq_counter_age_threshold",
+              "ep_item_eviction_sample_size",
               "ep_item_freq_decayer_chunk_duration",
+              "ep_item_freq_decayer_lazy",
               "ep_item_freq_decayer_percent",
               "ep_item_num_based_new_chk",
               "ep_keep_closed_chks",
+              "ep_lock_profile_sample_rate",
               "ep_magma_max_commit_points",
               "ep_magma_max_write_cache",
               "ep_magma_mem_quota_ratio",
@@ -6733,18 +6834,25 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_max_vbuckets",
               "ep_mem_high_wat",
               "ep_mem_low_wat",
+              "ep_mem_quota_sharing",
               "ep_mem_used_merge_threshold_percent",
               "ep_min_compression_ratio",
               "ep_mutation_mem_threshold",
+              "ep_negative_key_cache_ttl",
               "ep_num_auxio_threads",
               "ep_num_nonio_threads",
               "ep_num_reader_threads",
               "ep_num_writer_threads",
               "ep_pager_active_vb_pcnt",
               "ep_pager_sleep_time_ms",
+              "ep_pager_visitor_tasks",
               "ep_postInitfile",
+              "ep_replica_value_policy",
               "ep_replication_throttle_cap_pcnt",
+              "ep_replication_throttle_min_rate",
               "ep_replication_throttle_queue_cap",
+              "ep_replication_throttle_rate_shaping",
+              "ep_replication_throttle_shaping_band_pcnt",
               "ep_replication_throttle_threshold",
               "ep_retain_erroneous_tombstones",
               "ep_rocksdb_options",
@@ -6760,15 +6868,25 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_rocksdb_seqno_cf_optimize_compaction",
               "ep_rocksdb_write_rate_limit",
               "ep_rocksdb_uc_max_size_amplification_percent",
+              "ep_rocksdb_shared_column_families",
               "ep_scopes_max_size",
+              "ep_task_profile_slow_runs",
               "ep_time_synchronization",
               "ep_uuid",
+              "ep_value_tier_numa_node",
+              "ep_value_tier_path",
+              "ep_value_tier_size",
               "ep_vb0",
+              "ep_vbucket_deletion_chunk_size",
               "ep_waitforwarmup",
               "ep_warmup",
               "ep_warmup_batch_size",
+              "ep_warmup_hashtable_image",
+              "ep_warmup_hashtable_image_values",
               "ep_warmup_min_items_threshold",
+              "ep_warmup_scans_per_shard",
               "ep_warmup_min_memory_threshold",
+              "ep_workload_adaptive",
               "ep_xattr_enabled"}},
             {"workload",
              {"ep_workload:num_readers",
@@ -6782,6 +6900,14 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_workload:num_shards",
               "ep_workload:ready_tasks",
               "ep_workload:num_sleepers",
+              "ep_workload:adaptive_adjustments",
+              "ep_workload:adaptive_readers",
+              "ep_workload:adaptive_writers",
+              "ep_workload:weight",
+              "ep_workload:Writer:runtime_us",
+              "ep_workload:Reader:runtime_us",
+              "ep_workload:AuxIO:runtime_us",
+              "ep_workload:NonIO:runtime_us",
               "ep_workload:LowPrioQ_AuxIO:InQsize",
               "ep_workload:LowPrioQ_AuxIO:OutQsize",
               "ep_workload:LowPrioQ_NonIO:InQsize",
@@ -6820,36 +6946,52 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_active_datatype_xattr",
               "ep_active_hlc_drift",
               "ep_active_hlc_drift_count",
+              "ep_arena_memory_accounting",
               "ep_backend",
               "ep_backfill_mem_threshold",
+              "ep_bfilter_blocked",
               "ep_bfilter_enabled",
               "ep_bfilter_fp_prob",
               "ep_bfilter_key_count",
+              "ep_bfilter_persist",
               "ep_bfilter_residency_threshold",
               "ep_bg_fetch_avg_read_amplification",
               "ep_bg_fetched",
               "ep_bg_meta_fetched",
               "ep_bg_remaining_items",
               "ep_bg_remaining_jobs",
+              "ep_bgfetchers_per_shard",
               "ep_blob_num",
               "ep_blob_overhead",
               "ep_bucket_priority",
               "ep_bucket_type",
               "ep_cache_size",
+              "ep_chk_lock_free_readers",
+              "ep_chk_max_bucket_memory",
               "ep_chk_max_items",
+              "ep_chk_max_vb_memory",
               "ep_chk_period",
               "ep_chk_persistence_remains",
               "ep_chk_remover_stime",
               "ep_clock_cas_drift_threshold_exceeded",
               "ep_collections_enabled",
               "ep_collections_max_size",
+              "ep_compaction_backoff_bg_wait",
               "ep_compaction_exp_mem_threshold",
+              "ep_compaction_io_rate_limit",
+              "ep_compaction_max_concurrent_vbuckets",
               "ep_compaction_write_queue_cap",
               "ep_compression_mode",
               "ep_config_file",
+              "ep_conflict_resolution_cas_summary_size",
               "ep_conflict_resolution_type",
               "ep_connection_manager_interval",
               "ep_couch_bucket",
+              "ep_couchstore_compact_metadata",
+              "ep_couchstore_doc_cache_size",
+              "ep_couchstore_read_handle_cache",
+              "ep_couchstore_scan_readahead_size",
+              "ep_couchstore_write_combine_size",
               "ep_cursor_dropping_lower_mark",
               "ep_cursor_dropping_lower_threshold",
               "ep_cursor_dropping_upper_mark",
@@ -6863,31 +7005,48 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_data_traffic_enabled",
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
+              "ep_dcp_backfill_shared_scans",
               "ep_dcp_conn_buffer_size",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
               "ep_dcp_conn_buffer_size_max",
               "ep_dcp_conn_buffer_size_perc",
+              "ep_dcp_conn_notifier_coalesce_us",
               "ep_dcp_consumer_process_buffered_messages_batch_size",
+              "ep_dcp_consumer_processor_tasks",
               "ep_dcp_consumer_process_buffered_messages_yield_limit",
               "ep_dcp_enable_noop",
               "ep_dcp_ephemeral_backfill_type",
               "ep_dcp_flow_control_policy",
               "ep_dcp_idle_timeout",
+              "ep_dcp_item_transform_cache_size",
               "ep_dcp_max_unacked_bytes",
               "ep_dcp_min_compression_ratio",
               "ep_dcp_noop_mandatory_for_v5_features",
               "ep_dcp_noop_tx_interval",
+              "ep_dcp_producer_ready_queue_quantum",
               "ep_dcp_producer_snapshot_marker_yield_limit",
               "ep_dcp_scan_byte_limit",
+              "ep_dcp_scan_byte_limit_max",
               "ep_dcp_scan_item_limit",
+              "ep_dcp_seqno_ack_batch_size",
+              "ep_dcp_seqno_ack_max_delay_us",
+              "ep_dcp_step_batch_size",
               "ep_dcp_takeover_max_time",
               "ep_defragmenter_age_threshold",
+              "ep_defragmenter_auto_interval",
+              "ep_defragmenter_auto_lower_threshold",
+              "ep_defragmenter_auto_min_interval",
+              "ep_defragmenter_auto_upper_threshold",
               "ep_defragmenter_chunk_duration",
               "ep_defragmenter_enabled",
               "ep_defragmenter_interval",
+              "ep_defragmenter_max_extent_utilization",
               "ep_defragmenter_num_moved",
+              "ep_defragmenter_num_skipped_dense",
               "ep_defragmenter_num_visited",
+              "ep_defragmenter_stored_value_enabled",
+              "ep_defragmenter_sv_num_moved",
               "ep_degraded_mode",
               "ep_diskqueue_drain",
               "ep_diskqueue_fill",
@@ -6895,6 +7054,15 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_diskqueue_memory",
               "ep_diskqueue_pending",
               "ep_disk_backfill_queue",
+              "ep_doc_cache_hits",
+              "ep_doc_cache_items",
+              "ep_doc_cache_memory_used",
+              "ep_doc_cache_misses",
+              "ep_executor_autoscale_max_readers",
+              "ep_executor_autoscale_max_writers",
+              "ep_executor_local_queue_size",
+              "ep_executor_numa_binding",
+              "ep_executor_weight",
               "ep_exp_pager_enabled",
               "ep_exp_pager_initial_run_time",
               "ep_exp_pager_stime",
@@ -6903,17 +7071,32 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_expired_pager",
               "ep_expiry_pager_task_time",
               "ep_failpartialwarmup",
+              "ep_flusher_batch_min_size",
               "ep_flush_all",
               "ep_flush_duration_total",
               "ep_flusher_batch_split_trigger",
+              "ep_flusher_batch_target_commit_time",
+              "ep_flusher_group_commit_size",
+              "ep_flushers_per_shard",
               "ep_fsync_after_every_n_bytes_written",
+              "ep_get_keys_byte_limit",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_hot_key_cache_min_freq",
+              "ep_hot_key_cache_size",
+              "ep_ht_arena_allocator",
               "ep_ht_eviction_policy",
+              "ep_ht_huge_pages",
+              "ep_ht_inline_value_size",
+              "ep_ht_layout",
               "ep_ht_locks",
+              "ep_ht_numa_placement",
+              "ep_ht_read_lock_mode",
               "ep_ht_resize_interval",
+              "ep_ht_resize_mode",
+              "ep_ht_resize_step_size",
               "ep_ht_size",
               "ep_initfile",
               "ep_io_bg_fetch_read_count",
@@ -6926,14 +7109,20 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_item_compressor_num_compressed",
               "ep_item_compressor_num_visited",
               "ep_item_eviction_age_percentage",
+              "ep_item_eviction_collection_quota_percentage",
+              "ep_item_eviction_compress_values",
               "ep_item_eviction_freq_counter_age_threshold",
+              "ep_item_eviction_sample_size",
               "ep_item_freq_decayer_chunk_duration",
+              "ep_item_freq_decayer_lazy",
               "ep_item_freq_decayer_percent",
               "ep_item_num",
               "ep_item_num_based_new_chk",
+              "ep_items_expelled_from_checkpoints",
               "ep_items_rm_from_checkpoints",
               "ep_keep_closed_chks",
               "ep_kv_size",
+              "ep_lock_profile_sample_rate",
               "ep_max_checkpoints",
               "ep_max_failover_entries",
               "ep_max_item_privileged_bytes",
@@ -6948,6 +7137,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_mem_high_wat_percent",
               "ep_mem_low_wat",
               "ep_mem_low_wat_percent",
+              "ep_mem_quota_sharing",
               "ep_mem_tracker_enabled",
               "ep_mem_used_merge_threshold_percent",
               "ep_meta_data_disk",
@@ -6957,12 +7147,14 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_meta_data_memory",
               "ep_min_compression_ratio",
               "ep_mutation_mem_threshold",
+              "ep_negative_key_cache_ttl",
               "ep_num_access_scanner_runs",
               "ep_num_access_scanner_skips",
               "ep_num_auxio_threads",
               "ep_num_eject_failures",
               "ep_num_expiry_pager_runs",
               "ep_num_freq_decayer_runs",
+              "ep_num_get_value_copies",
               "ep_num_non_resident",
               "ep_num_nonio_threads",
               "ep_num_not_my_vbuckets",
@@ -6974,9 +7166,13 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_num_ops_set_meta",
               "ep_num_ops_set_meta_res_fail",
               "ep_num_ops_set_ret_meta",
+              "ep_num_pager_compressions",
               "ep_num_pager_runs",
               "ep_num_reader_threads",
+              "ep_num_replica_persist_compressions",
+              "ep_num_replica_persist_ejects",
               "ep_num_value_ejects",
+              "ep_num_value_tier_moves",
               "ep_num_workers",
               "ep_num_writer_threads",
               "ep_magma_max_commit_points",
@@ -6990,6 +7186,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_overhead",
               "ep_pager_active_vb_pcnt",
               "ep_pager_sleep_time_ms",
+              "ep_pager_visitor_tasks",
               "ep_pending_compactions",
               "ep_pending_ops",
               "ep_pending_ops_max",
@@ -7010,8 +7207,14 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_replica_datatype_xattr",
               "ep_replica_hlc_drift",
               "ep_replica_hlc_drift_count",
+              "ep_replica_value_policy",
               "ep_replication_throttle_cap_pcnt",
+              "ep_replication_throttle_drain_rate",
+              "ep_replication_throttle_min_rate",
               "ep_replication_throttle_queue_cap",
+              "ep_replication_throttle_rate",
+              "ep_replication_throttle_rate_shaping",
+              "ep_replication_throttle_shaping_band_pcnt",
               "ep_replication_throttle_threshold",
               "ep_retain_erroneous_tombstones",
               "ep_rocksdb_options",
@@ -7027,8 +7230,10 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_rocksdb_seqno_cf_optimize_compaction",
               "ep_rocksdb_write_rate_limit",
               "ep_rocksdb_uc_max_size_amplification_percent",
+              "ep_rocksdb_shared_column_families",
               "ep_rollback_count",
               "ep_scopes_max_size",
+              "ep_task_profile_slow_runs",
               "ep_startup_time",
               "ep_storage_age",
               "ep_storage_age_highwat",
@@ -7039,21 +7244,32 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_tmp_oom_errors",
               "ep_total_cache_size",
               "ep_total_deduplicated",
+              "ep_total_deduplicated_flusher",
               "ep_total_del_items",
               "ep_total_enqueued",
               "ep_total_new_items",
               "ep_uuid",
               "ep_value_size",
+              "ep_value_tier_numa_node",
+              "ep_value_tier_path",
+              "ep_value_tier_size",
               "ep_vb0",
               "ep_vb_backfill_queue_size",
               "ep_vb_total",
               "ep_vbucket_del",
               "ep_vbucket_del_fail",
+              "ep_vbucket_del_mem_freed",
+              "ep_vbucket_del_mem_freed_rate",
+              "ep_vbucket_deletion_chunk_size",
               "ep_waitforwarmup",
               "ep_warmup",
               "ep_warmup_batch_size",
+              "ep_warmup_hashtable_image",
+              "ep_warmup_hashtable_image_values",
               "ep_warmup_min_items_threshold",
+              "ep_warmup_scans_per_shard",
               "ep_warmup_min_memory_threshold",
+              "ep_workload_adaptive",
               "ep_workload_pattern",
               "ep_xattr_enabled",
               "mem_used",
@@ -7189,6 +7405,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
         eng_stats.insert(eng_stats.end(),
                          {"ep_access_scanner_enabled",
                           "ep_alog_block_size",
+                          "ep_alog_incremental",
                           "ep_alog_max_stored_items",
                           "ep_alog_path",
                           "ep_alog_resident_ratio_threshold",
@@ -7222,6 +7439,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
         config_stats.insert(config_stats.end(),
                             {"ep_access_scanner_enabled",
                              "ep_alog_block_size",
+                             "ep_alog_incremental",
                              "ep_alog_max_stored_items",
                              "ep_alog_path",
                              "ep_alog_resident_ratio_threshold",
@@ -7233,11 +7451,13 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
     if (isEphemeralBucket(h)) {
         auto& eng_stats = statsKeys.at("");
         eng_stats.insert(eng_stats.end(),
-                         {"ep_ephemeral_full_policy",
+                         {"ep_ephemeral_auto_delete_sample_size",
+                          "ep_ephemeral_full_policy",
                           "ep_ephemeral_metadata_mark_stale_chunk_duration",
                           "ep_ephemeral_metadata_purge_age",
                           "ep_ephemeral_metadata_purge_interval",
                           "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                          "ep_ephemeral_metadata_purge_stale_threshold",
 
                           "vb_active_auto_delete_count",
                           "vb_active_ht_tombstone_purged_count",
@@ -7288,11 +7508,13 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
         auto& config_stats = statsKeys.at("config");
         config_stats.insert(
                 config_stats.end(),
-                {"ep_ephemeral_full_policy",
+                {"ep_ephemeral_auto_delete_sample_size",
+                 "ep_ephemeral_full_policy",
                  "ep_ephemeral_metadata_mark_stale_chunk_duration",
                  "ep_ephemeral_metadata_purge_age",
                  "ep_ephemeral_metadata_purge_interval",
-                 "ep_ephemeral_metadata_purge_stale_chunk_duration"});
+                 "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                 "ep_ephemeral_metadata_purge_stale_threshold"});
     }
 
     // In addition to the exact stat keys above, we also use regex patterns
@@ -7422,6 +7644,16 @@ static enum test_result test_mb19687_variable(EngineIface* h) {
                      "mem_used_estimate",
                      "mem_used_merge_threshold"
              }},
+            {"memory-breakdown",
+             {"mem_backfill_buffers",
+              "mem_blobs",
+              "mem_checkpoints",
+              "mem_collection_manifests",
+              "mem_dcp_buffers",
+              "mem_hash_table",
+              "mem_other",
+              "mem_stored_values",
+              "mem_used"}},
 
             // These stat groups return histograms so we can't guess the
             // key names...
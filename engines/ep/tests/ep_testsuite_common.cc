@@ -425,23 +425,29 @@ bool teardown_suite() {
 /*
  * Create n_buckets and return how many were actually created.
  */
+std::string get_bucket_config(const char* cfg, int index) {
+    std::stringstream config;
+    std::string str_cfg(cfg);
+    /* Find the position of "dbname=" in str_cfg */
+    size_t pos = str_cfg.find("dbname=");
+    if (pos != std::string::npos) {
+        /* Move till end of the dbname */
+        size_t new_pos = str_cfg.find(';', pos);
+        str_cfg.insert(new_pos, std::to_string(index));
+        config << str_cfg;
+    } else {
+        config << str_cfg << "dbname=" << get_dbname(cfg) << index;
+    }
+    return config.str();
+}
+
 int create_buckets(const char* cfg, int n_buckets, std::vector<BucketHolder> &buckets) {
     std::string dbname = get_dbname(cfg);
 
     for (int ii = 0; ii < n_buckets; ii++) {
         std::stringstream config, dbpath;
         dbpath << dbname.c_str() << ii;
-        std::string str_cfg(cfg);
-        /* Find the position of "dbname=" in str_cfg */
-        size_t pos = str_cfg.find("dbname=");
-        if (pos != std::string::npos) {
-            /* Move till end of the dbname */
-            size_t new_pos = str_cfg.find(';', pos);
-            str_cfg.insert(new_pos, std::to_string(ii));
-            config << str_cfg;
-        } else {
-            config << str_cfg << "dbname=" << dbpath.str();
-        }
+        config << get_bucket_config(cfg, ii);
 
         try {
             rmdb(dbpath.str().c_str());
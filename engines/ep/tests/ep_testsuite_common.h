@@ -282,6 +282,12 @@ struct BucketHolder {
     const std::string dbpath;
 };
 
+/*
+  Return the configuration create_buckets uses for the bucket with the given
+  index (the test configuration with the index appended to the dbname).
+*/
+std::string get_bucket_config(const char* cfg, int index);
+
 /*
   Create n_buckets and add to the buckets vector.
   Returns the number of buckets actually created.
@@ -999,6 +999,59 @@ static enum test_result test_delete_with_meta_race_with_delete(EngineIface* h) {
     return SUCCESS;
 }
 
+static enum test_result test_with_meta_batch(EngineIface* h) {
+    // A set, an add of the same key (which fails) and a delete of it, all
+    // in one batch
+    std::string batch;
+    auto addMutation = [&batch](cb::mcbp::ClientOpcode opcode,
+                                uint64_t seqno) {
+        cb::mcbp::request::SetWithMetaPayload extras;
+        extras.setFlags(0xdeadbeef);
+        extras.setExpiration(0);
+        extras.setSeqno(seqno);
+        extras.setCas(0xdeadbeef + seqno);
+        const char* value =
+                opcode == cb::mcbp::ClientOpcode::DelWithMeta ? "" : "value";
+        auto pkt = createPacket(
+                opcode,
+                Vbid(0),
+                0,
+                {reinterpret_cast<const char*>(&extras), sizeof(extras)},
+                "batch_key",
+                value);
+        batch.append(reinterpret_cast<const char*>(pkt.get()),
+                     sizeof(cb::mcbp::Request) + pkt->getBodylen());
+    };
+    addMutation(cb::mcbp::ClientOpcode::SetWithMeta, 10);
+    addMutation(cb::mcbp::ClientOpcode::AddWithMeta, 10);
+    addMutation(cb::mcbp::ClientOpcode::DelWithMeta, 11);
+
+    auto pkt = createPacket(
+            cb::mcbp::ClientOpcode::WithMetaBatch, Vbid(0), 0, {}, {}, batch);
+    checkeq(ENGINE_SUCCESS,
+            h->unknown_command(nullptr, *pkt, add_response),
+            "Expected the batch to be applied");
+    checkeq(cb::mcbp::Status::Success, last_status.load(), "Expected success");
+
+    checkeq(size_t(3 * sizeof(uint16_t)),
+            last_body.size(),
+            "Expected a status per mutation");
+    const auto* statuses = reinterpret_cast<const uint16_t*>(last_body.data());
+    checkeq(uint16_t(cb::mcbp::Status::Success),
+            ntohs(statuses[0]),
+            "Expected the set to succeed");
+    checkeq(uint16_t(cb::mcbp::Status::KeyEexists),
+            ntohs(statuses[1]),
+            "Expected the add to fail");
+    checkeq(uint16_t(cb::mcbp::Status::Success),
+            ntohs(statuses[2]),
+            "Expected the delete to succeed");
+
+    checkeq(1, get_int_stat(h, "ep_num_ops_set_meta"), "Expected one set");
+    checkeq(1, get_int_stat(h, "ep_num_ops_del_meta"), "Expected one delete");
+    return SUCCESS;
+}
+
 static enum test_result test_set_with_meta(EngineIface* h) {
     const char* key = "set_with_meta_key";
     size_t keylen = strlen(key);
@@ -3216,6 +3269,13 @@ BaseTestCase testsuite_testcases[] = {
                  NULL,
                  prepare,
                  cleanup),
+        TestCase("with meta batch",
+                 test_with_meta_batch,
+                 test_setup,
+                 teardown,
+                 NULL,
+                 prepare,
+                 cleanup),
         TestCase("set with meta by force",
                  test_set_with_meta_by_force,
                  test_setup,
@@ -46,6 +46,11 @@ public:
         return allSeqnos;
     }
 
+    void setPurgeBatchSize(size_t size) {
+        std::lock_guard<std::mutex> lh(purgeLock);
+        purgeBatchSize = size;
+    }
+
     /// Expose the rangeReadLock for testing.
     std::mutex& getRangeReadLock() {
         return rangeReadLock;
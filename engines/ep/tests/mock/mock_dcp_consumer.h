@@ -51,6 +51,10 @@ public:
         return backoffs.load();
     }
 
+    void incrFlowControlFreedBytes(uint32_t bytes) {
+        flowControl.incrFreedBytes(bytes);
+    }
+
     GetErrorMapState getGetErrorMapState() {
         return getErrorMapState;
     }
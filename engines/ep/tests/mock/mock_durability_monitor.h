@@ -24,16 +24,19 @@
  */
 class MockDurabilityMonitor : public DurabilityMonitor {
 public:
-    MockDurabilityMonitor(VBucket& vb) : DurabilityMonitor(vb) {
+    MockDurabilityMonitor(VBucket& vb,
+                          DurabilityTimings* timings = nullptr,
+                          LockProfile* lockProfile = nullptr)
+        : DurabilityMonitor(vb, timings, lockProfile) {
     }
 
     size_t public_getNumTracked() const {
-        std::lock_guard<std::mutex> lg(state.m);
+        std::lock_guard<StateMutex> lg(state.m);
         return DurabilityMonitor::getNumTracked(lg);
     }
 
     int64_t public_getReplicaMemorySeqno(const std::string& replica) const {
-        std::lock_guard<std::mutex> lg(state.m);
+        std::lock_guard<StateMutex> lg(state.m);
         return DurabilityMonitor::getReplicaMemorySeqno(lg, replica);
     }
 };
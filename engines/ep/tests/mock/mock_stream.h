@@ -296,6 +296,10 @@ public:
         return PassiveStream::processMutation(mutation);
     }
 
+    ENGINE_ERROR_CODE public_processPrepare(MutationConsumerMessage* prepare) {
+        return PassiveStream::processPrepare(prepare);
+    }
+
     size_t getNumBufferItems() const {
         LockHolder lh(buffer.bufMutex);
         return buffer.messages.size();
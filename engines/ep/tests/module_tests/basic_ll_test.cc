@@ -434,6 +434,64 @@ TEST_F(BasicLinkedListTest, UpdateDuringRangeRead) {
     EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
 }
 
+TEST_F(BasicLinkedListTest, RelinkMiddleElem) {
+    const int numItems = 3;
+    const std::string keyPrefix("key");
+
+    /* Add 3 new items */
+    addNewItemsToList(1, keyPrefix, numItems);
+
+    /* Reallocate a middle item, as the defragmenter does */
+    const auto key = makeStoredDocKey(keyPrefix + std::to_string(2));
+    {
+        auto res = ht.findForWrite(key);
+        std::lock_guard<std::mutex> listWriteLg(basicLL->getListWriteLock());
+        auto& osv = *res.storedValue->toOrderedStoredValue();
+        ASSERT_TRUE(basicLL->canRelinkListElem(listWriteLg, osv));
+        auto realloc = ht.unlocked_reallocateStoredValue(res.lock, osv);
+        basicLL->relinkListElem(listWriteLg,
+                                *realloc.second->toOrderedStoredValue(),
+                                *realloc.first->toOrderedStoredValue());
+    }
+
+    /* Check the copy has taken the element's place in the list */
+    std::vector<seqno_t> expectedSeqno = {1, 2, 3};
+    EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
+    auto* copy = ht.findForRead(key).storedValue;
+    ASSERT_TRUE(copy);
+    EXPECT_TRUE(copy->toOrderedStoredValue()->seqno_hook.is_linked());
+}
+
+TEST_F(BasicLinkedListTest, NoRelinkDuringRangeReadOrWithStaleItems) {
+    const int numItems = 3;
+    const std::string keyPrefix("key");
+
+    /* Add 3 new items */
+    addNewItemsToList(1, keyPrefix, numItems);
+
+    auto canRelink = [this, &keyPrefix](seqno_t seqno) {
+        auto res = ht.findForWrite(
+                makeStoredDocKey(keyPrefix + std::to_string(seqno)));
+        std::lock_guard<std::mutex> listWriteLg(basicLL->getListWriteLock());
+        return basicLL->canRelinkListElem(
+                listWriteLg, *res.storedValue->toOrderedStoredValue());
+    };
+
+    /* Elements in a range read can't be relinked, others can */
+    basicLL->registerFakeReadRange(2, numItems);
+    EXPECT_TRUE(canRelink(1));
+    EXPECT_FALSE(canRelink(2));
+    basicLL->resetReadRange();
+    EXPECT_TRUE(canRelink(2));
+
+    /* Nor can any element while there are stale items (which may point to
+       it) */
+    basicLL->registerFakeReadRange(1, numItems);
+    updateItemDuringRangeRead(numItems, keyPrefix + std::to_string(1));
+    basicLL->resetReadRange();
+    EXPECT_FALSE(canRelink(2));
+}
+
 TEST_F(BasicLinkedListTest, DeletedItem) {
     const std::string keyPrefix("key");
     const int numItems = 1;
@@ -850,6 +908,8 @@ TEST_F(BasicLinkedListTest, PurgeBeyondLast) {
 }
 
 TEST_F(BasicLinkedListTest, UpdateDuringPurge) {
+    /* Pause (and update) between each element */
+    basicLL->setPurgeBatchSize(1);
     const int numItems = 2;
     const std::string keyPrefix("key");
 
@@ -880,6 +940,48 @@ TEST_F(BasicLinkedListTest, UpdateDuringPurge) {
     EXPECT_EQ(0, basicLL->getNumStaleItems());
 }
 
+/* Purging runs concurrently with a range iterator, purging the stale items
+   the iterator has already moved past (but none it is still to read) */
+TEST_F(BasicLinkedListTest, PurgeDuringRangeIterator) {
+    const std::string keyPrefix("key");
+
+    /* 1: stale, 2-3: live, 4: stale, 5: live */
+    addStaleItem("stale1", 1);
+    addNewItemsToList(2, keyPrefix, 2);
+    addStaleItem("stale4", 4);
+    addNewItemsToList(5, keyPrefix, 1);
+    ASSERT_EQ(2, basicLL->getNumStaleItems());
+
+    std::vector<seqno_t> actualSeqno;
+    {
+        auto itr = getRangeIterator();
+
+        /* Read up to (but not including) seqno 3 */
+        while (itr.curr() != 3) {
+            actualSeqno.push_back((*itr).getBySeqno());
+            ++itr;
+        }
+
+        /* Only the stale item behind the iterator is purged */
+        EXPECT_EQ(1, basicLL->purgeTombstones(5));
+        EXPECT_EQ(1, basicLL->getNumStaleItems());
+
+        /* The iterator still reads the rest of its snapshot */
+        while (itr.curr() != itr.end()) {
+            actualSeqno.push_back((*itr).getBySeqno());
+            ++itr;
+        }
+    }
+    std::vector<seqno_t> expectedSeqno = {1, 2, 3, 4, 5};
+    EXPECT_EQ(expectedSeqno, actualSeqno);
+
+    /* With the iterator done the remaining stale item can be purged */
+    EXPECT_EQ(1, basicLL->purgeTombstones(5));
+    EXPECT_EQ(0, basicLL->getNumStaleItems());
+    expectedSeqno = {2, 3, 5};
+    EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
+}
+
 /* Run purge when the last item in the list does not yet have a seqno */
 TEST_F(BasicLinkedListTest, PurgeWithItemWithoutSeqno) {
     const int numItems = 2;
@@ -909,7 +1011,42 @@ TEST_F(BasicLinkedListTest, PurgeWithItemWithoutSeqno) {
     EXPECT_EQ(0, basicLL->getNumStaleItems());
 }
 
+/* The purger visits a batch of elements each time it takes the list
+   writeLock, and only checks if it should pause between batches */
+TEST_F(BasicLinkedListTest, PurgeInBatches) {
+    const size_t batch = BasicLinkedList::DefaultPurgeBatchSize;
+    const std::string keyPrefix("key");
+
+    /* A stale item at the start and the end of each batch */
+    seqno_t seqno = 1;
+    for (int batchNum = 0; batchNum < 2; ++batchNum) {
+        addStaleItem("stale" + std::to_string(seqno), seqno);
+        ++seqno;
+        addNewItemsToList(seqno, keyPrefix, batch - 2);
+        seqno += batch - 2;
+        addStaleItem("stale" + std::to_string(seqno), seqno);
+        ++seqno;
+    }
+    /* And one item which is never purged (the last item of the list) */
+    addNewItemsToList(seqno, keyPrefix, 1);
+    ASSERT_EQ(4, basicLL->getNumStaleItems());
+
+    int numPauses = 0;
+    auto pause = [&numPauses]() {
+        ++numPauses;
+        return true;
+    };
+    EXPECT_EQ(2, basicLL->purgeTombstones(seqno, pause));
+    EXPECT_EQ(1, numPauses);
+    EXPECT_EQ(2, basicLL->purgeTombstones(seqno, pause));
+    EXPECT_EQ(2, numPauses);
+    EXPECT_EQ(0, basicLL->getNumStaleItems());
+    EXPECT_EQ(2 * (batch - 2) + 1, basicLL->getNumItems());
+}
+
 TEST_F(BasicLinkedListTest, PurgePauseResume) {
+    /* Pause after every two elements */
+    basicLL->setPurgeBatchSize(2);
     const int numItems = 4, numPurgeItems = 2;
     const std::string keyPrefix("key");
 
@@ -952,6 +1089,8 @@ TEST_F(BasicLinkedListTest, PurgePauseResume) {
 }
 
 TEST_F(BasicLinkedListTest, PurgePauseResumeWithUpdate) {
+    /* Pause (and update) between each element */
+    basicLL->setPurgeBatchSize(1);
     const int numItems = 2, numPurgeItems = 1;
     const std::string keyPrefix("key");
 
@@ -988,6 +1127,8 @@ TEST_F(BasicLinkedListTest, PurgePauseResumeWithUpdate) {
 }
 
 TEST_F(BasicLinkedListTest, PurgePauseResumeWithUpdateAtPausedPoint) {
+    /* Pause (and update) between each element */
+    basicLL->setPurgeBatchSize(1);
     const int numItems = 4, numPurgeItems = 2;
     const std::string keyPrefix("key");
 
@@ -90,3 +90,62 @@ INSTANTIATE_TEST_CASE_P(
         BloomFilterDocKeyTest,
         ::testing::Combine(::testing::ValuesIn(allDocNamespaces),
                            ::testing::ValuesIn(allDocNamespaces)), );
+
+// A blocked filter has no false negatives, and a false positive rate close
+// to that requested.
+TEST(BloomFilterTest, blocked) {
+    const size_t keys = 10000;
+    BloomFilter filter(keys, 0.01, BFILTER_ENABLED, true);
+    ASSERT_TRUE(filter.isBlocked());
+    EXPECT_EQ(0, filter.getFilterSize() % 512);
+    EXPECT_GE(filter.getFilterSize(), BloomFilter(keys, 0.01).getFilterSize());
+
+    for (size_t ii = 0; ii < keys; ii++) {
+        filter.addKey(makeStoredDocKey("key_" + std::to_string(ii)));
+    }
+    // A few keys may have all their bits set by earlier keys already.
+    EXPECT_GE(filter.getNumOfKeysInFilter(), keys * 99 / 100);
+
+    for (size_t ii = 0; ii < keys; ii++) {
+        EXPECT_TRUE(filter.maybeKeyExists(
+                makeStoredDocKey("key_" + std::to_string(ii))));
+    }
+
+    size_t falsePositives = 0;
+    for (size_t ii = 0; ii < keys; ii++) {
+        if (filter.maybeKeyExists(
+                    makeStoredDocKey("other_" + std::to_string(ii)))) {
+            falsePositives++;
+        }
+    }
+    EXPECT_LT(falsePositives, keys * 3 / 100);
+
+    filter.setStatus(BFILTER_DISABLED);
+    EXPECT_TRUE(filter.maybeKeyExists(makeStoredDocKey("other_0")));
+    EXPECT_EQ(0, filter.getFilterSize());
+}
+
+// A filter re-created from its serialised form answers exactly as the
+// original did.
+TEST(BloomFilterTest, serialise) {
+    for (const bool blocked : {false, true}) {
+        BloomFilter filter(1000, 0.01, BFILTER_ENABLED, blocked);
+        for (size_t ii = 0; ii < 1000; ii++) {
+            filter.addKey(makeStoredDocKey("key_" + std::to_string(ii)));
+        }
+
+        auto copy = BloomFilter::deserialise(filter.serialise());
+        ASSERT_TRUE(copy) << "blocked:" << blocked;
+        EXPECT_EQ(blocked, copy->isBlocked());
+        EXPECT_EQ(BFILTER_ENABLED, copy->getStatus());
+        EXPECT_EQ(filter.getFilterSize(), copy->getFilterSize());
+        EXPECT_EQ(filter.getNumOfKeysInFilter(), copy->getNumOfKeysInFilter());
+        for (size_t ii = 0; ii < 2000; ii++) {
+            const auto key = makeStoredDocKey("key_" + std::to_string(ii));
+            EXPECT_EQ(filter.maybeKeyExists(key), copy->maybeKeyExists(key));
+        }
+    }
+
+    EXPECT_FALSE(BloomFilter::deserialise(""));
+    EXPECT_FALSE(BloomFilter::deserialise(std::string(100, 'x')));
+}
@@ -0,0 +1,96 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the CheckpointQueue class.
+ */
+
+#include "checkpoint_queue.h"
+#include "test_helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+static queued_item makeQueuedItem(int64_t seqno) {
+    queued_item qi(new Item(make_item(Vbid(0),
+                                      makeStoredDocKey(std::to_string(seqno)),
+                                      "value")));
+    qi->setBySeqno(seqno);
+    return qi;
+}
+
+static std::vector<int64_t> seqnos(const CheckpointQueue& queue) {
+    std::vector<int64_t> result;
+    for (const auto& qi : queue) {
+        result.push_back(qi->getBySeqno());
+    }
+    return result;
+}
+
+// Items spanning several chunks should be iterated in order, in both
+// directions.
+TEST(CheckpointQueueTest, IterateAcrossChunks) {
+    CheckpointQueue queue;
+    const int64_t numItems = CheckpointQueue::chunkSize * 2 + 3;
+    std::vector<int64_t> expected;
+    for (int64_t seqno = 1; seqno <= numItems; ++seqno) {
+        queue.push_back(makeQueuedItem(seqno));
+        expected.push_back(seqno);
+    }
+    EXPECT_EQ(size_t(numItems), queue.size());
+    EXPECT_EQ(expected, seqnos(queue));
+
+    std::vector<int64_t> reversed;
+    for (auto it = queue.rbegin(); it != queue.rend(); ++it) {
+        reversed.push_back((*it)->getBySeqno());
+    }
+    std::reverse(expected.begin(), expected.end());
+    EXPECT_EQ(expected, reversed);
+}
+
+// Erased items should be skipped, and iterators to other items must remain
+// valid across erases and appends.
+TEST(CheckpointQueueTest, EraseKeepsPositions) {
+    CheckpointQueue queue;
+    for (int64_t seqno = 1; seqno <= 4; ++seqno) {
+        queue.push_back(makeQueuedItem(seqno));
+    }
+    auto second = std::next(queue.begin());
+    auto third = std::next(second);
+    auto fourth = std::next(third);
+
+    queue.erase(third);
+    EXPECT_EQ(3, queue.size());
+    EXPECT_EQ(std::vector<int64_t>({1, 2, 4}), seqnos(queue));
+    EXPECT_EQ(fourth, std::next(second));
+    EXPECT_EQ(second, std::prev(fourth));
+
+    for (int64_t seqno = 5; seqno < 5 + int64_t(CheckpointQueue::chunkSize);
+         ++seqno) {
+        queue.push_back(makeQueuedItem(seqno));
+    }
+    EXPECT_EQ(2, (*second)->getBySeqno());
+    EXPECT_EQ(4, (*fourth)->getBySeqno());
+
+    // Erasing the last item makes the previous one last.
+    auto last = std::prev(queue.end());
+    const auto lastSeqno = (*last)->getBySeqno();
+    queue.erase(last);
+    EXPECT_EQ(lastSeqno - 1, (*std::prev(queue.end()))->getBySeqno());
+}
@@ -714,6 +714,183 @@ TYPED_TEST(CheckpointTest, ItemsForCheckpointCursorLimited) {
             << "Cursor should have moved into second checkpoint.";
 }
 
+// A cursor limited to some collections only returns the items of those
+// collections (and the checkpoint meta items), skipping the others.
+TYPED_TEST(CheckpointTest, ItemsForCollectionCursor) {
+    const CollectionID fruit(8);
+    for (int ii = 0; ii < 10; ++ii) {
+        const auto cid = (ii % 3 == 0) ? fruit : CollectionID::Default;
+        queued_item qi{new Item(makeStoredDocKey("key" + std::to_string(ii),
+                                                 cid),
+                                this->vbucket->getId(),
+                                queue_op::mutation,
+                                /*revSeq*/ 0,
+                                /*bySeq*/ 0)};
+        ASSERT_TRUE(this->manager->queueDirty(*this->vbucket,
+                                              qi,
+                                              GenerateBySeqno::Yes,
+                                              GenerateCas::Yes,
+                                              /*preLinkDocCtx*/ nullptr));
+    }
+
+    auto collections = std::make_shared<const std::vector<CollectionID>>(
+            std::vector<CollectionID>{fruit, CollectionID::System});
+    auto dcpCursor = this->manager->registerCursorBySeqno(
+            "collection-cursor", 0, collections);
+
+    std::vector<queued_item> items;
+    auto range = this->manager->getAllItemsForCursor(
+            dcpCursor.cursor.lock().get(), items);
+
+    // checkpoint_start, then key0, key3, key6 and key9.
+    ASSERT_EQ(5, items.size());
+    EXPECT_EQ(queue_op::checkpoint_start, items[0]->getOperation());
+    for (size_t ii = 1; ii < items.size(); ++ii) {
+        EXPECT_EQ(fruit, items[ii]->getKey().getCollectionID());
+    }
+    EXPECT_EQ(1010, range.end);
+
+    // Nothing more for the cursor until another fruit item is queued.
+    EXPECT_EQ(0, this->manager->getNumItemsForCursor(
+                         dcpCursor.cursor.lock().get()));
+}
+
+// DCP cursors at the same position are given the items read by the first of
+// them, and end up at the same position; one which has fallen behind reads
+// its own items.
+TYPED_TEST(CheckpointTest, SharedReadForCursorsAtSamePosition) {
+    auto cursorA = this->manager->registerCursorBySeqno("cursorA", 0);
+    auto cursorB = this->manager->registerCursorBySeqno("cursorB", 0);
+    for (int ii = 0; ii < 10; ++ii) {
+        ASSERT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+
+    std::vector<queued_item> itemsA;
+    auto resultA = this->manager->getItemsForCursor(
+            cursorA.cursor.lock().get(), itemsA, 1000);
+    std::vector<queued_item> itemsB;
+    auto resultB = this->manager->getItemsForCursor(
+            cursorB.cursor.lock().get(), itemsB, 1000);
+
+    ASSERT_EQ(11, itemsA.size()); // checkpoint_start and the mutations
+    EXPECT_EQ(itemsA, itemsB);
+    EXPECT_EQ(resultA.range.start, resultB.range.start);
+    EXPECT_EQ(resultA.range.end, resultB.range.end);
+    EXPECT_EQ(resultA.moreAvailable, resultB.moreAvailable);
+    EXPECT_EQ(0, this->manager->getNumItemsForCursor(
+                         cursorB.cursor.lock().get()));
+
+    // Only A reads the next item, so B (now behind) reads its own items.
+    ASSERT_TRUE(this->queueNewItem("key10"));
+    itemsA.clear();
+    this->manager->getItemsForCursor(cursorA.cursor.lock().get(), itemsA, 1000);
+    ASSERT_TRUE(this->queueNewItem("key11"));
+    itemsB.clear();
+    this->manager->getItemsForCursor(cursorB.cursor.lock().get(), itemsB, 1000);
+    ASSERT_EQ(1, itemsA.size());
+    ASSERT_EQ(2, itemsB.size());
+    EXPECT_EQ(itemsA[0], itemsB[0]);
+    EXPECT_EQ(makeStoredDocKey("key11"), itemsB[1]->getKey());
+}
+
+// With lock-free readers, a cursor which has read everything should report
+// nothing outstanding until something new is queued - including meta items
+// queued when a new checkpoint is created.
+TYPED_TEST(CheckpointTest, LockFreeReaders) {
+    this->checkpoint_config = CheckpointConfig(DEFAULT_CHECKPOINT_PERIOD,
+                                               MIN_CHECKPOINT_ITEMS,
+                                               /*numCheckpoints*/ 2,
+                                               /*itemBased*/ true,
+                                               /*keepClosed*/ false,
+                                               /*persistenceEnabled*/ true,
+                                               /*lockFreeReaders*/ true);
+    this->createManager();
+
+    EXPECT_TRUE(this->queueNewItem("key0"));
+    std::string dcp_cursor(DCP_CURSOR_PREFIX + std::to_string(1));
+    auto dcpCursor =
+            this->manager->registerCursorBySeqno(dcp_cursor.c_str(), 0);
+    auto* cursor = dcpCursor.cursor.lock().get();
+
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(cursor, items);
+    EXPECT_EQ(2, items.size()); // checkpoint_start + key0
+    EXPECT_EQ(0, this->manager->getNumItemsForCursor(cursor));
+    items.clear();
+    this->manager->getAllItemsForCursor(cursor, items);
+    EXPECT_TRUE(items.empty());
+
+    EXPECT_TRUE(this->queueNewItem("key1"));
+    EXPECT_EQ(1, this->manager->getNumItemsForCursor(cursor));
+    this->manager->getAllItemsForCursor(cursor, items);
+    ASSERT_EQ(1, items.size());
+    EXPECT_EQ(makeStoredDocKey("key1"), items[0]->getKey());
+
+    // A new checkpoint only adds meta items, but they must still be read.
+    this->manager->createNewCheckpoint();
+    items.clear();
+    this->manager->getAllItemsForCursor(cursor, items);
+    ASSERT_FALSE(items.empty());
+    EXPECT_EQ(queue_op::checkpoint_start, items.back()->getOperation());
+}
+
+// The open checkpoint should be closed once it exceeds the per-vBucket
+// memory budget.
+TYPED_TEST(CheckpointTest, MemoryBasedNewCheckpoint) {
+    this->checkpoint_config = CheckpointConfig(DEFAULT_CHECKPOINT_PERIOD,
+                                               MAX_CHECKPOINT_ITEMS,
+                                               /*numCheckpoints*/ 2,
+                                               /*itemBased*/ true,
+                                               /*keepClosed*/ false,
+                                               /*persistenceEnabled*/ true,
+                                               /*lockFreeReaders*/ false,
+                                               /*maxVBucketMemory*/ 1);
+    this->createManager();
+
+    EXPECT_TRUE(this->queueNewItem("key0"));
+    EXPECT_EQ(1, this->manager->getNumCheckpoints());
+    EXPECT_TRUE(this->queueNewItem("key1"));
+    EXPECT_EQ(2, this->manager->getNumCheckpoints());
+    EXPECT_EQ(1, this->manager->getNumOpenChkItems());
+}
+
+// With a memory budget, items which every cursor has read should be expelled
+// straight away; a cursor registering at an expelled seqno must be told to
+// backfill, and re-queuing an expelled key must not de-duplicate.
+TYPED_TEST(CheckpointTest, ExpelItems) {
+    this->checkpoint_config = CheckpointConfig(DEFAULT_CHECKPOINT_PERIOD,
+                                               MAX_CHECKPOINT_ITEMS,
+                                               /*numCheckpoints*/ 2,
+                                               /*itemBased*/ true,
+                                               /*keepClosed*/ false,
+                                               /*persistenceEnabled*/ true,
+                                               /*lockFreeReaders*/ false,
+                                               /*maxVBucketMemory*/ 1 << 30);
+    this->createManager(0);
+
+    for (int ii = 0; ii < 3; ++ii) {
+        EXPECT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    const auto numItems = this->manager->getNumItems();
+
+    // The persistence cursor is left on key2, so key0 and key1 are expelled.
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(this->manager->getPersistenceCursor(),
+                                        items);
+    EXPECT_EQ(4, items.size()); // checkpoint_start + 3 mutations
+    EXPECT_EQ(2, this->global_stats.itemsExpelledFromCheckpoints.load());
+    EXPECT_EQ(numItems - 2, this->manager->getNumItems());
+    EXPECT_EQ(1, this->manager->getNumOpenChkItems());
+    EXPECT_EQ(0, this->manager->expelUnreferencedCheckpointItems());
+
+    auto result = this->manager->registerCursorBySeqno("dcp", 1);
+    EXPECT_EQ(3, result.seqno);
+    EXPECT_TRUE(result.tryBackfill);
+
+    EXPECT_TRUE(this->queueNewItem("key0"));
+    EXPECT_EQ(2, this->manager->getNumOpenChkItems());
+}
+
 // Test the checkpoint cursor movement
 TYPED_TEST(CheckpointTest, CursorMovement) {
     /* We want to have items across 2 checkpoints. Size down the default number
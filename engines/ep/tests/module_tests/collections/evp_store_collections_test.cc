@@ -25,6 +25,7 @@
 #include "checkpoint_manager.h"
 #include "collections/collections_types.h"
 #include "ep_time.h"
+#include "item_pager.h"
 #include "kvstore.h"
 #include "programs/engine_testapp/mock_server.h"
 #include "tests/mock/mock_global_task.h"
@@ -150,6 +151,37 @@ TEST_P(CollectionsParameterizedTest, collections_basic) {
     EXPECT_EQ(ENGINE_UNKNOWN_COLLECTION, gv.getStatus());
 }
 
+// Test that each collection's memory usage is accounted for in the manifest,
+// and that the ItemPager sees which collections are over a quota.
+TEST_P(CollectionsParameterizedTest, collection_mem_used) {
+    VBucketPtr vb = store->getVBucket(vbid);
+    CollectionsManifest cm(CollectionEntry::meat);
+    vb->updateFromManifest({cm});
+
+    store_item(vbid, StoredDocKey{"key", CollectionEntry::defaultC}, "value");
+    store_item(vbid,
+               StoredDocKey{"meat:beef", CollectionEntry::meat},
+               std::string(1024, 'x'));
+    flushVBucketToDiskIfPersistent(vbid, 3);
+
+    Collections::Summary memUsed;
+    vb->lockCollections().updateMemUsedSummary(memUsed);
+    EXPECT_GT(memUsed[CollectionEntry::defaultC], 0);
+    EXPECT_GT(memUsed[CollectionEntry::meat], 1024);
+
+    auto overQuota = ItemPager::getCollectionsOverQuota(*store, 1024);
+    EXPECT_EQ(1, overQuota.size());
+    EXPECT_EQ(memUsed[CollectionEntry::meat] - 1024,
+              overQuota[CollectionEntry::meat]);
+
+    // Removing the item gives its memory back.
+    delete_item(vbid, StoredDocKey{"meat:beef", CollectionEntry::meat});
+    flushVBucketToDiskIfPersistent(vbid, 1);
+    memUsed.clear();
+    vb->lockCollections().updateMemUsedSummary(memUsed);
+    EXPECT_LT(memUsed[CollectionEntry::meat], 1024);
+}
+
 // BY-ID update: This test was created for MB-25344 and is no longer relevant as
 // we cannot 'hit' a logically deleted key from the front-end. This test has
 // been adjusted to still provide some value.
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+/*
+ * Unit tests for the CompactionThrottle class.
+ */
+
+#include "compaction_throttle.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono;
+
+static const size_t MiB = 1024 * 1024;
+
+// Without a rate compaction is never delayed.
+TEST(CompactionThrottleTest, Disabled) {
+    CompactionThrottle throttle(0, microseconds(0));
+    const auto now = steady_clock::now();
+    EXPECT_EQ(microseconds(0), throttle.acquire(100 * MiB, now));
+    EXPECT_EQ(0, throttle.getRate());
+}
+
+// I/O within the burst goes straight through, beyond it has to wait until
+// the rate has paid it off.
+TEST(CompactionThrottleTest, Rate) {
+    CompactionThrottle throttle(10 * MiB, microseconds(0));
+    const auto now = steady_clock::now();
+
+    // 100ms worth of burst.
+    EXPECT_EQ(microseconds(0), throttle.acquire(MiB, now));
+    EXPECT_EQ(milliseconds(100), throttle.acquire(MiB, now));
+    EXPECT_EQ(milliseconds(200), throttle.acquire(MiB, now));
+
+    // Once the I/O has been paid off, a new burst is allowed - but time
+    // spent idle doesn't add up to a larger one.
+    const auto later = now + seconds(10);
+    EXPECT_EQ(microseconds(0), throttle.acquire(MiB, later));
+    EXPECT_EQ(milliseconds(100), throttle.acquire(MiB, later));
+}
+
+// Slow background fetches halve the rate, fast ones double it back.
+TEST(CompactionThrottleTest, Backoff) {
+    CompactionThrottle throttle(16 * MiB, microseconds(1000));
+    auto now = steady_clock::now();
+    uint64_t wait = 0;
+    uint64_t fetches = 0;
+    throttle.sampleBgFetches(now, wait, fetches);
+    EXPECT_EQ(16 * MiB, throttle.getRate());
+
+    // Average wait of 2ms.
+    for (size_t ii = 1; ii <= CompactionThrottle::MaxBackoffLevel + 1; ++ii) {
+        now += CompactionThrottle::SampleInterval;
+        wait += 200000;
+        fetches += 100;
+        throttle.sampleBgFetches(now, wait, fetches);
+    }
+    EXPECT_EQ(CompactionThrottle::MaxBackoffLevel, throttle.getBackoffLevel());
+    EXPECT_EQ(MiB, throttle.getRate());
+
+    // Samples more frequent than the interval are ignored.
+    throttle.sampleBgFetches(now, wait, fetches + 1000000);
+    EXPECT_EQ(MiB, throttle.getRate());
+
+    // Average wait of 0.5ms.
+    now += CompactionThrottle::SampleInterval;
+    wait += 50000;
+    fetches += 100;
+    throttle.sampleBgFetches(now, wait, fetches);
+    EXPECT_EQ(2 * MiB, throttle.getRate());
+
+    // Disabling backoff restores the full rate.
+    throttle.setBackoffLatency(microseconds(0));
+    throttle.sampleBgFetches(now, wait, fetches);
+    EXPECT_EQ(16 * MiB, throttle.getRate());
+}
@@ -0,0 +1,87 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the CompressibilityTracker class.
+ */
+
+#include "compressibility_tracker.h"
+
+#include <gtest/gtest.h>
+
+using Tracker = CompressibilityTracker;
+
+// Collections which compress (or haven't been seen) are always attempted.
+TEST(CompressibilityTrackerTest, Compressible) {
+    Tracker tracker;
+    const CollectionID cid = CollectionID::Default;
+    EXPECT_TRUE(tracker.shouldAttempt(cid));
+    for (size_t ii = 0; ii < 2 * Tracker::Window; ++ii) {
+        // One in four compress, enough to keep trying
+        tracker.recordAttempt(cid, ii % 4 == 0);
+        EXPECT_TRUE(tracker.shouldAttempt(cid));
+    }
+    EXPECT_FALSE(tracker.isFutile(cid));
+    EXPECT_EQ(0, tracker.getNumSkipped());
+}
+
+// Once a collection is found to be futile only the occasional probe is made,
+// and other collections aren't affected.
+TEST(CompressibilityTrackerTest, Futile) {
+    Tracker tracker;
+    const CollectionID futile = 8;
+    const CollectionID other = 9;
+    for (size_t ii = 0; ii < Tracker::MinAttempts; ++ii) {
+        EXPECT_FALSE(tracker.isFutile(futile));
+        tracker.recordAttempt(futile, false);
+    }
+    EXPECT_TRUE(tracker.isFutile(futile));
+    EXPECT_FALSE(tracker.isFutile(other));
+
+    size_t attempts = 0;
+    for (size_t ii = 0; ii < 10 * Tracker::ProbeInterval; ++ii) {
+        if (tracker.shouldAttempt(futile)) {
+            ++attempts;
+        }
+        EXPECT_TRUE(tracker.shouldAttempt(other));
+    }
+    EXPECT_EQ(10, attempts);
+    EXPECT_EQ(10 * (Tracker::ProbeInterval - 1), tracker.getNumSkipped());
+
+    tracker.reset();
+    EXPECT_FALSE(tracker.isFutile(futile));
+    EXPECT_TRUE(tracker.shouldAttempt(futile));
+}
+
+// A futile collection whose documents start compressing is reconsidered as
+// the old results fade out.
+TEST(CompressibilityTrackerTest, Relearn) {
+    Tracker tracker;
+    const CollectionID cid = 8;
+    for (size_t ii = 0; ii < Tracker::Window; ++ii) {
+        tracker.recordAttempt(cid, false);
+    }
+    EXPECT_TRUE(tracker.isFutile(cid));
+
+    size_t probes = 0;
+    while (tracker.isFutile(cid)) {
+        ASSERT_LT(probes, Tracker::Window);
+        tracker.recordAttempt(cid, true);
+        ++probes;
+    }
+    EXPECT_LE(probes, Tracker::Window / Tracker::FutileRatio);
+}
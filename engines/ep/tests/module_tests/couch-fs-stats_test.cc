@@ -20,6 +20,11 @@
 
 #include "kvstore.h"
 
+#include <fcntl.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
 class TestStatsOps : public StatsOps {
 public:
     TestStatsOps(FileOpsInterface* ops)
@@ -57,3 +62,224 @@ INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
 INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
                               BufferedWrappedOpsTest,
                               testing::Types<>);
+
+/**
+ * Minimal in-memory FileOpsInterface, recording the pwrite() calls made
+ * against it and counting the pread() calls.
+ */
+class MemoryOps : public FileOpsInterface {
+public:
+    couch_file_handle constructor(couchstore_error_info_t*) override {
+        return reinterpret_cast<couch_file_handle>(this);
+    }
+    couchstore_error_t open(couchstore_error_info_t*,
+                            couch_file_handle*,
+                            const char*,
+                            int) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    couchstore_error_t close(couchstore_error_info_t*,
+                             couch_file_handle) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    ssize_t pread(couchstore_error_info_t*,
+                  couch_file_handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override {
+        ++reads;
+        if (size_t(offset) >= data.size()) {
+            return 0;
+        }
+        nbytes = std::min(nbytes, data.size() - offset);
+        std::copy_n(data.begin() + offset, nbytes, static_cast<char*>(buf));
+        return nbytes;
+    }
+    ssize_t pwrite(couchstore_error_info_t*,
+                   couch_file_handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override {
+        writes.emplace_back(offset, nbytes);
+        if (data.size() < offset + nbytes) {
+            data.resize(offset + nbytes);
+        }
+        std::copy_n(static_cast<const char*>(buf), nbytes, &data[offset]);
+        return nbytes;
+    }
+    cs_off_t goto_eof(couchstore_error_info_t*, couch_file_handle) override {
+        return data.size();
+    }
+    couchstore_error_t sync(couchstore_error_info_t*,
+                            couch_file_handle) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    couchstore_error_t advise(couchstore_error_info_t*,
+                              couch_file_handle,
+                              cs_off_t,
+                              cs_off_t,
+                              couchstore_file_advice_t) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    void destructor(couch_file_handle) override {
+    }
+
+    std::string data;
+    /// (offset, size) of each pwrite() made.
+    std::vector<std::pair<cs_off_t, size_t>> writes;
+    /// Number of pread() calls made.
+    size_t reads = 0;
+};
+
+class StatsOpsWriteCombineTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        handle = ops.constructor(&errinfo);
+        ASSERT_EQ(COUCHSTORE_SUCCESS,
+                  ops.open(&errinfo, &handle, "file", O_RDWR));
+    }
+
+    void TearDown() override {
+        ops.close(&errinfo, handle);
+        ops.destructor(handle);
+    }
+
+    void write(const std::string& value, cs_off_t offset) {
+        ASSERT_EQ(ssize_t(value.size()),
+                  ops.pwrite(&errinfo,
+                             handle,
+                             value.data(),
+                             value.size(),
+                             offset));
+    }
+
+    FileStats stats;
+    MemoryOps memory;
+    StatsOps ops{stats, memory, 16};
+    couchstore_error_info_t errinfo;
+    couch_file_handle handle;
+};
+
+// Contiguous writes are issued as one write when the file is synced.
+TEST_F(StatsOpsWriteCombineTest, ContiguousWritesCombined) {
+    write("abc", 0);
+    write("def", 3);
+    write("gh", 6);
+    EXPECT_TRUE(memory.writes.empty());
+
+    ASSERT_EQ(COUCHSTORE_SUCCESS, ops.sync(&errinfo, handle));
+    ASSERT_EQ(1, memory.writes.size());
+    EXPECT_EQ(std::make_pair(cs_off_t(0), size_t(8)), memory.writes[0]);
+    EXPECT_EQ("abcdefgh", memory.data);
+    EXPECT_EQ(1, stats.totalWriteSyscalls.load());
+    EXPECT_EQ(2, stats.totalWritesCombined.load());
+    EXPECT_EQ(8, stats.totalBytesWritten.load());
+}
+
+// A write elsewhere in the file, or one which doesn't fit, writes out what
+// has been combined so far; writes of at least the combine size go straight
+// through.
+TEST_F(StatsOpsWriteCombineTest, NonContiguousOrFullWritesFlush) {
+    write("abc", 0);
+    write("xyz", 10);
+    ASSERT_EQ(1, memory.writes.size());
+    EXPECT_EQ(std::make_pair(cs_off_t(0), size_t(3)), memory.writes[0]);
+
+    write("0123456789ab", 13);
+    ASSERT_EQ(2, memory.writes.size());
+    EXPECT_EQ(std::make_pair(cs_off_t(10), size_t(15)), memory.writes[1]);
+
+    write(std::string(16, 'z'), 25);
+    ASSERT_EQ(3, memory.writes.size());
+    EXPECT_EQ(std::make_pair(cs_off_t(25), size_t(16)), memory.writes[2]);
+    EXPECT_EQ(3, stats.totalWriteSyscalls.load());
+    EXPECT_EQ(1, stats.totalWritesCombined.load());
+}
+
+// Reads and the EOF see data which has been combined but not yet written.
+TEST_F(StatsOpsWriteCombineTest, ReadSeesPendingWrites) {
+    write("abc", 0);
+    write("def", 3);
+    EXPECT_EQ(6, ops.goto_eof(&errinfo, handle));
+
+    write("gh", 6);
+    char buf[8];
+    ASSERT_EQ(8, ops.pread(&errinfo, handle, buf, sizeof(buf), 0));
+    EXPECT_EQ("abcdefgh", std::string(buf, sizeof(buf)));
+    EXPECT_EQ(2, memory.writes.size());
+}
+
+// Closing the file writes out what has been combined.
+TEST_F(StatsOpsWriteCombineTest, CloseFlushes) {
+    write("abc", 0);
+    ASSERT_EQ(COUCHSTORE_SUCCESS, ops.close(&errinfo, handle));
+    EXPECT_EQ("abc", memory.data);
+    EXPECT_EQ(1, memory.writes.size());
+}
+
+class StatsOpsReadAheadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (int ii = 0; ii < 64; ++ii) {
+            memory.data.push_back('a' + (ii % 26));
+        }
+        handle = ops.constructor(&errinfo);
+        ASSERT_EQ(COUCHSTORE_SUCCESS,
+                  ops.open(&errinfo, &handle, "file", O_RDWR));
+    }
+
+    void TearDown() override {
+        ops.close(&errinfo, handle);
+        ops.destructor(handle);
+    }
+
+    std::string read(size_t size, cs_off_t offset) {
+        std::string buf(size, '\0');
+        const auto result =
+                ops.pread(&errinfo, handle, &buf[0], buf.size(), offset);
+        EXPECT_LE(0, result);
+        buf.resize(std::max(result, ssize_t(0)));
+        return buf;
+    }
+
+    FileStats stats;
+    MemoryOps memory;
+    StatsOps ops{stats, memory, 0, 16};
+    couchstore_error_info_t errinfo;
+    couch_file_handle handle;
+};
+
+// Small reads within what was read ahead don't read the file again.
+TEST_F(StatsOpsReadAheadTest, SmallReadsServedFromBuffer) {
+    EXPECT_EQ("abcd", read(4, 0));
+    EXPECT_EQ("efgh", read(4, 4));
+    EXPECT_EQ("mnop", read(4, 12));
+    EXPECT_EQ(1, memory.reads);
+    EXPECT_EQ(1, stats.readSizeHisto.total());
+
+    // Reads beyond (or partly beyond) the buffer read ahead again.
+    EXPECT_EQ("opqr", read(4, 14));
+    EXPECT_EQ(2, memory.reads);
+    EXPECT_EQ("c", read(1, 2));
+    EXPECT_EQ(3, memory.reads);
+}
+
+// Reads of at least the read-ahead size go straight to the file, as do reads
+// after a write.
+TEST_F(StatsOpsReadAheadTest, LargeReadsAndWrites) {
+    EXPECT_EQ(memory.data.substr(0, 32), read(32, 0));
+    EXPECT_EQ(1, memory.reads);
+
+    EXPECT_EQ("abcd", read(4, 0));
+    ASSERT_EQ(2, memory.reads);
+    ASSERT_EQ(1, ops.pwrite(&errinfo, handle, "Z", 1, 1));
+    EXPECT_EQ("aZcd", read(4, 0));
+    EXPECT_EQ(3, memory.reads);
+}
+
+// A read ahead past the end of the file only returns what there is.
+TEST_F(StatsOpsReadAheadTest, EndOfFile) {
+    EXPECT_EQ("klmn", read(4, 62 - 26));
+    EXPECT_EQ("kl", read(4, 62));
+    EXPECT_EQ("", read(4, 70));
+}
@@ -22,6 +22,8 @@
 #include "checkpoint_manager.h"
 #include "dcp/backfill_disk.h"
 #include "dcp/backfill_memory.h"
+#include "dcp/dcpconnmap.h"
+#include "dcp/item_transform_cache.h"
 #include "ep_engine.h"
 #include "ephemeral_vb.h"
 #include "failover-table.h"
@@ -404,6 +406,31 @@ TEST_P(StreamTest, test_keyAndValueExcludingXattrsMessageSize) {
     destroy_dcp_stream();
 }
 
+/*
+ * Streams needing the same modification of an item share the copy made by
+ * the first of them.
+ */
+TEST_P(StreamTest, ModifiedItemShared) {
+    auto item = makeItemWithXattrs();
+    item->setBySeqno(1);
+    item->setCas(1234);
+    queued_item qi(std::move(item));
+
+    setup_dcp_stream(0, IncludeValue::Yes, IncludeXattrs::No);
+    auto& cache = engine->getDcpConnMap().getItemTransformCache();
+    auto first = stream->public_makeResponseFromItem(qi);
+    auto second = stream->public_makeResponseFromItem(qi);
+
+    auto* firstItem =
+            dynamic_cast<MutationResponse&>(*first).getItem().get();
+    EXPECT_NE(qi.get(), firstItem);
+    EXPECT_EQ(firstItem,
+              dynamic_cast<MutationResponse&>(*second).getItem().get());
+    EXPECT_EQ(1, cache.getMisses());
+    EXPECT_EQ(1, cache.getHits());
+    destroy_dcp_stream();
+}
+
 /*
  * Test for a dcpResponse retrieved from a stream where IncludeValue is Yes and
  * IncludeXattrs are No, and the document does not have any xattrs.  So again
@@ -31,7 +31,9 @@
 #include "checkpoint_manager.h"
 #include "dcp/dcp-types.h"
 #include "dcp/dcpconnmap.h"
+#include "dcp/flow-control-manager.h"
 #include "dcp/producer.h"
+#include "dcp/ready-queue.h"
 #include "dcp/stream.h"
 #include "dcp_utils.h"
 #include "ep_time.h"
@@ -345,6 +347,54 @@ TEST_F(DCPTest, MB30189_addStats) {
             &mockStats);
 }
 
+// The adaptive flow control policy sizes each buffer to its consumer's drain
+// rate, within the memory headroom of the bucket.
+TEST_F(DCPTest, AdaptiveFlowControl) {
+    const size_t MiB = 1024 * 1024;
+    auto& stats = engine->getEpStats();
+    stats.setMaxDataSize(10240 * MiB);
+    stats.mem_high_wat = stats.getEstimatedTotalMemoryUsed() + 2048 * MiB;
+
+    DcpFlowControlManagerAdaptive manager(*engine);
+    const void* cookie1 = create_mock_cookie();
+    const void* cookie2 = create_mock_cookie();
+    MockDcpConsumer consumer1(*engine, cookie1, "test_consumer1");
+    MockDcpConsumer consumer2(*engine, cookie2, "test_consumer2");
+
+    // Initially a fair share of the budget (up to the max).
+    EXPECT_EQ(50 * MiB, manager.newConsumerConn(&consumer1));
+    EXPECT_EQ(50 * MiB, manager.newConsumerConn(&consumer2));
+    consumer1.setFlowControlBufSize(50 * MiB);
+    consumer2.setFlowControlBufSize(50 * MiB);
+
+    // Nothing drained; both drop to the min.
+    auto now = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    manager.adjustBuffers(now);
+    EXPECT_EQ(10 * MiB, consumer1.getFlowControlBufSize());
+    EXPECT_EQ(10 * MiB, consumer2.getFlowControlBufSize());
+
+    // consumer1 drains 40MiB/s, smoothed to 20MiB/s - its buffer grows to
+    // hold twice that; consumer2 stays idle.
+    consumer1.incrFlowControlFreedBytes(40 * MiB);
+    now += std::chrono::seconds(1);
+    manager.adjustBuffers(now);
+    EXPECT_EQ(40 * MiB, consumer1.getFlowControlBufSize());
+    EXPECT_EQ(10 * MiB, consumer2.getFlowControlBufSize());
+
+    // Memory runs short; the buffers shrink regardless of drain rate.
+    stats.mem_high_wat = stats.getEstimatedTotalMemoryUsed() + 20 * MiB;
+    consumer1.incrFlowControlFreedBytes(40 * MiB);
+    now += std::chrono::seconds(1);
+    manager.adjustBuffers(now);
+    EXPECT_EQ(10 * MiB, consumer1.getFlowControlBufSize());
+    EXPECT_EQ(10 * MiB, consumer2.getFlowControlBufSize());
+
+    manager.handleDisconnect(&consumer1);
+    manager.handleDisconnect(&consumer2);
+    destroy_mock_cookie(cookie1);
+    destroy_mock_cookie(cookie2);
+}
+
 std::string decompressValue(std::string compressedValue) {
     cb::compression::Buffer buffer;
     if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
@@ -1913,6 +1963,37 @@ TEST_F(NotifyTest, test_mb19503_connmap_notify_paused) {
     EXPECT_EQ(1, notifyTest.getCallbacks());
 }
 
+// Check that a connection is only queued once for notification until the
+// notifier processes it.
+TEST_F(NotifyTest, PendingNotificationsCoalesced) {
+    ConnMapNotifyTest notifyTest(*engine);
+
+    class MockServerCookieApi : public WrappedServerCookieIface {
+    public:
+        void notify_io_complete(gsl::not_null<const void*> cookie,
+                                ENGINE_ERROR_CODE status) override {
+            ++notifications;
+        }
+        int notifications = 0;
+    } scapi;
+
+    ASSERT_TRUE(notifyTest.producer->isPaused());
+    for (int ii = 0; ii < 3; ++ii) {
+        notifyTest.connMap->addConnectionToPending(
+                notifyTest.producer->shared_from_this());
+    }
+    EXPECT_EQ(1, notifyTest.connMap->getPendingNotifications().size());
+
+    notifyTest.connMap->processPendingNotifications();
+    EXPECT_EQ(1, scapi.notifications);
+    EXPECT_EQ(0, notifyTest.connMap->getPendingNotifications().size());
+
+    // Once processed it is queued again by the next notification.
+    notifyTest.connMap->addConnectionToPending(
+            notifyTest.producer->shared_from_this());
+    EXPECT_EQ(1, notifyTest.connMap->getPendingNotifications().size());
+}
+
 // Tests that the MutationResponse created for the deletion response is of the
 // correct size.
 TEST_P(ConnectionTest, test_mb24424_deleteResponse) {
@@ -2260,6 +2341,69 @@ void ConnectionTest::processConsumerMutationsNearThreshold(
     destroy_mock_cookie(cookie);
 }
 
+/* With several Processor tasks each task only processes the buffered items of
+   the vBuckets assigned to it. */
+TEST_P(ConnectionTest, ConsumerMultipleProcessors) {
+    engine->getConfiguration().setDcpConsumerProcessorTasks(2);
+    const void* cookie = create_mock_cookie();
+    auto consumer =
+            std::make_shared<MockDcpConsumer>(*engine, cookie, "test_consumer");
+    ASSERT_EQ(2, consumer->getNumProcessors());
+
+    const Vbid vbids[] = {Vbid(0), Vbid(1)};
+    const DocKey docKey{"mykey", DocKeyEncodesCollectionId::No};
+    uint32_t opaque = 1;
+    for (const auto vb : vbids) {
+        ASSERT_EQ(ENGINE_SUCCESS, set_vb_state(vb, vbucket_state_replica));
+        ASSERT_EQ(ENGINE_SUCCESS, consumer->addStream(opaque, vb, 0));
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  consumer->snapshotMarker(opaque, vb, 1, 10, 0x1));
+
+        // Force the mutation to be buffered.
+        engine->getKVBucket()->getVBucket(vb)->setTakeoverBackedUpState(true);
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  consumer->mutation(opaque,
+                                     docKey,
+                                     {}, // value
+                                     0, // priv bytes
+                                     PROTOCOL_BINARY_RAW_BYTES,
+                                     0, // cas
+                                     vb,
+                                     0, // flags
+                                     1, // by seqno
+                                     0, // rev seqno
+                                     0, // exptime
+                                     0, // locktime
+                                     {}, // meta
+                                     0)); // nru
+        engine->getKVBucket()->getVBucket(vb)->setTakeoverBackedUpState(false);
+        ++opaque;
+    }
+
+    auto getBuffered = [&consumer](Vbid vb) {
+        return static_cast<MockPassiveStream*>(
+                       consumer->getVbucketStream(vb).get())
+                ->getNumBufferItems();
+    };
+    ASSERT_EQ(1, getBuffered(vbids[0]));
+    ASSERT_EQ(1, getBuffered(vbids[1]));
+
+    // vb:1 belongs to the second Processor; the first leaves it alone.
+    EXPECT_EQ(more_to_process, consumer->processBufferedItems(1));
+    EXPECT_EQ(1, getBuffered(vbids[0]));
+    EXPECT_EQ(0, getBuffered(vbids[1]));
+
+    EXPECT_EQ(more_to_process, consumer->processBufferedItems(0));
+    EXPECT_EQ(0, getBuffered(vbids[0]));
+
+    EXPECT_EQ(all_processed, consumer->processBufferedItems(0));
+    EXPECT_EQ(all_processed, consumer->processBufferedItems(1));
+
+    consumer->closeAllStreams();
+    consumer->cancelTask();
+    destroy_mock_cookie(cookie);
+}
+
 /* Here we test how the Processor task in DCP consumer handles the scenario
    where the memory usage is beyond the replication throttle threshold.
    In case of Ephemeral buckets with 'fail_new_data' policy it is expected to
@@ -2660,3 +2804,66 @@ TEST_F(SingleThreadedStreamTest, MB31410) {
     // Cleanup
     ASSERT_EQ(ENGINE_SUCCESS, consumer->closeStream(opaque, vbid));
 }
+
+// Without a quantum each vbucket gets one response per turn.
+TEST(DcpReadyQueueTest, RoundRobin) {
+    DcpReadyQueue queue;
+    EXPECT_TRUE(queue.pushUnique(Vbid(0)));
+    EXPECT_FALSE(queue.pushUnique(Vbid(1)));
+    EXPECT_FALSE(queue.pushUnique(Vbid(0)));
+
+    Vbid vbid;
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(0), vbid);
+    queue.requeue(vbid, 1);
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(1), vbid);
+    queue.requeue(vbid, 1000);
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(0), vbid);
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(1), vbid);
+    EXPECT_FALSE(queue.popFront(vbid));
+}
+
+// With a quantum vbuckets take turns by bytes sent; a vbucket keeps its turn
+// while it has credit and skips turns to pay back an overrun.
+TEST(DcpReadyQueueTest, DeficitRoundRobin) {
+    DcpReadyQueue queue(100);
+    queue.pushUnique(Vbid(0));
+    queue.pushUnique(Vbid(1));
+
+    Vbid vbid;
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(0), vbid);
+    queue.requeue(vbid, 40);
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(0), vbid);
+    // Overruns by 20.
+    queue.requeue(vbid, 80);
+
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(1), vbid);
+    queue.requeue(vbid, 100);
+
+    // Credit of 80 this turn; overruns by 220.
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(0), vbid);
+    queue.requeue(vbid, 300);
+
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(1), vbid);
+    queue.requeue(vbid, 100);
+
+    // vb:0 sits out the next two turns (still 120, then 20 in debt), leaving
+    // vb:1 to go again.
+    for (int ii = 0; ii < 2; ++ii) {
+        ASSERT_TRUE(queue.popFront(vbid));
+        EXPECT_EQ(Vbid(1), vbid);
+        queue.requeue(vbid, 100);
+    }
+
+    ASSERT_TRUE(queue.popFront(vbid));
+    EXPECT_EQ(Vbid(0), vbid);
+    EXPECT_EQ(1, queue.size());
+}
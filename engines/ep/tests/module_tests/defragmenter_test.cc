@@ -27,6 +27,8 @@
 
 #include <valgrind/valgrind.h>
 
+#include <limits>
+
 
 /* Return how many bytes the memory allocator has mapped in RAM - essentially
  * application-allocated bytes plus memory in allocators own data structures
@@ -339,6 +341,107 @@ TEST_P(DefragmenterTest, DISABLED_RefCountMemUsage) {
     EXPECT_LE(mem_used_after_defrag, mem_used_before_defrag);
 }
 
+// Check that when the allocator can report the utilization of a value's
+// run, the defragmenter leaves values in densely packed runs alone and only
+// moves those in sparse runs.
+#if defined(HAVE_JEMALLOC)
+TEST_P(DefragmenterTest, SkipsDenseRuns) {
+#else
+TEST_P(DefragmenterTest, DISABLED_SkipsDenseRuns) {
+#endif
+    if (RUNNING_ON_VALGRIND) {
+        printf("DefragmenterTest.SkipsDenseRuns is currently disabled for"
+               " valgrind\n");
+        return;
+    }
+
+    auto* alloc_hooks = get_mock_server_api()->alloc_hooks;
+    {
+        std::unique_ptr<char[]> probe(new char[512]);
+        size_t nfree;
+        size_t nregs;
+        if (!alloc_hooks->get_allocation_utilization(
+                    probe.get(), &nfree, &nregs)) {
+            printf("DefragmenterTest.SkipsDenseRuns requires the allocator to"
+                   " report run utilization, skipping\n");
+            return;
+        }
+    }
+
+    const size_t size = 512;
+    const size_t num_docs = 5000;
+    setDocs(size, num_docs);
+
+    // Drop the checkpoint's references so the values are eligible to move.
+    vbucket->checkpointManager->clear(vbucket->getState());
+
+    const double max_utilization = 0.5;
+    const auto max_size = DefragmenterTask::getMaxValueSize(alloc_hooks);
+
+    // 1. Freshly written values are packed into full runs; (nearly) all of
+    // them should be skipped.
+    {
+        PauseResumeVBAdapter prAdapter(std::make_unique<DefragmentVisitor>(
+                0, max_size, alloc_hooks, max_utilization));
+        prAdapter.visit(*vbucket);
+
+        auto& visitor =
+                dynamic_cast<DefragmentVisitor&>(prAdapter.getHTVisitor());
+        EXPECT_EQ(num_docs, visitor.getVisitedCount());
+        EXPECT_GT(visitor.getSkippedDenseCount(), visitor.getDefragCount());
+    }
+
+    // 2. Leave one value in each run; those values should now be moved.
+    size_t num_remaining = num_docs;
+    fragment(num_docs, num_remaining);
+    {
+        AllocHooks::enable_thread_cache(false);
+
+        PauseResumeVBAdapter prAdapter(std::make_unique<DefragmentVisitor>(
+                0, max_size, alloc_hooks, max_utilization));
+        prAdapter.visit(*vbucket);
+
+        AllocHooks::enable_thread_cache(true);
+
+        auto& visitor =
+                dynamic_cast<DefragmentVisitor&>(prAdapter.getHTVisitor());
+        EXPECT_EQ(num_remaining, visitor.getVisitedCount());
+        EXPECT_GT(visitor.getDefragCount(), visitor.getSkippedDenseCount());
+    }
+}
+
+// Check that the defragmenter moves StoredValues (along with their values
+// when the allocator can't report run utilization), and that they can still
+// be found afterwards.
+TEST_P(DefragmenterTest, StoredValuesMoved) {
+    const size_t num_docs = 100;
+    setDocs(64, num_docs);
+
+    // Drop the checkpoint's references so the values are eligible to move.
+    vbucket->checkpointManager->clear(vbucket->getState());
+
+    PauseResumeVBAdapter prAdapter(std::make_unique<DefragmentVisitor>(
+            0,
+            std::numeric_limits<size_t>::max(),
+            /*alloc_hooks*/ nullptr,
+            /*max_utilization*/ 1.0,
+            /*defrag_stored_values*/ true));
+    prAdapter.visit(*vbucket);
+
+    auto& visitor = dynamic_cast<DefragmentVisitor&>(prAdapter.getHTVisitor());
+    EXPECT_EQ(num_docs, visitor.getVisitedCount());
+    EXPECT_EQ(num_docs, visitor.getDefragCount());
+    EXPECT_EQ(num_docs, visitor.getStoredValueDefragCount());
+
+    for (unsigned int i = 0; i < num_docs; i++) {
+        const auto key = makeStoredDocKey(std::to_string(i));
+        auto* v = vbucket->ht.findForRead(key).storedValue;
+        ASSERT_TRUE(v) << key;
+        EXPECT_EQ(64, v->valuelen());
+    }
+    EXPECT_EQ(num_docs, vbucket->ht.getNumItems());
+}
+
 #if defined(HAVE_JEMALLOC)
 TEST_P(DefragmenterTest, MaxDefragValueSize) {
 #else
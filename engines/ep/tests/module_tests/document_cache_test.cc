@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the DocumentCache class.
+ */
+
+#include "document_cache.h"
+#include "item.h"
+#include "kvstore.h"
+#include "test_helpers.h"
+
+#include <gtest/gtest.h>
+
+// A cached document should be returned with its value and metadata.
+TEST(DocumentCacheTest, Hit) {
+    DocumentCache cache(1024 * 1024, 4);
+    auto key = makeStoredDocKey("key");
+    auto item = make_item(Vbid(1), key, std::string(100, 'x'));
+    item.setBySeqno(10);
+    cache.insert(item, cache.getGeneration(Vbid(1)));
+    EXPECT_EQ(1, cache.getNumItems());
+    EXPECT_NE(0, cache.getMemoryUsed());
+
+    auto cached = cache.get(Vbid(1), key, GetMetaOnly::No);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(key, cached->getKey());
+    EXPECT_EQ(10, cached->getBySeqno());
+    EXPECT_EQ(std::string(100, 'x'),
+              std::string(cached->getData(), cached->getNBytes()));
+
+    // The key is only cached for its own vBucket.
+    EXPECT_FALSE(cache.get(Vbid(0), key, GetMetaOnly::No));
+    EXPECT_FALSE(
+            cache.get(Vbid(1), makeStoredDocKey("other"), GetMetaOnly::No));
+}
+
+// A metadata only lookup should return the metadata (as a metadata only
+// read from disk does, the value is not filled in).
+TEST(DocumentCacheTest, MetaOnly) {
+    DocumentCache cache(1024 * 1024, 1);
+    auto key = makeStoredDocKey("key");
+    auto item = make_item(Vbid(0), key, "value");
+    item.setCas(1234);
+    cache.insert(item, 0);
+
+    auto cached = cache.get(Vbid(0), key, GetMetaOnly::Yes);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(1234, cached->getCas());
+    EXPECT_EQ(item.getRevSeqno(), cached->getRevSeqno());
+    EXPECT_EQ(item.getNBytes(), cached->getNBytes());
+}
+
+// Deleted documents keep their deleted state.
+TEST(DocumentCacheTest, Deleted) {
+    DocumentCache cache(1024 * 1024, 1);
+    auto key = makeStoredDocKey("key");
+    auto item = make_item(Vbid(0), key, "");
+    item.setDeleted(DeleteSource::TTL);
+    cache.insert(item, 0);
+
+    auto cached = cache.get(Vbid(0), key, GetMetaOnly::No);
+    ASSERT_TRUE(cached);
+    EXPECT_TRUE(cached->isDeleted());
+    EXPECT_EQ(DeleteSource::TTL, cached->deletionSource());
+}
+
+// Once full the least recently used documents should be evicted.
+TEST(DocumentCacheTest, Eviction) {
+    auto keyA = makeStoredDocKey("a");
+    auto keyB = makeStoredDocKey("b");
+    auto keyC = makeStoredDocKey("c");
+
+    // Size the cache to hold exactly two documents.
+    size_t entrySize;
+    {
+        DocumentCache sizing(1024 * 1024, 1);
+        sizing.insert(make_item(Vbid(0), keyA, "value"), 0);
+        entrySize = sizing.getMemoryUsed();
+    }
+    DocumentCache cache(2 * entrySize, 1);
+    cache.insert(make_item(Vbid(0), keyA, "value"), 0);
+    cache.insert(make_item(Vbid(0), keyB, "value"), 0);
+    EXPECT_EQ(2, cache.getNumItems());
+
+    // Touch a, so b is the least recently used.
+    EXPECT_TRUE(cache.get(Vbid(0), keyA, GetMetaOnly::No));
+    cache.insert(make_item(Vbid(0), keyC, "value"), 0);
+    EXPECT_EQ(2, cache.getNumItems());
+    EXPECT_LE(cache.getMemoryUsed(), cache.getMaxSize());
+    EXPECT_TRUE(cache.get(Vbid(0), keyA, GetMetaOnly::No));
+    EXPECT_FALSE(cache.get(Vbid(0), keyB, GetMetaOnly::No));
+    EXPECT_TRUE(cache.get(Vbid(0), keyC, GetMetaOnly::No));
+
+    // A document larger than the whole cache is never cached.
+    cache.insert(make_item(Vbid(0), keyB, std::string(4 * entrySize, 'x')), 0);
+    EXPECT_FALSE(cache.get(Vbid(0), keyB, GetMetaOnly::No));
+    EXPECT_EQ(2, cache.getNumItems());
+}
+
+// Invalidating a key drops it, and a document read before the invalidation
+// must not be cached.
+TEST(DocumentCacheTest, Invalidate) {
+    DocumentCache cache(1024 * 1024, 1);
+    auto key = makeStoredDocKey("key");
+    cache.insert(make_item(Vbid(0), key, "value"), 0);
+
+    const auto generation = cache.getGeneration(Vbid(0));
+    cache.invalidate(Vbid(0), key);
+    EXPECT_FALSE(cache.get(Vbid(0), key, GetMetaOnly::No));
+    EXPECT_EQ(0, cache.getNumItems());
+    EXPECT_EQ(0, cache.getMemoryUsed());
+
+    cache.insert(make_item(Vbid(0), key, "stale"), generation);
+    EXPECT_FALSE(cache.get(Vbid(0), key, GetMetaOnly::No));
+
+    cache.insert(make_item(Vbid(0), key, "new"), cache.getGeneration(Vbid(0)));
+    EXPECT_TRUE(cache.get(Vbid(0), key, GetMetaOnly::No));
+}
+
+// Invalidating a vBucket drops only that vBucket's documents.
+TEST(DocumentCacheTest, InvalidateVBucket) {
+    DocumentCache cache(1024 * 1024, 2);
+    cache.insert(make_item(Vbid(0), makeStoredDocKey("a"), "value"), 0);
+    cache.insert(make_item(Vbid(0), makeStoredDocKey("b"), "value"), 0);
+    cache.insert(make_item(Vbid(1), makeStoredDocKey("a"), "value"), 0);
+
+    cache.invalidateVBucket(Vbid(0));
+    EXPECT_EQ(1, cache.getNumItems());
+    EXPECT_FALSE(cache.get(Vbid(0), makeStoredDocKey("a"), GetMetaOnly::No));
+    EXPECT_TRUE(cache.get(Vbid(1), makeStoredDocKey("a"), GetMetaOnly::No));
+    EXPECT_EQ(0, cache.getGeneration(Vbid(1)));
+}
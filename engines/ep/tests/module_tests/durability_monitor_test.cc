@@ -17,6 +17,9 @@
 
 #include "durability_monitor_test.h"
 #include "../mock/mock_synchronous_ep_engine.h"
+#include "durability_timings.h"
+
+#include <map>
 
 ENGINE_ERROR_CODE DurabilityMonitorTest::addSyncWrite(int64_t seqno) {
     auto item = std::make_unique<Item>(
@@ -182,3 +185,34 @@ TEST_F(DurabilityMonitorTest,
     }
     FAIL();
 }
+
+static void add_stat_callback(const char* key,
+                              const uint16_t klen,
+                              const char* val,
+                              const uint32_t vlen,
+                              gsl::not_null<const void*> cookie) {
+    auto* map = reinterpret_cast<std::map<std::string, std::string>*>(
+            const_cast<void*>(cookie.get()));
+    map->insert(std::make_pair(std::string(key, klen),
+                               std::string(val, vlen)));
+}
+
+// Every SyncWrite ack'ed (and so committed, with one replica) is timed.
+TEST_F(DurabilityMonitorTest, DurabilityTimings) {
+    auto& timings = store->getDurabilityTimings();
+    ASSERT_EQ(3, addSyncWrites({1, 2, 3} /*seqnos*/));
+    EXPECT_EQ(ENGINE_SUCCESS,
+              monitor->seqnoAckReceived(replica, 2 /*memSeqno*/));
+
+    std::map<std::string, std::string> stats;
+    timings.addStats(&stats, add_stat_callback);
+    EXPECT_EQ("2", stats["replicate_count"]);
+    EXPECT_EQ("2", stats["commit_count"]);
+    EXPECT_NE(stats.end(), stats.find("commit_p99_us"));
+
+    timings.reset();
+    stats.clear();
+    timings.addStats(&stats, add_stat_callback);
+    EXPECT_EQ("0", stats["replicate_count"]);
+    EXPECT_EQ("0", stats["commit_count"]);
+}
@@ -35,7 +35,10 @@ public:
         SingleThreadedKVBucketTest::SetUp();
         setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
         auto& vb = *store->getVBuckets().getBucket(vbid);
-        monitor = std::make_unique<MockDurabilityMonitor>(vb);
+        monitor = std::make_unique<MockDurabilityMonitor>(
+                vb,
+                &store->getDurabilityTimings(),
+                &engine->getEpStats().lockProfiles.durabilityMonitor);
         ASSERT_EQ(ENGINE_SUCCESS, monitor->registerReplicationChain({replica}));
     }
 
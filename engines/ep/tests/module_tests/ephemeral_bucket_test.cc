@@ -19,6 +19,8 @@
 
 #include "checkpoint_manager.h"
 #include "ephemeral_bucket.h"
+#include "ephemeral_tombstone_purger.h"
+#include "ephemeral_vb.h"
 #include "test_helpers.h"
 
 #include "../mock/mock_dcp_consumer.h"
@@ -267,3 +269,51 @@ TEST_F(SingleThreadedEphemeralPurgerTest, PurgeAcrossAllVbuckets) {
     EXPECT_GT(numPaused, 2 /* 1 run of 'HTCleaner' and more than 1 run of
                               'EphTombstoneStaleItemDeleter' */);
 }
+
+/* The stale item deleter starts a pass by itself once the stale items use
+   more than ephemeral_metadata_purge_stale_threshold of the bucket quota */
+TEST_F(SingleThreadedEphemeralPurgerTest, StaleMemoryThreshold) {
+    const Vbid vbid(0);
+    auto* bucket = dynamic_cast<EphemeralBucket*>(store);
+    auto& vb = dynamic_cast<EphemeralVBucket&>(*store->getVBucket(vbid));
+    auto& config = engine->getConfiguration();
+
+    /* Updating an item during a range read leaves the old version stale */
+    auto makeStaleItem = [this, &vb, vbid]() {
+        store_item(vbid, makeStoredDocKey("key"), "value");
+        auto itr = vb.makeRangeIterator(true /*isBackfill*/);
+        ASSERT_TRUE(itr.is_initialized());
+        store_item(vbid, makeStoredDocKey("key"), "value2");
+    };
+    makeStaleItem();
+    const auto staleBytes = bucket->getSeqListStaleMemory();
+    ASSERT_GT(staleBytes, 0);
+    ASSERT_EQ(staleBytes, vb.getSeqListStaleBytes());
+
+    EphTombstoneStaleItemDeleter deleter(engine.get(), *bucket);
+
+    /* Disabled, and then below the threshold; nothing is purged */
+    config.setEphemeralMetadataPurgeStaleThreshold(0);
+    deleter.run();
+    EXPECT_EQ(staleBytes, bucket->getSeqListStaleMemory());
+    config.setEphemeralMetadataPurgeStaleThreshold(1.0);
+    deleter.run();
+    EXPECT_EQ(staleBytes, bucket->getSeqListStaleMemory());
+
+    /* Above the threshold the stale item is purged */
+    config.setEphemeralMetadataPurgeStaleThreshold(
+            float(staleBytes) / 2 / engine->getEpStats().getMaxDataSize());
+    deleter.run();
+    EXPECT_EQ(0, bucket->getSeqListStaleMemory());
+
+    /* A requested pass (as made by the HTCleaner) runs regardless */
+    makeStaleItem();
+    ASSERT_GT(bucket->getSeqListStaleMemory(), 0);
+    config.setEphemeralMetadataPurgeStaleThreshold(0);
+    EphTombstoneStaleItemDeleter requested(engine.get(), *bucket);
+    requested.run();
+    EXPECT_GT(bucket->getSeqListStaleMemory(), 0);
+    requested.requestPass();
+    requested.run();
+    EXPECT_EQ(0, bucket->getSeqListStaleMemory());
+}
@@ -0,0 +1,126 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "epoch_domain.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// With no readers a retired object is released immediately.
+TEST(EpochDomainTest, RetireWithoutReaders) {
+    EpochDomain domain;
+    auto object = std::make_shared<int>(1);
+    std::weak_ptr<int> weak = object;
+
+    domain.retire(std::move(object));
+    EXPECT_TRUE(weak.expired());
+    EXPECT_EQ(0, domain.getNumRetired());
+}
+
+// A retired object is kept until the (outermost) guard of a reader which
+// entered before it was retired exits.
+TEST(EpochDomainTest, RetiredKeptWhileGuarded) {
+    EpochDomain domain;
+    auto object = std::make_shared<int>(1);
+    std::weak_ptr<int> weak = object;
+
+    {
+        auto outer = domain.enter();
+        ASSERT_TRUE(outer.active());
+        {
+            auto inner = domain.enter();
+            ASSERT_TRUE(inner.active());
+            domain.retire(std::move(object));
+        }
+        EXPECT_FALSE(weak.expired());
+        EXPECT_EQ(1, domain.getNumRetired());
+    }
+    EXPECT_TRUE(weak.expired());
+    EXPECT_EQ(0, domain.getNumRetired());
+}
+
+// A reader on another thread delays the release; the reader's exit
+// releases it.
+TEST(EpochDomainTest, ReleasedByLastReader) {
+    EpochDomain domain;
+    auto object = std::make_shared<int>(1);
+    std::weak_ptr<int> weak = object;
+    std::atomic<bool> entered{false};
+    std::atomic<bool> retired{false};
+
+    std::thread reader([&domain, &entered, &retired]() {
+        auto guard = domain.enter();
+        ASSERT_TRUE(guard.active());
+        entered = true;
+        while (!retired) {
+            std::this_thread::yield();
+        }
+    });
+
+    while (!entered) {
+        std::this_thread::yield();
+    }
+    domain.retire(std::move(object));
+    EXPECT_FALSE(weak.expired());
+    retired = true;
+    reader.join();
+    EXPECT_TRUE(weak.expired());
+}
+
+// Readers entering after the object was retired don't delay its release, and
+// an object (re)published while readers are running is never released while
+// one of them may be using it.
+TEST(EpochDomainTest, ConcurrentReadersAndRetire) {
+    EpochDomain domain;
+    std::atomic<int*> published{new int(0)};
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> invalid{0};
+
+    std::vector<std::thread> readers;
+    for (int ii = 0; ii < 4; ++ii) {
+        readers.emplace_back([&domain, &published, &stop, &invalid]() {
+            while (!stop) {
+                auto guard = domain.enter();
+                auto* value = published.load();
+                // A released value is overwritten with -1 by the deleter
+                if (*value < 0) {
+                    ++invalid;
+                }
+            }
+        });
+    }
+
+    // The deleter only marks the values as released; they are freed at the
+    // end so a reader which (wrongly) still uses one sees the -1 rather than
+    // freed memory.
+    std::vector<std::unique_ptr<int>> values;
+    for (int ii = 1; ii < 1000; ++ii) {
+        auto* previous = published.exchange(new int(ii));
+        values.emplace_back(previous);
+        domain.retire(std::shared_ptr<int>(previous, [](int* p) { *p = -1; }));
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, invalid);
+    EXPECT_EQ(0, domain.getNumRetired());
+    delete published.load();
+}
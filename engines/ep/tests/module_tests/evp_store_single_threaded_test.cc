@@ -31,6 +31,7 @@
 #include "ep_time.h"
 #include "evp_store_test.h"
 #include "failover-table.h"
+#include "hashtable_image.h"
 #include "fakes/fake_executorpool.h"
 #include "item_freq_decayer_visitor.h"
 #include "programs/engine_testapp/mock_server.h"
@@ -39,6 +40,7 @@
 #include "tests/module_tests/test_task.h"
 
 #include <libcouchstore/couch_db.h>
+#include <platform/dirutils.h>
 #include <string_utilities.h>
 #include <xattr/blob.h>
 #include <xattr/utils.h>
@@ -2334,6 +2336,108 @@ TEST_F(WarmupTest, setFreqSaturatedCallback) {
     EXPECT_TRUE(itemFreqTask->wakeupCalled);
 }
 
+// Test that warmup loads every vBucket when each shard's vBuckets are
+// scanned by several tasks.
+TEST_F(WarmupTest, scansPerShard) {
+    const size_t numVBuckets = 8;
+    for (uint16_t ii = 0; ii < numVBuckets; ++ii) {
+        setVBucketStateAndRunPersistTask(Vbid(ii), vbucket_state_active);
+        store_item(Vbid(ii), makeStoredDocKey("key"), "value");
+        flush_vbucket_to_disk(Vbid(ii));
+    }
+
+    resetEngineAndWarmup("warmup_scans_per_shard=3");
+    ASSERT_EQ(3, store->getWarmup()->getScansPerShard());
+
+    for (uint16_t ii = 0; ii < numVBuckets; ++ii) {
+        auto vb = store->getVBucket(Vbid(ii));
+        ASSERT_TRUE(vb);
+        EXPECT_EQ(1, vb->getNumItems()) << Vbid(ii);
+    }
+}
+
+// A clean shutdown can write HashTable images which warmup then loads
+// instead of scanning the data files, keeping each item's frequency counter.
+TEST_F(WarmupTest, hashTableImage) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    const auto key = makeStoredDocKey("key");
+    store_item(vbid, key, "value");
+    flush_vbucket_to_disk(vbid);
+    {
+        auto vb = store->getVBucket(vbid);
+        auto res = vb->ht.findForWrite(key);
+        ASSERT_TRUE(res.storedValue);
+        res.storedValue->setFreqCounterValue(200);
+    }
+
+    const auto image = HashTableImage::getFileName(test_dbname, vbid);
+    engine->getConfiguration().setWarmupHashtableImage(true);
+    store->snapshotStats();
+    resetEngineAndWarmup("warmup_hashtable_image=true");
+
+    EXPECT_TRUE(store->getWarmup()->isLoadedFromImage(vbid));
+    EXPECT_FALSE(cb::io::isFile(image)) << "image should be used only once";
+
+    auto vb = store->getVBucket(vbid);
+    ASSERT_TRUE(vb);
+    EXPECT_EQ(1, vb->getNumItems());
+    const auto* v = vb->ht.findForRead(key).storedValue;
+    ASSERT_TRUE(v);
+    EXPECT_TRUE(v->isResident());
+    EXPECT_EQ(200, v->getFreqCounterValue());
+    const auto value = v->getValueData();
+    EXPECT_EQ("value", std::string(value.data(), value.size()));
+}
+
+// An image which doesn't match the data file is ignored.
+TEST_F(WarmupTest, hashTableImageStale) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    flush_vbucket_to_disk(vbid);
+
+    const auto image = HashTableImage::getFileName(test_dbname, vbid);
+    ASSERT_TRUE(HashTableImage::write(image, *store->getVBucket(vbid), true));
+
+    // Modify the vBucket after the image was written.
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+    flush_vbucket_to_disk(vbid);
+
+    store->snapshotStats();
+    resetEngineAndWarmup("warmup_hashtable_image=true");
+    EXPECT_FALSE(store->getWarmup()->isLoadedFromImage(vbid));
+    EXPECT_FALSE(cb::io::isFile(image));
+    EXPECT_EQ(2, store->getVBucket(vbid)->getNumItems());
+}
+
+// With bfilter_persist a clean shutdown persists the bloom filters, and
+// warmup restores them.
+TEST_F(WarmupTest, persistedBloomFilter) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    const auto key = makeStoredDocKey("key");
+    store_item(vbid, key, "value");
+    flush_vbucket_to_disk(vbid);
+    // Deletes are added to the filter in either eviction mode.
+    delete_item(vbid, key);
+    flush_vbucket_to_disk(vbid);
+    ASSERT_EQ(1, store->getVBucket(vbid)->getNumOfKeysInFilter());
+
+    engine->getConfiguration().setBfilterPersist(true);
+    store->snapshotStats();
+    resetEngineAndWarmup("bfilter_persist=true");
+
+    auto vb = store->getVBucket(vbid);
+    ASSERT_TRUE(vb);
+    EXPECT_EQ("ENABLED", vb->getFilterStatusString());
+    EXPECT_EQ(1, vb->getNumOfKeysInFilter());
+    EXPECT_TRUE(vb->maybeKeyExistsInFilter(key));
+
+    // Without it, there's no filter until the vBucket is compacted.
+    store->snapshotStats();
+    resetEngineAndWarmup();
+    EXPECT_EQ("DOESN'T EXIST",
+              store->getVBucket(vbid)->getFilterStatusString());
+}
+
 TEST_F(WarmupTest, hlcEpoch) {
     setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
 
@@ -2635,6 +2739,8 @@ TEST_F(SingleThreadedEPBucketTest, mb25273) {
 // runs to complete.  If the task takes less than or more than two passes to
 // complete then an error will be reported.
 TEST_F(SingleThreadedEPBucketTest, ItemFreqDecayerTaskTest) {
+    // Decay by visiting the documents
+    engine->getConfiguration().setItemFreqDecayerLazy(false);
     setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
 
     // ProgressTracker:INITIAL_VISIT_COUNT_CHECK = 100 and therefore
@@ -2662,6 +2768,41 @@ TEST_F(SingleThreadedEPBucketTest, ItemFreqDecayerTaskTest) {
     EXPECT_TRUE(itemFreqDecayerTask->isCompleted());
 }
 
+// With lazy decay the ItemFreqDecayerTask completes without visiting the
+// documents; their counters are decayed when they're next accessed.
+TEST_F(SingleThreadedEPBucketTest, ItemFreqDecayerTaskLazy) {
+    engine->getConfiguration().setItemFreqDecayerLazy(true);
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+    for (uint32_t ii = 1; ii < 110; ii++) {
+        auto key = makeStoredDocKey("DOC_" + std::to_string(ii));
+        store_item(vbid, key, "value");
+    }
+    auto key = makeStoredDocKey("DOC_1");
+    auto vb = store->getVBucket(vbid);
+    {
+        auto result = vb->ht.findForWrite(key);
+        ASSERT_TRUE(result.storedValue);
+        result.storedValue->setFreqCounterValue(200);
+    }
+
+    auto& lpNonioQ = *task_executor->getLpTaskQ()[NONIO_TASK_IDX];
+    auto itemFreqDecayerTask =
+            std::make_shared<MockItemFreqDecayerTask>(engine.get(), 50);
+    task_executor->schedule(itemFreqDecayerTask);
+    itemFreqDecayerTask->wakeup();
+    runNextTask(lpNonioQ, "Item frequency count decayer task");
+    EXPECT_TRUE(itemFreqDecayerTask->isCompleted());
+
+    auto result = vb->ht.findForWrite(key);
+    ASSERT_TRUE(result.storedValue);
+    // Not yet applied...
+    EXPECT_EQ(200, result.storedValue->getFreqCounterValue());
+    // ... until the document is accessed.
+    vb->ht.applyFreqDecay(*result.storedValue);
+    EXPECT_EQ(100, result.storedValue->getFreqCounterValue());
+}
+
 // Test to confirm that the ItemFreqDecayerTask gets created on kv_bucket
 // initialisation.  The task should be runnable.  However once run should
 // enter a "snoozed" state.
@@ -3231,6 +3372,117 @@ TEST_F(SingleThreadedEPBucketTest, MB_31141_sanitise_input) {
     EXPECT_EQ(PROTOCOL_BINARY_RAW_BYTES, gv.item->getDataType());
 }
 
+// With a dcp_seqno_ack_batch_size set, the consumer acks the prepares of a
+// snapshot every N prepares, and at the end of the snapshot.
+TEST_F(SingleThreadedEPBucketTest, ConsumerSeqnoAckBatchSize) {
+    engine->getConfiguration().setDcpSeqnoAckBatchSize(3);
+    engine->getConfiguration().setDcpSeqnoAckMaxDelayUs(60 * 1000 * 1000);
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_replica);
+    auto vb = store->getVBuckets().getBucket(vbid);
+    ASSERT_NE(nullptr, vb.get());
+
+    auto consumer =
+            std::make_shared<MockDcpConsumer>(*engine, cookie, "test_consumer");
+    auto stream = std::static_pointer_cast<MockPassiveStream>(
+            consumer->makePassiveStream(
+                    *engine,
+                    consumer,
+                    "test-passive-stream",
+                    0 /* flags */,
+                    0 /* opaque */,
+                    vbid,
+                    0 /* startSeqno */,
+                    std::numeric_limits<uint64_t>::max() /* endSeqno */,
+                    0 /* vbUuid */,
+                    0 /* snapStartSeqno */,
+                    0 /* snapEndSeqno */,
+                    0 /* vb_high_seqno */));
+
+    const uint64_t snapshotEnd = 7;
+    SnapshotMarker marker(0 /* opaque */,
+                          vbid,
+                          1 /* start */,
+                          snapshotEnd,
+                          dcp_marker_flag_t::MARKER_FLAG_MEMORY,
+                          {});
+    stream->processMarker(&marker);
+
+    for (uint64_t seqno = 1; seqno <= snapshotEnd; ++seqno) {
+        queued_item qi(new Item(makeStoredDocKey("key" + std::to_string(seqno)),
+                                0 /*flags*/,
+                                0 /*expiry*/,
+                                "value",
+                                5 /*valueSize*/,
+                                PROTOCOL_BINARY_RAW_BYTES,
+                                0 /*cas*/,
+                                seqno,
+                                vbid));
+        qi->setPendingSyncWrite({cb::durability::Level::Majority, 0});
+        MutationConsumerMessage prepare(std::move(qi),
+                                        0 /* opaque */,
+                                        IncludeValue::Yes,
+                                        IncludeXattrs::Yes,
+                                        IncludeDeleteTime::No,
+                                        DocKeyEncodesCollectionId::No,
+                                        nullptr,
+                                        cb::mcbp::DcpStreamId{});
+        EXPECT_EQ(ENGINE_SUCCESS, stream->public_processPrepare(&prepare));
+    }
+
+    // Acks after the 3rd and 6th prepares, then the snapshot end.
+    std::vector<uint64_t> acked;
+    while (auto resp = stream->next()) {
+        if (resp->getEvent() == DcpResponse::Event::SeqnoAcknowledgement) {
+            acked.push_back(static_cast<SeqnoAcknowledgement&>(*resp)
+                                    .getInMemorySeqno());
+        }
+    }
+    EXPECT_EQ(std::vector<uint64_t>({3, 6, 7}), acked);
+}
+
+// With a step_batch_size set, a single step of the producer hands the
+// snapshot marker and the mutations following it to the front-end.
+TEST_F(SingleThreadedEPBucketTest, ProducerStepBatchSize) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    auto vb = store->getVBuckets().getBucket(vbid);
+    ASSERT_NE(nullptr, vb.get());
+
+    auto producer = std::make_shared<MockDcpProducer>(*engine,
+                                                      cookie,
+                                                      "test_producer",
+                                                      /*flags*/ 0);
+    producer->createCheckpointProcessorTask();
+    EXPECT_EQ(ENGINE_EINVAL, producer->control(0, "step_batch_size", "0"));
+    EXPECT_EQ(ENGINE_SUCCESS, producer->control(0, "step_batch_size", "10"));
+
+    MockDcpMessageProducers producers(engine.get());
+    producer->mockActiveStreamRequest(0, // flags
+                                      1, // opaque
+                                      *vb,
+                                      0, // start_seqno
+                                      ~0, // end_seqno
+                                      0, // vbucket_uuid,
+                                      0, // snap_start_seqno,
+                                      0); // snap_end_seqno,
+
+    const std::array<std::string, 5> keys = {{"k1", "k2", "k3", "k4", "k5"}};
+    for (const auto& key : keys) {
+        store_item(vbid, makeStoredDocKey(key), key);
+    }
+
+    // One step sends the marker and all five mutations.
+    notifyAndStepToCheckpoint(
+            *producer, producers, cb::mcbp::ClientOpcode::DcpMutation);
+    EXPECT_EQ("k5", producers.last_key);
+    EXPECT_EQ(5, producers.last_byseqno);
+    EXPECT_EQ(keys.size(), producer->getItemsSent());
+
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, producer->step(&producers));
+
+    producer->closeAllStreams();
+    producer->cancelCheckpointCreatorTask();
+}
+
 // Test highlighting MB_29480 - this is not demonstrating the issue is fixed.
 TEST_F(SingleThreadedEPBucketTest, MB_29480) {
     // Make vbucket active.
@@ -3401,6 +3653,139 @@ TEST_F(SingleThreadedEPBucketTest, MB_29512) {
     producer->cancelCheckpointCreatorTask();
 }
 
+// Two streams backfilling the same vBucket share one disk scan; the items read
+// by the first backfill's scan are passed to both streams.
+TEST_F(SingleThreadedEPBucketTest, SharedDiskBackfillScan) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+    std::array<std::string, 4> keys = {{"k1", "k2", "k3", "k4"}};
+    for (const auto& key : keys) {
+        store_item(vbid, makeStoredDocKey(key), key);
+    }
+    flush_vbucket_to_disk(vbid, keys.size());
+
+    // Wipe memory so both streams have to backfill from disk.
+    resetEngineAndWarmup("dcp_backfill_shared_scans=true");
+
+    auto* cookie2 = create_mock_cookie();
+    auto producer1 = std::make_shared<MockDcpProducer>(
+            *engine, cookie, "producer1", /*flags*/ 0);
+    auto producer2 = std::make_shared<MockDcpProducer>(
+            *engine, cookie2, "producer2", /*flags*/ 0);
+
+    auto vb = store->getVBuckets().getBucket(vbid);
+    ASSERT_NE(nullptr, vb.get());
+    for (auto& producer : {producer1, producer2}) {
+        producer->createCheckpointProcessorTask();
+        uint64_t rollbackSeqno = 0;
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  producer->streamRequest(0, // flags
+                                          1, // opaque
+                                          vbid,
+                                          0, // start_seqno
+                                          ~0, // end_seqno
+                                          vb->failovers->getLatestUUID(),
+                                          0, // snap_start_seqno
+                                          0, // snap_end_seqno
+                                          &rollbackSeqno,
+                                          &dcpAddFailoverLog,
+                                          {}));
+    }
+    auto* stream1 =
+            static_cast<MockActiveStream*>(producer1->findStream(vbid).get());
+    auto* stream2 =
+            static_cast<MockActiveStream*>(producer2->findStream(vbid).get());
+    ASSERT_TRUE(stream1->isBackfilling());
+    ASSERT_TRUE(stream2->isBackfilling());
+
+    auto& lpAuxioQ = *task_executor->getLpTaskQ()[AUXIO_TASK_IDX];
+    // backfill:create() of producer1, creating the scan...
+    runNextTask(lpAuxioQ);
+    // ... and of producer2, which joins it.
+    runNextTask(lpAuxioQ);
+    EXPECT_EQ(0, stream2->getNumBackfillItems());
+
+    // backfill:scan() of producer1 reads the items for both streams.
+    runNextTask(lpAuxioQ);
+    EXPECT_EQ(keys.size(), stream1->getNumBackfillItems());
+    EXPECT_EQ(keys.size(), stream2->getNumBackfillItems());
+    // Snapshot marker plus the items.
+    EXPECT_EQ(keys.size() + 1, stream1->public_readyQSize());
+    EXPECT_EQ(keys.size() + 1, stream2->public_readyQSize());
+
+    // The rest of both backfills: scan() (done) / complete() / finished().
+    for (int ii = 0; ii < 5; ++ii) {
+        runNextTask(lpAuxioQ);
+    }
+    EXPECT_FALSE(stream1->public_isBackfillTaskRunning());
+    EXPECT_FALSE(stream2->public_isBackfillTaskRunning());
+    EXPECT_EQ(keys.size(), stream2->getNumBackfillItems());
+
+    for (auto& producer : {producer1, producer2}) {
+        producer->closeAllStreams();
+        producer->cancelCheckpointCreatorTask();
+    }
+    destroy_mock_cookie(cookie2);
+}
+
+// The scan buffer grows while the client keeps the backfill buffer drained,
+// and shrinks back once the backfill buffer fills.
+TEST_F(SingleThreadedEPBucketTest, AdaptiveBackfillScanBuffer) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    for (int ii = 0; ii < 10; ++ii) {
+        store_item(vbid, makeStoredDocKey("key" + std::to_string(ii)), "v");
+    }
+    flush_vbucket_to_disk(vbid, 10);
+
+    resetEngineAndWarmup(
+            "dcp_scan_item_limit=2;dcp_scan_byte_limit=4194304;"
+            "dcp_scan_byte_limit_max=16777216");
+
+    auto producer = std::make_shared<MockDcpProducer>(
+            *engine, cookie, "test_producer", /*flags*/ 0);
+    producer->createCheckpointProcessorTask();
+    auto vb = store->getVBuckets().getBucket(vbid);
+    ASSERT_NE(nullptr, vb.get());
+    uint64_t rollbackSeqno = 0;
+    ASSERT_EQ(ENGINE_SUCCESS,
+              producer->streamRequest(0, // flags
+                                      1, // opaque
+                                      vbid,
+                                      0, // start_seqno
+                                      ~0, // end_seqno
+                                      vb->failovers->getLatestUUID(),
+                                      0, // snap_start_seqno
+                                      0, // snap_end_seqno
+                                      &rollbackSeqno,
+                                      &dcpAddFailoverLog,
+                                      {}));
+
+    auto& scanBuffer = producer->public_getBackfillScanBuffer();
+    auto& lpAuxioQ = *task_executor->getLpTaskQ()[AUXIO_TASK_IDX];
+    // backfill:create()
+    runNextTask(lpAuxioQ);
+    EXPECT_EQ(2, scanBuffer.maxItems);
+
+    // Each scan() run is cut short by the scan buffer with the (empty)
+    // backfill buffer drained, so the scan buffer doubles up to the max.
+    runNextTask(lpAuxioQ);
+    EXPECT_EQ(8388608, scanBuffer.maxBytes);
+    EXPECT_EQ(4, scanBuffer.maxItems);
+    runNextTask(lpAuxioQ);
+    EXPECT_EQ(16777216, scanBuffer.maxBytes);
+    EXPECT_EQ(8, scanBuffer.maxItems);
+
+    // The client stops draining; the next run fills the backfill buffer.
+    producer->setBackfillBufferSize(1);
+    runNextTask(lpAuxioQ);
+    EXPECT_TRUE(producer->getBackfillBufferFullStatus());
+    EXPECT_EQ(8388608, scanBuffer.maxBytes);
+    EXPECT_EQ(4, scanBuffer.maxItems);
+
+    producer->closeAllStreams();
+    producer->cancelCheckpointCreatorTask();
+}
+
 TEST_F(SingleThreadedEPBucketTest, MB_29541) {
     setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
 
@@ -28,10 +28,12 @@
 
 #include "../mock/mock_dcp_producer.h"
 #include "bgfetcher.h"
+#include "checkpoint_manager.h"
 #include "checkpoint_remover.h"
 #include "dcp/dcpconnmap.h"
 #include "flusher.h"
 #include "item_eviction.h"
+#include "kvshard.h"
 #include "tests/mock/mock_global_task.h"
 #include "tests/mock/mock_synchronous_ep_engine.h"
 #include "tests/module_tests/test_helpers.h"
@@ -1147,6 +1149,165 @@ TEST_F(EPStoreFullEvictionNoBloomFIlterTest, MB_29816) {
     ASSERT_EQ(ENGINE_KEY_ENOENT, gv.getStatus());
 }
 
+class EPBucketMultiFlusherTest : public EPBucketTest {
+    void SetUp() override {
+        config_string += "max_num_shards=2;flushers_per_shard=2";
+        EPBucketTest::SetUp();
+    }
+};
+
+// With two flushers per shard, consecutive vBuckets of the same shard should
+// alternate between the shard's writer stores, and each vBucket's data must
+// be readable once flushed through its own store.
+TEST_F(EPBucketMultiFlusherTest, VBucketsSpreadAcrossFlushers) {
+    auto* shard = store->getVBuckets().getShardByVbId(Vbid(0));
+    ASSERT_EQ(2, shard->getNumFlushers());
+    ASSERT_EQ(shard, store->getVBuckets().getShardByVbId(Vbid(2)));
+    EXPECT_EQ(0, shard->getFlusherIndex(Vbid(0)));
+    EXPECT_EQ(1, shard->getFlusherIndex(Vbid(2)));
+    EXPECT_NE(shard->getRWUnderlying(Vbid(0)),
+              shard->getRWUnderlying(Vbid(2)));
+    EXPECT_NE(shard->getFlusher(0), shard->getFlusher(1));
+    EXPECT_EQ(nullptr, shard->getFlusher(2));
+
+    for (auto id : {Vbid(0), Vbid(2)}) {
+        store->setVBucketState(id, vbucket_state_active, false);
+        auto key = makeStoredDocKey("key");
+        store_item(id, key, "value");
+        flush_vbucket_to_disk(id);
+        evict_key(id, key);
+
+        auto gv = store->get(key, id, cookie, QUEUE_BG_FETCH);
+        ASSERT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+        runBGFetcherTask();
+        gv = store->get(key, id, cookie, QUEUE_BG_FETCH);
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus()) << id.to_string();
+    }
+}
+
+class EPBucketMultiBgFetcherTest : public EPBucketTest {
+    void SetUp() override {
+        config_string += "max_num_shards=2;bgfetchers_per_shard=2";
+        EPBucketTest::SetUp();
+    }
+};
+
+// With two BgFetchers per shard, consecutive vBuckets of the same shard
+// should alternate between them, and each only fetches for its own vBuckets.
+TEST_F(EPBucketMultiBgFetcherTest, VBucketsSpreadAcrossBgFetchers) {
+    auto* shard = store->getVBuckets().getShardByVbId(Vbid(0));
+    ASSERT_EQ(2, shard->getNumBgFetchers());
+    ASSERT_EQ(shard, store->getVBuckets().getShardByVbId(Vbid(2)));
+    EXPECT_EQ(0, shard->getBgFetcherIndex(Vbid(0)));
+    EXPECT_EQ(1, shard->getBgFetcherIndex(Vbid(2)));
+    EXPECT_NE(shard->getBgFetcher(0), shard->getBgFetcher(1));
+    EXPECT_EQ(nullptr, shard->getBgFetcher(2));
+
+    const Vbid id(2);
+    store->setVBucketState(id, vbucket_state_active, false);
+    auto key = makeStoredDocKey("key");
+    store_item(id, key, "value");
+    flush_vbucket_to_disk(id);
+    evict_key(id, key);
+
+    auto gv = store->get(key, id, cookie, QUEUE_BG_FETCH);
+    ASSERT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+    auto vb = store->getVBucket(id);
+    EXPECT_FALSE(shard->getBgFetcher(0)->pendingJob());
+    EXPECT_TRUE(shard->getBgFetcher(1)->pendingJob());
+
+    MockGlobalTask mockTask(engine->getTaskable(),
+                            TaskId::MultiBGFetcherTask);
+    shard->getBgFetcher(0)->run(&mockTask);
+    EXPECT_TRUE(vb->hasPendingBGFetchItems());
+    shard->getBgFetcher(1)->run(&mockTask);
+    EXPECT_FALSE(vb->hasPendingBGFetchItems());
+
+    gv = store->get(key, id, cookie, QUEUE_BG_FETCH);
+    EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus());
+}
+
+// Persistence waiters are notified by the commit which persists what they
+// wait for, regardless of the order they were added in; those waiting for
+// more remain.
+TEST_F(EPBucketTest, HighPriorityRequestsNotifiedOnCommit) {
+    store->setVBucketState(vbid, vbucket_state_active, false);
+    auto vb = store->getVBucket(vbid);
+    const void* cookie2 = create_mock_cookie();
+    const void* cookie3 = create_mock_cookie();
+    vb->checkAddHighPriorityVBEntry(3, cookie3, HighPriorityVBNotify::Seqno);
+    vb->checkAddHighPriorityVBEntry(1, cookie, HighPriorityVBNotify::Seqno);
+    vb->checkAddHighPriorityVBEntry(2, cookie2, HighPriorityVBNotify::Seqno);
+    ASSERT_EQ(3, vb->getHighPriorityChkSize());
+
+    auto& stats = engine->getEpStats();
+    stats.seqnoPersistenceHisto.reset();
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+    flush_vbucket_to_disk(vbid, 2);
+    EXPECT_EQ(1, vb->getHighPriorityChkSize());
+    EXPECT_EQ(2, stats.seqnoPersistenceHisto.total());
+
+    store_item(vbid, makeStoredDocKey("key3"), "value");
+    flush_vbucket_to_disk(vbid, 1);
+    EXPECT_EQ(0, vb->getHighPriorityChkSize());
+    EXPECT_EQ(3, stats.seqnoPersistenceHisto.total());
+
+    destroy_mock_cookie(cookie2);
+    destroy_mock_cookie(cookie3);
+}
+
+// Couchstore syncs every vBucket file on commit, so a flush offered the
+// chance to defer its sync (group commit) must complete immediately.
+TEST_F(EPBucketTest, GroupCommitFlushCompletesWithoutSupport) {
+    store->setVBucketState(vbid, vbucket_state_active, false);
+    store_item(vbid, makeStoredDocKey("key"), "value");
+
+    auto& bucket = dynamic_cast<EPBucket&>(*store);
+    std::vector<Vbid> unsynced;
+    EXPECT_EQ(std::make_pair(false, size_t(1)),
+              bucket.flushVBucket(vbid, &unsynced));
+    EXPECT_TRUE(unsynced.empty());
+    EXPECT_EQ(1, store->getVBucket(vbid)->getPersistenceSeqno());
+    EXPECT_TRUE(bucket.syncFlushedVBuckets(*store->getRWUnderlying(vbid),
+                                           unsynced));
+}
+
+// Likewise a flush of only a vBucket state change.
+TEST_F(EPBucketTest, GroupCommitStateFlushCompletesWithoutSupport) {
+    store->setVBucketState(vbid, vbucket_state_active, false);
+    auto& bucket = dynamic_cast<EPBucket&>(*store);
+    std::vector<Vbid> unsynced;
+    bucket.flushVBucket(vbid, &unsynced);
+    ASSERT_TRUE(unsynced.empty());
+
+    store->setVBucketState(vbid, vbucket_state_replica, false);
+    EXPECT_EQ(std::make_pair(false, size_t(0)),
+              bucket.flushVBucket(vbid, &unsynced));
+    EXPECT_TRUE(unsynced.empty());
+    EXPECT_EQ(vbucket_state_replica,
+              store->getRWUnderlying(vbid)->getVBucketState(vbid)->state);
+}
+
+// A key updated in several checkpoints should only be written once when
+// those checkpoints are flushed in the same batch.
+TEST_F(EPBucketTest, FlushDeduplicatesAcrossCheckpoints) {
+    store->setVBucketState(vbid, vbucket_state_active, false);
+    auto vb = store->getVBucket(vbid);
+    auto key = makeStoredDocKey("key");
+
+    store_item(vbid, key, "value1");
+    vb->checkpointManager->createNewCheckpoint();
+    store_item(vbid, key, "value2");
+    vb->checkpointManager->createNewCheckpoint();
+    store_item(vbid, key, "value3");
+    ASSERT_EQ(0, engine->getEpStats().totalDeduplicated.load());
+
+    flush_vbucket_to_disk(vbid, 1);
+    EXPECT_EQ(2, engine->getEpStats().totalDeduplicatedFlusher);
+    EXPECT_EQ(vb->getHighSeqno(), vb->getPersistenceSeqno());
+}
+
 struct PrintToStringCombinedName {
     std::string operator()(
             const ::testing::TestParamInfo<::testing::tuple<std::string, bool>>&
@@ -250,6 +250,104 @@ TEST_F(ExecutorPoolDynamicWorkerTest, reschedule_dead_task) {
     EXPECT_EQ(2, runCount);
 }
 
+/* With local queues enabled every task must still run exactly once, whether
+ * it is run by the thread which fetched it or stolen by another thread.
+ */
+TEST_F(ExecutorPoolDynamicWorkerTest, local_queues) {
+    pool->setLocalQueueSize(8);
+
+    const size_t numTasks = 200;
+    std::atomic<size_t> runCount{0};
+    for (size_t i = 0; i < numTasks; ++i) {
+        ExTask task = std::make_shared<LambdaTask>(
+                taskable, TaskId::StatSnap, 0, true, [&] {
+                    ++runCount;
+                    return false;
+                });
+        pool->schedule(task);
+    }
+    pool->waitForEmptyTaskLocator();
+
+    EXPECT_EQ(numTasks, runCount);
+    EXPECT_EQ(0, pool->getNumReadyTasks());
+}
+
+/* With autoscaling enabled a writer is added while a task waits behind busy
+ * writers, and removed again after the writers have been idle long enough.
+ */
+TEST_F(ExecutorPoolDynamicWorkerTest, autoscale_writers) {
+    pool->setAutoscaleLimit(WRITER_TASK_IDX, 3);
+
+    std::atomic<bool> release{false};
+    std::vector<ExTask> tasks;
+    for (size_t i = 0; i < 3; ++i) {
+        ExTask task = std::make_shared<LambdaTask>(
+                taskable, TaskId::StatSnap, 0, true, [&] {
+                    while (!release) {
+                        std::this_thread::sleep_for(
+                                std::chrono::milliseconds(1));
+                    }
+                    return false;
+                });
+        pool->schedule(task);
+        tasks.push_back(task);
+    }
+
+    // Both writers busy, the third task waiting for a thread.
+    while (pool->getNumBusyWorkers(WRITER_TASK_IDX) < 2 ||
+           pool->getNumReadyTasks() < 1) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(2, pool->autoscaleCheck(WRITER_TASK_IDX));
+    EXPECT_EQ(3, pool->autoscaleCheck(WRITER_TASK_IDX));
+    EXPECT_EQ(3, pool->getNumWriters());
+
+    release = true;
+    pool->waitForEmptyTaskLocator();
+
+    for (size_t i = 1; i < ExecutorPool::AutoscaleShrinkChecks; ++i) {
+        ASSERT_EQ(3, pool->autoscaleCheck(WRITER_TASK_IDX));
+    }
+    EXPECT_EQ(2, pool->autoscaleCheck(WRITER_TASK_IDX));
+
+    // Never below the thread count autoscaling started from.
+    for (size_t i = 0; i < ExecutorPool::AutoscaleShrinkChecks; ++i) {
+        ASSERT_EQ(2, pool->autoscaleCheck(WRITER_TASK_IDX));
+    }
+}
+
+/* Runtime is charged to a taskable scaled by its weight, and a newly
+ * registered taskable starts level with the least served existing one.
+ */
+TEST_F(ExecutorPoolTest, taskable_share_accounting) {
+    MockTaskable taskable;
+    taskable.setWorkloadWeight(4);
+    taskable.chargeRunTime(READER_TASK_IDX, std::chrono::microseconds(8));
+    EXPECT_EQ(8000, taskable.getTotalRunTime(READER_TASK_IDX));
+    EXPECT_EQ(2000, taskable.getVirtualRunTime(READER_TASK_IDX));
+    EXPECT_EQ(0, taskable.getVirtualRunTime(WRITER_TASK_IDX));
+
+    TestExecutorPool pool(10, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          2, // MaxNumReaders
+                          2, // MaxNumWriters
+                          2, // MaxNumAuxio
+                          2 // MaxNumNonio
+    );
+    pool.registerTaskable(taskable);
+    EXPECT_FALSE(pool.isSharingThreads());
+
+    MockTaskable taskable2;
+    pool.registerTaskable(taskable2);
+    EXPECT_TRUE(pool.isSharingThreads());
+    EXPECT_EQ(2000, taskable2.getVirtualRunTime(READER_TASK_IDX));
+    EXPECT_EQ(0, taskable2.getTotalRunTime(READER_TASK_IDX));
+
+    pool.unregisterTaskable(taskable2, false);
+    EXPECT_FALSE(pool.isSharingThreads());
+    pool.unregisterTaskable(taskable, false);
+}
+
 /* Testing to ensure that repeatedly scheduling a task does not result in
  * multiple entries in the taskQueue - this could cause a deadlock in
  * _unregisterTaskable when the taskLocator is empty but duplicate tasks remain
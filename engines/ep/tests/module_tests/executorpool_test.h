@@ -100,6 +100,16 @@ public:
         tMutex.wait(lh, [this] { return taskLocator.empty(); });
     }
 
+    /// Run an autoscale check of the given type, bypassing the rate limit.
+    size_t autoscaleCheck(task_type_t type) {
+        std::lock_guard<std::mutex> lh(autoscaleMutex);
+        return _autoscaleWorkers(type);
+    }
+
+    size_t getNumBusyWorkers(task_type_t type) {
+        return curWorkers[type];
+    }
+
     ~TestExecutorPool() = default;
 };
 
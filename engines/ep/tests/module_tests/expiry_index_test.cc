@@ -0,0 +1,66 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+/*
+ * Unit tests for the ExpiryIndex class.
+ */
+
+#include "expiry_index.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+static StoredDocKey makeKey(const std::string& key) {
+    return StoredDocKey(key, CollectionID::Default);
+}
+
+// Only the keys which expired before the given time are taken, once.
+TEST(ExpiryIndexTest, TakeExpired) {
+    ExpiryIndex index;
+    index.add(makeKey("a"), 100);
+    index.add(makeKey("b"), 200);
+    index.add(makeKey("c"), 0);
+    index.add(makeKey("d"), 100);
+    EXPECT_EQ(3, index.size());
+
+    // Expired means strictly before, as StoredValue::isExpired.
+    EXPECT_TRUE(index.takeExpired(100).empty());
+
+    auto expired = index.takeExpired(101);
+    std::sort(expired.begin(), expired.end());
+    ASSERT_EQ(2, expired.size());
+    EXPECT_EQ(makeKey("a"), expired[0]);
+    EXPECT_EQ(makeKey("d"), expired[1]);
+    EXPECT_EQ(1, index.size());
+
+    EXPECT_TRUE(index.takeExpired(101).empty());
+    expired = index.takeExpired(1000);
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(makeKey("b"), expired[0]);
+    EXPECT_EQ(0, index.size());
+}
+
+// A key stored with several expiry times is taken for each of them.
+TEST(ExpiryIndexTest, Duplicates) {
+    ExpiryIndex index;
+    index.add(makeKey("a"), 100);
+    index.add(makeKey("a"), 100);
+    index.add(makeKey("a"), 300);
+    EXPECT_EQ(3, index.size());
+    EXPECT_EQ(2, index.takeExpired(200).size());
+    EXPECT_EQ(1, index.takeExpired(400).size());
+}
@@ -0,0 +1,90 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the FlushBatchController class.
+ */
+
+#include "flush_batch_controller.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono;
+
+// Without a target the limit is always the max batch size.
+TEST(FlushBatchControllerTest, Disabled) {
+    FlushBatchController controller(10000, 100, milliseconds(0));
+    controller.commitCompleted(10000, seconds(10));
+    EXPECT_EQ(10000, controller.getBatchLimit());
+
+    controller.setMaxBatchSize(500);
+    EXPECT_EQ(500, controller.getBatchLimit());
+}
+
+// Slow commits shrink the limit in proportion, down to the min batch size.
+TEST(FlushBatchControllerTest, ShrinksOnSlowCommits) {
+    FlushBatchController controller(10000, 100, milliseconds(100));
+    controller.commitCompleted(10000, milliseconds(400));
+    EXPECT_EQ(2500, controller.getBatchLimit());
+
+    // A slow commit of a smaller batch scales down from that batch's size.
+    controller.commitCompleted(500, milliseconds(200));
+    EXPECT_EQ(250, controller.getBatchLimit());
+
+    controller.commitCompleted(250, seconds(10));
+    EXPECT_EQ(100, controller.getBatchLimit());
+}
+
+// Fast commits of batches close to the limit grow it back, up to the max.
+TEST(FlushBatchControllerTest, GrowsOnFastCommits) {
+    FlushBatchController controller(1000, 10, milliseconds(100));
+    controller.commitCompleted(1000, milliseconds(1000));
+    ASSERT_EQ(100, controller.getBatchLimit());
+
+    // Small batches say nothing about how large a batch could be.
+    controller.commitCompleted(10, milliseconds(1));
+    EXPECT_EQ(100, controller.getBatchLimit());
+
+    // Within target but not well within; stays put.
+    controller.commitCompleted(100, milliseconds(80));
+    EXPECT_EQ(100, controller.getBatchLimit());
+
+    controller.commitCompleted(100, milliseconds(10));
+    EXPECT_EQ(151, controller.getBatchLimit());
+
+    for (int ii = 0; ii < 10; ++ii) {
+        controller.commitCompleted(controller.getBatchLimit(),
+                                   milliseconds(10));
+    }
+    EXPECT_EQ(1000, controller.getBatchLimit());
+}
+
+// Changing the bounds applies to the current limit.
+TEST(FlushBatchControllerTest, BoundsChanged) {
+    FlushBatchController controller(1000, 10, milliseconds(100));
+    controller.commitCompleted(1000, milliseconds(1000));
+    ASSERT_EQ(100, controller.getBatchLimit());
+
+    controller.setMinBatchSize(200);
+    EXPECT_EQ(200, controller.getBatchLimit());
+
+    controller.setMaxBatchSize(50);
+    EXPECT_EQ(50, controller.getBatchLimit());
+
+    controller.setTargetCommitTime(milliseconds(0));
+    EXPECT_EQ(50, controller.getBatchLimit());
+}
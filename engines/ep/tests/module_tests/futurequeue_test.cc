@@ -23,7 +23,7 @@
 
 class FutureQueueTest : public ::testing::TestWithParam<std::string> {
 public:
-    FutureQueue<> queue;
+    FutureQueue queue;
     MockTaskable taskable;
 };
 
@@ -224,3 +224,38 @@ TEST_F(FutureQueueTest, taskNotInQueue) {
     EXPECT_EQ(-1,
               static_cast<TestTask*>(queue.top().get())->order);
 }
+
+/*
+ * Repeatedly move tasks (including one queued twice) around the queue and
+ * check the queue is still ordered by wakeTime.
+ */
+TEST_F(FutureQueueTest, manyUpdates) {
+    const int n = 100;
+    std::vector<ExTask> tasks;
+    for (int i = 0; i < n; i++) {
+        tasks.push_back(std::make_shared<TestTask>(
+                taskable, TaskId::PendingOpsNotification, i));
+        tasks.back()->updateWaketime(std::chrono::steady_clock::time_point(
+                std::chrono::nanoseconds(i)));
+        queue.push(tasks.back());
+    }
+    queue.push(tasks[0]);
+
+    for (int i = 0; i < n * 10; i++) {
+        const auto newtime = std::chrono::nanoseconds((i * 7919) % 1000);
+        EXPECT_TRUE(queue.updateWaketime(
+                tasks[(i * 31) % n],
+                std::chrono::steady_clock::time_point(newtime)));
+    }
+    queue.assertInvariants();
+    EXPECT_EQ(size_t(n + 1), queue.size());
+
+    ExTask lastTask;
+    while (!queue.empty()) {
+        if (lastTask) {
+            EXPECT_LE(lastTask->getWaketime(), queue.top()->getWaketime());
+        }
+        lastTask = queue.top();
+        queue.pop();
+    }
+}
@@ -25,6 +25,7 @@
 #include "stored_value_factories.h"
 #include "tests/module_tests/test_helpers.h"
 #include "threadtests.h"
+#include "value_tier.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -34,6 +35,8 @@
 #include <algorithm>
 #include <limits>
 #include <string>
+#include <thread>
+#include <unordered_map>
 
 EPStats global_stats;
 
@@ -248,6 +251,380 @@ TEST_F(HashTableTest, Resize) {
     verifyFound(h, keys);
 }
 
+// reserve() sizes the table for the given number of items, and never shrinks
+// it.
+TEST_F(HashTableTest, Reserve) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+
+    h.reserve(10000);
+    const auto reserved = h.getSize();
+    EXPECT_GE(reserved, 6143);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+    verifyFound(h, keys);
+
+    h.reserve(1);
+    EXPECT_EQ(reserved, h.getSize());
+    verifyFound(h, keys);
+}
+
+// The removed CAS summary bounds the CAS of the keys evicted, deleted or
+// cleared from the HashTable, and only grows.
+TEST_F(HashTableTest, RemovedCasSummary) {
+    HashTable h(global_stats, makeFactory(), 5, 1);
+    auto key = makeStoredDocKey("key");
+    EXPECT_EQ(std::numeric_limits<uint64_t>::max(), h.getRemovedCasBound(key));
+
+    h.enableRemovedCasSummary(1, 100);
+    EXPECT_EQ(100, h.getRemovedCasBound(key));
+
+    Item item(key, 0, 0, "value", strlen("value"));
+    item.setCas(200);
+    ASSERT_EQ(MutationStatus::WasClean, h.set(item));
+    EXPECT_EQ(100, h.getRemovedCasBound(key));
+    {
+        auto res = h.findForWrite(key);
+        ASSERT_TRUE(res.storedValue);
+        res.storedValue->markClean();
+        EXPECT_TRUE(h.unlocked_ejectItem(
+                res.lock, res.storedValue, FULL_EVICTION));
+    }
+    EXPECT_EQ(200, h.getRemovedCasBound(key));
+
+    item.setCas(150);
+    ASSERT_EQ(MutationStatus::WasClean, h.set(item));
+    {
+        auto res = h.findForWrite(key);
+        h.unlocked_del(res.lock, key);
+    }
+    EXPECT_EQ(200, h.getRemovedCasBound(key));
+
+    item.setCas(300);
+    ASSERT_EQ(MutationStatus::WasClean, h.set(item));
+    h.clear();
+    EXPECT_EQ(300, h.getRemovedCasBound(key));
+
+    store(h, makeStoredDocKey("other"));
+    EXPECT_THROW(h.enableRemovedCasSummary(1, 0), std::logic_error);
+}
+
+// Check that lookups in a Grouped HashTable find all items, including those
+// beyond the BucketGroup of deep chains.
+TEST_F(HashTableTest, SingleChainFind) {
+    // All keys share a single chain; lookups must still find each key (and
+    // not find absent keys) when skipping links by tag.
+    // (OrderedStoredValues, as they can be replaced by a copy.)
+    HashTable h(global_stats, makeFactory(true), 1, 1);
+    auto keys = generateKeys(100);
+    storeMany(h, keys);
+    verifyFound(h, keys);
+
+    for (const auto& key : generateKeys(100, 100)) {
+        EXPECT_FALSE(h.findForRead(key).storedValue);
+    }
+
+    // Links are re-tagged when a StoredValue is replaced by a copy.
+    {
+        auto res = h.findForWrite(keys[50]);
+        ASSERT_TRUE(res.storedValue);
+        auto copied = h.unlocked_replaceByCopy(res.lock, *res.storedValue);
+        EXPECT_NE(res.storedValue, copied.first);
+    }
+    verifyFound(h, keys);
+}
+
+TEST_F(HashTableTest, GroupedFind) {
+    HashTable h(global_stats, makeFactory(), 5, 1, HashTable::Layout::Grouped);
+    ASSERT_EQ(HashTable::Layout::Grouped, h.getLayout());
+    testFind(h);
+}
+
+// Check that the BucketGroups are kept in sync as items are removed from
+// the middle and head of chains, and across a resize.
+TEST_F(HashTableTest, GroupedDeleteAndResize) {
+    size_t initialSize = global_stats.getCurrentSize();
+    HashTable h(global_stats, makeFactory(), 5, 3, HashTable::Layout::Grouped);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+    verifyFound(h, keys);
+
+    // Delete every other key; the remainder must still be found.
+    std::vector<StoredDocKey> remaining;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2) {
+            ASSERT_TRUE(del(h, keys[i]));
+            EXPECT_FALSE(h.findForRead(keys[i]).storedValue);
+        } else {
+            remaining.push_back(keys[i]);
+        }
+    }
+    verifyFound(h, remaining);
+
+    h.resize(769);
+    EXPECT_EQ(769, h.getSize());
+    verifyFound(h, remaining);
+
+    for (const auto& key : remaining) {
+        del(h, key);
+    }
+    EXPECT_EQ(0, count(h));
+    EXPECT_EQ(initialSize, global_stats.getCurrentSize());
+}
+
+// Check that a Grouped HashTable returns the correct item when both a
+// Pending and Committed item exist for a key.
+TEST_F(HashTableTest, GroupedPendingAndCommitted) {
+    HashTable h(global_stats, makeFactory(), 2, 1, HashTable::Layout::Grouped);
+    auto key = makeStoredDocKey("key");
+    store(h, key);
+
+    auto pending = makePendingItem(key, "pending");
+    ASSERT_EQ(MutationStatus::WasClean, h.set(pending));
+
+    auto* readSv = h.findForRead(key).storedValue;
+    ASSERT_TRUE(readSv);
+    EXPECT_EQ(CommittedState::Committed, readSv->getCommitted());
+
+    auto* writeSv = h.findForWrite(key).storedValue;
+    ASSERT_TRUE(writeSv);
+    EXPECT_EQ(CommittedState::Pending, writeSv->getCommitted());
+}
+
+TEST_F(HashTableTest, LayoutFromString) {
+    EXPECT_EQ(HashTable::Layout::Chained,
+              HashTable::layoutFromString("chained"));
+    EXPECT_EQ(HashTable::Layout::Grouped,
+              HashTable::layoutFromString("grouped"));
+    EXPECT_THROW(HashTable::layoutFromString("open"), std::invalid_argument);
+}
+
+TEST_F(HashTableTest, IncrementalResize) {
+    size_t initialSize = global_stats.getCurrentSize();
+    HashTable h(global_stats, makeFactory(), 6, 3);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    // New size is rounded up to a multiple of the number of locks.
+    ASSERT_TRUE(h.startIncrementalResize(769));
+    EXPECT_TRUE(h.isResizing());
+    EXPECT_EQ(771, h.getSize());
+    EXPECT_FALSE(h.startIncrementalResize(1000));
+
+    // Migrate some, but not all of the old buckets; all keys must still be
+    // visible, whichever table they currently live in.
+    ASSERT_TRUE(h.incrementalResizeStep(1));
+    ASSERT_TRUE(h.isResizing());
+    verifyFound(h, keys);
+    EXPECT_EQ(keys.size(), count(h));
+
+    // Mutations mid-resize.
+    auto extra = generateKeys(100, keys.size());
+    storeMany(h, extra);
+    for (const auto& key : keys) {
+        ASSERT_TRUE(del(h, key));
+    }
+    ASSERT_TRUE(h.isResizing());
+    verifyFound(h, extra);
+    EXPECT_EQ(extra.size(), count(h));
+
+    while (h.isResizing()) {
+        ASSERT_TRUE(h.incrementalResizeStep(1));
+    }
+    EXPECT_EQ(771, h.getSize());
+    EXPECT_EQ(1, h.getNumResizes());
+    verifyFound(h, extra);
+    EXPECT_EQ(extra.size(), count(h));
+
+    h.clear();
+    EXPECT_EQ(initialSize, global_stats.getCurrentSize());
+}
+
+TEST_F(HashTableTest, IncrementalResizeUnaligned) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+
+    auto keys = generateKeys(100);
+    storeMany(h, keys);
+
+    // Current size isn't a multiple of the number of locks - falls back to
+    // a blocking resize.
+    EXPECT_FALSE(h.startIncrementalResize(769));
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(771, h.getSize());
+    verifyFound(h, keys);
+
+    // After which it can be resized incrementally.
+    EXPECT_TRUE(h.startIncrementalResize(48));
+    while (h.isResizing()) {
+        ASSERT_TRUE(h.incrementalResizeStep(1024));
+    }
+    EXPECT_EQ(48, h.getSize());
+    verifyFound(h, keys);
+}
+
+TEST_F(HashTableTest, IncrementalResizeClear) {
+    size_t initialSize = global_stats.getCurrentSize();
+    HashTable h(global_stats, makeFactory(), 6, 3, HashTable::Layout::Grouped);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+    ASSERT_TRUE(h.startIncrementalResize(771));
+    ASSERT_TRUE(h.incrementalResizeStep(10));
+    verifyFound(h, keys);
+
+    // Clearing completes the resize.
+    h.clear();
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(0, count(h));
+    EXPECT_EQ(initialSize, global_stats.getCurrentSize());
+}
+
+// A table being destroyed can be released in chunks, freeing at most the
+// requested number of items per step.
+TEST_F(HashTableTest, ReleaseItemsInChunks) {
+    size_t initialSize = global_stats.getCurrentSize();
+    HashTable h(global_stats, makeFactory(), 5, 3, HashTable::Layout::Grouped);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    size_t steps = 0;
+    size_t freed = 0;
+    for (;;) {
+        const auto released = h.releaseItems(100);
+        freed += released.second;
+        ++steps;
+        if (!released.first) {
+            break;
+        }
+        ASSERT_LT(steps, 20) << "releaseItems never completed";
+    }
+    EXPECT_GE(steps, 10);
+    EXPECT_GT(freed, 0);
+    EXPECT_EQ(0, h.getNumItems());
+    EXPECT_EQ(initialSize, global_stats.getCurrentSize());
+}
+
+#ifdef __linux__
+// A value moved to the value tier is read from it unchanged, and isn't
+// compressed (which would move it back to the heap).
+TEST_F(HashTableTest, MoveToTier) {
+    std::unique_ptr<ValueTier, ValueTier::Release> tier(
+            new ValueTier(64 * 1024, "", -1));
+    HashTable h(global_stats, makeFactory(), 5, 1);
+
+    auto key = makeStoredDocKey("key");
+    const std::string value(512, 'v');
+    Item item(key, 0, 0, value.data(), value.size());
+    ASSERT_EQ(MutationStatus::WasClean, h.set(item));
+    {
+        auto res = h.findForWrite(key);
+        ASSERT_TRUE(res.storedValue);
+        ASSERT_TRUE(h.unlocked_moveToTier(res.lock, *res.storedValue, *tier));
+        EXPECT_TRUE(res.storedValue->getValue()->isTiered());
+        EXPECT_EQ(value, res.storedValue->getValue()->to_s());
+        EXPECT_FALSE(res.storedValue->isCompressible());
+    }
+    EXPECT_EQ(1, tier->getNumAllocations());
+
+    // Overwriting the value frees it from the tier.
+    ASSERT_EQ(MutationStatus::WasDirty, h.set(item));
+    EXPECT_EQ(0, tier->getNumAllocations());
+}
+#endif
+
+TEST_F(HashTableTest, SharedReadLock) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                1,
+                HashTable::Layout::Chained,
+                HashTable::ReadLockMode::Shared);
+    auto keys = generateKeys(10);
+    storeMany(h, keys);
+
+    {
+        auto first = h.findForRead(keys[0], TrackReference::No);
+        ASSERT_TRUE(first.storedValue);
+        EXPECT_TRUE(first.lock.isShared());
+
+        // With a single lock every key shares a stripe; a concurrent reader
+        // must not be blocked by the shared lock held above.
+        std::thread reader([&h, &keys]() {
+            for (const auto& key : keys) {
+                auto result = h.findForRead(key, TrackReference::No);
+                EXPECT_TRUE(result.storedValue);
+                EXPECT_TRUE(result.lock.isShared());
+            }
+        });
+        reader.join();
+
+        // A shared lock doesn't permit modifying the bucket.
+        EXPECT_THROW(h.unlocked_del(first.lock, keys[0]),
+                     std::invalid_argument);
+    }
+
+    // Tracking references modifies the StoredValue, so takes the lock
+    // exclusively.
+    auto tracked = h.findForRead(keys[0], TrackReference::Yes);
+    ASSERT_TRUE(tracked.storedValue);
+    EXPECT_FALSE(tracked.lock.isShared());
+    EXPECT_TRUE(tracked.lock.getHTLock());
+}
+
+TEST_F(HashTableTest, ExclusiveReadLock) {
+    HashTable h(global_stats, makeFactory(), 5, 1);
+    auto keys = generateKeys(1);
+    storeMany(h, keys);
+
+    auto result = h.findForRead(keys[0], TrackReference::No);
+    ASSERT_TRUE(result.storedValue);
+    EXPECT_FALSE(result.lock.isShared());
+    EXPECT_TRUE(result.lock.getHTLock());
+}
+
+// The LockVersion of a key's lock should change with every exclusive
+// acquisition, but not with shared ones.
+TEST_F(HashTableTest, LockVersion) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                1,
+                HashTable::Layout::Chained,
+                HashTable::ReadLockMode::Shared);
+    auto keys = generateKeys(2);
+    storeMany(h, keys);
+
+    const auto initial = h.getLockVersion(keys[0]);
+    EXPECT_TRUE(initial == h.getLockVersion(keys[0]));
+    // Single lock, so all keys share its version.
+    EXPECT_TRUE(initial == h.getLockVersion(keys[1]));
+
+    {
+        auto result = h.findForRead(keys[0], TrackReference::No);
+        ASSERT_TRUE(result.lock.isShared());
+    }
+    EXPECT_TRUE(initial == h.getLockVersion(keys[0]));
+
+    {
+        auto hbl = h.getLockedBucket(keys[1]);
+        const auto locked = h.getLockVersion(hbl);
+        EXPECT_FALSE(initial == locked);
+        EXPECT_TRUE(locked == h.getLockVersion(keys[0]));
+    }
+}
+
+TEST_F(HashTableTest, ReadLockModeFromString) {
+    EXPECT_EQ(HashTable::ReadLockMode::Exclusive,
+              HashTable::readLockModeFromString("exclusive"));
+    EXPECT_EQ(HashTable::ReadLockMode::Shared,
+              HashTable::readLockModeFromString("shared"));
+    EXPECT_THROW(HashTable::readLockModeFromString("optimistic"),
+                 std::invalid_argument);
+}
+
 class AccessGenerator : public Generator<bool> {
 public:
 
@@ -937,6 +1314,50 @@ TEST_F(HashTableTest, CopyDeletedItem) {
 // Check that an OSV which was deleted and then made alive again has the
 // lock expiry correctly reset (lock_expiry is stored in the same place as
 // deleted time).
+/* Test reallocating an element in HT (as done by the defragmenter) */
+TEST_F(HashTableTest, ReallocateStoredValue) {
+    for (const bool isOrdered : {false, true}) {
+        /* Setup with 2 hash buckets and 1 lock, so the items are chained */
+        HashTable ht(global_stats, makeFactory(isOrdered), 2, 1);
+
+        const int numItems = 5;
+        auto keys = generateKeys(numItems);
+        storeMany(ht, keys);
+
+        const auto memSizeBefore = ht.getItemMemory();
+        const auto metaDataMemBefore = ht.getMetadataMemory();
+        const auto cacheSizeBefore = ht.getCacheSize();
+
+        std::pair<StoredValue*, StoredValue::UniquePtr> realloc;
+        {
+            auto res = ht.findForWrite(makeStoredDocKey("2"));
+            ASSERT_TRUE(res.storedValue);
+            realloc = ht.unlocked_reallocateStoredValue(res.lock,
+                                                        *res.storedValue);
+
+            /* The copy replaced the original, which is no longer owned by
+               the HT */
+            EXPECT_EQ(res.storedValue, realloc.second.get().get());
+            EXPECT_NE(res.storedValue, realloc.first);
+            EXPECT_EQ(*realloc.second, *realloc.first);
+        }
+
+        /* All items can still be found, the reallocated one at its copy */
+        for (const auto& key : keys) {
+            auto* v = ht.findForRead(key).storedValue;
+            ASSERT_TRUE(v) << key;
+            if (key == makeStoredDocKey("2")) {
+                EXPECT_EQ(realloc.first, v);
+            }
+        }
+
+        EXPECT_EQ(numItems, ht.getNumItems());
+        EXPECT_EQ(memSizeBefore, ht.getItemMemory());
+        EXPECT_EQ(metaDataMemBefore, ht.getMetadataMemory());
+        EXPECT_EQ(cacheSizeBefore, ht.getCacheSize());
+    }
+}
+
 TEST_F(HashTableTest, LockAfterDelete) {
     /* Setup OSVFactory with 2 hash buckets and 1 lock. */
     HashTable ht(global_stats, makeFactory(true), 2, 1);
@@ -1005,6 +1426,112 @@ TEST_F(HashTableTest, PauseResumeHashBucket) {
     ht.pauseResumeVisit(mockVisitor, start);
 }
 
+// Test that the memory used by StoredValues is reported per collection as
+// they are added, changed and removed.
+TEST_F(HashTableTest, MemChangedCallback) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    std::unordered_map<CollectionID, int64_t> memUsed;
+    ht.setMemChangedCallback([&memUsed](CollectionID collection,
+                                        int64_t delta) {
+        memUsed[collection] += delta;
+    });
+
+    const CollectionID collection = 8;
+    auto key1 = makeStoredDocKey("key1");
+    auto key2 = makeStoredDocKey("key2", collection);
+    Item item1(key1, 0, 0, "value", strlen("value"));
+    Item item2(key2, 0, 0, "value", strlen("value"));
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item1));
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item2));
+    EXPECT_GT(memUsed[CollectionID::Default], 0);
+    EXPECT_EQ(memUsed[CollectionID::Default], memUsed[collection]);
+    EXPECT_EQ(ht.getItemMemory(),
+              memUsed[CollectionID::Default] + memUsed[collection]);
+
+    Item bigger(key2, 0, 0, "a larger value", strlen("a larger value"));
+    ASSERT_EQ(MutationStatus::WasDirty, ht.set(bigger));
+    EXPECT_GT(memUsed[collection], memUsed[CollectionID::Default]);
+
+    ASSERT_TRUE(del(ht, key1));
+    EXPECT_EQ(0, memUsed[CollectionID::Default]);
+
+    ht.clear();
+    EXPECT_EQ(0, memUsed[collection]);
+}
+
+TEST_F(HashTableTest, CollectionIndex) {
+    HashTable ht(global_stats, makeFactory(), 5, 3);
+    EXPECT_FALSE(ht.isCollectionIndexed());
+    EXPECT_THROW(ht.getCollectionKeys(CollectionID::Default),
+                 std::logic_error);
+    ht.enableCollectionIndex();
+    ASSERT_TRUE(ht.isCollectionIndexed());
+
+    const CollectionID collection = 8;
+    std::vector<StoredDocKey> keys;
+    for (int ii = 0; ii < 100; ++ii) {
+        const auto key = "key" + std::to_string(ii);
+        store(ht, makeStoredDocKey(key));
+        if (ii % 10 == 0) {
+            keys.push_back(makeStoredDocKey(key, collection));
+            store(ht, keys.back());
+        }
+    }
+
+    auto sorted = [](std::vector<StoredDocKey> keys) {
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    };
+    EXPECT_EQ(100, ht.getCollectionKeys(CollectionID::Default).size());
+    EXPECT_EQ(sorted(keys), sorted(ht.getCollectionKeys(collection)));
+    EXPECT_TRUE(ht.getCollectionKeys(9).empty());
+
+    // Updates don't change the index, removals do; so does resizing.
+    store(ht, keys.front());
+    ASSERT_TRUE(del(ht, keys.back()));
+    keys.pop_back();
+    ht.resize(97);
+    EXPECT_EQ(sorted(keys), sorted(ht.getCollectionKeys(collection)));
+
+    // Enabling is only allowed while the HashTable is empty.
+    EXPECT_THROW(ht.enableCollectionIndex(), std::logic_error);
+
+    ht.clear();
+    EXPECT_TRUE(ht.getCollectionKeys(CollectionID::Default).empty());
+    EXPECT_TRUE(ht.getCollectionKeys(collection).empty());
+}
+
+// Lazy decays are applied to a document's frequency count when it's next
+// accessed; a document added after a decay isn't decayed by it.
+TEST_F(HashTableTest, LazyFreqDecay) {
+    HashTable ht(global_stats, makeFactory(true), 5, 1);
+    auto oldKey = makeStoredDocKey("old");
+    auto newKey = makeStoredDocKey("new");
+    store(ht, oldKey);
+    ht.findForWrite(oldKey).storedValue->setFreqCounterValue(200);
+
+    ht.decayFreqCounters(50);
+    ht.decayFreqCounters(50);
+    store(ht, newKey);
+    ht.findForWrite(newKey).storedValue->setFreqCounterValue(200);
+
+    for (const auto& key : {oldKey, newKey}) {
+        auto result = ht.findForWrite(key);
+        ht.applyFreqDecay(*result.storedValue);
+    }
+    EXPECT_EQ(50, ht.findForWrite(oldKey).storedValue->getFreqCounterValue());
+    EXPECT_EQ(200, ht.findForWrite(newKey).storedValue->getFreqCounterValue());
+
+    // Applying again (with no new decays) changes nothing, and the epoch
+    // survives the counter being updated.
+    auto result = ht.findForWrite(oldKey);
+    ht.applyFreqDecay(*result.storedValue);
+    result.storedValue->setFreqCounterValue(60);
+    EXPECT_EQ(ht.getFreqDecayEpoch(),
+              result.storedValue->getFreqDecayEpoch());
+    EXPECT_EQ(60, result.storedValue->getFreqCounterValue());
+}
+
 // Test the itemFreqDecayerVisitor by adding 256 documents to the hash table.
 // Then set the frequency count of each document in the range 0 to 255.  We
 // then visit each document and decay it by 50%.  The test checks that the
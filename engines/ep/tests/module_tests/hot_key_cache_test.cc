@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the HotKeyCache class.
+ */
+
+#include "hot_key_cache.h"
+#include "ep_time.h"
+#include "test_helpers.h"
+
+#include <gtest/gtest.h>
+
+// A cached item should be returned while the version is unchanged.
+TEST(HotKeyCacheTest, Hit) {
+    HotKeyCache cache(16);
+    auto key = makeStoredDocKey("key");
+    cache.insert(make_item(Vbid(0), key, "value"), {1, 5});
+
+    auto item = cache.get(key, {1, 5});
+    ASSERT_TRUE(item);
+    EXPECT_EQ(key, item->getKey());
+    EXPECT_EQ("value",
+              std::string(item->getData(), item->getNBytes()));
+    EXPECT_EQ(1, cache.getHits());
+    EXPECT_EQ(0, cache.getMisses());
+}
+
+// Once the key's lock has been acquired exclusively again (or the key maps to
+// a different lock) the cached item must not be returned.
+TEST(HotKeyCacheTest, StaleVersion) {
+    HotKeyCache cache(16);
+    auto key = makeStoredDocKey("key");
+    cache.insert(make_item(Vbid(0), key, "value"), {1, 5});
+
+    EXPECT_FALSE(cache.get(key, {1, 6}));
+    EXPECT_FALSE(cache.get(key, {2, 5}));
+    EXPECT_EQ(0, cache.getHits());
+    EXPECT_EQ(2, cache.getMisses());
+}
+
+// A key sharing the slot of a cached item should miss, and replaces the
+// cached item when admitted.
+TEST(HotKeyCacheTest, SlotCollision) {
+    HotKeyCache cache(1);
+    auto keyA = makeStoredDocKey("a");
+    auto keyB = makeStoredDocKey("b");
+    cache.insert(make_item(Vbid(0), keyA, "a"), {0, 1});
+
+    EXPECT_FALSE(cache.get(keyB, {0, 1}));
+
+    cache.insert(make_item(Vbid(0), keyB, "b"), {0, 1});
+    EXPECT_FALSE(cache.get(keyA, {0, 1}));
+    EXPECT_TRUE(cache.get(keyB, {0, 1}));
+}
+
+// Expired items must be left for the normal path to expire.
+TEST(HotKeyCacheTest, Expired) {
+    HotKeyCache cache(16);
+    auto key = makeStoredDocKey("key");
+    cache.insert(make_item(Vbid(0), key, "value", ep_real_time() - 1),
+                 {0, 1});
+
+    EXPECT_FALSE(cache.get(key, {0, 1}));
+}
@@ -612,6 +612,173 @@ TEST_P(STItemPagerTest, decayByOne) {
     EXPECT_EQ(1, pv->getEjected());
 }
 
+// Test that with a sample size set the hifi_mfu pager evicts by sampling
+// random hash buckets rather than walking the whole hash table.
+TEST_P(STItemPagerTest, sampledEviction) {
+    Configuration& cfg = engine->getConfiguration();
+    if (cfg.getHtEvictionPolicy() != "hifi_mfu") {
+        return;
+    }
+    populateUntilTmpFail(vbid);
+
+    std::shared_ptr<std::atomic<bool>> available;
+    std::atomic<item_pager_phase> phase{ACTIVE_AND_PENDING_ONLY};
+    bool isEphemeral = std::get<0>(GetParam()) == "ephemeral";
+    auto pv = std::make_unique<MockPagingVisitor>(
+            *engine->getKVBucket(),
+            engine->getEpStats(),
+            1.0,
+            available,
+            ITEM_PAGER,
+            false,
+            0.5,
+            VBucketFilter(),
+            &phase,
+            isEphemeral,
+            cfg.getItemEvictionAgePercentage(),
+            cfg.getItemEvictionFreqCounterAgeThreshold(),
+            PagingVisitor::EvictionPolicy::hifi_mfu);
+    pv->setSampleSize(8);
+
+    VBucketPtr vb = store->getVBucket(vbid);
+    pv->visitBucket(vb);
+    EXPECT_GT(pv->getEjected(), 0);
+}
+
+// Test that when a pager run is split over a group of visitors, only the
+// last of them to complete finishes the run.
+TEST_P(STItemPagerTest, visitorGroupCompletesOnce) {
+    Configuration& cfg = engine->getConfiguration();
+    auto available = std::make_shared<std::atomic<bool>>(false);
+    std::atomic<item_pager_phase> phase{REPLICA_ONLY};
+    auto group = std::make_shared<PagingVisitor::Group>(2);
+    std::vector<std::unique_ptr<MockPagingVisitor>> visitors;
+    for (int ii = 0; ii < 2; ++ii) {
+        visitors.push_back(std::make_unique<MockPagingVisitor>(
+                *engine->getKVBucket(),
+                engine->getEpStats(),
+                1.0,
+                available,
+                ITEM_PAGER,
+                false,
+                0.5,
+                VBucketFilter(),
+                &phase,
+                std::get<0>(GetParam()) == "ephemeral",
+                cfg.getItemEvictionAgePercentage(),
+                cfg.getItemEvictionFreqCounterAgeThreshold(),
+                PagingVisitor::EvictionPolicy::hifi_mfu));
+        visitors.back()->setGroup(group);
+    }
+
+    visitors[0]->complete();
+    EXPECT_FALSE(*available);
+    EXPECT_EQ(REPLICA_ONLY, phase);
+
+    visitors[1]->complete();
+    EXPECT_TRUE(*available);
+    EXPECT_EQ(ACTIVE_AND_PENDING_ONLY, phase);
+}
+
+// Test that with compression before ejection enabled, the pager's first
+// pass compresses cold values in memory rather than ejecting them.
+TEST_P(STItemPagerTest, compressBeforeEject) {
+    populateUntilTmpFail(vbid);
+
+    std::shared_ptr<std::atomic<bool>> available;
+    std::atomic<item_pager_phase> phase{ACTIVE_AND_PENDING_ONLY};
+    Configuration& cfg = engine->getConfiguration();
+    bool isEphemeral = std::get<0>(GetParam()) == "ephemeral";
+    auto pv = std::make_unique<MockPagingVisitor>(
+            *engine->getKVBucket(),
+            engine->getEpStats(),
+            1.0,
+            available,
+            ITEM_PAGER,
+            false,
+            0.5,
+            VBucketFilter(),
+            &phase,
+            isEphemeral,
+            cfg.getItemEvictionAgePercentage(),
+            cfg.getItemEvictionFreqCounterAgeThreshold(),
+            PagingVisitor::EvictionPolicy::hifi_mfu);
+    pv->setCompressBeforeEject(1.2f);
+
+    auto& stats = engine->getEpStats();
+    const auto ejects = stats.numValueEjects.load();
+    VBucketPtr vb = store->getVBucket(vbid);
+    pv->visitBucket(vb);
+    EXPECT_GT(stats.numPagerCompressions, 0);
+    EXPECT_EQ(ejects, stats.numValueEjects);
+    EXPECT_EQ(0, pv->getEjected());
+}
+
+// Test that with replica_value_policy=eject the values of a replica are
+// ejected as soon as they are persisted, keeping their metadata.
+TEST_P(STItemPagerTest, replicaValuesEjectedOnPersist) {
+    if (std::get<0>(GetParam()) == "ephemeral") {
+        return;
+    }
+    engine->getConfiguration().setReplicaValuePolicy("eject");
+
+    const std::string value(512, 'x');
+    const int count = 10;
+    for (int ii = 0; ii < count; ii++) {
+        auto key = makeStoredDocKey("key_" + std::to_string(ii));
+        auto item = make_item(vbid, key, value);
+        ASSERT_EQ(ENGINE_SUCCESS, storeItem(item));
+    }
+    store->setVBucketState(vbid, vbucket_state_replica, false);
+
+    flushVBucketToDiskIfPersistent(vbid, count);
+    auto vb = store->getVBucket(vbid);
+    EXPECT_EQ(count, engine->getEpStats().numReplicaPersistEjects);
+    EXPECT_EQ(count, vb->getNumNonResidentItems());
+    EXPECT_EQ(count, vb->ht.getNumItems());
+}
+
+// Test that a visitor ejecting replica values visits replicas before other
+// vBuckets, and ejects all of their values.
+TEST_P(STItemPagerTest, replicaValuesEjectedFirst) {
+    if (std::get<0>(GetParam()) == "ephemeral") {
+        return;
+    }
+    const Vbid replicaVB = Vbid(1);
+    store->setVBucketState(replicaVB, vbucket_state_active, false);
+    auto count = populateUntilTmpFail(replicaVB);
+    store->setVBucketState(replicaVB, vbucket_state_replica, false);
+
+    std::shared_ptr<std::atomic<bool>> available;
+    std::atomic<item_pager_phase> phase{REPLICA_ONLY};
+    Configuration& cfg = engine->getConfiguration();
+    auto pv = std::make_unique<MockPagingVisitor>(
+            *engine->getKVBucket(),
+            engine->getEpStats(),
+            0.1,
+            available,
+            ITEM_PAGER,
+            false,
+            0.5,
+            VBucketFilter(),
+            &phase,
+            false,
+            cfg.getItemEvictionAgePercentage(),
+            cfg.getItemEvictionFreqCounterAgeThreshold(),
+            PagingVisitor::EvictionPolicy::hifi_mfu);
+    pv->setEjectReplicaValues();
+
+    auto comparator = pv->getVBucketComparator();
+    ASSERT_TRUE(comparator);
+    EXPECT_TRUE(comparator(replicaVB, vbid));
+    EXPECT_FALSE(comparator(vbid, replicaVB));
+
+    VBucketPtr vb = store->getVBucket(replicaVB);
+    pv->visitBucket(vb);
+    EXPECT_EQ(count, pv->getEjected());
+    EXPECT_EQ(count, vb->getNumNonResidentItems());
+}
+
 /**
  * MB-29333:  Test that if a vbucket contains a single document with an
  * execution frequency of Item::initialFreqCount, but the document
@@ -0,0 +1,59 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the ItemPool class.
+ */
+
+#include "item_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <new>
+
+// An empty pool has no blocks to allocate.
+TEST(ItemPoolTest, EmptyAllocate) {
+    ItemPool pool;
+    EXPECT_EQ(nullptr, pool.allocate());
+    EXPECT_EQ(0, pool.size());
+}
+
+// Freed blocks are cached (up to BlocksPerCore per core), and returned to
+// the heap by the destructor.
+TEST(ItemPoolTest, DeallocateCaches) {
+    ItemPool pool;
+    for (size_t ii = 0; ii < ItemPool::BlocksPerCore; ++ii) {
+        EXPECT_TRUE(pool.deallocate(::operator new(64)));
+    }
+    EXPECT_EQ(ItemPool::BlocksPerCore, pool.size());
+}
+
+// A cached block is allocated again (from the same core).
+TEST(ItemPoolTest, Reuse) {
+    ItemPool pool;
+    void* block = ::operator new(64);
+    ASSERT_TRUE(pool.deallocate(block));
+    ASSERT_EQ(1, pool.size());
+
+    // The thread may have moved to another core since freeing the block.
+    void* allocated = pool.allocate();
+    if (allocated) {
+        EXPECT_EQ(block, allocated);
+        EXPECT_EQ(0, pool.size());
+        ::operator delete(allocated);
+    }
+}
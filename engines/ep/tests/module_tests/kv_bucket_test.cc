@@ -48,7 +48,9 @@
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
+#include <algorithm>
 #include <chrono>
+#include <set>
 #include <thread>
 
 void KVBucketTest::SetUp() {
@@ -231,7 +233,8 @@ bool KVBucketTest::isItemFreqDecayerTaskSnoozed() const {
 void KVBucketTest::runBGFetcherTask() {
     MockGlobalTask mockTask(engine->getTaskable(),
                             TaskId::MultiBGFetcherTask);
-    store->getVBucket(vbid)->getShard()->getBgFetcher()->run(&mockTask);
+    store->getVBucket(vbid)->getShard()->getBgFetcherForVBucket(vbid)->run(
+            &mockTask);
 }
 
 /**
@@ -412,6 +415,64 @@ TEST_P(KVBucketParamTest, GetKeyStatsNMVB) {
                                    WantsDeleted::No));
 }
 
+// Check getMulti returns results in key order, with keys which cannot be
+// served immediately reported as EWOULDBLOCK.
+TEST_P(KVBucketParamTest, GetMulti) {
+    auto key1 = makeStoredDocKey("key1");
+    auto key2 = makeStoredDocKey("key2");
+    auto missing = makeStoredDocKey("missing");
+    store_item(vbid, key1, "value1");
+    store_item(vbid, key2, "value2");
+
+    const std::vector<std::pair<DocKey, Vbid>> keys{
+            {key2, vbid},
+            {key1, Vbid(vbid.get() + 1)},
+            {missing, vbid},
+            {key1, vbid}};
+    auto result = store->getMulti(keys, cookie, HONOR_STATES);
+    ASSERT_EQ(keys.size(), result.size());
+
+    ASSERT_EQ(ENGINE_SUCCESS, result[0].getStatus());
+    EXPECT_EQ("value2", result[0].item->getValue()->to_s());
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, result[1].getStatus());
+    EXPECT_EQ(ENGINE_KEY_ENOENT, result[2].getStatus());
+    ASSERT_EQ(ENGINE_SUCCESS, result[3].getStatus());
+    EXPECT_EQ("value1", result[3].item->getValue()->to_s());
+
+    // Keys in a non-active vBucket are left for get() to handle.
+    store->setVBucketState(vbid, vbucket_state_pending, false);
+    result = store->getMulti(keys, cookie, HONOR_STATES);
+    for (const auto& gv : result) {
+        EXPECT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+    }
+}
+
+// The engine records the time taken by the phases of a mutation in the trace
+// of the request.
+TEST_P(KVBucketParamTest, SetTraceSpans) {
+    auto& traceable = mock_get_traceable(cookie);
+    traceable.setTracingEnabled(true);
+    traceable.getTracer().clear();
+
+    auto item = make_item(vbid, makeStoredDocKey("key"), "value");
+    EXPECT_EQ(ENGINE_SUCCESS, store->set(item, cookie));
+
+    std::vector<cb::tracing::TraceCode> codes;
+    for (const auto& span : traceable.getTracer().getDurations()) {
+        EXPECT_NE(cb::tracing::Span::Duration::max(), span.duration);
+        codes.push_back(span.code);
+    }
+    EXPECT_NE(codes.end(),
+              std::find(codes.begin(),
+                        codes.end(),
+                        cb::tracing::TraceCode::HASH_LOCK));
+    EXPECT_NE(codes.end(),
+              std::find(codes.begin(),
+                        codes.end(),
+                        cb::tracing::TraceCode::QUEUE_DIRTY));
+    traceable.setTracingEnabled(false);
+}
+
 // Replace tests //////////////////////////////////////////////////////////////
 
 // Test replace against a non-existent key.
@@ -445,6 +506,86 @@ TEST_P(KVBucketParamTest, ReplacePendingVB) {
     EXPECT_EQ(ENGINE_EWOULDBLOCK, store->replace(item, cookie));
 }
 
+// MutateInPlace tests ////////////////////////////////////////////////////////
+
+// The mutator is given the current version of the document, and what it
+// returns replaces it.
+TEST_P(KVBucketParamTest, MutateInPlace) {
+    auto key = makeStoredDocKey("key");
+    auto stored = store_item(vbid, key, "value");
+
+    auto updated = make_item(vbid, key, "value2");
+    uint64_t cas = 0;
+    EXPECT_EQ(ENGINE_SUCCESS,
+              store->mutateInPlace(
+                      key,
+                      vbid,
+                      cookie,
+                      [&updated, &stored](cb::unique_item_ptr current) {
+                          EXPECT_TRUE(current);
+                          auto& item = *static_cast<Item*>(current.get());
+                          EXPECT_EQ("value", item.getValue()->to_s());
+                          EXPECT_EQ(stored.getCas(), item.getCas());
+                          return std::make_pair(cb::engine_errc::success,
+                                                static_cast<::item*>(&updated));
+                      },
+                      cas));
+    EXPECT_NE(0, cas);
+    EXPECT_EQ(cas, updated.getCas());
+
+    auto gv = store->get(key, vbid, cookie, QUEUE_BG_FETCH);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value2", gv.item->getValue()->to_s());
+    EXPECT_EQ(cas, gv.item->getCas());
+}
+
+// A missing document is passed as nullptr; returning no item (or an error)
+// leaves the document as it is.
+TEST_P(KVBucketParamTest, MutateInPlaceUnchanged) {
+    auto key = makeStoredDocKey("key");
+    uint64_t cas = 0;
+    EXPECT_EQ(ENGINE_SUCCESS,
+              store->mutateInPlace(key,
+                                   vbid,
+                                   cookie,
+                                   [](cb::unique_item_ptr current) {
+                                       EXPECT_FALSE(current);
+                                       return std::make_pair(
+                                               cb::engine_errc::success,
+                                               static_cast<item*>(nullptr));
+                                   },
+                                   cas));
+    EXPECT_EQ(0, cas);
+
+    store_item(vbid, key, "value");
+    auto failing = [](cb::unique_item_ptr current) {
+        EXPECT_TRUE(current);
+        return std::make_pair(cb::engine_errc::key_already_exists,
+                              static_cast<item*>(nullptr));
+    };
+    EXPECT_EQ(ENGINE_KEY_EEXISTS,
+              store->mutateInPlace(key, vbid, cookie, failing, cas));
+    auto gv = store->get(key, vbid, cookie, QUEUE_BG_FETCH);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value", gv.item->getValue()->to_s());
+}
+
+// Check incorrect vbucket returns not-my-vbucket, without calling the mutator.
+TEST_P(KVBucketParamTest, MutateInPlaceNMVB) {
+    uint64_t cas = 0;
+    EXPECT_EQ(ENGINE_NOT_MY_VBUCKET,
+              store->mutateInPlace(makeStoredDocKey("key"),
+                                   Vbid(vbid.get() + 1),
+                                   cookie,
+                                   [](cb::unique_item_ptr) {
+                                       ADD_FAILURE() << "mutator called";
+                                       return std::make_pair(
+                                               cb::engine_errc::success,
+                                               static_cast<item*>(nullptr));
+                                   },
+                                   cas));
+}
+
 // Set tests //////////////////////////////////////////////////////////////////
 
 // Test CAS set against a non-existent key
@@ -1286,6 +1427,27 @@ TEST_P(KVBucketParamTest, MB31495_GetRandomKey) {
     EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus());
 }
 
+// getRandomKeys returns distinct values, up to the number asked for
+TEST_P(KVBucketParamTest, GetRandomKeys) {
+    EXPECT_TRUE(store->getRandomKeys(10).empty());
+
+    for (int ii = 0; ii < 5; ++ii) {
+        store_item(vbid, makeStoredDocKey("key" + std::to_string(ii)), "value");
+    }
+
+    auto values = store->getRandomKeys(3);
+    EXPECT_EQ(3, values.size());
+
+    values = store->getRandomKeys(10);
+    ASSERT_EQ(5, values.size());
+    std::set<std::string> keys;
+    for (const auto& gv : values) {
+        EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus());
+        keys.insert(gv.item->getKey().to_string());
+    }
+    EXPECT_EQ(5, keys.size());
+}
+
 class StoreIfTest : public KVBucketTest {
 public:
     void SetUp() override {
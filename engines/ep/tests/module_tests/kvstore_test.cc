@@ -27,6 +27,9 @@
 #ifdef EP_USE_ROCKSDB
 #include "rocksdb-kvstore/rocksdb-kvstore_config.h"
 #endif
+#ifdef EP_USE_MAGMA
+#include "magma-kvstore/magma-kvstore_config.h"
+#endif
 #include "collections/collection_persisted_stats.h"
 #include "src/internal.h"
 #include "tests/module_tests/test_helpers.h"
@@ -295,6 +298,111 @@ TEST_F(CouchKVStoreTest, CompressedTest) {
     kvstore->destroyScanContext(scanCtx);
 }
 
+// A ByKey scan returns the items in key order, and resumes from the item it
+// paused on.
+TEST_F(CouchKVStoreTest, ScanByKey) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+    ASSERT_TRUE(kvstore->supportsKeyOrderScan());
+
+    // Keys are written in the reverse of their key order.
+    kvstore->begin(std::make_unique<TransactionContext>());
+    WriteCallback wc;
+    for (int i = 1; i <= 5; i++) {
+        std::string key("key" + std::to_string(6 - i));
+        Item item(makeStoredDocKey(key),
+                  0,
+                  0,
+                  "value",
+                  5,
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0,
+                  i);
+        kvstore->set(item, wc);
+    }
+    kvstore->commit(flush);
+
+    class KeyCallback : public StatusCallback<GetValue> {
+    public:
+        void callback(GetValue& result) override {
+            if (keys.size() == 2 && !paused) {
+                paused = true;
+                setStatus(ENGINE_ENOMEM);
+                return;
+            }
+            setStatus(ENGINE_SUCCESS);
+            keys.emplace_back(result.item->getKey());
+        }
+
+        std::vector<StoredDocKey> keys;
+        bool paused = false;
+    };
+
+    auto cb = std::make_shared<KeyCallback>();
+    auto cl = std::make_shared<KVStoreTestCacheCallback>(1, 5, Vbid(0));
+    ScanContext* scanCtx = kvstore->initScanContext(cb,
+                                                    cl,
+                                                    Vbid(0),
+                                                    1,
+                                                    DocumentFilter::ALL_ITEMS,
+                                                    ValueFilter::KEYS_ONLY);
+    ASSERT_NE(nullptr, scanCtx);
+    scanCtx->order = ScanOrder::ByKey;
+
+    EXPECT_EQ(scan_again, kvstore->scan(scanCtx));
+    EXPECT_EQ(2, cb->keys.size());
+    EXPECT_EQ(scan_success, kvstore->scan(scanCtx));
+    kvstore->destroyScanContext(scanCtx);
+
+    ASSERT_EQ(5, cb->keys.size());
+    for (int i = 1; i <= 5; i++) {
+        EXPECT_EQ(makeStoredDocKey("key" + std::to_string(i)),
+                  cb->keys[i - 1]);
+    }
+}
+
+// getAllKeys stops as soon as the callback sets a status.
+TEST_F(CouchKVStoreTest, GetAllKeysStops) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+
+    kvstore->begin(std::make_unique<TransactionContext>());
+    WriteCallback wc;
+    for (int i = 1; i <= 5; i++) {
+        Item item(makeStoredDocKey("key" + std::to_string(i)),
+                  0,
+                  0,
+                  "value",
+                  5,
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0,
+                  i);
+        kvstore->set(item, wc);
+    }
+    kvstore->commit(flush);
+
+    class KeyCallback : public StatusCallback<const DocKey&> {
+    public:
+        void callback(const DocKey& key) override {
+            keys.emplace_back(key);
+            if (keys.size() == 3) {
+                setStatus(ENGINE_ENOMEM);
+            }
+        }
+
+        std::vector<StoredDocKey> keys;
+    };
+
+    auto cb = std::make_shared<KeyCallback>();
+    EXPECT_EQ(ENGINE_SUCCESS,
+              kvstore->getAllKeys(Vbid(0), makeStoredDocKey("key2"), 10, cb));
+    ASSERT_EQ(3, cb->keys.size());
+    EXPECT_EQ(makeStoredDocKey("key2"), cb->keys[0]);
+    EXPECT_EQ(makeStoredDocKey("key4"), cb->keys[2]);
+}
+
 // Verify the stats returned from operations are accurate.
 TEST_F(CouchKVStoreTest, StatsTest) {
     KVStoreConfig config(
@@ -418,6 +526,169 @@ TEST_F(CouchKVStoreTest, MB_18580_ENOENT) {
     EXPECT_THROW(kvstore.ro->getDbFileInfo(Vbid(0)), std::system_error);
 }
 
+// getMulti reads documents in file order rather than key order; check each
+// fetch still gets its own document when the two orders differ.
+TEST_F(CouchKVStoreTest, GetMultiOutOfKeyOrder) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+
+    // Commit keys in descending order, one commit each, so later keys in
+    // key order are earlier in the file.
+    WriteCallback wc;
+    for (int i = 5; i >= 1; i--) {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        const std::string value = "value" + std::to_string(i);
+        Item item(makeStoredDocKey("key" + std::to_string(i)),
+                  0,
+                  0,
+                  value.c_str(),
+                  value.size());
+        kvstore->set(item, wc);
+        ASSERT_TRUE(kvstore->commit(flush));
+    }
+
+    vb_bgfetch_queue_t itms;
+    for (int i = 1; i <= 5; i++) {
+        vb_bgfetch_item_ctx_t ctx;
+        ctx.isMetaOnly = GetMetaOnly::No;
+        itms[makeStoredDocKey("key" + std::to_string(i))] = std::move(ctx);
+    }
+    kvstore->getMulti(Vbid(0), itms);
+
+    for (int i = 1; i <= 5; i++) {
+        auto& fetched = itms[makeStoredDocKey("key" + std::to_string(i))];
+        ASSERT_EQ(ENGINE_SUCCESS, fetched.value.getStatus());
+        ASSERT_TRUE(fetched.value.item);
+        EXPECT_EQ("value" + std::to_string(i),
+                  fetched.value.item->getValue()->to_s());
+    }
+}
+
+// With the read handle cache enabled, bgfetches reuse the vBucket's open
+// file until a commit changes it.
+TEST_F(CouchKVStoreTest, GetMultiReusesReadHandle) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    config.setReadHandleCacheEnabled(true);
+    auto kvstore = setup_kv_store(config);
+    auto& st = kvstore->getKVStoreStat();
+
+    WriteCallback wc;
+    auto store = [this, &kvstore, &wc](const std::string& value) {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        Item item(makeStoredDocKey("key"), 0, 0, value.c_str(), value.size());
+        kvstore->set(item, wc);
+        ASSERT_TRUE(kvstore->commit(flush));
+    };
+    auto fetch = [&kvstore]() {
+        vb_bgfetch_queue_t itms;
+        const auto key = makeStoredDocKey("key");
+        itms[key].isMetaOnly = GetMetaOnly::No;
+        kvstore->getMulti(Vbid(0), itms);
+        EXPECT_EQ(ENGINE_SUCCESS, itms[key].value.getStatus());
+        return itms[key].value.item ? itms[key].value.item->getValue()->to_s()
+                                    : std::string();
+    };
+
+    store("value1");
+    const size_t opens = st.numOpen;
+    EXPECT_EQ("value1", fetch());
+    EXPECT_EQ(opens + 1, st.numOpen);
+    EXPECT_EQ("value1", fetch());
+    EXPECT_EQ(opens + 1, st.numOpen);
+
+    // The cached handle wouldn't see the new value, so must be reopened.
+    store("value2");
+    const size_t opensAfterCommit = st.numOpen;
+    EXPECT_EQ("value2", fetch());
+    EXPECT_EQ(opensAfterCommit + 1, st.numOpen);
+}
+
+ * passes for each changed key.
+ */
+class RecordingRBCallback : public RollbackCB {
+public:
+    void callback(GetValue& val) override {
+        FAIL() << "rollback should pass the key's state at the rollback point";
+    }
+
+    void rollbackKey(GetValue& postRbSeqno, GetValue& preRbSeqno) override {
+        ASSERT_TRUE(postRbSeqno.item);
+        const StoredDocKey key(postRbSeqno.item->getKey());
+        postDeleted[key] = postRbSeqno.item->isDeleted();
+        preStatus[key] = preRbSeqno.getStatus();
+        if (preRbSeqno.getStatus() == ENGINE_SUCCESS) {
+            preValue[key] = preRbSeqno.item->getValue()->to_s();
+        }
+    }
+
+    std::unordered_map<StoredDocKey, bool> postDeleted;
+    std::unordered_map<StoredDocKey, ENGINE_ERROR_CODE> preStatus;
+    std::unordered_map<StoredDocKey, std::string> preValue;
+};
+
+// Rollback should pass every key changed since the rollback point to the
+// callback, along with the key's state at the rollback point.
+TEST_F(CouchKVStoreTest, RollbackPassesPreRollbackState) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+
+    WriteCallback wc;
+    DeleteCallback dc;
+    auto store = [this, &kvstore, &wc](const std::string& key,
+                                       const std::string& value,
+                                       int64_t seqno) {
+        Item item(makeStoredDocKey(key),
+                  0,
+                  0,
+                  value.c_str(),
+                  value.size(),
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0,
+                  seqno);
+        kvstore->begin(std::make_unique<TransactionContext>());
+        kvstore->set(item, wc);
+        return kvstore->commit(flush);
+    };
+    for (int i = 1; i <= 10; i++) {
+        ASSERT_TRUE(store("key" + std::to_string(i), "value", i));
+    }
+
+    // After the rollback point, update one key, delete one and add one.
+    ASSERT_TRUE(store("key1", "updated", 11));
+    Item deleted(makeStoredDocKey("key2"),
+                 0,
+                 0,
+                 nullptr,
+                 0,
+                 PROTOCOL_BINARY_RAW_BYTES,
+                 0,
+                 12);
+    deleted.setDeleted();
+    kvstore->begin(std::make_unique<TransactionContext>());
+    kvstore->del(deleted, dc);
+    ASSERT_TRUE(kvstore->commit(flush));
+    ASSERT_TRUE(store("key11", "value", 13));
+
+    auto rcb = std::make_shared<RecordingRBCallback>();
+    auto result = kvstore->rollback(Vbid(0), 10, rcb);
+    ASSERT_TRUE(result.success);
+    EXPECT_EQ(10, result.highSeqno);
+
+    // Only the keys changed since seqno 10 are rolled back (the scan
+    // starts after the rollback header).
+    EXPECT_EQ(3, rcb->preStatus.size());
+    EXPECT_EQ(ENGINE_SUCCESS, rcb->preStatus[makeStoredDocKey("key1")]);
+    EXPECT_EQ("value", rcb->preValue[makeStoredDocKey("key1")]);
+    EXPECT_FALSE(rcb->postDeleted[makeStoredDocKey("key1")]);
+    EXPECT_EQ(ENGINE_SUCCESS, rcb->preStatus[makeStoredDocKey("key2")]);
+    EXPECT_EQ("value", rcb->preValue[makeStoredDocKey("key2")]);
+    EXPECT_TRUE(rcb->postDeleted[makeStoredDocKey("key2")]);
+    EXPECT_EQ(ENGINE_KEY_ENOENT, rcb->preStatus[makeStoredDocKey("key11")]);
+}
+
 class CollectionsOfflineUpgadeCallback : public StatusCallback<CacheLookup> {
 public:
     CollectionsOfflineUpgadeCallback(CollectionID cid) : expectedCid(cid) {
@@ -500,6 +771,27 @@ TEST_F(CouchKVStoreTest, CollectionsOfflineUpgade) {
     EXPECT_EQ(keys, stats.highSeqno);
 }
 
+// The stats of all collections are persisted as one document, which must
+// decode to what was encoded.
+TEST(CollectionsPersistedStatsTest, EncodeDecode) {
+    Collections::VB::PersistedStatsMap stats;
+    stats[CollectionID::Default] = {10, 1000};
+    stats[CollectionID(8)] = {0, 0};
+    stats[CollectionID(0xffffffff)] = {std::numeric_limits<uint64_t>::max(),
+                                       123456789};
+
+    auto encoded = Collections::VB::encodePersistedStats(stats);
+    auto decoded =
+            Collections::VB::decodePersistedStats(encoded.data(), encoded.size());
+    ASSERT_EQ(stats.size(), decoded.size());
+    for (const auto& entry : stats) {
+        EXPECT_EQ(entry.second.itemCount, decoded[entry.first].itemCount);
+        EXPECT_EQ(entry.second.highSeqno, decoded[entry.first].highSeqno);
+    }
+
+    EXPECT_TRUE(Collections::VB::decodePersistedStats(nullptr, 0).empty());
+}
+
 /**
  * The CouchKVStoreErrorInjectionTest cases utilise GoogleMock to inject
  * errors into couchstore as if they come from the filesystem in order
@@ -1391,7 +1683,12 @@ public:
                      uint64_t rev,
                      MutationRequestCallback& cb,
                      bool del)
-        : CouchRequest(it, rev, cb, del, false /*persist namespace*/) {
+        : CouchRequest(it,
+                       rev,
+                       cb,
+                       del,
+                       false /*persist namespace*/,
+                       false /*compact metadata*/) {
     }
 
     ~MockCouchRequest() {}
@@ -2095,6 +2392,67 @@ TEST_F(CouchKVStoreMetaData, assignment) {
     EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, copy2->getDataType());
 }
 
+//
+// Test that V3 (compact) metadata decodes to what was encoded, and is smaller
+// than V1 for typical values
+//
+TEST_F(CouchKVStoreMetaData, compactRoundTrip) {
+    auto metadata = MetaDataFactory::createMetaData();
+    metadata->setCas(0x15c8c1a5b0a70000ull); // a typical HLC cas
+    metadata->setExptime(0);
+    metadata->setFlags(0);
+    metadata->setDataType(PROTOCOL_BINARY_DATATYPE_JSON);
+    metadata->setDeleteSource(DeleteSource::TTL);
+
+    auto encoded = metadata->prepareAndGetCompactForPersistence();
+    EXPECT_LT(encoded.size, MetaData::getMetaDataSize(MetaData::Version::V1));
+    EXPECT_TRUE(MetaData::isCompact(encoded));
+
+    auto decoded = MetaDataFactory::createMetaData(encoded);
+    EXPECT_EQ(MetaData::Version::V3, decoded->getVersionInitialisedFrom());
+    EXPECT_EQ(0x15c8c1a5b0a70000ull, decoded->getCas());
+    EXPECT_EQ(0, decoded->getExptime());
+    EXPECT_EQ(0, decoded->getFlags());
+    EXPECT_EQ(FLEX_META_CODE, decoded->getFlexCode());
+    EXPECT_EQ(DeleteSource::TTL, decoded->getDeleteSource());
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, decoded->getDataType());
+}
+
+//
+// Test that a V3 encoding which would have the size of V0 to V2 is padded, so
+// it can't be mistaken for them
+//
+TEST_F(CouchKVStoreMetaData, compactPadded) {
+    auto metadata = MetaDataFactory::createMetaData();
+    // 1 + 9 (cas) + 5 (exptime) + 1 (flags) + 2 = 18 bytes before padding
+    metadata->setCas(0x15c8c1a5b0a70000ull);
+    metadata->setExptime(0xcafe1234);
+    metadata->setFlags(0);
+    metadata->setDataType(PROTOCOL_BINARY_RAW_BYTES);
+
+    auto encoded = metadata->prepareAndGetCompactForPersistence();
+    EXPECT_EQ(MetaData::getMetaDataSize(MetaData::Version::V2) + 1,
+              encoded.size);
+
+    auto decoded = MetaDataFactory::createMetaData(encoded);
+    EXPECT_EQ(MetaData::Version::V3, decoded->getVersionInitialisedFrom());
+    EXPECT_EQ(0x15c8c1a5b0a70000ull, decoded->getCas());
+    EXPECT_EQ(0xcafe1234, decoded->getExptime());
+    EXPECT_EQ(0, decoded->getFlags());
+    EXPECT_EQ(PROTOCOL_BINARY_RAW_BYTES, decoded->getDataType());
+
+    // The largest values encode to at most MaxCompactSize
+    metadata->setCas(std::numeric_limits<uint64_t>::max());
+    metadata->setExptime(std::numeric_limits<uint32_t>::max());
+    metadata->setFlags(std::numeric_limits<uint32_t>::max());
+    encoded = metadata->prepareAndGetCompactForPersistence();
+    EXPECT_EQ(MetaData::getMetaDataSize(MetaData::Version::V3), encoded.size);
+    decoded = MetaDataFactory::createMetaData(encoded);
+    EXPECT_EQ(std::numeric_limits<uint64_t>::max(), decoded->getCas());
+    EXPECT_EQ(std::numeric_limits<uint32_t>::max(), decoded->getExptime());
+    EXPECT_EQ(std::numeric_limits<uint32_t>::max(), decoded->getFlags());
+}
+
 class PersistenceCallbacks
         : public Callback<TransactionContext, mutation_result>,
           public Callback<TransactionContext, int> {
@@ -2141,6 +2499,12 @@ protected:
             kvstoreConfig = std::make_unique<RocksDBKVStoreConfig>(
                     config, 0 /*shardId*/);
         }
+#endif
+#ifdef EP_USE_MAGMA
+        else if (config.getBackend() == "magma") {
+            kvstoreConfig = std::make_unique<MagmaKVStoreConfig>(
+                    config, 0 /*shardId*/);
+        }
 #endif
         kvstore = setup_kv_store(*kvstoreConfig);
     }
@@ -2391,9 +2755,61 @@ TEST_P(KVStoreParamTest, HighSeqnoCorrectlyStoredForCommitBatch) {
     EXPECT_EQ(kvstore->getVBucketState(vbid)->highSeqno, 10);
 }
 
+// A commit whose sync is deferred must still be visible, and a later
+// syncCommits() must succeed.
+TEST_P(KVStoreParamTest, DeferredCommitSync) {
+    if (!kvstore->getStorageProperties().hasGroupCommit()) {
+        // Each commit is synced; there's never anything to sync.
+        EXPECT_TRUE(kvstore->syncCommits());
+        return;
+    }
+    kvstore->setDeferCommitSync(true);
+    kvstore->begin(std::make_unique<TransactionContext>());
+    StoredDocKey key = makeStoredDocKey("key");
+    Item item(key, 0, 0, "value", 5);
+    WriteCallback wc;
+    kvstore->set(item, wc);
+    EXPECT_TRUE(kvstore->commit(flush));
+    kvstore->setDeferCommitSync(false);
+
+    GetValue gv = kvstore->get(key, Vbid(0));
+    checkGetValue(gv);
+    EXPECT_TRUE(kvstore->syncCommits());
+}
+
+// A vBucket state snapshot may also defer its sync, so the state changes of
+// several vBuckets are made durable by one syncCommits().
+TEST_P(KVStoreParamTest, DeferredSnapshotSync) {
+    kvstore->setDeferCommitSync(
+            kvstore->getStorageProperties().hasGroupCommit());
+    vbucket_state state(vbucket_state_replica,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        false,
+                        "",
+                        false);
+    EXPECT_TRUE(kvstore->snapshotVBucket(
+            Vbid(0), state, VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT));
+    kvstore->setDeferCommitSync(false);
+    EXPECT_TRUE(kvstore->syncCommits());
+
+    auto* persisted = kvstore->getVBucketState(Vbid(0));
+    ASSERT_TRUE(persisted);
+    EXPECT_EQ(vbucket_state_replica, persisted->state);
+}
+
 std::string kvstoreTestParams[] = {
 #ifdef EP_USE_ROCKSDB
         "rocksdb",
+#endif
+#ifdef EP_USE_MAGMA
+        "magma",
 #endif
         "couchdb"};
 
@@ -2499,4 +2915,78 @@ TEST_F(RocksDBKVStoreTest, StatisticsOptionWrongValueTest) {
     // Re-open with the new configuration
     kvstore = setup_kv_store(*kvstoreConfig);
 }
+
+// Verify that with shared Column Families the VBuckets of a shard are kept
+// apart by their key prefix, are found again when the DB is re-opened and
+// can be deleted on their own.
+TEST_F(RocksDBKVStoreTest, SharedColumnFamiliesTest) {
+    Configuration config;
+    config.setDbname(data_dir);
+    config.setBackend("rocksdb");
+    config.setRocksdbSharedColumnFamilies(true);
+    kvstoreConfig =
+            std::make_unique<RocksDBKVStoreConfig>(config, 0 /*shardId*/);
+
+    // The fixture created the DB with a pair of CFs per VBucket, which cannot
+    // be re-opened with shared CFs.
+    kvstore.reset();
+    EXPECT_THROW(setup_kv_store(*kvstoreConfig), std::logic_error);
+    cb::io::rmrf(data_dir);
+
+    // Two VBuckets of shard 0
+    const std::vector<Vbid> vbids = {
+            Vbid(0), Vbid(static_cast<uint16_t>(config.getMaxNumShards()))};
+    kvstore = setup_kv_store(*kvstoreConfig, vbids);
+
+    WriteCallback wc;
+    int64_t seqno = 0;
+    for (auto vbid : vbids) {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        Item item(makeStoredDocKey("key-" + std::to_string(vbid.get())),
+                  0 /*flags*/,
+                  0 /*exptime*/,
+                  "value",
+                  5 /*nb*/,
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0 /*cas*/,
+                  ++seqno,
+                  vbid);
+        kvstore->set(item, wc);
+        EXPECT_TRUE(kvstore->commit(flush));
+    }
+
+    auto checkItems = [this, &vbids]() {
+        for (auto vbid : vbids) {
+            const auto key = "key-" + std::to_string(vbid.get());
+            GetValue gv = kvstore->get(makeStoredDocKey(key), vbid);
+            checkGetValue(gv);
+            for (auto other : vbids) {
+                if (other != vbid) {
+                    gv = kvstore->get(makeStoredDocKey(key), other);
+                    checkGetValue(gv, ENGINE_KEY_ENOENT);
+                }
+            }
+        }
+    };
+    checkItems();
+
+    // Re-open; the VBuckets are found through their vbstate and the high
+    // seqno of each is read within its own key prefix.
+    kvstore.reset();
+    kvstore = setup_kv_store(*kvstoreConfig, {});
+    checkItems();
+    ASSERT_NE(nullptr, kvstore->getVBucketState(vbids[0]));
+    EXPECT_EQ(1, kvstore->getVBucketState(vbids[0])->highSeqno);
+    ASSERT_NE(nullptr, kvstore->getVBucketState(vbids[1]));
+    EXPECT_EQ(2, kvstore->getVBucketState(vbids[1])->highSeqno);
+
+    // Deleting a VBucket only removes its own keys
+    kvstore->delVBucket(vbids[1], 0);
+    GetValue gv = kvstore->get(makeStoredDocKey("key-0"), vbids[0]);
+    checkGetValue(gv);
+    gv = kvstore->get(
+            makeStoredDocKey("key-" + std::to_string(vbids[1].get())),
+            vbids[1]);
+    checkGetValue(gv, ENGINE_KEY_ENOENT);
+}
 #endif
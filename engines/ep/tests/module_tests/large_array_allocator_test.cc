@@ -0,0 +1,75 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the LargeArrayAllocator class.
+ */
+
+#include "large_array_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using Array = std::vector<uint64_t, LargeArrayAllocator<uint64_t>>;
+
+TEST(LargeArrayAllocatorTest, HugePagesFromString) {
+    EXPECT_EQ(LargeArrayPolicy::HugePages::Off,
+              LargeArrayPolicy::hugePagesFromString("off"));
+    EXPECT_EQ(LargeArrayPolicy::HugePages::Transparent,
+              LargeArrayPolicy::hugePagesFromString("transparent"));
+    EXPECT_EQ(LargeArrayPolicy::HugePages::Explicit,
+              LargeArrayPolicy::hugePagesFromString("explicit"));
+    EXPECT_THROW(LargeArrayPolicy::hugePagesFromString("on"),
+                 std::invalid_argument);
+}
+
+// Only large arrays with a non-default policy are mapped.
+TEST(LargeArrayAllocatorTest, IsMapped) {
+    LargeArrayPolicy policy;
+    EXPECT_FALSE(policy.isMapped(LargeArrayPolicy::MinMappedSize));
+
+    policy.hugePages = LargeArrayPolicy::HugePages::Transparent;
+    EXPECT_FALSE(policy.isMapped(LargeArrayPolicy::MinMappedSize - 1));
+    EXPECT_TRUE(policy.isMapped(LargeArrayPolicy::MinMappedSize));
+
+    policy.hugePages = LargeArrayPolicy::HugePages::Off;
+    policy.numaNode = 0;
+    EXPECT_TRUE(policy.isMapped(LargeArrayPolicy::MinMappedSize));
+}
+
+// Mapped arrays can be used (and freed) like any other, and the policy
+// follows the contents when arrays are swapped.
+TEST(LargeArrayAllocatorTest, Swap) {
+    LargeArrayPolicy policy;
+    policy.hugePages = LargeArrayPolicy::HugePages::Explicit;
+
+    const size_t elements = LargeArrayPolicy::MinMappedSize;
+    Array large(elements, Array::allocator_type(policy));
+    large.back() = 1;
+    Array small(10);
+
+    large.swap(small);
+    EXPECT_EQ(elements, small.size());
+    EXPECT_EQ(1, small.back());
+    EXPECT_EQ(policy, small.get_allocator().getPolicy());
+    EXPECT_EQ(LargeArrayPolicy(), large.get_allocator().getPolicy());
+
+    small = Array(small.get_allocator());
+    EXPECT_TRUE(small.empty());
+    EXPECT_EQ(policy, small.get_allocator().getPolicy());
+}
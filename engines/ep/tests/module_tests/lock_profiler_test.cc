@@ -0,0 +1,138 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+/*
+ * Unit tests for the LockProfile and ProfiledMutex classes.
+ */
+
+#include "lock_profiler.h"
+#include "locks.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+using StatMap = std::map<std::string, std::string>;
+
+static void add_stat_callback(const char* key,
+                              const uint16_t klen,
+                              const char* val,
+                              const uint32_t vlen,
+                              gsl::not_null<const void*> cookie) {
+    auto* map = reinterpret_cast<StatMap*>(const_cast<void*>(cookie.get()));
+    map->insert(std::make_pair(std::string(key, klen),
+                               std::string(val, vlen)));
+}
+
+static StatMap getStats(const LockProfile& profile) {
+    StatMap stats;
+    profile.addStats(&stats, add_stat_callback);
+    return stats;
+}
+
+// A sample rate of 1 times every acquisition, and 0 none.
+TEST(LockProfileTest, SampleRate) {
+    LockProfile profile("test");
+    profile.setSampleRate(1);
+    for (int ii = 0; ii < 100; ++ii) {
+        EXPECT_TRUE(profile.sample());
+    }
+    profile.setSampleRate(0);
+    for (int ii = 0; ii < 100; ++ii) {
+        EXPECT_FALSE(profile.sample());
+    }
+
+    // Sampling 1 in N should time roughly 1/Nth of acquisitions.
+    profile.setSampleRate(10);
+    int sampled = 0;
+    for (int ii = 0; ii < 100000; ++ii) {
+        sampled += profile.sample() ? 1 : 0;
+    }
+    EXPECT_GT(sampled, 5000);
+    EXPECT_LT(sampled, 20000);
+}
+
+TEST(LockProfileTest, ProfiledMutex) {
+    LockProfile profile("test");
+    profile.setSampleRate(1);
+    ProfiledMutex<> mutex(&profile);
+    for (int ii = 0; ii < 10; ++ii) {
+        std::lock_guard<ProfiledMutex<>> lh(mutex);
+    }
+    // try_lock() isn't profiled.
+    ASSERT_TRUE(mutex.try_lock());
+    mutex.unlock();
+
+    auto stats = getStats(profile);
+    EXPECT_EQ("1", stats["test:sample_rate"]);
+    EXPECT_EQ("10", stats["test:wait_count"]);
+    EXPECT_EQ("10", stats["test:hold_count"]);
+    EXPECT_EQ(1, stats.count("test:hold_p99_ns"));
+    EXPECT_EQ(1, stats.count("test:wait_max_ns"));
+
+    profile.reset();
+    stats = getStats(profile);
+    EXPECT_EQ("0", stats["test:wait_count"]);
+    EXPECT_EQ("0", stats["test:hold_count"]);
+    EXPECT_EQ(0, stats.count("test:hold_p99_ns"));
+}
+
+TEST(LockProfileTest, Disabled) {
+    LockProfile profile("test");
+    profile.setSampleRate(0);
+    ProfiledMutex<> mutex(&profile);
+    ProfiledMutex<> unprofiled(nullptr);
+    {
+        std::lock_guard<ProfiledMutex<>> lh(mutex);
+        std::lock_guard<ProfiledMutex<>> lh2(unprofiled);
+    }
+    const auto stats = getStats(profile);
+    EXPECT_EQ("0", stats.at("test:wait_count"));
+    EXPECT_EQ("0", stats.at("test:hold_count"));
+}
+
+// Reader and writer acquisitions of a ProfiledRWLock through the lock holders
+// record both the wait and the hold.
+TEST(LockProfileTest, ProfiledRWLock) {
+    LockProfile profile("test");
+    profile.setSampleRate(1);
+    ProfiledRWLock lock(profile);
+    {
+        ReaderLockHolder rlh(lock);
+    }
+    {
+        WriterLockHolder wlh(lock);
+    }
+    const auto stats = getStats(profile);
+    EXPECT_EQ("2", stats.at("test:wait_count"));
+    EXPECT_EQ("2", stats.at("test:hold_count"));
+}
+
+TEST(LockProfileTest, LockProfilesStats) {
+    LockProfiles profiles;
+    profiles.setSampleRate(42);
+    StatMap stats;
+    profiles.addStats(&stats, add_stat_callback);
+    for (const auto* name : {"hash_table",
+                             "checkpoint_queue",
+                             "vbucket_state",
+                             "durability_monitor",
+                             "backfill_manager"}) {
+        EXPECT_EQ("42", stats[std::string(name) + ":sample_rate"]) << name;
+        EXPECT_EQ("0", stats[std::string(name) + ":wait_count"]) << name;
+    }
+}
@@ -0,0 +1,72 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "memory_arbiter.h"
+
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+static size_t sum(const std::vector<size_t>& quotas) {
+    return std::accumulate(quotas.begin(), quotas.end(), size_t(0));
+}
+
+// Buckets under their low watermark keep their configured quota when nobody
+// needs to borrow.
+TEST(MemoryArbiterTest, NoPressureKeepsBase) {
+    const auto quotas = MemoryArbiter::computeQuotas(
+            {{1000, 100, 0.75}, {2000, 500, 0.75}});
+    EXPECT_EQ(1000, quotas[0]);
+    EXPECT_EQ(2000, quotas[1]);
+}
+
+// A bucket over its low watermark borrows what it needs from an idle one,
+// and the total quota is unchanged.
+TEST(MemoryArbiterTest, LendsToPressuredBucket) {
+    // Bucket 0 has (750 - 150) * 0.5 = 300 to lend; bucket 1 needs
+    // 825 / 0.75 - 1000 = 100 to be back at its low watermark.
+    const auto quotas = MemoryArbiter::computeQuotas(
+            {{1000, 150, 0.75}, {1000, 825, 0.75}});
+    EXPECT_EQ(900, quotas[0]);
+    EXPECT_EQ(1100, quotas[1]);
+    EXPECT_EQ(2000, sum(quotas));
+}
+
+// A borrower can't be granted more than is lent; the pool is shared in
+// proportion to the need.
+TEST(MemoryArbiterTest, GrantCappedByPool) {
+    // Bucket 0 lends (750 - 550) * 0.5 = 100; buckets 1 and 2 need 100 and
+    // 300.
+    const auto quotas = MemoryArbiter::computeQuotas(
+            {{1000, 550, 0.75}, {1000, 825, 0.75}, {1000, 975, 0.75}});
+    EXPECT_EQ(900, quotas[0]);
+    EXPECT_EQ(1025, quotas[1]);
+    EXPECT_EQ(1075, quotas[2]);
+    EXPECT_EQ(3000, sum(quotas));
+}
+
+// A lender whose usage has grown lends less, so its quota comes back.
+TEST(MemoryArbiterTest, LenderReclaims) {
+    const auto before = MemoryArbiter::computeQuotas(
+            {{1000, 150, 0.75}, {1000, 900, 0.75}});
+    const auto after = MemoryArbiter::computeQuotas(
+            {{1000, 650, 0.75}, {1000, 900, 0.75}});
+    EXPECT_LT(before[0], after[0]);
+    EXPECT_GT(before[1], after[1]);
+    EXPECT_EQ(1000 - 50, after[0]);
+    EXPECT_EQ(1050, after[1]);
+}
@@ -506,6 +506,41 @@ TEST_F(MutationLogTest, BatchLoad) {
     }
 }
 
+static bool appendKey(void* arg, Vbid vb, const DocKey& k) {
+    auto* keys = reinterpret_cast<std::vector<StoredDocKey>*>(arg);
+    keys->emplace_back(k);
+    return true;
+}
+
+// Keys logged more than once in a batch are applied once, in key order.
+TEST_F(MutationLogTest, BatchLoadDuplicates) {
+    {
+        MutationLog ml(tmp_log_filename.c_str());
+        ml.open();
+        for (const auto* key : {"key2", "key1", "key2", "key0", "key1"}) {
+            ml.newItem(Vbid(0), makeStoredDocKey(key));
+        }
+        ml.commit1();
+        ml.commit2();
+    }
+
+    {
+        MutationLog ml(tmp_log_filename.c_str());
+        ml.open();
+        MutationLogHarvester h(ml);
+        h.setVBucket(Vbid(0));
+
+        EXPECT_EQ(ml.end(), h.loadBatch(ml.begin(), 0));
+
+        std::vector<StoredDocKey> keys;
+        h.apply(&keys, appendKey);
+        std::vector<StoredDocKey> expected{makeStoredDocKey("key0"),
+                                           makeStoredDocKey("key1"),
+                                           makeStoredDocKey("key2")};
+        EXPECT_EQ(expected, keys);
+    }
+}
+
 // @todo
 //   Test Read Only log
 //   Test close / open / close / open
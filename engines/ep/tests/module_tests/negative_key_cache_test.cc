@@ -0,0 +1,84 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the NegativeKeyCache class.
+ */
+
+#include "negative_key_cache.h"
+#include "test_helpers.h"
+
+#include <gtest/gtest.h>
+
+// An inserted key is contained until it expires.
+TEST(NegativeKeyCacheTest, ContainsUntilExpiry) {
+    NegativeKeyCache cache;
+    auto key = makeStoredDocKey("key");
+    EXPECT_FALSE(cache.contains(key, 100));
+
+    cache.insert(key, 110);
+    EXPECT_EQ(1, cache.size());
+    EXPECT_TRUE(cache.contains(key, 100));
+    EXPECT_TRUE(cache.contains(key, 109));
+    EXPECT_FALSE(cache.contains(makeStoredDocKey("other"), 100));
+    EXPECT_EQ(2, cache.getHits());
+
+    EXPECT_FALSE(cache.contains(key, 110));
+    EXPECT_EQ(0, cache.size());
+}
+
+// Keys of different collections are different keys.
+TEST(NegativeKeyCacheTest, Collections) {
+    NegativeKeyCache cache;
+    cache.insert(makeStoredDocKey("key", CollectionID(8)), 110);
+    EXPECT_TRUE(cache.contains(
+            makeStoredDocKey("key", CollectionID(8)), 100));
+    EXPECT_FALSE(cache.contains(makeStoredDocKey("key"), 100));
+}
+
+// Erasing a key (as when it gets a StoredValue) forgets it.
+TEST(NegativeKeyCacheTest, Erase) {
+    NegativeKeyCache cache;
+    auto key = makeStoredDocKey("key");
+    cache.erase(key);
+
+    cache.insert(key, 110);
+    cache.insert(key, 120);
+    EXPECT_EQ(1, cache.size());
+    cache.erase(key);
+    EXPECT_EQ(0, cache.size());
+    EXPECT_FALSE(cache.contains(key, 100));
+
+    cache.insert(key, 110);
+    cache.clear();
+    EXPECT_EQ(0, cache.size());
+    EXPECT_FALSE(cache.contains(key, 100));
+}
+
+// Once full the oldest entries are replaced.
+TEST(NegativeKeyCacheTest, ReplacesOldest) {
+    NegativeKeyCache cache;
+    for (size_t ii = 0; ii < NegativeKeyCache::Capacity + 1; ++ii) {
+        cache.insert(makeStoredDocKey("key" + std::to_string(ii)), 110);
+    }
+    EXPECT_EQ(NegativeKeyCache::Capacity, cache.size());
+    EXPECT_FALSE(cache.contains(makeStoredDocKey("key0"), 100));
+    for (size_t ii = 1; ii < NegativeKeyCache::Capacity + 1; ++ii) {
+        EXPECT_TRUE(cache.contains(
+                makeStoredDocKey("key" + std::to_string(ii)), 100));
+    }
+}
@@ -20,6 +20,7 @@
 #include "objectregistry.h"
 
 #include "item.h"
+#include "item_pool.h"
 #include "test_helpers.h"
 #include "tests/mock/mock_synchronous_ep_engine.h"
 
@@ -62,3 +63,15 @@ TEST_F(ObjectRegistryTest, MemOverhead) {
     }
     EXPECT_EQ(0, engine.getEpStats().getMemOverhead());
 }
+
+// Check that a deleted Item's memory is kept for reuse by the engine's
+// ItemPool.
+TEST_F(ObjectRegistryTest, ItemPool) {
+    auto& pool = engine.getItemPool();
+    const auto pooled = pool.size();
+
+    auto* item = new Item(makeStoredDocKey("key"), 0, 0, "value", 5);
+    delete item;
+    EXPECT_EQ(pooled + 1, pool.size());
+    EXPECT_EQ(0, engine.getEpStats().getNumItem());
+}
@@ -0,0 +1,151 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "configuration.h"
+#include "replicationthrottle.h"
+#include "stats.h"
+
+#include <gtest/gtest.h>
+
+/**
+ * ReplicationThrottle with a clock controlled by the test.
+ */
+template <typename Throttle>
+class TestThrottle : public Throttle {
+public:
+    TestThrottle(const Configuration& config, EPStats& stats)
+        : Throttle(config, stats) {
+    }
+
+    void advance(std::chrono::milliseconds duration) {
+        time += duration;
+    }
+
+protected:
+    std::chrono::steady_clock::time_point now() const override {
+        return time;
+    }
+
+    std::chrono::steady_clock::time_point time{std::chrono::seconds(1)};
+};
+
+class ReplicationThrottleTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        stats.setMaxDataSize(1024 * 1024 * 1024);
+        stats.replicationThrottleThreshold = 0.99;
+        stats.replicationThrottleWriteQueueCap = queueCap;
+        stats.diskQueueSize = 0;
+    }
+
+    /**
+     * Apply messages at the given rate (per second) for a second, in
+     * 100ms steps, so the throttle learns the unshaped rate.
+     */
+    template <typename Throttle>
+    void applyUnshaped(TestThrottle<Throttle>& throttle, size_t rate) {
+        for (int ii = 0; ii < 10; ++ii) {
+            ASSERT_EQ(ReplicationThrottle::Status::Process,
+                      throttle.getStatus());
+            throttle.consume(rate / 10);
+            throttle.advance(std::chrono::milliseconds(100));
+        }
+    }
+
+    const ssize_t queueCap = 10000;
+    Configuration config;
+    EPStats stats;
+};
+
+// Outside of the shaping band replication isn't limited.
+TEST_F(ReplicationThrottleTest, NotLimitedOutsideBand) {
+    TestThrottle<ReplicationThrottle> throttle(config, stats);
+    applyUnshaped(throttle, 100000);
+    EXPECT_EQ(ReplicationThrottle::Status::Process, throttle.getStatus());
+    EXPECT_EQ(0, throttle.getRate());
+}
+
+// Within the shaping band the rate is brought down towards the minimum rate
+// the closer the write queue is to its cap; and replication pauses when the
+// tokens are used, resuming as they accrue.
+TEST_F(ReplicationThrottleTest, RateShapedWithinBand) {
+    TestThrottle<ReplicationThrottle> throttle(config, stats);
+    applyUnshaped(throttle, 100000);
+
+    // Half way through the default 10% band.
+    stats.diskQueueSize = queueCap - (queueCap / 20);
+    ASSERT_EQ(ReplicationThrottle::Status::Process, throttle.getStatus());
+    const auto halfwayRate = throttle.getRate();
+    EXPECT_GT(halfwayRate, config.getReplicationThrottleMinRate());
+    EXPECT_LT(halfwayRate, 100000);
+
+    // Use all the tokens.
+    while (throttle.getStatus() == ReplicationThrottle::Status::Process) {
+        throttle.consume(10);
+    }
+    EXPECT_EQ(ReplicationThrottle::Status::Pause, throttle.getStatus());
+    throttle.advance(std::chrono::milliseconds(10));
+    EXPECT_EQ(ReplicationThrottle::Status::Process, throttle.getStatus());
+
+    // Closer to the cap the rate is lower.
+    stats.diskQueueSize = queueCap - (queueCap / 100);
+    throttle.getStatus();
+    EXPECT_LT(throttle.getRate(), halfwayRate);
+    EXPECT_GE(throttle.getRate(), config.getReplicationThrottleMinRate());
+
+    // At the cap replication is paused outright.
+    stats.diskQueueSize = queueCap;
+    EXPECT_EQ(ReplicationThrottle::Status::Pause, throttle.getStatus());
+
+    // And back out of the band it is no longer limited.
+    stats.diskQueueSize = 0;
+    EXPECT_EQ(ReplicationThrottle::Status::Process, throttle.getStatus());
+    EXPECT_EQ(0, throttle.getRate());
+}
+
+// With rate shaping disabled only the limits throttle replication.
+TEST_F(ReplicationThrottleTest, RateShapingDisabled) {
+    TestThrottle<ReplicationThrottle> throttle(config, stats);
+    throttle.setRateShaping(false);
+    stats.diskQueueSize = queueCap - 1;
+    for (int ii = 0; ii < 1000; ++ii) {
+        ASSERT_EQ(ReplicationThrottle::Status::Process, throttle.getStatus());
+        throttle.consume(1000);
+    }
+    EXPECT_EQ(0, throttle.getRate());
+    stats.diskQueueSize = queueCap;
+    EXPECT_EQ(ReplicationThrottle::Status::Pause, throttle.getStatus());
+}
+
+// Being rate limited doesn't disconnect Ephemeral replication, even with the
+// fail_new_data policy.
+TEST_F(ReplicationThrottleTest, EphemeralShapedIsNotDisconnect) {
+    config.setEphemeralFullPolicy("fail_new_data");
+    TestThrottle<ReplicationThrottleEphe> throttle(config, stats);
+    applyUnshaped(throttle, 100000);
+
+    stats.diskQueueSize = queueCap - (queueCap / 100);
+    while (throttle.getStatus() == ReplicationThrottle::Status::Process) {
+        throttle.consume(10);
+    }
+    EXPECT_EQ(ReplicationThrottle::Status::Pause, throttle.getStatus());
+
+    stats.diskQueueSize = queueCap;
+    EXPECT_EQ(ReplicationThrottle::Status::Disconnect, throttle.getStatus());
+}
@@ -0,0 +1,71 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "sharded_rwlock.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A thread always reads through the same shard, so can take the read lock
+// recursively.
+TEST(ShardedRWLockTest, SameShardPerThread) {
+    ShardedRWLock lock;
+    auto* shard = &lock.reader();
+    EXPECT_EQ(shard, &lock.reader());
+
+    std::lock_guard<cb::ReaderLock> outer(lock.reader());
+    std::lock_guard<cb::ReaderLock> inner(lock.reader());
+}
+
+// Readers on any thread must never see a write in progress.
+TEST(ShardedRWLockTest, WriterExcludesReaders) {
+    ShardedRWLock lock;
+    size_t first = 0;
+    size_t second = 0;
+    std::atomic<size_t> inconsistent{0};
+
+    std::vector<std::thread> readers;
+    for (size_t ii = 0; ii < ShardedRWLock::NumShards + 1; ++ii) {
+        readers.emplace_back([&lock, &first, &second, &inconsistent]() {
+            for (size_t jj = 0; jj < 10000; ++jj) {
+                {
+                    std::lock_guard<cb::ReaderLock> rlh(lock.reader());
+                    if (first != second) {
+                        ++inconsistent;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    for (size_t ii = 0; ii < 10000; ++ii) {
+        std::lock_guard<ShardedRWLock> wlh(lock);
+        ++first;
+        ++second;
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, inconsistent);
+    EXPECT_EQ(10000, first);
+}
@@ -24,6 +24,7 @@
 #include "dcp/producer.h"
 #include "dcp/stream.h"
 #include "evp_store_single_threaded_test.h"
+#include "statwriter.h"
 #include "tasks.h"
 #include "test_helpers.h"
 #include "tests/mock/mock_synchronous_ep_engine.h"
@@ -441,3 +442,50 @@ TEST_F(EpStatsTest, memoryAllocated) {
 
     EXPECT_EQ(0, stats.getPreciseTotalMemoryUsed());
 }
+
+// Integers are formatted without a stringstream, and must give exactly what
+// streaming them did.
+TEST(StatWriterTest, Values) {
+    std::map<std::string, std::string> stats;
+    auto add_stats = [](const char* key,
+                        const uint16_t klen,
+                        const char* val,
+                        const uint32_t vlen,
+                        gsl::not_null<const void*> cookie) {
+        auto* stats = reinterpret_cast<std::map<std::string, std::string>*>(
+                const_cast<void*>(cookie.get()));
+        (*stats)[std::string(key, klen)] = std::string(val, vlen);
+    };
+
+    auto expect = [&stats, &add_stats](const auto& value) {
+        std::stringstream ss;
+        ss << value;
+        add_casted_stat("value", value, add_stats, &stats);
+        EXPECT_EQ(ss.str(), stats["value"]);
+    };
+    expect(0);
+    expect(-1);
+    expect(std::numeric_limits<int16_t>::min());
+    expect(std::numeric_limits<uint16_t>::max());
+    expect(std::numeric_limits<int32_t>::min());
+    expect(std::numeric_limits<uint32_t>::max());
+    expect(std::numeric_limits<int64_t>::min());
+    expect(std::numeric_limits<int64_t>::max());
+    expect(std::numeric_limits<uint64_t>::max());
+    expect(size_t(1234567890));
+    expect(1.5);
+    expect(std::string("text"));
+    expect('c');
+
+    add_casted_stat("value", false, add_stats, &stats);
+    EXPECT_EQ("false", stats["value"]);
+    add_casted_stat("value", std::atomic<int>(-42), add_stats, &stats);
+    EXPECT_EQ("-42", stats["value"]);
+
+    add_prefixed_stat(std::string("vb_0"), "count", 7, add_stats, &stats);
+    EXPECT_EQ("7", stats["vb_0:count"]);
+    add_prefixed_stat("prefix", "name", "value", add_stats, &stats);
+    EXPECT_EQ("value", stats["prefix:name"]);
+    add_prefixed_stat(Vbid(3), "state", 1, add_stats, &stats);
+    EXPECT_EQ("1", stats["vb:3:state"]);
+}
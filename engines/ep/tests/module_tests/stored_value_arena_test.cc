@@ -0,0 +1,88 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the StoredValueArena class.
+ */
+
+#include "stored_value_arena.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+// Freed objects should be reused for subsequent allocations of the same size
+// class, without allocating more slabs.
+TEST(StoredValueArenaTest, Reuse) {
+    StoredValueArena arena;
+    auto* a = arena.allocate(60);
+    ASSERT_NE(nullptr, a);
+    std::memset(a, 'a', 60);
+    EXPECT_EQ(1, arena.getNumSlabs());
+    EXPECT_EQ(1, arena.getNumAllocated());
+
+    StoredValueArena::deallocate(a);
+    EXPECT_EQ(0, arena.getNumAllocated());
+
+    auto* b = arena.allocate(64);
+    EXPECT_EQ(a, b) << "Expected freed chunk of same size class to be reused";
+    EXPECT_EQ(1, arena.getNumSlabs());
+    StoredValueArena::deallocate(b);
+}
+
+// Allocations too large for any size class are refused.
+TEST(StoredValueArenaTest, TooLarge) {
+    StoredValueArena arena;
+    EXPECT_EQ(nullptr, arena.allocate(StoredValueArena::maxChunkSize));
+    EXPECT_EQ(0, arena.getNumSlabs());
+}
+
+// Filling a slab should allocate another one; and distinct size classes use
+// distinct slabs.
+TEST(StoredValueArenaTest, MultipleSlabs) {
+    StoredValueArena arena;
+    std::vector<void*> objects;
+    const size_t size = 100;
+    while (arena.getNumSlabs() < 2) {
+        objects.push_back(arena.allocate(size));
+    }
+    EXPECT_GT(objects.size(), StoredValueArena::slabSize / 128 - 1);
+
+    objects.push_back(arena.allocate(200));
+    EXPECT_EQ(3, arena.getNumSlabs());
+    EXPECT_EQ(objects.size(), arena.getNumAllocated());
+
+    for (auto* object : objects) {
+        StoredValueArena::deallocate(object);
+    }
+    EXPECT_EQ(0, arena.getNumAllocated());
+}
+
+// Objects may outlive their arena; freeing them afterwards must be safe (and
+// under ASan, not leak).
+TEST(StoredValueArenaTest, ObjectOutlivesArena) {
+    void* object;
+    {
+        StoredValueArena arena;
+        object = arena.allocate(32);
+        auto* other = arena.allocate(32);
+        StoredValueArena::deallocate(other);
+    }
+    std::memset(object, 'x', 32);
+    StoredValueArena::deallocate(object);
+}
@@ -338,6 +338,20 @@ TYPED_TEST(ValueTest, freqCounterNotReset) {
     EXPECT_EQ(10, this->sv->getFreqCounterValue());
 }
 
+// Check that when we copy a SV / OSV, the contents (including the
+// freqCounter) are copied.
+TYPED_TEST(ValueTest, copyStoredValue) {
+    ASSERT_EQ(4, this->sv->getFreqCounterValue());
+    this->sv->setFreqCounterValue(100);
+    ASSERT_EQ(100, this->sv->getFreqCounterValue());
+
+    auto copy = this->factory.copyStoredValue(*this->sv, {});
+
+    EXPECT_EQ(100, copy->getFreqCounterValue());
+    EXPECT_EQ(*this->sv, *copy);
+    EXPECT_EQ(this->sv->getObjectSize(), copy->getObjectSize());
+}
+
 /// Check that StoredValue / OrderedStoredValue don't unexpectedly change in
 /// size (we've carefully crafted them to be as efficient as possible).
 TEST(StoredValueTest, expectedSize) {
@@ -348,6 +362,97 @@ TEST(StoredValueTest, expectedSize) {
             << "Unexpected change in StoredValue storage size for key: " << key;
 }
 
+/**
+ * Test fixture for StoredValues created with an inline value region.
+ */
+class InlineStoredValueTest : public ::testing::Test {
+public:
+    InlineStoredValueTest() : factory(stats, inlineSize) {
+    }
+
+    static std::string valueOf(const StoredValue& sv) {
+        const auto data = sv.getValueData();
+        return {data.data(), data.size()};
+    }
+
+protected:
+    static const uint8_t inlineSize = 16;
+    EPStats stats;
+    StoredValueFactory factory;
+};
+
+// Check a small value is stored inline, and is still visible through the
+// value accessors and in Items created from the StoredValue.
+TEST_F(InlineStoredValueTest, SmallValueIsInline) {
+    auto key = makeStoredDocKey("key");
+    auto sv = factory(make_item(Vbid(0), key, "value"), {});
+
+    EXPECT_TRUE(sv->hasInlineValue());
+    EXPECT_TRUE(sv->hasValue());
+    EXPECT_FALSE(sv->getValue());
+    EXPECT_EQ(5, sv->valuelen());
+    EXPECT_EQ("value", valueOf(*sv));
+    EXPECT_EQ(StoredValue::getRequiredStorage(key, inlineSize),
+              sv->getObjectSize());
+    EXPECT_EQ(sv->getObjectSize(), sv->size());
+
+    auto item = sv->toItem(false, Vbid(0));
+    ASSERT_TRUE(item->getValue());
+    EXPECT_EQ("value", item->getValue()->to_s());
+    EXPECT_FALSE(sv->toItemKeyOnly(Vbid(0))->getValue());
+}
+
+// Check a large value doesn't get an inline region at all.
+TEST_F(InlineStoredValueTest, LargeValueIsNotInline) {
+    auto key = makeStoredDocKey("key");
+    auto sv = factory(
+            make_item(Vbid(0), key, std::string(inlineSize + 1, 'x')), {});
+
+    EXPECT_FALSE(sv->hasInlineValue());
+    ASSERT_TRUE(sv->getValue());
+    EXPECT_EQ(inlineSize + 1, sv->valuelen());
+    EXPECT_EQ(StoredValue::getRequiredStorage(key), sv->getObjectSize());
+}
+
+// Check a value moves between the inline region and a Blob as it is updated,
+// and is dropped on eject.
+TEST_F(InlineStoredValueTest, ValueMoves) {
+    auto key = makeStoredDocKey("key");
+    auto sv = factory(make_item(Vbid(0), key, "1"), {});
+    ASSERT_TRUE(sv->hasInlineValue());
+    const auto objectSize = sv->getObjectSize();
+
+    sv->setValue(make_item(Vbid(0), key, std::string(inlineSize + 1, 'x')));
+    EXPECT_FALSE(sv->hasInlineValue());
+    ASSERT_TRUE(sv->getValue());
+    EXPECT_EQ(objectSize + inlineSize + 1, sv->size());
+
+    sv->setValue(make_item(Vbid(0), key, "22"));
+    EXPECT_TRUE(sv->hasInlineValue());
+    EXPECT_EQ("22", valueOf(*sv));
+    EXPECT_EQ(objectSize, sv->size());
+
+    sv->ejectValue();
+    EXPECT_FALSE(sv->hasValue());
+    EXPECT_EQ(0, sv->valuelen());
+
+    sv->restoreValue(make_item(Vbid(0), key, "333"));
+    EXPECT_TRUE(sv->hasInlineValue());
+    EXPECT_EQ("333", valueOf(*sv));
+}
+
+// Check StoredValues can be allocated from (and freed back to) an arena.
+TEST(StoredValueTest, ArenaAllocated) {
+    EPStats stats;
+    StoredValueFactory factory(stats, /*inlineValueSize*/ 0, /*useArena*/ true);
+    auto key = makeStoredDocKey("key");
+    auto sv = factory(make_item(Vbid(0), key, "value"), {});
+    auto next = factory(make_item(Vbid(0), key, "value"), std::move(sv));
+    EXPECT_TRUE(next->hasKey(key));
+    EXPECT_TRUE(next->getNext()->hasKey(key));
+    next.reset();
+}
+
 /**
  * Test fixture for OrderedStoredValue-only tests.
  */
@@ -362,15 +467,3 @@ TEST_F(OrderedStoredValueTest, expectedSize) {
             << "Unexpected change in OrderedStoredValue storage size for key: "
             << key;
 }
-
-// Check that when we copy a OSV, the freqCounter is also copied. (Cannot copy
-// StoredValues, hence no version for them).
-TEST_F(OrderedStoredValueTest, copyStoreValue) {
-    ASSERT_EQ(4, sv->getFreqCounterValue());
-    sv->setFreqCounterValue(100);
-    ASSERT_EQ(100, sv->getFreqCounterValue());
-
-    auto copy = factory.copyStoredValue(*sv, {});
-
-    EXPECT_EQ(100, copy->getFreqCounterValue());
-}
@@ -78,6 +78,39 @@ TEST(StoredDocKey, no_encoded_collectionId) {
     EXPECT_EQ(0, key3.getCollectionID());
 }
 
+// A DocKey decodes its collection-ID once; a DocKey created with the ID
+// already decoded must behave the same as one which decoded it.
+TEST(DocKey, decodedCollectionID) {
+    const CollectionID cid = 0x12345;
+    cb::mcbp::unsigned_leb128<CollectionIDType> leb(cid);
+    std::string raw{reinterpret_cast<const char*>(leb.data()), leb.size()};
+    raw.append("key");
+    const auto* data = reinterpret_cast<const uint8_t*>(raw.data());
+
+    DocKey decoded(data, raw.size(), DocKeyEncodesCollectionId::Yes);
+    DocKey preDecoded(
+            data, raw.size(), cid, gsl::narrow_cast<uint8_t>(leb.size()));
+    for (const auto& key : {decoded, preDecoded}) {
+        EXPECT_EQ(DocKeyEncodesCollectionId::Yes, key.getEncoding());
+        EXPECT_EQ(cid, key.getCollectionID());
+        const auto idAndKey = key.getIdAndKey();
+        EXPECT_EQ(cid, idAndKey.first);
+        EXPECT_EQ("key",
+                  std::string(reinterpret_cast<const char*>(
+                                      idAndKey.second.data()),
+                              idAndKey.second.size()));
+        const auto noCid = key.makeDocKeyWithoutCollectionID();
+        EXPECT_EQ(DocKeyEncodesCollectionId::No, noCid.getEncoding());
+        EXPECT_EQ(3, noCid.size());
+        EXPECT_EQ(decoded.hash(), key.hash());
+    }
+
+    // A key without a stop byte only fails when the ID is asked for
+    const uint8_t invalid[] = {0x80, 0x80};
+    DocKey invalidKey(invalid, sizeof(invalid), DocKeyEncodesCollectionId::Yes);
+    EXPECT_THROW(invalidKey.getCollectionID(), std::invalid_argument);
+}
+
 TEST_P(StoredDocKeyTest, copy_constructor) {
     StoredDocKey key1("key1", GetParam());
     StoredDocKey key2(key1);
@@ -0,0 +1,91 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the TaskProfile class.
+ */
+
+#include "task_profile.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+using namespace std::chrono;
+
+static void add_stat_callback(const char* key,
+                              const uint16_t klen,
+                              const char* val,
+                              const uint32_t vlen,
+                              gsl::not_null<const void*> cookie) {
+    auto* map = reinterpret_cast<std::map<std::string, std::string>*>(
+            const_cast<void*>(cookie.get()));
+    map->insert(std::make_pair(std::string(key, klen),
+                               std::string(val, vlen)));
+}
+
+static std::map<std::string, std::string> getStats(
+        const TaskProfile& profile) {
+    std::map<std::string, std::string> stats;
+    profile.addStats(&stats, add_stat_callback);
+    return stats;
+}
+
+// Only the tasks which ran are reported, with their runtime and delay.
+TEST(TaskProfileTest, Histograms) {
+    TaskProfile profile;
+    EXPECT_TRUE(getStats(profile).empty());
+
+    const std::string name = GlobalTask::getTaskName(TaskId::ItemPager);
+    for (int ii = 1; ii <= 100; ++ii) {
+        profile.logRunTime(TaskId::ItemPager, milliseconds(ii));
+    }
+    profile.logQTime(TaskId::ItemPager, microseconds(0));
+
+    auto stats = getStats(profile);
+    EXPECT_EQ("100", stats[name + ":runtime_count"]);
+    EXPECT_NEAR(50000, std::stoi(stats[name + ":runtime_p50_us"]), 1000);
+    EXPECT_NEAR(100000, std::stoi(stats[name + ":runtime_max_us"]), 1000);
+    EXPECT_EQ("1", stats[name + ":delay_count"]);
+    EXPECT_EQ("1", stats[name + ":delay_max_us"]);
+
+    profile.reset();
+    EXPECT_TRUE(getStats(profile).empty());
+}
+
+// Only the most recent slow runs are kept, most recent first.
+TEST(TaskProfileTest, SlowRuns) {
+    TaskProfile profile(2);
+    profile.logSlowRun(
+            TaskId::ItemPager, "first", "nonio_worker_0", seconds(1));
+    profile.logSlowRun(
+            TaskId::ItemPager, "second", "nonio_worker_1", seconds(2));
+    profile.logSlowRun(
+            TaskId::ItemPager, "third", "nonio_worker_0", seconds(3));
+
+    auto stats = getStats(profile);
+    EXPECT_EQ("third", stats["slow_run:0:description"]);
+    EXPECT_EQ("3000000", stats["slow_run:0:runtime_us"]);
+    EXPECT_EQ("nonio_worker_0", stats["slow_run:0:thread"]);
+    EXPECT_EQ("second", stats["slow_run:1:description"]);
+    EXPECT_EQ(0, stats.count("slow_run:2:description"));
+
+    profile.setMaxSlowRuns(0);
+    profile.logSlowRun(
+            TaskId::ItemPager, "fourth", "nonio_worker_0", seconds(1));
+    EXPECT_TRUE(getStats(profile).empty());
+}
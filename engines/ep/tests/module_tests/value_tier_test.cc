@@ -0,0 +1,104 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "value_tier.h"
+
+#include "blob.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+
+using ValueTierPtr = std::unique_ptr<ValueTier, ValueTier::Release>;
+
+// Allocations are made until the tier is full, and freed memory is reused.
+TEST(ValueTierTest, AllocateUntilFull) {
+    ValueTierPtr tier(new ValueTier(64 * 1024, "", -1));
+    EXPECT_EQ(64 * 1024, tier->getCapacity());
+
+    std::vector<void*> allocations;
+    while (auto* ptr = tier->allocate(1000)) {
+        allocations.push_back(ptr);
+        ASSERT_LT(allocations.size(), 100);
+    }
+    // 1000 bytes (and the header) use a 1024 byte class.
+    EXPECT_EQ(64, allocations.size());
+    EXPECT_EQ(64 * 1024, tier->getUsed());
+    EXPECT_EQ(nullptr, tier->allocate(1000));
+
+    ValueTier::deallocate(allocations.back());
+    allocations.pop_back();
+    EXPECT_EQ(63, tier->getNumAllocations());
+    auto* ptr = tier->allocate(1000);
+    EXPECT_NE(nullptr, ptr);
+    allocations.push_back(ptr);
+
+    for (auto* allocation : allocations) {
+        ValueTier::deallocate(allocation);
+    }
+    EXPECT_EQ(0, tier->getUsed());
+    EXPECT_EQ(0, tier->getNumAllocations());
+}
+
+TEST(ValueTierTest, OverMaxAllocation) {
+    ValueTierPtr tier(new ValueTier(4 * ValueTier::MaxAllocation, "", -1));
+    EXPECT_EQ(nullptr, tier->allocate(ValueTier::MaxAllocation + 1));
+    auto* ptr = tier->allocate(ValueTier::MaxAllocation);
+    EXPECT_NE(nullptr, ptr);
+    ValueTier::deallocate(ptr);
+}
+
+// A Blob copied to the tier holds the same value; copying it back gives a
+// heap Blob.
+TEST(ValueTierTest, BlobCopy) {
+    ValueTierPtr tier(new ValueTier(64 * 1024, "", -1));
+    const std::string data(500, 'x');
+    value_t heap(Blob::New(data.data(), data.size()));
+    EXPECT_FALSE(heap->isTiered());
+
+    value_t tiered(Blob::CopyToTier(*heap, *tier));
+    ASSERT_TRUE(tiered);
+    EXPECT_TRUE(tiered->isTiered());
+    EXPECT_EQ(data.size(), tiered->valueSize());
+    EXPECT_EQ(data, tiered->to_s());
+    EXPECT_EQ(1, tier->getNumAllocations());
+
+    value_t copy(Blob::Copy(*tiered));
+    EXPECT_FALSE(copy->isTiered());
+    EXPECT_EQ(data, copy->to_s());
+
+    tiered.reset();
+    EXPECT_EQ(0, tier->getNumAllocations());
+}
+
+// A tier released by its owner stays mapped until its last value is freed.
+TEST(ValueTierTest, ReleasedWithValues) {
+    ValueTierPtr tier(new ValueTier(64 * 1024, "", -1));
+    const std::string data(100, 'y');
+    value_t heap(Blob::New(data.data(), data.size()));
+    value_t tiered(Blob::CopyToTier(*heap, *tier));
+    ASSERT_TRUE(tiered);
+
+    tier.reset();
+    EXPECT_EQ(data, tiered->to_s());
+    tiered.reset();
+}
+
+#endif
@@ -0,0 +1,60 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "workload.h"
+
+#include <gtest/gtest.h>
+
+// Read heavy workloads get most of the threads as readers, unless the items
+// are resident so the reads don't need to go to disk.
+TEST(WorkLoadPolicyTest, ReadHeavy) {
+    EXPECT_EQ(6, WorkLoadPolicy::getNumReadersFor(READ_HEAVY, 50, false, 8));
+    EXPECT_EQ(4, WorkLoadPolicy::getNumReadersFor(READ_HEAVY, 100, false, 8));
+}
+
+// Write heavy workloads get most as writers, mixed are split evenly.
+TEST(WorkLoadPolicyTest, WriteHeavyAndMixed) {
+    EXPECT_EQ(2, WorkLoadPolicy::getNumReadersFor(WRITE_HEAVY, 50, false, 8));
+    EXPECT_EQ(4, WorkLoadPolicy::getNumReadersFor(MIXED, 50, false, 8));
+}
+
+// A disk queue backlog moves a quarter of the threads to the writers, but
+// never the last quarter of the readers.
+TEST(WorkLoadPolicyTest, DiskBacklog) {
+    EXPECT_EQ(4, WorkLoadPolicy::getNumReadersFor(READ_HEAVY, 50, true, 8));
+    EXPECT_EQ(2, WorkLoadPolicy::getNumReadersFor(MIXED, 50, true, 8));
+    EXPECT_EQ(2, WorkLoadPolicy::getNumReadersFor(WRITE_HEAVY, 50, true, 8));
+}
+
+// There is always at least one reader and one writer.
+TEST(WorkLoadPolicyTest, AtLeastOneOfEach) {
+    EXPECT_EQ(1, WorkLoadPolicy::getNumReadersFor(WRITE_HEAVY, 50, true, 2));
+    EXPECT_EQ(1, WorkLoadPolicy::getNumReadersFor(READ_HEAVY, 0, false, 2));
+    EXPECT_EQ(2, WorkLoadPolicy::getNumReadersFor(READ_HEAVY, 0, false, 3));
+    EXPECT_EQ(1, WorkLoadPolicy::getNumReadersFor(MIXED, 50, false, 1));
+}
+
+TEST(WorkLoadPolicyTest, RecordAdjustment) {
+    WorkLoadPolicy policy(4, 4);
+    EXPECT_EQ(0, policy.getNumAdjustments());
+    policy.recordAdjustment(6, 2);
+    EXPECT_EQ(1, policy.getNumAdjustments());
+    EXPECT_EQ(6, policy.getAdaptiveReaders());
+    EXPECT_EQ(2, policy.getAdaptiveWriters());
+}
@@ -97,8 +97,9 @@ void OutputCouchFile::writeDocuments() {
 
 void OutputCouchFile::setCollectionStats(
         CollectionID cid, Collections::VB::PersistedStats stats) const {
-    std::string docName = "|" + cid.to_string() + "|";
-    writeLocalDocument(docName, stats.getLebEncodedStats());
+    // The output file only has the one collection's stats.
+    writeLocalDocument(Collections::CouchstoreCollectionStats,
+                       Collections::VB::encodePersistedStats({{cid, stats}}));
 }
 
 void OutputCouchFile::writeLocalDocument(const std::string& documentName,
@@ -198,6 +198,11 @@ enum class ClientOpcode : uint8_t {
      * Command to create a new checkpoint on a given vbucket by force
      */
     CreateCheckpoint = 0xaa,
+    /**
+     * Apply a batch of SET/ADD/DEL_WITH_META mutations for one vbucket,
+     * returning the status of each mutation in a single response.
+     */
+    WithMetaBatch = 0xab,
     NotifyVbucketUpdate = 0xac,
     /**
      * Command to enable data traffic after completion of warm
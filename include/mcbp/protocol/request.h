@@ -207,6 +207,14 @@ public:
     boost::optional<cb::durability::Requirements> getDurabilityRequirements()
             const;
 
+    /**
+     * May this command be reordered with other reorderable commands?
+     *
+     * @return true if the client allows this command to be reordered (and
+     *              the server supports reordering of this command type)
+     */
+    bool mayReorder() const;
+
     /**
      * May this command be reordered with the next command?
      *
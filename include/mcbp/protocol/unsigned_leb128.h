@@ -19,6 +19,7 @@
 #include <boost/optional/optional.hpp>
 #include <platform/sized_buffer.h>
 #include <array>
+#include <cstring>
 #include <gsl/gsl>
 #include <type_traits>
 
@@ -49,6 +50,43 @@ template <class T>
 typename std::enable_if<std::is_unsigned<T>::value,
                         std::pair<T, cb::const_byte_buffer>>::type
 decode_unsigned_leb128(cb::const_byte_buffer buf, struct Leb128NoThrow) {
+    // The common case (collection-IDs below 128) is a single byte
+    if ((buf[0] & 0x80) == 0) {
+        return {T(buf[0]), cb::const_byte_buffer{buf.data() + 1,
+                                                 buf.size() - 1}};
+    }
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+        __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Multi-byte values are decoded a 64-bit word at a time when there are
+    // 8 bytes to read (keys are usually longer than their prefix): find the
+    // stop byte in the word and gather the 7-bit groups before it with
+    // shifts and masks instead of a loop over the bytes.
+    if (buf.size() >= sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, buf.data(), sizeof(word));
+        const uint64_t stopBits = ~word & 0x8080808080808080ull;
+        if (stopBits) {
+            const size_t end = __builtin_ctzll(stopBits) / 8;
+            if (end < sizeof(uint64_t) - 1) {
+                word &= (uint64_t(1) << ((end + 1) * 8)) - 1;
+            }
+            word &= 0x7f7f7f7f7f7f7f7full;
+            word = (word & 0x007f007f007f007full) |
+                   ((word & 0x7f007f007f007f00ull) >> 1);
+            word = (word & 0x00003fff00003fffull) |
+                   ((word & 0x3fff00003fff0000ull) >> 2);
+            word = (word & 0x000000000fffffffull) |
+                   ((word & 0x0fffffff00000000ull) >> 4);
+            return {T(word),
+                    cb::const_byte_buffer{buf.data() + end + 1,
+                                          buf.size() - (end + 1)}};
+        }
+        // No stop byte in the first 8 bytes, only valid for larger T; fall
+        // back to the byte loop.
+    }
+#endif
+
     T rv = buf[0] & 0x7full;
     size_t end = 0;
     if ((buf[0] & 0x80) == 0x80ull) {
@@ -20,6 +20,7 @@
 #include <cstring>
 #include <iomanip>
 
+#include <platform/crc32c.h>
 #include <platform/sized_buffer.h>
 #include <platform/socket.h>
 
@@ -232,19 +233,23 @@ struct DocKeyInterface {
         return static_cast<const T*>(this)->getEncoding();
     }
 
+    /**
+     * Hash the key; keys which compare equal hash the same, regardless of
+     * whether the CollectionID is encoded or not.
+     *
+     * Uses CRC32C; crc32c() selects a hardware (SSE4.2) implementation at
+     * runtime where available, which processes 8 bytes per instruction
+     * instead of the one byte per step of a traditional string hash.
+     */
     uint32_t hash() const {
-        uint32_t h = 5381;
+        uint32_t h = 0;
 
         if (getEncoding() == DocKeyEncodesCollectionId::No) {
-            h = ((h << 5) + h) ^ uint32_t(DefaultCollectionLeb128Encoded);
+            h = crc32c(&DefaultCollectionLeb128Encoded, 1, h);
         }
         // else hash the entire data which includes an encoded CollectionID
 
-        for (auto c : cb::const_byte_buffer(data(), size())) {
-            h = ((h << 5) + h) ^ uint32_t(c);
-        }
-
-        return h;
+        return crc32c(data(), size(), h);
     }
 };
 
@@ -259,6 +264,33 @@ struct DocKey : DocKeyInterface<DocKey> {
      */
     DocKey(const uint8_t* key, size_t nkey, DocKeyEncodesCollectionId encoding)
         : buffer(key, nkey), encoding(encoding) {
+        if (encoding == DocKeyEncodesCollectionId::Yes) {
+            // Inline the common single byte (ID < 128) case
+            if (nkey && (key[0] & 0x80) == 0) {
+                collectionID = key[0];
+                prefixLen = 1;
+            } else {
+                decodeCollectionID();
+            }
+        }
+    }
+
+    /**
+     * Creates a view onto a key which encodes a collection-ID that has
+     * already been decoded (e.g. when the request was validated), so
+     * getCollectionID() and friends don't decode it again.
+     *
+     * @param cid The collection-ID the key encodes
+     * @param prefixLen The length of the leb128 collection-ID prefix
+     */
+    DocKey(const uint8_t* key,
+           size_t nkey,
+           CollectionIDType cid,
+           uint8_t prefixLen)
+        : buffer(key, nkey),
+          encoding(DocKeyEncodesCollectionId::Yes),
+          prefixLen(prefixLen),
+          collectionID(cid) {
     }
 
     /**
@@ -300,7 +332,22 @@ struct DocKey : DocKeyInterface<DocKey> {
         return buffer.size();
     }
 
-    CollectionID getCollectionID() const;
+    /**
+     * The collection-ID is decoded once, when the DocKey is created, and
+     * copies of the DocKey carry it.
+     *
+     * @throws std::invalid_argument if the key encodes an invalid
+     *         collection-ID
+     */
+    CollectionID getCollectionID() const {
+        if (encoding == DocKeyEncodesCollectionId::No) {
+            return CollectionID::Default;
+        }
+        if (prefixLen == 0) {
+            throwInvalidCollectionID();
+        }
+        return collectionID;
+    }
 
     DocKeyEncodesCollectionId getEncoding() const {
         return encoding;
@@ -312,18 +359,42 @@ struct DocKey : DocKeyInterface<DocKey> {
      * hashed/compared to the same value as the same logical key which doesn't
      * encode the collection-ID.
      */
-    std::pair<CollectionID, cb::const_byte_buffer> getIdAndKey() const;
+    std::pair<CollectionID, cb::const_byte_buffer> getIdAndKey() const {
+        const auto cid = getCollectionID();
+        return {cid, {data() + prefixLen, size() - prefixLen}};
+    }
 
     /**
      * @return a DocKey that views this DocKey but without any collection-ID
      * prefix. If this was already viewing a key without any encoded
      * collection-ID, then this is returned.
      */
-    DocKey makeDocKeyWithoutCollectionID() const;
+    DocKey makeDocKeyWithoutCollectionID() const {
+        if (encoding == DocKeyEncodesCollectionId::Yes) {
+            const auto idAndKey = getIdAndKey();
+            return {idAndKey.second.data(),
+                    idAndKey.second.size(),
+                    DocKeyEncodesCollectionId::No};
+        }
+        return *this;
+    }
 
 private:
+    /**
+     * Decode the leb128 collection-ID prefix into the members below; leaves
+     * prefixLen 0 if the key doesn't have a valid prefix.
+     */
+    void decodeCollectionID();
+
+    [[noreturn]] void throwInvalidCollectionID() const;
+
     cb::const_byte_buffer buffer;
     DocKeyEncodesCollectionId encoding{DocKeyEncodesCollectionId::No};
+    // The decoded collection-ID prefix (an encoded ID is at least one byte,
+    // so prefixLen is only 0 if the key doesn't encode one). These fit in the
+    // padding after encoding, so a DocKey is no bigger for them.
+    uint8_t prefixLen{0};
+    CollectionIDType collectionID{CollectionID::Default};
 };
 
 /**
@@ -11,6 +11,7 @@
 #include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional_fwd.hpp>
 #include <spdlog/common.h>
@@ -124,6 +125,19 @@ enum class StoreIfStatus {
 using StoreIfPredicate = std::function<StoreIfStatus(
         const boost::optional<item_info>&, cb::vbucket_info)>;
 
+/**
+ * Function passed to mutate_in_place() which produces the new version of a
+ * document from its current version.
+ *
+ * It is given the current item (nullptr if the document doesn't exist),
+ * which it takes ownership of. It returns the item to store in its place,
+ * which remains owned by the caller; or nullptr with success to leave the
+ * document as it is. Any other status fails the mutation, and is returned
+ * by mutate_in_place().
+ */
+using DocumentMutator =
+        std::function<std::pair<engine_errc, item*>(unique_item_ptr)>;
+
 struct EngineErrorCasPair {
     engine_errc status;
     uint64_t cas;
@@ -287,6 +301,30 @@ struct MEMCACHED_PUBLIC_CLASS EngineIface {
                                         Vbid vbucket,
                                         DocStateFilter documentStateFilter) = 0;
 
+    /**
+     * Retrieve multiple items in a single call; used by the frontend to
+     * look up a pipeline of GET requests in one go.
+     *
+     * Unlike get() this must not block, nor use the cookie for anything
+     * other than accounting - it belongs to the request currently being
+     * executed, which is not necessarily the request for any of the keys.
+     * Any key which cannot be returned immediately (or would require the
+     * cookie to be notified / updated) should be returned with
+     * engine_errc::would_block; the frontend then looks it up via get()
+     * when its request is executed.
+     *
+     * The default implementation returns would_block for every key.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param keys the keys to look up, each with the vbucket it belongs to
+     * @param documentStateFilter as for get(); applied to every key
+     * @return One result per key, in the same order as keys
+     */
+    virtual std::vector<cb::EngineErrorItemPair> get_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<std::pair<DocKey, Vbid>>& keys,
+            DocStateFilter documentStateFilter);
+
     /**
      * Optionally retrieve an item. Only non-deleted items may be fetched
      * through this interface (Documents in deleted state may be evicted
@@ -439,6 +477,37 @@ struct MEMCACHED_PUBLIC_CLASS EngineIface {
         return {cb::engine_errc::not_supported, 0};
     }
 
+    /**
+     * Update a document by applying a function to its current version, with
+     * the document locked against any other update for the duration. Unlike
+     * a get followed by a CAS store this can't fail because of a concurrent
+     * update, so the caller never has to retry.
+     *
+     * The mutator is called at most once, from within the engine and with
+     * the document locked: it must not call back into the engine other than
+     * to allocate or release items. It isn't called if the document first
+     * needs to be fetched from disk; the engine returns would_block instead
+     * and the caller should retry once notified.
+     *
+     * Optional interface; not supported by all engines. An engine which
+     * doesn't support it returns not_supported without calling the mutator.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param key the key of the document to update
+     * @param vbucket the virtual bucket id
+     * @param mutator function producing the new version of the document
+     *
+     * @return a std::pair containing the engine_error code and CAS of the
+     *         document
+     */
+    virtual cb::EngineErrorCasPair mutate_in_place(
+            gsl::not_null<const void*> cookie,
+            const DocKey& key,
+            Vbid vbucket,
+            cb::DocumentMutator mutator) {
+        return {cb::engine_errc::not_supported, 0};
+    }
+
     /**
      * Flush the cache.
      *
@@ -593,6 +662,19 @@ inline EngineErrorItemPair makeEngineErrorItemPair(cb::engine_errc err,
 }
 }
 
+inline std::vector<cb::EngineErrorItemPair> EngineIface::get_multi(
+        gsl::not_null<const void*>,
+        const std::vector<std::pair<DocKey, Vbid>>& keys,
+        DocStateFilter) {
+    std::vector<cb::EngineErrorItemPair> results;
+    results.reserve(keys.size());
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        results.push_back(
+                cb::makeEngineErrorItemPair(cb::engine_errc::would_block));
+    }
+    return results;
+}
+
 /**
  * @}
  */
@@ -728,6 +728,13 @@ protected:
  * the server returns ENGINE_ROLLBACK error.
  */
 #define DCP_ADD_STREAM_STRICT_VBUUID 32
+/**
+ * Indicate the client accepts the disk snapshot of a stream starting at
+ * seqno 0 in key order rather than seqno order. Items within that snapshot
+ * may then arrive in any seqno order; the snapshot is only consistent once
+ * all of it has been received. Ignored for takeover streams.
+ */
+#define DCP_ADD_STREAM_FLAG_KEY_ORDER_BACKFILL 64
     uint32_t flags = 0;
 };
 static_assert(sizeof(DcpAddStreamPayload) == 4, "Unexpected struct size");
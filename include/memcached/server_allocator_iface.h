@@ -128,6 +128,46 @@ struct ServerAllocatorIface {
      * @return whether the call was successful
      */
     bool (*get_allocator_property)(const char* name, size_t* value);
+
+    /**
+     * Creates (or reuses a released) allocator arena, for a bucket to make
+     * all of its allocations from.
+     * @param arena destination for the arena's index (never 0, the default
+     *        arena)
+     * @return whether the allocator supports arenas and one was created
+     */
+    bool (*create_arena)(unsigned* arena);
+
+    /**
+     * Releases an arena made by create_arena, purging its unused pages. The
+     * arena is reused by a later create_arena.
+     */
+    void (*release_arena)(unsigned arena);
+
+    /**
+     * Binds the calling thread to the given arena, so its allocations come
+     * from that arena. 0 binds the thread back to the default arena.
+     * @return whether the call was successful
+     */
+    bool (*set_thread_arena)(unsigned arena);
+
+    /**
+     * Returns the bytes currently allocated from the given arena (including
+     * those sitting in thread caches).
+     */
+    size_t (*get_arena_allocated)(unsigned arena);
+
+    /**
+     * Gets how full the allocator's run (slab / extent) backing the given
+     * allocation is.
+     * @param ptr an allocation
+     * @param nfree destination for the number of free regions in the run
+     * @param nregs destination for the number of regions in the run
+     * @return whether the allocator can report the run's utilization
+     */
+    bool (*get_allocation_utilization)(const void* ptr,
+                                       size_t* nfree,
+                                       size_t* nregs);
 };
 
 #ifdef __cplusplus
@@ -23,6 +23,7 @@
 #include <xattr/visibility.h>
 #include <cstddef>
 #include <memory>
+#include <vector>
 
 namespace cb {
 namespace xattr {
@@ -272,9 +273,44 @@ protected:
      */
     void remove_segment(const size_t offset, const size_t size);
 
+    /**
+     * Blobs with at least this many kv-pairs get an index of the keys so
+     * they can be looked up with a binary search rather than a scan of the
+     * blob. Most documents only have a couple of xattrs, where the scan is
+     * cheaper than building the index.
+     */
+    static const size_t IndexThreshold = 8;
+
+    /**
+     * Locate the kv-pair for the given key
+     *
+     * @param key The key to look up
+     * @return the offset of the kv-pair, or 0 if the key isn't there
+     */
+    size_t find(const cb::const_char_buffer& key) const;
+
+    /// Build the index (if the blob is big enough to warrant one)
+    void build_index() const;
+
+    /// Update the index as the kv-pair at offset was (re)written
+    void index_inserted(size_t offset);
+
+    /// Update the index as the size bytes at offset were removed
+    void index_removed(size_t offset, size_t size);
+
 private:
     cb::char_buffer blob;
 
+    /**
+     * The offsets of the kv-pairs in the blob sorted by their keys. Built on
+     * the first lookup and kept up to date by the modifications; empty if
+     * the blob is too small to be indexed.
+     */
+    mutable std::vector<uint32_t> index;
+
+    /// Has the blob been looked at to build the index?
+    mutable bool indexed = false;
+
     /// When the incoming data is compressed will auto-decompress into this
     cb::compression::Buffer decompressed;
 
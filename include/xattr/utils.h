@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <platform/compress.h>
 #include <platform/sized_buffer.h>
 #include <xattr/visibility.h>
 
@@ -62,6 +63,19 @@ uint32_t get_body_offset(const cb::const_char_buffer& payload);
 XATTR_PUBLIC_API
 cb::const_char_buffer get_body(const cb::const_char_buffer& payload);
 
+/**
+ * Inflate just the XATTR section (the length and the XATTR blob) of a snappy
+ * compressed document. Only as much of the document as is needed is
+ * inflated, so the cost doesn't depend on the size of the body.
+ *
+ * @param payload the snappy compressed document (which must have XATTRs)
+ * @param xattrs where to store the inflated XATTR section
+ * @return true on success, false if the payload isn't valid
+ */
+XATTR_PUBLIC_API
+bool inflate_xattrs(const cb::const_char_buffer& payload,
+                    cb::compression::Buffer& xattrs);
+
 /**
  * Check to see if the provided attribute represents a system
  * attribute or not.
@@ -33,6 +33,7 @@
 
 #include "config.h"
 
+#include <logger/rate_limiter.h>
 #include <logger/visibility.h>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/logger.h>
@@ -173,6 +174,31 @@ LOGGER_PUBLIC_API const bool isInitialized();
         }                                         \
     } while (false)
 
+/**
+ * Log through a RateLimiter for the call site, for messages on paths which
+ * may end up logging for every operation. The site may log 10 messages per
+ * second, and the number of messages dropped in between is logged along with
+ * the next one let through.
+ */
+#define CB_LOG_ENTRY_RATELIMITED(severity, ...)                             \
+    do {                                                                    \
+        auto _logger_ = cb::logger::get();                                  \
+        if (_logger_->should_log(severity)) {                               \
+            static cb::logger::RateLimiter _limiter_;                       \
+            uint64_t _suppressed_ = 0;                                      \
+            if (_limiter_.allow(_suppressed_)) {                            \
+                if (_suppressed_ != 0) {                                    \
+                    _logger_->log(severity,                                 \
+                                  "Suppressed {} messages from {}:{}",      \
+                                  _suppressed_,                             \
+                                  __FILE__,                                 \
+                                  __LINE__);                                \
+                }                                                           \
+                _logger_->log(severity, __VA_ARGS__);                       \
+            }                                                               \
+        }                                                                   \
+    } while (false)
+
 #define LOG_TRACE(...) \
     CB_LOG_ENTRY(spdlog::level::level_enum::trace, __VA_ARGS__)
 #define LOG_DEBUG(...) \
@@ -183,3 +209,8 @@ LOGGER_PUBLIC_API const bool isInitialized();
 #define LOG_ERROR(...) CB_LOG_ENTRY(spdlog::level::level_enum::err, __VA_ARGS__)
 #define LOG_CRITICAL(...) \
     CB_LOG_ENTRY(spdlog::level::level_enum::critical, __VA_ARGS__)
+
+#define LOG_INFO_RATELIMITED(...) \
+    CB_LOG_ENTRY_RATELIMITED(spdlog::level::level_enum::info, __VA_ARGS__)
+#define LOG_WARNING_RATELIMITED(...) \
+    CB_LOG_ENTRY_RATELIMITED(spdlog::level::level_enum::warn, __VA_ARGS__)
@@ -99,6 +99,20 @@ BENCHMARK_DEFINE_F(LoggerBench, LogToLoggerWithEnabledLogLevel)
     }
 }
 
+/**
+ * Benchmark the cost of logging through a rate limited log site, where
+ * (after the first few) the messages are dropped before being formatted.
+ */
+BENCHMARK_DEFINE_F(LoggerBench, LogToLoggerRateLimited)
+(benchmark::State& state) {
+    if (state.thread_index == 0) {
+        cb::logger::get()->set_level(spdlog::level::level_enum::trace);
+    }
+    while (state.KeepRunning()) {
+        CB_LOG_ENTRY_RATELIMITED(spdlog::level::level_enum::trace, "Foo");
+    }
+}
+
 /**
  * Benchmark the cost of grabbing the logger (which means checking
  * for it's existence and copy a shared pointer).
@@ -117,6 +131,9 @@ BENCHMARK_REGISTER_F(LoggerBench, LogToLoggerWithDisabledLogLevel)
 BENCHMARK_REGISTER_F(LoggerBench, LogToLoggerWithEnabledLogLevel)
         ->Threads(1)
         ->Threads(16);
+BENCHMARK_REGISTER_F(LoggerBench, LogToLoggerRateLimited)
+        ->Threads(1)
+        ->Threads(16);
 
 int main(int argc, char** argv) {
     ::benchmark::Initialize(&argc, argv);
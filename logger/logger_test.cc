@@ -21,6 +21,7 @@
 #include <platform/cbassert.h>
 
 #include <valgrind/valgrind.h>
+#include <thread>
 
 #ifndef WIN32
 #include <sys/resource.h>
@@ -200,3 +201,48 @@ TEST_F(SpdloggerTest, VbidClassTest) {
     ASSERT_EQ(1, files.size()) << "We should only have a single logfile";
     EXPECT_EQ(1, countInFile(files.front(), "INFO VbidClassTest vb:1023"));
 }
+
+/**
+ * Only the burst of messages is let through each interval, and the number
+ * dropped is handed back with the next message let through.
+ */
+TEST(RateLimiterTest, Burst) {
+    cb::logger::RateLimiter limiter(2, std::chrono::hours(1));
+    const auto total = cb::logger::RateLimiter::getTotalSuppressed();
+
+    uint64_t suppressed = 1;
+    EXPECT_TRUE(limiter.allow(suppressed));
+    EXPECT_EQ(0, suppressed);
+    EXPECT_TRUE(limiter.allow(suppressed));
+    for (int ii = 0; ii < 5; ++ii) {
+        EXPECT_FALSE(limiter.allow(suppressed));
+    }
+    EXPECT_EQ(total + 5, cb::logger::RateLimiter::getTotalSuppressed());
+
+    cb::logger::RateLimiter fast(1, std::chrono::milliseconds(1));
+    EXPECT_TRUE(fast.allow(suppressed));
+    EXPECT_FALSE(fast.allow(suppressed));
+    EXPECT_FALSE(fast.allow(suppressed));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(fast.allow(suppressed));
+    EXPECT_EQ(2, suppressed);
+}
+
+/**
+ * A rate limited log site logs its burst, then reports the number of
+ * messages it dropped with the next message it lets through.
+ */
+TEST_F(SpdloggerTest, RateLimited) {
+    auto log = [](int ii) { LOG_WARNING_RATELIMITED("RateLimited {}", ii); };
+    for (int ii = 0; ii < 15; ++ii) {
+        log(ii);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    log(15);
+
+    cb::logger::shutdown();
+    files = cb::io::findFilesWithPrefix(filename);
+    ASSERT_EQ(1, files.size()) << "We should only have a single logfile";
+    EXPECT_EQ(11, countInFile(files.front(), "RateLimited "));
+    EXPECT_EQ(1, countInFile(files.front(), "Suppressed 5 messages from"));
+}
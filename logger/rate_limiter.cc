@@ -0,0 +1,49 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "rate_limiter.h"
+
+namespace cb {
+namespace logger {
+
+static std::atomic<uint64_t> totalSuppressed{0};
+
+bool RateLimiter::allow(uint64_t& suppressed) {
+    const auto now =
+            std::chrono::steady_clock::now().time_since_epoch().count();
+    auto current = start.load(std::memory_order_relaxed);
+    if (now - current >= interval &&
+        start.compare_exchange_strong(current, now)) {
+        count.store(0, std::memory_order_relaxed);
+    }
+
+    if (count.fetch_add(1, std::memory_order_relaxed) < burst) {
+        suppressed = dropped.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    totalSuppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+uint64_t RateLimiter::getTotalSuppressed() {
+    return totalSuppressed.load(std::memory_order_relaxed);
+}
+
+} // namespace logger
+} // namespace cb
@@ -0,0 +1,78 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <logger/visibility.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace cb {
+namespace logger {
+
+/**
+ * A RateLimiter limits how often a single log site may log, so that a hot
+ * path which suddenly starts warning for every operation (a failing TLS
+ * handshake, a misbehaving DCP stream etc.) can't flood (and with the async
+ * logger's blocking overflow policy, stall) the logger.
+ *
+ * Each site may log `burst` messages per `interval`; the messages after that
+ * are counted and dropped, and the number dropped is handed back with the
+ * next message allowed through so it can be reported. It doesn't take any
+ * locks: when racing threads hit the start of a new interval a message or
+ * two may slip through either way, which is fine for its purpose.
+ *
+ * Normally used through the LOG_*_RATELIMITED macros, which create one
+ * (static) instance per call site.
+ */
+class LOGGER_PUBLIC_API RateLimiter {
+public:
+    explicit RateLimiter(size_t burst = 10,
+                         std::chrono::steady_clock::duration interval =
+                                 std::chrono::seconds(1))
+        : burst(burst), interval(interval.count()) {
+    }
+
+    /**
+     * Check if the site may log a message now.
+     *
+     * @param suppressed set to the number of messages dropped since the
+     *                   last one allowed through (when returning true)
+     * @return true if the message should be logged
+     */
+    bool allow(uint64_t& suppressed);
+
+    /// @return the total number of messages dropped by all rate limiters
+    static uint64_t getTotalSuppressed();
+
+private:
+    const size_t burst;
+    const std::chrono::steady_clock::rep interval;
+
+    /// The start of the current interval
+    std::atomic<std::chrono::steady_clock::rep> start{0};
+    /// The number of messages seen in the current interval
+    std::atomic<size_t> count{0};
+    /// The number of messages dropped since the last one allowed through
+    std::atomic<uint64_t> dropped{0};
+};
+
+} // namespace logger
+} // namespace cb
@@ -0,0 +1,766 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * mcload - Utility program to generate load on a running memcached process
+ * over the network, and report the latency of the operations.
+ *
+ * Each thread owns a connection and keeps up to --pipeline requests in
+ * flight on it (responses are returned in order, as unordered execution
+ * isn't negotiated). With --rate the requests are sent on a fixed schedule
+ * (open loop), and latencies are measured from the time a request was due
+ * to be sent so a stalled server can't hide its latency by slowing down
+ * the load.
+ */
+
+#include "config.h"
+
+#include <getopt.h>
+#include <mcbp/protocol/framebuilder.h>
+#include <memcached/durability_spec.h>
+#include <memcached/protocol_binary.h>
+#include <platform/dirutils.h>
+#include <platform/platform.h>
+#include <programs/getpass.h>
+#include <programs/hostname_utils.h>
+#include <protocol/connection/client_connection.h>
+#include <utilities/hdrhistogram.h>
+#include <utilities/terminate_handler.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+
+using cb::mcbp::ClientOpcode;
+using cb::mcbp::Status;
+
+enum class Operation { Get, Set, DurableSet, Subdoc, Count };
+
+static const char* to_string(Operation op) {
+    switch (op) {
+    case Operation::Get:
+        return "GET";
+    case Operation::Set:
+        return "SET";
+    case Operation::DurableSet:
+        return "SET (durable)";
+    case Operation::Subdoc:
+        return "SUBDOC_DICT_UPSERT";
+    case Operation::Count:
+        break;
+    }
+    return "unknown";
+}
+
+/// The workload, shared (read only) by all of the threads
+struct Workload {
+    std::string prefix{"mcload-"};
+    size_t numKeys = 10000;
+    size_t numVbuckets = 1024;
+    /// The zipf skew of the key distribution (0 for uniform)
+    double skew = 0;
+    /// The cumulative probability of each key, if not uniform
+    std::vector<double> keyCdf;
+    /// The documents to store, and the weight of each
+    std::vector<std::string> values;
+    std::vector<double> valueWeights;
+    /// The weight of each operation
+    std::array<double, size_t(Operation::Count)> opWeights{{80, 20, 0, 0}};
+    cb::durability::Level durabilityLevel = cb::durability::Level::Majority;
+    /// The total number of requests per second to send (0 for closed loop)
+    double rate = 0;
+    size_t pipeline = 1;
+    std::chrono::seconds duration{10};
+};
+
+/// The connection details, used by every thread to create its connection
+struct ConnectionConfig {
+    std::string host;
+    in_port_t port;
+    sa_family_t family;
+    bool secure;
+    std::string sslCert;
+    std::string sslKey;
+    std::string user;
+    std::string password;
+    std::string bucket;
+};
+
+/// The statistics collected for each operation
+struct OpStats {
+    /// Latencies in microseconds, up to a minute
+    HdrHistogram latency{1, 60 * 1000 * 1000, 3};
+    uint64_t misses = 0;
+    std::map<Status, uint64_t> errors;
+};
+
+class Worker {
+public:
+    Worker(const Workload& workload,
+           const ConnectionConfig& config,
+           size_t threads,
+           unsigned int seed)
+        : workload(workload),
+          config(config),
+          rng(seed),
+          keyDist(0, workload.numKeys - 1),
+          valueDist(workload.valueWeights.begin(),
+                    workload.valueWeights.end()),
+          opDist(workload.opWeights.begin(), workload.opWeights.end()),
+          interval(workload.rate > 0 ? std::chrono::nanoseconds(uint64_t(
+                                               1e9 * threads / workload.rate))
+                                     : std::chrono::nanoseconds(0)) {
+    }
+
+    /// Store every n'th key, starting at the given one
+    void populate(size_t first, size_t step) {
+        connect();
+        for (size_t key = first; key < workload.numKeys; key += step) {
+            if (inflight.size() == workload.pipeline) {
+                receive();
+            }
+            send(Operation::Set, key, std::chrono::steady_clock::now());
+        }
+        while (!inflight.empty()) {
+            receive();
+        }
+    }
+
+    void run() {
+        connect();
+        const auto start = std::chrono::steady_clock::now();
+        const auto end = start + workload.duration;
+        auto next = start;
+
+        while (true) {
+            const auto now = std::chrono::steady_clock::now();
+            const bool due = interval.count() == 0 || now >= next;
+            if (now < end && due && inflight.size() < workload.pipeline) {
+                const auto op = Operation(opDist(rng));
+                send(op, nextKey(), interval.count() == 0 ? now : next);
+                next += interval;
+            } else if (!inflight.empty()) {
+                receive();
+            } else if (now >= end) {
+                break;
+            } else {
+                std::this_thread::sleep_until(next);
+            }
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    const std::array<OpStats, size_t(Operation::Count)>& getStats() const {
+        return stats;
+    }
+
+    std::chrono::steady_clock::duration getElapsed() const {
+        return elapsed;
+    }
+
+private:
+    void connect() {
+        if (connection) {
+            return;
+        }
+        connection = std::make_unique<MemcachedConnection>(
+                config.host, config.port, config.family, config.secure);
+        connection->setSslCertFile(config.sslCert);
+        connection->setSslKeyFile(config.sslKey);
+        connection->connect();
+        connection->setFeatures(
+                "mcload " MEMCACHED_VERSION,
+                {cb::mcbp::Feature::XERROR,
+                 cb::mcbp::Feature::JSON,
+                 cb::mcbp::Feature::TCPNODELAY,
+                 cb::mcbp::Feature::AltRequestSupport,
+                 cb::mcbp::Feature::SyncReplication});
+        if (!config.user.empty()) {
+            connection->authenticate(config.user,
+                                     config.password,
+                                     connection->getSaslMechanisms());
+        }
+        if (!config.bucket.empty()) {
+            connection->selectBucket(config.bucket);
+        }
+    }
+
+    size_t nextKey() {
+        if (workload.keyCdf.empty()) {
+            return keyDist(rng);
+        }
+        const auto p = std::uniform_real_distribution<double>(0, 1)(rng);
+        const auto it = std::lower_bound(
+                workload.keyCdf.begin(), workload.keyCdf.end(), p);
+        return std::min(size_t(it - workload.keyCdf.begin()),
+                        workload.numKeys - 1);
+    }
+
+    void send(Operation op,
+              size_t keyIndex,
+              std::chrono::steady_clock::time_point due) {
+        const auto key = workload.prefix + std::to_string(keyIndex);
+        const std::string* value = nullptr;
+        std::vector<uint8_t> extras;
+        std::vector<uint8_t> framingExtras;
+
+        switch (op) {
+        case Operation::Get:
+            break;
+        case Operation::DurableSet:
+            // The id and length, followed by the level
+            framingExtras.push_back(
+                    uint8_t(1 << 4) |
+                    uint8_t(cb::mcbp::request::FrameInfoId::
+                                    DurabilityRequirement));
+            framingExtras.push_back(uint8_t(workload.durabilityLevel));
+            // FALLTHROUGH
+        case Operation::Set: {
+            value = &workload.values[valueDist(rng)];
+            cb::mcbp::request::MutationPayload payload;
+            const auto buf = payload.getBuffer();
+            extras.assign(buf.begin(), buf.end());
+        } break;
+        case Operation::Subdoc:
+            // Path length, path flags and doc flags
+            extras = {0, uint8_t(subdocPath.size()), 0,
+                      uint8_t(mcbp::subdoc::doc_flag::Mkdoc)};
+            break;
+        case Operation::Count:
+            throw std::logic_error("Worker::send: invalid operation");
+        }
+
+        const std::string subdocValue{"1"};
+        std::string body;
+        if (op == Operation::Subdoc) {
+            body = subdocPath + subdocValue;
+        }
+        const size_t valueSize = value ? value->size() : body.size();
+
+        std::vector<uint8_t> buffer(sizeof(cb::mcbp::Request) +
+                                    framingExtras.size() + extras.size() +
+                                    key.size() + valueSize);
+        cb::mcbp::RequestBuilder builder({buffer.data(), buffer.size()});
+        builder.setMagic(framingExtras.empty()
+                                 ? cb::mcbp::Magic::ClientRequest
+                                 : cb::mcbp::Magic::AltClientRequest);
+        switch (op) {
+        case Operation::Get:
+            builder.setOpcode(ClientOpcode::Get);
+            break;
+        case Operation::Set:
+        case Operation::DurableSet:
+            builder.setOpcode(ClientOpcode::Set);
+            builder.setDatatype(cb::mcbp::Datatype::JSON);
+            break;
+        case Operation::Subdoc:
+            builder.setOpcode(ClientOpcode::SubdocDictUpsert);
+            break;
+        case Operation::Count:
+            break;
+        }
+        if (!framingExtras.empty()) {
+            builder.setFramingExtras({framingExtras.data(),
+                                      framingExtras.size()});
+        }
+        builder.setExtras({extras.data(), extras.size()});
+        builder.setKey(cb::const_char_buffer{key.data(), key.size()});
+        if (value) {
+            builder.setValue(
+                    cb::const_char_buffer{value->data(), value->size()});
+        } else if (!body.empty()) {
+            builder.setValue(cb::const_char_buffer{body.data(), body.size()});
+        }
+        builder.setVBucket(
+                Vbid(uint16_t(std::hash<std::string>()(key) %
+                              workload.numVbuckets)));
+        builder.setOpaque(opaque++);
+
+        Frame frame;
+        frame.payload = std::move(buffer);
+        connection->sendFrame(frame);
+        inflight.push_back({op, due});
+    }
+
+    void receive() {
+        Frame frame;
+        connection->recvFrame(frame);
+        const auto now = std::chrono::steady_clock::now();
+        const auto request = inflight.front();
+        inflight.pop_front();
+
+        auto& opStats = stats[size_t(request.op)];
+        const auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                now - request.due);
+        opStats.latency.addValue(std::max(int64_t(1), int64_t(usec.count())));
+
+        const auto status = frame.getResponse()->getStatus();
+        if (status == Status::KeyEnoent && request.op == Operation::Get) {
+            ++opStats.misses;
+        } else if (status != Status::Success) {
+            ++opStats.errors[status];
+        }
+    }
+
+    struct Inflight {
+        Operation op;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    const Workload& workload;
+    const ConnectionConfig& config;
+    const std::string subdocPath{"n"};
+    std::unique_ptr<MemcachedConnection> connection;
+    std::mt19937_64 rng;
+    std::uniform_int_distribution<size_t> keyDist;
+    std::discrete_distribution<size_t> valueDist;
+    std::discrete_distribution<size_t> opDist;
+    const std::chrono::nanoseconds interval;
+    std::deque<Inflight> inflight;
+    uint32_t opaque = 0;
+    std::array<OpStats, size_t(Operation::Count)> stats;
+    std::chrono::steady_clock::duration elapsed{};
+};
+
+/**
+ * Parse a list of the form "value[:weight],..." where the weight defaults
+ * to 1.
+ */
+static std::vector<std::pair<std::string, double>> parseWeightedList(
+        const std::string& list) {
+    std::vector<std::pair<std::string, double>> ret;
+    std::string::size_type pos = 0;
+    while (pos <= list.size()) {
+        auto end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const auto entry = list.substr(pos, end - pos);
+        const auto colon = entry.find(':');
+        if (colon == std::string::npos) {
+            ret.emplace_back(entry, 1.0);
+        } else {
+            ret.emplace_back(entry.substr(0, colon),
+                             std::stod(entry.substr(colon + 1)));
+        }
+        pos = end + 1;
+    }
+    return ret;
+}
+
+static cb::durability::Level parseDurabilityLevel(const std::string& level) {
+    if (level == "majority") {
+        return cb::durability::Level::Majority;
+    }
+    if (level == "majorityAndPersistOnMaster") {
+        return cb::durability::Level::MajorityAndPersistOnMaster;
+    }
+    if (level == "persistToMajority") {
+        return cb::durability::Level::PersistToMajority;
+    }
+    throw std::invalid_argument("Unknown durability level: " + level);
+}
+
+/// @return a JSON document of (at least 8 bytes and) the given size
+static std::string makeValue(size_t size) {
+    const std::string prefix{R"({"v":")"};
+    const std::string suffix{R"("})"};
+    const auto fill = size > prefix.size() + suffix.size()
+                              ? size - prefix.size() - suffix.size()
+                              : 0;
+    return prefix + std::string(fill, 'x') + suffix;
+}
+
+static void printStats(std::array<OpStats, size_t(Operation::Count)>& stats,
+                       std::chrono::steady_clock::duration elapsed,
+                       bool json) {
+    const auto seconds =
+            std::chrono::duration_cast<std::chrono::duration<double>>(elapsed)
+                    .count();
+    for (size_t ii = 0; ii < stats.size(); ++ii) {
+        auto& opStats = stats[ii];
+        const auto count = opStats.latency.getValueCount();
+        if (count == 0) {
+            continue;
+        }
+        std::cout << to_string(Operation(ii)) << ": " << count << " ops ("
+                  << std::fixed << std::setprecision(0) << count / seconds
+                  << " ops/s)";
+        if (opStats.misses) {
+            std::cout << ", " << opStats.misses << " misses";
+        }
+        std::cout << std::endl;
+        for (const auto& error : opStats.errors) {
+            std::cout << "    " << ::to_string(error.first) << ": "
+                      << error.second << std::endl;
+        }
+        std::cout << "    latency (us):";
+        for (const auto percentile : {50.0, 90.0, 99.0, 99.9, 100.0}) {
+            std::cout << " p" << std::setprecision(percentile == 99.9 ? 1 : 0)
+                      << percentile << "="
+                      << opStats.latency.getValueAtPercentile(percentile);
+        }
+        std::cout << std::endl;
+        if (json) {
+            std::cout << opStats.latency.to_string() << std::endl;
+        }
+    }
+}
+
+static void usage() {
+    static const char* text = R"(Usage: mcload [options]
+
+Options:
+    --ipv4 / -4          Use IPv4
+    --ipv6 / -6          Use IPv6
+    --host= / -h         Connect to the specified host (with an optional port
+                         number). By default this is set to "localhost".
+    --port= / -p         Connect to the specified port (By default this is
+                         11210)
+    --user= / -u         The username to use for authentication.
+    --password= / -P     The password to use for authentication. If not
+                         specified the textual string set in the environment
+                         variable CB_PASSWORD is used. If '-' is specified the
+                         password is read from standard input.
+    --bucket= / -b       The bucket to run the load against
+    --ssl / -s           Connect over SSL
+    --ssl=cert,key       Try to authenticate over SSL by using the provided
+                         SSL certificate and private key.
+    --threads= / -t      The number of threads (and connections) to use
+                         (default 1)
+    --pipeline=          The number of requests each connection may have in
+                         flight (default 1)
+    --rate= / -r         The total number of requests per second to send
+                         (open loop). By default each connection sends its
+                         next request as soon as it may (closed loop).
+    --duration= / -d     The number of seconds to run for (default 10)
+    --keys= / -k         The number of keys to use (default 10000)
+    --prefix=            The prefix of the keys (default "mcload-")
+    --zipf=skew          Pick the keys from a zipf distribution with the
+                         given skew (uniform by default)
+    --value-size=        The document sizes to store, optionally weighted,
+                         as size[:weight],... (default 256)
+    --mix=               The weight of each operation, as
+                         get:n,set:n,durable:n,subdoc:n (default
+                         get:80,set:20). durable stores the document with
+                         the --durability level, and subdoc upserts a path
+                         in it.
+    --durability=        The durability level of the durable sets: majority,
+                         majorityAndPersistOnMaster or persistToMajority
+                         (default majority)
+    --vbuckets=          The number of vBuckets of the bucket (default 1024).
+                         Keys are spread over all of them, so all must be
+                         active on the server.
+    --populate           Store every key before running the load
+    --json               Print the latency histograms as JSON
+    --help               This help text
+)";
+
+    std::cerr << text << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    // Make sure that we dump callstacks on the console
+    install_backtrace_terminate_handler();
+
+    int cmd;
+    std::string port{"11210"};
+    std::string host{"localhost"};
+    sa_family_t family = AF_UNSPEC;
+    ConnectionConfig config;
+    config.secure = false;
+    Workload workload;
+    size_t threads = 1;
+    std::string valueSizes{"256"};
+    std::string mix;
+    bool populate = false;
+    bool json = false;
+
+    /* Initialize the socket subsystem */
+    cb_initialize_sockets();
+
+    enum {
+        OptPipeline = 256,
+        OptPrefix,
+        OptZipf,
+        OptValueSize,
+        OptMix,
+        OptDurability,
+        OptVbuckets,
+        OptPopulate,
+        OptJson,
+        OptHelp
+    };
+
+    struct option long_options[] = {
+            {"ipv4", no_argument, nullptr, '4'},
+            {"ipv6", no_argument, nullptr, '6'},
+            {"host", required_argument, nullptr, 'h'},
+            {"port", required_argument, nullptr, 'p'},
+            {"user", required_argument, nullptr, 'u'},
+            {"password", required_argument, nullptr, 'P'},
+            {"bucket", required_argument, nullptr, 'b'},
+            {"ssl", optional_argument, nullptr, 's'},
+            {"threads", required_argument, nullptr, 't'},
+            {"pipeline", required_argument, nullptr, OptPipeline},
+            {"rate", required_argument, nullptr, 'r'},
+            {"duration", required_argument, nullptr, 'd'},
+            {"keys", required_argument, nullptr, 'k'},
+            {"prefix", required_argument, nullptr, OptPrefix},
+            {"zipf", required_argument, nullptr, OptZipf},
+            {"value-size", required_argument, nullptr, OptValueSize},
+            {"mix", required_argument, nullptr, OptMix},
+            {"durability", required_argument, nullptr, OptDurability},
+            {"vbuckets", required_argument, nullptr, OptVbuckets},
+            {"populate", no_argument, nullptr, OptPopulate},
+            {"json", no_argument, nullptr, OptJson},
+            {"help", no_argument, nullptr, OptHelp},
+            {nullptr, 0, nullptr, 0}};
+
+    try {
+        while ((cmd = getopt_long(argc,
+                                  argv,
+                                  "46h:p:u:P:b:st:r:d:k:",
+                                  long_options,
+                                  nullptr)) != EOF) {
+            switch (cmd) {
+            case '6':
+                family = AF_INET6;
+                break;
+            case '4':
+                family = AF_INET;
+                break;
+            case 'h':
+                host.assign(optarg);
+                break;
+            case 'p':
+                port.assign(optarg);
+                break;
+            case 'u':
+                config.user.assign(optarg);
+                break;
+            case 'P':
+                config.password.assign(optarg);
+                break;
+            case 'b':
+                config.bucket.assign(optarg);
+                break;
+            case 's':
+                config.secure = true;
+                if (optarg) {
+                    config.sslCert.assign(optarg);
+                    auto idx = config.sslCert.find(',');
+                    if (idx == std::string::npos) {
+                        std::cerr << "Invalid format for SSL certificate and "
+                                     "key\n";
+                        exit(EXIT_FAILURE);
+                    }
+                    config.sslKey = config.sslCert.substr(idx + 1);
+                    config.sslCert.resize(idx);
+
+                    if (!cb::io::isFile(config.sslCert)) {
+                        std::cerr << "SSL certificate file " << config.sslCert
+                                  << " does not exists";
+                        exit(EXIT_FAILURE);
+                    }
+
+                    if (!cb::io::isFile(config.sslKey)) {
+                        std::cerr << "SSL private file " << config.sslKey
+                                  << " does not exists";
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                break;
+            case 't':
+                threads = std::stoul(optarg);
+                break;
+            case OptPipeline:
+                workload.pipeline = std::stoul(optarg);
+                break;
+            case 'r':
+                workload.rate = std::stod(optarg);
+                break;
+            case 'd':
+                workload.duration = std::chrono::seconds(std::stoul(optarg));
+                break;
+            case 'k':
+                workload.numKeys = std::stoul(optarg);
+                break;
+            case OptPrefix:
+                workload.prefix.assign(optarg);
+                break;
+            case OptZipf:
+                workload.skew = std::stod(optarg);
+                break;
+            case OptValueSize:
+                valueSizes.assign(optarg);
+                break;
+            case OptMix:
+                mix.assign(optarg);
+                break;
+            case OptDurability:
+                workload.durabilityLevel = parseDurabilityLevel(optarg);
+                break;
+            case OptVbuckets:
+                workload.numVbuckets = std::stoul(optarg);
+                break;
+            case OptPopulate:
+                populate = true;
+                break;
+            case OptJson:
+                json = true;
+                break;
+            default:
+                usage();
+            }
+        }
+
+        if (threads == 0 || workload.pipeline == 0 || workload.numKeys == 0 ||
+            workload.numVbuckets == 0) {
+            std::cerr << "threads, pipeline, keys and vbuckets must be "
+                         "non-zero"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        for (const auto& entry : parseWeightedList(valueSizes)) {
+            workload.values.push_back(makeValue(std::stoul(entry.first)));
+            workload.valueWeights.push_back(entry.second);
+        }
+
+        if (!mix.empty()) {
+            workload.opWeights.fill(0);
+            for (const auto& entry : parseWeightedList(mix)) {
+                if (entry.first == "get") {
+                    workload.opWeights[size_t(Operation::Get)] = entry.second;
+                } else if (entry.first == "set") {
+                    workload.opWeights[size_t(Operation::Set)] = entry.second;
+                } else if (entry.first == "durable") {
+                    workload.opWeights[size_t(Operation::DurableSet)] =
+                            entry.second;
+                } else if (entry.first == "subdoc") {
+                    workload.opWeights[size_t(Operation::Subdoc)] =
+                            entry.second;
+                } else {
+                    std::cerr << "Unknown operation in --mix: " << entry.first
+                              << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << "Invalid argument: " << ex.what() << std::endl;
+        usage();
+    }
+
+    if (workload.skew > 0) {
+        // The cumulative probability of the key ranked i is the sum of
+        // 1/i^skew over the keys up to it, normalised.
+        workload.keyCdf.resize(workload.numKeys);
+        double sum = 0;
+        for (size_t ii = 0; ii < workload.numKeys; ++ii) {
+            sum += 1.0 / std::pow(double(ii + 1), workload.skew);
+            workload.keyCdf[ii] = sum;
+        }
+        for (auto& p : workload.keyCdf) {
+            p /= sum;
+        }
+    }
+
+    if (config.sslCert.empty() && config.sslKey.empty()) {
+        // Use normal authentication
+        if (config.password.empty()) {
+            const char* env_password = std::getenv("CB_PASSWORD");
+            if (env_password) {
+                config.password = env_password;
+            }
+        }
+
+        if (config.password == "-") {
+            config.password.assign(getpass());
+        }
+    }
+
+    try {
+        sa_family_t fam;
+        std::tie(config.host, config.port, fam) =
+                cb::inet::parse_hostname(host, port);
+
+        if (family == AF_UNSPEC) { // The user may have used -4 or -6
+            family = fam;
+        }
+        config.family = family;
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::random_device rd;
+        for (size_t ii = 0; ii < threads; ++ii) {
+            workers.push_back(
+                    std::make_unique<Worker>(workload, config, threads, rd()));
+        }
+
+        if (populate) {
+            std::vector<std::thread> populators;
+            for (size_t ii = 0; ii < threads; ++ii) {
+                populators.emplace_back([&workers, ii, threads]() {
+                    workers[ii]->populate(ii, threads);
+                });
+            }
+            for (auto& thread : populators) {
+                thread.join();
+            }
+        }
+
+        std::vector<std::thread> runners;
+        for (auto& worker : workers) {
+            runners.emplace_back([&worker]() { worker->run(); });
+        }
+        for (auto& thread : runners) {
+            thread.join();
+        }
+
+        std::array<OpStats, size_t(Operation::Count)> total;
+        std::chrono::steady_clock::duration elapsed{};
+        for (const auto& worker : workers) {
+            const auto& stats = worker->getStats();
+            for (size_t ii = 0; ii < total.size(); ++ii) {
+                total[ii].latency += stats[ii].latency;
+                total[ii].misses += stats[ii].misses;
+                for (const auto& error : stats[ii].errors) {
+                    total[ii].errors[error.first] += error.second;
+                }
+            }
+            elapsed = std::max(elapsed, worker->getElapsed());
+        }
+        printStats(total, elapsed, json);
+    } catch (const ConnectionError& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -28,11 +28,14 @@
 #include <utilities/terminate_handler.h>
 
 #include <strings.h>
+#include <algorithm>
 #include <array>
+#include <cinttypes>
 #include <cstdlib>
 #include <gsl/gsl>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #define JSON_DUMP_INDENT_SIZE 4
 
@@ -43,6 +46,8 @@ struct Bin {
     uint64_t cumulative_count;
 };
 
+// The timings returned by the stats which are histograms with fixed buckets
+// (e.g. "subdoc_execute").
 class Timings {
 public:
     Timings(nlohmann::json json) : max(0), ns(Bin()), oldwayout(false) {
@@ -225,6 +230,108 @@ private:
     uint64_t total;
 };
 
+/// Format a duration in microseconds with a readable unit
+static std::string format_usec(uint64_t usec) {
+    char buffer[32];
+    if (usec < 1000) {
+        snprintf(buffer, sizeof(buffer), "%" PRIu64 "us", usec);
+    } else if (usec < 1000 * 1000) {
+        snprintf(buffer, sizeof(buffer), "%.2fms", double(usec) / 1000);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.2fs", double(usec) / 1000000);
+    }
+    return buffer;
+}
+
+// The command timings (from GetCmdTimer): the buckets of a HdrHistogram of
+// microseconds which have any values recorded, and some percentiles.
+class HdrTimings {
+public:
+    explicit HdrTimings(const nlohmann::json& root) {
+        if (root.find("error") != root.end()) {
+            // The server responded with an error.. send that to the user
+            throw std::runtime_error(root["error"].get<std::string>());
+        }
+
+        total = root["total"].get<uint64_t>();
+        for (const auto& entry : root["percentiles"]) {
+            percentiles.emplace_back(entry[0].get<double>(),
+                                     entry[1].get<uint64_t>());
+        }
+        for (const auto& entry : root["data"]) {
+            data.emplace_back(entry[0].get<uint64_t>(),
+                              entry[1].get<uint64_t>());
+            max = std::max(max, data.back().second);
+        }
+    }
+
+    uint64_t getTotal() const {
+        return total;
+    }
+
+    void dumpHistogram(const std::string& opcode) {
+        std::cout << "The following data is collected for \"" << opcode
+                  << "\"" << std::endl;
+
+        // Determine how wide the max value would be, and pad all counts
+        // to that width.
+        const int max_width = snprintf(nullptr, 0, "%" PRIu64, max);
+        uint64_t low = 0;
+        uint64_t cumulative = 0;
+        for (const auto& bin : data) {
+            cumulative += bin.second;
+            char buffer[1024];
+            int offset = snprintf(buffer,
+                                  sizeof(buffer),
+                                  "[%8s - %8s] (%6.2f%%) %*" PRIu64 " | ",
+                                  format_usec(low).c_str(),
+                                  format_usec(bin.first).c_str(),
+                                  double(cumulative) * 100.0 / total,
+                                  max_width,
+                                  bin.second);
+            const int num = (int)(44.0 * (float)bin.second / (float)max);
+            for (int ii = 0; ii < num; ++ii) {
+                offset += snprintf(buffer + offset, sizeof(buffer) - offset, "#");
+            }
+            std::cout << buffer << std::endl;
+            low = bin.first + 1;
+        }
+        std::cout << "Total: " << total << " operations" << std::endl;
+        std::cout << getPercentiles() << std::endl;
+    }
+
+    /// @return the percentiles, e.g. "p50 12us, p90 20us, ..., max 1.20ms"
+    std::string getPercentiles() const {
+        std::string ret;
+        for (const auto& p : percentiles) {
+            if (!ret.empty()) {
+                ret += ", ";
+            }
+            if (p.first >= 100.0) {
+                ret += "max";
+            } else {
+                char buffer[32];
+                snprintf(buffer, sizeof(buffer), "p%g", p.first);
+                ret += buffer;
+            }
+            ret += " " + format_usec(p.second);
+        }
+        return ret;
+    }
+
+private:
+    uint64_t total = 0;
+
+    /// The largest count of any bucket (to scale the printout)
+    uint64_t max = 0;
+
+    /// (percentile, usec)
+    std::vector<std::pair<double, uint64_t>> percentiles;
+
+    /// (upper bound of the bucket in usec, count)
+    std::vector<std::pair<uint64_t, uint64_t>> data;
+};
+
 std::string opcode2string(cb::mcbp::ClientOpcode opcode) {
     try {
         return to_string(opcode);
@@ -286,7 +393,7 @@ static void request_cmd_timings(MemcachedConnection& connection,
                 std::cout << timings.dump(JSON_DUMP_INDENT_SIZE) << std::endl;
             }
         } else {
-            Timings timings(resp.getTimings());
+            HdrTimings timings(resp.getTimings());
 
             if (timings.getTotal() == 0) {
                 if (skip == 0) {
@@ -298,7 +405,8 @@ static void request_cmd_timings(MemcachedConnection& connection,
                     timings.dumpHistogram(command);
                 } else {
                     std::cout << command << " " << timings.getTotal()
-                              << " operations" << std::endl;
+                              << " operations (" << timings.getPercentiles()
+                              << ")" << std::endl;
                 }
             }
         }
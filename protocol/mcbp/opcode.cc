@@ -139,6 +139,7 @@ bool is_valid_opcode(ClientOpcode opcode) {
     case ClientOpcode::VbucketBatchCount:
     case ClientOpcode::DelWithMeta:
     case ClientOpcode::DelqWithMeta:
+    case ClientOpcode::WithMetaBatch:
     case ClientOpcode::CreateCheckpoint:
     case ClientOpcode::NotifyVbucketUpdate:
     case ClientOpcode::EnableTraffic:
@@ -434,6 +435,8 @@ std::string to_string(cb::mcbp::ClientOpcode opcode) {
         return "DEL_WITH_META";
     case ClientOpcode::DelqWithMeta:
         return "DELQ_WITH_META";
+    case ClientOpcode::WithMetaBatch:
+        return "WITH_META_BATCH";
     case ClientOpcode::CreateCheckpoint:
         return "CREATE_CHECKPOINT";
     case ClientOpcode::NotifyVbucketUpdate:
@@ -139,6 +139,7 @@ const std::map<cb::mcbp::ClientOpcode, std::string> client_blueprint = {
          {ClientOpcode::VbucketBatchCount, "VBUCKET_BATCH_COUNT"},
          {ClientOpcode::DelWithMeta, "DEL_WITH_META"},
          {ClientOpcode::DelqWithMeta, "DELQ_WITH_META"},
+         {ClientOpcode::WithMetaBatch, "WITH_META_BATCH"},
          {ClientOpcode::CreateCheckpoint, "CREATE_CHECKPOINT"},
          {ClientOpcode::NotifyVbucketUpdate, "NOTIFY_VBUCKET_UPDATE"},
          {ClientOpcode::EnableTraffic, "ENABLE_TRAFFIC"},
@@ -32,22 +32,24 @@ namespace mcbp {
 static bool reorderSupported(ClientOpcode opcode) {
     switch (opcode) {
     case ClientOpcode::Get:
-        return true;
     case ClientOpcode::Set:
     case ClientOpcode::Add:
     case ClientOpcode::Replace:
     case ClientOpcode::Delete:
     case ClientOpcode::Increment:
     case ClientOpcode::Decrement:
+    case ClientOpcode::Getk:
+    case ClientOpcode::Append:
+    case ClientOpcode::Prepend:
+    case ClientOpcode::Touch:
+    case ClientOpcode::Gat:
+        return true;
     case ClientOpcode::Quit:
     case ClientOpcode::Flush:
     case ClientOpcode::Getq:
     case ClientOpcode::Noop:
     case ClientOpcode::Version:
-    case ClientOpcode::Getk:
     case ClientOpcode::Getkq:
-    case ClientOpcode::Append:
-    case ClientOpcode::Prepend:
     case ClientOpcode::Stat:
     case ClientOpcode::Setq:
     case ClientOpcode::Addq:
@@ -60,8 +62,6 @@ static bool reorderSupported(ClientOpcode opcode) {
     case ClientOpcode::Appendq:
     case ClientOpcode::Prependq:
     case ClientOpcode::Verbosity:
-    case ClientOpcode::Touch:
-    case ClientOpcode::Gat:
     case ClientOpcode::Gatq:
     case ClientOpcode::Hello:
     case ClientOpcode::SaslListMechs:
@@ -144,6 +144,7 @@ static bool reorderSupported(ClientOpcode opcode) {
     case ClientOpcode::SnapshotVbStates:
     case ClientOpcode::VbucketBatchCount:
     case ClientOpcode::DelWithMeta:
+    case ClientOpcode::WithMetaBatch:
     case ClientOpcode::DelqWithMeta:
     case ClientOpcode::CreateCheckpoint:
     case ClientOpcode::NotifyVbucketUpdate:
@@ -376,6 +377,7 @@ bool Request::isQuiet() const {
         case ClientOpcode::SnapshotVbStates:
         case ClientOpcode::VbucketBatchCount:
         case ClientOpcode::DelWithMeta:
+        case ClientOpcode::WithMetaBatch:
         case ClientOpcode::CreateCheckpoint:
         case ClientOpcode::NotifyVbucketUpdate:
         case ClientOpcode::EnableTraffic:
@@ -487,9 +489,9 @@ Request::getDurabilityRequirements() const {
     return {};
 }
 
-bool Request::mayReorder(const Request& other) const {
-    if (!reorderSupported(getClientOpcode()) ||
-        !reorderSupported(other.getClientOpcode())) {
+bool Request::mayReorder() const {
+    if (!is_client_magic(getMagic()) ||
+        !reorderSupported(getClientOpcode())) {
         return false;
     }
 
@@ -505,26 +507,13 @@ bool Request::mayReorder(const Request& other) const {
         return true;
     });
 
-    if (!allowReorder) {
-        // This command don't allow for reordering of commands
-        return false;
-    }
-
-    allowReorder = false;
-    other.parseFrameExtras([&allowReorder](cb::mcbp::request::FrameInfoId id,
-                                           cb::const_byte_buffer data) -> bool {
-        if (id == cb::mcbp::request::FrameInfoId::Reorder) {
-            allowReorder = true;
-            // stop parsing
-            return false;
-        }
-        // Continue parsing
-        return true;
-    });
-
     return allowReorder;
 }
 
+bool Request::mayReorder(const Request& other) const {
+    return mayReorder() && other.mayReorder();
+}
+
 nlohmann::json Request::toJSON() const {
     if (!isValid()) {
         throw std::logic_error("Request::toJSON(): Invalid packet");
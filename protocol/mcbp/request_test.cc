@@ -295,3 +295,15 @@ TEST(Request_MayReorder, both_do_opcode_do) {
     EXPECT_TRUE(m.mayReorder(o));
     EXPECT_TRUE(o.mayReorder(m));
 }
+
+TEST(Request_MayReorder, single) {
+    auto get = buildPacket(ClientOpcode::Get, true);
+    auto set = buildPacket(ClientOpcode::Set, true);
+    auto unflagged = buildPacket(ClientOpcode::Get, false);
+    auto hello = buildPacket(ClientOpcode::Hello, true);
+
+    EXPECT_TRUE(reinterpret_cast<Request*>(get.data())->mayReorder());
+    EXPECT_TRUE(reinterpret_cast<Request*>(set.data())->mayReorder());
+    EXPECT_FALSE(reinterpret_cast<Request*>(unflagged.data())->mayReorder());
+    EXPECT_FALSE(reinterpret_cast<Request*>(hello.data())->mayReorder());
+}
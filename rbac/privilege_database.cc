@@ -33,13 +33,25 @@ namespace rbac {
 
 struct DatabaseContext {
     // Every time we create a new PrivilegeDatabase we bump the generation.
-    // The PrivilegeContext contains the generation number it was generated
-    // from so that we can easily detect if the PrivilegeContext is stale.
     std::atomic<uint32_t> generation{0};
 
-    // The read write lock needed when you want to build a context
+    // The generation of the database currently in use. The PrivilegeContext
+    // contains the generation number it was generated from so that we can
+    // easily detect if the PrivilegeContext is stale. (A database being
+    // built doesn't make the contexts stale until it is installed.)
+    std::atomic<uint32_t> current{0};
+
+    // The read write lock needed when you want to install a new database,
+    // or a thread wants a reference to the current one
     cb::RWLock rwlock;
-    std::unique_ptr<PrivilegeDatabase> db;
+    std::shared_ptr<const PrivilegeDatabase> db;
+
+    /// Install a new database. Must be called with the write lock held
+    void install(std::unique_ptr<PrivilegeDatabase> database) {
+        const auto gen = database->generation;
+        db = std::move(database);
+        current.store(gen);
+    }
 };
 
 /// We keep one context for the local scope, and one for the external
@@ -58,6 +70,29 @@ static int to_index(Domain domain) {
     throw std::invalid_argument("to_index(): Invalid domain provided");
 }
 
+/**
+ * Get the database currently in use for the domain.
+ *
+ * Each thread keeps a reference to the database it last used, so the lock
+ * is only needed the first time a thread sees a new generation of the
+ * database. (All of the connections served by a thread refreshing their
+ * stale contexts after a reload share that one lookup rather than
+ * contending on the lock.)
+ *
+ * @return the database, valid until the next call from this thread
+ */
+static const PrivilegeDatabase& getDatabase(Domain domain) {
+    static thread_local std::shared_ptr<const PrivilegeDatabase> cached[2];
+    const auto idx = to_index(domain);
+    auto& ctx = contexts[idx];
+    auto& db = cached[idx];
+    if (!db || db->generation != ctx.current.load()) {
+        std::lock_guard<cb::ReaderLock> guard(ctx.rwlock.reader());
+        db = ctx.db;
+    }
+    return *db;
+}
+
 bool UserEntry::operator==(const UserEntry& other) const {
     return (internal == other.internal && privileges == other.privileges &&
             buckets == other.buckets);
@@ -266,7 +301,7 @@ PrivilegeAccess PrivilegeDatabase::check(const PrivilegeContext& context,
 }
 
 PrivilegeAccess PrivilegeContext::check(Privilege privilege) const {
-    if (generation != contexts[to_index(domain)].generation) {
+    if (generation != contexts[to_index(domain)].current) {
         return PrivilegeAccess::Stale;
     }
 
@@ -341,16 +376,12 @@ void PrivilegeContext::setBucketPrivilegeBits(bool value) {
 PrivilegeContext createContext(const std::string& user,
                                Domain domain,
                                const std::string& bucket) {
-    auto& ctx = contexts[to_index(domain)];
-    std::lock_guard<cb::ReaderLock> guard(ctx.rwlock.reader());
-    return ctx.db->createContext(user, domain, bucket);
+    return getDatabase(domain).createContext(user, domain, bucket);
 }
 
 std::pair<PrivilegeContext, bool> createInitialContext(const std::string& user,
                                                        Domain domain) {
-    auto& ctx = contexts[to_index(domain)];
-    std::lock_guard<cb::ReaderLock> guard(ctx.rwlock.reader());
-    return ctx.db->createInitialContext(user, domain);
+    return getDatabase(domain).createInitialContext(user, domain);
 }
 
 void loadPrivilegeDatabase(const std::string& filename) {
@@ -362,18 +393,20 @@ void loadPrivilegeDatabase(const std::string& filename) {
     std::lock_guard<cb::WriterLock> guard(ctx.rwlock.writer());
     // Handle race conditions
     if (ctx.db->generation < database->generation) {
-        ctx.db.swap(database);
+        ctx.install(std::move(database));
     }
 }
 
 void initialize() {
     // Create an empty database to avoid having to add checks
     // if it exists or not...
-    contexts[to_index(Domain::Local)].db = std::make_unique<PrivilegeDatabase>(
-            nlohmann::json{}, Domain::Local);
-    contexts[to_index(Domain::External)].db =
-            std::make_unique<PrivilegeDatabase>(nlohmann::json{},
-                                                Domain::External);
+    for (auto domain : {Domain::Local, Domain::External}) {
+        auto& ctx = contexts[to_index(domain)];
+        auto database =
+                std::make_unique<PrivilegeDatabase>(nlohmann::json{}, domain);
+        std::lock_guard<cb::WriterLock> guard(ctx.rwlock.writer());
+        ctx.install(std::move(database));
+    }
 }
 
 void destroy() {
@@ -407,7 +440,7 @@ void updateExternalUser(const std::string& descr) {
     auto next = ctx.db->updateUser(username, Domain::External, entry);
     if (next) {
         // I changed the database.. swap
-        ctx.db.swap(next);
+        ctx.install(std::move(next));
     }
 }
 
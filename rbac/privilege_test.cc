@@ -145,3 +145,37 @@ TEST(PrivilegeDatabaseTest, to_json) {
     cb::rbac::PrivilegeDatabase db(json, cb::rbac::Domain::External);
     EXPECT_EQ(json.dump(2), db.to_json(cb::rbac::Domain::External).dump(2));
 }
+
+// Privilege contexts only become stale once a new database is installed,
+// and then pick up the new privileges.
+TEST(PrivilegeDatabaseTest, StaleContext) {
+    cb::rbac::initialize();
+
+    nlohmann::json json;
+    json["trond"]["privileges"] = {"Audit"};
+    json["trond"]["domain"] = "external";
+    cb::rbac::updateExternalUser(json.dump());
+
+    auto context = cb::rbac::createContext(
+            "trond", cb::rbac::Domain::External, "");
+    EXPECT_EQ(cb::rbac::PrivilegeAccess::Ok,
+              context.check(cb::rbac::Privilege::Audit));
+
+    // A database being built must not invalidate the contexts in use
+    cb::rbac::PrivilegeDatabase db(nullptr, cb::rbac::Domain::External);
+    EXPECT_EQ(cb::rbac::PrivilegeAccess::Ok,
+              context.check(cb::rbac::Privilege::Audit));
+
+    json["trond"]["privileges"] = {"BucketManagement"};
+    cb::rbac::updateExternalUser(json.dump());
+    EXPECT_EQ(cb::rbac::PrivilegeAccess::Stale,
+              context.check(cb::rbac::Privilege::Audit));
+
+    context = cb::rbac::createContext("trond", cb::rbac::Domain::External, "");
+    EXPECT_EQ(cb::rbac::PrivilegeAccess::Fail,
+              context.check(cb::rbac::Privilege::Audit));
+    EXPECT_EQ(cb::rbac::PrivilegeAccess::Ok,
+              context.check(cb::rbac::Privilege::BucketManagement));
+
+    cb::rbac::destroy();
+}
@@ -0,0 +1,339 @@
+#!/usr/bin/env python2.7
+
+"""
+Copyright 2019 Couchbase, Inc
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+This script compares the results of a Google Benchmark testsuite (such as
+ep_engine_benchmarks) with a stored baseline, and reports the change of each
+benchmark. A benchmark is only reported as a regression (or improvement) if
+the change is larger than the noise seen across its repetitions, and the
+two sets of repetitions differ significantly (Mann-Whitney U test).
+
+The results are either read from a JSON file written by the benchmark
+(--benchmark_out_format=json), or the benchmark binary is run (all
+benchmarks by default) with the requested number of repetitions.
+
+Create a baseline (on the machine the comparisons will run on):
+
+    python benchmark_compare.py -B build/kv_engine/ep_engine_benchmarks
+        -r 5 --baseline ep_benchmarks_baseline.json --update_baseline
+
+Compare with it:
+
+    python benchmark_compare.py -B build/kv_engine/ep_engine_benchmarks
+        -r 5 --baseline ep_benchmarks_baseline.json -o report.txt
+
+Exits with 1 if any benchmark regressed, 2 for usage errors and -1 if a
+file or the benchmark can't be read or run.
+"""
+
+from __future__ import print_function
+
+import json
+import math
+import optparse
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def convert_time(input_time, input_format, desired_format):
+    units = {"s": 1, "ms": 1000, "us": 1000000, "ns": 1000000000}
+    return float(input_time) * units[desired_format] / units[input_format]
+
+
+def run_benchmark(binary, benchmark_filter, repetitions, output):
+    """Run the benchmark binary, writing the JSON results to output."""
+    command = [binary,
+               '--benchmark_out_format=json',
+               '--benchmark_out={}'.format(output),
+               '--benchmark_repetitions={}'.format(repetitions)]
+    if benchmark_filter:
+        command.append('--benchmark_filter={}'.format(benchmark_filter))
+    print('Running: {}'.format(' '.join(command)), file=sys.stderr)
+    try:
+        subprocess.check_call(command, stdout=sys.stderr)
+    except (OSError, subprocess.CalledProcessError) as e:
+        print('Failed to run the benchmark:\n\t {}'.format(e))
+        sys.exit(-1)
+
+
+def load_results(path):
+    try:
+        with open(path, 'r') as f:
+            return json.load(f)
+    except (IOError, ValueError) as e:
+        print('Failed to load JSON data from {}:\n\t {}'.format(path, e))
+        sys.exit(-1)
+
+
+def collect_samples(json_data, metric):
+    """
+    Return a dictionary of benchmark name to the list of values of metric
+    (one per repetition), in ns for the time metrics. The aggregates Google
+    Benchmark adds for repetitions (mean, median, stddev) are skipped.
+    """
+    samples = {}
+    for test in json_data['benchmarks']:
+        if test.get('run_type') == 'aggregate':
+            continue
+        name = test.get('run_name', test['name'])
+        if (test.get('run_type') is None and
+                name.endswith(('_mean', '_median', '_stddev'))):
+            continue
+        if metric not in test:
+            continue
+        value = float(test[metric])
+        if metric in ('real_time', 'cpu_time'):
+            value = convert_time(value, test.get('time_unit', 'ns'), 'ns')
+        samples.setdefault(name, []).append(value)
+    return samples
+
+
+def mean(values):
+    return sum(values) / len(values)
+
+
+def stddev(values):
+    if len(values) < 2:
+        return 0.0
+    m = mean(values)
+    return math.sqrt(sum((v - m) ** 2 for v in values) / (len(values) - 1))
+
+
+def mann_whitney_p(a, b):
+    """
+    Two sided p-value of the Mann-Whitney U test, using the normal
+    approximation (with a tie correction). Returns 1.0 if there are too few
+    samples for the approximation to mean anything.
+    """
+    n1 = len(a)
+    n2 = len(b)
+    if n1 < 3 or n2 < 3:
+        return 1.0
+
+    ranked = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+    ranks = [0.0] * len(ranked)
+    ties = 0.0
+    ii = 0
+    while ii < len(ranked):
+        jj = ii
+        while jj + 1 < len(ranked) and ranked[jj + 1][0] == ranked[ii][0]:
+            jj += 1
+        for kk in range(ii, jj + 1):
+            ranks[kk] = (ii + jj) / 2.0 + 1
+        count = jj - ii + 1
+        ties += count ** 3 - count
+        ii = jj + 1
+
+    r1 = sum(rank for rank, (_, group) in zip(ranks, ranked) if group == 0)
+    u1 = r1 - n1 * (n1 + 1) / 2.0
+    n = n1 + n2
+    variance = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)))
+    if variance <= 0:
+        return 1.0
+    z = (u1 - n1 * n2 / 2.0) / math.sqrt(variance)
+    return math.erfc(abs(z) / math.sqrt(2))
+
+
+def compare(baseline, current, options):
+    """
+    Compare each benchmark, returning a list of rows of:
+        (name, baseline mean, current mean, change %, threshold %, verdict)
+    For time metrics lower is better; for other metrics (e.g counters such
+    as items_per_second) higher is better, unless --lower_is_better is set.
+    """
+    lower_is_better = (options.metric in ('real_time', 'cpu_time') or
+                       options.lower_is_better)
+    rows = []
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            rows.append((name, mean(baseline[name]), None, None, None,
+                         'MISSING'))
+            continue
+        if name not in baseline:
+            rows.append((name, None, mean(current[name]), None, None, 'NEW'))
+            continue
+
+        base = baseline[name]
+        cur = current[name]
+        base_mean = mean(base)
+        cur_mean = mean(cur)
+        if base_mean == 0:
+            rows.append((name, base_mean, cur_mean, None, None, 'same'))
+            continue
+
+        change = (cur_mean - base_mean) / base_mean * 100
+        # The noise is the larger relative standard deviation of the two
+        # sets, scaled by the requested number of deviations, and never less
+        # than the minimum threshold.
+        noise = max(stddev(base) / base_mean,
+                    stddev(cur) / cur_mean if cur_mean else 0) * 100
+        threshold = max(options.threshold, options.deviations * noise)
+
+        verdict = 'same'
+        if abs(change) > threshold and (
+                mann_whitney_p(base, cur) < options.alpha or
+                min(len(base), len(cur)) < 3):
+            worse = change > 0 if lower_is_better else change < 0
+            verdict = 'REGRESSION' if worse else 'improvement'
+        rows.append((name, base_mean, cur_mean, change, threshold, verdict))
+    return rows
+
+
+def format_report(rows, metric):
+    def value(v):
+        return '-' if v is None else '{:.2f}'.format(v)
+
+    def percent(v):
+        return '-' if v is None else '{:+.1f}%'.format(v)
+
+    width = max([len('Benchmark')] + [len(row[0]) for row in rows])
+    unit = ' (ns)' if metric in ('real_time', 'cpu_time') else ''
+    lines = ['{:<{w}}  {:>14}  {:>14}  {:>9}  {:>9}  {}'.format(
+        'Benchmark', 'Baseline' + unit, 'Current' + unit, 'Change',
+        'Threshold', 'Verdict', w=width)]
+    for name, base, cur, change, threshold, verdict in rows:
+        lines.append('{:<{w}}  {:>14}  {:>14}  {:>9}  {:>9}  {}'.format(
+            name, value(base), value(cur), percent(change),
+            '-' if threshold is None else '{:.1f}%'.format(threshold),
+            verdict, w=width))
+
+    counts = {}
+    for row in rows:
+        counts[row[5]] = counts.get(row[5], 0) + 1
+    lines.append('')
+    lines.append('{} benchmarks: '.format(len(rows)) + ', '.join(
+        '{} {}'.format(counts[k], k) for k in sorted(counts)))
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    parser = optparse.OptionParser()
+    required_args = optparse.OptionGroup(parser, 'Required Arguments')
+    required_args.add_option('--baseline', action='store', type='string',
+                             dest='baseline',
+                             help='The stored baseline (JSON output from '
+                                  'Google Benchmark)')
+    parser.add_option_group(required_args)
+
+    input_args = optparse.OptionGroup(
+        parser, 'Current results (one of)')
+    input_args.add_option('-B', '--binary', action='store', type='string',
+                          dest='binary',
+                          help='The benchmark binary to run, for example '
+                               'build/kv_engine/ep_engine_benchmarks')
+    input_args.add_option('-b', '--benchmark_file', action='store',
+                          type='string', dest='input_file',
+                          help='JSON output from an earlier run of the '
+                               'benchmark')
+    parser.add_option_group(input_args)
+
+    optional_args = optparse.OptionGroup(parser, 'Optional Arguments')
+    optional_args.add_option('-f', '--filter', action='store', type='string',
+                             dest='filter', default='',
+                             help='Only run the benchmarks matching this '
+                                  'regex (default all)')
+    optional_args.add_option('-r', '--repetitions', action='store',
+                             type='int', dest='repetitions', default=5,
+                             help='Repetitions of each benchmark when '
+                                  'running it [default: %default]')
+    optional_args.add_option('-m', '--metric', action='store', type='string',
+                             dest='metric', default='real_time',
+                             help='The value to compare; real_time, '
+                                  'cpu_time or the name of a counter '
+                                  '[default: %default]')
+    optional_args.add_option('--lower_is_better', action='store_true',
+                             dest='lower_is_better', default=False,
+                             help='Lower values of the (counter) metric are '
+                                  'better')
+    optional_args.add_option('-t', '--threshold', action='store',
+                             type='float', dest='threshold', default=5.0,
+                             help='Minimum change (in percent) to report '
+                                  '[default: %default]')
+    optional_args.add_option('-d', '--deviations', action='store',
+                             type='float', dest='deviations', default=2.0,
+                             help='Changes smaller than this many relative '
+                                  'standard deviations are noise '
+                                  '[default: %default]')
+    optional_args.add_option('-a', '--alpha', action='store', type='float',
+                             dest='alpha', default=0.05,
+                             help='Significance level of the Mann-Whitney U '
+                                  'test [default: %default]')
+    optional_args.add_option('-o', '--output_file', action='store',
+                             type='string', dest='output_file', default='',
+                             help='Write the report to this file as well as '
+                                  'stdout')
+    optional_args.add_option('-u', '--update_baseline', action='store_true',
+                             dest='update_baseline', default=False,
+                             help='Store the current results as the baseline '
+                                  'instead of comparing with it')
+    parser.add_option_group(optional_args)
+    (options, args) = parser.parse_args()
+
+    if len(args) != 0:
+        print('benchmark_compare does not take any direct arguments')
+        parser.print_help()
+        sys.exit(2)
+    if not options.baseline or (bool(options.binary) ==
+                                bool(options.input_file)):
+        print('--baseline and one of --binary or --benchmark_file must be '
+              'set')
+        parser.print_help()
+        sys.exit(2)
+
+    input_file = options.input_file
+    temporary = None
+    if options.binary:
+        fd, temporary = tempfile.mkstemp(suffix='.json')
+        os.close(fd)
+        run_benchmark(options.binary, options.filter, options.repetitions,
+                      temporary)
+        input_file = temporary
+
+    current_data = load_results(input_file)
+    if temporary:
+        os.remove(temporary)
+
+    if options.update_baseline:
+        try:
+            with open(options.baseline, 'w') as f:
+                json.dump(current_data, f, indent=2)
+        except IOError as e:
+            print('Failed to write the baseline:\n\t {}'.format(e))
+            sys.exit(-1)
+        print('Stored {} results as the baseline in {}'.format(
+            len(current_data['benchmarks']), options.baseline))
+        return 0
+
+    baseline = collect_samples(load_results(options.baseline), options.metric)
+    current = collect_samples(current_data, options.metric)
+    rows = compare(baseline, current, options)
+    report = format_report(rows, options.metric)
+    sys.stdout.write(report)
+    if options.output_file:
+        try:
+            with open(options.output_file, 'w') as f:
+                f.write(report)
+        except IOError as e:
+            print('Failed to write the report:\n\t {}'.format(e))
+            sys.exit(-1)
+
+    return 1 if any(row[5] == 'REGRESSION' for row in rows) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -252,6 +252,48 @@ TEST_F(SettingsTest, Threads) {
     }
 }
 
+TEST_F(SettingsTest, DcpThreads) {
+    nonNumericValuesShouldFail("dcp_threads");
+
+    nlohmann::json json;
+    json["threads"] = 4;
+    json["dcp_threads"] = 2;
+    try {
+        Settings settings(json);
+        EXPECT_EQ(2, settings.getNumDcpThreads());
+        EXPECT_TRUE(settings.has.dcp_threads);
+        EXPECT_EQ(6, settings.getNumFrontEndThreads());
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    // It can't be changed at runtime
+    Settings settings(json);
+    json["dcp_threads"] = 3;
+    EXPECT_THROW(settings.updateSettings(Settings(json)),
+                 std::invalid_argument);
+}
+
+TEST_F(SettingsTest, WorkerThreadGroups) {
+    nonNumericValuesShouldFail("worker_thread_groups");
+
+    nlohmann::json json;
+    json["worker_thread_groups"] = 2;
+    try {
+        Settings settings(json);
+        EXPECT_EQ(2, settings.getNumWorkerThreadGroups());
+        EXPECT_TRUE(settings.has.worker_thread_groups);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    // It can't be changed at runtime
+    Settings settings(json);
+    json["worker_thread_groups"] = 3;
+    EXPECT_THROW(settings.updateSettings(Settings(json)),
+                 std::invalid_argument);
+}
+
 TEST_F(SettingsTest, Interfaces) {
     nonArrayValuesShouldFail("interfaces");
 
@@ -462,6 +504,40 @@ TEST_F(SettingsTest, InterfacesInvalidProtocolString) {
     expectFail<std::invalid_argument>(root);
 }
 
+#ifndef WIN32
+/// Test that a Unix domain socket path is accepted, and bad ones rejected.
+TEST_F(SettingsTest, InterfacesUnixDomainPath) {
+    nlohmann::json obj;
+    obj["port"] = 11999;
+    obj["path"] = "/tmp/memcached.sock";
+
+    nlohmann::json array;
+    array.push_back(obj);
+
+    nlohmann::json root;
+    root["interfaces"] = array;
+
+    try {
+        Settings settings(root);
+        ASSERT_EQ(1, settings.getInterfaces().size());
+        const auto& ifc0 = settings.getInterfaces()[0];
+        EXPECT_EQ("/tmp/memcached.sock", ifc0.path);
+        EXPECT_EQ(11999, ifc0.port);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    root["interfaces"][0]["path"] = "";
+    expectFail<std::invalid_argument>(root);
+
+    root["interfaces"][0]["path"] = std::string(200, 'a');
+    expectFail<std::invalid_argument>(root);
+
+    root["interfaces"][0]["path"] = 1;
+    expectFail<nlohmann::json::exception>(root);
+}
+#endif
+
 TEST_F(SettingsTest, ParseLoggerSettings) {
     nonObjectValuesShouldFail("logger");
 
@@ -507,6 +583,105 @@ TEST_F(SettingsTest, StdinListener) {
     }
 }
 
+TEST_F(SettingsTest, ReuseportListeners) {
+    nonBooleanValuesShouldFail("reuseport_listeners");
+
+    nlohmann::json obj;
+    obj["reuseport_listeners"] = true;
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isReuseportListenersEnabled());
+        EXPECT_TRUE(settings.has.reuseport_listeners);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj["reuseport_listeners"] = false;
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isReuseportListenersEnabled());
+        EXPECT_TRUE(settings.has.reuseport_listeners);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    // Not enabled by default, and can't be changed at runtime
+    Settings settings;
+    EXPECT_FALSE(settings.isReuseportListenersEnabled());
+    Settings updated(obj);
+    updated.setReuseportListenersEnabled(true);
+    EXPECT_THROW(settings.updateSettings(updated, false),
+                 std::invalid_argument);
+}
+
+TEST_F(SettingsTest, EventBackend) {
+    nonStringValuesShouldFail("event_backend");
+
+    nlohmann::json obj;
+    obj["event_backend"] = "poll";
+    try {
+        Settings settings(obj);
+        EXPECT_EQ("poll", settings.getEventBackend());
+        EXPECT_TRUE(settings.has.event_backend);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    // The default backend by default, and can't be changed at runtime
+    Settings settings;
+    EXPECT_TRUE(settings.getEventBackend().empty());
+    Settings updated(obj);
+    EXPECT_THROW(settings.updateSettings(updated, false),
+                 std::invalid_argument);
+}
+
+TEST_F(SettingsTest, EventChangelist) {
+    nonBooleanValuesShouldFail("event_changelist");
+
+    nlohmann::json obj;
+    obj["event_changelist"] = true;
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isEventChangelistEnabled());
+        EXPECT_TRUE(settings.has.event_changelist);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    // Not enabled by default, and can't be changed at runtime
+    Settings settings;
+    EXPECT_FALSE(settings.isEventChangelistEnabled());
+    Settings updated(obj);
+    EXPECT_THROW(settings.updateSettings(updated, false),
+                 std::invalid_argument);
+}
+
+TEST_F(SettingsTest, WorkerCpuAffinity) {
+    nonStringValuesShouldFail("worker_cpu_affinity");
+
+    nlohmann::json obj;
+    obj["worker_cpu_affinity"] = "0-1,4";
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(std::vector<int>({0, 1, 4}),
+                  settings.getWorkerCpuAffinity());
+        EXPECT_TRUE(settings.has.worker_cpu_affinity);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    nlohmann::json invalid;
+    invalid["worker_cpu_affinity"] = "3-1";
+    expectFail<std::invalid_argument>(invalid);
+
+    // Not pinned by default, and can't be changed at runtime
+    Settings settings;
+    EXPECT_TRUE(settings.getWorkerCpuAffinity().empty());
+    Settings updated(obj);
+    EXPECT_THROW(settings.updateSettings(updated, false),
+                 std::invalid_argument);
+}
+
 TEST_F(SettingsTest, TopkeysEnabled) {
     nonBooleanValuesShouldFail("topkeys_enabled");
 
@@ -895,6 +1070,29 @@ TEST_F(SettingsTest, DedupeNmvbMaps) {
     }
 }
 
+TEST_F(SettingsTest, CoalesceResponses) {
+    nonBooleanValuesShouldFail("coalesce_responses");
+
+    nlohmann::json obj;
+    obj["coalesce_responses"] = true;
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isCoalesceResponses());
+        EXPECT_TRUE(settings.has.coalesce_responses);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj["coalesce_responses"] = false;
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isCoalesceResponses());
+        EXPECT_TRUE(settings.has.coalesce_responses);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST_F(SettingsTest, XattrEnabled) {
     nonBooleanValuesShouldFail("xattr_enabled");
 
@@ -918,6 +1116,48 @@ TEST_F(SettingsTest, XattrEnabled) {
     }
 }
 
+TEST_F(SettingsTest, SubdocPathCacheSize) {
+    nonNumericValuesShouldFail("subdoc_path_cache_size");
+
+    nlohmann::json obj;
+    obj["subdoc_path_cache_size"] = 100;
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(100, settings.getSubdocPathCacheSize());
+        EXPECT_TRUE(settings.has.subdoc_path_cache_size);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, StreamedValueThreshold) {
+    nonNumericValuesShouldFail("streamed_value_threshold");
+
+    nlohmann::json obj;
+    obj["streamed_value_threshold"] = 4096;
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(4096, settings.getStreamedValueThreshold());
+        EXPECT_TRUE(settings.has.streamed_value_threshold);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, TraceSampleRate) {
+    nonNumericValuesShouldFail("trace_sample_rate");
+
+    nlohmann::json obj;
+    obj["trace_sample_rate"] = 10;
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(10, settings.getTraceSampleRate());
+        EXPECT_TRUE(settings.has.trace_sample_rate);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST_F(SettingsTest, TracingEnabled) {
     nonBooleanValuesShouldFail("tracing_enabled");
 
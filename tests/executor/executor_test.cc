@@ -24,7 +24,9 @@
 #include <gtest/gtest.h>
 #include <phosphor/phosphor.h>
 #include <platform/backtrace.h>
+#include <algorithm>
 #include <atomic>
+#include <future>
 #include <memory>
 
 class ExecutorTest : public ::testing::Test {
@@ -297,6 +299,125 @@ TEST_F(ExecutorTest, PeriodicExecution) {
     EXPECT_TRUE(cmd->executionComplete);
 }
 
+/**
+ * A (high priority) task which blocks the executor running it until
+ * released.
+ */
+class BlockingTestTask : public Task {
+public:
+    Status execute() override {
+        started.set_value();
+        release.get_future().wait();
+        return Status::Finished;
+    }
+
+    Priority getPriority() const override {
+        return Priority::High;
+    }
+
+    std::promise<void> started;
+    std::promise<void> release;
+};
+
+/**
+ * A task of a given priority which records the order it ran in.
+ */
+class PriorityTestTask : public Task {
+public:
+    struct Log {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::vector<int> order;
+        size_t complete = 0;
+    };
+
+    PriorityTestTask(Log& log, int id, Priority priority)
+        : log(log), id(id), priority(priority) {
+    }
+
+    Status execute() override {
+        std::lock_guard<std::mutex> lh(log.mutex);
+        log.order.push_back(id);
+        return Status::Finished;
+    }
+
+    void notifyExecutionComplete() override {
+        std::lock_guard<std::mutex> lh(log.mutex);
+        ++log.complete;
+        log.cond.notify_all();
+    }
+
+    Priority getPriority() const override {
+        return priority;
+    }
+
+    Log& log;
+    const int id;
+    const Priority priority;
+};
+
+class ExecutorPriorityTest : public ExecutorTest {
+protected:
+    void SetUp() override {
+        // A single executor, so the tasks queue up behind each other
+        executorpool = std::make_unique<ExecutorPool>(1);
+    }
+
+    /**
+     * Run the tasks with the given priorities, all queued up before the
+     * first of them runs.
+     *
+     * @return the indexes of the tasks in the order they ran
+     */
+    std::vector<int> run(const std::vector<Task::Priority>& priorities) {
+        auto blocker = std::make_shared<BlockingTestTask>();
+        {
+            std::shared_ptr<Task> task = blocker;
+            std::lock_guard<std::mutex> guard(task->getMutex());
+            executorpool->schedule(task);
+        }
+        blocker->started.get_future().wait();
+
+        PriorityTestTask::Log log;
+        for (size_t ii = 0; ii < priorities.size(); ++ii) {
+            std::shared_ptr<Task> task = std::make_shared<PriorityTestTask>(
+                    log, int(ii), priorities[ii]);
+            std::lock_guard<std::mutex> guard(task->getMutex());
+            executorpool->schedule(task);
+        }
+        EXPECT_EQ(priorities.size(), executorpool->runqSize());
+        blocker->release.set_value();
+
+        std::unique_lock<std::mutex> lh(log.mutex);
+        log.cond.wait(lh, [&log, &priorities]() {
+            return log.complete == priorities.size();
+        });
+        return log.order;
+    }
+};
+
+TEST_F(ExecutorPriorityTest, HighRunsFirst) {
+    using Priority = Task::Priority;
+    EXPECT_EQ(std::vector<int>({3, 1, 2, 0}),
+              run({Priority::Low,
+                   Priority::Normal,
+                   Priority::Normal,
+                   Priority::High}));
+}
+
+// A burst of tasks in one lane delays, but doesn't starve, the other lanes
+TEST_F(ExecutorPriorityTest, LowIsNotStarved) {
+    using Priority = Task::Priority;
+    std::vector<Priority> priorities(10, Priority::High);
+    priorities.push_back(Priority::Low);
+
+    const auto order = run(priorities);
+    ASSERT_EQ(priorities.size(), order.size());
+    const auto low = std::find(order.begin(), order.end(), 10);
+    EXPECT_GE(Executor::getLaneWeight(Priority::High),
+              std::distance(order.begin(), low));
+}
+
 using StaleTraceDumpRemoverTest = ExecutorTest;
 
 /**
@@ -20,16 +20,21 @@
  * C++ libraries Each library has the test implemented in its "standard" way so
  * we can compare the performance against each other. This is not intended to be
  * a complete performance test of either library.
+ *
+ * It also compares validating JSON (as done for datatype detection) with
+ * JSON_checker and with cb::json::Validator.
  */
 
 #include "config.h"
 
+#include <JSON_checker.h>
 #include <benchmark/benchmark.h>
 #include <cJSON.h>
 #include <cJSON_utils.h>
 #include <gtest/gtest.h>
 #include <nlohmann/json.hpp>
 #include <platform/dirutils.h>
+#include <utilities/json_validator.h>
 
 class JSONBenchmark : public ::benchmark::Fixture {
     void SetUp(benchmark::State& st) override {
@@ -229,6 +234,53 @@ BENCHMARK_DEFINE_F(JSONBenchmark, cJSON_FindElement_NotExists)
     }
 }
 
+BENCHMARK_DEFINE_F(JSONBenchmark, JSONChecker_Validate)
+(benchmark::State& state) {
+    JSON_checker::Validator validator;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(validator.validate(
+                reinterpret_cast<const uint8_t*>(loaded_json.data()),
+                loaded_json.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * loaded_json.size());
+}
+
+BENCHMARK_DEFINE_F(JSONBenchmark, Validator_Validate)
+(benchmark::State& state) {
+    cb::json::Validator validator;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(validator.validate(
+                reinterpret_cast<const uint8_t*>(loaded_json.data()),
+                loaded_json.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * loaded_json.size());
+}
+
+// A value which isn't JSON (but is mostly text, so isn't rejected early).
+BENCHMARK_DEFINE_F(JSONBenchmark, JSONChecker_ValidateNotJSON)
+(benchmark::State& state) {
+    JSON_checker::Validator validator;
+    auto value = loaded_json;
+    value.back() = ',';
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(validator.validate(
+                reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * value.size());
+}
+
+BENCHMARK_DEFINE_F(JSONBenchmark, Validator_ValidateNotJSON)
+(benchmark::State& state) {
+    cb::json::Validator validator;
+    auto value = loaded_json;
+    value.back() = ',';
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(validator.validate(
+                reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * value.size());
+}
+
 BENCHMARK_REGISTER_F(JSONBenchmark, JMC_ParseFile);
 BENCHMARK_REGISTER_F(JSONBenchmark, cJSON_ParseFile);
 BENCHMARK_REGISTER_F(JSONBenchmark, JMC_AddStringToJson)
@@ -257,5 +309,9 @@ BENCHMARK_REGISTER_F(JSONBenchmark, JMC_FindElement_Exists);
 BENCHMARK_REGISTER_F(JSONBenchmark, cJSON_FindElement_Exists);
 BENCHMARK_REGISTER_F(JSONBenchmark, JMC_FindElement_NotExists);
 BENCHMARK_REGISTER_F(JSONBenchmark, cJSON_FindElement_NotExists);
+BENCHMARK_REGISTER_F(JSONBenchmark, JSONChecker_Validate);
+BENCHMARK_REGISTER_F(JSONBenchmark, Validator_Validate);
+BENCHMARK_REGISTER_F(JSONBenchmark, JSONChecker_ValidateNotJSON);
+BENCHMARK_REGISTER_F(JSONBenchmark, Validator_ValidateNotJSON);
 
 BENCHMARK_MAIN()
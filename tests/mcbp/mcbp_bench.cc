@@ -19,6 +19,8 @@
 #include <benchmark/benchmark.h>
 #include <daemon/cookie.h>
 #include <daemon/mcbp_validators.h>
+#include <daemon/settings.h>
+#include <mcbp/protocol/framebuilder.h>
 #include <mcbp/protocol/header.h>
 #include <memcached/protocol_binary.h>
 
@@ -98,7 +100,233 @@ BENCHMARK_DEFINE_F(McbpValidatorBench, AddBench)(benchmark::State& state) {
     }
 }
 
+/**
+ * Test the performance of the command validators, and the rest of the
+ * protocol layer a command passes through, for frames built with the
+ * RequestBuilder.
+ */
+class McbpFrameBench : public ::benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& st) override {
+        settings.setXattrEnabled(true);
+        connection.enableDatatype(cb::mcbp::Feature::XATTR);
+        connection.enableDatatype(cb::mcbp::Feature::JSON);
+        connection.enableDatatype(cb::mcbp::Feature::SNAPPY);
+        std::fill(std::begin(blob), std::end(blob), 0);
+    }
+
+protected:
+    /**
+     * Build a request in the blob
+     *
+     * @param durable add a durability requirement to the framing extras
+     */
+    cb::const_byte_buffer build(cb::mcbp::ClientOpcode opcode,
+                                cb::const_byte_buffer extras,
+                                cb::const_byte_buffer value,
+                                cb::mcbp::Datatype datatype,
+                                bool durable = false) {
+        cb::mcbp::RequestBuilder builder({blob, sizeof(blob)});
+        builder.setMagic(durable ? cb::mcbp::Magic::AltClientRequest
+                                 : cb::mcbp::Magic::ClientRequest);
+        builder.setOpcode(opcode);
+        builder.setDatatype(datatype);
+        builder.setOpaque(0xdeadbeef);
+        if (durable) {
+            // The id and length, followed by the level (Majority)
+            const uint8_t framingExtras[] = {
+                    uint8_t(uint8_t(cb::mcbp::request::FrameInfoId::
+                                            DurabilityRequirement)
+                                    << 4 |
+                            1),
+                    0x01};
+            builder.setFramingExtras({framingExtras, sizeof(framingExtras)});
+        }
+        builder.setExtras(extras);
+        builder.setKey(cb::const_char_buffer{"benchmark::key"});
+        builder.setValue(value);
+        return builder.getFrame()->getFrame();
+    }
+
+    /// Validate the command in the buffer, as the executor does for every
+    /// command read.
+    void validate(benchmark::State& state,
+                  cb::mcbp::ClientOpcode opcode,
+                  cb::const_byte_buffer buffer) {
+        Cookie cookie(connection);
+        cookie.setPacket(Cookie::PacketContent::Full, buffer);
+        if (validator.validate(opcode, cookie) != cb::mcbp::Status::Success) {
+            const auto error = "Invalid request: " + cookie.getErrorContext();
+            state.SkipWithError(error.c_str());
+            return;
+        }
+
+        while (state.KeepRunning()) {
+            cookie.reset();
+            cookie.setPacket(Cookie::PacketContent::Full, buffer);
+            benchmark::DoNotOptimize(validator.validate(opcode, cookie));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    cb::const_byte_buffer mutationExtras() {
+        static cb::mcbp::request::MutationPayload extras;
+        return extras.getBuffer();
+    }
+
+    McbpValidator validator;
+    MockConnection connection;
+    uint8_t blob[4096];
+    const std::string jsonValue = R"({"name":"benchmark","value":[1,2,3]})";
+};
+
+BENCHMARK_DEFINE_F(McbpFrameBench, ValidateDelete)(benchmark::State& state) {
+    validate(state,
+             cb::mcbp::ClientOpcode::Delete,
+             build(cb::mcbp::ClientOpcode::Delete,
+                   {},
+                   {},
+                   cb::mcbp::Datatype::Raw));
+}
+
+BENCHMARK_DEFINE_F(McbpFrameBench, ValidateIncrement)
+(benchmark::State& state) {
+    cb::mcbp::request::ArithmeticPayload extras;
+    extras.setDelta(1);
+    validate(state,
+             cb::mcbp::ClientOpcode::Increment,
+             build(cb::mcbp::ClientOpcode::Increment,
+                   extras.getBuffer(),
+                   {},
+                   cb::mcbp::Datatype::Raw));
+}
+
+BENCHMARK_DEFINE_F(McbpFrameBench, ValidateSetJson)(benchmark::State& state) {
+    validate(state,
+             cb::mcbp::ClientOpcode::Set,
+             build(cb::mcbp::ClientOpcode::Set,
+                   mutationExtras(),
+                   {reinterpret_cast<const uint8_t*>(jsonValue.data()),
+                    jsonValue.size()},
+                   cb::mcbp::Datatype::JSON));
+}
+
+BENCHMARK_DEFINE_F(McbpFrameBench, ValidateDurableSet)
+(benchmark::State& state) {
+    validate(state,
+             cb::mcbp::ClientOpcode::Set,
+             build(cb::mcbp::ClientOpcode::Set,
+                   mutationExtras(),
+                   {reinterpret_cast<const uint8_t*>(jsonValue.data()),
+                    jsonValue.size()},
+                   cb::mcbp::Datatype::JSON,
+                   true));
+}
+
+BENCHMARK_DEFINE_F(McbpFrameBench, ValidateSubdocGet)
+(benchmark::State& state) {
+    // The path length and the flags, followed by the path as the value
+    const uint8_t extras[] = {0, 4, 0};
+    const std::string path = "name";
+    validate(state,
+             cb::mcbp::ClientOpcode::SubdocGet,
+             build(cb::mcbp::ClientOpcode::SubdocGet,
+                   {extras, sizeof(extras)},
+                   {reinterpret_cast<const uint8_t*>(path.data()),
+                    path.size()},
+                   cb::mcbp::Datatype::Raw));
+}
+
+// Benchmark the header checks and the lookups of each section of a request.
+BENCHMARK_DEFINE_F(McbpFrameBench, ParseHeader)(benchmark::State& state) {
+    const auto buffer = build(
+            cb::mcbp::ClientOpcode::Set,
+            mutationExtras(),
+            {reinterpret_cast<const uint8_t*>(jsonValue.data()),
+             jsonValue.size()},
+            cb::mcbp::Datatype::JSON,
+            true);
+    const auto& header = *reinterpret_cast<const cb::mcbp::Header*>(
+            buffer.data());
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(header.isValid());
+        const auto& request = header.getRequest();
+        benchmark::DoNotOptimize(request.getClientOpcode());
+        benchmark::DoNotOptimize(request.getFramingExtras());
+        benchmark::DoNotOptimize(request.getExtdata());
+        benchmark::DoNotOptimize(request.getKey());
+        benchmark::DoNotOptimize(request.getValue());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Benchmark decoding the durability requirement from the frame extras.
+BENCHMARK_DEFINE_F(McbpFrameBench, DecodeFrameInfo)(benchmark::State& state) {
+    const auto buffer = build(cb::mcbp::ClientOpcode::Set,
+                              mutationExtras(),
+                              {},
+                              cb::mcbp::Datatype::Raw,
+                              true);
+    const auto& request =
+            reinterpret_cast<const cb::mcbp::Header*>(buffer.data())
+                    ->getRequest();
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(request.getDurabilityRequirements());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Benchmark the datatype checks done for a request with a JSON value.
+BENCHMARK_DEFINE_F(McbpFrameBench, DatatypeChecks)(benchmark::State& state) {
+    const auto datatype = protocol_binary_datatype_t(
+            PROTOCOL_BINARY_DATATYPE_JSON | PROTOCOL_BINARY_DATATYPE_SNAPPY);
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(mcbp::datatype::is_valid(datatype));
+        benchmark::DoNotOptimize(connection.isDatatypeEnabled(datatype));
+        benchmark::DoNotOptimize(mcbp::datatype::is_snappy(datatype));
+        benchmark::DoNotOptimize(mcbp::datatype::is_xattr(datatype));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Benchmark building a GET response, with the flags as extras and a 256
+ * byte value. mcbp_add_header() needs the connection to be bound to a
+ * worker thread (for its stats), so this builds the same header with the
+ * ResponseBuilder.
+ */
+BENCHMARK_DEFINE_F(McbpFrameBench, BuildResponse)(benchmark::State& state) {
+    const std::string value(256, 'x');
+    const uint32_t flags = 0xcaffee;
+    while (state.KeepRunning()) {
+        cb::mcbp::ResponseBuilder builder({blob, sizeof(blob)});
+        builder.setMagic(cb::mcbp::Magic::ClientResponse);
+        builder.setOpcode(cb::mcbp::ClientOpcode::Get);
+        builder.setStatus(cb::mcbp::Status::Success);
+        builder.setDatatype(cb::mcbp::Datatype::Raw);
+        builder.setOpaque(0xdeadbeef);
+        builder.setCas(0x1234);
+        builder.setExtras({reinterpret_cast<const uint8_t*>(&flags),
+                           sizeof(flags)});
+        builder.setValue(value);
+        benchmark::DoNotOptimize(builder.getFrame());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
 BENCHMARK_REGISTER_F(McbpValidatorBench, GetBench);
 BENCHMARK_REGISTER_F(McbpValidatorBench, SetBench);
 BENCHMARK_REGISTER_F(McbpValidatorBench, AddBench);
+BENCHMARK_REGISTER_F(McbpFrameBench, ValidateDelete);
+BENCHMARK_REGISTER_F(McbpFrameBench, ValidateIncrement);
+BENCHMARK_REGISTER_F(McbpFrameBench, ValidateSetJson);
+BENCHMARK_REGISTER_F(McbpFrameBench, ValidateDurableSet);
+BENCHMARK_REGISTER_F(McbpFrameBench, ValidateSubdocGet);
+BENCHMARK_REGISTER_F(McbpFrameBench, ParseHeader);
+BENCHMARK_REGISTER_F(McbpFrameBench, DecodeFrameInfo);
+BENCHMARK_REGISTER_F(McbpFrameBench, DatatypeChecks);
+BENCHMARK_REGISTER_F(McbpFrameBench, BuildResponse);
 BENCHMARK_MAIN()
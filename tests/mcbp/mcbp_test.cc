@@ -4096,6 +4096,12 @@ TEST_P(GetRandomKeyValidatorTest, CorrectMessage) {
     EXPECT_EQ(cb::mcbp::Status::Success, validate());
 }
 
+TEST_P(GetRandomKeyValidatorTest, Count) {
+    req.setExtlen(4);
+    req.setBodylen(4);
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+}
+
 TEST_P(GetRandomKeyValidatorTest, InvalidMagic) {
     blob[0] = 0;
     EXPECT_EQ(cb::mcbp::Status::Einval, validate());
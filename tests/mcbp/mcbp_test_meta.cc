@@ -102,5 +102,83 @@ INSTANTIATE_TEST_CASE_P(
                                   cb::mcbp::ClientOpcode::DelWithMeta,
                                   cb::mcbp::ClientOpcode::DelqWithMeta),
                 ::testing::Bool()), );
+
+class WithMetaBatchTest : public ::testing::WithParamInterface<bool>,
+                          public ValidatorTest {
+public:
+    WithMetaBatchTest() : ValidatorTest(GetParam()) {
+    }
+
+    void SetUp() override {
+        ValidatorTest::SetUp();
+        addMutation(cb::mcbp::ClientOpcode::SetWithMeta);
+        addMutation(cb::mcbp::ClientOpcode::DelWithMeta);
+    }
+
+protected:
+    /// Append a mutation (with a 5 byte value) to the batch
+    cb::mcbp::Request& addMutation(cb::mcbp::ClientOpcode opcode) {
+        auto& batch = request.message.header.request;
+        const size_t offset = sizeof(batch) + batch.getBodylen();
+        auto& mutation = *reinterpret_cast<cb::mcbp::Request*>(blob + offset);
+        mutation.setMagic(cb::mcbp::Magic::ClientRequest);
+        mutation.setOpcode(opcode);
+        mutation.setDatatype(cb::mcbp::Datatype::Raw);
+        mutation.setExtlen(24);
+        mutation.setKeylen(4);
+        mutation.setBodylen(24 + 4 + 5);
+        // Default collection key (valid with or without collections)
+        memcpy(blob + offset + sizeof(mutation) + 24, "\0key", 4);
+        batch.setBodylen(batch.getBodylen() + sizeof(mutation) + 24 + 4 + 5);
+        return mutation;
+    }
+
+    cb::mcbp::Status validate() {
+        return ValidatorTest::validate(cb::mcbp::ClientOpcode::WithMetaBatch,
+                                       static_cast<void*>(&request));
+    }
+};
+
+TEST_P(WithMetaBatchTest, CorrectMessage) {
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+}
+
+TEST_P(WithMetaBatchTest, Empty) {
+    request.message.header.request.setBodylen(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(WithMetaBatchTest, Truncated) {
+    auto& batch = request.message.header.request;
+    batch.setBodylen(batch.getBodylen() - 1);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(WithMetaBatchTest, InvalidOpcode) {
+    addMutation(cb::mcbp::ClientOpcode::SetqWithMeta);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(WithMetaBatchTest, OtherVBucket) {
+    addMutation(cb::mcbp::ClientOpcode::AddWithMeta).setVBucket(Vbid(1));
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(WithMetaBatchTest, InvalidExtlen) {
+    auto& mutation = addMutation(cb::mcbp::ClientOpcode::AddWithMeta);
+    mutation.setExtlen(25);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(WithMetaBatchTest, NoKey) {
+    auto& mutation = addMutation(cb::mcbp::ClientOpcode::AddWithMeta);
+    mutation.setKeylen(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+INSTANTIATE_TEST_CASE_P(CollectionsOnOff,
+                        WithMetaBatchTest,
+                        ::testing::Bool(), );
+
 } // namespace test
 } // namespace mcbp
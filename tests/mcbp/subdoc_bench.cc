@@ -0,0 +1,432 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the work the subdoc executors (daemon/subdocument.cc) do
+ * for each request once the document has been fetched: executing each path
+ * with subjson, building the contiguous document a following mutation
+ * operates on, inflating compressed documents, and parsing and updating the
+ * xattr blob (xattr/blob.cc).
+ */
+
+#include <benchmark/benchmark.h>
+#include <platform/compress.h>
+#include <subdoc/operations.h>
+#include <xattr/blob.h>
+#include <xattr/utils.h>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Create a JSON document of (approximately) the given size. The document has
+ * top-level fields f0..fN padding it out, followed by the given depth of
+ * nested objects ("a") ending with the field "leaf".
+ */
+static std::string makeDocument(size_t size, size_t depth) {
+    std::string doc = "{";
+    const std::string padding(32, 'x');
+    for (size_t ii = 0; doc.size() < size; ++ii) {
+        doc += "\"f" + std::to_string(ii) + "\":\"" + padding + "\",";
+    }
+    for (size_t ii = 1; ii < depth; ++ii) {
+        doc += "\"a\":{";
+    }
+    doc += "\"leaf\":\"value\"";
+    doc.append(depth - 1, '}');
+    doc += "}";
+    return doc;
+}
+
+/// @return the path of the leaf in a document created by makeDocument.
+static std::string makeLeafPath(size_t depth) {
+    std::string path;
+    for (size_t ii = 1; ii < depth; ++ii) {
+        path += "a.";
+    }
+    return path + "leaf";
+}
+
+/// Create a JSON document with an array "arr" of the given number of numbers.
+static std::string makeArrayDocument(size_t elements) {
+    std::string doc = "{\"arr\":[";
+    for (size_t ii = 0; ii < elements; ++ii) {
+        if (ii != 0) {
+            doc += ",";
+        }
+        doc += std::to_string(ii);
+    }
+    return doc + "]}";
+}
+
+/// Create an xattr blob of the given number of xattrs (x0..xN), each with a
+/// JSON value of (approximately) the given size.
+static std::string makeXattrs(size_t count, size_t valueSize) {
+    cb::xattr::Blob blob;
+    const std::string value =
+            "{\"v\":\"" + std::string(valueSize > 8 ? valueSize - 8 : 0, 'x') +
+            "\"}";
+    for (size_t ii = 0; ii < count; ++ii) {
+        blob.set("x" + std::to_string(ii), value);
+    }
+    const auto encoded = blob.finalize();
+    return {encoded.data(), encoded.size()};
+}
+
+/// @return count paths of the top-level fields of a document created by
+///         makeDocument, spread evenly across the document.
+static std::vector<std::string> makeFieldPaths(const std::string& doc,
+                                               size_t count) {
+    // Each of the padding fields is followed by a comma.
+    const size_t fields = std::count(doc.begin(), doc.end(), ',');
+    std::vector<std::string> paths;
+    for (size_t ii = 0; ii < count; ++ii) {
+        paths.push_back("f" + std::to_string(ii * fields / count));
+    }
+    return paths;
+}
+
+class SubdocBench : public benchmark::Fixture {
+protected:
+    /**
+     * Execute the command on the path of doc, as subdoc_operate_one_path
+     * does.
+     */
+    void execute(Subdoc::Command cmd,
+                 cb::const_char_buffer doc,
+                 const std::string& path,
+                 cb::const_char_buffer value = {}) {
+        op.clear();
+        op.set_result_buf(&result);
+        op.set_code(cmd);
+        op.set_doc(doc.data(), doc.size());
+        op.set_value(value.data(), value.size());
+        const auto status = op.op_exec(path.data(), path.size());
+        if (status != Subdoc::Error::SUCCESS) {
+            throw std::runtime_error("SubdocBench::execute: failed for " +
+                                     path);
+        }
+    }
+
+    /**
+     * Copy the result of the last mutation into a contiguous document, as
+     * operate_single_doc does before the next path of a multi-mutation.
+     */
+    cb::const_char_buffer rebuildDocument() {
+        size_t length = 0;
+        for (auto& loc : result.newdoc()) {
+            length += loc.length;
+        }
+        std::unique_ptr<char[]> temp(new char[length]);
+        size_t offset = 0;
+        for (auto& loc : result.newdoc()) {
+            std::copy(loc.at, loc.at + loc.length, temp.get() + offset);
+            offset += loc.length;
+        }
+        tempDoc.swap(temp);
+        return {tempDoc.get(), length};
+    }
+
+    Subdoc::Operation op;
+    Subdoc::Result result;
+    std::unique_ptr<char[]> tempDoc;
+};
+
+/*
+ * Lookup (GET) of a single path.
+ * Arguments:
+ *  - range(0) : Document size
+ *  - range(1) : Path depth
+ */
+BENCHMARK_DEFINE_F(SubdocBench, Lookup)(benchmark::State& state) {
+    const auto doc = makeDocument(state.range(0), state.range(1));
+    const auto path = makeLeafPath(state.range(1));
+    while (state.KeepRunning()) {
+        execute(Subdoc::Command::GET, {doc.data(), doc.size()}, path);
+        benchmark::DoNotOptimize(result.matchloc());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+/*
+ * Mutation (DICT_UPSERT) of a single path, including building the new
+ * document.
+ * Arguments:
+ *  - range(0) : Document size
+ *  - range(1) : Path depth
+ */
+BENCHMARK_DEFINE_F(SubdocBench, Mutation)(benchmark::State& state) {
+    const auto doc = makeDocument(state.range(0), state.range(1));
+    const auto path = makeLeafPath(state.range(1));
+    const std::string value = "\"new value\"";
+    while (state.KeepRunning()) {
+        execute(Subdoc::Command::DICT_UPSERT,
+                {doc.data(), doc.size()},
+                path,
+                {value.data(), value.size()});
+        benchmark::DoNotOptimize(rebuildDocument());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+static void DocumentArguments(benchmark::internal::Benchmark* b) {
+    for (int size : {256, 4096, 65536, 1048576}) {
+        for (int depth : {1, 4, 16, 32}) {
+            b->Args({size, depth});
+        }
+    }
+}
+
+/*
+ * Lookup of the middle and the last element of an array.
+ * Arguments:
+ *  - range(0) : Number of array elements
+ */
+BENCHMARK_DEFINE_F(SubdocBench, ArrayLookup)(benchmark::State& state) {
+    const auto doc = makeArrayDocument(state.range(0));
+    const auto middle = "arr[" + std::to_string(state.range(0) / 2) + "]";
+    const std::string last = "arr[-1]";
+    while (state.KeepRunning()) {
+        execute(Subdoc::Command::GET, {doc.data(), doc.size()}, middle);
+        execute(Subdoc::Command::GET, {doc.data(), doc.size()}, last);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+/*
+ * Appending to an array (ARRAY_APPEND), and counting its elements
+ * (GET_COUNT).
+ * Arguments:
+ *  - range(0) : Number of array elements
+ */
+BENCHMARK_DEFINE_F(SubdocBench, ArrayAppend)(benchmark::State& state) {
+    const auto doc = makeArrayDocument(state.range(0));
+    const std::string path = "arr";
+    const std::string value = "12345";
+    while (state.KeepRunning()) {
+        execute(Subdoc::Command::ARRAY_APPEND,
+                {doc.data(), doc.size()},
+                path,
+                {value.data(), value.size()});
+        benchmark::DoNotOptimize(rebuildDocument());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(SubdocBench, ArrayCount)(benchmark::State& state) {
+    const auto doc = makeArrayDocument(state.range(0));
+    const std::string path = "arr";
+    while (state.KeepRunning()) {
+        execute(Subdoc::Command::GET_COUNT, {doc.data(), doc.size()}, path);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * A multi-path lookup, of fields spread across the document.
+ * Arguments:
+ *  - range(0) : Document size
+ *  - range(1) : Number of paths
+ */
+BENCHMARK_DEFINE_F(SubdocBench, MultiLookup)(benchmark::State& state) {
+    const auto doc = makeDocument(state.range(0), 1);
+    const auto paths = makeFieldPaths(doc, state.range(1));
+    while (state.KeepRunning()) {
+        for (const auto& path : paths) {
+            execute(Subdoc::Command::GET, {doc.data(), doc.size()}, path);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+}
+
+/*
+ * A multi-path mutation; each path operates on the document built from the
+ * previous one.
+ * Arguments:
+ *  - range(0) : Document size
+ *  - range(1) : Number of paths
+ */
+BENCHMARK_DEFINE_F(SubdocBench, MultiMutation)(benchmark::State& state) {
+    const auto doc = makeDocument(state.range(0), 1);
+    const auto paths = makeFieldPaths(doc, state.range(1));
+    const std::string value = "\"new value\"";
+    while (state.KeepRunning()) {
+        cb::const_char_buffer current{doc.data(), doc.size()};
+        for (const auto& path : paths) {
+            execute(Subdoc::Command::DICT_UPSERT,
+                    current,
+                    path,
+                    {value.data(), value.size()});
+            current = rebuildDocument();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+}
+
+static void MultiPathArguments(benchmark::internal::Benchmark* b) {
+    for (int size : {4096, 65536}) {
+        for (int paths : {1, 2, 4, 8, 16}) {
+            b->Args({size, paths});
+        }
+    }
+}
+
+/*
+ * Lookup of a path in a compressed (Snappy) document, which must be
+ * inflated first, compared with the same uncompressed document.
+ * Arguments:
+ *  - range(0) : Document size
+ *  - range(1) : Compressed (0: no, 1: yes)
+ */
+BENCHMARK_DEFINE_F(SubdocBench, CompressedLookup)(benchmark::State& state) {
+    const auto doc = makeDocument(state.range(0), 4);
+    const auto path = makeLeafPath(4);
+    const bool compressed = state.range(1) != 0;
+    cb::compression::Buffer deflated;
+    if (!cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                  {doc.data(), doc.size()},
+                                  deflated)) {
+        state.SkipWithError("Failed to compress the document");
+        return;
+    }
+
+    cb::compression::Buffer inflated;
+    while (state.KeepRunning()) {
+        cb::const_char_buffer input{doc.data(), doc.size()};
+        if (compressed) {
+            if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                          {deflated.data(), deflated.size()},
+                                          inflated)) {
+                state.SkipWithError("Failed to inflate the document");
+                return;
+            }
+            input = {inflated.data(), inflated.size()};
+        }
+        execute(Subdoc::Command::GET, input, path);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+/*
+ * Lookup of an xattr path, as do_xattr_phase does: parse the xattr blob,
+ * get the xattr, wrap it as a document {"key":value} and execute the path
+ * on that.
+ * Arguments:
+ *  - range(0) : Number of xattrs
+ *  - range(1) : Size of each xattr
+ */
+BENCHMARK_DEFINE_F(SubdocBench, XattrLookup)(benchmark::State& state) {
+    auto xattrs = makeXattrs(state.range(0), state.range(1));
+    const std::string key = "x" + std::to_string(state.range(0) - 1);
+    const auto path = key + ".v";
+    std::string document;
+    while (state.KeepRunning()) {
+        const cb::xattr::Blob blob({&xattrs[0], xattrs.size()}, false);
+        const auto value = blob.get(key);
+        document = "{\"" + key + "\":";
+        document.append(value.data(), value.size());
+        document += "}";
+        execute(Subdoc::Command::GET, {document.data(), document.size()}, path);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * xattrs.size());
+}
+
+/*
+ * Update of an xattr: copy the blob, replace one xattr and encode the new
+ * blob.
+ * Arguments:
+ *  - range(0) : Number of xattrs
+ *  - range(1) : Size of each xattr
+ */
+BENCHMARK_DEFINE_F(SubdocBench, XattrMutation)(benchmark::State& state) {
+    auto xattrs = makeXattrs(state.range(0), state.range(1));
+    const std::string key = "x" + std::to_string(state.range(0) / 2);
+    const std::string value =
+            "{\"v\":\"" + std::string(state.range(1), 'y') + "\"}";
+    while (state.KeepRunning()) {
+        const cb::xattr::Blob blob({&xattrs[0], xattrs.size()}, false);
+        cb::xattr::Blob copy(blob);
+        copy.set(key, value);
+        benchmark::DoNotOptimize(copy.finalize());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * xattrs.size());
+}
+
+/*
+ * Parsing the xattrs of a compressed (Snappy) document.
+ * Arguments:
+ *  - range(0) : Number of xattrs
+ *  - range(1) : Size of each xattr
+ */
+BENCHMARK_DEFINE_F(SubdocBench, XattrCompressed)(benchmark::State& state) {
+    auto document = makeXattrs(state.range(0), state.range(1)) +
+                    makeDocument(4096, 1);
+    cb::compression::Buffer deflated;
+    if (!cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                  {document.data(), document.size()},
+                                  deflated)) {
+        state.SkipWithError("Failed to compress the document");
+        return;
+    }
+    const std::string key = "x" + std::to_string(state.range(0) - 1);
+    while (state.KeepRunning()) {
+        const cb::xattr::Blob blob({deflated.data(), deflated.size()}, true);
+        benchmark::DoNotOptimize(blob.get(key));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void XattrArguments(benchmark::internal::Benchmark* b) {
+    for (int count : {1, 8, 64}) {
+        for (int size : {16, 256, 4096}) {
+            b->Args({count, size});
+        }
+    }
+}
+
+BENCHMARK_REGISTER_F(SubdocBench, Lookup)->Apply(DocumentArguments);
+BENCHMARK_REGISTER_F(SubdocBench, Mutation)->Apply(DocumentArguments);
+BENCHMARK_REGISTER_F(SubdocBench, ArrayLookup)
+        ->RangeMultiplier(10)
+        ->Range(10, 100000);
+BENCHMARK_REGISTER_F(SubdocBench, ArrayAppend)
+        ->RangeMultiplier(10)
+        ->Range(10, 100000);
+BENCHMARK_REGISTER_F(SubdocBench, ArrayCount)
+        ->RangeMultiplier(10)
+        ->Range(10, 100000);
+BENCHMARK_REGISTER_F(SubdocBench, MultiLookup)->Apply(MultiPathArguments);
+BENCHMARK_REGISTER_F(SubdocBench, MultiMutation)->Apply(MultiPathArguments);
+BENCHMARK_REGISTER_F(SubdocBench, CompressedLookup)
+        ->Args({4096, 0})
+        ->Args({4096, 1})
+        ->Args({65536, 0})
+        ->Args({65536, 1})
+        ->Args({1048576, 0})
+        ->Args({1048576, 1});
+BENCHMARK_REGISTER_F(SubdocBench, XattrLookup)->Apply(XattrArguments);
+BENCHMARK_REGISTER_F(SubdocBench, XattrMutation)->Apply(XattrArguments);
+BENCHMARK_REGISTER_F(SubdocBench, XattrCompressed)->Apply(XattrArguments);
+BENCHMARK_MAIN()
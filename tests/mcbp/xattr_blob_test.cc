@@ -231,3 +231,87 @@ TEST(XattrBlob, iterator_insert) {
         }
     }
 }
+
+// Only the XATTR section of a compressed document should be inflated, and
+// the Blob should be usable directly on the compressed document
+TEST(XattrBlob, InflateXattrsOnly) {
+    cb::xattr::Blob blob;
+    blob.set("user", "{\"author\":\"bubba\"}");
+    blob.set("_sync", "{\"cas\":\"0xdeadbeefcafefeed\"}");
+    const auto xattrs = to_string(blob.finalize());
+
+    std::string document = xattrs;
+    for (int ii = 0; ii < 10000; ++ii) {
+        document += "{\"body\":" + std::to_string(ii) + "},";
+    }
+
+    cb::compression::Buffer deflated;
+    ASSERT_TRUE(cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                         {document.data(), document.size()},
+                                         deflated));
+
+    cb::compression::Buffer inflated;
+    ASSERT_TRUE(cb::xattr::inflate_xattrs(
+            {deflated.data(), deflated.size()}, inflated));
+    EXPECT_EQ(xattrs, std::string(inflated.data(), inflated.size()));
+
+    cb::xattr::Blob compressed({deflated.data(), deflated.size()}, true);
+    EXPECT_EQ("{\"author\":\"bubba\"}", to_string(compressed.get("user")));
+    EXPECT_EQ(xattrs.size(), compressed.size());
+
+    // Truncated and garbage input must be rejected
+    EXPECT_FALSE(cb::xattr::inflate_xattrs({deflated.data(), 8}, inflated));
+    const std::string garbage(64, '\xff');
+    EXPECT_FALSE(cb::xattr::inflate_xattrs({garbage.data(), garbage.size()},
+                                           inflated));
+}
+
+// Blobs with many keys are looked up through an index, which must be kept
+// up to date as the blob is modified
+TEST(XattrBlob, ManyKeys) {
+    cb::xattr::Blob blob;
+    for (int ii = 0; ii < 32; ++ii) {
+        const auto key = "key" + std::to_string(ii);
+        const auto value = "{\"value\":" + std::to_string(ii) + "}";
+        blob.set(key, value);
+    }
+    validate(blob.finalize());
+
+    EXPECT_EQ("{\"value\":7}", to_string(blob.get("key7")));
+    EXPECT_TRUE(to_string(blob.get("key")).empty());
+    EXPECT_TRUE(to_string(blob.get("key77")).empty());
+
+    // Replace with values of the same, a shorter and a longer size
+    blob.set("key10", "{\"value\":99}");
+    blob.set("key11", "{}");
+    blob.set("key12", "{\"value\":\"a much longer value\"}");
+    blob.remove("key3");
+    blob.set("key99", "true");
+    validate(blob.finalize());
+
+    for (int ii = 0; ii < 32; ++ii) {
+        const auto key = "key" + std::to_string(ii);
+        std::string expected = "{\"value\":" + std::to_string(ii) + "}";
+        switch (ii) {
+        case 3:
+            expected = "";
+            break;
+        case 10:
+            expected = "{\"value\":99}";
+            break;
+        case 11:
+            expected = "{}";
+            break;
+        case 12:
+            expected = "{\"value\":\"a much longer value\"}";
+            break;
+        }
+        EXPECT_EQ(expected, to_string(blob.get(key))) << key;
+    }
+    EXPECT_EQ("true", to_string(blob.get("key99")));
+
+    // A copy must be able to use the index as well
+    cb::xattr::Blob copy(blob);
+    EXPECT_EQ("{\"value\":31}", to_string(copy.get("key31")));
+    EXPECT_EQ("true", to_string(copy.get("key99")));
+}
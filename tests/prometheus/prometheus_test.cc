@@ -0,0 +1,92 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "daemon/prometheus.h"
+
+#include <gtest/gtest.h>
+#include <utilities/hdrhistogram.h>
+
+using cb::prometheus::Writer;
+
+TEST(PrometheusWriterTest, Samples) {
+    Writer writer;
+    writer.counter("kv_cmd_get_total", {{"bucket", "default"}}, 10);
+    writer.counter("kv_cmd_get_total", {{"bucket", "other"}}, 0);
+    writer.gauge("kv_ep_mem_used", {}, 1.5);
+    writer.gauge("kv_ep_escaped", {{"bucket", "a\"b\\c\nd"}}, 2);
+
+    EXPECT_EQ(
+            "# TYPE kv_cmd_get_total counter\n"
+            "kv_cmd_get_total{bucket=\"default\"} 10\n"
+            "kv_cmd_get_total{bucket=\"other\"} 0\n"
+            "# TYPE kv_ep_mem_used gauge\n"
+            "kv_ep_mem_used 1.5\n"
+            "# TYPE kv_ep_escaped gauge\n"
+            "kv_ep_escaped{bucket=\"a\\\"b\\\\c\\nd\"} 2\n",
+            writer.str());
+}
+
+TEST(PrometheusWriterTest, Sanitise) {
+    EXPECT_EQ("ep_mem_used", Writer::sanitise("ep_mem_used"));
+    EXPECT_EQ("replication_producer_count",
+              Writer::sanitise("replication:producer_count"));
+    EXPECT_EQ("_0_p99_9", Writer::sanitise("00:p99.9"));
+}
+
+TEST(PrometheusWriterTest, Histogram) {
+    HdrHistogram histogram(1, 60000000, 2);
+    histogram.addValue(10); // 10us
+    histogram.addValue(400); // 400us
+    histogram.addValue(400);
+    histogram.addValue(2000000); // 2s
+
+    Writer writer;
+    writer.histogram("kv_cmd_duration_seconds",
+                     {{"bucket", "default"}, {"opcode", "GET"}},
+                     histogram);
+    const auto& doc = writer.str();
+
+    const std::string labels = "{bucket=\"default\",opcode=\"GET\",le=";
+    EXPECT_EQ(0, doc.find("# TYPE kv_cmd_duration_seconds histogram\n"));
+    EXPECT_NE(std::string::npos,
+              doc.find("kv_cmd_duration_seconds_bucket" + labels +
+                       "\"5e-05\"} 1\n"));
+    EXPECT_NE(std::string::npos,
+              doc.find("kv_cmd_duration_seconds_bucket" + labels +
+                       "\"0.00025\"} 1\n"));
+    EXPECT_NE(std::string::npos,
+              doc.find("kv_cmd_duration_seconds_bucket" + labels +
+                       "\"0.0005\"} 3\n"));
+    EXPECT_NE(std::string::npos,
+              doc.find("kv_cmd_duration_seconds_bucket" + labels +
+                       "\"1\"} 3\n"));
+    EXPECT_NE(std::string::npos,
+              doc.find("kv_cmd_duration_seconds_bucket" + labels +
+                       "\"2.5\"} 4\n"));
+    EXPECT_NE(std::string::npos,
+              doc.find("kv_cmd_duration_seconds_bucket" + labels +
+                       "\"+Inf\"} 4\n"));
+    EXPECT_NE(std::string::npos,
+              doc.find("kv_cmd_duration_seconds_count{bucket=\"default\","
+                       "opcode=\"GET\"} 4\n"));
+
+    // The sum is approximate (to the precision of the histogram)
+    const auto sumKey = std::string(
+            "kv_cmd_duration_seconds_sum{bucket=\"default\",opcode=\"GET\"} ");
+    const auto pos = doc.find(sumKey);
+    ASSERT_NE(std::string::npos, pos);
+    EXPECT_NEAR(2.00081, std::stod(doc.substr(pos + sumKey.size())), 0.02);
+}
@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "daemon/subdoc_path_cache.h"
+#include <gtest/gtest.h>
+
+class SubdocPathCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        cache.setMaxDocuments(2);
+    }
+
+    const SubdocPathCache::Location found{
+            cb::mcbp::Status::Success, 10, 5};
+    SubdocPathCache cache;
+    SubdocPathCache::Location loc{};
+};
+
+TEST_F(SubdocPathCacheTest, Disabled) {
+    cache.setMaxDocuments(0);
+    cache.insert("doc", 1, 100, {"a.b", 3}, found);
+    EXPECT_EQ(0, cache.size());
+    EXPECT_FALSE(cache.lookup("doc", 1, 100, {"a.b", 3}, loc));
+}
+
+TEST_F(SubdocPathCacheTest, Lookup) {
+    cache.insert("doc", 1, 100, {"a.b", 3}, found);
+    cache.insert("doc",
+                 1,
+                 100,
+                 {"a.c", 3},
+                 {cb::mcbp::Status::SubdocPathEnoent, 0, 0});
+
+    ASSERT_TRUE(cache.lookup("doc", 1, 100, {"a.b", 3}, loc));
+    EXPECT_EQ(cb::mcbp::Status::Success, loc.status);
+    EXPECT_EQ(10, loc.offset);
+    EXPECT_EQ(5, loc.length);
+
+    ASSERT_TRUE(cache.lookup("doc", 1, 100, {"a.c", 3}, loc));
+    EXPECT_EQ(cb::mcbp::Status::SubdocPathEnoent, loc.status);
+
+    EXPECT_FALSE(cache.lookup("doc", 1, 100, {"a.d", 3}, loc));
+    EXPECT_FALSE(cache.lookup("other", 1, 100, {"a.b", 3}, loc));
+}
+
+// A different CAS (or length) is a different version of the document, so
+// the locations recorded for the old version must not be used.
+TEST_F(SubdocPathCacheTest, NewVersionOfDocument) {
+    cache.insert("doc", 1, 100, {"a.b", 3}, found);
+    EXPECT_FALSE(cache.lookup("doc", 2, 100, {"a.b", 3}, loc));
+    EXPECT_FALSE(cache.lookup("doc", 1, 101, {"a.b", 3}, loc));
+
+    cache.insert("doc", 2, 100, {"x", 1}, found);
+    EXPECT_EQ(1, cache.size());
+    EXPECT_TRUE(cache.lookup("doc", 2, 100, {"x", 1}, loc));
+    EXPECT_FALSE(cache.lookup("doc", 2, 100, {"a.b", 3}, loc));
+    EXPECT_FALSE(cache.lookup("doc", 1, 100, {"a.b", 3}, loc));
+}
+
+TEST_F(SubdocPathCacheTest, LeastRecentlyUsedDropped) {
+    cache.insert("doc1", 1, 100, {"a", 1}, found);
+    cache.insert("doc2", 1, 100, {"a", 1}, found);
+
+    // Touch doc1 so doc2 is the one dropped.
+    EXPECT_TRUE(cache.lookup("doc1", 1, 100, {"a", 1}, loc));
+    cache.insert("doc3", 1, 100, {"a", 1}, found);
+    EXPECT_EQ(2, cache.size());
+    EXPECT_TRUE(cache.lookup("doc1", 1, 100, {"a", 1}, loc));
+    EXPECT_FALSE(cache.lookup("doc2", 1, 100, {"a", 1}, loc));
+    EXPECT_TRUE(cache.lookup("doc3", 1, 100, {"a", 1}, loc));
+
+    cache.setMaxDocuments(1);
+    EXPECT_EQ(1, cache.size());
+    EXPECT_TRUE(cache.lookup("doc3", 1, 100, {"a", 1}, loc));
+}
+
+TEST_F(SubdocPathCacheTest, PathsPerDocumentBounded) {
+    for (size_t ii = 0; ii < SubdocPathCache::MaxPathsPerDocument + 1; ++ii) {
+        const auto path = std::to_string(ii);
+        cache.insert("doc", 1, 100, {path.data(), path.size()}, found);
+    }
+    const auto last = std::to_string(SubdocPathCache::MaxPathsPerDocument);
+    EXPECT_TRUE(cache.lookup("doc", 1, 100, {"0", 1}, loc));
+    EXPECT_FALSE(cache.lookup("doc", 1, 100, {last.data(), last.size()}, loc));
+}
@@ -65,23 +65,37 @@ protected:
             throw std::invalid_argument("Failed to parse payload: " + payload);
         }
 
-        size_t ret = 0;
-        for (auto* obj = json.get()->child; obj != nullptr; obj = obj->next) {
-            if (obj->type == cJSON_Number) {
-                ret += obj->valueint;
-            } else if (obj->type == cJSON_Array) {
-                for (auto* ent = obj->child; ent != nullptr; ent = ent->next) {
-                    if (ent->type == cJSON_Number) {
-                        ret += ent->valueint;
-                    } else {
-                        throw std::invalid_argument("Expected numbers, got " +
-                                                    std::to_string(ent->type));
-                    }
-                }
-            }
+        auto* total = cJSON_GetObjectItem(json.get(), "total");
+        if (total == nullptr || total->type != cJSON_Number) {
+            throw std::invalid_argument("No total in payload: " + payload);
         }
+        return size_t(total->valueint);
+    }
 
-        return ret;
+    /**
+     * Get the given percentile of the times in the payload
+     * @param payload the JSON returned from the server
+     * @param percentile the percentile to look for
+     * @return the time (in microseconds)
+     */
+    uint64_t getPercentile(const std::string& payload, double percentile) {
+        unique_cJSON_ptr json(cJSON_Parse(payload.c_str()));
+        if (!json) {
+            throw std::invalid_argument("Failed to parse payload: " + payload);
+        }
+
+        auto* percentiles = cJSON_GetObjectItem(json.get(), "percentiles");
+        if (percentiles == nullptr || percentiles->type != cJSON_Array) {
+            throw std::invalid_argument("No percentiles in payload: " +
+                                        payload);
+        }
+        for (auto* ent = percentiles->child; ent != nullptr; ent = ent->next) {
+            if (cJSON_GetArrayItem(ent, 0)->valuedouble == percentile) {
+                return uint64_t(cJSON_GetArrayItem(ent, 1)->valuedouble);
+            }
+        }
+        throw std::invalid_argument("Percentile " + std::to_string(percentile) +
+                                    " not in payload: " + payload);
     }
 };
 
@@ -194,3 +208,26 @@ TEST_P(CmdTimerTest, DefaultBucket) {
     EXPECT_TRUE(response.isSuccess());
     EXPECT_EQ(1, getNumberOfOps(response.getDataString()));
 }
+
+/**
+ * The timings include the percentiles of the times recorded
+ */
+TEST_P(CmdTimerTest, Percentiles) {
+    auto& c = getAdminConnection();
+    c.selectBucket("rbac_test");
+
+    BinprotResponse response;
+    c.executeCommand(
+            BinprotGetCmdTimerCommand{"", cb::mcbp::ClientOpcode::Scrub},
+            response);
+    ASSERT_TRUE(response.isSuccess());
+    const auto payload = response.getDataString();
+    EXPECT_EQ(1, getNumberOfOps(payload));
+
+    // With a single value recorded, every percentile is that value
+    const auto max = getPercentile(payload, 100.0);
+    for (const auto percentile : {50.0, 90.0, 99.0, 99.9, 99.99}) {
+        EXPECT_EQ(max, getPercentile(payload, percentile)) << percentile;
+    }
+    c.reconnect();
+}
@@ -143,6 +143,7 @@ public:
         case cb::mcbp::ClientOpcode::AddqWithMeta:
         case cb::mcbp::ClientOpcode::DelWithMeta:
         case cb::mcbp::ClientOpcode::DelqWithMeta:
+        case cb::mcbp::ClientOpcode::WithMetaBatch:
         case cb::mcbp::ClientOpcode::EnableTraffic:
         case cb::mcbp::ClientOpcode::DisableTraffic:
         case cb::mcbp::ClientOpcode::GetFailoverLog:
@@ -18,7 +18,9 @@
 #include "testapp.h"
 #include "testapp_client_test.h"
 
+#include <mcbp/protocol/framebuilder.h>
 #include <platform/compress.h>
+#include <platform/dirutils.h>
 #include <algorithm>
 #include <gsl/gsl>
 
@@ -441,6 +443,55 @@ INSTANTIATE_TEST_CASE_P(
                                              ClientSnappySupport::No)),
         PrintToStringCombinedName());
 
+/// Append a GET with the reorder frame info to the frame
+static void encodeReorderableGet(Frame& frame,
+                                 const std::string& key,
+                                 uint32_t opaque) {
+    const auto offset = frame.payload.size();
+    frame.payload.resize(offset + sizeof(cb::mcbp::Request) + 1 + key.size());
+    cb::mcbp::RequestBuilder builder(
+            {frame.payload.data() + offset, frame.payload.size() - offset});
+    builder.setMagic(cb::mcbp::Magic::AltClientRequest);
+    builder.setOpcode(cb::mcbp::ClientOpcode::Get);
+    builder.setOpaque(opaque);
+    const uint8_t reorder = 0x00; // ID:0 Len:0
+    builder.setFramingExtras({&reorder, 1});
+    builder.setKey(key);
+}
+
+/**
+ * With unordered execution a reorderable command should not have to wait
+ * for a blocked reorderable command in front of it.
+ */
+TEST_P(GetSetTest, UnorderedExecution) {
+    auto& conn = getConnection();
+    conn.setUnorderedExecutionMode(ExecutionMode::Unordered);
+
+    // Block the next command (the first GET) until the file is removed
+    const auto testfile = cb::io::getcwd() + "/" + cb::io::mktemp("lockfile");
+    conn.configureEwouldBlockEngine(EWBEngineMode::BlockMonitorFile,
+                                    ENGINE_EWOULDBLOCK /* unused */,
+                                    0,
+                                    testfile);
+
+    Frame frame;
+    encodeReorderableGet(frame, name + "_blocked", 1);
+    encodeReorderableGet(frame, name + "_unblocked", 2);
+    conn.sendFrame(frame);
+
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    EXPECT_EQ(2u, rsp.getResponse().getOpaque());
+    EXPECT_EQ(cb::mcbp::Status::KeyEnoent, rsp.getStatus());
+
+    cb::io::rmrf(testfile);
+    conn.recvResponse(rsp);
+    EXPECT_EQ(1u, rsp.getResponse().getOpaque());
+    EXPECT_EQ(cb::mcbp::Status::KeyEnoent, rsp.getStatus());
+
+    conn.setUnorderedExecutionMode(ExecutionMode::Ordered);
+}
+
 TEST_P(GetSetTest, TestAdd) {
     MemcachedConnection& conn = getConnection();
     conn.mutate(document, Vbid(0), MutationType::Add);
@@ -571,6 +622,51 @@ TEST_P(GetSetTest, TestSet) {
     }
 }
 
+/// Values above the streamed_value_threshold are read straight into the
+/// item; they should be stored just like the buffered ones (and keep the
+/// XATTRs of the existing document).
+TEST_P(GetSetTest, TestSetStreamedValue) {
+    memcached_cfg["streamed_value_threshold"] = 1024;
+    reconfigure();
+
+    auto& conn = getConnection();
+    document.info.datatype = cb::mcbp::Datatype::Raw;
+    document.value = std::string(256 * 1024, 'a');
+    conn.mutate(document, Vbid(0), MutationType::Add);
+    auto stored = conn.get(name, Vbid(0));
+    EXPECT_EQ(document.value, stored.value);
+    EXPECT_EQ(document.info.flags, stored.info.flags);
+
+    createXattr("meta.streamed", "true");
+    document.value = std::string(512 * 1024, 'b');
+    conn.mutate(document, Vbid(0), MutationType::Set);
+    stored = conn.get(name, Vbid(0));
+    EXPECT_EQ(document.value, stored.value);
+    if (::testing::get<1>(GetParam()) == XattrSupport::Yes) {
+        EXPECT_EQ("true", getXattr("meta.streamed").getValue());
+    }
+
+    // The packet may arrive in many pieces, splitting the key and the value
+    BinprotMutationCommand cmd;
+    cmd.setMutationType(MutationType::Replace);
+    cmd.setKey(name);
+    cmd.setValue(std::string(64 * 1024, 'c'));
+    Frame frame;
+    cmd.encode(frame.payload);
+    while (!frame.payload.empty()) {
+        conn.sendPartialFrame(
+                frame, std::min(frame.payload.size(), Frame::size_type(7000)));
+    }
+    BinprotMutationResponse rsp;
+    conn.recvResponse(rsp);
+    EXPECT_TRUE(rsp.isSuccess()) << to_string(rsp.getStatus());
+    stored = conn.get(name, Vbid(0));
+    EXPECT_EQ(std::string(64 * 1024, 'c'), stored.value);
+
+    memcached_cfg["streamed_value_threshold"] = 1024 * 1024;
+    reconfigure();
+}
+
 TEST_P(GetSetTest, TestGetMiss) {
     MemcachedConnection& conn = getConnection();
     int eNoentCount = getResponseCount(cb::mcbp::Status::KeyEnoent);
@@ -403,6 +403,84 @@ TEST_P(StatsTest, TestAggregate) {
     EXPECT_NE(nullptr, cJSON_GetObjectItem(stats.get(), "pid"));
 }
 
+/**
+ * A pipeline of small commands sent in one go should be read with fewer
+ * reads than there are commands.
+ */
+TEST_P(StatsTest, TestReadSyscalls) {
+    MemcachedConnection& conn = getConnection();
+    auto stats = conn.stats("");
+    const auto syscalls =
+            cJSON_GetObjectItem(stats.get(), "read_syscalls")->valueint;
+    const auto cmds = cJSON_GetObjectItem(stats.get(), "cmds_read")->valueint;
+
+    const int pipeline = 50;
+    Frame frame;
+    for (int ii = 0; ii < pipeline; ++ii) {
+        std::vector<uint8_t> packet;
+        BinprotGenericCommand(cb::mcbp::ClientOpcode::Noop).encode(packet);
+        frame.payload.insert(frame.payload.end(), packet.begin(), packet.end());
+    }
+    conn.sendFrame(frame);
+    for (int ii = 0; ii < pipeline; ++ii) {
+        BinprotResponse rsp;
+        conn.recvResponse(rsp);
+        EXPECT_TRUE(rsp.isSuccess());
+    }
+
+    stats = conn.stats("");
+    EXPECT_LE(cmds + pipeline,
+              cJSON_GetObjectItem(stats.get(), "cmds_read")->valueint);
+    EXPECT_GT(syscalls + pipeline,
+              cJSON_GetObjectItem(stats.get(), "read_syscalls")->valueint);
+}
+
+TEST_P(StatsTest, TestWriteSyscalls) {
+    MemcachedConnection& conn = getConnection();
+    auto stats = conn.stats("");
+    const auto syscalls =
+            cJSON_GetObjectItem(stats.get(), "write_syscalls")->valueint;
+    const auto held =
+            cJSON_GetObjectItem(stats.get(), "responses_held")->valueint;
+
+    // The responses of a pipeline already read in full are held back and
+    // sent together
+    const int pipeline = 50;
+    Frame frame;
+    for (int ii = 0; ii < pipeline; ++ii) {
+        std::vector<uint8_t> packet;
+        BinprotGenericCommand(cb::mcbp::ClientOpcode::Noop).encode(packet);
+        frame.payload.insert(frame.payload.end(), packet.begin(), packet.end());
+    }
+    conn.sendFrame(frame);
+    for (int ii = 0; ii < pipeline; ++ii) {
+        BinprotResponse rsp;
+        conn.recvResponse(rsp);
+        EXPECT_TRUE(rsp.isSuccess());
+    }
+
+    stats = conn.stats("");
+    EXPECT_LT(held,
+              cJSON_GetObjectItem(stats.get(), "responses_held")->valueint);
+    EXPECT_GT(syscalls + pipeline,
+              cJSON_GetObjectItem(stats.get(), "write_syscalls")->valueint);
+}
+
+TEST_P(StatsTest, TestBufferPool) {
+    MemcachedConnection& conn = getConnection();
+    auto stats = conn.stats("");
+    const auto hits =
+            cJSON_GetObjectItem(stats.get(), "buffer_pool_hits")->valueint;
+
+    // The response buffers of the stats calls are taken from the pool
+    // once the first of them have been returned to it
+    for (int ii = 0; ii < 10; ++ii) {
+        stats = conn.stats("");
+    }
+    EXPECT_LT(hits,
+              cJSON_GetObjectItem(stats.get(), "buffer_pool_hits")->valueint);
+}
+
 TEST_P(StatsTest, TestConnections) {
     MemcachedConnection& conn = getConnection();
     conn.hello("TestConnections", "1.0", "test connections test");
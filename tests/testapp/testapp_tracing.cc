@@ -100,3 +100,34 @@ TEST_F(TracingTest, FailOnFeatureRequestWhenDisabledOnServer) {
     EXPECT_THROW(conn.setFeature(cb::mcbp::Feature::Tracing, true),
                  std::runtime_error);
 }
+
+TEST_F(TracingTest, SampledTraces) {
+    // Keep the trace of every request
+    memcached_cfg["trace_sample_rate"] = 1;
+    reconfigure();
+
+    // The client does not need to ask for tracing
+    MemcachedConnection& conn = getConnection();
+    conn.setFeature(cb::mcbp::Feature::Tracing, false);
+    conn.mutate(document, Vbid(0), MutationType::Add);
+    EXPECT_FALSE(conn.getTraceData());
+
+    auto& admin = getAdminConnection();
+    const auto samples =
+            nlohmann::json::parse(admin.ioctl_get("trace.samples"));
+    ASSERT_TRUE(samples.is_array());
+    bool found = false;
+    for (const auto& sample : samples) {
+        if (sample["opcode"] == "ADD") {
+            found = true;
+            ASSERT_FALSE(sample["spans"].empty());
+            EXPECT_EQ("request", sample["spans"][0]["name"]);
+            EXPECT_LE(sample["spans"][0]["duration"].get<uint32_t>(),
+                      sample["duration"].get<uint32_t>());
+        }
+    }
+    EXPECT_TRUE(found) << samples.dump();
+
+    memcached_cfg["trace_sample_rate"] = 1000;
+    reconfigure();
+}
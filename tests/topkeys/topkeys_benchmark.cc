@@ -28,7 +28,7 @@
 class TopkeysBench : public benchmark::Fixture {
 protected:
     TopkeysBench() {
-        topkeys = std::make_unique<TopKeys>(50);
+        topkeys = std::make_unique<TopKeys>(50, 24);
         settings.setTopkeysEnabled(true);
         for (int ii = 0; ii < 10000; ii++) {
             keys.emplace_back("topkey_test_" + std::to_string(ii));
@@ -51,7 +51,7 @@ BENCHMARK_DEFINE_F(TopkeysBench, TopkeysDisabled)(benchmark::State& state) {
     const auto l = keys[0].size();
 
     while (state.KeepRunning()) {
-        topkeys->updateKey(k, l, 10);
+        topkeys->updateKey(state.thread_index, k, l, 0, {}, 10);
         ::benchmark::ClobberMemory();
     }
 }
@@ -68,7 +68,7 @@ BENCHMARK_DEFINE_F(TopkeysBench, UpdateSameKey)(benchmark::State& state) {
     const auto l = keys[0].size();
 
     while (state.KeepRunning()) {
-        topkeys->updateKey(k, l, 10);
+        topkeys->updateKey(state.thread_index, k, l, 0, {}, 10);
         ::benchmark::ClobberMemory();
     }
 }
@@ -92,7 +92,7 @@ BENCHMARK_DEFINE_F(TopkeysBench, UpdateRandomKey)(benchmark::State& state) {
         const auto& element = mine[start++ % size];
         const auto* k = element.data();
         const auto l = element.size();
-        topkeys->updateKey(k, l, 10);
+        topkeys->updateKey(state.thread_index, k, l, 0, {}, 10);
         ::benchmark::ClobberMemory();
     }
 }
@@ -18,13 +18,25 @@
 #include "daemon/settings.h"
 #include "daemon/topkeys.h"
 #include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
 #include <memory>
+#include <thread>
+
+using namespace std::chrono;
 
 class TopKeysTest : public ::testing::Test {
 protected:
     void SetUp() {
         settings.setTopkeysEnabled(true);
-        topkeys.reset(new TopKeys(10));
+        topkeys.reset(new TopKeys(10, 4));
+    }
+
+    void updateKey(const std::string& key,
+                   size_t thread = 0,
+                   size_t bytes = 0,
+                   nanoseconds latency = {}) {
+        topkeys->updateKey(
+                thread, key.data(), key.size(), bytes, latency, 100);
     }
 
     std::unique_ptr<TopKeys> topkeys;
@@ -47,14 +59,89 @@ TEST_F(TopKeysTest, Basic) {
     }
 
     // loop inserting keys
-    for (int jj = 0; jj < 20000; jj++) {
+    for (int jj = 0; jj < 2000; jj++) {
         for (auto& key : keys) {
-            topkeys->updateKey(key.c_str(), key.size(), jj);
+            topkeys->updateKey(jj % 4, key.c_str(), key.size(), 0, {}, jj);
         }
     }
 
-    // Verify we hit all shards inside TopKeys
+    // Only the requested number of keys is reported
     size_t count = 0;
     topkeys->stats(&count, 0, dump_key);
-    EXPECT_EQ(80, count);
+    EXPECT_EQ(10, count);
+}
+
+// The frequently accessed keys are reported (most frequent first) among a
+// much larger number of keys accessed once.
+TEST_F(TopKeysTest, HeavyHitters) {
+    for (int ii = 0; ii < 100000; ++ii) {
+        updateKey("cold_" + std::to_string(ii));
+        if (ii % 10 == 0) {
+            updateKey("hot");
+        }
+        if (ii % 20 == 0) {
+            updateKey("warm");
+        }
+    }
+
+    const auto keys = topkeys->getKeys();
+    ASSERT_EQ(10, keys.size());
+    EXPECT_EQ("hot", keys[0].key);
+    EXPECT_EQ("warm", keys[1].key);
+    EXPECT_GE(keys[0].access_count, keys[1].access_count);
+    EXPECT_GE(keys[1].access_count, keys[2].access_count);
+}
+
+// The accesses of a key by different threads are merged, with the average
+// bytes and latency of the accesses.
+TEST_F(TopKeysTest, MergeThreads) {
+    for (size_t thread = 0; thread < 4; ++thread) {
+        for (int ii = 0; ii < 10; ++ii) {
+            updateKey("key", thread, 100 * (thread + 1), microseconds(10));
+        }
+    }
+
+    const auto keys = topkeys->getKeys();
+    ASSERT_EQ(1, keys.size());
+    EXPECT_EQ("key", keys[0].key);
+    EXPECT_EQ(40, keys[0].access_count);
+    EXPECT_EQ(40, keys[0].ops);
+    EXPECT_EQ(10000, keys[0].bytes);
+    EXPECT_EQ(400000, keys[0].latency);
+
+    nlohmann::json json;
+    topkeys->json_stats(json, 110);
+    ASSERT_EQ(1, json["topkeys"].size());
+    const auto& key = json["topkeys"][0];
+    EXPECT_EQ("key", key["key"]);
+    EXPECT_EQ(40, key["access_count"]);
+    EXPECT_EQ(10, key["ctime"]);
+    EXPECT_EQ(250, key["avg_bytes"]);
+    EXPECT_EQ(10, key["avg_latency_us"]);
+}
+
+TEST_F(TopKeysTest, Disabled) {
+    settings.setTopkeysEnabled(false);
+    updateKey("key");
+    settings.setTopkeysEnabled(true);
+    EXPECT_TRUE(topkeys->getKeys().empty());
+}
+
+// Each thread updates its own shard while the stats are read.
+TEST_F(TopKeysTest, ConcurrentUpdates) {
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([this, thread]() {
+            for (int ii = 0; ii < 10000; ++ii) {
+                updateKey("key_" + std::to_string(ii % 50), thread);
+            }
+        });
+    }
+    for (int ii = 0; ii < 100; ++ii) {
+        EXPECT_LE(topkeys->getKeys().size(), 10);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(10, topkeys->getKeys().size());
 }
@@ -0,0 +1,95 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "daemon/trace_sampler.h"
+
+#include <gtest/gtest.h>
+#include <mcbp/protocol/opcode.h>
+#include <nlohmann/json.hpp>
+#include <tracing/tracetypes.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+static TraceSampler::Sample makeSample(uint64_t start) {
+    TraceSampler::Sample sample = {};
+    sample.start = start;
+    sample.duration = uint32_t(start * 10);
+    sample.connection = 1;
+    sample.opaque = 0xdeadbeef;
+    sample.opcode = uint8_t(cb::mcbp::ClientOpcode::Get);
+    sample.nspans = 2;
+    sample.spans[0] = {0, int32_t(sample.duration),
+                       uint8_t(cb::tracing::TraceCode::REQUEST)};
+    sample.spans[1] = {1, -1, uint8_t(cb::tracing::TraceCode::GET)};
+    return sample;
+}
+
+TEST(TraceSamplerTest, Empty) {
+    TraceSampler sampler;
+    EXPECT_TRUE(sampler.getSamples().empty());
+}
+
+TEST(TraceSamplerTest, KeepsTheLatest) {
+    auto sampler = std::make_unique<TraceSampler>();
+    const size_t total = TraceSampler::Capacity + 10;
+    for (size_t ii = 1; ii <= total; ++ii) {
+        sampler->add(makeSample(ii));
+    }
+
+    const auto samples = sampler->getSamples();
+    ASSERT_EQ(TraceSampler::Capacity, samples.size());
+    for (size_t ii = 0; ii < samples.size(); ++ii) {
+        const auto start = total - TraceSampler::Capacity + ii + 1;
+        EXPECT_EQ(start, samples[ii].start);
+        EXPECT_EQ(start * 10, samples[ii].duration);
+        EXPECT_EQ(2, samples[ii].nspans);
+    }
+}
+
+TEST(TraceSamplerTest, ToJson) {
+    const auto json = TraceSampler::to_json(makeSample(5));
+    EXPECT_EQ(50, json["duration"].get<int>());
+    EXPECT_EQ("GET", json["opcode"].get<std::string>());
+    EXPECT_FALSE(json["slow"].get<bool>());
+    const auto& spans = json["spans"];
+    ASSERT_EQ(2u, spans.size());
+    EXPECT_EQ("request", spans[0]["name"].get<std::string>());
+    EXPECT_EQ(50, spans[0]["duration"].get<int>());
+    EXPECT_EQ("get", spans[1]["name"].get<std::string>());
+    EXPECT_TRUE(spans[1]["duration"].is_null());
+}
+
+// Samples read while the ring is written must never be torn
+TEST(TraceSamplerTest, ConcurrentReads) {
+    auto sampler = std::make_unique<TraceSampler>();
+    std::atomic_bool done{false};
+    std::thread writer([&sampler, &done]() {
+        for (uint64_t ii = 1; ii < 100000; ++ii) {
+            sampler->add(makeSample(ii));
+        }
+        done = true;
+    });
+
+    while (!done) {
+        for (const auto& sample : sampler->getSamples()) {
+            ASSERT_EQ(sample.start * 10, sample.duration);
+            ASSERT_EQ(sample.duration, uint32_t(sample.spans[0].duration));
+        }
+    }
+    writer.join();
+}
@@ -53,6 +53,29 @@ TEST_F(TracingTest, Basic) {
     EXPECT_GE(tracer.getTotalMicros().count(), 10000);
 }
 
+// A code may be used for more than one span of a request; ending it ends the
+// most recent span which is still open.
+TEST_F(TracingTest, RepeatedCode) {
+    using cb::tracing::TraceCode;
+    tracer.begin(TraceCode::REQUEST);
+    tracer.begin(TraceCode::HASH_LOCK);
+    EXPECT_TRUE(tracer.end(TraceCode::HASH_LOCK));
+    tracer.begin(TraceCode::HASH_LOCK);
+
+    const auto& spans = tracer.getDurations();
+    ASSERT_EQ(3u, spans.size());
+    const auto first = spans[1].duration;
+    EXPECT_NE(cb::tracing::Span::Duration::max(), first);
+    EXPECT_EQ(cb::tracing::Span::Duration::max(), spans[2].duration);
+
+    EXPECT_TRUE(tracer.end(TraceCode::HASH_LOCK));
+    EXPECT_EQ(first, spans[1].duration);
+    EXPECT_NE(cb::tracing::Span::Duration::max(), spans[2].duration);
+
+    // Nothing left open with the code
+    EXPECT_FALSE(tracer.end(TraceCode::HASH_LOCK));
+}
+
 TEST_F(TracingTest, ErrorRate) {
     uint64_t micros_list[] = {5,
                               11,
@@ -127,3 +150,12 @@ TEST_F(TracingCookieTest, InstantTracerEnd) {
     const auto& durations = cookie.getTracer().getDurations();
     EXPECT_EQ(0u, durations.size());
 }
+
+/// The engine may run code with the tracing helpers without a cookie
+TEST_F(TracingCookieTest, NoCookie) {
+    const void* none = nullptr;
+    { ScopedTracer tracer(none, cb::tracing::TraceCode::HASH_LOCK); }
+    InstantTracer(none, cb::tracing::TraceCode::NOTIFY_IO, /*start*/ true);
+    InstantTracer(none, cb::tracing::TraceCode::NOTIFY_IO, /*start*/ false);
+    EXPECT_TRUE(cookie.getTracer().getDurations().empty());
+}
@@ -135,6 +135,26 @@ TYPED_TEST(UnsignedLeb128, EncodeDecodeMultipleValues) {
     EXPECT_EQ(iterations, index);
 }
 
+// Values followed by more data are decoded a word at a time; check they
+// decode the same, including when the following bytes have the MSbit set.
+TYPED_TEST(UnsignedLeb128, DecodeWithTrailingData) {
+    std::mt19937_64 twister(sizeof(TypeParam));
+    for (int n = 0; n < 1000; n++) {
+        // Spread the values over all the encoded lengths
+        const auto value = gsl::narrow_cast<TypeParam>(
+                twister() >> (twister() % (sizeof(uint64_t) * 8)));
+        cb::mcbp::unsigned_leb128<TypeParam> leb(value);
+        std::vector<uint8_t> data(leb.begin(), leb.end());
+        const uint8_t trailing = (n % 2) ? 0xff : 0x01;
+        data.resize(leb.size() + 8, trailing);
+
+        auto rv = cb::mcbp::decode_unsigned_leb128<TypeParam>({data});
+        EXPECT_EQ(value, rv.first);
+        ASSERT_EQ(8, rv.second.size());
+        EXPECT_EQ(data.data() + leb.size(), rv.second.data());
+    }
+}
+
 TYPED_TEST(UnsignedLeb128, DecodeInvalidInput) {
     // Encode a value and then break the value by removing the stop-byte
     std::mt19937_64 twister(sizeof(TypeParam));
@@ -0,0 +1,137 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "daemon/vbucket_load.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+
+using cb::mcbp::ClientOpcode;
+
+class VBucketLoadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        load.resize(4);
+    }
+
+    VBucketLoad load;
+};
+
+// Nothing is reported before the first sample, or for vBuckets not accessed.
+TEST_F(VBucketLoadTest, Empty) {
+    EXPECT_TRUE(load.getLoad().empty());
+    load.record(0, ClientOpcode::Get, Vbid(1), 10);
+    EXPECT_TRUE(load.getLoad().empty());
+    load.sample();
+    EXPECT_EQ(1, load.getLoad().size());
+
+    // Commands which don't access documents, and vBuckets out of range
+    load.record(0, ClientOpcode::Noop, Vbid(2), 0);
+    load.record(0, ClientOpcode::Get, Vbid(VBucketLoad::MaxVBuckets), 0);
+    load.sample();
+    EXPECT_EQ(1, load.getLoad().size());
+}
+
+TEST_F(VBucketLoadTest, Counts) {
+    load.record(0, ClientOpcode::Get, Vbid(3), 100);
+    load.record(1, ClientOpcode::Get, Vbid(3), 100);
+    load.record(2, ClientOpcode::Set, Vbid(3), 50);
+    load.record(3, ClientOpcode::Gat, Vbid(3), 10);
+    load.sample();
+
+    auto result = load.getLoad();
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(Vbid(3), result[0].vbucket);
+    EXPECT_EQ(3, result[0].reads);
+    EXPECT_EQ(2, result[0].writes);
+    EXPECT_EQ(260, result[0].bytes);
+    EXPECT_EQ(3, result[0].readsPerSec);
+    EXPECT_EQ(2, result[0].writesPerSec);
+    EXPECT_EQ(260, result[0].bytesPerSec);
+
+    // A second without traffic halves the rates, but not the totals
+    load.sample();
+    result = load.getLoad();
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(3, result[0].reads);
+    EXPECT_EQ(1, result[0].readsPerSec);
+    EXPECT_EQ(130, result[0].bytesPerSec);
+
+    load.reset();
+    EXPECT_TRUE(load.getLoad().empty());
+}
+
+// Only the last WindowSize seconds count towards the rates.
+TEST_F(VBucketLoadTest, Window) {
+    for (size_t ii = 0; ii < VBucketLoad::WindowSize; ++ii) {
+        load.record(0, ClientOpcode::Set, Vbid(0), 0);
+        load.sample();
+    }
+    auto result = load.getLoad();
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(1, result[0].writesPerSec);
+
+    for (size_t ii = 0; ii < VBucketLoad::WindowSize; ++ii) {
+        load.sample();
+    }
+    result = load.getLoad();
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(VBucketLoad::WindowSize, result[0].writes);
+    EXPECT_EQ(0, result[0].writesPerSec);
+}
+
+// The hottest vBuckets are returned first.
+TEST_F(VBucketLoadTest, Hottest) {
+    for (uint16_t vb = 0; vb < 10; ++vb) {
+        for (uint16_t ii = 0; ii <= vb; ++ii) {
+            load.record(vb % 4, ClientOpcode::Get, Vbid(vb), 0);
+        }
+    }
+    load.sample();
+
+    auto result = load.getLoad(3);
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ(Vbid(9), result[0].vbucket);
+    EXPECT_EQ(Vbid(8), result[1].vbucket);
+    EXPECT_EQ(Vbid(7), result[2].vbucket);
+    EXPECT_EQ(10, load.getLoad().size());
+}
+
+// Threads count concurrently with sampling.
+TEST_F(VBucketLoadTest, Concurrent) {
+    const int ops = 10000;
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([this, thread] {
+            for (int ii = 0; ii < ops; ++ii) {
+                load.record(thread, ClientOpcode::Set, Vbid(5), 1);
+            }
+        });
+    }
+    for (int ii = 0; ii < 5; ++ii) {
+        load.sample();
+        load.getLoad();
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    load.sample();
+
+    const auto result = load.getLoad();
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(4 * ops, result[0].writes);
+    EXPECT_EQ(4 * ops, result[0].bytes);
+}
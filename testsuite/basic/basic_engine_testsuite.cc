@@ -24,6 +24,7 @@
 #include "basic_engine_testsuite.h"
 
 #include <iostream>
+#include <map>
 #include <vector>
 #include <sstream>
 
@@ -507,6 +508,87 @@ static enum test_result lru_test(EngineIface* h) {
     return SUCCESS;
 }
 
+std::map<std::string, std::string> slab_stats;
+static void slab_stats_handler(const char* key,
+                               const uint16_t klen,
+                               const char* val,
+                               const uint32_t vlen,
+                               gsl::not_null<const void*>) {
+    slab_stats[std::string(key, klen)] = std::string(val, vlen);
+}
+
+static void store_items(EngineIface* h,
+                        const void* cookie,
+                        const char* prefix,
+                        size_t nbytes,
+                        int first,
+                        int last) {
+    for (int ii = first; ii < last; ++ii) {
+        uint64_t cas = 0;
+        std::string key = prefix + std::to_string(ii);
+        DocKey allocate_key(key, DocKeyEncodesCollectionId::No);
+        auto ret = h->allocate(cookie,
+                               allocate_key,
+                               nbytes,
+                               0,
+                               0,
+                               PROTOCOL_BINARY_RAW_BYTES,
+                               Vbid(0));
+        cb_assert(ret.first == cb::engine_errc::success);
+        cb_assert(h->store(cookie,
+                           ret.second.get(),
+                           cas,
+                           OPERATION_SET,
+                           {},
+                           DocumentState::Alive) == ENGINE_SUCCESS);
+    }
+}
+
+/*
+ * Once the memory is filled with small items, storing larger items should
+ * move slabs from the class of the small items instead of evicting the larger
+ * ones.
+ */
+static enum test_result slab_automove_test(EngineIface* h) {
+    const auto* cookie = test_harness->create_cookie();
+
+    int small = 0;
+    evictions = 0;
+    while (evictions == 0) {
+        store_items(h, cookie, "small_", 100, small, small + 100);
+        small += 100;
+        cb_assert(h->get_stats(cookie, {}, eviction_stats_handler) ==
+                  ENGINE_SUCCESS);
+    }
+    const auto small_evictions = evictions;
+
+    // Let the evictions of the small items fall out of the automove window
+    test_harness->time_travel(30);
+
+    // Fills the first slab of the class, evicts one large item (which marks
+    // the class as short of memory), and then needs slabs moved
+    const int large = 1000;
+    store_items(h, cookie, "large_", 4000, 0, large);
+
+    cb_assert(h->get_stats(cookie, {}, eviction_stats_handler) ==
+              ENGINE_SUCCESS);
+    assert_equal(small_evictions + 1, evictions);
+    cb_assert(h->get_stats(cookie, "slabs"_ccb, slab_stats_handler) ==
+              ENGINE_SUCCESS);
+    assert_ge(std::stoi(slab_stats["slabs_moved"]), 3);
+    assert_ge(std::stoi(slab_stats["slab_reassign_evicted"]), 1);
+
+    for (int ii = 1; ii < large; ++ii) {
+        std::string key = "large_" + std::to_string(ii);
+        DocKey get_key(key, DocKeyEncodesCollectionId::No);
+        auto ret = h->get(cookie, get_key, Vbid(0), DocStateFilter::Alive);
+        cb_assert(ret.first == cb::engine_errc::success);
+    }
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
 static enum test_result get_stats_test(EngineIface* h) {
     return PENDING;
 }
@@ -660,6 +742,7 @@ engine_test_t* get_tests(void) {
 #ifndef VALGRIND
         // this test is disabled for VALGRIND because cache_size=48 and using malloc don't work.
         TEST_CASE("LRU test", lru_test, NULL, NULL, "cache_size=48", NULL, NULL),
+        TEST_CASE("slab automove test", slab_automove_test, NULL, NULL, "cache_size=8388608", NULL, NULL),
 #endif
         TEST_CASE("get stats test", get_stats_test, NULL, NULL, NULL, NULL, NULL),
         TEST_CASE("reset stats test", reset_stats_test, NULL, NULL, NULL, NULL, NULL),
@@ -35,26 +35,29 @@
 class ScopedTracer {
 public:
     ScopedTracer(Cookie& cookie, const cb::tracing::TraceCode code)
-        : cookie(cookie) {
+        : cookie(&cookie) {
         if (cookie.isTracingEnabled()) {
             spanId = cookie.getTracer().begin(code);
         }
     }
 
-    /// Constructor from Cookie (void*)
+    /// Constructor from Cookie (void*), which may be nullptr (no request
+    /// to trace)
     ScopedTracer(const void* cookie, const cb::tracing::TraceCode code)
-        : ScopedTracer(*reinterpret_cast<Cookie*>(const_cast<void*>(cookie)),
-                       code) {
+        : cookie(reinterpret_cast<Cookie*>(const_cast<void*>(cookie))) {
+        if (this->cookie && this->cookie->isTracingEnabled()) {
+            spanId = this->cookie->getTracer().begin(code);
+        }
     }
 
     ~ScopedTracer() {
-        if (cookie.isTracingEnabled()) {
-            cookie.getTracer().end(spanId);
+        if (cookie && cookie->isTracingEnabled()) {
+            cookie->getTracer().end(spanId);
         }
     }
 
 protected:
-    Cookie& cookie;
+    Cookie* cookie;
 
     /// ID of our Span.
     cb::tracing::Tracer::SpanId spanId = {};
@@ -83,16 +86,19 @@ public:
         }
     }
 
-    /// Constructor from Cookie (void*)
+    /// Constructor from Cookie (void*), which may be nullptr (no request
+    /// to trace)
     InstantTracer(const void* cookie,
                   const cb::tracing::TraceCode code,
                   bool begin,
                   std::chrono::steady_clock::time_point time =
-                          std::chrono::steady_clock::now())
-        : InstantTracer(*reinterpret_cast<Cookie*>(const_cast<void*>(cookie)),
-                        code,
-                        begin,
-                        time) {
+                          std::chrono::steady_clock::now()) {
+        if (cookie) {
+            InstantTracer(*reinterpret_cast<Cookie*>(const_cast<void*>(cookie)),
+                          code,
+                          begin,
+                          time);
+        }
     }
 };
 
@@ -53,15 +53,16 @@ bool Tracer::end(SpanId spanId, std::chrono::steady_clock::time_point endTime) {
 
 bool Tracer::end(const TraceCode tracecode,
                  std::chrono::steady_clock::time_point endTime) {
-    // Locate the ID for this tracecode (when we begin the Span).
-    SpanId spanId = 0;
-    for (const auto& span : vecSpans) {
-        if (span.code == tracecode) {
-            break;
+    // Locate the ID for this tracecode (when we begin the Span). The same
+    // code may be used more than once in a request, so pick the most recent
+    // span which hasn't ended yet.
+    for (auto spanId = vecSpans.size(); spanId > 0; --spanId) {
+        const auto& span = vecSpans[spanId - 1];
+        if (span.code == tracecode && span.duration == Span::Duration::max()) {
+            return end(spanId - 1, endTime);
         }
-        spanId++;
     }
-    return end(spanId, endTime);
+    return false;
 }
 
 const std::vector<Span>& Tracer::getDurations() const {
@@ -156,6 +157,14 @@ MEMCACHED_PUBLIC_API std::string to_string(
         return "set.with.meta";
     case TraceCode::STORE:
         return "store";
+    case TraceCode::HASH_LOCK:
+        return "hash.lock";
+    case TraceCode::BLOOM_FILTER:
+        return "bloom.filter";
+    case TraceCode::QUEUE_DIRTY:
+        return "queue.dirty";
+    case TraceCode::NOTIFY_IO:
+        return "notify.io";
     }
     return "unknown tracecode";
 }
@@ -35,6 +35,15 @@ enum class TraceCode : uint8_t {
     GETSTATS,
     SETWITHMETA,
     STORE,
+    /// Time spent locking the hash bucket of the key (and finding the key)
+    HASH_LOCK,
+    /// Time spent checking the bloom filter for the key
+    BLOOM_FILTER,
+    /// Time spent queueing the mutation into the checkpoint
+    QUEUE_DIRTY,
+    /// Time from the engine notifying a blocked request (e.g. its background
+    /// fetch completed) until the front end thread resumed it.
+    NOTIFY_IO,
 };
 } // namespace tracing
 } // namespace cb
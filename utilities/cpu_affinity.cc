@@ -0,0 +1,142 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "cpu_affinity.h"
+#include "string_utilities.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> ret;
+    if (list.empty()) {
+        return ret;
+    }
+
+    for (const auto& range : split_string(list, ",")) {
+        const auto bounds = split_string(range, "-", 1);
+        try {
+            size_t pos;
+            const auto first = std::stoi(bounds.front(), &pos);
+            if (pos != bounds.front().size()) {
+                throw std::invalid_argument("trailing characters");
+            }
+            auto last = first;
+            if (bounds.size() == 2) {
+                last = std::stoi(bounds.back(), &pos);
+                if (pos != bounds.back().size()) {
+                    throw std::invalid_argument("trailing characters");
+                }
+            }
+            if (first < 0 || last < first) {
+                throw std::invalid_argument("invalid range");
+            }
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                ret.push_back(cpu);
+            }
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("parse_cpu_list: Invalid CPU list: \"" +
+                                        list + "\"");
+        }
+    }
+    return ret;
+}
+
+int get_numa_node_count() {
+    int nodes = 0;
+    while (!get_numa_node_cpus(nodes).empty()) {
+        ++nodes;
+    }
+    return nodes == 0 ? 1 : nodes;
+}
+
+std::vector<int> get_numa_node_cpus(int node) {
+#ifdef __linux__
+    std::ifstream file("/sys/devices/system/node/node" +
+                       std::to_string(node) + "/cpulist");
+    std::string list;
+    if (file && std::getline(file, list)) {
+        try {
+            return parse_cpu_list(list);
+        } catch (const std::invalid_argument&) {
+        }
+    }
+#endif
+    return {};
+}
+
+bool bind_current_thread_to_cpus(const std::vector<int>& cpus) {
+#ifdef __linux__
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    // With a pid of 0 the affinity of the calling thread is set
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+bool prefer_local_numa_memory() {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    // MPOL_PREFERRED with an empty node mask means "the local node"
+    // (spelled out to avoid a dependency on libnuma's numaif.h)
+    const int mpolPreferred = 1;
+    return syscall(SYS_set_mempolicy, mpolPreferred, nullptr, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+bool bind_memory_to_numa_node(void* addr, size_t length, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    unsigned long mask = 0;
+    if (node < 0 || node >= int(sizeof(mask) * 8)) {
+        return false;
+    }
+    mask = 1UL << node;
+    // MPOL_PREFERRED; the kernel ignores the last bit of maxnode (which is
+    // why libnuma passes one more than the mask's size too)
+    const int mpolPreferred = 1;
+    return syscall(SYS_mbind,
+                   addr,
+                   length,
+                   mpolPreferred,
+                   &mask,
+                   sizeof(mask) * 8 + 1,
+                   0) == 0;
+#else
+    (void)addr;
+    (void)length;
+    (void)node;
+    return false;
+#endif
+}
@@ -0,0 +1,82 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memcached/mcd_util-visibility.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Helpers for placing threads on CPUs and NUMA nodes. Thread placement is
+ * only supported on Linux; elsewhere the functions report that nothing
+ * could be done.
+ */
+
+/**
+ * Parse a list of CPUs in the format used by Linux (and taskset), like
+ * "0-3,8,10-11"
+ *
+ * @param list the list to parse
+ * @return the CPUs in the list, in the order given
+ * @throws std::invalid_argument if the list is malformed
+ */
+MCD_UTIL_PUBLIC_API
+std::vector<int> parse_cpu_list(const std::string& list);
+
+/**
+ * Get the number of NUMA nodes of the host (1 if the host isn't NUMA or
+ * the topology isn't known)
+ */
+MCD_UTIL_PUBLIC_API
+int get_numa_node_count();
+
+/**
+ * Get the CPUs of a NUMA node
+ *
+ * @return the CPUs, or an empty list if they aren't known
+ */
+MCD_UTIL_PUBLIC_API
+std::vector<int> get_numa_node_cpus(int node);
+
+/**
+ * Restrict the calling thread to run on the given CPUs
+ *
+ * @return true on success
+ */
+MCD_UTIL_PUBLIC_API
+bool bind_current_thread_to_cpus(const std::vector<int>& cpus);
+
+/**
+ * Make the memory the calling thread allocates come from the NUMA node it
+ * runs on (when possible), overriding the process wide policy (which may
+ * be to interleave all memory over all nodes).
+ *
+ * @return true on success
+ */
+MCD_UTIL_PUBLIC_API
+bool prefer_local_numa_memory();
+
+/**
+ * Make the pages of the given (not yet touched) mapping come from the given
+ * NUMA node when possible.
+ *
+ * @return true on success
+ */
+MCD_UTIL_PUBLIC_API
+bool bind_memory_to_numa_node(void* addr, size_t length, int node);
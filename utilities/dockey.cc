@@ -18,6 +18,7 @@
 #include <mcbp/protocol/unsigned_leb128.h>
 #include <memcached/dockey.h>
 #include <sstream>
+#include <stdexcept>
 
 std::string CollectionID::to_string() const {
     std::stringstream sstream;
@@ -31,24 +32,19 @@ std::string ScopeID::to_string() const {
     return sstream.str();
 }
 
-CollectionID DocKey::getCollectionID() const {
-    if (encoding == DocKeyEncodesCollectionId::Yes) {
-        return cb::mcbp::decode_unsigned_leb128<CollectionIDType>(buffer).first;
+void DocKey::decodeCollectionID() {
+    if (buffer.size() == 0) {
+        return;
     }
-    return CollectionID::Default;
-}
-
-std::pair<CollectionID, cb::const_byte_buffer> DocKey::getIdAndKey() const {
-    if (encoding == DocKeyEncodesCollectionId::Yes) {
-        return cb::mcbp::decode_unsigned_leb128<CollectionIDType>(buffer);
+    const auto decoded = cb::mcbp::decode_unsigned_leb128<CollectionIDType>(
+            buffer, cb::mcbp::Leb128NoThrow());
+    if (decoded.second.data()) {
+        collectionID = decoded.first;
+        prefixLen = gsl::narrow_cast<uint8_t>(decoded.second.data() - data());
     }
-    return {CollectionID::Default, {data(), size()}};
 }
 
-DocKey DocKey::makeDocKeyWithoutCollectionID() const {
-    if (getEncoding() == DocKeyEncodesCollectionId::Yes) {
-        auto decoded = cb::mcbp::skip_unsigned_leb128<CollectionIDType>(buffer);
-        return {decoded.data(), decoded.size(), DocKeyEncodesCollectionId::No};
-    }
-    return *this;
+void DocKey::throwInvalidCollectionID() const {
+    throw std::invalid_argument(
+            "DocKey::getCollectionID: key does not encode a collection-ID");
 }
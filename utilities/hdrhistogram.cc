@@ -98,6 +98,13 @@ HdrHistogram::Iterator HdrHistogram::makeLogIterator(int64_t firstBucketWidth,
     return iter;
 }
 
+HdrHistogram::Iterator HdrHistogram::makeRecordedIterator() const {
+    HdrHistogram::Iterator iter;
+    iter.type = Iterator::IterMode::Recorded;
+    hdr_iter_recorded_init(&iter, histogram.get());
+    return iter;
+}
+
 boost::optional<std::pair<uint64_t, uint64_t>>
 HdrHistogram::getNextValueAndCount(Iterator& iter) const {
     boost::optional<std::pair<uint64_t, uint64_t>> valueAndCount;
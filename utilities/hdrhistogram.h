@@ -141,6 +141,12 @@ public:
      */
     Iterator makeLogIterator(int64_t firstBucketWidth, double log_base) const;
 
+    /**
+     * Returns an iterator over the buckets of the histogram which have
+     * values recorded in them
+     */
+    Iterator makeRecordedIterator() const;
+
     /**
      * Gets the next value and corresponding count from the histogram
      * Returns an optional pair, comprising of:
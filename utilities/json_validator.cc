@@ -0,0 +1,620 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "json_validator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_VALIDATOR_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace cb {
+namespace json {
+
+namespace {
+
+/// Bitmasks of the classes of the bytes of a 64 byte block (bit n is byte n)
+struct Block {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t structural = 0;
+    uint64_t whitespace = 0;
+    /// Bytes below 0x20 (including the whitespace ones)
+    uint64_t control = 0;
+    uint64_t nonAscii = 0;
+};
+
+inline int countTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return int(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+/// @return a mask with bit n set if an odd number of the bits 0..n are set
+inline uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+inline bool isWhitespace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/// @return true if c ends a scalar (number or literal)
+inline bool isDelimiter(uint8_t c) {
+    switch (c) {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+    case ',':
+    case ':':
+    case '[':
+    case ']':
+    case '{':
+    case '}':
+    case '"':
+        return true;
+    }
+    return false;
+}
+
+inline bool isDigit(uint8_t c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool isHexDigit(uint8_t c) {
+    return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+#ifdef JSON_VALIDATOR_SSE2
+inline uint64_t movemask(__m128i v) {
+    return uint16_t(_mm_movemask_epi8(v));
+}
+
+inline __m128i anyOf(__m128i v, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, b));
+}
+
+Block classify(const uint8_t* data) {
+    const auto quote = _mm_set1_epi8('"');
+    const auto backslash = _mm_set1_epi8('\\');
+    const auto openBrace = _mm_set1_epi8('{');
+    const auto closeBrace = _mm_set1_epi8('}');
+    const auto openBracket = _mm_set1_epi8('[');
+    const auto closeBracket = _mm_set1_epi8(']');
+    const auto colon = _mm_set1_epi8(':');
+    const auto comma = _mm_set1_epi8(',');
+    const auto space = _mm_set1_epi8(' ');
+    const auto tab = _mm_set1_epi8('\t');
+    const auto newline = _mm_set1_epi8('\n');
+    const auto cr = _mm_set1_epi8('\r');
+
+    Block block;
+    for (int ii = 0; ii < 4; ++ii) {
+        const auto v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + ii * 16));
+        const int shift = ii * 16;
+        block.quote |= movemask(_mm_cmpeq_epi8(v, quote)) << shift;
+        block.backslash |= movemask(_mm_cmpeq_epi8(v, backslash)) << shift;
+        const auto structural =
+                _mm_or_si128(_mm_or_si128(anyOf(v, openBrace, closeBrace),
+                                          anyOf(v, openBracket, closeBracket)),
+                             anyOf(v, colon, comma));
+        block.structural |= movemask(structural) << shift;
+        const auto whitespace =
+                _mm_or_si128(anyOf(v, space, tab), anyOf(v, newline, cr));
+        block.whitespace |= movemask(whitespace) << shift;
+
+        // Bytes >= 0x80 are negative, so also compare less than ' '.
+        const auto nonAscii = movemask(v);
+        block.control |= (movemask(_mm_cmplt_epi8(v, space)) & ~nonAscii)
+                         << shift;
+        block.nonAscii |= nonAscii << shift;
+    }
+    return block;
+}
+#else
+Block classify(const uint8_t* data) {
+    Block block;
+    for (int ii = 0; ii < 64; ++ii) {
+        const uint64_t bit = uint64_t(1) << ii;
+        switch (data[ii]) {
+        case '"':
+            block.quote |= bit;
+            break;
+        case '\\':
+            block.backslash |= bit;
+            break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+            block.structural |= bit;
+            break;
+        case ' ':
+            block.whitespace |= bit;
+            break;
+        case '\t':
+        case '\n':
+        case '\r':
+            block.whitespace |= bit;
+            block.control |= bit;
+            break;
+        default:
+            if (data[ii] < 0x20) {
+                block.control |= bit;
+            } else if (data[ii] >= 0x80) {
+                block.nonAscii |= bit;
+            }
+        }
+    }
+    return block;
+}
+#endif
+
+/**
+ * Check the input is valid (shortest form, non-surrogate, at most U+10FFFF)
+ * UTF-8.
+ */
+bool isValidUtf8(const uint8_t* data, size_t size) {
+    size_t ii = 0;
+    while (ii < size) {
+        // Skip ASCII 8 bytes at a time.
+        while (ii + 8 <= size) {
+            uint64_t word;
+            std::memcpy(&word, data + ii, sizeof(word));
+            if (word & 0x8080808080808080ULL) {
+                break;
+            }
+            ii += 8;
+        }
+        if (ii == size) {
+            break;
+        }
+
+        const uint8_t c = data[ii];
+        if (c < 0x80) {
+            ++ii;
+            continue;
+        }
+
+        size_t length;
+        uint32_t codepoint;
+        uint32_t min;
+        if ((c & 0xe0) == 0xc0) {
+            length = 2;
+            codepoint = c & 0x1f;
+            min = 0x80;
+        } else if ((c & 0xf0) == 0xe0) {
+            length = 3;
+            codepoint = c & 0x0f;
+            min = 0x800;
+        } else if ((c & 0xf8) == 0xf0) {
+            length = 4;
+            codepoint = c & 0x07;
+            min = 0x10000;
+        } else {
+            return false;
+        }
+
+        if (size - ii < length) {
+            return false;
+        }
+        for (size_t jj = 1; jj < length; ++jj) {
+            if ((data[ii + jj] & 0xc0) != 0x80) {
+                return false;
+            }
+            codepoint = (codepoint << 6) | (data[ii + jj] & 0x3f);
+        }
+        if (codepoint < min || codepoint > 0x10ffff ||
+            (codepoint >= 0xd800 && codepoint <= 0xdfff)) {
+            return false;
+        }
+        ii += length;
+    }
+    return true;
+}
+
+/// Check the number or literal (true, false, null) starting at data
+bool isValidScalar(const uint8_t* data, size_t size) {
+    size_t length = 0;
+    while (length < size && !isDelimiter(data[length])) {
+        ++length;
+    }
+
+    switch (data[0]) {
+    case 't':
+        return length == 4 && std::memcmp(data, "true", 4) == 0;
+    case 'f':
+        return length == 5 && std::memcmp(data, "false", 5) == 0;
+    case 'n':
+        return length == 4 && std::memcmp(data, "null", 4) == 0;
+    }
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    size_t ii = 0;
+    if (data[ii] == '-') {
+        ++ii;
+    }
+    if (ii == length) {
+        return false;
+    }
+    if (data[ii] == '0') {
+        ++ii;
+    } else if (isDigit(data[ii])) {
+        while (ii < length && isDigit(data[ii])) {
+            ++ii;
+        }
+    } else {
+        return false;
+    }
+
+    if (ii < length && data[ii] == '.') {
+        const auto start = ++ii;
+        while (ii < length && isDigit(data[ii])) {
+            ++ii;
+        }
+        if (ii == start) {
+            return false;
+        }
+    }
+
+    if (ii < length && (data[ii] == 'e' || data[ii] == 'E')) {
+        ++ii;
+        if (ii < length && (data[ii] == '+' || data[ii] == '-')) {
+            ++ii;
+        }
+        const auto start = ii;
+        while (ii < length && isDigit(data[ii])) {
+            ++ii;
+        }
+        if (ii == start) {
+            return false;
+        }
+    }
+
+    return ii == length;
+}
+
+/**
+ * Stage 1: classifies the document a block at a time, appending the offset
+ * of every structural character, string (its opening quote) and scalar
+ * (its first byte) outside of strings to the index.
+ *
+ * While doing so the contents of the strings are checked, other than
+ * UTF-8 which is left to the caller (see getFirstNonAscii()).
+ */
+class Indexer {
+public:
+    Indexer(const uint8_t* data, size_t size) : data(data), size(size) {
+    }
+
+    /**
+     * Index the given (64 byte aligned) range of the document.
+     *
+     * @return false if the range is invalid
+     */
+    bool index(size_t begin, size_t end, std::vector<uint32_t>& indexes) {
+        for (size_t offset = begin; offset < end; offset += 64) {
+            const uint8_t* ptr = data + offset;
+            uint8_t tail[64];
+            if (size - offset < 64) {
+                // Pad the tail with whitespace, which changes nothing.
+                std::memset(tail, ' ', sizeof(tail));
+                std::memcpy(tail, ptr, size - offset);
+                ptr = tail;
+            }
+            if (!indexBlock(offset, classify(ptr), indexes)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @return true if the document ended in the middle of a string
+    bool inString() const {
+        return prevInString != 0;
+    }
+
+    /**
+     * @return the offset of the first block containing non-ASCII bytes (all
+     *         of which are in strings), or size if there are none
+     */
+    size_t getFirstNonAscii() const {
+        return firstNonAscii;
+    }
+
+private:
+    bool indexBlock(size_t offset,
+                    const Block& block,
+                    std::vector<uint32_t>& indexes) {
+        uint64_t escaped = 0;
+        if (block.backslash || prevEscaped) {
+            escaped = findEscaped(block.backslash);
+        }
+
+        // Bit set for the opening quote and contents of strings.
+        const uint64_t quotes = block.quote & ~escaped;
+        const uint64_t inString = prefixXor(quotes) ^ prevInString;
+        prevInString = uint64_t(int64_t(inString) >> 63);
+
+        // Control characters must be escaped in strings, and backslashes
+        // and non-ASCII bytes are only valid in strings.
+        if ((block.control & inString) || (escaped & ~inString) ||
+            (block.nonAscii & ~inString)) {
+            return false;
+        }
+        if (escaped && !checkEscapes(offset, escaped)) {
+            return false;
+        }
+        if (block.nonAscii && firstNonAscii == size) {
+            firstNonAscii = offset;
+        }
+
+        const uint64_t scalar =
+                ~(block.structural | block.whitespace | block.quote) &
+                ~inString;
+        const uint64_t scalarStart = scalar & ~((scalar << 1) | prevScalar);
+        prevScalar = scalar >> 63;
+
+        uint64_t bits = (block.structural & ~inString) | (quotes & inString) |
+                        scalarStart;
+        while (bits) {
+            indexes.push_back(uint32_t(offset + countTrailingZeros(bits)));
+            bits &= bits - 1;
+        }
+        return true;
+    }
+
+    /**
+     * @return a mask of the bytes which follow an odd length run of
+     *         backslashes (i.e. which are escaped)
+     */
+    uint64_t findEscaped(uint64_t backslash) {
+        uint64_t escaped = 0;
+        if (prevEscaped) {
+            // The first byte is escaped by the last of the previous block.
+            escaped = 1;
+            backslash &= ~uint64_t(1);
+            prevEscaped = 0;
+        }
+        while (backslash) {
+            const int bit = countTrailingZeros(backslash);
+            if (bit == 63) {
+                prevEscaped = 1;
+                break;
+            }
+            escaped |= uint64_t(1) << (bit + 1);
+            backslash &= ~(uint64_t(3) << bit);
+        }
+        return escaped;
+    }
+
+    /// Check the escaped bytes of a block are valid escapes
+    bool checkEscapes(size_t offset, uint64_t escaped) const {
+        while (escaped) {
+            const size_t pos = offset + countTrailingZeros(escaped);
+            escaped &= escaped - 1;
+            if (pos >= size) {
+                return false;
+            }
+            switch (data[pos]) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                break;
+            case 'u':
+                if (size - pos <= 4 || !isHexDigit(data[pos + 1]) ||
+                    !isHexDigit(data[pos + 2]) || !isHexDigit(data[pos + 3]) ||
+                    !isHexDigit(data[pos + 4])) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const uint8_t* const data;
+    const size_t size;
+    size_t firstNonAscii = size;
+
+    /// 1 if the first byte of the next block is escaped
+    uint64_t prevEscaped = 0;
+    /// All ones if the previous block ended in a string
+    uint64_t prevInString = 0;
+    /// 1 if the previous block ended with (part of) a scalar
+    uint64_t prevScalar = 0;
+};
+
+/**
+ * Stage 2: checks the indexed structural characters, strings and scalars
+ * form a valid object or array.
+ */
+class GrammarChecker {
+public:
+    GrammarChecker(const uint8_t* data, size_t size) : data(data), size(size) {
+    }
+
+    bool check(const std::vector<uint32_t>& indexes) {
+        for (const auto index : indexes) {
+            if (!step(index)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool isComplete() const {
+        return state == State::Done;
+    }
+
+private:
+    enum class State {
+        /// A value (only an object or array at the top level)
+        Value,
+        /// A value or ']' (after '[')
+        ValueOrEnd,
+        /// An object key (after ',')
+        Key,
+        /// An object key or '}' (after '{')
+        KeyOrEnd,
+        Colon,
+        /// A ',' or the end of the current object / array
+        CommaOrEnd,
+        /// The top level object / array is complete
+        Done
+    };
+
+    bool step(size_t index) {
+        const auto c = data[index];
+        switch (c) {
+        case '{':
+        case '[':
+            if ((state != State::Value && state != State::ValueOrEnd) ||
+                depth == Validator::MaxDepth) {
+                return false;
+            }
+            stack[depth++] = c;
+            state = (c == '{') ? State::KeyOrEnd : State::ValueOrEnd;
+            return true;
+
+        case '}':
+        case ']': {
+            const auto open = (c == '}') ? '{' : '[';
+            const auto empty = (c == '}') ? State::KeyOrEnd : State::ValueOrEnd;
+            if (depth == 0 || stack[depth - 1] != open ||
+                (state != State::CommaOrEnd && state != empty)) {
+                return false;
+            }
+            --depth;
+            state = depth ? State::CommaOrEnd : State::Done;
+            return true;
+        }
+
+        case ':':
+            if (state != State::Colon) {
+                return false;
+            }
+            state = State::Value;
+            return true;
+
+        case ',':
+            if (state != State::CommaOrEnd) {
+                return false;
+            }
+            state = (stack[depth - 1] == '{') ? State::Key : State::Value;
+            return true;
+
+        case '"':
+            if (state == State::Key || state == State::KeyOrEnd) {
+                state = State::Colon;
+                return true;
+            }
+            break;
+
+        default:
+            if (!isValidScalar(data + index, size - index)) {
+                return false;
+            }
+            break;
+        }
+
+        // A string or scalar value, which can't be at the top level.
+        if (depth == 0 ||
+            (state != State::Value && state != State::ValueOrEnd)) {
+            return false;
+        }
+        state = State::CommaOrEnd;
+        return true;
+    }
+
+    const uint8_t* const data;
+    const size_t size;
+    State state = State::Value;
+    size_t depth = 0;
+    uint8_t stack[Validator::MaxDepth];
+};
+
+} // anonymous namespace
+
+bool Validator::validate(const uint8_t* data, size_t size) {
+    return validateFast(data, size) || fallback.validate(data, size);
+}
+
+bool Validator::validateFast(const uint8_t* data, size_t size) {
+    if (size > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+
+    // Give up straight away on anything which isn't an object or array
+    // (which includes most binary values); there's no point indexing it.
+    size_t start = 0;
+    while (start < size && isWhitespace(data[start])) {
+        ++start;
+    }
+    if (start == size || (data[start] != '{' && data[start] != '[')) {
+        return false;
+    }
+
+    Indexer indexer(data, size);
+    GrammarChecker grammar(data, size);
+    for (size_t begin = 0; begin < size; begin += ChunkSize) {
+        indexes.clear();
+        const auto end = std::min(begin + ChunkSize, size);
+        if (!indexer.index(begin, end, indexes) || !grammar.check(indexes)) {
+            return false;
+        }
+    }
+
+    if (indexer.inString() || !grammar.isComplete()) {
+        return false;
+    }
+
+    const auto nonAscii = indexer.getFirstNonAscii();
+    return nonAscii == size || isValidUtf8(data + nonAscii, size - nonAscii);
+}
+
+} // namespace json
+} // namespace cb
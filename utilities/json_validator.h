@@ -0,0 +1,103 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <JSON_checker.h>
+#include <memcached/mcd_util-visibility.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cb {
+namespace json {
+
+/**
+ * A JSON validator with the same interface (and the same answers) as
+ * JSON_checker::Validator, which validates the common case of an object or
+ * array document without stepping through it a byte at a time.
+ *
+ * Validation is done in two stages (in the style of simdjson):
+ *
+ * 1. The document is classified 64 bytes at a time (using SSE2 where
+ *    available) into bitmasks of quotes, backslashes, structural characters,
+ *    whitespace and control characters. Simple bit manipulation of the masks
+ *    gives which bytes are inside strings, checks there are no control
+ *    characters in strings, and produces the index of every structural
+ *    character, string and scalar (number / literal) outside of strings.
+ * 2. The indexes are walked to check the grammar, with each scalar checked
+ *    individually. String contents were already checked by stage 1 (plus
+ *    the escape sequences and UTF-8, which are only looked at when the
+ *    document contains any).
+ *
+ * Only documents which this proves are valid JSON objects or arrays are
+ * answered directly; everything else (invalid documents, top level scalars,
+ * very deeply nested documents) is passed to JSON_checker::Validator, so the
+ * result is always the same as JSON_checker's.
+ *
+ * An instance keeps its buffers between calls, and must not be used by more
+ * than one thread at a time.
+ */
+class MCD_UTIL_PUBLIC_API Validator {
+public:
+    /**
+     * Check if the data is valid JSON.
+     *
+     * @param data pointer to the data to check
+     * @param size the number of bytes to check
+     * @return true if the data is valid JSON
+     */
+    bool validate(const uint8_t* data, size_t size);
+
+    bool validate(const char* data, size_t size) {
+        return validate(reinterpret_cast<const uint8_t*>(data), size);
+    }
+
+    bool validate(const std::string& data) {
+        return validate(data.data(), data.size());
+    }
+
+    /**
+     * Check if the data is a JSON object or array without falling back to
+     * JSON_checker.
+     *
+     * @return true if the data was proven to be valid, false if it isn't or
+     *         couldn't be (in which case JSON_checker has the final say)
+     */
+    bool validateFast(const uint8_t* data, size_t size);
+
+    /// Deepest nesting validateFast() handles before it gives up
+    static const size_t MaxDepth = 64;
+
+    /**
+     * The document is indexed (and the indexes checked) this many bytes at a
+     * time, which bounds the memory used for the indexes and lets invalid
+     * documents be rejected without indexing all of them.
+     */
+    static const size_t ChunkSize = 64 * 1024;
+
+private:
+    /// Offsets of the structural characters, strings and scalars of a chunk
+    std::vector<uint32_t> indexes;
+
+    JSON_checker::Validator fallback;
+};
+
+} // namespace json
+} // namespace cb
@@ -0,0 +1,175 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for cb::json::Validator
+ */
+
+#include "json_validator.h"
+
+#include <JSON_checker.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+class JsonValidatorTest : public ::testing::Test {
+protected:
+    /// Check the validator agrees with JSON_checker, and return its answer.
+    bool validate(const std::string& value) {
+        const auto* data = reinterpret_cast<const uint8_t*>(value.data());
+        const auto result = validator.validate(data, value.size());
+        EXPECT_EQ(checker.validate(data, value.size()), result) << value;
+        return result;
+    }
+
+    /// @return true if the fast path proved the value is JSON
+    bool validateFast(const std::string& value) {
+        return validator.validateFast(
+                reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    }
+
+    cb::json::Validator validator;
+    JSON_checker::Validator checker;
+};
+
+TEST_F(JsonValidatorTest, Valid) {
+    for (const auto* value : {"{}",
+                              "[]",
+                              " \t\r\n{ } ",
+                              R"({"a":1,"b":[true,false,null],"c":{}})",
+                              R"([0,-0,1.5,-1.5e10,2E-3,1e+2,123456789])",
+                              R"(["\"\\\/\b\f\n\r\t\u00e9\uD83D\uDE00"])",
+                              "[\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\"]",
+                              R"({"key" : [ "value" , { "x" : [ ] } ] })"}) {
+        EXPECT_TRUE(validate(value)) << value;
+        EXPECT_TRUE(validateFast(value)) << value;
+    }
+}
+
+TEST_F(JsonValidatorTest, Invalid) {
+    for (const auto* value : {"",
+                              "  ",
+                              "{",
+                              "]",
+                              "{}}",
+                              "{} []",
+                              "[1,]",
+                              "[,1]",
+                              "{\"a\"}",
+                              "{\"a\":}",
+                              "{\"a\" 1}",
+                              "{1:2}",
+                              "{\"a\":1,}",
+                              "[\"a\" \"b\"]",
+                              "[1 2]",
+                              "[01]",
+                              "[1.]",
+                              "[.5]",
+                              "[1e]",
+                              "[-]",
+                              "[+1]",
+                              "[tru]",
+                              "[truex]",
+                              "[nul]",
+                              "[\"abc]",
+                              "[\"\\x\"]",
+                              "[\"\\u12G4\"]",
+                              "[\"\\u12\"]",
+                              "[\"tab\there\"]",
+                              "[\"\\\"]",
+                              "[\\\"a\"]",
+                              "[\"\xc0\xaf\"]",
+                              "[\"\xed\xa0\x80\"]",
+                              "[\"\xc3\"]",
+                              "[\xc3\xa9]",
+                              "[1]\x01"}) {
+        EXPECT_FALSE(validateFast(value)) << value;
+        validate(value);
+    }
+}
+
+// Top level scalars, and documents nested deeper than the fast path handles,
+// are left to JSON_checker.
+TEST_F(JsonValidatorTest, Fallback) {
+    for (const auto* value : {"1", "\"string\"", "true", "null"}) {
+        EXPECT_FALSE(validateFast(value)) << value;
+        validate(value);
+    }
+
+    const auto depth = cb::json::Validator::MaxDepth;
+    std::string nested = std::string(depth, '[') + std::string(depth, ']');
+    EXPECT_TRUE(validateFast(nested));
+    EXPECT_TRUE(validate(nested));
+
+    nested = "[" + nested + "]";
+    EXPECT_FALSE(validateFast(nested));
+    validate(nested);
+}
+
+// Escapes, strings and scalars spanning the 64 byte blocks and the chunks
+// the document is processed in.
+TEST_F(JsonValidatorTest, BlockBoundaries) {
+    for (size_t pad = 0; pad < 130; ++pad) {
+        const std::string prefix = "[\"" + std::string(pad, 'x');
+        EXPECT_TRUE(validate(prefix + "\\\\\"]")) << pad;
+        EXPECT_TRUE(validate(prefix + "\\\"\"]")) << pad;
+        EXPECT_TRUE(validate(prefix + "\\u00e9\"]")) << pad;
+        EXPECT_FALSE(validate(prefix + "\\\\\\\"]")) << pad;
+        EXPECT_TRUE(validate("[" + std::string(pad, ' ') + "12345.5e7]"))
+                << pad;
+        EXPECT_FALSE(validate("[" + std::string(pad, ' ') + "12345.5e]"))
+                << pad;
+    }
+
+    std::string large = "[";
+    while (large.size() < 3 * cb::json::Validator::ChunkSize) {
+        large += R"({"id":12345,"name":"some \"quoted\" text"},)";
+    }
+    large += "[]]";
+    EXPECT_TRUE(validate(large));
+    EXPECT_TRUE(validateFast(large));
+
+    large[large.size() - 2] = '}';
+    EXPECT_FALSE(validate(large));
+}
+
+// Random corruption of a valid document must give the same answer as
+// JSON_checker.
+TEST_F(JsonValidatorTest, Corrupted) {
+    const std::string doc =
+            R"({"a":[1,-2.5e3,true,false,null,"s\"t\\r\u00e9"],)"
+            R"("b":{"c":{},"d":[]},"e":")"
+            "\xc3\xa9\xe2\x82\xac\"}";
+    const std::string bytes = "{}[]:,\"\\ 0123456789-+.eEtrufalsn\x01\xc3\xff";
+
+    std::mt19937 gen(1);
+    for (int ii = 0; ii < 10000; ++ii) {
+        auto value = doc;
+        const auto pos = gen() % value.size();
+        switch (gen() % 3) {
+        case 0:
+            value.erase(pos, 1);
+            break;
+        case 1:
+            value.insert(pos, 1, bytes[gen() % bytes.size()]);
+            break;
+        default:
+            value[pos] = bytes[gen() % bytes.size()];
+        }
+        validate(value);
+    }
+}
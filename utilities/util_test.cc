@@ -24,6 +24,7 @@
 
 #include <memcached/util.h>
 #include <memcached/config_parser.h>
+#include "cpu_affinity.h"
 #include "string_utilities.h"
 
 #include <gtest/gtest.h>
@@ -173,6 +174,20 @@ TEST(StringTest, split_string) {
                 ElementsAre("Hello", "World<BOOM>!"));
 }
 
+TEST(StringTest, parse_cpu_list) {
+    using namespace testing;
+
+    EXPECT_TRUE(parse_cpu_list("").empty());
+    EXPECT_THAT(parse_cpu_list("3"), ElementsAre(3));
+    EXPECT_THAT(parse_cpu_list("0-3"), ElementsAre(0, 1, 2, 3));
+    EXPECT_THAT(parse_cpu_list("8,0-1,4"), ElementsAre(8, 0, 1, 4));
+    EXPECT_THROW(parse_cpu_list("a"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("1,"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("3-1"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("1-2-3"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("-1"), std::invalid_argument);
+}
+
 TEST(StringTest, percent_decode) {
     // Test every character from 0x00->0xFF that they can be converted to
     // percent encoded strings and back again
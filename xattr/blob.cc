@@ -23,13 +23,29 @@
 #include <arpa/inet.h>
 #endif
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 namespace cb {
 namespace xattr {
 
+/**
+ * Compare a (zero terminated) key stored in the blob with the given key, in
+ * the same order as strcmp
+ */
+static int compare_key(const char* stored, const cb::const_char_buffer& key) {
+    const auto len = strlen(stored);
+    const auto rv = std::memcmp(stored, key.buf, std::min(len, key.len));
+    if (rv != 0) {
+        return rv;
+    }
+    return len < key.len ? -1 : (len > key.len ? 1 : 0);
+}
+
 Blob::Blob(const Blob& other)
-    : allocator(default_allocator),
+    : index(other.index),
+      indexed(other.indexed),
+      allocator(default_allocator),
       alloc_size(other.blob.size()) {
     decompressed.resize(other.decompressed.size());
     std::copy_n(other.decompressed.data(),
@@ -49,18 +65,15 @@ Blob::Blob(cb::char_buffer buffer,
 }
 
 Blob& Blob::assign(cb::char_buffer buffer, bool compressed) {
+    index.clear();
+    indexed = false;
     if (compressed && buffer.size()) {
-        // inflate and attach blob to the compression::buffer
-        if (!cb::compression::inflate(
-                    cb::compression::Algorithm::Snappy,
+        // inflate just the xattrs and attach blob to the compression::buffer
+        if (!cb::xattr::inflate_xattrs(
                     {static_cast<const char*>(buffer.data()), buffer.size()},
                     decompressed)) {
             throw std::runtime_error("Blob::assign failed to inflate");
         }
-
-        // Connect blob to the decompressed xattrs after resizing which in
-        // theory /could/ release the now un-required non xattr data
-        decompressed.resize(cb::xattr::get_body_offset(decompressed));
         blob = {decompressed.data(), decompressed.size()};
     } else if (buffer.size()) {
         // incoming data is not compressed, just get the size and attach
@@ -73,35 +86,123 @@ Blob& Blob::assign(cb::char_buffer buffer, bool compressed) {
 }
 
 cb::char_buffer Blob::get(const cb::const_char_buffer& key) const {
+    const auto offset = find(key);
+    if (offset == 0) {
+        // Not found!
+        return {nullptr, 0};
+    }
+
+    auto* value = blob.buf + offset + 4 + key.len + 1;
+    return {value, strlen(value)};
+}
+
+size_t Blob::find(const cb::const_char_buffer& key) const {
+    if (!indexed) {
+        build_index();
+    }
+
+    if (!index.empty()) {
+        const auto iter = std::lower_bound(
+                index.begin(),
+                index.end(),
+                key,
+                [this](uint32_t offset, const cb::const_char_buffer& k) {
+                    return compare_key(blob.buf + offset + 4, k) < 0;
+                });
+        if (iter != index.end() &&
+            compare_key(blob.buf + *iter + 4, key) == 0) {
+            return *iter;
+        }
+        return 0;
+    }
+
     try {
         size_t current = 4;
         while (current < blob.len) {
             // Get the length of the next kv-pair
             const auto size = read_length(current);
-            current += 4;
             if (size > key.len) {
                 // This may be the next key
-                if (blob.buf[current + key.len] == '\0' &&
-                    std::memcmp(blob.buf + current, key.buf, key.len) == 0) {
+                const auto* ptr = blob.buf + current + 4;
+                if (ptr[key.len] == '\0' &&
+                    std::memcmp(ptr, key.buf, key.len) == 0) {
                     // Yay this is the key!!!
-                    auto* value = blob.buf + current + key.len + 1;
-                    return {value, strlen(value)};
-                } else {
-                    // jump to the next key!!
-                    current += size;
+                    return current;
                 }
-            } else {
-                current += size;
             }
+            // jump to the next key!!
+            current += 4 + size;
         }
     } catch (const std::out_of_range&) {
     }
 
-    // Not found!
-    return {nullptr, 0};
+    return 0;
+}
+
+void Blob::build_index() const {
+    index.clear();
+    indexed = true;
+
+    size_t count = 0;
+    try {
+        size_t current = 4;
+        while (current < blob.len) {
+            current += 4 + read_length(current);
+            ++count;
+        }
+    } catch (const std::out_of_range&) {
+        // Leave it to the scan to deal with
+        return;
+    }
+
+    if (count < IndexThreshold) {
+        return;
+    }
+
+    index.reserve(count);
+    size_t current = 4;
+    while (current < blob.len) {
+        index.push_back(gsl::narrow<uint32_t>(current));
+        current += 4 + read_length(current);
+    }
+
+    std::sort(index.begin(), index.end(), [this](uint32_t a, uint32_t b) {
+        return std::strcmp(blob.buf + a + 4, blob.buf + b + 4) < 0;
+    });
+}
+
+void Blob::index_inserted(size_t offset) {
+    if (index.empty()) {
+        return;
+    }
+
+    const auto* key = blob.buf + offset + 4;
+    const auto iter = std::lower_bound(
+            index.begin(), index.end(), key, [this](uint32_t o, const char* k) {
+                return std::strcmp(blob.buf + o + 4, k) < 0;
+            });
+    index.insert(iter, gsl::narrow<uint32_t>(offset));
+}
+
+void Blob::index_removed(size_t offset, size_t size) {
+    if (index.empty()) {
+        return;
+    }
+
+    index.erase(std::remove(index.begin(), index.end(), offset), index.end());
+    for (auto& entry : index) {
+        if (entry > offset) {
+            entry -= gsl::narrow<uint32_t>(size);
+        }
+    }
 }
 
 void Blob::prune_user_keys() {
+    // Most (if not all) of the blob is probably going, so rebuild the index
+    // when it is next needed rather than keeping it up to date.
+    index.clear();
+    indexed = false;
+
     try {
         size_t current = 4;
         while (current < blob.len) {
@@ -169,6 +270,7 @@ void Blob::set(const cb::const_char_buffer& key,
             allocator.swap(temp);
             blob = {allocator.get(), newsize - 4 - key.len - 1 - value.len - 1};
             alloc_size = newsize;
+            index_removed(old_offset, old_kv_size);
         }
 
         append_kvpair(key, value);
@@ -218,9 +320,12 @@ void Blob::append_kvpair(const cb::const_char_buffer& key,
 
     grow_buffer(gsl::narrow<uint32_t>(needed));
     write_kvpair(offset, key, value);
+    index_inserted(offset);
 }
 
 void Blob::remove_segment(const size_t offset, const size_t size) {
+    index_removed(offset, size);
+
     if (offset + size == blob.len) {
         // No need to do anyting as this was the last thing in our blob..
         // just change the length
@@ -17,6 +17,7 @@
 #include "config.h"
 
 #include <cJSON_utils.h>
+#include <algorithm>
 #include <unordered_set>
 #include <memcached/protocol_binary.h>
 #include <xattr/blob.h>
@@ -151,6 +152,138 @@ char_buffer get_body(const cb::char_buffer& payload) {
     return {payload.buf + offset, payload.len - offset};
 }
 
+/**
+ * Read a little endian value of the given number of bytes from the input,
+ * advancing it.
+ *
+ * @return false if the input is too short
+ */
+static bool snappy_read_le(cb::const_char_buffer& input,
+                           size_t bytes,
+                           uint32_t& value) {
+    if (input.size() < bytes) {
+        return false;
+    }
+    value = 0;
+    for (size_t ii = 0; ii < bytes; ++ii) {
+        value |= uint32_t(uint8_t(input.buf[ii])) << (8 * ii);
+    }
+    input.buf += bytes;
+    input.len -= bytes;
+    return true;
+}
+
+/**
+ * Inflate the first size bytes of a snappy compressed buffer.
+ *
+ * Snappy's (raw) format is the uncompressed length followed by a sequence
+ * of literals and copies of earlier output, so any prefix of the output can
+ * be produced by decoding just as many elements as it takes.
+ *
+ * @param input the compressed data
+ * @param size the number of bytes to inflate
+ * @param output where to store them (must have room for size bytes)
+ * @return false if the input isn't valid or inflates to less than size bytes
+ */
+static bool snappy_inflate_prefix(cb::const_char_buffer input,
+                                  size_t size,
+                                  char* output) {
+    // The preamble; the uncompressed length as a varint.
+    uint64_t length = 0;
+    for (int shift = 0;; shift += 7) {
+        if (input.empty() || shift > 28) {
+            return false;
+        }
+        const auto byte = uint8_t(input.buf[0]);
+        input.buf++;
+        input.len--;
+        length |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    if (length < size) {
+        return false;
+    }
+
+    size_t produced = 0;
+    while (produced < size) {
+        if (input.empty()) {
+            return false;
+        }
+        const auto tag = uint8_t(input.buf[0]);
+        input.buf++;
+        input.len--;
+
+        uint32_t len;
+        uint32_t offset;
+        switch (tag & 0x3) {
+        case 0: { // literal
+            len = tag >> 2;
+            if (len >= 60 && !snappy_read_le(input, len - 59, len)) {
+                return false;
+            }
+            const auto literal = size_t(len) + 1;
+            if (literal > input.size()) {
+                return false;
+            }
+            const auto needed = std::min(literal, size - produced);
+            std::copy_n(input.buf, needed, output + produced);
+            input.buf += needed;
+            input.len -= needed;
+            produced += needed;
+            continue;
+        }
+        case 1: // copy with 1 byte offset
+            len = 4 + ((tag >> 2) & 0x7);
+            if (!snappy_read_le(input, 1, offset)) {
+                return false;
+            }
+            offset |= uint32_t(tag >> 5) << 8;
+            break;
+        case 2: // copy with 2 byte offset
+            len = (tag >> 2) + 1;
+            if (!snappy_read_le(input, 2, offset)) {
+                return false;
+            }
+            break;
+        default: // copy with 4 byte offset
+            len = (tag >> 2) + 1;
+            if (!snappy_read_le(input, 4, offset)) {
+                return false;
+            }
+            break;
+        }
+
+        if (offset == 0 || offset > produced) {
+            return false;
+        }
+        len = std::min(len, uint32_t(size - produced));
+        // The source may overlap what is being written (a repeating
+        // pattern), so copy a byte at a time.
+        const char* src = output + produced - offset;
+        for (uint32_t ii = 0; ii < len; ++ii) {
+            output[produced + ii] = src[ii];
+        }
+        produced += len;
+    }
+
+    return true;
+}
+
+bool inflate_xattrs(const cb::const_char_buffer& payload,
+                    cb::compression::Buffer& xattrs) {
+    uint32_t len;
+    if (!snappy_inflate_prefix(
+                payload, sizeof(len), reinterpret_cast<char*>(&len))) {
+        return false;
+    }
+
+    const size_t size = ntohl(len) + sizeof(len);
+    xattrs.resize(size);
+    return snappy_inflate_prefix(payload, size, xattrs.data());
+}
+
 size_t get_system_xattr_size(uint8_t datatype, const cb::const_char_buffer doc) {
     if (!::mcbp::datatype::is_xattr(datatype)) {
         return 0;